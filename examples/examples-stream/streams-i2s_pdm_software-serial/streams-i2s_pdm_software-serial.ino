@@ -0,0 +1,43 @@
+/**
+ * @file streams-i2s_pdm_software-serial.ino
+ * @author Phil Schatzmann
+ * @brief We read the raw data of a PDM microphone with a standard I2S
+ * interface and convert it to PCM in software: with 48000 samples per second
+ * and 2 channels of 32 bits the bit clock is 3.072 MHz, so that each frame
+ * provides the 64 PDM bits of one PCM sample. Connect the clock of the
+ * microphone to BCK and the data to the data in pin.
+ *
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+
+#include "AudioTools.h"
+#include "AudioTools/PDMConverter.h"
+
+AudioInfo info_i2s(48000, 2, 32);
+AudioInfo info(48000, 1, 16);
+I2SStream i2sStream;  // Access I2S as stream
+PDMToPCMStream pdm(i2sStream);
+CsvOutput<int16_t> csvStream(Serial);
+StreamCopy copier(csvStream, pdm);  // copy the PCM data to csvStream
+
+// Arduino Setup
+void setup(void) {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Info);
+
+  auto cfg = i2sStream.defaultConfig(RX_MODE);
+  cfg.copyFrom(info_i2s);
+  i2sStream.begin(cfg);
+
+  // 64 PDM bits per sample which are provided as 32 bit words
+  pdm.setDecimation(64);
+  pdm.setWordSize(4);
+  pdm.setGain(4.0);
+  pdm.begin(info);
+
+  csvStream.begin(info);
+}
+
+// Arduino loop - copy data
+void loop() { copier.copy(); }
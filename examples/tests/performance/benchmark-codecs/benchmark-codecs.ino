@@ -0,0 +1,69 @@
+/**
+ * @file benchmark-codecs.ino
+ * @author Phil Schatzmann
+ * @brief Measures the cycles per sample, the used real time budget and the
+ * heap and stack use of the encoders and decoders on the target. The encoded
+ * data is generated from the test block before it is decoded.
+ * Please install the https://github.com/pschatzmann/adpcm library
+ * @version 0.1
+ * @date 2024-03-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "AudioTools.h"
+#include "AudioTools/AudioBenchmark.h"
+#include "AudioCodecs/CodecADPCM.h"  // https://github.com/pschatzmann/adpcm
+
+AudioInfo info(44100, 2, 16);
+AudioBenchmark benchmark(info, 1024);
+const int blocks = 50;
+NullStream null_out;
+
+/// Collects the encoded data
+class EncodedOutput : public AudioOutput {
+ public:
+  Vector<uint8_t> data{0};
+  size_t write(const uint8_t* in, size_t len) override {
+    int size = data.size();
+    data.resize(size + len);
+    memcpy(data.data() + size, in, len);
+    return len;
+  }
+};
+
+void measure(const char* name, AudioEncoder& encoder, AudioDecoder& decoder) {
+  Serial.println(name);
+  // encoding
+  EncodedOutput encoded;
+  encoder.setAudioInfo(info);
+  encoder.setOutput(null_out);
+  encoder.begin();
+  benchmark.run("- encode", encoder);
+  // use a longer sequence for the decoder
+  encoder.setOutput(encoded);
+  for (int j = 0; j < blocks; j++) {
+    encoder.write((uint8_t*)benchmark.data(), benchmark.size());
+  }
+  encoder.end();
+
+  decoder.setAudioInfo(info);
+  benchmark.run("- decode", decoder, encoded.data.data(), encoded.data.size());
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+  benchmark.setOutput(Serial);
+  benchmark.begin();
+
+  ADPCMEncoder adpcm_encoder(AV_CODEC_ID_ADPCM_IMA_WAV, 1024);
+  ADPCMDecoder adpcm_decoder(AV_CODEC_ID_ADPCM_IMA_WAV, 1024);
+  measure("ADPCM IMA WAV", adpcm_encoder, adpcm_decoder);
+
+  EncoderL8 l8_encoder;
+  DecoderL8 l8_decoder;
+  measure("L8", l8_encoder, l8_decoder);
+}
+
+void loop() {}
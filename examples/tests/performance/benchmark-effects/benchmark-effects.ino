@@ -0,0 +1,57 @@
+/**
+ * @file benchmark-effects.ino
+ * @author Phil Schatzmann
+ * @brief Measures the cycles per sample, the used real time budget and the
+ * heap and stack use of the standard effects on the target
+ * @version 0.1
+ * @date 2024-03-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "AudioTools.h"
+#include "AudioTools/AudioBenchmark.h"
+#include "AudioEffects/Dynamics.h"
+
+AudioInfo info(44100, 2, 16);
+AudioBenchmark benchmark(info, 512);
+NullStream out;
+
+void measure(const char* name, AudioEffect& effect) {
+  AudioEffectStreamT<effect_t> effects(out);
+  effects.addEffect(effect);
+  effects.begin(info);
+  benchmark.run(name, effects);
+  effects.end();
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+  benchmark.setOutput(Serial);
+  benchmark.begin();
+
+  Boost boost(0.5);
+  measure("Boost", boost);
+  Distortion distortion;
+  measure("Distortion", distortion);
+  Fuzz fuzz;
+  measure("Fuzz", fuzz);
+  Tremolo tremolo;
+  measure("Tremolo", tremolo);
+  Delay delay_effect(100);
+  measure("Delay", delay_effect);
+  ADSRGain adsr;
+  measure("ADSRGain", adsr);
+  PitchShift pitch_shift;
+  measure("PitchShift", pitch_shift);
+  DynamicsEffect dynamics;
+  measure("DynamicsEffect", dynamics);
+
+  VolumeStream volume(out);
+  volume.begin(info);
+  volume.setVolume(0.5);
+  benchmark.run("VolumeStream", volume);
+}
+
+void loop() {}
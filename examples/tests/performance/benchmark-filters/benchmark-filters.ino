@@ -0,0 +1,70 @@
+/**
+ * @file benchmark-filters.ino
+ * @author Phil Schatzmann
+ * @brief Measures the cycles per sample, the used real time budget and the
+ * heap and stack use of the standard filters and converters on the target
+ * @version 0.1
+ * @date 2024-03-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "AudioTools.h"
+#include "AudioTools/AudioBenchmark.h"
+
+AudioInfo info(44100, 2, 16);
+AudioBenchmark benchmark(info, 512);
+NullStream out;
+
+template <typename TF>
+void measure(const char* name, Filter<TF>& left, Filter<TF>& right) {
+  FilteredStream<int16_t, TF> filtered(out, info.channels);
+  filtered.setFilter(0, left);
+  filtered.setFilter(1, right);
+  filtered.begin(info);
+  benchmark.run(name, filtered);
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+  benchmark.setOutput(Serial);
+  benchmark.begin();
+
+  // 32 tap moving average
+  static float fir_coef[32];
+  for (int j = 0; j < 32; j++) fir_coef[j] = 1.0f / 32;
+  FIR<float> fir_left(fir_coef), fir_right(fir_coef);
+  measure("FIR<float> 32 taps", fir_left, fir_right);
+
+  LowPassFilter<float> lp_left(1000, info.sample_rate);
+  LowPassFilter<float> lp_right(1000, info.sample_rate);
+  measure("LowPassFilter<float>", lp_left, lp_right);
+
+  HighPassFilter<float> hp_left(1000, info.sample_rate);
+  HighPassFilter<float> hp_right(1000, info.sample_rate);
+  measure("HighPassFilter<float>", hp_left, hp_right);
+
+  EquilizerNBands eq(out);
+  eq.setGraphic(10);
+  eq.begin(info);
+  for (int j = 0; j < eq.size(); j++) eq.setGain(j, j % 2 ? 3.0f : -3.0f);
+  benchmark.run("EquilizerNBands 10 bands", eq);
+  eq.setFixedPoint(true);
+  benchmark.run("EquilizerNBands 10 bands fixed", eq);
+
+  ResampleStream resample(out);
+  resample.setStepSize(0.5f);
+  resample.begin(info);
+  benchmark.run("ResampleStream 0.5", resample);
+
+  NumberFormatConverterStreamT<int16_t, int32_t> to32(out);
+  to32.begin();
+  benchmark.run("NumberFormatConverter 16->32", to32);
+
+  ChannelFormatConverterStreamT<int16_t> to_mono(out);
+  to_mono.begin(info.channels, 1);
+  benchmark.run("ChannelFormatConverter 2->1", to_mono);
+}
+
+void loop() {}
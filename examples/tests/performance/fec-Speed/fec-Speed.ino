@@ -0,0 +1,62 @@
+/**
+ * @file fec-Speed.ino
+ * @author Phil Schatzmann
+ * @brief Measures the encoding and decoding throughput of the forward error
+ * correction classes in MB/s
+ * @version 0.1
+ * @date 2024-01-20
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include "AudioTools.h"
+#include "Communication/AudioFEC.h"
+
+const int frame_size = 200;
+const int frames = 200;
+uint8_t data[frame_size];
+RingBuffer<uint8_t> buffer(frame_size * 2 * frames);
+QueueStream<uint8_t> queue(buffer);
+
+template <class FEC>
+void measure(const char* name, FEC& fec) {
+  // encode
+  queue.begin();
+  uint32_t start = micros();
+  for (int j = 0; j < frames; j++) {
+    fec.write(data, frame_size);
+  }
+  uint32_t encode_us = micros() - start;
+
+  // decode
+  start = micros();
+  for (int j = 0; j < frames; j++) {
+    fec.readBytes(data, frame_size);
+  }
+  uint32_t decode_us = micros() - start;
+
+  float mb = frame_size * frames / 1000000.0f;
+  Serial.print(name);
+  Serial.print(" encode: ");
+  Serial.print(mb / (encode_us / 1000000.0f));
+  Serial.print(" MB/s decode: ");
+  Serial.print(mb / (decode_us / 1000000.0f));
+  Serial.println(" MB/s");
+  queue.end();
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+  for (int j = 0; j < frame_size; j++) data[j] = random(255);
+}
+
+void loop() {
+  static ReedSolomonFEC<frame_size, 8> rs(queue);
+  static HammingFEC<frame_size, uint16_t> hamming16(queue);
+  static HammingFEC<frame_size, uint32_t> hamming32(queue);
+  measure("Reed-Solomon(8)", rs);
+  measure("Hamming<uint16_t>", hamming16);
+  measure("Hamming<uint32_t>", hamming32);
+  delay(1000);
+}
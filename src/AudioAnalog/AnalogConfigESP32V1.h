@@ -101,6 +101,12 @@ class AnalogConfigESP32V1 : public AudioInfo {
     // ADC config parameters
     bool adc_calibration_active = false;
     bool is_auto_center_read = false;
+    /// Batch read: the DC offset is removed with a running mean of
+    /// 1/2^auto_center_shift (see ConverterDCBlockerT)
+    int auto_center_shift = 10;
+    /// Reads the ADC results in blocks directly into the output buffer: false
+    /// uses the (slower) per channel FIFO buffers
+    bool is_batch_read = true;
     adc_digi_convert_mode_t adc_conversion_mode = ADC_CONV_MODE;
     adc_digi_output_format_t adc_output_type = ADC_OUTPUT_TYPE;
     uint8_t adc_attenuation = ADC_ATTEN_DB_12; // full voltage range of 3.9V
@@ -184,12 +184,27 @@ protected:
     bool active_tx = false;
     bool active_rx = false;
     ConverterAutoCenter auto_center;
+    // auto center of the batch read: applied when the frames are assembled
+    ConverterDCBlockerT<int16_t> dc_blocker;
     #ifdef HAS_ESP32_DAC
     dac_continuous_handle_t dac_handle;
     #endif
     
     // create array of FIFO buffers, one for each channel
-    FIFO<ADC_DATA_TYPE>** fifo_buffers;
+    FIFO<ADC_DATA_TYPE>** fifo_buffers = nullptr;
+
+    // batched reading: ADC results which have not been processed yet
+    Vector<adc_digi_output_data_t> read_buffer{0};
+    int read_pos = 0;
+    int read_len = 0;
+    // calibrated value in millivolts for each raw value
+    Vector<int16_t> cali_table{0};
+    // index in the frame for each ADC channel number (-1 if not used)
+    int8_t channel_slot[16];
+    // incomplete and last complete frame of the last read
+    Vector<int16_t> open_frame{0};
+    Vector<int16_t> last_frame{0};
+    uint32_t open_mask = 0;
 
     // 16Bit Audiostream for ESP32
     // ----------------------------------------------------------
@@ -243,6 +258,16 @@ protected:
         // } adc_digi_output_data_t;     
 
         size_t readBytes(uint8_t *dest, size_t size_bytes) {
+            if (self->cfg.is_batch_read) {
+                return self->readBatch(dest, size_bytes);
+            }
+            return readBytesFIFO(dest, size_bytes);
+        }
+
+    protected:
+        AnalogDriverESP32V1 *self;
+
+        size_t readBytesFIFO(uint8_t *dest, size_t size_bytes) {
             // TRACED();
 
             size_t total_bytes = 0;
@@ -423,11 +448,130 @@ protected:
             return bytes_provided;
         }
 
-    protected:
-        AnalogDriverESP32V1 *self;
-
     } io{this};
 
+    // Batched reading: the ADC results are parsed in blocks and the samples
+    // are written directly to their position in the interleaved output. 
+    // Incomplete frames and unprocessed results are kept for the next call.
+    // ----------------------------------------------------------
+    size_t readBatch(uint8_t *dest, size_t size_bytes) {
+        const int channels = cfg.channels;
+        const uint32_t full_mask = (1u << channels) - 1;
+        const int frames = size_bytes / sizeof(int16_t) / channels;
+        if (frames == 0) return 0;
+        const bool calibrate = cali_table.size() > 0;
+        const bool center = cfg.is_auto_center_read;
+        const ADC_DATA_TYPE raw_mask = cali_table.size() - 1;
+        int16_t *frame = (int16_t *)dest;
+        int16_t *end = frame + frames * channels;
+        uint32_t mask = open_mask;
+
+        // continue with the incomplete frame of the last call
+        memcpy(frame, open_frame.data(), channels * sizeof(int16_t));
+
+        while (frame < end) {
+            if (read_pos >= read_len && !readADC((end - frame) * channels)) {
+                break;
+            }
+            const adc_digi_output_data_t *p = read_buffer.data() + read_pos;
+            const adc_digi_output_data_t *p_end = read_buffer.data() + read_len;
+            for (; p < p_end && frame < end; p++) {
+                int slot = channel_slot[AUDIO_ADC_GET_CHANNEL(p) & 0xF];
+                if (slot < 0) continue;
+                ADC_DATA_TYPE data = AUDIO_ADC_GET_DATA(p);
+                uint32_t bit = 1u << slot;
+                if (mask & bit) {
+                    // a result was lost: repeat the last values of the
+                    // missing channels to keep the channels aligned
+                    const int16_t *last = frame == (int16_t *)dest ? last_frame.data()
+                                                                  : frame - channels;
+                    for (int ch = 0; ch < channels; ch++) {
+                        if ((mask & (1u << ch)) == 0) frame[ch] = last[ch];
+                    }
+                    frame += channels;
+                    mask = 0;
+                    if (frame >= end) break;
+                }
+                int16_t value = calibrate ? cali_table[data & raw_mask] : (int16_t)data;
+                frame[slot] = center ? dc_blocker.process(slot, value) : value;
+                mask |= bit;
+                if (mask == full_mask) {
+                    frame += channels;
+                    mask = 0;
+                }
+            }
+            read_pos = p - read_buffer.data();
+        }
+
+        // keep the incomplete and the last complete frame for the next call
+        if (frame < end) {
+            memcpy(open_frame.data(), frame, channels * sizeof(int16_t));
+        }
+        open_mask = frame < end ? mask : 0;
+        if (frame > (int16_t *)dest) {
+            memcpy(last_frame.data(), frame - channels, channels * sizeof(int16_t));
+        }
+
+        return (frame - (int16_t *)dest) * sizeof(int16_t);
+    }
+
+    // Reads the next block of ADC results into the read_buffer
+    bool readADC(int samples) {
+        int max_samples = read_buffer.size();
+        if (samples > max_samples) samples = max_samples;
+        // the requested bytes must be a multiple of 4
+        uint32_t bytes = samples * sizeof(adc_digi_output_data_t);
+        bytes = (bytes + 3) & ~3u;
+        if (bytes > max_samples * sizeof(adc_digi_output_data_t)) bytes -= 4;
+        uint32_t bytes_read = 0;
+        read_pos = 0;
+        read_len = 0;
+        if (adc_continuous_read(adc_handle, (uint8_t *)read_buffer.data(), bytes,
+                                &bytes_read, (uint32_t)cfg.timeout) != ESP_OK) {
+            LOGE("adc_continuous_read unsuccessful");
+            return false;
+        }
+        read_len = bytes_read / sizeof(adc_digi_output_data_t);
+        return read_len > 0;
+    }
+
+    // Setup of the channel mapping, read buffer and calibration table for
+    // the batched reading
+    // ----------------------------------------------------------
+    bool setupBatchRead() {
+        for (int j = 0; j < 16; j++) channel_slot[j] = -1;
+        for (int i = 0; i < cfg.channels; i++) {
+            channel_slot[cfg.adc_channels[i] & 0xF] = i;
+        }
+        read_buffer.resize(cfg.buffer_size);
+        read_pos = 0;
+        read_len = 0;
+        open_frame.resize(cfg.channels);
+        last_frame.resize(cfg.channels);
+        memset(open_frame.data(), 0, cfg.channels * sizeof(int16_t));
+        memset(last_frame.data(), 0, cfg.channels * sizeof(int16_t));
+        open_mask = 0;
+        dc_blocker.begin(cfg.channels, cfg.auto_center_shift);
+        cali_table.resize(0);
+        if (cfg.adc_calibration_active) {
+            // evaluate the calibration only once for all raw values
+            int size = 1 << cfg.adc_bit_width;
+            cali_table.resize(size);
+            for (int raw = 0; raw < size; raw++) {
+                int milli_volts = 0;
+                auto err = adc_cali_raw_to_voltage(adc_cali_handle, raw, &milli_volts);
+                if (err != ESP_OK) {
+                    LOGE("adc_cali_raw_to_voltage error: %d", err);
+                    cali_table.resize(0);
+                    return false;
+                }
+                cali_table[raw] = milli_volts;
+            }
+            LOGI("calibration table with %d entries", size);
+        }
+        return true;
+    }
+
     NumberFormatConverterStream converter{io};
 
     // Setup Digital to Analog
@@ -599,6 +743,12 @@ protected:
         // Setup up optimal auto center which puts the avg at 0
         auto_center.begin(cfg.channels, cfg.bits_per_sample, true);
 
+        if (cfg.is_batch_read) {
+            if (!setupBatchRead()) return false;
+            LOGI("Setup ADC successful");
+            return true;
+        }
+
         // Initialize the FIFO buffers    
         size_t fifo_size = (cfg.buffer_size / cfg.channels) + 8; // Add a few extra elements
         fifo_buffers = new FIFO<ADC_DATA_TYPE>*[cfg.channels]; // Allocate an array of FIFO objects
@@ -634,6 +784,8 @@ protected:
             delete[] fifo_buffers;
             fifo_buffers = nullptr;
         }
+        read_buffer.resize(0);
+        cali_table.resize(0);
 
         #ifdef ARDUINO
         // Set all used pins/channels to INIT state
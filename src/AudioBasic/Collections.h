@@ -6,6 +6,7 @@
  */
 
 #include "AudioBasic/Collections/Vector.h"
+#include "AudioBasic/Collections/VectorN.h"
 #include "AudioBasic/Collections/List.h"
 #include "AudioBasic/Collections/Stack.h"
 #include "AudioBasic/Collections/Queue.h"
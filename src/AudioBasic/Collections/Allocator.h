@@ -3,6 +3,15 @@
 
 #include "AudioConfig.h"
 #include "AudioTools/AudioLogger.h"
+#if defined(ESP32)
+#include "esp_heap_caps.h"
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include "esp_memory_utils.h"
+#else
+#include "soc/soc_memory_layout.h"
+#endif
+#endif
 
 namespace audio_tools {
 
@@ -133,4 +142,590 @@ class AllocatorPSRAM : public Allocator {
 
 static AllocatorExt DefaultAllocator;
 
+/// Placement hint for a buffer: hot buffers are accessed frequently and
+/// should stay in internal SRAM, cold buffers can go to PSRAM
+enum class MemoryHint { Default, Hot, Cold, DMA };
+
+/**
+ * @brief Allocator which places the memory according to a MemoryHint: on the
+ * ESP32 hot buffers are allocated in internal SRAM (and only if this fails in
+ * PSRAM), cold buffers in PSRAM (and only if this fails in internal SRAM) and
+ * DMA buffers in DMA capable memory. On other platforms we just use calloc.
+ * The actual placement is tracked, so that it can be reported with
+ * logReport(): hot buffers which ended up in PSRAM are likely to suffer from
+ * cache misses.
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AllocatorHint : public Allocator {
+ public:
+  AllocatorHint(MemoryHint hint, const char* name = "") {
+    this->hint = hint;
+    this->name = name;
+  }
+
+  void free(void* memory) override {
+    if (memory == nullptr) return;
+    Header* header = (Header*)memory - 1;
+    if (header->is_external) {
+      external_size -= header->size;
+    } else {
+      internal_size -= header->size;
+    }
+#if defined(ESP32)
+    heap_caps_free(header);
+#else
+    ::free(header);
+#endif
+  }
+
+  MemoryHint memoryHint() { return hint; }
+
+  /// Bytes which are currently allocated in internal memory
+  size_t internalSize() { return internal_size; }
+
+  /// Bytes which are currently allocated in PSRAM
+  size_t externalSize() { return external_size; }
+
+  /// Number of allocations which could not be placed as requested
+  int misplacedCount() { return misplaced_count; }
+
+  /// Logs the actual placement
+  void logReport() {
+    LOGI("%s: internal: %zu bytes, psram: %zu bytes, misplaced: %d", name,
+         internal_size, external_size, misplaced_count);
+    if (hint == MemoryHint::Hot && external_size > 0) {
+      LOGW("%s: %zu bytes of hot buffers in PSRAM", name, external_size);
+    }
+  }
+
+ protected:
+  struct Header {
+    uint32_t size;
+    uint32_t is_external;
+  };
+  MemoryHint hint;
+  const char* name;
+  size_t internal_size = 0;
+  size_t external_size = 0;
+  int misplaced_count = 0;
+
+  void* do_allocate(size_t size) override {
+    size_t total = sizeof(Header) + (size == 0 ? 1 : size);
+    bool is_external = false;
+    Header* header = nullptr;
+#if defined(ESP32)
+    const uint32_t internal = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    const uint32_t external = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    switch (hint) {
+      case MemoryHint::Hot:
+        header = (Header*)heap_caps_malloc(total, internal);
+        if (header == nullptr) {
+          header = (Header*)heap_caps_malloc(total, external);
+          is_external = header != nullptr;
+          misplaced_count++;
+        }
+        break;
+      case MemoryHint::Cold:
+        header = (Header*)heap_caps_malloc(total, external);
+        is_external = header != nullptr;
+        if (header == nullptr) {
+          header = (Header*)heap_caps_malloc(total, internal);
+          misplaced_count++;
+        }
+        break;
+      case MemoryHint::DMA:
+        header = (Header*)heap_caps_malloc(total, MALLOC_CAP_DMA | internal);
+        break;
+      default:
+        header = (Header*)heap_caps_malloc(total, internal);
+        if (header == nullptr) {
+          header = (Header*)heap_caps_malloc(total, external);
+          is_external = header != nullptr;
+        }
+        break;
+    }
+#else
+    header = (Header*)malloc(total);
+#endif
+    if (header == nullptr) return nullptr;
+    memset(header, 0, total);
+    header->size = size;
+    header->is_external = is_external;
+    if (is_external) {
+      external_size += size;
+    } else {
+      internal_size += size;
+    }
+    return header + 1;
+  }
+};
+
+/// Allocator for frequently accessed buffers (e.g. copy and I2S buffers)
+static AllocatorHint HotAllocator{MemoryHint::Hot, "hot"};
+/// Allocator for rarely accessed data (e.g. metadata and url history)
+static AllocatorHint ColdAllocator{MemoryHint::Cold, "cold"};
+/// Allocator for buffers which are accessed by DMA
+static AllocatorHint DMAAllocator{MemoryHint::DMA, "dma"};
+
+/**
+ * @brief Allocator which accounts the memory of a component (e.g. a codec,
+ * a buffer, the FFT or the HTTP client): it forwards the requests to the
+ * parent allocator and records the current and peak bytes separately for
+ * internal SRAM and PSRAM. If a budget is defined, allocations which would
+ * exceed it are failing, so that the Allocator stops with an error instead of
+ * running out of memory later. All tracked allocators are registered, so
+ * that logReportAll() can report them together.
+ * @code
+ * AllocatorTracked mp3_memory("mp3", 40000);
+ * decoder.setAllocator(mp3_memory);
+ * @endcode
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AllocatorTracked : public Allocator {
+ public:
+  AllocatorTracked(const char* tag, size_t budget = 0,
+                   Allocator& parent = DefaultAllocator) {
+    this->tag = tag;
+    this->budget = budget;
+    p_parent = &parent;
+    // register
+    p_next = first();
+    first() = this;
+  }
+
+  ~AllocatorTracked() {
+    // unregister
+    for (AllocatorTracked** p = &first(); *p != nullptr; p = &(*p)->p_next) {
+      if (*p == this) {
+        *p = p_next;
+        break;
+      }
+    }
+  }
+
+  /// Defines the max number of bytes: 0 = no limit
+  void setBudget(size_t bytes) { budget = bytes; }
+
+  size_t budgetSize() { return budget; }
+
+  const char* name() { return tag; }
+
+  void free(void* memory) override {
+    if (memory == nullptr) return;
+    Header* header = (Header*)memory - 1;
+    if (header->is_external) {
+      external_size -= header->size;
+    } else {
+      internal_size -= header->size;
+    }
+    p_parent->free(header);
+  }
+
+  /// Bytes which are currently allocated
+  size_t size() { return internal_size + external_size; }
+
+  /// Bytes which are currently allocated in internal SRAM
+  size_t internalSize() { return internal_size; }
+
+  /// Bytes which are currently allocated in PSRAM
+  size_t externalSize() { return external_size; }
+
+  /// Max bytes which were allocated
+  size_t peak() { return peak_size; }
+
+  /// Max bytes which were allocated in internal SRAM
+  size_t internalPeak() { return internal_peak; }
+
+  /// Max bytes which were allocated in PSRAM
+  size_t externalPeak() { return external_peak; }
+
+  /// Number of allocations which were rejected because of the budget
+  int rejectedCount() { return rejected_count; }
+
+  /// Logs the current and peak values
+  void logReport() {
+    LOGI("%s: current: %zu (sram %zu, psram %zu) peak: %zu (sram %zu, psram "
+         "%zu) budget: %zu",
+         tag, size(), internal_size, external_size, peak_size, internal_peak,
+         external_peak, budget);
+  }
+
+  /// First registered tracked allocator (or nullptr)
+  static AllocatorTracked*& first() {
+    static AllocatorTracked* p_first = nullptr;
+    return p_first;
+  }
+
+  /// Next registered tracked allocator (or nullptr)
+  AllocatorTracked* next() { return p_next; }
+
+  /// Logs the values of all tracked allocators
+  static void logReportAll() {
+    for (AllocatorTracked* p = first(); p != nullptr; p = p->p_next) {
+      p->logReport();
+    }
+  }
+
+  /// Provides the tracked allocator with the indicated tag (or nullptr)
+  static AllocatorTracked* find(const char* tag) {
+    for (AllocatorTracked* p = first(); p != nullptr; p = p->p_next) {
+      if (strcmp(p->tag, tag) == 0) return p;
+    }
+    return nullptr;
+  }
+
+ protected:
+  /// Keeps the alignment of 8 bytes
+  struct Header {
+    uint32_t size;
+    uint32_t is_external;
+  };
+  const char* tag;
+  Allocator* p_parent = nullptr;
+  AllocatorTracked* p_next = nullptr;
+  size_t budget = 0;
+  size_t internal_size = 0;
+  size_t external_size = 0;
+  size_t internal_peak = 0;
+  size_t external_peak = 0;
+  size_t peak_size = 0;
+  int rejected_count = 0;
+
+  static bool isExternal(void* memory) {
+#if defined(ESP32)
+    return esp_ptr_external_ram(memory);
+#else
+    return false;
+#endif
+  }
+
+  void* do_allocate(size_t size) override {
+    if (budget > 0 && this->size() + size > budget) {
+      LOGE("%s: budget of %zu bytes exceeded: %zu + %zu", tag, budget,
+           this->size(), size);
+      rejected_count++;
+      return nullptr;
+    }
+    Header* header = (Header*)p_parent->allocate(sizeof(Header) + size);
+    if (header == nullptr) return nullptr;
+    header->size = size;
+    header->is_external = isExternal(header);
+    if (header->is_external) {
+      external_size += size;
+      if (external_size > external_peak) external_peak = external_size;
+    } else {
+      internal_size += size;
+      if (internal_size > internal_peak) internal_peak = internal_size;
+    }
+    if (this->size() > peak_size) peak_size = this->size();
+    return header + 1;
+  }
+};
+
+/// Defines where the memory region of an AllocatorArena or AllocatorPool is
+/// located
+enum class MemoryPlacement { Default, Internal, PSRAM, DMA };
+
+/**
+ * @brief Base class for allocators which are managing a single preallocated
+ * memory region: the region is either provided by the caller or it is
+ * allocated in begin() with the requested placement (internal SRAM, PSRAM or
+ * DMA capable memory on the ESP32; malloc on all other platforms).
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AllocatorRegion : public Allocator {
+ public:
+  ~AllocatorRegion() { releaseRegion(); }
+
+  /// Size of the managed region in bytes
+  size_t size() { return region_size; }
+
+  /// Address of the managed region
+  uint8_t* region() { return p_region; }
+
+  /// Checks if the memory belongs to the region
+  bool contains(void* memory) {
+    uint8_t* ptr = (uint8_t*)memory;
+    return p_region != nullptr && ptr >= p_region &&
+           ptr < p_region + region_size;
+  }
+
+  MemoryPlacement placement() { return region_placement; }
+
+ protected:
+  uint8_t* p_region = nullptr;
+  size_t region_size = 0;
+  bool is_owned = false;
+  MemoryPlacement region_placement = MemoryPlacement::Default;
+
+  /// Allocates the region with the requested placement
+  bool setupRegion(size_t size, MemoryPlacement placement) {
+    releaseRegion();
+    region_placement = placement;
+    p_region = (uint8_t*)allocateRegion(size, placement);
+    if (p_region == nullptr) {
+      LOGE("Region allocation failed for %zu bytes", size);
+      return false;
+    }
+    region_size = size;
+    is_owned = true;
+    return true;
+  }
+
+  /// Uses memory which is managed by the caller
+  void setupRegion(void* region, size_t size) {
+    releaseRegion();
+    p_region = (uint8_t*)region;
+    region_size = size;
+    is_owned = false;
+  }
+
+  void releaseRegion() {
+    if (is_owned && p_region != nullptr) {
+#if defined(ESP32)
+      heap_caps_free(p_region);
+#else
+      ::free(p_region);
+#endif
+    }
+    p_region = nullptr;
+    region_size = 0;
+    is_owned = false;
+  }
+
+  static void* allocateRegion(size_t size, MemoryPlacement placement) {
+    if (size == 0) size = 1;
+#if defined(ESP32)
+    uint32_t caps = MALLOC_CAP_8BIT;
+    switch (placement) {
+      case MemoryPlacement::Internal:
+        caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        break;
+      case MemoryPlacement::PSRAM:
+        caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+        break;
+      case MemoryPlacement::DMA:
+        caps = MALLOC_CAP_DMA | MALLOC_CAP_8BIT;
+        break;
+      default:
+        break;
+    }
+    return heap_caps_malloc(size, caps);
+#else
+    return malloc(size);
+#endif
+  }
+
+  /// All allocations are aligned to 8 bytes
+  static size_t align(size_t size) { return (size + 7) & ~(size_t)7; }
+};
+
+/**
+ * @brief Bump pointer allocator: all allocations are taken sequentially from
+ * one preallocated region and free() does not give back any memory (except
+ * for the most recent allocation). The whole region is released with
+ * reset(). This way a complete processing chain can be set up from one
+ * region with a predictable peak memory usage.
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AllocatorArena : public AllocatorRegion {
+ public:
+  AllocatorArena() = default;
+
+  /// Allocates the region with the indicated size and placement
+  AllocatorArena(size_t size,
+                 MemoryPlacement placement = MemoryPlacement::Default) {
+    begin(size, placement);
+  }
+
+  /// Uses the memory region provided by the caller
+  AllocatorArena(void* region, size_t size) { begin(region, size); }
+
+  bool begin(size_t size,
+             MemoryPlacement placement = MemoryPlacement::Default) {
+    reset();
+    return setupRegion(size, placement);
+  }
+
+  bool begin(void* region, size_t size) {
+    reset();
+    setupRegion(region, size);
+    return region != nullptr;
+  }
+
+  /// Releases the region
+  void end() {
+    reset();
+    releaseRegion();
+  }
+
+  /// Makes the complete region available again: the objects which have been
+  /// allocated from it must not be used any more!
+  void reset() {
+    used_size = 0;
+    last_pos = 0;
+  }
+
+  /// Only the most recent allocation gives back its memory
+  void free(void* memory) override {
+    if (memory == nullptr) return;
+    if (!contains(memory)) {
+      LOGE("free: memory not from arena");
+      return;
+    }
+    if ((uint8_t*)memory == p_region + last_pos) {
+      used_size = last_pos;
+    }
+  }
+
+  /// Bytes which are currently in use
+  size_t used() { return used_size; }
+
+  /// Max bytes which were in use
+  size_t peak() { return peak_size; }
+
+  /// Bytes which are still available
+  size_t available() { return region_size - used_size; }
+
+ protected:
+  size_t used_size = 0;
+  size_t last_pos = 0;
+  size_t peak_size = 0;
+
+  void* do_allocate(size_t size) override {
+    size_t len = align(size == 0 ? 1 : size);
+    if (p_region == nullptr || used_size + len > region_size) {
+      LOGE("Arena exhausted: %zu of %zu bytes used", used_size, region_size);
+      return nullptr;
+    }
+    void* result = p_region + used_size;
+    last_pos = used_size;
+    used_size += len;
+    if (used_size > peak_size) peak_size = used_size;
+    memset(result, 0, len);
+    return result;
+  }
+};
+
+/**
+ * @brief Allocator which manages a preallocated region of blocks with a fixed
+ * size: allocation and free are O(1) using a free list and there is no
+ * fragmentation. Allocations which are bigger then the block size are
+ * failing.
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AllocatorPool : public AllocatorRegion {
+ public:
+  AllocatorPool() = default;
+
+  /// Allocates the region for count blocks with the indicated size
+  AllocatorPool(size_t blockSize, int count,
+                MemoryPlacement placement = MemoryPlacement::Default) {
+    begin(blockSize, count, placement);
+  }
+
+  /// Splits up the memory region provided by the caller into blocks
+  AllocatorPool(void* region, size_t size, size_t blockSize) {
+    begin(region, size, blockSize);
+  }
+
+  bool begin(size_t blockSize, int count,
+             MemoryPlacement placement = MemoryPlacement::Default) {
+    block_size = blockAlign(blockSize);
+    if (!setupRegion(block_size * count, placement)) return false;
+    setupFreeList();
+    return true;
+  }
+
+  bool begin(void* region, size_t size, size_t blockSize) {
+    block_size = blockAlign(blockSize);
+    setupRegion(region, size);
+    setupFreeList();
+    return region != nullptr;
+  }
+
+  /// Releases the region
+  void end() {
+    releaseRegion();
+    setupFreeList();
+  }
+
+  /// Gives the block back to the pool
+  void free(void* memory) override {
+    if (memory == nullptr) return;
+    if (!contains(memory)) {
+      LOGE("free: memory not from pool");
+      return;
+    }
+    *(uint8_t**)memory = p_free;
+    p_free = (uint8_t*)memory;
+    used_count--;
+  }
+
+  /// Size of a block in bytes
+  size_t blockSize() { return block_size; }
+
+  /// Total number of blocks
+  int blockCount() { return block_count; }
+
+  /// Number of blocks which are currently in use
+  int used() { return used_count; }
+
+  /// Max number of blocks which were in use
+  int peak() { return peak_count; }
+
+  /// Number of blocks which are still available
+  int available() { return block_count - used_count; }
+
+ protected:
+  uint8_t* p_free = nullptr;
+  size_t block_size = 0;
+  int block_count = 0;
+  int used_count = 0;
+  int peak_count = 0;
+
+  /// A free block must be able to store the pointer to the next free block
+  static size_t blockAlign(size_t size) {
+    return align(size < sizeof(void*) ? sizeof(void*) : size);
+  }
+
+  void setupFreeList() {
+    p_free = nullptr;
+    used_count = 0;
+    block_count = block_size == 0 ? 0 : region_size / block_size;
+    for (int j = block_count - 1; j >= 0; j--) {
+      uint8_t* block = p_region + j * block_size;
+      *(uint8_t**)block = p_free;
+      p_free = block;
+    }
+  }
+
+  void* do_allocate(size_t size) override {
+    if (size > block_size) {
+      LOGE("Requested %zu bytes > block size %zu", size, block_size);
+      return nullptr;
+    }
+    if (p_free == nullptr) {
+      LOGE("Pool exhausted: %d blocks used", used_count);
+      return nullptr;
+    }
+    uint8_t* result = p_free;
+    p_free = *(uint8_t**)p_free;
+    used_count++;
+    if (used_count > peak_count) peak_count = used_count;
+    memset(result, 0, block_size);
+    return result;
+  }
+};
+
 }  // namespace audio_tools
\ No newline at end of file
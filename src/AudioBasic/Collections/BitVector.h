@@ -7,7 +7,10 @@
 namespace audio_tools {
 
 /**
- * @brief Space optimized vector which stores the boolean values as bits
+ * @brief Space optimized vector which stores the boolean values as bits.
+ * Beside the individual bit access we support some bulk operations which
+ * are working on 64 bit words: append(), getBits(), setBits(), copyFrom(),
+ * popcount() and findFirstSet().
  * @ingroup collections
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -25,8 +28,8 @@ public:
     if (index < 0)
       return false;
     bool result = false;
-    int offset = index / sizeof(uint64_t);
-    int bit = index % sizeof(uint64_t);
+    int offset = index >> 6;
+    int bit = index & 63;
     if (offset < vector.size()) {
       uint64_t value = vector[offset];
       // get bit
@@ -39,20 +42,18 @@ public:
     if (index < 0)
       return;
     max_idx = max(max_idx, index + 1);
-    int offset = index / sizeof(uint64_t);
-    int bit = index % sizeof(uint64_t);
-    while (offset >= vector.size()) {
-      vector.push_back(0l);
-    }
+    int offset = index >> 6;
+    int bit = index & 63;
+    reserveWords(offset + 1);
     // check if we need to updte the value
     if (((vector[offset] >> bit) & 1U) != value) {
       // needs update
       if (value) {
         // set bit
-        vector[offset] |= 1UL << bit;
+        vector[offset] |= 1ULL << bit;
       } else {
         // clear bit
-        vector[offset] &= ~(1UL << bit);
+        vector[offset] &= ~(1ULL << bit);
       }
       // call change handler to notify about change
       if (changeHandler != nullptr) {
@@ -61,6 +62,109 @@ public:
     }
   }
 
+  /// Provides up to 64 bits starting at the indicated index (lsb first)
+  uint64_t getBits(int64_t index, int count) {
+    if (index < 0 || count <= 0)
+      return 0;
+    if (count > 64)
+      count = 64;
+    int offset = index >> 6;
+    int bit = index & 63;
+    uint64_t result = 0;
+    if (offset < vector.size()) {
+      result = vector[offset] >> bit;
+      if (bit != 0 && bit + count > 64 && offset + 1 < vector.size()) {
+        result |= vector[offset + 1] << (64 - bit);
+      }
+    }
+    return result & mask(count);
+  }
+
+  /// Updates up to 64 bits starting at the indicated index (lsb first)
+  void setBits(int64_t index, uint64_t bits, int count) {
+    if (index < 0 || count <= 0)
+      return;
+    if (count > 64)
+      count = 64;
+    if (changeHandler != nullptr) {
+      // we need to report the individual changes
+      for (int j = 0; j < count; j++) {
+        set(index + j, (bits >> j) & 1U);
+      }
+      return;
+    }
+    max_idx = max(max_idx, index + count);
+    int offset = index >> 6;
+    int bit = index & 63;
+    reserveWords(((index + count - 1) >> 6) + 1);
+    uint64_t m = mask(count);
+    bits &= m;
+    vector[offset] = (vector[offset] & ~(m << bit)) | (bits << bit);
+    if (bit + count > 64) {
+      int rest = 64 - bit;
+      uint64_t m2 = m >> rest;
+      vector[offset + 1] = (vector[offset + 1] & ~m2) | (bits >> rest);
+    }
+  }
+
+  /// Adds up to 64 bits at the end (lsb first)
+  void append(uint64_t bits, int count) { setBits(max_idx, bits, count); }
+
+  /// Copies len bits from the source starting at srcIdx to destIdx
+  void copyFrom(BitVector &src, int64_t srcIdx, int64_t len,
+                int64_t destIdx = 0) {
+    if (srcIdx < 0 || destIdx < 0 || len <= 0)
+      return;
+    if (&src == this && destIdx > srcIdx && destIdx < srcIdx + len) {
+      // overlapping: copy backwards
+      int64_t pos = len;
+      while (pos > 0) {
+        int n = pos >= 64 ? 64 : pos;
+        pos -= n;
+        setBits(destIdx + pos, getBits(srcIdx + pos, n), n);
+      }
+      return;
+    }
+    for (int64_t pos = 0; pos < len; pos += 64) {
+      int n = len - pos >= 64 ? 64 : len - pos;
+      setBits(destIdx + pos, src.getBits(srcIdx + pos, n), n);
+    }
+  }
+
+  /// Counts the bits which are set
+  int64_t popcount() {
+    int64_t result = 0;
+    int words = (max_idx + 63) >> 6;
+    for (int j = 0; j < words && j < vector.size(); j++) {
+      uint64_t value = vector[j];
+      if (j == words - 1 && (max_idx & 63) != 0)
+        value &= mask(max_idx & 63);
+      result += __builtin_popcountll(value);
+    }
+    return result;
+  }
+
+  /// Provides the index of the first set bit starting from the indicated
+  /// position: -1 if there is none
+  int64_t findFirstSet(int64_t from = 0) {
+    if (from < 0)
+      from = 0;
+    int words = (max_idx + 63) >> 6;
+    int offset = from >> 6;
+    if (offset >= words || offset >= vector.size())
+      return -1;
+    uint64_t value = vector[offset] & (~0ULL << (from & 63));
+    while (true) {
+      if (value != 0) {
+        int64_t result = ((int64_t)offset << 6) + __builtin_ctzll(value);
+        return result < max_idx ? result : -1;
+      }
+      if (++offset >= words || offset >= vector.size())
+        return -1;
+      value = vector[offset];
+    }
+  }
+
   void clear() {
     max_idx = 0;
     vector.clear();
@@ -95,15 +199,10 @@ public:
     }
     max_idx+=n;
   }
-  /// Extracts an integer 
+
+  /// Extracts an integer starting at the indicated bit index
   template <typename T> T toInt(int n) {
-    T result;
-    for (int j = 0; j < sizeof(T) * 8; j++) {
-      bool x = get(n);
-      // set bit at pos
-      result ^= (-x ^ result) & (1UL << j);
-    }
-    return result;
+    return (T)getBits(n, sizeof(T) * 8);
   }
 
 
@@ -112,9 +211,19 @@ protected:
   void (*changeHandler)(int idx, bool value, void *ref) = nullptr;
   void *ref;
   int64_t max_idx = 0;
+
+  static uint64_t mask(int count) {
+    return count >= 64 ? ~0ULL : (1ULL << count) - 1;
+  }
+
+  void reserveWords(int words) {
+    while (words > vector.size()) {
+      vector.push_back(0ull);
+    }
+  }
 };
 
 
 } // namespace audio_tools
 
-#endif
\ No newline at end of file
+#endif
@@ -8,6 +8,11 @@
 
 namespace audio_tools {
 
+/// Called after the Vector has moved elements with memmove: types which
+/// point into their own memory provide an overload to fix the pointers.
+template <class T>
+inline void vectorRelocated(T *data, int count) {}
+
 /**
  * @brief Vector implementation which provides the most important methods as
  *defined by std::vector. This class it is quite handy to have and most of the
@@ -128,7 +133,7 @@ class Vector {
 
   /// copy constructor
   Vector(Vector<T> &copyFrom) {
-    this->p_allocator = copyFrom.p_allocator;
+    setAllocator(*copyFrom.p_allocator);
     resize_internal(copyFrom.size(), false);
     for (int j = 0; j < copyFrom.size(); j++) {
       p_data[j] = copyFrom[j];
@@ -148,7 +153,7 @@ class Vector {
 
   /// legacy constructor with pointer range
   Vector(T *from, T *to, Allocator &allocator = DefaultAllocator) {
-    this->p_allocator = &allocator;
+    setAllocator(allocator);
     this->len = to - from;
     resize_internal(this->len, false);
     for (size_t j = 0; j < this->len; j++) {
@@ -159,10 +164,18 @@ class Vector {
   /// Destructor
   virtual ~Vector() { reset(); }
 
+  /// Defines the allocator: an explicitly defined allocator (e.g. an
+  /// AllocatorArena) is also used if USE_ALLOCATOR is not active. Any memory
+  /// which has been allocated with the prior allocator is released.
   void setAllocator(Allocator &allocator) {
+    if (p_data != nullptr && &allocator != p_allocator) reset();
     p_allocator = &allocator;
+    is_custom_allocator = &allocator != &DefaultAllocator;
   }
 
+  /// Provides the allocator
+  Allocator &allocator() { return *p_allocator; }
+
   void clear() { len = 0; }
 
   int size() { return len; }
@@ -232,14 +245,20 @@ class Vector {
     T *dataCpy = p_data;
     int bufferLenCpy = bufferLen;
     int lenCpy = len;
+    Allocator *allocatorCpy = p_allocator;
+    bool isCustomCpy = is_custom_allocator;
     // swap this
     p_data = in.p_data;
     len = in.len;
     bufferLen = in.bufferLen;
+    p_allocator = in.p_allocator;
+    is_custom_allocator = in.is_custom_allocator;
     // swp in
     in.p_data = dataCpy;
     in.len = lenCpy;
     in.bufferLen = bufferLenCpy;
+    in.p_allocator = allocatorCpy;
+    in.is_custom_allocator = isCustomCpy;
   }
 
   T &operator[](int index) {
@@ -288,6 +307,7 @@ class Vector {
       // shift values by 1 position
       memmove((void *)&p_data[pos], (void *)(&p_data[pos + 1]),
               lenToEnd * sizeof(T));
+      vectorRelocated(&p_data[pos], lenToEnd);
 
       // make sure that we have a valid object at the end
 #if defined(NO_INPLACE_INIT_SUPPORT)
@@ -342,6 +362,7 @@ class Vector {
   int len = 0;
   T *p_data = nullptr;
   Allocator *p_allocator = &DefaultAllocator;
+  bool is_custom_allocator = false;
 
   void resize_internal(int newSize, bool copy, bool shrink = false) {
     if (newSize <= 0) return;
@@ -355,6 +376,7 @@ class Vector {
         if (copy && this->len > 0) {
           // save existing data
           memmove((void*)p_data, (void*)oldData, len * sizeof(T));
+          vectorRelocated(p_data, len);
           // clear to prevent double release
           memset((void*)oldData, 0, len * sizeof(T));
         }
@@ -368,20 +390,20 @@ class Vector {
 
   T *newArray(int newSize) {
     T *data;
-#if USE_ALLOCATOR
-    data = p_allocator->createArray<T>(newSize);  // new T[newSize+1];
-#else
-    data = new T[newSize];
-#endif
+    if (USE_ALLOCATOR || is_custom_allocator) {
+      data = p_allocator->createArray<T>(newSize);  // new T[newSize+1];
+    } else {
+      data = new T[newSize];
+    }
     return data;
   }
 
   void deleteArray(T *oldData, int oldBufferLen) {
-#if USE_ALLOCATOR
-    p_allocator->removeArray(oldData, oldBufferLen);  // delete [] oldData;
-#else
-    delete[] oldData;
-#endif
+    if (USE_ALLOCATOR || is_custom_allocator) {
+      p_allocator->removeArray(oldData, oldBufferLen);  // delete [] oldData;
+    } else {
+      delete[] oldData;
+    }
   }
 
 
@@ -0,0 +1,93 @@
+#pragma once
+#include <assert.h>
+#include <stddef.h>
+
+namespace audio_tools {
+
+/**
+ * @brief Vector with a compile time capacity of N entries: the data is
+ * stored inside the object (or in static memory), so there is no heap
+ * allocation and the compiler can unroll the loops over capacity(). It
+ * provides the most important methods of the Vector, but the size can not
+ * grow beyond N.
+ * @ingroup collections
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T
+ * @tparam N capacity
+ **/
+template <class T, int N>
+class VectorN {
+ public:
+  VectorN() = default;
+
+  /// Allocate size and initialize array
+  VectorN(int size, T value) { resize(size, value); }
+
+  static constexpr int capacity() { return N; }
+
+  int size() { return len; }
+
+  bool empty() { return len == 0; }
+
+  bool isFull() { return len == N; }
+
+  void clear() { len = 0; }
+
+  /// Adds an entry: returns false if the capacity is exceeded
+  bool push_back(const T &value) {
+    if (len >= N) return false;
+    p_data[len++] = value;
+    return true;
+  }
+
+  void pop_back() {
+    if (len > 0) len--;
+  }
+
+  /// Removes a single element
+  void erase(int pos) {
+    if (pos < 0 || pos >= len) return;
+    for (int j = pos; j < len - 1; j++) p_data[j] = p_data[j + 1];
+    len--;
+  }
+
+  /// Changes the size: returns false if the capacity is exceeded
+  bool resize(int newSize) {
+    if (newSize < 0 || newSize > N) return false;
+    len = newSize;
+    return true;
+  }
+
+  bool resize(int newSize, T value) {
+    if (!resize(newSize)) return false;
+    for (int j = 0; j < newSize; j++) p_data[j] = value;
+    return true;
+  }
+
+  /// Sets all entries of the full capacity to the value
+  void fill(T value) {
+    for (int j = 0; j < N; j++) p_data[j] = value;
+  }
+
+  T &operator[](int index) {
+    assert(index < N);
+    return p_data[index];
+  }
+
+  const T &operator[](int index) const { return p_data[index]; }
+
+  T &back() { return p_data[len - 1]; }
+
+  T *data() { return p_data; }
+
+  T *begin() { return p_data; }
+
+  T *end() { return p_data + len; }
+
+ protected:
+  T p_data[N];
+  int len = 0;
+};
+
+}  // namespace audio_tools
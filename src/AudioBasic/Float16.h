@@ -1,9 +1,21 @@
 #pragma once
+#include <stdint.h>
+#include <string.h>
+#include <cmath>
+
+#if defined(__F16C__) && (!defined(USE_SIMD) || USE_SIMD)
+#  include <immintrin.h>
+#  define USE_FLOAT16_F16C
+#elif defined(__ARM_FP16_FORMAT_IEEE) && defined(__ARM_FP) && (__ARM_FP & 2)
+#  define USE_FLOAT16_ARM
+#endif
 
 namespace audio_tools {
 
 /**
- * @brief Stores float values with 2 bytes
+ * @brief Stores float values with 2 bytes. Use the bulk conversions
+ * toFloat() and fromFloat() for arrays: they use the F16C instructions on x86
+ * and the half precision conversion (vcvt) on ARM if available.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
@@ -30,22 +42,55 @@ class float16 {
          return (int) float16::half_to_float(value);
     }
     inline bool operator<  (float16 other) const{
-        return float() < (float)other;
+        return toFloat() < other.toFloat();
     }
     inline bool operator<=  (float16 other) const{
-        return float() <= (float)other;
+        return toFloat() <= other.toFloat();
     }
     inline bool operator>  (float16 other) const{
-        return float() > (float)other;
+        return toFloat() > other.toFloat();
     }
     inline bool operator>=  (float16 other) const{
-        return float() >= (float)other;
+        return toFloat() >= other.toFloat();
     }
     inline bool operator==  (float16 other) const{
-        return float() == (float)other;
+        return toFloat() == other.toFloat();
     }
     inline bool operator!=  (float16 other) const{
-        return float() != (float)other;
+        return toFloat() != other.toFloat();
+    }
+
+    /// Provides the value as float
+    inline float toFloat() const { return half_to_float(value); }
+
+    /// Converts an array of float16 values to floats
+    static void toFloat(const float16 *from, float *to, size_t samples) {
+        size_t j = 0;
+#if defined(USE_FLOAT16_F16C)
+        for (; j + 4 <= samples; j += 4) {
+            __m128i half = _mm_loadl_epi64((const __m128i *)(from + j));
+            _mm_storeu_ps(to + j, _mm_cvtph_ps(half));
+        }
+#elif defined(USE_FLOAT16_ARM)
+        const __fp16 *in = (const __fp16 *)from;
+        for (; j < samples; j++) to[j] = in[j];
+#endif
+        for (; j < samples; j++) to[j] = half_to_float(from[j].value);
+    }
+
+    /// Converts an array of floats to float16 values (rounded to nearest)
+    static void fromFloat(const float *from, float16 *to, size_t samples) {
+        size_t j = 0;
+#if defined(USE_FLOAT16_F16C)
+        for (; j + 4 <= samples; j += 4) {
+            __m128i half = _mm_cvtps_ph(_mm_loadu_ps(from + j), 0);
+            _mm_storel_epi64((__m128i *)(to + j), half);
+        }
+#elif defined(USE_FLOAT16_ARM)
+        __fp16 *out = (__fp16 *)to;
+        for (; j < samples; j++) out[j] = from[j];
+#endif
+        for (; j < samples; j++) to[j].value = float_to_half(from[j]);
     }
 
 
@@ -54,11 +99,15 @@ class float16 {
 
     /// see https://stackoverflow.com/questions/1659440/32-bit-to-16-bit-floating-point-conversion
     static uint32_t as_uint(const float x) {
-        return *(uint*)&x;
+        uint32_t result;
+        memcpy(&result, &x, sizeof(result));
+        return result;
     }
     /// see https://stackoverflow.com/questions/1659440/32-bit-to-16-bit-floating-point-conversion
     static float as_float(const uint32_t x) {
-        return *(float*)&x;
+        float result;
+        memcpy(&result, &x, sizeof(result));
+        return result;
     }
 
     /// see https://stackoverflow.com/questions/1659440/32-bit-to-16-bit-floating-point-conversion
@@ -78,6 +127,8 @@ class float16 {
 
 };
 
+static_assert(sizeof(float16) == 2, "float16 must use 2 bytes");
+
 inline float operator+ (float16 one, float16 two) 
 {
 	return (float)one + (float)two;
@@ -112,26 +163,26 @@ inline float operator/ (float16 one, float two)
 }
 inline float operator+ (float one, float16 two)
 {
-	return two + float(one);
+	return one + (float)two;
 }
 inline float operator- (float one, float16 two)
 {
-	return two - float(one);
+	return one - (float)two;
 }
 inline float operator* (float one, float16 two)
 {
-	return two * float(one);
+	return one * (float)two;
 }
 inline float operator/ (float one, float16 two)
 {
-	return two / float(one);
+	return one / (float)two;
 }
 
 }
 
 namespace std {
 
-inline float floor ( float16 arg ) { return std::floor((float)arg);}
-inline float fabs ( float16 arg ) { return std::fabs((float)arg);}
+inline float floor ( audio_tools::float16 arg ) { return std::floor((float)arg);}
+inline float fabs ( audio_tools::float16 arg ) { return std::fabs((float)arg);}
 
 }
@@ -2,11 +2,18 @@
 
 #include "AudioBasic/Str.h"
 
+/// Short strings (incl. the terminating 0) are stored w/o heap allocation
+#ifndef STR_EXT_INLINE_SIZE
+#  define STR_EXT_INLINE_SIZE 24
+#endif
+
 namespace audio_tools {
 
 /**
  * @brief Str which keeps the data on the heap. We grow the allocated
- * memory only if the copy source is not fitting.
+ * memory only if the copy source is not fitting. Strings with less than
+ * STR_EXT_INLINE_SIZE characters are kept in an inline buffer, so that they
+ * do not need any heap allocation.
  *
  * While it should be avoided to use a lot of heap allocatioins in
  * embedded devices it is sometimes more convinent to allocate a string
@@ -93,8 +100,7 @@ class StrExt : public Str {
 
   /// assigns a memory buffer
   void copyFrom(const char *source, int len, int maxlen = 0) {
-    this->maxlen = maxlen == 0 ? len : maxlen;
-    grow(this->maxlen);
+    grow(maxlen == 0 ? len : maxlen);
     if (this->chars != nullptr) {
       this->len = len;
       this->is_const = false;
@@ -169,19 +175,42 @@ class StrExt : public Str {
     chars = nullptr;
   }
 
-  void swap(StrExt &other){
+  void swap(StrExt &other) {
+    bool is_inline = chars == inline_chars;
+    bool other_inline = other.chars == other.inline_chars;
+    bool is_null = chars == nullptr;
+    bool other_null = other.chars == nullptr;
     int tmp_len = len;
     int tmp_maxlen = maxlen;
     len = other.len;
     maxlen = other.maxlen;
+    other.len = tmp_len;
+    other.maxlen = tmp_maxlen;
     vector.swap(other.vector);
-    chars = vector.data();
-    other.chars = other.vector.data();
+    char tmp[STR_EXT_INLINE_SIZE];
+    memcpy(tmp, inline_chars, STR_EXT_INLINE_SIZE);
+    memcpy(inline_chars, other.inline_chars, STR_EXT_INLINE_SIZE);
+    memcpy(other.inline_chars, tmp, STR_EXT_INLINE_SIZE);
+    chars = other_null     ? nullptr
+            : other_inline ? inline_chars
+                           : vector.data();
+    other.chars = is_null     ? nullptr
+                  : is_inline ? other.inline_chars
+                              : other.vector.data();
   }
 
+  /// Returns true if the string is stored in the inline buffer
+  bool isInline() { return chars == inline_chars; }
+
+  /// The object was moved with memmove: an inline string must point to the
+  /// new inline buffer
+  void relocated() {
+    if (chars != nullptr && chars != vector.data()) chars = inline_chars;
+  }
 
  protected:
   Vector<char> vector;
+  char inline_chars[STR_EXT_INLINE_SIZE];
 
   StrExt& move(StrExt &other) {
     swap(other);
@@ -200,7 +229,16 @@ class StrExt : public Str {
       grown = true;
       // we use at minimum the defined maxlen
       int newSize = newMaxLen > maxlen ? newMaxLen : maxlen;
+      if (newSize < STR_EXT_INLINE_SIZE && vector.size() == 0) {
+        chars = inline_chars;
+        chars[0] = 0;
+        maxlen = STR_EXT_INLINE_SIZE - 1;
+        return grown;
+      }
+      bool was_inline = chars == inline_chars;
       vector.resize(newSize + 1);
+      // keep the content of the inline buffer
+      if (was_inline) memcpy(vector.data(), inline_chars, len + 1);
       chars = &vector[0];
       maxlen = newSize;
     }
@@ -240,4 +278,9 @@ class StrExt : public Str {
   }
 };
 
+/// Fixes the inline strings after a Vector<StrExt> has moved its elements
+inline void vectorRelocated(StrExt *data, int count) {
+  for (int j = 0; j < count; j++) data[j].relocated();
+}
+
 }  // namespace audio_tools
\ No newline at end of file
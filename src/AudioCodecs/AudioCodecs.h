@@ -25,4 +25,5 @@
 #include "AudioCodecs/CodecFloat.h"
 #include "AudioCodecs/CodecBase64.h"
 #include "AudioCodecs/DecoderFromStreaming.h"
+#include "AudioCodecs/MultiDecoder.h"
 
@@ -15,6 +15,7 @@ namespace audio_tools {
  */
 class AudioDecoder : public AudioWriter, public AudioInfoSource {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_CODEC)
   AudioDecoder() = default;
   virtual ~AudioDecoder() = default;
   AudioDecoder(AudioDecoder const &) = delete;
@@ -59,12 +60,34 @@ class AudioDecoder : public AudioWriter, public AudioInfoSource {
   bool begin() override { return true; }
   void end() override {}
 
+  /// Informs the decoder that the input has been moved by the indicated
+  /// number of bytes (e.g. after a seek): for most decoders this is not needed
+  virtual void notifySeek(long offset) {}
+
+  /// Keeps the allocated memory in end(), so that the next begin() just
+  /// resets the state (e.g. for the next track). Use release() to free the
+  /// memory.
+  virtual void setReuseMemory(bool flag) { is_reuse_memory = flag; }
+
+  /// Returns true if end() keeps the allocated memory
+  bool isReuseMemory() { return is_reuse_memory; }
+
+  /// Ends the processing and frees the memory also if setReuseMemory() is
+  /// active
+  virtual void release() {
+    bool reuse = is_reuse_memory;
+    is_reuse_memory = false;
+    end();
+    is_reuse_memory = reuse;
+  }
+
   /// custom id to be used by application
   int id;
 
  protected:
   Print *p_print = nullptr;
   AudioInfo info;
+  bool is_reuse_memory = false;
 };
 
 /**
@@ -86,6 +109,7 @@ class ContainerDecoder : public AudioDecoder {
  */
 class AudioEncoder : public AudioWriter {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_CODEC)
   AudioEncoder() = default;
   virtual ~AudioEncoder() = default;
   AudioEncoder(AudioEncoder const &) = delete;
@@ -120,6 +144,7 @@ class AudioEncoderExt : public AudioEncoder {
  */
 class CodecNOP : public AudioDecoder, public AudioEncoder {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_CODEC)
   static CodecNOP *instance() {
     static CodecNOP self;
     return &self;
@@ -208,8 +233,10 @@ class StreamingDecoder : public AudioInfoSource {
 class StreamingDecoderAdapter : public StreamingDecoder {
  public:
   StreamingDecoderAdapter(AudioDecoder &decoder,
-                          int copySize = DEFAULT_BUFFER_SIZE) {
+                          int copySize = DEFAULT_BUFFER_SIZE,
+                          Allocator &allocator = DefaultAllocator) {
     p_decoder = &decoder;
+    buffer.setAllocator(allocator);
     if (copySize > 0) resize(copySize);
   }
   /// Starts the processing
@@ -220,17 +247,28 @@ class StreamingDecoderAdapter : public StreamingDecoder {
 
   /// Defines the output Stream
   void setOutput(Print &out_stream) override {
+    p_print = &out_stream;
     p_decoder->setOutput(out_stream);
   }
 
   /// Provides the last available MP3FrameInfo
   AudioInfo audioInfo() override { return p_decoder->audioInfo(); }
 
+  /// Activates the back pressure: copy() reads the next data only if the
+  /// output can accept at least the indicated number of bytes. 0 (=default)
+  /// deactivates the check.
+  void setBackPressure(int minOutputBytes) {
+    min_output_available = minOutputBytes;
+  }
+
   /// checks if the class is active
   virtual operator bool() { return *p_decoder; }
 
   /// Process a single read operation - to be called in the loop
   virtual bool copy() {
+    if (min_output_available > 0 && p_print != nullptr &&
+        p_print->availableForWrite() < min_output_available)
+      return false;
     int read = readBytes(&buffer[0], buffer.size());
     int written = 0;
     if (read > 0) written = p_decoder->write(&buffer[0], read);
@@ -243,6 +281,7 @@ class StreamingDecoderAdapter : public StreamingDecoder {
  protected:
   AudioDecoder *p_decoder = nullptr;
   Vector<uint8_t> buffer{0};
+  int min_output_available = 0;
 
   size_t readBytes(uint8_t *data, size_t len) override {
     if (p_input == nullptr) return 0;
@@ -224,6 +224,9 @@ class EncodedAudioOutput : public ModifyingOutput {
   /// Is Available for Write check activated ?
   bool isCheckAvailableForWrite() { return check_available_for_write; }
 
+  /// Activates the check of availableForWrite() of the output
+  void setCheckAvailableForWrite(bool flag) { check_available_for_write = flag; }
+
   /// defines the size of the decoded frame in bytes
   void setFrameSize(int size) { frame_size = size; }
 
@@ -0,0 +1,233 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#include "AudioTools/AudioKernels.h"
+
+// the SSSE3 kernels are selected at runtime on the desktop
+#if defined(USE_SIMD_SSSE3)
+#  define USE_SIMD_BASE64
+#  define BASE64_SIMD_TARGET
+#elif defined(USE_SIMD_DISPATCH)
+#  include <tmmintrin.h>
+#  define USE_SIMD_BASE64
+#  define BASE64_SIMD_TARGET __attribute__((target("ssse3")))
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Bulk Base64 conversion of whole buffers: we process groups of 3
+ * bytes to 4 characters (and back) w/o any state. On x86 we convert 12 bytes
+ * to 16 characters (and back) with the SSSE3 instructions. The decoding
+ * accepts the standard and the URL safe alphabet: invalid characters are
+ * decoded as 0.
+ * @ingroup codecs
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Base64 {
+ public:
+  /// Number of characters which are needed to encode len bytes (incl.
+  /// padding)
+  static size_t encodedLength(size_t len) { return 4 * ((len + 2) / 3); }
+
+  /// Max number of bytes which result from decoding len characters
+  static size_t decodedLength(size_t len) { return len / 4 * 3 + 2; }
+
+  /// Encodes the bytes incl. the padding of the last group and returns the
+  /// number of characters
+  static size_t encode(const uint8_t *in, size_t len, char *out) {
+    size_t groups = len / 3;
+    encodeGroups(in, groups, out);
+    size_t pos = groups * 3;
+    char *p = out + groups * 4;
+    size_t rest = len - pos;
+    if (rest > 0) {
+      uint32_t triple = static_cast<uint32_t>(in[pos]) << 16;
+      if (rest > 1) triple |= static_cast<uint32_t>(in[pos + 1]) << 8;
+      p[0] = alphabet()[(triple >> 18) & 0x3F];
+      p[1] = alphabet()[(triple >> 12) & 0x3F];
+      p[2] = rest > 1 ? alphabet()[(triple >> 6) & 0x3F] : '=';
+      p[3] = '=';
+      p += 4;
+    }
+    return p - out;
+  }
+
+  /// Encodes full groups of 3 bytes to 4 characters w/o padding
+  static void encodeGroups(const uint8_t *in, size_t groups, char *out) {
+    size_t j = 0;
+#ifdef USE_SIMD_BASE64
+    if (useSIMD()) j = encodeSSSE3(in, groups, out);
+#endif
+    const char *table = alphabet();
+    for (; j < groups; j++) {
+      const uint8_t *p = in + j * 3;
+      uint32_t triple = (static_cast<uint32_t>(p[0]) << 16) |
+                        (static_cast<uint32_t>(p[1]) << 8) | p[2];
+      char *o = out + j * 4;
+      o[0] = table[(triple >> 18) & 0x3F];
+      o[1] = table[(triple >> 12) & 0x3F];
+      o[2] = table[(triple >> 6) & 0x3F];
+      o[3] = table[triple & 0x3F];
+    }
+  }
+
+  /// Decodes the characters and returns the number of bytes: padded groups
+  /// are supported at any position and an incomplete last group of 2 or 3
+  /// characters is decoded as if it was padded.
+  static size_t decode(const char *in, size_t len, uint8_t *out) {
+    const uint8_t *p = (const uint8_t *)in;
+    const uint8_t *table = decodeTable();
+    uint8_t *o = out;
+    size_t j = 0;
+    while (j + 4 <= len) {
+#ifdef USE_SIMD_BASE64
+      if (useSIMD()) {
+        size_t n = decodeSSSE3(p + j, (len - j) / 4, o);
+        j += n * 4;
+        o += n * 3;
+        if (j + 4 > len) break;
+      }
+#endif
+      // scalar processing of the next group (e.g. with padding)
+      const uint8_t *g = p + j;
+      uint32_t n = (static_cast<uint32_t>(table[g[0]]) << 18) |
+                   (static_cast<uint32_t>(table[g[1]]) << 12);
+      *o++ = n >> 16;
+      if (g[2] != '=') {
+        n |= static_cast<uint32_t>(table[g[2]]) << 6;
+        *o++ = (n >> 8) & 0xFF;
+        if (g[3] != '=') {
+          n |= table[g[3]];
+          *o++ = n & 0xFF;
+        }
+      }
+      j += 4;
+    }
+    // incomplete group
+    size_t rest = len - j;
+    if (rest >= 2) {
+      const uint8_t *g = p + j;
+      uint32_t n = (static_cast<uint32_t>(table[g[0]]) << 18) |
+                   (static_cast<uint32_t>(table[g[1]]) << 12);
+      *o++ = n >> 16;
+      if (rest == 3 && g[2] != '=') {
+        n |= static_cast<uint32_t>(table[g[2]]) << 6;
+        *o++ = (n >> 8) & 0xFF;
+      }
+    }
+    return o - out;
+  }
+
+ protected:
+  struct Table {
+    uint8_t values[256];
+    Table() {
+      memset(values, 0, sizeof(values));
+      for (int j = 0; j < 64; j++) values[(uint8_t)alphabet()[j]] = j;
+      // URL safe alphabet and the alternatives which were supported so far
+      values['-'] = 62;
+      values['.'] = 62;
+      values['_'] = 63;
+      values[','] = 63;
+    }
+  };
+
+  static const char *alphabet() {
+    return "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  }
+
+  static const uint8_t *decodeTable() {
+    static const Table table;
+    return table.values;
+  }
+
+#ifdef USE_SIMD_BASE64
+  static bool useSIMD() {
+#  ifdef USE_SIMD_SSSE3
+    return true;
+#  else
+    // all CPUs with SSE4.1 support SSSE3
+    return CpuFeatures::hasSSE41();
+#  endif
+  }
+
+  /// Encodes 12 bytes to 16 characters with each step: we load 16 bytes, so
+  /// we stop before reading past the end. Returns the number of processed
+  /// groups.
+  BASE64_SIMD_TARGET static size_t encodeSSSE3(const uint8_t *in,
+                                               size_t groups, char *out) {
+    const __m128i shuffle =
+        _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m128i shift_lut =
+        _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                      '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t j = 0;
+    for (; j * 3 + 16 <= groups * 3; j += 4) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(in + j * 3));
+      value = _mm_shuffle_epi8(value, shuffle);
+      // split each group into the 4 indices
+      __m128i t0 = _mm_and_si128(value, _mm_set1_epi32(0x0fc0fc00));
+      __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+      __m128i t2 = _mm_and_si128(value, _mm_set1_epi32(0x003f03f0));
+      __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+      __m128i indices = _mm_or_si128(t1, t3);
+      // map the ranges of the indices to the ascii offsets
+      __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+      __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+      result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+      result = _mm_shuffle_epi8(shift_lut, result);
+      result = _mm_add_epi8(result, indices);
+      _mm_storeu_si128((__m128i *)(out + j * 4), result);
+    }
+    return j;
+  }
+
+  /// Decodes 16 characters to 12 bytes with each step until we find a
+  /// character which is not part of the standard alphabet (e.g. padding).
+  /// Returns the number of processed groups.
+  BASE64_SIMD_TARGET static size_t decodeSSSE3(const uint8_t *in,
+                                               size_t groups, uint8_t *out) {
+    const __m128i lut_lo =
+        _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                      0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi =
+        _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+                      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll =
+        _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                       -1, -1, -1, -1);
+    const __m128i mask_nibble = _mm_set1_epi8(0x0F);
+    size_t j = 0;
+    for (; j + 4 <= groups; j += 4) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(in + j * 4));
+      __m128i hi = _mm_and_si128(_mm_srli_epi32(value, 4), mask_nibble);
+      __m128i lo = _mm_and_si128(value, mask_nibble);
+      // validate the characters with the nibble bitmaps
+      __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo),
+                                      _mm_shuffle_epi8(lut_hi, hi));
+      if (_mm_movemask_epi8(_mm_cmpgt_epi8(invalid, _mm_setzero_si128())))
+        break;
+      // translate the characters to the 6 bit values
+      __m128i eq_slash = _mm_cmpeq_epi8(value, _mm_set1_epi8(0x2F));
+      __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_slash, hi));
+      value = _mm_add_epi8(value, roll);
+      // merge the 4 values of each group into 3 bytes
+      value = _mm_maddubs_epi16(value, _mm_set1_epi32(0x01400140));
+      value = _mm_madd_epi16(value, _mm_set1_epi32(0x00011000));
+      value = _mm_shuffle_epi8(value, pack);
+      uint8_t *p = out + j * 3;
+      _mm_storel_epi64((__m128i *)p, value);
+      uint32_t rest = _mm_cvtsi128_si32(_mm_srli_si128(value, 8));
+      memcpy(p + 8, &rest, 4);
+    }
+    return j;
+  }
+#endif
+};
+
+}  // namespace audio_tools
@@ -47,6 +47,14 @@ class AACDecoderFAAD : public AudioDecoder {
       return false;
     }
 
+    // a kept decoder is just reset: NeAACDecInit() is called with the next data
+    if (hAac != nullptr) {
+      NeAACDecPostSeekReset(hAac, 0);
+      input_buffer.reset();
+      is_init = false;
+      return true;
+    }
+
     // Open the library
     hAac = NeAACDecOpen();
 
@@ -79,7 +87,7 @@ class AACDecoderFAAD : public AudioDecoder {
   virtual void end() {
     TRACED();
     flush();
-    if (hAac != nullptr) {
+    if (hAac != nullptr && !is_reuse_memory) {
       NeAACDecClose(hAac);
       hAac = nullptr;
     }
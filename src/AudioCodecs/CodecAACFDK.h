@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AudioCodecs/AudioCodecsBase.h"
+#include "AudioLibs/MemoryManager.h"
 #include "AACDecoderFDK.h"
 #include "AACEncoderFDK.h"
 
@@ -14,6 +15,8 @@ AudioInfoSupport *audioChangeFDK = nullptr;
  * @brief Audio Decoder which decodes AAC into a PCM stream
  * This is basically just a wrapper using https://github.com/pschatzmann/arduino-fdk-aac
  * which uses AudioInfo and provides the handlig of AudioInfo changes.
+ * The FDK state is allocated in begin(): with setMemoryPlacement() it can be
+ * moved to PSRAM.
  * @ingroup codecs
  * @ingroup decoder
  * @author Phil Schatzmann
@@ -40,13 +43,35 @@ class AACDecoderFDK : public AudioDecoder  {
             dec->setOutput(out_stream);
         }
 
+        /// Defines where the FDK state is allocated in begin(): with PSRAM
+        /// all allocations of at least psramLimit bytes go to PSRAM
+        void setMemoryPlacement(MemoryPlacement placement, int psramLimit = 4096){
+            memory_placement = placement;
+            psram_limit = psramLimit;
+        }
+
+        /// Internal memory in bytes which was allocated by the last begin()
+        int internalMemoryUsed() { return internal_used; }
+
+        /// PSRAM in bytes which was allocated by the last begin()
+        int psramMemoryUsed() { return psram_used; }
+
         bool begin(){
-            return dec->begin(TT_MP4_ADTS, 1);
+            return begin(TT_MP4_ADTS, 1);
         }
 
-        // opens the decoder
+        // opens the decoder: a kept decoder resynchronizes with the next frame
         bool begin(TRANSPORT_TYPE transportType, UINT nrOfLayers){
-            return dec->begin(transportType, nrOfLayers);
+            if (is_reuse_memory && (bool)*dec && transportType == transport_type
+                && nrOfLayers == layers) return true;
+            transport_type = transportType;
+            layers = nrOfLayers;
+            MemoryPlacementScope scope(memory_placement, psram_limit);
+            bool result = dec->begin(transportType, nrOfLayers);
+            internal_used = scope.internalUsed();
+            psram_used = scope.psramUsed();
+            LOGI("FDK decoder memory: internal %d, psram %d", internal_used, psram_used);
+            return result;
         }
 
         /**
@@ -83,7 +108,7 @@ class AACDecoderFDK : public AudioDecoder  {
         // release the resources
         void end(){
              TRACED();
-            dec->end();
+            if (!is_reuse_memory) dec->end();
         }
 
         virtual operator bool() {
@@ -113,12 +138,21 @@ class AACDecoderFDK : public AudioDecoder  {
 
     protected:
         aac_fdk::AACDecoderFDK *dec=nullptr;
+        TRANSPORT_TYPE transport_type = TT_MP4_ADTS;
+        UINT layers = 1;
+        MemoryPlacement memory_placement = MemoryPlacement::Default;
+        int psram_limit = 4096;
+        int internal_used = 0;
+        int psram_used = 0;
 };
 
 
 /**
  * @brief Encodes PCM data to the AAC format and writes the result to a stream
  * This is basically just a wrapper using https://github.com/pschatzmann/arduino-fdk-aac
+ * The FDK state is allocated in begin(): with setMemoryPlacement() it can be
+ * moved to PSRAM. The impact of the placement on the speed can be measured
+ * with avgEncodeTimeUs().
  * @ingroup codecs
  * @ingroup encoder
  * @author Phil Schatzmann
@@ -236,6 +270,33 @@ public:
         enc->setOutputBufferSize(outbuf_size);
     }
 
+    /// Restricts the encoder to AAC-LC w/o SBR and PS: call before begin()
+    void setLowComplexityOnly(){
+        setAudioObjectType(2);
+        setSpectralBandReplication(0);
+    }
+
+    /// Defines where the FDK state is allocated in begin(): with PSRAM
+    /// all allocations of at least psramLimit bytes go to PSRAM
+    void setMemoryPlacement(MemoryPlacement placement, int psramLimit = 4096){
+        memory_placement = placement;
+        psram_limit = psramLimit;
+    }
+
+    /// Internal memory in bytes which was allocated by the last begin()
+    int internalMemoryUsed() { return internal_used; }
+
+    /// PSRAM in bytes which was allocated by the last begin()
+    int psramMemoryUsed() { return psram_used; }
+
+    /// Average processing time of write() in us since begin()
+    uint32_t avgEncodeTimeUs() {
+        return write_count == 0 ? 0 : write_us / write_count;
+    }
+
+    /// Max processing time of write() in us since begin()
+    uint32_t maxEncodeTimeUs() { return max_write_us; }
+
     /// Defines the Audio Info
     void setAudioInfo(AudioInfo from) override {
         TRACED();
@@ -255,7 +316,7 @@ public:
      */
     virtual bool begin(AudioInfo info) {
         TRACED();
-        return enc->begin(info.channels,info.sample_rate, info.bits_per_sample);
+        return begin(info.channels,info.sample_rate, info.bits_per_sample);
     }
 
     /**
@@ -268,19 +329,30 @@ public:
      */
     virtual bool begin(int input_channels=2, int input_sample_rate=44100, int input_bits_per_sample=16) {
         TRACED();
-        return enc->begin(input_channels,input_sample_rate, input_bits_per_sample);
+        MemoryPlacementScope scope(memory_placement, psram_limit);
+        bool result = enc->begin(input_channels,input_sample_rate, input_bits_per_sample);
+        updateMemoryUsed(scope);
+        return result;
     }
 
     // starts the processing
     bool begin() {
+        MemoryPlacementScope scope(memory_placement, psram_limit);
         enc->begin();
+        updateMemoryUsed(scope);
         return true;
     }
     
     // convert PCM data to AAC
     size_t write(const uint8_t *data, size_t len){
         LOGD("write %d bytes", (int)len);
-        return enc->write((uint8_t*)data, len);
+        uint32_t start = micros();
+        size_t result = enc->write((uint8_t*)data, len);
+        uint32_t us = micros() - start;
+        write_us += us;
+        write_count++;
+        if (us > max_write_us) max_write_us = us;
+        return result;
     }
 
     // release resources
@@ -312,7 +384,22 @@ public:
 
 protected:
     aac_fdk::AACEncoderFDK *enc=nullptr;
-
+    MemoryPlacement memory_placement = MemoryPlacement::Default;
+    int psram_limit = 4096;
+    int internal_used = 0;
+    int psram_used = 0;
+    uint64_t write_us = 0;
+    uint32_t write_count = 0;
+    uint32_t max_write_us = 0;
+
+    void updateMemoryUsed(MemoryPlacementScope &scope){
+        internal_used = scope.internalUsed();
+        psram_used = scope.psramUsed();
+        LOGI("FDK encoder memory: internal %d, psram %d", internal_used, psram_used);
+        write_us = 0;
+        write_count = 0;
+        max_write_us = 0;
+    }
 };
 
 }
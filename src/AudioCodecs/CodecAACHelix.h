@@ -2,6 +2,7 @@
 
 #include "AudioCodecs/AudioCodecsBase.h"
 #include "AACDecoderHelix.h"
+#include "AudioCodecs/FrameAligner.h"
 
 namespace audio_tools {
 
@@ -84,7 +85,12 @@ class AACDecoderHelix : public AudioDecoder  {
             if (aac!=nullptr) {
                 //aac->setDelay(CODEC_DELAY_MS);
                 aac->setInfoCallback(infoCallback, this);
-                aac->begin();
+                // a kept decoder resynchronizes with the next frame
+                if (!is_reuse_memory || !(bool)*aac) aac->begin();
+            }
+            if (is_frame_aligned) {
+                aligner.setFrameCallback(frameCallback, this);
+                aligner.begin();
             }
             return true;
         }
@@ -92,7 +98,8 @@ class AACDecoderHelix : public AudioDecoder  {
         /// Releases the reserved memory
         virtual void end() override {
             TRACED();
-            if (aac!=nullptr) aac->end();
+            if (aac!=nullptr && !is_reuse_memory) aac->end();
+            if (is_frame_aligned) aligner.end();
         }
 
         virtual _AACFrameInfo audioInfoEx(){
@@ -119,6 +126,7 @@ class AACDecoderHelix : public AudioDecoder  {
         size_t write(const uint8_t* data, size_t len) override {
             LOGD("AACDecoderHelix::write: %d", (int)len);
             if (aac==nullptr) return 0;
+            if (is_frame_aligned) return aligner.write(data, len);
             int open = len;
             int processed = 0;
             uint8_t *data8 = (uint8_t*)data;
@@ -178,9 +186,33 @@ class AACDecoderHelix : public AudioDecoder  {
             aac->setMaxPCMSize(len);
         }
 
+        /// Groups the ADTS input into complete frames, so that libhelix is
+        /// called only once per frame: call before begin()
+        void setFrameAligned(bool active) {
+            is_frame_aligned = active;
+        }
+
+        /// Provides the frame statistics (e.g. framesPerSecond()) if the
+        /// input is frame aligned
+        FrameAligner &frameAligner() {
+            return aligner;
+        }
+
     protected:
         libhelix::AACDecoderHelix *aac=nullptr;
         bool info_notifications_active = true;
+        bool is_frame_aligned = false;
+        FrameAligner aligner{FrameAligner::ADTS};
+
+        static void frameCallback(const uint8_t *frame, size_t len, void *ref) {
+            AACDecoderHelix *self = (AACDecoderHelix *)ref;
+            size_t processed = 0;
+            while (processed < len) {
+                int act_write = self->aac->write(frame + processed, len - processed);
+                if (act_write <= 0) break;
+                processed += act_write;
+            }
+        }
 
 };
 
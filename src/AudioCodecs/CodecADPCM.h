@@ -13,7 +13,9 @@ namespace audio_tools {
  */
 class ADPCMDecoder : public AudioDecoderExt {
  public:
-  ADPCMDecoder(AVCodecID id, int blockSize = ADAPCM_DEFAULT_BLOCK_SIZE) {
+  ADPCMDecoder(AVCodecID id, int blockSize = ADAPCM_DEFAULT_BLOCK_SIZE,
+               Allocator &allocator = DefaultAllocator) {
+    adpcm_block.setAllocator(allocator);
     info.sample_rate = 44100;
     info.channels = 2;
     info.bits_per_sample = 16;
@@ -117,7 +119,9 @@ class ADPCMDecoder : public AudioDecoderExt {
  */
 class ADPCMEncoder : public AudioEncoderExt {
  public:
-  ADPCMEncoder(AVCodecID id, int blockSize = ADAPCM_DEFAULT_BLOCK_SIZE) {
+  ADPCMEncoder(AVCodecID id, int blockSize = ADAPCM_DEFAULT_BLOCK_SIZE,
+               Allocator &allocator = DefaultAllocator) {
+    pcm_block.setAllocator(allocator);
     info.sample_rate = 44100;
     info.channels = 2;
     info.bits_per_sample = 16;
@@ -3,6 +3,7 @@
 
 #include "AudioBasic/Str.h"
 #include "AudioCodecs/AudioCodecsBase.h"
+#include "AudioCodecs/Base64.h"
 
 namespace audio_tools {
 
@@ -29,7 +30,8 @@ static const int B64index[256] = {
  * @brief DecoderBase64 - Converts a Base64 encoded Stream into the original
  * data stream. Decoding only gives a valid result if we start at a limit of 4
  * bytes. We therefore use by default a newline to determine a valid start
- * boundary.
+ * boundary. The characters of each write are decoded in bulk: an incomplete
+ * group of up to 3 characters is kept for the next write.
  * @ingroup codecs
  * @ingroup decoder
  * @author Phil Schatzmann
@@ -62,6 +64,7 @@ class DecoderBase64 : public AudioDecoder {
   bool begin() override {
     TRACED();
     is_valid = newline_logic == NoCR;
+    buffer.clear();
     active = true;
     return true;
   }
@@ -69,26 +72,22 @@ class DecoderBase64 : public AudioDecoder {
   void end() override {
     TRACED();
     // deconde ramaining bytes
-    int len = buffer.available();
-    uint8_t tmp[len];
-    buffer.readArray(tmp, len);
-    decodeLine(tmp, len);
+    decodeLine(buffer.size());
 
     active = false;
-    buffer.resize(0);
+    buffer.clear();
+    if (!is_reuse_memory) {
+      buffer.reset();
+      result.reset();
+    }
   }
 
   size_t write(const uint8_t *data, size_t len) override {
     if (p_print == nullptr) return 0;
     TRACED();
     addToBuffer((uint8_t *)data, len);
-    int decode_size = 4;  // maybe we should increase this ?
-    while (buffer.available() >= decode_size) {
-      uint8_t tmp[decode_size];
-      buffer.readArray(tmp, decode_size);
-      decodeLine(tmp, decode_size);
-    }
-
+    // decode all complete groups and keep the rest for the next write
+    decodeLine(buffer.size() / 4 * 4);
     return len;
   }
 
@@ -98,44 +97,25 @@ class DecoderBase64 : public AudioDecoder {
   bool active = false;
   bool is_valid = false;
   Base46Logic newline_logic = CRforFrame;
-  Vector<uint8_t> result;
-  RingBuffer<uint8_t> buffer{1500};
+  Vector<uint8_t> result{0};
+  Vector<char> buffer{0};
   AudioInfo info;
 
-  void decodeLine(uint8_t *data, size_t byteCount) {
+  /// Decodes the indicated number of characters from the start of the buffer
+  void decodeLine(size_t byteCount) {
     LOGD("decode: %d", (int)byteCount);
-    int len = byteCount;
-
-    unsigned char *p = (unsigned char *)data;
-    int pad = len > 0 && (len % 4 || p[len - 1] == '=');
-    const size_t L = ((len + 3) / 4 - pad) * 4;
-    result.resize(L / 4 * 3 + pad);
-    memset(result.data(), 0, result.size());
-
-    for (size_t i = 0, j = 0; i < L; i += 4) {
-      int32_t n = static_cast<int32_t>(B64index[p[i]]) << 18 | B64index[p[i + 1]] << 12 |
-              B64index[p[i + 2]] << 6 | B64index[p[i + 3]];
-      result[j++] = n >> 16;
-      result[j++] = n >> 8 & 0xFF;
-      result[j++] = n & 0xFF;
-    }
-    if (pad) {
-      int32_t n = static_cast<int32_t>(B64index[p[L]]) << 18 | B64index[p[L + 1]] << 12;
-      result[result.size() - 1] = n >> 16;
-
-      if (len > L + 2 && p[L + 2] != '=') {
-        n |= B64index[p[L + 2]] << 6;
-        result.push_back(n >> 8 & 0xFF);
-      }
-    }
-    writeBlocking(p_print, result.data(), result.size());
+    if (byteCount == 0) return;
+    result.resize(Base64::decodedLength(byteCount));
+    size_t len = Base64::decode(buffer.data(), byteCount, result.data());
+    writeBlocking(p_print, result.data(), len);
+    // move the incomplete group to the start
+    size_t rest = buffer.size() - byteCount;
+    memmove(buffer.data(), buffer.data() + byteCount, rest);
+    buffer.resize(rest);
   }
 
   void addToBuffer(uint8_t *data, size_t len) {
     TRACED();
-    if (buffer.size() < len) {
-      buffer.resize(len);
-    }
     // syncronize to find a valid start position
     int start = 0;
     if (!is_valid) {
@@ -149,21 +129,25 @@ class DecoderBase64 : public AudioDecoder {
     }
 
     if (is_valid) {
-      // remove white space
+      // remove white space and control characters
+      size_t pos = buffer.size();
+      buffer.resize(pos + len - start);
+      char *p = buffer.data();
       for (int j = start; j < len; j++) {
-        if (!isspace(data[j])) {
-          buffer.write(data[j]);
+        if (data[j] > ' ') {
+          p[pos++] = data[j];
         } else if (data[j] == '\n') {
-          int offset = buffer.available() % 4;
+          int offset = pos % 4;
           if (offset > 0) {
-            LOGW("Resync %d (-%d)...", buffer.available(), offset);
-            uint8_t tmp[4];
-            buffer.readArray(tmp, offset);
+            LOGW("Resync %d (-%d)...", (int)pos, offset);
+            // drop the incomplete group
+            pos -= offset;
           }
         }
       }
+      buffer.resize(pos);
     }
-    LOGD("buffer: %d, is_valid: %s", buffer.available(),
+    LOGD("buffer: %d, is_valid: %s", (int)buffer.size(),
          is_valid ? "true" : "false");
   }
 };
@@ -173,7 +157,10 @@ class DecoderBase64 : public AudioDecoder {
  * @brief EncoderBase64s - Encodes the input data into a Base64 string.
  * By default each audio frame is followed by a new line, so that we can
  * easily resynchronize the reading of a data stream. The generation
- * of the new line can be configured with the setNewLine() method.
+ * of the new line can be configured with the setNewLine() method. The data
+ * of each write is encoded in bulk: with NoCR an incomplete group of up to 2
+ * bytes is kept for the next write, so that we generate one continuous Base64
+ * string which is padded only in end().
  * @ingroup codecs
  * @ingroup encoder
  * @author Phil Schatzmann
@@ -201,6 +188,7 @@ class EncoderBase64 : public AudioEncoder {
   /// starts the processing using the actual RAWAudioInfo
   virtual bool begin() override {
     is_open = true;
+    carry_len = 0;
     frame_size = info.bits_per_sample * info.channels / 8;
     if (newline_logic != NoCR) {
       if (frame_size==0){
@@ -214,8 +202,14 @@ class EncoderBase64 : public AudioEncoder {
     return true;
   }
 
-  /// stops the processing
-  void end() override { is_open = false; }
+  /// stops the processing: encodes the remaining bytes with padding
+  void end() override {
+    if (is_open && carry_len > 0) {
+      encodeLine(carry, carry_len);
+      carry_len = 0;
+    }
+    is_open = false;
+  }
 
   /// Writes PCM data to be encoded as RAW
   virtual size_t write(const uint8_t *data, size_t len) override {
@@ -223,21 +217,14 @@ class EncoderBase64 : public AudioEncoder {
 
     switch (newline_logic) {
       case NoCR:
+        encodeContinuous(data, len);
+        break;
       case CRforWrite:
         encodeLine(data, len);
         break;
-      case CRforFrame: {
-        int frames = len / frame_size;
-        int open = len;
-        int offset = 0;
-        while (open > 0) {
-          int write_size = min(frame_size, open);
-          encodeLine(data + offset, write_size);
-          open -= write_size;
-          offset += write_size;
-        }
+      case CRforFrame:
+        encodeFrames(data, len);
         break;
-      }
     }
 
     return len;
@@ -254,6 +241,8 @@ class EncoderBase64 : public AudioEncoder {
   Vector<uint8_t> ret;
   AudioInfo info;
   int frame_size;
+  uint8_t carry[3];
+  int carry_len = 0;
 
   void flush() {
 #if defined(ESP32) 
@@ -265,28 +254,14 @@ class EncoderBase64 : public AudioEncoder {
 #endif
   }
 
+  /// Encodes the data as one line
   void encodeLine(const uint8_t *data, size_t input_length) {
     LOGD("EncoderBase64::encodeLine: %d", (int)input_length);
-    int output_length = 4 * ((input_length + 2) / 3);
+    int output_length = Base64::encodedLength(input_length);
     if (ret.size() < output_length + 1) {
       ret.resize(output_length + 1);
     }
-
-    for (int i = 0, j = 0; i < input_length;) {
-      uint32_t octet_a = i < input_length ? (unsigned char)data[i++] : 0;
-      uint32_t octet_b = i < input_length ? (unsigned char)data[i++] : 0;
-      uint32_t octet_c = i < input_length ? (unsigned char)data[i++] : 0;
-
-      uint32_t triple = (octet_a << 0x10) + (octet_b << 0x08) + octet_c;
-
-      ret[j++] = encoding_table[(triple >> 3 * 6) & 0x3F];
-      ret[j++] = encoding_table[(triple >> 2 * 6) & 0x3F];
-      ret[j++] = encoding_table[(triple >> 1 * 6) & 0x3F];
-      ret[j++] = encoding_table[(triple >> 0 * 6) & 0x3F];
-    }
-
-    for (int i = 0; i < mod_table[input_length % 3]; i++)
-      ret[output_length - 1 - i] = '=';
+    Base64::encode(data, input_length, (char *)ret.data());
 
     // add a new line to the end
     if (newline_logic != NoCR) {
@@ -297,6 +272,51 @@ class EncoderBase64 : public AudioEncoder {
     writeBlocking(p_print, ret.data(), output_length);
     flush();
   }
+
+  /// Encodes each frame as a separate line and writes all lines at once
+  void encodeFrames(const uint8_t *data, size_t len) {
+    int line_length = Base64::encodedLength(frame_size) + 1;
+    int lines = (len + frame_size - 1) / frame_size;
+    if (ret.size() < lines * line_length) {
+      ret.resize(lines * line_length);
+    }
+    char *out = (char *)ret.data();
+    for (size_t pos = 0; pos < len; pos += frame_size) {
+      size_t n = min((size_t)frame_size, len - pos);
+      out += Base64::encode(data + pos, n, out);
+      *out++ = '\n';
+    }
+    writeBlocking(p_print, ret.data(), out - (char *)ret.data());
+    flush();
+  }
+
+  /// Encodes the complete groups w/o padding and keeps the rest
+  void encodeContinuous(const uint8_t *data, size_t len) {
+    // complete the group of the last write
+    while (carry_len > 0 && carry_len < 3 && len > 0) {
+      carry[carry_len++] = *data++;
+      len--;
+    }
+    int groups = len / 3;
+    int carry_groups = carry_len == 3 ? 1 : 0;
+    int output_length = (groups + carry_groups) * 4;
+    if (ret.size() < output_length) {
+      ret.resize(output_length);
+    }
+    char *out = (char *)ret.data();
+    if (carry_groups > 0) {
+      Base64::encodeGroups(carry, 1, out);
+      carry_len = 0;
+    }
+    Base64::encodeGroups(data, groups, out + carry_groups * 4);
+    // keep the incomplete group
+    for (size_t j = groups * 3; j < len; j++) carry[carry_len++] = data[j];
+
+    if (output_length > 0) {
+      writeBlocking(p_print, ret.data(), output_length);
+      flush();
+    }
+  }
 };
 
 }  // namespace audio_tools
@@ -98,8 +98,10 @@ class Codec2Decoder : public AudioDecoder {
       return false;
     }
 
-    result_buffer.resize(bytesCompressed());
-    input_buffer.resize(bytesCompressed() );
+    result_buffer.resize(bytesUncompressed());
+    input_buffer.resize(bytesCompressed());
+    conceal_buffer.resize(bytesUncompressed());
+    conceal_count = 0;
 
     assert(input_buffer.size()>0);
     assert(result_buffer.size()>0);
@@ -147,14 +149,42 @@ class Codec2Decoder : public AudioDecoder {
     return len;
   }
 
+  /// Packet loss concealment for the indicated number of lost encoded bytes
+  /// (e.g. reported by the transport): we drop the incomplete frame and
+  /// output the lost frames
+  void concealBytes(int bytes) {
+    if (!is_active) return;
+    input_pos = 0;
+    conceal((bytes + bytesCompressed() - 1) / bytesCompressed());
+  }
+
+  /// Outputs the indicated number of frames for lost data: we repeat the
+  /// last decoded frame with a fade out, so that short losses are bridged
+  /// and longer losses become silent.
+  void conceal(int frames) {
+    if (!is_active) return;
+    int16_t *last = (int16_t *)result_buffer.data();
+    int16_t *out = (int16_t *)conceal_buffer.data();
+    int samples = conceal_buffer.size() / sizeof(int16_t);
+    for (int f = 0; f < frames; f++) {
+      conceal_count++;
+      // halve the volume with each concealed frame
+      int shift = conceal_count < 15 ? conceal_count : 15;
+      for (int j = 0; j < samples; j++) out[j] = last[j] >> shift;
+      p_print->write(conceal_buffer.data(), conceal_buffer.size());
+    }
+  }
+
  protected:
   Print *p_print = nullptr;
   struct CODEC2 *p_codec2;
   bool is_active = false;
   Vector<uint8_t> input_buffer;
   Vector<uint8_t> result_buffer;
+  Vector<uint8_t> conceal_buffer;
   int input_pos = 0;
   int bits_per_second = 0;
+  int conceal_count = 0;
 
   /// Build decoding buffer and decode when frame is full
   void processByte(uint8_t byte) {
@@ -164,6 +194,7 @@ class Codec2Decoder : public AudioDecoder {
     // decode if buffer is full
     if (input_pos >= input_buffer.size()) {
       codec2_decode(p_codec2, (short*)result_buffer.data(), input_buffer.data());
+      conceal_count = 0;
       int written = p_print->write((uint8_t *)result_buffer.data(), result_buffer.size());
       if (written != result_buffer.size()){
         LOGE("write: %d written: %d", result_buffer.size(), written);
@@ -235,8 +266,8 @@ class Codec2Encoder : public AudioEncoder {
       return false;
     }
 
-    input_buffer.resize(bytesCompressed());
-    result_buffer.resize(bytesUncompressed());
+    input_buffer.resize(bytesUncompressed());
+    result_buffer.resize(bytesCompressed());
     assert(input_buffer.size()>0);
     assert(result_buffer.size()>0);
     LOGI("bytesCompressed:%d", bytesCompressed());
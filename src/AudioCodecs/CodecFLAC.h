@@ -73,6 +73,12 @@ class FLACDecoder : public StreamingDecoder {
     // if it is already active we close it
     auto state = FLAC__stream_decoder_get_state(decoder);
     if (state != FLAC__STREAM_DECODER_UNINITIALIZED){
+      // a kept decoder is just reset
+      if (is_reuse_memory && FLAC__stream_decoder_reset(decoder)) {
+        LOGI("FLAC is reset");
+        is_active = true;
+        return true;
+      }
       FLAC__stream_decoder_finish(decoder);
     }
 
@@ -100,8 +106,10 @@ class FLACDecoder : public StreamingDecoder {
     TRACEI();
     if (decoder != nullptr){
       flush();
-      FLAC__stream_decoder_delete(decoder);
-      decoder = nullptr;
+      if (!is_reuse_memory) {
+        FLAC__stream_decoder_delete(decoder);
+        decoder = nullptr;
+      }
     }
     is_active = false;
   }
@@ -0,0 +1,389 @@
+#pragma once
+
+#include "AudioCodecs/CodecFLAC.h"
+#include <atomic>
+#if defined(ESP32)
+#include "Concurrency/Task.h"
+#elif defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || defined(USE_STD_CONCURRENCY)
+#include <chrono>
+#include <thread>
+#else
+#error "FLACEncoderParallel requires FreeRTOS tasks (ESP32) or std::thread"
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief FLAC encoder which encodes the frames on multiple cores: the PCM
+ * data is split into jobs of blocksPerJob() frames which are encoded on a
+ * pool of workers (FreeRTOS tasks on the ESP32, std::thread on the desktop).
+ * Each worker uses its own libflac encoder. The output is written in the
+ * original order from the caller's context and the frame numbers (and
+ * CRCs) of the frame headers are updated, so that we get one valid FLAC
+ * stream.
+ *
+ * The STREAMINFO does not contain the MD5 signature, the total number of
+ * samples and the min/max frame sizes (which is valid for streams). Ogg is
+ * not supported.
+ * @ingroup codecs
+ * @ingroup encoder
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FLACEncoderParallel : public AudioEncoder {
+ public:
+  FLACEncoderParallel(int workers = 2) { setWorkers(workers); }
+
+  ~FLACEncoderParallel() { end(); }
+
+  /// Defines the number of workers: call before begin()
+  void setWorkers(int count) { worker_count = count; }
+
+  int workers() { return worker_count; }
+
+  void setBlockSize(int size) { flac_block_size = size; }
+
+  int blockSize() { return flac_block_size; }
+
+  /// Number of FLAC frames which are encoded in one job
+  void setBlocksPerJob(int blocks) { blocks_per_job = blocks; }
+
+  int blocksPerJob() { return blocks_per_job; }
+
+  void setCompressionLevel(int level) { flac_compression_level = level; }
+
+  int compressionLevel() { return flac_compression_level; }
+
+#if defined(ESP32)
+  /// Defines the stack size, priority and core of the worker tasks: core -1
+  /// distributes the workers over the cores
+  void setWorkerTask(int stackSize, int priority = 1, int core = -1) {
+    stack_size = stackSize;
+    task_priority = priority;
+    task_core = core;
+  }
+#endif
+
+  /// Defines the output Stream
+  void setOutput(Print &out_stream) override { p_print = &out_stream; }
+
+  const char *mime() override { return "audio/flac"; }
+
+  void setAudioInfo(AudioInfo from) override { cfg = from; }
+
+  bool begin() override {
+    TRACED();
+    end();
+    if (cfg.bits_per_sample != 16 && cfg.bits_per_sample != 24 &&
+        cfg.bits_per_sample != 32) {
+      LOGE("bits_per_sample not supported: %d", (int)cfg.bits_per_sample);
+      return false;
+    }
+    if (worker_count <= 0 || blocks_per_job <= 0) return false;
+    job_samples = flac_block_size * blocks_per_job * cfg.channels;
+    // setup the crc table before the workers are using it
+    crc16(nullptr, 0);
+    for (int j = 0; j < worker_count; j++) {
+      Worker *worker = new Worker();
+      worker->self = this;
+      worker->id = j;
+      worker->pcm.resize(job_samples);
+      worker->p_encoder = FLAC__stream_encoder_new();
+      if (worker->p_encoder == nullptr) {
+        LOGE("FLAC__stream_encoder_new");
+        delete worker;
+        end();
+        return false;
+      }
+      worker_vector.push_back(worker);
+      startWorker(*worker);
+    }
+    job_idx = 0;
+    frame_number = 0;
+    is_open = true;
+    return true;
+  }
+
+  /// starts the processing
+  bool begin(Print &out) {
+    p_print = &out;
+    return begin();
+  }
+
+  /// Encodes the open data and stops the workers
+  void end() override {
+    TRACED();
+    if (is_open) {
+      // encode the remaining data and output all jobs in order: the oldest
+      // job is the next one after the last submitted job
+      Worker &actual = current();
+      if (actual.state == IDLE && actual.frames > 0) {
+        submit(actual);
+        job_idx = (job_idx + 1) % worker_count;
+      }
+      for (int j = 0; j < worker_count; j++) {
+        writeResult(*worker_vector[(job_idx + j) % worker_count]);
+      }
+    }
+    for (auto worker : worker_vector) {
+      stopWorker(*worker);
+      FLAC__stream_encoder_delete(worker->p_encoder);
+      delete worker;
+    }
+    worker_vector.clear();
+    is_open = false;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!is_open || p_print == nullptr) return 0;
+    int sample_size = cfg.bits_per_sample == 16 ? 2 : 4;
+    int samples = len / sample_size;
+    int pos = 0;
+    while (pos < samples) {
+      Worker &actual = current();
+      // the buffer of the worker can be reused when its last job is done
+      if (actual.state != IDLE) writeResult(actual);
+      int fill = actual.frames * cfg.channels;
+      int n = min(samples - pos, job_samples - fill);
+      if (sample_size == 2) {
+        const int16_t *data16 = (const int16_t *)data + pos;
+        for (int j = 0; j < n; j++) actual.pcm[fill + j] = data16[j];
+      } else {
+        memcpy(actual.pcm.data() + fill, (const int32_t *)data + pos, n * 4);
+      }
+      actual.frames += n / cfg.channels;
+      pos += n;
+      if (actual.frames * cfg.channels == job_samples) {
+        submit(actual);
+        job_idx = (job_idx + 1) % worker_count;
+      }
+    }
+    return len;
+  }
+
+  operator bool() override { return is_open; }
+
+  bool isOpen() { return is_open; }
+
+ protected:
+  enum State { IDLE, READY, DONE };
+  /// Worker with its own libflac encoder which encodes one job at a time
+  struct Worker {
+    FLACEncoderParallel *self = nullptr;
+    int id = 0;
+    FLAC__StreamEncoder *p_encoder = nullptr;
+    Vector<FLAC__int32> pcm{0};
+    int frames = 0;
+    bool with_header = false;
+    uint32_t first_frame = 0;
+    Vector<uint8_t> result{0};
+    std::atomic<int> state{IDLE};
+    std::atomic<bool> is_running{false};
+#if defined(ESP32)
+    Task task;
+#else
+    std::thread thread;
+#endif
+  };
+  AudioInfo cfg;
+  Print *p_print = nullptr;
+  Vector<Worker *> worker_vector;
+  int worker_count = 2;
+  int blocks_per_job = 8;
+  int job_samples = 0;
+  int job_idx = 0;
+  uint32_t frame_number = 0;
+  bool is_open = false;
+  int flac_block_size = 512;
+  int flac_compression_level = 8;
+#if defined(ESP32)
+  int stack_size = 10000;
+  int task_priority = 1;
+  int task_core = -1;
+#endif
+
+  Worker &current() { return *worker_vector[job_idx]; }
+
+  /// Starts the encoding of the collected data
+  void submit(Worker &worker) {
+    worker.with_header = frame_number == 0;
+    worker.first_frame = frame_number;
+    frame_number += (worker.frames + flac_block_size - 1) / flac_block_size;
+    worker.state = READY;
+  }
+
+  /// Writes the encoded data of the worker when it is available
+  void writeResult(Worker &worker) {
+    if (worker.state == IDLE) return;
+    while (worker.state != DONE) pause();
+    p_print->write(worker.result.data(), worker.result.size());
+    worker.result.clear();
+    worker.frames = 0;
+    worker.state = IDLE;
+  }
+
+  static void pause() {
+#if defined(ESP32)
+    delay(1);
+#else
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+#endif
+  }
+
+  void startWorker(Worker &worker) {
+    worker.is_running = true;
+#if defined(ESP32)
+    int core = task_core >= 0 ? task_core : worker.id % 2;
+    worker.task.create("flac", stack_size, task_priority, core);
+    worker.task.begin([&worker]() { process(worker); });
+#else
+    worker.thread = std::thread([&worker]() {
+      while (worker.is_running) process(worker);
+    });
+#endif
+  }
+
+  void stopWorker(Worker &worker) {
+    worker.is_running = false;
+#if defined(ESP32)
+    worker.task.remove();
+#else
+    if (worker.thread.joinable()) worker.thread.join();
+#endif
+  }
+
+  /// Encodes the job of the worker
+  static void process(Worker &worker) {
+    if (worker.state != READY) {
+      pause();
+      return;
+    }
+    worker.self->encode(worker);
+    worker.state = DONE;
+  }
+
+  void encode(Worker &worker) {
+    FLAC__StreamEncoder *p_encoder = worker.p_encoder;
+    FLAC__stream_encoder_set_channels(p_encoder, cfg.channels);
+    FLAC__stream_encoder_set_bits_per_sample(p_encoder, cfg.bits_per_sample);
+    FLAC__stream_encoder_set_sample_rate(p_encoder, cfg.sample_rate);
+    FLAC__stream_encoder_set_blocksize(p_encoder, flac_block_size);
+    FLAC__stream_encoder_set_compression_level(p_encoder,
+                                               flac_compression_level);
+    FLAC__StreamEncoderInitStatus status = FLAC__stream_encoder_init_stream(
+        p_encoder, write_callback, nullptr, nullptr, nullptr, &worker);
+    if (status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+      LOGE("ERROR: initializing encoder: %s",
+           FLAC__StreamEncoderInitStatusString[status]);
+      return;
+    }
+    if (!FLAC__stream_encoder_process_interleaved(p_encoder, worker.pcm.data(),
+                                                  worker.frames)) {
+      LOGE("FLAC__stream_encoder_process_interleaved");
+    }
+    FLAC__stream_encoder_finish(p_encoder);
+  }
+
+  static FLAC__StreamEncoderWriteStatus write_callback(
+      const FLAC__StreamEncoder *encoder, const FLAC__byte buffer[],
+      size_t bytes, uint32_t samples, uint32_t current_frame,
+      void *client_data) {
+    Worker *worker = (Worker *)client_data;
+    if (samples == 0) {
+      // stream header and metadata: only needed once
+      if (worker->with_header) append(worker->result, buffer, bytes);
+    } else {
+      appendFrame(worker->result, buffer, bytes,
+                  worker->first_frame + current_frame);
+    }
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+  }
+
+  static void append(Vector<uint8_t> &out, const uint8_t *data, size_t len) {
+    size_t size = out.size();
+    out.resize(size + len);
+    memcpy(out.data() + size, data, len);
+  }
+
+  /// Adds the frame with the indicated frame number to the output
+  static void appendFrame(Vector<uint8_t> &out, const uint8_t *frame,
+                          size_t len, uint32_t number) {
+    // length of the utf-8 coded frame number
+    int old_len = 1;
+    if (frame[4] & 0x80) {
+      while (old_len < 7 && (frame[4] << old_len) & 0x80) old_len++;
+    }
+    // optional block size and sample rate
+    int extra = 0;
+    int bs = frame[2] >> 4;
+    int sr = frame[2] & 0x0F;
+    if (bs == 6) extra += 1;
+    if (bs == 7) extra += 2;
+    if (sr == 12) extra += 1;
+    if (sr == 13 || sr == 14) extra += 2;
+    size_t header_end = 4 + old_len + extra;
+    if (len < header_end + 3) return;
+
+    // new header
+    uint8_t header[16];
+    memcpy(header, frame, 4);
+    int header_len = 4 + utf8(number, header + 4);
+    memcpy(header + header_len, frame + 4 + old_len, extra);
+    header_len += extra;
+    header[header_len] = crc8(header, header_len);
+    header_len++;
+
+    size_t start = out.size();
+    append(out, header, header_len);
+    append(out, frame + header_end + 1, len - header_end - 3);
+    uint16_t crc = crc16(out.data() + start, out.size() - start);
+    uint8_t crc_bytes[2] = {(uint8_t)(crc >> 8), (uint8_t)(crc & 0xFF)};
+    append(out, crc_bytes, 2);
+  }
+
+  /// UTF-8 like coding of the frame number: returns the number of bytes
+  static int utf8(uint32_t value, uint8_t *out) {
+    if (value < 0x80) {
+      out[0] = value;
+      return 1;
+    }
+    int len = 2;
+    while (len < 6 && value >= (1UL << (5 * len + 1))) len++;
+    for (int j = len - 1; j > 0; j--) {
+      out[j] = 0x80 | (value & 0x3F);
+      value >>= 6;
+    }
+    out[0] = (0xFF << (8 - len)) | value;
+    return len;
+  }
+
+  static uint8_t crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t j = 0; j < len; j++) {
+      crc ^= data[j];
+      for (int b = 0; b < 8; b++) crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+  }
+
+  static uint16_t crc16(const uint8_t *data, size_t len) {
+    static uint16_t table[256];
+    static bool is_table = false;
+    if (!is_table) {
+      for (int j = 0; j < 256; j++) {
+        uint16_t crc = j << 8;
+        for (int b = 0; b < 8; b++)
+          crc = crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1;
+        table[j] = crc;
+      }
+      is_table = true;
+    }
+    uint16_t crc = 0;
+    for (size_t j = 0; j < len; j++) {
+      crc = (crc << 8) ^ table[(crc >> 8) ^ data[j]];
+    }
+    return crc;
+  }
+};
+
+}  // namespace audio_tools
@@ -138,4 +138,115 @@ class EncoderFloat : public AudioEncoder {
 
 };
 
+/**
+ * @brief DecoderFloat16 - Converts a stream of float16 values (with 2 bytes)
+ * into 2 byte integers
+ * @ingroup codecs
+ * @ingroup decoder
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class DecoderFloat16 : public AudioDecoder {
+    public:
+        DecoderFloat16() = default;
+
+        DecoderFloat16(Print &out_stream){
+            p_print = &out_stream;
+        }
+
+        /// Defines the output Stream
+        void setOutput(Print &out_stream) override {
+            p_print = &out_stream;
+        }
+
+        /// Converts data from float16 to int16_t
+        virtual size_t write(const uint8_t *data, size_t len) override {
+            if (p_print==nullptr)  return 0;
+            int samples = len/sizeof(float16);
+            float_buffer.resize(samples);
+            buffer.resize(samples);
+            float16::toFloat((const float16*)data, float_buffer.data(), samples);
+            for (int j=0;j<samples;j++){
+                float value = float_buffer[j]*32767.0f;
+                if (value > 32767.0f) value = 32767.0f;
+                if (value < -32767.0f) value = -32767.0f;
+                buffer[j] = value;
+            }
+            p_print->write((uint8_t*)buffer.data(), samples*sizeof(int16_t));
+            return samples*sizeof(float16);
+        }
+
+        virtual operator bool() override {
+            return p_print!=nullptr;
+        }
+
+    protected:
+        Print *p_print=nullptr;
+        Vector<float> float_buffer;
+        Vector<int16_t> buffer;
+
+};
+
+/**
+ * @brief EncoderFloat16 - Encodes 16 bit PCM data stream to float16 values
+ * (with 2 bytes): the data has the same size but can be processed as floats.
+ * @ingroup codecs
+ * @ingroup encoder
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class EncoderFloat16 : public AudioEncoder {
+    public: 
+        EncoderFloat16() = default;
+
+        EncoderFloat16(Print &out){
+            p_print = &out;
+        }
+
+        /// Defines the output Stream
+        void setOutput(Print &out_stream) override {
+            p_print = &out_stream;
+        }
+
+        /// Provides "audio/pcm"
+        const char* mime() override{
+            return mime_pcm;
+        }
+
+        virtual bool begin() override{
+            is_open = true;
+            return true;
+        }
+
+        void end() override {
+            is_open = false;
+        }
+
+        /// Converts data from int16_t to float16
+        virtual size_t write(const uint8_t *data, size_t len) override {
+            if (p_print==nullptr)  return 0;
+            int16_t *pt16 = (int16_t*)data;
+            size_t samples = len / sizeof(int16_t);
+            float_buffer.resize(samples);
+            buffer.resize(samples);
+            for (size_t j=0;j<samples;j++){
+                float_buffer[j] = static_cast<float>(pt16[j]) / 32768.0f;
+            }
+            float16::fromFloat(float_buffer.data(), buffer.data(), samples);
+            p_print->write((uint8_t*)buffer.data(), samples*sizeof(float16));
+            return len;
+        }
+
+        operator bool() override {
+            return is_open;
+        }
+
+    protected:
+        Print* p_print=nullptr;
+        bool is_open = false;
+        Vector<float> float_buffer;
+        Vector<float16> buffer;
+
+};
+
 }
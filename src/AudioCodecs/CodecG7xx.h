@@ -1,5 +1,6 @@
 #pragma once
 #include "AudioCodecs/AudioCodecsBase.h"
+#include "AudioCodecs/G711.h"
 
 extern "C"{
   #include "g72x.h"
@@ -305,25 +306,63 @@ class G711Encoder : public G7xxEncoder {
   G711Encoder(uint8_t(*enc)(int)) : G7xxEncoder(others) {
     this->enc = enc;
     assert(this->enc!=nullptr);
+    // use the fast bulk conversion for the standard functions
+    if (enc == linear2alaw) bulk_enc = G711::encodeALaw;
+    if (enc == linear2ulaw) bulk_enc = G711::encodeULaw;
   };
+
+  bool begin() override {
+    has_odd_byte = false;
+    return G7xxEncoder::begin();
+  }
+
   size_t write(const uint8_t *data, size_t len) override {
     LOGD("write: %d", len);
     if (!is_active) {
       LOGE("inactive");
       return 0;
     }
-    // encode bytes
-    int samples = len/2;
-    int16_t *p_16 = (int16_t *)data;
-    uint8_t buffer[samples];
-    for (int j = 0; j < samples; j++) {
-	      buffer[j] = enc(p_16[j]);
+    size_t pos = 0;
+    // complete the sample from the last write
+    if (has_odd_byte && len > 0) {
+      uint8_t bytes[2] = {odd_byte, data[0]};
+      int16_t sample;
+      memcpy(&sample, bytes, 2);
+      encode(&sample, 1);
+      has_odd_byte = false;
+      pos = 1;
+    }
+    // encode the samples in chunks
+    while (len - pos >= 2) {
+      int samples = min((len - pos) / 2, (size_t)G711_CHUNK_SAMPLES);
+      int16_t pcm[G711_CHUNK_SAMPLES];
+      memcpy(pcm, data + pos, samples * 2);
+      encode(pcm, samples);
+      pos += samples * 2;
+    }
+    // keep the incomplete sample
+    if (pos < len) {
+      odd_byte = data[pos];
+      has_odd_byte = true;
     }
-    p_print->write(buffer,samples);
     return len;
   }
+
   protected:
   uint8_t(*enc)(int)=nullptr;
+  void (*bulk_enc)(const int16_t *, uint8_t *, int) = nullptr;
+  uint8_t odd_byte = 0;
+  bool has_odd_byte = false;
+
+  void encode(const int16_t *pcm, int samples) {
+    uint8_t buffer[G711_CHUNK_SAMPLES];
+    if (bulk_enc != nullptr) {
+      bulk_enc(pcm, buffer, samples);
+    } else {
+      for (int j = 0; j < samples; j++) buffer[j] = enc(pcm[j]);
+    }
+    p_print->write(buffer, samples);
+  }
 };
 
 /**
@@ -339,6 +378,9 @@ class G711Decoder : public G7xxDecoder {
   G711Decoder(int (*dec)(uint8_t a_val)) : G7xxDecoder(others) {
     this->dec = dec;
     assert(this->dec!=nullptr);
+    // use the fast table lookup for the standard functions
+    if (dec == alaw2linear) bulk_dec = G711::decodeALaw;
+    if (dec == ulaw2linear) bulk_dec = G711::decodeULaw;
   };
 
   size_t write(const uint8_t *data, size_t len) override {
@@ -347,16 +389,24 @@ class G711Decoder : public G7xxDecoder {
       LOGE("inactive");
       return 0;
     }
-    // decode bytes
-    uint8_t *p_8 = (uint8_t *)data;
-    for (int j = 0; j < len; j++) {
-	      int16_t result = dec(p_8[j]);
-        p_print->write((uint8_t*)&result,sizeof(int16_t));
+    // decode the bytes in chunks
+    int16_t pcm[G711_CHUNK_SAMPLES];
+    size_t pos = 0;
+    while (pos < len) {
+      int samples = min(len - pos, (size_t)G711_CHUNK_SAMPLES);
+      if (bulk_dec != nullptr) {
+        bulk_dec(data + pos, pcm, samples);
+      } else {
+        for (int j = 0; j < samples; j++) pcm[j] = dec(data[pos + j]);
+      }
+      p_print->write((uint8_t *)pcm, samples * sizeof(int16_t));
+      pos += samples;
     }
     return len;
   }
   protected:
   int (*dec)(uint8_t a_val)=nullptr;
+  void (*bulk_dec)(const uint8_t *, int16_t *, int) = nullptr;
 };
 
 
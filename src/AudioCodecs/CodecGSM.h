@@ -9,6 +9,7 @@
 #pragma once
 
 #include "AudioCodecs/AudioCodecsBase.h"
+#include "AudioTools/AudioKernels.h"
 #include "gsm.h"
 
 
@@ -109,11 +110,7 @@ class GSMDecoder : public AudioDecoder {
   }
 
   void fromBigEndian(Vector<uint8_t> &vector){
-    int size = vector.size() / 2;
-    int16_t *data16 = (int16_t*) vector.data();
-    for (int i=0; i<size; i++){
-      data16[i] = ntohs(data16[i]);
-    }
+    AudioKernels::networkToHost16(vector.data(), vector.size() / 2);
   }
 
 
@@ -204,11 +201,7 @@ class GSMEncoder : public AudioEncoder {
   }
 
   void toBigEndian(Vector<uint8_t> &vector){
-    int size = vector.size() / 2;
-    int16_t *data16 = (int16_t*) vector.data();
-    for (int i=0; i<size; i++){
-      data16[i] = htons(data16[i]);
-    }
+    AudioKernels::hostToNetwork16(vector.data(), vector.size() / 2);
   }
 
   void scaleValues(Vector<uint8_t> &vector) {
@@ -0,0 +1,514 @@
+#pragma once
+
+#include "AudioCodecs/AudioCodecsBase.h"
+#include <atomic>
+#if defined(ESP32)
+#include "Concurrency/Task.h"
+#define IMA_ADPCM_PARALLEL
+#elif defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || defined(USE_STD_CONCURRENCY)
+#include <chrono>
+#include <thread>
+#define IMA_ADPCM_PARALLEL
+#endif
+
+namespace audio_tools {
+
+const int16_t ima_index_table[16] {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+const int32_t ima_step_table[89] {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+/**
+ * @brief Table driven coding of IMA ADPCM blocks in the layout which is used
+ * by WAV files: each channel starts with a 4 byte header (predictor and step
+ * index) followed by groups of 4 bytes (8 samples) per channel. A block is
+ * processed in one pass over all interleaved channels and the difference and
+ * the next step index are looked up from tables which are precomputed for all
+ * step index and nibble combinations.
+ * @ingroup codecs
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class IMAADPCMBlock {
+ public:
+  /// Number of frames in a block
+  static int framesPerBlock(int blockAlign, int channels) {
+    return (blockAlign / channels - 4) * 2 + 1;
+  }
+
+  /// Decodes a complete block into interleaved samples
+  static void decode(const uint8_t *in, int16_t *out, int channels,
+                     int blockAlign) {
+    Tables &t = tables();
+    int groups = (blockAlign / channels - 4) / 4;
+    for (int ch = 0; ch < channels; ch++) {
+      const uint8_t *header = in + ch * 4;
+      int32_t predictor = (int16_t)(header[0] | header[1] << 8);
+      int index = header[2] > 88 ? 88 : header[2];
+      int16_t *o = out + ch;
+      *o = predictor;
+      o += channels;
+      const uint8_t *data = in + channels * 4 + ch * 4;
+      for (int g = 0; g < groups; g++) {
+        for (int b = 0; b < 4; b++) {
+          uint8_t byte = data[b];
+          decodeNibble(t, byte & 0x0F, predictor, index, o);
+          o += channels;
+          decodeNibble(t, byte >> 4, predictor, index, o);
+          o += channels;
+        }
+        data += channels * 4;
+      }
+    }
+  }
+
+  /// Encodes a complete block of interleaved samples. The step index is
+  /// determined from the block itself, so that each block can be encoded
+  /// independently.
+  static void encode(const int16_t *in, uint8_t *out, int channels,
+                     int blockAlign) {
+    Tables &t = tables();
+    int groups = (blockAlign / channels - 4) / 4;
+    for (int ch = 0; ch < channels; ch++) {
+      const int16_t *i = in + ch;
+      int32_t predictor = *i;
+      int index = initialIndex(i, channels, groups * 8);
+      i += channels;
+      uint8_t *header = out + ch * 4;
+      header[0] = predictor & 0xFF;
+      header[1] = (predictor >> 8) & 0xFF;
+      header[2] = index;
+      header[3] = 0;
+      uint8_t *data = out + channels * 4 + ch * 4;
+      for (int g = 0; g < groups; g++) {
+        for (int b = 0; b < 4; b++) {
+          uint8_t low = encodeNibble(t, *i, predictor, index);
+          i += channels;
+          uint8_t high = encodeNibble(t, *i, predictor, index);
+          i += channels;
+          data[b] = low | high << 4;
+        }
+        data += channels * 4;
+      }
+    }
+  }
+
+ protected:
+  struct Tables {
+    int16_t diff[89][16];
+    uint8_t next_index[89][16];
+    Tables() {
+      for (int index = 0; index < 89; index++) {
+        int32_t step = ima_step_table[index];
+        for (int nibble = 0; nibble < 16; nibble++) {
+          int32_t diff = step >> 3;
+          if (nibble & 4) diff += step;
+          if (nibble & 2) diff += step >> 1;
+          if (nibble & 1) diff += step >> 2;
+          this->diff[index][nibble] = nibble & 8 ? -diff : diff;
+          int next = index + ima_index_table[nibble];
+          next_index[index][nibble] = next < 0 ? 0 : (next > 88 ? 88 : next);
+        }
+      }
+    }
+  };
+
+  static Tables &tables() {
+    static Tables tables;
+    return tables;
+  }
+
+  static inline void decodeNibble(Tables &t, uint8_t nibble,
+                                  int32_t &predictor, int &index,
+                                  int16_t *out) {
+    predictor += t.diff[index][nibble];
+    if (predictor < -32768) predictor = -32768;
+    else if (predictor > 32767) predictor = 32767;
+    index = t.next_index[index][nibble];
+    *out = predictor;
+  }
+
+  static inline uint8_t encodeNibble(Tables &t, int32_t sample,
+                                     int32_t &predictor, int &index) {
+    int32_t diff = sample - predictor;
+    uint8_t nibble = 0;
+    if (diff < 0) {
+      nibble = 8;
+      diff = -diff;
+    }
+    int32_t step = ima_step_table[index];
+    if (diff >= step) {
+      nibble |= 4;
+      diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+      nibble |= 2;
+      diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) nibble |= 1;
+    // we use the same reconstruction as the decoder
+    predictor += t.diff[index][nibble];
+    if (predictor < -32768) predictor = -32768;
+    else if (predictor > 32767) predictor = 32767;
+    index = t.next_index[index][nibble];
+    return nibble;
+  }
+
+  /// Step index which matches the average difference of the first samples
+  static int initialIndex(const int16_t *in, int channels, int samples) {
+    int n = samples < 8 ? samples : 8;
+    int32_t sum = 0;
+    for (int j = 0; j < n; j++) {
+      int32_t diff = in[(j + 1) * channels] - in[j * channels];
+      sum += diff < 0 ? -diff : diff;
+    }
+    int32_t avg = n > 0 ? sum / n : 0;
+    int index = 0;
+    while (index < 88 && ima_step_table[index] < avg) index++;
+    return index;
+  }
+};
+
+/**
+ * @brief Table driven IMA ADPCM decoder without any external dependencies:
+ * the block size must be defined with setBlockSize() (e.g. by the
+ * WAVDecoder). Any number of channels is supported.
+ * @ingroup codecs
+ * @ingroup decoder
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class IMAADPCMDecoder : public AudioDecoderExt {
+ public:
+  IMAADPCMDecoder(int blockSize = 0) {
+    info.sample_rate = 44100;
+    info.channels = 2;
+    info.bits_per_sample = 16;
+    block_size = blockSize;
+  }
+
+  /// Defines the size of an encoded block (block align)
+  void setBlockSize(int blockSize) override { block_size = blockSize; }
+
+  int blockSize() { return block_size; }
+
+  void setOutput(Print &out_stream) override { p_print = &out_stream; }
+
+  bool begin() override {
+    TRACEI();
+    if (block_size == 0) block_size = 256 * info.channels;
+    if (block_size % (4 * info.channels) != 0) {
+      LOGE("invalid block size %d for %d channels", block_size, info.channels);
+      return false;
+    }
+    block.resize(block_size);
+    pcm.resize(IMAADPCMBlock::framesPerBlock(block_size, info.channels) *
+               info.channels);
+    block_pos = 0;
+    notifyAudioChange(info);
+    is_active = true;
+    return true;
+  }
+
+  void end() override {
+    block.resize(0);
+    pcm.resize(0);
+    is_active = false;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!is_active || p_print == nullptr) return 0;
+    size_t pos = 0;
+    while (pos < len) {
+      // decode complete blocks directly from the provided data
+      if (block_pos == 0 && len - pos >= (size_t)block_size) {
+        decodeBlock(data + pos);
+        pos += block_size;
+        continue;
+      }
+      size_t n = min(len - pos, (size_t)(block_size - block_pos));
+      memcpy(block.data() + block_pos, data + pos, n);
+      block_pos += n;
+      pos += n;
+      if (block_pos == block_size) {
+        decodeBlock(block.data());
+        block_pos = 0;
+      }
+    }
+    return len;
+  }
+
+  operator bool() override { return is_active; }
+
+ protected:
+  Print *p_print = nullptr;
+  Vector<uint8_t> block{0};
+  Vector<int16_t> pcm{0};
+  int block_size = 0;
+  int block_pos = 0;
+  bool is_active = false;
+
+  void decodeBlock(const uint8_t *data) {
+    IMAADPCMBlock::decode(data, pcm.data(), info.channels, block_size);
+    writeSamples<int16_t>(p_print, pcm.data(), pcm.size());
+  }
+};
+
+/**
+ * @brief Table driven IMA ADPCM encoder without any external dependencies.
+ * Each block is encoded independently, so the blocks which are collected
+ * in one batch can be split across multiple cores with setWorkers(): the
+ * additional workers are FreeRTOS tasks on the ESP32 and std::threads on the
+ * desktop. The caller encodes the last part of each batch itself.
+ * @ingroup codecs
+ * @ingroup encoder
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class IMAADPCMEncoder : public AudioEncoderExt {
+ public:
+  IMAADPCMEncoder(int blockSize = 0) {
+    info.sample_rate = 44100;
+    info.channels = 2;
+    info.bits_per_sample = 16;
+    block_size = blockSize;
+  }
+
+  ~IMAADPCMEncoder() { end(); }
+
+  /// Defines the size of an encoded block (block align): the default is
+  /// 256 bytes per channel
+  void setBlockSize(int blockSize) { block_size = blockSize; }
+
+  /// Provides the block size (only available after calling begin)
+  int blockSize() override { return block_size; }
+
+  /// Provides the number of frames per block (only available after begin)
+  int framesPerBlock() {
+    return IMAADPCMBlock::framesPerBlock(block_size, info.channels);
+  }
+
+  /// Number of blocks which are collected before they are encoded and
+  /// written with one write
+  void setBatchBlocks(int blocks) { batch_blocks = blocks; }
+
+  /// Defines the total number of cores which are used for the encoding: call
+  /// before begin()
+  void setWorkers(int count) { worker_count = count; }
+
+  void setOutput(Print &out_stream) override { p_print = &out_stream; }
+
+  const char *mime() override { return "audio/adpcm"; }
+
+  bool begin() override {
+    TRACEI();
+    end();
+    if (info.bits_per_sample != 16) {
+      LOGE("bits_per_sample not supported: %d", info.bits_per_sample);
+      return false;
+    }
+    if (block_size == 0) block_size = 256 * info.channels;
+    if (block_size % (4 * info.channels) != 0) {
+      LOGE("invalid block size %d for %d channels", block_size, info.channels);
+      return false;
+    }
+    if (batch_blocks <= 0) batch_blocks = 1;
+    frame_samples = framesPerBlock() * info.channels;
+    pcm.resize(frame_samples * batch_blocks);
+    encoded.resize(block_size * batch_blocks);
+    pcm_pos = 0;
+    startWorkers();
+    is_active = true;
+    return true;
+  }
+
+  /// Encodes the open data (padded with silence) and stops the workers
+  void end() override {
+    if (is_active && pcm_pos > 0) {
+      int blocks = (pcm_pos + frame_samples - 1) / frame_samples;
+      memset(pcm.data() + pcm_pos, 0,
+             (blocks * frame_samples - pcm_pos) * sizeof(int16_t));
+      encodeBatch(pcm.data(), blocks);
+      pcm_pos = 0;
+    }
+    stopWorkers();
+    is_active = false;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!is_active || p_print == nullptr) return 0;
+    const int16_t *samples = (const int16_t *)data;
+    int sample_count = len / sizeof(int16_t);
+    int batch_samples = pcm.size();
+    int pos = 0;
+    while (pos < sample_count) {
+      // encode complete batches directly from the provided data
+      if (pcm_pos == 0 && sample_count - pos >= batch_samples) {
+        encodeBatch(samples + pos, batch_blocks);
+        pos += batch_samples;
+        continue;
+      }
+      int n = min(sample_count - pos, batch_samples - pcm_pos);
+      memcpy(pcm.data() + pcm_pos, samples + pos, n * sizeof(int16_t));
+      pcm_pos += n;
+      pos += n;
+      if (pcm_pos == batch_samples) {
+        encodeBatch(pcm.data(), batch_blocks);
+        pcm_pos = 0;
+      }
+    }
+    return len;
+  }
+
+  operator bool() override { return is_active; }
+
+ protected:
+  Print *p_print = nullptr;
+  Vector<int16_t> pcm{0};
+  Vector<uint8_t> encoded{0};
+  int block_size = 0;
+  int batch_blocks = 16;
+  int frame_samples = 0;
+  int pcm_pos = 0;
+  int worker_count = 1;
+  bool is_active = false;
+
+  void encodeBlocks(const int16_t *in, uint8_t *out, int blocks) {
+    for (int j = 0; j < blocks; j++) {
+      IMAADPCMBlock::encode(in + j * frame_samples, out + j * block_size,
+                            info.channels, block_size);
+    }
+  }
+
+#ifdef IMA_ADPCM_PARALLEL
+  enum State { IDLE, READY, DONE };
+  /// Additional worker which encodes a range of blocks
+  struct Worker {
+    IMAADPCMEncoder *self = nullptr;
+    const int16_t *in = nullptr;
+    uint8_t *out = nullptr;
+    int blocks = 0;
+    std::atomic<int> state{IDLE};
+    std::atomic<bool> is_running{false};
+#if defined(ESP32)
+    Task task;
+    TaskHandle_t caller = nullptr;
+#else
+    std::thread thread;
+#endif
+  };
+  Vector<Worker *> workers;
+
+  void startWorkers() {
+    for (int j = 1; j < worker_count; j++) {
+      Worker *worker = new Worker();
+      worker->self = this;
+      worker->is_running = true;
+#if defined(ESP32)
+      worker->task.create("ima", 4096, 1, j % 2);
+      worker->task.begin([worker]() {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        process(*worker);
+      });
+#else
+      worker->thread = std::thread([worker]() {
+        while (worker->is_running) {
+          if (worker->state == READY) {
+            process(*worker);
+          } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+          }
+        }
+      });
+#endif
+      workers.push_back(worker);
+    }
+  }
+
+  void stopWorkers() {
+    for (auto worker : workers) {
+      worker->is_running = false;
+#if defined(ESP32)
+      worker->task.remove();
+#else
+      if (worker->thread.joinable()) worker->thread.join();
+#endif
+      delete worker;
+    }
+    workers.clear();
+  }
+
+  static void process(Worker &worker) {
+    if (worker.state != READY) return;
+    worker.self->encodeBlocks(worker.in, worker.out, worker.blocks);
+    worker.state = DONE;
+#if defined(ESP32)
+    xTaskNotifyGive(worker.caller);
+#endif
+  }
+
+  /// Splits the blocks across the workers and the caller and writes the
+  /// result in one write
+  void encodeBatch(const int16_t *in, int blocks) {
+    int parts = workers.size() + 1;
+    int per_part = blocks / parts;
+    int block = 0;
+    if (per_part > 0) {
+      for (auto worker : workers) {
+        worker->in = in + block * frame_samples;
+        worker->out = encoded.data() + block * block_size;
+        worker->blocks = per_part;
+#if defined(ESP32)
+        worker->caller = xTaskGetCurrentTaskHandle();
+        worker->state = READY;
+        xTaskNotifyGive(worker->task.getTaskHandle());
+#else
+        worker->state = READY;
+#endif
+        block += per_part;
+      }
+    }
+    // the caller encodes the rest
+    encodeBlocks(in + block * frame_samples, encoded.data() + block * block_size,
+                 blocks - block);
+    if (per_part > 0) {
+      for (auto worker : workers) {
+#if defined(ESP32)
+        while (worker->state != DONE) ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+#else
+        while (worker->state != DONE) std::this_thread::yield();
+#endif
+        worker->state = IDLE;
+      }
+    }
+    p_print->write(encoded.data(), blocks * block_size);
+  }
+#else
+  void startWorkers() {
+    if (worker_count > 1) LOGW("workers not supported");
+  }
+
+  void stopWorkers() {}
+
+  void encodeBatch(const int16_t *in, int blocks) {
+    encodeBlocks(in, encoded.data(), blocks);
+    p_print->write(encoded.data(), blocks * block_size);
+  }
+#endif
+};
+
+}  // namespace audio_tools
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AudioCodecs/AudioCodecsBase.h"
+#include "AudioTools/AudioKernels.h"
 namespace audio_tools {
 
 /**
@@ -47,10 +48,8 @@ public:
   virtual size_t write(const uint8_t *data, size_t len) override {
     if (p_print == nullptr)
       return 0;
-    int16_t *data16 = (int16_t *)data;
-    for (int j = 0; j < len / 2; j++) {
-      data16[j] = ntohs(data16[j]);
-    }
+    // we convert in place in the caller's buffer
+    AudioKernels::networkToHost16((void *)data, len / 2);
     return p_print->write((uint8_t *)data, len);
   }
 
@@ -103,11 +102,8 @@ public:
     if (p_print == nullptr)
       return 0;
 
-    int16_t *data16 = (int16_t *)data;
-    for (int j = 0; j < len / 2; j++) {
-      data16[j] = htons(data16[j]);
-    }
-
+    // we convert in place in the caller's buffer
+    AudioKernels::hostToNetwork16((void *)data, len / 2);
     return p_print->write((uint8_t *)data, len);
   }
 
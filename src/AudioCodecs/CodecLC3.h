@@ -11,6 +11,7 @@
 #pragma once
 
 #include "AudioCodecs/AudioCodecsBase.h"
+#include "AudioCodecs/CodecWorker.h"
 #include "lc3.h"
 
 namespace audio_tools {
@@ -23,6 +24,8 @@ namespace audio_tools {
 /**
  * @brief Decoder for LC3. Depends on
  * https://github.com/pschatzmann/arduino-liblc3
+ * Each channel has its own decoder: a frame consists of the input byte count
+ * for each channel.
  * @ingroup codecs
  * @ingroup decoder
  * @author Phil Schatzmann
@@ -66,13 +69,18 @@ class LC3Decoder : public AudioDecoder {
     }
 
     // setup memory
-    input_buffer.resize(input_byte_count);
-    output_buffer.resize(num_frames * 2);
-    lc3_decoder_memory.resize(dec_size);
-
-    // setup decoder
-    lc3_decoder = lc3_setup_decoder(dt_us, info.sample_rate, 0,
-                                    (void *)lc3_decoder_memory.data());
+    int channels = info.channels;
+    input_buffer.resize(input_byte_count * channels);
+    output_buffer.resize(num_frames * channels * bytesPerSample());
+    lc3_decoder_memory.resize(dec_size * channels);
+    lc3_decoders.resize(channels);
+
+    // setup a decoder per channel
+    for (int ch = 0; ch < channels; ch++) {
+      lc3_decoders[ch] =
+          lc3_setup_decoder(dt_us, info.sample_rate, 0,
+                            (void *)(lc3_decoder_memory.data() + ch * dec_size));
+    }
     notifyAudioChange(info);
 
     input_pos = 0;
@@ -98,9 +106,15 @@ class LC3Decoder : public AudioDecoder {
     for (int j = 0; j < len; j++) {
       input_buffer[input_pos++] = p_ptr8[j];
       if (input_pos >= input_buffer.size()) {
-        if (lc3_decode(lc3_decoder, input_buffer.data(), input_buffer.size(),
-                       pcm_format, (int16_t *)output_buffer.data(), 1) != 0) {
-          LOGE("lc3_decode");
+        int channels = info.channels;
+        for (int ch = 0; ch < channels; ch++) {
+          if (lc3_decode(lc3_decoders[ch],
+                         input_buffer.data() + ch * input_byte_count,
+                         input_byte_count, pcm_format,
+                         output_buffer.data() + ch * bytesPerSample(),
+                         channels) != 0) {
+            LOGE("lc3_decode");
+          }
         }
 
         // write all data to final output
@@ -118,10 +132,10 @@ class LC3Decoder : public AudioDecoder {
 
  protected:
   Print *p_print = nullptr;
-  lc3_decoder_t lc3_decoder = nullptr;
+  Vector<lc3_decoder_t> lc3_decoders{0};
   lc3_pcm_format pcm_format;
   Vector<uint8_t> lc3_decoder_memory;
-  Vector<uint16_t> output_buffer;
+  Vector<uint8_t> output_buffer;
   Vector<uint8_t> input_buffer;
   size_t input_pos = 0;
   int dt_us;
@@ -130,6 +144,9 @@ class LC3Decoder : public AudioDecoder {
   unsigned dec_size;
   bool active = false;
 
+  /// 24 bit samples are stored in 32 bits
+  int bytesPerSample() { return info.bits_per_sample == 16 ? 2 : 4; }
+
   bool checkValues() {
     if (p_print == nullptr) {
       LOGE("Output is not defined");
@@ -146,8 +163,9 @@ class LC3Decoder : public AudioDecoder {
       return false;
     }
 
-    if (info.channels!=1){
+    if (info.channels <= 0) {
       LOGE("channels: %d", info.channels);
+      return false;
     }
 
     if (num_frames == -1) {
@@ -178,6 +196,12 @@ class LC3Decoder : public AudioDecoder {
 /**
  * @brief Encoder for LC3 - Depends on
  * https://github.com/pschatzmann/arduino-liblc3
+ * The channels are encoded together with one encoder state per channel from
+ * the interleaved data: a frame consists of the output byte count for each
+ * channel. For a high throughput the frames can be encoded in batches which
+ * are written with one write and with setUseWorker() a batch is encoded on
+ * the second core while the next batch is collected. encodeFrames() encodes
+ * multiple frames into a buffer which is provided by the caller.
  * @ingroup codecs
  * @ingroup encoder
  * @author Phil Schatzmann
@@ -196,6 +220,7 @@ class LC3Encoder : public AudioEncoder {
 
   bool begin() {
     TRACEI();
+    end();
 
     unsigned enc_size = lc3_encoder_size(dt_us, info.sample_rate);
     num_frames = lc3_frame_samples(dt_us, info.sample_rate);
@@ -212,49 +237,111 @@ class LC3Encoder : public AudioEncoder {
     }
 
     // setup memory
-    lc3_encoder_memory.resize(enc_size);
-    input_buffer.resize(num_frames * 2);
-    output_buffer.resize(output_byte_count);
+    int channels = info.channels;
+    int buffer_count = use_worker ? 2 : 1;
+    lc3_encoder_memory.resize(enc_size * channels);
+    lc3_encoders.resize(channels);
+    for (int j = 0; j < 2; j++) {
+      input_buffer[j].resize(j < buffer_count ? frameSize() * batch_frames : 0);
+      output_buffer[j].resize(
+          j < buffer_count ? output_byte_count * channels * batch_frames : 0);
+    }
 
-    // setup encoder
-    lc3_encoder = lc3_setup_encoder(dt_us, info.sample_rate, 0,
-                                    lc3_encoder_memory.data());
+    // setup an encoder per channel
+    for (int ch = 0; ch < channels; ch++) {
+      lc3_encoders[ch] = lc3_setup_encoder(
+          dt_us, info.sample_rate, 0, lc3_encoder_memory.data() + ch * enc_size);
+    }
 
     input_pos = 0;
+    input_idx = 0;
+    if (use_worker) {
+      worker.begin(
+          [this](int idx) { encodeBatch(input_buffer[idx].data(), idx); },
+          worker_core);
+    }
     active = true;
     return true;
   }
 
   virtual void end() {
     TRACEI();
+    if (active) {
+      worker.end();
+      int frames = input_pos / frameSize();
+      if (frames > 0) {
+        int len = encodeFrames(input_buffer[input_idx].data(), frames,
+                               output_buffer[input_idx].data(),
+                               output_buffer[input_idx].size());
+        p_print->write(output_buffer[input_idx].data(), len);
+      }
+    }
+    input_pos = 0;
     active = false;
   }
 
+  /// Number of frames which are encoded and written together
+  void setBatchFrames(int frames) { batch_frames = frames > 0 ? frames : 1; }
+
+  /// Encodes the batches on the indicated core while the caller collects
+  /// the next batch: call before begin()
+  void setUseWorker(bool active, int core = 1) {
+    use_worker = active;
+    worker_core = core;
+  }
+
+  /// Size of the PCM data of one frame in bytes
+  int frameSize() { return num_frames * info.channels * bytesPerSample(); }
+
+  /// Encodes the indicated number of frames (of frameSize() bytes each) into
+  /// the provided buffer: returns the number of encoded bytes
+  int encodeFrames(const uint8_t *pcm, int frames, uint8_t *out,
+                   size_t outSize) {
+    int channels = info.channels;
+    int frame_bytes = output_byte_count * channels;
+    int result = 0;
+    for (int j = 0; j < frames && result + frame_bytes <= (int)outSize; j++) {
+      const uint8_t *frame = pcm + j * frameSize();
+      for (int ch = 0; ch < channels; ch++) {
+        if (lc3_encode(lc3_encoders[ch], pcm_format,
+                       frame + ch * bytesPerSample(), channels,
+                       output_byte_count, out + result) != 0) {
+          LOGE("lc3_encode");
+        }
+        result += output_byte_count;
+      }
+    }
+    return result;
+  }
+
   virtual const char *mime() { return "audio/lc3"; }
 
   virtual void setOutput(Print &out_stream) { p_print = &out_stream; }
 
-  operator bool() { return lc3_encoder != nullptr; }
+  operator bool() { return lc3_encoders.size() > 0; }
 
   virtual size_t write(const uint8_t *data, size_t len) {
     if (!active) return 0;
     LOGD("write %u", len);
-    uint8_t *p_ptr8 = (uint8_t *)data;
-
-    for (int j = 0; j < len; j++) {
-      input_buffer[input_pos++] = p_ptr8[j];
-      if (input_pos >= num_frames * 2) {
-        if (lc3_encode(lc3_encoder, pcm_format,
-                       (const int16_t *)input_buffer.data(), 1,
-                       output_buffer.size(), output_buffer.data()) != 0) {
-          LOGE("lc3_encode");
-        }
-
-        // write all data to final output
-        int requested = output_buffer.size();
-        int written = p_print->write(output_buffer.data(), requested);
-        if (written != requested) {
-          LOGE("Encoder Bytes requested: %d - written: %d", requested, written);
+    int batch_size = frameSize() * batch_frames;
+    size_t pos = 0;
+    while (pos < len) {
+      // encode complete batches directly from the provided data
+      if (!use_worker && input_pos == 0 && len - pos >= batch_size) {
+        encodeBatch(data + pos, 0);
+        pos += batch_size;
+        continue;
+      }
+      int n = min((int)(len - pos), batch_size - input_pos);
+      memcpy(input_buffer[input_idx].data() + input_pos, data + pos, n);
+      input_pos += n;
+      pos += n;
+      if (input_pos == batch_size) {
+        if (use_worker) {
+          worker.submit(input_idx);
+          input_idx = 1 - input_idx;
+        } else {
+          encodeBatch(input_buffer[0].data(), 0);
         }
         input_pos = 0;
       }
@@ -266,15 +353,33 @@ class LC3Encoder : public AudioEncoder {
   Print *p_print = nullptr;
   unsigned dt_us = 1000;
   uint16_t num_frames;
-  lc3_encoder_t lc3_encoder = nullptr;
+  Vector<lc3_encoder_t> lc3_encoders{0};
   lc3_pcm_format pcm_format;
   uint16_t output_byte_count = 20;
   Vector<uint8_t> lc3_encoder_memory;
-  Vector<uint8_t> output_buffer;
-  Vector<uint8_t> input_buffer;
+  Vector<uint8_t> output_buffer[2];
+  Vector<uint8_t> input_buffer[2];
   int input_pos = 0;
+  int input_idx = 0;
+  int batch_frames = 1;
+  bool use_worker = false;
+  int worker_core = 1;
+  CodecWorker worker;
   bool active = false;
 
+  /// 24 bit samples are stored in 32 bits
+  int bytesPerSample() { return info.bits_per_sample == 16 ? 2 : 4; }
+
+  /// encodes the batch and writes the result with one write
+  void encodeBatch(const uint8_t *pcm, int idx) {
+    int requested = encodeFrames(pcm, batch_frames, output_buffer[idx].data(),
+                                 output_buffer[idx].size());
+    int written = p_print->write(output_buffer[idx].data(), requested);
+    if (written != requested) {
+      LOGE("Encoder Bytes requested: %d - written: %d", requested, written);
+    }
+  }
+
   bool checkValues() {
     if (p_print == nullptr) {
       LOGE("Output is not defined");
@@ -291,8 +396,9 @@ class LC3Encoder : public AudioEncoder {
       return false;
     }
 
-    if (info.channels!=1){
+    if (info.channels <= 0) {
       LOGE("channels: %d", info.channels);
+      return false;
     }
 
     if (num_frames == -1) {
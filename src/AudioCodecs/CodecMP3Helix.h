@@ -3,6 +3,7 @@
 #include "AudioCodecs/AudioCodecsBase.h"
 #include "AudioMetaData/MetaDataFilter.h"
 #include "MP3DecoderHelix.h"
+#include "AudioCodecs/FrameAligner.h"
 
 namespace audio_tools {
 
@@ -82,16 +83,22 @@ class MP3DecoderHelix : public AudioDecoder  {
             TRACED();
             if (mp3!=nullptr) {
                 //mp3->setDelay(CODEC_DELAY_MS);   
-                mp3->begin();
+                // a kept decoder resynchronizes with the next frame
+                if (!is_reuse_memory || !(bool)*mp3) mp3->begin();
                 filter.begin();
             } 
+            if (is_frame_aligned) {
+                aligner.setFrameCallback(frameCallback, this);
+                aligner.begin();
+            }
             return true;
         }
 
         /// Releases the reserved memory
         void end(){
             TRACED();
-            if (mp3!=nullptr) mp3->end();
+            if (mp3!=nullptr && !is_reuse_memory) mp3->end();
+            if (is_frame_aligned) aligner.end();
         }
 
         MP3FrameInfo audioInfoEx(){
@@ -111,6 +118,7 @@ class MP3DecoderHelix : public AudioDecoder  {
         size_t write(const uint8_t* data, size_t len) {
             LOGD("%s: %zu", LOG_METHOD, len);
             if (mp3==nullptr) return 0;
+            if (is_frame_aligned) return aligner.write(data, len);
             return use_filter ? filter.write((uint8_t*)data, len): mp3->write((uint8_t*)data, len);
         }
 
@@ -175,10 +183,33 @@ class MP3DecoderHelix : public AudioDecoder  {
         void setMaxPCMSize(size_t len) {
             mp3->setMaxPCMSize(len);
         }
+
+        /// Groups the input into complete MP3 frames, so that libhelix is
+        /// called only once per frame: call before begin(). Data which is not
+        /// part of a frame (e.g. ID3 tags) is skipped.
+        void setFrameAligned(bool active) {
+            is_frame_aligned = active;
+        }
+
+        /// Provides the frame statistics (e.g. framesPerSecond()) if the
+        /// input is frame aligned
+        FrameAligner &frameAligner() {
+            return aligner;
+        }
+
     protected:
         libhelix::MP3DecoderHelix *mp3=nullptr;
         MetaDataFilter<libhelix::MP3DecoderHelix> filter;
         bool use_filter = false;
+        bool is_frame_aligned = false;
+        FrameAligner aligner{FrameAligner::MP3};
+
+        static void frameCallback(const uint8_t *frame, size_t len, void *ref) {
+            MP3DecoderHelix *self = (MP3DecoderHelix *)ref;
+            uint8_t *data = (uint8_t *)frame;
+            if (self->use_filter) self->filter.write(data, len);
+            else self->mp3->write(data, len);
+        }
 
 };
 
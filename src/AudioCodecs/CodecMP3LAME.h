@@ -24,6 +24,8 @@ struct AudioInfoLAME : public liblame::AudioInfo  {
 /**
  * @brief Encodes PCM data to the MP3 format and writes the result to a stream
  * This is basically just a wrapper using https://github.com/pschatzmann/arduino-liblame
+ * The encoding is done in write(): use the EncoderThreaded wrapper to encode
+ * the frames on the other core.
  * @ingroup codecs
  * @ingroup encoder
  * @author Phil Schatzmann
@@ -31,7 +31,12 @@ struct OpusSettings : public AudioInfo {
   }
   int max_buffer_size = OPUS_DEC_MAX_BUFFER_SIZE;
   int max_buffer_write_size = 512;
-
+  /// writePacket(): recover the packet before a gap from the in-band FEC data
+  /// of the next packet (the encoder needs inband_fec and packet_loss_perc)
+  bool use_fec = true;
+  /// writePacket(): max number of lost packets which are concealed (PLC): for
+  /// bigger gaps we just continue with the next packet
+  int max_conceal_packets = 5;
 };
 
 /**
@@ -101,12 +106,23 @@ struct OpusEncoderSettings : public OpusSettings {
   int prediction_disabled = -1;
   /// 0, 1
   int use_dtx = -1;
+  /// with use_dtx: the DTX frames (max 2 bytes) are not written, so the
+  /// receiver must handle the gaps (e.g. packet loss concealment)
+  bool skip_dtx_frames = false;
   /// OPUS_FRAMESIZE_2_5_MS,OPUS_FRAMESIZE_5_MS,OPUS_FRAMESIZE_10_MS,OPUS_FRAMESIZE_20_MS,OPUS_FRAMESIZE_40_MS,OPUS_FRAMESIZE_60_MS,OPUS_FRAMESIZE_80_MS,OPUS_FRAMESIZE_100_MS,OPUS_FRAMESIZE_120_MS
   int frame_sizes_ms_x2 = -1; /* x2 to avoid 2.5 ms */
 };
 
 /**
  * @brief OpusAudioDecoder: Depends on https://github.com/pschatzmann/arduino-libopus.git
+ *
+ * write() decodes each packet as it arrives. For lossy transports (e.g. UDP,
+ * ESP-NOW) use writePacket() with the sequence number of the network layer:
+ * when a gap is detected the packet before the new one is recovered with the
+ * in-band FEC data of the new packet and the older lost packets are concealed
+ * by the Opus packet loss concealment (PLC), so that we do not need any
+ * retransmits. If the jitter buffer of the network layer gives up on a packet
+ * you can call writeLoss() to conceal it immediately.
  * @author Phil Schatzmann
  * @ingroup codecs
  * @ingroup decoder
@@ -170,18 +186,24 @@ class OpusAudioDecoder : public AudioDecoder {
            opus_strerror(err), cfg.sample_rate, cfg.channels);
       return false;
     }
+    is_first_packet = true;
+    last_frame_samples = cfg.sample_rate / 50;  // 20ms
+    lost_count = 0;
+    fec_count = 0;
+    plc_count = 0;
+    late_count = 0;
     active = true;
     return true;
   }
 
   void end() override {
     TRACED();
-    if (dec) {
-      opus_decoder_destroy(dec);
-      dec = nullptr;
+    // the decoder state is stored in decbuf: opus_decoder_init() resets it
+    dec = nullptr;
+    if (!is_reuse_memory) {
+      outbuf.reset();
+      decbuf.reset();
     }
-    outbuf.resize(0);
-    decbuf.resize(0);
     active = false;
   }
 
@@ -197,14 +219,109 @@ class OpusAudioDecoder : public AudioDecoder {
     if (!active || p_print == nullptr) return 0;
     // decode data
     LOGD("OpusAudioDecoder::write: %d", (int)len);
-    int in_band_forward_error_correction = 0;
-    int frame_count = cfg.max_buffer_size / cfg.channels / sizeof(opus_int16);
-    int out_samples = opus_decode(
-        dec, (uint8_t *)data, len, (opus_int16 *)outbuf.data(),
-        frame_count, in_band_forward_error_correction);
+    decode(data, len, maxFrames(), false);
+    return len;
+  }
+
+  /// Decodes a packet with the sequence number from the network layer: lost
+  /// packets are recovered with FEC or concealed with PLC. Late or duplicate
+  /// packets are ignored.
+  size_t writePacket(uint16_t seq, const uint8_t *data, size_t len) {
+    if (!active || p_print == nullptr) return 0;
+    if (!is_first_packet) {
+      int16_t gap = seq - next_seq;
+      if (gap < 0) {
+        late_count++;
+        return len;
+      }
+      if (gap > 0) {
+        lost_count += gap;
+        if (gap <= cfg.max_conceal_packets) {
+          conceal(cfg.use_fec ? gap - 1 : gap);
+          if (cfg.use_fec) {
+            // the lost packet has the same duration as the actual one
+            int frames = opus_packet_get_nb_samples(data, len, cfg.sample_rate);
+            if (frames <= 0) frames = last_frame_samples;
+            if (decode(data, len, min(frames, maxFrames()), true) > 0) {
+              fec_count++;
+            } else {
+              conceal(1);
+            }
+          }
+        } else {
+          LOGW("opus: %d packets lost", gap);
+        }
+      }
+    }
+    is_first_packet = false;
+    next_seq = seq + 1;
+    decode(data, len, maxFrames(), false);
+    return len;
+  }
+
+  /// Conceals the indicated number of lost packets with the Opus PLC: the
+  /// packets are considered to be consumed, so they are ignored if they still
+  /// arrive
+  void writeLoss(int packets = 1) {
+    if (!active || p_print == nullptr) return;
+    conceal(packets);
+    lost_count += packets;
+    next_seq += packets;
+  }
+
+  /// Number of lost packets detected by the sequence number
+  uint32_t lostPackets() { return lost_count; }
+
+  /// Number of lost packets recovered with the in-band FEC
+  uint32_t fecPackets() { return fec_count; }
+
+  /// Number of lost packets concealed with PLC
+  uint32_t concealedPackets() { return plc_count; }
+
+  /// Number of late or duplicate packets which were ignored
+  uint32_t latePackets() { return late_count; }
+
+  operator bool() override { return active; }
+
+ protected:
+  Print *p_print = nullptr;
+  OpusSettings cfg;
+  OpusDecoder *dec;
+  bool active = false;
+  Vector<uint8_t> outbuf{0};
+  Vector<uint8_t> decbuf{0};
+  const uint32_t valid_rates[5] = {8000, 12000, 16000, 24000,  48000};
+  bool is_first_packet = true;
+  uint16_t next_seq = 0;
+  int last_frame_samples = 960;
+  uint32_t lost_count = 0;
+  uint32_t fec_count = 0;
+  uint32_t plc_count = 0;
+  uint32_t late_count = 0;
+
+  /// max number of frames which fit into the output buffer
+  int maxFrames() {
+    return cfg.max_buffer_size / cfg.channels / sizeof(opus_int16);
+  }
+
+  /// generates the audio for lost packets with the Opus PLC
+  void conceal(int packets) {
+    for (int j = 0; j < packets; j++) {
+      if (decode(nullptr, 0, min(last_frame_samples, maxFrames()), false) > 0)
+        plc_count++;
+    }
+  }
+
+  /// decodes the packet (nullptr for PLC) and writes the result: returns the
+  /// number of decoded frames
+  int decode(const uint8_t *data, size_t len, int frameCount, bool fec) {
+    int out_samples =
+        opus_decode(dec, (uint8_t *)data, len, (opus_int16 *)outbuf.data(),
+                    frameCount, fec ? 1 : 0);
     if (out_samples < 0) {
       LOGW("opus-decode: %s", opus_strerror(out_samples));
     } else if (out_samples > 0) {
+      if (data != nullptr && !fec) last_frame_samples = out_samples;
       // write data to final destination
       int out_bytes = out_samples * cfg.channels * sizeof(int16_t);
       LOGD("opus-decode: %d", out_bytes);
@@ -217,20 +334,9 @@ class OpusAudioDecoder : public AudioDecoder {
         processed += written;
       }
     }
-    return len;
+    return out_samples;
   }
 
-  operator bool() override { return active; }
-
- protected:
-  Print *p_print = nullptr;
-  OpusSettings cfg;
-  OpusDecoder *dec;
-  bool active = false;
-  Vector<uint8_t> outbuf{0};
-  Vector<uint8_t> decbuf{0};
-  const uint32_t valid_rates[5] = {8000, 12000, 16000, 24000,  48000};
-
   bool isValidRate(int rate){
     for (auto &valid : valid_rates){
       if (valid==rate) return true;
@@ -274,6 +380,9 @@ class OpusAudioEncoder : public AudioEncoder {
     int size = getFrameSizeSamples(cfg.sample_rate) * 2;
     frame.resize(size);
     assert(frame.data() != nullptr);
+    frame_pos = 0;
+    // the packet buffer is reused for all frames
+    packet.resize(cfg.max_buffer_size > 0 ? cfg.max_buffer_size : 512);
     enc = opus_encoder_create(cfg.sample_rate, cfg.channels, cfg.application, &err);
     if (err != OPUS_OK) {
       LOGE("opus_encoder_create: %s for sample_rate: %d, channels:%d",
@@ -296,8 +405,12 @@ class OpusAudioEncoder : public AudioEncoder {
 
   /// stops the processing
   void end() override {
-    // flush buffered data
-    encodeFrame();
+    // flush buffered data: the rest of the frame is silence
+    if (frame_pos > 0) {
+      memset(frame.data() + frame_pos, 0, frame.size() - frame_pos);
+      encodeFrame(frame.data());
+      frame_pos = 0;
+    }
     // release memory
     opus_encoder_destroy(enc);
     is_open = false;
@@ -308,9 +421,24 @@ class OpusAudioEncoder : public AudioEncoder {
     if (!is_open || p_print == nullptr) return 0;
     LOGD("OpusAudioEncoder::write: %d", (int)len);
 
-    // fill frame
-    for (int j = 0; j < len; j++) {
-      encodeByte(data[j]);
+    size_t pos = 0;
+    while (pos < len) {
+      // encode complete frames directly from the provided data
+      if (frame_pos == 0 && len - pos >= frame.size()) {
+        encodeFrame(data + pos);
+        pos += frame.size();
+        continue;
+      }
+      // fill frame
+      size_t n = min(len - pos, (size_t)(frame.size() - frame_pos));
+      memcpy(frame.data() + frame_pos, data + pos, n);
+      frame_pos += n;
+      pos += n;
+      // if frame is complete -> encode
+      if (frame_pos >= frame.size()) {
+        encodeFrame(frame.data());
+        frame_pos = 0;
+      }
     }
     return len;
   }
@@ -319,40 +447,46 @@ class OpusAudioEncoder : public AudioEncoder {
 
   bool isOpen() { return is_open; }
 
+  /// Number of DTX frames which were not written
+  uint32_t dtxFrames() { return dtx_frames; }
+
+  /// Changes the complexity (0-10) while encoding: e.g. to reduce the CPU
+  /// load
+  bool setComplexity(int complexity) {
+    cfg.complexity = complexity;
+    if (!is_open) return true;
+    if (opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity)) != OPUS_OK) {
+      LOGE("invalid complexity: %d", complexity);
+      return false;
+    }
+    return true;
+  }
+
  protected:
   Print *p_print = nullptr;
   OpusEncoder *enc = nullptr;
   OpusEncoderSettings cfg;
   bool is_open = false;
   Vector<uint8_t> frame{0};
+  Vector<uint8_t> packet{0};
   int frame_pos = 0;
+  uint32_t dtx_frames = 0;
 
-  void encodeByte(uint8_t data) {
-    // add byte to frame
-    frame[frame_pos++] = data;
-
-    // if frame is complete -> encode
-    if (frame_pos >= frame.size()) {
-      encodeFrame();
-      frame_pos = 0;
-    }
-  }
-
-  void encodeFrame() {
+  void encodeFrame(const uint8_t *pcm) {
     if (frame.size() > 0) {
-      // allocate temp buffer on stack
-      int packet_len = OPUS_ENC_MAX_BUFFER_SIZE > 0 ? OPUS_ENC_MAX_BUFFER_SIZE : 512;
-      uint8_t packet[packet_len];
-
       int frames = frame.size() / cfg.channels / sizeof(int16_t);
       LOGD("opus_encode - frame_size: %d", frames);
-      int len = opus_encode(enc, (opus_int16 *)frame.data(), frames,
-                            packet, packet_len);
+      int len = opus_encode(enc, (const opus_int16 *)pcm, frames,
+                            packet.data(), packet.size());
       if (len < 0) {
         LOGE("opus_encode: %s", opus_strerror(len));
+      } else if (len <= 2 && cfg.use_dtx == 1 && cfg.skip_dtx_frames) {
+        // nothing to transmit
+        LOGD("opus-encode: dtx");
+        dtx_frames++;
       } else if (len > 0) {
         LOGD("opus-encode: %d", len);
-        int eff = p_print->write(packet, len);
+        int eff = p_print->write(packet.data(), len);
         if (eff!=len){
           LOGE("encodeFrame data lost: %d->%d", len, eff);
         }
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "AudioCodecs/AudioCodecsBase.h"
+#include "AudioCodecs/CodecWorker.h"
 #include "sbc.h"
 #include "sbc/formats.h"
 
@@ -186,6 +187,12 @@ protected:
  * @brief Encoder for SBC - Depends on
  * https://github.com/pschatzmann/arduino-libsbc.
  * Inspired by sbcenc.c
+ *
+ * For a high throughput the frames can be encoded in batches: complete
+ * batches are encoded directly from the written data and the result is
+ * written with one write. With setUseWorker() the batches are encoded on the
+ * second core while the next batch is collected. encodeFrames() encodes
+ * multiple frames into a buffer which is provided by the caller.
  * @ingroup codecs
  * @ingroup encoder
  * @author Phil Schatzmann
@@ -234,24 +241,75 @@ public:
     }
   }
 
+  /// Uses joint stereo for 2 channels
+  void setJointStereo(bool active) { is_joint_stereo = active; }
+
+  /// Number of frames which are encoded and written together
+  void setBatchFrames(int frames) { batch_frames = frames > 0 ? frames : 1; }
+
+  /// Encodes the batches on the indicated core while the caller collects
+  /// the next batch: call before begin()
+  void setUseWorker(bool active, int core = 1) {
+    use_worker = active;
+    worker_core = core;
+  }
+
   /// Restarts the processing
   bool begin() {
     TRACEI();
+    end();
     is_first = true;
     is_active = setup();
     current_codesize = codeSize();
-    buffer.resize(current_codesize);
-    result_buffer.resize(frameLength());
+    int buffer_count = use_worker ? 2 : 1;
+    for (int j = 0; j < 2; j++) {
+      buffer[j].resize(j < buffer_count ? current_codesize * batch_frames : 0);
+      result_buffer[j].resize(j < buffer_count ? frameLength() * batch_frames
+                                               : 0);
+    }
+    buffer_idx = 0;
+    buffer_pos = 0;
+    if (is_active && use_worker) {
+      worker.begin([this](int idx) { encodeBatch(buffer[idx].data(), idx); },
+                   worker_core);
+    }
     return true;
   }
 
-  /// Ends the processing
+  /// Ends the processing: the complete frames of the open batch are encoded
   virtual void end() {
     TRACEI();
-    sbc_finish(&sbc);
+    if (is_active) {
+      int frames = buffer_pos / current_codesize;
+      worker.end();
+      if (frames > 0) {
+        int len = encodeFrames(buffer[buffer_idx].data(), frames,
+                               result_buffer[buffer_idx].data(),
+                               result_buffer[buffer_idx].size());
+        p_print->write(result_buffer[buffer_idx].data(), len);
+      }
+      sbc_finish(&sbc);
+    }
+    buffer_pos = 0;
     is_active = false;
   }
 
+  /// Encodes the indicated number of frames (of bytesUncompressed() each)
+  /// into the provided buffer: returns the number of encoded bytes
+  int encodeFrames(const uint8_t *pcm, int frames, uint8_t *out,
+                   size_t outSize) {
+    int result = 0;
+    for (int j = 0; j < frames; j++) {
+      ssize_t written = 0;
+      // Encodes ONE input block into ONE output block
+      sbc_encode(&sbc, pcm + j * current_codesize, current_codesize,
+                 out + result, outSize - result, &written);
+      if (written <= 0) break;
+      result += written;
+    }
+    return result;
+  }
+
   virtual const char *mime() { return "audio/sbc"; }
 
   virtual void setOutput(Print &out_stream) { p_print = &out_stream; }
@@ -269,11 +327,29 @@ public:
       return 0;
     }
 
-    // encode bytes
-    for (int j = 0; j < len; j++) {
-      processByte(data[j]);
+    int batch_size = current_codesize * batch_frames;
+    size_t pos = 0;
+    while (pos < len) {
+      // encode complete batches directly from the provided data
+      if (!use_worker && buffer_pos == 0 && len - pos >= batch_size) {
+        encodeBatch(data + pos, 0);
+        pos += batch_size;
+        continue;
+      }
+      int n = min((int)(len - pos), batch_size - buffer_pos);
+      memcpy(buffer[buffer_idx].data() + buffer_pos, data + pos, n);
+      buffer_pos += n;
+      pos += n;
+      if (buffer_pos == batch_size) {
+        if (use_worker) {
+          worker.submit(buffer_idx);
+          buffer_idx = 1 - buffer_idx;
+        } else {
+          encodeBatch(buffer[0].data(), 0);
+        }
+        buffer_pos = 0;
+      }
     }
-
     return len;
   }
 
@@ -292,8 +368,14 @@ protected:
   bool is_active = false;
   int current_codesize = 0;
   int buffer_pos = 0;
-  Vector<uint8_t> buffer{0};
-  Vector<uint8_t> result_buffer{0};
+  int buffer_idx = 0;
+  Vector<uint8_t> buffer[2];
+  Vector<uint8_t> result_buffer[2];
+  int batch_frames = 1;
+  bool use_worker = false;
+  int worker_core = 1;
+  CodecWorker worker;
+  bool is_joint_stereo = false;
   int subbands = 4;
   int blocks = 4;
   int bitpool = 32;
@@ -337,7 +419,7 @@ protected:
       sbc.mode = SBC_MODE_MONO;
       break;
     case 2:
-      sbc.mode = SBC_MODE_STEREO;
+      sbc.mode = is_joint_stereo ? SBC_MODE_JOINT_STEREO : SBC_MODE_STEREO;
       break;
     default:
       LOGE("Invalid channels: %d", info.channels);
@@ -379,21 +461,12 @@ protected:
     return true;
   }
 
-  // add byte to decoding buffer and decode if buffer is full
-  void processByte(uint8_t byte) {
-    buffer[buffer_pos++] = byte;
-    if (buffer_pos >= current_codesize) {
-      ssize_t written;
-      // Encodes ONE input block into ONE output block */
-      // ssize_t sbc_encode(sbc_t *sbc, const void *input, size_t input_len,
-      // void *output, size_t output_len, ssize_t *written);
-      sbc_encode(&sbc, &buffer[0], current_codesize, &result_buffer[0],
-                 result_buffer.size(), &written);
-      LOGD("sbc_encode: %d -> %d (buffer: %d))", current_codesize, written,
-           result_buffer.size());
-      p_print->write(&result_buffer[0], written);
-      buffer_pos = 0;
-    }
+  /// encodes the batch and writes the result with one write
+  void encodeBatch(const uint8_t *pcm, int idx) {
+    int len = encodeFrames(pcm, batch_frames, result_buffer[idx].data(),
+                           result_buffer[idx].size());
+    LOGD("sbc_encode: %d -> %d", current_codesize * batch_frames, len);
+    p_print->write(result_buffer[idx].data(), len);
   }
 };
 
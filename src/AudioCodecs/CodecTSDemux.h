@@ -38,6 +38,11 @@ struct AllocSize {
 /**
  * @brief MPEG-TS (MTS) decoder. Extracts the AAC audio data from a MPEG-TS (MTS) data stream. You can
  * define the relevant stream types via the API.
+ * In the streaming mode (see setStreamingMode()) the 188 byte TS packets are
+ * parsed in place: the packets are filtered by PID and the PES payload
+ * fragments are forwarded directly to the output w/o any reassembly, so only
+ * a partial packet needs to be buffered. The PAT and PMT sections must fit
+ * into a single packet in this mode.
  * Required dependency: https://github.com/pschatzmann/arduino-tsdemux
  * @ingroup codecs
  * @ingroup decoder
@@ -63,6 +68,21 @@ class MTSDecoder : public AudioDecoder {
     // create the pids we plan on printing
     memset(print_pids, 0, sizeof(print_pids));
 
+    // default supported stream types
+    if (stream_types.empty()){
+      addStreamType(TSD_PMT_STREAM_TYPE_PES_METADATA);
+      addStreamType(TSD_PMT_STREAM_TYPE_AUDIO_AAC);
+    }
+
+    if (is_streaming) {
+      // no demux context and write buffer needed
+      memset(pmt_pids, 0, sizeof(pmt_pids));
+      partial_len = 0;
+      buffer.resize(0);
+      return true;
+    }
+    if (buffer.size() == 0) buffer.resize(MTS_WRITE_BUFFER_SIZE);
+
     // set default values onto the context.
     if (tsd_context_init(&ctx)!=TSD_OK){
       TRACEE();
@@ -77,12 +97,6 @@ class MTSDecoder : public AudioDecoder {
       ctx.free = log_free;
     }
 
-    // default supported stream types
-    if (stream_types.empty()){
-      addStreamType(TSD_PMT_STREAM_TYPE_PES_METADATA);
-      addStreamType(TSD_PMT_STREAM_TYPE_AUDIO_AAC);
-    }
-
     // add a callback.
     // the callback is used to determine which PIDs contain the data we want
     // to demux. We also receive PES data for any PIDs that we register later
@@ -96,12 +110,13 @@ class MTSDecoder : public AudioDecoder {
 
   void end() override {
     TRACED();
-    // finally end the demux process which will flush any remaining PES data.
-    tsd_demux_end(&ctx);
-
-    // destroy context
-    tsd_context_destroy(&ctx);
+    if (is_active && !is_streaming) {
+      // finally end the demux process which will flush any remaining PES data.
+      tsd_demux_end(&ctx);
 
+      // destroy context
+      tsd_context_destroy(&ctx);
+    }
     is_active = false;
   }
 
@@ -112,6 +127,7 @@ class MTSDecoder : public AudioDecoder {
   size_t write(const uint8_t *data, size_t len) override {
     if (!is_active) return 0;
     LOGD("MTSDecoder::write: %d", (int)len);
+    if (is_streaming) return writeStreaming(data, len);
     size_t result = buffer.writeArray((uint8_t*)data, len);
     // demux
     demux(underflowLimit);
@@ -119,9 +135,19 @@ class MTSDecoder : public AudioDecoder {
   }
 
   void flush(){
-    demux(0);
+    if (!is_streaming) demux(0);
   }
 
+  /// Activates the streaming mode which parses the TS packets in place w/o
+  /// the tsdemux library: call before begin()
+  void setStreamingMode(bool active) {
+    if (is_active) end();
+    is_streaming = active;
+  }
+
+  /// Number of TS packets which have been processed in the streaming mode
+  size_t packetCount() { return packet_count; }
+
   void clearStreamTypes(){
     TRACED();
     stream_types.clear();
@@ -160,6 +186,131 @@ class MTSDecoder : public AudioDecoder {
   SingleBuffer<uint8_t> buffer{MTS_WRITE_BUFFER_SIZE};
   Vector<TSDPMTStreamType> stream_types;
   Vector<AllocSize> alloc_vector;
+  // streaming mode
+  bool is_streaming = false;
+  uint16_t pmt_pids[MTS_PRINT_PIDS_LEN] = {0};
+  uint8_t partial[188];
+  int partial_len = 0;
+  size_t packet_count = 0;
+
+  /// Processes the complete packets in place: only an incomplete packet at
+  /// the end is copied
+  size_t writeStreaming(const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    if (partial_len > 0) {
+      size_t n = min(len, (size_t)(188 - partial_len));
+      memcpy(partial + partial_len, data, n);
+      partial_len += n;
+      pos += n;
+      if (partial_len < 188) return len;
+      parsePacket(partial);
+      partial_len = 0;
+    }
+    while (pos < len) {
+      // resync
+      if (data[pos] != 0x47) {
+        pos++;
+        continue;
+      }
+      if (len - pos < 188) {
+        partial_len = len - pos;
+        memcpy(partial, data + pos, partial_len);
+        break;
+      }
+      parsePacket(data + pos);
+      pos += 188;
+    }
+    return len;
+  }
+
+  void parsePacket(const uint8_t *packet) {
+    packet_count++;
+    uint16_t pid = (packet[1] & 0x1F) << 8 | packet[2];
+    bool is_start = packet[1] & 0x40;
+    int adaptation = (packet[3] >> 4) & 0x3;
+    // no payload
+    if (!(adaptation & 0x1)) return;
+    int start = 4;
+    if (adaptation & 0x2) start += 1 + packet[4];
+    if (start >= 188) return;
+    const uint8_t *payload = packet + start;
+    int payload_len = 188 - start;
+    // filter by pid
+    if (pid == 0) {
+      if (is_start) parsePATSection(payload, payload_len);
+    } else if (containsPid(pmt_pids, pid)) {
+      if (is_start) parsePMTSection(payload, payload_len);
+    } else if (containsPid(print_pids, pid)) {
+      writePES(payload, payload_len, is_start);
+    }
+  }
+
+  static bool containsPid(uint16_t *pids, uint16_t pid) {
+    for (int j = 0; j < MTS_PRINT_PIDS_LEN; j++) {
+      if (pids[j] == pid) return true;
+    }
+    return false;
+  }
+
+  static bool addPid(uint16_t *pids, uint16_t pid) {
+    if (containsPid(pids, pid)) return true;
+    for (int j = 0; j < MTS_PRINT_PIDS_LEN; j++) {
+      if (pids[j] == 0) {
+        pids[j] = pid;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Provides the section after the pointer field: returns the section length
+  static int section(const uint8_t *&data, int len) {
+    int pointer = data[0];
+    if (1 + pointer + 3 > len) return 0;
+    data += 1 + pointer;
+    int section_len = (data[1] & 0x0F) << 8 | data[2];
+    // the section must fit into the packet
+    return 3 + section_len <= len - 1 - pointer ? section_len : 0;
+  }
+
+  void parsePATSection(const uint8_t *data, int len) {
+    int section_len = section(data, len);
+    // programs up to the crc
+    for (int j = 8; j + 4 <= section_len + 3 - 4; j += 4) {
+      uint16_t program = data[j] << 8 | data[j + 1];
+      uint16_t pid = (data[j + 2] & 0x1F) << 8 | data[j + 3];
+      if (program != 0) addPid(pmt_pids, pid);
+    }
+  }
+
+  void parsePMTSection(const uint8_t *data, int len) {
+    int section_len = section(data, len);
+    if (section_len < 13) return;
+    int end = section_len + 3 - 4;
+    int pos = 12 + ((data[10] & 0x0F) << 8 | data[11]);
+    while (pos + 5 <= end) {
+      TSDPMTStreamType type = (TSDPMTStreamType)data[pos];
+      uint16_t pid = (data[pos + 1] & 0x1F) << 8 | data[pos + 2];
+      if (isStreamTypeActive(type)) {
+        LOGD("stream type 0x%x on pid 0x%x", (int)type, pid);
+        addPid(print_pids, pid);
+      }
+      pos += 5 + ((data[pos + 3] & 0x0F) << 8 | data[pos + 4]);
+    }
+  }
+
+  /// Forwards the payload w/o the PES header to the output
+  void writePES(const uint8_t *data, int len, bool is_start) {
+    if (is_start) {
+      // packet_start_code_prefix, stream_id, length, flags, header length
+      if (len < 9 || data[0] != 0 || data[1] != 0 || data[2] != 1) return;
+      int header_len = 9 + data[8];
+      if (header_len >= len) return;
+      data += header_len;
+      len -= header_len;
+    }
+    if (p_print != nullptr) writeSamples<uint8_t>(p_print, (uint8_t *)data, len);
+  }
 
   void set_write_active(bool flag){
     //LOGD("is_write_active: %s", flag ? "true":"false");
@@ -53,7 +53,8 @@ public:
     return true;
   }
 
-  /// Releases the reserved memory
+  /// Releases the reserved memory: vorbisfile can not reset a stream, so
+  /// setReuseMemory() has no effect
   void end() override {
     LOGI("end");
     active = false;
@@ -2,272 +2,23 @@
 
 #include "AudioCodecs/AudioCodecsBase.h"
 #include "AudioCodecs/AudioFormat.h"
-
-
-#define TAG(a, b, c, d)                                                  \
-  ((static_cast<uint32_t>(a) << 24) | (static_cast<uint32_t>(b) << 16) | \
-   (static_cast<uint32_t>(c) << 8) | (d))
-#define READ_BUFFER_SIZE 512
+#include "AudioTools/AudioKernels.h"
+#include "AudioCodecs/WAVHeader.h"
 
 namespace audio_tools {
 
-/**
- * @brief Sound information which is available in the WAV header
- * @author Phil Schatzmann
- * @copyright GPLv3
- *
- */
-struct WAVAudioInfo : AudioInfo {
-  WAVAudioInfo() = default;
-  WAVAudioInfo(const AudioInfo &from) {
-    sample_rate = from.sample_rate;
-    channels = from.channels;
-    bits_per_sample = from.bits_per_sample;
-  }
-
-  AudioFormat format = AudioFormat::PCM;
-  int byte_rate = 0;
-  int block_align = 0;
-  bool is_streamed = true;
-  bool is_valid = false;
-  uint32_t data_length = 0;
-  uint32_t file_size = 0;
-  int offset = 0;
-};
-
-static const char *wav_mime = "audio/wav";
-
-/**
- * @brief Parser for Wav header data
- * for details see https://de.wikipedia.org/wiki/RIFF_WAVE
- * @author Phil Schatzmann
- * @copyright GPLv3
- *
- */
-class WAVHeader {
- public:
-  WAVHeader() = default;
-
-  /// Adds data to the 44 byte wav header data buffer and make it available for parsing
-  int write(uint8_t *data, size_t data_len) {
-    int write_len = min(data_len, 44 - len);
-    memmove(buffer, data + len, write_len);
-    len += write_len;
-    LOGI("WAVHeader::write: %u -> %d -> %d", (unsigned)data_len, write_len,
-         (int)len);
-    return write_len;
-  }
-
-  /// Call begin when header data is complete to parse the data
-  void parse() {
-    LOGI("WAVHeader::begin: %u", (unsigned)len);
-    this->data_pos = 0l;
-    memset((void *)&headerInfo, 0, sizeof(WAVAudioInfo));
-    while (!eof()) {
-      uint32_t tag, tag2, length;
-      tag = read_tag();
-      if (eof()) break;
-      length = read_int32();
-      if (!length || length >= 0x7fff0000) {
-        headerInfo.is_streamed = true;
-        length = ~0;
-      }
-      if (tag != TAG('R', 'I', 'F', 'F') || length < 4) {
-        seek(length, SEEK_CUR);
-        continue;
-      }
-      headerInfo.file_size = length;
-      tag2 = read_tag();
-      length -= 4;
-      if (tag2 != TAG('W', 'A', 'V', 'E')) {
-        seek(length, SEEK_CUR);
-        continue;
-      }
-      // RIFF chunk found, iterate through it
-      while (length >= 8) {
-        uint32_t subtag, sublength;
-        subtag = read_tag();
-        if (eof()) break;
-        sublength = read_int32();
-        length -= 8;
-        if (length < sublength) break;
-        if (subtag == TAG('f', 'm', 't', ' ')) {
-          if (sublength < 16) {
-            // Insufficient data for 'fmt '
-            break;
-          }
-          headerInfo.format = (AudioFormat)read_int16();
-          headerInfo.channels = read_int16();
-          headerInfo.sample_rate = read_int32();
-          headerInfo.byte_rate = read_int32();
-          headerInfo.block_align = read_int16();
-          headerInfo.bits_per_sample = read_int16();
-          if (headerInfo.format == (AudioFormat) 0xfffe) {
-            if (sublength < 28) {
-              // Insufficient data for waveformatex
-              break;
-            }
-            skip(8);
-            headerInfo.format = (AudioFormat)read_int32();
-            skip(sublength - 28);
-          } else {
-            skip(sublength - 16);
-          }
-          headerInfo.is_valid = true;
-        } else if (subtag == TAG('d', 'a', 't', 'a')) {
-          sound_pos = tell();
-          headerInfo.data_length = sublength;
-          if (!headerInfo.data_length || headerInfo.is_streamed) {
-            headerInfo.is_streamed = true;
-            logInfo();
-            return;
-          }
-          seek(sublength, SEEK_CUR);
-        } else {
-          skip(sublength);
-        }
-        length -= sublength;
-      }
-      if (length > 0) {
-        // Bad chunk?
-        seek(length, SEEK_CUR);
-      }
-    }
-    logInfo();
-    len = 0;
-  }
-
-  /// Returns true if the header is complete (with 44 bytes)
-  bool isDataComplete() { return len == 44; }
-
-  /// provides the info from the header
-  WAVAudioInfo &audioInfo() { return headerInfo; }
-
-  /// Sets the info in the header
-  void setAudioInfo(WAVAudioInfo info){
-    headerInfo = info;
-  }
-
-  /// Just write a wav header to the indicated output
-  void writeHeader(Print *out) {
-    SingleBuffer<uint8_t> buffer(50);
-    writeRiffHeader(buffer);
-    writeFMT(buffer);
-    writeDataHeader(buffer);
-    len = buffer.available();
-    out->write(buffer.data(), buffer.available());
-  }
-
- protected:
-  struct WAVAudioInfo headerInfo;
-  uint8_t buffer[44];
-  size_t len = 0;
-  size_t data_pos = 0;
-  size_t sound_pos = 0;
-
-  uint32_t read_tag() {
-    uint32_t tag = 0;
-    tag = (tag << 8) | getChar();
-    tag = (tag << 8) | getChar();
-    tag = (tag << 8) | getChar();
-    tag = (tag << 8) | getChar();
-    return tag;
-  }
-
-  uint32_t getChar32() { return getChar(); }
-
-  uint32_t read_int32() {
-    uint32_t value = 0;
-    value |= getChar32() << 0;
-    value |= getChar32() << 8;
-    value |= getChar32() << 16;
-    value |= getChar32() << 24;
-    return value;
-  }
-
-  uint16_t read_int16() {
-    uint16_t value = 0;
-    value |= getChar() << 0;
-    value |= getChar() << 8;
-    return value;
-  }
-
-  void skip(int n) {
-    int i;
-    for (i = 0; i < n; i++) getChar();
-  }
-
-  int getChar() {
-    if (data_pos < len)
-      return buffer[data_pos++];
-    else
-      return -1;
-  }
-
-  void seek(long int offset, int origin) {
-    if (origin == SEEK_SET) {
-      data_pos = offset;
-    } else if (origin == SEEK_CUR) {
-      data_pos += offset;
-    }
-  }
-
-  size_t tell() { return data_pos; }
-
-  bool eof() { return data_pos >= len - 1; }
-
-  void logInfo() {
-    LOGI("WAVHeader sound_pos: %lu", (unsigned long)sound_pos);
-    LOGI("WAVHeader channels: %d ", headerInfo.channels);
-    LOGI("WAVHeader bits_per_sample: %d", headerInfo.bits_per_sample);
-    LOGI("WAVHeader sample_rate: %d ", (int) headerInfo.sample_rate);
-    LOGI("WAVHeader format: %d", (int)headerInfo.format);
-  }
-
-  void writeRiffHeader(BaseBuffer<uint8_t> &buffer) {
-    buffer.writeArray((uint8_t *)"RIFF", 4);
-    write32(buffer, headerInfo.file_size - 8);
-    buffer.writeArray((uint8_t *)"WAVE", 4);
-  }
-
-  void writeFMT(BaseBuffer<uint8_t> &buffer) {
-    uint16_t fmt_len = 16;
-    buffer.writeArray((uint8_t *)"fmt ", 4);
-    write32(buffer, fmt_len);
-    write16(buffer, (uint16_t)headerInfo.format);  // PCM
-    write16(buffer, headerInfo.channels);
-    write32(buffer, headerInfo.sample_rate);
-    write32(buffer, headerInfo.byte_rate);
-    write16(buffer, headerInfo.block_align);  // frame size
-    write16(buffer, headerInfo.bits_per_sample);
-  }
-
-  void write32(BaseBuffer<uint8_t> &buffer, uint64_t value) {
-    buffer.writeArray((uint8_t *)&value, 4);
-  }
-
-  void write16(BaseBuffer<uint8_t> &buffer, uint16_t value) {
-    buffer.writeArray((uint8_t *)&value, 2);
-  }
-
-  void writeDataHeader(BaseBuffer<uint8_t> &buffer) {
-    buffer.writeArray((uint8_t *)"data", 4);
-    write32(buffer, headerInfo.file_size);
-    int offset = headerInfo.offset;
-    if (offset > 0) {
-      uint8_t empty[offset];
-      memset(empty, 0, offset);
-      buffer.writeArray(empty, offset);  // resolve issue with wrong aligment
-    }
-  }
-
-};
-
 /**
  * @brief A simple WAVDecoder: We parse the header data on the first record to 
  * determine the format. If no AudioDecoderExt is specified we just write the PCM
  * data to the output that is defined by calling setOutput(). You can define a
  * ADPCM decoder to decode WAV files that contain ADPCM data.
+ *
+ * If the PCM data does not need any conversion and matches the AudioInfo of
+ * the output, we switch to the passthrough mode after the header: write()
+ * hands the data directly to the output. If you define the input with
+ * setInput() (e.g. a File) you can call copy() in the loop: in the passthrough
+ * mode the data chunk is read directly into the memory of the output if it
+ * supports this and the reading stops at the end of the data chunk.
  * @ingroup codecs
  * @ingroup decoder
  * @author Phil Schatzmann
@@ -296,13 +47,37 @@ class WAVDecoder : public AudioDecoder {
   }
 
   /// Defines the output Stream
-  void setOutput(Print &out_stream) override { this->p_print = &out_stream; }
+  void setOutput(Print &out_stream) override {
+    this->p_print = &out_stream;
+    p_provider = nullptr;
+    p_target = nullptr;
+  }
+
+  /// Defines the output: we can write directly into its memory
+  void setOutput(AudioStream &out_stream) override {
+    AudioDecoder::setOutput(out_stream);
+    p_provider = out_stream.bufferProvider();
+    p_target = &out_stream;
+  }
+
+  /// Defines the output: we can write directly into its memory
+  void setOutput(AudioOutput &out_stream) override {
+    AudioDecoder::setOutput(out_stream);
+    p_provider = out_stream.bufferProvider();
+    p_target = &out_stream;
+  }
+
+  /// Defines the input which is used by copy()
+  void setInput(Stream &in) { p_input = &in; }
 
   bool begin() override {
     TRACED();
     setupEncodedAudio();
     buffer24.reset();
+    header.clear();
     isFirst = true;
+    is_passthrough = false;
+    data_written = 0;
     active = true;
     return true;
   }
@@ -310,6 +85,8 @@ class WAVDecoder : public AudioDecoder {
   void end() override {
     TRACED();
     buffer24.reset();
+    copy_buffer.reset();
+    is_passthrough = false;
     active = false;
   }
 
@@ -321,11 +98,16 @@ class WAVDecoder : public AudioDecoder {
 
   virtual size_t write(const uint8_t *data, size_t len) override {
     TRACED();
+    if (is_passthrough) {
+      data_written += len;
+      return p_print->write(data, len);
+    }
     size_t result = 0;
     if (active) {
       if (isFirst) {
         result = decodeHeader((uint8_t*) data, len);
-        if (result<len){
+        // the sound data after the header
+        if (!isFirst && isValid && result<len){
           result += write_out((uint8_t *)data+result, len-result);
         }
       } else if (isValid) {
@@ -335,6 +117,51 @@ class WAVDecoder : public AudioDecoder {
     return result;
   }
 
+  /// Reads the next block from the input which was defined with setInput()
+  /// and decodes it: returns false if there is no more data
+  bool copy() {
+    if (!active || p_input == nullptr) return false;
+    size_t len = DEFAULT_BUFFER_SIZE;
+    if (isFirst) {
+      // the header is followed by the data
+      len = 44;
+    } else if (!header.audioInfo().is_streamed &&
+               header.audioInfo().data_length > 0) {
+      // stop at the end of the data chunk
+      uint32_t data_length = header.audioInfo().data_length;
+      if (data_written >= data_length) return false;
+      len = min(len, (size_t)(data_length - data_written));
+    }
+
+    // read the PCM data directly into the memory of the output
+    if (is_passthrough && p_provider != nullptr) {
+      size_t frame_size = header.audioInfo().block_align;
+      size_t direct_len = len;
+      uint8_t *p_target_data = p_provider->writeBufferPtr(direct_len);
+      if (frame_size > 0 && direct_len >= frame_size && direct_len < len)
+        direct_len = direct_len / frame_size * frame_size;
+      if (p_target_data != nullptr && direct_len > 0) {
+        size_t read = p_input->readBytes(p_target_data, direct_len);
+        size_t result = p_provider->commitWriteBuffer(read);
+        data_written += result;
+        return read > 0;
+      }
+    }
+
+    copy_buffer.resize(len);
+    size_t read = p_input->readBytes(copy_buffer.data(), len);
+    size_t pos = 0;
+    while (pos < read) {
+      size_t result = write(copy_buffer.data() + pos, read - pos);
+      if (result == 0) break;
+      pos += result;
+    }
+    return read > 0;
+  }
+
+  /// Returns true if the data is written to the output w/o any processing
+  bool isPassthrough() { return is_passthrough; }
+
   virtual operator bool() override { return active; }
 
  protected:
@@ -342,6 +169,12 @@ class WAVDecoder : public AudioDecoder {
   bool isFirst = true;
   bool isValid = true;
   bool active = false;
+  bool is_passthrough = false;
+  uint32_t data_written = 0;
+  Stream *p_input = nullptr;
+  BufferProvider *p_provider = nullptr;
+  AudioInfoSupport *p_target = nullptr;
+  Vector<uint8_t> copy_buffer{0};
   AudioFormat decoder_format = AudioFormat::PCM;
   AudioDecoderExt *p_decoder = nullptr;
   EncodedAudioOutput dec_out;
@@ -351,10 +184,15 @@ class WAVDecoder : public AudioDecoder {
     return p_decoder==nullptr ? *p_print : dec_out;
   }
 
+  /// check if we need to convert int24 data from 3 bytes to 4 bytes
+  bool isConvert24() {
+    return header.audioInfo().bits_per_sample == 24 && sizeof(int24_t) == 4;
+  }
+
   virtual size_t write_out(const uint8_t *in_ptr, size_t in_size) {
-    // check if we need to convert int24 data from 3 bytes to 4 bytes
     size_t result = 0;
-    if (header.audioInfo().bits_per_sample == 24 && sizeof(int24_t)==4){
+    data_written += in_size;
+    if (isConvert24()){
       write_out_24(in_ptr, in_size);
       result = in_size;
     } else {
@@ -363,32 +201,45 @@ class WAVDecoder : public AudioDecoder {
     return result;
   }
 
-  // convert int24 to int32
+  // convert the packed int24 data (3 bytes) to int24_t (4 bytes) in chunks
   size_t write_out_24(const uint8_t *in_ptr, size_t in_size) {
-    // make sure we can store a frame of 24bit (3bytes)
     AudioInfo& info = header.audioInfo();
-    // in_size might be not a multiple of 3, so we use a buffer for a single frame
-    buffer24.resize(info.channels*3);
-    int result = 0;
-    int32_t frame[info.channels];
-    uint8_t val24[3]={0};
-    
-    // add all bytes to buffer
-    for (int j=0;j<in_size;j++){
-      buffer24.write(in_ptr[j]);
-      // if buffer is full convert and output
-      if (buffer24.availableForWrite()==0){
-        for (int ch=0;ch<info.channels;ch++){
-          buffer24.readArray((uint8_t*)&val24[0], 3);
-          frame[ch] = interpret24bitAsInt32(val24);
-          //LOGW("%d", frame[ch]);
-        }
-        assert(buffer24.available()==0);
-        buffer24.reset();
-        size_t written = out().write((uint8_t*)frame,sizeof(frame));
-        assert(written==sizeof(frame));
-        result += written;
+    // in_size might be not a multiple of the frame size, so we use a buffer
+    // for a single frame
+    int frame_size = info.channels * 3;
+    buffer24.resize(frame_size);
+    const size_t max_samples =
+        INT24_CHUNK_SAMPLES - INT24_CHUNK_SAMPLES % info.channels;
+    if (max_samples == 0) {
+      LOGE("too many channels: %d", info.channels);
+      return 0;
+    }
+    int32_t samples[INT24_CHUNK_SAMPLES];
+    size_t result = 0;
+    size_t pos = 0;
+
+    // complete the frame from the last write
+    if (buffer24.available() > 0) {
+      while (pos < in_size && buffer24.availableForWrite() > 0) {
+        buffer24.write(in_ptr[pos++]);
       }
+      if (buffer24.availableForWrite() > 0) return result;
+      AudioKernels::unpack24(buffer24.address(), samples, info.channels);
+      result += out().write((uint8_t *)samples, info.channels * sizeof(int32_t));
+      buffer24.reset();
+    }
+
+    // convert the complete frames
+    while (in_size - pos >= (size_t)frame_size) {
+      size_t n = min((in_size - pos) / frame_size * info.channels, max_samples);
+      AudioKernels::unpack24(in_ptr + pos, samples, n);
+      result += out().write((uint8_t *)samples, n * sizeof(int32_t));
+      pos += n * 3;
+    }
+
+    // keep the incomplete frame
+    while (pos < in_size) {
+      buffer24.write(in_ptr[pos++]);
     }
     return result;
   }
@@ -403,7 +254,6 @@ class WAVDecoder : public AudioDecoder {
   
 
   int decodeHeader(uint8_t *in_ptr, size_t in_size) {
-    int result = 0;
     // we expect at least the full header
     int written = header.write(in_ptr, in_size);
     if (!header.isDataComplete()) {
@@ -412,8 +262,6 @@ class WAVDecoder : public AudioDecoder {
     // parse header
     header.parse();
 
-    size_t len = in_size - written;
-    uint8_t *sound_ptr = (uint8_t *)in_ptr + written;
     isFirst = false;
     isValid = header.audioInfo().is_valid;
 
@@ -439,13 +287,16 @@ class WAVDecoder : public AudioDecoder {
       bi.channels = header.audioInfo().channels;
       bi.bits_per_sample = header.audioInfo().bits_per_sample;
       notifyAudioChange(bi);
-      // write prm data from first record
-      LOGI("WAVDecoder writing first sound data");
-      result = out().write(sound_ptr, len);
+
+      // forward the PCM data w/o any processing
+      is_passthrough = p_decoder == nullptr && !isConvert24() &&
+                       (p_target == nullptr || p_target->audioInfo() == bi);
+      LOGI("WAV passthrough: %s", is_passthrough ? "true" : "false");
     } else {
       LOGE("WAV format not supported: %d", (int)format);
     }
-    return result;
+    // the sound data is written by the caller
+    return written;
   }
 
   void setupEncodedAudio() {
@@ -462,6 +313,7 @@ class WAVDecoder : public AudioDecoder {
  * @brief A simple WAV file encoder. If no AudioEncoderExt is specified the WAV file contains
  * PCM data, otherwise it is encoded as ADPCM. The WAV header is written with the first writing
  * of audio data. Calling begin() is making sure that the header is written again.
+ * For long recordings into a file see WAVRecorderT.
  * @ingroup codecs
  * @ingroup encoder
  * @author Phil Schatzmann
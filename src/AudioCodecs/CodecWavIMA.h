@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AudioCodecs/AudioCodecsBase.h"
+#include "AudioCodecs/CodecIMAADPCM.h"
 
 #define WAVE_FORMAT_IMA_ADPCM 0x0011
 #define TAG(a, b, c, d) ((static_cast<uint32_t>(a) << 24) | (static_cast<uint32_t>(b) << 16) | (static_cast<uint32_t>(c) << 8) | (d))
@@ -8,23 +9,6 @@
 
 namespace audio_tools {
 
-const int16_t ima_index_table[16] {
-    -1, -1, -1, -1, 2, 4, 6, 8,
-    -1, -1, -1, -1, 2, 4, 6, 8
-};
-
-const int32_t ima_step_table[89] {
-    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
-    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
-    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
-    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
-    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
-    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
-    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
-    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
-    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
-};
-
 /**
  * @brief Sound information which is available in the WAV header - adjusted for IMA ADPCM
  * @author Phil Schatzmann
@@ -329,10 +313,6 @@ class WavIMADecoder : public AudioDecoder {
 
         bool begin() {
             TRACED();
-            ima_states[0].predictor = 0;
-            ima_states[0].step_index = 0;
-            ima_states[1].predictor = 0;
-            ima_states[1].step_index = 0;
             isFirst = true;
             active = true;
             header.clearHeader();
@@ -434,54 +414,14 @@ class WavIMADecoder : public AudioDecoder {
         int16_t *output_buffer = nullptr;
         size_t bytes_per_decoded_block = 0;
         size_t samples_per_decoded_block = 0;
-        IMAState ima_states[2];
-
-        int16_t decodeSample(uint8_t sample, int channel = 0) {
-            int step_index = ima_states[channel].step_index;
-            int32_t step = ima_step_table[step_index];
-            step_index += ima_index_table[sample];
-            if (step_index < 0) step_index = 0;
-            else if (step_index > 88) step_index = 88;
-            ima_states[channel].step_index = step_index;
-            int32_t predictor = ima_states[channel].predictor;
-            uint8_t sign = sample & 8;
-            uint8_t delta = sample & 7;
-            int32_t diff = step >> 3;
-            if (delta & 4) diff += step;
-            if (delta & 2) diff += (step >> 1);
-            if (delta & 1) diff += (step >> 2);
-            if (sign) predictor -= diff;
-            else predictor += diff;
-            if (predictor < -32768) predictor = -32768;
-            else if (predictor > 32767) predictor = 32767;
-            ima_states[channel].predictor = predictor;
-            return (int16_t)predictor;
-        }
 
         void decodeBlock(int channels) {
-            if (channels == 0 || channels > 2) return;
-            input_pos = 4;
-            int output_pos = 1;
-            ima_states[0].predictor = (int16_t)((input_buffer[1] << 8) + input_buffer[0]);
-            ima_states[0].step_index = input_buffer[2];
-            output_buffer[0] = ima_states[0].predictor;
-            if (channels == 2) {
-                ima_states[1].predictor = (int16_t)(input_buffer[5] << 8) + input_buffer[4];
-                ima_states[1].step_index = input_buffer[6];
-                output_buffer[1] = ima_states[1].predictor;
-                input_pos = 8;
-                output_pos = 2;
-            }
-            for (int i=0; i<samples_per_decoded_block-channels; i++) {
-                uint8_t sample = (i & 1) ? input_buffer[input_pos++] >> 4 : input_buffer[input_pos] & 15;
-                if (channels == 1) output_buffer[output_pos++] = decodeSample(sample);
-                else {
-                    output_buffer[output_pos] = decodeSample(sample, (i >> 3) & 1);
-                    output_pos += 2;
-                    if ((i & 15) == 7) output_pos -= 15;
-                    else if ((i & 15) == 15) output_pos--;
-                }
+            if (channels == 0) return;
+            if (IMAADPCMBlock::framesPerBlock(bytes_per_encoded_block, channels) * channels != samples_per_decoded_block) {
+                LOGE("invalid frames_per_block");
+                return;
             }
+            IMAADPCMBlock::decode(input_buffer, output_buffer, channels, bytes_per_encoded_block);
         }
 
         void processInput(const uint8_t* data, size_t size) {
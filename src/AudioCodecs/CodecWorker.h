@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include "AudioTools/AudioLogger.h"
+#if defined(ESP32)
+#include "Concurrency/Task.h"
+#define CODEC_WORKER_PARALLEL
+#elif defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || defined(USE_STD_CONCURRENCY)
+#include <chrono>
+#include <thread>
+#define CODEC_WORKER_PARALLEL
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Background worker for the encoders with a state which is carried
+ * from one frame to the next (e.g. SBC, LC3): the frames can not be split
+ * across cores, but the caller can collect the next batch while the worker
+ * encodes the previous one (double buffering). The job is called with the
+ * index of the submitted buffer. The worker is a FreeRTOS task on the ESP32
+ * and a std::thread on the desktop: on other platforms the job is executed
+ * by the caller.
+ * @ingroup codecs
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CodecWorker {
+ public:
+  ~CodecWorker() { end(); }
+
+  /// Starts the worker (on the indicated core of the ESP32)
+  bool begin(std::function<void(int)> job, int core = 1) {
+    end();
+    this->job = job;
+#ifdef CODEC_WORKER_PARALLEL
+    state = IDLE;
+    is_running = true;
+#if defined(ESP32)
+    task.create("codec", 4096, 1, core);
+    task.begin([this]() {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      process();
+    });
+#else
+    thread = std::thread([this]() {
+      while (is_running) {
+        if (state == READY) {
+          process();
+        } else {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      }
+    });
+#endif
+    is_active = true;
+#else
+    LOGW("worker not supported");
+#endif
+    return true;
+  }
+
+  /// Waits until the previous job has finished and starts the job for the
+  /// indicated buffer
+  void submit(int idx) {
+    if (!is_active) {
+      job(idx);
+      return;
+    }
+    wait();
+    index = idx;
+#if defined(ESP32)
+    caller = xTaskGetCurrentTaskHandle();
+    state = READY;
+    xTaskNotifyGive(task.getTaskHandle());
+#else
+    state = READY;
+#endif
+  }
+
+  /// Waits until the actual job has finished
+  void wait() {
+    if (!is_active) return;
+#if defined(ESP32)
+    while (state == READY) ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+#elif defined(CODEC_WORKER_PARALLEL)
+    while (state == READY) std::this_thread::yield();
+#endif
+  }
+
+  /// Finishes the open job and stops the worker
+  void end() {
+    if (!is_active) return;
+    wait();
+#ifdef CODEC_WORKER_PARALLEL
+    is_running = false;
+#if defined(ESP32)
+    task.remove();
+#else
+    if (thread.joinable()) thread.join();
+#endif
+#endif
+    is_active = false;
+  }
+
+  /// Returns true if the jobs are executed in the background
+  bool isActive() { return is_active; }
+
+ protected:
+  enum State { IDLE, READY };
+  std::function<void(int)> job;
+  std::atomic<int> state{IDLE};
+  std::atomic<bool> is_running{false};
+  int index = 0;
+  bool is_active = false;
+#if defined(ESP32)
+  Task task;
+  TaskHandle_t caller = nullptr;
+#elif defined(CODEC_WORKER_PARALLEL)
+  std::thread thread;
+#endif
+
+  void process() {
+    if (state != READY) return;
+    job(index);
+    state = IDLE;
+#if defined(ESP32)
+    xTaskNotifyGive(caller);
+#endif
+  }
+};
+
+}  // namespace audio_tools
@@ -14,52 +14,76 @@ namespace audio_tools {
 /**
  * @brief We try to keep the necessary buffer for parsing as small as possible,
  * The data() method provides the start of the actual data and with consume
- * we remove the processed data from the buffer to make space again.
+ * we remove the processed data from the buffer to make space again. The data
+ * is parsed in place: consume just moves the read position and the remaining
+ * data is only moved to the front when there is not enough space left at the
+ * end.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
 class ParseBuffer {
 public:
   size_t writeArray(uint8_t *data, size_t len) {
-    int to_write = min(availableToWrite(), (size_t)len);
-    memmove(vector.data() + available_byte_count, data, to_write);
-    available_byte_count += to_write;
+    if (read_pos > 0 && size() - write_pos < len) compact();
+    int to_write = min(size() - write_pos, (size_t)len);
+    memcpy(vector.data() + write_pos, data, to_write);
+    write_pos += to_write;
     return to_write;
   }
   void consume(int size) {
-    memmove(vector.data(), &vector[size], available_byte_count - size);
-    available_byte_count -= size;
+    read_pos += size;
+    if (read_pos >= write_pos) {
+      read_pos = 0;
+      write_pos = 0;
+    }
   }
   void resize(int size) { vector.resize(size + 4); }
 
-  uint8_t *data() { return vector.data(); }
+  uint8_t *data() { return vector.data() + read_pos; }
 
-  size_t availableToWrite() { return size() - available_byte_count; }
+  size_t availableToWrite() { return size() - available(); }
 
-  size_t available() { return available_byte_count; }
+  size_t available() { return write_pos - read_pos; }
 
   void clear() {
-    available_byte_count = 0;
+    read_pos = 0;
+    write_pos = 0;
     memset(vector.data(), 0, vector.size());
   }
 
-  bool isEmpty() { return available_byte_count == 0; }
+  bool isEmpty() { return available() == 0; }
 
   size_t size() { return vector.size(); }
 
   long indexOf(const char *str) {
-    uint8_t *ptr = (uint8_t *)memmem(vector.data(), available_byte_count, str,
-                                     strlen(str));
-    return ptr == nullptr ? -1l : ptr - vector.data();
+    uint8_t *ptr = (uint8_t *)memmem(data(), available(), str, strlen(str));
+    return ptr == nullptr ? -1l : ptr - data();
   }
 
 protected:
   Vector<uint8_t> vector{0};
-  size_t available_byte_count = 0;
+  size_t read_pos = 0;
+  size_t write_pos = 0;
+
+  /// moves the unprocessed data to the beginning of the buffer
+  void compact() {
+    size_t len = available();
+    memmove(vector.data(), data(), len);
+    read_pos = 0;
+    write_pos = len;
+  }
 };
 
 using FOURCC = char[4];
 
+/// Entry of the idx1 chunk
+struct AVIIndexEntry {
+  FOURCC ckid;
+  uint32_t dwFlags;
+  uint32_t dwChunkOffset;
+  uint32_t dwChunkLength;
+};
+
 struct AVIMainHeader {
   //  FOURCC fcc;
   //  uint32_t cb;
@@ -145,6 +169,8 @@ enum ParseState {
   ParseStrf,
   AfterStrf,
   ParseMovi,
+  AfterSubChunk,
+  ParseIdx1,
   ParseIgnore,
 };
 /***
@@ -239,6 +265,12 @@ protected:
  * minimum length must be bigger then the header size! The file structure is
  * documented at
  * https://learn.microsoft.com/en-us/windows/win32/directshow/avi-riff-file-reference
+ *
+ * The content of the movi chunks is passed on directly from the written data
+ * when possible. Each video frame is announced to the VideoAudioSync which can
+ * drop late frames w/o decoding them. If the index is activated, the file
+ * positions of the video frames are collected from the idx1 chunk, so that
+ * we can seek to a frame.
  * @ingroup codecs
  * @ingroup decoder
  * @ingroup video
@@ -271,6 +303,8 @@ public:
 
   bool begin() override {
     parse_state = ParseHeader;
+    video_frame_idx = 0;
+    is_video_frame_active = false;
     header_is_avi = false;
     is_parsing_active = true;
     current_pos = 0;
@@ -295,7 +329,20 @@ public:
 
   virtual size_t write(const uint8_t *data, size_t len) override {
     LOGD("write: %d", (int)len);
-    int result = parse_buffer.writeArray((uint8_t *)data, len);
+    size_t direct = 0;
+    // the stream data is processed in place w/o copying it to the parse buffer
+    if (is_parsing_active && parse_state == SubChunkContinue &&
+        parse_buffer.isEmpty()) {
+      direct = min(len, (size_t)open_subchunk_len);
+      writeStreamData((uint8_t *)data, direct);
+      open_subchunk_len -= direct;
+      current_pos += direct;
+      cleanupStack();
+      if (open_subchunk_len == 0) endSubChunk();
+      if (direct == len) return len;
+    }
+    int result =
+        direct + parse_buffer.writeArray((uint8_t *)data + direct, len - direct);
     if (is_parsing_active) {
       // we expect the first parse to succeed
       if (parse()) {
@@ -347,7 +394,66 @@ public:
   int videoSeconds() { return video_seconds; }
 
   /// Replace the synchronization logic with your implementation
-  void setVideoAudioSync(VideoAudioSync *yourSync) { p_synch = yourSync; }
+  void setVideoAudioSync(VideoAudioSync *yourSync) {
+    p_synch = yourSync;
+    p_synch->setAudioByteRate(audio_info.nAvgBytesPerSec);
+  }
+
+  /// Index of the next video frame
+  uint32_t videoFrame() { return video_frame_idx; }
+
+  /// Collect the positions of the video frames from the idx1 chunk which is
+  /// at the end of the file
+  void setIndexActive(bool active) { is_index_active = active; }
+
+  /// Number of video frames in the index
+  size_t indexSize() { return video_index.size(); }
+
+  /// Loads the idx1 index from a seekable file (e.g. File) as soon as the
+  /// metadata is available: the file position is restored.
+  template <class F>
+  bool loadIndex(F &file) {
+    if (movi_start_pos == 0) return false;
+    size_t pos = file.position();
+    bool result = false;
+    if (file.seek(movi_start_pos + movi_size)) {
+      uint8_t header[CHUNK_HEADER_SIZE];
+      if (file.read(header, CHUNK_HEADER_SIZE) == CHUNK_HEADER_SIZE &&
+          memcmp(header, "idx1", 4) == 0) {
+        uint32_t size = 0;
+        memcpy(&size, header + 4, 4);
+        video_index.clear();
+        index_entry_count = 0;
+        AVIIndexEntry entry;
+        for (uint32_t j = 0; j + sizeof(entry) <= size; j += sizeof(entry)) {
+          if (file.read((uint8_t *)&entry, sizeof(entry)) != sizeof(entry))
+            break;
+          addIndexEntry(entry);
+        }
+        result = true;
+      }
+    }
+    file.seek(pos);
+    return result;
+  }
+
+  /// Prepares the decoder to continue with the indicated video frame: seek
+  /// the file to the returned position and write the data from there. Returns
+  /// -1 if the frame is not in the index.
+  long seekVideoFrame(uint32_t frame) {
+    if (frame >= video_index.size()) return -1;
+    parse_buffer.clear();
+    current_pos = video_index[frame];
+    open_subchunk_len = 0;
+    // we continue in the movi list
+    object_stack.clear();
+    object_stack.push(movi_object);
+    parse_state = SubChunk;
+    is_parsing_active = true;
+    video_frame_idx = frame;
+    p_synch->reset((uint64_t)frame * main_header.dwMicroSecPerFrame);
+    return current_pos;
+  }
 
 protected:
   bool header_is_avi = false;
@@ -358,7 +464,7 @@ protected:
   int stream_header_idx = -1;
   Vector<AVIStreamHeader> stream_header;
   BitmapInfoHeader video_info;
-  WAVFormatX audio_info;
+  WAVFormatX audio_info{};
   Vector<StreamContentType> content_types;
   Stack<ParseObject> object_stack;
   ParseObject current_stream_data;
@@ -367,6 +473,17 @@ protected:
   long open_subchunk_len = 0;
   long current_pos = 0;
   long movi_end_pos = 0;
+  ParseObject movi_object;
+  long movi_start_pos = 0;
+  long movi_size = 0;
+  long idx1_open = 0;
+  long subchunk_padding = 0;
+  uint32_t video_frame_idx = 0;
+  bool is_video_frame_active = false;
+  bool is_index_active = false;
+  bool is_index_relative = true;
+  uint32_t index_entry_count = 0;
+  Vector<uint32_t> video_index;
   StrExt spaces;
   StrExt str;
   char video_format[5] = {0};
@@ -477,6 +594,10 @@ protected:
           is_parsing_active = (validation_cb(*this));
         processStack(movi);
         movi_end_pos = movi.end_pos;
+        movi_object = movi;
+        // the idx1 offsets are relative to the movi id
+        movi_start_pos = movi.start_pos + CHUNK_HEADER_SIZE;
+        movi_size = movi.data_size;
         parse_state = SubChunk;
         // trigger new write
         result = false;
@@ -491,14 +612,21 @@ protected:
         processStack(hdrl);
       }
 
+      long size = getInt(4);
       current_stream_data = parseAVIStreamData();
       parse_state = SubChunkContinue;
       open_subchunk_len = current_stream_data.open;
+      // the word alignment byte is not part of the content
+      subchunk_padding = open_subchunk_len > size ? open_subchunk_len - size : 0;
       if (current_stream_data.isVideo()) {
         LOGI("video:[%d]->[%d]", (int)current_stream_data.start_pos,
              (int)current_stream_data.end_pos);
-        if (p_output_video != nullptr)
-          p_output_video->beginFrame(current_stream_data.open);
+        is_video_frame_active =
+            p_output_video != nullptr &&
+            p_synch->beginVideoFrame(video_frame_idx,
+                                     main_header.dwMicroSecPerFrame);
+        if (is_video_frame_active)
+          p_output_video->beginFrame(open_subchunk_len - subchunk_padding);
       } else if (current_stream_data.isAudio()) {
         LOGI("audio:[%d]->[%d]", (int)current_stream_data.start_pos,
              (int)current_stream_data.end_pos);
@@ -511,21 +639,44 @@ protected:
     case SubChunkContinue: {
       writeData();
       if (open_subchunk_len == 0) {
-        if (current_stream_data.isVideo() && p_output_video != nullptr) {
-          uint32_t time_used_ms = p_output_video->endFrame();
-          p_synch->delayVideoFrame(main_header.dwMicroSecPerFrame, time_used_ms);
-        }
-        if (tryParseChunk("idx").isValid()) {
-          parse_state = ParseIgnore;
-        } else if (tryParseList("rec").isValid()) {
-          parse_state = ParseRec;
+        endSubChunk();
+      }
+    } break;
+
+    case AfterSubChunk: {
+      if (getStr(0, 4).equals("idx1")) {
+        if (is_index_active) {
+          idx1_open = getInt(4);
+          consume(CHUNK_HEADER_SIZE);
+          video_index.clear();
+          index_entry_count = 0;
+          parse_state = ParseIdx1;
         } else {
-          if (current_pos >= movi_end_pos) {
-            parse_state = ParseIgnore;
-          } else {
-            parse_state = SubChunk;
-          }
+          parse_state = ParseIgnore;
         }
+      } else if (current_pos >= movi_end_pos) {
+        parse_state = ParseIgnore;
+      } else {
+        // rec lists are handled by SubChunk
+        parse_state = SubChunk;
+      }
+    } break;
+
+    case ParseIdx1: {
+      // we need at least one complete entry
+      if (parse_buffer.available() < sizeof(AVIIndexEntry)) {
+        result = false;
+        break;
+      }
+      while (idx1_open >= (long)sizeof(AVIIndexEntry) &&
+             parse_buffer.available() >= sizeof(AVIIndexEntry)) {
+        addIndexEntry(*(AVIIndexEntry *)parse_buffer.data());
+        consume(sizeof(AVIIndexEntry));
+        idx1_open -= sizeof(AVIIndexEntry);
+      }
+      if (idx1_open < (long)sizeof(AVIIndexEntry)) {
+        LOGI("index: %d frames", (int)video_index.size());
+        parse_state = ParseIgnore;
       }
     } break;
 
@@ -542,6 +693,7 @@ protected:
   }
 
   void setupAudioInfo() {
+    p_synch->setAudioByteRate(audio_info.nAvgBytesPerSec);
     info.channels = audio_info.nChannels;
     info.bits_per_sample = audio_info.wBitsPerSample;
     info.sample_rate = audio_info.nSamplesPerSec;
@@ -567,22 +719,54 @@ protected:
 
   void writeData() {
     long to_write = min((long)parse_buffer.available(), open_subchunk_len);
-    if (current_stream_data.isAudio()) {
-      LOGD("audio %d", (int)to_write);
-      if (!is_mute){
-        p_synch->writeAudio(p_output_audio, parse_buffer.data(), to_write);
-      }
+    if (current_stream_data.isAudio() || current_stream_data.isVideo()) {
+      writeStreamData(parse_buffer.data(), to_write);
       open_subchunk_len -= to_write;
       cleanupStack();
       consume(to_write);
+    }
+  }
+
+  /// Passes the content of the current movi chunk to the audio or video output
+  void writeStreamData(uint8_t *data, size_t len) {
+    long content = open_subchunk_len - subchunk_padding;
+    if (content <= 0) return;
+    if ((long)len > content) len = content;
+    if (current_stream_data.isAudio()) {
+      LOGD("audio %d", (int)len);
+      if (!is_mute) {
+        p_synch->writeAudio(p_output_audio, data, len);
+      }
     } else if (current_stream_data.isVideo()) {
-      LOGD("video %d", (int)to_write);
-      if (p_output_video != nullptr)
-        p_output_video->write(parse_buffer.data(), to_write);
-      open_subchunk_len -= to_write;
-      cleanupStack();
-      consume(to_write);
+      LOGD("video %d", (int)len);
+      if (is_video_frame_active) p_output_video->write(data, len);
+    }
+  }
+
+  /// Completes the current movi chunk: dropped video frames are not delayed
+  void endSubChunk() {
+    if (current_stream_data.isVideo()) {
+      if (is_video_frame_active) {
+        uint32_t time_used_ms = p_output_video->endFrame();
+        p_synch->delayVideoFrame(main_header.dwMicroSecPerFrame, time_used_ms);
+        is_video_frame_active = false;
+      }
+      video_frame_idx++;
+    }
+    parse_state = AfterSubChunk;
+  }
+
+  /// Records the file position of the video chunks
+  void addIndexEntry(const AVIIndexEntry &entry) {
+    // the offsets are usually relative to the movi id: some files use the
+    // file position
+    if (index_entry_count++ == 0) {
+      is_index_relative = entry.dwChunkOffset < (uint32_t)movi_start_pos;
     }
+    if (entry.ckid[2] != 'd') return;
+    uint32_t pos = entry.dwChunkOffset;
+    if (is_index_relative) pos += movi_start_pos;
+    video_index.push_back(pos);
   }
 
   // 'RIFF' fileSize fileType (data)
@@ -685,10 +869,8 @@ protected:
   void cleanupStack() {
     ParseObject current;
     // make sure that we remove the object from the stack of we past the end
-    object_stack.peek(current);
-    while (current.end_pos <= current_pos) {
+    while (object_stack.peek(current) && current.end_pos <= current_pos) {
       object_stack.pop(current);
-      object_stack.peek(current);
     }
   }
 
@@ -118,6 +118,12 @@ class MP4ParseBuffer {
  * Quicktime format). Small atoms will be make available via a callback method.
  * The big (audio) content is written to the Print object which was specified in
  * the constructor. Depends on https://github.com/pschatzmann/arduino-libhelix!
+ *
+ * If the source supports seek() (e.g. a File or a URLStream with range
+ * requests) you can use the random access mode with begin(source): the moov
+ * atom is parsed first (also when it is at the end of the file) and copy()
+ * provides the individual access units from their offsets in mdat w/o any
+ * atom buffering. AAC access units are provided with an ADTS header.
  * @ingroup codecs
  * @ingroup decoder
  * @ingroup video
@@ -152,14 +158,85 @@ class ContainerMP4 : public ContainerDecoder {
     return rc;
   }
 
+  /// Starts the random access mode: the source must support seek(pos)
+  template <class T>
+  bool begin(T &source) {
+    p_in = &source;
+    seek_cb = [](Stream *in, size_t pos) { return ((T *)in)->seek(pos); };
+    if (!begin()) return false;
+    table = MP4SampleTable();
+    in_pos = -1;
+    if (!parseRandomAccess()) {
+      LOGE("no audio track found");
+      is_active = false;
+      return false;
+    }
+    setSample(0);
+    return true;
+  }
+
   /// ends the processing
   void end() override { 
     p_decoder->end(); 
     is_active = false;
+    p_in = nullptr;
+    table.clear();
+  }
+
+  /// Random access mode: provides the next access unit to the decoder,
+  /// returns the number of bytes read from the source (0 at the end)
+  size_t copy() {
+    if (p_in == nullptr || !is_active) return 0;
+    if (sample_idx >= table.sizes.size()) return 0;
+    int size = table.sizes[sample_idx];
+    int hdr = table.is_aac && is_adts ? 7 : 0;
+    frame.resize(size + hdr);
+    if (hdr > 0) writeADTSHeader(frame.data(), size);
+    if (readAt(sample_pos, frame.data() + hdr, size) != size) {
+      LOGE("read error at %lu", (unsigned long)sample_pos);
+      return 0;
+    }
+    int pos = 0;
+    int open = frame.size();
+    while (open > 0) {
+      int processed = decode(frame.data() + pos, open);
+      if (processed <= 0) break;
+      open -= processed;
+      pos += processed;
+    }
+    nextSample();
+    return size;
+  }
+
+  /// Random access mode: moves to the access unit at the indicated time
+  bool setPositionMs(uint32_t ms) {
+    if (table.timescale == 0 || table.sample_delta == 0) return false;
+    uint32_t idx = (uint64_t)ms * table.timescale / 1000 / table.sample_delta;
+    if (idx >= table.sizes.size()) return false;
+    setSample(idx);
+    return true;
   }
 
+  /// Random access mode: number of access units
+  size_t sampleCount() { return table.sizes.size(); }
+
+  /// Random access mode: index of the next access unit
+  size_t sampleIndex() { return sample_idx; }
+
+  /// Random access mode: AAC access units are provided with an ADTS header
+  /// (default true), so that they can be processed by any AAC decoder
+  void setADTS(bool active) { is_adts = active; }
+
   operator bool() override { return is_active; }
 
+  /// Adjusts the open mdat data after a seek within the mdat atom
+  void notifySeek(long offset) override {
+    if (stream_out_open > 0) {
+      stream_out_open -= offset;
+      current_pos += offset;
+    }
+  }
+
   /// writes the data to be parsed into atoms
   size_t write(const uint8_t *data, size_t len) override {
     TRACED();
@@ -229,11 +306,286 @@ class ContainerMP4 : public ContainerDecoder {
   const char *stream_atom;
   int current_pos = 0;
   const char *current_atom = nullptr;
+  // random access mode
+  Stream *p_in = nullptr;
+  bool (*seek_cb)(Stream *in, size_t pos) = nullptr;
+  long in_pos = -1;
+  /// Sample table of the first sound track
+  struct MP4SampleTable {
+    Vector<uint16_t> sizes{0, ColdAllocator};
+    Vector<uint32_t> offsets{0, ColdAllocator};
+    /// pairs of first chunk (1 based) and samples per chunk
+    Vector<uint32_t> stsc{0};
+    uint32_t timescale = 0;
+    uint32_t sample_delta = 0;
+    bool is_aac = false;
+    uint8_t profile = 2;
+    uint8_t rate_idx = 4;
+    uint8_t channels = 2;
+    void clear() {
+      sizes.reset();
+      offsets.reset();
+      stsc.reset();
+    }
+  } table;
+  Vector<uint8_t> frame{0};
+  bool is_adts = true;
+  bool is_sound_trak = false;
+  bool is_table_done = false;
+  size_t sample_idx = 0;
+  size_t sample_pos = 0;
+  uint32_t chunk_idx = 0;
+  uint32_t chunk_sample = 0;
+  int stsc_idx = 0;
+
   void (*data_callback)(MP4Atom &atom,
                         ContainerMP4 &container) = default_data_callback;
   bool (*is_header_callback)(MP4Atom *atom,
                              const uint8_t *data) = default_is_header_callback;
 
+  /// Reads the data at the indicated position of the source
+  int readAt(size_t pos, uint8_t *data, int len) {
+    if ((long)pos != in_pos) {
+      if (!seek_cb(p_in, pos)) return 0;
+      in_pos = pos;
+    }
+    int result = 0;
+    while (result < len) {
+      int read = p_in->readBytes(data + result, len - result);
+      if (read <= 0) break;
+      result += read;
+    }
+    in_pos += result;
+    return result;
+  }
+
+  uint32_t readAt32(size_t pos) {
+    uint8_t data[4] = {0};
+    readAt(pos, data, 4);
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+           (uint32_t)data[2] << 8 | data[3];
+  }
+
+  /// Walks through the top level atoms
+  bool parseRandomAccess() {
+    is_sound_trak = false;
+    is_table_done = false;
+    parseAtoms(0, -1);
+    return is_table_done && table.sizes.size() > 0;
+  }
+
+  /// Parses the atoms between start and end (-1 for the end of the file)
+  void parseAtoms(size_t start, long end) {
+    size_t pos = start;
+    uint8_t header[16];
+    while (end < 0 || pos + 8 <= (size_t)end) {
+      if (readAt(pos, header, 8) != 8) return;
+      uint64_t size = (uint32_t)ntohl(*(uint32_t *)header);
+      int hdr_size = 8;
+      if (size == 1) {
+        if (readAt(pos + 8, header + 8, 8) != 8) return;
+        size = (uint64_t)ntohl(*(uint32_t *)(header + 8)) << 32 |
+               ntohl(*(uint32_t *)(header + 12));
+        hdr_size = 16;
+      }
+      if (size == 0) return;  // up to the end: mdat
+      if (size < (uint64_t)hdr_size) {
+        LOGE("invalid atom size at %lu", (unsigned long)pos);
+        return;
+      }
+      MP4Atom atom{this, (const char *)header + 4};
+      atom.start_pos = pos;
+      atom.total_size = size;
+      size_t data_pos = pos + hdr_size;
+      long data_end = pos + size;
+      LOGI("%s: 0x%06x-0x%06x", atom.atom, (int)pos, (int)data_end);
+      if (atom.is("moov") || atom.is("trak") || atom.is("mdia") ||
+          atom.is("minf") || atom.is("stbl")) {
+        if (atom.is("trak")) is_sound_trak = false;
+        if (!is_table_done) parseAtoms(data_pos, data_end);
+        if (atom.is("trak") && is_sound_trak && table.sizes.size() > 0) {
+          is_table_done = true;
+        }
+      } else if (!is_table_done) {
+        parseTableAtom(atom, data_pos);
+      }
+      pos = data_end;
+    }
+  }
+
+  /// Reads the relevant information of the sample table atoms
+  void parseTableAtom(MP4Atom &atom, size_t pos) {
+    if (atom.is("mdhd")) {
+      bool v1 = readAt32(pos) >> 24 == 1;
+      table.timescale = readAt32(pos + (v1 ? 20 : 12));
+    } else if (atom.is("hdlr")) {
+      is_sound_trak = readAt32(pos + 8) == 0x736f756e;  // soun
+    } else if (!is_sound_trak) {
+      return;
+    } else if (atom.is("stsd")) {
+      parseSampleDescription(pos + 8);
+    } else if (atom.is("stts")) {
+      table.sample_delta = readAt32(pos + 12);
+    } else if (atom.is("stsc")) {
+      uint32_t count = readAt32(pos + 4);
+      table.stsc.resize(count * 2);
+      for (uint32_t j = 0; j < count; j++) {
+        table.stsc[j * 2] = readAt32(pos + 8 + j * 12);
+        table.stsc[j * 2 + 1] = readAt32(pos + 12 + j * 12);
+      }
+    } else if (atom.is("stsz")) {
+      uint32_t fixed = readAt32(pos + 4);
+      uint32_t count = readAt32(pos + 8);
+      if (!table.sizes.resize(count)) return;
+      uint8_t data[4];
+      for (uint32_t j = 0; j < count; j++) {
+        uint32_t size = fixed;
+        if (fixed == 0) {
+          // sequential read w/o seek
+          readAt(pos + 12 + j * 4, data, 4);
+          size = (uint32_t)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+        }
+        if (size > 0xFFFF) {
+          LOGE("sample size %u not supported", (unsigned)size);
+          table.sizes.reset();
+          return;
+        }
+        table.sizes[j] = size;
+      }
+    } else if (atom.is("stco") || atom.is("co64")) {
+      bool is64 = atom.is("co64");
+      uint32_t count = readAt32(pos + 4);
+      if (!table.offsets.resize(count)) return;
+      for (uint32_t j = 0; j < count; j++) {
+        // we only support 32 bit offsets
+        table.offsets[j] = is64 ? readAt32(pos + 12 + j * 8)
+                                : readAt32(pos + 8 + j * 4);
+      }
+    }
+  }
+
+  /// Determines the audio info and the AAC configuration from the first
+  /// sample entry
+  void parseSampleDescription(size_t entry) {
+    uint8_t data[36];
+    if (readAt(entry, data, 36) != 36) return;
+    table.is_aac = memcmp(data + 4, "mp4a", 4) == 0;
+    AudioInfo info;
+    info.channels = data[24] << 8 | data[25];
+    info.bits_per_sample = data[26] << 8 | data[27];
+    info.sample_rate = data[32] << 8 | data[33];
+    info.logInfo();
+    setAudioInfo(info);
+    p_decoder->setAudioInfo(info);
+    table.channels = info.channels;
+    table.rate_idx = rateIndex(info.sample_rate);
+    if (!table.is_aac) return;
+    // find the esds atom in the sample entry
+    uint32_t entry_size = (uint32_t)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+    uint8_t esds[64];
+    int len = readAt(entry + 36, esds, min(entry_size - 36, (uint32_t)64));
+    for (int j = 0; j + 4 < len; j++) {
+      if (memcmp(esds + j, "esds", 4) == 0) {
+        parseDescriptors(esds + j + 8, len - j - 8);
+        return;
+      }
+    }
+  }
+
+  /// Determines the AudioSpecificConfig from the ES, DecoderConfig and
+  /// DecoderSpecificInfo descriptors
+  void parseDescriptors(const uint8_t *data, int len) {
+    int pos = 0;
+    while (pos + 2 < len) {
+      uint8_t tag = data[pos++];
+      // skip the variable length size
+      while (pos < len && (data[pos] & 0x80)) pos++;
+      pos++;
+      if (tag == 0x03) {
+        // ES_ID and flags: followed by the optional fields
+        uint8_t flags = pos + 2 < len ? data[pos + 2] : 0;
+        pos += 3;
+        if (flags & 0x80) pos += 2;
+        if ((flags & 0x40) && pos < len) pos += data[pos] + 1;
+        if (flags & 0x20) pos += 2;
+      } else if (tag == 0x04) {
+        pos += 13;
+      } else if (tag == 0x05) {
+        if (pos + 1 >= len) return;
+        uint8_t object_type = data[pos] >> 3;
+        // ADTS only supports the profiles 1-4: HE-AAC is signaled as LC
+        table.profile = object_type >= 1 && object_type <= 4 ? object_type : 2;
+        table.rate_idx = (data[pos] & 0x07) << 1 | data[pos + 1] >> 7;
+        table.channels = (data[pos + 1] >> 3) & 0x0F;
+        return;
+      } else {
+        return;
+      }
+    }
+  }
+
+  static uint8_t rateIndex(uint32_t rate) {
+    static const uint32_t rates[13] = {96000, 88200, 64000, 48000, 44100,
+                                       32000, 24000, 22050, 16000, 12000,
+                                       11025, 8000,  7350};
+    for (int j = 0; j < 13; j++) {
+      if (rates[j] == rate) return j;
+    }
+    return 4;
+  }
+
+  void writeADTSHeader(uint8_t *hdr, int size) {
+    int len = size + 7;
+    int profile = table.profile - 1;
+    hdr[0] = 0xFF;
+    hdr[1] = 0xF1;
+    hdr[2] = (profile << 6) | (table.rate_idx << 2) | (table.channels >> 2);
+    hdr[3] = ((table.channels & 3) << 6) | (len >> 11);
+    hdr[4] = (len >> 3) & 0xFF;
+    hdr[5] = ((len & 7) << 5) | 0x1F;
+    hdr[6] = 0xFC;
+  }
+
+  /// Number of samples in the indicated chunk (0 based)
+  uint32_t samplesPerChunk(uint32_t chunk) {
+    while (stsc_idx + 2 < (int)table.stsc.size() &&
+           table.stsc[stsc_idx + 2] <= chunk + 1) {
+      stsc_idx += 2;
+    }
+    while (stsc_idx > 0 && table.stsc[stsc_idx] > chunk + 1) stsc_idx -= 2;
+    return table.stsc.size() >= 2 ? table.stsc[stsc_idx + 1] : 1;
+  }
+
+  /// Positions to the indicated access unit
+  void setSample(size_t idx) {
+    sample_idx = 0;
+    chunk_idx = 0;
+    chunk_sample = 0;
+    stsc_idx = 0;
+    sample_pos = table.offsets.empty() ? 0 : table.offsets[0];
+    // skip complete chunks
+    while (chunk_idx + 1 < table.offsets.size()) {
+      uint32_t samples = samplesPerChunk(chunk_idx);
+      if (sample_idx + samples > idx) break;
+      sample_idx += samples;
+      chunk_idx++;
+    }
+    if (chunk_idx < table.offsets.size()) sample_pos = table.offsets[chunk_idx];
+    while (sample_idx < idx) nextSample();
+  }
+
+  void nextSample() {
+    sample_pos += table.sizes[sample_idx];
+    sample_idx++;
+    chunk_sample++;
+    if (chunk_sample >= samplesPerChunk(chunk_idx) &&
+        chunk_idx + 1 < table.offsets.size()) {
+      chunk_idx++;
+      chunk_sample = 0;
+      sample_pos = table.offsets[chunk_idx];
+    }
+  }
+
   /// output of audio mdat to helix decoder;
   size_t decode(const uint8_t *data, size_t len) {
     return p_decoder->write(data, len);
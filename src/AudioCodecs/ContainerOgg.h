@@ -2,13 +2,10 @@
 
 #include "AudioCodecs/AudioCodecsBase.h"
 #include "AudioCodecs/CodecOpus.h"
+#include "AudioCodecs/OggPageParser.h"
 #include "AudioTools/Buffers.h"
 #include "oggz/oggz.h"
 
-#define OGG_READ_SIZE (1024)
-#define OGG_DEFAULT_BUFFER_SIZE (OGG_READ_SIZE)
-// #define OGG_DEFAULT_BUFFER_SIZE (246)
-// #define OGG_READ_SIZE (512)
 
 namespace audio_tools {
 
@@ -16,7 +13,8 @@ namespace audio_tools {
  * @brief Decoder for Ogg Container. Decodes a packet from an Ogg
  * container. The Ogg begin segment contains the AudioInfo structure. You can
  * subclass and overwrite the beginOfSegment() method to implement your own
- * headers
+ * headers. The pages are parsed with the OggPageParser, so the packets are
+ * provided w/o copying them if the page is contained in the written data.
  * Dependency: https://github.com/pschatzmann/arduino-libopus
  * @ingroup codecs
  * @ingroup decoder
@@ -63,25 +61,8 @@ class OggContainerDecoder : public ContainerDecoder {
     TRACED();
     out.setAudioInfo(info);
     out.begin();
-    if (p_oggz == nullptr) {
-      p_oggz = oggz_new(OGGZ_READ | OGGZ_AUTO);  // OGGZ_NONSTRICT
-      is_open = true;
-      // Callback to Replace standard IO
-      if (oggz_io_set_read(p_oggz, ogg_io_read, this) != 0) {
-        LOGE("oggz_io_set_read");
-        is_open = false;
-      }
-      // Callback
-      if (oggz_set_read_callback(p_oggz, -1, read_packet, this) != 0) {
-        LOGE("oggz_set_read_callback");
-        is_open = false;
-      }
-
-      if (oggz_set_read_page(p_oggz, -1, read_page, this) != 0) {
-        LOGE("oggz_set_read_page");
-        is_open = false;
-      }
-    }
+    parser.setPacketCallback(read_packet, this);
+    is_open = parser.begin();
     return is_open;
   }
 
@@ -89,93 +70,63 @@ class OggContainerDecoder : public ContainerDecoder {
     TRACED();
     flush();
     out.end();
+    parser.end();
     is_open = false;
-    oggz_close(p_oggz);
-    p_oggz = nullptr;
   }
 
-  void flush() {
-    LOGD("oggz_read...");
-    while ((oggz_read(p_oggz, OGG_READ_SIZE)) > 0)
-      ;
-  }
+  /// The packets are processed in write(): so there is nothing to flush
+  void flush() {}
 
   virtual size_t write(const uint8_t *data, size_t len) override {
     LOGD("write: %d", (int)len);
-
-    // fill buffer
-    size_t size_consumed = buffer.writeArray((uint8_t *)data, len);
-    if (buffer.availableForWrite() == 0) {
-      // Read all bytes into oggz, calling any read callbacks on the fly.
-      flush();
-    }
-    // write remaining bytes
-    if (size_consumed < len) {
-      size_consumed += buffer.writeArray((uint8_t *)data + size_consumed,
-                                         len - size_consumed);
-      flush();
-    }
-    return size_consumed;
+    if (!is_open) return 0;
+    return parser.write(data, len);
   }
 
   virtual operator bool() override { return is_open; }
 
+  /// Provides access to the page parser (e.g. for the statistics)
+  OggPageParser &pageParser() { return parser; }
+
  protected:
   EncodedAudioOutput out;
   CopyDecoder dec_copy;
   AudioDecoder *p_codec = nullptr;
-  RingBuffer<uint8_t> buffer{OGG_DEFAULT_BUFFER_SIZE};
-  OGGZ *p_oggz = nullptr;
+  OggPageParser parser;
   bool is_open = false;
-  long pos = 0;
-
-  // Final Stream Callback -> provide data to ogg
-  static size_t ogg_io_read(void *user_handle, void *buf, size_t n) {
-    LOGD("ogg_io_read: %d", (int)n);
-    size_t result = 0;
-    OggContainerDecoder *self = (OggContainerDecoder *)user_handle;
-    if (self->buffer.available() >= n) {
-      OggContainerDecoder *self = (OggContainerDecoder *)user_handle;
-      result = self->buffer.readArray((uint8_t *)buf, n);
-      self->pos += result;
-
-    } else {
-      result = 0;
-    }
-    return result;
-  }
 
   // Process full packet
-  static int read_packet(OGGZ *oggz, oggz_packet *zp, long serialno,
-                         void *user_data) {
-    LOGD("read_packet: %d", (int)zp->op.bytes);
+  static void read_packet(const OggPacketSpan &packet, void *user_data) {
+    LOGD("read_packet: %d", (int)packet.len);
     OggContainerDecoder *self = (OggContainerDecoder *)user_data;
-    ogg_packet *op = &zp->op;
-    int result = op->bytes;
-    if (op->b_o_s) {
-      self->beginOfSegment(op);
-    } else if (op->e_o_s) {
-      self->endOfSegment(op);
+    ogg_packet op;
+    op.packet = (unsigned char *)packet.data;
+    op.bytes = packet.len;
+    op.b_o_s = packet.bos;
+    op.e_o_s = packet.eos;
+    op.granulepos = packet.granulepos;
+    op.packetno = packet.packetno;
+    if (op.b_o_s) {
+      self->beginOfSegment(&op);
+    } else if (op.e_o_s) {
+      // the last packet might contain audio data
+      if (op.bytes > 0) self->writeAudio(&op);
+      self->endOfSegment(&op);
     } else {
-      if (memcmp(op->packet, "OpusTags", 8) == 0) {
-        self->beginOfSegment(op);
+      if (op.bytes >= 8 && memcmp(op.packet, "OpusTags", 8) == 0) {
+        self->beginOfSegment(&op);
       } else {
-        LOGD("process audio packet");
-        int eff = self->out.write(op->packet, op->bytes);
-        if (eff != result) {
-          LOGE("Incomplere write");
-        }
+        self->writeAudio(&op);
       }
     }
-    // 0 = success
-    return 0;
   }
 
-  static int read_page(OGGZ *oggz, const ogg_page *og, long serialno,
-                       void *user_data) {
-    LOGD("read_page: %d", (int)og->body_len);
-    // 0 = success
-    return 0;
+  void writeAudio(ogg_packet *op) {
+    LOGD("process audio packet");
+    int eff = out.write(op->packet, op->bytes);
+    if (eff != op->bytes) {
+      LOGE("Incomplere write");
+    }
   }
 
   virtual void beginOfSegment(ogg_packet *op) {
@@ -202,7 +153,9 @@ class OggContainerDecoder : public ContainerDecoder {
 
 /**
  * @brief Output class for the OggContainerEncoder. Each
- * write is ending up as container entry
+ * write is ending up as container entry. By default each entry is written
+ * as separate Ogg page: with setPageSize() and setMaxLatencyMs() several
+ * entries are collected in one page. Each page is written with one write.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
@@ -214,12 +167,21 @@ class OggContainerOutput : public AudioOutput {
   /// Defines the output Stream
   void setOutput(Print &print) { p_out = &print; }
 
+  /// Collects the packets until the page contains at least the indicated
+  /// number of bytes: 0 (=default) writes a page per packet
+  void setPageSize(int bytes) { page_size = bytes; }
+
+  /// Maximum time in ms the first packet of a page is kept before the page
+  /// is written (default 100)
+  void setMaxLatencyMs(uint32_t ms) { max_latency_ms = ms; }
+
   /// starts the processing using the actual AudioInfo
   virtual bool begin() override {
     TRACED();
     assert(cfg.channels != 0);
     assert(cfg.sample_rate != 0);
     is_open = true;
+    pending_bytes = 0;
     if (p_oggz == nullptr) {
       p_oggz = oggz_new(OGGZ_WRITE | OGGZ_NONSTRICT | OGGZ_AUTO);
       serialno = oggz_serialno_new(p_oggz);
@@ -240,6 +202,7 @@ class OggContainerOutput : public AudioOutput {
     TRACED();
 
     writeFooter();
+    writePages();
 
     is_open = false;
     oggz_close(p_oggz);
@@ -263,13 +226,12 @@ class OggContainerOutput : public AudioOutput {
       op.e_o_s = false;
       op.packetno = packetno++;
       is_audio = true;
-      if (!writePacket(op, OGGZ_FLUSH_AFTER)) {
+      if (!writePacket(op, isPageComplete(len) ? OGGZ_FLUSH_AFTER : 0)) {
         return 0;
       }
     }
     // trigger pysical write
-    while ((oggz_write(p_oggz, len)) > 0)
-      ;
+    writePages();
 
     return len;
   }
@@ -285,6 +247,33 @@ class OggContainerOutput : public AudioOutput {
   size_t packetno = 0;
   long serialno = -1;
   bool is_audio = false;
+  int page_size = 0;
+  uint32_t max_latency_ms = 100;
+  int pending_bytes = 0;
+  uint32_t page_start_ms = 0;
+  Vector<uint8_t> page{0};
+
+  /// Determines if the page is complete after the next packet
+  bool isPageComplete(int len) {
+    if (pending_bytes == 0) page_start_ms = millis();
+    pending_bytes += len;
+    if (page_size == 0 || pending_bytes >= page_size ||
+        millis() - page_start_ms >= max_latency_ms) {
+      pending_bytes = 0;
+      return true;
+    }
+    return false;
+  }
+
+  /// Writes all complete pages: each page with one write
+  void writePages() {
+    while ((oggz_write(p_oggz, 4096)) > 0)
+      ;
+    if (page.size() > 0) {
+      writeSamples<uint8_t>(p_out, page.data(), page.size());
+      page.clear();
+    }
+  }
 
   virtual bool writePacket(ogg_packet &op, int flag = 0) {
     LOGD("writePacket: %d", (int)op.bytes);
@@ -328,8 +317,10 @@ class OggContainerOutput : public AudioOutput {
       LOGE("self is null");
       return 0;
     }
-    // self->out.write((uint8_t *)buf, n);
-    writeSamples<uint8_t>(self->p_out, (uint8_t *)buf, n);
+    // collect the page header and body: they are written by writePages()
+    size_t size = self->page.size();
+    self->page.resize(size + n);
+    memcpy(self->page.data() + size, buf, n);
     // 0 = continue
     return 0;
   }
@@ -407,6 +398,13 @@ class OggContainerEncoder : public AudioEncoder {
 
   bool isOpen() { return p_ogg->isOpen(); }
 
+  /// Collects several packets in one Ogg page until it contains at least the
+  /// indicated number of bytes: 0 (=default) writes a page per packet
+  void setPageSize(int bytes) { p_ogg->setPageSize(bytes); }
+
+  /// Maximum time in ms a packet is kept before the page is written
+  void setMaxLatencyMs(uint32_t ms) { p_ogg->setMaxLatencyMs(ms); }
+
  protected:
   AudioEncoder *p_codec = nullptr;
   OggContainerOutput ogg;
@@ -7,7 +7,11 @@
 namespace audio_tools {
 
 /**
- * @brief Adapter class which allows the AudioDecoder API on a StreamingDecoder
+ * @brief Adapter class which allows the AudioDecoder API on a StreamingDecoder.
+ * The written data is buffered in a queue of the indicated size. With
+ * setBackPressure() we decode only as much as the output can accept and
+ * write() accepts only the data which fits into the queue: the partial write
+ * makes the StreamCopy wait, so the decoder runs at constant memory.
  * @ingroup codecs
  * @ingroup decoder
  * @author Phil Schatzmann
@@ -25,6 +29,7 @@ public:
 
   /// Defines the output Stream
   void setOutput(Print &out) override {
+    p_out = &out;
     p_dec->setOutput(out);
   }
 
@@ -51,9 +56,32 @@ public:
     if (is_setup) rbuffer.resize(size);
   }
 
+  /// Activates the back pressure: we decode only while the output can
+  /// accept at least the indicated number of bytes (e.g. the size of a
+  /// decoded frame). 0 (=default) decodes all available data.
+  void setBackPressure(int minOutputBytes) {
+    min_output_available = minOutputBytes;
+  }
+
+  /// Decodes the queued data which the output can accept and provides the
+  /// free space of the input queue
+  int availableForWrite() {
+    setupLazy();
+    if (min_output_available > 0) decode();
+    return rbuffer.availableForWrite();
+  }
+
   size_t write(const uint8_t *data, size_t len) override {
     TRACED();
     setupLazy();
+    if (min_output_available > 0) {
+      // make room in the queue and accept only what fits
+      decode();
+      size_t result = queue.write((uint8_t *)data,
+                                  min(len, (size_t)rbuffer.availableForWrite()));
+      decode();
+      return result;
+    }
     size_t result = queue.write((uint8_t *)data, len);
     // trigger processing - we leave byteCount in the buffer
     // while(queue.available()>byteCount){
@@ -75,7 +103,9 @@ protected:
   bool active = false;
   bool is_setup = false;
   int buffer_size;
+  int min_output_available = 0;
   StreamingDecoder *p_dec = nullptr;
+  Print *p_out = nullptr;
   RingBuffer<uint8_t> rbuffer{0};
   QueueStream<uint8_t> queue{rbuffer}; // convert Buffer to Stream
 
@@ -86,6 +116,13 @@ protected:
       is_setup = true;
     }
   }
+
+  /// Decodes while there is data and the output has enough space
+  void decode() {
+    while (queue.available() > 0 &&
+           (p_out == nullptr || p_out->availableForWrite() >= min_output_available) &&
+           p_dec->copy());
+  }
 };
 
 using DecoderFromStreaming = DecoderAdapter;
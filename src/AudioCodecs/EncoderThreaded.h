@@ -0,0 +1,329 @@
+#pragma once
+
+#include <atomic>
+
+#include "AudioCodecs/AudioCodecsBase.h"
+#include "Concurrency/RingBufferLockFree.h"
+#if defined(ESP32)
+#include "Concurrency/Task.h"
+#define ENCODER_THREADED_PARALLEL
+#elif defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || defined(USE_STD_CONCURRENCY)
+#include <chrono>
+#include <thread>
+#define ENCODER_THREADED_PARALLEL
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Encodes in the background, so that the capturing (e.g. from I2S)
+ * does not stall while a frame is encoded (e.g. with MP3EncoderLAME): the PCM
+ * data is written to a lock free queue of blocks, which is processed by a
+ * worker (a FreeRTOS task on the other core of the ESP32, a std::thread on
+ * the desktop) with the wrapped encoder. The encoded result goes to a lock
+ * free output ring which is written to the final output in the context of the
+ * caller: in write() and end().
+ *
+ * If the PCM queue is full, write() either waits until the worker has
+ * processed a block (blocking, the default) or drops the data (non
+ * blocking). On other platforms the data is encoded by the caller.
+ * @code
+ * MP3EncoderLAME mp3;
+ * EncoderThreaded encoder(mp3);
+ * EncodedAudioStream out(&file, &encoder);
+ * @endcode
+ * @ingroup codecs
+ * @ingroup encoder
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class EncoderThreaded : public AudioEncoder {
+ public:
+  EncoderThreaded(AudioEncoder &encoder, int blockSize = 1024,
+                  int blockCount = 8, int outputSize = 8 * 1024) {
+    p_encoder = &encoder;
+    block_size = blockSize;
+    block_count = blockCount;
+    output_size = outputSize;
+  }
+
+  ~EncoderThreaded() { end(); }
+
+  /// Defines the size in bytes of a PCM block: call before begin()
+  void setBlockSize(int bytes) { block_size = bytes; }
+
+  /// Defines the number of PCM blocks in the queue: call before begin()
+  void setBlockCount(int count) { block_count = count; }
+
+  /// Defines the size of the ring for the encoded data: call before begin()
+  void setOutputSize(int bytes) { output_size = bytes; }
+
+  /// If false, the data is dropped when the queue is full (default true)
+  void setBlocking(bool flag) { is_blocking = flag; }
+
+#if defined(ESP32)
+  /// Defines the stack size, priority and core of the worker task: LAME
+  /// needs a big stack
+  void setWorkerTask(int stackSize, int priority = 1, int core = 0) {
+    stack_size = stackSize;
+    task_priority = priority;
+    task_core = core;
+  }
+#endif
+
+  void setOutput(Print &out_stream) override { p_print = &out_stream; }
+
+  void setAudioInfo(AudioInfo from) override {
+    AudioEncoder::setAudioInfo(from);
+    p_encoder->setAudioInfo(from);
+  }
+
+  const char *mime() override { return p_encoder->mime(); }
+
+  bool begin() override {
+    TRACED();
+    end();
+    resetStatistics();
+#ifdef ENCODER_THREADED_PARALLEL
+    queue.resize(block_size * block_count);
+    output.resize(output_size);
+    block.resize(block_size);
+    if (queue.size() == 0 || output.size() == 0 ||
+        (int)block.size() != block_size) {
+      LOGE("not enough memory");
+      return false;
+    }
+    ring_print.p_ring = &output;
+    ring_print.p_active = &is_running;
+    p_encoder->setOutput(ring_print);
+    if (!p_encoder->begin()) return false;
+    is_running = true;
+#if defined(ESP32)
+    task.create("encoder", stack_size, task_priority, task_core);
+    task.begin([this]() {
+      if (!processBlocks()) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    });
+#else
+    thread = std::thread([this]() {
+      while (is_running) {
+        if (!processBlocks()) {
+          std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+      }
+    });
+#endif
+    is_active = true;
+    return true;
+#else
+    LOGW("worker not supported");
+    if (p_print != nullptr) p_encoder->setOutput(*p_print);
+    is_active = p_encoder->begin();
+    return is_active;
+#endif
+  }
+
+  /// Encodes the queued data and writes the result to the output
+  void end() override {
+    if (!is_active) return;
+#ifdef ENCODER_THREADED_PARALLEL
+    // wait until the worker has processed all complete blocks
+    while (queue.available() >= block_size) {
+      flushOutput();
+      delay(1);
+    }
+    is_running = false;
+#if defined(ESP32)
+    while (is_busy) delay(1);
+    task.remove();
+#else
+    if (thread.joinable()) thread.join();
+#endif
+    flushOutput();
+    // the remaining data is encoded by the caller
+    ring_print.p_active = nullptr;
+    if (p_print != nullptr) p_encoder->setOutput(*p_print);
+    int len = queue.readArray(block.data(), block_size);
+    if (len > 0) encode(block.data(), len);
+#endif
+    p_encoder->end();
+    is_active = false;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+#ifdef ENCODER_THREADED_PARALLEL
+    if (!is_active) return 0;
+    size_t result = 0;
+    while (result < len) {
+      result += queue.writeArray(data + result, len - result);
+      if (queue.available() >= block_size) notifyWorker();
+      flushOutput();
+      if (result < len) {
+        if (!is_blocking) {
+          dropped_bytes += len - result;
+          break;
+        }
+        delay(1);
+      }
+    }
+    updateMaxDepth();
+    return len;
+#else
+    if (!is_active) return 0;
+    uint32_t start = micros();
+    size_t result = p_encoder->write(data, len);
+    updateStatistics((uint32_t)(micros() - start));
+    return result;
+#endif
+  }
+
+  /// Number of bytes in the PCM queue
+  int queueDepth() {
+#ifdef ENCODER_THREADED_PARALLEL
+    return queue.available();
+#else
+    return 0;
+#endif
+  }
+
+  /// Max number of bytes which were in the PCM queue
+  int maxQueueDepth() { return max_depth; }
+
+  /// Number of bytes which were dropped because the queue was full
+  size_t droppedBytes() { return dropped_bytes; }
+
+  /// Number of encoded blocks
+  uint32_t blocks() { return block_counter; }
+
+  /// Average encoding time per block in us
+  uint32_t avgEncodeTimeUs() {
+    return block_counter == 0 ? 0 : sum_encode_us / block_counter;
+  }
+
+  /// Max encoding time of a block in us
+  uint32_t maxEncodeTimeUs() { return max_encode_us; }
+
+  /// Encoding time of the last block in us
+  uint32_t lastEncodeTimeUs() { return last_encode_us; }
+
+  /// Resets the statistics
+  void resetStatistics() {
+    max_depth = 0;
+    dropped_bytes = 0;
+    block_counter = 0;
+    sum_encode_us = 0;
+    max_encode_us = 0;
+    last_encode_us = 0;
+  }
+
+  /// Returns true after a successful begin()
+  bool isActive() { return is_active; }
+
+  operator bool() override { return is_active; }
+
+ protected:
+  /// Writes the encoded data to the output ring: waits while the ring is
+  /// full and the worker is active
+  class RingPrint : public Print {
+   public:
+    RingBufferLockFree<uint8_t> *p_ring = nullptr;
+    std::atomic<bool> *p_active = nullptr;
+    size_t write(uint8_t ch) override { return write(&ch, 1); }
+    size_t write(const uint8_t *data, size_t len) override {
+      size_t result = 0;
+      while (result < len) {
+        result += p_ring->writeArray(data + result, len - result);
+        if (result < len) {
+          if (p_active == nullptr || !*p_active) break;
+          delay(1);
+        }
+      }
+      return result;
+    }
+    int availableForWrite() override { return p_ring->availableForWrite(); }
+  };
+
+  AudioEncoder *p_encoder = nullptr;
+  Print *p_print = nullptr;
+  int block_size = 1024;
+  int block_count = 8;
+  int output_size = 8 * 1024;
+  bool is_blocking = true;
+  bool is_active = false;
+  std::atomic<bool> is_running{false};
+  std::atomic<bool> is_busy{false};
+  std::atomic<int> max_depth{0};
+  std::atomic<size_t> dropped_bytes{0};
+  std::atomic<uint32_t> block_counter{0};
+  std::atomic<uint32_t> sum_encode_us{0};
+  std::atomic<uint32_t> max_encode_us{0};
+  std::atomic<uint32_t> last_encode_us{0};
+#ifdef ENCODER_THREADED_PARALLEL
+  RingBufferLockFree<uint8_t> queue;
+  RingBufferLockFree<uint8_t> output;
+  Vector<uint8_t> block{0};
+  RingPrint ring_print;
+#if defined(ESP32)
+  Task task;
+  int stack_size = 16 * 1024;
+  int task_priority = 1;
+  int task_core = 0;
+#else
+  std::thread thread;
+#endif
+
+  /// Encodes the complete blocks of the queue: worker only
+  bool processBlocks() {
+    is_busy = true;
+    if (!is_running || queue.available() < block_size) {
+      is_busy = false;
+      return false;
+    }
+    while (is_running && queue.available() >= block_size) {
+      queue.readArray(block.data(), block_size);
+      encode(block.data(), block_size);
+    }
+    is_busy = false;
+    return true;
+  }
+
+  void notifyWorker() {
+#if defined(ESP32)
+    xTaskNotifyGive(task.getTaskHandle());
+#endif
+  }
+
+  /// Writes the encoded data to the final output: caller only
+  void flushOutput() {
+    if (p_print == nullptr) {
+      output.clearArray(output.available());
+      return;
+    }
+    while (output.available() > 0) {
+      int len = output.readPtrSize();
+      int written = p_print->write(output.readPtr(), len);
+      output.consume(written);
+      if (written < len) break;
+    }
+  }
+
+  void updateMaxDepth() {
+    int depth = queue.available();
+    if (depth > max_depth) max_depth = depth;
+  }
+#endif
+
+  void encode(const uint8_t *data, size_t len) {
+    uint32_t start = micros();
+    p_encoder->write(data, len);
+    updateStatistics((uint32_t)(micros() - start));
+  }
+
+  void updateStatistics(uint32_t us) {
+    last_encode_us = us;
+    sum_encode_us += us;
+    if (us > max_encode_us) max_encode_us = us;
+    block_counter++;
+  }
+};
+
+}  // namespace audio_tools
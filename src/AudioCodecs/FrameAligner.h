@@ -0,0 +1,150 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioCodecs/CodecADTS.h"
+#include "AudioCodecs/SeekIndex.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Groups encoded MP3 or AAC (ADTS) data into complete frames: the
+ * frame callback is called once per frame. Complete frames which are
+ * contained in the written data are provided directly from the written
+ * buffer, so only the frames which are split over different write() calls are
+ * copied. Data between the frames (e.g. after a loss of sync) is skipped.
+ *
+ * Because a frame must be contiguous we use a linear buffer which can hold
+ * one frame.
+ * @ingroup codecs
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FrameAligner {
+ public:
+  enum Type { ADTS, MP3 };
+  typedef void (*FrameCallback)(const uint8_t *frame, size_t len, void *ref);
+
+  FrameAligner(Type type = ADTS) { setType(type); }
+
+  /// Defines the frame format
+  void setType(Type type) {
+    frame_type = type;
+    header_size = type == MP3 ? 4 : 7;
+  }
+
+  /// Defines the callback which receives the complete frames
+  void setFrameCallback(FrameCallback cb, void *ref = nullptr) {
+    frame_cb = cb;
+    p_ref = ref;
+  }
+
+  bool begin() {
+    buffer.resize(frame_type == MP3 ? 2881 : 8191);
+    buffer.reset();
+    adts.begin();
+    frame_count = 0;
+    skipped = 0;
+    start_ms = millis();
+    return true;
+  }
+
+  void end() {
+    LOGI("frames: %u (%d frames/sec), skipped bytes: %u",
+         (unsigned)frame_count, (int)framesPerSecond(), (unsigned)skipped);
+    buffer.resize(0);
+  }
+
+  size_t write(const uint8_t *data, size_t len) {
+    // complete the open frame
+    size_t pos = buffer.isEmpty() ? 0 : fillBuffer(data, len);
+    // process the complete frames in place
+    while (buffer.isEmpty() && pos < len) {
+      int frame_len = frameLength(data + pos, len - pos);
+      if (frame_len < 0) {
+        pos++;
+        skipped++;
+      } else if (frame_len == 0 || pos + frame_len > len) {
+        // incomplete header or frame: keep it for the next write
+        buffer.writeArray(data + pos, len - pos);
+        pos = len;
+      } else {
+        writeFrame(data + pos, frame_len);
+        pos += frame_len;
+      }
+    }
+    return len;
+  }
+
+  /// Number of frames which have been provided since begin()
+  size_t frameCount() { return frame_count; }
+
+  /// Number of skipped bytes which were not part of any frame
+  size_t skippedBytes() { return skipped; }
+
+  /// Achieved number of frames per second since begin()
+  float framesPerSecond() {
+    uint32_t ms = millis() - start_ms;
+    return ms == 0 ? 0.0f : 1000.0f * frame_count / ms;
+  }
+
+ protected:
+  Type frame_type = ADTS;
+  int header_size = 7;
+  SingleBuffer<uint8_t> buffer{0};
+  ADTSParser adts;
+  FrameCallback frame_cb = nullptr;
+  void *p_ref = nullptr;
+  size_t frame_count = 0;
+  size_t skipped = 0;
+  uint32_t start_ms = 0;
+
+  /// Provides the length of the frame which starts at data: 0 if we need
+  /// more data and -1 if there is no valid header.
+  int frameLength(const uint8_t *data, size_t len) {
+    if (len < (size_t)header_size) {
+      // a partial header must at least start with the sync byte
+      return data[0] == 0xFF ? 0 : -1;
+    }
+    int result = -1;
+    if (frame_type == MP3) {
+      SeekIndex::FrameInfo info;
+      if (SeekIndex::parseMP3(data, info)) result = info.len;
+    } else if (adts.isSyncWord((uint8_t *)data) &&
+               adts.parse((uint8_t *)data)) {
+      result = adts.size();
+    }
+    if (result < header_size || result > buffer.size()) return -1;
+    return result;
+  }
+
+  /// Adds the data to the open frame: returns the number of used bytes
+  size_t fillBuffer(const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    while (!buffer.isEmpty() && pos < len) {
+      int available = buffer.available();
+      int frame_len = frameLength(buffer.data(), available);
+      if (frame_len < 0) {
+        // not a valid frame: continue with the next byte
+        buffer.clearArray(1);
+        skipped++;
+        continue;
+      }
+      int needed = frame_len == 0 ? header_size : frame_len;
+      int n = min((size_t)(needed - available), len - pos);
+      buffer.writeArray(data + pos, n);
+      pos += n;
+      if (frame_len > 0 && buffer.available() == frame_len) {
+        writeFrame(buffer.data(), frame_len);
+        buffer.reset();
+      }
+    }
+    return pos;
+  }
+
+  void writeFrame(const uint8_t *frame, size_t len) {
+    frame_count++;
+    if (frame_cb != nullptr) frame_cb(frame, len, p_ref);
+  }
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,122 @@
+#pragma once
+#include <stdint.h>
+
+/// Number of samples which are converted on the stack by the G711 codecs
+#ifndef G711_CHUNK_SAMPLES
+#  define G711_CHUNK_SAMPLES 256
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Bulk G.711 A-law and µ-law conversion of whole buffers w/o any
+ * external library: the decoding uses a 256 entry table which is created
+ * with the first use, the encoding determines the segment w/o branches from
+ * the number of leading zeros. The results are identical with the reference
+ * implementation (linear2alaw, alaw2linear, linear2ulaw, ulaw2linear).
+ * @ingroup codecs
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class G711 {
+ public:
+  /// Converts 16 bit PCM samples to A-law
+  static void encodeALaw(const int16_t *pcm, uint8_t *out, int samples) {
+    for (int j = 0; j < samples; j++) out[j] = linearToALaw(pcm[j]);
+  }
+
+  /// Converts 16 bit PCM samples to µ-law
+  static void encodeULaw(const int16_t *pcm, uint8_t *out, int samples) {
+    for (int j = 0; j < samples; j++) out[j] = linearToULaw(pcm[j]);
+  }
+
+  /// Converts A-law to 16 bit PCM samples
+  static void decodeALaw(const uint8_t *in, int16_t *pcm, int samples) {
+    const int16_t *table = aLawTable();
+    for (int j = 0; j < samples; j++) pcm[j] = table[in[j]];
+  }
+
+  /// Converts µ-law to 16 bit PCM samples
+  static void decodeULaw(const uint8_t *in, int16_t *pcm, int samples) {
+    const int16_t *table = uLawTable();
+    for (int j = 0; j < samples; j++) pcm[j] = table[in[j]];
+  }
+
+  /// Converts a single 16 bit PCM sample to A-law
+  static inline uint8_t linearToALaw(int16_t sample) {
+    int pcm = sample >> 3;
+    uint8_t mask = 0xD5;
+    if (pcm < 0) {
+      mask = 0x55;
+      pcm = -pcm - 1;
+    }
+    // segment 0 and 1 use the same step size
+    int seg = bitLength(pcm) - 5;
+    if (seg < 0) seg = 0;
+    if (seg >= 8) return 0x7F ^ mask;
+    int shift = seg < 2 ? 1 : seg;
+    return ((seg << 4) | ((pcm >> shift) & 0x0F)) ^ mask;
+  }
+
+  /// Converts a single 16 bit PCM sample to µ-law
+  static inline uint8_t linearToULaw(int16_t sample) {
+    int pcm = sample >> 2;
+    uint8_t mask = 0xFF;
+    if (pcm < 0) {
+      pcm = -pcm;
+      mask = 0x7F;
+    }
+    if (pcm > 8159) pcm = 8159;
+    pcm += 0x21;
+    int seg = bitLength(pcm) - 6;
+    if (seg >= 8) return 0x7F ^ mask;
+    return ((seg << 4) | ((pcm >> (seg + 1)) & 0x0F)) ^ mask;
+  }
+
+  /// Converts a single A-law value to a 16 bit PCM sample
+  static int16_t aLawToLinear(uint8_t value) {
+    value ^= 0x55;
+    int t = (value & 0x0F) << 4;
+    int seg = (value & 0x70) >> 4;
+    if (seg == 0) {
+      t += 8;
+    } else {
+      t += 0x108;
+      t <<= seg - 1;
+    }
+    return (value & 0x80) ? t : -t;
+  }
+
+  /// Converts a single µ-law value to a 16 bit PCM sample
+  static int16_t uLawToLinear(uint8_t value) {
+    value = ~value;
+    int t = ((value & 0x0F) << 3) + 0x84;
+    t <<= (value & 0x70) >> 4;
+    return (value & 0x80) ? (0x84 - t) : (t - 0x84);
+  }
+
+ protected:
+  struct Table {
+    int16_t values[256];
+    Table(int16_t (*decode)(uint8_t)) {
+      for (int j = 0; j < 256; j++) values[j] = decode(j);
+    }
+  };
+
+  static const int16_t *aLawTable() {
+    static const Table table(aLawToLinear);
+    return table.values;
+  }
+
+  static const int16_t *uLawTable() {
+    static const Table table(uLawToLinear);
+    return table.values;
+  }
+
+  /// Number of significant bits of a positive value
+  static inline int bitLength(int value) {
+    return 8 * sizeof(unsigned long) - __builtin_clzl((unsigned long)value | 1);
+  }
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioCodecs/AudioCodecsBase.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Determines the mime type from the first bytes of the data or
+ * normalizes a mime type which was provided e.g. by the HTTP Content-Type
+ * @ingroup codecs
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MimeDetector {
+ public:
+  /// Determines the mime type from the start of the data: returns nullptr if
+  /// the format is not known
+  static const char *detect(const uint8_t *data, size_t len) {
+    if (len >= 4 && memcmp(data, "fLaC", 4) == 0) return "audio/flac";
+    if (len >= 4 && memcmp(data, "OggS", 4) == 0) return "audio/ogg";
+    if (len >= 12 && memcmp(data, "RIFF", 4) == 0 &&
+        memcmp(data + 8, "WAVE", 4) == 0)
+      return "audio/vnd.wave";
+    if (len >= 8 && memcmp(data + 4, "ftyp", 4) == 0) return "audio/mp4";
+    if (len >= 3 && memcmp(data, "ID3", 3) == 0) return "audio/mpeg";
+    if (len >= 2 && data[0] == 0xFF) {
+      // ADTS: sync word with layer 0
+      if ((data[1] & 0xF6) == 0xF0) return "audio/aac";
+      // MPEG audio: sync word with a valid layer
+      if ((data[1] & 0xE0) == 0xE0 && (data[1] & 0x06) != 0)
+        return "audio/mpeg";
+    }
+    return nullptr;
+  }
+
+  /// Maps the alternative names to the mime which is used by detect(): any
+  /// parameters (e.g. ;charset=) are ignored
+  static const char *normalize(const char *mime) {
+    if (mime == nullptr) return nullptr;
+    static const char *aliases[][2] = {
+        {"audio/mp3", "audio/mpeg"},       {"audio/mpeg3", "audio/mpeg"},
+        {"audio/x-mpeg", "audio/mpeg"},    {"audio/aacp", "audio/aac"},
+        {"audio/x-aac", "audio/aac"},      {"audio/x-flac", "audio/flac"},
+        {"audio/wav", "audio/vnd.wave"},   {"audio/x-wav", "audio/vnd.wave"},
+        {"audio/wave", "audio/vnd.wave"},  {"audio/m4a", "audio/mp4"},
+        {"audio/x-m4a", "audio/mp4"},      {"application/ogg", "audio/ogg"},
+        {"audio/mpeg", "audio/mpeg"},      {"audio/aac", "audio/aac"},
+        {"audio/flac", "audio/flac"},      {"audio/vnd.wave", "audio/vnd.wave"},
+        {"audio/mp4", "audio/mp4"},        {"audio/ogg", "audio/ogg"}};
+    for (auto &alias : aliases) {
+      if (isMime(mime, alias[0])) return alias[1];
+    }
+    return mime;
+  }
+
+  /// Compares the mime types ignoring the case and the parameters
+  static bool isMime(const char *mime, const char *name) {
+    size_t len = strlen(name);
+    if (strncasecmp(mime, name, len) != 0) return false;
+    char next = mime[len];
+    return next == 0 || next == ';' || next == ' ';
+  }
+};
+
+/**
+ * @brief Decoder which determines the format from the first bytes of the data
+ * (or from the mime type which was provided e.g. from the HTTP Content-Type)
+ * and forwards the data to the decoder which was registered for this mime
+ * type. The decoders stay allocated (warm), so that a change of the format
+ * just selects another decoder: we only call begin() on it. Decoders which
+ * are registered with a factory function are created on first use and are
+ * kept until releaseDecoders() is called. This way one AudioPlayer can play
+ * a mixed library of e.g. mp3, aac, flac and wav files.
+ * @ingroup codecs
+ * @ingroup decoder
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MultiDecoder : public AudioDecoder {
+ public:
+  MultiDecoder() = default;
+  ~MultiDecoder() { releaseDecoders(); }
+
+  /// Registers a decoder instance for the indicated mime type (e.g.
+  /// "audio/mpeg")
+  bool addDecoder(AudioDecoder &decoder, const char *mime) {
+    DecoderEntry entry;
+    entry.mime = MimeDetector::normalize(mime);
+    entry.p_decoder = &decoder;
+    decoders.push_back(entry);
+    return true;
+  }
+
+  /// Registers a factory function which creates the decoder on first use
+  bool addDecoder(AudioDecoder *(*create)(), const char *mime) {
+    DecoderEntry entry;
+    entry.mime = MimeDetector::normalize(mime);
+    entry.create = create;
+    decoders.push_back(entry);
+    return true;
+  }
+
+  /// Defines the mime type (e.g. from the HTTP Content-Type) which is used
+  /// instead of the detection: nullptr or an unsupported type activates the
+  /// detection from the data
+  void setMimeType(const char *mime) { mime_hint = mime; }
+
+  /// Defines the output Stream
+  void setOutput(Print &out) override {
+    p_print = &out;
+    if (p_actual != nullptr) p_actual->setOutput(out);
+  }
+
+  /// Defines the object which is notified about AudioInfo changes
+  void addNotifyAudioChange(AudioInfoSupport &bi) override {
+    AudioDecoder::addNotifyAudioChange(bi);
+    if (p_actual != nullptr) p_actual->addNotifyAudioChange(bi);
+  }
+
+  /// (Re)starts the format detection with the next write
+  bool begin() override {
+    TRACED();
+    p_actual = nullptr;
+    actual_mime = nullptr;
+    is_active = true;
+    return true;
+  }
+
+  /// Stops the processing: the decoders stay allocated for the next begin()
+  void end() override {
+    TRACED();
+    p_actual = nullptr;
+    actual_mime = nullptr;
+    is_active = false;
+  }
+
+  /// Keeps the memory of the decoders in their end()
+  void setReuseMemory(bool flag) override {
+    AudioDecoder::setReuseMemory(flag);
+    for (auto &entry : decoders) {
+      if (entry.p_decoder != nullptr) entry.p_decoder->setReuseMemory(flag);
+    }
+  }
+
+  /// Ends the processing and releases the decoders
+  void release() override {
+    end();
+    releaseDecoders();
+  }
+
+  /// Releases the memory of all decoders and deletes the decoders which were
+  /// created by the factory functions
+  void releaseDecoders() {
+    p_actual = nullptr;
+    for (auto &entry : decoders) {
+      if (entry.p_decoder != nullptr) entry.p_decoder->release();
+      if (entry.is_created) {
+        delete entry.p_decoder;
+        entry.p_decoder = nullptr;
+        entry.is_created = false;
+      }
+    }
+  }
+
+  AudioInfo audioInfo() override {
+    return p_actual != nullptr ? p_actual->audioInfo() : info;
+  }
+
+  /// Provides the mime type of the actual decoder (or nullptr)
+  const char *mime() { return actual_mime; }
+
+  /// Provides the actual decoder (or nullptr)
+  AudioDecoder *getDecoder() { return p_actual; }
+
+  /// Selects the decoder with the first write and forwards the data
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!is_active) return 0;
+    if (p_actual == nullptr && !selectDecoder(data, len)) {
+      // ignore unsupported data
+      return len;
+    }
+    return p_actual->write(data, len);
+  }
+
+  /// Informs the actual decoder about a seek
+  void notifySeek(long offset) override {
+    if (p_actual != nullptr) p_actual->notifySeek(offset);
+  }
+
+  operator bool() override { return is_active; }
+
+ protected:
+  struct DecoderEntry {
+    const char *mime = nullptr;
+    AudioDecoder *p_decoder = nullptr;
+    AudioDecoder *(*create)() = nullptr;
+    bool is_created = false;
+  };
+  Vector<DecoderEntry> decoders{0};
+  AudioDecoder *p_actual = nullptr;
+  const char *mime_hint = nullptr;
+  const char *actual_mime = nullptr;
+  bool is_active = false;
+
+  /// Determines the decoder from the mime hint or the data
+  bool selectDecoder(const uint8_t *data, size_t len) {
+    DecoderEntry *p_entry = findEntry(MimeDetector::normalize(mime_hint));
+    if (p_entry == nullptr) {
+      const char *mime = MimeDetector::detect(data, len);
+      p_entry = findEntry(mime);
+      if (p_entry == nullptr) {
+        LOGW("Unsupported format: %s", mime == nullptr ? "?" : mime);
+        return false;
+      }
+    }
+    if (p_entry->p_decoder == nullptr && p_entry->create != nullptr) {
+      // allocate the decoder only once
+      p_entry->p_decoder = p_entry->create();
+      p_entry->is_created = true;
+    }
+    if (p_entry->p_decoder == nullptr) return false;
+    p_entry->p_decoder->setReuseMemory(is_reuse_memory);
+    LOGI("Using decoder for %s", p_entry->mime);
+    p_actual = p_entry->p_decoder;
+    actual_mime = p_entry->mime;
+    if (p_print != nullptr) p_actual->setOutput(*p_print);
+    for (auto p_notify : notify_vector) p_actual->addNotifyAudioChange(*p_notify);
+    return p_actual->begin();
+  }
+
+  DecoderEntry *findEntry(const char *mime) {
+    if (mime == nullptr) return nullptr;
+    for (auto &entry : decoders) {
+      if (MimeDetector::isMime(mime, entry.mime)) return &entry;
+    }
+    return nullptr;
+  }
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,301 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/Buffers.h"
+
+/// Max size of an Ogg page which can be split over different writes
+#ifndef OGG_MAX_PAGE_SIZE
+#  define OGG_MAX_PAGE_SIZE (16 * 1024)
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Packet which was found by the OggPageParser: the data points either
+ * into the written buffer or into the internal buffer of the parser and is
+ * only valid in the callback.
+ * @ingroup codecs
+ */
+struct OggPacketSpan {
+  const uint8_t *data = nullptr;
+  size_t len = 0;
+  int64_t granulepos = -1;
+  uint32_t serialno = 0;
+  uint32_t packetno = 0;
+  bool bos = false;
+  bool eos = false;
+};
+
+/**
+ * @brief Parses Ogg pages w/o libogg: the pages are located with the OggS
+ * capture pattern and validated with the CRC32 of the page. The packets are
+ * provided to the callback. Pages which are contained in the written data are
+ * processed directly from the written buffer, so only the pages which are
+ * split over different write() calls and the packets which continue on the
+ * next page are copied. Data between the pages (e.g. after a loss of sync) is
+ * skipped.
+ * @ingroup codecs
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class OggPageParser {
+ public:
+  typedef void (*PacketCallback)(const OggPacketSpan &packet, void *ref);
+
+  /// Defines the callback which receives the packets
+  void setPacketCallback(PacketCallback cb, void *ref = nullptr) {
+    packet_cb = cb;
+    p_ref = ref;
+  }
+
+  /// Defines the max size of a page or packet which needs to be copied:
+  /// call before begin()
+  void setMaxPageSize(int size) { max_page_size = size; }
+
+  bool begin() {
+    buffer.resize(max_page_size);
+    buffer.reset();
+    packet.resize(0);
+    packet_serialno = 0;
+    packet_count = 0;
+    page_count = 0;
+    skipped = 0;
+    copied = 0;
+    return true;
+  }
+
+  void end() {
+    LOGI("pages: %u, packets: %u, skipped bytes: %u, copied bytes: %u",
+         (unsigned)page_count, (unsigned)packet_count, (unsigned)skipped,
+         (unsigned)copied);
+    buffer.resize(0);
+    packet.resize(0);
+  }
+
+  size_t write(const uint8_t *data, size_t len) {
+    // complete the open page
+    size_t pos = buffer.isEmpty() ? 0 : fillBuffer(data, len);
+    // process the complete pages in place
+    while (buffer.isEmpty() && pos < len) {
+      int page_len = pageLength(data + pos, len - pos);
+      if (page_len < 0) {
+        pos++;
+        skipped++;
+      } else if (page_len == 0 || pos + page_len > len) {
+        // incomplete page: keep it for the next write
+        buffer.writeArray(data + pos, len - pos);
+        copied += len - pos;
+        pos = len;
+      } else if (!isValidPage(data + pos, page_len)) {
+        pos++;
+        skipped++;
+      } else {
+        processPage(data + pos, page_len);
+        pos += page_len;
+      }
+    }
+    return len;
+  }
+
+  /// Number of valid pages since begin()
+  size_t pageCount() { return page_count; }
+
+  /// Number of provided packets since begin()
+  size_t packetCount() { return packet_count; }
+
+  /// Number of skipped bytes which were not part of any valid page
+  size_t skippedBytes() { return skipped; }
+
+  /// Number of bytes which needed to be copied
+  size_t copiedBytes() { return copied; }
+
+  /// CRC32 of Ogg (polynomial 0x04c11db7, w/o reflection) with a 256 entry
+  /// table
+  static uint32_t crc(uint32_t crc, const uint8_t *data, size_t len) {
+    const uint32_t *table = crcTable();
+    for (size_t j = 0; j < len; j++) {
+      crc = (crc << 8) ^ table[((crc >> 24) ^ data[j]) & 0xFF];
+    }
+    return crc;
+  }
+
+ protected:
+  static const int header_size = 27;
+  int max_page_size = OGG_MAX_PAGE_SIZE;
+  SingleBuffer<uint8_t> buffer{0};
+  // packet which continues on the next page
+  Vector<uint8_t> packet{0};
+  uint32_t packet_serialno = 0;
+  PacketCallback packet_cb = nullptr;
+  void *p_ref = nullptr;
+  size_t page_count = 0;
+  size_t packet_count = 0;
+  size_t skipped = 0;
+  size_t copied = 0;
+
+  static const uint32_t *crcTable() {
+    static uint32_t table[256] = {0};
+    static bool is_setup = false;
+    if (!is_setup) {
+      for (uint32_t j = 0; j < 256; j++) {
+        uint32_t r = j << 24;
+        for (int k = 0; k < 8; k++) {
+          r = (r & 0x80000000) ? (r << 1) ^ 0x04c11db7 : r << 1;
+        }
+        table[j] = r;
+      }
+      is_setup = true;
+    }
+    return table;
+  }
+
+  static uint32_t readLE32(const uint8_t *data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+           ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+  }
+
+  /// Number of bytes which are needed to determine the page length
+  static int headerLength(const uint8_t *data, size_t len) {
+    return len < (size_t)header_size ? header_size : header_size + data[26];
+  }
+
+  /// Provides the length of the page which starts at data: 0 if we need
+  /// more data and -1 if there is no valid header.
+  int pageLength(const uint8_t *data, size_t len) {
+    static const char capture[] = "OggS";
+    size_t n = len < 4 ? len : 4;
+    if (memcmp(data, capture, n) != 0) return -1;
+    if (len > 4 && data[4] != 0) return -1;
+    int header_len = headerLength(data, len);
+    if (len < (size_t)header_len) return 0;
+    int result = header_len;
+    for (int j = 0; j < data[26]; j++) result += data[header_size + j];
+    if (result > max_page_size && result > (int)len) {
+      LOGW("page too big: %d", result);
+      return -1;
+    }
+    return result;
+  }
+
+  /// Compares the CRC with the value in the header
+  bool isValidPage(const uint8_t *page, size_t len) {
+    const uint8_t zero[4] = {0};
+    uint32_t value = crc(0, page, 22);
+    value = crc(value, zero, 4);
+    value = crc(value, page + 26, len - 26);
+    return value == readLE32(page + 22);
+  }
+
+  /// Adds the data to the open page: returns the number of used bytes
+  size_t fillBuffer(const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    while (!buffer.isEmpty() && pos < len) {
+      int available = buffer.available();
+      int page_len = pageLength(buffer.data(), available);
+      if (page_len < 0) {
+        // not a valid page: continue with the next byte
+        buffer.clearArray(1);
+        skipped++;
+        continue;
+      }
+      int needed =
+          page_len == 0 ? headerLength(buffer.data(), available) : page_len;
+      int n = min((size_t)(needed - available), len - pos);
+      buffer.writeArray(data + pos, n);
+      copied += n;
+      pos += n;
+      if (page_len > 0 && buffer.available() == page_len) {
+        if (isValidPage(buffer.data(), page_len)) {
+          processPage(buffer.data(), page_len);
+          buffer.reset();
+        } else {
+          buffer.clearArray(1);
+          skipped++;
+        }
+      }
+    }
+    return pos;
+  }
+
+  /// Splits the page into packets with the help of the lacing values
+  void processPage(const uint8_t *page, size_t len) {
+    page_count++;
+    uint8_t flags = page[5];
+    bool is_continued = flags & 0x01;
+    int64_t granulepos = (int64_t)readLE32(page + 6) |
+                         ((int64_t)readLE32(page + 10) << 32);
+    uint32_t serialno = readLE32(page + 14);
+    int segments = page[26];
+    const uint8_t *lacing = page + header_size;
+    const uint8_t *body = lacing + segments;
+
+    // a continued packet w/o start (or of another stream) is dropped
+    bool has_start = packet.size() > 0 && packet_serialno == serialno;
+    if (!is_continued || !has_start) packet.resize(0);
+    bool skip_first = is_continued && !has_start;
+
+    // determine the last complete packet for the eos and granulepos
+    int last_end = -1;
+    for (int j = 0; j < segments; j++) {
+      if (lacing[j] < 255) last_end = j;
+    }
+
+    size_t start = 0;
+    size_t size = 0;
+    bool is_first = true;
+    for (int j = 0; j < segments; j++) {
+      size += lacing[j];
+      if (lacing[j] == 255) continue;
+      // packet is complete
+      if (skip_first) {
+        skip_first = false;
+      } else {
+        OggPacketSpan span;
+        span.serialno = serialno;
+        span.bos = (flags & 0x02) && is_first;
+        span.eos = (flags & 0x04) && j == last_end;
+        span.granulepos = j == last_end ? granulepos : -1;
+        if (packet.size() > 0) {
+          // first packet continues the packet of the last page
+          appendPacket(body + start, size);
+          span.data = packet.data();
+          span.len = packet.size();
+          writePacket(span);
+          packet.resize(0);
+        } else {
+          span.data = body + start;
+          span.len = size;
+          writePacket(span);
+        }
+      }
+      is_first = false;
+      start += size;
+      size = 0;
+    }
+    // the last packet continues on the next page
+    if (size > 0 && !skip_first) {
+      packet_serialno = serialno;
+      appendPacket(body + start, size);
+    }
+  }
+
+  void appendPacket(const uint8_t *data, size_t len) {
+    size_t old_size = packet.size();
+    if (old_size + len > (size_t)max_page_size * 4) {
+      LOGW("packet too big");
+      packet.resize(0);
+      return;
+    }
+    packet.resize(old_size + len);
+    memcpy(packet.data() + old_size, data, len);
+    copied += len;
+  }
+
+  void writePacket(OggPacketSpan &span) {
+    span.packetno = packet_count++;
+    if (packet_cb != nullptr) packet_cb(span, p_ref);
+  }
+};
+
+}  // namespace audio_tools
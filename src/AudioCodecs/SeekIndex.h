@@ -0,0 +1,615 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioCodecs/WAVHeader.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Entry of the SeekIndex
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct SeekPoint {
+  /// time in units of the rate of the index (e.g. samples)
+  uint32_t time;
+  /// byte position in the stream
+  uint32_t pos;
+};
+
+/**
+ * @brief Determines the byte position of a time in an encoded audio stream.
+ * The encoded data is provided with write() while it is played: the format is
+ * detected from the start of the stream and we use
+ * - the data offset and block align of the WAV header
+ * - the stsc and stco atoms of MP4 files (if the moov atom is before mdat)
+ * - the Xing or VBRI TOC of MP3 files
+ * - a sparse frame offset index which is built during the playback of MP3 and
+ *   AAC (ADTS) data, so that repeated seeks are a binary search
+ *
+ * Positions which have not been indexed yet are estimated from the TOC or
+ * from the average bitrate: the decoder needs to resynchronize in this case.
+ * @ingroup codecs
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SeekIndex {
+ public:
+  enum Format { UNKNOWN, MP3, ADTS, WAV, MP4 };
+
+  /// Restarts the index for a new stream
+  void begin() {
+    state = PROBE;
+    format_type = UNKNOWN;
+    stream_pos = 0;
+    skip_to = 0;
+    probe.resize(0);
+    probe_start = 0;
+    points.clear();
+    toc.clear();
+    interval = interval_ms;
+    rate = 0;
+    time = 0;
+    indexed_time = 0;
+    is_exact = true;
+    scanned_bytes = 0;
+    scanned_time = 0;
+    hdr_len = 0;
+    seek_pos = -1;
+    // mp4
+    atom_pos = 0;
+    in_atom = false;
+    is_sound_track = false;
+    is_mp4_indexed = false;
+    stsc.clear();
+    sample_delta = 0;
+    chunk_samples = 0;
+    stsc_idx = 0;
+  }
+
+  /// Minimum distance of the index entries in ms: the distance is doubled
+  /// when the max number of entries has been reached
+  void setInterval(uint32_t ms) { interval_ms = ms; }
+
+  /// Max number of entries in the sparse index
+  void setMaxEntries(int count) { max_entries = count; }
+
+  /// Provides the encoded data which is played
+  size_t write(const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+      pos += process(data + pos, len - pos);
+    }
+    return len;
+  }
+
+  /// Provides the byte position of the frame at or before the indicated time:
+  /// returns -1 if the position can not be determined
+  long bytePosition(uint32_t ms) {
+    seek_pos = -1;
+    switch (format_type) {
+      case WAV: {
+        if (byte_rate <= 0) return -1;
+        uint64_t offset = (uint64_t)ms * byte_rate / 1000;
+        if (block_align > 0) offset -= offset % block_align;
+        if (data_length > 0 && offset > data_length) return -1;
+        return data_start + offset;
+      }
+      case MP3:
+      case ADTS:
+      case MP4: {
+        if (rate == 0) return -1;
+        uint64_t t = (uint64_t)ms * rate / 1000;
+        if (!points.empty() && t <= indexed_time) {
+          SeekPoint &point = points[find(points, t)];
+          seek_pos = point.pos;
+          seek_time = point.time;
+          return point.pos;
+        }
+        if (!toc.empty()) return estimate(t);
+        if (scanned_time > 0 && !points.empty()) {
+          return indexed_pos + (t - indexed_time) * scanned_bytes / scanned_time;
+        }
+        return -1;
+      }
+      default:
+        return -1;
+    }
+  }
+
+  /// Informs the index that the stream continues at the indicated position
+  /// (after a seek)
+  void setStreamPosition(size_t pos) {
+    is_exact = format_type == WAV || (long)pos == seek_pos;
+    if ((long)pos == seek_pos) time = seek_time;
+    stream_pos = pos;
+    if (state == FRAMES) {
+      next_frame = pos;
+      hdr_len = 0;
+    }
+  }
+
+  /// Position of the next byte which is expected by write()
+  size_t streamPosition() { return stream_pos; }
+
+  /// Provides the detected format
+  Format format() { return format_type; }
+
+  /// Provides the duration in ms if it is known: 0 otherwise
+  uint32_t durationMs() {
+    if (format_type == WAV) {
+      return byte_rate > 0 ? (uint64_t)data_length * 1000 / byte_rate : 0;
+    }
+    return rate > 0 ? (uint64_t)total_time * 1000 / rate : 0;
+  }
+
+  /// Number of entries in the sparse index
+  int size() { return points.size(); }
+
+  /// Frame information from MP3 and ADTS headers
+  struct FrameInfo {
+    uint32_t len = 0;
+    uint32_t samples = 0;
+    uint32_t rate = 0;
+    int side_info = 0;
+  };
+
+  /// Parses a 4 byte MP3 frame header
+  static bool parseMP3(const uint8_t *h, FrameInfo &info) {
+    static const uint16_t bitrates[5][15] = {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}};
+    static const uint16_t rates[3] = {44100, 48000, 32000};
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) return false;
+    int version = (h[1] >> 3) & 3;  // 0: 2.5, 2: 2, 3: 1
+    int layer = 4 - ((h[1] >> 1) & 3);
+    int bitrate_idx = h[2] >> 4;
+    int rate_idx = (h[2] >> 2) & 3;
+    if (version == 1 || layer == 4 || bitrate_idx == 0 || bitrate_idx == 15 ||
+        rate_idx == 3) {
+      return false;
+    }
+    bool is_v1 = version == 3;
+    int table = is_v1 ? layer - 1 : (layer == 1 ? 3 : 4);
+    uint32_t bitrate = bitrates[table][bitrate_idx] * 1000;
+    info.rate = rates[rate_idx] >> (is_v1 ? 0 : (version == 2 ? 1 : 2));
+    int padding = (h[2] >> 1) & 1;
+    bool is_mono = (h[3] >> 6) == 3;
+    if (layer == 1) {
+      info.samples = 384;
+      info.len = (12 * bitrate / info.rate + padding) * 4;
+    } else {
+      info.samples = (layer == 3 && !is_v1) ? 576 : 1152;
+      info.len = info.samples / 8 * bitrate / info.rate + padding;
+    }
+    info.side_info = is_v1 ? (is_mono ? 17 : 32) : (is_mono ? 9 : 17);
+    return true;
+  }
+
+ protected:
+  enum State { PROBE, FRAMES, ATOMS, DONE };
+  static constexpr int PROBE_SIZE = 512;
+  State state = PROBE;
+  Format format_type = UNKNOWN;
+  Vector<SeekPoint> points{0, ColdAllocator};
+  /// estimated positions from the Xing or VBRI TOC
+  Vector<SeekPoint> toc{0, ColdAllocator};
+  Vector<uint8_t> probe{0};
+  size_t probe_start = 0;
+  size_t stream_pos = 0;
+  size_t skip_to = 0;
+  uint32_t interval_ms = 1000;
+  uint32_t interval = 1000;
+  int max_entries = 512;
+  uint32_t rate = 0;
+  uint64_t time = 0;
+  uint64_t total_time = 0;
+  uint64_t indexed_time = 0;
+  size_t indexed_pos = 0;
+  uint64_t scanned_bytes = 0;
+  uint64_t scanned_time = 0;
+  bool is_exact = true;
+  long seek_pos = -1;
+  uint32_t seek_time = 0;
+  // wav
+  size_t data_start = 0;
+  int byte_rate = 0;
+  int block_align = 0;
+  uint32_t data_length = 0;
+  // frames
+  size_t next_frame = 0;
+  uint8_t hdr[8];
+  int hdr_len = 0;
+  // mp4 atoms
+  size_t atom_pos = 0;
+  uint8_t atom_hdr[16];
+  int atom_hdr_len = 0;
+  uint32_t atom_type = 0;
+  bool in_atom = false;
+  uint32_t word = 0;
+  uint32_t data_idx = 0;
+  uint32_t mdhd_version = 0;
+  uint32_t timescale = 0;
+  bool is_sound_track = false;
+  bool is_mp4_indexed = false;
+  uint32_t sample_delta = 0;
+  uint32_t chunk_count = 0;
+  uint64_t chunk_samples = 0;
+  /// pairs of first chunk and samples per chunk
+  Vector<uint32_t> stsc{0};
+  int stsc_idx = 0;
+
+  size_t process(const uint8_t *data, size_t len) {
+    // skip data which is not relevant
+    if (stream_pos < skip_to) {
+      size_t n = min(len, skip_to - stream_pos);
+      stream_pos += n;
+      return n;
+    }
+    switch (state) {
+      case PROBE:
+        return probeData(data, len);
+      case FRAMES:
+        return scanFrames(data, len);
+      case ATOMS:
+        return parseAtoms(data, len);
+      default:
+        stream_pos += len;
+        return len;
+    }
+  }
+
+  static uint32_t read32(const uint8_t *data) {
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+           (uint32_t)data[2] << 8 | data[3];
+  }
+
+  static uint32_t tag(const char *str) { return read32((const uint8_t *)str); }
+
+  /// Collects the start of the stream to determine the format
+  size_t probeData(const uint8_t *data, size_t len) {
+    if (probe.empty()) probe_start = stream_pos;
+    size_t size = probe.size();
+    size_t n = min(len, (size_t)PROBE_SIZE - size);
+    probe.resize(size + n);
+    memcpy(probe.data() + size, data, n);
+    stream_pos += n;
+
+    // skip ID3v2 tags
+    while (probe.size() >= 10 && memcmp(probe.data(), "ID3", 3) == 0) {
+      size_t tag_size = 10 + ((probe[6] & 0x7f) << 21 | (probe[7] & 0x7f) << 14 |
+                              (probe[8] & 0x7f) << 7 | (probe[9] & 0x7f));
+      if (probe[5] & 0x10) tag_size += 10;
+      if (tag_size <= probe.size()) {
+        memmove(probe.data(), probe.data() + tag_size, probe.size() - tag_size);
+        probe.resize(probe.size() - tag_size);
+        probe_start += tag_size;
+      } else {
+        skip_to = probe_start + tag_size;
+        probe.resize(0);
+        return n;
+      }
+    }
+    if (probe.size() < PROBE_SIZE) return n;
+
+    detect();
+    // replay the probe data with the new state
+    if (state != DONE && state != PROBE) {
+      Vector<uint8_t> tmp{0};
+      tmp.swap(probe);
+      stream_pos = probe_start;
+      write(tmp.data(), tmp.size());
+    }
+    probe.resize(0);
+    return n;
+  }
+
+  void detect() {
+    state = DONE;
+    if (memcmp(probe.data(), "RIFF", 4) == 0) {
+      detectWAV();
+    } else if (memcmp(probe.data() + 4, "ftyp", 4) == 0) {
+      format_type = MP4;
+      state = ATOMS;
+      atom_pos = probe_start;
+      atom_hdr_len = 0;
+      in_atom = false;
+    } else {
+      detectFrames();
+    }
+    LOGI("SeekIndex format: %d", format_type);
+  }
+
+  void detectWAV() {
+    WAVHeader header;
+    header.write(probe.data(), 44);
+    header.parse();
+    WAVAudioInfo &wav = header.audioInfo();
+    if (header.soundPos() == 0 || wav.byte_rate <= 0) {
+      LOGW("SeekIndex: unsupported WAV header");
+      return;
+    }
+    format_type = WAV;
+    data_start = probe_start + header.soundPos();
+    byte_rate = wav.byte_rate;
+    block_align = wav.block_align;
+    data_length = wav.data_length;
+  }
+
+  void detectFrames() {
+    FrameInfo info;
+    int size = probe.size();
+    for (int j = 0; j + 8 < size; j++) {
+      Format fmt = UNKNOWN;
+      if (parseMP3(probe.data() + j, info)) fmt = MP3;
+      else if (parseADTS(probe.data() + j, info)) fmt = ADTS;
+      if (fmt == UNKNOWN) continue;
+      // confirm with the next frame header
+      FrameInfo next;
+      int next_pos = j + info.len;
+      if (next_pos + 8 < size &&
+          !(fmt == MP3 ? parseMP3(probe.data() + next_pos, next)
+                       : parseADTS(probe.data() + next_pos, next))) {
+        continue;
+      }
+      format_type = fmt;
+      state = FRAMES;
+      rate = info.rate;
+      next_frame = probe_start + j;
+      hdr_len = 0;
+      if (fmt == MP3) readTOC(j, info);
+      return;
+    }
+  }
+
+  /// Reads the Xing or VBRI header of the first MP3 frame
+  void readTOC(int pos, FrameInfo &info) {
+    const uint8_t *frame = probe.data() + pos;
+    int avail = probe.size() - pos;
+    int xing = 4 + info.side_info;
+    if (avail >= xing + 120 && (memcmp(frame + xing, "Xing", 4) == 0 ||
+                                memcmp(frame + xing, "Info", 4) == 0)) {
+      uint32_t flags = read32(frame + xing + 4);
+      const uint8_t *ptr = frame + xing + 8;
+      uint32_t frames = 0, bytes = 0;
+      if (flags & 1) {
+        frames = read32(ptr);
+        ptr += 4;
+      }
+      if (flags & 2) {
+        bytes = read32(ptr);
+        ptr += 4;
+      }
+      total_time = (uint64_t)frames * info.samples;
+      if ((flags & 4) && bytes > 0 && frames > 0) {
+        toc.resize(100);
+        for (int j = 0; j < 100; j++) {
+          toc[j].time = total_time * j / 100;
+          toc[j].pos = probe_start + pos + (uint64_t)ptr[j] * bytes / 256;
+        }
+      }
+      // the Xing frame does not contain any audio
+      next_frame += info.len;
+      return;
+    }
+    const uint8_t *vbri = frame + 36;
+    if (avail >= 36 + 26 && memcmp(vbri, "VBRI", 4) == 0) {
+      uint32_t frames = read32(vbri + 14);
+      int entries = vbri[18] << 8 | vbri[19];
+      int scale = vbri[20] << 8 | vbri[21];
+      int entry_size = vbri[22] << 8 | vbri[23];
+      int frames_per_entry = vbri[24] << 8 | vbri[25];
+      total_time = (uint64_t)frames * info.samples;
+      if (avail >= 36 + 26 + entries * entry_size && entry_size <= 4) {
+        const uint8_t *ptr = vbri + 26;
+        uint32_t offset = probe_start + pos;
+        toc.resize(entries + 1);
+        for (int j = 0; j <= entries; j++) {
+          toc[j].time = (uint64_t)j * frames_per_entry * info.samples;
+          toc[j].pos = offset;
+          if (j == entries) break;
+          uint32_t value = 0;
+          for (int k = 0; k < entry_size; k++) value = value << 8 | *ptr++;
+          offset += value * scale;
+        }
+      }
+      next_frame += info.len;
+    }
+  }
+
+  static bool parseADTS(const uint8_t *h, FrameInfo &info) {
+    static const uint32_t rates[13] = {96000, 88200, 64000, 48000, 44100,
+                                       32000, 24000, 22050, 16000, 12000,
+                                       11025, 8000,  7350};
+    if (h[0] != 0xFF || (h[1] & 0xF6) != 0xF0) return false;
+    int rate_idx = (h[2] >> 2) & 0xF;
+    if (rate_idx > 12) return false;
+    info.len = ((h[3] & 0x3) << 11) | (h[4] << 3) | (h[5] >> 5);
+    if (info.len < 7) return false;
+    info.rate = rates[rate_idx];
+    info.samples = ((h[6] & 0x3) + 1) * 1024;
+    return true;
+  }
+
+  /// Scans the frame headers and adds the index entries
+  size_t scanFrames(const uint8_t *data, size_t len) {
+    if (stream_pos < next_frame) {
+      size_t n = min(len, next_frame - stream_pos);
+      stream_pos += n;
+      return n;
+    }
+    int hdr_size = format_type == MP3 ? 4 : 7;
+    hdr[hdr_len++] = data[0];
+    stream_pos++;
+    if (hdr_len < hdr_size) return 1;
+    FrameInfo info;
+    bool ok = format_type == MP3 ? parseMP3(hdr, info) : parseADTS(hdr, info);
+    if (ok) {
+      addFrame(next_frame, info);
+      next_frame += info.len;
+      hdr_len = 0;
+    } else {
+      // lost sync: we search the next header
+      is_exact = false;
+      memmove(hdr, hdr + 1, --hdr_len);
+      next_frame++;
+    }
+    return 1;
+  }
+
+  void addFrame(size_t pos, FrameInfo &info) {
+    if (is_exact) {
+      if (time >= indexed_time) {
+        addPoint(time, pos);
+        indexed_time = time;
+        indexed_pos = pos;
+      }
+    }
+    time += info.samples;
+    scanned_bytes += info.len;
+    scanned_time += info.samples;
+  }
+
+  /// Adds an entry if the distance to the last entry is >= the interval
+  void addPoint(uint64_t t, size_t pos) {
+    if (!points.empty() &&
+        t < points[points.size() - 1].time + (uint64_t)interval * rate / 1000) {
+      return;
+    }
+    if (points.size() >= max_entries) {
+      // keep every second entry
+      int size = points.size();
+      for (int j = 0; j < size / 2; j++) points[j] = points[j * 2];
+      points.resize(size / 2);
+      interval *= 2;
+    }
+    SeekPoint point;
+    point.time = t;
+    point.pos = pos;
+    points.push_back(point);
+  }
+
+  /// Binary search for the last entry with time <= t
+  static int find(Vector<SeekPoint> &vector, uint64_t t) {
+    int low = 0;
+    int high = vector.size() - 1;
+    while (low < high) {
+      int mid = (low + high + 1) / 2;
+      if (vector[mid].time <= t) {
+        low = mid;
+      } else {
+        high = mid - 1;
+      }
+    }
+    return low;
+  }
+
+  /// Interpolates the position from the TOC
+  long estimate(uint64_t t) {
+    int idx = find(toc, t);
+    SeekPoint &from = toc[idx];
+    if (idx + 1 >= (int)toc.size() || t <= from.time) return from.pos;
+    SeekPoint &to = toc[idx + 1];
+    return from.pos +
+           (t - from.time) * (to.pos - from.pos) / (to.time - from.time);
+  }
+
+  /// Walks through the MP4 atoms: only the relevant atoms are parsed
+  size_t parseAtoms(const uint8_t *data, size_t len) {
+    if (in_atom) {
+      size_t n = min(len, atom_pos - stream_pos);
+      for (size_t j = 0; j < n; j++) atomByte(data[j]);
+      stream_pos += n;
+      if (stream_pos == atom_pos) in_atom = false;
+      return n;
+    }
+    if (stream_pos < atom_pos) {
+      size_t n = min(len, atom_pos - stream_pos);
+      stream_pos += n;
+      return n;
+    }
+    atom_hdr[atom_hdr_len++] = data[0];
+    stream_pos++;
+    if (atom_hdr_len < 8) return 1;
+    uint64_t size = read32(atom_hdr);
+    if (size == 1) {
+      // 64 bit size
+      if (atom_hdr_len < 16) return 1;
+      size = (uint64_t)read32(atom_hdr + 8) << 32 | read32(atom_hdr + 12);
+    }
+    int hdr_size = atom_hdr_len;
+    atom_hdr_len = 0;
+    atom_type = read32(atom_hdr + 4);
+    if (size < (uint64_t)hdr_size) {
+      // size 0 (up to the end) or invalid
+      state = DONE;
+      return 1;
+    }
+    if (atom_type == tag("moov") || atom_type == tag("trak") ||
+        atom_type == tag("mdia") || atom_type == tag("minf") ||
+        atom_type == tag("stbl")) {
+      // continue with the child atoms
+      atom_pos = stream_pos;
+      return 1;
+    }
+    atom_pos = stream_pos - hdr_size + size;
+    if (atom_type == tag("mdhd") || atom_type == tag("hdlr") ||
+        (is_sound_track && !is_mp4_indexed &&
+         (atom_type == tag("stts") || atom_type == tag("stsc") ||
+          atom_type == tag("stco") || atom_type == tag("co64")))) {
+      in_atom = true;
+      data_idx = 0;
+    }
+    return 1;
+  }
+
+  void atomByte(uint8_t value) {
+    word = word << 8 | value;
+    if (++data_idx % 4 == 0) atomWord(data_idx / 4 - 1, word);
+  }
+
+  void atomWord(uint32_t idx, uint32_t value) {
+    if (atom_type == tag("mdhd")) {
+      if (idx == 0) mdhd_version = value >> 24;
+      if (idx == (mdhd_version == 1 ? 5u : 3u)) timescale = value;
+    } else if (atom_type == tag("hdlr")) {
+      if (idx == 2) is_sound_track = value == tag("soun");
+    } else if (atom_type == tag("stts")) {
+      if (idx == 3) sample_delta = value;
+    } else if (atom_type == tag("stsc")) {
+      if (idx >= 2 && (idx - 2) % 3 < 2) stsc.push_back(value);
+    } else if (atom_type == tag("stco")) {
+      if (idx == 1) chunk_count = value;
+      if (idx >= 2) addChunk(idx - 1, value);
+    } else if (atom_type == tag("co64")) {
+      if (idx == 1) chunk_count = value;
+      if (idx >= 2 && (idx - 2) % 2 == 1) addChunk((idx - 2) / 2 + 1, value);
+    }
+  }
+
+  /// Adds an index entry for the chunk (1 based) of the sound track
+  void addChunk(uint32_t chunk, uint32_t offset) {
+    if (chunk == 1) {
+      rate = timescale;
+      if (sample_delta == 0) sample_delta = 1024;
+    }
+    // samples per chunk from the stsc table
+    while (stsc_idx + 3 < (int)stsc.size() && stsc[stsc_idx + 2] <= chunk) {
+      stsc_idx += 2;
+    }
+    uint32_t samples = stsc.size() >= 2 ? stsc[stsc_idx + 1] : 1;
+    addPoint(chunk_samples * sample_delta, offset);
+    chunk_samples += samples;
+    if (chunk == chunk_count) {
+      is_mp4_indexed = true;
+      total_time = chunk_samples * sample_delta;
+      indexed_time = total_time;
+    }
+  }
+};
+
+}  // namespace audio_tools
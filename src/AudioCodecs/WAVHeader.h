@@ -0,0 +1,275 @@
+#pragma once
+
+#include "AudioCodecs/AudioCodecsBase.h"
+#include "AudioCodecs/AudioFormat.h"
+#include "AudioTools/Buffers.h"
+
+#define TAG(a, b, c, d)                                                  \
+  ((static_cast<uint32_t>(a) << 24) | (static_cast<uint32_t>(b) << 16) | \
+   (static_cast<uint32_t>(c) << 8) | (d))
+#define READ_BUFFER_SIZE 512
+
+namespace audio_tools {
+
+/**
+ * @brief Sound information which is available in the WAV header
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ *
+ */
+struct WAVAudioInfo : AudioInfo {
+  WAVAudioInfo() = default;
+  WAVAudioInfo(const AudioInfo &from) {
+    sample_rate = from.sample_rate;
+    channels = from.channels;
+    bits_per_sample = from.bits_per_sample;
+  }
+
+  AudioFormat format = AudioFormat::PCM;
+  int byte_rate = 0;
+  int block_align = 0;
+  bool is_streamed = true;
+  bool is_valid = false;
+  uint32_t data_length = 0;
+  uint32_t file_size = 0;
+  int offset = 0;
+};
+
+static const char *wav_mime = "audio/wav";
+
+/**
+ * @brief Parser for Wav header data
+ * for details see https://de.wikipedia.org/wiki/RIFF_WAVE
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ *
+ */
+class WAVHeader {
+ public:
+  WAVHeader() = default;
+
+  /// Adds data to the 44 byte wav header data buffer and make it available for parsing
+  int write(uint8_t *data, size_t data_len) {
+    int write_len = min(data_len, 44 - len);
+    memmove(buffer + len, data, write_len);
+    len += write_len;
+    LOGI("WAVHeader::write: %u -> %d -> %d", (unsigned)data_len, write_len,
+         (int)len);
+    return write_len;
+  }
+
+  /// Call begin when header data is complete to parse the data
+  void parse() {
+    LOGI("WAVHeader::begin: %u", (unsigned)len);
+    this->data_pos = 0l;
+    memset((void *)&headerInfo, 0, sizeof(WAVAudioInfo));
+    while (!eof()) {
+      uint32_t tag, tag2, length;
+      tag = read_tag();
+      if (eof()) break;
+      length = read_int32();
+      if (!length || length >= 0x7fff0000) {
+        headerInfo.is_streamed = true;
+        length = ~0;
+      }
+      if (tag != TAG('R', 'I', 'F', 'F') || length < 4) {
+        seek(length, SEEK_CUR);
+        continue;
+      }
+      headerInfo.file_size = length;
+      tag2 = read_tag();
+      length -= 4;
+      if (tag2 != TAG('W', 'A', 'V', 'E')) {
+        seek(length, SEEK_CUR);
+        continue;
+      }
+      // RIFF chunk found, iterate through it
+      while (length >= 8) {
+        uint32_t subtag, sublength;
+        subtag = read_tag();
+        if (eof()) break;
+        sublength = read_int32();
+        length -= 8;
+        if (length < sublength) break;
+        if (subtag == TAG('f', 'm', 't', ' ')) {
+          if (sublength < 16) {
+            // Insufficient data for 'fmt '
+            break;
+          }
+          headerInfo.format = (AudioFormat)read_int16();
+          headerInfo.channels = read_int16();
+          headerInfo.sample_rate = read_int32();
+          headerInfo.byte_rate = read_int32();
+          headerInfo.block_align = read_int16();
+          headerInfo.bits_per_sample = read_int16();
+          if (headerInfo.format == (AudioFormat) 0xfffe) {
+            if (sublength < 28) {
+              // Insufficient data for waveformatex
+              break;
+            }
+            skip(8);
+            headerInfo.format = (AudioFormat)read_int32();
+            skip(sublength - 28);
+          } else {
+            skip(sublength - 16);
+          }
+          headerInfo.is_valid = true;
+        } else if (subtag == TAG('d', 'a', 't', 'a')) {
+          sound_pos = tell();
+          headerInfo.data_length = sublength;
+          if (!headerInfo.data_length || headerInfo.is_streamed) {
+            headerInfo.is_streamed = true;
+            logInfo();
+            return;
+          }
+          seek(sublength, SEEK_CUR);
+        } else {
+          skip(sublength);
+        }
+        length -= sublength;
+      }
+      if (length > 0) {
+        // Bad chunk?
+        seek(length, SEEK_CUR);
+      }
+    }
+    logInfo();
+    len = 0;
+  }
+
+  /// Returns true if the header is complete (with 44 bytes)
+  bool isDataComplete() { return len == 44; }
+
+  /// Discards the collected header data
+  void clear() {
+    len = 0;
+    data_pos = 0;
+  }
+
+  /// provides the info from the header
+  WAVAudioInfo &audioInfo() { return headerInfo; }
+
+  /// Position of the sound data (after the data chunk header): 0 if not found
+  size_t soundPos() { return sound_pos; }
+
+  /// Sets the info in the header
+  void setAudioInfo(WAVAudioInfo info){
+    headerInfo = info;
+  }
+
+  /// Just write a wav header to the indicated output
+  void writeHeader(Print *out) {
+    SingleBuffer<uint8_t> buffer(50);
+    writeRiffHeader(buffer);
+    writeFMT(buffer);
+    writeDataHeader(buffer);
+    len = buffer.available();
+    out->write(buffer.data(), buffer.available());
+  }
+
+ protected:
+  struct WAVAudioInfo headerInfo;
+  uint8_t buffer[44];
+  size_t len = 0;
+  size_t data_pos = 0;
+  size_t sound_pos = 0;
+
+  uint32_t read_tag() {
+    uint32_t tag = 0;
+    tag = (tag << 8) | getChar();
+    tag = (tag << 8) | getChar();
+    tag = (tag << 8) | getChar();
+    tag = (tag << 8) | getChar();
+    return tag;
+  }
+
+  uint32_t getChar32() { return getChar(); }
+
+  uint32_t read_int32() {
+    uint32_t value = 0;
+    value |= getChar32() << 0;
+    value |= getChar32() << 8;
+    value |= getChar32() << 16;
+    value |= getChar32() << 24;
+    return value;
+  }
+
+  uint16_t read_int16() {
+    uint16_t value = 0;
+    value |= getChar() << 0;
+    value |= getChar() << 8;
+    return value;
+  }
+
+  void skip(int n) {
+    int i;
+    for (i = 0; i < n; i++) getChar();
+  }
+
+  int getChar() {
+    if (data_pos < len)
+      return buffer[data_pos++];
+    else
+      return -1;
+  }
+
+  void seek(long int offset, int origin) {
+    if (origin == SEEK_SET) {
+      data_pos = offset;
+    } else if (origin == SEEK_CUR) {
+      data_pos += offset;
+    }
+  }
+
+  size_t tell() { return data_pos; }
+
+  bool eof() { return data_pos >= len - 1; }
+
+  void logInfo() {
+    LOGI("WAVHeader sound_pos: %lu", (unsigned long)sound_pos);
+    LOGI("WAVHeader channels: %d ", headerInfo.channels);
+    LOGI("WAVHeader bits_per_sample: %d", headerInfo.bits_per_sample);
+    LOGI("WAVHeader sample_rate: %d ", (int) headerInfo.sample_rate);
+    LOGI("WAVHeader format: %d", (int)headerInfo.format);
+  }
+
+  void writeRiffHeader(BaseBuffer<uint8_t> &buffer) {
+    buffer.writeArray((uint8_t *)"RIFF", 4);
+    write32(buffer, headerInfo.file_size - 8);
+    buffer.writeArray((uint8_t *)"WAVE", 4);
+  }
+
+  void writeFMT(BaseBuffer<uint8_t> &buffer) {
+    uint16_t fmt_len = 16;
+    buffer.writeArray((uint8_t *)"fmt ", 4);
+    write32(buffer, fmt_len);
+    write16(buffer, (uint16_t)headerInfo.format);  // PCM
+    write16(buffer, headerInfo.channels);
+    write32(buffer, headerInfo.sample_rate);
+    write32(buffer, headerInfo.byte_rate);
+    write16(buffer, headerInfo.block_align);  // frame size
+    write16(buffer, headerInfo.bits_per_sample);
+  }
+
+  void write32(BaseBuffer<uint8_t> &buffer, uint64_t value) {
+    buffer.writeArray((uint8_t *)&value, 4);
+  }
+
+  void write16(BaseBuffer<uint8_t> &buffer, uint16_t value) {
+    buffer.writeArray((uint8_t *)&value, 2);
+  }
+
+  void writeDataHeader(BaseBuffer<uint8_t> &buffer) {
+    buffer.writeArray((uint8_t *)"data", 4);
+    write32(buffer, headerInfo.data_length);
+    int offset = headerInfo.offset;
+    if (offset > 0) {
+      uint8_t empty[offset];
+      memset(empty, 0, offset);
+      buffer.writeArray(empty, offset);  // resolve issue with wrong aligment
+    }
+  }
+
+};
+
+}  // namespace audio_tools
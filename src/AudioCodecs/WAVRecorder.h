@@ -0,0 +1,254 @@
+#pragma once
+
+#include "AudioCodecs/CodecWAV.h"
+#include "AudioTools/AsyncOutputQueue.h"
+#include "AudioTools/AudioOutput.h"
+#ifdef USE_CONCURRENCY
+#  include "Concurrency/Task.h"
+#endif
+
+/// Size of the blocks which are written to the file
+#ifndef WAV_RECORDER_BLOCK_SIZE
+#  define WAV_RECORDER_BLOCK_SIZE (32 * 1024)
+#endif
+
+/// Size of the queue between write() and the file writer
+#ifndef WAV_RECORDER_QUEUE_SIZE
+#  define WAV_RECORDER_QUEUE_SIZE (64 * 1024)
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Long running recording of PCM data into a WAV file (e.g. on a SD
+ * card): write() only adds the data to a queue, so that it never waits for
+ * the file. The writer (drain() or the writer task) collects the data into
+ * blocks of 32 KB which are written at aligned file positions: the first
+ * block contains the header. The RIFF and data sizes in the header are
+ * updated periodically, so that the file is valid even after a power loss.
+ *
+ * With setPreallocate() we write the indicated number of bytes at begin(),
+ * so that the file system does not need to allocate clusters during the
+ * recording. The header always reports the recorded size: the unused
+ * preallocated bytes follow the data chunk.
+ *
+ * The FileType must support write(), seek() and flush().
+ * @ingroup codecs
+ * @ingroup encoder
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <class FileType>
+class WAVRecorderT : public AudioOutput {
+ public:
+  WAVRecorderT() = default;
+  WAVRecorderT(FileType &file) { setFile(file); }
+  ~WAVRecorderT() { end(); }
+
+  /// Defines the (open) file which is used for the recording
+  void setFile(FileType &file) { p_file = &file; }
+
+  /// Defines the size of the blocks which are written to the file
+  void setBlockSize(int size) { block_size = size; }
+
+  /// Defines the size of the queue which must hold the data that arrives
+  /// while a block is written and what happens when it is full
+  void setQueueSize(int size, AsyncOutputPolicy policy = AsyncOutputSkip) {
+    queue_size = size;
+    queue_policy = policy;
+  }
+
+  /// Number of bytes which are reserved in the file at begin()
+  void setPreallocate(uint32_t bytes) { preallocate_size = bytes; }
+
+  /// Updates the header after the indicated number of blocks: 0 updates it
+  /// only in end()
+  void setHeaderUpdateBlocks(int blocks) { header_update_blocks = blocks; }
+
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    TRACED();
+    if (p_file == nullptr || !cfg) {
+      LOGE("file or AudioInfo not defined");
+      return false;
+    }
+    end();
+    block.resize(block_size);
+    delete p_queue;
+    p_queue = new AsyncOutputQueue(queue_size, queue_policy);
+    data_length = 0;
+    file_pos = 0;
+    blocks_written = 0;
+    if (preallocate_size > 0) preallocate();
+    p_file->seek(0);
+    // the header is written with the first block
+    block_pos = writeHeader(block.data());
+    is_active = true;
+    return true;
+  }
+
+  /// Adds the data to the queue: if there is no writer task we write the
+  /// full blocks to the file
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!is_active) return 0;
+    p_queue->write(data, len);
+#ifdef USE_CONCURRENCY
+    if (is_writer_task) return len;
+#endif
+    drain();
+    return len;
+  }
+
+  /// Poll step: moves the queued data into the blocks and writes the full
+  /// blocks to the file. Call it from the loop or from a separate task.
+  void drain() {
+    if (p_queue == nullptr) return;
+    while (true) {
+      int len = p_queue->read(block.data() + block_pos, block_size - block_pos);
+      if (len <= 0) break;
+      block_pos += len;
+      data_length += len;
+      if (block_pos == block_size) writeBlock();
+    }
+  }
+
+  /// Writes the remaining data and the final header
+  void end() override {
+    if (!is_active) return;
+    TRACED();
+#ifdef USE_CONCURRENCY
+    endWriterTask();
+#endif
+    is_active = false;
+    drain();
+    if (block_pos > 0) writeBlock();
+    updateHeader();
+    delete p_queue;
+    p_queue = nullptr;
+    block.reset();
+  }
+
+#ifdef USE_CONCURRENCY
+  /// Starts a task which writes the queued data to the file
+  bool beginWriterTask(int stackSize = 3 * 1024, int priority = 1,
+                       int core = -1) {
+    if (is_writer_task) return false;
+    writer_task.create("wav-recorder", stackSize, priority, core);
+    is_writer_task = true;
+    return writer_task.begin([this]() {
+      drain();
+      delay(1);
+    });
+  }
+
+  /// Stops the writer task
+  void endWriterTask() {
+    if (!is_writer_task) return;
+    writer_task.remove();
+    is_writer_task = false;
+  }
+#endif
+
+  /// Number of recorded PCM bytes
+  uint32_t dataLength() { return data_length; }
+
+  /// Number of bytes which were discarded because the queue was full
+  uint32_t droppedBytes() {
+    return p_queue == nullptr ? 0 : p_queue->droppedBytes();
+  }
+
+  /// Max number of bytes which were queued
+  int maxLagBytes() { return p_queue == nullptr ? 0 : p_queue->maxLagBytes(); }
+
+ protected:
+  FileType *p_file = nullptr;
+  AsyncOutputQueue *p_queue = nullptr;
+  Vector<uint8_t> block{0};
+  int block_size = WAV_RECORDER_BLOCK_SIZE;
+  int block_pos = 0;
+  int queue_size = WAV_RECORDER_QUEUE_SIZE;
+  AsyncOutputPolicy queue_policy = AsyncOutputSkip;
+  uint32_t preallocate_size = 0;
+  int header_update_blocks = 8;
+  uint32_t data_length = 0;
+  uint32_t file_pos = 0;
+  uint32_t blocks_written = 0;
+#ifdef USE_CONCURRENCY
+  Task writer_task;
+  bool is_writer_task = false;
+#endif
+
+  /// Collects the header into a memory buffer
+  class HeaderPrint : public Print {
+   public:
+    HeaderPrint(uint8_t *data) { p_data = data; }
+    size_t write(uint8_t ch) override {
+      p_data[len++] = ch;
+      return 1;
+    }
+    size_t write(const uint8_t *data, size_t size) override {
+      memcpy(p_data + len, data, size);
+      len += size;
+      return size;
+    }
+    size_t len = 0;
+
+   protected:
+    uint8_t *p_data;
+  };
+
+  /// Writes the header with the data length of the file to the indicated
+  /// memory
+  int writeHeader(uint8_t *data) {
+    uint32_t file_data_length = file_pos > 44 ? file_pos - 44 : 0;
+    WAVAudioInfo info(cfg);
+    info.format = AudioFormat::PCM;
+    info.byte_rate = cfg.sample_rate * cfg.channels * cfg.bits_per_sample / 8;
+    info.block_align = cfg.bits_per_sample / 8 * cfg.channels;
+    info.is_streamed = false;
+    info.data_length = file_data_length;
+    info.file_size = file_data_length + 44;
+    WAVHeader header;
+    header.setAudioInfo(info);
+    HeaderPrint out(data);
+    header.writeHeader(&out);
+    return out.len;
+  }
+
+  void writeBlock() {
+    p_file->write(block.data(), block_pos);
+    file_pos += block_pos;
+    block_pos = 0;
+    blocks_written++;
+    if (header_update_blocks > 0 && blocks_written % header_update_blocks == 0)
+      updateHeader();
+  }
+
+  /// Overwrites the header with the actual sizes and returns to the end of
+  /// the recorded data
+  void updateHeader() {
+    uint8_t header[44];
+    int len = writeHeader(header);
+    p_file->seek(0);
+    p_file->write(header, len);
+    p_file->seek(file_pos);
+    p_file->flush();
+  }
+
+  /// Writes empty blocks, so that the file system allocates the space
+  void preallocate() {
+    memset(block.data(), 0, block_size);
+    p_file->seek(0);
+    for (uint32_t pos = 0; pos < preallocate_size; pos += block_size) {
+      p_file->write(block.data(), min((uint32_t)block_size,
+                                      preallocate_size - pos));
+    }
+    p_file->flush();
+  }
+};
+
+}  // namespace audio_tools
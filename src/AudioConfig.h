@@ -50,6 +50,31 @@
 #  define PREFER_FIXEDPOINT false 
 #endif
 
+// Use the architecture specific (SIMD/DSP) implementation of the AudioKernels
+#ifndef USE_SIMD
+#  define USE_SIMD true
+#endif
+
+// Publish the results of the VolumeMeter and FFTDisplay with a lock free
+// Snapshot, so that they can be read from another task (requires std::atomic)
+#ifndef USE_SNAPSHOT
+#  if defined(__AVR__)
+#    define USE_SNAPSHOT false
+#  else
+#    define USE_SNAPSHOT true
+#  endif
+#endif
+
+// Support for the asynchronous outputs of the MultiOutput (requires
+// std::atomic)
+#ifndef USE_ASYNC_OUTPUT
+#  if defined(__AVR__)
+#    define USE_ASYNC_OUTPUT false
+#  else
+#    define USE_ASYNC_OUTPUT true
+#  endif
+#endif
+
 // Add automatic using namespace audio_tools;
 #ifndef USE_AUDIOTOOLS_NS
 #  define USE_AUDIOTOOLS_NS true
@@ -78,6 +103,35 @@
 #define LOG_PRINTF_BUFFER_SIZE 303
 #define LOG_METHOD __PRETTY_FUNCTION__
 
+// log statements below these levels are removed at compile time
+// (0: Debug, 1: Info, 2: Warning, 3: Error, 4: None)
+#ifndef LOG_MIN_LEVEL
+#  define LOG_MIN_LEVEL 0
+#endif
+#ifndef LOG_MIN_LEVEL_CODEC
+#  define LOG_MIN_LEVEL_CODEC LOG_MIN_LEVEL
+#endif
+#ifndef LOG_MIN_LEVEL_HTTP
+#  define LOG_MIN_LEVEL_HTTP LOG_MIN_LEVEL
+#endif
+#ifndef LOG_MIN_LEVEL_STREAM
+#  define LOG_MIN_LEVEL_STREAM LOG_MIN_LEVEL
+#endif
+#ifndef LOG_MIN_LEVEL_BUFFER
+#  define LOG_MIN_LEVEL_BUFFER LOG_MIN_LEVEL
+#endif
+
+// set USE_DEFERRED_LOGGING to true to be able to record the log messages w/o
+// formatting them in the calling (e.g. audio) task
+#ifndef USE_DEFERRED_LOGGING
+#  define USE_DEFERRED_LOGGING false
+#endif
+
+// number of log records which can be queued: must be a power of 2
+#ifndef LOG_DEFERRED_RECORDS
+#  define LOG_DEFERRED_RECORDS 32
+#endif
+
 // cheange USE_CHECK_MEMORY to true to activate memory checks
 #define USE_CHECK_MEMORY false
 
@@ -152,6 +206,11 @@
 #  define COPY_RETRY_LIMIT 20
 #endif
 
+/// Copy buffer size of the offline (batch) processing
+#ifndef BATCH_BUFFER_SIZE 
+#  define BATCH_BUFFER_SIZE (64 * 1024)
+#endif
+
 #ifndef MAX_SINGLE_CHARS
 #  define MAX_SINGLE_CHARS 8
 #endif
@@ -161,10 +220,25 @@
 #  define HTTP_MAX_LEN 1024
 #endif
 
+// size of the bulk read buffer for the http reply
+#ifndef HTTP_READ_BUFFER_SIZE
+#  define HTTP_READ_BUFFER_SIZE 512
+#endif
+
 #ifndef USE_RESAMPLE_BUFFER
 #  define USE_RESAMPLE_BUFFER true
 #endif
 
+// number of filter taps per phase for the polyphase resampler
+#ifndef RESAMPLE_POLYPHASE_TAPS
+#  define RESAMPLE_POLYPHASE_TAPS 16
+#endif
+
+// max number of phases (coefficient table rows) for the polyphase resampler
+#ifndef RESAMPLE_MAX_PHASES
+#  define RESAMPLE_MAX_PHASES 512
+#endif
+
 /**
  * @brief PWM
  */
@@ -723,6 +797,16 @@ using WiFiServerSecure = BearSSL::WiFiServerSecure;
 #define VS1053_EXT 1
 #define VS1053_DEFAULT_VOLUME 0.7
 
+//------ AudioEffects ----------
+// Use fixed point (Q15) instead of float arithmetic in the AudioEffects: by default on processors w/o FPU
+#ifndef USE_EFFECTS_Q15
+#  if defined(ESP32C3) || defined(ARDUINO_ARCH_RP2040) || defined(ARDUINO_ARCH_MBED_RP2040) || defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
+#    define USE_EFFECTS_Q15 true
+#  else
+#    define USE_EFFECTS_Q15 false
+#  endif
+#endif
+
 
 
 //----------------
@@ -771,6 +855,85 @@ typedef WiFiClient WiFiClientSecure;
 #  define URL_HANDSHAKE_TIMEOUT 120000
 #endif
 
+// max number of connections in the http connection pool
+#ifndef URL_POOL_SIZE
+#  define URL_POOL_SIZE 4
+#endif
+
+// idle connections are closed after this time
+#ifndef URL_POOL_MAX_IDLE_MS
+#  define URL_POOL_MAX_IDLE_MS 10000
+#endif
+
+// activates the measurements of the ProfilingStream and Pipeline::setProfiler()
+// #define USE_PROFILER
+
+// time to live of the cached DNS results
+#ifndef URL_DNS_CACHE_TTL_MS
+#  define URL_DNS_CACHE_TTL_MS 300000
+#endif
+
+// payload size of the UDPStream packet mode: fits into a 1500 byte MTU
+#ifndef UDP_PAYLOAD_SIZE
+#  define UDP_PAYLOAD_SIZE 1468
+#endif
+
+// depth of the UDPStream jitter buffer in packets
+#ifndef UDP_JITTER_MIN_PACKETS
+#  define UDP_JITTER_MIN_PACKETS 2
+#endif
+
+#ifndef UDP_JITTER_MAX_PACKETS
+#  define UDP_JITTER_MAX_PACKETS 16
+#endif
+
+// update interval and PI controller gains (ppm) of the VBAN drift compensation
+#ifndef VBAN_DRIFT_UPDATE_MS
+#  define VBAN_DRIFT_UPDATE_MS 100
+#endif
+
+#ifndef VBAN_DRIFT_KP
+#  define VBAN_DRIFT_KP 500.0f
+#endif
+
+#ifndef VBAN_DRIFT_KI
+#  define VBAN_DRIFT_KI 20.0f
+#endif
+
+// length of the gain ramp in samples when the OutputMixer weights are changed
+#ifndef OUTPUT_MIXER_RAMP_SAMPLES
+#  define OUTPUT_MIXER_RAMP_SAMPLES 256
+#endif
+
+// max number of channels of an OutputMixer input with format conversion
+#ifndef OUTPUT_MIXER_MAX_CHANNELS
+#  define OUTPUT_MIXER_MAX_CHANNELS 8
+#endif
+
+// number of FEC frames which are encoded with one call
+#ifndef FEC_BATCH_FRAMES
+#  define FEC_BATCH_FRAMES 4
+#endif
+
+// max number of listeners of the AudioServerMultiClient
+#ifndef AUDIO_SERVER_MAX_CLIENTS
+#  define AUDIO_SERVER_MAX_CLIENTS 8
+#endif
+
+// size of the shared encoded data of the AudioServerMultiClient
+#ifndef AUDIO_SERVER_BUFFER_SIZE
+#  define AUDIO_SERVER_BUFFER_SIZE 32 * 1024
+#endif
+
+// number of range requests to resume a dropped download
+#ifndef URL_RESUME_RETRIES
+#  define URL_RESUME_RETRIES 3
+#endif
+
+#ifndef URL_RESUME_DELAY_MS
+#  define URL_RESUME_DELAY_MS 500
+#endif
+
 #ifndef USE_TASK
 #  define USE_TASK false
 #endif
@@ -1,6 +1,9 @@
 #pragma once
 #include "AudioEffects/AudioParameters.h"
+#include "AudioEffects/DelayLine.h"
 #include "AudioEffects/PitchShift.h"
+#include "AudioEffects/LFO.h"
+#include "AudioTools/AudioKernels.h"
 #include "AudioTools/AudioLogger.h"
 #include "AudioTools/AudioTypes.h"
 #include <stdint.h>
@@ -11,7 +14,10 @@ namespace audio_tools {
 typedef int16_t effect_t;
 
 /**
- * @brief Abstract Base class for Sound Effects
+ * @brief Abstract Base class for Sound Effects. The effects can process a
+ * single sample or a block of samples: the block processing avoids a virtual
+ * call per sample. With USE_EFFECTS_Q15 the effects use fixed point
+ * instead of float arithmetic.
  * @ingroup effects
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -25,6 +31,12 @@ public:
   /// calculates the effect output from the input
   virtual effect_t process(effect_t in) = 0;
 
+  /// calculates the effect output for a block of samples (in place)
+  virtual void process(effect_t *data, size_t len) {
+    if (!active()) return;
+    for (size_t j = 0; j < len; j++) data[j] = process(data[j]);
+  }
+
   /// sets the effect active/inactive
   virtual void setActive(bool value) { active_flag = value; }
 
@@ -81,13 +93,40 @@ public:
   effect_t process(effect_t input) {
     if (!active())
       return input;
-    int32_t result = volume() * input;
+#if USE_EFFECTS_Q15
+    int32_t result = (static_cast<int64_t>(input) * gain) >> 16;
+#else
+    int32_t result = gain * input;
+#endif
     // clip to int16_t
     return clip(result);
   }
 
+  void process(effect_t *data, size_t len) {
+    if (!active())
+      return;
+    AudioKernels::applyGain(data, len, 1, &gain);
+  }
+
+  bool setVolume(float volume) override {
+    VolumeSupport::setVolume(volume);
+#if USE_EFFECTS_Q15
+    gain = AudioKernels::toGainQ16(volume);
+#else
+    gain = volume;
+#endif
+    return true;
+  }
+
   Boost *clone() { return new Boost(*this); }
 
+protected:
+#if USE_EFFECTS_Q15
+  int32_t gain = GAIN_Q16_ONE; // Q16.16
+#else
+  float gain = 1.0f;
+#endif
+
 };
 
 /**
@@ -123,6 +162,13 @@ public:
     return clip(input, p_clip_threashold, max_input);
   }
 
+  void process(effect_t *data, size_t len) {
+    if (!active())
+      return;
+    for (size_t j = 0; j < len; j++)
+      data[j] = clip(data[j], p_clip_threashold, max_input);
+  }
+
   Distortion *clone() { return new Distortion(*this); }
 
 protected:
@@ -141,13 +187,16 @@ class Fuzz : public AudioEffect {
 public:
   /// Fuzz Constructor: use e.g. effectValue=6.5; maxOut = 300
   Fuzz(float fuzzEffectValue = 6.5, uint16_t maxOut = 300) {
-    p_effect_value = fuzzEffectValue;
+    setFuzzEffectValue(fuzzEffectValue);
     max_out = maxOut;
   }
 
   Fuzz(const Fuzz &copy) = default;
 
-  void setFuzzEffectValue(float v) { p_effect_value = v; }
+  void setFuzzEffectValue(float v) {
+    p_effect_value = v;
+    effect_value_q8 = v * 256;
+  }
 
   float fuzzEffectValue() { return p_effect_value; }
 
@@ -158,20 +207,39 @@ public:
   effect_t process(effect_t input) {
     if (!active())
       return input;
-    float v = p_effect_value;
-    int32_t result = clip(v * input);
-    return map(result * v, -32768, +32767, -max_out, max_out);
+    return fuzz(input);
+  }
+
+  void process(effect_t *data, size_t len) {
+    if (!active())
+      return;
+    for (size_t j = 0; j < len; j++)
+      data[j] = fuzz(data[j]);
   }
 
   Fuzz *clone() { return new Fuzz(*this); }
 
 protected:
   float p_effect_value;
+  int32_t effect_value_q8; // Q8.8: the products fit into 32 bits
   uint16_t max_out;
+
+  inline effect_t fuzz(effect_t input) {
+#if USE_EFFECTS_Q15
+    int32_t result = clip((input * effect_value_q8) >> 8);
+    int32_t scaled = (result * effect_value_q8) >> 8;
+#else
+    float v = p_effect_value;
+    int32_t result = clip(v * input);
+    int32_t scaled = result * v;
+#endif
+    return map(scaled, -32768, +32767, -max_out, max_out);
+  }
 };
 
 /**
- * @brief Tremolo AudioEffect
+ * @brief Tremolo AudioEffect: the gain is modulated with a sine LFO which is
+ * based on the shared SineTable
  * @ingroup effects
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -186,44 +254,48 @@ public:
     this->duration_ms = duration_ms;
     this->sampleRate = sampleRate;
     this->p_percent = depthPercent;
-    int32_t rate_count = sampleRate * duration_ms / 1000;
-    rate_count_half = rate_count / 2;
+    // start at the minimum gain
+    lfo.setPhase(0.75f);
+    updateLFO();
+    updateFactors();
   }
 
   Tremolo(const Tremolo &copy) = default;
 
   void setDuration(int16_t ms) {
     this->duration_ms = ms;
-    int32_t rate_count = sampleRate * ms / 1000;
-    rate_count_half = rate_count / 2;
+    updateLFO();
   }
 
   int16_t duration() { return duration_ms; }
 
-  void setDepth(uint8_t percent) { p_percent = percent; }
+  void setDepth(uint8_t percent) {
+    p_percent = percent;
+    updateFactors();
+  }
 
   uint8_t depth() { return p_percent; }
 
+  /// Defines the waveform of the LFO (default Sine)
+  void setWaveform(LFO::Waveform waveform) { lfo.setWaveform(waveform); }
+
   effect_t process(effect_t input) {
     if (!active())
       return input;
+    return tremolo(input, lfo.next());
+  }
 
-    // limit value to max 100% and calculate factors
-    float tremolo_depth = p_percent > 100 ? 1.0 : 0.01 * p_percent;
-    float signal_depth = (100.0 - p_percent) / 100.0;
-
-    float tremolo_factor = tremolo_depth / rate_count_half;
-    int32_t out = (signal_depth * input) + (tremolo_factor * count * input);
-
-    // saw tooth shaped counter
-    count += inc;
-    if (count >= rate_count_half) {
-      inc = -1;
-    } else if (count <= 0) {
-      inc = +1;
+  void process(effect_t *data, size_t len) {
+    if (!active())
+      return;
+    // calculate the lfo values in blocks
+    int16_t values[32];
+    for (size_t pos = 0; pos < len; pos += 32) {
+      size_t n = min(len - pos, (size_t)32);
+      lfo.next(values, n);
+      for (size_t j = 0; j < n; j++)
+        data[pos + j] = tremolo(data[pos + j], values[j]);
     }
-
-    return clip(out);
   }
 
   Tremolo *clone() { return new Tremolo(*this); }
@@ -231,10 +303,127 @@ public:
 protected:
   int16_t duration_ms;
   uint32_t sampleRate;
-  int32_t count = 0;
-  int16_t inc = 1;
-  int32_t rate_count_half; // number of samples for on raise and fall
   uint8_t p_percent;
+  LFO lfo; // one cycle per duration
+#if USE_EFFECTS_Q15
+  int32_t signal_depth;   // Q15
+  int32_t tremolo_factor; // Q15
+#else
+  float signal_depth;
+  float tremolo_factor;
+#endif
+
+  void updateLFO() {
+    float ms = duration_ms > 0 ? duration_ms : 1;
+    lfo.setFrequency(1000.0f / ms, sampleRate);
+  }
+
+  /// limit value to max 100% and calculate factors
+  void updateFactors() {
+    int percent = p_percent > 100 ? 100 : p_percent;
+#if USE_EFFECTS_Q15
+    signal_depth = (100 - percent) * GAIN_Q15_ONE / 100;
+    tremolo_factor = percent * GAIN_Q15_ONE / 100;
+#else
+    signal_depth = (100.0f - percent) / 100.0f;
+    tremolo_factor = 0.01f * percent;
+#endif
+  }
+
+  /// the gain moves between signal_depth and 1.0 following the lfo
+  inline effect_t tremolo(effect_t input, int16_t lfo_value) {
+    // lfo in the range of 0 to 32767
+    int32_t lfo_pos = (lfo_value + 32768) >> 1;
+#if USE_EFFECTS_Q15
+    int32_t tremolo_depth = (lfo_pos * tremolo_factor) >> 15;
+    int32_t out = ((signal_depth + tremolo_depth) * input) >> 15;
+#else
+    int32_t out = (signal_depth + tremolo_factor * lfo_pos / 32768.0f) * input;
+#endif
+    return clip(out);
+  }
+};
+
+/**
+ * @brief Vibrato AudioEffect: the pitch is modulated by reading the signal
+ * from a delay line with a delay which follows the LFO.
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Vibrato : public AudioEffect {
+public:
+  /// e.g. rateHz=5, depthMs=2, sampleRate=44100
+  Vibrato(float rateHz = 5.0f, float depthMs = 2.0f,
+          uint32_t sampleRate = 44100) {
+    this->sampleRate = sampleRate;
+    this->rate = rateHz;
+    // the delay line is short and randomly accessed
+    buffer.setAllocator(DefaultAllocator);
+    setDepth(depthMs);
+  }
+
+  Vibrato(const Vibrato &copy) = default;
+
+  /// Defines the frequency of the modulation
+  void setRate(float hz) {
+    rate = hz;
+    lfo.setFrequency(rate, sampleRate);
+  }
+
+  float getRate() { return rate; }
+
+  /// Defines the max delay variation in ms
+  void setDepth(float ms) {
+    depth_ms = ms;
+    float depth_samples = ms * sampleRate / 1000.0f;
+    depth_q16 = depth_samples * 65536.0f;
+    // the delay moves between 1 and 1 + depth samples
+    buffer.resize(depth_samples + 2);
+    lfo.setFrequency(rate, sampleRate);
+  }
+
+  float getDepth() { return depth_ms; }
+
+  /// Defines the waveform of the LFO (default Sine)
+  void setWaveform(LFO::Waveform waveform) { lfo.setWaveform(waveform); }
+
+  effect_t process(effect_t input) {
+    if (!active())
+      return input;
+    buffer.write(input);
+    return buffer.readFraction(delay(lfo.next()), 1);
+  }
+
+  void process(effect_t *data, size_t len) {
+    if (!active())
+      return;
+    int16_t values[DELAY_LINE_BLOCK_SIZE];
+    for (size_t pos = 0; pos < len; pos += DELAY_LINE_BLOCK_SIZE) {
+      int n = min(len - pos, (size_t)DELAY_LINE_BLOCK_SIZE);
+      lfo.next(values, n);
+      buffer.write(data + pos, n);
+      for (int j = 0; j < n; j++)
+        data[pos + j] = buffer.readFraction(delay(values[j]), n - j);
+    }
+  }
+
+  Vibrato *clone() { return new Vibrato(*this); }
+
+protected:
+  DelayLine buffer;
+  LFO lfo;
+  uint32_t sampleRate;
+  float rate = 5.0f;
+  float depth_ms = 2.0f;
+  uint32_t depth_q16 = 0;
+
+  /// delay in 16.16 format for the lfo value
+  inline uint32_t delay(int16_t lfo_value) {
+    // lfo in the range of 0 to 32767
+    uint32_t lfo_pos = (lfo_value + 32768) >> 1;
+    return 65536 + (uint32_t)(((uint64_t)depth_q16 * lfo_pos) >> 15);
+  }
 };
 
 /**
@@ -276,6 +465,9 @@ public:
       depth = 1.0;
     if (depth < 0)
       depth = 0.0;
+#if USE_EFFECTS_Q15
+    depth_q15 = depth * GAIN_Q15_ONE;
+#endif
   }
 
   float getDepth() { return depth; }
@@ -286,6 +478,9 @@ public:
       feedback = 1.0;
     if (feedback < 0)
       feedback = 0.0;
+#if USE_EFFECTS_Q15
+    feedback_q15 = feedback * GAIN_Q15_ONE;
+#endif
   }
 
   float getFeedback() { return feedback; }
@@ -298,32 +493,64 @@ public:
   float getSampleRate() { return sampleRate; }
 
   effect_t process(effect_t input) {
-    if (!active())
+    if (!active() || delay_len_samples == 0)
       return input;
+    effect_t stored;
+    effect_t result = delay(input, buffer.read(delay_len_samples), stored);
+    buffer.write(stored);
+    return result;
+  }
 
-    // Read last audio sample in each delay line
-    int32_t delayed_value = buffer[delay_line_index];
-
-    // Mix the above with current audio and write the results back to output
-    int32_t out = ((1.0 - depth) * input) + (depth * delayed_value);
-
-    // Update each delay line
-    buffer[delay_line_index] = clip(feedback * (delayed_value + input));
-
-    // Finally, update the delay line index
-    if (delay_line_index++ >= delay_len_samples) {
-      delay_line_index = 0;
+  /// Processes the data in blocks: the delayed samples are read and the
+  /// results are written to the delay line with memcpy
+  void process(effect_t *data, size_t len) {
+    if (!active() || delay_len_samples == 0)
+      return;
+    effect_t delayed[DELAY_LINE_BLOCK_SIZE];
+    effect_t stored[DELAY_LINE_BLOCK_SIZE];
+    // the stored samples must not be needed within the same block
+    size_t block = min(delay_len_samples, (size_t)DELAY_LINE_BLOCK_SIZE);
+    for (size_t pos = 0; pos < len; pos += block) {
+      int n = min(len - pos, block);
+      buffer.read(delayed, n, delay_len_samples);
+      for (int j = 0; j < n; j++)
+        data[pos + j] = delay(data[pos + j], delayed[j], stored[j]);
+      buffer.write(stored, n);
     }
-    return clip(out);
+  }
+
+  /// Defines the allocator for the delay line: by default we use the
+  /// ColdAllocator which prefers PSRAM
+  void setAllocator(Allocator &allocator) {
+    buffer.setAllocator(allocator);
+    buffer.resize(delay_len_samples);
   }
 
   Delay *clone() { return new Delay(*this); }
 
 protected:
-  Vector<effect_t> buffer{0};
+  DelayLine buffer;
   float feedback = 0.0, duration = 0.0, sampleRate = 0.0, depth = 0.0;
   size_t delay_len_samples = 0;
-  size_t delay_line_index = 0;
+#if USE_EFFECTS_Q15
+  int32_t depth_q15 = 0, feedback_q15 = 0;
+#endif
+
+  /// Mixes the input with the delayed value and provides the value which
+  /// needs to be stored in the delay line
+  inline effect_t delay(effect_t input, int32_t delayed_value, effect_t &stored) {
+    // Mix the above with current audio and write the results back to output
+#if USE_EFFECTS_Q15
+    int32_t out = ((GAIN_Q15_ONE - depth_q15) * input + depth_q15 * delayed_value) >> 15;
+    // Update each delay line: the sum * 2^15 still fits into 32 bits
+    stored = clip((feedback_q15 * (delayed_value + input)) >> 15);
+#else
+    int32_t out = ((1.0f - depth) * input) + (depth * delayed_value);
+    // Update each delay line
+    stored = clip(feedback * (delayed_value + input));
+#endif
+    return clip(out);
+  }
 
   void updateBufferSize() {
     if (sampleRate > 0 && duration > 0) {
@@ -331,7 +558,6 @@ protected:
       if (newSampleCount != delay_len_samples) {
         delay_len_samples = newSampleCount;
         buffer.resize(delay_len_samples);
-        memset(buffer.data(),0,delay_len_samples*sizeof(effect_t));
         LOGD("sample_count: %u", (unsigned)delay_len_samples);
       }
     }
@@ -396,6 +622,22 @@ public:
     return result;
   }
 
+  void process(effect_t *data, size_t len) {
+    if (!active())
+      return;
+    float gain[32];
+    for (size_t pos = 0; pos < len; pos += 32) {
+      int n = min(len - pos, (size_t)32);
+      adsr->tick(gain, n);
+      for (int j = 0; j < n; j++)
+        data[pos + j] = factor * gain[j] * data[pos + j];
+    }
+  }
+
+  /// Calculates the envelope only every n samples and interpolates the
+  /// values in between
+  void setControlRate(int samples) { adsr->setControlRate(samples); }
+
   bool isActive() { return adsr->isActive(); }
 
   ADSRGain *clone() { return new ADSRGain(*this); }
@@ -443,6 +685,15 @@ public:
     return buffer.read();
   }
 
+  void process(effect_t *data, size_t len) {
+    if (!active())
+      return;
+    for (size_t j = 0; j < len; j++) {
+      buffer.write(data[j]);
+      data[j] = buffer.read();
+    }
+  }
+
   PitchShift *clone() { return new PitchShift(*this); }
 
 protected:
@@ -470,7 +721,7 @@ public:
         //Attack -> 30 ms -> 3000
         //Release -> 20 ms -> 2000
         //Hold -> 10ms -> 1000
-        sample_rate = sample_rate * attackMs / 1000;
+        sample_rate = sampleRate;
         attack_count = sample_rate * attackMs / 1000;
         release_count = sample_rate * releaseMs / 1000;
         hold_count = sample_rate * holdMs / 1000; 
@@ -478,9 +729,9 @@ public:
         //threshold -20dB below limit -> 0.1 * 2^31
         threshold = 0.01f * thresholdPercent * NumberConverter::maxValueT<effect_t>();
         //compression ratio: 6:1 -> -6dB = 0.5
-        gainreduce = compressionRatio;
+        gainreduce = toGain(compressionRatio);
         //initial gain = 1.0 -> no compression
-	      gain = 1.0f;
+        gain = gainOne();
         recalculate();
     }
 
@@ -510,7 +761,7 @@ public:
     /// Defines the compression ratio from 0 to 1
     void setCompressionRatio(float compressionRatio){
       if (compressionRatio<1.0){
-        gainreduce = compressionRatio;
+        gainreduce = toGain(compressionRatio);
       }
       recalculate();
     }
@@ -522,23 +773,44 @@ public:
         return compress(input);
     }
 
+    /// Processes a block of samples
+    void process(effect_t *data, size_t len) {
+        if (!active())
+          return;
+        for (size_t j = 0; j < len; j++)
+          data[j] = compress(data[j]);
+    }
+
     Compressor *clone() { return new Compressor(*this); }
 
 protected:
     enum CompStates {S_NoOperation, S_Attack, S_GainReduction, S_Release };
     enum CompStates state = S_NoOperation;
 
+#if USE_EFFECTS_Q15
+    /// gain in Q30 to have enough resolution for the steps
+    typedef int32_t gain_t;
+    static gain_t gainOne() { return 1L << 30; }
+#else
+    typedef float gain_t;
+    static gain_t gainOne() { return 1.0f; }
+#endif
+
     int32_t attack_count, release_count, hold_count,  timeout;
-    float gainreduce, gain_step_attack, gain_step_release, gain, threshold;
+    gain_t gainreduce, gain_step_attack, gain_step_release, gain;
+    int32_t threshold;
     uint32_t sample_rate;
 
+    static gain_t toGain(float value) { return value * gainOne(); }
+
     void recalculate() {
-        gain_step_attack = (1.0f - gainreduce) / attack_count;
-        gain_step_release = (1.0f - gainreduce) / release_count;
+        gain_step_attack = (gainOne() - gainreduce) / (attack_count > 0 ? attack_count : 1);
+        gain_step_release = (gainOne() - gainreduce) / (release_count > 0 ? release_count : 1);
     }
 
-    float compress(float inSampleF){
-        if (fabs(inSampleF) > threshold) {
+    inline effect_t compress(effect_t inSample){
+        int32_t inAbs = inSample < 0 ? -inSample : inSample;
+        if (inAbs > threshold) {
             if (gain >=  gainreduce) {
                 if (state==S_NoOperation) {
                     state=S_Attack;
@@ -553,7 +825,7 @@ protected:
 
         }
 
-        if (fabs(inSampleF) < threshold && gain <= 1.0f) {
+        if (inAbs < threshold && gain <= gainOne()) {
             if ( timeout==0 && state==S_GainReduction) {
                 state=S_Release;
                  timeout = release_count;
@@ -583,7 +855,7 @@ protected:
 
 
             case S_Release:
-                if ( timeout>0 && gain<1.0f) {
+                if ( timeout>0 && gain<gainOne()) {
                      timeout--;
                     gain += gain_step_release;
                 }
@@ -593,7 +865,7 @@ protected:
                 break;
 
             case S_NoOperation:
-                if (gain < 1.0f) gain = 1.0f;
+                if (gain < gainOne()) gain = gainOne();
                 break;
 
             default:
@@ -601,8 +873,11 @@ protected:
 
         }
 
-        float outSampleF = gain * inSampleF;
-        return outSampleF;
+#if USE_EFFECTS_Q15
+        return (inSample * (gain >> 15)) >> 15;
+#else
+        return gain * inSample;
+#endif
     }
 
 };
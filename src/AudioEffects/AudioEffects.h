@@ -2,6 +2,8 @@
 #include "AudioBasic/Collections.h"
 #include "AudioEffects/SoundGenerator.h"
 #include "AudioEffects/AudioEffect.h"
+#include "AudioEffects/Dynamics.h"
+#include "AudioEffects/Reverb.h"
 #include "AudioTools/AudioStreams.h"
 #if defined(USE_VARIANTS) && __cplusplus >= 201703L 
 #  include <variant>
@@ -261,35 +263,13 @@ class AudioEffectStreamT : public ModifyingStream {
     */
     size_t readBytes(uint8_t *data, size_t len) override {
         if (!active || p_io==nullptr)return 0;
-        size_t result_size = 0;
 
         // read data from source
         size_t result = p_io->readBytes((uint8_t*)data, len);
         int frames = result / sizeof(T) / info.channels;
         T* samples = (T*) data;
-
-        for (int count=0;count<frames;count++){
-            // determine sample by combining all channels in frame
-            T result_sample = 0;
-            for (int ch=0;ch<info.channels;ch++){
-                T sample = *samples++;
-                //p_io->readBytes((uint8_t*)&sample, sizeof(T));
-                result_sample += sample / info.channels;
-            }
-
-            // apply effects
-            for (int j=0; j<size(); j++){
-                result_sample = effects[j]->process(result_sample);
-            }
-
-            // write result multiplying channels 
-            T* p_buffer = ((T*)data)+(count*info.channels);
-            for (int ch=0;ch<info.channels;ch++){
-                p_buffer[ch] = result_sample;
-                result_size += sizeof(T);
-            }
-        }
-        return result_size;
+        processFrames(samples, samples, frames);
+        return frames * info.channels * sizeof(T);
     }
 
     /**
@@ -301,32 +281,17 @@ class AudioEffectStreamT : public ModifyingStream {
         // length must be multple of channels
         assert(len % (sizeof(T)*info.channels)==0);
         int frames = len / sizeof(T) / info.channels;
-        size_t result_size = 0;
+        size_t result_size = frames * info.channels * sizeof(T);
 
         // process all samples
-        for (int j=0;j<frames;j++){
-            // calculate sample for frame
-            T* p_buffer = ((T*)data) + (j*info.channels);
-            T sample=0;
-            for (int ch=0;ch<info.channels;ch++){
-                sample += p_buffer[ch] / info.channels;
-                result_size += sizeof(T);
-            }
-
-            // apply effects
-            for (int j=0; j<size(); j++){
-                sample = effects[j]->process(sample);
-            }
-
-            // wite result channel times to output defined in constructor
-            for (int ch=0;ch<info.channels;ch++){
-                if (p_io!=nullptr){
-                    p_io->write((uint8_t*)&sample, sizeof(T));
-
-                } else if (p_print!=nullptr){
-                    p_print->write((uint8_t*)&sample, sizeof(T));
-                }
-            }
+        out_buffer.resize(frames * info.channels);
+        processFrames((const T*)data, out_buffer.data(), frames);
+
+        // wite result to output defined in constructor
+        if (p_io!=nullptr){
+            p_io->write((uint8_t*)out_buffer.data(), result_size);
+        } else if (p_print!=nullptr){
+            p_print->write((uint8_t*)out_buffer.data(), result_size);
         }
         return result_size;
     }
@@ -381,6 +346,35 @@ class AudioEffectStreamT : public ModifyingStream {
     bool active = false;
     Stream *p_io=nullptr;
     Print *p_print=nullptr;
+    Vector<effect_t> mono_buffer{0};
+    Vector<T> out_buffer{0};
+
+    /// Combines the channels of each frame, applies each effect once on the
+    /// whole block and copies the result to all channels (in and out might
+    /// be the same)
+    void processFrames(const T* in, T* out, int frames) {
+        mono_buffer.resize(frames);
+        for (int count=0;count<frames;count++){
+            // determine sample by combining all channels in frame
+            T result_sample = 0;
+            for (int ch=0;ch<info.channels;ch++){
+                result_sample += *in++ / info.channels;
+            }
+            mono_buffer[count] = result_sample;
+        }
+
+        // apply effects
+        for (int j=0; j<size(); j++){
+            effects[j]->process(mono_buffer.data(), frames);
+        }
+
+        // write result multiplying channels
+        for (int count=0;count<frames;count++){
+            for (int ch=0;ch<info.channels;ch++){
+                *out++ = mono_buffer[count];
+            }
+        }
+    }
 };
 
 #if defined(USE_VARIANTS) && __cplusplus >= 201703L || defined(DOXYGEN)
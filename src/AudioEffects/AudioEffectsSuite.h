@@ -27,12 +27,6 @@ namespace audio_tools {
 
 typedef float effectsuite_t;
 
-/**
- * @brief Table of interpolation values as a 2D array indexed by
- * interpolationTable[pointIndex][alphaIndex]
- */
-static effectsuite_t **interpolationTable = nullptr;
-
 /**
  * @brief Base Class for Effects
  * @ingroup effects
@@ -55,14 +49,26 @@ class EffectSuiteBase  : public AudioEffect {
     return active_flag ? 32767.0f * processDouble(static_cast<effectsuite_t>(inputSample)/32767.0f) : inputSample;
   }
 
+protected:
+  /// converts the int16_t sample to the range of -1.0 to 1.0
+  static inline effectsuite_t toDouble(effect_t sample) {
+    return sample * (1.0f / 32767.0f);
+  }
+
+  /// converts the processed sample back to int16_t
+  static inline effect_t toEffect(effectsuite_t sample) {
+    return 32767.0f * sample;
+  }
+
 };
 
 
 /**
- * @brief Class provides a wave table that can be populated with a number of
- * preallocated waveforms. These can be used to generate audio in themselves or
+ * @brief Class provides a modulation signal with a number of predefined
+ * waveforms. These can be used to generate audio in themselves or
  * to modulate The parameters of another effect. Class initialised with sample
- * rate.
+ * rate. The signal is generated by the shared LFO engine: so we do not need
+ * any wave table per instance.
  * @author Matthew Hamilton
  * @ingroup effects
  * @copyright MIT License
@@ -75,10 +81,7 @@ public:
   ModulationBaseClass(ModulationBaseClass &copy) = default; 
 
   ModulationBaseClass(effectsuite_t extSampRate) {
-    this->sampleRate = extSampRate;
-    timeStep = 1. / extSampRate;
-    allocateMemory();
-    // setInterpTable();
+    setupModulationBaseClass(extSampRate);
     srand(static_cast<unsigned>(time(0)));
   }
   /** Destructor */
@@ -90,65 +93,31 @@ public:
    * @param extSampRate External sample rate
    */
   void setupModulationBaseClass(effectsuite_t extSampRate) {
-    if (waveTable != nullptr) {
-      delete[] waveTable;
-    }
     sampleRate = extSampRate;
     timeStep = 1. / extSampRate;
-    allocateMemory();
+    last_freq = -1;
   }
 
   /**
-   * sets wavetable to one period of a triangle wave
+   * sets the modulation to a triangle wave
    */
-  void setTriangle() {
-    std::fill(waveTable, waveTable + sampleRate, 0);
-    const effectsuite_t radPerSec = 2 * 3.1415926536f * timeStep;
-    for (int i = 0; i < sampleRate; i++) {
-      for (int j = 0; j < 35; j += 1)
-        waveTable[i] += pow(-1., j) *
-                        (sin((2. * effectsuite_t(j) + 1) * i * radPerSec)) /
-                        (2. * effectsuite_t(j) + 1);
-    }
-  }
+  void setTriangle() { setWaveform(LFO::Triangle); }
   /**
-   * sets wavetable to one period of a square wave
+   * sets the modulation to a square wave
    */
-  void setSquare() {
-    std::fill(waveTable, waveTable + sampleRate, 0);
-    const effectsuite_t radPerSec = 2 * 3.1415926536f * timeStep;
-    for (int i = 0; i < sampleRate; i++) {
-      for (int j = 0; j < 35; j += 1)
-        waveTable[i] += (sin((2 * j + 1) * i * radPerSec)) / (2 * j + 1);
-    }
-  }
+  void setSquare() { setWaveform(LFO::Square); }
   /**
-   * sets wavetable to one period of a sawtooth wave
+   * sets the modulation to a sawtooth wave
    */
-  void setSawtooth() {
-    std::fill(waveTable, waveTable + sampleRate, 0);
-    const effectsuite_t radPerSec = 2 * 3.1415926536f * timeStep;
-    for (int i = 0; i < sampleRate; i++) {
-      for (int j = 1; j < 11; j += 1)
-        waveTable[i] += pow(-1, j) * sin(j * radPerSec * i) / effectsuite_t(j);
-    }
-  }
+  void setSawtooth() { setWaveform(LFO::Sawtooth); }
   /**
-   * sets wavetable to one period of a sine wave oscillating between -1 and 1
+   * sets the modulation to a sine wave oscillating between -1 and 1
    */
-  void setSine() {
-    const effectsuite_t radPerSec = 2 * 3.1415926536f * timeStep;
-    for (int i = 0; i < sampleRate; i++)
-      waveTable[i] = sin(i * radPerSec);
-  }
+  void setSine() { setWaveform(LFO::Sine); }
   /**
-   * sets wavetable to one period of a sine wave oscillating between 0 and 1
+   * sets the modulation to a sine wave oscillating between 0 and 1
    */
-  void setOffSine() {
-    const effectsuite_t radPerSec = 2 * 3.1415926536f * timeStep;
-    for (int i = 0; i < sampleRate; i++)
-      waveTable[i] = (sin(i * radPerSec) + 1) * .5f;
-  }
+  void setOffSine() { setWaveform(LFO::Sine, true); }
 
   void setNoise() {
     is_noise = true;
@@ -159,16 +128,21 @@ public:
   }
 
   /**
-   * sets wavetable to DC one
+   * sets the modulation to DC one
    */
   void setDC() {
-    for (int i = 0; i < sampleRate; i++)
-      waveTable[i] = 1.0;
+    setWaveform(LFO::Sine);
+    is_dc = true;
   }
-  /** set wave table to be a ramp from 0 to 1 */
-  void setRamp() {
-    for (int i = 0; i < sampleRate; i++)
-      waveTable[i] = i / effectsuite_t(sampleRate);
+  /** sets the modulation to a ramp from 0 to 1 */
+  void setRamp() { setWaveform(LFO::Sawtooth, true); }
+  /**
+   * sets the modulation to smoothed random values between 0 and 1: a new
+   * value is used for each step of the speed used in readTable()
+   */
+  void setRandom() {
+    setWaveform(LFO::Random, true);
+    is_random = true;
   }
   /**
    * reads out white noise
@@ -181,8 +155,8 @@ public:
                     (static_cast<effectsuite_t>(RAND_MAX / (hi - lo)));
   }
   /**
-   * clip wave table values with a tanh function. Effect change with a variable
-   * amp to control intensity.
+   * clip the modulation values with a tanh function. Effect change with a
+   * variable amp to control intensity.
    * @param amp amount to multiply signal before being fed through a tanh
    * function
    */
@@ -190,173 +164,80 @@ public:
     if (amp < .01) {
       amp = .01;
     }
-
-    for (int i = 0; i < sampleRate; i++)
-      waveTable[i] = tanh(amp * waveTable[i]) / tanh(amp);
+    clip_amp = amp;
   }
 
   /**
-   * Read through values in waveTable as a given frequency
-   * @param freq read speed in Hz: essentially the number of samples
-   * jumped between reads
-   * @return value from table as effectsuite_t
+   * Provides the next value of the modulation signal
+   * @param freq frequency in Hz
+   * @return value as effectsuite_t
    */
   effectsuite_t readTable(effectsuite_t freq) {
     if (freq > 0) {
-      //    const effectsuite_t out = getInterpOut(tableIndex);
-      const effectsuite_t out = getSplineOut(tableIndex, int(freq));
-      tableIndex += freq;
-      if (tableIndex - sampleRate > 0)
-        tableIndex -= sampleRate;
-
-      return out;
+      updateFrequency(freq);
+      return toValue(lfo.next());
     } else {
       return 0.;
     }
   }
-  void printInterpTable() {
-    for (int j = 0; j < res; j++) {
-      for (int i = 0; i < order; i++) {
-        std::cout << interpTable[i][j] << '\t';
-      }
-      std::cout << '\n';
-    }
-  }
-  /**
-   * populates the internal interpolation table
-   * @return return tru on success, else false
-   */
-  bool setInterpTable() {
-    effectsuite_t *polynomial_normaliser = new effectsuite_t[order];
-    if (!polynomial_normaliser) {
-      return false;
-    }
-    std::fill(polynomial_normaliser, polynomial_normaliser + order, 1);
-    effectsuite_t *alphas = new effectsuite_t[res];
-    if (!alphas) {
-      return false;
-    }
-
-    for (int i = 0; i < res; i++) {
-      alphas[i] = (i / float(res)) - 0.5;
-    }
-
-    effectsuite_t *anchors = new effectsuite_t[order];
 
-    if ((order % 2) == 0) {
-      for (int i = 0; i < order; i++) {
-        anchors[i] = -(effectsuite_t(order) - 1) * 0.5 + effectsuite_t(i);
-        std::fill(interpTable[i], interpTable[i] + res, 1);
-      }
-    } else {
-      for (int i = 0; i < order; i++) {
-        anchors[i] = (-(effectsuite_t(order)) * 0.5) + effectsuite_t(i);
-      }
-    }
-
-    // loop for every value of alpha
-    for (int q = 0; q < res; q++) {
-      // loop for sub polynomial
-      for (int j = 0; j < order; j++) {
-        // loop for each point in subpoly
-        for (int m = 0; m < order; m++) {
-          if (m != j) {
-            if (q == 0) {
-              polynomial_normaliser[j] =
-                  polynomial_normaliser[j] * (anchors[j] - anchors[m]);
-            }
-            interpTable[j][q] *= (alphas[q] - anchors[m]);
-          }
-        }
-        interpTable[j][q] /= polynomial_normaliser[j];
-      }
-    }
-
-    delete[] polynomial_normaliser;
-    delete[] alphas;
-    delete[] anchors;
-    return true;
-  }
-
-protected:
   /**
-   * allocate memory to internal wave table based on sample rate
-   * @return returns true on success or false on failure
+   * Provides the next n values of the modulation signal
+   * @param out result values
+   * @param n number of values
+   * @param freq frequency in Hz
    */
-  bool allocateMemory() {
-    waveTable = new effectsuite_t[sampleRate];
-    assert(waveTable!=nullptr);
-    if (!waveTable) {
-      return false;
+  void readTable(effectsuite_t *out, int n, effectsuite_t freq) {
+    if (freq <= 0) {
+      std::fill(out, out + n, 0);
+      return;
     }
-    std::fill(waveTable, waveTable + sampleRate, 0);
-    return true;
-  }
-  /**
-   * get the interpolated output of the waveTable from the
-   * given buffer index
-   * @param bufferIndex buffer index as effectsuite_t
-   * @return returns interpolated value from surrounding wavtable indices
-   */
-  effectsuite_t getInterpOut(effectsuite_t bufferIndex) {
-    const int order = 4;
-    const int orderHalf = order * .5;
-    const int res = 100;
-    effectsuite_t interpOut = 0;
-    int intBufferIndex = floor(bufferIndex);
-    int alphaIndex = int(floor((bufferIndex - intBufferIndex) * res));
-
-    for (int i = 0; i < order; i++) {
-      int interpIndex =
-          (((i + 1 - orderHalf) + intBufferIndex) + sampleRate) % sampleRate;
-      interpOut += (interpTable[i][alphaIndex]) * (waveTable[interpIndex]);
+    updateFrequency(freq);
+    int16_t values[32];
+    for (int pos = 0; pos < n; pos += 32) {
+      int len = min(n - pos, 32);
+      lfo.next(values, len);
+      for (int j = 0; j < len; j++) out[pos + j] = toValue(values[j]);
     }
-    return interpOut;
-  }
-
-  /**
-   * get a cubic spline interpolated out from the wave table
-   *
-   *  Derived from code by Alec Wright at repository:
-   *  https://github.com/Alec-Wright/Chorus
-   *
-   *  @authors Matthew Hamilton, Alec Wright
-   *  @param bufferIndex the required buffer index
-   *  @param freq (speed) that the table is being read through
-   *  @return returns interpolated value as effectsuite_t
-   */
-  effectsuite_t getSplineOut(effectsuite_t bufferIndex, int freq) {
-    if (freq < 1) {
-      freq = 1;
-    }
-    const int n0 = floor(bufferIndex);
-    const int n1 = (n0 + freq) % sampleRate;
-    const int n2 = (n0 + (2 * freq)) % sampleRate;
-    const effectsuite_t alpha = bufferIndex - n0;
-    const effectsuite_t a = waveTable[n1];
-    const effectsuite_t c = ((3 * (waveTable[n2] - waveTable[n1])) -
-                      (3 * (waveTable[n1] - waveTable[n0]))) *
-                     .25;
-    const effectsuite_t b = (waveTable[n2] - waveTable[n1]) - ((2 * c)) / 3;
-    const effectsuite_t d = (-c) / 3;
-    return a + (b * alpha) + (c * alpha * alpha) + (d * alpha * alpha * alpha);
   }
 
 public:
-  /** current table read index */
-  effectsuite_t tableIndex = 0;
   /** Internal Sample Rate */
-  int sampleRate;
+  int sampleRate = 44100;
   /** time between samples: 1/sampRate */
-  effectsuite_t timeStep;
-  /** store modulation signal as*/
-  effectsuite_t *waveTable;
+  effectsuite_t timeStep = 1. / 44100.;
 
 protected:
-  static const int order = 4;
-  static const int res = 100;
-  effectsuite_t interpTable[order][res];// = {1};
+  LFO lfo;
+  effectsuite_t last_freq = -1;
+  effectsuite_t clip_amp = 0;
   bool is_noise = false;
+  bool is_unipolar = false;
+  bool is_dc = false;
+  bool is_random = false;
+
+  void setWaveform(LFO::Waveform waveform, bool unipolar = false) {
+    lfo.setWaveform(waveform);
+    is_unipolar = unipolar;
+    is_dc = false;
+    is_random = false;
+  }
+
+  void updateFrequency(effectsuite_t freq) {
+    if (freq == last_freq) return;
+    last_freq = freq;
+    // the random values change with each step of the original table
+    // which had one entry per sample
+    lfo.setFrequency(is_random ? freq * sampleRate : freq, sampleRate);
+  }
+
+  effectsuite_t toValue(int16_t value) {
+    if (is_dc) return 1.0f;
+    effectsuite_t result = value * (1.0f / 32767.0f);
+    if (clip_amp > 0) result = tanh(clip_amp * result) / tanh(clip_amp);
+    if (is_unipolar) result = (result + 1.0f) * 0.5f;
+    return result;
+  }
 };
 
 /**
@@ -389,7 +270,9 @@ protected:
 
 /**
  * @brief A Base class for delay based digital effects. Provides the basic methods
- * that are shared amongst Flanger, Delay, Chorus and Phaser
+ * that are shared amongst Flanger, Delay, Chorus and Phaser. The samples are
+ * stored as int16_t in a DelayLine (by default in PSRAM if available) and
+ * fractional delays are linearly interpolated in fixed point.
  * @version 0.1
  * @see DelayEffectBase
  * @author Matthew Hamilton
@@ -404,223 +287,63 @@ public:
   DelayEffectBase(DelayEffectBase &copy) = default;
 
   DelayEffectBase(int bufferSizeSamples) {
-    error = setDelayBuffer(bufferSizeSamples);
-    delayTimeSamples = bufferSizeSamples;
-    if (interpolationTable == nullptr) {
-      interpolationTable = DelayEffectBase::setInterpolationTable();
-    }
-  }
-
-  /** Destructor. */
-  ~DelayEffectBase() {
-    if (delayBuffer != nullptr)
-      delete[] delayBuffer;
+    setupDelayEffectBase(bufferSizeSamples);
   }
 
   /**
-   * <#Description#>
-   * @param bufferSizeSamples <#bufferSizeSamples description#>
+   * Allocates the delay line
+   * @param bufferSizeSamples max delay in samples
    */
   void setupDelayEffectBase(const int bufferSizeSamples) {
-    error = setDelayBuffer(bufferSizeSamples);
+    error = !delayLine.resize(bufferSizeSamples);
     delayTimeSamples = bufferSizeSamples;
   }
 
-protected:
-  /**
-   * Sets the internal lagrange interpolation table. Ideally it should be
-   * shared amongst all
-   *
-   * @returns    false and an error description if there's a problem,
-   * or sets the interpolation lookup table and returns true
-   */
-  static effectsuite_t **setInterpolationTable() {
-    const int order = interpOrder;
-    const int res = interpResolution;
-    effectsuite_t **interpTable = new effectsuite_t *[order];
-    if (!interpTable) {
-      return NULL;
-    }
-
-    for (int i = 0; i < order; i++) {
-      interpTable[i] = new effectsuite_t[res + 1];
-      if (!interpTable[i]) {
-        return NULL;
-      }
-      std::fill(interpTable[i], interpTable[i] + res, 1);
-    }
-
-    effectsuite_t *polynomial_normaliser = new effectsuite_t[order];
-    if (!polynomial_normaliser) {
-      return NULL;
-    }
-    std::fill(polynomial_normaliser, polynomial_normaliser + order, 1);
-    effectsuite_t *alphas = new effectsuite_t[res];
-    if (!alphas) {
-      return NULL;
-    }
-
-    for (int i = 0; i < res; i++) {
-      alphas[i] = (i / float(res)) - 0.5;
-    }
-
-    effectsuite_t *anchors = new effectsuite_t[order];
-
-    if ((order % 2) == 0) {
-      for (int i = 0; i < order; i++) {
-        anchors[i] = -(effectsuite_t(order) - 1) * 0.5 + effectsuite_t(i);
-      }
-    } else {
-      for (int i = 0; i < order; i++) {
-        anchors[i] = (-(effectsuite_t(order)) * 0.5) + effectsuite_t(i);
-      }
-    }
-
-    // loop for every value of alpha
-    for (int q = 0; q < res; q++) {
-      // loop for sub polynomial
-      for (int j = 0; j < order; j++) {
-        // loop for each point in subpoly
-        for (int m = 0; m < order; m++) {
-          if (m != j) {
-            if (q == 0) {
-              polynomial_normaliser[j] =
-                  polynomial_normaliser[j] * (anchors[j] - anchors[m]);
-            }
-            interpTable[j][q] *= (alphas[q] - anchors[m]);
-          }
-        }
-        interpTable[j][q] /= polynomial_normaliser[j];
-      }
-    }
-    delete[] polynomial_normaliser;
-    delete[] alphas;
-    delete[] anchors;
-    return interpTable;
-  }
-
-  // void printInterpTable() {
-  //   for (int j = 0; j < interpResolution; j++) {
-  //     for (int i = 0; i < interpOrder; i++) {
-  //       printf("index %d: %.2f \t", i, interpolationTable[i][j]);
-  //     }
-  //     printf("\n");
-  //   }
-  // }
-
-protected:
-  /**
-   * Allocates memory for delay buffer and initialises all elements to 0
-   * @param bufferSizeSamples		the size of delay buffer to be used
-   * @returns   false and error description if there's a problem,
-   * or sets the internal delay buffer and returns true
-   */
-  bool setDelayBuffer(int bufferSizeSamples) {
-    maxDelayBufferSize = bufferSizeSamples;
-    delayBuffer = new effectsuite_t[maxDelayBufferSize];
-    if (!delayBuffer) {
-      return false;
-    }
-    std::fill(delayBuffer, delayBuffer + maxDelayBufferSize, 0);
-    return true;
+  /// Defines the allocator for the delay line: by default we use the
+  /// ColdAllocator which prefers PSRAM
+  void setAllocator(Allocator &allocator) {
+    delayLine.setAllocator(allocator);
+    error = !delayLine.resize(delayLine.maxDelay());
   }
 
+protected:
   /**
    * store input sample into the delay buffer
    * @param inputSample sample to be stored for delay (effectsuite_t)
    */
-  void storeSample(effectsuite_t inputSample) {
-    delayBuffer[currentDelayWriteIndex] = inputSample;
-  }
-
-  /**
-   * Increments the currentDelayWriteBufferIndex by 1
-   */
-  void incDelayBuffWriteIndex() {
-    currentDelayWriteIndex++;
-    currentDelayWriteIndex %= delayTimeSamples;
-  }
-
-  /**
-   * Increments the currentDelayBufferReadIndex by indexInc
-   * @param indexInc The amount to increment the delay buffer index
-   */
-  void incDelayBuffReadIndex(effectsuite_t indexInc) {
-    currentDelayReadIndex += indexInc;
-    if (currentDelayReadIndex >= effectsuite_t(delayTimeSamples)) {
-      currentDelayReadIndex = 0;
-    }
-    if (currentDelayReadIndex < 0) {
-      currentDelayReadIndex = 0;
-    }
-  }
-
-  /**
-   * sets the currentDelayBufferReadIndex by indexInc (Currently no wrapping)
-   * @param index the read index index required
-   */
-  void setDelayBuffReadIndex(effectsuite_t index) {
-    currentDelayReadIndex = index;
-    if (currentDelayReadIndex >= effectsuite_t(delayTimeSamples)) {
-      currentDelayReadIndex = 0;
-    }
-    if (currentDelayReadIndex < 0) {
-      currentDelayReadIndex = 0;
-    }
+  void delaySample(effectsuite_t inputSample) {
+    delayLine.write(toSample(inputSample));
   }
 
   /**
-   * store input sample into the delay buffer and increment
-   * currentDelayWriteIndex for tracking when to loop back to start of buffer
-   * @param inputSample sample to be stored for delay (effectsuite_t)
+   * Provides the delayed sample x[n-delay] where n is the position of the
+   * next sample which will be written
+   * @param delay delay in samples
+   * @param offset number of samples of the actual block which have already
+   * been written
+   * @returns linearly interpolated output
    */
-  void delaySample(effectsuite_t inputSample) {
-    storeSample(inputSample);
-    incDelayBuffWriteIndex();
+  effectsuite_t getDelayedOut(effectsuite_t delay, int offset = 0) {
+    return delayLine.readFraction(delayLine.toQ16(delay), offset) *
+           (1.0f / 32767.0f);
   }
-  /**
-   * get the value of the requested buffer index by interpolating other points
-   * @param bufferIndex	The required buffer index
-   * @returns interpolated output
-   */
-  effectsuite_t getInterpolatedOut(effectsuite_t bufferIndex) {
-    const int order = interpOrder;
-    const int orderHalf = order * .5;
-    const int res = interpResolution;
-    effectsuite_t interpOut = 0;
-    int intBufferIndex = floor(bufferIndex);
-    int alphaIndex = int(floor((bufferIndex - intBufferIndex) * res));
-
-    for (int i = 0; i < order; i++) {
-      int interpIndex = (i + 1 - orderHalf) + intBufferIndex;
-      if (interpIndex < 0 || (interpIndex >= maxDelayBufferSize)) {
-        if (interpIndex < 0) {
-          interpIndex = maxDelayBufferSize + interpIndex;
-        } else {
-          interpIndex = interpIndex - maxDelayBufferSize;
-        }
-      }
 
-      interpOut +=
-          (interpolationTable[i][alphaIndex]) * (delayBuffer[interpIndex]);
-    }
-    return interpOut;
+  /// converts a sample in the range of -1.0 to 1.0 to int16_t with clipping
+  static inline int16_t toSample(effectsuite_t sample) {
+    effectsuite_t result = sample * 32767.0f;
+    if (result > 32767.0f) return 32767;
+    if (result < -32767.0f) return -32767;
+    return result;
   }
 
 protected: // member variables
   /** buffer to stored audio buffer for delay effects*/
-  effectsuite_t *delayBuffer = 0;
-  /** Maximum number of samples that can be stored in delayBuffer*/
-  int maxDelayBufferSize = 441000;
+  DelayLine delayLine;
   /** the delay time of signal in samples*/
   int delayTimeSamples = 44100;
-  int currentDelayWriteIndex = 0;
-  effectsuite_t currentDelayReadIndex = 0;
-  static const int interpOrder = 4;
-  static const int interpResolution = 1000;
 
   /** internal class error boolean*/
-  bool error;
+  bool error = false;
 };
 
 /**
@@ -672,6 +395,13 @@ public:
     return active_flag ? 32767.0 * processDouble(static_cast<effectsuite_t>(inputSample)/32767.0) : inputSample;
   }
 
+  /// processes a block of samples w/o virtual call per sample
+  void process(effect_t *data, size_t len) override {
+    if (!active_flag) return;
+    for (size_t j = 0; j < len; j++)
+      data[j] = toEffect(FilterEffectBase::processDouble(toDouble(data[j])));
+  }
+
   /**
    *  detect the envelop of an incoming signal
    * @param sample		the incoming signal sample value
@@ -1063,14 +793,7 @@ public:
    */
   virtual effectsuite_t processDouble(effectsuite_t inputSample) override {
     delaySample(inputSample);
-    const effectsuite_t waveDelay = getModSignal();
-    const effectsuite_t delayAmount =
-        ((int(currentDelayWriteIndex - waveDelay) + delayTimeSamples) %
-         delayTimeSamples) +
-        ((currentDelayWriteIndex - waveDelay) -
-         trunc(currentDelayWriteIndex - waveDelay));
-    const effectsuite_t out = .0 * inputSample + 1. * getInterpolatedOut(delayAmount);
-    return out;
+    return getDelayedOut(getModSignal() - 1, 1);
   }
 
   /**
@@ -1101,6 +824,24 @@ public:
    */
   void setBase(effectsuite_t baseAmount) { base = baseAmount * sampleRate; }
 
+  using SimpleLPF::process;
+
+  /// processes a block of samples: the input is written to the delay line
+  /// with memcpy before we read the modulated taps
+  void process(effect_t *data, size_t len) override {
+    if (!active_flag) return;
+    for (size_t pos = 0; pos < len; pos += DELAY_LINE_BLOCK_SIZE) {
+      int n = min(len - pos, (size_t)DELAY_LINE_BLOCK_SIZE);
+      effectsuite_t mod[DELAY_LINE_BLOCK_SIZE];
+      readTable(mod, n, readSpeed);
+      delayLine.write(data + pos, n);
+      for (int j = 0; j < n; j++) {
+        uint32_t delay = delayLine.toQ16(mod[j] * swing + base - 1);
+        data[pos + j] = delayLine.readFraction(delay, n - j);
+      }
+    }
+  }
+
   SimpleChorus* clone() override {
     return new SimpleChorus(*this);
   }
@@ -1112,52 +853,18 @@ protected:
   effectsuite_t swing;
   /** minimum delay in samples. Typically 10 milliseconds */
   effectsuite_t base;
-  /** the minimum value of the lowpassed random modulation signal*/
-  effectsuite_t modMin = .5;
-  /** the maximum value of the lowpassed random modulation signal*/
-  effectsuite_t modMax = .5;
-  /** the normalising factor of the random delay signal*/
-  effectsuite_t modNorm = 1 / (modMax - modMin);
   const effectsuite_t readSpeed = ((readNoise() + 1) * .5) * .0005;
 
   /**
-   * modulation signal scaling equation: ((n - modMin)*modNorm*swing) + base
-   * modulates a random white noise signal by lowpass filtering then
+   * modulation signal scaling equation: (n*swing) + base
+   * modulates a smoothed random signal between 0 and 1 by
    * scaling to a range between 15 to 25 miliseconds of delay.
    **/
   effectsuite_t getModSignal() { return (readTable(readSpeed) * swing) + base; }
 
   void setRandLfo() {
     std::fill(iirBuffer, iirBuffer + filterOrder, .5);
-    for (int i = 0; i < sampleRate; i++) {
-      waveTable[i] = (readNoise() + 1) * .5;
-      //        waveTable[i] = applyFilter((readNoise()+1)*.5);
-      if (waveTable[i] < modMin)
-        modMin = waveTable[i];
-      if (waveTable[i] > modMax) {
-        modMax = waveTable[i];
-      }
-    }
-
-    modNorm = 1 / (modMax - modMin);
-
-    // normalises the delay signal
-    for (int i = 0; i < sampleRate; i++) {
-      waveTable[i] -= modMin;
-      waveTable[i] *= modNorm;
-    }
-
-    //  setOffSine();
-
-    // this code fades out at the end and fades in at the start
-    // to avoid any discontinuities int the signal.
-    //    const int fadeSize = 10000;
-    //    const effectsuite_t fadeSpeed = 2*M_PI/fadeSize;
-    //    for (int i = 0; i < fadeSize; i++)
-    //    {
-    //        const int fadeIndex = ((sampleRate-fadeSize/2)+i)%sampleRate;
-    //        waveTable[fadeIndex] *= (1+cos(fadeSpeed*i))*.5;
-    //    }
+    setRandom();
   }
 };
 
@@ -1171,7 +878,7 @@ class FilteredDelay : public DelayEffectBase, public FilterEffectBase {
 public:
   /** Constructor */
   FilteredDelay(int delayInSamples, int sample_rate=44100) : DelayEffectBase(sample_rate) {
-    delayTimeSamples = delayInSamples;
+    delayTimeSamples = min(delayInSamples, sample_rate);
     changeChebyICoefficients(.05, true, .1, 4);
   };
 
@@ -1207,8 +914,8 @@ public:
   effectsuite_t processDouble(effectsuite_t inputSample) override {
     delaySample(
         applyFilter((inputSample * delayGain) +
-                    feedbackGain * getInterpolatedOut(currentDelayWriteIndex)));
-    const effectsuite_t out = getInterpolatedOut(currentDelayWriteIndex) + inputSample;
+                    feedbackGain * getDelayedOut(delayTimeSamples)));
+    const effectsuite_t out = getDelayedOut(delayTimeSamples) + inputSample;
     return out;
   }
 
@@ -1216,6 +923,31 @@ public:
     return active_flag ? 32767.0 * processDouble(static_cast<effectsuite_t>(inputSample)/32767.0) : inputSample;
   }
 
+  /// processes a block of samples: the delayed samples are read and the
+  /// filtered feedback is written with memcpy
+  void process(effect_t *data, size_t len) override {
+    if (!active_flag) return;
+    // the output uses the delayed sample of the next position
+    int block = min(delayTimeSamples - 1, DELAY_LINE_BLOCK_SIZE - 1);
+    if (block < 1) {
+      for (size_t j = 0; j < len; j++)
+        data[j] = toEffect(FilteredDelay::processDouble(toDouble(data[j])));
+      return;
+    }
+    effect_t delayed[DELAY_LINE_BLOCK_SIZE];
+    effect_t stored[DELAY_LINE_BLOCK_SIZE];
+    for (size_t pos = 0; pos < len; pos += block) {
+      int n = min(len - pos, (size_t)block);
+      delayLine.read(delayed, n + 1, delayTimeSamples);
+      for (int j = 0; j < n; j++) {
+        effectsuite_t in = toDouble(data[pos + j]);
+        stored[j] = toSample(applyFilter(in * delayGain + feedbackGain * toDouble(delayed[j])));
+        data[pos + j] = clip((int32_t)delayed[j + 1] + data[pos + j]);
+      }
+      delayLine.write(stored, n);
+    }
+  }
+
   FilteredDelay *clone() override {
     return new FilteredDelay(*this);
   }
@@ -1255,8 +987,8 @@ public:
    * @see DelayEffectBase constructor
    */
   SimpleDelay(int maxDelayInSamples=8810, int samplingRate=44100) {
-    writeHeadIndex = 0;
-    readHeadIndex = 1;
+    sampleRate = samplingRate;
+    setupDelayEffectBase(maxDelayInSamples);
     currentDelaySamples = maxDelayInSamples;
     targetDelaySamples = maxDelayInSamples;
     setDelayTransitionTime(0.5);
@@ -1293,61 +1025,69 @@ public:
 
   /**
    * Apply delay and return input sample along with delay buffer signal
-   * @param inputSample <#inputSample description#>
-   * @return <#return value description#>
+   * @param inputSample input sample
+   * @return input + delayed sample
    */
   effectsuite_t processDouble(effectsuite_t inputSample) override {
-    // write sample
-    delayBuffer[writeHeadIndex] = inputSample;
-    writeHeadIndex++;
-    writeHeadIndex %= maxDelayBufferSize;
-
-    // read sample
-    effectsuite_t outSample = getSplineOut(readHeadIndex) + (inputSample * 1);
-    if (delayTimeChanged) {
-      count++;
-      const effectsuite_t difference = (currentDelaySamples - targetDelaySamples);
-      const effectsuite_t increment = delayIncrement * (difference / fabs(difference));
-      currentDelaySamples -= increment;
-      readHeadIndex += 1 + increment;
-      readHeadIndex = std::fmod(readHeadIndex, maxDelayBufferSize);
-      if (count > floor(delayTransitionTimeInSamples)) {
-        currentDelaySamples = targetDelaySamples;
-        readHeadIndex = floor(readHeadIndex);
-        delayTimeChanged = false;
-      }
-    } else {
-      readHeadIndex++;
-      readHeadIndex = std::fmod(readHeadIndex, maxDelayBufferSize);
-    }
-    return outSample;
+    const effectsuite_t delayed = getDelayedOut(currentDelaySamples);
+    delaySample(inputSample + feedbackGain * delayed);
+    updateDelayTime();
+    return inputSample + delayGain * delayed;
   }
 
   effect_t process(effect_t inputSample) override {
     return active_flag ? 32767.0 * processDouble(static_cast<effectsuite_t>(inputSample)/32767.0) : inputSample;
   }
 
+  /// processes a block of samples: the feedback is written with memcpy
+  void process(effect_t *data, size_t len) override {
+    if (!active_flag) return;
+    effect_t stored[DELAY_LINE_BLOCK_SIZE];
+    size_t pos = 0;
+    while (pos < len) {
+      // the samples which are stored in the block must not be read
+      int block = min(currentDelaySamples, targetDelaySamples) - 1;
+      if (block > DELAY_LINE_BLOCK_SIZE) block = DELAY_LINE_BLOCK_SIZE;
+      if (block < 1) {
+        data[pos] = toEffect(SimpleDelay::processDouble(toDouble(data[pos])));
+        pos++;
+        continue;
+      }
+      int n = min(len - pos, (size_t)block);
+      for (int j = 0; j < n; j++) {
+        int32_t delayed = delayLine.readFraction(delayLine.toQ16(currentDelaySamples), -j);
+        stored[j] = clip(data[pos + j] + (int32_t)(feedbackGain * delayed));
+        data[pos + j] = clip(data[pos + j] + (int32_t)(delayGain * delayed));
+        updateDelayTime();
+      }
+      delayLine.write(stored, n);
+      pos += n;
+    }
+  }
+
   /**
-   <#Description#>
-   @param delayInSamples <#delayInSamples description#>
+   * Allocates the delay line
+   * @param delayInSamples max delay in samples
    */
   void setupSimpleDelay(int delayInSamples) {
     setupDelayEffectBase(delayInSamples);
   }
   /**
-   <#Description#>
-   @param delayInSample <#delayInSample description#>
+   * Changes the delay time with a transition
+   * @param delayInSamples new delay in samples
    */
   void setDelayTime(effectsuite_t delayInSamples) {
     delayTimeChanged = true;
     targetDelaySamples = delayInSamples;
     const effectsuite_t delayTimeDifference = currentDelaySamples - targetDelaySamples;
-    delayIncrement = delayTimeDifference / delayTransitionTimeInSamples;
+    delayIncrement = delayTransitionTimeInSamples > 0
+                         ? delayTimeDifference / delayTransitionTimeInSamples
+                         : delayTimeDifference;
     count = 0;
   }
   /**
-   <#Description#>
-   @param seconds <#seconds description#>
+   * Defines the time for the transition to a new delay time
+   * @param seconds transition time in seconds
    */
   void setDelayTransitionTime(effectsuite_t seconds) {
     delayTransitionTime = seconds;
@@ -1371,42 +1111,26 @@ protected:
     }
     return;
   }
-  /**
-   * get a cubic spline interpolated out from the wave table
-   * Derived from code by Alec Wright at repository:
-   * https://github.com/Alec-Wright/Chorus
-   * @authors Matthew Hamilton, Alec Wright
-   * @param bufferIndex the required buffer index
-   * @return returns interpolated value as effectsuite_t
-   */
-  effectsuite_t getSplineOut(effectsuite_t bufferIndex) {
-    const int n0 = floor(bufferIndex);
-    const int n1 = (n0 + 1) % maxDelayBufferSize;
-    const int n2 = (n0 + 2) % maxDelayBufferSize;
-    const effectsuite_t alpha = bufferIndex - n0;
 
-    const effectsuite_t a = delayBuffer[n1];
-    const effectsuite_t c = ((3 * (delayBuffer[n2] - delayBuffer[n1])) -
-                      (3 * (delayBuffer[n1] - delayBuffer[n0]))) *
-                     0.25;
-    const effectsuite_t b = (delayBuffer[n2] - delayBuffer[n1]) - (2 * c * 0.33333);
-    const effectsuite_t d = (-c) * 0.33333;
-    return a + (b * alpha) + (c * alpha * alpha) + (d * alpha * alpha * alpha);
+  /// moves the delay time towards the target
+  void updateDelayTime() {
+    if (!delayTimeChanged) return;
+    count++;
+    currentDelaySamples -= delayIncrement;
+    if (count >= delayTransitionTimeInSamples) {
+      currentDelaySamples = targetDelaySamples;
+      delayTimeChanged = false;
+    }
   }
 
 protected: // member vairables
   effectsuite_t delayGain = .707;
   effectsuite_t feedbackGain = 0.;
-  effectsuite_t readHeadIndex;
-  unsigned int writeHeadIndex;
   effectsuite_t currentDelaySamples;
   effectsuite_t targetDelaySamples;
   /** increment when transition from current to target delay per sample set by
    * delayTransitionTime*/
-  effectsuite_t delayIncrement;
-  /** inverse of delay increment: for working out whole number cyles to reach
-   * target delay*/
-  effectsuite_t invDelayIncrement;
+  effectsuite_t delayIncrement = 0;
   /** time in seconds to transition from one delay to another*/
   effectsuite_t delayTransitionTime;
   effectsuite_t delayTransitionTimeInSamples;
@@ -1434,7 +1158,9 @@ public:
   SimpleFlanger() = default;
   SimpleFlanger(SimpleFlanger&copy) = default;
   SimpleFlanger(effectsuite_t extSampleRate=44100)
-      : DelayEffectBase(static_cast<int>(extSampleRate * 0.02)) {}
+      : DelayEffectBase(static_cast<int>(extSampleRate * 0.02)) {
+    timeStep = 1. / extSampleRate;
+  }
 
   /** Destructor. */
   ~SimpleFlanger() = default;
@@ -1464,7 +1190,7 @@ public:
    */
   void setRate(const effectsuite_t rate) {
     modulationRate = rate;
-    setAngleDelta();
+    updateLFO();
   }
 
   /**
@@ -1483,7 +1209,7 @@ public:
   effectsuite_t processDouble(effectsuite_t inputSample) override {
     delaySample(inputSample);
     const effectsuite_t out = ((1 - fabs(effectGain * .2)) * (inputSample) +
-                        (effectGain * getInterpolatedOut(modulationIndex)));
+                        (effectGain * getDelayedOut(modulationDelay, 1)));
     updateModulation();
     return out;
   }
@@ -1491,9 +1217,30 @@ public:
   void setupSimpleFlanger(effectsuite_t extSampleRate) {
     setupDelayEffectBase(extSampleRate * .02);
     timeStep = 1. / extSampleRate;
+    updateLFO();
     setEffectParams(.707, extSampleRate * .02, .1);
   }
 
+  using AudioEffect::process;
+
+  /// processes a block of samples: the input is written to the delay line
+  /// with memcpy before we read the modulated taps
+  void process(effect_t *data, size_t len) override {
+    if (!active_flag) return;
+    const effectsuite_t dry = 1 - fabs(effectGain * .2);
+    int16_t values[DELAY_LINE_BLOCK_SIZE];
+    for (size_t pos = 0; pos < len; pos += DELAY_LINE_BLOCK_SIZE) {
+      int n = min(len - pos, (size_t)DELAY_LINE_BLOCK_SIZE);
+      lfo.next(values, n);
+      delayLine.write(data + pos, n);
+      for (int j = 0; j < n; j++) {
+        int32_t delayed = delayLine.readFraction(delayLine.toQ16(modulationDelay), n - j);
+        data[pos + j] = clip(dry * data[pos + j] + effectGain * delayed);
+        modulationDelay = toDelay(values[j]);
+      }
+    }
+  }
+
   SimpleFlanger* clone() override {
     return new SimpleFlanger(*this);
   }
@@ -1513,44 +1260,31 @@ protected:
   }
 
   /**
-   *  setAngleDelta: sets the angleDelta for delay modulation
+   *  updateLFO: sets the frequency of the lfo for the delay modulation
    **/
-  void setAngleDelta() {
-    const effectsuite_t cyclesPerSample = modulationRate * timeStep;
-    angleDelta = cyclesPerSample * 2.0 * internal_Pi;
-  }
+  void updateLFO() { lfo.setFrequency(modulationRate, 1. / timeStep); }
 
   /**
-   *  updateModulation: updates the modulationIndex by the correct increment
+   *  updateModulation: updates the modulationDelay with the next lfo value
    **/
-  void updateModulation() {
-    modulationAngle += angleDelta;
-    modulationIndex = (currentDelayWriteIndex -
-                       (modulationDepth * (1 + (sin(modulationAngle))))) -
-                      12;
-    modulationIndex =
-        ((int(modulationIndex) + delayTimeSamples) % delayTimeSamples) +
-        (modulationIndex - floor(modulationIndex));
+  void updateModulation() { modulationDelay = toDelay(lfo.next()); }
+
+  /// converts the Q15 lfo value to the delay in samples
+  effectsuite_t toDelay(int16_t value) {
+    return (modulationDepth * (1 + value * (1.0f / 32767.0f))) + 12;
   }
 
 protected:
-  /** internal class declaration of pi  it would likely make sense to have this
-   * moved  to a higher class */
-  constexpr static const effectsuite_t internal_Pi = 3.141592653589793;
-
   effectsuite_t modulationDepth = 1000, modulationRate = 0, effectGain = .01;
 
-  effectsuite_t modulationIndex = 0;
+  /** actual delay in samples */
+  effectsuite_t modulationDelay = 0;
 
   /** 1/sampleRate: The time in seconds between samples*/
   effectsuite_t timeStep = 1. / 44100.;
 
-  /** 2 * pi * modulationRate / sampleRate */
-  effectsuite_t modulationConstant, modulationAngle = 0;
-
-  // const effectsuite_t cyclesPerSample = modulationRate * timeStep;
-  /**increment value for modulation signal*/
-  effectsuite_t angleDelta = 2 * internal_Pi * timeStep;
+  /** sine modulation signal */
+  LFO lfo;
 };
 
 /**
@@ -1583,6 +1317,15 @@ public:
     return applyFilter(sample);
   }
 
+  using FilterEffectBase::process;
+
+  /// processes a block of samples w/o virtual call per sample
+  void process(effect_t *data, size_t len) override {
+    if (!active_flag) return;
+    for (size_t j = 0; j < len; j++)
+      data[j] = toEffect(EnvelopeFilter::processDouble(toDouble(data[j])));
+  }
+
 protected:
   /**
    * this follows the signal envelope and alters the internallow pass filter
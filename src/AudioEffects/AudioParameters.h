@@ -1,10 +1,14 @@
 #pragma once
+#include <math.h>
 #include "AudioTools/AudioLogger.h"
 
 namespace audio_tools {
 
 /**
- * @brief Base class for all parameters
+ * @brief Base class for all parameters. By default the value is updated for
+ * each sample. With setControlRate() the value is only calculated every n
+ * samples and the samples in between are linearly interpolated, which is
+ * much cheaper and not audible for envelopes.
  */
 class AbstractParameter {
     public:
@@ -14,10 +18,48 @@ class AbstractParameter {
             return act_value;
         };
 
+        /// Defines the number of samples after which the value is calculated
+        /// (1 = every sample)
+        void setControlRate(int samples) {
+            control_rate = samples < 1 ? 1 : samples;
+            ramp_count = 0;
+            ramp_value = act_value;
+        }
+
+        int controlRate() { return control_rate; }
+
         // triggers an update of the value
         virtual float tick() {
-            act_value = update();
-            return act_value;
+            if (control_rate <= 1) {
+                act_value = update();
+                return act_value;
+            }
+            if (ramp_count == 0) nextRamp();
+            ramp_value += ramp_step;
+            ramp_count--;
+            return ramp_value;
+        }
+
+        /// Provides the next n values
+        virtual void tick(float *values, int n) {
+            if (control_rate <= 1) {
+                for (int j = 0; j < n; j++) values[j] = act_value = update();
+                return;
+            }
+            int pos = 0;
+            while (pos < n) {
+                if (ramp_count == 0) nextRamp();
+                int len = min(n - pos, ramp_count);
+                float value = ramp_value;
+                float step = ramp_step;
+                for (int j = 0; j < len; j++) {
+                    value += step;
+                    values[pos + j] = value;
+                }
+                ramp_value = value;
+                ramp_count -= len;
+                pos += len;
+            }
         }
 
         // to manage keyboard related parameters
@@ -28,9 +70,27 @@ class AbstractParameter {
 
     protected:
         float act_value = 0;
+        int control_rate = 1;
+        int ramp_count = 0;
+        float ramp_value = 0;
+        float ramp_step = 0;
         friend class ScaledParameter;
 
         virtual float update() = 0;
+
+        /// Advances the value by n samples
+        virtual float update(int samples) {
+            float result = act_value;
+            for (int j = 0; j < samples; j++) result = update();
+            return result;
+        }
+
+        /// Calculates the value at the end of the next control period
+        void nextRamp() {
+            act_value = update(control_rate);
+            ramp_step = (act_value - ramp_value) / control_rate;
+            ramp_count = control_rate;
+        }
 };
 
 /**
@@ -43,6 +103,7 @@ class Parameter : public AbstractParameter {
             act_value = value;
         }
         virtual float update(){ return act_value;}
+        float update(int samples) override { return act_value; }
 };
 
 /**
@@ -97,6 +158,8 @@ class ADSR : public  AbstractParameter  {
             state = Attack;
             this->target = tgt>0.0f && tgt<=1.0f ? tgt : sustain;
             this->act_value = 0;
+            ramp_value = 0;
+            ramp_count = 0;
         }
 
         void keyOff(){
@@ -104,11 +167,13 @@ class ADSR : public  AbstractParameter  {
             if (state!=Idle){
                 state = Release;
                 target = 0;
+                // start the release with the next sample
+                ramp_count = 0;
             }
         }
 
         bool isActive(){
-            return state!=Idle;
+            return state!=Idle || ramp_count > 0;
         }
 
     protected:
@@ -120,49 +185,58 @@ class ADSR : public  AbstractParameter  {
         int zeroCount =  0;
 
         inline float update( ) {
+            return update(1);
+        }
 
-            switch ( state ) {
-                case Attack:
-                    act_value += attack;
-                    if ( act_value >= target ) {
-                        act_value = target;
-                        target = sustain;
-                        state = Decay;
-                    }
-                    break;
-
-                case Decay:
-                    if ( act_value > sustain ) {
-                        act_value -= decay;
-                        if ( act_value <= sustain ) {
-                            act_value = sustain;
-                            state = Sustain;
+        /// Advances the envelope by n samples: each stage is a linear ramp,
+        /// so we can calculate the end of the stage directly
+        float update(int samples) override {
+            while (samples > 0) {
+                switch ( state ) {
+                    case Attack:
+                        if (rampTo(samples, target, attack)) {
+                            target = sustain;
+                            state = Decay;
                         }
-                    }
-                    else {
-                        act_value += decay; // attack target < sustainLevel level
-                        if ( act_value >= sustain ) {
-                            act_value = sustain;
+                        break;
+
+                    case Decay:
+                        if (rampTo(samples, sustain, decay)) {
                             state = Sustain;
                         }
-                    }
-                    break;
-
-                case Release:
-                    act_value -= release;
-                    if ( act_value <= 0.0f ) {
-                        act_value = 0.0;
-                        state = Idle;
-                    }
-                    break;
-
-                default:
-                    // nothing to be done
-                    break;
+                        break;
+
+                    case Release:
+                        if (rampTo(samples, 0.0f, release)) {
+                            state = Idle;
+                        }
+                        break;
+
+                    default:
+                        // nothing to be done
+                        return act_value;
+                }
             }
             return act_value;
         }
 
+        /// Moves the value with the rate per sample towards the target: returns
+        /// true if the target was reached and reduces the open samples
+        bool rampTo(int &samples, float to, float rate) {
+            float distance = fabsf(to - act_value);
+            // like the per sample update we need at least one step
+            int steps = rate > 0.0f ? (int)ceilf(distance / rate) : samples + 1;
+            if (steps < 1) steps = 1;
+            if (steps > samples) {
+                act_value += (to > act_value ? rate : -rate) * samples;
+                samples = 0;
+                return false;
+            }
+            act_value = to;
+            samples -= steps;
+            return true;
+        }
+
 };
 
 
@@ -182,6 +256,10 @@ class ScaledParameter : public AbstractParameter {
         return p_parameter->update() + min * (max-min);
     }
 
+    float update(int samples) override {
+        return p_parameter->update(samples) + min * (max-min);
+    }
+
     protected:
         float min=0, max=0;
         AbstractParameter *p_parameter;
@@ -0,0 +1,139 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#include "AudioBasic/Collections/Allocator.h"
+#include "AudioBasic/Collections/Vector.h"
+
+/// Max number of samples which are processed in one block: the delay line
+/// reserves this number of additional samples
+#ifndef DELAY_LINE_BLOCK_SIZE
+#  define DELAY_LINE_BLOCK_SIZE 64
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Delay line with int16_t samples which is shared by the delay based
+ * effects. The size is rounded up to a power of 2, so that the wrap around is
+ * just a bit mask. The samples are written and read in blocks with at most 2
+ * memcpy, which is important for long delays (1-2 seconds) which are stored
+ * in PSRAM: by default the memory is allocated with the ColdAllocator.
+ *
+ * The delay is relative to the next sample which will be written: a delay
+ * of d provides x[n-d]. Fractional delays are given in 16.16 fixed point
+ * format and are linearly interpolated.
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class DelayLine {
+ public:
+  DelayLine() { setAllocator(ColdAllocator); }
+
+  DelayLine(int maxDelay, Allocator &allocator = ColdAllocator) {
+    setAllocator(allocator);
+    resize(maxDelay);
+  }
+
+  DelayLine(const DelayLine &copy) {
+    setAllocator(*copy.p_allocator);
+    resize(copy.max_delay);
+  }
+
+  DelayLine &operator=(const DelayLine &copy) {
+    setAllocator(*copy.p_allocator);
+    resize(copy.max_delay);
+    return *this;
+  }
+
+  /// Defines the allocator: call before resize()
+  void setAllocator(Allocator &allocator) {
+    p_allocator = &allocator;
+    buffer.setAllocator(allocator);
+  }
+
+  /// Allocates the memory for the indicated max delay in samples and clears
+  /// the content
+  bool resize(int maxDelay) {
+    if (maxDelay < 1) maxDelay = 1;
+    max_delay = maxDelay;
+    int size = 1;
+    while (size < maxDelay + DELAY_LINE_BLOCK_SIZE + 2) size <<= 1;
+    if (size != (int)buffer.size()) {
+      buffer.resize(size);
+      if ((int)buffer.size() != size) return false;
+      mask = size - 1;
+    }
+    clear();
+    return true;
+  }
+
+  /// Max supported delay in samples
+  int maxDelay() { return max_delay; }
+
+  /// Sets all samples to 0
+  void clear() {
+    if (buffer.size() > 0) memset(buffer.data(), 0, buffer.size() * sizeof(int16_t));
+    pos = 0;
+  }
+
+  /// Adds a single sample
+  void write(int16_t sample) {
+    buffer[pos & mask] = sample;
+    pos++;
+  }
+
+  /// Adds n samples
+  void write(const int16_t *data, int n) {
+    int idx = pos & mask;
+    int len1 = min(n, (int)buffer.size() - idx);
+    memcpy(buffer.data() + idx, data, len1 * sizeof(int16_t));
+    if (len1 < n) memcpy(buffer.data(), data + len1, (n - len1) * sizeof(int16_t));
+    pos += n;
+  }
+
+  /// Provides x[n-delay]
+  int16_t read(int delay) { return buffer[(pos - delay) & mask]; }
+
+  /// Provides the delayed samples for the next n samples: out[j] = x[n+j-delay].
+  /// n must not be bigger than the delay.
+  void read(int16_t *out, int n, int delay) {
+    int idx = (pos - delay) & mask;
+    int len1 = min(n, (int)buffer.size() - idx);
+    memcpy(out, buffer.data() + idx, len1 * sizeof(int16_t));
+    if (len1 < n) memcpy(out + len1, buffer.data(), (n - len1) * sizeof(int16_t));
+  }
+
+  /// Provides the linearly interpolated sample for a delay in 16.16 format.
+  /// With offset you can address the samples of a block which has already
+  /// been written: x[n-offset-delay]
+  int16_t readFraction(uint32_t delayQ16, int offset = 0) {
+    uint32_t idx = pos - offset - (delayQ16 >> 16);
+    // 15 bit fraction, so that the product fits into 32 bits
+    int32_t frac = (delayQ16 & 0xFFFF) >> 1;
+    int32_t a = buffer[idx & mask];
+    int32_t b = buffer[(idx - 1) & mask];
+    return a + (((b - a) * frac) >> 15);
+  }
+
+  /// Converts a delay in samples to the 16.16 format and limits it to the
+  /// supported range
+  uint32_t toQ16(float delay) {
+    if (delay < 0.0f) delay = 0.0f;
+    if (delay > max_delay) delay = max_delay;
+    return delay * 65536.0f;
+  }
+
+  /// Number of written samples
+  uint32_t position() { return pos; }
+
+ protected:
+  Vector<int16_t> buffer{0};
+  Allocator *p_allocator = &ColdAllocator;
+  uint32_t mask = 0;
+  uint32_t pos = 0;
+  int max_delay = 0;
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,316 @@
+#pragma once
+#include "AudioBasic/Collections.h"
+#include "AudioEffects/AudioEffect.h"
+#include "AudioTools/BaseConverter.h"
+#include <math.h>
+
+namespace audio_tools {
+
+/**
+ * @brief Block based dynamics engine (compressor, limiter or gate) for 16 bit
+ * interleaved samples. The level is measured with a windowed RMS or peak
+ * detector which is updated incrementally per control block. The gain is
+ * only calculated at the end of each control block of N frames and is
+ * interpolated linearly over the next block, so the per sample work is just
+ * a multiplication. With a lookahead the signal is delayed, so that the gain
+ * reduction is already active when a peak arrives. All channels share the
+ * same gain (stereo linked).
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class DynamicsProcessor {
+ public:
+  enum Mode { Compressor, Limiter, Gate };
+  enum Detector { RMS, Peak };
+
+  DynamicsProcessor(Mode mode = Compressor) { setMode(mode); }
+
+  /// Starts the processing with the indicated format
+  bool begin(uint32_t sampleRate, int channels = 1) {
+    sample_rate = sampleRate;
+    this->channels = channels > 0 ? channels : 1;
+    setup();
+    return true;
+  }
+
+  void setMode(Mode mode) {
+    this->mode = mode;
+    is_dirty = true;
+  }
+
+  void setDetector(Detector detector) {
+    this->detector = detector;
+    is_dirty = true;
+  }
+
+  /// Threshold in dB relative to full scale (e.g. -20)
+  void setThreshold(float dB) { threshold_db = dB; }
+
+  /// Compression ratio (e.g. 4 for 4:1): ignored by the limiter
+  void setRatio(float ratio) { this->ratio = ratio < 1.0f ? 1.0f : ratio; }
+
+  /// Attenuation in dB which is applied by the gate (e.g. -60)
+  void setGateRange(float dB) { gate_range_db = dB; }
+
+  /// Gain in dB which is added after the compression (max 12 dB)
+  void setMakeupGain(float dB) { makeup_db = dB > 12.0f ? 12.0f : dB; }
+
+  void setAttackMs(float ms) {
+    attack_ms = ms;
+    is_dirty = true;
+  }
+
+  void setReleaseMs(float ms) {
+    release_ms = ms;
+    is_dirty = true;
+  }
+
+  /// Defines the delay in ms which is used to look ahead (0 = off)
+  void setLookaheadMs(float ms) {
+    lookahead_ms = ms;
+    is_dirty = true;
+  }
+
+  /// Defines the length of the detector window in ms
+  void setWindowMs(float ms) {
+    window_ms = ms;
+    is_dirty = true;
+  }
+
+  /// Number of frames after which the gain is recalculated
+  void setControlInterval(int frames) {
+    control_frames = frames > 0 ? frames : 1;
+    is_dirty = true;
+  }
+
+  /// Delay in frames which is caused by the lookahead
+  int latency() { return delay.size() / channels; }
+
+  /// Actual gain reduction in dB
+  float gainReductionDb() { return 20.0f * log10f(gain_actual); }
+
+  /// Processes the interleaved samples in place
+  void process(int16_t *data, size_t samples) {
+    if (is_dirty) setup();
+    samples -= samples % channels;
+    for (size_t j = 0; j < samples; j += channels) {
+      int16_t *frame = data + j;
+      // update the detector with the undelayed signal
+      for (int ch = 0; ch < channels; ch++) {
+        int32_t value = frame[ch];
+        int32_t abs_value = value < 0 ? -value : value;
+        if (abs_value > block_peak) block_peak = abs_value;
+        block_sum += (float)(value * value);
+      }
+      // apply the interpolated gain to the delayed signal
+      gain_q14 += gain_inc_q14;
+      for (int ch = 0; ch < channels; ch++) {
+        int32_t value = frame[ch];
+        if (delay_len > 0) {
+          int16_t delayed = delay[delay_pos];
+          delay[delay_pos] = value;
+          if (++delay_pos >= delay_len) delay_pos = 0;
+          value = delayed;
+        }
+        value = (value * gain_q14) >> 14;
+        frame[ch] = value > 32767 ? 32767 : (value < -32768 ? -32768 : value);
+      }
+      if (++block_pos >= control_frames) updateGain();
+    }
+  }
+
+ protected:
+  Mode mode = Compressor;
+  Detector detector = RMS;
+  uint32_t sample_rate = 44100;
+  int channels = 1;
+  float threshold_db = -20.0f;
+  float ratio = 4.0f;
+  float gate_range_db = -60.0f;
+  float makeup_db = 0.0f;
+  float attack_ms = 5.0f;
+  float release_ms = 50.0f;
+  float lookahead_ms = 0.0f;
+  float window_ms = 10.0f;
+  int control_frames = 32;
+  bool is_dirty = true;
+  // detector ring of the block results
+  Vector<float> block_sums{0};
+  Vector<int32_t> block_peaks{0};
+  int window_pos = 0;
+  float window_sum = 0.0f;
+  float block_sum = 0.0f;
+  int32_t block_peak = 0;
+  int block_pos = 0;
+  // gain
+  float attack_coef = 0.0f;
+  float release_coef = 0.0f;
+  float gain_actual = 1.0f;
+  int32_t gain_q14 = 1 << 14;
+  int32_t gain_inc_q14 = 0;
+  // lookahead
+  Vector<int16_t> delay{0};
+  int delay_pos = 0;
+  int delay_len = 0;
+
+  void setup() {
+    is_dirty = false;
+    int blocks = window_ms * sample_rate / 1000 / control_frames;
+    if (blocks < 1) blocks = 1;
+    block_sums.resize(blocks);
+    block_peaks.resize(blocks);
+    for (int j = 0; j < blocks; j++) {
+      block_sums[j] = 0.0f;
+      block_peaks[j] = 0;
+    }
+    window_pos = 0;
+    window_sum = 0.0f;
+    block_sum = 0.0f;
+    block_peak = 0;
+    block_pos = 0;
+    // coefficients for the smoothing per control block
+    attack_coef = coefficient(attack_ms);
+    release_coef = coefficient(release_ms);
+    gain_actual = 1.0f;
+    gain_q14 = toQ14(makeup());
+    gain_inc_q14 = 0;
+    delay_len = lookahead_ms * sample_rate / 1000 * channels;
+    delay.resize(delay_len);
+    for (int j = 0; j < delay_len; j++) delay[j] = 0;
+    delay_pos = 0;
+  }
+
+  float coefficient(float ms) {
+    float blocks = ms * sample_rate / 1000.0f / control_frames;
+    return blocks <= 0.0f ? 0.0f : expf(-1.0f / blocks);
+  }
+
+  float makeup() { return powf(10.0f, makeup_db / 20.0f); }
+
+  static int32_t toQ14(float gain) { return gain * (1 << 14); }
+
+  /// Measured level in dB from the detector window
+  float levelDb() {
+    int blocks = block_sums.size();
+    float level;
+    if (detector == RMS) {
+      float samples = (float)blocks * control_frames * channels;
+      level = sqrtf(window_sum / samples);
+    } else {
+      int32_t peak = 0;
+      for (int j = 0; j < blocks; j++) {
+        if (block_peaks[j] > peak) peak = block_peaks[j];
+      }
+      level = peak;
+    }
+    if (level < 1.0f) level = 1.0f;
+    return 20.0f * log10f(level / 32768.0f);
+  }
+
+  /// Gain in dB for the level
+  float targetDb(float level_db) {
+    float over = level_db - threshold_db;
+    switch (mode) {
+      case Compressor:
+        return over > 0.0f ? -over * (1.0f - 1.0f / ratio) : 0.0f;
+      case Limiter:
+        return over > 0.0f ? -over : 0.0f;
+      case Gate:
+        return over < 0.0f ? gate_range_db : 0.0f;
+    }
+    return 0.0f;
+  }
+
+  /// Called at the end of each control block
+  void updateGain() {
+    block_pos = 0;
+    // replace the oldest block in the detector window
+    window_sum += block_sum - block_sums[window_pos];
+    if (window_sum < 0.0f) window_sum = 0.0f;
+    block_sums[window_pos] = block_sum;
+    block_peaks[window_pos] = block_peak;
+    if (++window_pos >= (int)block_sums.size()) window_pos = 0;
+    block_sum = 0.0f;
+    block_peak = 0;
+
+    // smooth the gain: the attack is used when the gain is reduced
+    float target = powf(10.0f, targetDb(levelDb()) / 20.0f);
+    float coef = target < gain_actual ? attack_coef : release_coef;
+    gain_actual = target + coef * (gain_actual - target);
+
+    // interpolate to the new gain over the next block
+    int32_t next = toQ14(gain_actual * makeup());
+    gain_inc_q14 = (next - gain_q14) / control_frames;
+    gain_q14 = next - gain_inc_q14 * control_frames;
+  }
+};
+
+/**
+ * @brief The DynamicsProcessor (compressor, limiter or gate) as AudioEffect
+ * for mono samples
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class DynamicsEffect : public AudioEffect {
+ public:
+  DynamicsEffect(uint32_t sampleRate = 44100,
+                 DynamicsProcessor::Mode mode = DynamicsProcessor::Compressor)
+      : processor(mode) {
+    processor.begin(sampleRate, 1);
+  }
+
+  /// Provides access to the parameters
+  DynamicsProcessor &dynamics() { return processor; }
+
+  effect_t process(effect_t input) override {
+    if (!active()) return input;
+    processor.process(&input, 1);
+    return input;
+  }
+
+  void process(effect_t *data, size_t len) override {
+    if (!active()) return;
+    processor.process(data, len);
+  }
+
+  DynamicsEffect *clone() override { return new DynamicsEffect(*this); }
+
+ protected:
+  DynamicsProcessor processor;
+};
+
+/**
+ * @brief The DynamicsProcessor (compressor, limiter or gate) as converter for
+ * 16 bit interleaved data: e.g. as final limiter in a ConverterStream.
+ * @ingroup convert
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class DynamicsConverter : public BaseConverter {
+ public:
+  DynamicsConverter(DynamicsProcessor::Mode mode = DynamicsProcessor::Limiter)
+      : processor(mode) {}
+
+  /// Provides access to the parameters
+  DynamicsProcessor &dynamics() { return processor; }
+
+  bool begin(AudioInfo info) {
+    if (info.bits_per_sample != 16) {
+      LOGE("bits_per_sample not supported: %d", info.bits_per_sample);
+      return false;
+    }
+    return processor.begin(info.sample_rate, info.channels);
+  }
+
+  size_t convert(uint8_t *src, size_t size) override {
+    processor.process((int16_t *)src, size / sizeof(int16_t));
+    return size;
+  }
+
+ protected:
+  DynamicsProcessor processor;
+};
+
+}  // namespace audio_tools
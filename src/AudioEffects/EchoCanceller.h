@@ -0,0 +1,345 @@
+#pragma once
+#include "AudioBasic/Collections.h"
+#include "AudioFilter/ConvolutionFilter.h"
+#include "AudioTools/AudioStreams.h"
+#include "AudioTools/Buffers.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Acoustic echo canceller for mono 16 bit samples (e.g. for a full
+ * duplex intercom): the echo of the far end signal (reference) is estimated
+ * with a partitioned block frequency domain adaptive filter (PBFDAF) and
+ * subtracted from the microphone signal.
+ *
+ * The filter uses the partitioned overlap-save engine of the
+ * ConvolutionFilter: the reference is transformed once per block into the
+ * frequency delay line and convolved with the filter partitions. The error
+ * updates all partitions with a normalized LMS step in the frequency domain.
+ * The gradient constraint (which keeps the second half of each partition
+ * zero) needs 2 FFTs and is therefore applied to only one partition per block
+ * in turn. So we need 5 FFTs per block independent of the tail length.
+ *
+ * With the default block size of 128 samples at 16 kHz (8 ms) a tail of 256
+ * ms needs 32 partitions. The tail must cover the acoustic echo path and
+ * the delay of the output buffers (e.g. the I2S DMA buffers). The adaptation
+ * is stopped while the near end is talking (Geigel detector). The result is
+ * delayed by one block.
+ * @code
+ * FFTDriverRealFFT driver;
+ * EchoCancellerProcessor aec(driver);
+ * aec.setTailMs(200);
+ * aec.begin(16000);
+ * ...
+ * aec.writeReference(speaker_data, samples);
+ * aec.process(mic_data, samples);
+ * @endcode
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class EchoCancellerProcessor : protected ConvolutionFilter<float> {
+ public:
+  EchoCancellerProcessor(FFTDriver &driver) : ConvolutionFilter<float>(driver) {
+    partition_size = 128;
+  }
+
+  /// Block size in samples (power of 2): call before begin()
+  void setBlockSize(int samples) { setPartitionSize(samples); }
+
+  int blockSize() { return partition_size; }
+
+  /// Length of the echo path in ms: call before begin()
+  void setTailMs(int ms) { tail_ms = ms; }
+
+  /// Step size of the adaptation from 0.0 to 1.0 (default 0.5)
+  void setStepSize(float mu) { this->mu = mu; }
+
+  /// The adaptation is stopped if the microphone peak exceeds the far end
+  /// peak multiplied with this factor: e.g. 0.5 if the echo is at least 6 dB
+  /// below the far end. 0 disables the double talk detection (default 0.5)
+  void setDoubleTalkThreshold(float factor) { dtd_threshold = factor; }
+
+  /// Max number of reference samples which can be written ahead of the
+  /// microphone samples: call before begin()
+  void setReferenceBufferSize(int samples) { reference_size = samples; }
+
+  /// Starts the processing with the indicated sample rate
+  bool begin(int sampleRate) {
+    int tail = (int64_t)tail_ms * sampleRate / 1000;
+    if (!setup((tail + partition_size - 1) / partition_size)) return false;
+    power.resize(bins);
+    error_spectrum.resize(bins * 2);
+    mic.resize(partition_size);
+    result.resize(partition_size);
+    peaks.resize(partitions);
+    reference.resize(reference_size > 0 ? reference_size : 4 * partition_size);
+    if ((int)peaks.size() != partitions || reference.size() == 0) {
+      LOGE("not enough memory");
+      partitions = 0;
+      return false;
+    }
+    reset();
+    return true;
+  }
+
+  void end() {
+    p_driver->end();
+    partitions = 0;
+    impulse_spectrum.resize(0);
+    input_spectrum.resize(0);
+    accumulator.resize(0);
+    input.resize(0);
+    output.resize(0);
+    power.resize(0);
+    error_spectrum.resize(0);
+    mic.resize(0);
+    result.resize(0);
+    peaks.resize(0);
+    reference.resize(0);
+  }
+
+  /// Clears the history and the learned echo path
+  void reset() {
+    ConvolutionFilter<float>::reset();
+    memset(impulse_spectrum.data(), 0,
+           impulse_spectrum.size() * sizeof(float));
+    memset(result.data(), 0, result.size() * sizeof(int16_t));
+    memset(peaks.data(), 0, peaks.size() * sizeof(int16_t));
+    for (int k = 0; k < bins; k++) power[k] = 0.0f;
+    reference.reset();
+    constrain_idx = 0;
+    peak_idx = 0;
+    hangover = 0;
+  }
+
+  /// Records the far end samples which are sent to the speaker
+  void writeReference(const int16_t *data, size_t samples) {
+    if (partitions == 0) return;
+    for (size_t j = 0; j < samples; j++) {
+      // keep the most recent samples
+      if (reference.isFull()) reference.read();
+      reference.write(data[j]);
+    }
+  }
+
+  /// Removes the echo from the microphone samples in place: the result is
+  /// delayed by one block
+  void process(int16_t *data, size_t samples) {
+    if (partitions == 0) return;
+    float *ref = input.data() + partition_size;
+    for (size_t j = 0; j < samples; j++) {
+      // silence if the far end did not provide any data
+      ref[pos] = reference.isEmpty() ? 0.0f : reference.read();
+      mic[pos] = data[j];
+      data[j] = result[pos];
+      if (++pos == partition_size) processBlock();
+    }
+  }
+
+  /// Number of partitions of the adaptive filter
+  int partitionCount() { return partitions; }
+
+  /// Latency in samples
+  int latency() { return partition_size; }
+
+  /// True while the near end is talking and the adaptation is stopped
+  bool isDoubleTalk() { return hangover > 0; }
+
+ protected:
+  Vector<float> power{0};
+  Vector<float> error_spectrum{0};
+  Vector<float> mic{0};
+  Vector<int16_t> result{0};
+  // peak of the reference for each block of the tail
+  Vector<int16_t> peaks{0};
+  RingBuffer<int16_t> reference{0};
+  int tail_ms = 128;
+  int reference_size = 0;
+  int constrain_idx = 0;
+  int peak_idx = 0;
+  int hangover = 0;
+  float mu = 0.5f;
+  float dtd_threshold = 0.5f;
+  // smoothing of the reference power
+  const float power_smoothing = 0.9f;
+  // blocks for which the adaptation stays stopped after double talk
+  const int hangover_blocks = 8;
+
+  void processBlock() {
+    pos = 0;
+    // reference spectrum into the delay line and estimated echo to output
+    transformInput();
+    convolve();
+    bool is_double_talk = updateDoubleTalk();
+    // error = mic - echo
+    int16_t *out = result.data();
+    for (int j = 0; j < partition_size; j++) {
+      float error = mic[j] - output[j];
+      output[j] = error;
+      if (error > 32767.0f) error = 32767.0f;
+      if (error < -32768.0f) error = -32768.0f;
+      out[j] = error;
+    }
+    if (!is_double_talk) adapt();
+    memmove(input.data(), input.data() + partition_size,
+            partition_size * sizeof(float));
+  }
+
+  /// Normalized LMS update of all partitions with the error of the block
+  void adapt() {
+    // error spectrum: the first half is zero for overlap-save
+    for (int j = 0; j < partition_size; j++) {
+      p_driver->setValue(j, 0.0f);
+      p_driver->setValue(partition_size + j, output[j]);
+    }
+    p_driver->fft();
+    readSpectrum(error_spectrum.data());
+
+    // step size for each bin normalized by the reference power
+    const float *x0 = &input_spectrum[current_partition * bins * 2];
+    const float *e = error_spectrum.data();
+    const float regularization = (float)fft_len * 100.0f;
+    for (int k = 0; k < bins; k++) {
+      float p = x0[k * 2] * x0[k * 2] + x0[k * 2 + 1] * x0[k * 2 + 1];
+      power[k] = power_smoothing * power[k] + (1.0f - power_smoothing) * p;
+      float step = mu / (partitions * power[k] + regularization);
+      accumulator[k * 2] = e[k * 2] * step;
+      accumulator[k * 2 + 1] = e[k * 2 + 1] * step;
+    }
+
+    // W += conj(X) * E * step
+    const float *g = accumulator.data();
+    for (int p = 0; p < partitions; p++) {
+      int slot = (current_partition + p) % partitions;
+      const float *x = &input_spectrum[slot * bins * 2];
+      float *w = &impulse_spectrum[p * bins * 2];
+      for (int k = 0; k < bins * 2; k += 2) {
+        w[k] += x[k] * g[k] + x[k + 1] * g[k + 1];
+        w[k + 1] += x[k] * g[k + 1] - x[k + 1] * g[k];
+      }
+    }
+    constrain(constrain_idx);
+    constrain_idx = (constrain_idx + 1) % partitions;
+  }
+
+  /// Removes the circular part of the indicated partition: the second half
+  /// of the impulse response must be zero
+  void constrain(int p) {
+    float *w = &impulse_spectrum[p * bins * 2];
+    writeSpectrum(w);
+    p_driver->rfft();
+    for (int j = 0; j < partition_size; j++) {
+      p_driver->setValue(j, p_driver->getValue(j) * scale);
+    }
+    for (int j = partition_size; j < fft_len; j++) p_driver->setValue(j, 0.0f);
+    p_driver->fft();
+    readSpectrum(w);
+  }
+
+  /// Geigel detector: the near end is talking if the microphone peak is
+  /// bigger than the far end peak over the tail
+  bool updateDoubleTalk() {
+    const float *ref = input.data() + partition_size;
+    int16_t ref_peak = 0;
+    int16_t mic_peak = 0;
+    for (int j = 0; j < partition_size; j++) {
+      int16_t r = abs((int)ref[j]) > 32767 ? 32767 : abs((int)ref[j]);
+      int16_t m = abs((int)mic[j]) > 32767 ? 32767 : abs((int)mic[j]);
+      if (r > ref_peak) ref_peak = r;
+      if (m > mic_peak) mic_peak = m;
+    }
+    peaks[peak_idx] = ref_peak;
+    peak_idx = (peak_idx + 1) % partitions;
+    if (dtd_threshold <= 0.0f) return false;
+    int16_t max_peak = 0;
+    for (int p = 0; p < partitions; p++) {
+      if (peaks[p] > max_peak) max_peak = peaks[p];
+    }
+    if (mic_peak > dtd_threshold * max_peak) {
+      hangover = hangover_blocks;
+    } else if (hangover > 0) {
+      hangover--;
+    }
+    return hangover > 0;
+  }
+};
+
+/**
+ * @brief Echo cancellation for a full duplex stream (e.g. I2SStream in
+ * RXTX_MODE) with 16 bit mono data: the written data is sent to the
+ * speaker and recorded as far end reference; the data which is read from the
+ * microphone is provided w/o the echo.
+ * @code
+ * FFTDriverRealFFT driver;
+ * EchoCancellerStream aec(i2s, driver);
+ * aec.processor().setTailMs(200);
+ * aec.begin(AudioInfo(16000, 1, 16));
+ * @endcode
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class EchoCancellerStream : public ModifyingStream {
+ public:
+  EchoCancellerStream(FFTDriver &driver) : aec(driver) {}
+  EchoCancellerStream(Stream &io, FFTDriver &driver) : aec(driver) {
+    setStream(io);
+  }
+
+  void setStream(Stream &io) override {
+    p_stream = &io;
+    p_print = &io;
+  }
+
+  void setOutput(Print &out) override { p_print = &out; }
+
+  /// Provides access to the parameters
+  EchoCancellerProcessor &processor() { return aec; }
+
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    if (info.bits_per_sample != 16 || info.channels != 1) {
+      LOGE("only 16 bit mono is supported");
+      return false;
+    }
+    return aec.begin(info.sample_rate);
+  }
+
+  void end() override { aec.end(); }
+
+  /// Sends the far end data to the speaker and records it as reference
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_print == nullptr) return 0;
+    size_t result = p_print->write(data, len);
+    aec.writeReference((const int16_t *)data, result / sizeof(int16_t));
+    return result;
+  }
+
+  /// Provides the microphone data w/o the echo
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_stream == nullptr) return 0;
+    size_t result = p_stream->readBytes(data, len);
+    aec.process((int16_t *)data, result / sizeof(int16_t));
+    return result;
+  }
+
+  int available() override {
+    return p_stream == nullptr ? 0 : p_stream->available();
+  }
+
+  int availableForWrite() override {
+    return p_print == nullptr ? 0 : p_print->availableForWrite();
+  }
+
+ protected:
+  EchoCancellerProcessor aec;
+  Stream *p_stream = nullptr;
+  Print *p_print = nullptr;
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,132 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "AudioEffects/SineTable.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Low frequency oscillator for the modulation effects (chorus,
+ * flanger, tremolo, vibrato). It uses a 32 bit fixed point phase
+ * accumulator: the sine is taken from the shared SineTable in flash and the
+ * other waveforms are calculated directly from the phase, so there is no
+ * table per instance and no float operation per sample. The values are Q15
+ * in the range of -32767 to 32767 and can be provided in blocks.
+ *
+ * The Random waveform moves linearly to a new random value in each cycle.
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class LFO {
+ public:
+  enum Waveform { Sine, Triangle, Square, Sawtooth, Random };
+
+  LFO() = default;
+
+  LFO(float frequency, float sampleRate, Waveform waveform = Sine) {
+    setWaveform(waveform);
+    setFrequency(frequency, sampleRate);
+  }
+
+  void setWaveform(Waveform waveform) { wave = waveform; }
+
+  Waveform waveform() { return wave; }
+
+  void setFrequency(float frequency, float sampleRate) {
+    inc = SineTable::increment(frequency, sampleRate);
+  }
+
+  /// Defines the phase increment per sample directly (2^32 is one cycle)
+  void setIncrement(uint32_t increment) { inc = increment; }
+
+  /// Defines the phase as fraction of a cycle
+  void setPhase(float cycles) { phase_acc = SineTable::phase(cycles); }
+
+  /// Provides the next Q15 value
+  inline int16_t next() {
+    int16_t result = value(phase_acc);
+    advance(inc);
+    return result;
+  }
+
+  /// Provides the next n Q15 values
+  void next(int16_t *out, size_t n) {
+    uint32_t phase = phase_acc;
+    switch (wave) {
+      case Sine:
+        for (size_t j = 0; j < n; j++, phase += inc) out[j] = SineTable::sine(phase);
+        break;
+      case Triangle:
+        for (size_t j = 0; j < n; j++, phase += inc) out[j] = triangle(phase);
+        break;
+      case Square:
+        for (size_t j = 0; j < n; j++, phase += inc) out[j] = square(phase);
+        break;
+      case Sawtooth:
+        for (size_t j = 0; j < n; j++, phase += inc) out[j] = sawtooth(phase);
+        break;
+      case Random:
+        for (size_t j = 0; j < n; j++) out[j] = next();
+        return;
+    }
+    phase_acc = phase;
+  }
+
+  /// Q15 value for the indicated phase
+  int16_t value(uint32_t phase) {
+    switch (wave) {
+      case Triangle:
+        return triangle(phase);
+      case Square:
+        return square(phase);
+      case Sawtooth:
+        return sawtooth(phase);
+      case Random:
+        return random_from + (((random_to - random_from) * (int32_t)(phase >> 17)) >> 15);
+      default:
+        return SineTable::sine(phase);
+    }
+  }
+
+ protected:
+  uint32_t phase_acc = 0;
+  uint32_t inc = 0;
+  Waveform wave = Sine;
+  int32_t random_from = 0;
+  int32_t random_to = 0;
+  uint32_t random_state = 0x12345678;
+
+  inline void advance(uint32_t delta) {
+    uint32_t old = phase_acc;
+    phase_acc += delta;
+    // new random target after each cycle
+    if (wave == Random && phase_acc < old) {
+      random_from = random_to;
+      random_state ^= random_state << 13;
+      random_state ^= random_state >> 17;
+      random_state ^= random_state << 5;
+      random_to = (int32_t)(random_state >> 16) - 32768;
+      if (random_to < -32767) random_to = -32767;
+    }
+  }
+
+  /// same phase as the sine: starts at 0 and rises
+  static inline int16_t triangle(uint32_t phase) {
+    int32_t u = (phase + 0x40000000u) >> 16;
+    int32_t v = u < 32768 ? u : 65535 - u;
+    return 2 * v - 32767;
+  }
+
+  static inline int16_t square(uint32_t phase) {
+    return phase < 0x80000000u ? 32767 : -32767;
+  }
+
+  static inline int16_t sawtooth(uint32_t phase) {
+    int32_t result = (int32_t)(phase >> 16) - 32768;
+    return result < -32767 ? -32767 : result;
+  }
+};
+
+}  // namespace audio_tools
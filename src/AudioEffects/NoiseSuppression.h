@@ -0,0 +1,253 @@
+#pragma once
+#include "AudioBasic/Collections.h"
+#include "AudioLibs/AudioFFT.h"
+#include "AudioTools/BaseConverter.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Spectral noise suppression (Wiener filter) for mono 16 bit
+ * samples: e.g. for the microphone of an intercom. The signal is processed
+ * with an overlap-add STFT: frames of 2 hops with a sqrt hann window are
+ * zero padded to the next power of 2 and transformed with the indicated
+ * FFTDriver. The noise floor of each bin is tracked incrementally: it is
+ * estimated from the first frames and then averaged over the frames where
+ * the bin contains only noise, so speech raises it only slowly. The gains are
+ * calculated with the decision directed a priori SNR and are limited by the
+ * max reduction.
+ *
+ * With a hop of 160 samples at 16 kHz (10 ms) a 512 point FFT is used. The
+ * processing is in place with a delay of one hop.
+ * @code
+ * FFTDriverRealFFT driver;
+ * NoiseSuppressionConverter ns(driver);
+ * ns.processor().setReductionDB(15);
+ * ns.begin(info);
+ * @endcode
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class NoiseSuppressionProcessor {
+ public:
+  NoiseSuppressionProcessor(FFTDriver &driver) { p_driver = &driver; }
+
+  /// Max attenuation of the noise in dB (default 20)
+  void setReductionDB(float db) { min_gain = powf(10.0f, -db / 20.0f); }
+
+  /// Relative increase of the noise floor per frame (default 0.005)
+  void setNoiseRise(float rise) { noise_rise = 1.0f + rise; }
+
+  /// Smoothing of the a priori SNR from 0.0 to 1.0 (default 0.98)
+  void setSmoothing(float alpha) { this->alpha = alpha; }
+
+  /// Defines the allocator for the work buffers: call before begin()
+  void setAllocator(Allocator &allocator) {
+    window.setAllocator(allocator);
+    input.setAllocator(allocator);
+    ola.setAllocator(allocator);
+    output.setAllocator(allocator);
+    noise.setAllocator(allocator);
+    snr.setAllocator(allocator);
+  }
+
+  /// Starts the processing with the indicated hop size in samples: e.g.
+  /// sampleRate / 100 for 10 ms
+  bool begin(int hopSamples) {
+    hop = hopSamples;
+    frame = 2 * hop;
+    fft_len = 8;
+    while (fft_len < frame) fft_len *= 2;
+    bins = fft_len / 2 + 1;
+    window.resize(frame);
+    input.resize(frame);
+    ola.resize(frame);
+    output.resize(hop);
+    noise.resize(bins);
+    snr.resize(bins);
+    if ((int)snr.size() != bins) {
+      LOGE("not enough memory");
+      return false;
+    }
+    if (!p_driver->begin(fft_len) || !p_driver->isReverseFFT()) {
+      LOGE("FFTDriver does not support the inverse fft");
+      return false;
+    }
+    // periodic sqrt hann: the product of the analysis and synthesis windows
+    // adds up to 1 with 50% overlap
+    for (int j = 0; j < frame; j++) {
+      window[j] = sqrtf(0.5f - 0.5f * cosf(2.0f * PI * j / frame));
+    }
+    setupScale();
+    reset();
+    return true;
+  }
+
+  void end() {
+    p_driver->end();
+    window.resize(0);
+    input.resize(0);
+    ola.resize(0);
+    output.resize(0);
+    noise.resize(0);
+    snr.resize(0);
+  }
+
+  /// Restarts the noise estimation
+  void reset() {
+    memset(input.data(), 0, input.size() * sizeof(float));
+    memset(ola.data(), 0, ola.size() * sizeof(float));
+    memset(output.data(), 0, output.size() * sizeof(int16_t));
+    for (int j = 0; j < bins; j++) {
+      noise[j] = 0.0f;
+      snr[j] = 1.0f;
+    }
+    pos = 0;
+    frames = 0;
+  }
+
+  /// Processes the mono samples in place: the result is delayed by one hop
+  void process(int16_t *data, size_t samples) {
+    if (hop == 0) return;
+    float *in = input.data() + frame - hop;
+    for (size_t j = 0; j < samples; j++) {
+      in[pos] = data[j];
+      data[j] = output[pos];
+      if (++pos == hop) {
+        processFrame();
+        pos = 0;
+      }
+    }
+  }
+
+  /// Estimated noise power of the indicated bin
+  float noisePower(int bin) { return noise[bin]; }
+
+  /// Number of bins
+  int size() { return bins; }
+
+ protected:
+  FFTDriver *p_driver = nullptr;
+  Vector<float> window{0};
+  Vector<float> input{0};
+  Vector<float> ola{0};
+  Vector<int16_t> output{0};
+  Vector<float> noise{0};
+  // previous |G|^2 * snr_post for the decision directed estimation
+  Vector<float> snr{0};
+  int hop = 0;
+  int frame = 0;
+  int fft_len = 0;
+  int bins = 0;
+  int pos = 0;
+  uint32_t frames = 0;
+  float scale = 1.0f;
+  float min_gain = 0.1f;
+  float noise_rise = 1.005f;
+  float alpha = 0.98f;
+  // frames which are used for the initial noise estimate
+  const uint32_t init_frames = 10;
+  // power relative to the noise above which a bin is considered as signal
+  const float speech_threshold = 4.0f;
+  const float noise_smoothing = 0.9f;
+
+  /// Determines the scaling of the reverse fft of the driver
+  void setupScale() {
+    for (int j = 0; j < fft_len; j++) p_driver->setValue(j, j == 0 ? 1.0f : 0.0f);
+    p_driver->fft();
+    p_driver->rfft();
+    float gain = p_driver->getValue(0);
+    scale = gain != 0.0f ? 1.0f / gain : 1.0f;
+  }
+
+  void processFrame() {
+    // analysis
+    for (int j = 0; j < frame; j++) p_driver->setValue(j, input[j] * window[j]);
+    for (int j = frame; j < fft_len; j++) p_driver->setValue(j, 0.0f);
+    p_driver->fft();
+    // gains
+    FFTBin bin;
+    for (int k = 0; k < bins; k++) {
+      p_driver->getBin(k, bin);
+      float power = bin.real * bin.real + bin.img * bin.img;
+      updateNoise(k, power);
+      float gain = wienerGain(k, power);
+      bin.multiply(gain);
+      p_driver->setBin(k, bin);
+    }
+    frames++;
+    // synthesis with overlap-add
+    p_driver->rfft();
+    for (int j = 0; j < frame; j++) {
+      ola[j] += p_driver->getValue(j) * scale * window[j];
+    }
+    for (int j = 0; j < hop; j++) {
+      float value = ola[j];
+      if (value > 32767.0f) value = 32767.0f;
+      if (value < -32768.0f) value = -32768.0f;
+      output[j] = value;
+    }
+    memmove(ola.data(), ola.data() + hop, (frame - hop) * sizeof(float));
+    memset(ola.data() + frame - hop, 0, hop * sizeof(float));
+    memmove(input.data(), input.data() + hop, (frame - hop) * sizeof(float));
+  }
+
+  /// Recursive average of the power of the bins which contain only noise:
+  /// bins with a much higher power (e.g. speech) raise it only slowly
+  void updateNoise(int k, float power) {
+    if (frames < init_frames) {
+      noise[k] = (noise[k] * frames + power) / (frames + 1);
+    } else if (power < speech_threshold * noise[k]) {
+      noise[k] = noise_smoothing * noise[k] + (1.0f - noise_smoothing) * power;
+    } else {
+      noise[k] *= noise_rise;
+    }
+    // avoid a stuck estimate after digital silence
+    if (noise[k] < 1.0f) noise[k] = 1.0f;
+  }
+
+  /// Wiener gain with the decision directed a priori SNR
+  float wienerGain(int k, float power) {
+    float snr_post = power / noise[k];
+    float snr_prio = snr_post - 1.0f;
+    if (snr_prio < 0.0f) snr_prio = 0.0f;
+    snr_prio = alpha * snr[k] + (1.0f - alpha) * snr_prio;
+    float gain = snr_prio / (1.0f + snr_prio);
+    if (gain < min_gain) gain = min_gain;
+    snr[k] = gain * gain * snr_post;
+    return gain;
+  }
+};
+
+/**
+ * @brief The NoiseSuppressionProcessor as converter for 16 bit mono data:
+ * e.g. in a ConverterStream. The hop size is 10 ms.
+ * @ingroup convert
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class NoiseSuppressionConverter : public BaseConverter {
+ public:
+  NoiseSuppressionConverter(FFTDriver &driver) : ns(driver) {}
+
+  /// Provides access to the parameters
+  NoiseSuppressionProcessor &processor() { return ns; }
+
+  bool begin(AudioInfo info) {
+    if (info.bits_per_sample != 16 || info.channels != 1) {
+      LOGE("only 16 bit mono is supported");
+      return false;
+    }
+    return ns.begin(info.sample_rate / 100);
+  }
+
+  size_t convert(uint8_t *src, size_t size) override {
+    ns.process((int16_t *)src, size / sizeof(int16_t));
+    return size;
+  }
+
+ protected:
+  NoiseSuppressionProcessor ns;
+};
+
+}  // namespace audio_tools
@@ -1,6 +1,7 @@
 
 #pragma once
 #include "AudioConfig.h"
+#include "AudioEffects/SineTable.h"
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -461,4 +462,169 @@ protected:
   }
 };
 
+/**
+ * @brief Block based granular (overlap-add) pitch shifter in fixed point which
+ * is intended for MCUs: we read from a delay line with two taps which are
+ * half a grain apart. The delay of the taps changes with (1 - pitch shift)
+ * and each tap is faded with a raised cosine window, so that the tap which
+ * jumps at the end of the grain is silent. The two windows add up to 1.
+ * There are no virtual calls and no float operations per sample.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class GranularPitchShift {
+public:
+  /// Uses the buffer_size as grain size (rounded down to a power of 2)
+  bool begin(PitchShiftInfo info) {
+    grain_bits = 4;
+    while ((2 << grain_bits) <= info.buffer_size && grain_bits < 14)
+      grain_bits++;
+    int grain = 1 << grain_bits;
+    buffer.resize(grain * 2);
+    memset(buffer.data(), 0, buffer.size() * sizeof(int16_t));
+    mask = buffer.size() - 1;
+    write_pos = 0;
+    phase = 0;
+    setPitchShift(info.pitch_shift);
+    return true;
+  }
+
+  /// Defines the pitch shift factor (e.g. 2.0 is one octave up)
+  void setPitchShift(float shift) {
+    // change of the delay per sample as fraction of the grain
+    float delta = (1.0f - shift) / (1 << grain_bits);
+    phase_inc = (int32_t)(int64_t)(delta * 4294967296.0);
+  }
+
+  /// Latency in samples
+  int latency() { return 1 << (grain_bits - 1); }
+
+  /// Processes the mono samples in place
+  void process(int16_t *data, size_t samples) {
+    int16_t *buf = buffer.data();
+    int shift = 32 - grain_bits;
+    for (size_t j = 0; j < samples; j++) {
+      buf[write_pos] = data[j];
+      uint32_t phase2 = phase + 0x80000000u;
+      int32_t result = tap(buf, phase, shift) + tap(buf, phase2, shift);
+      data[j] = result >> 15;
+      phase += phase_inc;
+      write_pos = (write_pos + 1) & mask;
+    }
+  }
+
+protected:
+  Vector<int16_t> buffer{0};
+  int grain_bits = 10;
+  uint32_t mask = 0;
+  uint32_t write_pos = 0;
+  uint32_t phase = 0;
+  int32_t phase_inc = 0;
+
+  /// windowed sample (Q15) of the tap with the delay defined by the phase
+  inline int32_t tap(int16_t *buf, uint32_t tap_phase, int shift) {
+    uint32_t delay = tap_phase >> shift;
+    int32_t frac = (tap_phase >> (shift - 15)) & 0x7FFF;
+    int32_t s1 = buf[(write_pos - delay) & mask];
+    int32_t s2 = buf[(write_pos - delay - 1) & mask];
+    int32_t sample = s1 + (((s2 - s1) * frac) >> 15);
+    // raised cosine: 0 at a delay of 0 and 1 in the middle of the grain
+    int32_t window = (32767 - SineTable::sine(tap_phase + 0x40000000u)) >> 1;
+    return sample * window;
+  }
+};
+
+/**
+ * @brief Pitch Shift which uses a block based engine (e.g. GranularPitchShift
+ * or PhaseVocoderPitchShift): we reduce the channels to 1 to calculate the
+ * pitch shift and provide the result in the correct number of channels. Only
+ * 16 bit data is supported.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam EngineT
+ */
+template <class EngineT = GranularPitchShift>
+class PitchShiftBlockOutput : public AudioOutput {
+public:
+  PitchShiftBlockOutput(Print &out) { p_out = &out; }
+
+  PitchShiftBlockOutput(Print &out, EngineT &engine) {
+    p_out = &out;
+    p_engine = &engine;
+  }
+
+  PitchShiftInfo defaultConfig() {
+    PitchShiftInfo result;
+    result.buffer_size = 1024;
+    return result;
+  }
+
+  bool begin(PitchShiftInfo info) {
+    TRACED();
+    if (info.bits_per_sample != 16) {
+      LOGE("bits_per_sample not supported: %d", info.bits_per_sample);
+      return false;
+    }
+    cfg = info;
+    AudioOutput::setAudioInfo(info);
+    active = engine().begin(info);
+    return active;
+  }
+
+  /// Changes the pitch shift factor
+  void setPitchShift(float shift) {
+    cfg.pitch_shift = shift;
+    engine().setPitchShift(shift);
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!active)
+      return 0;
+    int channels = cfg.channels;
+    const int16_t *p_in = (const int16_t *)data;
+    int frames = len / (sizeof(int16_t) * channels);
+    const int max_frames = 128;
+    int16_t mono[max_frames];
+    int16_t out[max_frames * channels];
+    for (int pos = 0; pos < frames; pos += max_frames) {
+      int n = min(max_frames, frames - pos);
+      // calculate avg sample value
+      for (int j = 0; j < n; j++) {
+        int32_t total = 0;
+        for (int ch = 0; ch < channels; ch++)
+          total += p_in[(pos + j) * channels + ch];
+        mono[j] = total / channels;
+      }
+      engine().process(mono, n);
+      for (int j = 0; j < n; j++) {
+        for (int ch = 0; ch < channels; ch++)
+          out[j * channels + ch] = mono[j];
+      }
+      writeAll((uint8_t *)out, n * channels * sizeof(int16_t));
+    }
+    return frames * channels * sizeof(int16_t);
+  }
+
+  void end() { active = false; }
+
+protected:
+  EngineT default_engine;
+  EngineT *p_engine = nullptr;
+  bool active = false;
+  PitchShiftInfo cfg;
+  Print *p_out = nullptr;
+
+  EngineT &engine() { return p_engine != nullptr ? *p_engine : default_engine; }
+
+  void writeAll(const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    int retry = 0;
+    while (pos < len && retry++ < 100) {
+      pos += p_out->write(data + pos, len - pos);
+    }
+  }
+};
+
 } // namespace audio_tools
\ No newline at end of file
@@ -0,0 +1,185 @@
+#pragma once
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioEffects/PitchShift.h"
+#include "AudioLibs/AudioFFT.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Block based phase vocoder pitch shifter: the signal is processed in
+ * frames of the FFT size (buffer_size, power of 2) with an overlap of 4. For
+ * each frame we determine the true frequency of each bin from the phase
+ * difference, move the bins by the pitch shift factor and resynthesize the
+ * frame with the accumulated phases, which is then added to the output with
+ * an overlap-add. This gives less artefacts than a time domain shifter but
+ * needs more CPU and a latency of one FFT size.
+ *
+ * The FFT is executed by any FFTDriver which supports the reverse FFT (e.g.
+ * FFTDriverRealFFT, FFTDriverKissFFT or FFTDriverESP32): it is set up only
+ * once in begin().
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class PhaseVocoderPitchShift {
+ public:
+  PhaseVocoderPitchShift() = default;
+  PhaseVocoderPitchShift(FFTDriver &driver) { setDriver(driver); }
+
+  void setDriver(FFTDriver &driver) { p_driver = &driver; }
+
+  /// Uses the buffer_size as FFT size
+  bool begin(PitchShiftInfo info) {
+    if (p_driver == nullptr) {
+      LOGE("FFTDriver not defined");
+      return false;
+    }
+    fft_len = 16;
+    while (fft_len * 2 <= info.buffer_size) fft_len *= 2;
+    hop = fft_len / overlap;
+    bins = fft_len / 2 + 1;
+    if (!p_driver->begin(fft_len) || !p_driver->isReverseFFT()) {
+      LOGE("FFT driver does not support the reverse FFT");
+      return false;
+    }
+    window.resize(fft_len);
+    for (int j = 0; j < fft_len; j++) {
+      window[j] = 0.5f - 0.5f * cosf(2.0f * PI * j / fft_len);
+    }
+    input.resize(fft_len);
+    output.resize(fft_len);
+    last_phase.resize(bins);
+    sum_phase.resize(bins);
+    magnitudes.resize(bins);
+    frequencies.resize(bins);
+    syn_magnitudes.resize(bins);
+    syn_frequencies.resize(bins);
+    reset();
+    setPitchShift(info.pitch_shift);
+    return setupScale();
+  }
+
+  void end() { p_driver->end(); }
+
+  /// Defines the pitch shift factor (e.g. 2.0 is one octave up)
+  void setPitchShift(float shift) { pitch_shift = shift; }
+
+  /// Latency in samples
+  int latency() { return fft_len; }
+
+  /// Processes the mono samples in place
+  void process(int16_t *data, size_t samples) {
+    for (size_t j = 0; j < samples; j++) {
+      input[fft_len - hop + pos] = data[j];
+      data[j] = NumberConverter::clipT<float, int16_t>(output[pos]);
+      if (++pos >= hop) processFrame();
+    }
+  }
+
+ protected:
+  FFTDriver *p_driver = nullptr;
+  const int overlap = 4;
+  int fft_len = 0;
+  int hop = 0;
+  int bins = 0;
+  int pos = 0;
+  float pitch_shift = 1.0f;
+  float scale = 1.0f;
+  Vector<float> window{0};
+  Vector<float> input{0};
+  Vector<float> output{0};
+  Vector<float> last_phase{0};
+  Vector<float> sum_phase{0};
+  Vector<float> magnitudes{0};
+  Vector<float> frequencies{0};
+  Vector<float> syn_magnitudes{0};
+  Vector<float> syn_frequencies{0};
+
+  void reset() {
+    pos = 0;
+    clear(input);
+    clear(output);
+    clear(last_phase);
+    clear(sum_phase);
+  }
+
+  static void clear(Vector<float> &vector) {
+    memset(vector.data(), 0, vector.size() * sizeof(float));
+  }
+
+  /// Determines the scaling of the driver for a forward and reverse FFT
+  bool setupScale() {
+    for (int j = 0; j < fft_len; j++) p_driver->setValue(j, j == 0 ? 1.0f : 0.0f);
+    p_driver->fft();
+    FFTBin bin{0, 0};
+    for (int k = 0; k < fft_len; k++) {
+      p_driver->getBin(k, bin);
+      p_driver->setBin(k, bin.real, bin.img);
+    }
+    p_driver->rfft();
+    float value = p_driver->getValue(0);
+    if (value == 0.0f) {
+      LOGE("FFT driver does not provide the reverse FFT result");
+      return false;
+    }
+    // the overlap-add of the squared hann windows (overlap 4) adds up to 1.5
+    scale = 1.0f / value / 1.5f;
+    return true;
+  }
+
+  static float wrapPhase(float phase) {
+    phase = fmodf(phase + PI, 2.0f * PI);
+    if (phase < 0.0f) phase += 2.0f * PI;
+    return phase - PI;
+  }
+
+  void processFrame() {
+    pos = 0;
+    const float expected = 2.0f * PI * hop / fft_len;
+    // analysis
+    for (int j = 0; j < fft_len; j++) {
+      p_driver->setValue(j, input[j] * window[j]);
+    }
+    p_driver->fft();
+    FFTBin bin{0, 0};
+    for (int k = 0; k < bins; k++) {
+      p_driver->getBin(k, bin);
+      float phase = atan2f(bin.img, bin.real);
+      float delta = wrapPhase(phase - last_phase[k] - k * expected);
+      last_phase[k] = phase;
+      magnitudes[k] = sqrtf(bin.real * bin.real + bin.img * bin.img);
+      // true frequency in bins
+      frequencies[k] = k + delta / expected;
+    }
+
+    // move the bins
+    clear(syn_magnitudes);
+    clear(syn_frequencies);
+    for (int k = 0; k < bins; k++) {
+      int target = k * pitch_shift + 0.5f;
+      if (target >= bins) break;
+      syn_magnitudes[target] += magnitudes[k];
+      syn_frequencies[target] = frequencies[k] * pitch_shift;
+    }
+
+    // synthesis: the upper half is the conjugate of the lower half
+    for (int k = 0; k < bins; k++) {
+      sum_phase[k] = wrapPhase(sum_phase[k] + syn_frequencies[k] * expected);
+      float real = syn_magnitudes[k] * cosf(sum_phase[k]);
+      float img = syn_magnitudes[k] * sinf(sum_phase[k]);
+      p_driver->setBin(k, real, img);
+      if (k > 0 && k < fft_len - k) p_driver->setBin(fft_len - k, real, -img);
+    }
+    p_driver->rfft();
+
+    // overlap-add
+    memmove(output.data(), output.data() + hop, (fft_len - hop) * sizeof(float));
+    memset(output.data() + fft_len - hop, 0, hop * sizeof(float));
+    for (int j = 0; j < fft_len; j++) {
+      output[j] += p_driver->getValue(j) * window[j] * scale;
+    }
+    memmove(input.data(), input.data() + hop, (fft_len - hop) * sizeof(float));
+  }
+};
+
+}  // namespace audio_tools
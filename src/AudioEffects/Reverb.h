@@ -0,0 +1,363 @@
+#pragma once
+#include "AudioBasic/Collections.h"
+#include "AudioEffects/AudioEffect.h"
+#include "AudioTools/BaseConverter.h"
+
+/// Number of frames which are processed in one block
+#ifndef REVERB_BLOCK_SIZE
+#  define REVERB_BLOCK_SIZE 64
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Freeverb style reverb (parallel lowpass feedback comb filters
+ * followed by allpass filters) in fixed point for 16 bit interleaved mono or
+ * stereo samples. The delay lines are stored as int16_t, the feedback and
+ * damping are calculated in Q15 and each filter processes a whole block
+ * before the next filter is used. The quality defines the number of
+ * filters: High uses the 8 combs and 4 allpasses of the original Freeverb,
+ * Medium 6 and 3 and Low 4 and 2. With stereo each channel has its own
+ * filters with slightly different delays.
+ *
+ * All delay lines are allocated in one block from the allocator which can be
+ * defined with setAllocator(): e.g. an AllocatorArena.
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ReverbProcessor {
+ public:
+  enum Quality { Low, Medium, High };
+
+  ReverbProcessor(Quality quality = Medium) { setQuality(quality); }
+
+  /// Defines the allocator for the delay lines: call before begin()
+  void setAllocator(Allocator &allocator) { memory.setAllocator(allocator); }
+
+  /// Defines the number of filters: call before begin()
+  void setQuality(Quality quality) { this->quality = quality; }
+
+  /// Reduces the number of filters which are processed w/o reallocating the
+  /// delay lines: it is limited to the quality which was used in begin()
+  void setActiveQuality(Quality activeQuality) {
+    int count = activeQuality == High ? 8 : activeQuality == Medium ? 6 : 4;
+    if (count > comb_count) count = comb_count;
+    // the reactivated filters must not contain old data
+    for (int ch = 0; ch < channels && memory.size() > 0; ch++) {
+      for (int j = active_comb_count; j < count; j++) clear(combs[ch][j]);
+      for (int j = active_comb_count / 2; j < count / 2; j++)
+        clear(allpasses[ch][j]);
+    }
+    active_comb_count = count;
+  }
+
+  /// Room size from 0.0 to 1.0: defines the feedback of the combs
+  void setRoomSize(float size) {
+    room_size = limit(size);
+    updateParameters();
+  }
+
+  /// Damping of the high frequencies from 0.0 to 1.0
+  void setDamping(float damping) {
+    this->damping = limit(damping);
+    updateParameters();
+  }
+
+  /// Level of the reverb from 0.0 to 1.0
+  void setWet(float wet) {
+    this->wet = limit(wet);
+    updateParameters();
+  }
+
+  /// Level of the input signal from 0.0 to 1.0
+  void setDry(float dry) {
+    this->dry = limit(dry);
+    updateParameters();
+  }
+
+  /// Stereo width from 0.0 to 1.0
+  void setWidth(float width) {
+    this->width = limit(width);
+    updateParameters();
+  }
+
+  /// Allocates the delay lines for the indicated format (1 or 2 channels)
+  bool begin(uint32_t sampleRate, int channels = 1) {
+    if (channels < 1 || channels > 2) {
+      LOGE("channels not supported: %d", channels);
+      return false;
+    }
+    this->channels = channels;
+    comb_count = quality == High ? 8 : quality == Medium ? 6 : 4;
+    allpass_count = comb_count / 2;
+    active_comb_count = comb_count;
+    float factor = sampleRate / 44100.0f;
+    int total = 0;
+    for (int ch = 0; ch < channels; ch++) {
+      int spread = ch == 0 ? 0 : stereo_spread;
+      for (int j = 0; j < comb_count; j++) {
+        total += setup(combs[ch][j], (comb_tuning[j] + spread) * factor, total);
+      }
+      for (int j = 0; j < allpass_count; j++) {
+        total += setup(allpasses[ch][j], (allpass_tuning[j] + spread) * factor,
+                       total);
+      }
+    }
+    memory.resize(total);
+    if ((int)memory.size() != total) {
+      LOGE("not enough memory for %d samples", total);
+      return false;
+    }
+    clear();
+    updateParameters();
+    return true;
+  }
+
+  /// Releases the memory
+  void end() {
+    memory.resize(0);
+    memory.shrink_to_fit();
+  }
+
+  /// Sets all delay lines to 0
+  void clear() {
+    memset(memory.data(), 0, memory.size() * sizeof(int16_t));
+    for (int ch = 0; ch < 2; ch++) {
+      for (auto &comb : combs[ch]) {
+        comb.pos = 0;
+        comb.filter = 0;
+      }
+      for (auto &allpass : allpasses[ch]) allpass.pos = 0;
+    }
+  }
+
+  /// Number of bytes which are used by the delay lines
+  size_t memorySize() { return memory.size() * sizeof(int16_t); }
+
+  /// Processes the interleaved samples in place
+  void process(int16_t *data, size_t samples) {
+    if (memory.size() == 0) return;
+    size_t frames = samples / channels;
+    for (size_t pos = 0; pos < frames; pos += REVERB_BLOCK_SIZE) {
+      int n = min(frames - pos, (size_t)REVERB_BLOCK_SIZE);
+      processBlock(data + pos * channels, n);
+    }
+  }
+
+ protected:
+  struct Comb {
+    int offset = 0;
+    int size = 0;
+    int pos = 0;
+    int32_t filter = 0;
+  };
+  struct Allpass {
+    int offset = 0;
+    int size = 0;
+    int pos = 0;
+  };
+  // Freeverb tunings for 44.1 kHz
+  const int comb_tuning[8] = {1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617};
+  const int allpass_tuning[4] = {556, 441, 341, 225};
+  const int stereo_spread = 23;
+  Vector<int16_t> memory{0};
+  Comb combs[2][8];
+  Allpass allpasses[2][4];
+  Quality quality = Medium;
+  int channels = 1;
+  int comb_count = 0;
+  int allpass_count = 0;
+  int active_comb_count = 0;
+  float room_size = 0.5f, damping = 0.5f, wet = 0.33f, dry = 0.7f,
+        width = 1.0f;
+  // Q15 coefficients
+  int32_t feedback_q15 = 0, damp1_q15 = 0, damp2_q15 = 0, input_q15 = 0;
+  // Q12 output gains (which can be > 1)
+  int32_t wet1_q12 = 0, wet2_q12 = 0, dry_q12 = 0;
+
+  static float limit(float value) {
+    if (value < 0.0f) return 0.0f;
+    if (value > 1.0f) return 1.0f;
+    return value;
+  }
+
+  static inline int32_t saturate(int32_t value) {
+    if (value > 32767) return 32767;
+    if (value < -32768) return -32768;
+    return value;
+  }
+
+  template <class T>
+  void clear(T &filter) {
+    memset(memory.data() + filter.offset, 0, filter.size * sizeof(int16_t));
+    filter.pos = 0;
+  }
+
+  template <class T>
+  int setup(T &filter, int size, int offset) {
+    filter.offset = offset;
+    filter.size = size < 1 ? 1 : size;
+    filter.pos = 0;
+    return filter.size;
+  }
+
+  void updateParameters() {
+    // scaling factors of Freeverb
+    const float scale_wet = 3.0f, scale_dry = 2.0f, scale_room = 0.28f,
+                offset_room = 0.7f, scale_damp = 0.4f, fixed_gain = 0.015f;
+    feedback_q15 = (room_size * scale_room + offset_room) * 32767;
+    damp1_q15 = damping * scale_damp * 32767;
+    damp2_q15 = 32767 - damp1_q15;
+    // the mono input is the sum of both channels
+    input_q15 = fixed_gain * (channels == 1 ? 2 : 1) * 32767;
+    float wet_scaled = wet * scale_wet;
+    if (channels == 1) {
+      wet1_q12 = wet_scaled * 4096;
+      wet2_q12 = 0;
+    } else {
+      wet1_q12 = wet_scaled * (width / 2 + 0.5f) * 4096;
+      wet2_q12 = wet_scaled * ((1 - width) / 2) * 4096;
+    }
+    dry_q12 = dry * scale_dry * 4096;
+  }
+
+  void processBlock(int16_t *data, int n) {
+    int16_t input[REVERB_BLOCK_SIZE];
+    int32_t out[2][REVERB_BLOCK_SIZE];
+    for (int j = 0; j < n; j++) {
+      int32_t sum = data[j * channels];
+      if (channels == 2) sum += data[j * channels + 1];
+      input[j] = saturate((sum * input_q15) >> 15);
+    }
+    for (int ch = 0; ch < channels; ch++) {
+      int32_t *acc = out[ch];
+      memset(acc, 0, n * sizeof(int32_t));
+      for (int j = 0; j < active_comb_count; j++)
+        processComb(combs[ch][j], input, acc, n);
+      for (int j = 0; j < active_comb_count / 2; j++)
+        processAllpass(allpasses[ch][j], acc, n);
+    }
+    // mix with the dry signal
+    int32_t *out_l = out[0];
+    int32_t *out_r = out[channels - 1];
+    for (int j = 0; j < n; j++) {
+      for (int ch = 0; ch < channels; ch++) {
+        int32_t wet_own = ch == 0 ? out_l[j] : out_r[j];
+        int32_t wet_other = ch == 0 ? out_r[j] : out_l[j];
+        int16_t &sample = data[j * channels + ch];
+        sample = saturate((sample * dry_q12 + wet_own * wet1_q12 +
+                           wet_other * wet2_q12) >> 12);
+      }
+    }
+  }
+
+  /// Lowpass feedback comb filter: adds the output to acc
+  void processComb(Comb &comb, const int16_t *input, int32_t *acc, int n) {
+    int16_t *buffer = memory.data() + comb.offset;
+    int size = comb.size;
+    int pos = comb.pos;
+    int32_t filter = comb.filter;
+    const int32_t feedback = feedback_q15, damp1 = damp1_q15, damp2 = damp2_q15;
+    for (int j = 0; j < n; j++) {
+      int32_t output = buffer[pos];
+      filter = (output * damp2 + filter * damp1) >> 15;
+      buffer[pos] = saturate(input[j] + ((filter * feedback) >> 15));
+      if (++pos >= size) pos = 0;
+      acc[j] += output;
+    }
+    comb.pos = pos;
+    comb.filter = filter;
+  }
+
+  /// Allpass filter which is processed in place: the result is in the
+  /// range of int16_t
+  void processAllpass(Allpass &allpass, int32_t *data, int n) {
+    int16_t *buffer = memory.data() + allpass.offset;
+    int size = allpass.size;
+    int pos = allpass.pos;
+    for (int j = 0; j < n; j++) {
+      int32_t input = saturate(data[j]);
+      int32_t output = buffer[pos];
+      buffer[pos] = saturate(input + (output >> 1));
+      if (++pos >= size) pos = 0;
+      data[j] = saturate(output - input);
+    }
+    allpass.pos = pos;
+  }
+};
+
+/**
+ * @brief The ReverbProcessor as AudioEffect for mono samples
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ReverbEffect : public AudioEffect {
+ public:
+  ReverbEffect(uint32_t sampleRate = 44100,
+               ReverbProcessor::Quality quality = ReverbProcessor::Medium)
+      : processor(quality) {
+    processor.begin(sampleRate, 1);
+  }
+
+  /// Provides access to the parameters
+  ReverbProcessor &reverb() { return processor; }
+
+  effect_t process(effect_t input) override {
+    if (!active()) return input;
+    processor.process(&input, 1);
+    return input;
+  }
+
+  void process(effect_t *data, size_t len) override {
+    if (!active()) return;
+    processor.process(data, len);
+  }
+
+  ReverbEffect *clone() override { return new ReverbEffect(*this); }
+
+ protected:
+  ReverbProcessor processor;
+};
+
+/**
+ * @brief The ReverbProcessor as converter for 16 bit interleaved mono or
+ * stereo data: e.g. in a ConverterStream.
+ * @code
+ * AllocatorArena arena(64 * 1024);
+ * ReverbConverter reverb;
+ * reverb.reverb().setAllocator(arena);
+ * reverb.reverb().setRoomSize(0.8);
+ * reverb.begin(info);
+ * @endcode
+ * @ingroup convert
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ReverbConverter : public BaseConverter {
+ public:
+  ReverbConverter(ReverbProcessor::Quality quality = ReverbProcessor::Medium)
+      : processor(quality) {}
+
+  /// Provides access to the parameters
+  ReverbProcessor &reverb() { return processor; }
+
+  bool begin(AudioInfo info) {
+    if (info.bits_per_sample != 16) {
+      LOGE("bits_per_sample not supported: %d", info.bits_per_sample);
+      return false;
+    }
+    return processor.begin(info.sample_rate, info.channels);
+  }
+
+  size_t convert(uint8_t *src, size_t size) override {
+    processor.process((int16_t *)src, size / sizeof(int16_t));
+    return size;
+  }
+
+ protected:
+  ReverbProcessor processor;
+};
+
+}  // namespace audio_tools
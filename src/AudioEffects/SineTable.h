@@ -0,0 +1,117 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+namespace audio_tools {
+
+/**
+ * @brief Sine table (Q15) with 256 entries for one full wave plus one guard
+ * entry for the interpolation. The const table is placed in flash and is
+ * shared by all oscillators, generators and effects. The phase is a 32 bit
+ * fixed point value where 2^32 represents one full cycle.
+ * @ingroup generator
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SineTable {
+ public:
+  /// Provides the table with 257 entries
+  static const int16_t *values() {
+    static const int16_t table[257] = {
+        0, 804, 1608, 2410, 3212, 4011, 4808, 5602, 6393, 7179,
+        7962, 8739, 9512, 10278, 11039, 11793, 12539, 13279, 14010, 14732,
+        15446, 16151, 16846, 17530, 18204, 18868, 19519, 20159, 20787, 21403,
+        22005, 22594, 23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+        27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956, 30273, 30571,
+        30852, 31113, 31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521,
+        32609, 32678, 32728, 32757, 32767, 32757, 32728, 32678, 32609, 32521,
+        32412, 32285, 32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571,
+        30273, 29956, 29621, 29268, 28898, 28510, 28105, 27683, 27245, 26790,
+        26319, 25832, 25329, 24811, 24279, 23731, 23170, 22594, 22005, 21403,
+        20787, 20159, 19519, 18868, 18204, 17530, 16846, 16151, 15446, 14732,
+        14010, 13279, 12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+        6393, 5602, 4808, 4011, 3212, 2410, 1608, 804, 0, -804,
+        -1608, -2410, -3212, -4011, -4808, -5602, -6393, -7179, -7962, -8739,
+        -9512, -10278, -11039, -11793, -12539, -13279, -14010, -14732, -15446, -16151,
+        -16846, -17530, -18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+        -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790, -27245, -27683,
+        -28105, -28510, -28898, -29268, -29621, -29956, -30273, -30571, -30852, -31113,
+        -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678,
+        -32728, -32757, -32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+        -32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571, -30273, -29956,
+        -29621, -29268, -28898, -28510, -28105, -27683, -27245, -26790, -26319, -25832,
+        -25329, -24811, -24279, -23731, -23170, -22594, -22005, -21403, -20787, -20159,
+        -19519, -18868, -18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+        -12539, -11793, -11039, -10278, -9512, -8739, -7962, -7179, -6393, -5602,
+        -4808, -4011, -3212, -2410, -1608, -804, 0};
+    return table;
+  }
+
+  /// Q15 sine for the indicated phase with linear interpolation
+  static inline int16_t sine(uint32_t phase) {
+    const int16_t *table = values();
+    uint32_t idx = phase >> 24;
+    int32_t frac = (phase >> 8) & 0xFFFF;
+    int32_t a = table[idx];
+    return a + (((table[idx + 1] - a) * frac) >> 16);
+  }
+
+  /// Converts a frequency into a phase increment per sample
+  static uint32_t increment(float frequency, float sampleRate) {
+    if (sampleRate <= 0.0f) return 0;
+    return (uint32_t)(int64_t)(frequency / sampleRate * 4294967296.0);
+  }
+
+  /// Converts a fraction of a cycle (e.g. 0.25 for 90 degrees) into a phase
+  static uint32_t phase(float cycles) {
+    cycles -= (int)cycles;
+    if (cycles < 0.0f) cycles += 1.0f;
+    return (uint32_t)(int64_t)(cycles * 4294967296.0);
+  }
+};
+
+/**
+ * @brief Sine oscillator (e.g. for LFOs) based on the shared SineTable and a
+ * 32 bit fixed point phase accumulator: no float operations are needed per
+ * sample and the state is just 8 bytes.
+ * @ingroup generator
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SineOscillator {
+ public:
+  SineOscillator() = default;
+  SineOscillator(float frequency, float sampleRate) {
+    setFrequency(frequency, sampleRate);
+  }
+
+  void setFrequency(float frequency, float sampleRate) {
+    inc = SineTable::increment(frequency, sampleRate);
+  }
+
+  /// Defines the phase as fraction of a cycle
+  void setPhase(float cycles) { phase_acc = SineTable::phase(cycles); }
+
+  /// Provides the next Q15 value
+  inline int16_t next() {
+    int16_t result = SineTable::sine(phase_acc);
+    phase_acc += inc;
+    return result;
+  }
+
+  /// Provides the next n Q15 values
+  void next(int16_t *out, size_t n) {
+    uint32_t phase = phase_acc;
+    for (size_t j = 0; j < n; j++) {
+      out[j] = SineTable::sine(phase);
+      phase += inc;
+    }
+    phase_acc = phase;
+  }
+
+ protected:
+  uint32_t phase_acc = 0;
+  uint32_t inc = 0;
+};
+
+}  // namespace audio_tools
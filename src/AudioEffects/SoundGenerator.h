@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AudioBasic/Collections.h"
+#include "AudioEffects/SineTable.h"
 #include "AudioTools/AudioLogger.h"
 #include "AudioTools/AudioTypes.h"
 #include <math.h>
@@ -57,6 +58,15 @@ public:
   /// Provides a single sample
   virtual T readSample() = 0;
 
+  /// Provides n (mono) samples: override this method to generate the samples
+  /// in one block instead of calling readSample() for each sample
+  virtual size_t readSamples(T *out, size_t n) {
+    for (size_t j = 0; j < n; j++) {
+      out[j] = readSample();
+    }
+    return n;
+  }
+
   /// Provides the data as byte array with the requested number of channels
   virtual size_t readBytes(uint8_t *data, size_t len) {
     LOGD("readBytes: %d", (int)len);
@@ -104,10 +114,15 @@ protected:
   size_t readBytesFrames(uint8_t *buffer, size_t lengthBytes, int frames,
                          int channels) {
     T *result_buffer = (T *)buffer;
-    for (int j = 0; j < frames; j++) {
-      T sample = readSample();
-      for (int ch = 0; ch < channels; ch++) {
-        *result_buffer++ = sample;
+    readSamples(result_buffer, frames);
+    // copy the samples to all channels: we start at the end so that we do
+    // not overwrite any samples which have not been processed yet
+    if (channels > 1) {
+      for (int j = frames - 1; j >= 0; j--) {
+        T sample = result_buffer[j];
+        for (int ch = 0; ch < channels; ch++) {
+          result_buffer[j * channels + ch] = sample;
+        }
       }
     }
     return frames * sizeof(T) * channels;
@@ -205,6 +220,28 @@ public:
     return result;
   }
 
+  /// Provides n samples with the help of a recursive oscillator: sin() and
+  /// cos() are only calculated once per block of max 256 samples, so that
+  /// the rounding errors can not accumulate
+  size_t readSamples(T *out, size_t n) override {
+    float delta = m_frequency * m_deltaTime;
+    float angle_delta = double_Pi * delta;
+    float ds = sinf(angle_delta), dc = cosf(angle_delta);
+    for (size_t pos = 0; pos < n; pos += 256) {
+      size_t len = min(n - pos, (size_t)256);
+      float angle = double_Pi * m_cycles + m_phase;
+      float s = sinf(angle), c = cosf(angle);
+      for (size_t j = 0; j < len; j++) {
+        out[pos + j] = m_amplitude * s;
+        float tmp = s * dc + c * ds;
+        c = c * dc - s * ds;
+        s = tmp;
+      }
+      advance(delta * len);
+    }
+    return n;
+  }
+
   void setAmplitude(float amp) { m_amplitude = amp; }
 
 protected:
@@ -215,6 +252,14 @@ protected:
   float m_phase = 0.0f;
   const float double_Pi = PI * 2.0f;
 
+  /// Moves the phase by the indicated number of cycles
+  void advance(float cycles) {
+    m_cycles += cycles;
+    if (m_cycles > 1.0f) {
+      m_cycles -= (int)m_cycles;
+    }
+  }
+
   void logStatus() {
     SoundGenerator<T>::info.logStatus();
     LOGI("amplitude: %f", this->m_amplitude);
@@ -241,6 +286,21 @@ public:
                  SineWaveGenerator<T>::m_amplitude);
   }
 
+  /// Provides n samples from the phase (w/o calculating any sine)
+  size_t readSamples(T *out, size_t n) override {
+    float delta = this->m_frequency * this->m_deltaTime;
+    float cycles = this->m_cycles + this->m_phase / this->double_Pi;
+    cycles -= floorf(cycles);
+    T amplitude = this->m_amplitude;
+    for (size_t j = 0; j < n; j++) {
+      out[j] = cycles < 0.5f ? amplitude : -amplitude;
+      cycles += delta;
+      if (cycles >= 1.0f) cycles -= 1.0f;
+    }
+    this->advance(delta * n);
+    return n;
+  }
+
 protected:
   // returns amplitude for positive vales and -amplitude for negative values
   T value(T value, T amplitude) {
@@ -249,7 +309,8 @@ protected:
 };
 
 /**
- * @brief Sine wave which is based on a fast approximation function.
+ * @brief Sine wave which is based on the shared SineTable with linear
+ * interpolation and a fixed point phase accumulator.
  * @ingroup generator
  * @author Vivian Leigh Stewart
  * @copyright GPLv3
@@ -260,26 +321,39 @@ public:
   FastSineGenerator(float amplitude = 32767.0, float phase = 0.0)
       : SineWaveGenerator<T>(amplitude, phase) {
     LOGD("FastSineGenerator");
+    phase_acc = SineTable::phase(phase);
   }
 
   virtual T readSample() override {
-    float angle =
-        SineWaveGenerator<T>::m_cycles + SineWaveGenerator<T>::m_phase;
-    T result = SineWaveGenerator<T>::m_amplitude * sine(angle);
-    SineWaveGenerator<T>::m_cycles +=
-        SineWaveGenerator<T>::m_frequency * SineWaveGenerator<T>::m_deltaTime;
-    if (SineWaveGenerator<T>::m_cycles > 1.0) {
-      SineWaveGenerator<T>::m_cycles -= 1.0;
-    }
+    T result = scale(SineTable::sine(phase_acc));
+    phase_acc += increment();
     return result;
   }
 
+  /// Provides n samples using a fixed point phase accumulator
+  size_t readSamples(T *out, size_t n) override {
+    uint32_t inc = increment();
+    uint32_t phase = phase_acc;
+    for (size_t j = 0; j < n; j++) {
+      out[j] = scale(SineTable::sine(phase));
+      phase += inc;
+    }
+    phase_acc = phase;
+    return n;
+  }
+
 protected:
-  /// sine approximation.
-  inline float sine(float t) {
-    float p = (t - (int)t) - 0.5f; // 0 <= p <= 1
-    float pp = p * p;
-    return (p - 6.283211f * pp * p + 9.132843f * pp * pp * p) * -6.221086f;
+  uint32_t phase_acc = 0;
+
+  /// phase increment per sample
+  inline uint32_t increment() {
+    return SineTable::phase(SineWaveGenerator<T>::m_frequency *
+                            SineWaveGenerator<T>::m_deltaTime);
+  }
+
+  /// scales the Q15 value to the amplitude
+  inline T scale(int16_t value) {
+    return SineWaveGenerator<T>::m_amplitude * (value / 32767.0f);
   }
 };
 
@@ -298,10 +372,28 @@ public:
   /// Provides a single sample
   T readSample() { return (random(-amplitude, amplitude)); }
 
+  /// Provides n samples
+  size_t readSamples(T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) {
+      out[j] = random(-amplitude, amplitude);
+    }
+    return n;
+  }
+
 protected:
   T amplitude;
+  uint32_t seed = rand() | 1;
   // //range : [min, max]
-  int random(int min, int max) { return min + rand() % ((max + 1) - min); }
+  int random(int min, int max) {
+    return min + nextRandom() % ((max + 1) - min);
+  }
+  // xorshift32: much faster than rand() and w/o any shared state
+  uint32_t nextRandom() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  }
 };
 
 /**
@@ -370,6 +462,14 @@ public:
     return value; // return 0
   }
 
+  /// Provides n samples
+  size_t readSamples(T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) {
+      out[j] = value;
+    }
+    return n;
+  }
+
 protected:
   T value;
 };
@@ -588,6 +688,14 @@ public:
   /// Provides a single sample
   T readSample() override { return value_return; }
 
+  /// Provides n samples
+  size_t readSamples(T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) {
+      out[j] = value_return;
+    }
+    return n;
+  }
+
   // Similar like is active to check if the array is still playing.
   bool isRunning() { return is_running; }
 
@@ -598,8 +706,9 @@ protected:
 };
 
 /**
- * @brief A sine generator based on a table. The table is created using
- * degrees where one full wave is 360 degrees.
+ * @brief A sine generator based on the shared SineTable with a fixed point
+ * phase accumulator: frequency and amplitude changes are applied at the start
+ * of a wave.
  * @ingroup generator
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -619,33 +728,34 @@ public:
   void setMaxAmplitudeStep(float step) { max_amplitude_step = step; }
 
   T readSample() {
-    // update angle
-    angle += step;
-    if (angle >= 360.0f) {
-      while (angle >= 360.0f) {
-        angle -= 360.0f;
-      }
+    // update phase
+    uint32_t last = phase;
+    phase += step;
+    if (phase < last) {
       // update frequency at start of circle (near 0 degrees)
       step = step_new;
-
       updateAmplitudeInSteps();
-      // amplitude = amplitude_to_be;
     }
-    return interpolate(angle);
+    return amplitude * (SineTable::sine(phase) / 32767.0f);
+  }
+
+  /// Provides n samples w/o any virtual calls
+  size_t readSamples(T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) {
+      out[j] = SineFromTable<T>::readSample();
+    }
+    return n;
   }
 
   bool begin() {
     is_first = true;
     SoundGenerator<T>::begin();
-    base_frequency = SoundGenerator<T>::audioInfo().sample_rate /
-                     360.0f; // 122.5 hz (at 44100); 61 hz (at 22050)
+    if (frequency > 0.0f) setFrequency(frequency);
     return true;
   }
 
   bool begin(AudioInfo info, float frequency) {
     SoundGenerator<T>::begin(info);
-    base_frequency = SoundGenerator<T>::audioInfo().sample_rate /
-                     360.0f; // 122.5 hz (at 44100); 61 hz (at 22050)
     setFrequency(frequency);
     return true;
   }
@@ -657,12 +767,13 @@ public:
   }
 
   void setFrequency(float freq) {
-    step_new = freq / base_frequency;
+    frequency = freq;
+    step_new = SineTable::increment(freq, SoundGenerator<T>::info.sample_rate);
     if (is_first) {
       step = step_new;
       is_first = false;
     }
-    LOGD("step: %f", step_new);
+    LOGD("step: %u", (unsigned)step_new);
   }
 
 protected:
@@ -670,60 +781,11 @@ protected:
   float amplitude;
   float amplitude_to_be;
   float max_amplitude_step = 50.0f;
-  float base_frequency = 1.0f;
-  float step = 1.0f;
-  float step_new = 1.0f;
-  float angle = 0.0f;
-  // 122.5 hz (at 44100); 61 hz (at 22050)
-  const float values[181] = {
-      0,        0.0174524, 0.0348995, 0.052336, 0.0697565, 0.0871557,
-      0.104528, 0.121869,  0.139173,  0.156434, 0.173648,  0.190809,
-      0.207912, 0.224951,  0.241922,  0.258819, 0.275637,  0.292372,
-      0.309017, 0.325568,  0.34202,   0.358368, 0.374607,  0.390731,
-      0.406737, 0.422618,  0.438371,  0.45399,  0.469472,  0.48481,
-      0.5,      0.515038,  0.529919,  0.544639, 0.559193,  0.573576,
-      0.587785, 0.601815,  0.615661,  0.62932,  0.642788,  0.656059,
-      0.669131, 0.681998,  0.694658,  0.707107, 0.71934,   0.731354,
-      0.743145, 0.75471,   0.766044,  0.777146, 0.788011,  0.798636,
-      0.809017, 0.819152,  0.829038,  0.838671, 0.848048,  0.857167,
-      0.866025, 0.87462,   0.882948,  0.891007, 0.898794,  0.906308,
-      0.913545, 0.920505,  0.927184,  0.93358,  0.939693,  0.945519,
-      0.951057, 0.956305,  0.961262,  0.965926, 0.970296,  0.97437,
-      0.978148, 0.981627,  0.984808,  0.987688, 0.990268,  0.992546,
-      0.994522, 0.996195,  0.997564,  0.99863,  0.999391,  0.999848,
-      1,        0.999848,  0.999391,  0.99863,  0.997564,  0.996195,
-      0.994522, 0.992546,  0.990268,  0.987688, 0.984808,  0.981627,
-      0.978148, 0.97437,   0.970296,  0.965926, 0.961262,  0.956305,
-      0.951057, 0.945519,  0.939693,  0.93358,  0.927184,  0.920505,
-      0.913545, 0.906308,  0.898794,  0.891007, 0.882948,  0.87462,
-      0.866025, 0.857167,  0.848048,  0.838671, 0.829038,  0.819152,
-      0.809017, 0.798636,  0.788011,  0.777146, 0.766044,  0.75471,
-      0.743145, 0.731354,  0.71934,   0.707107, 0.694658,  0.681998,
-      0.669131, 0.656059,  0.642788,  0.62932,  0.615661,  0.601815,
-      0.587785, 0.573576,  0.559193,  0.544639, 0.529919,  0.515038,
-      0.5,      0.48481,   0.469472,  0.45399,  0.438371,  0.422618,
-      0.406737, 0.390731,  0.374607,  0.358368, 0.34202,   0.325568,
-      0.309017, 0.292372,  0.275637,  0.258819, 0.241922,  0.224951,
-      0.207912, 0.190809,  0.173648,  0.156434, 0.139173,  0.121869,
-      0.104528, 0.0871557, 0.0697565, 0.052336, 0.0348995, 0.0174524,
-      0};
-
-  T interpolate(float angle) {
-    bool positive = (angle <= 180.0f);
-    float angle_positive = positive ? angle : angle - 180.0f;
-    int angle_int1 = angle_positive;
-    int angle_int2 = angle_int1 + 1;
-    T v1 = values[angle_int1] * amplitude;
-    T v2 = values[angle_int2] * amplitude;
-    T result = v1 < v2 ? map(angle_positive, angle_int1, angle_int2, v1, v2)
-                       : map(angle_positive, angle_int1, angle_int2, v2, v1);
-    // float result = v1;
-    return positive ? result : -result;
-  }
-
-  T map(T x, T in_min, T in_max, T out_min, T out_max) {
-    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
-  }
+  float frequency = 0.0f;
+  // fixed point phase: 2^32 is a full cycle
+  uint32_t step = 0;
+  uint32_t step_new = 0;
+  uint32_t phase = 0;
 
   void updateAmplitudeInSteps() {
     float diff = amplitude_to_be - amplitude;
@@ -765,6 +827,29 @@ public:
     return count > 0.0f ? total / count : 0;
   }
 
+  /// Mixes n samples: the samples of each generator are requested as block
+  size_t readSamples(T *out, size_t n) override {
+    const int max_block = 64;
+    T tmp[max_block];
+    float total[max_block];
+    for (size_t pos = 0; pos < n; pos += max_block) {
+      int len = min(n - pos, (size_t)max_block);
+      int count = 0;
+      memset(total, 0, sizeof(total));
+      for (auto &generator : vector) {
+        if (generator->isActive()) {
+          generator->readSamples(tmp, len);
+          for (int j = 0; j < len; j++) total[j] += tmp[j];
+          count++;
+        }
+      }
+      for (int j = 0; j < len; j++) {
+        out[pos + j] = count > 0 ? total[j] / count : 0;
+      }
+    }
+    return n;
+  }
+
 protected:
   Vector<SoundGenerator<T> *> vector;
   int actualChannel = 0;
@@ -7,12 +7,137 @@
 #include "AudioTools/AudioStreams.h"
 #include "AudioEffects/SoundGenerator.h"
 #include "AudioEffects/AudioEffects.h"
+#include "Concurrency/RingBufferLockFree.h"
 #ifdef USE_MIDI
 #include "Midi.h"
 #endif
 
+/// Max number of scheduled key events which are not processed yet
+#ifndef SYNTHESIZER_EVENT_QUEUE_SIZE
+#  define SYNTHESIZER_EVENT_QUEUE_SIZE 64
+#endif
+
+/// Number of samples after which the envelopes are calculated: the values
+/// in between are interpolated
+#ifndef SYNTHESIZER_CONTROL_RATE
+#  define SYNTHESIZER_CONTROL_RATE 32
+#endif
+
 namespace audio_tools {
 
+/**
+ * @brief Key event which is executed at the indicated sample position
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct SynthesizerEvent {
+    uint32_t time = 0;
+    int note = 0;
+    float velocity = 0.0f;
+    bool is_key_on = false;
+};
+
+/**
+ * @brief Lock free queue of timestamped key events: a single producer (e.g.
+ * the MIDI task) adds the events and the audio task renders the blocks up to
+ * the next event, so that the events take effect at the exact sample
+ * position independent of the block size. The time is the sample position
+ * (see position()). Events must be added in chronological order: events
+ * which are in the past are executed at the start of the next block.
+ *
+ * To convert the arrival time of an event to a sample position we estimate
+ * the actual position from the time which has passed since the start of the
+ * last block (see now()). With a latency of at least one block the events
+ * are then rendered with a constant delay and w/o any jitter.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SynthesizerEventQueue {
+    public:
+        SynthesizerEventQueue(int size = SYNTHESIZER_EVENT_QUEUE_SIZE) { resize(size); }
+
+        /// Defines the max number of pending events: not thread safe
+        void resize(int size) { events.resize(size); }
+
+        /// Defines the sample rate which is used by now()
+        void setSampleRate(uint32_t rate) { sample_rate = rate; }
+
+        /// Defines the delay in samples which is added by now(): use at least
+        /// the size of the rendered blocks
+        void setLatency(uint32_t samples) { latency = samples; }
+
+        /// Adds an event: producer only. Returns false if the queue is full
+        bool add(uint32_t time, int note, float velocity, bool isKeyOn) {
+            if (events.writePtrSize() == 0) {
+                LOGW("event queue full");
+                return false;
+            }
+            SynthesizerEvent &event = *events.writePtr();
+            event.time = time;
+            event.note = note;
+            event.velocity = velocity;
+            event.is_key_on = isKeyOn;
+            return events.commitWrite(1);
+        }
+
+        /// Sample position at the start of the actual block
+        uint32_t position() { return block_pos.load(std::memory_order_acquire); }
+
+        /// Estimated actual sample position + latency
+        uint32_t now() {
+            uint32_t pos = block_pos.load(std::memory_order_acquire);
+            uint32_t start_us = block_start_us.load(std::memory_order_relaxed);
+            uint32_t elapsed_us = (uint32_t)micros() - start_us;
+            return pos + (uint32_t)((uint64_t)elapsed_us * sample_rate / 1000000) + latency;
+        }
+
+        /// Executes all events which are due with the callback and returns the
+        /// number of samples (max n) which can be rendered before the next
+        /// event: consumer only
+        template <class Callback>
+        size_t next(size_t n, Callback callback) {
+            while (events.readPtrSize() > 0) {
+                SynthesizerEvent &event = *events.readPtr();
+                int32_t delta = event.time - pos;
+                if (delta > 0) return min(n, (size_t)delta);
+                callback(event);
+                events.consume(1);
+            }
+            return n;
+        }
+
+        /// Confirms that n samples have been rendered: consumer only
+        void advance(size_t n) { pos += n; }
+
+        /// Marks the start of a new block: consumer only
+        void startBlock() {
+            block_start_us.store((uint32_t)micros(), std::memory_order_relaxed);
+            block_pos.store(pos, std::memory_order_release);
+        }
+
+        /// Renders n samples with render(offset, len) and executes the events
+        /// with callback(event) at their sample position: consumer only
+        template <class Render, class Callback>
+        void process(size_t n, Render render, Callback callback) {
+            startBlock();
+            size_t offset = 0;
+            while (offset < n) {
+                size_t len = next(n - offset, callback);
+                render(offset, len);
+                advance(len);
+                offset += len;
+            }
+        }
+
+    protected:
+        RingBufferLockFree<SynthesizerEvent> events{0};
+        uint32_t pos = 0;
+        std::atomic<uint32_t> block_pos{0};
+        std::atomic<uint32_t> block_start_us{0};
+        uint32_t sample_rate = 44100;
+        uint32_t latency = 0;
+};
+
 /**
  * @brief Defines the sound generation for one channel. A channel is used to process an indivudual key so 
  * that we can generate multiple notes at the same time.
@@ -24,7 +149,7 @@ class AbstractSynthesizerChannel {
         virtual ~AbstractSynthesizerChannel() = default;
         virtual AbstractSynthesizerChannel* clone() = 0;
         /// Start the sound generation
-        virtual void begin(AudioInfo config);
+        virtual void begin(AudioInfo config) = 0;
         /// Checks if the ADSR is still active - and generating sound
         virtual bool isActive() = 0;
         /// Provides the key on event to ADSR to start the sound
@@ -83,6 +208,7 @@ class DefaultSynthesizerChannel : public AbstractSynthesizerChannel {
             p_adsr = (ADSRGain*) effects.findEffect(1);
             if (p_adsr==nullptr){
                 p_adsr = new ADSRGain(0.0001, 0.0001, 0.8, 0.0005);
+                p_adsr->setControlRate(SYNTHESIZER_CONTROL_RATE);
                 p_adsr->setId(1);
                 effects.addEffect(p_adsr);
             } 
@@ -189,9 +315,11 @@ class Synthesizer : public SoundGenerator<int16_t> {
             SoundGenerator<int16_t>::begin(config);
             // provide config to defaut
             defaultChannel->begin(config);
+            events.setSampleRate(config.sample_rate);
             return true;
         }
 
+        /// Starts the note immediately: use keyOnAt() from other tasks
         void keyOn(int note, float tgt=0){
             LOGI("keyOn: %d", note);
             AbstractSynthesizerChannel *channel = getFreeChannel();
@@ -202,6 +330,7 @@ class Synthesizer : public SoundGenerator<int16_t> {
             }
         }
 
+        /// Stops the note immediately: use keyOffAt() from other tasks
         void keyOff(int note){
             LOGI("keyOff: %d", note);
             AbstractSynthesizerChannel *channel = getNoteChannel(note);
@@ -210,25 +339,46 @@ class Synthesizer : public SoundGenerator<int16_t> {
             }
         }
 
+        /// Schedules the note at the indicated sample position: this can be
+        /// called from another task (e.g. the MIDI task)
+        bool keyOnAt(uint32_t time, int note, float tgt=0){
+            return events.add(time, note, tgt, true);
+        }
+
+        /// Schedules the end of the note at the indicated sample position
+        bool keyOffAt(uint32_t time, int note){
+            return events.add(time, note, 0.0f, false);
+        }
+
+        /// Estimated actual sample position + latency which can be used as
+        /// time for keyOnAt() and keyOffAt()
+        uint32_t now() { return events.now(); }
+
+        /// Sample position at the start of the actual block
+        uint32_t position() { return events.position(); }
+
+        /// Delay in samples for now(): use at least the block size
+        void setEventLatency(uint32_t samples) { events.setLatency(samples); }
+
+        /// Provides access to the event queue e.g. to change the size
+        SynthesizerEventQueue &eventQueue() { return events; }
+
         /// Provides mixed samples of all channels
         int16_t readSample() override {
-            int total = 0;
-            uint16_t count = 0;
-            // calculate sum of all channels
-            for (int j=0;j<channels.size();j++){
-                if (channels[j]->isActive()){
-                    count++;
-                    total += channels[j]->readSample();
-                }
-            }
-            // prevent divide by zero
-            int result = 0;
-            if (count>0){
-                result = NumberConverter::clipT<int, int16_t>(total / count);
-            }
+            int16_t result;
+            readSamples(&result, 1);
             return result;
         }
 
+        /// Provides the mixed samples and executes the scheduled events at
+        /// their sample position
+        size_t readSamples(int16_t *out, size_t n) override {
+            events.process(n, [this, out](size_t offset, size_t len) {
+                for (size_t j = 0; j < len; j++) out[offset + j] = mixSample();
+            }, [this](SynthesizerEvent &event) { execute(event); });
+            return n;
+        }
+
         /// Assigns pins to notes - the last SynthesizerKey is marked with an entry containing the note <= 0 
         void setKeys(AudioActions &actions, SynthesizerKey* p_keys, AudioActions::ActiveLogic activeValue){
             while (p_keys->note > 0){
@@ -247,6 +397,31 @@ class Synthesizer : public SoundGenerator<int16_t> {
         AbstractSynthesizerChannel* defaultChannel;
         Vector<AbstractSynthesizerChannel*> channels;
         const char* midi_name = "Synthesizer";
+        SynthesizerEventQueue events;
+
+        /// Mixes the next sample of all channels
+        int16_t mixSample() {
+            int total = 0;
+            uint16_t count = 0;
+            // calculate sum of all channels
+            for (int j=0;j<channels.size();j++){
+                if (channels[j]->isActive()){
+                    count++;
+                    total += channels[j]->readSample();
+                }
+            }
+            // prevent divide by zero
+            int result = 0;
+            if (count>0){
+                result = NumberConverter::clipT<int, int16_t>(total / count);
+            }
+            return result;
+        }
+
+        void execute(SynthesizerEvent &event) {
+            if (event.is_key_on) keyOn(event.note, event.velocity);
+            else keyOff(event.note);
+        }
 
         struct KeyParameter {
             KeyParameter(Synthesizer* synth, int nte){
@@ -270,11 +445,11 @@ class Synthesizer : public SoundGenerator<int16_t> {
                 void onNoteOn(uint8_t channel, uint8_t note, uint8_t velocity) {
                     int frq = MidiCommon::noteToFrequency(note);
                     float vel = 1.0/127.0 * velocity;
-                    synth->keyOn(frq, vel);
+                    synth->keyOnAt(synth->now(), frq, vel);
                 }
                 void onNoteOff(uint8_t channel, uint8_t note, uint8_t velocity) {
                     int frq = MidiCommon::noteToFrequency(note);
-                    synth->keyOff(frq);
+                    synth->keyOffAt(synth->now(), frq);
                 }
                 void onControlChange(uint8_t channel, uint8_t controller, uint8_t value) {}
                 void onPitchBend(uint8_t channel, uint8_t value) {}
@@ -336,5 +511,373 @@ class Synthesizer : public SoundGenerator<int16_t> {
         }
 };
 
-} // namespace
+/**
+ * @brief Shared band-limited wavetables: for each waveform we provide 8
+ * tables (one per octave) which are generated by additive synthesis with
+ * only as many harmonics as can be played w/o aliasing. The tables are
+ * independent of the sample rate: the table is selected with the help of
+ * the 32 bit phase increment. They are created on first use and shared by
+ * all voices.
+ * @ingroup generator
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BandlimitedWavetable {
+    public:
+        enum Waveform {Sine=0, Saw, Square, Triangle};
+        /// Number of samples per table: we store one additional guard sample
+        static const int size = 256;
+        static const int levels = 8;
+
+        /// Provides the table with size+1 entries for the phase increment
+        static const int16_t* table(Waveform wave, uint32_t increment){
+            int16_t* data = tables(wave);
+            if (data==nullptr) return nullptr;
+            if (wave==Sine) return data;
+            // level 0 (127 harmonics) is used for increments < 2^24
+            int level = 0;
+            uint32_t limit = 1u << 24;
+            while (level < levels-1 && increment >= limit){
+                level++;
+                limit <<= 1;
+            }
+            return data + level * (size + 1);
+        }
+
+    protected:
+        static int16_t* tables(Waveform wave){
+            static int16_t* data[4] = {nullptr, nullptr, nullptr, nullptr};
+            if (data[wave]==nullptr){
+                int count = wave==Sine ? 1 : levels;
+                data[wave] = new int16_t[count * (size + 1)];
+                if (data[wave]==nullptr) return nullptr;
+                for (int level=0; level<count; level++){
+                    setup(wave, level, data[wave] + level * (size + 1));
+                }
+            }
+            return data[wave];
+        }
+
+        /// Sums up the harmonics and normalizes the result
+        static void setup(Waveform wave, int level, int16_t* result){
+            int harmonics = min(size / 2 - 1, (size / 2) >> level);
+            float values[size];
+            float max_value = 0.0f;
+            for (int j=0; j<size; j++){
+                float angle = 2.0f * PI * j / size;
+                float sum = 0.0f;
+                for (int h=1; h<=harmonics; h++){
+                    switch(wave){
+                        case Sine:
+                            if (h==1) sum += sinf(angle);
+                            break;
+                        case Saw:
+                            sum += sinf(h * angle) / h;
+                            break;
+                        case Square:
+                            if (h & 1) sum += sinf(h * angle) / h;
+                            break;
+                        case Triangle:
+                            if (h & 1) sum += ((h & 2) ? -1.0f : 1.0f) * sinf(h * angle) / (h * h);
+                            break;
+                    }
+                }
+                values[j] = sum;
+                if (fabsf(sum) > max_value) max_value = fabsf(sum);
+            }
+            float factor = max_value > 0.0f ? 32767.0f / max_value : 0.0f;
+            for (int j=0; j<size; j++){
+                result[j] = values[j] * factor;
+            }
+            result[size] = result[0];
+        }
+};
+
+/**
+ * @brief A voice of the WavetableSynthesizer: oscillator with a 32 bit fixed
+ * point phase accumulator, linear interpolation and an ADSR envelope.
+ * @ingroup generator
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class WavetableVoice {
+    public:
+        void setADSR(ADSR &adsr) { envelope = adsr; }
+
+        void keyOn(int note, float frequency, float velocity, uint32_t sampleRate, BandlimitedWavetable::Waveform wave, uint32_t age){
+            actual_note = note;
+            start_age = age;
+            increment = (uint64_t)(frequency * 65536.0f) * 65536 / sampleRate;
+            p_table = BandlimitedWavetable::table(wave, increment);
+            is_released = false;
+            envelope.keyOn(velocity);
+        }
+
+        void keyOff() {
+            is_released = true;
+            envelope.keyOff();
+        }
+
+        /// Stops the voice immediately
+        void stop() {
+            envelope = ADSR();
+            actual_note = -1;
+            is_released = false;
+        }
+
+        bool isActive() { return envelope.isActive(); }
+
+        bool isReleased() { return is_released; }
+
+        int note() { return actual_note; }
+
+        uint32_t age() { return start_age; }
+
+        float level() { return envelope.value(); }
+
+        /// Adds n (max 64) samples to the result
+        void render(float *result, int n){
+            if (p_table==nullptr) return;
+            const int16_t *table = p_table;
+            uint32_t phase_act = phase;
+            float gain[64];
+            if (n > 64) n = 64;
+            envelope.tick(gain, n);
+            for (int j=0; j<n; j++){
+                uint32_t idx = phase_act >> 24;
+                int32_t frac = (phase_act >> 8) & 0xFFFF;
+                int32_t a = table[idx];
+                int32_t sample = a + (((table[idx+1] - a) * frac) >> 16);
+                result[j] += sample * gain[j];
+                phase_act += increment;
+            }
+            phase = phase_act;
+        }
+
+    protected:
+        ADSR envelope;
+        const int16_t *p_table = nullptr;
+        uint32_t phase = 0;
+        uint32_t increment = 0;
+        uint32_t start_age = 0;
+        int actual_note = -1;
+        bool is_released = false;
+};
+
+/**
+ * @brief Polyphonic Synthesizer which is based on band-limited, mip-mapped
+ * wavetables (see BandlimitedWavetable) with a fixed point phase accumulator.
+ * The voices are rendered in blocks and a fixed number of voices is
+ * allocated in begin(): if no voice is free we steal the quietest released
+ * voice or otherwise the oldest one.
+ * @ingroup generator
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class WavetableSynthesizer : public SoundGenerator<int16_t> {
+    public:
+        WavetableSynthesizer(int voices = 16) {
+            setVoices(voices);
+            adsr.setControlRate(SYNTHESIZER_CONTROL_RATE);
+        }
+
+        /// Defines the number of voices: call before begin()
+        void setVoices(int count) { voice_count = count; }
+
+        /// Defines the waveform for the following notes
+        void setWaveform(BandlimitedWavetable::Waveform wave) { waveform = wave; }
+
+        /// Defines the ADSR parameters for the following notes
+        void setADSR(float attack, float decay, float sustainLevel, float release){
+            adsr = ADSR(attack, decay, sustainLevel, release);
+            adsr.setControlRate(control_rate);
+        }
 
+        /// Defines the number of samples after which the envelopes are
+        /// calculated (1 = every sample)
+        void setControlRate(int samples) {
+            control_rate = samples;
+            adsr.setControlRate(samples);
+        }
+
+        /// Defines the output volume which is applied to the sum of all voices
+        void setVolume(float vol) { volume = vol; }
+
+        bool begin(AudioInfo config) override {
+            TRACEI();
+            SoundGenerator<int16_t>::begin(config);
+            voices.resize(voice_count);
+            for (auto &voice : voices) voice.stop();
+            // make sure that the table is available before we start
+            BandlimitedWavetable::table(waveform, 0);
+            events.setSampleRate(config.sample_rate);
+            return true;
+        }
+
+        /// Starts the note: note is the frequency like in the Synthesizer
+        void keyOn(int note, float tgt=0){
+            LOGD("keyOn: %d", note);
+            if (voices.size()==0) return;
+            WavetableVoice &voice = getVoice(note);
+            voice.setADSR(adsr);
+            voice.keyOn(note, note, tgt, info.sample_rate, waveform, age++);
+        }
+
+        void keyOff(int note){
+            LOGD("keyOff: %d", note);
+            for (auto &voice : voices){
+                if (voice.note()==note && voice.isActive() && !voice.isReleased()){
+                    voice.keyOff();
+                }
+            }
+        }
+
+        /// Schedules the note at the indicated sample position: this can be
+        /// called from another task (e.g. the MIDI task)
+        bool keyOnAt(uint32_t time, int note, float tgt=0){
+            return events.add(time, note, tgt, true);
+        }
+
+        /// Schedules the end of the note at the indicated sample position
+        bool keyOffAt(uint32_t time, int note){
+            return events.add(time, note, 0.0f, false);
+        }
+
+        /// Estimated actual sample position + latency which can be used as
+        /// time for keyOnAt() and keyOffAt()
+        uint32_t now() { return events.now(); }
+
+        /// Sample position at the start of the actual block
+        uint32_t position() { return events.position(); }
+
+        /// Delay in samples for now(): use at least the block size
+        void setEventLatency(uint32_t samples) { events.setLatency(samples); }
+
+        /// Provides access to the event queue e.g. to change the size
+        SynthesizerEventQueue &eventQueue() { return events; }
+
+        /// Limits the number of voices which can be used w/o reallocating: the
+        /// voices above the limit are stopped
+        void setMaxActiveVoices(int count) {
+            if (count < 1) count = 1;
+            for (int j = count; j < (int)voices.size(); j++) voices[j].stop();
+            max_active_voices = count;
+        }
+
+        /// Max number of voices which can be used
+        int maxActiveVoices() {
+            return min(max_active_voices, (int)voices.size());
+        }
+
+        /// Number of voices which are generating sound
+        int activeVoices() {
+            int result = 0;
+            for (auto &voice : voices) if (voice.isActive()) result++;
+            return result;
+        }
+
+        int16_t readSample() override {
+            int16_t result;
+            readSamples(&result, 1);
+            return result;
+        }
+
+        /// Renders all active voices in blocks which are split at the
+        /// sample position of the scheduled events
+        size_t readSamples(int16_t *out, size_t n) override {
+            events.process(n, [this, out](size_t offset, size_t len) {
+                render(out + offset, len);
+            }, [this](SynthesizerEvent &event) {
+                if (event.is_key_on) keyOn(event.note, event.velocity);
+                else keyOff(event.note);
+            });
+            return n;
+        }
+
+        /// Assigns pins to notes - the last SynthesizerKey is marked with an entry containing the note <= 0 
+        void setKeys(AudioActions &actions, SynthesizerKey* p_keys, AudioActions::ActiveLogic activeValue){
+            while (p_keys->note > 0){
+                actions.add(p_keys->pin, callbackKeyOn, callbackKeyOff, activeValue , new KeyParameter(this, p_keys->note)); 
+                p_keys++;
+            }
+        }
+
+    protected:
+        Vector<WavetableVoice> voices{0};
+        ADSR adsr{0.0001, 0.0001, 0.8, 0.0005};
+        BandlimitedWavetable::Waveform waveform = BandlimitedWavetable::Saw;
+        int voice_count = 16;
+        int max_active_voices = 1000;
+        uint32_t age = 0;
+        float volume = 0.25f;
+        int control_rate = SYNTHESIZER_CONTROL_RATE;
+        SynthesizerEventQueue events;
+
+        void render(int16_t *out, size_t n) {
+            const int max_block = 64;
+            float mix[max_block];
+            for (size_t pos = 0; pos < n; pos += max_block) {
+                int len = min(n - pos, (size_t)max_block);
+                memset(mix, 0, len * sizeof(float));
+                int count = maxActiveVoices();
+                for (int j = 0; j < count; j++){
+                    if (voices[j].isActive()) voices[j].render(mix, len);
+                }
+                for (int j=0; j<len; j++){
+                    out[pos + j] = NumberConverter::clipT<float, int16_t>(mix[j] * volume);
+                }
+            }
+        }
+
+        struct KeyParameter {
+            KeyParameter(WavetableSynthesizer* synth, int nte){
+                p_synthesizer=synth;
+                note = nte;
+            };
+            WavetableSynthesizer *p_synthesizer = nullptr;
+            int note;
+        };
+
+        /// Retriggers the voice with the same note, uses a free voice or steals one
+        WavetableVoice &getVoice(int note){
+            WavetableVoice *result = nullptr;
+            int count = maxActiveVoices();
+            for (int j = 0; j < count; j++){
+                WavetableVoice &voice = voices[j];
+                if (voice.isActive() && voice.note()==note) return voice;
+                if (result==nullptr && !voice.isActive()) result = &voice;
+            }
+            if (result!=nullptr) return *result;
+            // steal the quietest released voice or otherwise the oldest one
+            for (int j = 0; j < count; j++){
+                WavetableVoice &voice = voices[j];
+                if (voice.isReleased() && (result==nullptr || voice.level() < result->level())){
+                    result = &voice;
+                }
+            }
+            if (result==nullptr){
+                for (int j = 0; j < count; j++){
+                    WavetableVoice &voice = voices[j];
+                    if (result==nullptr || age - voice.age() > age - result->age()) result = &voice;
+                }
+            }
+            LOGI("stealing voice with note %d", result->note());
+            return *result;
+        }
+
+        static void callbackKeyOn(bool active, int pin, void* ref){
+            KeyParameter* par = (KeyParameter*)ref;
+            if (par !=nullptr && par->p_synthesizer!=nullptr){
+                par->p_synthesizer->keyOn(par->note);
+            }
+        }
+
+        static void callbackKeyOff(bool active, int pin, void* ref){
+            KeyParameter* par = (KeyParameter*)ref;
+            if (par !=nullptr && par->p_synthesizer!=nullptr){
+                par->p_synthesizer->keyOff(par->note);
+            }
+        }
+};
+
+} // namespace
@@ -0,0 +1,294 @@
+#pragma once
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioEffects/AudioEffect.h"
+#include "AudioFilter/Filter.h"
+#include "AudioLibs/AudioFFT.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Convolution with long impulse responses (e.g. room correction or
+ * cabinet simulation with thousands of taps) using a uniformly partitioned
+ * overlap-save algorithm: the impulse response is split into partitions of
+ * the partition size, which are transformed only once in begin(). For each
+ * block of input samples we need just one FFT, a complex multiply-accumulate
+ * over all partitions and one inverse FFT.
+ *
+ * The partition size (a power of 2) defines the latency in samples: a bigger
+ * size needs less CPU but increases the latency. The FFT is executed by any
+ * FFTDriver which supports the reverse FFT (e.g. FFTDriverRealFFT,
+ * FFTDriverKissFFT or FFTDriverESP32). The driver is only used during the
+ * processing of a block, so the same driver can be shared by the filters of
+ * all channels.
+ * @ingroup filter
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T
+ */
+template <typename T>
+class ConvolutionFilter : public Filter<T> {
+ public:
+  ConvolutionFilter(FFTDriver &driver) { p_driver = &driver; }
+
+  template <size_t N>
+  ConvolutionFilter(FFTDriver &driver, const T (&impulse)[N],
+                    int partitionSize = 256) {
+    p_driver = &driver;
+    setImpulseResponse(impulse, N);
+    setPartitionSize(partitionSize);
+    begin();
+  }
+
+  /// Defines the impulse response: the data is used in begin()
+  void setImpulseResponse(const T *impulse, size_t len) {
+    p_impulse = impulse;
+    impulse_len = len;
+  }
+
+  /// Defines the partition size (power of 2) = latency in samples
+  void setPartitionSize(int size) { partition_size = size; }
+
+  int partitionSize() { return partition_size; }
+
+  /// Latency in samples
+  int latency() { return partition_size; }
+
+  /// Transforms the impulse response and resets the state
+  bool begin() {
+    if (p_driver == nullptr || p_impulse == nullptr || impulse_len == 0) {
+      LOGE("impulse response not defined");
+      return false;
+    }
+    if (!setup((impulse_len + partition_size - 1) / partition_size)) {
+      return false;
+    }
+
+    // transform all partitions of the impulse response
+    for (int p = 0; p < partitions; p++) {
+      for (int j = 0; j < fft_len; j++) {
+        size_t idx = p * partition_size + j;
+        float value =
+            (j < partition_size && idx < impulse_len) ? p_impulse[idx] : 0.0f;
+        p_driver->setValue(j, value);
+      }
+      p_driver->fft();
+      readSpectrum(&impulse_spectrum[p * bins * 2]);
+    }
+    reset();
+    return true;
+  }
+
+  /// Clears the history
+  void reset() {
+    memset(input_spectrum.data(), 0, input_spectrum.size() * sizeof(float));
+    memset(input.data(), 0, input.size() * sizeof(float));
+    memset(output.data(), 0, output.size() * sizeof(float));
+    pos = 0;
+    current_partition = 0;
+  }
+
+  /// Processes a single sample: the result is delayed by the partition size
+  T process(T in) override {
+    if (partitions == 0) return in;
+    T result = output[pos];
+    input[partition_size + pos] = in;
+    if (++pos == partition_size) processPartition();
+    return result;
+  }
+
+  /// Processes a block of samples: in and out can be the same array
+  void process(const T *in, T *out, size_t n) override {
+    if (partitions == 0) {
+      if (in != out) memmove(out, in, n * sizeof(T));
+      return;
+    }
+    for (size_t j = 0; j < n; j++) {
+      T value = in[j];
+      out[j] = output[pos];
+      input[partition_size + pos] = value;
+      if (++pos == partition_size) processPartition();
+    }
+  }
+
+ protected:
+  FFTDriver *p_driver = nullptr;
+  const T *p_impulse = nullptr;
+  size_t impulse_len = 0;
+  int partition_size = 256;
+  int fft_len = 0;
+  int bins = 0;
+  int partitions = 0;
+  int pos = 0;
+  int current_partition = 0;
+  float scale = 1.0f;
+  // spectra with interleaved real and imaginary values
+  Vector<float> impulse_spectrum{0};
+  Vector<float> input_spectrum{0};
+  Vector<float> accumulator{0};
+  Vector<float> input{0};
+  Vector<float> output{0};
+
+  /// Starts the driver and allocates the buffers for the indicated number of
+  /// partitions
+  bool setup(int partitionCount) {
+    if (partition_size <= 0 || (partition_size & (partition_size - 1)) != 0) {
+      LOGE("partition size %d is not a power of 2", partition_size);
+      return false;
+    }
+    if (!p_driver->isReverseFFT()) {
+      LOGE("FFT driver does not support the reverse FFT");
+      return false;
+    }
+    fft_len = 2 * partition_size;
+    bins = partition_size + 1;
+    partitions = partitionCount;
+    if (!p_driver->begin(fft_len)) {
+      LOGE("FFT driver begin failed");
+      return false;
+    }
+    if (!setupScale()) return false;
+    impulse_spectrum.resize(partitions * bins * 2);
+    input_spectrum.resize(partitions * bins * 2);
+    accumulator.resize(bins * 2);
+    input.resize(fft_len);
+    output.resize(partition_size);
+    if ((int)input_spectrum.size() != partitions * bins * 2) {
+      LOGE("not enough memory");
+      partitions = 0;
+      return false;
+    }
+    return true;
+  }
+
+  /// Determines the scaling of the driver for a forward and reverse FFT
+  bool setupScale() {
+    for (int j = 0; j < fft_len; j++) p_driver->setValue(j, j == 0 ? 1.0f : 0.0f);
+    p_driver->fft();
+    Vector<float> spectrum(bins * 2);
+    readSpectrum(spectrum.data());
+    writeSpectrum(spectrum.data());
+    p_driver->rfft();
+    float value = p_driver->getValue(0);
+    if (value == 0.0f) {
+      LOGE("FFT driver does not provide the reverse FFT result");
+      return false;
+    }
+    scale = 1.0f / value;
+    return true;
+  }
+
+  void readSpectrum(float *spectrum) {
+    FFTBin bin{0, 0};
+    for (int k = 0; k < bins; k++) {
+      p_driver->getBin(k, bin);
+      spectrum[k * 2] = bin.real;
+      spectrum[k * 2 + 1] = bin.img;
+    }
+  }
+
+  /// Provides all bins: the upper half is the conjugate of the lower half
+  void writeSpectrum(const float *spectrum) {
+    for (int k = 0; k < bins; k++) {
+      p_driver->setBin(k, spectrum[k * 2], spectrum[k * 2 + 1]);
+    }
+    for (int k = bins; k < fft_len; k++) {
+      int mirror = fft_len - k;
+      p_driver->setBin(k, spectrum[mirror * 2], -spectrum[mirror * 2 + 1]);
+    }
+  }
+
+  /// Overlap-save for the last partition size input samples
+  void processPartition() {
+    pos = 0;
+    transformInput();
+    convolve();
+    // keep the current block as the first half of the next FFT
+    memmove(input.data(), input.data() + partition_size,
+            partition_size * sizeof(float));
+  }
+
+  /// Spectrum of the last 2 input blocks goes into the frequency delay line
+  void transformInput() {
+    for (int j = 0; j < fft_len; j++) p_driver->setValue(j, input[j]);
+    p_driver->fft();
+    current_partition =
+        current_partition == 0 ? partitions - 1 : current_partition - 1;
+    readSpectrum(&input_spectrum[current_partition * bins * 2]);
+  }
+
+  /// Multiply-accumulate of the delay line with the impulse partitions: the
+  /// result is stored in the output
+  void convolve() {
+    // newest input with the first impulse partition
+    memset(accumulator.data(), 0, accumulator.size() * sizeof(float));
+    float *acc = accumulator.data();
+    for (int p = 0; p < partitions; p++) {
+      int slot = (current_partition + p) % partitions;
+      const float *x = &input_spectrum[slot * bins * 2];
+      const float *h = &impulse_spectrum[p * bins * 2];
+      for (int k = 0; k < bins * 2; k += 2) {
+        acc[k] += x[k] * h[k] - x[k + 1] * h[k + 1];
+        acc[k + 1] += x[k] * h[k + 1] + x[k + 1] * h[k];
+      }
+    }
+
+    // back to the time domain: the second half is valid
+    writeSpectrum(acc);
+    p_driver->rfft();
+    for (int j = 0; j < partition_size; j++) {
+      output[j] = p_driver->getValue(partition_size + j) * scale;
+    }
+  }
+};
+
+/**
+ * @brief Convolution reverb or cabinet simulation as AudioEffect: the impulse
+ * response is expected to be normalized to the range -1.0 to 1.0.
+ * @ingroup effects
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ConvolutionEffect : public AudioEffect {
+ public:
+  template <size_t N>
+  ConvolutionEffect(FFTDriver &driver, const float (&impulse)[N],
+                    int partitionSize = 256)
+      : ConvolutionEffect(driver, impulse, N, partitionSize) {}
+
+  ConvolutionEffect(FFTDriver &driver, const float *impulse, size_t len,
+                    int partitionSize = 256)
+      : filter(driver) {
+    p_driver = &driver;
+    p_impulse = impulse;
+    impulse_len = len;
+    partition_size = partitionSize;
+    filter.setImpulseResponse(impulse, len);
+    filter.setPartitionSize(partitionSize);
+    filter.begin();
+  }
+
+  ConvolutionEffect(const ConvolutionEffect &copy)
+      : ConvolutionEffect(*copy.p_driver, copy.p_impulse, copy.impulse_len,
+                          copy.partition_size) {
+    active_flag = copy.active_flag;
+    id_value = copy.id_value;
+  }
+
+  effect_t process(effect_t input) override {
+    if (!active()) return input;
+    return clip(filter.process(static_cast<float>(input)));
+  }
+
+  ConvolutionEffect *clone() override { return new ConvolutionEffect(*this); }
+
+  ConvolutionFilter<float> &convolutionFilter() { return filter; }
+
+ protected:
+  ConvolutionFilter<float> filter;
+  FFTDriver *p_driver = nullptr;
+  const float *p_impulse = nullptr;
+  size_t impulse_len = 0;
+  int partition_size = 256;
+};
+
+}  // namespace audio_tools
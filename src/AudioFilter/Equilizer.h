@@ -4,6 +4,7 @@
 #include "AudioConfig.h"
 #include "AudioTools/AudioOutput.h"
 #include "AudioTools/AudioStreams.h"
+#include "AudioTools/AudioFrameBuffer.h"
 
 /**
  * @defgroup equilizer Equilizer
@@ -45,7 +46,7 @@ struct ConfigEquilizer3Bands : public AudioInfo {
  * @ingroup equilizer
  * @author pschatzmann
  */
-class Equilizer3Bands : public ModifyingStream {
+class Equilizer3Bands : public ModifyingStream, public PlanarProcessor<float> {
  public:
   Equilizer3Bands(Print &out) { setOutput(out); }
 
@@ -128,6 +129,17 @@ class Equilizer3Bands : public ModifyingStream {
     return p_stream != nullptr ? p_stream->available() : 0;
   }
 
+  /// Processes the planar frames (e.g. as step of a PlanarStream): the
+  /// filters are linear, so the values do not need to be normalized
+  void process(AudioFrameBuffer<float> &frames) override {
+    int channels = min(frames.channels(), max_state_count);
+    for (int ch = 0; ch < channels; ch++) {
+      float *data = frames.channel(ch);
+      EQSTATE &es = state[ch];
+      for (int j = 0; j < frames.frames(); j++) data[j] = sample(es, data[j]);
+    }
+  }
+
  protected:
   ConfigEquilizer3Bands cfg;
   ConfigEquilizer3Bands *p_cfg = &cfg;
@@ -0,0 +1,455 @@
+#pragma once
+#include <math.h>
+
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioFrameBuffer.h"
+#include "AudioTools/AudioStreams.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Parametric or graphic equalizer with any number of bands: each band
+ * is a biquad (peaking, low shelf or high shelf) and all bands are cascaded.
+ * The data is processed in blocks which are deinterleaved into an
+ * AudioFrameBuffer, so that each section runs in a tight loop over the
+ * samples of one channel.
+ *
+ * The coefficients are only recalculated when a band has been changed: the
+ * new coefficients are then interpolated over the next block to avoid
+ * clicks. Bands with a gain of 0 dB are skipped.
+ *
+ * The float implementation uses the transposed direct form II. With
+ * setFixedPoint(true) the bands are processed with 32 bit integers in the
+ * direct form I with Q28 coefficients, a 64 bit accumulator and error
+ * feedback: the samples have 4 bits (24 dB) of headroom. Only 16 bit
+ * streams are supported.
+ * @ingroup equilizer
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class EquilizerNBands : public ModifyingStream, public PlanarProcessor<float> {
+ public:
+  enum BandType { Peak, LowShelf, HighShelf };
+
+  EquilizerNBands() = default;
+
+  EquilizerNBands(Print &out) { setOutput(out); }
+
+  EquilizerNBands(Stream &io) { setStream(io); }
+
+  void setStream(Stream &io) override {
+    p_stream = &io;
+    p_print = &io;
+  }
+
+  void setOutput(Print &out) override { p_print = &out; }
+
+  /// Adds a band: returns the band index
+  int addBand(BandType type, float frequency, float q = 1.41f,
+              float gainDb = 0.0f) {
+    Band band;
+    band.type = type;
+    band.frequency = frequency;
+    band.q = q;
+    band.gain_db = gainDb;
+    bands.push_back(band);
+    is_setup = false;
+    return bands.size() - 1;
+  }
+
+  /// Defines a graphic equalizer with octave bands starting at 31.25 Hz
+  /// (10 bands end at 16 kHz)
+  void setGraphic(int count = 10, float q = 1.41f) {
+    bands.clear();
+    float frequency = 31.25f;
+    for (int j = 0; j < count; j++) {
+      addBand(Peak, frequency, q);
+      frequency *= 2.0f;
+    }
+  }
+
+  /// Number of bands
+  int size() { return bands.size(); }
+
+  /// Changes the gain of a band in dB: the coefficients are recalculated
+  /// for the next block
+  void setGain(int band, float dB) {
+    if (band < 0 || band >= bands.size()) return;
+    if (bands[band].gain_db == dB) return;
+    bands[band].gain_db = dB;
+    bands[band].is_dirty = true;
+  }
+
+  float gain(int band) { return bands[band].gain_db; }
+
+  /// Changes the frequency and quality of a band
+  void setFrequency(int band, float frequency, float q = 1.41f) {
+    if (band < 0 || band >= bands.size()) return;
+    bands[band].frequency = frequency;
+    bands[band].q = q;
+    bands[band].is_dirty = true;
+  }
+
+  float frequency(int band) { return bands[band].frequency; }
+
+  /// Uses the fixed point implementation
+  void setFixedPoint(bool active) {
+    is_fixed_point = active;
+    is_setup = false;
+  }
+
+  /// Defines the max number of frames which are processed in one block
+  void setBlockFrames(int frames) {
+    block_frames = frames;
+    is_setup = false;
+  }
+
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    if (info.bits_per_sample != 16) {
+      LOGE("bits_per_sample not supported: %d", info.bits_per_sample);
+      return false;
+    }
+    if (info.channels <= 0 || block_frames <= 0) {
+      LOGE("channels and frames must not be 0");
+      return false;
+    }
+    setup();
+    return AudioStream::begin();
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_print == nullptr) return 0;
+    size_t result = len - len % (info.channels * sizeof(int16_t));
+    process((int16_t *)data, result / sizeof(int16_t));
+    return p_print->write(data, result);
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_stream == nullptr) return 0;
+    size_t result = p_stream->readBytes(data, len);
+    process((int16_t *)data, result / sizeof(int16_t));
+    return result;
+  }
+
+  int available() override {
+    return p_stream == nullptr ? 0 : p_stream->available();
+  }
+
+  int availableForWrite() override {
+    return p_print == nullptr ? 0 : p_print->availableForWrite();
+  }
+
+  /// Processes the interleaved samples in place
+  void process(int16_t *data, size_t samples) {
+    if (!is_setup) setup();
+    int channels = info.channels;
+    int frames = samples / channels;
+    for (int pos = 0; pos < frames; pos += block_frames) {
+      int count = min(block_frames, frames - pos);
+      int16_t *block = data + pos * channels;
+      if (is_fixed_point) {
+        processBlockQ(block, count);
+      } else {
+        float_frames.fromInterleaved(block, count);
+        processBlock(float_frames);
+        for (int ch = 0; ch < channels; ch++) {
+          float *values = float_frames.channel(ch);
+          int16_t *out = block + ch;
+          for (int j = 0; j < count; j++) {
+            *out = clip16(values[j]);
+            out += channels;
+          }
+        }
+      }
+    }
+  }
+
+  /// Processes the planar frames in the float implementation (e.g. as step
+  /// of a PlanarStream): the values are not clipped
+  void process(AudioFrameBuffer<float> &frames) override {
+    if (!is_setup) setup();
+    processBlock(frames);
+  }
+
+ protected:
+  struct Coef {
+    float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+  };
+  struct CoefQ {
+    int32_t b0 = 1 << 28, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+  };
+  struct Band {
+    BandType type = Peak;
+    float frequency = 1000.0f;
+    float q = 1.41f;
+    float gain_db = 0.0f;
+    bool is_dirty = true;
+    bool is_flat = true;
+    Coef coef;
+    CoefQ coef_q;
+  };
+  struct State {
+    float s1 = 0.0f, s2 = 0.0f;
+    int32_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    int64_t error = 0;
+  };
+  Print *p_print = nullptr;
+  Stream *p_stream = nullptr;
+  Vector<Band> bands;
+  Vector<State> states;
+  AudioFrameBuffer<float> float_frames;
+  AudioFrameBuffer<int32_t> fixed_frames;
+  int block_frames = 128;
+  bool is_fixed_point = false;
+  bool is_setup = false;
+
+  void setup() {
+    int channels = info.channels > 0 ? info.channels : 1;
+    states.resize(bands.size() * channels);
+    for (int j = 0; j < states.size(); j++) states[j] = State();
+    for (int j = 0; j < bands.size(); j++) {
+      Band &band = bands[j];
+      band.coef = calculate(band);
+      band.coef_q = toQ(band.coef);
+      band.is_flat = band.gain_db == 0.0f;
+      band.is_dirty = false;
+    }
+    if (is_fixed_point) {
+      fixed_frames.resize(channels, block_frames);
+    } else {
+      float_frames.resize(channels, block_frames);
+    }
+    is_setup = true;
+  }
+
+  State &state(int band, int ch) { return states[band * info.channels + ch]; }
+
+  /// Coefficients of the audio EQ cookbook (R. Bristow-Johnson)
+  Coef calculate(Band &band) {
+    float rate = info.sample_rate > 0 ? info.sample_rate : 44100;
+    float a = powf(10.0f, band.gain_db / 40.0f);
+    float w0 = 2.0f * PI * band.frequency / rate;
+    float cos_w0 = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * band.q);
+    float b0, b1, b2, a0, a1, a2;
+    switch (band.type) {
+      case LowShelf: {
+        float sq = 2.0f * sqrtf(a) * alpha;
+        b0 = a * ((a + 1) - (a - 1) * cos_w0 + sq);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cos_w0);
+        b2 = a * ((a + 1) - (a - 1) * cos_w0 - sq);
+        a0 = (a + 1) + (a - 1) * cos_w0 + sq;
+        a1 = -2 * ((a - 1) + (a + 1) * cos_w0);
+        a2 = (a + 1) + (a - 1) * cos_w0 - sq;
+      } break;
+      case HighShelf: {
+        float sq = 2.0f * sqrtf(a) * alpha;
+        b0 = a * ((a + 1) + (a - 1) * cos_w0 + sq);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cos_w0);
+        b2 = a * ((a + 1) + (a - 1) * cos_w0 - sq);
+        a0 = (a + 1) - (a - 1) * cos_w0 + sq;
+        a1 = 2 * ((a - 1) - (a + 1) * cos_w0);
+        a2 = (a + 1) - (a - 1) * cos_w0 - sq;
+      } break;
+      default:
+        b0 = 1 + alpha * a;
+        b1 = -2 * cos_w0;
+        b2 = 1 - alpha * a;
+        a0 = 1 + alpha / a;
+        a1 = -2 * cos_w0;
+        a2 = 1 - alpha / a;
+        break;
+    }
+    Coef result;
+    result.b0 = b0 / a0;
+    result.b1 = b1 / a0;
+    result.b2 = b2 / a0;
+    result.a1 = a1 / a0;
+    result.a2 = a2 / a0;
+    return result;
+  }
+
+  static int32_t toQ28(float value) { return lrintf(value * (1 << 28)); }
+
+  static CoefQ toQ(const Coef &coef) {
+    CoefQ result;
+    result.b0 = toQ28(coef.b0);
+    result.b1 = toQ28(coef.b1);
+    result.b2 = toQ28(coef.b2);
+    result.a1 = toQ28(coef.a1);
+    result.a2 = toQ28(coef.a2);
+    return result;
+  }
+
+  static inline int16_t clip16(float value) {
+    if (value > 32767.0f) return 32767;
+    if (value < -32768.0f) return -32768;
+    return value;
+  }
+
+  /// Float implementation: transposed direct form II
+  void processBlock(AudioFrameBuffer<float> &frames) {
+    int channels = min(frames.channels(), (int)info.channels);
+    int count = frames.frames();
+    if (count == 0) return;
+    for (int j = 0; j < bands.size(); j++) {
+      Band &band = bands[j];
+      if (band.is_dirty) {
+        // interpolate from the actual to the new coefficients
+        Coef target = calculate(band);
+        Coef inc;
+        inc.b0 = (target.b0 - band.coef.b0) / count;
+        inc.b1 = (target.b1 - band.coef.b1) / count;
+        inc.b2 = (target.b2 - band.coef.b2) / count;
+        inc.a1 = (target.a1 - band.coef.a1) / count;
+        inc.a2 = (target.a2 - band.coef.a2) / count;
+        for (int ch = 0; ch < channels; ch++) {
+          filterRamp(band.coef, inc, state(j, ch), frames.channel(ch), count);
+        }
+        band.coef = target;
+        band.coef_q = toQ(target);
+        band.is_flat = band.gain_db == 0.0f;
+        band.is_dirty = false;
+        continue;
+      }
+      for (int ch = 0; ch < channels; ch++) {
+        State &st = state(j, ch);
+        if (band.is_flat) {
+          // the state of a flat filter is 0
+          st.s1 = st.s2 = 0.0f;
+        } else {
+          filter(band.coef, st, frames.channel(ch), count);
+        }
+      }
+    }
+  }
+
+  static void filter(const Coef &c, State &st, float *data, int count) {
+    float s1 = st.s1, s2 = st.s2;
+    for (int j = 0; j < count; j++) {
+      float x = data[j];
+      float y = c.b0 * x + s1;
+      s1 = c.b1 * x - c.a1 * y + s2;
+      s2 = c.b2 * x - c.a2 * y;
+      data[j] = y;
+    }
+    st.s1 = s1;
+    st.s2 = s2;
+  }
+
+  static void filterRamp(Coef c, const Coef &inc, State &st, float *data,
+                         int count) {
+    float s1 = st.s1, s2 = st.s2;
+    for (int j = 0; j < count; j++) {
+      c.b0 += inc.b0;
+      c.b1 += inc.b1;
+      c.b2 += inc.b2;
+      c.a1 += inc.a1;
+      c.a2 += inc.a2;
+      float x = data[j];
+      float y = c.b0 * x + s1;
+      s1 = c.b1 * x - c.a1 * y + s2;
+      s2 = c.b2 * x - c.a2 * y;
+      data[j] = y;
+    }
+    st.s1 = s1;
+    st.s2 = s2;
+  }
+
+  /// Fixed point implementation: direct form I
+  void processBlockQ(int16_t *block, int count) {
+    int channels = info.channels;
+    // 16 bit samples with 4 bits of headroom in 32 bits
+    fixed_frames.fromInterleaved(block, count);
+    for (int ch = 0; ch < channels; ch++) {
+      int32_t *values = fixed_frames.channel(ch);
+      for (int j = 0; j < count; j++) values[j] <<= 12;
+    }
+    for (int j = 0; j < bands.size(); j++) {
+      Band &band = bands[j];
+      if (band.is_dirty) {
+        CoefQ target = toQ(calculate(band));
+        CoefQ inc;
+        inc.b0 = (target.b0 - band.coef_q.b0) / count;
+        inc.b1 = (target.b1 - band.coef_q.b1) / count;
+        inc.b2 = (target.b2 - band.coef_q.b2) / count;
+        inc.a1 = (target.a1 - band.coef_q.a1) / count;
+        inc.a2 = (target.a2 - band.coef_q.a2) / count;
+        for (int ch = 0; ch < channels; ch++) {
+          filterQ(band.coef_q, &inc, state(j, ch), fixed_frames.channel(ch),
+                  count);
+        }
+        band.coef = calculate(band);
+        band.coef_q = target;
+        band.is_flat = band.gain_db == 0.0f;
+        band.is_dirty = false;
+        continue;
+      }
+      for (int ch = 0; ch < channels; ch++) {
+        State &st = state(j, ch);
+        int32_t *values = fixed_frames.channel(ch);
+        if (band.is_flat) {
+          // the history of a flat filter is the input
+          st.x1 = st.y1 = values[count - 1];
+          st.x2 = st.y2 = count > 1 ? values[count - 2] : st.x1;
+          st.error = 0;
+        } else {
+          filterQ(band.coef_q, nullptr, st, values, count);
+        }
+      }
+    }
+    for (int ch = 0; ch < channels; ch++) {
+      int32_t *values = fixed_frames.channel(ch);
+      int16_t *out = block + ch;
+      for (int j = 0; j < count; j++) {
+        int32_t value = (values[j] + (1 << 11)) >> 12;
+        *out = value > 32767 ? 32767 : (value < -32768 ? -32768 : value);
+        out += channels;
+      }
+    }
+  }
+
+  static void filterQ(CoefQ c, const CoefQ *p_inc, State &st, int32_t *data,
+                      int count) {
+    const int64_t mask = (1 << 28) - 1;
+    const int64_t max_value = 0x7FFFFFFF;
+    int32_t x1 = st.x1, x2 = st.x2, y1 = st.y1, y2 = st.y2;
+    int64_t error = st.error;
+    for (int j = 0; j < count; j++) {
+      if (p_inc != nullptr) {
+        c.b0 += p_inc->b0;
+        c.b1 += p_inc->b1;
+        c.b2 += p_inc->b2;
+        c.a1 += p_inc->a1;
+        c.a2 += p_inc->a2;
+      }
+      int32_t x = data[j];
+      int64_t acc = error + (int64_t)c.b0 * x + (int64_t)c.b1 * x1 +
+                    (int64_t)c.b2 * x2 - (int64_t)c.a1 * y1 -
+                    (int64_t)c.a2 * y2;
+      // first order error feedback of the truncated bits
+      error = acc & mask;
+      int64_t y = acc >> 28;
+      if (y > max_value) y = max_value;
+      if (y < -max_value) y = -max_value;
+      x2 = x1;
+      x1 = x;
+      y2 = y1;
+      y1 = y;
+      data[j] = y;
+    }
+    st.x1 = x1;
+    st.x2 = x2;
+    st.y1 = y1;
+    st.y2 = y2;
+    st.error = error;
+  }
+};
+
+}  // namespace audio_tools
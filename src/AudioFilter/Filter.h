@@ -34,6 +34,11 @@ class Filter {
   Filter &operator=(Filter const &) = delete;
 
   virtual T process(T in) = 0;
+
+  /// Processes a block of n samples: in and out can be the same array
+  virtual void process(const T *in, T *out, size_t n) {
+    for (size_t j = 0; j < n; j++) out[j] = process(in[j]);
+  }
 };
 
 /**
@@ -48,6 +53,9 @@ class NoFilter : Filter<T> {
   // construct without coefs
   NoFilter() = default;
   virtual T process(T in) { return in; }
+  virtual void process(const T *in, T *out, size_t n) {
+    if (in != out) memmove(out, in, n * sizeof(T));
+  }
 };
 
 /**
@@ -63,17 +71,31 @@ template <typename T>
 class FIR : public Filter<T> {
  public:
   template <size_t B>
-  FIR(const T (&b)[B], const T factor = 1.0) : lenB(B), factor(factor) {
+  FIR(const T (&b)[B], const T factor = 1.0) : factor(factor) {
     setValues(b);
   }
 
+  /// Constructor for coefficients which are only known at runtime: call
+  /// setValues(const T*, size_t) to define them
+  explicit FIR(const T factor = 1.0) : factor(factor) {}
+
   template <size_t B>
   void setValues(const T (&b)[B]) {
-    if (x != nullptr) delete x;
-    x = new T[lenB]();
-    coeff_b = new T[2 * lenB - 1];
-    for (uint16_t i = 0; i < 2 * lenB - 1; i++) {
-      coeff_b[i] = b[(2 * lenB - 1 - i) % lenB];
+    setValues(b, B);
+  }
+
+  /// Defines the coefficients: there is no limit for the number of taps
+  void setValues(const T *b, size_t len) {
+    delete[] x;
+    delete[] coeff_b;
+    lenB = len;
+    i_b = 0;
+    // the history is stored twice, so that the window is always contiguous
+    x = new T[2 * lenB]();
+    // reversed coefficients, so that they match the history from old to new
+    coeff_b = new T[lenB];
+    for (size_t i = 0; i < lenB; i++) {
+      coeff_b[i] = b[lenB - 1 - i];
     }
   }
 
@@ -81,16 +103,20 @@ class FIR : public Filter<T> {
     delete[] x;
     delete[] coeff_b;
   }
+
   T process(T value) {
     x[i_b] = value;
-    T b_terms = 0;
-    T *b_shift = &coeff_b[lenB - i_b - 1];
-    for (uint8_t i = 0; i < lenB; i++) {
-      b_terms += b_shift[i] * x[i];
-    }
+    x[i_b + lenB] = value;
     i_b++;
     if (i_b == lenB) i_b = 0;
 
+    // contiguous window from the oldest to the newest value
+    const T *window = &x[i_b];
+    T b_terms = 0;
+    for (size_t i = 0; i < lenB; i++) {
+      b_terms += coeff_b[i] * window[i];
+    }
+
 #ifdef USE_TYPETRAITS
     if (!(std::is_same<T, float>::value || std::is_same<T, float>::value)) {
       b_terms = b_terms / factor;
@@ -103,11 +129,15 @@ class FIR : public Filter<T> {
     return b_terms;
   }
 
+  void process(const T *in, T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) out[j] = FIR<T>::process(in[j]);
+  }
+
  private:
-  const uint8_t lenB;
-  uint8_t i_b = 0;
+  size_t lenB = 0;
+  size_t i_b = 0;
   T *x = nullptr;
-  T *coeff_b;
+  T *coeff_b = nullptr;
   T factor;
 };
 
@@ -131,10 +161,10 @@ class IIR : public Filter<T> {
     coeff_a = new T[2 * lenA - 1];
     T a0 = _a[0];
     const T *a = &_a[1];
-    for (uint16_t i = 0; i < 2 * lenB - 1; i++) {
+    for (size_t i = 0; i < 2 * lenB - 1; i++) {
       coeff_b[i] = b[(2 * lenB - 1 - i) % lenB] / a0;
     }
-    for (uint16_t i = 0; i < 2 * lenA - 1; i++) {
+    for (size_t i = 0; i < 2 * lenA - 1; i++) {
       coeff_a[i] = a[(2 * lenA - 2 - i) % lenA] / a0;
     }
   }
@@ -154,10 +184,10 @@ class IIR : public Filter<T> {
     T a_terms = 0;
     T *a_shift = &coeff_a[lenA - i_a - 1];
 
-    for (uint8_t i = 0; i < lenB; i++) {
+    for (size_t i = 0; i < lenB; i++) {
       b_terms += x[i] * b_shift[i];
     }
-    for (uint8_t i = 0; i < lenA; i++) {
+    for (size_t i = 0; i < lenA; i++) {
       a_terms += y[i] * a_shift[i];
     }
 
@@ -180,10 +210,14 @@ class IIR : public Filter<T> {
     return filtered;
   }
 
+  void process(const T *in, T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) out[j] = IIR<T>::process(in[j]);
+  }
+
  private:
   T factor;
-  const uint8_t lenB, lenA;
-  uint8_t i_b = 0, i_a = 0;
+  const size_t lenB, lenA;
+  size_t i_b = 0, i_a = 0;
   T *x;
   T *y;
   T *coeff_b;
@@ -234,6 +268,10 @@ class BiQuadDF1 : public Filter<T> {
     return y_1;
   }
 
+  void process(const T *in, T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) out[j] = BiQuadDF1<T>::process(in[j]);
+  }
+
  private:
   T b_0;
   T b_1;
@@ -289,6 +327,10 @@ class BiQuadDF2 : public Filter<T> {
     return y;
   }
 
+  void process(const T *in, T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) out[j] = BiQuadDF2<T>::process(in[j]);
+  }
+
  protected:
   T b_0 = 0;
   T b_1 = 0;
@@ -563,6 +605,13 @@ class SOSFilter : public Filter<T> {
     return value;
   }
 
+  /// Processes the full block section by section
+  void process(const T *in, T *out, size_t n) override {
+    for (size_t i = 0; i < N; i++) {
+      filters[i]->process(i == 0 ? in : out, out, n);
+    }
+  }
+
  private:
   Filter<T> *filters[N];
   template <size_t M>
@@ -595,6 +644,16 @@ class FilterChain : public Filter<T> {
     return value;
   }
 
+  /// Processes the full block filter by filter
+  void process(const T *in, T *out, size_t n) override {
+    if (in != out) memmove(out, in, n * sizeof(T));
+    for (Filter<T> *&filter : filters) {
+      if (filter != nullptr) {
+        filter->process(out, out, n);
+      }
+    }
+  }
+
  private:
   Filter<T> *filters[N] = {0};
 };
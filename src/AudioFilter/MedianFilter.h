@@ -22,6 +22,10 @@ class MedianFilter : public Filter<T> {
 
   virtual T process(T in) override { return insert(&medianFilter, in); }
 
+  virtual void process(const T *in, T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) out[j] = insert(&medianFilter, in[j]);
+  }
+
  protected:
   struct MedianNode_t {
     T value = 0;                               // sample value
@@ -121,4 +125,135 @@ class MedianFilter : public Filter<T> {
   }
 };
 
-}  // namespace audio_tools
\ No newline at end of file
+/**
+ * @brief Streaming median filter for large windows (e.g. 31 - 101 samples):
+ * the window is kept in a ring buffer and the samples are organized in two
+ * heaps which share one array: a max heap with the values below and a min
+ * heap with the values above the median, which is located at the root of
+ * both. Replacing the oldest sample needs O(log n) steps instead of the O(n)
+ * of the MedianFilter. Even sizes are rounded up to the next odd number.
+ *
+ * Like the MedianFilter the window starts with 0 values. Use one instance
+ * per channel (e.g. in a FilteredStream).
+ * @ingroup filter
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ **/
+template <typename T>
+class MedianFilterHeap : public Filter<T> {
+ public:
+  MedianFilterHeap(int size = 31) { resize(size); }
+
+  /// Defines the window size and resets the filter
+  void resize(int size) {
+    if (size < 1) size = 1;
+    if (size % 2 == 0) size++;
+    window.resize(size);
+    pos.resize(size);
+    heap_buffer.resize(size);
+    reset();
+  }
+
+  /// Number of samples in the window
+  int size() { return window.size(); }
+
+  /// Fills the window with 0 values
+  void reset() {
+    int n = window.size();
+    // median at heap[0], min heap at heap[1..n/2], max heap at heap[-1..-n/2]
+    heap = heap_buffer.data() + n / 2;
+    for (int i = n - 1; i >= 0; i--) {
+      window[i] = 0;
+      pos[i] = ((i + 1) / 2) * ((i & 1) ? -1 : 1);
+      heap[pos[i]] = i;
+    }
+    count = n / 2;
+    idx = 0;
+  }
+
+  virtual T process(T in) override { return insert(in); }
+
+  virtual void process(const T *in, T *out, size_t n) override {
+    for (size_t j = 0; j < n; j++) out[j] = insert(in[j]);
+  }
+
+ protected:
+  Vector<T> window{0};
+  // heap position of each window entry
+  Vector<int> pos{0};
+  // window index of each heap position
+  Vector<int> heap_buffer{0};
+  int *heap = nullptr;
+  // number of entries in the min and in the max heap
+  int count = 0;
+  int idx = 0;
+
+  /// Replaces the oldest sample and provides the median
+  T insert(T value) {
+    int p = pos[idx];
+    T old = window[idx];
+    window[idx] = value;
+    if (++idx == window.size()) idx = 0;
+    if (p > 0) {
+      if (old < value) {
+        minSortDown(p * 2);
+      } else if (minSortUp(p)) {
+        maxSortDown(-1);
+      }
+    } else if (p < 0) {
+      if (value < old) {
+        maxSortDown(p * 2);
+      } else if (maxSortUp(p)) {
+        minSortDown(1);
+      }
+    } else {
+      if (count > 0) maxSortDown(-1);
+      if (count > 0) minSortDown(1);
+    }
+    return window[heap[0]];
+  }
+
+  inline bool less(int i, int j) {
+    return window[heap[i]] < window[heap[j]];
+  }
+
+  /// swaps the heap entries if i is smaller then j
+  inline bool exchangeIfLess(int i, int j) {
+    if (!less(i, j)) return false;
+    int tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+    pos[heap[i]] = i;
+    pos[heap[j]] = j;
+    return true;
+  }
+
+  /// restores the min heap starting from the indicated position
+  void minSortDown(int i) {
+    for (; i <= count; i *= 2) {
+      if (i > 1 && i < count && less(i + 1, i)) ++i;
+      if (!exchangeIfLess(i, i / 2)) break;
+    }
+  }
+
+  /// restores the max heap starting from the indicated position
+  void maxSortDown(int i) {
+    for (; i >= -count; i *= 2) {
+      if (i < -1 && i > -count && less(i, i - 1)) --i;
+      if (!exchangeIfLess(i / 2, i)) break;
+    }
+  }
+
+  /// returns true if the entry has been moved to the median
+  bool minSortUp(int i) {
+    while (i > 0 && exchangeIfLess(i, i / 2)) i /= 2;
+    return i == 0;
+  }
+
+  bool maxSortUp(int i) {
+    while (i < 0 && exchangeIfLess(i / 2, i)) i /= 2;
+    return i == 0;
+  }
+};
+
+}  // namespace audio_tools
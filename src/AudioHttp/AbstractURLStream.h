@@ -10,6 +10,7 @@ namespace audio_tools {
  */
 class AbstractURLStream : public AudioStream {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_HTTP)
   // executes the URL request
   virtual bool begin(const char* urlStr, const char* acceptMime = nullptr,
                      MethodID action = GET, const char* reqMime = "",
@@ -7,6 +7,8 @@
 
 #include "AudioHttp/URLStream.h"
 #include "AudioHttp/URLStreamBuffered.h"
+#include "AudioHttp/URLRangePrefetch.h"
 #include "AudioHttp/AudioServer.h"
+#include "AudioHttp/AudioServerMultiClient.h"
 #include "AudioHttp/ICYStream.h"
 #include "AudioHttp/ICYStreamBuffered.h"
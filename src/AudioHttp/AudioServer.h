@@ -16,7 +16,10 @@
 #endif
 
 #include "AudioCodecs/CodecWAV.h"
+#include "AudioHttp/NonBlockingOutput.h"
 #include "AudioTools.h"
+#include "AudioTools/AudioMetrics.h"
+#include "AudioTools/SilenceDetector.h"
 
 namespace audio_tools {
 
@@ -129,10 +132,13 @@ class AudioServerT {
       if (client_obj) {
         if (callback == nullptr) {
           LOGD("copy data...");
-          if (converter_ptr == nullptr) {
+          // send the pending data w/o blocking
+          if (is_non_blocking) async_output.flush();
+          BaseConverter *p_converter = activeConverter();
+          if (p_converter == nullptr) {
             copier.copy();
           } else {
-            copier.copy(*converter_ptr);
+            copier.copy(*p_converter);
           }
           // if we limit the size of the WAV the encoder gets automatically
           // closed when all has been sent
@@ -152,6 +158,12 @@ class AudioServerT {
   /// defines a converter that will be used when the audio is rendered
   void setConverter(BaseConverter *c) { converter_ptr = c; }
 
+  /// The data which is identified as silent is not sent to the client
+  void setSilenceDetector(SilenceDetector &detector) {
+    silence_converter.setSilenceDetector(detector);
+    is_silence_suppression = true;
+  }
+
   /// Provides the output stream
   Stream &out() { return client_obj; }
 
@@ -166,6 +178,25 @@ class AudioServerT {
     copier.resize(size);
   }
 
+  /// Activates the asynchronous sending: the data is kept in a pending buffer
+  /// of the indicated size and is written to the client only as much as it
+  /// accepts, so that doLoop() never blocks on a slow client.
+  void setNonBlocking(bool active, int bufferSize = DEFAULT_BUFFER_SIZE * 4) {
+    is_non_blocking = active;
+    async_output.resize(bufferSize);
+    async_output.setOutput(client_obj);
+  }
+
+  /// Number of bytes which are waiting to be sent to the client
+  int pending() { return is_non_blocking ? async_output.pending() : 0; }
+
+  /// Requests to the indicated path are answered with the metrics in the
+  /// Prometheus text format instead of the audio
+  void setMetrics(AudioMetrics &metrics, const char *path = "/metrics") {
+    p_metrics = &metrics;
+    metrics_path = path;
+  }
+
  protected:
   // WIFI
 #ifdef ESP32
@@ -183,6 +214,25 @@ class AudioServerT {
   Stream *in = nullptr;
   StreamCopy copier;
   BaseConverter *converter_ptr = nullptr;
+  SilenceSuppressionConverter silence_converter;
+  bool is_silence_suppression = false;
+  NonBlockingOutput async_output;
+  bool is_non_blocking = false;
+  AudioMetrics *p_metrics = nullptr;
+  const char *metrics_path = "/metrics";
+
+  /// The silence suppression is applied before the defined converter
+  BaseConverter *activeConverter() {
+    if (!is_silence_suppression) return converter_ptr;
+    silence_converter.setConverter(converter_ptr);
+    return &silence_converter;
+  }
+
+  /// Output for the audio data: the client or the pending buffer
+  Print &clientOutput() {
+    if (is_non_blocking) return async_output;
+    return client_obj;
+  }
 
   void setupServer(int port) {
     Server tmp(port);
@@ -236,13 +286,42 @@ class AudioServerT {
     } else if (in != nullptr) {
       // provide data for stream
       LOGI("sendReply - Returning audio stream...");
-      copier.begin(client_obj, *in);
+      async_output.clear();
+      // in non blocking mode we copy only what fits into the pending buffer
+      copier.setCheckAvailableForWrite(is_non_blocking);
+      copier.begin(clientOutput(), *in);
       if (!client_obj.connected()){
         LOGE("connection was closed");
       }
     }
   }
 
+  /// Checks if the request line (e.g. GET /metrics HTTP/1.1) is for the
+  /// metrics path
+  bool isMetricsRequest(String &requestLine) {
+    if (p_metrics == nullptr) return false;
+    const char *line = requestLine.c_str();
+    const char *path = strchr(line, ' ');
+    if (path == nullptr) return false;
+    path++;
+    int len = strlen(metrics_path);
+    return strncmp(path, metrics_path, len) == 0 &&
+           (path[len] == ' ' || path[len] == '?' || path[len] == 0);
+  }
+
+  /// Replies with the metrics and closes the connection: the audio is not
+  /// affected
+  void sendMetrics() {
+    TRACED();
+    client_obj.println("HTTP/1.1 200 OK");
+    client_obj.print("Content-type:");
+    client_obj.println(AUDIO_METRICS_MIME);
+    client_obj.println("Connection: close");
+    client_obj.println();
+    p_metrics->print(client_obj);
+    client_obj.stop();
+  }
+
   // Handle an new client connection and return the data
   void processClient() {
     // LOGD("processClient");
@@ -250,6 +329,8 @@ class AudioServerT {
       LOGI("New Client:");  // print a message out the serial port
       String currentLine =
           "";  // make a String to hold incoming data from the client
+      bool is_first_line = true;
+      bool is_metrics = false;
       while (client_obj.connected()) {  // loop while the client's connected
         if (client_obj
                 .available()) {  // if there's bytes to read from the client,
@@ -260,11 +341,19 @@ class AudioServerT {
             // row. that's the end of the client HTTP request, so send a
             // response:
             if (currentLine.length() == 0) {
-              sendReplyHeader();
-              sendReplyContent();
+              if (is_metrics) {
+                sendMetrics();
+              } else {
+                sendReplyHeader();
+                sendReplyContent();
+              }
               // break out of the while loop:
               break;
             } else {  // if you got a newline, then clear currentLine:
+              if (is_first_line) {
+                is_metrics = isMetricsRequest(currentLine);
+                is_first_line = false;
+              }
               currentLine = "";
             }
           } else if (c != '\r') {  // if you got anything else but a carriage
@@ -445,10 +534,13 @@ class AudioEncoderServer : public AudioServer {
       // provide data for stream: in -copy>  encoded_stream -> out
       LOGI("sendReply - Returning encoded stream...");
       // encoded_stream.begin(out_ptr(), encoder);
-      encoded_stream.setOutput(out_ptr());
+      async_output.clear();
+      encoded_stream.setOutput(&clientOutput());
       encoded_stream.setEncoder(encoder);
+      encoded_stream.setCheckAvailableForWrite(is_non_blocking);
       encoded_stream.begin();
 
+      copier.setCheckAvailableForWrite(is_non_blocking);
       copier.begin(encoded_stream, *in);
       if (!client_obj.connected()){
         LOGE("connection was closed");
@@ -0,0 +1,438 @@
+#pragma once
+
+#include "AudioConfig.h"
+#if defined(USE_AUDIO_SERVER) && (defined(USE_ETHERNET) || defined(USE_WIFI))
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioCodecs/CodecWAV.h"
+#include "AudioHttp/AudioServer.h"
+#include "AudioTools.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Statistics of a single listener of the AudioServerMultiClientT
+ * @ingroup http
+ */
+struct AudioServerClientInfo {
+  /// Number of bytes which have been sent
+  size_t bytes_sent = 0;
+  /// Number of encoded bytes which are waiting to be sent
+  size_t backlog = 0;
+  /// Average throughput in bytes per second
+  size_t bytes_per_second = 0;
+  /// Number of bytes which have been skipped because the client was too slow
+  size_t bytes_skipped = 0;
+};
+
+/**
+ * @brief Encoded data which is shared by all clients: the data is stored
+ * in a ring buffer and is addressed by the absolute stream position. In
+ * addition we keep the first bytes (e.g. the WAV header), so that we can
+ * provide them to clients which are joining later.
+ * @ingroup http
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioServerSharedBuffer : public Print {
+ public:
+  /// Defines the size of the ring buffer and of the stream header
+  void resize(size_t size, size_t headerSize = 0) {
+    buffer.resize(size);
+    header.resize(headerSize);
+    reset();
+  }
+
+  /// Clears the data
+  void reset() {
+    write_pos = 0;
+    header_len = 0;
+  }
+
+  size_t write(uint8_t ch) override { return write(&ch, 1); }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (buffer.size() == 0) return 0;
+    // keep the header for late clients
+    if (header_len < header.size()) {
+      size_t header_open = min(len, header.size() - header_len);
+      memcpy(header.data() + header_len, data, header_open);
+      header_len += header_open;
+    }
+    // copy with at most 2 memcpy
+    size_t size = buffer.size();
+    size_t written = 0;
+    while (written < len) {
+      size_t idx = (write_pos + written) % size;
+      size_t n = min(len - written, size - idx);
+      memcpy(buffer.data() + idx, data + written, n);
+      written += n;
+    }
+    write_pos += len;
+    return len;
+  }
+
+  /// Absolute position of the next byte which will be written
+  uint64_t position() { return write_pos; }
+
+  /// Absolute position of the oldest byte which is still available
+  uint64_t oldestPosition() {
+    return write_pos > buffer.size() ? write_pos - buffer.size() : 0;
+  }
+
+  /// Provides the contiguous data starting at the indicated position: returns
+  /// the number of bytes
+  size_t data(uint64_t pos, uint8_t *&result) {
+    if (pos < oldestPosition() || pos >= write_pos) return 0;
+    size_t idx = pos % buffer.size();
+    result = buffer.data() + idx;
+    return min((size_t)(write_pos - pos), buffer.size() - idx);
+  }
+
+  /// The recorded stream header
+  uint8_t *headerData() { return header.data(); }
+
+  /// Length of the recorded stream header
+  size_t headerSize() { return header_len; }
+
+  size_t size() { return buffer.size(); }
+
+ protected:
+  Vector<uint8_t> buffer{0};
+  Vector<uint8_t> header{0};
+  size_t header_len = 0;
+  uint64_t write_pos = 0;
+};
+
+/**
+ * @brief Webserver which streams the encoded audio to multiple listeners
+ * at the same time: the audio is encoded only once into a shared ring
+ * buffer and each client has its own read position. The data is written to
+ * the clients in small portions, so that a slow client can not stall the
+ * encoder: if the data of a client has been overwritten in the ring buffer,
+ * the client is either dropped or skips ahead to the latest data.
+ *
+ * The audio is provided either from a Stream (begin(in, info)) or you can
+ * write the PCM data directly to this object. Call copy() in the loop.
+ * @ingroup http
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <class Client, class Server>
+class AudioServerMultiClientT : public AudioOutput {
+ public:
+  AudioServerMultiClientT(AudioEncoder *encoder, int port = 80) {
+    this->encoder = encoder;
+    setupServer(port);
+  }
+
+  AudioServerMultiClientT(AudioEncoder *encoder, const char *network,
+                          const char *password, int port = 80) {
+    this->encoder = encoder;
+    this->network = network;
+    this->password = password;
+    setupServer(port);
+  }
+
+  ~AudioServerMultiClientT() { end(); }
+
+  /// Defines the max number of clients
+  void setMaxClients(int count) { max_clients = count; }
+
+  /// Defines the size of the shared ring buffer in bytes
+  void setBufferSize(size_t size) { buffer_size = size; }
+
+  /// Max number of bytes which are written to a client in one step
+  void setWriteSize(size_t size) { write_size = size; }
+
+  /// If true (default) slow clients are dropped, otherwise they skip ahead
+  void setDropSlowClients(bool drop) { is_drop_slow_clients = drop; }
+
+  /// Number of bytes at the beginning of the stream which are provided to
+  /// each new client (e.g. 44 for the WAV header)
+  void setHeaderSize(size_t size) { header_size = size; }
+
+  /// Start the server with the data from the input stream
+  bool begin(Stream &in, AudioInfo info) {
+    p_in = &in;
+    return begin(info);
+  }
+
+  /// Start the server with the data from the input stream
+  bool begin(AudioStream &in) {
+    p_in = &in;
+    return begin(in.audioInfo());
+  }
+
+  /// Start the server: the PCM data is written to this object
+  bool begin(AudioInfo info) {
+    TRACEI();
+    if (encoder == nullptr) {
+      LOGE("encoder not defined");
+      return false;
+    }
+    cfg = info;
+    shared_buffer.resize(buffer_size, header_size);
+    encoder->setAudioInfo(info);
+    encoded_output.setOutput(&shared_buffer);
+    encoded_output.setEncoder(encoder);
+    if (!encoded_output.begin(info)) {
+      LOGE("encoder begin failed");
+      return false;
+    }
+    if (p_in != nullptr) copier.begin(encoded_output, *p_in);
+#ifdef USE_WIFI
+    connectWiFi();
+#endif
+    server.begin();
+    return true;
+  }
+
+  bool begin() override { return begin(cfg); }
+
+  /// Stops the server and disconnects all clients
+  void end() override {
+    for (auto p_client : clients) {
+      p_client->client.stop();
+      delete p_client;
+    }
+    clients.clear();
+    encoded_output.end();
+  }
+
+  /// Writes the PCM data: it is encoded once for all clients
+  size_t write(const uint8_t *data, size_t len) override {
+    return encoded_output.write(data, len);
+  }
+
+  /// Accepts new clients, encodes the next input and sends it to all
+  /// clients: returns true if any client is connected
+  bool copy() {
+    acceptClient();
+    if (p_in != nullptr) copier.copy();
+    sendAll();
+    return clientCount() > 0;
+  }
+
+  /// Number of connected clients
+  int clientCount() { return clients.size(); }
+
+  /// Provides the statistics of the indicated client
+  AudioServerClientInfo clientInfo(int idx) {
+    AudioServerClientInfo result;
+    if (idx < 0 || idx >= (int)clients.size()) return result;
+    ClientEntry *p_entry = clients[idx];
+    result.bytes_sent = p_entry->bytes_sent;
+    result.bytes_skipped = p_entry->bytes_skipped;
+    result.backlog = shared_buffer.position() - p_entry->pos;
+    uint32_t ms = millis() - p_entry->start_ms;
+    result.bytes_per_second =
+        ms == 0 ? 0 : (uint64_t)p_entry->bytes_sent * 1000 / ms;
+    return result;
+  }
+
+  /// Number of clients which were dropped because they were too slow
+  uint32_t droppedClients() { return dropped_count; }
+
+  /// Provides access to the shared encoded data
+  AudioServerSharedBuffer &sharedBuffer() { return shared_buffer; }
+
+  AudioEncoder *audioEncoder() { return encoder; }
+
+ protected:
+  struct ClientEntry {
+    Client client;
+    uint64_t pos = 0;
+    size_t header_sent = 0;
+    size_t bytes_sent = 0;
+    size_t bytes_skipped = 0;
+    uint32_t start_ms = 0;
+    // the request has been read (empty line) and the reply header was sent
+    bool is_streaming = false;
+    char last[2] = {0};
+  };
+#ifdef ESP32
+  Server server;
+#else
+  Server server{80};
+#endif
+  Vector<ClientEntry *> clients;
+  AudioServerSharedBuffer shared_buffer;
+  EncodedAudioOutput encoded_output;
+  AudioEncoder *encoder = nullptr;
+  StreamCopy copier;
+  Stream *p_in = nullptr;
+  const char *network = nullptr;
+  const char *password = nullptr;
+  int max_clients = AUDIO_SERVER_MAX_CLIENTS;
+  size_t buffer_size = AUDIO_SERVER_BUFFER_SIZE;
+  size_t write_size = DEFAULT_BUFFER_SIZE;
+  size_t header_size = 0;
+  bool is_drop_slow_clients = true;
+  uint32_t dropped_count = 0;
+
+  void setupServer(int port) {
+    Server tmp(port);
+    server = tmp;
+  }
+
+#ifdef USE_WIFI
+  void connectWiFi() {
+    TRACED();
+    if (WiFi.status() != WL_CONNECTED && network != nullptr &&
+        password != nullptr) {
+      WiFi.begin(network, password);
+      while (WiFi.status() != WL_CONNECTED) {
+        Serial.print(".");
+        delay(500);
+      }
+#ifdef ESP32
+      WiFi.setSleep(false);
+#endif
+      Serial.println();
+    }
+    Serial.print("IP address: ");
+    Serial.println(WiFi.localIP());
+  }
+#endif
+
+  /// Registers a new client
+  void acceptClient() {
+#if USE_SERVER_ACCEPT
+    Client client = server.accept();
+#else
+    Client client = server.available();
+#endif
+    if (!client) return;
+    if ((int)clients.size() >= max_clients) {
+      LOGW("max clients reached: %d", max_clients);
+      client.stop();
+      return;
+    }
+    LOGI("New Client: %d", (int)clients.size() + 1);
+    ClientEntry *p_entry = new ClientEntry();
+    p_entry->client = client;
+    clients.push_back(p_entry);
+  }
+
+  /// Reads the http request w/o blocking up to the empty line
+  bool processRequest(ClientEntry &entry) {
+    while (entry.client.available() > 0) {
+      char c = entry.client.read();
+      if (c == '\r') continue;
+      if (c == '\n' && entry.last[0] == '\n') {
+        sendReplyHeader(entry);
+        return true;
+      }
+      entry.last[0] = c;
+    }
+    return false;
+  }
+
+  void sendReplyHeader(ClientEntry &entry) {
+    entry.client.println("HTTP/1.1 200 OK");
+    entry.client.print("Content-type:");
+    entry.client.println(encoder->mime());
+    entry.client.println();
+    // start with the actual data
+    entry.pos = shared_buffer.position();
+    if (entry.pos < header_size) {
+      // the header is still available in the ring buffer
+      entry.pos = 0;
+      entry.header_sent = header_size;
+    }
+    entry.start_ms = millis();
+    entry.is_streaming = true;
+  }
+
+  /// Writes the open data to all clients and removes the closed clients
+  void sendAll() {
+    for (int j = clients.size() - 1; j >= 0; j--) {
+      ClientEntry *p_entry = clients[j];
+      bool is_active = p_entry->client.connected();
+      if (is_active && !p_entry->is_streaming) processRequest(*p_entry);
+      if (is_active && p_entry->is_streaming) is_active = send(*p_entry);
+      if (!is_active) {
+        LOGI("Client disconnected");
+        p_entry->client.stop();
+        delete p_entry;
+        clients.erase(j);
+      }
+    }
+  }
+
+  /// Sends the next portion of data: returns false if the client is dropped
+  bool send(ClientEntry &entry) {
+    // provide the recorded header first
+    if (entry.header_sent < shared_buffer.headerSize()) {
+      size_t len = shared_buffer.headerSize() - entry.header_sent;
+      size_t written = entry.client.write(
+          shared_buffer.headerData() + entry.header_sent, len);
+      entry.header_sent += written;
+      entry.bytes_sent += written;
+      return true;
+    }
+    // client is too slow
+    if (entry.pos < shared_buffer.oldestPosition()) {
+      if (is_drop_slow_clients) {
+        LOGW("dropping slow client");
+        dropped_count++;
+        return false;
+      }
+      uint64_t latest = shared_buffer.position();
+      entry.bytes_skipped += latest - entry.pos;
+      entry.pos = latest;
+      return true;
+    }
+    uint8_t *data = nullptr;
+    size_t len = shared_buffer.data(entry.pos, data);
+    if (len == 0) return true;
+    // non blocking write if supported by the client
+    size_t max_len = write_size;
+    int available = entry.client.availableForWrite();
+    if (available > 0 && (size_t)available < max_len) max_len = available;
+    size_t written = entry.client.write(data, min(len, max_len));
+    entry.pos += written;
+    entry.bytes_sent += written;
+    return true;
+  }
+};
+
+#ifdef USE_WIFI
+using AudioServerMultiClient = AudioServerMultiClientT<WiFiClient, WiFiServer>;
+#endif
+
+#ifdef USE_ETHERNET
+using AudioServerMultiClient =
+    AudioServerMultiClientT<EthernetClient, EthernetServer>;
+#endif
+
+/**
+ * @brief Streams the audio as WAV data to multiple listeners: the WAV header
+ * is provided to each client which connects.
+ * @ingroup http
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioWAVServerMultiClient : public AudioServerMultiClient {
+ public:
+  AudioWAVServerMultiClient(int port = 80)
+      : AudioServerMultiClient(&wav_encoder, port) {
+    setHeaderSize(44);
+  }
+
+  AudioWAVServerMultiClient(const char *network, const char *password,
+                            int port = 80)
+      : AudioServerMultiClient(&wav_encoder, network, password, port) {
+    setHeaderSize(44);
+  }
+
+  WAVEncoder &wavEncoder() { return wav_encoder; }
+
+ protected:
+  WAVEncoder wav_encoder;
+};
+
+}  // namespace audio_tools
+
+#endif
@@ -26,34 +26,40 @@ class HttpChunkReader : public HttpLineReader {
     has_ended = false;
   }
 
-  void open(Client &client) {
+  void open(HttpClientBuffer &client) {
     LOGD("HttpChunkReader: %s", "open");
     has_ended = false;
     readChunkLen(client);
   }
 
-  // reads a block of data from the chunks
-  virtual int read(Client &client, uint8_t *str, int len) {
+  // reads a block of data from the chunks: the payload is copied directly
+  // into the provided buffer, continuing with the next chunk if possible
+  virtual int read(HttpClientBuffer &client, uint8_t *str, int len) {
     LOGD("HttpChunkReader: %s", "read");
-    if (has_ended && open_chunk_len == 0) return 0;
-
-    // read the chunk data - but not more then available
-    int read_max = len < open_chunk_len ? len : open_chunk_len;
-    int len_processed = client.read(str, read_max);
-    // update current unprocessed chunk
-    open_chunk_len -= len_processed;
-
-    // remove traling CR LF from data
-    if (open_chunk_len <= 0) {
-      removeCRLF(client);
-      readChunkLen(client);
+    int result = 0;
+    while (result < len && !(has_ended && open_chunk_len == 0)) {
+      // read the chunk data - but not more then available
+      int open = len - result;
+      int read_max = open < open_chunk_len ? open : open_chunk_len;
+      int len_processed = client.read(str + result, read_max);
+      if (len_processed <= 0) break;
+      result += len_processed;
+      // update current unprocessed chunk
+      open_chunk_len -= len_processed;
+
+      // remove traling CR LF from data
+      if (open_chunk_len <= 0) {
+        removeCRLF(client);
+        readChunkLen(client);
+      }
+      // do not wait for the next chunk
+      if (client.available() == 0) break;
     }
-
-    return len_processed;
+    return result;
   }
 
   // reads a single line from the chunks
-  virtual int readln(Client &client, uint8_t *str, int len,
+  virtual int readln(HttpClientBuffer &client, uint8_t *str, int len,
                      bool incl_nl = true) {
     LOGD("HttpChunkReader: %s", "readln");
     if (has_ended && open_chunk_len == 0) return 0;
@@ -85,7 +91,7 @@ class HttpChunkReader : public HttpLineReader {
   bool has_ended = false;
   HttpReplyHeader *http_heaer_ptr;
 
-  void removeCRLF(Client &client) {
+  void removeCRLF(HttpClientBuffer &client) {
     LOGD("HttpChunkReader: %s", "removeCRLF");
     // remove traling CR LF from data
     if (client.peek() == '\r') {
@@ -99,7 +105,7 @@ class HttpChunkReader : public HttpLineReader {
   }
 
   // we read the chunk length which is indicated as hex value
-  virtual void readChunkLen(Client &client) {
+  virtual void readChunkLen(HttpClientBuffer &client) {
     LOGD("HttpChunkReader::readChunkLen");
     uint8_t len_str[51];
     readlnInternal(client, len_str, 50, false);
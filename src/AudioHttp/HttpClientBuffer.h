@@ -0,0 +1,169 @@
+#pragma once
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioLogger.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Read buffer on top of a Client: the data is requested from the
+ * client in bulk blocks, so that the header and chunk size lines can be
+ * parsed w/o a separate (expensive) socket call for each character. Reads
+ * which are bigger then the buffer are passed directly to the client.
+ * All reads of a http reply must go through the same buffer!
+ * @ingroup http
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class HttpClientBuffer : public Stream {
+ public:
+  HttpClientBuffer(int size = HTTP_READ_BUFFER_SIZE) { buffer_size = size; }
+
+  /// Defines the client and discards the buffered data
+  void setClient(Client &client) {
+    p_client = &client;
+    clear();
+  }
+
+  /// Defines the max wait time for readBytesUntil()
+  void setTimeout(uint32_t ms) { timeout_ms = ms; }
+
+  /// Discards the buffered data
+  void clear() {
+    read_pos = 0;
+    read_end = 0;
+  }
+
+  /// Number of buffered bytes
+  int buffered() { return read_end - read_pos; }
+
+  /// The buffered data can be read even if the connection has been closed
+  bool connected() {
+    return buffered() > 0 || (p_client != nullptr && p_client->connected());
+  }
+
+  int available() override {
+    int result = buffered();
+    if (p_client != nullptr) result += p_client->available();
+    return result;
+  }
+
+  int read() override {
+    if (read_pos >= read_end && !fill()) return -1;
+    return buffer[read_pos++];
+  }
+
+  int peek() override {
+    if (read_pos >= read_end && !fill()) return -1;
+    return buffer[read_pos];
+  }
+
+  /// Provides the buffered data first: big reads go directly to the client
+  int read(uint8_t *data, size_t len) {
+    size_t result = copyBuffered(data, len);
+    if (result < len && p_client != nullptr && p_client->available() > 0) {
+      if (len - result >= buffer_size) {
+        int read = p_client->read(data + result, len - result);
+        if (read > 0) result += read;
+      } else if (fill()) {
+        result += copyBuffered(data + result, len - result);
+      }
+    }
+    return result;
+  }
+
+  /// Reads a line up to the LF using a memchr search in the buffer. The
+  /// result is terminated with 0: if incl_nl is false the CR is removed as
+  /// well. Returns the number of consumed bytes (including CR LF).
+  int readln(uint8_t *str, int len, bool incl_nl = true) {
+    int result = 0;
+    int stored = 0;
+    bool is_buffer_overflow = false;
+    bool is_eol = false;
+    while (!is_eol) {
+      if (read_pos >= read_end && !fill()) break;
+      uint8_t *start = buffer.data() + read_pos;
+      size_t open = read_end - read_pos;
+      uint8_t *nl = (uint8_t *)memchr(start, '\n', open);
+      size_t take = nl != nullptr ? nl - start + 1 : open;
+      size_t copy = min(take, (size_t)max(len - 1 - stored, 0));
+      if (copy < take) is_buffer_overflow = true;
+      memcpy(str + stored, start, copy);
+      stored += copy;
+      result += take;
+      read_pos += take;
+      is_eol = nl != nullptr;
+    }
+    // remove the LF and optionally the CR
+    if (stored > 0 && str[stored - 1] == '\n') stored--;
+    if (!incl_nl && stored > 0 && str[stored - 1] == '\r') stored--;
+    str[stored] = 0;
+    if (is_buffer_overflow) {
+      LOGE("Line cut off: %s", str);
+    }
+    return result;
+  }
+
+  /// Reads up to the terminator (which is removed) using a memchr search
+  size_t readBytesUntil(char terminator, char *data, size_t length) {
+    size_t result = 0;
+    uint32_t end = millis() + timeout_ms;
+    while (result < length) {
+      if (read_pos >= read_end && !fill()) {
+        if (millis() > end) break;
+        delay(1);
+        continue;
+      }
+      uint8_t *start = buffer.data() + read_pos;
+      size_t open = min((size_t)(read_end - read_pos), length - result);
+      uint8_t *term = (uint8_t *)memchr(start, terminator, open);
+      size_t take = term != nullptr ? term - start : open;
+      memcpy(data + result, start, take);
+      result += take;
+      read_pos += take;
+      if (term != nullptr) {
+        read_pos++;
+        break;
+      }
+    }
+    return result;
+  }
+
+  size_t write(uint8_t ch) override {
+    return p_client == nullptr ? 0 : p_client->write(ch);
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    return p_client == nullptr ? 0 : p_client->write(data, len);
+  }
+
+ protected:
+  Client *p_client = nullptr;
+  Vector<uint8_t> buffer{0};
+  size_t buffer_size = HTTP_READ_BUFFER_SIZE;
+  int read_pos = 0;
+  int read_end = 0;
+  uint32_t timeout_ms = URL_CLIENT_TIMEOUT;
+
+  size_t copyBuffered(uint8_t *data, size_t len) {
+    size_t result = min(len, (size_t)buffered());
+    if (result > 0) {
+      memcpy(data, buffer.data() + read_pos, result);
+      read_pos += result;
+    }
+    return result;
+  }
+
+  /// Refills the empty buffer with the available data
+  bool fill() {
+    if (p_client == nullptr || p_client->available() <= 0) return false;
+    // lazy allocation
+    if (buffer.size() != buffer_size) buffer.resize(buffer_size);
+    int read = p_client->read(buffer.data(), buffer_size);
+    read_pos = 0;
+    read_end = read > 0 ? read : 0;
+    return read_end > 0;
+  }
+};
+
+}  // namespace audio_tools
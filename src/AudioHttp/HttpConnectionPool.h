@@ -0,0 +1,331 @@
+#pragma once
+
+#include "AudioConfig.h"
+#ifdef USE_URL_ARDUINO
+
+#if defined(ESP32)
+#include <Client.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#endif
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioBasic/StrExt.h"
+#include "AudioTools/AudioLogger.h"
+#ifdef USE_CONCURRENCY
+#include "Concurrency/LockGuard.h"
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Cache for the DNS results: the resolved addresses are kept for the
+ * indicated time to live. The Arduino API does not provide the TTL of the DNS
+ * reply, so we use a fixed value.
+ * @ingroup http
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class DNSCache {
+ public:
+  DNSCache(uint32_t ttlMs = URL_DNS_CACHE_TTL_MS) { setTTL(ttlMs); }
+
+  /// Defines how long a resolved address is valid
+  void setTTL(uint32_t ms) { ttl_ms = ms; }
+
+  /// Provides the address of the host: from the cache if it is still valid
+  bool resolve(const char *host, IPAddress &result) {
+    uint32_t now = millis();
+    for (auto &entry : entries) {
+      if (entry.host.equals(host)) {
+        if (now - entry.time < ttl_ms) {
+          result = entry.address;
+          return true;
+        }
+        if (!lookup(host, entry.address)) return false;
+        entry.time = now;
+        result = entry.address;
+        return true;
+      }
+    }
+    Entry entry;
+    if (!lookup(host, entry.address)) return false;
+    entry.host = host;
+    entry.time = now;
+    result = entry.address;
+    entries.push_back(entry);
+    return true;
+  }
+
+  /// Removes all entries
+  void clear() { entries.clear(); }
+
+ protected:
+  struct Entry {
+    StrExt host;
+    IPAddress address;
+    uint32_t time = 0;
+  };
+  Vector<Entry> entries;
+  uint32_t ttl_ms = URL_DNS_CACHE_TTL_MS;
+
+  virtual bool lookup(const char *host, IPAddress &result) {
+#ifdef USE_WIFI
+    if (WiFi.hostByName(host, result) == 1) return true;
+#endif
+    LOGW("could not resolve %s", host);
+    return false;
+  }
+};
+
+/**
+ * @brief Pool of http connections with keep-alive: a connection to the same
+ * host and port is reused, so that we can avoid the TCP connect and the TLS
+ * handshake for each request (e.g. for HLS segments and playlist updates).
+ * The pool is limited in size and idle connections are closed after the max
+ * idle time. All URLStream objects share the DefaultConnectionPool by default.
+ * @ingroup http
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class HttpConnectionPool {
+ public:
+  HttpConnectionPool(int maxConnections = URL_POOL_SIZE,
+                     uint32_t maxIdleMs = URL_POOL_MAX_IDLE_MS) {
+    setMaxConnections(maxConnections);
+    setMaxIdleTime(maxIdleMs);
+  }
+
+  HttpConnectionPool(HttpConnectionPool const &) = delete;
+  HttpConnectionPool &operator=(HttpConnectionPool const &) = delete;
+
+  ~HttpConnectionPool() { end(); }
+
+  /// Defines the max number of connections
+  void setMaxConnections(int count) { max_connections = count; }
+
+  /// Idle connections are closed after the indicated time
+  void setMaxIdleTime(uint32_t ms) { max_idle_ms = ms; }
+
+#ifdef USE_CONCURRENCY
+  /// Defines the mutex which protects the pool if it is used by different
+  /// tasks (e.g. for the warm up of connections in the background)
+  void setMutex(MutexBase &mutex) { p_mutex = &mutex; }
+#endif
+
+  /// Provides a client for the host: a connected idle client to the same host
+  /// is reused. Returns nullptr if the pool is exhausted.
+  Client *acquire(const char *host, int port, bool isSecure) {
+    lock();
+    Client *result = acquireClient(host, port, isSecure, true);
+    unlock();
+    return result;
+  }
+
+  /// Opens an idle connection to the host which can be used by a later
+  /// acquire(): an existing idle connection is kept alive.
+  bool warmUp(const char *host, int port, bool isSecure) {
+    lock();
+    bool is_open = false;
+    for (auto p_con : connections) {
+      if (!p_con->is_used && p_con->is_secure == isSecure &&
+          p_con->port == port && p_con->host.equals(host) &&
+          p_con->client->connected()) {
+        p_con->last_used = millis();
+        is_open = true;
+        break;
+      }
+    }
+    Client *p_client =
+        is_open ? nullptr : acquireClient(host, port, isSecure, false);
+    unlock();
+    if (is_open) return true;
+    if (p_client == nullptr) return false;
+
+    // connect outside of the lock: the client is marked as used
+    LOGI("warm up connection to %s:%d", host, port);
+    bool ok = false;
+    IPAddress address;
+    if (isSecure) {
+      // TLS needs the host name for SNI
+      ok = p_client->connect(host, port);
+    } else if (dns.resolve(host, address)) {
+      ok = p_client->connect(address, port);
+    }
+    if (ok) warm_count++;
+    lock();
+    releaseClient(p_client, ok);
+    unlock();
+    return ok;
+  }
+
+  /// Provides access to the DNS cache
+  DNSCache &dnsCache() { return dns; }
+
+  /// Number of connections which have been opened in advance
+  uint32_t warmUps() { return warm_count; }
+
+  /// Returns the client to the pool: with keepAlive the connection stays open
+  void release(Client *client, bool keepAlive) {
+    lock();
+    releaseClient(client, keepAlive);
+    unlock();
+  }
+
+  /// Closes the connections which were idle for too long
+  void closeIdle() {
+    lock();
+    closeIdleClients();
+    unlock();
+  }
+
+  /// Closes all connections and releases the clients
+  void end() {
+    lock();
+    for (auto p_con : connections) {
+      if (p_con->client->connected()) p_con->client->stop();
+      delete p_con->client;
+      delete p_con;
+    }
+    connections.clear();
+    unlock();
+  }
+
+  /// Number of requests which could reuse an open connection
+  uint32_t hits() { return hit_count; }
+
+  /// Number of requests which needed a new connection
+  uint32_t misses() { return miss_count; }
+
+  /// Reuse hit rate in percent
+  int hitRatePercent() {
+    uint32_t total = hit_count + miss_count;
+    return total == 0 ? 0 : hit_count * 100 / total;
+  }
+
+  /// Resets the counters
+  void resetStatistics() {
+    hit_count = 0;
+    miss_count = 0;
+  }
+
+  /// Number of clients managed by the pool
+  int size() { return connections.size(); }
+
+ protected:
+  struct HttpConnection {
+    Client *client = nullptr;
+    StrExt host;
+    int port = 0;
+    bool is_secure = false;
+    bool is_used = false;
+    uint32_t last_used = 0;
+  };
+  Vector<HttpConnection *> connections;
+  int max_connections = URL_POOL_SIZE;
+  uint32_t max_idle_ms = URL_POOL_MAX_IDLE_MS;
+  uint32_t hit_count = 0;
+  uint32_t miss_count = 0;
+  uint32_t warm_count = 0;
+  DNSCache dns;
+#ifdef USE_CONCURRENCY
+  MutexBase *p_mutex = nullptr;
+#endif
+
+  void lock() {
+#ifdef USE_CONCURRENCY
+    if (p_mutex != nullptr) p_mutex->lock();
+#endif
+  }
+
+  void unlock() {
+#ifdef USE_CONCURRENCY
+    if (p_mutex != nullptr) p_mutex->unlock();
+#endif
+  }
+
+  void releaseClient(Client *client, bool keepAlive) {
+    for (auto p_con : connections) {
+      if (p_con->client == client) {
+        if (!keepAlive && client->connected()) client->stop();
+        p_con->is_used = false;
+        p_con->last_used = millis();
+        return;
+      }
+    }
+  }
+
+  void closeIdleClients() {
+    uint32_t now = millis();
+    for (auto p_con : connections) {
+      if (!p_con->is_used && p_con->client->connected() &&
+          now - p_con->last_used > max_idle_ms) {
+        LOGI("closing idle connection to %s", p_con->host.c_str());
+        p_con->client->stop();
+      }
+    }
+  }
+
+  Client *acquireClient(const char *host, int port, bool isSecure,
+                        bool isCounted) {
+    closeIdleClients();
+    // reuse an open connection
+    for (auto p_con : connections) {
+      if (!p_con->is_used && p_con->is_secure == isSecure &&
+          p_con->port == port && p_con->host.equals(host) &&
+          p_con->client->connected()) {
+        LOGI("reusing connection to %s:%d", host, port);
+        if (isCounted) hit_count++;
+        p_con->is_used = true;
+        return p_con->client;
+      }
+    }
+    if (isCounted) miss_count++;
+    // reuse a free client for a new connection
+    HttpConnection *p_free = nullptr;
+    for (auto p_con : connections) {
+      if (!p_con->is_used && p_con->is_secure == isSecure) {
+        p_free = p_con;
+        if (!p_con->client->connected()) break;
+      }
+    }
+    if (p_free == nullptr && connections.size() < max_connections) {
+      Client *p_client = createClient(isSecure);
+      if (p_client == nullptr) return nullptr;
+      p_free = new HttpConnection();
+      p_free->client = p_client;
+      p_free->is_secure = isSecure;
+      connections.push_back(p_free);
+    }
+    if (p_free == nullptr) {
+      LOGW("connection pool exhausted");
+      return nullptr;
+    }
+    if (p_free->client->connected()) p_free->client->stop();
+    p_free->host = host;
+    p_free->port = port;
+    p_free->is_used = true;
+    return p_free->client;
+  }
+
+  virtual Client *createClient(bool isSecure) {
+#ifdef USE_WIFI_CLIENT_SECURE
+    if (isSecure) {
+      WiFiClientSecure *result = new WiFiClientSecure();
+      result->setInsecure();
+      return result;
+    }
+#endif
+#ifdef USE_WIFI
+    if (!isSecure) return new WiFiClient();
+#endif
+    return nullptr;
+  }
+};
+
+/// Connection pool which is shared by all URLStreams
+static HttpConnectionPool DefaultConnectionPool;
+
+}  // namespace audio_tools
+
+#endif
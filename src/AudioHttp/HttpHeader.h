@@ -32,6 +32,9 @@ static const char* HOST_C = "Host";
 static const char* ACCEPT_ENCODING = "Accept-Encoding";
 static const char* IDENTITY = "identity";
 static const char* LOCATION = "Location";
+static const char* RANGE = "Range";
+static const char* CONTENT_RANGE = "Content-Range";
+static const char* ACCEPT_RANGES = "Accept-Ranges";
 
 // Http methods
 static const char* methods[] = {"?",       "GET",    "HEAD",  "POST",
@@ -76,6 +79,10 @@ class HttpHeader {
   ~HttpHeader() {
     LOGD("~HttpHeader");
     clear();
+    for (auto& ptr : free_lines) {
+      delete ptr;
+    }
+    free_lines.clear();
   }
 
   // /// clears the data - usually we do not delete but we just set the active
@@ -90,14 +97,16 @@ class HttpHeader {
   //     return *this;
   // }
 
-  /// clears the data
+  /// clears the data: the HttpHeaderLine objects are kept for the next
+  /// request, so that we do not need to allocate them again
   HttpHeader& clear() {
     is_written = false;
     is_chunked = false;
     url_path = "/";
-    // delete HttpHeaderLine objects
-    for (auto& ptr : lines){
-      delete ptr;
+    for (auto& ptr : lines) {
+      ptr->value = "";
+      ptr->active = false;
+      free_lines.push_back(ptr);
     }
     lines.clear();
     return *this;
@@ -145,6 +154,16 @@ class HttpHeader {
     return *this;
   }
 
+  /// deactivates the header line with the key
+  HttpHeader& remove(const char* key) {
+    for (auto& line_ptr : lines) {
+      if (line_ptr->key.equalsIgnoreCase(key)) {
+        line_ptr->active = false;
+      }
+    }
+    return *this;
+  }
+
   /// adds a  received new line to the header
   HttpHeader& put(const char* line) {
     LOGD("HttpHeader::put -> %s", (const char*)line);
@@ -177,7 +196,8 @@ class HttpHeader {
   }
 
   // reads a single header line
-  int readLine(Client& in, char* str, int len) {
+  template <typename T>
+  int readLine(T& in, char* str, int len) {
     int result = reader.readlnInternal(in, (uint8_t*)str, len, false);
     LOGD("HttpHeader::readLine -> %s", str);
     return result;
@@ -227,7 +247,8 @@ class HttpHeader {
   }
 
   /// reads the full header from the request (stream)
-  bool read(Client& in) {
+  template <typename T>
+  bool read(T& in) {
     LOGD("HttpHeader::read");
     // remove all existing value
     clear();
@@ -325,7 +346,9 @@ class HttpHeader {
   StrExt protocol_str{10};
   StrExt url_path{70};
   StrExt status_msg{20};
-  List<HttpHeaderLine*> lines;
+  Vector<HttpHeaderLine*> lines{0};
+  // cleared lines which are reused by headerLine()
+  Vector<HttpHeaderLine*> free_lines{0};
   HttpLineReader reader;
   const char* CRLF = "\r\n";
   int timeout_ms = URL_CLIENT_TIMEOUT;
@@ -354,8 +377,17 @@ class HttpHeader {
         }
       }
       if (create_new_lines || Str(key).equalsIgnoreCase(CONTENT_LENGTH) ||
-          Str(key).equalsIgnoreCase(CONTENT_TYPE)) {
-        HttpHeaderLine *new_line = new HttpHeaderLine(key);    
+          Str(key).equalsIgnoreCase(CONTENT_TYPE) ||
+          Str(key).equalsIgnoreCase(CONTENT_RANGE)) {
+        HttpHeaderLine* new_line = nullptr;
+        if (free_lines.empty()) {
+          new_line = new HttpHeaderLine(key);
+        } else {
+          new_line = free_lines[free_lines.size() - 1];
+          free_lines.pop_back();
+          new_line->key = key;
+          new_line->active = true;
+        }
         lines.push_back(new_line);
         return new_line;
       }
@@ -459,7 +491,8 @@ class HttpReplyHeader : public HttpHeader {
   }
 
   // reads the final chunked reply headers
-  void readExt(Client& in) {
+  template <typename T>
+  void readExt(T& in) {
     LOGI("HttpReplyHeader::readExt");
     char* line = tempBuffer();
     readLine(in, line, HTTP_MAX_LEN);
@@ -505,6 +538,32 @@ class HttpReplyHeader : public HttpHeader {
     // get reason-phrase after last SP
     status_msg.substring(line_str, space2 + 1, line_str.length());
   }
+
+  /// Parses the Content-Range of a 206 reply: "bytes start-end/total". The
+  /// total is -1 if it is not known ("*"). Returns false if not available.
+  bool contentRange(size_t& start, size_t& end, long& total) {
+    const char* range = get(CONTENT_RANGE);
+    if (range == nullptr) return false;
+    Str range_str(range);
+    int pos_start = range_str.indexOf("bytes");
+    pos_start = pos_start < 0 ? 0 : pos_start + 5;
+    int pos_minus = range_str.indexOf('-', pos_start);
+    int pos_slash = range_str.indexOf('/', pos_start);
+    if (pos_minus < 0 || pos_slash < pos_minus) {
+      LOGW("invalid %s: %s", CONTENT_RANGE, range);
+      return false;
+    }
+    start = strtoul(range + pos_start, nullptr, 10);
+    end = strtoul(range + pos_minus + 1, nullptr, 10);
+    total = range[pos_slash + 1] == '*' ? -1 : atol(range + pos_slash + 1);
+    return true;
+  }
+
+  /// Returns true if the server indicated that it supports range requests
+  bool isAcceptRanges() {
+    const char* ranges = get(ACCEPT_RANGES);
+    return ranges != nullptr && Str(ranges).equalsIgnoreCase("bytes");
+  }
 };
 
 }  // namespace audio_tools
\ No newline at end of file
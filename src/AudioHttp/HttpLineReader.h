@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AudioHttp/HttpClientBuffer.h"
 #include "AudioTools/AudioLogger.h"
 
 namespace audio_tools {
@@ -77,6 +78,23 @@ class HttpLineReader {
 
     return result;
   }
+
+  /// Fast path: the line is searched in the buffered data
+  virtual int readlnInternal(HttpClientBuffer& client, uint8_t* str, int len,
+                             bool incl_nl = true) {
+    LOGD("HttpLineReader %s", "readlnInternal");
+    // wait for first character
+    for (int w = 0; w < 20 && client.available() == 0; w++) {
+      delay(100);
+    }
+    // if we do not have any data we stop
+    if (client.available() == 0) {
+      LOGW("HttpLineReader %s", "readlnInternal->no Data");
+      str[0] = 0;
+      return 0;
+    }
+    return client.readln(str, len, incl_nl);
+  }
 };
 
 }  // namespace audio_tools
@@ -25,6 +25,7 @@ namespace audio_tools {
 
 class HttpRequest {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_HTTP)
   friend class URLStream;
 
   HttpRequest() = default;
@@ -36,6 +37,7 @@ class HttpRequest {
   void setClient(Client &client) {
     this->client_ptr = &client;
     this->client_ptr->setTimeout(clientTimeout);
+    client_buffer.setClient(client);
   }
 
   // the requests usually need a host. This needs to be set if we did not
@@ -45,17 +47,20 @@ class HttpRequest {
     this->host_name = host;
   }
 
-  operator bool() { return client_ptr != nullptr ? (bool)*client_ptr : false; }
+  operator bool() {
+    if (client_ptr == nullptr) return false;
+    return client_buffer.buffered() > 0 || (bool)*client_ptr;
+  }
 
   virtual bool connected() {
-    return client_ptr == nullptr ? false : client_ptr->connected();
+    return client_ptr == nullptr ? false : client_buffer.connected();
   }
 
   virtual int available() {
     if (reply_header.isChunked()) {
       return chunk_reader.available();
     }
-    return client_ptr != nullptr ? client_ptr->available() : 0;
+    return client_ptr != nullptr ? client_buffer.available() : 0;
   }
 
   virtual void stop() {
@@ -116,23 +121,23 @@ class HttpRequest {
   virtual int read(uint8_t *str, int len) {
     TRACED();
     if (reply_header.isChunked()) {
-      return chunk_reader.read(*client_ptr, str, len);
+      return chunk_reader.read(client_buffer, str, len);
     } else {
-      return client_ptr->read(str, len);
+      return client_buffer.read(str, len);
     }
   }
 
   size_t readBytesUntil(char terminator, char *buffer, size_t length) {
-    return client_ptr->readBytesUntil(terminator, buffer, length);
+    return client_buffer.readBytesUntil(terminator, buffer, length);
   }
 
   // read the reply data up to the next new line. For Chunked data we provide
   // the full chunk!
   virtual int readln(uint8_t *str, int len, bool incl_nl = true) {
     if (reply_header.isChunked()) {
-      return chunk_reader.readln(*client_ptr, str, len);
+      return chunk_reader.readln(client_buffer, str, len);
     } else {
-      return chunk_reader.readlnInternal(*client_ptr, str, len, incl_nl);
+      return chunk_reader.readlnInternal(client_buffer, str, len, incl_nl);
     }
   }
 
@@ -213,6 +218,8 @@ class HttpRequest {
       LOGE("The client has not been defined");
       return false;
     }
+    // the data of a previous reply is not valid any more
+    client_buffer.clear();
     if (http_connect_callback) {
       http_connect_callback(*this, url, request_header);
     }
@@ -291,11 +298,11 @@ class HttpRequest {
     LOGI("Request written ... waiting for reply")
     // Commented out because this breaks the RP2040 W
     // client_ptr->flush();
-    reply_header.read(*client_ptr);
+    reply_header.read(client_buffer);
 
     // if we use chunked tranfer we need to read the first chunked length
     if (reply_header.isChunked()) {
-      chunk_reader.open(*client_ptr);
+      chunk_reader.open(client_buffer);
     };
 
     // wait for data
@@ -310,13 +317,18 @@ class HttpRequest {
   }
 
   /// Defines the client timeout in ms
-  void setTimeout(int timeoutMs) { clientTimeout = timeoutMs; }
+  void setTimeout(int timeoutMs) {
+    clientTimeout = timeoutMs;
+    client_buffer.setTimeout(timeoutMs);
+  }
 
   /// we are sending the data chunked
   bool isChunked() { return request_header.isChunked(); }
 
  protected:
   Client *client_ptr = nullptr;
+  // all reads of the reply go through the buffer
+  HttpClientBuffer client_buffer;
   Url url;
   HttpRequestHeader request_header;
   HttpReplyHeader reply_header;
@@ -93,14 +93,7 @@ class ICYStream : public AbstractURLStream {
       // get data
       int read = url.readBytes(data, len);
       // remove metadata from data
-      int pos = 0;
-      for (int j = 0; j < read; j++) {
-        icy.processChar(data[j]);
-        if (icy.isData()) {
-          data[pos++] = data[j];
-        }
-      }
-      result = pos;
+      result = read > 0 ? icy.demux(data, read) : 0;
     } else {
       // fast access if there is no metadata
       result = url.readBytes(data, len);
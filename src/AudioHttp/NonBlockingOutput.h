@@ -0,0 +1,90 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioOutput.h"
+#include "AudioTools/Buffers.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Output which never blocks on the network: the data is stored in a
+ * pending buffer and is sent to the final output (e.g. a WiFiClient) in
+ * partial blocks with flush(), which needs to be called in the polling loop.
+ * We only write as much as availableForWrite() of the final output permits.
+ * Some clients (e.g. the ESP32 WiFiClient) always report 0: in this case we
+ * write at most the indicated max write size in one step.
+ *
+ * The writer gets only the free space of the pending buffer reported in
+ * availableForWrite(): if the buffer is full, write() returns 0 instead of
+ * waiting. This also works with AsyncTCP-style clients, if they provide the
+ * free send space as availableForWrite().
+ * @ingroup http
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class NonBlockingOutput : public AudioOutput {
+ public:
+  NonBlockingOutput(int bufferSize = DEFAULT_BUFFER_SIZE * 4) {
+    resize(bufferSize);
+  }
+
+  NonBlockingOutput(Print &out, int bufferSize = DEFAULT_BUFFER_SIZE * 4) {
+    setOutput(out);
+    resize(bufferSize);
+  }
+
+  /// Defines the final output
+  void setOutput(Print &out) { p_out = &out; }
+
+  /// Defines the size of the pending buffer
+  void resize(int size) { buffer.resize(size); }
+
+  /// Max number of bytes which are written if the final output does not
+  /// report availableForWrite()
+  void setMaxWriteSize(int size) { max_write_size = size; }
+
+  /// Discards the pending data
+  void clear() { buffer.reset(); }
+
+  /// Adds the data to the pending buffer: returns the accepted bytes
+  size_t write(const uint8_t *data, size_t len) override {
+    // try to make some room first
+    if ((size_t)buffer.availableForWrite() < len) flush();
+    return buffer.writeArray(data, len);
+  }
+
+  /// Free space in the pending buffer
+  int availableForWrite() override { return buffer.availableForWrite(); }
+
+  /// Sends the pending data in partial blocks w/o blocking
+  void flush() override {
+    if (p_out == nullptr) return;
+    while (buffer.available() > 0) {
+      int len = buffer.readPtrSize();
+      int available = p_out->availableForWrite();
+      int max_len = available > 0 ? available : max_write_size;
+      if (len > max_len) len = max_len;
+      size_t written = p_out->write(buffer.readPtr(), len);
+      buffer.consume(written);
+      total_written += written;
+      // the output does not accept more data for now
+      if ((int)written < len || available <= 0) break;
+    }
+  }
+
+  /// Number of bytes which are waiting to be sent
+  int pending() { return buffer.available(); }
+
+  /// Total number of bytes which have been sent to the final output
+  size_t totalWritten() { return total_written; }
+
+  void resetTotalWritten() { total_written = 0; }
+
+ protected:
+  Print *p_out = nullptr;
+  RingBuffer<uint8_t> buffer{0};
+  int max_write_size = 512;
+  size_t total_written = 0;
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "AudioConfig.h"
+#ifdef USE_URL_ARDUINO
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioHttp/URLStream.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Loads multiple byte ranges of a file in parallel with http range
+ * requests: e.g. the moov atom at the end of a M4A file, while the main
+ * URLStream is still reading the audio data from the beginning. Each range is
+ * using its own URLStream (connection) and is kept in memory, so the number of
+ * ranges is limited by the size of the connection pool.
+ *
+ * Call copy() until isLoaded() returns true: the loaded data is then provided
+ * with readBytes().
+ * @ingroup http
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class URLRangePrefetch {
+ public:
+  URLRangePrefetch() = default;
+
+  URLRangePrefetch(URLRangePrefetch const &) = delete;
+  URLRangePrefetch &operator=(URLRangePrefetch const &) = delete;
+
+  ~URLRangePrefetch() {
+    end();
+    clear();
+  }
+
+  /// Adds a byte range which will be loaded by begin()
+  void addRange(size_t start, size_t len) {
+    RangeEntry *p_range = new RangeEntry();
+    p_range->start = start;
+    p_range->len = len;
+    ranges.push_back(p_range);
+  }
+
+  /// Removes all ranges
+  void clear() {
+    end();
+    for (auto p_range : ranges) delete p_range;
+    ranges.clear();
+  }
+
+  /// Starts the range requests for all ranges
+  bool begin(const char *url, const char *acceptMime = nullptr) {
+    TRACEI();
+    bool result = true;
+    for (auto p_range : ranges) {
+      p_range->loaded = 0;
+      p_range->data.resize(p_range->len);
+      if (p_range->stream == nullptr) p_range->stream = new URLStream();
+      p_range->stream->setWaitForData(false);
+      long last = p_range->start + p_range->len - 1;
+      if (!p_range->stream->beginRange(url, p_range->start, last,
+                                       acceptMime) ||
+          p_range->stream->position() != p_range->start) {
+        LOGE("range request failed: %lu", (unsigned long)p_range->start);
+        p_range->stream->end();
+        result = false;
+      }
+    }
+    return result;
+  }
+
+  /// Loads the available data of all ranges w/o blocking: returns the number
+  /// of loaded bytes
+  size_t copy() {
+    size_t result = 0;
+    for (auto p_range : ranges) {
+      if (p_range->isLoaded() || p_range->stream == nullptr) continue;
+      size_t open = p_range->len - p_range->loaded;
+      int available = p_range->stream->available();
+      if (available <= 0) continue;
+      size_t len = min((size_t)available, open);
+      size_t read = p_range->stream->readBytes(
+          p_range->data.data() + p_range->loaded, len);
+      p_range->loaded += read;
+      result += read;
+      if (p_range->isLoaded()) p_range->stream->end();
+    }
+    return result;
+  }
+
+  /// Returns true if all ranges have been loaded
+  bool isLoaded() {
+    for (auto p_range : ranges) {
+      if (!p_range->isLoaded()) return false;
+    }
+    return true;
+  }
+
+  /// Returns true if the indicated bytes are available in memory
+  bool contains(size_t pos, size_t len) {
+    RangeEntry *p_range = findRange(pos);
+    return p_range != nullptr &&
+           pos + len <= p_range->start + p_range->loaded;
+  }
+
+  /// Provides the loaded data starting at the indicated file position:
+  /// returns the number of copied bytes
+  size_t readBytes(size_t pos, uint8_t *data, size_t len) {
+    RangeEntry *p_range = findRange(pos);
+    if (p_range == nullptr) return 0;
+    size_t offset = pos - p_range->start;
+    size_t result = min(len, p_range->loaded - offset);
+    memcpy(data, p_range->data.data() + offset, result);
+    return result;
+  }
+
+  /// Closes all connections: the loaded data is kept
+  void end() {
+    for (auto p_range : ranges) {
+      if (p_range->stream != nullptr) {
+        delete p_range->stream;
+        p_range->stream = nullptr;
+      }
+    }
+  }
+
+  /// Number of defined ranges
+  int size() { return ranges.size(); }
+
+ protected:
+  struct RangeEntry {
+    size_t start = 0;
+    size_t len = 0;
+    size_t loaded = 0;
+    Vector<uint8_t> data{0};
+    URLStream *stream = nullptr;
+    bool isLoaded() { return loaded >= len; }
+  };
+  Vector<RangeEntry *> ranges;
+
+  /// Finds the range with loaded data at the indicated position
+  RangeEntry *findRange(size_t pos) {
+    for (auto p_range : ranges) {
+      if (pos >= p_range->start && pos < p_range->start + p_range->loaded) {
+        return p_range;
+      }
+    }
+    return nullptr;
+  }
+};
+
+}  // namespace audio_tools
+
+#endif
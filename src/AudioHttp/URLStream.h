@@ -11,6 +11,7 @@
 #endif
 
 #include "AudioHttp/AbstractURLStream.h"
+#include "AudioHttp/HttpConnectionPool.h"
 #include "AudioHttp/HttpRequest.h"
 
 namespace audio_tools {
@@ -80,10 +81,19 @@ class URLStream : public AbstractURLStream {
                      MethodID action = GET, const char* reqMime = "",
                      const char* reqData = "") override {
     LOGI("%s: %s", LOG_METHOD, urlStr);
+    if (!is_range_request) {
+      range_start = 0;
+      range_end = -1;
+    }
+    is_range_request = false;
     if (!preProcess(urlStr, acceptMime)) {
       LOGE("preProcess failed");
       return false;
     }
+    p_accept_mime = acceptMime;
+    is_get = action == GET;
+    bool is_range = is_get && (range_start > 0 || range_end >= 0);
+    if (is_range) setupRangeHeader();
     int result = process<const char*>(action, url, reqMime, reqData);
     if (result > 0) {
       size = request.contentLength();
@@ -93,13 +103,58 @@ class URLStream : public AbstractURLStream {
       }
     }
     total_read = 0;
-    active = result == 200;
+    total_size = size;
+    if (result == 206) {
+      processContentRange();
+    } else if (result == 200 && is_range) {
+      LOGW("Range not supported by server: data starts at 0");
+      range_start = 0;
+    }
+    active = result == 200 || result == 206;
     LOGI("==> http status: %d", result);
     custom_log_level.reset();
 
     return active;
   }
 
+  /// Execute a GET request for the data starting at the indicated byte
+  /// position up to the (inclusive) end position: -1 for the end of the file
+  virtual bool beginRange(const char* urlStr, size_t start, long end = -1,
+                          const char* acceptMime = nullptr) {
+    range_start = start;
+    range_end = end;
+    is_range_request = true;
+    return begin(urlStr, acceptMime);
+  }
+
+  /// Restarts the actual GET request at the indicated byte position
+  bool seek(size_t pos) {
+    if (url_str.isEmpty()) {
+      LOGE("begin() not called");
+      return false;
+    }
+    // the url_str is updated by begin
+    StrExt url_copy(url_str.c_str());
+    return beginRange(url_copy.c_str(), pos, -1, p_accept_mime);
+  }
+
+  /// Actual byte position in the resource
+  size_t position() { return range_start + total_read; }
+
+  /// Size of the resource in bytes (from the Content-Range or
+  /// Content-Length): -1 if not known
+  long totalSize() { return total_size; }
+
+  /// If activated, a GET request is automatically continued with a range
+  /// request at the actual position when the connection drops
+  void setAutoResume(bool active, int maxRetries = URL_RESUME_RETRIES) {
+    is_auto_resume = active;
+    resume_max_retries = maxRetries;
+  }
+
+  /// Number of successful resumes
+  int resumeCount() { return resume_count; }
+
   /// Execute e.g. http POST request which submits the content as a stream
   virtual bool begin(const char* urlStr, const char* acceptMime,
                      MethodID action, const char* reqMime, Stream& reqData,
@@ -118,6 +173,10 @@ class URLStream : public AbstractURLStream {
       }
     }
     total_read = 0;
+    total_size = size;
+    range_start = 0;
+    range_end = -1;
+    is_get = action == GET;
     active = result == 200;
     LOGI("==> http status: %d", result);
     custom_log_level.reset();
@@ -126,7 +185,30 @@ class URLStream : public AbstractURLStream {
   }
 
   virtual void end() override {
-    if (active) request.stop();
+    if (p_pool_client != nullptr) {
+      // keep the connection open if the reply has been read completely
+      bool keep_alive = active && isKeepAlive();
+      if (!keep_alive) request.stop();
+      p_pool->release(p_pool_client, keep_alive);
+      p_pool_client = nullptr;
+    } else if (active) {
+      request.stop();
+    }
+    active = false;
+    clear();
+  }
+
+  /// Defines the connection pool which is used if no client has been
+  /// defined: nullptr deactivates the pooling
+  void setConnectionPool(HttpConnectionPool *pool) { p_pool = pool; }
+
+  /// Ends the actual request but keeps the connection open (keep-alive), so
+  /// that it is reused by the next begin() to the same host
+  void endKeepAlive() {
+    if (p_pool_client != nullptr) {
+      p_pool->release(p_pool_client, true);
+      p_pool_client = nullptr;
+    }
     active = false;
     clear();
   }
@@ -135,6 +217,9 @@ class URLStream : public AbstractURLStream {
     if (!active || !request) return 0;
 
     int result = request.available();
+    if (result == 0 && isResumeNeeded() && resume()) {
+      result = request.available();
+    }
     LOGD("available: %d", result);
     return result;
   }
@@ -143,8 +228,12 @@ class URLStream : public AbstractURLStream {
     if (!active || !request) return 0;
 
     int read = request.read((uint8_t*)&data[0], len);
-    if (read < 0) {
+    if (read <= 0) {
       read = 0;
+      if (isResumeNeeded() && resume()) {
+        read = request.read((uint8_t*)&data[0], len);
+        if (read < 0) read = 0;
+      }
     }
     total_read += read;
     LOGD("readBytes %d -> %d", (int)len, read);
@@ -258,6 +347,17 @@ class URLStream : public AbstractURLStream {
   Url url;
   long size;
   long total_read;
+  long total_size = -1;
+  // range request
+  size_t range_start = 0;
+  long range_end = -1;
+  bool is_range_request = false;
+  bool is_get = true;
+  const char* p_accept_mime = nullptr;
+  // resume after a dropped connection
+  bool is_auto_resume = false;
+  int resume_max_retries = URL_RESUME_RETRIES;
+  int resume_count = 0;
   // buffered single byte read
   Vector<uint8_t> read_buffer{0};
   uint16_t read_buffer_size = DEFAULT_BUFFER_SIZE;
@@ -271,7 +371,11 @@ class URLStream : public AbstractURLStream {
   Client* client = nullptr; // client defined via setClient
 #ifdef USE_WIFI
   WiFiClient* clientInsecure = nullptr; // wifi client for http
+  HttpConnectionPool* p_pool = &DefaultConnectionPool;
+#else
+  HttpConnectionPool* p_pool = nullptr;
 #endif
+  Client* p_pool_client = nullptr; // client from the connection pool
 #ifdef USE_WIFI_CLIENT_SECURE
   WiFiClientSecure* clientSecure = nullptr; // wifi client for https
 #endif
@@ -282,12 +386,15 @@ class URLStream : public AbstractURLStream {
   bool preProcess(const char* urlStr, const char* acceptMime) {
     TRACED();
     custom_log_level.set();
+    // a kept alive connection can only be reused for the same host
+    Url new_url(urlStr);
+    bool is_same_host = Str(url.host()).equals(new_url.host());
     url_str = urlStr;
     url.setUrl(url_str.c_str());
     int result = -1;
 
     // close it - if we have an active connection
-    if (active) end();
+    if (active || p_pool_client != nullptr) end();
 
 #ifdef USE_WIFI
     // optional: login if necessary if no external client is defined
@@ -304,9 +411,14 @@ class URLStream : public AbstractURLStream {
       request.setAcceptMime(acceptMime);
     }
 
-    // setup client
-    Client& client = getClient(url.isSecure());
+    // setup client: prefer a pooled connection
+    if (this->client == nullptr && p_pool != nullptr) {
+      p_pool_client = p_pool->acquire(url.host(), url.port(), url.isSecure());
+    }
+    Client& client =
+        p_pool_client != nullptr ? *p_pool_client : getClient(url.isSecure());
     request.setClient(client);
+    if (p_pool_client == nullptr && !is_same_host) request.stop();
 
     // set timeout
     client.setTimeout(clientTimeout / 1000);
@@ -317,6 +429,9 @@ class URLStream : public AbstractURLStream {
     if (clientSecure != nullptr) {
       clientSecure->setHandshakeTimeout(handshakeTimeout);
     }
+    if (p_pool_client != nullptr && url.isSecure()) {
+      ((WiFiClientSecure*)p_pool_client)->setHandshakeTimeout(handshakeTimeout);
+    }
 
     // Performance optimization for ESP32
     if (!is_power_save) {
@@ -341,6 +456,11 @@ class URLStream : public AbstractURLStream {
       if (redirect_url != nullptr) {
         LOGW("Redirected to: %s", redirect_url);
         url.setUrl(redirect_url);
+        // the reply of the redirect has not been consumed
+        if (p_pool_client != nullptr) {
+          p_pool->release(p_pool_client, false);
+          p_pool_client = nullptr;
+        }
         Client* p_client = &getClient(url.isSecure());
         p_client->stop();
         request.setClient(*p_client);
@@ -393,6 +513,81 @@ class URLStream : public AbstractURLStream {
 
   inline bool isEOS() { return read_pos >= read_size; }
 
+  /// Adds the Range header to the request
+  void setupRangeHeader() {
+    char range[40];
+    if (range_end >= 0) {
+      snprintf(range, sizeof(range), "bytes=%lu-%ld",
+               (unsigned long)range_start, range_end);
+    } else {
+      snprintf(range, sizeof(range), "bytes=%lu-", (unsigned long)range_start);
+    }
+    LOGI("%s: %s", RANGE, range);
+    request.header().put(RANGE, range);
+  }
+
+  /// Determines the position and total size from the Content-Range
+  void processContentRange() {
+    size_t start = 0, end = 0;
+    long total = -1;
+    if (request.reply().contentRange(start, end, total)) {
+      range_start = start;
+      total_size = total;
+      if (size <= 0) size = end - start + 1;
+    } else {
+      total_size = -1;
+    }
+  }
+
+  /// A GET request must be resumed if the connection dropped before all data
+  /// has been received
+  bool isResumeNeeded() {
+    return is_auto_resume && is_get && size > 0 && total_read < size &&
+           !request.connected();
+  }
+
+  /// Continues the GET request at the actual position
+  bool resume() {
+    long full_size = size;
+    long full_total_size = total_size;
+    long read = total_read;
+    size_t start = range_start;
+    long last = range_end >= 0 ? range_end : (long)start + full_size - 1;
+    long orig_end = range_end;
+    size_t pos = start + read;
+    StrExt url_copy(url_str.c_str());
+    for (int j = 0; j < resume_max_retries; j++) {
+      LOGW("connection lost: resuming at %lu", (unsigned long)pos);
+      if (beginRange(url_copy.c_str(), pos, last, p_accept_mime) &&
+          range_start == pos) {
+        // report the values of the original request
+        range_start = start;
+        range_end = orig_end;
+        size = full_size;
+        total_size = full_total_size;
+        total_read = read;
+        resume_count++;
+        return true;
+      }
+      if (active) {
+        // the server ignored the range: we can not continue
+        LOGE("resume failed: no range support");
+        end();
+        return false;
+      }
+      delay(URL_RESUME_DELAY_MS);
+    }
+    LOGE("resume failed");
+    return false;
+  }
+
+  /// The connection can be reused if the reply has been read completely
+  bool isKeepAlive() {
+    if (size <= 0 || total_read < size) return false;
+    const char* con = request.reply().get(CONNECTION);
+    return con == nullptr || !Str(con).equalsIgnoreCase(CON_CLOSE);
+  }
+
   bool login() {
 #ifdef USE_WIFI
     if (network != nullptr && password != nullptr &&
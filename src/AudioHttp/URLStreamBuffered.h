@@ -17,6 +17,11 @@
 #  define URL_STREAM_BUFFER_COUNT 10
 #endif
 
+/// Size of the network reads: about one TCP window
+#ifndef URL_STREAM_READ_SIZE
+#  define URL_STREAM_READ_SIZE 1460
+#endif
+
 #ifndef STACK_SIZE
 #  define STACK_SIZE 30000
 #endif
@@ -24,10 +29,45 @@
 
 namespace audio_tools {
 
+/**
+ * @brief Fill level information of the BufferedTaskStream which can be used to
+ * tune the startup latency against the rebuffering frequency.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct BufferTelemetry {
+  /// Bytes which are currently buffered
+  size_t available = 0;
+  /// Size of the buffer (high-water mark)
+  size_t size = 0;
+  /// Level at which the playback is (re)started
+  size_t start_level = 0;
+  /// Lowest fill level since the playback has been started
+  size_t min_available = 0;
+  /// Time in ms from begin() to the start of the playback
+  uint32_t startup_ms = 0;
+  /// Number of buffer underruns which caused a rebuffering
+  uint32_t underruns = 0;
+  /// Total number of bytes which have been read from the stream
+  size_t total_bytes = 0;
+  /// Fill level in percent
+  float fillPercent() { return size == 0 ? 0.0f : 100.0f * available / size; }
+};
+
 /**
  * @brief A FreeRTOS task is filling the buffer from the indicated stream. Only
  * to be used on the ESP32
  *
+ * The data is provided as soon as the low-water mark has been reached, so
+ * that the playback starts quickly, while the task continues to fill the
+ * buffer up to the high-water mark (the buffer size) as the bandwidth allows.
+ * After an underrun we wait for the double of the last start level (max the
+ * high-water mark) before we continue to provide data.
+ *
+ * The task reads blocks of URL_STREAM_READ_SIZE bytes and is blocked by the
+ * FreeRTOS stream buffer (which is using a task notification) when the buffer
+ * is full, so that it wakes up as soon as the consumer has read some data:
+ * there is no polling with delay().
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
@@ -45,12 +85,30 @@ class BufferedTaskStream : public AudioStream {
     stop();
   }
 
+  /// Defines the buffer size (high-water mark) in bytes: call before begin()
+  void setBufferSize(size_t size) { buffer_size = size; }
+
+  /// Defines the fill level in bytes at which we start to provide data
+  void setLowWaterMark(size_t level) { low_water = level; }
+
+  /// Defines the size of the blocks which are read from the input stream
+  void setReadSize(size_t size) { read_size = size; }
+
   virtual void begin(bool wait = true) {
     TRACED();
+    if (low_water == 0 || low_water > buffer_size) low_water = buffer_size / 4;
+    if (read_size > buffer_size) read_size = buffer_size;
+    buffer.resize(buffer_size);
+    buffer.reset();
+    read_buffer.resize(read_size);
+    telemetry_data = BufferTelemetry();
+    telemetry_data.size = buffer_size;
+    telemetry_data.start_level = low_water;
+    start_ms = millis();
+    is_wait = wait;
     active = true;
-    ready = false;
+    ready = !wait;
     task.begin(std::bind(&BufferedTaskStream::processTask, this));
-    if (!wait) ready = true;
   }
 
   virtual void end() {
@@ -76,68 +134,101 @@ class BufferedTaskStream : public AudioStream {
 
   /// reads a byte - to be avoided
   virtual int read() override {
-    // if (!ready) return -1;
-    int result = -1;
-    result = buffers.read();
-    return result;
+    uint8_t result = 0;
+    return readBytes(&result, 1) == 1 ? result : -1;
   }
 
-  /// peeks a byte - to be avoided
-  virtual int peek() override {
-    // if (!ready) return -1;
-    int result = -1;
-    result = buffers.peek();
-    return result;
-  };
+  /// peeks a byte - not supported by the stream buffer
+  virtual int peek() override { return -1; };
 
   /// Use this method !!
   virtual size_t readBytes(uint8_t *data, size_t len) override {
-    // if (!ready) return 0;
-    size_t result = 0;
-    result = buffers.readArray(data, len);
+    if (!isReady()) return 0;
+    size_t result = buffer.readArray(data, len);
+    updateTelemetry();
     LOGD("%s: %zu -> %zu", LOG_METHOD, len, result);
     return result;
   }
 
   /// Returns the available bytes in the buffer: to be avoided
   virtual int available() override {
-    // if (!ready) return 0;
-    int result = 0;
-    result = buffers.available();
-    return result;
+    return isReady() ? buffer.available() : 0;
   }
 
+  /// Provides the actual fill level information
+  BufferTelemetry telemetry() {
+    telemetry_data.available = buffer.available();
+    return telemetry_data;
+  }
 
  protected:
   AudioStream *p_stream = nullptr;
   bool active = false;
   Task task{"BufferedTaskStream", STACK_SIZE, URL_STREAM_PRIORITY,
             URL_STREAM_CORE};
-  SynchronizedNBuffer<uint8_t> buffers{DEFAULT_BUFFER_SIZE,
-                                       URL_STREAM_BUFFER_COUNT};
+  size_t buffer_size = DEFAULT_BUFFER_SIZE * URL_STREAM_BUFFER_COUNT;
+  size_t low_water = 0;
+  size_t read_size = URL_STREAM_READ_SIZE;
+  // the consumer does not wait, the task waits until there is space
+  BufferRTOS<uint8_t> buffer{0, 1, portMAX_DELAY, 0};
+  Vector<uint8_t> read_buffer{0};
+  BufferTelemetry telemetry_data;
+  uint32_t start_ms = 0;
   bool ready = false;
-
-  void processTask() {
-    size_t available_to_write = this->buffers.availableForWrite();
-    if (*(this->p_stream) && available_to_write > 0) {
-      size_t to_read = min(available_to_write, (size_t)512);
-      uint8_t buffer[to_read];
-      size_t avail_read = this->p_stream->readBytes((uint8_t *)buffer, to_read);
-      size_t written = this->buffers.writeArray(buffer, avail_read);
-
-      if (written != avail_read) {
-        LOGE("DATA Lost! %zu reqested, %zu written!", avail_read, written);
+  bool is_wait = true;
+
+  /// Checks if the start level has been reached
+  bool isReady() {
+    if (!ready) {
+      int available = buffer.available();
+      // at the end of the stream we provide the rest
+      bool is_eof = !(*p_stream) && available > 0;
+      if (available >= (int)telemetry_data.start_level || is_eof) {
+        ready = true;
+        telemetry_data.min_available = available;
+        if (telemetry_data.startup_ms == 0) {
+          telemetry_data.startup_ms = millis() - start_ms;
+          LOGI("playback started after %u ms", (unsigned) telemetry_data.startup_ms);
+        }
       }
+    }
+    return ready;
+  }
 
-    } else {
-      // 3ms at 44100 stereo is about 529.2 bytes
-      delay(3);
+  /// Records the fill level and detects underruns
+  void updateTelemetry() {
+    size_t available = buffer.available();
+    if (available < telemetry_data.min_available) {
+      telemetry_data.min_available = available;
     }
-    // buffer is full we start to provide data
-    if (available_to_write == 0) {
-      this->ready = true;
+    if (available == 0 && is_wait && *p_stream) {
+      // underrun: we need a bigger reserve
+      telemetry_data.underruns++;
+      size_t level = telemetry_data.start_level * 2;
+      telemetry_data.start_level = level > buffer_size ? buffer_size : level;
+      ready = false;
+      LOGW("buffer underrun: rebuffering to %u bytes",
+           (unsigned)telemetry_data.start_level);
     }
   }
+
+  void processTask() {
+    if (*(this->p_stream)) {
+      size_t avail_read =
+          this->p_stream->readBytes(read_buffer.data(), read_buffer.size());
+      if (avail_read > 0) {
+        // blocks until there is enough space
+        size_t written = buffer.writeArray(read_buffer.data(), avail_read);
+        telemetry_data.total_bytes += written;
+        if (written != avail_read) {
+          LOGE("DATA Lost! %zu reqested, %zu written!", avail_read, written);
+        }
+        return;
+      }
+    }
+    // no data from the network
+    delay(1);
+  }
 };
 
 /**
@@ -204,6 +295,18 @@ class URLStreamBuffered : public AbstractURLStream {
     urlStream.end();
   }
 
+  /// Defines the buffer size (high-water mark) in bytes: call before begin()
+  void setBufferSize(size_t size) { taskStream.setBufferSize(size); }
+
+  /// Defines the fill level in bytes at which we start to provide data
+  void setLowWaterMark(size_t level) { taskStream.setLowWaterMark(level); }
+
+  /// Defines the size of the blocks which are read from the network
+  void setReadSize(size_t size) { taskStream.setReadSize(size); }
+
+  /// Provides the actual fill level information
+  BufferTelemetry telemetry() { return taskStream.telemetry(); }
+
   /// provides access to the HttpRequest
   HttpRequest &httpRequest() { return urlStream.httpRequest(); }
 
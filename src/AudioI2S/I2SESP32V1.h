@@ -119,6 +119,34 @@ class I2SDriverESP32V1 {
     return result;
   }
 
+  /// Pull mode: the callback renders the output data directly into the DMA
+  /// buffer which has just been sent (and which will be sent again after the
+  /// other DMA buffers). The callback is executed in the ISR so it must be
+  /// short and located in IRAM! Call before begin(). When active, the DMA
+  /// writeBytes() must not be used.
+  void setDMACallbackTX(void (*callback)(uint8_t *data, size_t len, void *ref),
+                        void *ref = nullptr) {
+    dma_callback_tx = callback;
+    dma_callback_ref_tx = ref;
+  }
+
+  /// The callback gets the DMA buffer which has just been filled with the
+  /// received data: it is executed in the ISR (see setDMACallbackTX()). When
+  /// active, readBytes() must not be used. For multi channel TDM you can use
+  /// TDMCapture::dmaCallback to split the slots.
+  void setDMACallbackRX(void (*callback)(const uint8_t *data, size_t len,
+                                         void *ref),
+                        void *ref = nullptr) {
+    dma_callback_rx = callback;
+    dma_callback_ref_rx = ref;
+  }
+
+  /// Latency in frames from the rendering in the TX DMA callback to the
+  /// output: (buffer_count - 1) * frames per DMA buffer
+  int dmaLatencyFrames() {
+    return (dma_desc_num - 1) * dma_frame_num;
+  }
+
   void setWaitTimeReadMs(TickType_t ms) {
     ticks_to_wait_read = pdMS_TO_TICKS(ms);
   }
@@ -133,6 +161,13 @@ class I2SDriverESP32V1 {
   i2s_chan_handle_t rx_chan = nullptr;  // I2S rx channel handler
   bool is_started = false;
   TickType_t ticks_to_wait_read = portMAX_DELAY;
+  void (*dma_callback_tx)(uint8_t *data, size_t len, void *ref) = nullptr;
+  void (*dma_callback_rx)(const uint8_t *data, size_t len,
+                          void *ref) = nullptr;
+  void *dma_callback_ref_tx = nullptr;
+  void *dma_callback_ref_rx = nullptr;
+  int dma_desc_num = 0;
+  int dma_frame_num = 0;
   TickType_t ticks_to_wait_write = portMAX_DELAY;
 
   struct DriverCommon {
@@ -374,20 +409,27 @@ class I2SDriverESP32V1 {
               },
       };
 
-      if (cfg.rx_tx_mode == TX_MODE) {
+      if (cfg.rx_tx_mode == RXTX_MODE || cfg.rx_tx_mode == TX_MODE) {
         if (i2s_channel_init_tdm_mode(tx_chan, &tdm_cfg) != ESP_OK) {
           LOGE("i2s_channel_init_tdm_tx_mode %s", "tx");
           return false;
         }
+        if (i2s_channel_enable(tx_chan) != ESP_OK) {
+          LOGE("i2s_channel_enable %s", "tx");
+          return false;
+        }
       }
-      if (cfg.rx_tx_mode == RX_MODE) {
+      if (cfg.rx_tx_mode == RXTX_MODE || cfg.rx_tx_mode == RX_MODE) {
         if (i2s_channel_init_tdm_mode(rx_chan, &tdm_cfg) != ESP_OK) {
           LOGE("i2s_channel_init_tdm_tx_mode %s", "rx");
           return false;
         }
-        return true;
+        if (i2s_channel_enable(rx_chan) != ESP_OK) {
+          LOGE("i2s_channel_enable %s", "rx");
+          return false;
+        }
       }
-      return false;
+      return true;
     }
   } tdm;
 
@@ -400,7 +442,9 @@ class I2SDriverESP32V1 {
     TRACED();
     cfg.logInfo();
     this->cfg = cfg;
-    if (cfg.channels <= 0 || cfg.channels > 2) {
+    // TDM supports up to 16 slots
+    int max_channels = cfg.signal_type == TDM ? 16 : 2;
+    if (cfg.channels <= 0 || cfg.channels > max_channels) {
       LOGE("invalid channels: %d", cfg.channels);
       return false;
     }
@@ -411,6 +455,12 @@ class I2SDriverESP32V1 {
       return false;
     }
 
+    // callbacks must be registered before the channels are enabled
+    if (!registerDMACallbacks()) {
+      end();
+      return false;
+    }
+
     is_started = driver.startChannels(cfg, tx_chan, rx_chan, txPin, rxPin);
     if (!is_started) {
       end();
@@ -421,6 +471,18 @@ class I2SDriverESP32V1 {
 
   bool newChannels(I2SConfigESP32V1 &cfg, DriverCommon &driver) {
     i2s_chan_config_t chan_cfg = driver.getChannelConfig(cfg);
+    // the config defines the DMA buffers
+    int frame_size = cfg.channels * (cfg.bits_per_sample == 24
+                                         ? 4
+                                         : cfg.bits_per_sample / 8);
+    chan_cfg.dma_desc_num = cfg.buffer_count;
+    chan_cfg.dma_frame_num = max(cfg.buffer_size / frame_size, 1);
+    if (isDMACallback()) {
+      // output silence if the producer did not render anything
+      chan_cfg.auto_clear = true;
+    }
+    dma_desc_num = chan_cfg.dma_desc_num;
+    dma_frame_num = chan_cfg.dma_frame_num;
     switch (cfg.rx_tx_mode) {
       case RX_MODE:
         if (i2s_new_channel(&chan_cfg, NULL, &rx_chan) != ESP_OK) {
@@ -443,6 +505,57 @@ class I2SDriverESP32V1 {
     return true;
   }
 
+  bool isDMACallback() {
+    return dma_callback_tx != nullptr || dma_callback_rx != nullptr;
+  }
+
+  bool registerDMACallbacks() {
+    if (tx_chan != nullptr && dma_callback_tx != nullptr) {
+      i2s_event_callbacks_t callbacks = {};
+      callbacks.on_sent = onSent;
+      if (i2s_channel_register_event_callback(tx_chan, &callbacks, this) !=
+          ESP_OK) {
+        LOGE("i2s_channel_register_event_callback %s", "tx");
+        return false;
+      }
+    }
+    if (rx_chan != nullptr && dma_callback_rx != nullptr) {
+      i2s_event_callbacks_t callbacks = {};
+      callbacks.on_recv = onReceived;
+      if (i2s_channel_register_event_callback(rx_chan, &callbacks, this) !=
+          ESP_OK) {
+        LOGE("i2s_channel_register_event_callback %s", "rx");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Provides the address of the DMA buffer from the event
+  static uint8_t *dmaBuffer(i2s_event_data_t *event) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0)
+    return (uint8_t *)event->dma_buf;
+#else
+    return *(uint8_t **)event->data;
+#endif
+  }
+
+  static bool IRAM_ATTR onSent(i2s_chan_handle_t handle,
+                               i2s_event_data_t *event, void *ref) {
+    I2SDriverESP32V1 *self = (I2SDriverESP32V1 *)ref;
+    self->dma_callback_tx(dmaBuffer(event), event->size,
+                          self->dma_callback_ref_tx);
+    return false;
+  }
+
+  static bool IRAM_ATTR onReceived(i2s_chan_handle_t handle,
+                                   i2s_event_data_t *event, void *ref) {
+    I2SDriverESP32V1 *self = (I2SDriverESP32V1 *)ref;
+    self->dma_callback_rx(dmaBuffer(event), event->size,
+                          self->dma_callback_ref_rx);
+    return false;
+  }
+
   DriverCommon &getDriver(I2SConfigESP32V1 &cfg) {
     switch (cfg.signal_type) {
       case Digital:
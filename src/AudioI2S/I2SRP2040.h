@@ -367,7 +367,9 @@ class I2SDriverRP2040 {
   }
 };
 
+#ifndef USE_I2S_RP2040_PIO
 using I2SDriver = I2SDriverRP2040;
+#endif
 
 }  // namespace audio_tools
 
@@ -0,0 +1,408 @@
+#pragma once
+
+#include "AudioI2S/I2SConfig.h"
+#if defined(RP2040_HOWER)
+#include "AudioBasic/Collections/Vector.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+
+/// Max number of DMA buffers of the I2SDriverRP2040PIO
+#ifndef I2S_PIO_MAX_BUFFER_COUNT
+#  define I2S_PIO_MAX_BUFFER_COUNT 16
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief I2S and TDM output for the RP2040 which uses its own PIO program and
+ * DMA chaining instead of the Arduino I2S class: a data DMA channel sends one
+ * buffer to the PIO and then triggers a control DMA channel which loads the
+ * address of the next buffer from a table and restarts the data channel. So
+ * the buffers are sent in a loop without any interrupt.
+ *
+ * - I2S (2 channels) and TDM (signal_type TDM, 1 to 8 slots) with 16 or 32
+ * bits per sample: the slot width is the sample width
+ * - buffer_count (2, 4, 8 or 16) and buffer_size (bytes) from the config
+ * - I2S_STD_FORMAT with the WS change one bit before the MSB or
+ * I2S_LEFT_JUSTIFIED_FORMAT. In TDM the frame sync is a pulse of one bit.
+ * - pin_ws must be pin_bck + 1
+ *
+ * The buffers which have been sent are released by poll() which determines
+ * the actual buffer from the read address of the data DMA channel. With
+ * setDMACallbackTX() we render the data directly into the released buffer
+ * (pull mode), otherwise writeBytes() fills the released buffers. Buffers
+ * which were not filled in time are cleared (see underflows()).
+ *
+ * poll() is called by writeBytes() when it waits for a buffer. For a
+ * dedicated core call setExternalPoll(true) and call poll() from loop1():
+ * @code
+ * void loop1() { i2s.driver()->poll(); }
+ * @endcode
+ * Activate it with USE_I2S_RP2040_PIO, so that it is used by the I2SStream.
+ * @ingroup platform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class I2SDriverRP2040PIO {
+  friend class I2SStream;
+
+ public:
+  ~I2SDriverRP2040PIO() { end(); }
+
+  /// Provides the default configuration
+  I2SConfigStd defaultConfig(RxTxMode mode) {
+    I2SConfigStd c(mode);
+    return c;
+  }
+
+  /// Updates the sample rate w/o restart if only the sample rate has changed
+  bool setAudioInfo(AudioInfo info) {
+    if (!is_active || info.channels != cfg.channels ||
+        info.bits_per_sample != cfg.bits_per_sample)
+      return false;
+    cfg.sample_rate = info.sample_rate;
+    pio_sm_set_clkdiv(pio, sm, clockDivider());
+    return true;
+  }
+
+  /// starts the output with the default config in TX Mode
+  bool begin(RxTxMode mode = TX_MODE) {
+    TRACED();
+    return begin(defaultConfig(mode));
+  }
+
+  /// starts the output
+  bool begin(I2SConfigStd cfg) {
+    TRACEI();
+    end();
+    this->cfg = cfg;
+    cfg.logInfo();
+    if (cfg.rx_tx_mode != TX_MODE) {
+      LOGE("Unsupported mode: only TX_MODE is supported");
+      return false;
+    }
+    if (cfg.bits_per_sample != 16 && cfg.bits_per_sample != 32) {
+      LOGE("Unsupported bits_per_sample: %d", cfg.bits_per_sample);
+      return false;
+    }
+    int max_channels = cfg.signal_type == TDM ? 8 : 2;
+    int min_channels = cfg.signal_type == TDM ? 1 : 2;
+    if (cfg.channels < min_channels || cfg.channels > max_channels) {
+      LOGE("Unsupported channels: '%d'", cfg.channels);
+      return false;
+    }
+    if (cfg.pin_ws != cfg.pin_bck + 1) {
+      LOGE("pin ws: '%d' must be pin bck: '%d' + 1", cfg.pin_ws, cfg.pin_bck);
+      return false;
+    }
+    if (!setupBuffers()) return false;
+    if (!setupPIO()) return false;
+    setupDMA();
+    // the control channel starts the data channel with the first buffer
+    dma_channel_start(dma_ctrl);
+    pio_sm_set_enabled(pio, sm, true);
+    is_active = true;
+    return true;
+  }
+
+  /// stops the output and releases the PIO and DMA resources
+  void end() {
+    if (!is_active) return;
+    TRACEI();
+    is_active = false;
+    pio_sm_set_enabled(pio, sm, false);
+    // prevent that the channels restart each other
+    channel_config_set_chain_to(&data_config, dma_data);
+    dma_channel_set_config(dma_data, &data_config, false);
+    dma_channel_abort(dma_ctrl);
+    dma_channel_abort(dma_data);
+    dma_channel_unclaim(dma_ctrl);
+    dma_channel_unclaim(dma_data);
+    pio_remove_program(pio, &program, program_offset);
+    pio_sm_unclaim(pio, sm);
+    buffers.reset();
+  }
+
+  /// provides the actual configuration
+  I2SConfigStd config() { return cfg; }
+
+  /// Pull mode: the callback renders the output data directly into the DMA
+  /// buffer which has just been sent (and which will be sent again after the
+  /// other DMA buffers). It is executed by poll(). When active, writeBytes()
+  /// must not be used.
+  void setDMACallbackTX(void (*callback)(uint8_t *data, size_t len, void *ref),
+                        void *ref = nullptr) {
+    dma_callback_tx = callback;
+    dma_callback_ref_tx = ref;
+  }
+
+  /// Latency in frames from the rendering in the TX DMA callback to the
+  /// output: (buffer_count - 1) * frames per DMA buffer
+  int dmaLatencyFrames() {
+    return (buffer_count - 1) * buffer_size / frameSize();
+  }
+
+  /// poll() is called from another core (e.g. loop1()), so writeBytes() only
+  /// waits for the released buffers
+  void setExternalPoll(bool flag) { is_external_poll = flag; }
+
+  /// Releases the buffers which have been sent since the last call: call it
+  /// at least once per buffer duration.
+  void poll() {
+    if (!is_active) return;
+    int actual = playingBuffer();
+    while (release_idx != actual) {
+      releaseBuffer(release_idx);
+      release_idx = (release_idx + 1) % buffer_count;
+    }
+  }
+
+  /// writes the data into the released DMA buffers: blocks until all data
+  /// has been written
+  size_t writeBytes(const void *src, size_t size_bytes) {
+    LOGD("writeBytes(%d)", size_bytes);
+    if (!is_active) return 0;
+    const uint8_t *p = (const uint8_t *)src;
+    size_t open = size_bytes;
+    while (open > 0) {
+      while (!isWritable(fill_idx)) {
+        if (!is_external_poll) poll();
+        tight_loop_contents();
+      }
+      size_t len = min(open, (size_t)(buffer_size - fill_pos));
+      memcpy(buffer(fill_idx) + fill_pos, p, len);
+      fill_pos += len;
+      p += len;
+      open -= len;
+      if (fill_pos == buffer_size) {
+        is_filled[fill_idx] = true;
+        fill_idx = (fill_idx + 1) % buffer_count;
+        fill_pos = 0;
+      }
+    }
+    return size_bytes;
+  }
+
+  size_t readBytes(void *dest, size_t size_bytes) {
+    LOGE("readBytes not supported");
+    return 0;
+  }
+
+  int availableForWrite() {
+    if (!is_active) return 0;
+    if (!is_external_poll) poll();
+    return isWritable(fill_idx) ? buffer_size - fill_pos : 0;
+  }
+
+  int available() { return 0; }
+
+  void flush() {}
+
+  /// Number of buffers which were sent w/o new data
+  uint32_t underflows() { return underflow_count; }
+
+ protected:
+  I2SConfigStd cfg;
+  PIO pio = pio0;
+  int sm = -1;
+  int dma_data = -1;
+  int dma_ctrl = -1;
+  uint program_offset = 0;
+  uint16_t instructions[8];
+  pio_program_t program;
+  dma_channel_config data_config;
+  Vector<uint8_t> buffers{0};
+  // the control channel reads the table with a ring, so it must be aligned
+  alignas(I2S_PIO_MAX_BUFFER_COUNT * sizeof(uint32_t))
+      const uint8_t *buffer_addresses[I2S_PIO_MAX_BUFFER_COUNT];
+  volatile bool is_filled[I2S_PIO_MAX_BUFFER_COUNT];
+  int buffer_count = 0;
+  int buffer_size = 0;
+  volatile int fill_idx = 0;
+  int fill_pos = 0;
+  int release_idx = 0;
+  volatile uint32_t underflow_count = 0;
+  bool is_active = false;
+  bool is_external_poll = false;
+  void (*dma_callback_tx)(uint8_t *data, size_t len, void *ref) = nullptr;
+  void *dma_callback_ref_tx = nullptr;
+
+  int frameSize() { return cfg.channels * cfg.bits_per_sample / 8; }
+
+  uint8_t *buffer(int idx) { return buffers.data() + idx * buffer_size; }
+
+  /// we can fill a buffer which has been released and is not sent
+  bool isWritable(int idx) {
+    return !is_filled[idx] && idx != playingBuffer();
+  }
+
+  /// Determines the buffer which is sent from the DMA read address
+  int playingBuffer() {
+    uint32_t addr = dma_hw->ch[dma_data].read_addr;
+    uint32_t offset = addr - (uint32_t)buffers.data();
+    return (offset / buffer_size) % buffer_count;
+  }
+
+  /// the buffer has been sent: the callback renders the next data, otherwise
+  /// we clear it if it has not been filled by writeBytes()
+  void releaseBuffer(int idx) {
+    if (dma_callback_tx != nullptr) {
+      dma_callback_tx(buffer(idx), buffer_size, dma_callback_ref_tx);
+      return;
+    }
+    if (is_filled[idx]) {
+      is_filled[idx] = false;
+    } else {
+      underflow_count++;
+      // don't clear the buffer which is partially written
+      if (idx != fill_idx) memset(buffer(idx), 0, buffer_size);
+    }
+  }
+
+  bool setupBuffers() {
+    // the address table is used as ring: the count must be a power of 2
+    buffer_count = 2;
+    while (buffer_count < cfg.buffer_count &&
+           buffer_count < I2S_PIO_MAX_BUFFER_COUNT)
+      buffer_count *= 2;
+    if (buffer_count != cfg.buffer_count) {
+      LOGW("buffer_count: %d -> %d", cfg.buffer_count, buffer_count);
+    }
+    buffer_size = cfg.buffer_size / frameSize() * frameSize();
+    if (buffer_size <= 0) {
+      LOGE("buffer_size too small: %d", cfg.buffer_size);
+      return false;
+    }
+    buffers.resize(buffer_count * buffer_size);
+    memset(buffers.data(), 0, buffers.size());
+    for (int j = 0; j < buffer_count; j++) {
+      buffer_addresses[j] = buffer(j);
+      is_filled[j] = false;
+    }
+    fill_idx = 1;
+    fill_pos = 0;
+    release_idx = 0;
+    underflow_count = 0;
+    // in pull mode we render all buffers which are not sent yet
+    if (dma_callback_tx != nullptr) {
+      for (int j = 1; j < buffer_count; j++) releaseBuffer(j);
+    }
+    return true;
+  }
+
+  /// PIO program with 2 instructions per bit: side set bit 0 is bck and bit
+  /// 1 is ws. y contains the number of bits per slot (I2S) or frame (TDM) - 2.
+  int setupProgram() {
+    bool is_tdm = cfg.signal_type == TDM;
+    auto side = [](int value) { return pio_encode_sideset(2, value); };
+    // first half: ws low
+    instructions[0] = pio_encode_out(pio_pins, 1) | side(0b00);
+    instructions[1] = pio_encode_jmp_x_dec(0) | side(0b01);
+    // last bit with ws high: this is the delay of one bit before the MSB
+    instructions[2] = pio_encode_out(pio_pins, 1) | side(0b10);
+    instructions[3] = pio_encode_mov(pio_x, pio_y) | side(0b11);
+    program.length = 4;
+    if (!is_tdm) {
+      // second half: ws high
+      instructions[4] = pio_encode_out(pio_pins, 1) | side(0b10);
+      instructions[5] = pio_encode_jmp_x_dec(4) | side(0b11);
+      instructions[6] = pio_encode_out(pio_pins, 1) | side(0b00);
+      instructions[7] = pio_encode_mov(pio_x, pio_y) | side(0b01);
+      program.length = 8;
+    }
+    program.instructions = instructions;
+    program.origin = -1;
+    // with the left justified format we start with the bit at the ws change
+    bool is_delayed = cfg.i2s_format != I2S_LEFT_JUSTIFIED_FORMAT &&
+                      cfg.i2s_format != I2S_MSB_FORMAT;
+    int entry = program.length - (is_delayed ? 1 : 2);
+    return entry;
+  }
+
+  bool setupPIO() {
+    int entry = setupProgram();
+    pio = pio0;
+    if (!pio_can_add_program(pio, &program)) pio = pio1;
+    if (!pio_can_add_program(pio, &program)) {
+      LOGE("No space for the PIO program");
+      return false;
+    }
+    sm = pio_claim_unused_sm(pio, false);
+    if (sm < 0) {
+      LOGE("No PIO state machine available");
+      return false;
+    }
+    program_offset = pio_add_program(pio, &program);
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, program_offset, program_offset + program.length - 1);
+    sm_config_set_sideset(&c, 2, false, false);
+    sm_config_set_out_pins(&c, cfg.pin_data, 1);
+    sm_config_set_sideset_pins(&c, cfg.pin_bck);
+    // MSB first with autopull of one sample
+    sm_config_set_out_shift(&c, false, true, cfg.bits_per_sample);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv(&c, clockDivider());
+    pio_gpio_init(pio, cfg.pin_data);
+    pio_gpio_init(pio, cfg.pin_bck);
+    pio_gpio_init(pio, cfg.pin_ws);
+    pio_sm_set_consecutive_pindirs(pio, sm, cfg.pin_data, 1, true);
+    pio_sm_set_consecutive_pindirs(pio, sm, cfg.pin_bck, 2, true);
+    pio_sm_init(pio, sm, program_offset + entry, &c);
+
+    // load the bit counter into y
+    int bits = cfg.bits_per_sample * (cfg.signal_type == TDM ? cfg.channels : 1);
+    pio_sm_put_blocking(pio, sm, bits - 2);
+    pio_sm_exec(pio, sm, pio_encode_pull(false, true) | pio_encode_sideset(2, 0));
+    pio_sm_exec(pio, sm, pio_encode_out(pio_y, 32) | pio_encode_sideset(2, 0));
+    return true;
+  }
+
+  void setupDMA() {
+    dma_data = dma_claim_unused_channel(true);
+    dma_ctrl = dma_claim_unused_channel(true);
+
+    // data channel: one buffer to the PIO, then the control channel
+    data_config = dma_channel_get_default_config(dma_data);
+    channel_config_set_transfer_data_size(
+        &data_config, cfg.bits_per_sample == 16 ? DMA_SIZE_16 : DMA_SIZE_32);
+    channel_config_set_read_increment(&data_config, true);
+    channel_config_set_write_increment(&data_config, false);
+    channel_config_set_dreq(&data_config, pio_get_dreq(pio, sm, true));
+    channel_config_set_chain_to(&data_config, dma_ctrl);
+    dma_channel_configure(dma_data, &data_config, &pio->txf[sm], nullptr,
+                          buffer_size / (cfg.bits_per_sample / 8), false);
+
+    // control channel: next address from the table which restarts the data
+    // channel
+    dma_channel_config c = dma_channel_get_default_config(dma_ctrl);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, log2(buffer_count * sizeof(uint32_t)));
+    dma_channel_configure(dma_ctrl, &c,
+                          &dma_hw->ch[dma_data].al3_read_addr_trig,
+                          buffer_addresses, 1, false);
+  }
+
+  /// 2 PIO cycles per bit
+  float clockDivider() {
+    float bit_rate = 2.0f * cfg.sample_rate * cfg.channels * cfg.bits_per_sample;
+    return (float)clock_get_hz(clk_sys) / bit_rate;
+  }
+
+  static int log2(int value) {
+    int result = 0;
+    while ((1 << result) < value) result++;
+    return result;
+  }
+};
+
+#ifdef USE_I2S_RP2040_PIO
+using I2SDriver = I2SDriverRP2040PIO;
+#endif
+
+}  // namespace audio_tools
+
+#endif
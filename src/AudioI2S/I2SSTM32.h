@@ -120,6 +120,16 @@ class I2SDriverSTM32 {
   /// https://github.com/pschatzmann/stm32f411-i2s
   static void writeFromReceive(uint8_t *buffer, uint16_t byteCount, void *ref) {
     I2SDriverSTM32 *self = (I2SDriverSTM32 *)ref;
+    self->dma_half_bytes = byteCount;
+    if (self->dma_callback_rxtx != nullptr) {
+      self->p_dma_rx_half = buffer;
+      self->processDuplex();
+      return;
+    }
+    if (self->dma_callback_rx != nullptr) {
+      self->dma_callback_rx(buffer, byteCount, self->dma_callback_ref);
+      return;
+    }
     uint16_t written = 0;
     if (self->p_dma_out != nullptr)
       written = self->p_dma_out->write(buffer, byteCount);
@@ -136,6 +146,16 @@ class I2SDriverSTM32 {
   /// https://github.com/pschatzmann/stm32f411-i2s
   static void readToTransmit(uint8_t *buffer, uint16_t byteCount, void *ref) {
     I2SDriverSTM32 *self = (I2SDriverSTM32 *)ref;
+    self->dma_half_bytes = byteCount;
+    if (self->dma_callback_rxtx != nullptr) {
+      self->p_dma_tx_half = buffer;
+      self->processDuplex();
+      return;
+    }
+    if (self->dma_callback_tx != nullptr) {
+      self->dma_callback_tx(buffer, byteCount, self->dma_callback_ref);
+      return;
+    }
     static size_t count = 0;
     size_t read = 0;
     if (self->p_dma_in != nullptr) {
@@ -182,6 +202,49 @@ class I2SDriverSTM32 {
     p_dma_out = &out;
   }
 
+  /// Zero copy output: the callback fills the half of the DMA buffer which
+  /// has just been sent. It is executed in the half/full complete interrupt,
+  /// so it must be short. When active, writeBytes() must not be used.
+  void setDMACallbackTX(void (*callback)(uint8_t *data, size_t len, void *ref),
+                        void *ref = nullptr) {
+    use_dma = true;
+    dma_callback_tx = callback;
+    dma_callback_ref = ref;
+  }
+
+  /// Zero copy input: the callback gets the half of the DMA buffer which has
+  /// just been received (see setDMACallbackTX()). When active, readBytes()
+  /// must not be used.
+  void setDMACallbackRX(void (*callback)(const uint8_t *data, size_t len,
+                                         void *ref),
+                        void *ref = nullptr) {
+    use_dma = true;
+    dma_callback_rx = callback;
+    dma_callback_ref = ref;
+  }
+
+  /// Full duplex (RXTX_MODE): the callback gets the received half and the
+  /// transmit half of the same DMA event, so that it can process the input
+  /// directly into the output. Both directions use the same clock, so the
+  /// output is delayed by exactly one half of the DMA buffer (see
+  /// dmaLatencyFrames()).
+  void setDMACallbackRXTX(void (*callback)(const uint8_t *rx, uint8_t *tx,
+                                           size_t len, void *ref),
+                          void *ref = nullptr) {
+    use_dma = true;
+    dma_callback_rxtx = callback;
+    dma_callback_ref = ref;
+  }
+
+  /// Latency in frames from the DMA callback to the output: one half of the
+  /// DMA buffer. The size is known after the first callback.
+  int dmaLatencyFrames() {
+    return dma_half_bytes / (cfg.channels * cfg.bits_per_sample / 8);
+  }
+
+  /// Number of processed DMA half buffers in full duplex mode
+  uint32_t dmaHalfCount() { return dma_half_count; }
+
  protected:
   stm32_i2s::Stm32I2sClass i2s;
   stm32_i2s::I2SSettingsSTM32 i2s_stm32;
@@ -195,6 +258,35 @@ class I2SDriverSTM32 {
   Print *p_dma_out = nullptr;
   Stream *p_dma_in = nullptr;
   uint32_t last_write_ms = 0;
+  void (*dma_callback_tx)(uint8_t *data, size_t len, void *ref) = nullptr;
+  void (*dma_callback_rx)(const uint8_t *data, size_t len,
+                          void *ref) = nullptr;
+  void (*dma_callback_rxtx)(const uint8_t *rx, uint8_t *tx, size_t len,
+                            void *ref) = nullptr;
+  void *dma_callback_ref = nullptr;
+  uint8_t *volatile p_dma_rx_half = nullptr;
+  uint8_t *volatile p_dma_tx_half = nullptr;
+  volatile uint16_t dma_half_bytes = 0;
+  volatile uint32_t dma_half_count = 0;
+
+  bool isRxCallback() {
+    return dma_callback_rx != nullptr || dma_callback_rxtx != nullptr;
+  }
+
+  bool isTxCallback() {
+    return dma_callback_tx != nullptr || dma_callback_rxtx != nullptr;
+  }
+
+  /// The rx and tx callbacks of a DMA event can arrive in any order: we
+  /// call the duplex callback when we have both halves
+  void processDuplex() {
+    if (p_dma_rx_half == nullptr || p_dma_tx_half == nullptr) return;
+    dma_callback_rxtx(p_dma_rx_half, p_dma_tx_half, dma_half_bytes,
+                      dma_callback_ref);
+    p_dma_rx_half = nullptr;
+    p_dma_tx_half = nullptr;
+    dma_half_count++;
+  }
 
   size_t writeBytesDMA(const void *src, size_t size_bytes) {
     size_t result = 0;
@@ -252,15 +344,22 @@ class I2SDriverSTM32 {
   }
 
   bool startI2SDMA() {
+    p_dma_rx_half = nullptr;
+    p_dma_tx_half = nullptr;
+    dma_half_count = 0;
+    if (dma_callback_rxtx != nullptr && cfg.rx_tx_mode != RXTX_MODE) {
+      LOGE("The duplex callback needs RXTX_MODE");
+      return false;
+    }
     switch (cfg.rx_tx_mode) {
       case RX_MODE:
-        if (use_dma && p_rx_buffer == nullptr)
+        if (use_dma && p_rx_buffer == nullptr && !isRxCallback())
           p_rx_buffer = allocateBuffer();
         result = i2s.beginReadDMA(i2s_stm32, writeFromReceive);
         break;
       case TX_MODE:
         stm32_write_active = false;
-        if (use_dma && p_tx_buffer == nullptr)
+        if (use_dma && p_tx_buffer == nullptr && !isTxCallback())
           p_tx_buffer = allocateBuffer();
         result = i2s.beginWriteDMA(i2s_stm32, readToTransmit);
         break;
@@ -268,9 +367,10 @@ class I2SDriverSTM32 {
       case RXTX_MODE:
         if (use_dma) {
           stm32_write_active = false;
-          if (p_rx_buffer == nullptr)
+          // the callbacks work directly on the DMA buffer
+          if (p_rx_buffer == nullptr && !isRxCallback())
             p_rx_buffer = allocateBuffer();
-          if (p_tx_buffer == nullptr)
+          if (p_tx_buffer == nullptr && !isTxCallback())
             p_tx_buffer = allocateBuffer();
         }
         result = i2s.beginReadWriteDMA(
@@ -328,7 +428,7 @@ class I2SDriverSTM32 {
         case TX_MODE:
           return I2S_MODE_MASTER_TX;
         default:
-          LOGE("RXTX_MODE not supported");
+          // full duplex: the I2S extension receives with the same clock
           return I2S_MODE_MASTER_TX;
       }
     } else {
@@ -338,7 +438,7 @@ class I2SDriverSTM32 {
         case TX_MODE:
           return I2S_MODE_SLAVE_TX;
         default:
-          LOGE("RXTX_MODE not supported");
+          // full duplex: the I2S extension receives with the same clock
           return I2S_MODE_SLAVE_TX;
       }
     }
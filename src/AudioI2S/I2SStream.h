@@ -12,6 +12,7 @@
 #include "AudioI2S/I2SNanoSenseBLE.h"
 #include "AudioI2S/I2SRP2040-MBED.h"
 #include "AudioI2S/I2SRP2040.h"
+#include "AudioI2S/I2SRP2040PIO.h"
 #include "AudioI2S/I2SSAMD.h"
 #include "AudioI2S/I2SSTM32.h"
 #include "AudioTools/AudioStreams.h"
@@ -132,11 +133,74 @@ class I2SStream : public AudioStream {
   /// Provides access to the driver
   I2SDriver *driver() { return &i2s; }
 
+  /// Latency in ms which is caused by the DMA buffers (buffer_count *
+  /// buffer_size) of the actual configuration
+  uint32_t latencyMs() {
+    I2SConfig cfg = i2s.config();
+    if (cfg.sample_rate == 0) return 0;
+    return (uint64_t)cfg.buffer_count * bufferFrames(cfg) * 1000 /
+           cfg.sample_rate;
+  }
+
+  /// Defines the buffer_size (and if necessary the buffer_count) of the
+  /// config from the target latency in ms: call after defining the
+  /// sample_rate, channels and bits_per_sample.
+  static void setLatencyMs(I2SConfig &cfg, uint32_t ms) {
+    int count = max(cfg.buffer_count, 2);
+    int frames = (uint64_t)ms * cfg.sample_rate / 1000;
+    int frames_per_buffer = max((frames + count - 1) / count, 8);
+    // respect the max DMA buffer size by adding buffers
+    int max_frames = maxBufferFrames(cfg);
+    if (frames_per_buffer > max_frames) {
+      count = (frames + max_frames - 1) / max_frames;
+      frames_per_buffer = (frames + count - 1) / count;
+    }
+    cfg.buffer_count = count;
+    cfg.buffer_size = frames_per_buffer * bufferFrameUnits(cfg);
+    LOGI("latency %d ms: buffer_count: %d, buffer_size: %d", (int)ms,
+         cfg.buffer_count, cfg.buffer_size);
+  }
+
  protected:
   I2SDriver i2s;
   int mute_pin;
   bool is_active = false;
 
+  /// Bytes of a frame in the DMA buffer
+  static int frameBytes(I2SConfig &cfg) {
+    int sample_bytes = cfg.bits_per_sample == 24 ? 4 : cfg.bits_per_sample / 8;
+    return max(cfg.channels * sample_bytes, 1);
+  }
+
+  /// Units of buffer_size per frame: the ESP32 (with the legacy API) defines
+  /// the buffer_size in frames, the RP2040 in 32 bit words and all other
+  /// platforms in bytes.
+  static int bufferFrameUnits(I2SConfig &cfg) {
+#if defined(ESP32) && ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+    return 1;
+#elif defined(RP2040_HOWER)
+    return max(frameBytes(cfg) / 4, 1);
+#else
+    return frameBytes(cfg);
+#endif
+  }
+
+  /// Number of frames in one DMA buffer
+  static int bufferFrames(I2SConfig &cfg) {
+    return cfg.buffer_size / bufferFrameUnits(cfg);
+  }
+
+  /// Max number of frames in one DMA buffer
+  static int maxBufferFrames(I2SConfig &cfg) {
+#if defined(ESP32) && ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+    return 1024;
+#elif defined(ESP32)
+    return 4092 / frameBytes(cfg);
+#else
+    return 4096;
+#endif
+  }
+
   /// set mute pin on or off
   void mute(bool is_mute) {
 #ifdef ARDUINO
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "AudioTools/AudioKernels.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "Concurrency/RingBufferLockFree.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Multi channel TDM capture: the interleaved slots of each received
+ * DMA buffer are split directly into one lock free ring buffer per slot, so
+ * that e.g. a microphone array does not need an additional copy and
+ * channel split pass. 32 bit slots can be truncated to 16 bit samples in the
+ * same pass (T = int16_t). Each slot is filled independently: if the ring
+ * buffer of a slot is full, the new samples of this slot are dropped.
+ *
+ * Register the capture as DMA callback of the I2S driver before it is
+ * started:
+ * @code
+ * TDMCapture<int16_t> capture;
+ * capture.begin(8, 32, 1024);
+ * i2s.driver()->setDMACallbackRX(TDMCapture<int16_t>::dmaCallback, &capture);
+ * @endcode
+ * The callback is executed in the ISR: read the slots with readSlot() or
+ * readFrames() from one task.
+ * @ingroup io
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T sample type of the ring buffers
+ */
+template <typename T = int16_t>
+class TDMCapture {
+ public:
+  TDMCapture() = default;
+  ~TDMCapture() { end(); }
+
+  /// Defines the number of slots, the bits per sample of the DMA data (16 or
+  /// 32) and the size of each ring buffer in samples
+  bool begin(int slots, int bitsPerSample, int bufferSamples) {
+    end();
+    if (slots <= 0 || (bitsPerSample != 16 && bitsPerSample != 32) ||
+        bitsPerSample < (int)sizeof(T) * 8) {
+      LOGE("Unsupported slots: %d or bits_per_sample: %d", slots,
+           bitsPerSample);
+      return false;
+    }
+    slot_count = slots;
+    bits_per_sample = bitsPerSample;
+    for (int j = 0; j < slots; j++) {
+      buffers.push_back(new RingBufferLockFree<T>(bufferSamples));
+    }
+    dropped_samples = 0;
+    return true;
+  }
+
+  /// Releases the ring buffers
+  void end() {
+    for (auto p_buffer : buffers) delete p_buffer;
+    buffers.clear();
+    slot_count = 0;
+  }
+
+  /// Callback for the I2S driver: ref is the TDMCapture
+  static void dmaCallback(const uint8_t *data, size_t len, void *ref) {
+    ((TDMCapture<T> *)ref)->writeDMA(data, len);
+  }
+
+  /// Splits the interleaved DMA data into the ring buffers of the slots:
+  /// returns the number of frames
+  size_t writeDMA(const uint8_t *data, size_t len) {
+    if (slot_count == 0) return 0;
+    size_t frames = len / (slot_count * bits_per_sample / 8);
+    for (int ch = 0; ch < slot_count; ch++) {
+      if (bits_per_sample == 16) {
+        writeSlot(ch, (const int16_t *)data + ch, frames);
+      } else {
+        writeSlot(ch, (const int32_t *)data + ch, frames);
+      }
+    }
+    return frames;
+  }
+
+  /// Number of slots
+  int slots() { return slot_count; }
+
+  /// Number of samples which are available for the indicated slot
+  int available(int slot) { return buffers[slot]->available(); }
+
+  /// Number of frames which are available in all slots
+  int available() {
+    int result = slot_count > 0 ? buffers[0]->available() : 0;
+    for (int j = 1; j < slot_count; j++)
+      result = min(result, buffers[j]->available());
+    return result;
+  }
+
+  /// Reads the samples of the indicated slot
+  int readSlot(int slot, T *to, int samples) {
+    return buffers[slot]->readArray(to, samples);
+  }
+
+  /// Reads the same number of frames from all slots into one array per slot
+  int readFrames(T *const *to, int frames) {
+    int result = min(frames, available());
+    for (int j = 0; j < slot_count; j++) buffers[j]->readArray(to[j], result);
+    return result;
+  }
+
+  /// Provides the ring buffer of the indicated slot
+  RingBufferLockFree<T> &slot(int slot) { return *buffers[slot]; }
+
+  /// Number of samples which were dropped because a ring buffer was full
+  uint32_t droppedSamples() { return dropped_samples; }
+
+ protected:
+  Vector<RingBufferLockFree<T> *> buffers{0};
+  int slot_count = 0;
+  int bits_per_sample = 16;
+  volatile uint32_t dropped_samples = 0;
+
+  /// writes the samples of one slot in at most 2 contiguous segments
+  template <typename TIn>
+  void writeSlot(int ch, const TIn *from, size_t frames) {
+    RingBufferLockFree<T> &buffer = *buffers[ch];
+    size_t open = frames;
+    while (open > 0) {
+      size_t n = min(open, (size_t)buffer.writePtrSize());
+      if (n == 0) break;
+      AudioKernels::extractChannel(from, buffer.writePtr(), n, slot_count);
+      buffer.commitWrite(n);
+      from += n * slot_count;
+      open -= n;
+    }
+    dropped_samples += open;
+  }
+};
+
+}  // namespace audio_tools
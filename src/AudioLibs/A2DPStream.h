@@ -13,15 +13,15 @@
 #include "BluetoothA2DPSink.h"
 #include "BluetoothA2DPSource.h"
 #include "AudioTools/AudioStreams.h"
-#include "Concurrency/BufferRTOS.h"
+#include "Concurrency/RingBufferLockFree.h"
 
 
 namespace audio_tools {
 
 class A2DPStream;
 static A2DPStream *A2DPStream_self=nullptr;
-// buffer which is used to exchange data
-static BufferRTOS<uint8_t>a2dp_buffer{0, A2DP_BUFFER_SIZE, portMAX_DELAY, portMAX_DELAY};
+// lock free buffer which is used to exchange data with the a2dp callback
+static RingBufferLockFree<uint8_t> a2dp_buffer{0};
 // flag to indicated that we are ready to process data
 static bool is_a2dp_active = false;
 
@@ -53,6 +53,35 @@ class A2DPConfig {
         int delay_ms = 1;
         /// when a2dp source is active but has no data we generate silence data
         bool silence_on_nodata = false;
+        /// Adaptive latency (TX_MODE): the target buffer fill is derived from
+        /// the measured callback intervals instead of the buffer size
+        bool is_adaptive = false;
+        /// Adaptive: the target fill covers this many max callback intervals
+        float adaptive_factor = 3.0f;
+        /// Adaptive: min target fill in ms
+        int adaptive_min_ms = 50;
+        /// Adaptive: additional fill in ms which is added for each underrun
+        int adaptive_underrun_ms = 20;
+};
+
+/**
+ * @brief Statistics of the data exchange with the a2dp callback
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct A2DPStatistics {
+    /// Number of callbacks which could not be served with the requested data
+    uint32_t underrun_count = 0;
+    /// Number of missing bytes
+    uint32_t underrun_bytes = 0;
+    /// Average interval between the callbacks in us
+    uint32_t callback_interval_us = 0;
+    /// Max interval between the callbacks (slowly decaying) in us
+    uint32_t callback_interval_max_us = 0;
+    /// Target buffer fill in bytes
+    uint32_t target_fill = 0;
+    /// Actual buffer fill in bytes
+    uint32_t available = 0;
 };
 
 
@@ -65,6 +94,9 @@ class A2DPConfig {
  * however this is rather inefficient, beause quite a bit buffer needs to be allocated.
  * It is recommended to use the API with the callbacks. Examples can be found in the examples-basic-api
  * directory.
+ * In TX_MODE you can activate is_adaptive in the A2DPConfig: the buffer fill is then kept
+ * close to a target which is derived from the measured callback intervals and which is increased
+ * on underruns. The statistics() provide the underruns and callback timing.
  * 
  * Requires: https://github.com/pschatzmann/ESP32-A2DP
  *
@@ -133,6 +165,7 @@ class A2DPStream : public AudioStream, public VolumeSupport {
             bool result = false;
             LOGI("Connecting to %s",cfg.name);
             a2dp_buffer.resize(cfg.buffer_size);
+            resetStatistics();
 
             // initialize a2dp_silence_timeout
             if (config.silence_on_nodata){
@@ -215,19 +248,25 @@ class A2DPStream : public AudioStream, public VolumeSupport {
         size_t write(const uint8_t* data, size_t len) override {   
             LOGD("%s: %zu", LOG_METHOD, len);
             if (config.mode == TX_MODE){
-                // at 80% we activate the processing
+                // at 80% (or the adaptive target) we activate the processing
                 if(!is_a2dp_active 
                 && config.startup_logic == StartWhenBufferFull
-                && a2dp_buffer.available() >= 0.8f * a2dp_buffer.size()){
+                && a2dp_buffer.available() >= startFill()){
                     LOGI("set active");
                     is_a2dp_active = true;
                 }
 
                 // blocking write: if buffer is full we wait
-                while(len > 0.9f * a2dp_buffer.availableForWrite() * 100 / 90){
+                while(len > a2dp_buffer.availableForWrite()){
                     LOGD("Waiting for buffer to be available");
                     delay(5);
                 }
+
+                // adaptive: we keep the fill close to the target
+                while(config.is_adaptive && is_a2dp_active
+                && a2dp_buffer.available() >= (int)target_fill.load()){
+                    delay(1);
+                }
             }
 
             // write to buffer
@@ -265,6 +304,29 @@ class A2DPStream : public AudioStream, public VolumeSupport {
             return a2dp_buffer.availableForWrite();
         }
 
+        /// Provides the underrun and callback timing statistics
+        A2DPStatistics statistics() {
+            A2DPStatistics result;
+            result.underrun_count = underrun_count.load();
+            result.underrun_bytes = underrun_bytes.load();
+            result.callback_interval_us = interval_avg_us.load();
+            result.callback_interval_max_us = interval_max_us.load();
+            result.target_fill = target_fill.load();
+            result.available = a2dp_buffer.available();
+            return result;
+        }
+
+        /// Resets the statistics and the adaptive target
+        void resetStatistics() {
+            underrun_count = 0;
+            underrun_bytes = 0;
+            interval_avg_us = 0;
+            interval_max_us = 0;
+            underrun_boost_ms = 0;
+            last_callback_us = 0;
+            target_fill = msToBytes(config.adaptive_min_ms);
+        }
+
         // Define the volme (values between 0.0 and 1.0)
         bool setVolume(float volume) override {
             VolumeSupport::setVolume(volume);
@@ -279,6 +341,61 @@ class A2DPStream : public AudioStream, public VolumeSupport {
         BluetoothA2DPSink *a2dp_sink = nullptr;
         BluetoothA2DPCommon *a2dp=nullptr;
         const int A2DP_MAX_VOL = 128;
+        // statistics: updated by the a2dp callback
+        std::atomic<uint32_t> underrun_count{0};
+        std::atomic<uint32_t> underrun_bytes{0};
+        std::atomic<uint32_t> interval_avg_us{0};
+        std::atomic<uint32_t> interval_max_us{0};
+        std::atomic<uint32_t> target_fill{0};
+        uint32_t underrun_boost_ms = 0;
+        uint32_t last_callback_us = 0;
+
+        /// Converts a duration in ms to bytes (int16_t, 2 channels)
+        uint32_t msToBytes(uint32_t ms) {
+            return (uint64_t)ms * info.sample_rate / 1000 * 4;
+        }
+
+        /// Buffer fill at which we start the processing
+        int startFill() {
+            if (config.is_adaptive) return target_fill.load();
+            return 0.8f * a2dp_buffer.size();
+        }
+
+        /// Measures the callback interval and determines the target fill
+        void updateTiming(int32_t len) {
+            uint32_t now = micros();
+            if (last_callback_us != 0) {
+                uint32_t interval = now - last_callback_us;
+                uint32_t avg = interval_avg_us.load();
+                avg = avg == 0 ? interval : (avg * 7 + interval) / 8;
+                interval_avg_us = avg;
+                // peak with a slow decay
+                uint32_t max = interval_max_us.load();
+                max = interval > max ? interval : max - max / 64;
+                interval_max_us = max;
+                if (config.is_adaptive) {
+                    uint32_t ms = config.adaptive_factor * max / 1000
+                                  + underrun_boost_ms;
+                    if (ms < (uint32_t)config.adaptive_min_ms) ms = config.adaptive_min_ms;
+                    uint32_t fill = msToBytes(ms);
+                    // we need to be able to provide at least one callback
+                    if (fill < (uint32_t)len) fill = len;
+                    uint32_t limit = 0.9f * a2dp_buffer.size();
+                    if (fill > limit) fill = limit;
+                    target_fill = fill;
+                }
+            }
+            last_callback_us = now;
+        }
+
+        /// Records the missing data of a callback
+        void updateUnderrun(int32_t missing) {
+            underrun_count++;
+            underrun_bytes += missing;
+            if (config.is_adaptive) {
+                underrun_boost_ms += config.adaptive_underrun_ms;
+            }
+        }
 
         // auto-detect device to send audio to (TX-Mode)
         static bool detected_device(const char* ssid, esp_bd_addr_t address, int rssi){
@@ -300,17 +417,20 @@ class A2DPStream : public AudioStream, public VolumeSupport {
         // callback used by A2DP to provide the a2dp_source sound data
         static int32_t a2dp_stream_source_sound_data(uint8_t* data, int32_t len) {
             int32_t result_len = 0;
-            A2DPConfig config = A2DPStream_self->config;
+            A2DPConfig &config = A2DPStream_self->config;
+            A2DPStream_self->updateTiming(len);
 
             // at first call we start with some empty data
             if (is_a2dp_active){
                 // the data in the file must be in int16 with 2 channels 
-                yield();
                 result_len = a2dp_buffer.readArray((uint8_t*)data, len);
+                if (result_len < len) {
+                    A2DPStream_self->updateUnderrun(len - result_len);
+                }
 
                 // provide silence data
-                if (config.silence_on_nodata && result_len == 0){
-                    memset(data,0, len);
+                if (config.silence_on_nodata && result_len < len){
+                    memset(data + result_len, 0, len - result_len);
                     result_len = len;
                 }
             } else {
@@ -22,7 +22,14 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 // potentially receive multiple streams concurrently).
 //
 
+#include <atomic>
+
 #include "Print.h" // Arduino Print
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#ifdef USE_CONCURRENCY
+#  include "Concurrency/Task.h"
+#endif
 // include live555
 #include "BasicUsageEnvironment.hh"
 //#include "liveMedia.hh"
@@ -44,6 +51,145 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 #undef DEBUG_PRINT_EACH_RECEIVED_FRAME
 #define DEBUG_PRINT_EACH_RECEIVED_FRAME 0
 
+// Number of RTP frames in the receive queue
+#ifndef RTSP_QUEUE_FRAMES
+#  define RTSP_QUEUE_FRAMES 16
+#endif
+
+// Buffered time before we start to output the received frames
+#ifndef RTSP_TARGET_LATENCY_MS
+#  define RTSP_TARGET_LATENCY_MS 60
+#endif
+
+#ifndef RTSP_OUTPUT_TASK_STACK_SIZE
+#  define RTSP_OUTPUT_TASK_STACK_SIZE 4096
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Preallocated receive queue for whole RTP frames: live555 receives
+ * the data directly into the free slots, so the event loop never needs to
+ * wait for the output. The frames are provided in the order of their RTP
+ * sequence numbers (live555 reorders the packets) and gaps in the sequence
+ * numbers are counted as lost frames. The output starts when the buffered
+ * frames cover the target latency. One producer (the event loop) and one
+ * consumer (the output task) are supported w/o locking.
+ * @ingroup communications
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class RTSPFrameQueue {
+ public:
+  /// Allocates frameCount frames of frameSize bytes
+  bool begin(int frameSize, int frameCount, int targetLatencyMs) {
+    frame_size = frameSize;
+    frame_count = frameCount;
+    target_latency_ms = targetLatencyMs;
+    memory.resize(frame_size * frame_count);
+    frames.resize(frame_count);
+    write_count = 0;
+    read_count = 0;
+    lost_frames = 0;
+    overflow_frames = 0;
+    is_buffering = true;
+    is_first = true;
+    return memory.size() == frame_size * frame_count;
+  }
+
+  /// Producer: provides the slot for the next frame: nullptr if full
+  uint8_t *writeBuffer() {
+    uint32_t count = write_count.load(std::memory_order_relaxed);
+    if (count - read_count.load(std::memory_order_acquire) >=
+        (uint32_t)frame_count)
+      return nullptr;
+    return slot(count);
+  }
+
+  /// Producer: makes the frame in the writeBuffer() available
+  void commit(size_t len, uint16_t seq, uint32_t timeMs) {
+    // loss detection
+    if (!is_first) {
+      uint16_t expected = last_seq + 1;
+      lost_frames += (uint16_t)(seq - expected);
+    }
+    is_first = false;
+    last_seq = seq;
+    uint32_t count = write_count.load(std::memory_order_relaxed);
+    Frame &frame = frames[count % frame_count];
+    frame.len = len;
+    frame.seq = seq;
+    frame.time_ms = timeMs;
+    write_count.store(count + 1, std::memory_order_release);
+  }
+
+  /// Producer: a frame could not be stored because the queue was full
+  void addOverflow() { overflow_frames++; }
+
+  /// Consumer: writes the next frame to the output: returns false if there
+  /// is nothing to write
+  bool writeTo(Print &out) {
+    uint32_t count = read_count.load(std::memory_order_relaxed);
+    int n = write_count.load(std::memory_order_acquire) - count;
+    if (n == 0) {
+      // underflow: wait until we have the target latency again
+      is_buffering = true;
+      return false;
+    }
+    if (is_buffering) {
+      Frame &last = frames[(count + n - 1) % frame_count];
+      bool full = n >= frame_count;
+      if (!full && last.time_ms - frames[count % frame_count].time_ms <
+                       (uint32_t)target_latency_ms)
+        return false;
+      is_buffering = false;
+    }
+    Frame &frame = frames[count % frame_count];
+    out.write(slot(count), frame.len);
+    read_count.store(count + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Number of frames in the queue
+  int available() {
+    return write_count.load(std::memory_order_acquire) -
+           read_count.load(std::memory_order_relaxed);
+  }
+
+  /// Number of frames which were lost in the network
+  uint32_t lostFrames() { return lost_frames; }
+
+  /// Number of frames which were dropped because the queue was full
+  uint32_t overflowFrames() { return overflow_frames; }
+
+  int frameSize() { return frame_size; }
+
+ protected:
+  struct Frame {
+    size_t len = 0;
+    uint16_t seq = 0;
+    uint32_t time_ms = 0;
+  };
+  Vector<uint8_t> memory{0};
+  Vector<Frame> frames{0};
+  int frame_size = 0;
+  int frame_count = 0;
+  int target_latency_ms = 0;
+  std::atomic<uint32_t> write_count{0};
+  std::atomic<uint32_t> read_count{0};
+  uint16_t last_seq = 0;
+  bool is_first = true;
+  bool is_buffering = true;
+  uint32_t lost_frames = 0;
+  uint32_t overflow_frames = 0;
+
+  uint8_t *slot(uint32_t count) {
+    return memory.data() + (count % frame_count) * frame_size;
+  }
+};
+
+}  // namespace audio_tools
+
 /// @brief AudioTools internal: rtsp
 namespace audiotools_rtsp {
 
@@ -56,6 +202,7 @@ static char rtspEventLoopWatchVariable = 0;
 static Print* rtspOutput = nullptr;
 static uint32_t rtspSinkReceiveBufferSize = 0;
 static bool rtspUseTCP = REQUEST_STREAMING_OVER_TCP;
+static audio_tools::RTSPFrameQueue* rtspQueue = nullptr;
 
 }  // namespace audiotools_rtsp
 
@@ -91,6 +238,19 @@ class AudioClientRTSP {
       is_blocking = flag;
     }
 
+    /// Decouples the output from the live555 event loop with a queue of
+    /// frameCount frames: the output starts when the received frames cover
+    /// the target latency. With concurrency support the queue is written to
+    /// the output by a separate task, otherwise in loop(). Call before begin()!
+    void setQueue(int frameCount = RTSP_QUEUE_FRAMES,
+                  int targetLatencyMs = RTSP_TARGET_LATENCY_MS) {
+      queue_frames = frameCount;
+      target_latency_ms = targetLatencyMs;
+    }
+
+    /// Provides access to the receive queue (e.g. to check the lost frames)
+    RTSPFrameQueue &queue() { return frame_queue; }
+
     /// login to wifi: optional convinience method. You can also just start Wifi the normal way
     void setLogin(const char* ssid, const char* password){
       this->ssid = ssid;
@@ -103,6 +263,22 @@ class AudioClientRTSP {
       if (url==nullptr) {
         return false;
       }
+      if (queue_frames > 0) {
+        if (!frame_queue.begin(audiotools_rtsp::rtspSinkReceiveBufferSize,
+                               queue_frames, target_latency_ms)) {
+          LOGE("not enough memory");
+          return false;
+        }
+        audiotools_rtsp::rtspQueue = &frame_queue;
+#ifdef USE_CONCURRENCY
+        if (output_task.getTaskHandle() == nullptr) {
+          output_task.create("RTSPOutput", RTSP_OUTPUT_TASK_STACK_SIZE);
+        }
+        output_task.begin([this]() {
+          if (!frame_queue.writeTo(*audiotools_rtsp::rtspOutput)) delay(1);
+        });
+#endif
+      }
       if (!login()){
         LOGE("wifi down");
         return false;
@@ -126,10 +302,20 @@ class AudioClientRTSP {
     /// to be called in Arduino loop when blocking = false
     void loop() {
       if (audiotools_rtsp::rtspEventLoopWatchVariable==0) scheduler->SingleStep();  
+#ifndef USE_CONCURRENCY
+      // output the queued frames
+      if (audiotools_rtsp::rtspQueue != nullptr) {
+        while (frame_queue.writeTo(*audiotools_rtsp::rtspOutput));
+      }
+#endif
     }
 
     void end() {
       audiotools_rtsp::rtspEventLoopWatchVariable = 1; 
+#ifdef USE_CONCURRENCY
+      if (audiotools_rtsp::rtspQueue != nullptr) output_task.end();
+#endif
+      audiotools_rtsp::rtspQueue = nullptr;
       env->reclaim();
       env = NULL;
       delete scheduler;
@@ -148,6 +334,12 @@ class AudioClientRTSP {
     const char* ssid=nullptr;
     const char* password = nullptr;
     bool is_blocking = false;
+    RTSPFrameQueue frame_queue;
+    int queue_frames = 0;
+    int target_latency_ms = RTSP_TARGET_LATENCY_MS;
+#ifdef USE_CONCURRENCY
+    Task output_task;
+#endif
 
     /// login to wifi: optional convinience method. You can also just start Wifi the normal way
     bool login(){
@@ -288,6 +480,9 @@ class OurSink : public MediaSink {
 
  private:
   u_int8_t* fReceiveBuffer;
+  // buffer which is used by getNextFrame(): a slot of the queue or
+  // fReceiveBuffer
+  u_int8_t* fCurrentBuffer = nullptr;
   MediaSubsession& fSubsession;
   char* fStreamId;
 };
@@ -697,8 +892,19 @@ void OurSink::afterGettingFrame(unsigned frameSize,
   envir() << "\n";
 #endif
 
-  // Decode the data
-  if (rtspOutput) {
+  if (rtspQueue != nullptr) {
+    // the frame was received into the queue: the output task writes it
+    if (fCurrentBuffer != fReceiveBuffer) {
+      RTPSource* source = fSubsession.rtpSource();
+      uint16_t seq = source != NULL ? source->curPacketRTPSeqNum() : 0;
+      uint32_t time_ms = presentationTime.tv_sec * 1000 +
+                         presentationTime.tv_usec / 1000;
+      rtspQueue->commit(frameSize, seq, time_ms);
+    } else {
+      rtspQueue->addOverflow();
+    }
+  } else if (rtspOutput) {
+    // Decode the data
     size_t writtenSize = rtspOutput->write(fReceiveBuffer, frameSize);
     assert(writtenSize == frameSize);
   }
@@ -712,7 +918,10 @@ Boolean OurSink::continuePlaying() {
 
   // Request the next frame of data from our input source. "afterGettingFrame()"
   // will get called later, when it arrives:
-  fSource->getNextFrame(fReceiveBuffer, rtspSinkReceiveBufferSize,
+  // receive directly into the queue: if it is full we drop the frame
+  fCurrentBuffer = rtspQueue != nullptr ? rtspQueue->writeBuffer() : nullptr;
+  if (fCurrentBuffer == nullptr) fCurrentBuffer = fReceiveBuffer;
+  fSource->getNextFrame(fCurrentBuffer, rtspSinkReceiveBufferSize,
                         afterGettingFrame, this, onSourceClosure, this);
   return True;
 }
@@ -24,6 +24,9 @@ class FFTDriverCmsisFFT : public FFTDriver {
     public:
         bool begin(int len) override {
             TRACEI();
+            // the instance and the buffers are reused for the same length
+            if (len==this->len && isValid() && input!=nullptr) return true;
+            end();
             this->len = len;
             input = new float[len];
             output = new float[len*2];
@@ -39,12 +42,13 @@ class FFTDriverCmsisFFT : public FFTDriver {
         }
         void end()override{
             TRACEI();
-            if (input!=nullptr) delete input;
-            if (output!=nullptr) delete output;
-            if (output_magn!=nullptr) delete output_magn;
+            if (input!=nullptr) delete[] input;
+            if (output!=nullptr) delete[] output;
+            if (output_magn!=nullptr) delete[] output_magn;
             input = nullptr;
             output = nullptr;
             output_magn = nullptr;
+            len = 0;
         }
 
         void setValue(int idx, float value) override{
@@ -93,8 +97,8 @@ class FFTDriverCmsisFFT : public FFTDriver {
         bool isValid() override{ return status==ARM_MATH_SUCCESS; }
 
 	    arm_rfft_fast_instance_f32 fft_instance;
-    	arm_status status;
-        int len;
+    	arm_status status = ARM_MATH_ARGUMENT_ERROR;
+        int len = 0;
         float *input=nullptr;
         float *output_magn=nullptr;
         float *output=nullptr;
@@ -118,6 +122,8 @@ class AudioCmsisFFT : public AudioFFTBase {
             return driverEx()->output;
         }
 
+        using AudioFFTBase::magnitudes;
+
         float* magnitudes() {
             return driverEx()->output_magn;
         }
@@ -135,4 +141,230 @@ class AudioCmsisFFT : public AudioFFTBase {
 };
 
 
-}
\ No newline at end of file
+/**
+ * @brief Fixed point driver for Cmsis-FFT using arm_rfft_q15: the 16 bit
+ * samples are used w/o conversion to float, which is much faster on
+ * processors w/o FPU. The bins are scaled down by the length (see the
+ * CMSIS documentation of arm_rfft_q15). The inverse FFT is not supported.
+ * @ingroup fft-cmsis
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FFTDriverCmsisFFTQ15 : public FFTDriver {
+    public:
+        bool begin(int len) override {
+            TRACEI();
+            // the instance and the buffers are reused for the same length
+            if (len==this->len && isValid()) return true;
+            this->len = len;
+            input.resize(len);
+            output.resize(len*2);
+            output_magn.resize(len/2);
+            status = arm_rfft_init_q15(&fft_instance, len, 0, 1);
+            if (status!=ARM_MATH_SUCCESS){
+                LOGE("arm_rfft_init_q15: %d", status);
+            }
+            return isValid();
+        }
+
+        void end() override {
+            input.resize(0);
+            output.resize(0);
+            output_magn.resize(0);
+            len = 0;
+        }
+
+        bool isFixedPoint() override { return true; }
+
+        void setValue(int idx, float value) override {
+            if (value > 32767.0f) value = 32767.0f;
+            if (value < -32768.0f) value = -32768.0f;
+            input[idx] = value;
+        }
+
+        void setValueQ15(int idx, int16_t value) override {
+            input[idx] = value;
+        }
+
+        void fft() override {
+            // the input is modified by arm_rfft_q15
+            arm_rfft_q15(&fft_instance, input.data(), output.data());
+            // the magnitudes are in 2.14 format
+            arm_cmplx_mag_q15(output.data(), output_magn.data(), len / 2);
+        }
+
+        /// magnitude in the scale of the float drivers
+        float magnitude(int idx) override {
+            return 2.0f * output_magn[idx] * len;
+        }
+
+        float magnitudeFast(int idx) override {
+            float result = magnitude(idx);
+            return result * result;
+        }
+
+        /// magnitudes divided by the length w/o floating point operations
+        void magnitudes(int32_t *result, int n, int len) override {
+            for (int j=0;j<n;j++) result[j] = 2 * static_cast<int32_t>(output_magn[j]);
+        }
+
+        /// all magnitudes with one factor
+        void magnitudes(float *result, int n) override {
+            const float factor = 2.0f * len;
+            for (int j=0;j<n;j++) result[j] = factor * output_magn[j];
+        }
+
+        float getValue(int idx) override { return input[idx];}
+
+        bool getBin(int pos, FFTBin &bin) override {
+            if (pos>=len/2) return false;
+            bin.real = static_cast<float>(output[pos*2]) * len;
+            bin.img = static_cast<float>(output[pos*2+1]) * len;
+            return true;
+        }
+
+        bool isValid() override{ return status==ARM_MATH_SUCCESS && input.size()==len; }
+
+        arm_rfft_instance_q15 fft_instance;
+        arm_status status = ARM_MATH_ARGUMENT_ERROR;
+        int len = 0;
+        Vector<q15_t> input{0};
+        Vector<q15_t> output{0};
+        Vector<q15_t> output_magn{0};
+};
+
+/**
+ * @brief AudioFFT for ARM processors that provided Cmsis DSP using the fixed
+ * point (Q15) functions: recommended for processors w/o FPU
+ * @ingroup fft-cmsis
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioCmsisFFTQ15 : public AudioFFTBase {
+    public:
+        AudioCmsisFFTQ15():AudioFFTBase(new FFTDriverCmsisFFTQ15()) {}
+
+        /// Provides the result array returned by CMSIS FFT
+        q15_t* array() {
+            return driverEx()->output.data();
+        }
+
+        FFTDriverCmsisFFTQ15* driverEx() {
+            return (FFTDriverCmsisFFTQ15*)driver();
+        }
+};
+
+/**
+ * @brief Fixed point driver for Cmsis-FFT using arm_rfft_q31: like the Q15
+ * driver w/o floating point operations, but with a higher precision of the
+ * intermediate results. The 16 bit samples are shifted into the upper bits
+ * of the 32 bit input. The inverse FFT is not supported.
+ * @ingroup fft-cmsis
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FFTDriverCmsisFFTQ31 : public FFTDriver {
+    public:
+        bool begin(int len) override {
+            TRACEI();
+            // the instance and the buffers are reused for the same length
+            if (len==this->len && isValid()) return true;
+            this->len = len;
+            input.resize(len);
+            output.resize(len*2);
+            output_magn.resize(len/2);
+            status = arm_rfft_init_q31(&fft_instance, len, 0, 1);
+            if (status!=ARM_MATH_SUCCESS){
+                LOGE("arm_rfft_init_q31: %d", status);
+            }
+            return isValid();
+        }
+
+        void end() override {
+            input.resize(0);
+            output.resize(0);
+            output_magn.resize(0);
+            len = 0;
+        }
+
+        bool isFixedPoint() override { return true; }
+
+        void setValue(int idx, float value) override {
+            if (value > 32767.0f) value = 32767.0f;
+            if (value < -32768.0f) value = -32768.0f;
+            input[idx] = static_cast<q31_t>(value * 65536.0f);
+        }
+
+        void setValueQ15(int idx, int16_t value) override {
+            input[idx] = static_cast<q31_t>(value) << 16;
+        }
+
+        void fft() override {
+            // the input is modified by arm_rfft_q31
+            arm_rfft_q31(&fft_instance, input.data(), output.data());
+            // the magnitudes are in 2.30 format
+            arm_cmplx_mag_q31(output.data(), output_magn.data(), len / 2);
+        }
+
+        /// magnitude in the scale of the float drivers
+        float magnitude(int idx) override {
+            return 2.0f * output_magn[idx] / 65536.0f * len;
+        }
+
+        float magnitudeFast(int idx) override {
+            float result = magnitude(idx);
+            return result * result;
+        }
+
+        /// magnitudes divided by the length w/o floating point operations
+        void magnitudes(int32_t *result, int n, int len) override {
+            for (int j=0;j<n;j++) result[j] = output_magn[j] >> 15;
+        }
+
+        /// all magnitudes with one factor
+        void magnitudes(float *result, int n) override {
+            const float factor = 2.0f * len / 65536.0f;
+            for (int j=0;j<n;j++) result[j] = factor * output_magn[j];
+        }
+
+        float getValue(int idx) override { return input[idx] / 65536.0f;}
+
+        bool getBin(int pos, FFTBin &bin) override {
+            if (pos>=len/2) return false;
+            bin.real = static_cast<float>(output[pos*2]) / 65536.0f * len;
+            bin.img = static_cast<float>(output[pos*2+1]) / 65536.0f * len;
+            return true;
+        }
+
+        bool isValid() override{ return status==ARM_MATH_SUCCESS && input.size()==len; }
+
+        arm_rfft_instance_q31 fft_instance;
+        arm_status status = ARM_MATH_ARGUMENT_ERROR;
+        int len = 0;
+        Vector<q31_t> input{0};
+        Vector<q31_t> output{0};
+        Vector<q31_t> output_magn{0};
+};
+
+/**
+ * @brief AudioFFT for ARM processors that provided Cmsis DSP using the fixed
+ * point (Q31) functions
+ * @ingroup fft-cmsis
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioCmsisFFTQ31 : public AudioFFTBase {
+    public:
+        AudioCmsisFFTQ31():AudioFFTBase(new FFTDriverCmsisFFTQ31()) {}
+
+        /// Provides the result array returned by CMSIS FFT
+        q31_t* array() {
+            return driverEx()->output.data();
+        }
+
+        FFTDriverCmsisFFTQ31* driverEx() {
+            return (FFTDriverCmsisFFTQ31*)driver();
+        }
+};
+
+}
@@ -2,6 +2,7 @@
 
 #include "AudioFFT.h"
 #include "esp_dsp.h"
+#include "esp_heap_caps.h"
 
 /** 
  * @defgroup fft-dsp esp32-dsp
@@ -13,44 +14,81 @@ namespace audio_tools {
 
 /**
  * @brief fft Driver for espressif dsp library: https://espressif-docs.readthedocs-hosted.com/projects/esp-dsp/en/latest/esp-dsp-apis.html
+ * The data is kept in a 16 byte aligned buffer. By default the real input is
+ * packed into a complex vector of half the length which is processed with the
+ * radix-4 fft (dsps_fft4r) and then split into the real spectrum: this is
+ * about twice as fast as the complex radix-2 fft. The esp-dsp macros select
+ * the optimized assembler variants (e.g. _ae32 or _aes3 on the ESP32-S3).
+ * The inverse fft is only supported by the radix-2 path: use setRealFFT(false)
+ * if you need it.
  * @ingroup fft-dsp
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
 class FFTDriverEspressifFFT : public FFTDriver {
     public:
+        /// Activates the radix-4 real fft: call before begin()
+        void setRealFFT(bool active) { is_real_requested = active; }
+
         bool begin(int len) override {
+            if (p_data!=nullptr && this->len!=len) end();
             this->len = len;
             if (p_data==nullptr){
-                p_data = new float[len*2];
+                // the optimized functions need 16 byte aligned data
+                p_data = (float*) heap_caps_aligned_alloc(16, len * 2 * sizeof(float), MALLOC_CAP_8BIT);
                 if (p_data==nullptr){
                     LOGE("not enough memory");
+                    return false;
                 }
             }
-            assert(p_data!=nullptr);
-            ret = dsps_fft2r_init_fc32(NULL, CONFIG_DSP_MAX_FFT_SIZE);
-            if (ret  != ESP_OK){
-                LOGE("dsps_fft2r_init_fc32 %d", ret);
+            // the radix-4 fft of len/2 needs a power of 4
+            int half = len / 2;
+            is_real = is_real_requested && half >= 4 && (half & 0x55555555) != 0;
+            if (is_real) {
+                ret = dsps_fft4r_init_fc32(NULL, CONFIG_DSP_MAX_FFT_SIZE);
+                if (ret  != ESP_OK){
+                    LOGE("dsps_fft4r_init_fc32 %d", ret);
+                }
+            } else {
+                ret = dsps_fft2r_init_fc32(NULL, CONFIG_DSP_MAX_FFT_SIZE);
+                if (ret  != ESP_OK){
+                    LOGE("dsps_fft2r_init_fc32 %d", ret);
+                }
             }
-            return p_data!=nullptr && ret == ESP_OK;
+            return ret == ESP_OK;
         }
 
         void end() override {
-            dsps_fft2r_deinit_fc32();
-            if (p_data==nullptr){
-                delete p_data;
+            if (is_real) {
+                dsps_fft4r_deinit_fc32();
+            } else {
+                dsps_fft2r_deinit_fc32();
+            }
+            if (p_data!=nullptr){
+                heap_caps_free(p_data);
                 p_data = nullptr;
             }
         }
 
         void setValue(int idx, float value) override {
             if (idx<len){
-                p_data[idx*2 + 0] = value;
-                p_data[idx*2 + 1] = 0.0f;
+                if (is_real){
+                    p_data[idx] = value;
+                } else {
+                    p_data[idx*2 + 0] = value;
+                    p_data[idx*2 + 1] = 0.0f;
+                }
             }
         }
 
+        /// In the real fft mode the samples can be written directly
+        float *inputArray() override { return is_real ? p_data : nullptr; }
+
         void fft() override {
+            if (is_real){
+                fftReal();
+                return;
+            }
             ret = dsps_fft2r_fc32(p_data, len);
             if (ret  != ESP_OK){
                 LOGE("dsps_fft2r_fc32 %d", ret);
@@ -68,6 +106,10 @@ class FFTDriverEspressifFFT : public FFTDriver {
         };
 
         void rfft() override {
+            if (is_real){
+                LOGE("Not supported with the real fft");
+                return;
+            }
             conjugate();
             ret = dsps_fft2r_fc32(p_data, len);
             if (ret  != ESP_OK){
@@ -101,29 +143,58 @@ class FFTDriverEspressifFFT : public FFTDriver {
 
         /// magnitude w/o sqrt
         float magnitudeFast(int idx) override { 
+            // the real fft stores the nyquist value in the imaginary part of bin 0
+            if (is_real && idx==0) return p_data[0] * p_data[0];
             return (p_data[idx*2] * p_data[idx*2] + p_data[idx*2+1] * p_data[idx*2+1]);
         }
         bool setBin(int pos, float real, float img) override {
-            if (pos>=len) return false;
+            if (pos>=maxBins()) return false;
             p_data[pos*2] = real;
             p_data[pos*2+1] = img;
             return true;
         }
         bool getBin(int pos, FFTBin &bin) override { 
-            if (pos>=len) return false;
+            if (pos>=maxBins()) return false;
             bin.real = p_data[pos*2];
             bin.img = p_data[pos*2+1];
             return true;
         }
 
-        bool isReverseFFT() override {return true;}
+        bool isReverseFFT() override {return !is_real;}
 
         bool isValid() override{ return p_data!=nullptr && ret==ESP_OK; }
 
+        /// Returns true if the radix-4 real fft is used
+        bool isRealFFT() { return is_real; }
+
         esp_err_t ret;
         float *p_data = nullptr;
         int len=0;
 
+    protected:
+        bool is_real_requested = true;
+        bool is_real = false;
+
+        int maxBins() { return is_real ? len / 2 : len; }
+
+        /// N point real fft with a N/2 point complex radix-4 fft
+        void fftReal() {
+            int half = len / 2;
+            ret = dsps_fft4r_fc32(p_data, half);
+            if (ret  != ESP_OK){
+                LOGE("dsps_fft4r_fc32 %d", ret);
+            }
+            ret = dsps_bit_rev4r_fc32(p_data, half);
+            if (ret  != ESP_OK){
+                LOGE("dsps_bit_rev4r_fc32 %d", ret);
+            }
+            // split the packed result into the spectrum of the real signal
+            ret = dsps_cplx2real_fc32(p_data, half);
+            if (ret  != ESP_OK){
+                LOGE("dsps_cplx2real_fc32 %d", ret);
+            }
+        }
+
 };
 /**
  * @brief AudioFFT using FFTReal. The only specific functionality is the access to the dataArray
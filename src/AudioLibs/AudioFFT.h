@@ -39,6 +39,8 @@ struct AudioFFTResult {
 /**
  * @brief Configuration for AudioFFT. If there are more then 1 channel the 
  * channel_used is defining which channel is used to perform the fft on.
+ * The stride defines the hop size between 2 frames: e.g. use length/4 for an
+ * overlap of 75%. If it is 0 the frames do not overlap.
  * @ingroup fft
  */
 struct AudioFFTConfig : public  AudioInfo {
@@ -52,6 +54,7 @@ struct AudioFFTConfig : public  AudioInfo {
     /// Channel which is used as input
     uint8_t channel_used = 0; 
     int length=8192;
+    /// hop size in samples: 0 or length for non overlapping frames
     int stride=0;
     /// Optional window function
     WindowFunction *window_function = nullptr;  
@@ -59,8 +62,10 @@ struct AudioFFTConfig : public  AudioInfo {
 
 /// And individual FFT Bin
 struct FFTBin {
-    float real;
-    float img;
+    float real = 0.0f;
+    float img = 0.0f;
+
+    FFTBin() = default;
 
     FFTBin(float r, float i) {
         real = r;
@@ -112,6 +117,28 @@ class FFTDriver {
         bool setBin(int pos, FFTBin &bin) { return setBin(pos, bin.real, bin.img);}
         /// gets the value of a bin
         virtual bool getBin(int pos, FFTBin &bin) { return false;}        
+        /// Calculates the magnitudes w/o square root (power) of the first n bins
+        virtual void magnitudesFast(float *result, int n) {
+            for (int j=0;j<n;j++) result[j] = magnitudeFast(j);
+        }
+        /// Calculates the magnitudes of the first n bins
+        virtual void magnitudes(float *result, int n) {
+            magnitudesFast(result, n);
+            for (int j=0;j<n;j++) result[j] = sqrtf(result[j]);
+        }
+        /// Provides the input array if the values can be written directly (w/o
+        /// calling setValue() for each value): nullptr if not supported
+        virtual float *inputArray() { return nullptr; }
+        /// Returns true if the driver is working with fixed point values: the
+        /// input is provided with setValueQ15()
+        virtual bool isFixedPoint() { return false; }
+        /// Sets the real value as 16 bit integer (fixed point drivers)
+        virtual void setValueQ15(int pos, int16_t value) { setValue(pos, value); }
+        /// Calculates the magnitudes divided by the length as integers of the
+        /// first n bins
+        virtual void magnitudes(int32_t *result, int n, int len) {
+            for (int j=0;j<n;j++) result[j] = magnitude(j) / len;
+        }
 };
 
 /**
@@ -150,30 +177,43 @@ class AudioFFTBase : public AudioOutput {
                 LOGE("Len must be of the power of 2: %d", cfg.length);
                 return false;
             }
-            if (cfg.stride>0 && cfg.stride<cfg.length){
-                // holds last N bytes that need to be reprocessed
-                stride_buffer.resize((cfg.length - cfg.stride)*bytesPerSample());
-            }
+            // sliding window with the last length samples: fixed point drivers
+            // get the integer values w/o conversion to float
+            is_fixed_point = p_driver->isFixedPoint();
+            input_buffer.resize(is_fixed_point ? 0 : cfg.length);
+            input_buffer_q15.resize(is_fixed_point ? cfg.length : 0);
             if (!p_driver->begin(cfg.length)){
                 LOGE("Not enough memory");
             }
             if (cfg.window_function!=nullptr){
                 cfg.window_function->begin(length());
             }
-
-            current_pos = 0;
-            rfft_max = 0;
+            setupWindowQ15();
+            if (p_driver->isValid() && p_driver->isReverseFFT()){
+                setupInverseFFT();
+            }
+            reset();
             return p_driver->isValid();
         }
 
         /// Just resets the current_pos e.g. to start a new cycle
         void reset(){
             current_pos = 0;
+            write_pos = 0;
+            input_available = 0;
+            memset(input_buffer.data(), 0, input_buffer.size() * sizeof(float));
+            memset(input_buffer_q15.data(), 0, input_buffer_q15.size() * sizeof(int16_t));
+            memset(ola_buffer.data(), 0, ola_buffer.size() * sizeof(float));
             if (cfg.window_function!=nullptr){
                 cfg.window_function->begin(length());
             }
         }
 
+        /// Number of samples between 2 FFTs
+        int hopSize() {
+            return cfg.stride>0 && cfg.stride<cfg.length ? cfg.stride : cfg.length;
+        }
+
         operator bool() {
             return p_driver!=nullptr && p_driver->isValid();
         }
@@ -304,14 +344,19 @@ class AudioFFTBase : public AudioOutput {
             }
             return p_driver->magnitudeFast(bin);
         }
+        /// Defines the allocator for the work arrays (hot by default): call before begin()
+        void setAllocator(Allocator &allocator){
+            input_buffer.setAllocator(allocator);
+            input_buffer_q15.setAllocator(allocator);
+            ola_buffer.setAllocator(allocator);
+        }
+
         /// Provides the magnitudes as array of size size(). Please note that this method is allocating additinal memory!
         float* magnitudes() {
             if (p_magnitudes==nullptr){
                 p_magnitudes = new float[size()];
             }
-            for (int j=0;j<size();j++){
-                p_magnitudes[j]= magnitude(j);
-            }
+            magnitudes(p_magnitudes);
             return p_magnitudes;
         }
 
@@ -320,10 +365,38 @@ class AudioFFTBase : public AudioOutput {
             if (p_magnitudes==nullptr){
                 p_magnitudes = new float[size()];
             }
+            magnitudesFast(p_magnitudes);
+            return p_magnitudes;
+        }
+
+        /// Provides the magnitudes in the caller provided array of size size()
+        void magnitudes(float *result) {
+            p_driver->magnitudes(result, size());
+        }
+
+        /// Provides the magnitudes divided by the length as integers in the caller provided array of size size()
+        void magnitudes(int32_t *result) {
+            p_driver->magnitudes(result, size(), length());
+        }
+
+        /// Provides the magnitudes w/o square root (= power spectrum) in the caller provided array of size size()
+        void magnitudesFast(float *result) {
+            p_driver->magnitudesFast(result, size());
+        }
+
+        /// Provides the power spectrum in the caller provided array of size size()
+        void powers(float *result) {
+            magnitudesFast(result);
+        }
+
+        /// Provides the power spectrum in dB (10*log10(power/ref)) in the caller provided array of size size()
+        void magnitudesDB(float *result, float ref = 1.0f) {
+            magnitudesFast(result);
+            const float min_power = 1.0e-20f;
             for (int j=0;j<size();j++){
-                p_magnitudes[j]= magnitudeFast(j);
+                float power = result[j] / ref;
+                result[j] = 10.0f * log10f(power > min_power ? power : min_power);
             }
-            return p_magnitudes;
         }
 
         /// sets the value of a bin
@@ -344,7 +417,8 @@ class AudioFFTBase : public AudioOutput {
             p_out = &out;
         }
 
-        /// Returns true if we need to calculate the inverse FFT
+        /// Returns true if we need to calculate the inverse FFT: the result is
+        /// written with overlap-add to the output (ISTFT)
         bool isInverseFFT() {
             return p_out != nullptr && p_driver->isReverseFFT();
         }
@@ -355,55 +429,104 @@ class AudioFFTBase : public AudioOutput {
         AudioFFTConfig cfg;
         unsigned long timestamp_begin=0l;
         unsigned long timestamp=0l;
-        RingBuffer<uint8_t> stride_buffer{0};
         float *p_magnitudes = nullptr;
         int bins = 0;
         Print *p_out = nullptr;
-        float rfft_max = 0;
-
-
-        // Add samples to input data p_x - and process them if full
+        // ring buffer with the last length samples: write_pos is the oldest
+        Vector<float> input_buffer{0, HotAllocator};
+        Vector<int16_t> input_buffer_q15{0, HotAllocator};
+        // window function in Q15 for the fixed point drivers
+        Vector<int16_t> window_q15{0};
+        bool is_fixed_point = false;
+        int write_pos = 0;
+        int input_available = 0;
+        // overlap-add buffer for the inverse fft
+        Vector<float> ola_buffer{0, HotAllocator};
+        float rfft_scale = 1.0f;
+
+        // Add samples to the sliding window - and process them after each hop
         template<typename T>
         void processSamples(const void *data, size_t samples) {
+            if (is_fixed_point) {
+                processSamplesQ15<T>(data, samples);
+                return;
+            }
             T *dataT = (T*) data;
-            T sample;
-            float sample_windowed;
+            const int mask = cfg.length - 1;
+            const int hop = hopSize();
             for (int j=0; j<samples; j+=cfg.channels){
-                sample = dataT[j+cfg.channel_used];
-                p_driver->setValue(current_pos, windowedSample(sample));
-                writeStrideBuffer((uint8_t*)&sample, sizeof(T));
-                if (++current_pos>=cfg.length){
+                input_buffer[write_pos] = static_cast<float>(dataT[j+cfg.channel_used]);
+                write_pos = (write_pos + 1) & mask;
+                if (input_available < cfg.length) input_available++;
+                if (++current_pos>=hop && input_available>=cfg.length){
+                    // copy the windowed frame starting with the oldest sample
+                    float *p_input = p_driver->inputArray();
+                    for (int i=0; i<cfg.length; i++){
+                        float value = windowedSample(i, input_buffer[(write_pos + i) & mask]);
+                        if (p_input != nullptr) {
+                            p_input[i] = value;
+                        } else {
+                            p_driver->setValue(i, value);
+                        }
+                    }
                     // perform FFT
-                    fft<T>();
+                    fft();
 
                     if (isInverseFFT())
                         rfft();                    
+                }
+            }
+        }
 
-                    // reprocess data in stride buffer
-                    if (stride_buffer.size()>0){
-                        // reload data from stride buffer
-                        while (stride_buffer.available()){
-                            T sample;
-                            stride_buffer.readArray((uint8_t*)&sample, sizeof(T));
-                            p_driver->setValue(current_pos, windowedSample(sample));
-                            current_pos++;
+        /// Integer version of processSamples(): 24 and 32 bit samples are
+        /// reduced to 16 bits
+        template<typename T>
+        void processSamplesQ15(const void *data, size_t samples) {
+            T *dataT = (T*) data;
+            const int mask = cfg.length - 1;
+            const int hop = hopSize();
+            const int shift = std::is_same<T, int24_t>::value ? 8 : (sizeof(T) - sizeof(int16_t)) * 8;
+            int16_t *buffer = input_buffer_q15.data();
+            for (int j=0; j<samples; j+=cfg.channels){
+                buffer[write_pos] = static_cast<int32_t>(dataT[j+cfg.channel_used]) >> shift;
+                write_pos = (write_pos + 1) & mask;
+                if (input_available < cfg.length) input_available++;
+                if (++current_pos>=hop && input_available>=cfg.length){
+                    for (int i=0; i<cfg.length; i++){
+                        int16_t sample = buffer[(write_pos + i) & mask];
+                        if (window_q15.size() > 0) {
+                            sample = (static_cast<int32_t>(sample) * window_q15[i]) >> 15;
                         }
-                    } 
-
+                        p_driver->setValueQ15(i, sample);
+                    }
+                    fft();
                 }
             }
         }
 
-        template<typename T>
-        T windowedSample(T sample){
-            T result = sample;
+        /// Precalculates the window function factors in Q15
+        void setupWindowQ15() {
+            if (!is_fixed_point || cfg.window_function==nullptr) {
+                window_q15.resize(0);
+                return;
+            }
+            window_q15.resize(cfg.length);
+            for (int j=0;j<cfg.length;j++){
+                float factor = cfg.window_function->factor(j);
+                if (factor > 1.0f) factor = 1.0f;
+                if (factor < -1.0f) factor = -1.0f;
+                window_q15[j] = factor * 32767.0f;
+            }
+        }
+
+        float windowedSample(int pos, float sample){
+            float result = sample;
             if (cfg.window_function!=nullptr){
-                result = cfg.window_function->factor(current_pos) * sample;
+                result = cfg.window_function->factor(pos) * sample;
             }
             return result;
         }
 
-        template<typename T>
         void fft() {
             timestamp_begin = millis();
             p_driver->fft();
@@ -414,33 +537,64 @@ class AudioFFTBase : public AudioOutput {
             current_pos = 0;
         }
 
-        /// reverse fft if necessary 
+        /// Determines the scaling of the reverse fft and for the overlap-add
+        void setupInverseFFT() {
+            ola_buffer.resize(cfg.length);
+            // the drivers differ in the scaling of the reverse fft
+            for (int j=0;j<cfg.length;j++){
+                p_driver->setValue(j, j==0 ? 1.0f : 0.0f);
+            }
+            p_driver->fft();
+            p_driver->rfft();
+            float driver_gain = p_driver->getValue(0);
+            // sum of the overlapping windows
+            float window_sum = 0.0f;
+            for (int j=0;j<cfg.length;j++){
+                window_sum += windowedSample(j, 1.0f);
+            }
+            float ola_gain = window_sum / hopSize();
+            rfft_scale = driver_gain != 0.0f && ola_gain != 0.0f ? 1.0f / (driver_gain * ola_gain) : 1.0f;
+        }
+
+        /// reverse fft with overlap-add: outputs hop size samples
         void rfft() {
             TRACED();
             p_driver->rfft();
+            const int hop = hopSize();
+            float *ola = ola_buffer.data();
             for (int j=0;j<cfg.length;j++){
-                float value = p_driver->getValue(j);
-                if (rfft_max < value ) rfft_max = value;
-                //Serial.println(value / rfft_max);
-                switch(cfg.bits_per_sample){
-                    case 16:{
-                        int16_t out16 = value / rfft_max * NumberConverter::maxValue(16);
-                        for (int ch=0;ch<cfg.channels; ch++)
-                            p_out->write((uint8_t*)&out16, sizeof(out16));
-                        }break;
-                    case 24:{
-                        int24_t out24 = value  / rfft_max * NumberConverter::maxValue(24);
-                        for (int ch=0;ch<cfg.channels; ch++)
-                            p_out->write((uint8_t*)&out24, sizeof(out24));
-                        }break;
-                    case 32: {
-                        int32_t out32 = value  / rfft_max * NumberConverter::maxValue(32);
-                        for (int ch=0;ch<cfg.channels; ch++)
-                            p_out->write((uint8_t*)&out32, sizeof(out32));
-                        } break;
-                    default:
-                        LOGE("Unsupported bits")
-                }
+                ola[j] += p_driver->getValue(j) * rfft_scale;
+            }
+            for (int j=0;j<hop;j++){
+                writeOutput(ola[j]);
+            }
+            memmove(ola, ola + hop, (cfg.length - hop) * sizeof(float));
+            memset(ola + cfg.length - hop, 0, hop * sizeof(float));
+        }
+
+        /// writes the value to all channels of the output
+        void writeOutput(float value) {
+            float max_value = NumberConverter::maxValue(cfg.bits_per_sample);
+            if (value > max_value) value = max_value;
+            if (value < -max_value) value = -max_value;
+            switch(cfg.bits_per_sample){
+                case 16:{
+                    int16_t out16 = value;
+                    for (int ch=0;ch<cfg.channels; ch++)
+                        p_out->write((uint8_t*)&out16, sizeof(out16));
+                    }break;
+                case 24:{
+                    int24_t out24 = value;
+                    for (int ch=0;ch<cfg.channels; ch++)
+                        p_out->write((uint8_t*)&out24, sizeof(out24));
+                    }break;
+                case 32: {
+                    int32_t out32 = value;
+                    for (int ch=0;ch<cfg.channels; ch++)
+                        p_out->write((uint8_t*)&out32, sizeof(out32));
+                    } break;
+                default:
+                    LOGE("Unsupported bits")
             }
         }
 
@@ -467,20 +621,6 @@ class AudioFFTBase : public AudioOutput {
             }
         }
 
-        void writeStrideBuffer(uint8_t* buffer, size_t len){
-            if (stride_buffer.size()>0){
-                int available = stride_buffer.availableForWrite();
-                if (len>available){
-                    // clear oldest values to make space
-                    int diff = len-available;
-                    for(int j=0;j<diff;j++){
-                        stride_buffer.read();
-                    }
-                }
-                stride_buffer.writeArray(buffer, len);
-            }
-        }
-
         bool isPowerOfTwo(uint16_t x) {
             return (x & (x - 1)) == 0;
         }
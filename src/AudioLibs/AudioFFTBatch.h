@@ -0,0 +1,283 @@
+#pragma once
+
+#include "AudioLibs/AudioFFT.h"
+#if defined(ESP32) || defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || \
+    defined(USE_STD_CONCURRENCY)
+#  include "Concurrency/WorkerPool.h"
+#  define USE_FFT_BATCH_PARALLEL
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Executes the same FFT on several channels of the interleaved audio
+ * data in one call: e.g. for the analysis of a microphone array. All channels
+ * share the same driver (and therefore the same twiddle tables) and the same
+ * window function. The sliding windows and the resulting magnitudes are
+ * stored in one contiguous block per batch: channel after channel.
+ *
+ * If a WorkerPool and a second driver are defined with setParallel(), the
+ * second half of the batches is processed by the worker (e.g. on the other
+ * core of the ESP32) while the first half is processed by the caller.
+ * @code
+ * FFTDriverRealFFT driver; // used for all channels
+ * AudioFFTBatch batch(driver);
+ * auto cfg = batch.defaultConfig();
+ * cfg.channels = 4;
+ * cfg.length = 1024;
+ * cfg.window_function = &hann;
+ * batch.begin(cfg);
+ * ...
+ * float *mags = batch.magnitudes(2); // size() values of channel 2
+ * @endcode
+ * @ingroup fft
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioFFTBatch : public AudioOutput {
+ public:
+  AudioFFTBatch(FFTDriver &driver) { p_driver = &driver; }
+
+  /// Provides the default configuration: the channel_used is ignored
+  AudioFFTConfig defaultConfig() {
+    AudioFFTConfig result;
+    return result;
+  }
+
+  /// Selects the channels which are processed: by default all channels
+  void setChannels(const uint8_t *channels, int count) {
+    selected.resize(count);
+    for (int j = 0; j < count; j++) selected[j] = channels[j];
+  }
+
+  /// Callback which is called after all batches have been processed
+  void setCallback(void (*callback)(AudioFFTBatch &fft)) {
+    this->callback = callback;
+  }
+
+#ifdef USE_FFT_BATCH_PARALLEL
+  /// Splits the batches between the caller and a worker of the pool: the
+  /// second driver must be of the same type as the first one
+  void setParallel(WorkerPool &pool, FFTDriver &secondDriver) {
+    p_pool = &pool;
+    p_driver2 = &secondDriver;
+  }
+#endif
+
+  /// Defines the allocator for the sliding windows and magnitudes: call
+  /// before begin()
+  void setAllocator(Allocator &allocator) {
+    input.setAllocator(allocator);
+    mags.setAllocator(allocator);
+  }
+
+  bool begin(AudioFFTConfig info) {
+    cfg = info;
+    return begin();
+  }
+
+  bool begin() override {
+    if ((cfg.length & (cfg.length - 1)) != 0) {
+      LOGE("Len must be of the power of 2: %d", cfg.length);
+      return false;
+    }
+    if (selected.size() == 0) {
+      selected.resize(cfg.channels);
+      for (int j = 0; j < cfg.channels; j++) selected[j] = j;
+    }
+    for (int j = 0; j < selected.size(); j++) {
+      if (selected[j] >= cfg.channels) {
+        LOGE("Invalid channel: %d", selected[j]);
+        return false;
+      }
+    }
+    bins = cfg.length / 2;
+    input.resize(batches() * cfg.length);
+    mags.resize(batches() * bins);
+    if ((int)input.size() != batches() * cfg.length ||
+        (int)mags.size() != batches() * bins) {
+      LOGE("Not enough memory");
+      return false;
+    }
+    if (!p_driver->begin(cfg.length)) {
+      LOGE("Not enough memory");
+      return false;
+    }
+    if (p_driver2 != nullptr && !p_driver2->begin(cfg.length)) {
+      LOGE("Not enough memory");
+      return false;
+    }
+    if (cfg.window_function != nullptr) {
+      cfg.window_function->begin(cfg.length);
+    }
+    reset();
+    return p_driver->isValid();
+  }
+
+  void end() override {
+    p_driver->end();
+    if (p_driver2 != nullptr) p_driver2->end();
+    input.resize(0);
+    mags.resize(0);
+  }
+
+  /// Restarts the sliding windows
+  void reset() {
+    write_pos = 0;
+    current_pos = 0;
+    input_available = 0;
+    memset(input.data(), 0, input.size() * sizeof(float));
+    memset(mags.data(), 0, mags.size() * sizeof(float));
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!p_driver->isValid()) return 0;
+    switch (cfg.bits_per_sample) {
+      case 16:
+        processFrames<int16_t>(data, len / sizeof(int16_t) / cfg.channels);
+        break;
+      case 24:
+        processFrames<int24_t>(data, len / sizeof(int24_t) / cfg.channels);
+        break;
+      case 32:
+        processFrames<int32_t>(data, len / sizeof(int32_t) / cfg.channels);
+        break;
+      default:
+        LOGE("Unsupported bits_per_sample: %d", cfg.bits_per_sample);
+        break;
+    }
+    return len;
+  }
+
+  int availableForWrite() override {
+    return cfg.bits_per_sample / 8 * cfg.length * cfg.channels;
+  }
+
+  /// Number of batches (= selected channels)
+  int batches() { return selected.size(); }
+
+  /// Number of bins per batch
+  int size() { return bins; }
+
+  /// Number of samples per fft
+  int length() { return cfg.length; }
+
+  /// Frequency of the indicated bin
+  float frequency(int bin) {
+    return static_cast<float>(bin) * cfg.sample_rate / cfg.length;
+  }
+
+  /// Magnitudes (size() values) of the indicated batch
+  float *magnitudes(int batch) { return mags.data() + batch * bins; }
+
+  /// Bin with the max magnitude of the indicated batch
+  AudioFFTResult result(int batch) {
+    AudioFFTResult result;
+    result.bin = 0;
+    result.magnitude = 0;
+    float *m = magnitudes(batch);
+    for (int j = 0; j < bins; j++) {
+      if (m[j] > result.magnitude) {
+        result.magnitude = m[j];
+        result.bin = j;
+      }
+    }
+    result.frequency = frequency(result.bin);
+    return result;
+  }
+
+  /// time after the last fft of the batch
+  unsigned long resultTime() { return timestamp; }
+
+  AudioFFTConfig &config() { return cfg; }
+
+ protected:
+  FFTDriver *p_driver = nullptr;
+  FFTDriver *p_driver2 = nullptr;
+#ifdef USE_FFT_BATCH_PARALLEL
+  WorkerPool *p_pool = nullptr;
+  WorkerFuture future;
+#endif
+  AudioFFTConfig cfg;
+  void (*callback)(AudioFFTBatch &fft) = nullptr;
+  Vector<uint8_t> selected{0};
+  // sliding windows of all batches: length samples per batch
+  Vector<float> input{0, HotAllocator};
+  // magnitudes of all batches: bins values per batch
+  Vector<float> mags{0, HotAllocator};
+  int bins = 0;
+  int write_pos = 0;
+  int current_pos = 0;
+  int input_available = 0;
+  unsigned long timestamp = 0;
+
+  int hopSize() {
+    return cfg.stride > 0 && cfg.stride < cfg.length ? cfg.stride
+                                                     : cfg.length;
+  }
+
+  /// Distributes the frames to the sliding windows of the batches
+  template <typename T>
+  void processFrames(const void *data, size_t frames) {
+    T *frame = (T *)data;
+    const int mask = cfg.length - 1;
+    const int hop = hopSize();
+    const int count = batches();
+    float *windows = input.data();
+    for (size_t j = 0; j < frames; j++, frame += cfg.channels) {
+      for (int b = 0; b < count; b++) {
+        windows[b * cfg.length + write_pos] =
+            static_cast<float>(frame[selected[b]]);
+      }
+      write_pos = (write_pos + 1) & mask;
+      if (input_available < cfg.length) input_available++;
+      if (++current_pos >= hop && input_available >= cfg.length) {
+        fftAll();
+        current_pos = 0;
+      }
+    }
+  }
+
+  void fftAll() {
+    int count = batches();
+    int split = count;
+#ifdef USE_FFT_BATCH_PARALLEL
+    if (p_pool != nullptr && p_driver2 != nullptr && count > 1) {
+      split = (count + 1) / 2;
+      p_pool->submit([this, split, count]() { fftRange(*p_driver2, split, count); },
+                     &future);
+    }
+#endif
+    fftRange(*p_driver, 0, split);
+#ifdef USE_FFT_BATCH_PARALLEL
+    if (split < count) future.wait();
+#endif
+    timestamp = millis();
+    if (callback != nullptr) callback(*this);
+  }
+
+  /// Executes the fft for the batches from..to-1 with the indicated driver
+  void fftRange(FFTDriver &driver, int from, int to) {
+    const int mask = cfg.length - 1;
+    for (int b = from; b < to; b++) {
+      // copy the windowed frame starting with the oldest sample
+      float *window = input.data() + b * cfg.length;
+      float *p_input = driver.inputArray();
+      for (int i = 0; i < cfg.length; i++) {
+        float value = window[(write_pos + i) & mask];
+        if (cfg.window_function != nullptr) {
+          value *= cfg.window_function->factor(i);
+        }
+        if (p_input != nullptr) {
+          p_input[i] = value;
+        } else {
+          driver.setValue(i, value);
+        }
+      }
+      driver.fft();
+      driver.magnitudes(magnitudes(b), bins);
+    }
+  }
+};
+
+}  // namespace audio_tools
@@ -1,12 +1,21 @@
 #pragma once
 #include "AudioTools/AudioStreams.h"
+#include "AudioTools/PlanarFrameBuffer.h"
 #include "AudioLibs/AudioFaustDSP.h"
 
+/// Max number of frames which are passed to Faust in one compute() call
+#ifndef FAUST_BLOCK_FRAMES
+#  define FAUST_BLOCK_FRAMES 256
+#endif
+
 namespace audio_tools {
 
 /**
  * @brief Integration into Faust DSP see https://faust.grame.fr/
- * To generate code from faust, select src and cpp
+ * To generate code from faust, select src and cpp.
+ * The data is converted block by block between the interleaved PCM data and
+ * planar float buffers, which are allocated in begin(), and Faust is called
+ * once for each block of up to FAUST_BLOCK_FRAMES frames.
  * @ingroup dsp
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -28,7 +37,6 @@ class FaustStream : public AudioStream {
 
     ~FaustStream(){
         end();
-        deleteFloatBuffer();
         delete p_dsp;
 #ifdef USE_MEMORY_MANAGER
         DSP::classDestroy();
@@ -57,7 +65,6 @@ class FaustStream : public AudioStream {
         this->cfg = cfg;
         this->bytes_per_sample = cfg.bits_per_sample / 8;
         this->bytes_per_frame = bytes_per_sample * cfg.channels;
-        this->float_to_int_factor = NumberConverter::maxValue(cfg.bits_per_sample);
 
         if (p_dsp==nullptr){
 #ifdef USE_MEMORY_MANAGER
@@ -81,13 +88,12 @@ class FaustStream : public AudioStream {
 
         // we do expect an output
         result = checkChannels();
+        bytes_per_frame = bytes_per_sample * cfg.channels;
 
-        // allocate array of channel data
-        if (p_buffer==nullptr){
-            p_buffer = new FAUSTFLOAT*[cfg.channels]();
-        }
-        if (with_output_buffer && p_buffer_out==nullptr){
-            p_buffer_out = new FAUSTFLOAT*[cfg.channels]();
+        // allocate the planar channel data once
+        buffer.resize(cfg.channels, FAUST_BLOCK_FRAMES);
+        if (with_output_buffer){
+            buffer_out.resize(cfg.channels, FAUST_BLOCK_FRAMES);
         }
 
         LOGI("is_read: %s", is_read?"true":"false");
@@ -117,27 +123,16 @@ class FaustStream : public AudioStream {
         size_t result = 0;
         if (is_read){
             TRACED();
-            result = len;
-            int samples = len / bytes_per_sample;
-            allocateFloatBuffer(samples, false);
-            p_dsp->compute(samples, nullptr, p_buffer);
-            // convert from float to int
-            switch(cfg.bits_per_sample){
-                case 8:
-                    convertFloatBufferToInt<int8_t>(samples, p_buffer, data);
-                    break;
-                case 16:
-                    convertFloatBufferToInt<int16_t>(samples, p_buffer, data);
-                    break;
-                case 24:
-                    convertFloatBufferToInt<int24_t>(samples, p_buffer, data);
-                    break;
-                case 32:
-                    convertFloatBufferToInt<int32_t>(samples, p_buffer, data);
-                    break;
-                default:
-                    TRACEE();
+            int frames = len / bytes_per_frame;
+            int pos = 0;
+            while (pos < frames) {
+                int n = min(frames - pos, buffer.frames());
+                p_dsp->compute(n, nullptr, buffer.planes());
+                // convert from float to int
+                buffer.toInterleaved(data + pos * bytes_per_frame, n, cfg.bits_per_sample);
+                pos += n;
             }
+            result = frames * bytes_per_frame;
         }
         return result;
     }
@@ -145,19 +140,25 @@ class FaustStream : public AudioStream {
     /// Used if FaustStream is used as audio sink or filter
     size_t write(const uint8_t *data, size_t len) override {
         LOGD("FaustStream::write: %d", len);
-        switch(cfg.bits_per_sample){
-            case 8:
-                return writeT<int8_t>(data, len);
-            case 16:
-                return writeT<int16_t>(data, len);
-            case 24:
-                return writeT<int24_t>(data, len);
-            case 32:
-                return writeT<int32_t>(data, len);
-            default:
-                TRACEE();
+        size_t result = 0;
+        if (is_write){
+            TRACED();
+            int frames = len / bytes_per_frame;
+            uint8_t *write_data = (uint8_t*) data;
+            // the result is stored in the input data
+            PlanarFrameBuffer<FAUSTFLOAT> &out = with_output_buffer ? buffer_out : buffer;
+            int pos = 0;
+            while (pos < frames) {
+                uint8_t *block = write_data + pos * bytes_per_frame;
+                int n = buffer.fromInterleaved(block, frames - pos, cfg.bits_per_sample);
+                p_dsp->compute(n, buffer.planes(), out.planes());
+                out.toInterleaved(block, n, cfg.bits_per_sample);
+                pos += n;
+            }
+            // write data to final output
+            result = p_out->write(data, frames * bytes_per_frame);
         }
-        return 0;
+        return result;
     }
 
     int available() override {
@@ -228,13 +229,11 @@ class FaustStream : public AudioStream {
     bool with_output_buffer;
     int bytes_per_sample;
     int bytes_per_frame;
-    int buffer_allocated;
-    float float_to_int_factor = 32767;
     DSP *p_dsp = nullptr;
     AudioInfo cfg;
     Print *p_out=nullptr;
-    FAUSTFLOAT** p_buffer=nullptr;
-    FAUSTFLOAT** p_buffer_out=nullptr;
+    PlanarFrameBuffer<FAUSTFLOAT> buffer;
+    PlanarFrameBuffer<FAUSTFLOAT> buffer_out;
     UI ui;
 
     /// Checks the input and output channels and updates the is_write or is_read scenario flags
@@ -271,113 +270,6 @@ class FaustStream : public AudioStream {
         return result;
     }
 
-    /// Converts the float buffer to int values
-    template <class T> 
-    void convertFloatBufferToInt(int samples, FAUSTFLOAT**p_float_in, void *data_out){
-        T *dataT = (T*) data_out;
-        int frameCount = samples/cfg.channels;
-        for (int j=0; j<frameCount; j++){
-            for (int i=0;i<cfg.channels;i++){
-                float sample = p_float_in[i][j];
-                // clip input
-    			if(sample > 1.0f){
-                    sample = 1.0f;
-                }
-    			if(sample < -1.0f){
-                    sample = -1.0f;
-                }
-                dataT[(j*cfg.channels)+i] = sample * float_to_int_factor;
-            }
-        }
-    }
-
-    /// Converts the int buffer to float values
-    template <class T> 
-    void convertIntBufferToFloat(int samples, void *data_in, FAUSTFLOAT**p_float_out ){
-        T *dataT = (T*) data_in;
-        int frameCount = samples/cfg.channels;
-        for(int j=0;j<frameCount;j++){
-            for(int i=0;i<cfg.channels;i++){
-                p_float_out[i][j] =  static_cast<FAUSTFLOAT>(dataT[(j*cfg.channels)+i]) / float_to_int_factor;
-            }
-        }
-    }
-
-      /// Used if FaustStream is used as audio sink or filter
-    template <class T> 
-    size_t writeT(const uint8_t *write_data, size_t len) {
-        size_t result = 0;
-        if (is_write){
-            TRACED();
-            int samples = len / bytes_per_sample;
-            int frames = samples / cfg.channels;
-            // prepare float input for faust
-            allocateFloatBuffer(samples, with_output_buffer);
-            convertIntBufferToFloat<T>(samples, (void*) write_data, p_buffer);
-
-            // determine result
-            FAUSTFLOAT** p_float_buffer = with_output_buffer ? p_buffer_out : p_buffer; 
-            p_dsp->compute(frames, p_buffer, p_float_buffer);
-
-            // update buffer with data from faust
-            convertFloatBufferToInt<T>(samples, p_float_buffer, (void*) write_data);
-            // write data to final output
-            result = p_out->write(write_data, len);
-        }
-        return result;
-    }
-  
-
-    /// Allocate the buffer that is needed by faust
-    void allocateFloatBuffer(int samples, bool allocate_out){
-        if (samples>buffer_allocated){
-            if (p_buffer[0]!=nullptr){
-                for (int j=0;j<cfg.channels;j++){
-                    delete[]p_buffer[j];
-                    p_buffer[j] = nullptr;
-                }
-            }
-            if (p_buffer_out!=nullptr && p_buffer_out[0]!=nullptr){
-                for (int j=0;j<cfg.channels;j++){
-                    delete[]p_buffer_out[j];
-                    p_buffer_out[j] = nullptr;
-                }
-            }
-        }
-        if (p_buffer[0]==nullptr){
-            const int ch = cfg.channels;
-            for (int j=0;j<ch;j++){
-                p_buffer[j] = new FAUSTFLOAT[samples];
-            }
-            buffer_allocated = samples;
-        }
-        if (allocate_out){
-            if (p_buffer_out[0]==nullptr){
-                const int ch = cfg.channels;
-                for (int j=0;j<ch;j++){
-                    p_buffer_out[j] = new FAUSTFLOAT[samples];
-                }
-            }
-        }
-    }
-
-    void deleteFloatBuffer() {
-        if (p_buffer!=nullptr) {
-            for (int j=0;j<cfg.channels;j++){
-                if (p_buffer[j]!=nullptr) delete p_buffer[j];
-            }
-            delete[] p_buffer;
-            p_buffer = nullptr;
-        } 
-        if (p_buffer_out!=nullptr) {
-            for (int j=0;j<cfg.channels;j++){
-                if (p_buffer_out[j]!=nullptr) delete p_buffer_out[j];
-            }
-            delete[] p_buffer_out;
-            p_buffer_out = nullptr;
-        } 
-    }
-
     FAUSTFLOAT noteToFrequency(uint8_t x) {
         FAUSTFLOAT note = x;
         return 440.0 * pow(2.0f, (note-69)/12);
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "AudioFFT.h"
+
+/**
+ * @defgroup fft-fixed Fixed Point
+ * @ingroup fft
+ * @brief FFT using integer arithmetic for processors w/o FPU
+**/
+
+namespace audio_tools {
+
+/**
+ * @brief Portable fixed point FFT driver for processors w/o FPU (e.g.
+ * ESP32-C3, RP2040): the 16 bit input values are transformed with a N/2
+ * complex radix 2 FFT and a split step into the N/2 bins of the real FFT.
+ * The twiddle factors are Q15 and the calculation uses 32 bit integers, so
+ * no scaling is needed and the bins have the same scale as with the float
+ * drivers. The inverse FFT is not supported.
+ * @ingroup fft-fixed
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FFTDriverFixedPoint : public FFTDriver {
+    public:
+        bool begin(int len) override {
+            if (len < 4) return false;
+            this->len = len;
+            half = len / 2;
+            data.resize(len);
+            setupTwiddles();
+            return isValid();
+        }
+
+        void end() override {
+            data.resize(0);
+            cos_q15.resize(0);
+            sin_q15.resize(0);
+            len = 0;
+        }
+
+        /// Sets the real value: the fractional part is lost
+        void setValue(int pos, float value) override {
+            if (value > 32767.0f) value = 32767.0f;
+            if (value < -32768.0f) value = -32768.0f;
+            setValueQ15(pos, value);
+        }
+
+        void setValueQ15(int pos, int16_t value) override {
+            // even samples are the real, odd samples the imaginary part
+            data[pos] = value;
+        }
+
+        bool isFixedPoint() override { return true; }
+
+        void fft() override {
+            bitReverse();
+            butterflies();
+            split();
+        }
+
+        float magnitude(int idx) override {
+            return sqrtf(magnitudeFast(idx));
+        }
+
+        /// magnitude w/o sqrt
+        float magnitudeFast(int idx) override {
+            float re = data[idx * 2];
+            float im = data[idx * 2 + 1];
+            return re * re + im * im;
+        }
+
+        /// magnitudes divided by the length w/o floating point operations
+        void magnitudes(int32_t *result, int n, int len) override {
+            int shift = 0;
+            while ((1 << shift) < len) shift++;
+            for (int j = 0; j < n; j++) {
+                int64_t re = data[j * 2];
+                int64_t im = data[j * 2 + 1];
+                result[j] = isqrt(re * re + im * im) >> shift;
+            }
+        }
+
+        float getValue(int pos) override { return data[pos]; }
+
+        bool getBin(int pos, FFTBin &bin) override {
+            if (pos >= half) return false;
+            bin.real = data[pos * 2];
+            bin.img = data[pos * 2 + 1];
+            return true;
+        }
+
+        bool isValid() override {
+            return len > 0 && data.size() == len && cos_q15.size() == half + 1;
+        }
+
+        /// Provides the result as interleaved real and imaginary values
+        int32_t *array() { return data.data(); }
+
+    protected:
+        int len = 0;
+        int half = 0;
+        // interleaved complex values
+        Vector<int32_t> data{0};
+        // cos and sin of 2*PI*k/len for k = 0 .. len/2
+        Vector<int16_t> cos_q15{0};
+        Vector<int16_t> sin_q15{0};
+
+        void setupTwiddles() {
+            if (cos_q15.size() == half + 1) return;
+            cos_q15.resize(half + 1);
+            sin_q15.resize(half + 1);
+            for (int k = 0; k <= half; k++) {
+                double angle = 2.0 * PI * k / len;
+                cos_q15[k] = round(cos(angle) * 32767.0);
+                sin_q15[k] = round(sin(angle) * 32767.0);
+            }
+        }
+
+        /// multiplies with the Q15 value with rounding
+        static inline int32_t mul(int32_t value, int16_t q15) {
+            return (static_cast<int64_t>(value) * q15 + (1 << 14)) >> 15;
+        }
+
+        /// bit reversal of the half complex values
+        void bitReverse() {
+            int32_t *c = data.data();
+            for (int i = 1, j = 0; i < half; i++) {
+                int bit = half >> 1;
+                for (; j & bit; bit >>= 1) j ^= bit;
+                j ^= bit;
+                if (i < j) {
+                    int32_t tmp = c[2 * i];
+                    c[2 * i] = c[2 * j];
+                    c[2 * j] = tmp;
+                    tmp = c[2 * i + 1];
+                    c[2 * i + 1] = c[2 * j + 1];
+                    c[2 * j + 1] = tmp;
+                }
+            }
+        }
+
+        /// radix 2 complex FFT of length half
+        void butterflies() {
+            int32_t *c = data.data();
+            for (int size = 2; size <= half; size <<= 1) {
+                int step = len / size;
+                int h = size / 2;
+                for (int i = 0; i < half; i += size) {
+                    for (int j = 0; j < h; j++) {
+                        int16_t wr = cos_q15[j * step];
+                        int16_t wi = sin_q15[j * step];
+                        int32_t *u = c + 2 * (i + j);
+                        int32_t *v = c + 2 * (i + j + h);
+                        // v * (cos - i sin)
+                        int32_t tr = mul(v[0], wr) + mul(v[1], wi);
+                        int32_t ti = mul(v[1], wr) - mul(v[0], wi);
+                        v[0] = u[0] - tr;
+                        v[1] = u[1] - ti;
+                        u[0] += tr;
+                        u[1] += ti;
+                    }
+                }
+            }
+        }
+
+        /// Determines X[k] = (A + W^k * -iB) / 2 with A = Z[k] + conj(Z[half-k])
+        /// and B = Z[k] - conj(Z[half-k])
+        void splitBin(int k, const int32_t *zk, const int32_t *zmk, int32_t *out) {
+            int32_t ar = zk[0] + zmk[0];
+            int32_t ai = zk[1] - zmk[1];
+            int32_t br = zk[0] - zmk[0];
+            int32_t bi = zk[1] + zmk[1];
+            // -iB = bi - i br; multiplied with cos - i sin
+            int16_t wr = cos_q15[k];
+            int16_t wi = sin_q15[k];
+            int32_t tr = mul(bi, wr) - mul(br, wi);
+            int32_t ti = -mul(br, wr) - mul(bi, wi);
+            out[0] = (ar + tr) >> 1;
+            out[1] = (ai + ti) >> 1;
+        }
+
+        /// converts the half complex FFT into the bins of the real FFT
+        void split() {
+            int32_t *c = data.data();
+            // dc: the nyquist bin is not stored
+            c[0] = c[0] + c[1];
+            c[1] = 0;
+            for (int k = 1; k <= half / 2; k++) {
+                int mk = half - k;
+                int32_t zk[2] = {c[2 * k], c[2 * k + 1]};
+                int32_t zmk[2] = {c[2 * mk], c[2 * mk + 1]};
+                splitBin(k, zk, zmk, c + 2 * k);
+                if (mk != k) splitBin(mk, zmk, zk, c + 2 * mk);
+            }
+        }
+
+        /// integer square root
+        static uint32_t isqrt(uint64_t value) {
+            uint64_t result = 0;
+            uint64_t bit = 1ULL << 62;
+            while (bit > value) bit >>= 2;
+            while (bit != 0) {
+                if (value >= result + bit) {
+                    value -= result + bit;
+                    result = (result >> 1) + bit;
+                } else {
+                    result >>= 1;
+                }
+                bit >>= 2;
+            }
+            return result;
+        }
+};
+
+/**
+ * @brief AudioFFT using the portable fixed point driver: the samples are
+ * passed to the driver as integers w/o any float conversion.
+ * @ingroup fft-fixed
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioFixedPointFFT : public AudioFFTBase {
+    public:
+        AudioFixedPointFFT():AudioFFTBase(new FFTDriverFixedPoint()) {}
+
+        /// Provides the interleaved complex result array
+        int32_t *array() {
+            return driverEx()->array();
+        }
+
+        FFTDriverFixedPoint* driverEx() {
+            return (FFTDriverFixedPoint*)driver();
+        }
+};
+
+}
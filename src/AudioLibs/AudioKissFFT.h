@@ -38,6 +38,7 @@ class FFTDriverKissFFT : public FFTDriver {
         }
         void setValue(int idx, float value) override {
             p_data[idx].r  = value; 
+            p_data[idx].i  = 0.0f; 
         }
 
         void fft() override {
@@ -64,7 +65,7 @@ class FFTDriverKissFFT : public FFTDriver {
 
         bool isReverseFFT() override {return true;}
 
-        float getValue(int idx) override { return p_data[idx].r };
+        float getValue(int idx) override { return p_data[idx].r; }
 
         bool setBin(int pos, float real, float img) override {
             if (pos>=len) return false;
@@ -74,8 +75,8 @@ class FFTDriverKissFFT : public FFTDriver {
         }
         bool getBin(int pos, FFTBin &bin) override { 
             if (pos>=len) return false;
-            bin.real = p_data[idx].r;
-            bin.img = p_data[idx].i;
+            bin.real = p_data[pos].r;
+            bin.img = p_data[pos].i;
             return true;
         }
 
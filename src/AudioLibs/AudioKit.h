@@ -259,15 +259,19 @@ class AudioKitStream : public AudioStream {
   void setAudioInfo(AudioInfo info) override {
     TRACEI();
 
-    if (cfg.sample_rate != info.sample_rate
+    if ((cfg.sample_rate != info.sample_rate || cfg.channels != info.channels)
     && cfg.bits_per_sample == info.bits_per_sample
-    && cfg.channels == info.channels
     && is_started) {
-      // update sample rate only
+      // the codec does not need to be restarted: update the sample rate only
+      // if it is using a different setting
       LOGW("Update sample rate: %d", info.sample_rate);
+      audio_hal_iface_samples_t old_rate = cfg.toSampleRate();
       cfg.sample_rate = info.sample_rate;
+      cfg.channels = info.channels;
       i2s_stream.setAudioInfo(cfg);
-      kit.setSampleRate(cfg.toSampleRate());
+      if (cfg.toSampleRate() != old_rate) {
+        kit.setSampleRate(cfg.toSampleRate());
+      }
     } else if (cfg.sample_rate != info.sample_rate
     || cfg.bits_per_sample != info.bits_per_sample
     || cfg.channels != info.channels
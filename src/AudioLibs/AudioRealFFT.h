@@ -60,24 +60,49 @@ class FFTDriverRealFFT : public FFTDriver {
 
         /// magnitude w/o sqrt
         float magnitudeFast(int idx) override {
-            return (p_x[idx] * p_x[idx] + p_f[idx] * p_f[idx]);
+            int half = len / 2;
+            float img = (idx > 0 && idx < half) ? p_f[half + idx] : 0.0f;
+            return (p_f[idx] * p_f[idx] + img * img);
+        }
+
+        /// magnitudes w/o sqrt directly from the packed result
+        void magnitudesFast(float *result, int n) override {
+            int half = len / 2;
+            if (n > half) n = half;
+            if (n <= 0) return;
+            const float *re = p_f;
+            const float *im = p_f + half;
+            result[0] = re[0] * re[0];
+            for (int j=1;j<n;j++){
+                result[j] = re[j] * re[j] + im[j] * im[j];
+            }
         }
 
         bool isValid() override{ return p_fft_object!=nullptr; }
 
+        float *inputArray() override { return p_x; }
+
         /// get Real value
         float getValue(int idx) override { return p_x[idx];}
 
+        /// sets the value of a bin: FFTReal stores the real values in
+        /// f[0...len/2] and the negative imaginary values in f[len/2+1...len-1]
         bool setBin(int pos, float real, float img) override {
             if (pos>=len) return false;
-            p_x[pos] = real;
-            p_f[pos] = img;
+            int half = len / 2;
+            // the upper bins are the conjugate of the lower bins
+            if (pos > half) return true;
+            p_f[pos] = real;
+            if (pos > 0 && pos < half) p_f[half + pos] = -img;
             return true;
         }
         bool getBin(int pos, FFTBin &bin) override { 
             if (pos>=len) return false;
-            bin.real = p_x[pos];
-            bin.img = p_f[pos];
+            int half = len / 2;
+            int idx = pos > half ? len - pos : pos;
+            bin.real = p_f[idx];
+            bin.img = (idx > 0 && idx < half) ? -p_f[half + idx] : 0.0f;
+            if (pos > half) bin.img = -bin.img;
             return true;
         }
 
@@ -117,4 +142,176 @@ class AudioRealFFT : public AudioFFTBase {
         }
 };
 
+/// Determines log2 of the FFT length at compile time
+template <int N> struct FFTLength {
+    static_assert(N >= 8 && (N & (N - 1)) == 0, "length must be a power of 2 >= 8");
+    enum { L2 = 1 + FFTLength<N / 2>::L2 };
+};
+template <> struct FFTLength<4> { enum { L2 = 2 }; };
+
+/**
+ * @brief Driver for RealFFT with a length which is defined at compile time:
+ * it uses FFTRealFixLen where the passes are unrolled by the compiler and
+ * the buffers are fixed arrays.
+ * @ingroup fft-real
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam N length of the FFT (power of 2: e.g. 256 - 4096)
+ */
+template <int N>
+class FFTDriverRealFFTFixed : public FFTDriver {
+    public:
+        bool begin(int len) override {
+            if (len != N) {
+                LOGE("Invalid length %d: expected %d", len, N);
+                return false;
+            }
+            return true;
+        }
+        void end() override {}
+
+        void setValue(int idx, float value) override{
+            x[idx] = value;
+        }
+
+        void fft() override{
+            fft_object.do_fft(f, x);
+        };
+
+        /// Inverse fft - convert fft result back to time domain (samples)
+        void rfft() override{
+           fft_object.do_ifft(f, x);
+        }
+
+        bool isReverseFFT() override { return true;}
+
+        float magnitude(int idx) override {
+            return sqrtf(magnitudeFast(idx));
+        }
+
+        /// magnitude w/o sqrt
+        float magnitudeFast(int idx) override {
+            float img = (idx > 0 && idx < HALF) ? f[HALF + idx] : 0.0f;
+            return f[idx] * f[idx] + img * img;
+        }
+
+        /// magnitudes w/o sqrt directly from the packed result
+        void magnitudesFast(float *result, int n) override {
+            if (n > HALF) n = HALF;
+            if (n <= 0) return;
+            const float *re = f;
+            const float *im = f + HALF;
+            result[0] = re[0] * re[0];
+            for (int j=1;j<n;j++){
+                result[j] = re[j] * re[j] + im[j] * im[j];
+            }
+        }
+
+        bool isValid() override{ return true; }
+
+        float *inputArray() override { return x; }
+
+        /// get Real value
+        float getValue(int idx) override { return x[idx];}
+
+        /// sets the value of a bin: FFTReal stores the real values in
+        /// f[0...len/2] and the negative imaginary values in f[len/2+1...len-1]
+        bool setBin(int pos, float real, float img) override {
+            if (pos>=N) return false;
+            // the upper bins are the conjugate of the lower bins
+            if (pos > HALF) return true;
+            f[pos] = real;
+            if (pos > 0 && pos < HALF) f[HALF + pos] = -img;
+            return true;
+        }
+        bool getBin(int pos, FFTBin &bin) override {
+            if (pos>=N) return false;
+            int idx = pos > HALF ? N - pos : pos;
+            bin.real = f[idx];
+            bin.img = (idx > 0 && idx < HALF) ? -f[HALF + idx] : 0.0f;
+            if (pos > HALF) bin.img = -bin.img;
+            return true;
+        }
+
+        /// Index of the bin with the biggest magnitude (w/o virtual calls)
+        int maxBin(float &power) {
+            int result = 0;
+            power = f[0] * f[0];
+            for (int j=1;j<HALF;j++){
+                float value = f[j] * f[j] + f[HALF + j] * f[HALF + j];
+                if (value > power) {
+                    power = value;
+                    result = j;
+                }
+            }
+            return result;
+        }
+
+        static const int HALF = N / 2;
+        ffft::FFTRealFixLen<FFTLength<N>::L2> fft_object;
+        float x[N]; // real
+        float f[N]; // complex
+};
+
+/**
+ * @brief AudioFFT using RealFFT with a length which is defined at compile
+ * time. The length in the configuration is set automatically.
+ * @ingroup fft-real
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam N length of the FFT (power of 2: e.g. 256 - 4096)
+ */
+template <int N>
+class AudioRealFFTFixed : public AudioFFTBase {
+    public:
+        AudioRealFFTFixed():AudioFFTBase(new FFTDriverRealFFTFixed<N>()) {
+            cfg.length = N;
+        }
+
+        AudioRealFFTFixed(Print &out):AudioFFTBase(new FFTDriverRealFFTFixed<N>()) {
+            cfg.length = N;
+            setOutput(out);
+        }
+
+        AudioFFTConfig defaultConfig() {
+            AudioFFTConfig result = AudioFFTBase::defaultConfig();
+            result.length = N;
+            return result;
+        }
+
+        bool begin(AudioFFTConfig info) {
+            info.length = N;
+            return AudioFFTBase::begin(info);
+        }
+
+        bool begin() override {
+            cfg.length = N;
+            return AudioFFTBase::begin();
+        }
+
+        /// Determines the result values in the max magnitude bin
+        AudioFFTResult result() {
+            AudioFFTResult ret_value;
+            float power = 0;
+            ret_value.bin = driverEx()->maxBin(power);
+            ret_value.magnitude = sqrtf(power);
+            ret_value.frequency = frequency(ret_value.bin);
+            return ret_value;
+        }
+
+        /// Provides the real array returned by the FFT
+        float* realArray() {
+            return driverEx()->x;
+        }
+
+        /// Provides the complex array returned by the FFT
+        float *imgArray() {
+            return driverEx()->f;
+        }
+
+        FFTDriverRealFFTFixed<N>* driverEx() {
+            return (FFTDriverRealFFTFixed<N>*)driver();
+        }
+};
+
 }
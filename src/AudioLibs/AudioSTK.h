@@ -2,11 +2,17 @@
 
 #include "AudioConfig.h"
 #include "AudioEffects/AudioEffect.h"
+#include "AudioTools/AudioKernels.h"
 #ifdef ESP32
 #  include "freertos/FreeRTOS.h"
 #endif
 #include "StkAll.h"
 
+/// Number of frames which are requested from the instrument in one call
+#ifndef STK_BLOCK_FRAMES
+#  define STK_BLOCK_FRAMES 128
+#endif
+
 namespace audio_tools {
 
 /**
@@ -19,6 +25,9 @@ namespace audio_tools {
  * it was created in 1995. In the 90s the computers had limited processor power and memory available. 
  * In todays world we can get some cheap Microcontrollers, which provide almost the same capabilities.
  *
+ * The samples are requested from the instrument in blocks of STK_BLOCK_FRAMES frames,
+ * which are converted to integers in one pass.
+ *
  * @ingroup generator
  * @tparam T 
  */
@@ -53,6 +62,8 @@ class STKGenerator : public SoundGenerator<T> {
             SoundGenerator<T>::begin(cfg);
             max_value = NumberConverter::maxValue(sizeof(T)*8);
             stk::Stk::setSampleRate(SoundGenerator<T>::info.sample_rate);
+            // allocate the block once
+            frames.resize(STK_BLOCK_FRAMES, 1);
             return true;
         }
 
@@ -65,9 +76,29 @@ class STKGenerator : public SoundGenerator<T> {
             return result;
         }
 
+        /// Provides n samples: the instrument is called once per block
+        size_t readSamples(T *out, size_t n) override {
+            if (p_instrument==nullptr) {
+                memset(out, 0, n * sizeof(T));
+                return n;
+            }
+            size_t pos = 0;
+            while (pos < n) {
+                size_t len = min(n - pos, (size_t)STK_BLOCK_FRAMES);
+                // a smaller size does not reallocate the memory
+                frames.resize(len, 1);
+                p_instrument->tick(frames);
+                const stk::StkFloat *plane = &frames[0];
+                AudioKernels::fromPlanar(&plane, out + pos, 1, len);
+                pos += len;
+            }
+            return n;
+        }
+
     protected:
         StkCls *p_instrument=nullptr;
         T max_value;
+        stk::StkFrames frames;
 
 };
 
@@ -2,7 +2,9 @@
 
 #include "AudioConfig.h"
 #include "AudioTools/AudioOutput.h"
+#include "AudioTools/Buffers.h"
 #include "AudioCodecs/CodecWAV.h"
+#include "AudioTools/AudioMetrics.h"
 #include "HttpServer.h"
 #include "HttpExtensions.h"
 
@@ -74,6 +76,11 @@ class AudioServerEx : public AudioOutput {
         
         // handling of WAV
         p_server->addExtension(*p_stream);
+        // metrics in the Prometheus text format
+        if (p_metrics!=nullptr){
+            metrics_ctx[0] = p_metrics;
+            p_server->on(metrics_path, tinyhttp::T_GET, replyMetrics, metrics_ctx, 1);
+        }
         return p_server->begin(info.port, info.ssid, info.password);
     }
 
@@ -91,17 +98,44 @@ class AudioServerEx : public AudioOutput {
     /// Web server supports write so that we can e.g. use is as destination for the audio player.
     size_t write(const uint8_t* data, size_t len) override {
         if (p_stream==nullptr) return 0;
+        if (is_non_blocking) {
+            // never wait for the network: keep the data for copy()
+            if ((size_t)pending_buffer.availableForWrite() < len) flushPending();
+            return pending_buffer.writeArray(data, len);
+        }
         return p_stream->write((uint8_t*)data, len);
     }
 
     int availableForWrite() override {
         if (p_stream==nullptr) return 0;
+        if (is_non_blocking) return pending_buffer.availableForWrite();
         return p_stream->availableForWrite();
     }
 
+    /// Activates the asynchronous sending: write() stores the data in a pending
+    /// buffer which is sent to the clients in partial blocks by copy(), so that
+    /// the audio producing task never blocks on the network.
+    void setNonBlocking(bool active, int bufferSize = DEFAULT_BUFFER_SIZE * 4) {
+        is_non_blocking = active;
+        pending_buffer.resize(active ? bufferSize : 0);
+        pending_buffer.reset();
+    }
+
+    /// Number of bytes which are waiting to be sent
+    int pending() { return pending_buffer.available(); }
+
+    /// Serves the metrics in the Prometheus text format on the indicated path:
+    /// call before begin()
+    void setMetrics(AudioMetrics &metrics, const char* path = "/metrics") {
+        p_metrics = &metrics;
+        metrics_path = path;
+    }
+
     /// Needs to be called if the data was provided as input Stream in the AudioServerExConfig
+    /// or in the non blocking mode
     virtual void copy() {
         if (p_server!=nullptr){
+            if (is_non_blocking) flushPending();
             p_server->copy();
         }
     }
@@ -111,6 +145,31 @@ class AudioServerEx : public AudioOutput {
     WiFiServer wifi;
     HttpServer *p_server;
     ExtensionStream *p_stream=nullptr;
+    RingBuffer<uint8_t> pending_buffer{0};
+    bool is_non_blocking = false;
+    int max_write_size = 512;
+    AudioMetrics *p_metrics = nullptr;
+    const char* metrics_path = "/metrics";
+    void* metrics_ctx[1] = {nullptr};
+
+    static void replyMetrics(tinyhttp::HttpServer *server, const char* requestPath, tinyhttp::HttpRequestHandlerLine *hl) {
+        AudioMetrics *p_metrics = (AudioMetrics*) hl->context[0];
+        server->reply(AUDIO_METRICS_MIME, p_metrics->text(), 200);
+    }
+
+    /// Sends the pending data as much as the clients accept
+    void flushPending() {
+        while (pending_buffer.available() > 0) {
+            int len = pending_buffer.readPtrSize();
+            int available = p_stream->availableForWrite();
+            int max_len = available > 0 ? available : max_write_size;
+            if (len > max_len) len = max_len;
+            int written = p_stream->write(pending_buffer.readPtr(), len);
+            if (written <= 0) break;
+            pending_buffer.consume(written);
+            if (written < len || available <= 0) break;
+        }
+    }
 
     virtual tinyhttp::Str* getReplyHeader() {
         return nullptr;
@@ -73,6 +73,9 @@ public:
   }
 
   virtual Stream *selectStream(const char *path) override {
+    // update the index position if the path is in the index
+    int pos = idx.indexOf(path);
+    if (pos >= 0) idx_pos = pos;
     file.close();
     file = SD.open(path);
     file_name = file.name();
@@ -84,9 +87,16 @@ public:
   /// Dylan.*"
   void setFileFilter(const char *filter) { file_name_pattern = filter; }
 
+  /// Stores a hash table in the index, so that selectStream(path) can
+  /// determine the index position: call before begin()
+  void setPathLookup(bool active) { idx.setPathLookup(active); }
+
   /// Provides the current index position
   int index() { return idx_pos; }
 
+  /// Moves the actual file to the indicated byte position
+  bool seek(size_t pos) override { return file.seek(pos); }
+
   /// provides the actual file name
   const char *toStr() { return file_name; }
 
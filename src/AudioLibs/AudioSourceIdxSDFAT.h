@@ -97,33 +97,32 @@ class AudioSourceIdxSDFAT : public AudioSource {
   virtual Stream *selectStream(int index) override {
     LOGI("selectStream: %d", index);
     idx_pos = index;
-    return selectStream(idx[index]);
+    return openStream(idx[index]);
   }
 
   virtual Stream *selectStream(const char *path) override {
-    file.close();
-    if (path == nullptr) {
-      LOGE("Filename is null")
-      return nullptr;
-    }
-
-    // AudioFile new_file;
-    if (!file.open(path, O_RDONLY)) {
-      LOGE("Open error: '%s'", path);
+    if (path != nullptr) {
+      // update the index position if the path is in the index
+      int pos = idx.indexOf(path);
+      if (pos >= 0) idx_pos = pos;
     }
-
-    LOGI("-> selectStream: %s", path);
-    // file = new_file;
-    return &file;
+    return openStream(path);
   }
 
   /// Defines the regex filter criteria for selecting files. E.g. ".*Bob
   /// Dylan.*"
   void setFileFilter(const char *filter) { file_name_pattern = filter; }
 
+  /// Stores a hash table in the index, so that selectStream(path) can
+  /// determine the index position: call before begin()
+  void setPathLookup(bool active) { idx.setPathLookup(active); }
+
   /// Provides the current index position
   int index() { return idx_pos; }
 
+  /// Moves the actual file to the indicated byte position
+  bool seek(size_t pos) override { return file.seek(pos); }
+
   /// provides the actual file name
   const char *toStr() { return file_name; }
 
@@ -151,6 +150,23 @@ class AudioSourceIdxSDFAT : public AudioSource {
   int cs;
   bool owns_cfg = false;
 
+  Stream *openStream(const char *path) {
+    file.close();
+    if (path == nullptr) {
+      LOGE("Filename is null")
+      return nullptr;
+    }
+
+    // AudioFile new_file;
+    if (!file.open(path, O_RDONLY)) {
+      LOGE("Open error: '%s'", path);
+    }
+
+    LOGI("-> selectStream: %s", path);
+    // file = new_file;
+    return &file;
+  }
+
   const char *getFileName(AudioFile &file) {
     static char name[MAX_FILE_LEN];
     file.getName(name, MAX_FILE_LEN);
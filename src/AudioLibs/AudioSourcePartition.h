@@ -0,0 +1,202 @@
+#pragma once
+
+#include "AudioLogger.h"
+#include "AudioTools/AudioSource.h"
+#include "AudioTools/AudioStreams.h"
+#if defined(ESP32)
+#  include "esp_partition.h"
+#endif
+
+/// Max length of a clip name in the index (incl. the terminating 0)
+#ifndef AUDIO_PARTITION_NAME_LEN
+#  define AUDIO_PARTITION_NAME_LEN 24
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief AudioSource for AudioPlayer which provides the clips (e.g. prompts
+ * and sound effects) which are stored in a raw data partition of the flash:
+ * the whole partition is mapped into the address space with
+ * esp_partition_mmap(), so the clips are provided as MemoryStream w/o any
+ * copy, file system or RAM buffer and they start w/o delay.
+ *
+ * The partition starts with an index which is followed by the clip data.
+ * All numbers are 32 bit little endian:
+ * - "ACLP" followed by the number of clips
+ * - for each clip: the offset (relative to the start of the partition), the
+ *   size and the name with AUDIO_PARTITION_NAME_LEN bytes (0 terminated)
+ *
+ * The image can be written with esptool or parttool.py to a partition with
+ * the type data (e.g. with the label "audio"). On other platforms (or for
+ * images in PROGMEM) you can provide the image with begin(data, len).
+ * @ingroup player
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioSourcePartition : public AudioSource {
+ public:
+  /// Default constructor with the label of the data partition
+  AudioSourcePartition(const char *partitionLabel = "audio") {
+    label = partitionLabel;
+  }
+
+  ~AudioSourcePartition() { end(); }
+
+#if defined(ESP32)
+  /// Maps the partition and reads the index
+  virtual void begin() override {
+    TRACED();
+    if (p_image != nullptr) {
+      idx_pos = 0;
+      return;
+    }
+    const esp_partition_t *partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == nullptr) {
+      LOGE("partition not found: %s", label);
+      return;
+    }
+    const void *ptr = nullptr;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    esp_err_t rc = esp_partition_mmap(partition, 0, partition->size,
+                                      ESP_PARTITION_MMAP_DATA, &ptr,
+                                      &mmap_handle);
+#else
+    esp_err_t rc = esp_partition_mmap(partition, 0, partition->size,
+                                      SPI_FLASH_MMAP_DATA, &ptr, &mmap_handle);
+#endif
+    if (rc != ESP_OK) {
+      LOGE("esp_partition_mmap failed: %d", rc);
+      return;
+    }
+    is_mapped = true;
+    if (!begin((const uint8_t *)ptr, partition->size)) end();
+  }
+#else
+  virtual void begin() override { idx_pos = 0; }
+#endif
+
+  /// Uses the indicated image (e.g. from PROGMEM) instead of the partition
+  bool begin(const uint8_t *image, size_t len) {
+    TRACED();
+    p_image = image;
+    image_size = len;
+    idx_pos = 0;
+    clip_count = 0;
+    if (len < 8 || memcmp(image, "ACLP", 4) != 0) {
+      LOGE("invalid index");
+      p_image = nullptr;
+      return false;
+    }
+    uint32_t count = readLE32(image + 4);
+    if (count > (len - 8) / entry_size) {
+      LOGE("invalid number of clips: %u", (unsigned)count);
+      p_image = nullptr;
+      return false;
+    }
+    clip_count = count;
+    LOGI("clips: %d", clip_count);
+    return true;
+  }
+
+  /// Releases the mapping
+  void end() {
+#if defined(ESP32)
+    if (is_mapped) {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+      esp_partition_munmap(mmap_handle);
+#else
+      spi_flash_munmap(mmap_handle);
+#endif
+      is_mapped = false;
+    }
+#endif
+    p_image = nullptr;
+    image_size = 0;
+    clip_count = 0;
+    stream.setValue(nullptr, 0);
+  }
+
+  virtual Stream *nextStream(int offset = 1) override {
+    LOGI("nextStream: %d", offset);
+    return selectStream(idx_pos + offset);
+  }
+
+  virtual Stream *selectStream(int index) override {
+    LOGI("selectStream: %d", index);
+    if (index < 0 || index >= clip_count) return nullptr;
+    const uint8_t *entry = p_image + 8 + index * entry_size;
+    uint32_t offset = readLE32(entry);
+    uint32_t size = readLE32(entry + 4);
+    if (offset > image_size || size > image_size - offset) {
+      LOGE("invalid clip: %d", index);
+      return nullptr;
+    }
+    idx_pos = index;
+    clip_name = (const char *)entry + 8;
+    stream.setValue(p_image + offset, size, FLASH_RAM);
+    stream.begin();
+    return &stream;
+  }
+
+  virtual Stream *selectStream(const char *path) override {
+    int index = indexOf(path);
+    LOGI("-> selectStream: %s", path);
+    return index < 0 ? nullptr : selectStream(index);
+  }
+
+  /// Provides the index of the clip with the indicated name: -1 if not found
+  int indexOf(const char *name) {
+    for (int j = 0; j < clip_count; j++) {
+      const char *entry_name = (const char *)p_image + 8 + j * entry_size + 8;
+      if (strncmp(entry_name, name, AUDIO_PARTITION_NAME_LEN) == 0) return j;
+    }
+    return -1;
+  }
+
+  /// Provides the current index position
+  int index() { return idx_pos; }
+
+  /// Moves the actual clip to the indicated byte position
+  bool seek(size_t pos) override {
+    stream.begin();
+    if (pos > (size_t)stream.available()) return false;
+    stream.consumeReadBuffer(pos);
+    return true;
+  }
+
+  /// Provides the name of the actual clip
+  const char *toStr() { return clip_name; }
+
+  // provides default setting go to the next
+  virtual bool isAutoNext() override { return true; }
+
+  /// Provides the number of clips
+  long size() { return clip_count; }
+
+ protected:
+  static const int entry_size = 8 + AUDIO_PARTITION_NAME_LEN;
+  const char *label = nullptr;
+  const uint8_t *p_image = nullptr;
+  size_t image_size = 0;
+  int clip_count = 0;
+  int idx_pos = 0;
+  const char *clip_name = nullptr;
+  MemoryStream stream{nullptr, 0};
+#if defined(ESP32)
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+  esp_partition_mmap_handle_t mmap_handle;
+#else
+  spi_flash_mmap_handle_t mmap_handle;
+#endif
+  bool is_mapped = false;
+#endif
+
+  static uint32_t readLE32(const uint8_t *data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+           ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+  }
+};
+
+}  // namespace audio_tools
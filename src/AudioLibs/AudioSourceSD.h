@@ -4,6 +4,7 @@
 #include "AudioLogger.h"
 #include "AudioTools/AudioSource.h"
 #include "AudioLibs/SDDirect.h"
+#include "AudioLibs/SDReadAhead.h"
 #include "SD.h"
 #include "SPI.h"
 
@@ -70,16 +71,18 @@ public:
     file_name = idx[index];
     if (file_name==nullptr) return nullptr;
     LOGI("Using file %s", file_name);
+    read_ahead.end();
     file = SD.open(file_name);
-    return file ? &file : nullptr;
+    return provideStream();
   }
 
   virtual Stream *selectStream(const char *path) override {
+    read_ahead.end();
     file.close();
     file = SD.open(path);
     file_name = file.name();
     LOGI("-> selectStream: %s", path);
-    return file ? &file : nullptr;
+    return provideStream();
   }
 
   /// Defines the regex filter criteria for selecting files. E.g. ".*Bob
@@ -89,6 +92,15 @@ public:
   /// Provides the current index position
   int index() { return idx_pos; }
 
+  /// Moves the actual file to the indicated byte position
+  bool seek(size_t pos) override {
+    return read_ahead_size > 0 ? read_ahead.seek(pos) : file.seek(pos);
+  }
+
+  /// Reads the files in big aligned blocks of the indicated size (e.g. 16384)
+  /// which are filled in the background if possible: 0 to deactivate
+  void setReadAheadSize(size_t size) { read_ahead_size = size; }
+
   /// provides the actual file name
   const char *toStr() { return file_name; }
 
@@ -108,6 +120,8 @@ protected:
   SDDirect<fs::SDFS,fs::File> idx{SD};
 #endif
   File file;
+  SDReadAheadStream<File> read_ahead;
+  size_t read_ahead_size = 0;
   size_t idx_pos = 0;
   const char *file_name;
   const char *exension = nullptr;
@@ -117,7 +131,14 @@ protected:
   bool is_sd_setup = false;
   int cs;
 
-
+  /// Provides the file or the read ahead stream
+  Stream *provideStream() {
+    if (!file) return nullptr;
+    if (read_ahead_size == 0) return &file;
+    read_ahead.setBlockSize(read_ahead_size);
+    read_ahead.begin(file);
+    return &read_ahead;
+  }
 };
 
 } // namespace audio_tools
\ No newline at end of file
@@ -10,6 +10,7 @@
 
 #define USE_SDFAT
 #include "AudioLibs/SDDirect.h"
+#include "AudioLibs/SDReadAhead.h"
 
 // SD_FAT_TYPE = 0 for SdFat/File as defined in SdFatConfig.h,
 // 1 for FAT16/FAT32, 2 for exFAT, 3 for FAT16/FAT32 and exFAT.
@@ -105,6 +106,7 @@ class AudioSourceSDFAT : public AudioSource {
   }
 
   virtual Stream *selectStream(const char *path) override {
+    read_ahead.end();
     file.close();
     if (path == nullptr) {
       LOGE("Filename is null")
@@ -119,7 +121,7 @@ class AudioSourceSDFAT : public AudioSource {
     LOGI("-> selectStream: %s", path);
     strncpy(file_name, path, MAX_FILE_LEN);
     // file = new_file;
-    return &file;
+    return provideStream();
   }
 
   /// Defines the regex filter criteria for selecting files. E.g. ".*Bob
@@ -129,6 +131,16 @@ class AudioSourceSDFAT : public AudioSource {
   /// Provides the current index position
   int index() { return idx_pos; }
 
+  /// Moves the actual file to the indicated byte position
+  bool seek(size_t pos) override {
+    return read_ahead_size > 0 ? read_ahead.seek(pos) : file.seek(pos);
+  }
+
+  /// Reads the files in big aligned blocks of the indicated size (e.g. 16384)
+  /// which are filled in the background if possible: 0 to deactivate.
+  /// Contiguous files are read directly from the card sectors.
+  void setReadAheadSize(size_t size) { read_ahead_size = size; }
+
   /// provides the actual file name
   const char *toStr() { return file_name; }
 
@@ -146,6 +158,10 @@ class AudioSourceSDFAT : public AudioSource {
   SdSpiConfig *p_cfg = nullptr;
   AudioFs sd;
   AudioFile file;
+  SDReadAheadStream<AudioFile> read_ahead;
+  size_t read_ahead_size = 0;
+  uint32_t first_sector = 0;
+  uint32_t last_sector = 0;
   SDDirect<AudioFs, AudioFile> idx{sd};
   size_t idx_pos = 0;
   char file_name[MAX_FILE_LEN];
@@ -162,6 +178,29 @@ class AudioSourceSDFAT : public AudioSource {
     file.getName(name, MAX_FILE_LEN);
     return name;
   }
+
+  /// Provides the file or the read ahead stream
+  Stream *provideStream() {
+    if (read_ahead_size == 0 || !file) return &file;
+    read_ahead.setBlockSize(read_ahead_size);
+    // fast path for contiguous files
+    if (file.contiguousRange(&first_sector, &last_sector)) {
+      read_ahead.setSectorReader(readSectors, this);
+    } else {
+      read_ahead.setSectorReader(nullptr);
+    }
+    read_ahead.begin(file);
+    return &read_ahead;
+  }
+
+  /// Reads the sectors of a contiguous file directly from the card
+  static bool readSectors(uint32_t pos, uint8_t *data, size_t len, void *ref) {
+    AudioSourceSDFAT *self = (AudioSourceSDFAT *)ref;
+    uint32_t sector = self->first_sector + pos / SD_SECTOR_SIZE;
+    size_t count = len / SD_SECTOR_SIZE;
+    if (count == 0 || sector + count - 1 > self->last_sector) return false;
+    return self->sd.card()->readSectors(sector, data, count);
+  }
 };
 
 }  // namespace audio_tools
@@ -6,6 +6,7 @@
 #include "FS.h"
 #include "SD_MMC.h"
 #include "AudioLibs/SDDirect.h"
+#include "AudioLibs/SDReadAhead.h"
 
 namespace audio_tools {
 
@@ -69,16 +70,18 @@ public:
     file_name = idx[index];
     if (file_name==nullptr) return nullptr;
     LOGI("Using file %s", file_name);
+    read_ahead.end();
     file = SD_MMC.open(file_name);
-    return file ? &file : nullptr;
+    return provideStream();
   }
 
   virtual Stream *selectStream(const char *path) override {
+    read_ahead.end();
     file.close();
     file = SD_MMC.open(path);
     file_name = file.name();
     LOGI("-> selectStream: %s", path);
-    return file ? &file : nullptr;
+    return provideStream();
   }
 
   /// Defines the regex filter criteria for selecting files. E.g. ".*Bob
@@ -88,6 +91,15 @@ public:
   /// Provides the current index position
   int index() { return idx_pos; }
 
+  /// Moves the actual file to the indicated byte position
+  bool seek(size_t pos) override {
+    return read_ahead_size > 0 ? read_ahead.seek(pos) : file.seek(pos);
+  }
+
+  /// Reads the files in big aligned blocks of the indicated size (e.g. 16384)
+  /// which are filled in the background if possible: 0 to deactivate
+  void setReadAheadSize(size_t size) { read_ahead_size = size; }
+
   /// provides the actual file name
   const char *toStr() { return file_name; }
 
@@ -103,6 +115,8 @@ public:
 protected:
   SDDirect<fs::SDMMCFS,fs::File> idx{SD_MMC};
   File file;
+  SDReadAheadStream<File> read_ahead;
+  size_t read_ahead_size = 0;
   size_t idx_pos = 0;
   const char *file_name;
   const char *exension = nullptr;
@@ -110,6 +124,15 @@ protected:
   const char *file_name_pattern = "*";
   bool setup_index = true;
   bool is_sd_setup = false;
+
+  /// Provides the file or the read ahead stream
+  Stream *provideStream() {
+    if (!file) return nullptr;
+    if (read_ahead_size == 0) return &file;
+    read_ahead.setBlockSize(read_ahead_size);
+    read_ahead.begin(file);
+    return &read_ahead;
+  }
 };
 
 } // namespace audio_tools
\ No newline at end of file
@@ -63,6 +63,9 @@ public:
   /// Provides the current index position
   int index() { return idx_pos; }
 
+  /// Moves the actual file to the indicated byte position
+  bool seek(size_t pos) override { return file.seek(pos); }
+
   /// provides the actual file name
   const char *toStr() { return file_name; }
 
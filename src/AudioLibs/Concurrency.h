@@ -6,6 +6,9 @@
  */
 #include "Concurrency/QueueRTOS.h"
 #include "Concurrency/BufferRTOS.h"
+#include "Concurrency/BufferPoolRTOS.h"
 #include "Concurrency/SynchronizedBuffers.h"
+#include "Concurrency/RingBufferLockFree.h"
 #include "Concurrency/Task.h"
-#include "Concurrency/LockGuard.h"
\ No newline at end of file
+#include "Concurrency/LockGuard.h"
+#include "Concurrency/Snapshot.h"
\ No newline at end of file
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "AudioCodecs/AudioEncoded.h"
+#include "AudioLibs/Desktop/File.h"
+#include "AudioTools/StreamCopy.h"
+#include "Concurrency/WorkerPool.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Offline transcoding of files on the desktop which runs faster than
+ * real time: each file is decoded and encoded in its own pipeline (File ->
+ * decoder -> encoder -> File) with a StreamCopy in the offline mode, so that
+ * there are no pacing delays. The independent pipelines are executed by a
+ * WorkerPool. The decoder and encoder are created for each file with the
+ * factory functions. The encoder is started with the AudioInfo which is
+ * reported by the decoder.
+ *
+ * @ingroup io
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BatchTranscoder {
+ public:
+  ~BatchTranscoder() { end(); }
+
+  /// Defines the function which creates the decoder for a file
+  void setDecoderFactory(std::function<AudioDecoder *()> factory) {
+    decoder_factory = factory;
+  }
+
+  /// Defines the function which creates the encoder for a file
+  void setEncoderFactory(std::function<AudioEncoder *()> factory) {
+    encoder_factory = factory;
+  }
+
+  /// Defines the copy buffer size of each pipeline
+  void setBufferSize(int size) { buffer_size = size; }
+
+  /// Starts the indicated number of workers: 0 uses all cores
+  bool begin(int threads = 0, int queueSize = 16) {
+    if (!decoder_factory || !encoder_factory) {
+      LOGE("decoder or encoder factory not defined");
+      return false;
+    }
+    if (threads <= 0) threads = std::thread::hardware_concurrency();
+    if (threads <= 0) threads = 1;
+    resetStatistics();
+    return pool.begin(threads, queueSize);
+  }
+
+  /// Schedules the transcoding of a file: blocks while the queue is full
+  bool add(const char *inputFile, const char *outputFile) {
+    std::string in = inputFile;
+    std::string out = outputFile;
+    return pool.submit([this, in, out]() { transcode(in.c_str(), out.c_str()); });
+  }
+
+  /// Waits until all scheduled files have been processed
+  void waitAll() { pool.waitAll(); }
+
+  /// Waits for the open files and stops the workers
+  void end() { pool.end(); }
+
+  /// Transcodes a single file in the calling thread
+  bool transcode(const char *inputFile, const char *outputFile) {
+    File in(inputFile);
+    if (!in) {
+      LOGE("Could not open %s", inputFile);
+      files_failed++;
+      return false;
+    }
+    File out;
+    out.open(outputFile, FILE_WRITE);
+    if (!out) {
+      LOGE("Could not create %s", outputFile);
+      files_failed++;
+      return false;
+    }
+
+    std::unique_ptr<AudioDecoder> decoder(decoder_factory());
+    std::unique_ptr<AudioEncoder> encoder(encoder_factory());
+    EncodedAudioOutput enc(&out, encoder.get());
+    EncodedAudioOutput dec(&enc, decoder.get());
+    EncoderStarter starter(enc);
+    dec.addNotifyAudioChange(starter);
+    dec.begin();
+
+    StreamCopy copier(dec, in, buffer_size);
+    copier.setOffline(true, buffer_size);
+    size_t total = copier.copyAll();
+
+    dec.end();
+    enc.end();
+    bytes_written += out.position();
+    out.close();
+    bytes_read += total;
+    if (!starter.isStarted()) {
+      LOGE("No audio data in %s", inputFile);
+      files_failed++;
+      return false;
+    }
+    files_processed++;
+    return true;
+  }
+
+  /// Number of successfully transcoded files
+  int filesProcessed() { return files_processed; }
+
+  /// Number of files which could not be transcoded
+  int filesFailed() { return files_failed; }
+
+  /// Total number of encoded bytes which were read
+  uint64_t bytesRead() { return bytes_read; }
+
+  /// Total number of bytes which were written to the output files
+  uint64_t bytesWritten() { return bytes_written; }
+
+  /// Resets the statistics
+  void resetStatistics() {
+    files_processed = 0;
+    files_failed = 0;
+    bytes_read = 0;
+    bytes_written = 0;
+  }
+
+ protected:
+  /// Starts the encoder when the decoder has determined the AudioInfo
+  class EncoderStarter : public AudioInfoSupport {
+   public:
+    EncoderStarter(EncodedAudioOutput &enc) { p_enc = &enc; }
+    void setAudioInfo(AudioInfo info) override {
+      if (is_started) {
+        if (info != p_enc->audioInfo())
+          LOGW("AudioInfo changed in the middle of the file: ignored");
+        return;
+      }
+      p_enc->setAudioInfo(info);
+      is_started = p_enc->begin();
+    }
+    AudioInfo audioInfo() override { return p_enc->audioInfo(); }
+    bool isStarted() { return is_started; }
+
+   protected:
+    EncodedAudioOutput *p_enc = nullptr;
+    bool is_started = false;
+  };
+
+  WorkerPool pool;
+  std::function<AudioDecoder *()> decoder_factory;
+  std::function<AudioEncoder *()> encoder_factory;
+  int buffer_size = BATCH_BUFFER_SIZE;
+  std::atomic<int> files_processed{0};
+  std::atomic<int> files_failed{0};
+  std::atomic<uint64_t> bytes_read{0};
+  std::atomic<uint64_t> bytes_written{0};
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+
+namespace audio_tools {
+
+/**
+ * @brief Statistics of the audio callback of the desktop audio backends: we
+ * count the callbacks and the xruns (buffer underflows and overflows) and
+ * measure the time which was spent in the callback. The budget is the
+ * duration of the audio which was processed in the last callback: if the
+ * processing takes longer we will get dropouts.
+ * @ingroup io
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CallbackStatistics {
+ public:
+  /// Clears all values
+  void reset() {
+    callback_count = 0;
+    xrun_count = 0;
+    late_count = 0;
+    min_us = 0;
+    max_us = 0;
+    total_us = 0;
+    budget_us = 0;
+  }
+
+  /// Call at the start of the callback
+  void begin() { start_us = micros(); }
+
+  /// Call at the end of the callback with the number of processed frames
+  void end(uint32_t frames, uint32_t sampleRate) {
+    uint32_t used_us = (uint32_t)micros() - start_us;
+    if (callback_count == 0 || used_us < min_us) min_us = used_us;
+    if (used_us > max_us) max_us = used_us;
+    total_us += used_us;
+    if (sampleRate > 0) budget_us = 1000000ull * frames / sampleRate;
+    if (used_us > budget_us) late_count++;
+    callback_count++;
+  }
+
+  /// Records a buffer underflow or overflow
+  void addXRun() { xrun_count++; }
+
+  /// Number of executed callbacks
+  uint32_t callbackCount() { return callback_count; }
+
+  /// Number of buffer underflows or overflows
+  uint32_t xrunCount() { return xrun_count; }
+
+  /// Number of callbacks which took longer than the processed audio
+  uint32_t lateCount() { return late_count; }
+
+  /// Shortest processing time in us
+  uint32_t minUs() { return min_us; }
+
+  /// Longest processing time in us
+  uint32_t maxUs() { return max_us; }
+
+  /// Average processing time in us
+  uint32_t avgUs() {
+    uint32_t count = callback_count;
+    return count == 0 ? 0 : total_us / count;
+  }
+
+  /// Duration of the audio of the last callback in us
+  uint32_t budgetUs() { return budget_us; }
+
+  /// Average processing time relative to the budget (e.g. 0.1 for 10%)
+  float load() { return budget_us == 0 ? 0.0f : (float)avgUs() / budget_us; }
+
+  void logInfo() {
+    LOGI("callbacks: %u, xruns: %u, late: %u, min: %u us, avg: %u us, max: %u "
+         "us, budget: %u us",
+         (unsigned)callbackCount(), (unsigned)xrunCount(),
+         (unsigned)lateCount(), (unsigned)minUs(), (unsigned)avgUs(),
+         (unsigned)maxUs(), (unsigned)budgetUs());
+  }
+
+ protected:
+  // updated in the audio thread and read by the application
+  std::atomic<uint32_t> callback_count{0};
+  std::atomic<uint32_t> xrun_count{0};
+  std::atomic<uint32_t> late_count{0};
+  std::atomic<uint32_t> min_us{0};
+  std::atomic<uint32_t> max_us{0};
+  std::atomic<uint64_t> total_us{0};
+  std::atomic<uint32_t> budget_us{0};
+  uint32_t start_us = 0;
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,142 @@
+#pragma once
+#include "AudioConfig.h"
+#include "AudioTools/AudioOutput.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Receives the data which was sent by a CaptureOutput (e.g. from a
+ * serial port or an UDP socket) and writes the audio data w/o the headers to
+ * the defined output: use an EncodedAudioOutput with a WAVEncoder to create
+ * a WAV file or a CsvOutput. The output is notified about the AudioInfo.
+ * The parser resynchronizes on the magic number, so we can start to receive
+ * at any position. Missing blocks are detected with the sequence numbers.
+ * @ingroup io
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CaptureReceiver : public AudioOutput {
+ public:
+  CaptureReceiver() = default;
+  CaptureReceiver(Print &out) { setOutput(out); }
+  CaptureReceiver(AudioOutput &out) { setOutput(out); }
+  CaptureReceiver(AudioStream &out) { setOutput(out); }
+
+  /// Defines the output for the audio data
+  void setOutput(Print &out) { p_out = &out; }
+
+  /// Defines the output for the audio data which is notified about the
+  /// AudioInfo
+  void setOutput(AudioOutput &out) {
+    p_out = &out;
+    addNotifyAudioChange(out);
+  }
+
+  /// Defines the output for the audio data which is notified about the
+  /// AudioInfo
+  void setOutput(AudioStream &out) {
+    p_out = &out;
+    addNotifyAudioChange(out);
+  }
+
+  bool begin() override {
+    header_len = 0;
+    data_open = 0;
+    block_count = 0;
+    lost_blocks = 0;
+    skipped_bytes = 0;
+    is_first = true;
+    is_active = true;
+    return true;
+  }
+
+  /// Parses the received data
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!is_active) return 0;
+    size_t pos = 0;
+    while (pos < len) {
+      if (data_open > 0) {
+        // audio data of the actual block
+        size_t n = min(len - pos, data_open);
+        if (p_out != nullptr) p_out->write(data + pos, n);
+        data_open -= n;
+        pos += n;
+      } else {
+        pos += parseHeader(data + pos, len - pos);
+      }
+    }
+    return len;
+  }
+
+  /// Reads and processes all available data from the indicated stream
+  size_t copy(Stream &in) {
+    uint8_t buffer[DEFAULT_BUFFER_SIZE];
+    size_t result = 0;
+    while (in.available() > 0) {
+      int n = in.readBytes(buffer, sizeof(buffer));
+      if (n <= 0) break;
+      write(buffer, n);
+      result += n;
+    }
+    return result;
+  }
+
+  /// Number of received blocks
+  uint32_t blockCount() { return block_count; }
+
+  /// Number of missing blocks (from the sequence numbers)
+  uint32_t lostBlocks() { return lost_blocks; }
+
+  /// Number of bytes which were skipped to find the next header
+  uint32_t skippedBytes() { return skipped_bytes; }
+
+  /// Timestamp (in us) of the last block from the sender
+  uint32_t timestampUs() { return header.timestamp_us; }
+
+ protected:
+  Print *p_out = nullptr;
+  CaptureHeader header;
+  uint8_t header_data[CAPTURE_HEADER_SIZE];
+  size_t header_len = 0;
+  size_t data_open = 0;
+  uint32_t next_sequence = 0;
+  uint32_t block_count = 0;
+  uint32_t lost_blocks = 0;
+  uint32_t skipped_bytes = 0;
+  bool is_first = true;
+
+  /// collects the header bytes: returns the number of processed bytes
+  size_t parseHeader(const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    while (pos < len && header_len < CAPTURE_HEADER_SIZE) {
+      header_data[header_len++] = data[pos++];
+      // resync: the start must match the magic number
+      if (header_len <= 4 &&
+          header_data[header_len - 1] != CAPTURE_MAGIC[header_len - 1]) {
+        // the actual byte might be the start of the next header
+        uint8_t last = header_data[header_len - 1];
+        bool is_start = last == CAPTURE_MAGIC[0];
+        skipped_bytes += is_start ? header_len - 1 : header_len;
+        header_len = is_start ? 1 : 0;
+        header_data[0] = last;
+      }
+    }
+    if (header_len < CAPTURE_HEADER_SIZE) return pos;
+    header_len = 0;
+    if (!header.decode(header_data)) return pos;
+    if (!is_first && header.sequence != next_sequence) {
+      lost_blocks += header.sequence - next_sequence;
+    }
+    next_sequence = header.sequence + 1;
+    block_count++;
+    // report format changes
+    if (is_first || header.info != audioInfo()) {
+      setAudioInfo(header.info);
+    }
+    is_first = false;
+    data_open = header.len;
+    return pos;
+  }
+};
+
+}  // namespace audio_tools
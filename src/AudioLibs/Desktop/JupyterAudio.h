@@ -8,6 +8,8 @@
 #include <fstream>
 #include <filesystem>
 #include <stdio.h>
+#include <sstream>
+#include <vector>
 #include "nlohmann/json.hpp"
 #include "xtl/xbase64.hpp"
 
@@ -33,14 +35,37 @@ protected:
 };
 
 
+/**
+ * @brief Simple layer for Print object to write to a std::string
+ */
+class StringOutput : public Print {
+public:
+    StringOutput(std::string &str){
+        p_str = &str;
+    }
+    size_t write(const uint8_t *data, size_t len) override {
+         p_str->append((const char*)data, len);
+         return len;
+    }
+    int availableForWrite() override {
+      return 1024;
+    }
+protected:
+    std::string *p_str=nullptr;
+};
+
 /**
  * @brief Displays audio in a Jupyter as chart
- * Just wrapps a stream to provide the chart data
+ * Just wrapps a stream to provide the chart data. The samples are decimated
+ * to a min/max envelope with one vertical line per column, so the size of
+ * the svg only depends on the width and not on the length of the audio.
  */
 template <typename T> 
 class ChartT {
 public:
   void setup(std::string fName, int channelCount, int channelNo) {
+    // the file is only loaded once
+    if (fName != this->fname) file_data.clear();
     this->fname = fName;
     this->channels = channelCount;
     if (this->channels==0){
@@ -49,6 +74,22 @@ public:
     this->channel = channelNo;
   }
 
+  /// Uses the interleaved samples in memory (which must stay valid) instead
+  /// of the file: the data can be split into 2 parts (e.g. of a RingBuffer)
+  void setData(int channelCount, int channelNo, const T* data, size_t samples, const T* data1=nullptr, size_t samples1=0) {
+    this->fname.clear();
+    this->channels = channelCount;
+    this->channel = channelNo;
+    file_data.clear();
+    spans[0] = Span{data, samples};
+    spans[1] = Span{data1, samples1};
+  }
+
+  /// Defines the max number of columns of the chart (default 1024)
+  void setWidth(int columns) {
+    width = columns;
+  }
+
   int getChannels() {
     return this->channels;
   }
@@ -63,22 +104,23 @@ public:
     str.str("");
     // reset buffer;
     if (channel<channels){
-        ifstream is;
-        is.open(fname, is.binary);
-        is.seekg(wav_header_size, is.beg);
-        std::list<int16_t> audioList;
-        T buffer[channels];
-        size_t rec_size = channels*sizeof(T);
-        while(is.read((char *)buffer, rec_size)){
-            audioList.push_back(transform(buffer[channel]));
-        }
-        string str_size = "102400"; //std::to_string(audioList.size());
-        str << "<style>div.x-svg {width: "<< str_size <<"px; }</style>";
-        str << "<div class='x-svg'><svg viewBox='0 0 "<< str_size << " 100'> <polyline fill='none' stroke='blue' stroke-width='1' points ='";
-        // copy data from input stream
-        size_t idx = 0;
-        for(int16_t sample: audioList){
-            str << idx++ << "," << sample  << " ";
+        if (!fname.empty()) loadFile();
+        size_t frames = (spans[0].samples + spans[1].samples) / channels;
+        size_t columns = std::min(frames, (size_t)width);
+        str << "<style>div.x-svg {width: "<< columns <<"px; }</style>";
+        str << "<div class='x-svg'><svg viewBox='0 0 "<< columns << " 100'> <polyline fill='none' stroke='blue' stroke-width='1' points ='";
+        // min and max of each column
+        size_t frame = 0;
+        for (size_t col = 0; col < columns; col++){
+            size_t end = (col + 1) * frames / columns;
+            int min_value = transform(sample(frame));
+            int max_value = min_value;
+            for (; frame < end; frame++){
+                int value = transform(sample(frame));
+                if (value < min_value) min_value = value;
+                if (value > max_value) max_value = value;
+            }
+            str << col << "," << min_value << " " << col << "," << max_value << " ";
         }
         str << "'/></svg></div>";
     } else {
@@ -88,11 +130,40 @@ public:
   }
 
 protected:
+  struct Span {
+    const T* data = nullptr;
+    size_t samples = 0;
+  };
   std::stringstream str;
   std::string fname;
   const int wav_header_size = 44;
   int channels=0;
   int channel=0;
+  int width=1024;
+  Span spans[2];
+  std::vector<T> file_data;
+
+  /// Reads the samples of the file with one binary read
+  void loadFile() {
+    if (!file_data.empty()) return;
+    ifstream is;
+    is.open(fname, is.binary);
+    is.seekg(0, is.end);
+    long size = (long)is.tellg() - wav_header_size;
+    if (size <= 0) return;
+    file_data.resize(size / sizeof(T));
+    is.seekg(wav_header_size, is.beg);
+    is.read((char *)file_data.data(), file_data.size() * sizeof(T));
+    spans[0] = Span{file_data.data(), file_data.size()};
+    spans[1] = Span();
+  }
+
+  /// Provides the sample of the selected channel
+  T sample(size_t frame) {
+    size_t idx = frame * channels + channel;
+    if (idx < spans[0].samples) return spans[0].data[idx];
+    return spans[1].data[idx - spans[0].samples];
+  }
 
   int transform(int x){
     int result = x / 1000; // scale -32 to 32
@@ -169,12 +240,15 @@ public:
     return buffer_count;
   }
 
-  // provides the wav data as bas64 encded string
-  std::string audio() {
-    std::ifstream fin(fname, std::ios::binary);
-    std::stringstream m_buffer;
-    m_buffer << fin.rdbuf();
-    return xtl::base64encode(m_buffer.str());
+  // provides the wav data as bas64 encded string: it is encoded only once
+  const std::string &audio() {
+    if (audio_base64.empty()) {
+      std::ifstream fin(fname, std::ios::binary);
+      std::stringstream m_buffer;
+      m_buffer << fin.rdbuf();
+      audio_base64 = xtl::base64encode(m_buffer.str());
+    }
+    return audio_base64;
   }
 
   // Provides the audion information
@@ -187,14 +261,79 @@ protected:
   ChartT<T> chrt;
   WAVEncoder wave_encoder;
   EncodedAudioOutput out;
-  StreamCopyT<T> copier;
+  StreamCopyT<T> copier{DEFAULT_BUFFER_SIZE};
   AudioInfo cfg;
   string fname;
+  string audio_base64;
   size_t buffer_count=0;
 };
 
 using JupyterAudio = JupyterAudioT<int16_t>;
 
+/**
+ * @brief Displays audio data which is already in memory (e.g. in a Vector or
+ * RingBuffer) in Jupyter w/o copying it to a file: it is just a view of the
+ * interleaved samples, which must stay valid while it is used. The data of a
+ * RingBuffer is provided in 2 parts if it wraps around.
+ */
+template <typename T>
+class JupyterDataT {
+public:
+  JupyterDataT(const T* data, size_t samples, AudioInfo info) {
+    cfg = info;
+    spans[0] = Span{data, samples};
+  }
+
+  JupyterDataT(Vector<T> &data, AudioInfo info) : JupyterDataT(data.data(), data.size(), info) {}
+
+  JupyterDataT(RingBuffer<T> &data, AudioInfo info) {
+    cfg = info;
+    size_t first = data.readPtrSize();
+    spans[0] = Span{data.readPtr(), first};
+    spans[1] = Span{data.address(), data.available() - first};
+  }
+
+  ChartT<T> &chart(int channel=0) {
+    assert(cfg.channels>0);
+    chrt.setData(cfg.channels, channel, spans[0].data, spans[0].samples, spans[1].data, spans[1].samples);
+    return chrt;
+  }
+
+  /// Number of samples
+  size_t size() {
+    return spans[0].samples + spans[1].samples;
+  }
+
+  // provides the data as base64 encoded wav
+  std::string audio() {
+    std::string wav;
+    StringOutput fp(wav);
+    WAVEncoder wave_encoder;
+    wave_encoder.setAudioInfo(cfg);
+    wave_encoder.setOutput(fp);
+    wave_encoder.begin();
+    for (int j = 0; j < 2; j++) {
+      wave_encoder.write((const uint8_t*)spans[j].data, spans[j].samples * sizeof(T));
+    }
+    return xtl::base64encode(wav);
+  }
+
+  AudioInfo audioInfo() {
+    return cfg;
+  }
+
+protected:
+  struct Span {
+    const T* data = nullptr;
+    size_t samples = 0;
+  };
+  AudioInfo cfg;
+  Span spans[2];
+  ChartT<T> chrt;
+};
+
+using JupyterData = JupyterDataT<int16_t>;
+
 } // namespace audio_tools
 
 /// Disply Chart in Jupyterlab xeus
@@ -204,6 +343,15 @@ nl::json mime_bundle_repr(Chart &in) {
   return bundle;
 }
 
+/// Disply Audio player for data in memory in Jupyterlab xeus
+nl::json mime_bundle_repr(JupyterData &in) {
+  auto bundle = nl::json::object();
+  bundle["text/html"] = "<audio controls "
+                        "src='data:audio/wav;base64," +
+                        in.audio() + "'/>";
+  return bundle;
+}
+
 /// Disply Audio player in Jupyterlab xeus
 nl::json mime_bundle_repr(JupyterAudio &in) {
   auto bundle = nl::json::object();
@@ -0,0 +1,146 @@
+#pragma once
+#include "AudioConfig.h"
+#include "AudioTools/Buffers.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace audio_tools {
+
+/**
+ * @brief Ring buffer which is backed by a memory mapped file (desktop:
+ * Linux, macOS): the data is accessed with memcpy only, so we do not need
+ * any seek or read/write calls. This can be used for big buffers (e.g. a
+ * time shift buffer for pausing a live radio) which do not fit into the
+ * RAM. The capacity is rounded up to a multiple of the page size.
+ * @ingroup buffers
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T>
+class RingBufferMMap : public BaseBuffer<T> {
+ public:
+  RingBufferMMap() = default;
+  RingBufferMMap(const char *path, size_t size) { begin(path, size); }
+  ~RingBufferMMap() { end(); }
+
+  /// Opens (or creates) the file and maps it with the capacity of size
+  /// entries
+  bool begin(const char *path, size_t size) {
+    end();
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t bytes = ((size * sizeof(T) + page - 1) / page) * page;
+    fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      LOGE("open %s", path);
+      return false;
+    }
+    if (ftruncate(fd, bytes) != 0) {
+      LOGE("ftruncate %d", (int)bytes);
+      end();
+      return false;
+    }
+    void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+      LOGE("mmap %d", (int)bytes);
+      end();
+      return false;
+    }
+    p_data = (T *)ptr;
+    mapped_bytes = bytes;
+    max_size = bytes / sizeof(T);
+    reset();
+    return true;
+  }
+
+  /// Unmaps and closes the file
+  void end() {
+    if (p_data != nullptr) {
+      munmap(p_data, mapped_bytes);
+      p_data = nullptr;
+    }
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+    max_size = 0;
+    mapped_bytes = 0;
+  }
+
+  /// Writes the changed pages to the file
+  void flush() {
+    if (p_data != nullptr) msync(p_data, mapped_bytes, MS_ASYNC);
+  }
+
+  T read() override {
+    T result = 0;
+    if (readArray(&result, 1) != 1) return -1;
+    return result;
+  }
+
+  T peek() override {
+    if (isEmpty()) return -1;
+    return p_data[tail % max_size];
+  }
+
+  bool write(T data) override { return writeArray(&data, 1) == 1; }
+
+  int readArray(T data[], int count) override {
+    int result = min(count, available());
+    copy(data, tail, result, false);
+    tail += result;
+    return result;
+  }
+
+  int writeArray(const T data[], int len) override {
+    int result = min(len, availableForWrite());
+    copy((T *)data, head, result, true);
+    head += result;
+    return result;
+  }
+
+  void reset() override {
+    head = 0;
+    tail = 0;
+  }
+
+  int available() override { return head - tail; }
+
+  int availableForWrite() override { return max_size - (head - tail); }
+
+  bool isFull() override { return availableForWrite() == 0; }
+
+  bool isEmpty() { return available() == 0; }
+
+  T *address() override { return p_data; }
+
+  size_t size() override { return max_size; }
+
+  operator bool() { return p_data != nullptr; }
+
+ protected:
+  T *p_data = nullptr;
+  int fd = -1;
+  size_t mapped_bytes = 0;
+  size_t max_size = 0;
+  // free running positions
+  uint64_t head = 0;
+  uint64_t tail = 0;
+
+  /// copies the data in max 2 segments
+  void copy(T *data, uint64_t pos, int count, bool toBuffer) {
+    if (count <= 0) return;
+    size_t start = pos % max_size;
+    size_t first = min((size_t)count, max_size - start);
+    if (toBuffer) {
+      memcpy(p_data + start, data, first * sizeof(T));
+      memcpy(p_data, data + first, (count - first) * sizeof(T));
+    } else {
+      memcpy(data, p_data + start, first * sizeof(T));
+      memcpy(data + first, p_data, (count - first) * sizeof(T));
+    }
+  }
+};
+
+}  // namespace audio_tools
@@ -11,11 +11,15 @@
 #pragma once
 
 #include <math.h>
+#include "AudioBasic/Collections/Vector.h"
 
 namespace audio_tools {
 
 /**
- * @brief FFT Window Function
+ * @brief FFT Window Function: the factors are calculated only once per fft
+ * length in begin() and only the first half is stored, because the window is
+ * symmetric. The same window object can be shared by multiple FFT instances
+ * with the same length.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
@@ -23,18 +27,37 @@ namespace audio_tools {
 class WindowFunction {
  public:
   WindowFunction() = default;
+  WindowFunction(WindowFunction const&) = delete;
+  WindowFunction& operator=(WindowFunction const&) = delete;
+  virtual ~WindowFunction() = default;
 
   /// Setup the window function providing the fft length
   virtual void begin(int samples) {
+    // process only if there is a change
+    if (samples == i_samples && table.size() > 0) return;
     this->samples_minus_1 = -1.0f + samples;
     this->i_samples = samples;
     this->i_half_samples = samples / 2 - 1;
+    table_len = (samples + 1) / 2;
+    table.resize(table_len);
+    for (int j = 0; j < table_len; j++) {
+      float result = j < i_half_samples ? factor_internal(j)
+                                        : factor_internal(i_samples - j - 1);
+      table[j] = result > 1.0f ? 1.0f : result;
+    }
   }
 
   /// Provides the multipication factor at the indicated position. The result is symetirically mirrored around the center
   inline float factor(int idx) {
-    float result =  idx < i_half_samples ? factor_internal(idx) : factor_internal(i_samples-idx-1);
-    return result>1.0f ? 1.0f : result;
+    return idx < table_len ? table[idx] : table[i_samples - idx - 1];
+  }
+
+  /// Multiplies the samples (of fft length) with the window factors
+  void apply(float* data) {
+    const float* p_table = table.data();
+    for (int j = 0; j < table_len; j++) data[j] *= p_table[j];
+    for (int j = table_len; j < i_samples; j++)
+      data[j] *= p_table[i_samples - j - 1];
   }
 
   /// Provides the number of samples (fft length)
@@ -44,6 +67,8 @@ class WindowFunction {
   float samples_minus_1 = 0.0f;
   int i_samples = 0;
   int i_half_samples = 0;
+  Vector<float> table{0};
+  int table_len = 0;
   const float twoPi = 6.28318531f;
   const float fourPi = 12.56637061f;
   const float sixPi = 18.84955593f;
@@ -59,38 +84,24 @@ class WindowFunction {
 };
 
 /**
- * @brief Buffered window function, so that we do not need to re-calculate the
- * values
+ * @brief Buffered window function: all window functions are buffered now, so
+ * this is just a wrapper which is kept for compatibility
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
 class BufferedWindow : public WindowFunction {
  public:
   BufferedWindow(WindowFunction* wf) { p_wf = wf; }
-  BufferedWindow(BufferedWindow const&) = delete;
-  BufferedWindow& operator=(BufferedWindow const&) = delete;
 
   virtual void begin(int samples) override {
-    // process only if there is a change
+    p_wf->begin(samples);
     WindowFunction::begin(samples);
-    if (p_wf->samples() != samples) {
-      p_wf->begin(samples);
-      len = samples / 2;
-      buffer.resize(len);
-      for (int j = 0; j < len; j++) {
-        buffer[j] = p_wf->factor(j);
-      }
-    }
   }
 
  protected:
   WindowFunction* p_wf = nullptr;
-  Vector<float> buffer{0};
-  int len;
 
-  float factor_internal(int idx) override {
-    return idx < len ? buffer[idx] : buffer[i_samples - idx];
-  }
+  float factor_internal(int idx) override { return p_wf->factor(idx); }
 };
 
 /**
@@ -126,7 +137,7 @@ class Hann : public WindowFunction {
  public:
   Hann() = default;
   float factor_internal(int idx) {
-    return 0.54f * (1.0f - cos(twoPi * ratio(idx)));
+    return 0.5f * (1.0f - cos(twoPi * ratio(idx)));
   }
 };
 
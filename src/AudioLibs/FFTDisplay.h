@@ -1,18 +1,28 @@
 #pragma once
 #include "AudioLibs/AudioFFT.h"
-#include "Concurrency/LockGuard.h"
+#if USE_SNAPSHOT
+#  include "Concurrency/Snapshot.h"
+#else
+#  include "Concurrency/LockGuard.h"
+#endif
 
 namespace audio_tools {
 
 class FFTDisplay;
 FFTDisplay *selfFFTDisplay = nullptr;
-#if defined(USE_CONCURRENCY)
+#if defined(USE_CONCURRENCY) && !USE_SNAPSHOT
 // fft mutex
 static Mutex fft_mux;
 #endif
 /**
  * Display FFT result: we can define a start bin and group susequent bins for a
- * combined result.
+ * combined result. Alternatively we can define log spaced bands with
+ * setBands(): the bin ranges of each column are precalculated and the fft
+ * callback only provides the reduced band values. With USE_SNAPSHOT the
+ * magnitudes are published by the fft callback with a lock free
+ * SnapshotArray, so that the display task never blocks the audio processing.
+ * With min_update_ms the results are published at most with the refresh rate
+ * of the display.
  */
 
 class FFTDisplay {
@@ -28,22 +38,64 @@ class FFTDisplay {
   int fft_group_bin = 1;
   /// Influences the senitivity
   float fft_max_magnitude = 700.0f;
+  /// Minimum time between 2 published results: e.g. 1000 / refresh rate of
+  /// the display (0 = publish every fft result)
+  int min_update_ms = 0;
+
+  /// Defines the number of columns with the bands between the indicated
+  /// frequencies (maxFreq 0 = nyquist): call before begin()
+  void setBands(int columns, float minFreq = 50.0f, float maxFreq = 0.0f,
+                bool logScale = true) {
+    band_count = columns;
+    band_min_freq = minFreq;
+    band_max_freq = maxFreq;
+    band_log_scale = logScale;
+  }
 
   void begin() {
     // assign fft callback
     AudioFFTConfig &fft_cfg = p_fft->config();
     fft_cfg.callback = fftCallback;
+    last_update_ms = 0;
+    setupBands();
 
-    // number of bins
-    magnitudes.resize(p_fft->size());
-    for (int j = 0; j < p_fft->size(); j++) {
+    // number of bins or bands
+    int size = band_count > 0 ? band_count : p_fft->size();
+    magnitudes.resize(size);
+#if !USE_SNAPSHOT
+    for (int j = 0; j < size; j++) {
       magnitudes[j] = 0;
     }
+#endif
+  }
+
+  /// Provides the first bin of the indicated band: band_count is the end
+  int bandStart(int band) { return band_start[band]; }
+
+  /// Takes over the latest fft result: this is done automatically when the
+  /// magnitude of the first x position is requested. Returns true if there
+  /// is a new result.
+  bool update() {
+#if USE_SNAPSHOT
+    return magnitudes.update();
+#else
+    return true;
+#endif
   }
 
   /// Returns the magnitude for the indicated led x position. We might
   /// need to combine values from the magnitudes array if this is much bigger.
   float getMagnitude(int x) {
+    if (x == 0) update();
+#if USE_SNAPSHOT
+    const float *values = magnitudes.readBuffer();
+#else
+    const float *values = magnitudes.data();
+#endif
+    // the bands are already reduced
+    if (band_count > 0) {
+      return x < band_count ? values[x] : 0.0f;
+    }
     // get magnitude from fft
     float total = 0;
     for (int j = 0; j < fft_group_bin; j++) {
@@ -51,7 +103,7 @@ class FFTDisplay {
       if (idx >= magnitudes.size()) {
         idx = magnitudes.size() - 1;
       }
-      total += magnitudes[idx];
+      total += values[idx];
     }
     return total / fft_group_bin;
   }
@@ -73,17 +125,108 @@ class FFTDisplay {
 
  protected:
   AudioFFTBase *p_fft = nullptr;
+#if USE_SNAPSHOT
+  SnapshotArray<float> magnitudes;
+#else
   Vector<float> magnitudes{0};
+#endif
+  int band_count = 0;
+  float band_min_freq = 50.0f;
+  float band_max_freq = 0.0f;
+  bool band_log_scale = true;
+  // first bin of each band
+  Vector<uint16_t> band_start{0};
+  // magnitudes of all bins which are reduced to the bands
+  Vector<float> bin_values{0};
+  Vector<int32_t> bin_values_q{0};
+  unsigned long last_update_ms = 0;
+
+  /// precalculates the bin ranges of the bands
+  void setupBands() {
+    if (band_count <= 0) return;
+    int bins = p_fft->size();
+    float bin_width = (float)p_fft->config().sample_rate / p_fft->length();
+    float max_freq = band_max_freq > 0.0f ? band_max_freq : bins * bin_width;
+    float min_freq = band_min_freq > bin_width ? band_min_freq : bin_width;
+    band_start.resize(band_count + 1);
+    int prev = 0;
+    for (int j = 0; j <= band_count; j++) {
+      float f = band_log_scale
+                    ? min_freq * powf(max_freq / min_freq, (float)j / band_count)
+                    : min_freq + (max_freq - min_freq) * j / band_count;
+      int bin = f / bin_width;
+      // each band has at least one bin
+      if (j > 0 && bin <= prev) bin = prev + 1;
+      if (bin > bins) bin = bins;
+      band_start[j] = bin;
+      prev = bin;
+    }
+    bool is_fixed_point = p_fft->driver()->isFixedPoint();
+    bin_values.resize(is_fixed_point ? 0 : bins);
+    bin_values_q.resize(is_fixed_point ? bins : 0);
+  }
+
+  /// Returns false if the last result was published less then min_update_ms
+  /// ago
+  bool isUpdateDue() {
+    if (min_update_ms <= 0) return true;
+    unsigned long now = millis();
+    if (last_update_ms != 0 &&
+        now - last_update_ms < (unsigned long)min_update_ms)
+      return false;
+    last_update_ms = now;
+    return true;
+  }
+
+  /// averages the magnitudes of the bins of each band
+  void reduceBands(float *result) {
+    if (bin_values_q.size() > 0) {
+      // fixed point drivers: integer sums
+      p_fft->magnitudes(bin_values_q.data());
+      int len = p_fft->length();
+      for (int b = 0; b < band_count; b++) {
+        int64_t total = 0;
+        int start = band_start[b];
+        int end = band_start[b + 1];
+        for (int j = start; j < end; j++) total += bin_values_q[j];
+        result[b] = end > start ? (float)(total * len / (end - start)) : 0.0f;
+      }
+    } else {
+      p_fft->magnitudes(bin_values.data());
+      for (int b = 0; b < band_count; b++) {
+        float total = 0.0f;
+        int start = band_start[b];
+        int end = band_start[b + 1];
+        for (int j = start; j < end; j++) total += bin_values[j];
+        result[b] = end > start ? total / (end - start) : 0.0f;
+      }
+    }
+  }
 
   void loadMangnitudes() {
+    // limit the updates to the refresh rate of the display
+    if (!isUpdateDue()) return;
     // just save magnitudes to be displayed
-#if defined(USE_CONCURRENCY)
+#if USE_SNAPSHOT
+    if (band_count > 0) {
+      reduceBands(magnitudes.writeBuffer());
+    } else {
+      p_fft->magnitudes(magnitudes.writeBuffer());
+    }
+    magnitudes.publish();
+#else
+#  if defined(USE_CONCURRENCY)
     LockGuard guard(fft_mux);
-#endif
+#  endif
+    if (band_count > 0) {
+      reduceBands(magnitudes.data());
+      return;
+    }
     for (int j = 0; j < p_fft->size(); j++) {
       float value = p_fft->magnitude(j);
       magnitudes[j] = value;
     }
+#endif
   }
 };
 
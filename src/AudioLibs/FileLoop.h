@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AudioTools/BaseStream.h"
+#include "AudioTools/Fade.h"
 #ifdef ARDUINO
 #  include "FS.h"
 #  define READTYPE char
@@ -16,6 +17,13 @@ namespace audio_tools {
  * calling setLoopCount().
  * You can also optinally limit the total looping file size by calling 
  * setSize();
+ *
+ * For a seamless loop you can cache the start of the loop in RAM with
+ * setCacheMs(): after the end of the file the data is provided from the
+ * cache while the file is repositioned after the cached data in the next
+ * call, so that the rewind does not cause any underrun. With a cache the loop
+ * seam can also be crossfaded with setCrossfadeMs(): the end of the file is
+ * mixed with the start of the loop from the cache.
  * @ingroup io
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -44,6 +52,7 @@ public:
       current_file.seek(start_pos);
     }
     size_open = total_size;
+    if (!setupCache()) return false;
     return current_file;
   }
 
@@ -79,6 +88,20 @@ public:
     callback = cb;
   }
 
+  /// Defines the format of the (PCM) data which is needed by the cache
+  void setAudioInfo(AudioInfo info) { this->info = info; }
+
+  /// Caches the indicated ms of the start of the loop in RAM (0 = no cache):
+  /// the cache should cover several reads. Call before begin().
+  void setCacheMs(int ms) { cache_ms = ms; }
+
+  /// Crossfades the indicated ms at the loop seam: this requires a cache
+  /// which is at least as long as the crossfade. Call before begin().
+  void setCrossfadeMs(int ms, FadeCurve curve = FadeEqualPower) {
+    crossfade_ms = ms;
+    this->curve = curve;
+  }
+
   /// count values: 0) do not loop, 1) loop once, n) loop n times, -1) loop
   /// endless
   void setLoopCount(int count) { loop_count = count; }
@@ -101,25 +124,8 @@ public:
       copy_len = min((int)len, size_open);
     }
 
-    // read step 1;
-    int result1 = current_file.readBytes((READTYPE *)data, copy_len);
-    int result2 = 0;
-    int open = copy_len - result1;
-    if (isLoopActive() && open > 0) {
-      if (start_pos < 0) start_pos = 0;
-      LOGI("seek %d", start_pos);
-      // looping logic -> rewind to beginning: read step 2
-      current_file.seek(start_pos);
-      // notify user
-      if (callback!=nullptr){
-        callback(*this);
-      }
-      result1 = current_file.readBytes((READTYPE*)data + result1, open);
-      if (loop_count>0)
-        loop_count--;
-    }
-    // determine the result size
-    int result = result1 + result2;
+    int result = cache.size() > 0 ? readCached(data, copy_len)
+                                  : readFile(data, copy_len);
     // calculate the size_open if necessary
     if (total_size!=-1){
       size_open -= result;
@@ -144,6 +150,151 @@ protected:
   int total_size = -1;
   void (*callback)(FileLoopT &loop) = nullptr;
   FileType current_file;
+  AudioInfo info;
+  int cache_ms = 0;
+  int crossfade_ms = 0;
+  FadeCurve curve = FadeEqualPower;
+  Vector<uint8_t> cache{0, ColdAllocator};
+  int cache_pos = 0;
+  int crossfade_bytes = 0;
+  bool is_seek_pending = false;
+
+  /// Reads the data and rewinds at the end of the file
+  int readFile(uint8_t *data, int len) {
+    // read step 1;
+    int result = current_file.readBytes((READTYPE *)data, len);
+    int open = len - result;
+    if (isLoopActive() && open > 0) {
+      if (start_pos < 0) start_pos = 0;
+      LOGI("seek %d", start_pos);
+      // looping logic -> rewind to beginning: read step 2
+      current_file.seek(start_pos);
+      // notify user
+      if (callback!=nullptr){
+        callback(*this);
+      }
+      result += current_file.readBytes((READTYPE*)data + result, open);
+      if (loop_count>0)
+        loop_count--;
+    }
+    return result;
+  }
+
+  /// Reads the start of the loop into the cache
+  bool setupCache() {
+    cache.resize(0);
+    cache_pos = 0;
+    is_seek_pending = false;
+    if (cache_ms <= 0) return true;
+    int frame_size = info.channels * info.bits_per_sample / 8;
+    if (frame_size <= 0) {
+      LOGE("AudioInfo not defined");
+      return false;
+    }
+    int bytes_per_ms = info.sample_rate * frame_size / 1000;
+    int size = cache_ms * bytes_per_ms;
+    size -= size % frame_size;
+    cache.resize(size);
+    if ((int)cache.size() != size) {
+      LOGE("not enough memory for cache: %d", size);
+      return false;
+    }
+    int pos = current_file.position();
+    size = current_file.readBytes((READTYPE *)cache.data(), size);
+    size -= size % frame_size;
+    cache.resize(size);
+    current_file.seek(pos + size);
+    crossfade_bytes = min(crossfade_ms * bytes_per_ms, size);
+    crossfade_bytes -= crossfade_bytes % frame_size;
+    return true;
+  }
+
+  /// Provides the data from the cache and from the file
+  int readCached(uint8_t *data, int len) {
+    int result = 0;
+    bool is_wrapped = false;
+    while (result < len) {
+      // provide the start of the loop from the cache
+      if (cache_pos < (int)cache.size()) {
+        int n = min(len - result, (int)cache.size() - cache_pos);
+        memcpy(data + result, cache.data() + cache_pos, n);
+        cache_pos += n;
+        result += n;
+        continue;
+      }
+      if (is_seek_pending) {
+        seekAfterCache();
+      }
+      int n = readFileCrossfaded(data + result, len - result);
+      if (n > 0) {
+        result += n;
+        continue;
+      }
+      // end of file: continue with the cache
+      if (!isLoopActive() || is_wrapped) break;
+      LOGI("loop from cache");
+      is_wrapped = true;
+      is_seek_pending = true;
+      cache_pos = crossfade_bytes;
+      if (callback != nullptr) callback(*this);
+      if (loop_count > 0) loop_count--;
+    }
+    // we reposition the file in the call after the rewind
+    if (is_seek_pending && !is_wrapped) seekAfterCache();
+    return result;
+  }
+
+  void seekAfterCache() {
+    if (start_pos < 0) start_pos = 0;
+    LOGI("seek %d", start_pos + (int)cache.size());
+    current_file.seek(start_pos + cache.size());
+    is_seek_pending = false;
+  }
+
+  /// Reads the data from the file and mixes the end of the file with the
+  /// start of the loop
+  int readFileCrossfaded(uint8_t *data, int len) {
+    int pos = current_file.position();
+    int result = current_file.readBytes((READTYPE *)data, len);
+    if (crossfade_bytes <= 0 || result <= 0 || !isLoopActive()) return result;
+    int fade_start = (int)current_file.size() - crossfade_bytes;
+    int from = max(pos, fade_start);
+    int to = pos + result;
+    if (from >= to) return result;
+    switch (info.bits_per_sample) {
+      case 16:
+        crossfade<int16_t>(data + (from - pos), from - fade_start, to - from);
+        break;
+      case 24:
+        crossfade<int24_t>(data + (from - pos), from - fade_start, to - from);
+        break;
+      case 32:
+        crossfade<int32_t>(data + (from - pos), from - fade_start, to - from);
+        break;
+    }
+    return result;
+  }
+
+  /// Mixes the bytes at the offset of the crossfade with the cache
+  template <typename T>
+  void crossfade(uint8_t *data, int offset, int bytes) {
+    T *out = (T *)data;
+    T *head = (T *)(cache.data() + offset);
+    int samples = bytes / sizeof(T);
+    int first = offset / sizeof(T);
+    int total = crossfade_bytes / sizeof(T);
+    int channels = info.channels;
+    for (int j = 0; j < samples; j++) {
+      // same gain for all channels of a frame
+      int sample = (first + j) - (first + j) % channels;
+      int step = (int64_t)sample * FadeTable::SIZE / total;
+      int64_t gain_in = FadeTable::gain(curve, step);
+      int64_t gain_out = FadeTable::gain(curve, FadeTable::SIZE - step);
+      int64_t value = (int64_t)(int32_t)out[j] * gain_out +
+                      (int64_t)(int32_t)head[j] * gain_in;
+      out[j] = value >> 16;
+    }
+  }
 };
 
 /**
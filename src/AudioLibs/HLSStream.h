@@ -10,9 +10,71 @@
 #define MAX_HLS_LINE 512
 #define START_URLS_LIMIT 4
 #define HLS_BUFFER_COUNT 10
+#define HLS_PARALLEL_SEGMENTS 3
+#ifndef HLS_URL_HISTORY_SIZE
+#  define HLS_URL_HISTORY_SIZE 64
+#endif
 
 namespace audio_tools {
 
+/**
+ * @brief Estimates the network throughput from the received bytes: we use
+ * measurement windows of 1 second and an exponential moving average. If the
+ * download was limited by a full buffer, the result is only a lower bound.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class HLSThroughput {
+ public:
+  /// Records the received bytes
+  void add(size_t bytes) { window_bytes += bytes; }
+
+  /// Marks the actual window as limited by the buffer
+  void setLimited() { is_limited = true; }
+
+  /// Call regularly while downloading: closes the window after 1 second
+  void update() {
+    uint32_t now = millis();
+    if (window_start == 0) {
+      start(now);
+      return;
+    }
+    uint32_t ms = now - window_start;
+    if (ms < window_ms) return;
+    uint32_t sample = static_cast<uint64_t>(window_bytes) * 8000 / ms;
+    if (is_limited) {
+      if (sample > estimate) estimate = sample;
+    } else {
+      estimate = estimate == 0 ? sample : (estimate * 7 + sample * 3) / 10;
+    }
+    start(now);
+  }
+
+  /// No download active: the idle time is not counted
+  void setIdle() { window_start = 0; }
+
+  /// Estimated throughput in bits per second (0 if not known yet)
+  uint32_t bitsPerSecond() { return estimate; }
+
+  void clear() {
+    estimate = 0;
+    window_start = 0;
+  }
+
+ protected:
+  uint32_t estimate = 0;
+  uint32_t window_start = 0;
+  uint32_t window_bytes = 0;
+  uint32_t window_ms = 1000;
+  bool is_limited = false;
+
+  void start(uint32_t now) {
+    window_start = now;
+    window_bytes = 0;
+    is_limited = false;
+  }
+};
+
 /// @brief Abstract API for URLLoaderHLS
 class URLLoaderHLSBase {
  public:
@@ -26,6 +88,12 @@ class URLLoaderHLSBase {
   int contentLength() { return 0; }
 
   virtual void setBuffer(int size, int count) {}
+
+  /// Estimated network throughput in bits per second (0 if not known)
+  virtual uint32_t throughput() { return 0; }
+
+  /// Filling level of the buffer in percent
+  virtual int bufferLevelPercent() { return 100; }
 };
 
 /// URLLoader which saves the HLS segments to the indicated output
@@ -147,8 +215,16 @@ class URLLoaderHLS : public URLLoaderHLSBase {
     buffer_count = count;
   }
 
+  uint32_t throughput() override { return estimator.bitsPerSecond(); }
+
+  int bufferLevelPercent() override {
+    int size = buffer_size * buffer_count;
+    return size == 0 ? 100 : buffer.available() * 100 / size;
+  }
+
  protected:
-  Vector<const char *> urls{10};
+  HLSThroughput estimator;
+  Vector<const char *> urls{10, ColdAllocator};
 #if USE_TASK
   BufferRTOS<uint8_t> buffer{0};
   Task task{"Refill", 1024 * 5, 1, 1};
@@ -167,13 +243,15 @@ class URLLoaderHLS : public URLLoaderHLSBase {
   void bufferRefill() {
     TRACED();
     // we have nothing to do
-    if (urls.empty()) {
+    if (urls.empty() && !*p_stream) {
       LOGD("urls empty");
+      estimator.setIdle();
       delay(10);
       return;
     }
     if (buffer.availableForWrite() == 0) {
       LOGD("buffer full");
+      estimator.setLimited();
       delay(10);
       return;
     }
@@ -211,6 +289,7 @@ class URLLoaderHLS : public URLLoaderHLSBase {
       total += read;
       if (read > 0) {
         failed = 0;
+        estimator.add(read);
         buffer.writeArray(tmp, read);
         LOGI("buffer add %d -> %d:", read, buffer.available());
 
@@ -234,51 +313,311 @@ class URLLoaderHLS : public URLLoaderHLSBase {
       LOGD("Refilled with %d now %d available to write", total,
            buffer.availableForWrite());
     }
+    estimator.update();
+  }
+};
+
+/***
+ * @brief URLLoader which downloads multiple HLS segments in parallel, each
+ * with its own keep-alive connection (URLStream reuses it for the same host):
+ * so the next segments are already available when the actual segment ends. All connections are served
+ * with non blocking reads, and the total memory is limited by setBuffer(size,
+ * count): each connection gets the same share of it.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class URLLoaderHLSParallel : public URLLoaderHLSBase {
+ public:
+  URLLoaderHLSParallel(int parallel = HLS_PARALLEL_SEGMENTS) {
+    setParallel(parallel);
+  }
+
+  ~URLLoaderHLSParallel() { end(); }
+
+  /// Defines the number of segments which are loaded in parallel
+  void setParallel(int count) { parallel_count = count < 1 ? 1 : count; }
+
+  bool begin() override {
+    TRACED();
+    end();
+    size_t slot_size = buffer_size * buffer_count / parallel_count;
+    for (int j = 0; j < parallel_count; j++) {
+      Slot *p_slot = new Slot();
+      p_slot->buffer.resize(slot_size);
+      p_slot->stream.setTimeout(5000);
+      p_slot->stream.setWaitForData(false);
+      slots.push_back(p_slot);
+    }
+    read_idx = 0;
+    assign_idx = 0;
+    active = true;
+    return true;
+  }
+
+  void end() override {
+    TRACED();
+    for (auto p_slot : slots) {
+      p_slot->stream.end();
+      if (p_slot->url != nullptr) delete[] p_slot->url;
+      delete p_slot;
+    }
+    slots.clear();
+    for (auto url : urls) delete[] url;
+    urls.clear();
+    active = false;
+  }
+
+  /// Adds the next url to be played in sequence
+  void addUrl(const char *url) override {
+    LOGI("Adding %s", url);
+    int len = strlen(url);
+    char *str = new char[len + 1];
+    memcpy(str, url, len + 1);
+#if USE_TASK
+    LockGuard lock_guard{mutex};
+#endif
+    urls.push_back((const char *)str);
+  }
+
+  int urlCount() override { return urls.size(); }
+
+  /// Available bytes of the actual segment
+  int available() override {
+    if (!active) return 0;
+    refill();
+    nextSlot();
+    return slots[read_idx]->buffer.available();
+  }
+
+  /// Provides the data of the segments in sequence
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (!active) return 0;
+    refill();
+    size_t result = 0;
+    for (int j = 0; j < parallel_count && result < len; j++) {
+      nextSlot();
+      int read = slots[read_idx]->buffer.readArray(data + result, len - result);
+      if (read == 0) break;
+      result += read;
+    }
+    return result;
+  }
+
+  const char *contentType() {
+    if (!active) return nullptr;
+    return slots[read_idx]->stream.httpRequest().reply().get(CONTENT_TYPE);
+  }
+
+  int contentLength() {
+    if (!active) return 0;
+    return slots[read_idx]->stream.contentLength();
+  }
+
+  /// Defines the total memory: size * count bytes
+  void setBuffer(int size, int count) override {
+    buffer_size = size;
+    buffer_count = count;
+  }
+
+  uint32_t throughput() override { return estimator.bitsPerSecond(); }
+
+  int bufferLevelPercent() override {
+    int size = buffer_size * buffer_count;
+    int available = 0;
+    for (auto p_slot : slots) available += p_slot->buffer.available();
+    return size == 0 ? 100 : available * 100 / size;
+  }
+
+ protected:
+  struct Slot {
+    URLStream stream;
+    RingBuffer<uint8_t> buffer{0};
+    const char *url = nullptr;
+    bool is_used = false;
+    bool is_loading = false;
+  };
+  Vector<Slot *> slots;
+  Vector<const char *> urls{10, ColdAllocator};
+#if USE_TASK
+  Mutex mutex;
+#endif
+  HLSThroughput estimator;
+  bool active = false;
+  int parallel_count = HLS_PARALLEL_SEGMENTS;
+  int buffer_size = DEFAULT_BUFFER_SIZE;
+  int buffer_count = HLS_BUFFER_COUNT;
+  int read_idx = 0;
+  int assign_idx = 0;
+
+  /// Moves to the next slot when the actual segment has been consumed
+  void nextSlot() {
+    Slot *p_slot = slots[read_idx];
+    if (p_slot->is_used && !p_slot->is_loading &&
+        p_slot->buffer.available() == 0) {
+      p_slot->is_used = false;
+      delete[] p_slot->url;
+      p_slot->url = nullptr;
+      read_idx = (read_idx + 1) % parallel_count;
+    }
+  }
+
+  /// Starts the next segment in the next free slot
+  void startNext() {
+    Slot *p_slot = slots[assign_idx];
+    if (p_slot->is_used || urls.empty()) return;
+    {
+#if USE_TASK
+      LockGuard lock_guard{mutex};
+#endif
+      p_slot->url = urls[0];
+      urls.pop_front();
+    }
+    LOGI("loading %s", p_slot->url);
+    p_slot->is_used = true;
+    p_slot->is_loading = p_slot->stream.begin(p_slot->url);
+    if (!p_slot->is_loading) {
+      LOGE("Could not load %s", p_slot->url);
+      p_slot->stream.end();
+    }
+    assign_idx = (assign_idx + 1) % parallel_count;
+  }
+
+  /// Non blocking reads from all active connections
+  void refill() {
+    startNext();
+    bool is_loading = false;
+    uint8_t tmp[DEFAULT_BUFFER_SIZE];
+    for (auto p_slot : slots) {
+      if (!p_slot->is_loading) continue;
+      is_loading = true;
+      URLStream &stream = p_slot->stream;
+      int free = p_slot->buffer.availableForWrite();
+      if (free == 0) {
+        estimator.setLimited();
+        continue;
+      }
+      int to_read = min(min(stream.available(), free), DEFAULT_BUFFER_SIZE);
+      if (to_read > 0) {
+        int read = stream.readBytes(tmp, to_read);
+        p_slot->buffer.writeArray(tmp, read);
+        estimator.add(read);
+      }
+      // segment completely loaded
+      if ((int)stream.totalRead() >= stream.contentLength() || !stream) {
+        p_slot->is_loading = false;
+        stream.endKeepAlive();
+      }
+    }
+    if (is_loading) {
+      estimator.update();
+    } else {
+      estimator.setIdle();
+    }
   }
 };
 
 /**
- * Prevent that the same url is loaded twice. We limit the history to
- * 20 entries.
+ * Prevent that the same url is loaded twice: we keep the 64 bit hashes of
+ * the last HLS_URL_HISTORY_SIZE urls in a ring and in a hash table, so that
+ * the lookup does not depend on the number of entries and no memory is
+ * allocated.
  */
 class URLHistory {
  public:
+  /// Adds the url: returns false if it is already in the history
   bool add(const char *url) {
-    bool found = false;
-    Str url_str(url);
-    for (int j = 0; j < history.size(); j++) {
-      if (url_str.equals(history[j])) {
-        found = true;
-        break;
-      }
-    }
-    if (!found) {
-      char *str = new char[url_str.length() + 1];
-      memcpy(str, url, url_str.length() + 1);
-      history.push_back((const char*)str);
-      if (history.size() > 20) {
-        delete (history[0]);
-        history.pop_front();
-      }
+    uint64_t hash = hashOf(url);
+    if (contains(hash)) return false;
+    if (count == HLS_URL_HISTORY_SIZE) {
+      // forget the oldest url
+      remove(ring[ring_pos]);
+      count--;
     }
-    return !found;
+    ring[ring_pos] = hash;
+    ring_pos = (ring_pos + 1) % HLS_URL_HISTORY_SIZE;
+    count++;
+    insert(hash);
+    return true;
   }
 
-  void clear() { history.clear(); }
+  void clear() {
+    memset(table, 0, sizeof(table));
+    count = 0;
+    ring_pos = 0;
+  }
 
-  int size() { return history.size(); }
+  int size() { return count; }
 
  protected:
-  Vector<const char *> history;
+  static const int table_size = 2 * HLS_URL_HISTORY_SIZE;
+  // hashes in the order in which they were added
+  uint64_t ring[HLS_URL_HISTORY_SIZE];
+  // open addressing with linear probing: 0 marks an empty slot
+  uint64_t table[table_size] = {0};
+  int ring_pos = 0;
+  int count = 0;
+
+  /// 64 bit FNV-1a hash: 0 is reserved for empty slots
+  static uint64_t hashOf(const char *str) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const uint8_t *p = (const uint8_t *)str; *p != 0; p++) {
+      hash ^= *p;
+      hash *= 0x100000001b3ULL;
+    }
+    return hash == 0 ? 1 : hash;
+  }
+
+  static int slotOf(uint64_t hash) { return (hash >> 7) % table_size; }
+
+  bool contains(uint64_t hash) {
+    for (int j = slotOf(hash); table[j] != 0; j = (j + 1) % table_size) {
+      if (table[j] == hash) return true;
+    }
+    return false;
+  }
+
+  void insert(uint64_t hash) {
+    int j = slotOf(hash);
+    while (table[j] != 0) j = (j + 1) % table_size;
+    table[j] = hash;
+  }
+
+  /// Removes the hash and moves the following entries back, so that we do
+  /// not need any tombstones
+  void remove(uint64_t hash) {
+    int j = slotOf(hash);
+    while (table[j] != hash) {
+      if (table[j] == 0) return;
+      j = (j + 1) % table_size;
+    }
+    int gap = j;
+    for (int k = (gap + 1) % table_size; table[k] != 0;
+         k = (k + 1) % table_size) {
+      int home = slotOf(table[k]);
+      // move the entry if its home is not between the gap and k
+      bool keep = gap <= k ? (home > gap && home <= k)
+                           : (home > gap || home <= k);
+      if (!keep) {
+        table[gap] = table[k];
+        gap = k;
+      }
+    }
+    table[gap] = 0;
+  }
+};
 };
 
 /**
- * @brief Simple Parser for HLS data. We select the entry with min bandwidth
+ * @brief Simple Parser for HLS data. We start with the variant with the min
+ * bandwidth and switch to the variant which fits to the measured throughput:
+ * when the buffer is draining we move down before it runs empty.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
 class HLSParser {
  public:
+  ~HLSParser() { clearVariants(); }
+
   // loads the index url
   bool begin(const char *urlStr) {
     index_url_str = urlStr;
@@ -290,6 +629,8 @@ class HLSParser {
     custom_log_level.set();
     segments_url_str = "";
     bandwidth = 0;
+    clearVariants();
+    last_media_sequence = -1;
     if (!parseIndex()) {
       TRACEE();
       return false;
@@ -362,9 +703,26 @@ class HLSParser {
     url_stream.end();
     p_url_loader->end();
     url_history.clear();
+    clearVariants();
     active = false;
   }
 
+  /// Activates/deactivates the switching of the variants based on the
+  /// measured throughput (default true)
+  void setAdaptiveBitrate(bool active) { is_adaptive = active; }
+
+  /// Only variants up to the indicated % of the throughput are used
+  void setBandwidthUsagePercent(int percent) { bandwidth_usage = percent; }
+
+  /// Moves to a lower variant when the buffer is below the indicated %
+  void setLowBufferPercent(int percent) { low_buffer_percent = percent; }
+
+  /// Number of variants (#EXT-X-STREAM-INF) in the index
+  int variantCount() { return variants.size(); }
+
+  /// Bandwidth of the actual variant
+  int variantBandwidth() { return bandwidth; }
+
   /// Defines the number of urls that are preloaded in the URLLoaderHLS
   void setUrlCount(int count) { url_count = count; }
 
@@ -397,17 +755,123 @@ class HLSParser {
   int media_sequence = 0;
   int tartget_duration_ms = 5000;
   int segment_count = 0;
+  int segment_sequence = -1;
   uint64_t next_sement_load_time = 0;
+  // variants from the index
+  struct Variant {
+    int bandwidth = 0;
+    const char *url = nullptr;
+    const char *codec = nullptr;
+  };
+  Vector<Variant> variants;
+  int current_variant = -1;
+  int pending_bandwidth = -1;
+  const char *pending_codec = nullptr;
+  bool is_adaptive = true;
+  int bandwidth_usage = 80;
+  int low_buffer_percent = 25;
+  // last media sequence which was provided to the loader
+  int last_media_sequence = -1;
 
   // trigger the reloading of segments if the limit is underflowing
   void reloadSegments() {
     TRACED();
+    selectVariant();
     // get new urls
     if (!segments_url_str.isEmpty()) {
       parseSegments();
     }
   }
 
+  /// Selects the best variant for the measured throughput
+  void selectVariant() {
+    if (!is_adaptive || variants.size() < 2 || current_variant < 0 || !active)
+      return;
+    uint32_t throughput = p_url_loader->throughput();
+    int level = p_url_loader->bufferLevelPercent();
+    int target = current_variant;
+    if (level < low_buffer_percent) {
+      // the buffer is draining: move down (variants are sorted)
+      if (current_variant > 0) target = current_variant - 1;
+    } else if (throughput > 0) {
+      uint64_t usable = static_cast<uint64_t>(throughput) * bandwidth_usage / 100;
+      target = 0;
+      for (int j = 0; j < variants.size(); j++) {
+        if (variants[j].bandwidth <= usable) target = j;
+      }
+      // only move up if the buffer is healthy
+      if (target > current_variant && level < 2 * low_buffer_percent)
+        target = current_variant;
+    }
+    if (target != current_variant) {
+      LOGI("switching variant: bandwidth %d -> %d (throughput %u, buffer %d%%)",
+           variants[current_variant].bandwidth, variants[target].bandwidth,
+           (unsigned)throughput, level);
+      setVariant(target);
+      // load the playlist of the new variant immediately
+      next_sement_load_time = 0;
+      media_sequence = -1;
+    }
+  }
+
+  void setVariant(int idx) {
+    current_variant = idx;
+    bandwidth = variants[idx].bandwidth;
+    segments_url_str.set(variants[idx].url);
+    if (variants[idx].codec != nullptr) codec.set(variants[idx].codec);
+  }
+
+  /// Adds a variant sorted by bandwidth
+  void addVariant(int bandwidth, const char *url, const char *codecStr) {
+    Variant variant;
+    variant.bandwidth = bandwidth;
+    variant.url = copyStr(url);
+    variant.codec = codecStr;
+    int pos = 0;
+    while (pos < variants.size() && variants[pos].bandwidth <= bandwidth) pos++;
+    variants.push_back(variant);
+    for (int j = variants.size() - 1; j > pos; j--) {
+      variants[j] = variants[j - 1];
+    }
+    variants[pos] = variant;
+  }
+
+  void clearVariants() {
+    for (auto &variant : variants) {
+      delete[] variant.url;
+      delete[] variant.codec;
+    }
+    variants.clear();
+    delete[] pending_codec;
+    pending_codec = nullptr;
+    pending_bandwidth = -1;
+    current_variant = -1;
+  }
+
+  static const char *copyStr(const char *str) {
+    int len = strlen(str);
+    char *result = new char[len + 1];
+    memcpy(result, str, len + 1);
+    return result;
+  }
+
+  /// Resolves relative urls with the help of the reference url
+  void resolveUrl(Str &str, const char *reference, StrExt &result) {
+    if (str.startsWith("http")) {
+      result.set(str.c_str());
+    } else {
+      Str reference_str(reference);
+      int pos = reference_str.lastIndexOf("/");
+      if (pos >= 0) {
+        result.substring(reference_str, 0, pos);
+      } else {
+        result.set(reference);
+      }
+      result.add("/");
+      result.add(str.c_str());
+    }
+  }
+
   // parse the index file and the segments
   bool parseIndex() {
     TRACED();
@@ -419,6 +883,8 @@ class HLSParser {
     bool rc = url_stream.begin(index_url_str);
     url_active = true;
     rc = parseIndexLines();
+    // start with the variant with the min bandwidth
+    if (rc && variants.size() > 0) setVariant(0);
     return rc;
   }
 
@@ -502,98 +968,100 @@ class HLSParser {
     return true;
   }
 
-  // parse the segments
+  // parse the segments: the lines are processed in place in the read buffer
   bool parseSegmentLines() {
     TRACEI();
     char tmp[MAX_HLS_LINE];
-    bool result = true;
     is_extm3u = false;
 
+    // media sequence of the next segment
+    segment_sequence = -1;
+
     // parse lines
-    memset(tmp, 0, MAX_HLS_LINE);
     while (true) {
-      memset(tmp, 0, MAX_HLS_LINE);
-      size_t len =
-          url_stream.httpRequest().readBytesUntil('\n', tmp, MAX_HLS_LINE);
+      size_t len = url_stream.httpRequest().readBytesUntil('\n', tmp,
+                                                           MAX_HLS_LINE - 1);
       if (len == 0 && url_stream.available() == 0) break;
-      Str str(tmp);
+      if (len > 0 && tmp[len - 1] == '\r') len--;
+      tmp[len] = 0;
 
       // check header
-      if (str.indexOf("#EXTM3U") >= 0) {
+      if (!is_extm3u && strstr(tmp, "#EXTM3U") != nullptr) {
         is_extm3u = true;
       }
 
       if (is_extm3u) {
-        if (!parseSegmentLine(str)) {
+        if (!parseSegmentLine(tmp)) {
           return false;
         }
       }
     }
-    return result;
+    return true;
   }
 
-  // Add all segments to queue
-  bool parseSegmentLine(Str &str) {
-    TRACED();
-    LOGI("> %s", str.c_str());
+  static bool startsWith(const char *line, const char *prefix, int len) {
+    return strncmp(line, prefix, len) == 0;
+  }
 
-    int pos = str.indexOf("#");
-    if (pos >= 0) {
-      LOGI("-> Segment:  %s", str.c_str());
+  // Add all segments to queue
+  bool parseSegmentLine(const char *line) {
+    LOGD("> %s", line);
 
-      pos = str.indexOf("#EXT-X-MEDIA-SEQUENCE:");
-      if (pos >= 0) {
-        int new_media_sequence = atoi(str.c_str() + pos + 22);
+    if (line[0] == '#') {
+      if (startsWith(line, "#EXT-X-MEDIA-SEQUENCE:", 22)) {
+        int new_media_sequence = atoi(line + 22);
         LOGI("media_sequence: %d", new_media_sequence);
         if (new_media_sequence == media_sequence) {
           LOGW("MEDIA-SEQUENCE already loaded: %d", media_sequence);
           return false;
         }
         media_sequence = new_media_sequence;
+        segment_sequence = new_media_sequence;
+      } else if (startsWith(line, "#EXT-X-TARGETDURATION:", 22)) {
+        tartget_duration_ms = 1000 * atoi(line + 22);
+        LOGI("tartget_duration_ms: %d", tartget_duration_ms);
       }
-
-      pos = str.indexOf("#EXT-X-TARGETDURATION:");
-      if (pos >= 0) {
-        const char *duration_str = str.c_str() + pos + 22;
-        tartget_duration_ms = 1000 * atoi(duration_str);
-        LOGI("tartget_duration_ms: %d (%s)", tartget_duration_ms, duration_str);
-      }
-    } else {
+    } else if (line[0] != 0) {
       segment_count++;
-      if (url_history.add(str.c_str())) {
+      // segments with a known sequence number which were already loaded
+      // are skipped w/o any further processing
+      if (segment_sequence >= 0) {
+        int sequence = segment_sequence++;
+        if (sequence <= last_media_sequence) {
+          LOGD("Sequence %d already loaded", sequence);
+          return true;
+        }
+        last_media_sequence = sequence;
+      }
+      if (url_history.add(line)) {
         // provide audio urls to the url_loader
-        if (str.startsWith("http")) {
-          url_str = str;
+        if (startsWith(line, "http", 4)) {
+          url_str.set(line);
         } else {
           // we create the complete url
           url_str = segments_url_str;
           url_str.add("/");
-          url_str.add(str.c_str());
+          url_str.add(line);
         }
         p_url_loader->addUrl(url_str.c_str());
       } else {
-        LOGD("Duplicate ignored: %s", str.c_str());
+        LOGD("Duplicate ignored: %s", line);
       }
     }
     return true;
   }
 
-  // Determine codec for min bandwidth
+  // Collect the variants with their bandwidth and codec
   bool parseIndexLine(Str &str) {
     TRACED();
     LOGI("> %s", str.c_str());
-    int tmp_bandwidth;
     if (str.indexOf("EXT-X-STREAM-INF") >= 0) {
-      // determine min bandwidth
+      pending_bandwidth = 0;
       int pos = str.indexOf("BANDWIDTH=");
       if (pos > 0) {
         Str num(str.c_str() + pos + 10);
-        tmp_bandwidth = num.toInt();
-        url_active = (tmp_bandwidth < bandwidth || bandwidth == 0);
-        if (url_active) {
-          bandwidth = tmp_bandwidth;
-          LOGD("-> bandwith: %d", bandwidth);
-        }
+        pending_bandwidth = num.toInt();
+        LOGD("-> bandwith: %d", pending_bandwidth);
       }
 
       pos = str.indexOf("CODECS=");
@@ -602,11 +1070,23 @@ class HLSParser {
         int end = str.indexOf('"', pos + 10);
         codec.substring(str, start, end);
         LOGI("-> codec: %s", codec.c_str());
+        delete[] pending_codec;
+        pending_codec = copyStr(codec.c_str());
       }
+      return true;
+    }
+
+    // the url of the variant follows the EXT-X-STREAM-INF
+    if (pending_bandwidth >= 0 && !str.startsWith("#") && !str.isEmpty()) {
+      StrExt variant_url;
+      resolveUrl(str, index_url_str, variant_url);
+      addVariant(pending_bandwidth, variant_url.c_str(), pending_codec);
+      pending_codec = nullptr;
+      pending_bandwidth = -1;
+      return true;
     }
 
     if (str.startsWith("http")) {
-      // check if we have a valid codec
       segments_url_str.set(str);
       LOGD("segments_url_str = %s", str.c_str());
     }
@@ -679,6 +1159,12 @@ class HLSStream : public AudioStream {
   /// Defines the buffer size
   void setBuffer(int size, int count) { parser.setBuffer(size, count); }
 
+  /// Defines the loader: e.g. URLLoaderHLSParallel
+  void setUrlLoader(URLLoaderHLSBase &loader) { parser.setUrlLoader(loader); }
+
+  /// Activates/deactivates the bandwidth adaptive variant selection
+  void setAdaptiveBitrate(bool active) { parser.setAdaptiveBitrate(active); }
+
  protected:
   HLSParser parser;
   const char *ssid = nullptr;
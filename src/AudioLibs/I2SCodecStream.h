@@ -98,6 +98,8 @@ class I2SCodecStream : public AudioStream, public VolumeSupport {
     cfg.channels = info.channels;
 
     // update codec_cfg
+    sample_bits_t old_bits = codec_cfg.i2s.bits;
+    samplerate_t old_rate = codec_cfg.i2s.rate;
     codec_cfg.i2s.bits = toCodecBits(cfg.bits_per_sample);
     codec_cfg.i2s.rate = toRate(cfg.sample_rate);
 
@@ -106,10 +108,10 @@ class I2SCodecStream : public AudioStream, public VolumeSupport {
       return;
     }
 
-    // return if there is nothing to do
-    if (cfg.sample_rate == info.sample_rate &&
-        cfg.bits_per_sample == info.bits_per_sample &&
-        cfg.channels == info.channels) {
+    // the codec registers only depend on the bits and the rate range: e.g.
+    // a change between 44100 and 48000 or of the channels only updates i2s
+    if (codec_cfg.i2s.bits == old_bits && codec_cfg.i2s.rate == old_rate) {
+      LOGI("codec: no change");
       return;
     }
 
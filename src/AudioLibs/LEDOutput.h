@@ -38,6 +38,11 @@ struct LEDOutputConfig {
   bool is_matrix_vertical = true;
   /// Influences the senitivity
   int max_magnitude = 700;
+  /// Max refresh rate in Hz: the fft results are published at most with
+  /// this rate (0 = unlimited)
+  int refresh_rate = 0;
+  /// Display log spaced bands (one per column) instead of grouped bins
+  bool log_bands = false;
 };
 
 /**
@@ -84,6 +89,8 @@ class LEDOutput {
     FastLED.clear();  // clear all pixel data
 
     if (p_fft != nullptr) {
+      if (cfg.log_bands) p_fft->setBands(cfg.x);
+      if (cfg.refresh_rate > 0) p_fft->min_update_ms = 1000 / cfg.refresh_rate;
       p_fft->begin();
     }
 
@@ -171,7 +178,7 @@ class LEDOutput {
   virtual float getMaxMagnitude() {
     // get magnitude from
     if (p_vol != nullptr) {
-      return p_vol->volume();
+      return p_vol->values().volume;
     }
     float max = 0;
     if (p_fft != nullptr) {
@@ -252,7 +259,11 @@ class LEDOutput {
 /// Default update implementation which provides the fft result as "barchart"
 void fftLEDOutput(LEDOutputConfig *cfg, LEDOutput *matrix) {
   // process horizontal
+#if defined(USE_CONCURRENCY) && !USE_SNAPSHOT
   LockGuard guard(fft_mux);
+#endif
+  // nothing to render if there is no new result
+  if (!matrix->fftDisplay().update()) return;
   for (int x = 0; x < cfg->x; x++) {
     // max y determined by magnitude
     int currY = matrix->fftDisplay().getMagnitudeScaled(x, cfg->y);
@@ -93,7 +93,7 @@ class LEDOutputUnoR4 {
   virtual float getMaxMagnitude() {
     // get magnitude from
     if (p_vol != nullptr) {
-      return p_vol->volume();
+      return p_vol->values().volume;
     }
     float max = 0;
     if (p_fft != nullptr) {
@@ -1,5 +1,6 @@
 #pragma once
 #include "AudioConfig.h"
+#include "AudioTools/PlanarFrameBuffer.h"
 #include "maximilian.h"
 #include "libs/maxiClock.h"
 
@@ -11,7 +12,10 @@ void play2(maxi_float_t *channels);//run dac!
 namespace audio_tools {
 
 /**
- * @brief AudioTools integration with Maximilian
+ * @brief AudioTools integration with Maximilian: Maximilian provides one
+ * frame per call of the play callback. The frames are collected in a planar
+ * float buffer, which is allocated in begin(), and converted to 16 bit PCM
+ * in one block.
  * @ingroup dsp
  */
 class Maximilian : public VolumeSupport {
@@ -32,6 +36,8 @@ class Maximilian : public VolumeSupport {
         void begin(AudioInfo cfg){
             this->cfg = cfg;
             maxiSettings::setup(cfg.sample_rate, cfg.channels, DEFAULT_BUFFER_SIZE);
+            frame.resize(cfg.channels);
+            buffer.resize(cfg.channels, buffer_size / sizeof(int16_t) / cfg.channels);
         }
 
         /// Defines the volume. The values are between 0.0 and 1.0
@@ -51,18 +57,18 @@ class Maximilian : public VolumeSupport {
         /// Copies the audio data from maximilian to the audio sink, Call this method from the Arduino Loop. 
         void copy() {
             // fill buffer with data
-            maxi_float_t out[cfg.channels];
-            uint16_t samples = buffer_size / sizeof(uint16_t);
-            int16_t *p_samples = (int16_t *)p_buffer;
-            for (uint16_t j=0;j<samples;j+=cfg.channels){
+            int frames = buffer.frames();
+            maxi_float_t *out = frame.data();
+            for (int j=0;j<frames;j++){
                 callback(out);
-                // convert all channels to int16
                 for (int ch=0;ch<cfg.channels;ch++){
-                    p_samples[j+ch] = volume() * out[ch] * 32767.0f;
+                    buffer.plane(ch)[j] = out[ch];
                 }
             }
+            // convert all channels to int16 in one block
+            buffer.toInterleaved(p_buffer, frames, 16, volume());
             // write buffer to audio sink
-            unsigned int result = p_sink->write(p_buffer, buffer_size);
+            unsigned int result = p_sink->write(p_buffer, frames * cfg.channels * sizeof(int16_t));
             LOGI("bytes written %u", result)
         }
 
@@ -71,6 +77,8 @@ class Maximilian : public VolumeSupport {
         int buffer_size=256;
         Print *p_sink=nullptr;
         AudioInfo cfg;
+        Vector<maxi_float_t> frame{0};
+        PlanarFrameBuffer<maxi_float_t> buffer;
         void (*callback)(maxi_float_t *channels);
 };
 
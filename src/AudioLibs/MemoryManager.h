@@ -1,10 +1,20 @@
 #pragma once
 
 #include "AudioLogger.h"
+#include "AudioBasic/Collections/Allocator.h"
 #ifdef ESP32
 #include "esp_heap_caps.h"
 #endif
 
+/// Limit for the PSRAM allocations of malloc which is active by default
+#ifndef MEMORY_MANAGER_DEFAULT_LIMIT
+#  ifdef CONFIG_SPIRAM_MALLOC_ALWAYSINTERNAL
+#    define MEMORY_MANAGER_DEFAULT_LIMIT CONFIG_SPIRAM_MALLOC_ALWAYSINTERNAL
+#  else
+#    define MEMORY_MANAGER_DEFAULT_LIMIT 16384
+#  endif
+#endif
+
 namespace audio_tools {
 
 /**
@@ -28,11 +38,103 @@ public:
 #ifdef ESP32
     LOGI("Activate PSRAM from %d bytes", limit);
     heap_caps_malloc_extmem_enable(limit);
+    activeLimit() = limit;
     return true;
 #else
     return false;
 #endif
   }
+
+  /// Logs the actual placement of the hot, cold and DMA buffers and the
+  /// values of all AllocatorTracked components together with the free
+  /// internal and PSRAM memory
+  void logReport() {
+    HotAllocator.logReport();
+    ColdAllocator.logReport();
+    DMAAllocator.logReport();
+    AllocatorTracked::logReportAll();
+#ifdef ESP32
+    LOGI("free internal: %u bytes, free psram: %u bytes",
+         (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+         (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+#endif
+  }
+
+  /// Limit which was defined by the last begin()
+  static size_t &activeLimit() {
+    static size_t limit = MEMORY_MANAGER_DEFAULT_LIMIT;
+    return limit;
+  }
+};
+
+/**
+ * @brief Defines where the memory which is allocated with malloc is placed
+ * while the object is in scope: e.g. for the state of 3rd party libraries
+ * which can not use an Allocator. With PSRAM all allocations of at least
+ * limit bytes go to PSRAM, so that the big tables are external while the
+ * small (hot) structures stay internal. With Internal everything is allocated
+ * in internal memory. At the end of the scope the limit of the MemoryManager
+ * is restored. The memory which was used in the scope can be measured with
+ * internalUsed() and psramUsed().
+ *
+ * This needs a PSRAM which is available to malloc (CONFIG_SPIRAM_USE_MALLOC)
+ * on the ESP32: on other platforms the placement is ignored.
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class MemoryPlacementScope {
+ public:
+  MemoryPlacementScope(MemoryPlacement placement, size_t limit = 4096) {
+    this->placement = placement;
+#ifdef ESP32
+    free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    free_psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    switch (placement) {
+      case MemoryPlacement::PSRAM:
+        heap_caps_malloc_extmem_enable(limit);
+        break;
+      case MemoryPlacement::Internal:
+        heap_caps_malloc_extmem_enable(SIZE_MAX);
+        break;
+      default:
+        break;
+    }
+#endif
+  }
+
+  ~MemoryPlacementScope() {
+#ifdef ESP32
+    if (placement == MemoryPlacement::PSRAM ||
+        placement == MemoryPlacement::Internal) {
+      heap_caps_malloc_extmem_enable(MemoryManager::activeLimit());
+    }
+#endif
+  }
+
+  /// Internal memory in bytes which was allocated in the scope
+  int internalUsed() {
+#ifdef ESP32
+    return (int)free_internal -
+           (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+#else
+    return 0;
+#endif
+  }
+
+  /// PSRAM in bytes which was allocated in the scope
+  int psramUsed() {
+#ifdef ESP32
+    return (int)free_psram - (int)heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+#else
+    return 0;
+#endif
+  }
+
+ protected:
+  MemoryPlacement placement;
+  size_t free_internal = 0;
+  size_t free_psram = 0;
 };
 
 }
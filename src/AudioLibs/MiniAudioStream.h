@@ -6,6 +6,7 @@
  */
 
 #include "AudioTools.h"
+#include "AudioLibs/Desktop/CallbackStatistics.h"
 #include <mutex>
 
 #define MINIAUDIO_IMPLEMENTATION
@@ -41,10 +42,17 @@ class MiniAudioConfig : public AudioInfo {
   int delay_ms_if_buffer_full = MA_DELAY;
   int buffer_count = MA_BUFFER_COUNT;
   int buffer_start_count = MA_START_COUNT;
+  /// frames per callback: 0 uses the default of the backend
+  int period_frames = 0;
 };
 
 /**
  * @brief MiniAudio: https://miniaud.io/
+ * By default the data is exchanged with the device callback via ring buffers.
+ * In pull mode (setDataSource(), setDataSink()) the callback reads the output
+ * directly from the source (e.g. a GeneratedSoundStream or a whole stream
+ * chain) and writes the input directly to the sink, so the pipeline runs in
+ * the audio thread w/o any intermediate buffer and latency.
  * @ingroup io
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -116,8 +124,11 @@ class MiniAudioStream : public AudioStream {
 
     config_ma.pUserData = this;
     config_ma.playback.channels = config.channels;
+    config_ma.capture.channels = config.channels;
     config_ma.sampleRate = config.sample_rate;
     config_ma.dataCallback = data_callback;
+    if (config.period_frames > 0)
+      config_ma.periodSizeInFrames = config.period_frames;
     switch (config.bits_per_sample) {
       case 8:
         config_ma.playback.format = ma_format_u8;
@@ -135,6 +146,8 @@ class MiniAudioStream : public AudioStream {
         LOGE("Invalid format");
         return false;
     }
+    config_ma.capture.format = config_ma.playback.format;
+    stats.reset();
 
     if (ma_device_init(NULL, &config_ma, &device_ma) != MA_SUCCESS) {
       // Failed to initialize the device.
@@ -198,6 +211,17 @@ class MiniAudioStream : public AudioStream {
     return buffer_in.size() == 0 ? 0 : buffer_in.available();
   }
 
+  /// Pull mode: the callback reads the output data directly from the source.
+  /// Call before begin()
+  void setDataSource(Stream &source) { p_source = &source; }
+
+  /// Pull mode: the callback writes the captured data directly to the sink.
+  /// Call before begin()
+  void setDataSink(Print &sink) { p_sink = &sink; }
+
+  /// Provides the xrun counter and the timing of the callback
+  CallbackStatistics &statistics() { return stats; }
+
   size_t readBytes(uint8_t *data, size_t len) override {
     if (buffer_in.size() == 0) return 0;
     LOGD("write: %zu", len);
@@ -217,6 +241,9 @@ class MiniAudioStream : public AudioStream {
   std::mutex write_mtx;
   std::mutex read_mtx;
   int buffer_size = 0;
+  Stream *p_source = nullptr;
+  Print *p_sink = nullptr;
+  CallbackStatistics stats;
 
   // In playback mode copy data to pOutput. In capture mode read data from
   // pInput. In full-duplex mode, both pOutput and pInput will be valid and
@@ -247,6 +274,12 @@ class MiniAudioStream : public AudioStream {
     AudioInfo cfg = self->audioInfo();
 
     int bytes = frameCount * cfg.channels * cfg.bits_per_sample / 8;
+    self->stats.begin();
+    if (self->isPullMode()) {
+      self->pullCallback(pOutput, pInput, bytes);
+      self->stats.end(frameCount, cfg.sample_rate);
+      return;
+    }
     self->setupBuffers(bytes);
 
     if (pInput) {
@@ -279,9 +312,40 @@ class MiniAudioStream : public AudioStream {
             open -= len;
             processed += len;
           }
-          if (len != bytes) self->doWait();
+          if (len != bytes) {
+            self->stats.addXRun();
+            self->doWait();
+          }
+        }
+      }
+    }
+    self->stats.end(frameCount, cfg.sample_rate);
+  }
+
+  bool isPullMode() { return p_source != nullptr || p_sink != nullptr; }
+
+  /// Processes the data in the audio thread w/o any buffer
+  void pullCallback(void *pOutput, const void *pInput, int bytes) {
+    if (pInput && p_sink != nullptr) {
+      if (p_sink->write((const uint8_t *)pInput, bytes) != bytes)
+        stats.addXRun();
+    }
+    if (pOutput) {
+      int processed = 0;
+      if (p_source != nullptr) {
+        // the source might provide the data in smaller pieces
+        while (processed < bytes) {
+          size_t len =
+              p_source->readBytes((uint8_t *)pOutput + processed,
+                                  bytes - processed);
+          if (len == 0) break;
+          processed += len;
         }
       }
+      if (processed < bytes) {
+        if (p_source != nullptr) stats.addXRun();
+        memset((uint8_t *)pOutput + processed, 0, bytes - processed);
+      }
     }
   }
 };
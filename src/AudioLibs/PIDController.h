@@ -41,9 +41,13 @@ public:
     // Proportional term
     float pout = kp * error;
 
-    // Interal term
+    // Interal term: limited to the output range (anti windup)
     integral += error * dt;
     float Iout = ki * integral;
+    if (ki != 0.0f && (Iout > max || Iout < min)) {
+      Iout = Iout > max ? max : min;
+      integral = Iout / ki;
+    }
 
     // Derivative term
     assert(dt!=0.0);
@@ -0,0 +1,305 @@
+#pragma once
+
+#include "AudioLibs/AudioFFT.h"
+
+namespace audio_tools {
+
+class PitchDetection;
+
+/**
+ * @brief Configuration for PitchDetection: the window size defines the lowest
+ * frequency which can be detected (at least 2 periods should fit into the
+ * window). The hop size defines how often the pitch is determined.
+ * @ingroup fft
+ */
+struct PitchDetectionConfig : public AudioInfo {
+  PitchDetectionConfig() {
+    channels = 1;
+    bits_per_sample = 16;
+    sample_rate = 44100;
+  }
+  /// Callback method which is called after we got a new result
+  void (*callback)(PitchDetection &pitch) = nullptr;
+  /// Channel which is used as input
+  uint8_t channel_used = 0;
+  /// number of analyzed samples: the FFT length is 2 * length
+  int length = 2048;
+  /// samples between 2 detections: 0 or length for non overlapping frames
+  int stride = 512;
+  /// frequency range
+  float min_frequency = 40.0f;
+  float max_frequency = 2000.0f;
+  /// the first peak of the normalized autocorrelation which is above
+  /// cutoff * max peak is used (McLeod pitch method)
+  float cutoff = 0.93f;
+  /// results with a lower clarity are reported with a frequency of 0
+  float min_clarity = 0.5f;
+};
+
+/**
+ * @brief Result of the PitchDetection
+ * @ingroup fft
+ */
+struct PitchResult {
+  /// Frequency in Hz: 0 if no pitch was found
+  float frequency = 0.0f;
+  /// Peak of the normalized autocorrelation (0.0 to 1.0)
+  float clarity = 0.0f;
+
+  const char *note() { return AudioFFTNotes.note(frequency); }
+  const char *note(float &diff) { return AudioFFTNotes.note(frequency, diff); }
+  int midiNote() { return AudioFFTNotes.frequencyToMidiNote(frequency); }
+};
+
+/**
+ * @brief Pitch detection with the McLeod pitch method (MPM): the
+ * autocorrelation of the zero padded window is calculated with the FFT
+ * driver in O(N log N) as inverse FFT of the power spectrum. The driver
+ * which is passed in the constructor must support the reverse FFT (e.g.
+ * FFTDriverRealFFT). The pitch is determined after each stride, so the
+ * windows can overlap.
+ * @ingroup fft
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class PitchDetection : public AudioOutput {
+ public:
+  PitchDetection(FFTDriver *driver) { p_driver = driver; }
+
+  ~PitchDetection() { end(); }
+
+  /// Provides the default configuration
+  PitchDetectionConfig defaultConfig() {
+    PitchDetectionConfig cfg;
+    return cfg;
+  }
+
+  /// starts the processing
+  bool begin(PitchDetectionConfig cfg) {
+    this->cfg = cfg;
+    return begin();
+  }
+
+  /// starts the processing
+  bool begin() override {
+    if (!p_driver->isReverseFFT()) {
+      LOGE("The driver must support the reverse fft");
+      return false;
+    }
+    fft_length = 1;
+    while (fft_length < 2 * cfg.length) fft_length <<= 1;
+    if (!p_driver->begin(fft_length) || !p_driver->isValid()) {
+      LOGE("Not enough memory");
+      return false;
+    }
+    samples.resize(cfg.length);
+    nsdf.resize(cfg.length);
+    memset(samples.data(), 0, cfg.length * sizeof(float));
+    available = 0;
+    current_pos = 0;
+    hop_count = 0;
+    channel = 0;
+    return true;
+  }
+
+  /// Release the allocated memory
+  void end() override { p_driver->end(); }
+
+  /// Notify change of audio information
+  void setAudioInfo(AudioInfo info) override {
+    cfg.bits_per_sample = info.bits_per_sample;
+    cfg.sample_rate = info.sample_rate;
+    cfg.channels = info.channels;
+    begin(cfg);
+  }
+
+  AudioInfo audioInfo() override { return cfg; }
+
+  /// Provide the audio data
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!p_driver->isValid()) return 0;
+    switch (cfg.bits_per_sample) {
+      case 16:
+        processSamples<int16_t>(data, len / 2);
+        break;
+      case 24:
+        processSamples<int24_t>(data, len / 3);
+        break;
+      case 32:
+        processSamples<int32_t>(data, len / 4);
+        break;
+      default:
+        LOGE("Unsupported bits_per_sample: %d", cfg.bits_per_sample);
+        return 0;
+    }
+    return len;
+  }
+
+  int availableForWrite() override {
+    return cfg.bits_per_sample / 8 * cfg.channels * hopSize();
+  }
+
+  /// Number of samples between 2 detections
+  int hopSize() {
+    return cfg.stride > 0 && cfg.stride < cfg.length ? cfg.stride
+                                                     : cfg.length;
+  }
+
+  /// Last result
+  PitchResult result() { return pitch; }
+
+  /// Normalized square difference function of the last window
+  float *nsdfArray() { return nsdf.data(); }
+
+  /// time when the last result was provided
+  unsigned long resultTime() { return timestamp; }
+
+  /// provides access to the FFTDriver
+  FFTDriver *driver() { return p_driver; }
+
+  operator bool() { return p_driver != nullptr && p_driver->isValid(); }
+
+ protected:
+  PitchDetectionConfig cfg;
+  FFTDriver *p_driver = nullptr;
+  Vector<float> samples{0};
+  Vector<float> nsdf{0};
+  PitchResult pitch;
+  int fft_length = 0;
+  int available = 0;
+  int current_pos = 0;
+  int hop_count = 0;
+  int channel = 0;
+  unsigned long timestamp = 0;
+
+  template <typename T>
+  void processSamples(const void *data, size_t count) {
+    const T *p_data = (const T *)data;
+    float max_value = NumberConverter::maxValueT<T>();
+    for (size_t j = 0; j < count; j++) {
+      int ch = channel;
+      channel = (channel + 1) % cfg.channels;
+      if (ch != cfg.channel_used) continue;
+      T value = p_data[j];
+      samples[current_pos++] = static_cast<float>(value) / max_value;
+      if (available < cfg.length) available++;
+      if (current_pos >= cfg.length) current_pos = 0;
+      if (available == cfg.length && ++hop_count >= hopSize()) {
+        hop_count = 0;
+        detect();
+      }
+    }
+  }
+
+  /// Provides the sample at the indicated position of the sliding window
+  inline float sample(int idx) {
+    int pos = current_pos + idx;
+    return samples[pos >= cfg.length ? pos - cfg.length : pos];
+  }
+
+  void detect() {
+    int n = cfg.length;
+    // autocorrelation: inverse fft of the power spectrum of the zero padded
+    // window
+    float energy = 0.0f;
+    float *input = p_driver->inputArray();
+    for (int j = 0; j < fft_length; j++) {
+      float value = j < n ? sample(j) : 0.0f;
+      energy += value * value;
+      if (input != nullptr) {
+        input[j] = value;
+      } else {
+        p_driver->setValue(j, value);
+      }
+    }
+    pitch.frequency = 0.0f;
+    pitch.clarity = 0.0f;
+    if (energy > 0.0f) {
+      p_driver->fft();
+      FFTBin bin{0.0f, 0.0f};
+      for (int k = 0; k <= fft_length / 2; k++) {
+        p_driver->getBin(k, bin);
+        p_driver->setBin(k, bin.real * bin.real + bin.img * bin.img, 0.0f);
+      }
+      p_driver->rfft();
+      calculateNSDF(energy);
+      findPitch();
+    }
+    timestamp = millis();
+    if (cfg.callback != nullptr) cfg.callback(*this);
+  }
+
+  /// n(tau) = 2 r(tau) / m(tau) with m(tau) = sum x(j)^2 + x(j+tau)^2
+  void calculateNSDF(float energy) {
+    int n = cfg.length;
+    // the scaling of the inverse fft depends on the driver
+    float scale = p_driver->getValue(0);
+    if (scale <= 0.0f) return;
+    scale = energy / scale;
+    float m = 2.0f * energy;
+    for (int tau = 0; tau < n; tau++) {
+      if (tau > 0) {
+        float a = sample(tau - 1);
+        float b = sample(n - tau);
+        m -= a * a + b * b;
+      }
+      nsdf[tau] = m > 0.0f ? 2.0f * p_driver->getValue(tau) * scale / m : 0.0f;
+    }
+  }
+
+  /// Selects the first key maximum above cutoff * highest maximum
+  void findPitch() {
+    int n = cfg.length;
+    int min_tau = cfg.max_frequency > 0 ? cfg.sample_rate / cfg.max_frequency
+                                        : 1;
+    int max_tau = cfg.min_frequency > 0 ? cfg.sample_rate / cfg.min_frequency
+                                        : n - 1;
+    if (min_tau < 1) min_tau = 1;
+    if (max_tau > n - 2) max_tau = n - 2;
+    // skip the initial positive lobe
+    int tau = 1;
+    while (tau < max_tau && nsdf[tau] > 0.0f) tau++;
+    // collect the key maxima between positive zero crossings
+    const int max_peaks = 32;
+    int peaks[max_peaks];
+    int peak_count = 0;
+    float highest = 0.0f;
+    while (tau < max_tau && peak_count < max_peaks) {
+      while (tau < max_tau && nsdf[tau] <= 0.0f) tau++;
+      int best = -1;
+      while (tau < max_tau && nsdf[tau] > 0.0f) {
+        if (tau >= min_tau && (best < 0 || nsdf[tau] > nsdf[best])) best = tau;
+        tau++;
+      }
+      if (best > 0) {
+        peaks[peak_count++] = best;
+        if (nsdf[best] > highest) highest = nsdf[best];
+      }
+    }
+    float limit = cfg.cutoff * highest;
+    for (int j = 0; j < peak_count; j++) {
+      int idx = peaks[j];
+      if (nsdf[idx] >= limit) {
+        float delta = 0.0f;
+        float clarity = interpolate(idx, delta);
+        if (clarity < cfg.min_clarity) return;
+        pitch.clarity = clarity > 1.0f ? 1.0f : clarity;
+        pitch.frequency = cfg.sample_rate / (idx + delta);
+        return;
+      }
+    }
+  }
+
+  /// parabolic interpolation of the peak: returns the peak value
+  float interpolate(int idx, float &delta) {
+    float a = nsdf[idx - 1];
+    float b = nsdf[idx];
+    float c = nsdf[idx + 1];
+    float div = a - 2.0f * b + c;
+    if (div == 0.0f) return b;
+    delta = 0.5f * (a - c) / div;
+    return b - 0.25f * (a - c) * delta;
+  }
+};
+
+}  // namespace audio_tools
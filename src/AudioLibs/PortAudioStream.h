@@ -5,6 +5,7 @@
  */
 
 #include "AudioTools.h"
+#include "AudioLibs/Desktop/CallbackStatistics.h"
 #include "portaudio.h"
 
 namespace audio_tools {
@@ -29,10 +30,18 @@ class PortAudioConfig : public AudioInfo {
 
         bool is_input = false;
         bool is_output = true;
+        /// frames per callback: paFramesPerBufferUnspecified (0) lets
+        /// portaudio decide
+        int frames_per_buffer = paFramesPerBufferUnspecified;
 };
 
 /**
- * @brief Arduino Audio Stream using PortAudio
+ * @brief Arduino Audio Stream using PortAudio. By default we use the blocking
+ * read and write API. In pull mode (setDataSource(), setDataSink()) portaudio
+ * calls our callback, which reads the output directly from the source (e.g. a
+ * GeneratedSoundStream or a whole stream chain) and writes the input directly
+ * to the sink: so the pipeline runs in the audio thread w/o any intermediate
+ * buffer.
  * @ingroup io
  */
 class PortAudioStream : public AudioStream {
@@ -106,7 +115,8 @@ class PortAudioStream : public AudioStream {
                 }
 
                 // calculate frames
-                int buffer_frames = paFramesPerBufferUnspecified; //buffer_size / bytes / info.channels;
+                int buffer_frames = info.frames_per_buffer; //buffer_size / bytes / info.channels;
+                stats.reset();
 
                 // Open an audio I/O stream. 
                 LOGD("Pa_OpenDefaultStream");
@@ -116,13 +126,17 @@ class PortAudioStream : public AudioStream {
                     getFormat(),      // format  
                     info.sample_rate,                     // sample rate
                     buffer_frames,                        // frames per buffer 
-                    nullptr,   
-                    nullptr ); 
+                    isPullMode() ? stream_callback : nullptr,
+                    this ); 
                 LOGD("Pa_OpenDefaultStream - done");
                 if( err != paNoError && err!= paOutputUnderflow ) {
                     LOGE(  "PortAudio error: %s\n", Pa_GetErrorText( err ) );
                     return false;
                 }
+                // in pull mode there is no write to trigger the start
+                if (isPullMode()) {
+                    startStream();
+                }
             } else {
                 LOGI("basic audio information is missing...");
                 return false;
@@ -148,6 +162,21 @@ class PortAudioStream : public AudioStream {
             return err == paNoError;
         }
 
+        /// Pull mode: the callback reads the output data directly from the source. Call before begin()
+        void setDataSource(Stream &source) {
+            p_source = &source;
+        }
+
+        /// Pull mode: the callback writes the captured data directly to the sink. Call before begin()
+        void setDataSink(Print &sink) {
+            p_sink = &sink;
+        }
+
+        /// Provides the xrun counter and the timing of the callback
+        CallbackStatistics &statistics() {
+            return stats;
+        }
+
         size_t write(const uint8_t* data, size_t len) override {  
             LOGD("write: %zu", len);
 
@@ -193,6 +222,42 @@ class PortAudioStream : public AudioStream {
         PortAudioConfig info;
         bool stream_started = false;
         int buffer_size = 10*1024;
+        Stream *p_source = nullptr;
+        Print *p_sink = nullptr;
+        CallbackStatistics stats;
+
+        bool isPullMode() {
+            return p_source != nullptr || p_sink != nullptr;
+        }
+
+        static int stream_callback(const void *input, void *output, unsigned long frameCount,
+                                   const PaStreamCallbackTimeInfo *timeInfo,
+                                   PaStreamCallbackFlags statusFlags, void *userData) {
+            PortAudioStream *self = (PortAudioStream *)userData;
+            self->stats.begin();
+            if (statusFlags & (paInputUnderflow | paInputOverflow | paOutputUnderflow | paOutputOverflow)) {
+                self->stats.addXRun();
+            }
+            int bytes = frameCount * self->info.channels * self->bytesPerSample();
+            if (input != nullptr && self->p_sink != nullptr) {
+                self->p_sink->write((const uint8_t *)input, bytes);
+            }
+            if (output != nullptr) {
+                int processed = 0;
+                if (self->p_source != nullptr) {
+                    // the source might provide the data in smaller pieces
+                    while (processed < bytes) {
+                        size_t len = self->p_source->readBytes((uint8_t *)output + processed, bytes - processed);
+                        if (len == 0) break;
+                        processed += len;
+                    }
+                    if (processed < bytes) self->stats.addXRun();
+                }
+                memset((uint8_t *)output + processed, 0, bytes - processed);
+            }
+            self->stats.end(frameCount, self->info.sample_rate);
+            return paContinue;
+        }
 
         int bytesPerSample(){
             //return info.bits_per_sample / 8;
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioTypes.h"
+#if defined(ESP32) && defined(CONFIG_PM_ENABLE)
+#  include "esp_idf_version.h"
+#  include "esp_pm.h"
+#  define USE_ESP_PM
+#endif
+
+/// Target ratio of processing time to audio duration for the cpu frequency
+#ifndef POWER_MANAGER_TARGET_LOAD
+#  define POWER_MANAGER_TARGET_LOAD 0.6f
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Power management for battery powered devices: by default the ESP32
+ * runs at the max cpu frequency all the time. With the PowerManager the ESP-IDF
+ * power management locks are only taken while a block is processed
+ * (between startBlock() and endBlock()), so that the cpu can reduce the
+ * frequency and use light sleep in the idle gaps e.g. while the I2S DMA
+ * buffers are played.
+ *
+ * The processing time is measured and compared with the duration of the
+ * processed audio: the max frequency is reduced to the smallest frequency
+ * which keeps the load below the target load (see
+ * POWER_MANAGER_TARGET_LOAD) and is increased immediately if the load gets
+ * too high.
+ *
+ * This needs an ESP-IDF build with CONFIG_PM_ENABLE: on all other platforms
+ * only the load is measured.
+ * @code
+ * PowerManager pm;
+ * pm.begin(info, 240, 80);
+ * ...
+ * pm.startBlock();
+ * size_t bytes = copier.copy();
+ * pm.endBlock(bytes);
+ * @endcode
+ * @ingroup memorymgmt
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class PowerManager {
+ public:
+  PowerManager() = default;
+
+  ~PowerManager() { end(); }
+
+  /// Defines the load which should not be exceeded
+  void setTargetLoad(float load) { target_load = load; }
+
+  /// Time over which the load is measured before the frequency is reduced
+  void setInterval(uint32_t ms) { interval_ms = ms; }
+
+  /// Activates the power management with the indicated frequency range
+  bool begin(AudioInfo info, int maxMhz = 240, int minMhz = 80,
+             bool lightSleep = true) {
+    bytes_per_second =
+        info.sample_rate * info.channels * info.bits_per_sample / 8;
+    max_mhz = maxMhz;
+    min_mhz = minMhz;
+    light_sleep = lightSleep;
+    active_mhz = maxMhz;
+    sum_us = 0;
+    sum_bytes = 0;
+    interval_start_ms = millis();
+#ifdef USE_ESP_PM
+    if (lock_cpu == nullptr &&
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "audio_cpu", &lock_cpu) !=
+            ESP_OK) {
+      LOGE("esp_pm_lock_create");
+      return false;
+    }
+    if (lock_sleep == nullptr &&
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "audio_sleep",
+                           &lock_sleep) != ESP_OK) {
+      LOGE("esp_pm_lock_create");
+      return false;
+    }
+    return configure(active_mhz);
+#else
+    LOGW("power management not supported");
+    return false;
+#endif
+  }
+
+  /// Releases the locks
+  void end() {
+    if (is_locked) endBlock(0);
+#ifdef USE_ESP_PM
+    if (lock_cpu != nullptr) esp_pm_lock_delete(lock_cpu);
+    if (lock_sleep != nullptr) esp_pm_lock_delete(lock_sleep);
+    lock_cpu = nullptr;
+    lock_sleep = nullptr;
+#endif
+  }
+
+  /// Call before the processing of a block: the cpu runs at the active max
+  /// frequency and must not sleep
+  void startBlock() {
+    if (is_locked) return;
+#ifdef USE_ESP_PM
+    if (lock_cpu != nullptr) esp_pm_lock_acquire(lock_cpu);
+    if (lock_sleep != nullptr) esp_pm_lock_acquire(lock_sleep);
+#endif
+    is_locked = true;
+    start_us = micros();
+  }
+
+  /// Call after the processing of a block with the number of processed bytes:
+  /// the cpu may reduce the frequency or sleep until the next block
+  void endBlock(size_t bytes) {
+    if (!is_locked) return;
+    sum_us += (uint32_t)(micros() - start_us);
+    sum_bytes += bytes;
+    is_locked = false;
+#ifdef USE_ESP_PM
+    if (lock_sleep != nullptr) esp_pm_lock_release(lock_sleep);
+    if (lock_cpu != nullptr) esp_pm_lock_release(lock_cpu);
+#endif
+    update();
+  }
+
+  /// Frequency in MHz which is used while processing
+  int frequencyMhz() { return active_mhz; }
+
+  /// Load at the active frequency of the last interval
+  float load() { return last_load; }
+
+ protected:
+#ifdef USE_ESP_PM
+  esp_pm_lock_handle_t lock_cpu = nullptr;
+  esp_pm_lock_handle_t lock_sleep = nullptr;
+#endif
+  float target_load = POWER_MANAGER_TARGET_LOAD;
+  uint32_t interval_ms = 1000;
+  uint32_t bytes_per_second = 0;
+  int max_mhz = 240;
+  int min_mhz = 80;
+  int active_mhz = 240;
+  bool light_sleep = true;
+  bool is_locked = false;
+  uint32_t start_us = 0;
+  uint64_t sum_us = 0;
+  uint64_t sum_bytes = 0;
+  uint32_t interval_start_ms = 0;
+  float last_load = 0.0f;
+
+  /// Determines the frequency from the measured load
+  void update() {
+    if (bytes_per_second == 0 || sum_bytes == 0) return;
+    float audio_us = 1000000.0f * sum_bytes / bytes_per_second;
+    float load = sum_us / audio_us;
+    // react immediately if the load is too high
+    bool is_overload = load > target_load && active_mhz < max_mhz;
+    if (!is_overload && millis() - interval_start_ms < interval_ms) return;
+    last_load = load;
+    int mhz = requiredMhz(load);
+    if (mhz != active_mhz) {
+      LOGI("load %.2f: cpu %d -> %d MHz", load, active_mhz, mhz);
+      configure(mhz);
+    }
+    sum_us = 0;
+    sum_bytes = 0;
+    interval_start_ms = millis();
+  }
+
+  /// Smallest supported frequency which keeps the load below the target
+  int requiredMhz(float load) {
+    float needed = active_mhz * load / target_load;
+    const int steps[] = {80, 160, 240};
+    for (int mhz : steps) {
+      if (mhz >= min_mhz && mhz <= max_mhz && mhz >= needed) return mhz;
+    }
+    return max_mhz;
+  }
+
+  bool configure(int mhz) {
+    active_mhz = mhz;
+#ifdef USE_ESP_PM
+#  if ESP_IDF_VERSION_MAJOR >= 5
+    esp_pm_config_t cfg;
+#  else
+    esp_pm_config_esp32_t cfg;
+#  endif
+    cfg.max_freq_mhz = mhz;
+    cfg.min_freq_mhz = min_mhz < mhz ? min_mhz : mhz;
+    cfg.light_sleep_enable = light_sleep;
+    if (esp_pm_configure(&cfg) != ESP_OK) {
+      LOGE("esp_pm_configure");
+      return false;
+    }
+#endif
+    return true;
+  }
+};
+
+}  // namespace audio_tools
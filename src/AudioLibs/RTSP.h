@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 
 #include "AudioStreamer.h"
 #include "AudioTools/AudioPlayer.h"
@@ -14,6 +15,17 @@
  * @copyright GPLv3
  */
 
+/// Number of preallocated RTP payloads in the RTSPPacketPool
+#ifndef RTSP_PACKET_POOL_COUNT
+#  define RTSP_PACKET_POOL_COUNT 8
+#endif
+
+/// Timer ticks per packet duration which are used for the pacing: this
+/// defines the max jitter
+#ifndef RTSP_PACING_TICKS
+#  define RTSP_PACING_TICKS 4
+#endif
+
 namespace audio_tools {
 
 /**
@@ -503,6 +515,212 @@ public:
   }
 };
 
+/**
+ * @brief Preallocated pool of RTP payloads: the producer (e.g. the encoder)
+ * fills the packets ahead of time and only complete packets are provided to
+ * the consumer, so we never send short packets. The packets are encoded only
+ * once, independent of the number of clients. The RTP timestamp of each
+ * packet is derived from the number of frames per packet. One producer and
+ * one consumer task are supported w/o locking.
+ * @ingroup rtsp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class RTSPPacketPool : public AudioOutput {
+public:
+  RTSPPacketPool() = default;
+
+  /// Allocates the packets: framesPerPacket defines the timestamp increment
+  bool begin(int packetSize, int packetCount, uint32_t framesPerPacket) {
+    if (packetSize <= 0 || packetCount <= 0) {
+      LOGE("Invalid packet size or count");
+      return false;
+    }
+    packet_size = packetSize;
+    packet_count = packetCount;
+    frames_per_packet = framesPerPacket;
+    memory.resize(packet_size * packet_count);
+    reset();
+    return true;
+  }
+
+  void end() override {
+    memory.resize(0);
+    packet_count = 0;
+  }
+
+  /// Removes all packets
+  void reset() {
+    write_count = 0;
+    read_count = 0;
+    write_pos = 0;
+  }
+
+  /// Producer: adds the data; completed packets are made available
+  size_t write(const uint8_t *data, size_t len) override {
+    size_t result = 0;
+    while (result < len && packet_count > 0) {
+      uint32_t count = write_count.load(std::memory_order_relaxed);
+      // no free packet
+      if (count - read_count.load(std::memory_order_acquire) >=
+          (uint32_t)packet_count)
+        break;
+      uint8_t *packet = packetData(count);
+      size_t n = min(len - result, (size_t)(packet_size - write_pos));
+      memcpy(packet + write_pos, data + result, n);
+      write_pos += n;
+      result += n;
+      if (write_pos == packet_size) {
+        write_pos = 0;
+        write_count.store(count + 1, std::memory_order_release);
+      }
+    }
+    if (result < len) LOGD("packet pool full: %d", (int)(len - result));
+    return result;
+  }
+
+  /// Producer: number of bytes which can be written
+  int availableForWrite() override {
+    uint32_t used = write_count.load(std::memory_order_relaxed) -
+                    read_count.load(std::memory_order_acquire);
+    return (packet_count - used) * packet_size - write_pos;
+  }
+
+  /// Consumer: number of complete packets
+  int available() {
+    return write_count.load(std::memory_order_acquire) -
+           read_count.load(std::memory_order_relaxed);
+  }
+
+  /// Consumer: RTP timestamp (in frames) of the next packet
+  uint32_t nextTimestamp() {
+    return read_count.load(std::memory_order_relaxed) * frames_per_packet;
+  }
+
+  /// Consumer: copies the next packet: returns 0 if there is none
+  int read(uint8_t *dest, int len) {
+    if (available() == 0) return 0;
+    uint32_t count = read_count.load(std::memory_order_relaxed);
+    int result = min(len, packet_size);
+    memcpy(dest, packetData(count), result);
+    read_count.store(count + 1, std::memory_order_release);
+    return result;
+  }
+
+  int packetSize() { return packet_size; }
+
+  uint32_t framesPerPacket() { return frames_per_packet; }
+
+protected:
+  Vector<uint8_t> memory{0};
+  int packet_size = 0;
+  int packet_count = 0;
+  uint32_t frames_per_packet = 0;
+  int write_pos = 0;
+  std::atomic<uint32_t> write_count{0};
+  std::atomic<uint32_t> read_count{0};
+
+  uint8_t *packetData(uint32_t count) {
+    return memory.data() + (count % packet_count) * packet_size;
+  }
+};
+
+/**
+ * @brief IAudioSource which provides the packets of a RTSPPacketPool paced
+ * by their RTP timestamps: the timer of the AudioStreamer runs with
+ * RTSP_PACING_TICKS ticks per packet and a packet is only provided when its
+ * timestamp is due. So the jitter is limited to a fraction of the packet
+ * duration and a late timer does not accumulate any drift. If the producer
+ * is late we skip the tick instead of sending a short or empty packet and
+ * resynchronize the clock when the next packet is available.
+ * Depends on the https://github.com/pschatzmann/Micro-RTSP-Audio/ library
+ * @ingroup rtsp
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class RTSPSourcePacketPool : public IAudioSource {
+public:
+  RTSPSourcePacketPool() = default;
+  RTSPSourcePacketPool(RTSPPacketPool &pool, RTSPFormatAudioTools &format) {
+    setPacketPool(pool);
+    setFormat(&format);
+  }
+
+  void setPacketPool(RTSPPacketPool &pool) { p_pool = &pool; }
+
+  /// Defines the sample rate which is used for the RTP timestamps
+  void setSampleRate(int rate) { sample_rate = rate; }
+
+  /// Number of packets which must be available before we start to send
+  void setPrefillPackets(int count) { prefill = count; }
+
+  void setFormat(RTSPFormatAudioTools *format) {
+    p_format = format;
+    IAudioSource::setFormat(format);
+  }
+
+  RTSPFormat *getFormat() override { return p_format; }
+
+  /// Provides the next packet if it is due: otherwise we return 0
+  int readBytes(void *dest, int byteCount) override {
+    if (!started || p_pool == nullptr || sample_rate <= 0) return 0;
+    if (!is_synchronized) {
+      // (re)start the clock when enough packets are available
+      if (p_pool->available() < prefill) return 0;
+      start_us = micros() - timestampUs(p_pool->nextTimestamp());
+      is_synchronized = true;
+    }
+    // wrap around safe comparison
+    uint32_t due = start_us + timestampUs(p_pool->nextTimestamp());
+    if ((int32_t)((uint32_t)micros() - due) < 0) return 0;
+    if (p_pool->available() == 0) {
+      // underflow: resynchronize
+      is_synchronized = false;
+      return 0;
+    }
+    return p_pool->read((uint8_t *)dest, byteCount);
+  }
+
+  void start() override {
+    TRACEI();
+    IAudioSource::start();
+    is_synchronized = false;
+    started = true;
+    updateTimerPeriod();
+  }
+
+  void stop() override {
+    TRACEI();
+    IAudioSource::stop();
+    started = false;
+  }
+
+  bool isStarted() { return started; }
+
+  /// Sets the fragment size to the packet size and the timer period to a
+  /// fraction of the packet duration
+  void updateTimerPeriod() {
+    if (p_pool == nullptr || p_format == nullptr || sample_rate <= 0) return;
+    p_format->setFragmentSize(p_pool->packetSize());
+    uint64_t packet_us =
+        (uint64_t)p_pool->framesPerPacket() * 1000000 / sample_rate;
+    p_format->setTimerPeriod(packet_us / RTSP_PACING_TICKS);
+  }
+
+protected:
+  RTSPPacketPool *p_pool = nullptr;
+  RTSPFormatAudioTools *p_format = nullptr;
+  int sample_rate = 0;
+  int prefill = 2;
+  uint32_t start_us = 0;
+  bool is_synchronized = false;
+  bool started = false;
+
+  uint32_t timestampUs(uint32_t timestamp) {
+    return (uint64_t)timestamp * 1000000 / sample_rate;
+  }
+};
+
 /**
  * @brief We can write PCM data to the RTSPOutput. This is encoded by the
  * indicated encoder (e.g. SBCEncoder) and can be consumed by a RTSPServer.
@@ -532,6 +750,16 @@ public:
 
   AudioStreamer *streamer() { return &rtsp_streamer; }
 
+  /// Uses a preallocated pool of complete packets with timestamp based
+  /// pacing instead of the ring buffer: call before begin(). The
+  /// framesPerPacket are determined from the fragment size for PCM data and
+  /// must be provided for encoded data.
+  void setPacketPool(int packetCount = RTSP_PACKET_POOL_COUNT,
+                     uint32_t framesPerPacket = 0) {
+    pool_count = packetCount;
+    pool_frames_per_packet = framesPerPacket;
+  }
+
   bool begin(AudioInfo info) {
     cfg = info;
     return begin();
@@ -552,6 +780,7 @@ public:
       return false;
     }
     p_encoder->setAudioInfo(cfg);
+    if (pool_count > 0) return beginPacketPool();
     p_encoder->begin();
     p_format->begin(cfg);
     // setup the AudioStreamer
@@ -564,13 +793,19 @@ public:
     return true;
   }
 
-  void end() { rtps_source.stop(); }
+  void end() {
+    rtps_source.stop();
+    pool_source.stop();
+  }
 
   /** We do not know exactly how much we can write because the encoded audio
    * is using less space. But providing the available buffer should cover
    * the worst case.
    */
   int availableForWrite() {
+    if (pool_count > 0) {
+      return pool_source.isStarted() ? packet_pool.availableForWrite() : 0;
+    }
     return rtps_source.isStarted() ? buffer.available() : 0;
   }
 
@@ -585,7 +820,9 @@ public:
   }
 
   /// @brief Returns true if the server has been started
-  operator bool() { return rtps_source.isActive(); }
+  operator bool() {
+    return pool_count > 0 ? pool_source.isStarted() : rtps_source.isActive();
+  }
 
 protected:
   RTSPFormatPCM pcm;
@@ -596,6 +833,28 @@ protected:
   AudioEncoder *p_encoder = &copy_encoder;
   RTSPFormatAudioTools *p_format = &pcm;
   AudioStreamer rtsp_streamer;
+  RTSPPacketPool packet_pool;
+  RTSPSourcePacketPool pool_source;
+  int pool_count = 0;
+  uint32_t pool_frames_per_packet = 0;
+
+  bool beginPacketPool() {
+    p_format->begin(cfg);
+    int packet_size = p_format->fragmentSize();
+    uint32_t frames = pool_frames_per_packet;
+    if (frames == 0) {
+      frames = packet_size / (cfg.bits_per_sample / 8 * cfg.channels);
+    }
+    if (!packet_pool.begin(packet_size, pool_count, frames)) return false;
+    p_encoder->setOutput(packet_pool);
+    p_encoder->begin();
+    pool_source.setPacketPool(packet_pool);
+    pool_source.setFormat(p_format);
+    pool_source.setSampleRate(cfg.sample_rate);
+    pool_source.start();
+    rtsp_streamer.setAudioSource(&pool_source);
+    return true;
+  }
 };
 
 // legacy name
@@ -9,9 +9,37 @@
 
 namespace audio_tools {
 
+/// Header of the binary index file (idx.bin): it is followed by the offset
+/// table (one uint32_t per entry), the optional hash table sorted by hash
+/// (SDIndexHash per entry) and the 0 terminated file names.
+struct SDIndexHeader {
+  char magic[4] = {'A', 'I', 'D', 'X'};
+  uint16_t version = 1;
+  uint16_t flags = 0;
+  uint32_t count = 0;
+  uint32_t offsets_pos = 0;
+  uint32_t hashes_pos = 0;
+  uint32_t strings_pos = 0;
+  /// hash of the index definition (start dir, extension and pattern)
+  uint32_t key_hash = 0;
+  /// last modification time of the start directory
+  uint32_t signature = 0;
+};
+
+/// Entry of the hash table of the binary index file
+struct SDIndexHash {
+  uint32_t hash;
+  uint32_t index;
+};
+
 /**
  * @brief We store all the relevant file names in an sequential index
- * file. Form there we can access them via an index
+ * file. From this we create a binary index file with a fixed size header and
+ * an offset table, so that we can access the names via an index in O(1).
+ * With setPathLookup(true) we also store a sorted hash table, so that the
+ * index of a file name can be determined in O(log n).
+ * The index is rebuilt if the definition or the modification time of the
+ * start directory (if supported by the file system) has changed.
  */
 template <class SDT, class FileT>
 class SDIndex {
@@ -25,12 +53,19 @@ class SDIndex {
     this->file_name_pattern = file_name_pattern;
     idx_path = filePathString(startDir, "idx.txt");
     idx_defpath = filePathString(startDir, "idx-def.txt");
+    idx_binpath = filePathString(startDir, "idx.bin");
+    max_idx = -1;
     int idx_file_size = indexFileTSize();
     LOGI("Index file size: %d", idx_file_size);
     String keyNew =
         String(startDir) + "|" + extension + "|" + file_name_pattern;
-    String keyOld = getIndexDef();
-    if (setupIndex && (keyNew != keyOld || idx_file_size == 0)) {
+    key_hash = hash(keyNew.c_str());
+    signature = directorySignature(startDir);
+    bool is_valid = readHeader() && header.key_hash == key_hash &&
+                    header.signature == signature &&
+                    (!is_path_lookup || header.flags & FLAG_HASHES);
+    if (setupIndex && (!is_valid || idx_file_size == 0)) {
+      p_sd->remove(idx_path.c_str());
       FileT idxfile = p_sd->open(idx_path.c_str(), FILE_WRITE);
       LOGW("Creating index file");
       listDir(idxfile, startDir);
@@ -38,9 +73,54 @@ class SDIndex {
       idxfile.close();
       // update index definition file
       saveIndexDef(keyNew);
+      is_valid = false;
+    }
+    // (re)create the binary index from the text index
+    if (!is_valid && indexFileTSize() > 0) {
+      buildBinaryIndex();
+      readHeader();
     }
   }
 
+  /// Activates the sorted hash table which is needed by indexOf(): call
+  /// before begin()
+  void setPathLookup(bool active) { is_path_lookup = active; }
+
+  /// Determines the index of the file name: returns -1 if not found
+  int indexOf(const char *path) {
+    if (path == nullptr) return -1;
+    if (!header_valid || !(header.flags & FLAG_HASHES)) {
+      LOGD("indexOf: no hash table");
+      return -1;
+    }
+    FileT idxfile = p_sd->open(idx_binpath.c_str());
+    uint32_t hash_value = hash(path);
+    // binary search for the first entry with the hash
+    int low = 0;
+    int high = header.count;
+    SDIndexHash entry;
+    while (low < high) {
+      int mid = (low + high) / 2;
+      readHash(idxfile, mid, entry);
+      if (entry.hash < hash_value) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    // check all entries with the hash for collisions
+    int result = -1;
+    for (int j = low; j < (int)header.count && result < 0; j++) {
+      readHash(idxfile, j, entry);
+      if (entry.hash != hash_value) break;
+      if (readName(idxfile, entry.index) && strcmp(name_buffer, path) == 0) {
+        result = entry.index;
+      }
+    }
+    idxfile.close();
+    return result;
+  }
+
   void ls(Print &p, const char *startDir, const char *extension,
           const char *file_name_pattern = "*") {
     TRACED();
@@ -53,6 +133,16 @@ class SDIndex {
 
   /// Access file name by index
   const char *operator[](int idx) {
+    if (header_valid) {
+      if (idx < 0 || idx >= (int)header.count) {
+        LOGE("idx %d > size %d", idx, (int)header.count);
+        return nullptr;
+      }
+      FileT idxfile = p_sd->open(idx_binpath.c_str());
+      bool ok = readName(idxfile, idx);
+      idxfile.close();
+      return ok ? name_buffer : nullptr;
+    }
     // return null when inx too big
     if (max_idx >= 0 && idx > max_idx) {
       LOGE("idx %d > size %d", idx, max_idx);
@@ -93,6 +183,7 @@ class SDIndex {
   }
 
   long size() {
+    if (header_valid) return header.count;
     if (max_idx == -1) {
       FileT idxfile = p_sd->open(idx_path.c_str());
       int count = 0;
@@ -110,9 +201,17 @@ class SDIndex {
   }
 
  protected:
+  static constexpr uint16_t FLAG_HASHES = 1;
   String result;
   String idx_path;
   String idx_defpath;
+  String idx_binpath;
+  SDIndexHeader header;
+  bool header_valid = false;
+  bool is_path_lookup = false;
+  uint32_t key_hash = 0;
+  uint32_t signature = 0;
+  char name_buffer[MAX_FILE_LEN];
   SDT *p_sd = nullptr;
   List<String> file_path_stack;
   String file_path_str;
@@ -122,6 +221,153 @@ class SDIndex {
   const char *file_name_pattern = nullptr;
   long max_idx = -1;
 
+  /// FNV-1a hash
+  static uint32_t hash(const char *str) {
+    uint32_t result = 2166136261u;
+    while (*str) {
+      result = (result ^ (uint8_t)*str++) * 16777619u;
+    }
+    return result;
+  }
+
+  /// Last modification time of the start directory if supported
+  uint32_t directorySignature(const char *dir) {
+#if defined(ESP32) && !defined(USE_SDFAT)
+    FileT root = p_sd->open(dir);
+    uint32_t result = root ? (uint32_t)root.getLastWrite() : 0;
+    root.close();
+    return result;
+#else
+    return 0;
+#endif
+  }
+
+  bool readHeader() {
+    header_valid = false;
+    FileT idxfile = p_sd->open(idx_binpath.c_str());
+    if (!idxfile) return false;
+    if (idxfile.read((uint8_t *)&header, sizeof(header)) == sizeof(header)) {
+      SDIndexHeader def;
+      header_valid = memcmp(header.magic, def.magic, 4) == 0 &&
+                     header.version == def.version;
+    }
+    idxfile.close();
+    return header_valid;
+  }
+
+  /// Reads the indicated name into the name_buffer
+  bool readName(FileT &idxfile, int idx) {
+    uint32_t offset = 0;
+    if (!idxfile.seek(header.offsets_pos + idx * sizeof(uint32_t))) return false;
+    if (idxfile.read((uint8_t *)&offset, sizeof(offset)) != sizeof(offset))
+      return false;
+    if (!idxfile.seek(offset)) return false;
+    int len = idxfile.read((uint8_t *)name_buffer, MAX_FILE_LEN - 1);
+    if (len <= 0) return false;
+    name_buffer[len] = 0;
+    return true;
+  }
+
+  void readHash(FileT &idxfile, int pos, SDIndexHash &entry) {
+    idxfile.seek(header.hashes_pos + pos * sizeof(SDIndexHash));
+    idxfile.read((uint8_t *)&entry, sizeof(entry));
+  }
+
+  /// Reads the next line of the text index: returns false at the end
+  bool readLine(FileT &file, String &line) {
+    if (file.available() <= 0) return false;
+    line = file.readStringUntil('\n');
+    // remove potential cr character
+    if (line.endsWith("\r")) line.remove(line.length() - 1);
+    return true;
+  }
+
+  /// Converts the text index into the binary index
+  void buildBinaryIndex() {
+    TRACEI();
+    String line;
+    // determine the number of entries
+    FileT txt = p_sd->open(idx_path.c_str());
+    uint32_t count = 0;
+    while (readLine(txt, line)) {
+      if (line.length() > 0) count++;
+    }
+    txt.close();
+
+    header = SDIndexHeader();
+    header.count = count;
+    header.key_hash = key_hash;
+    header.signature = signature;
+    header.flags = is_path_lookup ? FLAG_HASHES : 0;
+    header.offsets_pos = sizeof(SDIndexHeader);
+    header.hashes_pos = header.offsets_pos + count * sizeof(uint32_t);
+    header.strings_pos =
+        header.hashes_pos + (is_path_lookup ? count * sizeof(SDIndexHash) : 0);
+
+    p_sd->remove(idx_binpath.c_str());
+    FileT bin = p_sd->open(idx_binpath.c_str(), FILE_WRITE);
+    bin.write((const uint8_t *)&header, sizeof(header));
+
+    // write the offset table and collect the hashes
+    Vector<SDIndexHash> hashes{0};
+    if (is_path_lookup) hashes.resize(count);
+    uint32_t offset = header.strings_pos;
+    uint32_t idx = 0;
+    txt = p_sd->open(idx_path.c_str());
+    while (readLine(txt, line) && idx < count) {
+      if (line.length() == 0) continue;
+      bin.write((const uint8_t *)&offset, sizeof(offset));
+      if (is_path_lookup) {
+        hashes[idx].hash = hash(line.c_str());
+        hashes[idx].index = idx;
+      }
+      offset += line.length() + 1;
+      idx++;
+    }
+    txt.close();
+
+    // write the sorted hash table
+    if (is_path_lookup) {
+      sortHashes(hashes);
+      bin.write((const uint8_t *)hashes.data(), count * sizeof(SDIndexHash));
+      hashes.reset();
+    }
+
+    // write the 0 terminated names
+    txt = p_sd->open(idx_path.c_str());
+    while (readLine(txt, line)) {
+      if (line.length() == 0) continue;
+      bin.write((const uint8_t *)line.c_str(), line.length() + 1);
+    }
+    txt.close();
+    bin.close();
+    LOGI("Binary index with %d entries created", (int)count);
+  }
+
+  /// In place heap sort by hash
+  static void sortHashes(Vector<SDIndexHash> &data) {
+    int n = data.size();
+    for (int j = n / 2 - 1; j >= 0; j--) siftDown(data, j, n);
+    for (int end = n - 1; end > 0; end--) {
+      SDIndexHash tmp = data[0];
+      data[0] = data[end];
+      data[end] = tmp;
+      siftDown(data, 0, end);
+    }
+  }
+
+  static void siftDown(Vector<SDIndexHash> &data, int root, int n) {
+    while (2 * root + 1 < n) {
+      int child = 2 * root + 1;
+      if (child + 1 < n && data[child + 1].hash > data[child].hash) child++;
+      if (data[root].hash >= data[child].hash) return;
+      SDIndexHash tmp = data[root];
+      data[root] = data[child];
+      data[child] = tmp;
+      root = child;
+    }
+  }
+
   String filePathString(const char *name, const char *suffix) {
     String result = name;
     return result.endsWith("/") ? result + suffix : result + "/" + suffix;
@@ -0,0 +1,291 @@
+#pragma once
+#include <atomic>
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioConfig.h"
+#include "AudioTools/AudioLogger.h"
+#ifdef USE_CONCURRENCY
+#  include "Concurrency/QueueRTOS.h"
+#  include "Concurrency/Task.h"
+#endif
+
+/// Size of the read ahead blocks: SD cards are most efficient with multi
+/// block transfers of 8 - 32 KB
+#ifndef SD_READ_AHEAD_SIZE
+#  define SD_READ_AHEAD_SIZE (16 * 1024)
+#endif
+
+#ifndef SD_READ_AHEAD_STACK_SIZE
+#  define SD_READ_AHEAD_STACK_SIZE 4096
+#endif
+
+#ifndef SD_READ_AHEAD_PRIORITY
+#  define SD_READ_AHEAD_PRIORITY 2
+#endif
+
+#ifndef SD_READ_AHEAD_CORE
+#  define SD_READ_AHEAD_CORE -1
+#endif
+
+#define SD_SECTOR_SIZE 512
+
+namespace audio_tools {
+
+/**
+ * @brief Read ahead wrapper for files on a SD card: the data is read in big
+ * blocks (SD_READ_AHEAD_SIZE) which are aligned to the block size, so that
+ * the SD card can use efficient multi block transfers. If concurrency is
+ * supported, a task is filling a double buffer in the background, otherwise
+ * the next block is read when the actual block has been consumed.
+ *
+ * Optionally you can define a sector reader, which is used for the sector
+ * aligned reads: e.g. for contiguous files with SdFat we can read the
+ * sectors directly from the card w/o going through the file system.
+ * @ingroup player
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam File
+ */
+template <class File>
+class SDReadAheadStream : public Stream {
+ public:
+  SDReadAheadStream(size_t blockSize = SD_READ_AHEAD_SIZE) {
+    setBlockSize(blockSize);
+  }
+
+  ~SDReadAheadStream() {
+    end();
+#ifdef USE_CONCURRENCY
+    task.remove();
+#endif
+  }
+
+  /// Defines the size of the read blocks (multiple of 512): call before
+  /// begin()
+  void setBlockSize(size_t size) {
+    if (size < SD_SECTOR_SIZE) size = SD_SECTOR_SIZE;
+    block_size = size / SD_SECTOR_SIZE * SD_SECTOR_SIZE;
+  }
+
+  /// Defines a function which reads sector aligned data directly (e.g. for
+  /// contiguous files): pos is the position in the file
+  void setSectorReader(bool (*reader)(uint32_t pos, uint8_t *data,
+                                      size_t len, void *ref),
+                       void *ref = nullptr) {
+    sector_reader = reader;
+    sector_reader_ref = ref;
+  }
+
+  /// Starts the read ahead from the actual position of the file
+  bool begin(File &file) {
+    end();
+    p_file = &file;
+    file_size = file.size();
+    read_pos = file.position();
+    if (memory.size() != block_size * BLOCK_COUNT) {
+      memory.resize(block_size * BLOCK_COUNT);
+    }
+    for (int j = 0; j < BLOCK_COUNT; j++) {
+      blocks[j].data = memory.data() + j * block_size;
+      blocks[j].len = 0;
+      blocks[j].generation = 0;
+    }
+    p_block = nullptr;
+    block_pos = 0;
+#ifdef USE_CONCURRENCY
+    free_blocks.clear();
+    filled_blocks.clear();
+    for (int j = 0; j < BLOCK_COUNT; j++) {
+      Block *block = &blocks[j];
+      free_blocks.enqueue(block);
+    }
+    task_pos = read_pos;
+    request_pos = read_pos;
+    generation++;
+    is_active = true;
+    is_idle = false;
+    if (task.getTaskHandle() == nullptr) {
+      task.create("SDReadAhead", SD_READ_AHEAD_STACK_SIZE,
+                  SD_READ_AHEAD_PRIORITY, SD_READ_AHEAD_CORE);
+    }
+    task.begin([this]() { processTask(); });
+#endif
+    return true;
+  }
+
+  /// Stops the read ahead: call before closing the file!
+  void end() {
+#ifdef USE_CONCURRENCY
+    if (is_active) {
+      is_active = false;
+      while (!is_idle) delay(1);
+      task.end();
+    }
+#endif
+    p_file = nullptr;
+    p_block = nullptr;
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_file == nullptr) return 0;
+    size_t result = 0;
+    while (result < len && read_pos < file_size) {
+      if (p_block == nullptr) {
+        p_block = nextBlock(result == 0);
+        if (p_block == nullptr) break;
+        block_pos = 0;
+      }
+      size_t n = min(len - result, p_block->len - block_pos);
+      memcpy(data + result, p_block->data + block_pos, n);
+      block_pos += n;
+      read_pos += n;
+      result += n;
+      if (block_pos >= p_block->len) {
+        releaseBlock(p_block);
+        p_block = nullptr;
+      }
+    }
+    return result;
+  }
+
+  int read() override {
+    uint8_t result = 0;
+    return readBytes(&result, 1) == 1 ? result : -1;
+  }
+
+  /// peek is supported only for the data in the actual block
+  int peek() override {
+    return p_block != nullptr && block_pos < p_block->len
+               ? p_block->data[block_pos]
+               : -1;
+  }
+
+  int available() override {
+    return p_file == nullptr ? 0 : file_size - read_pos;
+  }
+
+  /// Moves to the indicated file position: the read ahead data is discarded
+  bool seek(size_t pos) {
+    if (p_file == nullptr || pos > file_size) return false;
+    if (p_block != nullptr) releaseBlock(p_block);
+    p_block = nullptr;
+    read_pos = pos;
+#ifdef USE_CONCURRENCY
+    request_pos = pos;
+    generation++;
+#endif
+    return true;
+  }
+
+  size_t position() { return read_pos; }
+
+  size_t size() { return file_size; }
+
+  size_t write(uint8_t) override { return 0; }
+
+  operator bool() { return p_file != nullptr && *p_file; }
+
+ protected:
+  struct Block {
+    uint8_t *data = nullptr;
+    size_t len = 0;
+    uint32_t generation = 0;
+  };
+  static const int BLOCK_COUNT = 2;
+  File *p_file = nullptr;
+  Vector<uint8_t> memory{0};
+  Block blocks[BLOCK_COUNT];
+  Block *p_block = nullptr;
+  size_t block_pos = 0;
+  size_t block_size = SD_READ_AHEAD_SIZE;
+  size_t file_size = 0;
+  size_t read_pos = 0;
+  bool (*sector_reader)(uint32_t pos, uint8_t *data, size_t len,
+                        void *ref) = nullptr;
+  void *sector_reader_ref = nullptr;
+#ifdef USE_CONCURRENCY
+  Task task;
+  QueueRTOS<Block *> free_blocks{BLOCK_COUNT, portMAX_DELAY, 0};
+  QueueRTOS<Block *> filled_blocks{BLOCK_COUNT, portMAX_DELAY, 0};
+  std::atomic<uint32_t> generation{0};
+  std::atomic<size_t> request_pos{0};
+  std::atomic<bool> is_active{false};
+  std::atomic<bool> is_idle{true};
+  uint32_t task_generation = 0;
+  size_t task_pos = 0;
+
+  /// Fills the free blocks in the background
+  void processTask() {
+    if (!is_active) {
+      is_idle = true;
+      delay(10);
+      return;
+    }
+    Block *block = nullptr;
+    if (!free_blocks.dequeue(block, pdMS_TO_TICKS(10))) return;
+    uint32_t gen = generation.load();
+    if (gen != task_generation) {
+      task_generation = gen;
+      task_pos = request_pos.load();
+    }
+    if (task_pos >= file_size) {
+      // nothing to read: wait for a seek
+      free_blocks.enqueue(block);
+      delay(10);
+      return;
+    }
+    block->generation = task_generation;
+    block->len = readBlock(task_pos, block->data);
+    // stop reading on errors: an empty block marks the end
+    task_pos = block->len > 0 ? task_pos + block->len : file_size;
+    filled_blocks.enqueue(block);
+  }
+
+  Block *nextBlock(bool wait) {
+    Block *block = nullptr;
+    while (filled_blocks.dequeue(block, wait ? portMAX_DELAY : 0)) {
+      // ignore the blocks which were read before a seek
+      if (block->generation == generation.load()) {
+        if (block->len > 0) return block;
+        // read error
+        read_pos = file_size;
+      }
+      free_blocks.enqueue(block);
+      if (read_pos >= file_size) break;
+    }
+    return nullptr;
+  }
+
+  void releaseBlock(Block *block) { free_blocks.enqueue(block); }
+
+#else
+
+  Block *nextBlock(bool wait) {
+    Block *block = &blocks[0];
+    block->len = readBlock(read_pos, block->data);
+    return block->len > 0 ? block : nullptr;
+  }
+
+  void releaseBlock(Block *block) {}
+
+#endif
+
+  /// Reads the data up to the next block boundary
+  size_t readBlock(size_t pos, uint8_t *data) {
+    size_t len = block_size - (pos % block_size);
+    if (pos + len > file_size) len = file_size - pos;
+    if (sector_reader != nullptr && pos % SD_SECTOR_SIZE == 0) {
+      // the sector reader reads full sectors
+      size_t sector_len =
+          (len + SD_SECTOR_SIZE - 1) / SD_SECTOR_SIZE * SD_SECTOR_SIZE;
+      if (sector_reader(pos, data, sector_len, sector_reader_ref)) return len;
+    }
+    if (p_file->position() != pos && !p_file->seek(pos)) {
+      LOGE("seek %u", (unsigned)pos);
+      return 0;
+    }
+    return p_file->read(data, len);
+  }
+};
+
+}  // namespace audio_tools
@@ -8,6 +8,10 @@
 #include <cstdint>
 #include "AudioTools/AudioOutput.h"
 #include "AudioTools/Buffers.h"
+#ifdef USE_CONCURRENCY
+#  include "Concurrency/QueueRTOS.h"
+#  include "Concurrency/Task.h"
+#endif
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
 #include "tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
@@ -122,6 +126,19 @@ struct TfLiteConfig {
   // number of new slices to collect before evaluating the model
   int kSlicesToProcess = 2;
 
+  // Energy gate: the model is not evaluated when the rms of the audio stays
+  // below this value (0 = always evaluate)
+  int vad_threshold = 0;
+  // number of slices we continue to evaluate the model after the last slice
+  // which was above the threshold (0 = kFeatureSliceCount)
+  int vad_hold_slices = 0;
+
+  // run the model evaluation in a separate task (e.g. on the second core)
+  bool is_inference_task = false;
+  int inference_task_core = 0;
+  int inference_task_stack_size = 8 * 1024;
+  int inference_task_priority = 1;
+
   // Parameters for RecognizeCommands
   int32_t average_window_duration_ms = 1000;
   uint8_t detection_threshold = 50;
@@ -430,8 +447,8 @@ class TfLiteMicroSpeachWriter : public TfLiteWriter {
   TfLiteMicroSpeachWriter() = default;
 
   ~TfLiteMicroSpeachWriter() {
-    if (p_buffer != nullptr) delete p_buffer;
-    if (p_audio_samples != nullptr) delete p_audio_samples;
+    if (p_feature_data != nullptr) delete[] p_feature_data;
+    if (p_audio_samples != nullptr) delete[] p_audio_samples;
   }
 
   /// Call begin before starting the processing
@@ -455,25 +472,29 @@ class TfLiteMicroSpeachWriter : public TfLiteWriter {
       return false;
     }
 
-    // Allocate ring buffer
-    if (p_buffer == nullptr) {
-      p_buffer = new audio_tools::RingBuffer<int16_t>(kMaxAudioSampleSize);
-      LOGD("Allocating buffer for %d samples", kMaxAudioSampleSize);
-    }
-
-    // Initialize the feature data to default values.
+    // Initialize the feature data (ring of slices) to default values.
     if (p_feature_data == nullptr) {
       p_feature_data = new int8_t[cfg.featureElementCount()];
-      memset(p_feature_data, 0, cfg.featureElementCount());
     }
+    memset(p_feature_data, 0, cfg.featureElementCount());
+    feature_slice_idx = 0;
 
-    // allocate p_audio_samples
+    // allocate p_audio_samples: sliding window
     if (p_audio_samples == nullptr) {
       p_audio_samples = new int16_t[kMaxAudioSampleSize];
-      memset(p_audio_samples, 0, kMaxAudioSampleSize * sizeof(int16_t));
     }
-
-    return true;
+    memset(p_audio_samples, 0, kMaxAudioSampleSize * sizeof(int16_t));
+    audio_samples_len = 0;
+
+    // energy gate
+    energy_sum = 0;
+    energy_count = 0;
+    vad_hold = 0;
+    vad_threshold_sq = (int64_t)cfg.vad_threshold * cfg.vad_threshold;
+    vad_hold_slices =
+        cfg.vad_hold_slices > 0 ? cfg.vad_hold_slices : cfg.kFeatureSliceCount;
+
+    return setupInferenceTask();
   }
 
   virtual bool write(int16_t sample) {
@@ -483,10 +504,15 @@ class TfLiteMicroSpeachWriter : public TfLiteWriter {
       current_time += cfg.kFeatureSliceStrideMs;
       // determine slice
       total_slice_count++;
-      
-      int8_t* feature_buffer = addSlice();
+
+      addSlice();
+      bool is_active = updateEnergy();
       if (total_slice_count >= cfg.kSlicesToProcess) {
-        processSlices(feature_buffer);
+        if (is_active) {
+          processSlices();
+        } else {
+          skipped_count++;
+        }
         // reset total_slice_count
         total_slice_count = 0;
       }
@@ -494,12 +520,18 @@ class TfLiteMicroSpeachWriter : public TfLiteWriter {
     return true;
   }
 
+  /// Number of model evaluations which were skipped by the energy gate or
+  /// because the inference task was still busy
+  uint32_t skippedCount() { return skipped_count; }
+
  protected:
   TfLiteConfig cfg;
   TfLiteAudioStreamBase *parent=nullptr;
+  // ring of kFeatureSliceCount slices: feature_slice_idx is the oldest
   int8_t* p_feature_data = nullptr;
+  int feature_slice_idx = 0;
   int16_t* p_audio_samples = nullptr;
-  audio_tools::RingBuffer<int16_t>* p_buffer = nullptr;
+  int audio_samples_len = 0;
   FrontendState g_micro_features_state;
   FrontendConfig config;
   int kMaxAudioSampleSize;
@@ -509,6 +541,17 @@ class TfLiteMicroSpeachWriter : public TfLiteWriter {
   int8_t channel = 0;
   int32_t current_time = 0;
   int16_t total_slice_count = 0;
+  int64_t energy_sum = 0;
+  int energy_count = 0;
+  int64_t vad_threshold_sq = 0;
+  int vad_hold = 0;
+  int vad_hold_slices = 0;
+  uint32_t skipped_count = 0;
+#ifdef USE_CONCURRENCY
+  Task inference_task;
+  QueueRTOS<int32_t> inference_queue{1, 0, portMAX_DELAY};
+  volatile bool is_inference_busy = false;
+#endif
 
   virtual bool setup_recognizer() {
       // setup default p_recognizer if not defined
@@ -519,72 +562,133 @@ class TfLiteMicroSpeachWriter : public TfLiteWriter {
       return cfg.recognizeCommands->begin(cfg);
   }
 
+  /// Starts the task which evaluates the model
+  bool setupInferenceTask() {
+    if (!cfg.is_inference_task) return true;
+#ifdef USE_CONCURRENCY
+    if (inference_task.getTaskHandle() == nullptr) {
+      inference_task.create("TfLiteInference", cfg.inference_task_stack_size,
+                            cfg.inference_task_priority,
+                            cfg.inference_task_core);
+    }
+    inference_task.begin([this]() {
+      int32_t time = 0;
+      if (inference_queue.dequeue(time)) {
+        evaluate(time);
+        is_inference_busy = false;
+      }
+    });
+    return true;
+#else
+    LOGE("is_inference_task not supported");
+    return false;
+#endif
+  }
+
   /// Processes a single sample 
   virtual bool write1(const int16_t sample) {
-    if (cfg.channels == 1) {
-      p_buffer->write(sample);
-    } else {
+    int16_t value = sample;
+    if (cfg.channels != 1) {
       if (channel == 0) {
         last_value = sample;
         channel = 1;
-      } else
-        // calculate avg of 2 channels and convert it to int8_t
-        p_buffer->write(((sample / 2) + (last_value / 2)));
+        return true;
+      }
+      // calculate avg of 2 channels
+      value = (sample / 2) + (last_value / 2);
       channel = 0;
     }
-    return p_buffer->availableForWrite() > 0;
+    p_audio_samples[audio_samples_len++] = value;
+    energy_sum += (int32_t)value * value;
+    energy_count++;
+    return audio_samples_len < kMaxAudioSampleSize;
+  }
+
+  /// Returns true if the energy gate is open
+  bool updateEnergy() {
+    if (cfg.vad_threshold <= 0) return true;
+    bool is_voice = energy_count > 0 &&
+                    energy_sum / energy_count >= vad_threshold_sq;
+    energy_sum = 0;
+    energy_count = 0;
+    if (is_voice) {
+      vad_hold = vad_hold_slices;
+    } else if (vad_hold > 0) {
+      vad_hold--;
+    }
+    return vad_hold > 0;
   }
 
-  // If we can avoid recalculating some slices, just move the existing
-  // data up in the spectrogram, to perform something like this: last time
-  // = 80ms          current time = 120ms
+  // We do not move the spectrogram: the new slice just replaces the oldest
+  // slice in the ring of slices. The ring is only linearized into the model
+  // input when the model is evaluated:
   // +-----------+             +-----------+
-  // | data@20ms |         --> | data@60ms |
-  // +-----------+       --    +-----------+
-  // | data@40ms |     --  --> | data@80ms |
-  // +-----------+   --  --    +-----------+
-  // | data@60ms | --  --      |  <empty>  |
-  // +-----------+   --        +-----------+
-  // | data@80ms | --          |  <empty>  |
+  // | data@20ms | <- oldest   | data@100ms| <- new
+  // +-----------+             +-----------+
+  // | data@40ms |         --> | data@40ms | <- oldest
+  // +-----------+             +-----------+
+  // | data@60ms |             | data@60ms |
+  // +-----------+             +-----------+
+  // | data@80ms |             | data@80ms |
   // +-----------+             +-----------+
   virtual int8_t* addSlice() {
     TRACED();
-    // shift p_feature_data by one slice one one
-    memmove(p_feature_data, p_feature_data + cfg.kFeatureSliceSize,
-            (cfg.kFeatureSliceCount - 1) * cfg.kFeatureSliceSize);
-
-    // copy data from buffer to p_audio_samples
-    int audio_samples_size =
-        p_buffer->readArray(p_audio_samples, kMaxAudioSampleSize);
-
-    // check size
-    if (audio_samples_size != kMaxAudioSampleSize) {
-      LOGE("audio_samples_size=%d != kMaxAudioSampleSize=%d",
-           audio_samples_size, kMaxAudioSampleSize);
-    }
-
-    // keep some data to be reprocessed - move by kStrideSampleSize
-    p_buffer->writeArray(p_audio_samples + kStrideSampleSize, kKeepSampleSize);
-
-    //  the new slice data will always be stored at the end
     int8_t* new_slice_data =
-        p_feature_data + ((cfg.kFeatureSliceCount - 1) * cfg.kFeatureSliceSize);
+        p_feature_data + (feature_slice_idx * cfg.kFeatureSliceSize);
+    feature_slice_idx = (feature_slice_idx + 1) % cfg.kFeatureSliceCount;
+
     size_t num_samples_read = 0;
-    if (generateMicroFeatures(p_audio_samples, audio_samples_size,
+    if (generateMicroFeatures(p_audio_samples, audio_samples_len,
                               new_slice_data, cfg.kFeatureSliceSize,
                               &num_samples_read) != kTfLiteOk) {
       LOGE("Error generateMicroFeatures");
     }
+
+    // keep some data to be reprocessed - move by kStrideSampleSize
+    memmove(p_audio_samples, p_audio_samples + kStrideSampleSize,
+            kKeepSampleSize * sizeof(int16_t));
+    audio_samples_len = kKeepSampleSize;
     // printFeatures();
-    return p_feature_data;
+    return new_slice_data;
+  }
+
+  /// Copies the ring of slices in the right order to the indicated buffer
+  void copyFeatures(int8_t* target) {
+    int first = (cfg.kFeatureSliceCount - feature_slice_idx) *
+                cfg.kFeatureSliceSize;
+    memcpy(target,
+           p_feature_data + (feature_slice_idx * cfg.kFeatureSliceSize),
+           first);
+    memcpy(target + first, p_feature_data,
+           cfg.featureElementCount() - first);
   }
 
   // Process multiple slice of audio data 
-  virtual bool processSlices(int8_t* feature_buffer) {
+  virtual bool processSlices() {
     LOGI("->slices: %d", total_slice_count);
+#ifdef USE_CONCURRENCY
+    if (cfg.is_inference_task) {
+      // the model input is used by the task while it is busy
+      if (is_inference_busy) {
+        skipped_count++;
+        return false;
+      }
+      copyFeatures(parent->modelInputBuffer());
+      is_inference_busy = true;
+      if (!inference_queue.enqueue(current_time)) {
+        is_inference_busy = false;
+        return false;
+      }
+      return true;
+    }
+#endif
     // Copy feature buffer to input tensor
-    memcpy(parent->modelInputBuffer(), feature_buffer, cfg.featureElementCount());
+    copyFeatures(parent->modelInputBuffer());
+    return evaluate(current_time);
+  }
 
+  /// Evaluates the model with the data in the model input buffer
+  virtual bool evaluate(int32_t time) {
     // Run the model on the spectrogram input and make sure it succeeds.
     TfLiteStatus invoke_status = parent->interpreter().Invoke();
     if (invoke_status != kTfLiteOk) {
@@ -601,7 +705,7 @@ class TfLiteMicroSpeachWriter : public TfLiteWriter {
     bool is_new_command = false;
 
     TfLiteStatus process_status = cfg.recognizeCommands->getCommand(
-        output, current_time, &found_command, &score, &is_new_command);
+        output, time, &found_command, &score, &is_new_command);
     if (process_status != kTfLiteOk) {
       LOGE("TfLiteMicroSpeechRecognizeCommands::getCommand() failed");
       return false;
@@ -616,8 +720,9 @@ class TfLiteMicroSpeachWriter : public TfLiteWriter {
   /// For debugging: print feature matrix
   void printFeatures() {
     for (int i = 0; i < cfg.kFeatureSliceCount; i++) {
+      int slice = (feature_slice_idx + i) % cfg.kFeatureSliceCount;
       for (int j = 0; j < cfg.kFeatureSliceSize; j++) {
-        Serial.print(p_feature_data[(i * cfg.kFeatureSliceSize) + j]);
+        Serial.print(p_feature_data[(slice * cfg.kFeatureSliceSize) + j]);
         Serial.print(" ");
       }
       Serial.println();
@@ -4,6 +4,8 @@
 
 #include "AudioLibs/vban/vban.h"
 #include "AudioTools/AudioStreams.h"
+#include "AudioTools/ResampleStream.h"
+#include "AudioTools/SilenceDetector.h"
 #include "Concurrency/BufferRTOS.h"
 
 namespace audio_tools {
@@ -36,6 +38,12 @@ class VBANConfig : public AudioInfo {
   int max_write_size =
       DEFAULT_BUFFER_SIZE * 2;  // just good enough for 44100 stereo
   uint8_t format = 0;
+  /// compensate the clock drift between sender and receiver (RX_MODE)
+  bool drift_compensation = false;
+  /// target latency of the receive buffer in ms (0: 50% of the buffer)
+  int target_latency_ms = 0;
+  /// max sample rate correction in ppm
+  int max_correction_ppm = 2000;
 };
 
 /**
@@ -69,6 +77,8 @@ class VBANStream : public AudioStream {
     throttle.begin(thc);
     if (cfg.mode == TX_MODE) {
       configure_tx();
+    } else if (cfg.drift_compensation) {
+      setupDriftCompensation();
     }
   }
 
@@ -93,6 +103,7 @@ class VBANStream : public AudioStream {
 #else
       rx_buffer.resize(DEFAULT_BUFFER_SIZE, cfg.rx_buffer_count);
 #endif  
+      if (cfg.drift_compensation) setupDriftCompensation();
       return begin_rx();
     }
   }
@@ -111,6 +122,15 @@ class VBANStream : public AudioStream {
     for (int j = 0; j < samples; j++) {
       tx_buffer.write(adc_data[j]);
       if (tx_buffer.availableForWrite() == 0) {
+        if (p_silence != nullptr &&
+            p_silence->update((uint8_t*)tx_buffer.data(),
+                              vban.packet_data_bytes)) {
+          // silent packet: we just skip the counter
+          suppressed_packets++;
+          packet_counter++;
+          tx_buffer.reset();
+          continue;
+        }
         memcpy(vban.data_frame, tx_buffer.data(), vban.packet_data_bytes);
         *vban.packet_counter = packet_counter;  // increment packet counter
         // Send packet
@@ -131,16 +151,50 @@ class VBANStream : public AudioStream {
 
   int availableForWrite() { return cfg.max_write_size; }
 
+  /// The packets which are identified as silent are not sent
+  void setSilenceDetector(SilenceDetector& detector) { p_silence = &detector; }
+
+  /// Number of packets which were not sent because they were silent
+  uint32_t suppressedPackets() { return suppressed_packets; }
+
   size_t readBytes(uint8_t* data, size_t len) override {
     TRACED();
     size_t samples = len / (cfg.bits_per_sample/8);
     if (cfg.throttle_active) {
       throttle.delayFrames(samples / cfg.channels);
     }
+    if (cfg.drift_compensation) return readCompensated(data, len);
     return rx_buffer.readArray(data, len);
   }
 
-  int available() { return available_active ? rx_buffer.available() : 0; }
+  int available() {
+    if (!available_active) return 0;
+    if (cfg.drift_compensation) {
+      return rx_buffer.available() + resample_queue.available();
+    }
+    return rx_buffer.available();
+  }
+
+  /// Fill level of the receive buffer in percent
+  float fillLevelPercent() {
+    int size = rxBufferSize();
+    return size == 0 ? 0.0f : 100.0f * rx_buffer.available() / size;
+  }
+
+  /// Fill level of the receive buffer in ms
+  float fillLevelMs() { return bytesToMs(rx_buffer.available()); }
+
+  /// Estimated clock drift between sender and receiver in ppm
+  float driftPpm() { return drift_ppm; }
+
+  /// Actual sample rate correction in ppm
+  float correctionPpm() { return correction_ppm; }
+
+  /// Number of updates of the sample rate correction
+  uint32_t corrections() { return correction_count; }
+
+  /// Number of reads which did not find any data
+  uint32_t underruns() { return underrun_count; }
 
  protected:
   const IPAddress broadcast_address{0, 0, 0, 0};
@@ -155,10 +209,99 @@ class VBANStream : public AudioStream {
  #endif
   bool udp_connected = false;
   uint32_t packet_counter = 0;
+  uint32_t suppressed_packets = 0;
+  SilenceDetector* p_silence = nullptr;
   Throttle throttle;
   size_t bytes_received = 0;
   bool available_active = false;
   Print *p_out = nullptr;
+  // drift compensation
+  ResampleStream resample;
+  RingBuffer<uint8_t> resample_buffer{0};
+  QueueStream<uint8_t> resample_queue{resample_buffer};
+  Vector<uint8_t> raw_buffer{0};
+  float fill_ms = 0;
+  float drift_ppm = 0;
+  float correction_ppm = 0;
+  uint32_t last_correction_ms = 0;
+  uint32_t correction_count = 0;
+  uint32_t underrun_count = 0;
+
+  int rxBufferSize() { return DEFAULT_BUFFER_SIZE * cfg.rx_buffer_count; }
+
+  float bytesToMs(int bytes) {
+    float bytes_per_ms = cfg.sample_rate * cfg.channels *
+                         (cfg.bits_per_sample / 8) / 1000.0f;
+    return bytes_per_ms == 0 ? 0.0f : bytes / bytes_per_ms;
+  }
+
+  /// Target latency in ms
+  float targetLatencyMs() {
+    if (cfg.target_latency_ms > 0) return cfg.target_latency_ms;
+    return bytesToMs(rxBufferSize() / 2);
+  }
+
+  void setupDriftCompensation() {
+    resample_buffer.resize(cfg.max_write_size * 2);
+    resample_queue.end();
+    resample_queue.begin();
+    resample.setOutput(resample_queue);
+    resample.setBuffered(false);
+    resample.begin(cfg, 1.0f);
+    fill_ms = targetLatencyMs();
+    drift_ppm = 0;
+    correction_ppm = 0;
+    correction_count = 0;
+    last_correction_ms = millis();
+  }
+
+  /// Reads the data via the resampler which is speeding up or slowing down
+  /// the playback in order to keep the fill level at the target latency
+  size_t readCompensated(uint8_t* data, size_t len) {
+    if (resample_queue.available() == 0) {
+      int frame_size = cfg.channels * (cfg.bits_per_sample / 8);
+      // the resampled result must fit into the queue
+      int raw_len = min((int)len, rx_buffer.available());
+      raw_len = min(raw_len, cfg.max_write_size);
+      raw_len = raw_len / frame_size * frame_size;
+      if (raw_len == 0) {
+        if (available_active) underrun_count++;
+        return 0;
+      }
+      updateCorrection();
+      raw_buffer.resize(len);
+      int read = rx_buffer.readArray(raw_buffer.data(), raw_len);
+      resample.write(raw_buffer.data(), read);
+    }
+    return resample_queue.readBytes(data, len);
+  }
+
+  float limit(float value, float max) {
+    if (value > max) return max;
+    if (value < -max) return -max;
+    return value;
+  }
+
+  /// PI controller for the step size of the resampler
+  void updateCorrection() {
+    // smoothed fill level
+    fill_ms += (fillLevelMs() - fill_ms) * 0.05f;
+    uint32_t now = millis();
+    uint32_t dt_ms = now - last_correction_ms;
+    if (dt_ms < VBAN_DRIFT_UPDATE_MS) return;
+    last_correction_ms = now;
+    float target = targetLatencyMs();
+    if (target <= 0) return;
+    float error = (fill_ms - target) / target;
+    float max_ppm = cfg.max_correction_ppm;
+    // the integral part converges to the drift of the clocks
+    drift_ppm += VBAN_DRIFT_KI * error * dt_ms / 1000.0f;
+    drift_ppm = limit(drift_ppm, max_ppm);
+    correction_ppm = limit(drift_ppm + VBAN_DRIFT_KP * error, max_ppm);
+    // a step > 1 consumes the data faster
+    resample.setStepSize(1.0f + correction_ppm / 1000000.0f);
+    correction_count++;
+  }
 
   bool begin_tx() {
     if (!configure_tx()) {
@@ -432,7 +575,10 @@ class VBANStream : public AudioStream {
       // report available bytes only when buffer is 50% full
       if (!available_active) {
         bytes_received += vban_rx_data_bytes;
-        if (bytes_received >= cfg.rx_buffer_count * DEFAULT_BUFFER_SIZE * 0.75){
+        float active_ms = cfg.drift_compensation
+                              ? targetLatencyMs()
+                              : bytesToMs(rxBufferSize() * 0.75);
+        if (bytesToMs(bytes_received) >= active_ms) {
           available_active = true;
           LOGI("Activating vban");
         }
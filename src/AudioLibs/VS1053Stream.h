@@ -2,6 +2,10 @@
 
 #include "AudioTools/AudioStreams.h"
 #include "AudioCodecs/CodecCopy.h"
+#include "Concurrency/RingBufferLockFree.h"
+#ifdef USE_CONCURRENCY
+# include "Concurrency/Task.h"
+#endif
 #if VS1053_EXT
 # include "VS1053Driver.h"
 #else
@@ -37,6 +41,9 @@ class VS1053Config : public AudioInfo {
     bool is_midi = false;
     /// SPI.begin is called by the driver (default setting)
     bool is_start_spi = true; 
+    /// Size of the ring buffer between write() and the feeder (see
+    /// VS1053Stream::feed()): 0 writes directly to the VS1053
+    int feeder_buffer_size = 0;
 #if VS1053_EXT
     VS1053_INPUT input_device = VS1053_MIC;
 #endif
@@ -56,8 +63,9 @@ class VS1053Stream : public AudioStream, public VolumeSupport {
      */
     class VS1053StreamOut : public AudioStream {
       public:
-        VS1053StreamOut(VS1053 *vs){
+        VS1053StreamOut(VS1053 *vs, VS1053Stream *parent){
             p_VS1053 = vs;
+            p_parent = parent;
         }
         size_t write(const uint8_t *data, size_t len) override { 
             if (p_VS1053==nullptr) {
@@ -65,11 +73,15 @@ class VS1053Stream : public AudioStream, public VolumeSupport {
                 return 0;
             }
             TRACED();
+            if (p_parent->feeder.size() > 0) {
+                return p_parent->writeFeeder(data, len);
+            }
             p_VS1053->playChunk((uint8_t*)data, len);
             return len;
         }
       protected:
         VS1053 *p_VS1053=nullptr;
+        VS1053Stream *p_parent=nullptr;
     };
 
 public:
@@ -122,7 +134,7 @@ public:
 
         if (p_vs1053==nullptr){
            p_vs1053 = new VS1053(cfg.cs_pin,cfg.dcs_pin,cfg.dreq_pin);
-           p_vs1053_out = new VS1053StreamOut(p_vs1053);
+           p_vs1053_out = new VS1053StreamOut(p_vs1053, this);
 
             if (cfg.is_start_spi) {
                 LOGI("SPI.begin()")
@@ -177,6 +189,10 @@ public:
     /// Stops the processing and releases the memory
     void end(){
         TRACEI();
+#ifdef USE_CONCURRENCY
+        endFeederTask();
+#endif
+        feeder.resize(0);
         if (p_out!=nullptr){
             delete p_out;
             p_out = nullptr;
@@ -239,6 +255,55 @@ public:
         return p_out->write(data, len);
     }
 
+    /// Sends the data from the feeder ring buffer in chunks of 32 bytes as
+    /// long as DREQ signals that the VS1053 can accept them, so we never wait
+    /// for DREQ. Call it from the loop if there is no feeder task.
+    void feed() {
+        if (p_vs1053==nullptr || feeder.size()==0) return;
+        while (feeder.readPtrSize() > 0 && digitalRead(cfg.dreq_pin)==HIGH) {
+            int len = min(feeder.readPtrSize(), 32);
+            p_vs1053->playChunk(feeder.readPtr(), len);
+            feeder.consume(len);
+        }
+    }
+
+#ifdef USE_CONCURRENCY
+    /// Starts a task which feeds the VS1053 from the ring buffer: on the ESP32
+    /// it is woken up by the DREQ interrupt. Call after begin().
+    bool beginFeederTask(int stackSize = 3 * 1024, int priority = 2,
+                         int core = -1) {
+        if (feeder.size()==0) {
+            LOGE("feeder_buffer_size is 0");
+            return false;
+        }
+        if (is_feeder_task) return false;
+        feeder_task.create("vs1053-feeder", stackSize, priority, core);
+        is_feeder_task = true;
+#ifdef ESP32
+        attachInterruptArg(digitalPinToInterrupt(cfg.dreq_pin), dreqISR, this,
+                           RISING);
+#endif
+        return feeder_task.begin([this]() {
+            feed();
+            // wait for the next DREQ or at most one tick
+            ulTaskNotifyTake(pdTRUE, 1);
+        });
+    }
+
+    /// Stops the feeder task
+    void endFeederTask() {
+        if (!is_feeder_task) return;
+#ifdef ESP32
+        detachInterrupt(digitalPinToInterrupt(cfg.dreq_pin));
+#endif
+        feeder_task.remove();
+        is_feeder_task = false;
+    }
+#endif
+
+    /// Number of bytes in the feeder ring buffer
+    int feederAvailable() { return feeder.available(); }
+
     /// returns the VS1053 object
     VS1053 &getVS1053() {
         TRACED();
@@ -336,9 +401,44 @@ protected:
     EncodedAudioStream *p_out = nullptr;
     AudioEncoder *p_encoder = new WAVEncoder(); // by default we send wav data 
     CopyEncoder copy;  // used when is_encoded_data == true
+    RingBufferLockFree<uint8_t> feeder{0};
+#ifdef USE_CONCURRENCY
+    Task feeder_task;
+    bool is_feeder_task = false;
+
+#ifdef ESP32
+    static void IRAM_ATTR dreqISR(void *ref) {
+        VS1053Stream *self = (VS1053Stream *)ref;
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(self->feeder_task.getTaskHandle(), &woken);
+        if (woken) portYIELD_FROM_ISR();
+    }
+#endif
+#endif
+
+    /// Adds the data to the feeder ring buffer: if it is full we feed the
+    /// VS1053 (or wait for the feeder task)
+    size_t writeFeeder(const uint8_t *data, size_t len) {
+        size_t result = 0;
+        while (result < len) {
+            int n = feeder.writeArray(data + result, len - result);
+            result += n;
+            if (result < len) {
+#ifdef USE_CONCURRENCY
+                if (is_feeder_task) {
+                    delay(1);
+                    continue;
+                }
+#endif
+                feed();
+            }
+        }
+        return result;
+    }
 
     bool beginTx() {
         TRACEI();
+        feeder.resize(cfg.feeder_buffer_size);
         p_out->begin(cfg);      
         bool result = p_vs1053->begin();
         p_vs1053->startSong();
@@ -71,13 +71,18 @@ class MetaDataICY : public AbstractMetaData {
         /// Writes the data in order to retrieve the metadata and perform the corresponding callbacks 
         virtual size_t write(const uint8_t *data, size_t len) override {
             if (callback!=nullptr){
-                for (size_t j=0;j<len;j++){
-                    processChar((char)data[j]);
-                }
+                processSpans((uint8_t*)data, len, false);
             }
             return len;
         }
 
+        /// Removes the metadata from the buffer in place and returns the number of remaining
+        /// audio bytes. The audio ranges are moved with one memmove per metadata block.
+        virtual size_t demux(uint8_t *data, size_t len) {
+            if (!hasMetaData()) return len;
+            return processSpans(data, len, true);
+        }
+
         /// Returns the actual status of the state engine for the current byte
         virtual Status status() {
             return currentStatus;
@@ -165,6 +170,52 @@ class MetaDataICY : public AbstractMetaData {
         int dataLen = 0;
         int dataPos = 0;
 
+        /// Splits the buffer into audio and metadata ranges: if compact is true the audio
+        /// is moved to the start of the buffer. Returns the number of audio bytes.
+        size_t processSpans(uint8_t *data, size_t len, bool compact) {
+            size_t in = 0;
+            size_t out = 0;
+            while (in < len) {
+                switch(nextStatus){
+                    case ProcessData: {
+                        currentStatus = ProcessData;
+                        size_t n = mp3_blocksize - totalData;
+                        if (n > len - in) n = len - in;
+                        if (compact && out != in) memmove(data + out, data + in, n);
+                        processData(data + in, n);
+                        in += n;
+                        out += n;
+                        totalData += n;
+                        if (totalData>=mp3_blocksize){
+                            LOGI("Data ended")
+                            totalData = 0;
+                            nextStatus = SetupSize;
+                        }
+                    } break;
+
+                    case SetupSize:
+                        // the length byte: 0 means that there is no metadata
+                        processChar((char)data[in++]);
+                        break;
+
+                    case ProcessMetaData: {
+                        currentStatus = ProcessMetaData;
+                        size_t n = metaDataLen - metaDataPos;
+                        if (n > len - in) n = len - in;
+                        memcpy(metaData + metaDataPos, data + in, n);
+                        in += n;
+                        metaDataPos += n;
+                        if (metaDataPos>=metaDataLen){
+                            processMetaData(metaData, metaDataLen);
+                            LOGI("Metadata ended")
+                            nextStatus = ProcessData;
+                        }
+                    } break;
+                }
+            }
+            return out;
+        }
+
         virtual void clear() {
             nextStatus = ProcessData;
             totalData = 0;
@@ -235,6 +286,15 @@ class MetaDataICY : public AbstractMetaData {
             }
         }
 
+        /// Provides a range of audio data to the data callback
+        void processData(const uint8_t *data, size_t len){
+            if (dataBuffer!=nullptr){
+                for (size_t j=0;j<len;j++){
+                    processData((char)data[j]);
+                }
+            }
+        }
+
         /// Collects the data in a buffer and executes the callback when the buffer is full
         virtual void processData(char ch){
             if (dataBuffer!=nullptr){
@@ -90,7 +90,8 @@ class MetaDataID3Base  {
             len = 1600;
         }
         size_t tag_len = strlen(tag);
-        for (size_t j=0;j<=len-tag_len-1;j++){
+        if (len<tag_len) return -1;
+        for (size_t j=0;j+tag_len<=len;j++){
             if (memcmp(str+j,tag, tag_len)==0){
                 return j;
             }
@@ -325,7 +326,11 @@ struct ID3v2FrameString {
 static const int ID3FrameSize = 11;
 
 /**
- * @brief Simple ID3 Meta Data API which supports ID3 V2: We only support the "TALB", "TOPE", "TIT2", "TCON" tags
+ * @brief Simple ID3 Meta Data API which supports ID3 V2: We only support the "TALB", "TOPE", "TIT2", "TCON" tags.
+ * The data is processed with a state machine: we read the 10 byte tag header, which provides the tag length,
+ * and then the individual frame headers. Only the content of the relevant frames is copied (max 256 bytes):
+ * all other frames (e.g. big APIC pictures) are skipped w/o copying. After the end of the tag the data
+ * is not inspected any more.
  * @ingroup metadata-id3
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -336,8 +341,11 @@ class MetaDataID3V2 : public MetaDataID3Base  {
 
     /// (re)starts the processing
     void begin() {
-        status = TagNotFound;
-        use_bytes_of_next_write = 0;
+        state = FindHeader;
+        header_pos = 0;
+        skip_len = 0;
+        tag_remaining = 0;
+        total_len = 0;
         actual_tag = nullptr;
         tag_active = false;
         tag_processed = false;
@@ -345,26 +353,15 @@ class MetaDataID3V2 : public MetaDataID3Base  {
     
     /// Ends the processing and releases the memory
     void end() {
-        status = TagNotFound;
-        use_bytes_of_next_write = 0;
-        actual_tag = nullptr;
-        tag_active = false;
-        tag_processed = false;
+        begin();
     }
 
     /// provide the (partial) data which might contain the meta data
     size_t write(const uint8_t* data, size_t len){
-        if (armed){ 
-            switch(status){
-                case TagNotFound:
-                    processTagNotFound(data,len);
-                    break;
-                case PartialTagAtTail:
-                    processPartialTagAtTail(data,len);
-                    break;
-                default:                
-                    // do nothing
-                    break;
+        if (armed && state != Done){ 
+            size_t pos = 0;
+            while (pos < len && state != Done){
+                pos += process(data + pos, len - pos);
             }
         }
         return len;
@@ -386,16 +383,24 @@ class MetaDataID3V2 : public MetaDataID3Base  {
     }
 
   protected:
+    enum State {FindHeader, TagHeader, ExtendedHeader, FrameHeader, FrameContent, Skip, Done};
+    /// The tag is expected at the start: we give up after this number of bytes
+    const size_t search_limit = 1600;
+    State state = FindHeader;
     ID3v2 tagv2;
     bool tag_active = false;
     bool tag_processed = false;
-    ParseStatus status = TagNotFound;
     const char* actual_tag;
     ID3v2FrameString frame_header;
-    int use_bytes_of_next_write = 0;
+    uint8_t header_data[10];
+    int header_pos = 0;
     char result[256];
+    int result_len = 0;
+    bool has_encoding = false;
+    uint32_t frame_len = 0;
+    uint32_t skip_len = 0;
+    uint32_t tag_remaining = 0;
     uint64_t total_len = 0;
-    uint64_t end_len = 0;
 
     // calculate the synch save size
     uint32_t calcSize(uint8_t chars[4]) {
@@ -406,72 +411,180 @@ class MetaDataID3V2 : public MetaDataID3Base  {
         return byte0 << 21 | byte1 << 14 | byte2 << 7 | byte3;
     }
 
-    /// try to find the metatdata tag in the provided data
-    void processTagNotFound(const uint8_t* data, size_t len) {
+    /// frame sizes are synch save only in version 2.4
+    uint32_t calcFrameSize(uint8_t chars[4]) {
+        if (tagv2.version[0] >= 4) return calcSize(chars);
+        return (uint32_t)chars[0] << 24 | (uint32_t)chars[1] << 16 | (uint32_t)chars[2] << 8 | chars[3];
+    }
+
+    /// Processes the data for the actual state: returns the number of consumed bytes
+    size_t process(const uint8_t* data, size_t len) {
+        switch(state){
+            case FindHeader:
+                return findHeader(data, len);
+            case TagHeader:
+            case ExtendedHeader:
+            case FrameHeader:
+                return collectHeader(data, len);
+            case FrameContent:
+                return collectContent(data, len);
+            case Skip:
+                return skip(data, len);
+            default:
+                return len;
+        }
+    }
 
-        // activate tag processing when we have an ID3 Tag
-        if (!tag_active && !tag_processed){
-            int pos = findTag("ID3", (const char*) data, len);
-            if (pos>=0){
-                // fill v2 tag header
-                tag_active = true;  
-                // if we have enough data for the header we process it
-                if (len>=pos+sizeof(ID3v2)){
-                    memcpy(&tagv2, data+pos, sizeof(ID3v2));   
-                    end_len = total_len + calcSize(tagv2.size);
+    /// Looks for the "ID3" marker in the first bytes: matches are built up byte by byte
+    size_t findHeader(const uint8_t* data, size_t len) {
+        size_t pos = 0;
+        while (pos < len) {
+            if (total_len >= search_limit) {
+                state = Done;
+                return len;
+            }
+            uint8_t byte = data[pos++];
+            total_len++;
+            if (byte == "ID3"[header_pos]) {
+                header_data[header_pos++] = byte;
+                if (header_pos == 3) {
+                    state = TagHeader;
+                    return pos;
                 }
+            } else {
+                header_pos = byte == 'I' ? 1 : 0;
+                if (header_pos == 1) header_data[0] = byte;
             }
         }
+        return pos;
+    }
 
-        // deactivate tag processing when we are out of range
-        if (end_len>0 && total_len>end_len){
-            tag_active = false;
-            tag_processed = false;
+    /// Collects the bytes of the tag, extended or frame header
+    size_t collectHeader(const uint8_t* data, size_t len) {
+        int header_size = state == ExtendedHeader ? 4 : 10;
+        size_t n = min(len, (size_t)(header_size - header_pos));
+        memcpy(header_data + header_pos, data, n);
+        header_pos += n;
+        total_len += n;
+        if (state != TagHeader) tag_remaining -= min((uint32_t) n, tag_remaining);
+        if (header_pos == header_size) {
+            header_pos = 0;
+            if (state == TagHeader) processTagHeader();
+            else if (state == ExtendedHeader) processExtendedHeader();
+            else processFrameHeader();
         }
+        return n;
+    }
 
-        
-        if (tag_active){
-            // process all tags in current buffer
-            const char* partial_tag = nullptr;
-            for (const char* tag : id3_v2_tags){
-                actual_tag = tag;
-                int tag_pos = findTag(tag, (const char*)  data, len);
-
-                if (tag_pos>0 && tag_pos+sizeof(ID3v2Frame)<=len){
-                    // setup tag header
-                    memmove(&frame_header, data+tag_pos, sizeof(ID3v2FrameString));
-
-                    // get tag content
-                    if(calcSize(frame_header.size) <= len){
-                        int l = min(calcSize(frame_header.size)-1, (uint32_t) 256);
-                        memset(result,0,256);
-                        strncpy((char*)result, (char*) data+tag_pos+ID3FrameSize, l);
-                        int checkLen = min(l, 10);
-                        if (isAscii(checkLen)){
-                            processnotifyAudioChange();
-                        } else {
-                            LOGW("TAG %s ignored", tag);
-                        }
-                    } else {
-                        partial_tag = tag;
-                        LOGI("%s partial tag", tag);
-                    }
-                } 
-            }
-            
-            // save partial tag information so that we process the remainder with the next write
-            if (partial_tag!=nullptr){
-                int tag_pos = findTag(partial_tag, (const char*)  data, len);
-                memmove(&frame_header, data+tag_pos, sizeof(ID3v2FrameString));
-                int size = min(len - tag_pos, (size_t) calcSize(frame_header.size)-1); 
-                strncpy((char*)result, (char*)data+tag_pos+ID3FrameSize, size);
-                use_bytes_of_next_write = size;
-                status = PartialTagAtTail;
+    void processTagHeader() {
+        memcpy(&tagv2, header_data, sizeof(ID3v2));
+        bool valid = tagv2.version[0] >= 2 && tagv2.version[0] < 0xFF && tagv2.version[1] < 0xFF
+            && (tagv2.size[0] | tagv2.size[1] | tagv2.size[2] | tagv2.size[3]) < 0x80;
+        if (!valid) {
+            // not a real header: continue the search
+            state = FindHeader;
+            return;
+        }
+        tag_active = true;
+        tag_remaining = calcSize(tagv2.size);
+        LOGI("ID3v2.%d tag with %u bytes", tagv2.version[0], (unsigned) tag_remaining);
+        if (tagv2.version[0] < 3) {
+            // v2.2 uses 3 character frame ids which we do not support
+            startSkip(tag_remaining);
+        } else if (tagv2.flags & ExtendedHeaderFlag) {
+            state = ExtendedHeader;
+        } else {
+            nextFrame();
+        }
+    }
+
+    void processExtendedHeader() {
+        uint8_t *size = header_data;
+        // in v2.4 the size includes the size bytes, in v2.3 it does not
+        uint32_t ext_len = tagv2.version[0] >= 4 ? calcSize(size) - 4 : calcFrameSize(size);
+        startSkip(min(ext_len, tag_remaining));
+    }
+
+    void processFrameHeader() {
+        memcpy(&frame_header, header_data, sizeof(ID3v2Frame));
+        frame_len = calcFrameSize(frame_header.size);
+        if (header_data[0] == 0) {
+            // padding: the remainder of the tag is empty
+            startSkip(tag_remaining);
+            return;
+        }
+        if (frame_len > tag_remaining) frame_len = tag_remaining;
+        actual_tag = nullptr;
+        for (const char* tag : id3_v2_tags){
+            if (memcmp(frame_header.id, tag, 4) == 0) actual_tag = tag;
+        }
+        if (actual_tag != nullptr && frame_len > 0) {
+            memset(result, 0, sizeof(result));
+            result_len = 0;
+            has_encoding = false;
+            state = FrameContent;
+        } else {
+            startSkip(frame_len);
+        }
+    }
+
+    /// Copies the relevant part of the frame content (encoding byte + max 255 chars)
+    size_t collectContent(const uint8_t* data, size_t len) {
+        size_t n = min(len, (size_t) frame_len);
+        size_t pos = 0;
+        if (!has_encoding && n > 0) {
+            frame_header.encoding = data[0];
+            has_encoding = true;
+            pos = 1;
+        }
+        int copy = min((int)(n - pos), (int)sizeof(result) - 1 - result_len);
+        if (copy > 0) {
+            memcpy(result + result_len, data + pos, copy);
+            result_len += copy;
+        }
+        frame_len -= n;
+        tag_remaining -= min((uint32_t) n, tag_remaining);
+        total_len += n;
+        if (frame_len == 0) {
+            if (isAscii(strnlength(result, sizeof(result)))){
+                processnotifyAudioChange();
+            } else {
+                LOGW("TAG %s ignored", actual_tag);
             }
+            nextFrame();
         }
-    
-        total_len += len;
+        return n;
+    }
+
+    /// Skips the data w/o copying it
+    size_t skip(const uint8_t* data, size_t len) {
+        size_t n = min(len, (size_t) skip_len);
+        skip_len -= n;
+        tag_remaining -= min((uint32_t) n, tag_remaining);
+        total_len += n;
+        if (skip_len == 0) nextFrame();
+        return n;
+    }
 
+    void startSkip(uint32_t len) {
+        skip_len = len;
+        state = Skip;
+        if (skip_len == 0) nextFrame();
+    }
+
+    /// Continues with the next frame or ends the processing at the end of the tag
+    void nextFrame() {
+        header_pos = 0;
+        if (tag_remaining == 0) {
+            LOGI("ID3v2 tag processed");
+            tag_active = false;
+            tag_processed = true;
+            state = Done;
+        } else if (tag_remaining < 10) {
+            startSkip(tag_remaining);
+        } else {
+            state = FrameHeader;
+        }
     }
 
     /// Make sure that the result is a valid ASCII string
@@ -486,16 +599,6 @@ class MetaDataID3V2 : public MetaDataID3Base  {
         return true;
     }
 
-    /// We have the beginning of the metadata and need to process the remainder
-    void processPartialTagAtTail(const uint8_t* data, size_t len) {
-        int remainder = calcSize(frame_header.size) - use_bytes_of_next_write;
-        memcpy(result+use_bytes_of_next_write, data, remainder);
-        processnotifyAudioChange();    
-
-        status = TagNotFound;
-        processTagNotFound(data+use_bytes_of_next_write, len-use_bytes_of_next_write);
-    }
-
     /// For the time beeing we support only ASCII and UTF8
     bool encodingIsSupported(){
         return frame_header.encoding == 0 || frame_header.encoding == 3;
@@ -506,7 +609,6 @@ class MetaDataID3V2 : public MetaDataID3Base  {
         return (res == nullptr) ? -1 : res - str;
     }
 
-
     /// executes the callbacks
     void processnotifyAudioChange() {
         if (callback!=nullptr && actual_tag!=nullptr && encodingIsSupported()){
@@ -47,6 +47,12 @@ struct PWMConfig : public AudioInfo {
   uint8_t resolution = 8;  // Only used by ESP32: must be between 8 and 11 ->
                            // drives pwm frequency
   uint8_t timer_id = 0;    // Only used by ESP32 must be between 0 and 3
+  /// Output with DMA instead of a timer interrupt per frame (RP2040 and
+  /// ESP32): the CPU only needs to refill the blocks of buffer_size bytes
+  bool is_dma = false;
+  /// Requantize the samples to the pwm resolution with noise shaping: the
+  /// quantization noise is moved to the high frequencies
+  bool is_noise_shaping = false;
 
 #ifndef __AVR__
   uint16_t start_pin = PIN_PWM_START;
@@ -91,6 +97,8 @@ struct PWMConfig : public AudioInfo {
     LOGI("buffer_count: %u", buffers);
     LOGI("pwm_frequency: %u", (unsigned)pwm_frequency);
     LOGI("resolution: %d", resolution);
+    LOGI("is_dma: %s", is_dma ? "true" : "false");
+    LOGI("is_noise_shaping: %s", is_noise_shaping ? "true" : "false");
     // LOGI("timer_id: %d", timer_id);
   }
 
@@ -146,6 +154,8 @@ class DriverPWMBase {
     }
 
     // reset class variables
+    noise_error.resize(2 * audio_config.channels);
+    for (int j = 0; j < noise_error.size(); j++) noise_error[j] = 0;
     underflow_count = 0;
     underflow_per_second = 0;
     frame_count = 0;
@@ -198,8 +208,8 @@ class DriverPWMBase {
   // provides the effectivly measured output frames per second
   uint32_t framesPerSecond() { return frames_per_second; }
 
-  inline void updateStatistics() {
-    frame_count++;
+  inline void updateStatistics(int frames = 1) {
+    frame_count += frames;
     if (millis() >= time_1_sec) {
       time_1_sec = millis() + 1000;
       frames_per_second = frame_count;
@@ -237,6 +247,8 @@ class DriverPWMBase {
   bool is_timer_started = false;
   bool is_blocking_write = true;
   Decimate decimate;
+  // last two quantization errors for each channel (16 bit fraction)
+  Vector<int32_t> noise_error{0};
 
   void deleteBuffer() {
     // delete buffer if necessary
@@ -253,7 +265,7 @@ class DriverPWMBase {
       int required = (audio_config.bits_per_sample / 8) * audio_config.channels;
       if (buffer->available() >= required) {
         for (int j = 0; j < audio_config.channels; j++) {
-          int value = nextValue();
+          int value = nextPWMValue(j);
           pwmWrite(j, value);
         }
       } else {
@@ -263,6 +275,94 @@ class DriverPWMBase {
     }
   }
 
+  /// Determines the pwm values for the indicated number of frames (e.g. to
+  /// refill a DMA buffer): the values are stored interleaved. Missing data is
+  /// replaced with the last frame. Returns the number of frames with data.
+  int nextPWMFrames(uint16_t *values, int frames) {
+    const int channels = audio_config.channels;
+    const int required = frame_size * frames;
+    int available = frames;
+    if (buffer->available() < required) {
+      available = buffer->available() / frame_size;
+    }
+    for (int i = 0; i < available; i++) {
+      for (int j = 0; j < channels; j++) {
+        *values++ = nextPWMValue(j);
+      }
+    }
+    for (int i = available; i < frames; i++) {
+      for (int j = 0; j < channels; j++) {
+        *values = i > 0 ? values[-channels] : maxOutputValue() / 2;
+        values++;
+      }
+    }
+    underflow_count += frames - available;
+    updateStatistics(frames);
+    return available;
+  }
+
+  /// Determines the next pwm value of the indicated channel
+  int nextPWMValue(int channel) {
+    return audio_config.is_noise_shaping ? nextShapedValue(channel)
+                                         : nextValue();
+  }
+
+  /// Requantizes the next sample with a second order error feedback: the
+  /// quantization noise is shaped with (1 - z^-1)^2
+  int nextShapedValue(int channel) {
+    const int32_t max_value = maxOutputValue();
+    int32_t *error = noise_error.data() + 2 * channel;
+    // value in the pwm range with 16 fraction bits
+    int64_t value = (int64_t)(nextSample16() + 32768) * max_value;
+    value += 2 * error[0] - error[1];
+    int32_t result = (value + 32768) >> 16;
+    if (result < 0) result = 0;
+    if (result > max_value) result = max_value;
+    int32_t new_error = value - ((int64_t)result << 16);
+    // limit the error to keep the loop stable when we clip
+    if (new_error > 65536) new_error = 65536;
+    if (new_error < -65536) new_error = -65536;
+    error[1] = error[0];
+    error[0] = new_error;
+    return result;
+  }
+
+  /// reads the next sample and provides it as 16 bit value
+  int32_t nextSample16() {
+    switch (audio_config.bits_per_sample) {
+      case 8: {
+        int16_t value = buffer->read();
+        if (value < 0) {
+          LOGE(READ_ERROR_MSG);
+          value = 0;
+        }
+        return (int32_t)(int8_t)value << 8;
+      }
+      case 16: {
+        int16_t value = 0;
+        if (buffer->readArray((uint8_t *)&value, 2) != 2) {
+          LOGE(READ_ERROR_MSG);
+        }
+        return value;
+      }
+      case 24: {
+        int24_t value;
+        if (buffer->readArray((uint8_t *)&value, 3) != 3) {
+          LOGE(READ_ERROR_MSG);
+        }
+        return (int32_t)value >> 8;
+      }
+      case 32: {
+        int32_t value = 0;
+        if (buffer->readArray((uint8_t *)&value, 4) != 4) {
+          LOGE(READ_ERROR_MSG);
+        }
+        return value >> 16;
+      }
+    }
+    return 0;
+  }
+
   /// determines the next scaled value
   virtual int nextValue() {
     int result = 0;
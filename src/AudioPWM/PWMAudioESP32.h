@@ -2,6 +2,14 @@
 #pragma once
 #ifdef ESP32
 #include "AudioPWM/PWMAudioBase.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "soc/soc_caps.h"
+#if SOC_I2S_SUPPORTS_PDM_TX
+#include "driver/i2s_pdm.h"
+#include "Concurrency/Task.h"
+#define USE_PWM_DMA_ESP32
+#endif
+#endif
 
 namespace audio_tools {
 
@@ -28,6 +36,11 @@ typedef PinInfoESP32 PinInfo;
 /**
  * @brief Audio output to PWM pins for the ESP32. The ESP32 supports up to 16
  * channels.
+ * The LEDC has no DMA: with is_dma we output the data via the DMA of the I2S
+ * peripheral in PDM mode, so that the pins are driven by the hardware
+ * sigma-delta modulator and a task only needs to refill the blocks. This
+ * supports 1 channel and 2 channels on the chips which support 2 PDM
+ * data lines.
  * @ingroup platform
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -43,8 +56,9 @@ class PWMDriverESP32 : public DriverPWMBase {
   virtual void end() {
     TRACED();
     timer.end();
+    endDMA();
     is_timer_started = false;
-    for (int j = 0; j < audio_config.channels; j++) {
+    for (int j = 0; j < pins.size(); j++) {
 #if ESP_IDF_VERSION > ESP_IDF_VERSION_VAL(5, 0, 0)
       ledcDetach(pins[j].gpio);
 #else
@@ -57,6 +71,17 @@ class PWMDriverESP32 : public DriverPWMBase {
   /// when we get the first write -> we activate the timer to start with the
   /// output of data
   virtual void startTimer() {
+#ifdef USE_PWM_DMA_ESP32
+    if (tx_chan != nullptr) {
+      if (!is_timer_started) {
+        TRACEI();
+        task.create("pwm-dma", 3 * 1024, 10);
+        task.begin([this]() { writeDMABlock(); });
+        is_timer_started = true;
+      }
+      return;
+    }
+#endif
     if (!timer) {
       TRACEI();
       audio_config = audioInfo();
@@ -67,6 +92,13 @@ class PWMDriverESP32 : public DriverPWMBase {
 
   /// Setup LED PWM
   virtual void setupPWM() {
+    endDMA();
+#ifdef USE_PWM_DMA_ESP32
+    if (audio_config.is_dma) {
+      if (setupDMA()) return;
+      LOGW("DMA not available: using timer");
+    }
+#endif
     // frequency is driven by selected resolution
     audio_config.pwm_frequency = frequency(audio_config.resolution) * 1000;
 
@@ -117,6 +149,109 @@ class PWMDriverESP32 : public DriverPWMBase {
  protected:
   Vector<PinInfo> pins;
   TimerAlarmRepeating timer;
+#ifdef USE_PWM_DMA_ESP32
+  i2s_chan_handle_t tx_chan = nullptr;
+  Task task;
+  Vector<int16_t> dma_block{0};
+  int dma_frames = 0;
+
+  /// Outputs the pins with the I2S PDM modulator which is fed by DMA
+  bool setupDMA() {
+    TRACED();
+    if (audio_config.channels > 2) return false;
+#if !SOC_I2S_HW_VERSION_2
+    // only one pdm data line
+    if (audio_config.channels > 1) return false;
+#endif
+    dma_frames = audio_config.buffer_size / frame_size;
+    if (dma_frames < 1) dma_frames = 1;
+    dma_block.resize(dma_frames * audio_config.channels);
+
+    i2s_chan_config_t chan_cfg =
+        I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = audio_config.buffers;
+    chan_cfg.dma_frame_num = dma_frames;
+    chan_cfg.auto_clear = true;
+    if (i2s_new_channel(&chan_cfg, &tx_chan, nullptr) != ESP_OK) {
+      LOGE("i2s_new_channel");
+      tx_chan = nullptr;
+      return false;
+    }
+
+    i2s_pdm_tx_config_t pdm_cfg = {
+        .clk_cfg = I2S_PDM_TX_CLK_DEFAULT_CONFIG(
+            (uint32_t)audio_config.sample_rate),
+#if SOC_I2S_HW_VERSION_2
+        .slot_cfg = I2S_PDM_TX_SLOT_DAC_DEFAULT_CONFIG(
+            I2S_DATA_BIT_WIDTH_16BIT, (i2s_slot_mode_t)audio_config.channels),
+#else
+        .slot_cfg = I2S_PDM_TX_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT,
+                                                   I2S_SLOT_MODE_MONO),
+#endif
+        .gpio_cfg =
+            {
+                .clk = I2S_GPIO_UNUSED,
+                .dout = (gpio_num_t)audio_config.pins()[0],
+#if SOC_I2S_HW_VERSION_2
+                .dout2 = audio_config.channels > 1
+                             ? (gpio_num_t)audio_config.pins()[1]
+                             : I2S_GPIO_UNUSED,
+#endif
+                .invert_flags =
+                    {
+                        .clk_inv = false,
+                    },
+            },
+    };
+    if (i2s_channel_init_pdm_tx_mode(tx_chan, &pdm_cfg) != ESP_OK ||
+        i2s_channel_enable(tx_chan) != ESP_OK) {
+      LOGE("i2s_channel_init_pdm_tx_mode");
+      i2s_del_channel(tx_chan);
+      tx_chan = nullptr;
+      return false;
+    }
+    LOGI("setupDMA: pins=%d, frames=%d, blocks=%d", audio_config.channels,
+         dma_frames, audio_config.buffers);
+    return true;
+  }
+
+  /// Task loop: provides the next block to the DMA. We block until a DMA
+  /// buffer is free
+  void writeDMABlock() {
+    const int channels = audio_config.channels;
+    int available = dma_frames;
+    if (buffer->available() < frame_size * dma_frames) {
+      available = buffer->available() / frame_size;
+    }
+    int16_t *values = dma_block.data();
+    for (int i = 0; i < available * channels; i++) {
+      *values++ = nextSample16();
+    }
+    // repeat the last frame on underflow
+    for (int i = available; i < dma_frames; i++) {
+      for (int j = 0; j < channels; j++) {
+        *values = i > 0 ? values[-channels] : 0;
+        values++;
+      }
+    }
+    underflow_count += dma_frames - available;
+    updateStatistics(dma_frames);
+    size_t written = 0;
+    i2s_channel_write(tx_chan, dma_block.data(),
+                      dma_block.size() * sizeof(int16_t), &written,
+                      portMAX_DELAY);
+  }
+
+  void endDMA() {
+    if (tx_chan == nullptr) return;
+    task.end();
+    i2s_channel_disable(tx_chan);
+    i2s_del_channel(tx_chan);
+    tx_chan = nullptr;
+  }
+#else
+  void endDMA() {}
+#endif
 
   /// provides the max value for the indicated resulution
   int maxUnsignedValue(int resolution) { return pow(2, resolution); }
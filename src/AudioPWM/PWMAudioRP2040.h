@@ -4,7 +4,9 @@
 #include "AudioPWM/PWMAudioBase.h"
 #include "hardware/adc.h"
 #include "hardware/clocks.h"
+#include "hardware/dma.h"
 #include "hardware/gpio.h"
+#include "hardware/irq.h"
 #include "hardware/pwm.h"
 #include "hardware/structs/clocks.h"
 #include "pico/time.h"
@@ -35,6 +37,10 @@ struct PicoChannelOut {
  * @brief Audio output for the Rasperry Pico to PWM pins.
    The Raspberry Pi Pico has 8 PWM blocks/slices(1-8) and each PWM block
  provides up to two PWM outputs(A-B).
+ With is_dma the compare register of the slice is updated by two chained DMA
+ channels which are paced by a DMA timer: the CPU only refills a block when a
+ DMA transfer has completed. This requires that all pins are on the same
+ slice.
  * @ingroup platform
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -52,6 +58,7 @@ class PWMDriverRP2040 : public DriverPWMBase {
     TRACED();
     ticker.end();  // it does not hurt to call this even if it has not been
                    // started
+    endDMA();
     is_timer_started = false;
     for (auto pin : pins) {
       if (pin.gpio != -1) {
@@ -64,12 +71,26 @@ class PWMDriverRP2040 : public DriverPWMBase {
  protected:
   Vector<PicoChannelOut> pins;
   TimerAlarmRepeating ticker;
+  // dma output
+  bool is_dma_active = false;
+  int dma_channel[2] = {-1, -1};
+  int dma_timer = -1;
+  int dma_frames = 0;
+  Vector<uint32_t> dma_buffer[2];
+  Vector<uint16_t> dma_values{0};
 
   virtual void startTimer() override {
     TRACED();
-    ticker.setCallbackParameter(this);
-    ticker.begin(defaultPWMAudioOutputCallbackPico, audio_config.sample_rate, HZ);
-    
+    if (is_dma_active) {
+      // start with the available data in both blocks
+      fillDMABuffer(0);
+      fillDMABuffer(1);
+      dma_channel_start(dma_channel[0]);
+    } else {
+      ticker.setCallbackParameter(this);
+      ticker.begin(defaultPWMAudioOutputCallbackPico, audio_config.sample_rate,
+                   HZ);
+    }
     is_timer_started = true;
   }
 
@@ -94,6 +115,136 @@ class PWMDriverRP2040 : public DriverPWMBase {
 
       setupPWMPin(cfg, pins[channel]);
     }
+
+    endDMA();
+    if (audio_config.is_dma) {
+      is_dma_active = setupDMA();
+    }
+  }
+
+  /// All pins must be on the same slice so that we can write the compare
+  /// register of both pwm channels with one transfer
+  bool isDMASupported() {
+    for (int j = 1; j < audio_config.channels; j++) {
+      if (pins[j].slice != pins[0].slice) return false;
+    }
+    return true;
+  }
+
+  /// Sets up two chained DMA channels which write the pwm compare register
+  /// paced by a DMA timer at the sample rate
+  bool setupDMA() {
+    TRACED();
+    if (!isDMASupported()) {
+      LOGW("DMA requires all pins on the same slice: using timer");
+      return false;
+    }
+    dma_frames = audio_config.buffer_size / frame_size;
+    if (dma_frames < 1) dma_frames = 1;
+    dma_values.resize(dma_frames * audio_config.channels);
+    for (int j = 0; j < 2; j++) {
+      dma_buffer[j].resize(dma_frames);
+      for (int i = 0; i < dma_frames; i++) {
+        dma_buffer[j][i] = toCompareValue(maxOutputValue() / 2,
+                                          maxOutputValue() / 2);
+      }
+    }
+
+    // pace the transfers with a dma timer: rate = sys_clk * num / den
+    dma_timer = dma_claim_unused_timer(true);
+    uint32_t sys_clk = clock_get_hz(clk_sys);
+    uint32_t num = (uint64_t)0xFFFF * audio_config.sample_rate / sys_clk;
+    if (num < 1) num = 1;
+    if (num > 0xFFFF) num = 0xFFFF;
+    uint32_t den = ((uint64_t)sys_clk * num + audio_config.sample_rate / 2) /
+                   audio_config.sample_rate;
+    if (den > 0xFFFF) den = 0xFFFF;
+    dma_timer_set_fraction(dma_timer, num, den);
+    LOGI("->dma timer: %d (%u/%u)", dma_timer, (unsigned)num, (unsigned)den);
+
+    dma_channel[0] = dma_claim_unused_channel(true);
+    dma_channel[1] = dma_claim_unused_channel(true);
+    volatile void *cc = &pwm_hw->slice[pins[0].slice].cc;
+    for (int j = 0; j < 2; j++) {
+      dma_channel_config cfg = dma_channel_get_default_config(dma_channel[j]);
+      channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+      channel_config_set_read_increment(&cfg, true);
+      channel_config_set_write_increment(&cfg, false);
+      channel_config_set_dreq(&cfg, dma_get_timer_dreq(dma_timer));
+      channel_config_set_chain_to(&cfg, dma_channel[1 - j]);
+      dma_channel_configure(dma_channel[j], &cfg, cc, dma_buffer[j].data(),
+                            dma_frames, false);
+      dma_channel_set_irq0_enabled(dma_channel[j], true);
+    }
+
+    dmaSelf() = this;
+    irq_add_shared_handler(DMA_IRQ_0, dmaIRQHandler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+    LOGI("->dma channels: %d, %d with %d frames", dma_channel[0],
+         dma_channel[1], dma_frames);
+    return true;
+  }
+
+  /// Stops the DMA and releases the channels and the timer
+  void endDMA() {
+    if (!is_dma_active) return;
+    TRACED();
+    for (int j = 0; j < 2; j++) {
+      dma_channel_set_irq0_enabled(dma_channel[j], false);
+      dma_channel_abort(dma_channel[j]);
+      dma_channel_acknowledge_irq0(dma_channel[j]);
+      dma_channel_unclaim(dma_channel[j]);
+      dma_channel[j] = -1;
+    }
+    irq_remove_handler(DMA_IRQ_0, dmaIRQHandler);
+    dma_timer_unclaim(dma_timer);
+    dma_timer = -1;
+    dmaSelf() = nullptr;
+    is_dma_active = false;
+  }
+
+  /// Refills the indicated block with the next pwm values
+  void fillDMABuffer(int idx) {
+    nextPWMFrames(dma_values.data(), dma_frames);
+    uint16_t *values = dma_values.data();
+    uint32_t *out = dma_buffer[idx].data();
+    for (int i = 0; i < dma_frames; i++) {
+      if (audio_config.channels == 1) {
+        out[i] = toCompareValue(values[0], values[0]);
+      } else {
+        int a = pins[0].channel == PWM_CHAN_A ? 0 : 1;
+        out[i] = toCompareValue(values[a], values[1 - a]);
+      }
+      values += audio_config.channels;
+    }
+  }
+
+  /// Combines the levels of pwm channel A and B into a compare register value
+  inline uint32_t toCompareValue(uint16_t a, uint16_t b) {
+    return ((uint32_t)b << PWM_CH0_CC_B_LSB) | a;
+  }
+
+  /// Called when a DMA block has been sent: the block is refilled and
+  /// rearmed while the other channel is active
+  void onDMAComplete() {
+    for (int j = 0; j < 2; j++) {
+      if (dma_channel_get_irq0_status(dma_channel[j])) {
+        dma_channel_acknowledge_irq0(dma_channel[j]);
+        fillDMABuffer(j);
+        dma_channel_set_read_addr(dma_channel[j], dma_buffer[j].data(), false);
+      }
+    }
+  }
+
+  /// the DMA irq handler does not support a parameter
+  static PWMDriverRP2040 *&dmaSelf() {
+    static PWMDriverRP2040 *self = nullptr;
+    return self;
+  }
+
+  static void dmaIRQHandler() {
+    if (dmaSelf() != nullptr) dmaSelf()->onDMAComplete();
   }
 
   // defines the pwm_config which will be used to drive the pins
@@ -73,6 +73,7 @@
 #include "AudioTools/BaseConverter.h"
 #include "AudioFilter/Filter.h"
 #include "AudioFilter/Equilizer.h"
+#include "AudioFilter/EquilizerNBands.h"
 #include "AudioFilter/MedianFilter.h"
 #include "AudioTools/MusicalNotes.h"
 #include "AudioI2S/I2SStream.h"
@@ -83,6 +84,8 @@
 #include "AudioTools/AudioStreamsConverter.h"
 #include "AudioTools/AudioOutput.h"
 #include "AudioTools/VolumeStream.h"
+#include "AudioTools/AudioDucking.h"
+#include "AudioTools/GoertzelStream.h"
 #include "AudioTools/AudioIO.h"
 #include "AudioTools/ResampleStream.h"
 #include "AudioTools/StreamCopy.h"
@@ -96,6 +99,11 @@
 #include "AudioHttp/AudioHttp.h"
 #include "AudioTools/Fade.h"
 #include "AudioTools/Pipeline.h"
+#include "AudioTools/LoopbackLatency.h"
+#include "AudioTools/LatencyTracer.h"
+#include "AudioTools/AudioMetrics.h"
+#include "AudioTools/LoadGovernor.h"
+#include "AudioTools/BeamformerStream.h"
 #include "AudioTools/AudioPlayer.h"
 
 /**
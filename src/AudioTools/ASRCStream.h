@@ -0,0 +1,271 @@
+#pragma once
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioLibs/PIDController.h"
+#include "AudioTools/AudioStreams.h"
+#include "Concurrency/RingBufferLockFree.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Configuration for the ASRCStream
+ * @ingroup transform
+ */
+struct ASRCConfig : public AudioInfo {
+  /// Size of the ring buffer between the two clock domains in frames
+  int buffer_frames = 4096;
+  /// Fill level which is kept by the controller: 0 uses half of the buffer
+  int latency_frames = 0;
+  /// Max deviation of the ratio from 1.0 in ppm
+  float max_ppm = 1000.0f;
+  /// Proportional gain: ratio correction per frame of fill level error. The
+  /// controller is updated with each read, the defaults are tuned for reads
+  /// of about 512 frames.
+  float kp = 0.000002f;
+  /// Integral gain: ratio correction per accumulated frame of error
+  float ki = 0.000000002f;
+  /// Smoothing of the measured fill level (0..1): the ring is filled in
+  /// blocks, so we use a moving average
+  float fill_smoothing = 0.05f;
+};
+
+/**
+ * @brief Asynchronous sample rate converter which bridges two independent
+ * clock domains with the same nominal sample rate (e.g. A2DP, VBAN or I2S
+ * input -> I2S output): the source writes into a lock free ring buffer, the
+ * sink reads with readBytes(). With each read we compare the fill level of
+ * the ring buffer with the latency_frames and a PI controller adjusts the
+ * resampling ratio within +/- max_ppm, so that the fill level and therefore
+ * the latency stays constant. The variable ratio is applied with a 4 point
+ * Hermite interpolation.
+ * @code
+ * ASRCStream asrc;
+ * StreamCopy copier(i2s, asrc); // sink: reads the resampled data
+ * // source (e.g. A2DP callback): asrc.write(data, len);
+ * @endcode
+ * Since the source writes in blocks, the measured fill level varies by up to
+ * one block: this is the remaining latency jitter and causes a small wander
+ * of the ratio around the real clock ratio.
+ * write() never blocks: if the ring buffer is full the data is dropped (see
+ * overflows()). If the ring buffer runs empty we provide silence (see
+ * underflows()) until the latency_frames are available again.
+ * Supported are 16 and 32 bits per sample.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ASRCStream : public AudioStream {
+ public:
+  ASRCStream() = default;
+
+  ASRCConfig defaultConfig() {
+    ASRCConfig c;
+    c.copyFrom(audioInfo());
+    return c;
+  }
+
+  bool begin(ASRCConfig cfg) {
+    this->cfg = cfg;
+    setAudioInfo(cfg);
+    return begin();
+  }
+
+  bool begin() override {
+    TRACEI();
+    if (cfg.bits_per_sample != 16 && cfg.bits_per_sample != 32) {
+      LOGE("Unsupported bits_per_sample: %d", cfg.bits_per_sample);
+      return false;
+    }
+    if (cfg.channels <= 0 || cfg.buffer_frames < 8) {
+      LOGE("Invalid channels: %d or buffer_frames: %d", cfg.channels,
+           cfg.buffer_frames);
+      return false;
+    }
+    frame_size = cfg.channels * cfg.bits_per_sample / 8;
+    ring.resize(cfg.buffer_frames * frame_size);
+    target_frames = cfg.latency_frames > 0 ? cfg.latency_frames
+                                           : ring.size() / frame_size / 2;
+    float max_correction = cfg.max_ppm / 1000000.0f;
+    pid = PIDController();
+    pid.begin(1.0f, max_correction, -max_correction, cfg.kp, 0.0f, cfg.ki);
+    history.resize(4 * cfg.channels);
+    input.resize(frame_size * 64);
+    reset();
+    is_active = true;
+    return true;
+  }
+
+  void end() override {
+    is_active = false;
+    ring.resize(0);
+    history.reset();
+    input.reset();
+  }
+
+  void setAudioInfo(AudioInfo info) override {
+    AudioStream::setAudioInfo(info);
+    cfg.copyFrom(info);
+  }
+
+  /// Source clock domain: adds the data to the ring buffer
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!is_active) return 0;
+    // we only add full frames
+    int free = ring.availableForWrite() / frame_size * frame_size;
+    int written = ring.writeArray(data, min((int)len, free));
+    if (written < (int)len) overflow_count++;
+    return len;
+  }
+
+  int availableForWrite() override { return ring.availableForWrite(); }
+
+  /// Sink clock domain: provides the resampled data
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (!is_active) return 0;
+    int frames = len / frame_size;
+    updateRatio();
+    if (cfg.bits_per_sample == 16) {
+      readFrames<int16_t>((int16_t *)data, frames);
+    } else {
+      readFrames<int32_t>((int32_t *)data, frames);
+    }
+    return frames * frame_size;
+  }
+
+  /// The sink can always read: we provide silence if necessary
+  int available() override { return is_active ? DEFAULT_BUFFER_SIZE : 0; }
+
+  /// Actual ratio of input to output frames
+  float ratio() { return step; }
+
+  /// Actual deviation of the ratio from 1.0 in ppm
+  float ppm() { return (step - 1.0f) * 1000000.0f; }
+
+  /// Smoothed fill level of the ring buffer in frames
+  float fillFrames() { return fill_avg; }
+
+  /// Fill level which is kept by the controller
+  int latencyFrames() { return target_frames; }
+
+  /// Number of reads which needed to provide silence
+  uint32_t underflows() { return underflow_count; }
+
+  /// Number of writes which did not fit into the ring buffer
+  uint32_t overflows() { return overflow_count; }
+
+  ASRCConfig &config() { return cfg; }
+
+ protected:
+  ASRCConfig cfg;
+  RingBufferLockFree<uint8_t> ring{0};
+  PIDController pid;
+  Vector<float> history{0};
+  Vector<uint8_t> input{0};
+  int input_pos = 0;
+  int input_len = 0;
+  int frame_size = 0;
+  int target_frames = 0;
+  float step = 1.0f;
+  float pos = 0.0f;
+  float fill_avg = 0.0f;
+  bool is_active = false;
+  bool is_filling = true;
+  uint32_t underflow_count = 0;
+  uint32_t overflow_count = 0;
+
+  void reset() {
+    memset(history.data(), 0, history.size() * sizeof(float));
+    input_pos = input_len = 0;
+    step = 1.0f;
+    pos = 0.0f;
+    fill_avg = target_frames;
+    is_filling = true;
+    underflow_count = 0;
+    overflow_count = 0;
+  }
+
+  /// Number of buffered input frames
+  int bufferedFrames() {
+    return ring.available() / frame_size + input_len - input_pos;
+  }
+
+  /// PI control of the fill level
+  void updateRatio() {
+    float fill = bufferedFrames();
+    fill_avg += cfg.fill_smoothing * (fill - fill_avg);
+    if (is_filling) return;
+    // a fill level above the target must consume the input faster
+    step = 1.0f - pid.calculate(target_frames, fill_avg);
+  }
+
+  template <typename T>
+  void readFrames(T *out, int frames) {
+    // wait until we have the latency: this defines the delay
+    if (is_filling) {
+      if (bufferedFrames() < target_frames) {
+        memset(out, 0, frames * frame_size);
+        return;
+      }
+      is_filling = false;
+      fill_avg = bufferedFrames();
+    }
+
+    int channels = cfg.channels;
+    float *h = history.data();
+    for (int j = 0; j < frames; j++) {
+      // move the history until pos is between h[1] and h[2]
+      while (pos >= 1.0f) {
+        if (!nextFrame<T>()) {
+          // underflow: silence for the rest and refill
+          memset(out + j * channels, 0, (frames - j) * frame_size);
+          underflow_count++;
+          is_filling = true;
+          return;
+        }
+        pos -= 1.0f;
+      }
+      float x = pos;
+      for (int ch = 0; ch < channels; ch++) {
+        float y0 = h[ch];
+        float y1 = h[channels + ch];
+        float y2 = h[2 * channels + ch];
+        float y3 = h[3 * channels + ch];
+        float c1 = 0.5f * (y2 - y0);
+        float c2 = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3;
+        float c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
+        float value = ((c3 * x + c2) * x + c1) * x + y1;
+        out[j * channels + ch] = clip<T>(value);
+      }
+      pos += step;
+    }
+  }
+
+  /// Shifts the history by one frame: returns false if no input is available
+  template <typename T>
+  bool nextFrame() {
+    if (input_pos >= input_len) {
+      int len = min(ring.available() / frame_size * frame_size,
+                    (int)input.size());
+      input_len = ring.readArray(input.data(), len) / frame_size;
+      input_pos = 0;
+      if (input_len == 0) return false;
+    }
+    int channels = cfg.channels;
+    float *h = history.data();
+    memmove(h, h + channels, 3 * channels * sizeof(float));
+    T *frame = (T *)(input.data() + input_pos * frame_size);
+    for (int ch = 0; ch < channels; ch++) h[3 * channels + ch] = frame[ch];
+    input_pos++;
+    return true;
+  }
+
+  template <typename T>
+  static T clip(float value) {
+    T max_value = NumberConverter::maxValueT<T>();
+    if (value >= (float)max_value) return max_value;
+    if (value <= -(float)max_value) return -max_value;
+    return value;
+  }
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+
+#include "AudioBasic/Collections/Vector.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Policy of an asynchronous output when its queue is full
+ * @ingroup io
+ */
+enum AsyncOutputPolicy {
+  /// wait until the output has consumed enough data
+  AsyncOutputBlock,
+  /// discard the oldest queued data to make room for the new data
+  AsyncOutputDropOldest,
+  /// discard the new data which does not fit
+  AsyncOutputSkip
+};
+
+/**
+ * @brief Bounded byte queue between a real time writer and a (slow) output
+ * which is drained by another task or a poll step. The writer never waits
+ * for the output: if the queue is full the data is handled according to the
+ * AsyncOutputPolicy. Dropping the oldest data moves the read position from
+ * the writer: the reader copies a chunk and only confirms it if the read
+ * position was not moved in the meantime, so it never sends overwritten
+ * data. One writer and one reader are supported.
+ * @ingroup io
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AsyncOutputQueue {
+ public:
+  AsyncOutputQueue(int size, AsyncOutputPolicy policy = AsyncOutputDropOldest) {
+    size_t capacity = 1;
+    while (capacity < (size_t)size) capacity <<= 1;
+    data.resize(capacity);
+    mask = capacity - 1;
+    this->policy = policy;
+  }
+
+  AsyncOutputPolicy getPolicy() { return policy; }
+
+  /// Number of queued bytes
+  int available() {
+    size_t tail = tail_pos.load(std::memory_order_acquire);
+    return head_pos.load(std::memory_order_acquire) - tail;
+  }
+
+  /// Number of bytes which can be added w/o dropping
+  int availableForWrite() { return data.size() - available(); }
+
+  /// Adds the data: writer only. Returns the number of queued bytes which
+  /// is less then len only for AsyncOutputSkip or AsyncOutputBlock.
+  int write(const uint8_t *src, int len) {
+    int capacity = data.size();
+    if (len > capacity) {
+      // only the most recent data fits
+      if (policy == AsyncOutputDropOldest) {
+        dropped_bytes += len - capacity;
+        src += len - capacity;
+        len = capacity;
+      } else {
+        len = capacity;
+      }
+    }
+    int open = availableForWrite();
+    if (len > open) {
+      if (policy == AsyncOutputDropOldest) {
+        makeRoom(len);
+      } else {
+        if (policy == AsyncOutputSkip) dropped_bytes += len - open;
+        len = open;
+      }
+    }
+    if (len <= 0) return 0;
+    size_t head = head_pos.load(std::memory_order_relaxed);
+    size_t idx = head & mask;
+    size_t len1 = min((size_t)len, data.size() - idx);
+    memcpy(data.data() + idx, src, len1);
+    if (len1 < (size_t)len) memcpy(data.data(), src + len1, len - len1);
+    head_pos.store(head + len, std::memory_order_release);
+    int lag = available();
+    if (lag > max_lag) max_lag = lag;
+    return len;
+  }
+
+  /// Removes up to len bytes into dest: reader only
+  int read(uint8_t *dest, int len) {
+    while (true) {
+      size_t tail = tail_pos.load(std::memory_order_acquire);
+      int result = min(len, (int)(head_pos.load(std::memory_order_acquire) -
+                                  tail));
+      if (result <= 0) return 0;
+      size_t idx = tail & mask;
+      size_t len1 = min((size_t)result, data.size() - idx);
+      memcpy(dest, data.data() + idx, len1);
+      if (len1 < (size_t)result) memcpy(dest + len1, data.data(), result - len1);
+      // the writer did not drop the data while we were copying
+      if (tail_pos.compare_exchange_strong(tail, tail + result,
+                                           std::memory_order_acq_rel))
+        return result;
+    }
+  }
+
+  /// Number of discarded bytes
+  uint32_t droppedBytes() { return dropped_bytes; }
+
+  /// Max number of queued bytes
+  int maxLagBytes() { return max_lag; }
+
+  /// Resets the statistics
+  void resetStatistics() {
+    dropped_bytes = 0;
+    max_lag = 0;
+  }
+
+ protected:
+  Vector<uint8_t> data{0};
+  size_t mask = 0;
+  AsyncOutputPolicy policy;
+  std::atomic<size_t> head_pos{0};
+  std::atomic<size_t> tail_pos{0};
+  std::atomic<uint32_t> dropped_bytes{0};
+  std::atomic<int> max_lag{0};
+
+  /// moves the read position, so that len bytes can be written: the reader
+  /// might have consumed some data in the meantime
+  void makeRoom(int len) {
+    int capacity = data.size();
+    size_t tail = tail_pos.load(std::memory_order_acquire);
+    while (true) {
+      int used = head_pos.load(std::memory_order_relaxed) - tail;
+      int drop = used + len - capacity;
+      if (drop <= 0) return;
+      if (tail_pos.compare_exchange_weak(tail, tail + drop,
+                                         std::memory_order_acq_rel)) {
+        dropped_bytes += drop;
+        return;
+      }
+    }
+  }
+};
+
+}  // namespace audio_tools
@@ -10,6 +10,14 @@
 #define DEBOUNCE_DELAY 500
 #endif
 
+#ifndef TOUCH_INTERVAL
+#define TOUCH_INTERVAL 50
+#endif
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
 #if defined(IS_MIN_DESKTOP)
 extern "C" void pinMode(int, int);
 extern "C" int digitalRead(int);
@@ -20,10 +28,17 @@ namespace audio_tools {
 // global reference to access from static callback methods
 class AudioActions;
 static AudioActions *selfAudioActions = nullptr;
+// bitmask of the actions which were flagged by the pin interrupts
+static uint32_t selfAudioActionsPending = 0;
 
 /**
  * @brief A simple class to assign functions to gpio pins e.g. to implement a
  * simple navigation control or volume control with buttons
+ *
+ * By default processActions() polls the pins. With setUsePinInterrupt() the
+ * pin interrupts just set a flag for the changed pin and processActions() only
+ * reads and dispatches the flagged pins (and the pressed buttons for the
+ * repetition). Touch pins are sampled every TOUCH_INTERVAL ms.
  * @ingroup tools
  */
 class AudioActions {
@@ -71,7 +86,10 @@ public:
 #endif
     }
 
-    void process() {
+    /// Processes the pin: returns true if the pin needs to be checked again
+    /// (pending debounce or active button)
+    bool process() {
+      bool result = false;
       if (this->enabled) {
         bool value = readValue();
         if (this->actionOn != nullptr && this->actionOff != nullptr) {
@@ -96,6 +114,9 @@ public:
             this->actionOn(active, this->pin, this->ref);
             this->lastState = value;
             this->debounceTimeout = millis() + debounceDelayValue;
+          } else if (value != this->lastState) {
+            // the change is reported after the debounce delay
+            result = true;
           }
         } else {
           bool active = (this->activeLogic == ActiveLow) ? !value : value;
@@ -107,8 +128,11 @@ public:
             this->lastState = active;
             this->debounceTimeout = millis() + debounceDelayValue;
           }
+          // repeat the action while the button is pressed
+          result = active;
         }
       }
+      return result;
     }
   };
 
@@ -153,6 +177,7 @@ public:
         action.touchLimit = touchLimit;
 
         actions.push_back(action);
+        setupInterrupt(pin, actions.size() - 1, activeLogicPar);
       }
     } else {
       LOGW("pin %d -> Ignored", pin);
@@ -175,6 +200,10 @@ public:
     static int pos = 0;
     if (actions.empty())
       return;
+    if (use_pin_interrupt) {
+      processPendingActions();
+      return;
+    }
     // execute action
     actions[pos].process();
     pos++;
@@ -190,6 +219,33 @@ public:
     }
   }
 
+  /// Executes the actions of the pins which were flagged by the interrupts
+  void processPendingActions() {
+    uint32_t pending =
+        __atomic_exchange_n(&selfAudioActionsPending, 0, __ATOMIC_ACQ_REL);
+    bool is_touch_due = millis() >= next_touch_ms;
+    if (is_touch_due) next_touch_ms = millis() + touch_interval_ms;
+    uint32_t recheck = 0;
+    for (int j = 0; j < actions.size(); j++) {
+      Action &action = actions[j];
+      bool is_due;
+      if (action.activeLogic == ActiveTouch) {
+        is_due = is_touch_due;
+      } else if (j >= 32) {
+        // no flag available: we need to poll
+        is_due = true;
+      } else {
+        is_due = pending & (1u << j);
+      }
+      if (is_due && action.process() && j < 32) {
+        recheck |= 1u << j;
+      }
+    }
+    if (recheck != 0) {
+      __atomic_fetch_or(&selfAudioActionsPending, recheck, __ATOMIC_RELEASE);
+    }
+  }
+
   /// Determines the action for the pin
   Action *findAction(int pin) {
     for (Action &action : actions) {
@@ -204,8 +260,16 @@ public:
   void setDebounceDelay(int value) { debounceDelayValue = value; }
   /// Defines the touch limit (Default 20)
   void setTouchLimit(int value) { touchLimit = value; }
-  /// Use interrupts instead of processActions() call in loop
-  void setUsePinInterrupt(bool active) { use_pin_interrupt = active; }
+  /// Use interrupts to flag the changed pins, so that processActions() only
+  /// needs to process these: call before adding the actions
+  void setUsePinInterrupt(bool active) {
+    use_pin_interrupt = active;
+    // process all pins in the first call
+    if (active) selfAudioActionsPending = 0xFFFFFFFF;
+  }
+  /// Defines the interval in ms in which the touch pins are sampled when
+  /// interrupts are used (Default 50)
+  void setTouchInterval(int ms) { touch_interval_ms = ms; }
   /// setup pin mode when true
   void setPinMode(bool active) { use_pin_mode = active; }
 
@@ -214,10 +278,21 @@ protected:
   int touchLimit = TOUCH_LIMIT;
   bool use_pin_interrupt = false;
   bool use_pin_mode = true;
+  int touch_interval_ms = TOUCH_INTERVAL;
+  unsigned long next_touch_ms = 0;
 
   Vector<Action> actions{0};
 
-  static void audioActionsISR() { selfAudioActions->processAllActions(); }
+  /// flags the action with the index which is provided as argument
+  static void IRAM_ATTR audioActionsISRArg(void *arg) {
+    __atomic_fetch_or(&selfAudioActionsPending, 1u << (uintptr_t)arg,
+                      __ATOMIC_RELEASE);
+  }
+
+  /// w/o argument we can not tell the pin: we flag all pins
+  static void IRAM_ATTR audioActionsISR() {
+    __atomic_store_n(&selfAudioActionsPending, 0xFFFFFFFF, __ATOMIC_RELEASE);
+  }
 
   void setupPin(int pin, ActiveLogic logic) {
     // in the audio-driver library the pins are already set up
@@ -230,10 +305,18 @@ protected:
         LOGI("pin %d -> INPUT", pin);
       }
     }
+  }
 
+  void setupInterrupt(int pin, int idx, ActiveLogic logic) {
 #if !defined(IS_MIN_DESKTOP)
-    if (use_pin_interrupt) {
+    // touch pins are sampled and the flags are limited to 32 actions
+    if (use_pin_interrupt && logic != ActiveTouch && idx < 32) {
+#if defined(ESP32)
+      attachInterruptArg(digitalPinToInterrupt(pin), audioActionsISRArg,
+                         (void *)(uintptr_t)idx, CHANGE);
+#else
       attachInterrupt(digitalPinToInterrupt(pin), audioActionsISR, CHANGE);
+#endif
     }
 #endif
   }
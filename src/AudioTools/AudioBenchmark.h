@@ -0,0 +1,261 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/Profiler.h"
+#include "AudioTools/AudioOutput.h"
+#include "AudioCodecs/AudioEncoded.h"
+#include "AudioEffects/SoundGenerator.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Result of a benchmark run of the AudioBenchmark
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct AudioBenchmarkResult {
+  const char *name = "";
+  /// Number of measured runs
+  int runs = 0;
+  /// Samples (of all channels) which were processed per run
+  size_t samples = 0;
+  /// Duration of the processed audio of a single run in microseconds
+  float audio_us = 0.0f;
+  /// Fastest run in ticks
+  uint32_t min_ticks = 0;
+  /// Slowest run in ticks
+  uint32_t max_ticks = 0;
+  /// Sum of all runs in ticks
+  uint64_t total_ticks = 0;
+  /// Max heap in bytes which was allocated during the runs
+  int heap_used = 0;
+  /// Smallest free stack in bytes (high water mark) after the runs
+  int stack_free = -1;
+
+  /// Average ticks (cpu cycles on the microcontrollers) per sample
+  float cyclesPerSample() {
+    return runs == 0 || samples == 0 ? 0.0f
+                                     : (float)total_ticks / runs / samples;
+  }
+
+  /// Average time per run in microseconds
+  float avgUs() {
+    return runs == 0 ? 0.0f
+                     : (float)total_ticks / runs / ProfilerClock::ticksPerUs();
+  }
+
+  /// Percent of the real time budget which was used: above 100% the
+  /// processing is too slow for the sample rate
+  float budgetPercent() {
+    return audio_us == 0.0f ? 0.0f : 100.0f * avgUs() / audio_us;
+  }
+};
+
+/**
+ * @brief Measures the processing time of an audio component on the target:
+ * a fixed PCM block (a sine tone) is processed the indicated number of times
+ * and the time is measured with the cycle counter of the ProfilerClock. The
+ * report provides the cycles per sample, the percentage of the real time
+ * budget at the sample rate and the peak heap and stack use.
+ *
+ * Components which are processing the data in place (effects, converters)
+ * get a fresh copy of the block for each run.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioBenchmark {
+ public:
+  AudioBenchmark(AudioInfo info = AudioInfo(44100, 2, 16), int frames = 512,
+                 int runs = 20) {
+    this->info = info;
+    this->frames = frames;
+    setRuns(runs);
+  }
+
+  /// Defines the number of measured runs
+  void setRuns(int runs) { this->runs = runs > 0 ? runs : 1; }
+
+  /// Prints the report to the indicated output instead of the AudioLogger
+  void setOutput(Print &out) { p_logout = &out; }
+
+  /// Defines the format of the test block
+  void setAudioInfo(AudioInfo info) { this->info = info; }
+
+  AudioInfo audioInfo() { return info; }
+
+  /// Generates the test block
+  bool begin() {
+    if (info.bits_per_sample != 16) {
+      LOGE("bits_per_sample not supported: %d", info.bits_per_sample);
+      return false;
+    }
+    ProfilerClock::begin();
+    SineWaveGenerator<int16_t> sine(16000);
+    sine.begin(info, N_A4);
+    pcm.resize(frames * info.channels);
+    work.resize(pcm.size());
+    for (int j = 0; j < pcm.size(); j++) pcm[j] = sine.readSample();
+    return true;
+  }
+
+  /// The test block
+  int16_t *data() { return pcm.data(); }
+
+  /// Size of the test block in bytes
+  size_t size() { return pcm.size() * sizeof(int16_t); }
+
+  /// Writes the test block to the output: e.g. a stream with an effect,
+  /// filter, converter or an encoder
+  AudioBenchmarkResult run(const char *name, Print &out) {
+    return run(name, pcm.size(),
+               [&]() { out.write((uint8_t *)work.data(), size()); });
+  }
+
+  /// Encodes the test block with the encoder
+  AudioBenchmarkResult run(const char *name, AudioEncoder &encoder) {
+    return run(name, pcm.size(),
+               [&]() { encoder.write((uint8_t *)work.data(), size()); });
+  }
+
+  /// Processes the test block in place with the indicated function, which is
+  /// called with the data and the number of samples
+  AudioBenchmarkResult run(const char *name,
+                           void (*process)(int16_t *data, size_t samples)) {
+    return run(name, pcm.size(), [&]() { process(work.data(), work.size()); });
+  }
+
+  /// Decodes the encoded data: the real time budget is determined from the
+  /// decoded samples
+  AudioBenchmarkResult run(const char *name, AudioDecoder &decoder,
+                           const uint8_t *encoded, size_t len) {
+    SampleCounter counter;
+    AudioInfo format = info;
+    auto decode = [&]() {
+      counter.samples = 0;
+      decoder.setOutput(counter);
+      decoder.begin();
+      for (size_t pos = 0; pos < len; pos += 1024) {
+        decoder.write(encoded + pos, min((size_t)1024, len - pos));
+      }
+      decoder.end();
+    };
+    decode();
+    AudioInfo decoded = decoder.audioInfo();
+    if (decoded.sample_rate > 0 && decoded.channels > 0) format = decoded;
+    return run(name, counter.samples, decode, format);
+  }
+
+  /// Measures the indicated function which processes the indicated number of
+  /// samples: the test block is restored before each run
+  template <class F>
+  AudioBenchmarkResult run(const char *name, size_t samples, F fn) {
+    return run(name, samples, fn, info);
+  }
+
+  /// Measures the function for samples in the indicated format
+  template <class F>
+  AudioBenchmarkResult run(const char *name, size_t samples, F fn,
+                           AudioInfo format) {
+    AudioBenchmarkResult result;
+    result.name = name;
+    result.samples = samples;
+    if (format.sample_rate > 0 && format.channels > 0) {
+      result.audio_us = 1000000.0f * samples / format.channels /
+                        format.sample_rate;
+    }
+    // warm up: caches and lazy allocations
+    restore();
+    fn();
+    int heap_start = freeHeap();
+    int heap_min = heap_start;
+    int min_before = minFreeHeap();
+    for (int j = 0; j < runs; j++) {
+      restore();
+      uint32_t start = ProfilerClock::ticks();
+      fn();
+      uint32_t ticks = ProfilerClock::ticks() - start;
+      result.total_ticks += ticks;
+      if (j == 0 || ticks < result.min_ticks) result.min_ticks = ticks;
+      if (ticks > result.max_ticks) result.max_ticks = ticks;
+      int heap = freeHeap();
+      if (heap < heap_min) heap_min = heap;
+    }
+    // a lower minimum of the platform reveals the temporary allocations
+    int min_after = minFreeHeap();
+    if (min_after < min_before && min_after < heap_min) heap_min = min_after;
+    result.runs = runs;
+    result.heap_used = heap_start - heap_min;
+    result.stack_free = freeStack();
+    report(result);
+    return result;
+  }
+
+  /// Prints the result
+  void report(AudioBenchmarkResult &r) {
+    char msg[200];
+    snprintf(msg, sizeof(msg),
+             "%s: %.2f cycles/sample, avg=%.1fus min=%.1fus max=%.1fus "
+             "budget=%.1f%% heap=%d stack_free=%d",
+             r.name, r.cyclesPerSample(), r.avgUs(),
+             (float)r.min_ticks / ProfilerClock::ticksPerUs(),
+             (float)r.max_ticks / ProfilerClock::ticksPerUs(),
+             r.budgetPercent(), r.heap_used, r.stack_free);
+    if (p_logout != nullptr) {
+      p_logout->println(msg);
+    } else {
+      LOGI("%s", msg);
+    }
+  }
+
+  /// Free heap in bytes: -1 if not supported
+  static int freeHeap() {
+#if defined(ESP32) && defined(ARDUINO)
+    return ESP.getFreeHeap();
+#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
+    return rp2040.getFreeHeap();
+#else
+    return -1;
+#endif
+  }
+
+  /// Smallest free heap since the system start in bytes: -1 if not supported
+  static int minFreeHeap() {
+#if defined(ESP32) && defined(ARDUINO)
+    return ESP.getMinFreeHeap();
+#else
+    return freeHeap();
+#endif
+  }
+
+  /// High water mark of the stack of the actual task: -1 if not supported
+  static int freeStack() {
+#if defined(ESP32)
+    return uxTaskGetStackHighWaterMark(NULL);
+#else
+    return -1;
+#endif
+  }
+
+ protected:
+  AudioInfo info;
+  int frames = 512;
+  int runs = 20;
+  Vector<int16_t> pcm{0};
+  Vector<int16_t> work{0};
+  Print *p_logout = nullptr;
+
+  /// Counts the decoded samples
+  struct SampleCounter : public AudioOutput {
+    size_t samples = 0;
+    size_t write(const uint8_t *data, size_t len) override {
+      samples += len / sizeof(int16_t);
+      return len;
+    }
+  };
+
+  void restore() { memcpy(work.data(), pcm.data(), size()); }
+};
+
+}  // namespace audio_tools
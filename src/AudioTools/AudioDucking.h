@@ -0,0 +1,344 @@
+#pragma once
+#include <math.h>
+
+#include "AudioTools/AudioKernels.h"
+#include "AudioTools/AudioStreams.h"
+#include "AudioTools/AudioTypes.h"
+
+/// Number of frames which are processed with the same gain
+#ifndef DUCKING_BLOCK_FRAMES
+#  define DUCKING_BLOCK_FRAMES 32
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Config for DuckingStream
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct DuckingConfig : public AudioInfo {
+  DuckingConfig() {
+    bits_per_sample = 16;
+    channels = 2;
+    sample_rate = 44100;
+  }
+  /// false: ducking controlled by the sidechain; true: automatic gain control
+  /// based on the level of the processed signal
+  bool agc = false;
+  /// sidechain level (0.0 to 1.0) above which we duck
+  float threshold = 0.05f;
+  /// gain which is applied when ducked
+  float duck_gain = 0.25f;
+  /// agc: target level (0.0 to 1.0)
+  float agc_level = 0.5f;
+  /// agc: gain limits
+  float min_gain = 0.1f;
+  float max_gain = 4.0f;
+  /// attack and release time of the envelope follower
+  int envelope_attack_ms = 5;
+  int envelope_release_ms = 200;
+  /// time to reach the lower gain
+  int attack_ms = 20;
+  /// time to recover the higher gain
+  int release_ms = 500;
+};
+
+/**
+ * @brief Envelope follower: the peak of each block is smoothed with separate
+ * attack and release coefficients. The level is in the range of 0.0 to 1.0.
+ * @ingroup volume
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class EnvelopeFollower {
+ public:
+  /// Defines the attack and release time for blocks of the indicated frames
+  void begin(int sampleRate, int blockFrames, int attackMs, int releaseMs) {
+    attack = coefficient(sampleRate, blockFrames, attackMs);
+    release = coefficient(sampleRate, blockFrames, releaseMs);
+    level = 0.0f;
+  }
+
+  /// Updates the level with the peak of the block
+  float update(float peak) {
+    level += (peak - level) * (peak > level ? attack : release);
+    return level;
+  }
+
+  float value() { return level; }
+
+  /// Determines the normalized peak (0.0 to 1.0) of the samples with the
+  /// shared peak kernel
+  template <typename T>
+  static float peak(const T *data, size_t samples) {
+    int32_t result = 0;
+    int64_t sum = 0;
+    AudioKernels::peakSumSquares(data, samples, 1, &result, &sum);
+    return result / (float)NumberConverter::maxValueT<T>();
+  }
+
+  /// Determines the smoothing coefficient for a time constant in ms
+  static float coefficient(int sampleRate, int blockFrames, int ms) {
+    if (ms <= 0 || sampleRate <= 0) return 1.0f;
+    return 1.0f - expf(-1000.0f * blockFrames / (ms * (float)sampleRate));
+  }
+
+ protected:
+  float attack = 1.0f;
+  float release = 1.0f;
+  float level = 0.0f;
+};
+
+class DuckingStream;
+
+/**
+ * @brief Pass through stream for the sidechain signal (e.g. announcements)
+ * of a DuckingStream: it measures the level of the data which is read or
+ * written. Add it to an InputMixer or write to an OutputMixer before the
+ * ducked signal, so that the level is up to date.
+ * @ingroup volume
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SidechainStream : public ModifyingStream {
+ public:
+  SidechainStream() = default;
+
+  /// Defines/Changes the input & output
+  void setStream(Stream &in) override {
+    p_in = &in;
+    p_out = &in;
+  }
+
+  /// Defines/Changes the output target
+  void setOutput(Print &out) override { p_out = &out; }
+
+  /// Defines the format of the sidechain signal
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    envelope.begin(info.sample_rate, DUCKING_BLOCK_FRAMES, attack_ms,
+                   release_ms);
+    return true;
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_in == nullptr) return 0;
+    size_t result = p_in->readBytes(data, len);
+    measure(data, result);
+    return result;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    measure(data, len);
+    // w/o output we just measure
+    if (p_out == nullptr) return len;
+    return p_out->write(data, len);
+  }
+
+  int available() override { return p_in == nullptr ? 0 : p_in->available(); }
+
+  int availableForWrite() override {
+    return p_out == nullptr ? DEFAULT_BUFFER_SIZE : p_out->availableForWrite();
+  }
+
+  /// Actual smoothed level (0.0 to 1.0)
+  float level() { return envelope.value(); }
+
+  /// Defines the level explicitly (e.g. if it is calculated elsewhere)
+  void setLevel(float level) { envelope.update(level); }
+
+ protected:
+  friend class DuckingStream;
+  Stream *p_in = nullptr;
+  Print *p_out = nullptr;
+  EnvelopeFollower envelope;
+  int attack_ms = 5;
+  int release_ms = 200;
+
+  void measure(const uint8_t *data, size_t len) {
+    switch (info.bits_per_sample) {
+      case 16:
+        measureT((const int16_t *)data, len / sizeof(int16_t));
+        break;
+      case 24:
+        measureT((const int24_t *)data, len / sizeof(int24_t));
+        break;
+      case 32:
+        measureT((const int32_t *)data, len / sizeof(int32_t));
+        break;
+    }
+  }
+
+  /// updates the envelope with the peak of each block
+  template <typename T>
+  void measureT(const T *data, size_t samples) {
+    size_t block = DUCKING_BLOCK_FRAMES * info.channels;
+    for (size_t pos = 0; pos < samples; pos += block) {
+      size_t n = min(block, samples - pos);
+      envelope.update(EnvelopeFollower::peak(data + pos, n));
+    }
+  }
+};
+
+/**
+ * @brief Ducking and automatic gain control: the gain of the processed signal
+ * (e.g. the background music) is lowered when the level of the sidechain
+ * signal (e.g. an announcement) is above the threshold. With the agc option
+ * the gain is determined from the level of the processed signal itself.
+ * The gain is smoothed with the attack and release times, updated for each
+ * block of DUCKING_BLOCK_FRAMES frames and applied with the same gain kernel
+ * as in the VolumeStream.
+ * @ingroup volume
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class DuckingStream : public ModifyingStream {
+ public:
+  DuckingStream() = default;
+  DuckingStream(Stream &in) { setStream(in); }
+  DuckingStream(Print &out) { setOutput(out); }
+
+  /// Defines/Changes the input & output
+  void setStream(Stream &in) override {
+    p_in = &in;
+    p_out = &in;
+  }
+
+  /// Defines/Changes the output target
+  void setOutput(Print &out) override { p_out = &out; }
+
+  DuckingConfig defaultConfig() {
+    DuckingConfig cfg;
+    return cfg;
+  }
+
+  bool begin(DuckingConfig cfg) {
+    this->cfg = cfg;
+    setAudioInfo(cfg);
+    return begin();
+  }
+
+  bool begin() override {
+    cfg.copyFrom(info);
+    // by default the sidechain has the same format
+    if (!sidechain_info_defined) sidechain.setAudioInfo(info);
+    sidechain.attack_ms = cfg.envelope_attack_ms;
+    sidechain.release_ms = cfg.envelope_release_ms;
+    sidechain.begin();
+    own_envelope.begin(info.sample_rate, DUCKING_BLOCK_FRAMES,
+                       cfg.envelope_attack_ms, cfg.envelope_release_ms);
+    attack = EnvelopeFollower::coefficient(info.sample_rate,
+                                           DUCKING_BLOCK_FRAMES, cfg.attack_ms);
+    release = EnvelopeFollower::coefficient(
+        info.sample_rate, DUCKING_BLOCK_FRAMES, cfg.release_ms);
+    gain = 1.0f;
+    gains.resize(info.channels);
+    return true;
+  }
+
+  /// Provides the sidechain which measures the level of the controlling signal
+  SidechainStream &sidechainStream() { return sidechain; }
+
+  /// Defines the audio format of the sidechain if it is different
+  void setSidechainAudioInfo(AudioInfo info) {
+    sidechain_info_defined = true;
+    sidechain.setAudioInfo(info);
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_in == nullptr) return 0;
+    size_t result = p_in->readBytes(data, len);
+    process(data, result);
+    return result;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_out == nullptr) return 0;
+    process((uint8_t *)data, len);
+    return p_out->write(data, len);
+  }
+
+  int available() override { return p_in == nullptr ? 0 : p_in->available(); }
+
+  int availableForWrite() override {
+    return p_out == nullptr ? 0 : p_out->availableForWrite();
+  }
+
+  /// Actual gain which is applied
+  float currentGain() { return gain; }
+
+ protected:
+  DuckingConfig cfg;
+  Stream *p_in = nullptr;
+  Print *p_out = nullptr;
+  SidechainStream sidechain;
+  EnvelopeFollower own_envelope;
+  bool sidechain_info_defined = false;
+  Vector<int32_t> gains{0};
+  float gain = 1.0f;
+  float attack = 1.0f;
+  float release = 1.0f;
+
+  void process(uint8_t *data, size_t len) {
+    if (gains.size() < info.channels) return;
+    switch (info.bits_per_sample) {
+      case 16:
+        processT((int16_t *)data, len / sizeof(int16_t));
+        break;
+      case 24:
+        processT((int24_t *)data, len / sizeof(int24_t));
+        break;
+      case 32:
+        processT((int32_t *)data, len / sizeof(int32_t));
+        break;
+      default:
+        LOGE("Unsupported bits_per_sample: %d", info.bits_per_sample);
+    }
+  }
+
+  template <typename T>
+  void processT(T *data, size_t samples) {
+    size_t block = DUCKING_BLOCK_FRAMES * info.channels;
+    for (size_t pos = 0; pos < samples; pos += block) {
+      size_t n = min(block, samples - pos);
+      T *p_block = data + pos;
+      if (cfg.agc) {
+        own_envelope.update(EnvelopeFollower::peak(p_block, n));
+      }
+      updateGain(targetGain());
+      // skip the multiplication at unity gain
+      if (gains[0] == GAIN_Q16_ONE) continue;
+      AudioKernels::applyGain(p_block, n, info.channels, gains.data());
+    }
+  }
+
+  /// Determines the gain which we want to reach
+  float targetGain() {
+    if (!cfg.agc) {
+      return sidechain.level() > cfg.threshold ? cfg.duck_gain : 1.0f;
+    }
+    float level = own_envelope.value();
+    if (level <= 0.0f) return cfg.max_gain;
+    float result = cfg.agc_level / level;
+    if (result < cfg.min_gain) result = cfg.min_gain;
+    if (result > cfg.max_gain) result = cfg.max_gain;
+    return result;
+  }
+
+  /// Moves the gain towards the target: lower gains use the attack time
+  void updateGain(float target) {
+    gain += (target - gain) * (target < gain ? attack : release);
+    // snap to the target to get back to the unity gain
+    if (fabsf(target - gain) < 0.0001f) gain = target;
+    int32_t gain_q16 = AudioKernels::toGainQ16(gain);
+    for (int ch = 0; ch < info.channels; ch++) gains[ch] = gain_q16;
+  }
+};
+
+}  // namespace audio_tools
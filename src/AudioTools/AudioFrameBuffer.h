@@ -0,0 +1,104 @@
+#pragma once
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioKernels.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Planar (deinterleaved) audio frames: the samples of each channel are
+ * stored in a separate contiguous array, so that per channel processing
+ * (filters, equalizers, FFT) can use sequential access. The data is
+ * converted from and to the interleaved format of the streams with
+ * fromInterleaved() and toInterleaved() using the AudioKernels. The sample
+ * values are assigned without any scaling.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T>
+class AudioFrameBuffer {
+ public:
+  AudioFrameBuffer() = default;
+
+  AudioFrameBuffer(int channels, int frames) { resize(channels, frames); }
+
+  /// Defines the number of channels and the capacity in frames
+  void resize(int channels, int frames) {
+    channel_count = channels;
+    max_frames = frames;
+    if (frame_count > frames) frame_count = frames;
+    data_vector.resize(channels * frames);
+  }
+
+  /// Number of channels
+  int channels() { return channel_count; }
+
+  /// Number of valid frames
+  int frames() { return frame_count; }
+
+  /// Max number of frames
+  int capacity() { return max_frames; }
+
+  /// Defines the number of valid frames (max capacity)
+  void setFrames(int frames) {
+    frame_count = frames > max_frames ? max_frames : frames;
+  }
+
+  /// Provides the samples of the indicated channel
+  T *channel(int ch) { return data_vector.data() + ch * max_frames; }
+
+  /// Deinterleaves the indicated frames into the buffer: returns the number
+  /// of frames which were stored
+  template <typename TS>
+  int fromInterleaved(const TS *src, int frames) {
+    setFrames(frames);
+    AudioKernels::deinterleave(src, channel(0), max_frames, channel_count,
+                               frame_count);
+    return frame_count;
+  }
+
+  /// Interleaves the valid frames into the indicated array: returns the
+  /// number of frames
+  template <typename TD>
+  int toInterleaved(TD *dst) {
+    AudioKernels::interleave(channel(0), max_frames, dst, channel_count,
+                             frame_count);
+    return frame_count;
+  }
+
+  /// Interleaves only the indicated channel into the indicated array
+  template <typename TD>
+  void toInterleaved(TD *dst, int ch) {
+    const T *in = channel(ch);
+    TD *out = dst + ch;
+    for (int j = 0; j < frame_count; j++) {
+      *out = in[j];
+      out += channel_count;
+    }
+  }
+
+ protected:
+  Vector<T> data_vector{0};
+  int channel_count = 0;
+  int max_frames = 0;
+  int frame_count = 0;
+};
+
+/**
+ * @brief Processing step which works on planar frames: adjacent steps in a
+ * PlanarStream exchange the AudioFrameBuffer directly without converting the
+ * data back to the interleaved format.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T>
+class PlanarProcessor {
+ public:
+  virtual ~PlanarProcessor() = default;
+  /// Processes the frames in place
+  virtual void process(AudioFrameBuffer<T> &frames) = 0;
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,546 @@
+#pragma once
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioStreams.h"
+#if defined(ESP32) || defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || \
+    defined(USE_STD_CONCURRENCY)
+#  include "Concurrency/WorkerPool.h"
+#  define USE_AUDIO_GRAPH_WORKERS
+#endif
+
+/// Number of frames which are processed by each node in one step
+#ifndef AUDIO_GRAPH_BLOCK_FRAMES
+#  define AUDIO_GRAPH_BLOCK_FRAMES 256
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Node of an AudioGraph: the node has a fixed number of input and
+ * output ports and each port is typed by its number of channels. The data
+ * of a port is provided as interleaved float block of frames * channels
+ * samples. process() must write all output ports: it must not keep any
+ * pointers because the buffers are shared with other nodes.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioGraphNode {
+ public:
+  virtual ~AudioGraphNode() = default;
+  /// Number of input ports
+  virtual int inputCount() = 0;
+  /// Number of output ports
+  virtual int outputCount() = 0;
+  /// Number of channels of the indicated input port
+  virtual int inputChannels(int port) = 0;
+  /// Number of channels of the indicated output port
+  virtual int outputChannels(int port) = 0;
+  /// Called by AudioGraph::begin()
+  virtual bool begin() { return true; }
+  /// Processes one block: in and out contain one buffer per port
+  virtual void process(const float *const *in, float *const *out,
+                       int frames) = 0;
+};
+
+/**
+ * @brief Source node which reads 16 or 32 bit PCM data from a Stream:
+ * missing data is replaced by silence.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioGraphSource : public AudioGraphNode {
+ public:
+  AudioGraphSource() = default;
+  AudioGraphSource(Stream &in, AudioInfo info) { setStream(in, info); }
+
+  void setStream(Stream &in, AudioInfo info) {
+    p_stream = &in;
+    this->info = info;
+  }
+
+  int inputCount() override { return 0; }
+  int outputCount() override { return 1; }
+  int inputChannels(int port) override { return 0; }
+  int outputChannels(int port) override { return info.channels; }
+
+  bool begin() override {
+    if (p_stream == nullptr ||
+        (info.bits_per_sample != 16 && info.bits_per_sample != 32)) {
+      LOGE("Stream not defined or unsupported bits_per_sample: %d",
+           info.bits_per_sample);
+      return false;
+    }
+    return true;
+  }
+
+  void process(const float *const *in, float *const *out,
+               int frames) override {
+    int samples = frames * info.channels;
+    int sample_size = info.bits_per_sample / 8;
+    buffer.resize(samples * sample_size);
+    int len = p_stream->readBytes(buffer.data(), samples * sample_size);
+    int read = len / sample_size;
+    float *to = out[0];
+    if (info.bits_per_sample == 16) {
+      int16_t *data = (int16_t *)buffer.data();
+      for (int j = 0; j < read; j++) to[j] = data[j] / 32768.0f;
+    } else {
+      int32_t *data = (int32_t *)buffer.data();
+      for (int j = 0; j < read; j++) to[j] = data[j] / 2147483648.0f;
+    }
+    for (int j = read; j < samples; j++) to[j] = 0.0f;
+  }
+
+ protected:
+  Stream *p_stream = nullptr;
+  AudioInfo info;
+  Vector<uint8_t> buffer{0};
+};
+
+/**
+ * @brief Node which multiplies its input with a gain
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioGraphGain : public AudioGraphNode {
+ public:
+  AudioGraphGain(int channels, float gain = 1.0f) {
+    this->channels = channels;
+    this->gain = gain;
+  }
+
+  void setGain(float gain) { this->gain = gain; }
+
+  int inputCount() override { return 1; }
+  int outputCount() override { return 1; }
+  int inputChannels(int port) override { return channels; }
+  int outputChannels(int port) override { return channels; }
+
+  void process(const float *const *in, float *const *out,
+               int frames) override {
+    float g = gain;
+    for (int j = 0; j < frames * channels; j++) out[0][j] = in[0][j] * g;
+  }
+
+ protected:
+  int channels;
+  float gain;
+};
+
+/**
+ * @brief Node which sums up the indicated number of inputs
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioGraphMix : public AudioGraphNode {
+ public:
+  AudioGraphMix(int inputs, int channels) {
+    input_count = inputs;
+    this->channels = channels;
+  }
+
+  int inputCount() override { return input_count; }
+  int outputCount() override { return 1; }
+  int inputChannels(int port) override { return channels; }
+  int outputChannels(int port) override { return channels; }
+
+  void process(const float *const *in, float *const *out,
+               int frames) override {
+    int samples = frames * channels;
+    float *to = out[0];
+    memcpy(to, in[0], samples * sizeof(float));
+    for (int i = 1; i < input_count; i++) {
+      const float *from = in[i];
+      for (int j = 0; j < samples; j++) to[j] += from[j];
+    }
+  }
+
+ protected:
+  int input_count;
+  int channels;
+};
+
+/**
+ * @brief Audio processing graph: in contrast to the linear Pipeline the nodes
+ * can be connected as directed acyclic graph (e.g. splitting into multiple
+ * branches which are mixed again). The graph is pull based: each readBytes()
+ * processes all nodes block by block in topological order and provides the
+ * result of the output port as PCM data.
+ *
+ * The schedule is determined in begin(): we sort the nodes topologically and
+ * determine the lifetime of each output port (from the producing to the last
+ * consuming step). The block buffers are taken from a pool and returned as
+ * soon as their last consumer has been processed, so that the number of
+ * buffers is bounded by the width of the graph and not by the number of
+ * nodes.
+ *
+ * With setWorkerPool() the independent nodes of the same topological level
+ * are processed in parallel: in this case the lifetimes are determined per
+ * level, so that a buffer is never reused within the same level.
+ * @code
+ * AudioGraph graph;
+ * int src = graph.add(source);
+ * int low = graph.add(lowpass);
+ * int high = graph.add(highpass);
+ * int mix = graph.add(mixer);
+ * graph.connect(src, 0, low, 0);
+ * graph.connect(src, 0, high, 0);
+ * graph.connect(low, 0, mix, 0);
+ * graph.connect(high, 0, mix, 1);
+ * graph.setOutput(mix, 0);
+ * graph.begin(info);
+ * @endcode
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioGraph : public AudioStream {
+ public:
+  AudioGraph() = default;
+  ~AudioGraph() { end(); }
+
+  /// Adds a node and returns its id
+  int add(AudioGraphNode &node) {
+    Node entry;
+    entry.p_node = &node;
+    for (int j = 0; j < node.inputCount(); j++) entry.inputs.push_back(Link());
+    nodes.push_back(entry);
+    return nodes.size() - 1;
+  }
+
+  /// Connects the output port of a node with the input port of another node:
+  /// each input can only have one source but outputs can be used multiple
+  /// times. Unconnected inputs are silent.
+  bool connect(int from, int fromPort, int to, int toPort) {
+    if (!isValid(from) || !isValid(to) || fromPort < 0 ||
+        fromPort >= nodes[from].p_node->outputCount() || toPort < 0 ||
+        toPort >= nodes[to].p_node->inputCount()) {
+      LOGE("Invalid connection %d:%d -> %d:%d", from, fromPort, to, toPort);
+      return false;
+    }
+    int channels = nodes[from].p_node->outputChannels(fromPort);
+    if (channels != nodes[to].p_node->inputChannels(toPort)) {
+      LOGE("Channels do not match: %d -> %d", channels,
+           nodes[to].p_node->inputChannels(toPort));
+      return false;
+    }
+    nodes[to].inputs[toPort].node = from;
+    nodes[to].inputs[toPort].port = fromPort;
+    return true;
+  }
+
+  /// Defines the output port which provides the result
+  bool setOutput(int node, int port) {
+    if (!isValid(node) || port < 0 || port >= nodes[node].p_node->outputCount())
+      return false;
+    output.node = node;
+    output.port = port;
+    return true;
+  }
+
+#ifdef USE_AUDIO_GRAPH_WORKERS
+  /// Processes the independent nodes of each level in parallel
+  void setWorkerPool(WorkerPool &pool) { p_pool = &pool; }
+#endif
+
+  /// Defines the number of frames which are processed in one step
+  void setBlockFrames(int frames) { block_frames = frames; }
+
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    TRACEI();
+    if (output.node < 0) {
+      LOGE("Output not defined");
+      return false;
+    }
+    if (info.bits_per_sample != 16 && info.bits_per_sample != 32) {
+      LOGE("Unsupported bits_per_sample: %d", info.bits_per_sample);
+      return false;
+    }
+    if (nodes[output.node].p_node->outputChannels(output.port) !=
+        info.channels) {
+      LOGE("Channels of output port do not match: %d", info.channels);
+      return false;
+    }
+    for (auto &node : nodes) {
+      if (!node.p_node->begin()) return false;
+    }
+    if (!sortNodes()) return false;
+    allocateBuffers();
+    output_pos = output_len = 0;
+    is_active = true;
+    return true;
+  }
+
+  void end() override {
+    is_active = false;
+    for (auto p_buffer : buffers) delete p_buffer;
+    buffers.clear();
+#ifdef USE_AUDIO_GRAPH_WORKERS
+    for (auto p_future : futures) delete p_future;
+    futures.clear();
+#endif
+  }
+
+  /// Processes the graph and provides the result as PCM data
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (!is_active) return 0;
+    int sample_size = info.bits_per_sample / 8;
+    int samples = len / sample_size / info.channels * info.channels;
+    int pos = 0;
+    while (pos < samples) {
+      if (output_pos >= output_len) {
+        processBlock();
+        output_pos = 0;
+        output_len = block_frames * info.channels;
+      }
+      int n = min(samples - pos, output_len - output_pos);
+      const float *from = p_output + output_pos;
+      if (info.bits_per_sample == 16) {
+        writeSamples<int16_t>(from, (int16_t *)data + pos, n);
+      } else {
+        writeSamples<int32_t>(from, (int32_t *)data + pos, n);
+      }
+      pos += n;
+      output_pos += n;
+    }
+    return samples * sample_size;
+  }
+
+  int available() override { return is_active ? DEFAULT_BUFFER_SIZE : 0; }
+
+  /// Processes one block of all nodes
+  void processBlock() {
+    int start = 0;
+    while (start < (int)order.size()) {
+      int end = start;
+      while (end < (int)order.size() &&
+             nodes[order[end]].step == nodes[order[start]].step)
+        end++;
+      processStep(start, end);
+      start = end;
+    }
+  }
+
+  /// Number of allocated block buffers: bounded by the width of the graph
+  int bufferCount() { return buffers.size(); }
+
+  /// Number of nodes
+  int nodeCount() { return nodes.size(); }
+
+ protected:
+  struct Link {
+    int node = -1;
+    int port = 0;
+  };
+  struct Node {
+    AudioGraphNode *p_node = nullptr;
+    Vector<Link> inputs{0};
+    Vector<const float *> in{0};
+    Vector<float *> out{0};
+    Vector<int> out_buffer{0};
+    Vector<int> last_use{0};
+    int level = 0;
+    int step = 0;
+#ifdef USE_AUDIO_GRAPH_WORKERS
+    WorkerFuture *p_future = nullptr;
+#endif
+  };
+  Vector<Node> nodes{0};
+  Vector<int> order{0};
+  Vector<Vector<float> *> buffers{0};
+  Vector<float> silence{0};
+  Link output;
+  const float *p_output = nullptr;
+  int block_frames = AUDIO_GRAPH_BLOCK_FRAMES;
+  int output_pos = 0;
+  int output_len = 0;
+  bool is_active = false;
+#ifdef USE_AUDIO_GRAPH_WORKERS
+  WorkerPool *p_pool = nullptr;
+  Vector<WorkerFuture *> futures{0};
+#endif
+
+  bool isValid(int node) { return node >= 0 && node < (int)nodes.size(); }
+
+  /// Kahn's algorithm: determines the order and the level of each node
+  bool sortNodes() {
+    int n = nodes.size();
+    Vector<int> pending(n);
+    pending.resize(n);
+    order.clear();
+    for (int j = 0; j < n; j++) {
+      pending[j] = 0;
+      nodes[j].level = 0;
+      for (auto &link : nodes[j].inputs)
+        if (link.node >= 0) pending[j]++;
+      if (pending[j] == 0) order.push_back(j);
+    }
+    for (int i = 0; i < (int)order.size(); i++) {
+      int id = order[i];
+      for (int j = 0; j < n; j++) {
+        for (auto &link : nodes[j].inputs) {
+          if (link.node != id) continue;
+          nodes[j].level = max(nodes[j].level, nodes[id].level + 1);
+          if (--pending[j] == 0) order.push_back(j);
+        }
+      }
+    }
+    if ((int)order.size() != n) {
+      LOGE("The graph contains a cycle");
+      return false;
+    }
+    // sort by level (stable), so that each level is contiguous
+    for (int i = 1; i < n; i++) {
+      int id = order[i];
+      int j = i - 1;
+      while (j >= 0 && nodes[order[j]].level > nodes[id].level) {
+        order[j + 1] = order[j];
+        j--;
+      }
+      order[j + 1] = id;
+    }
+    for (int i = 0; i < n; i++) {
+      nodes[order[i]].step = isParallel() ? nodes[order[i]].level : i;
+    }
+    return true;
+  }
+
+  /// Liveness analysis: assigns the pool buffers to the output ports
+  void allocateBuffers() {
+    end();
+    int max_channels = 1;
+    for (auto &node : nodes) {
+      int outputs = node.p_node->outputCount();
+      node.out_buffer.resize(outputs);
+      node.last_use.resize(outputs);
+      for (int p = 0; p < outputs; p++) {
+        max_channels = max(max_channels, node.p_node->outputChannels(p));
+        node.last_use[p] = node.step;
+      }
+    }
+    for (auto &node : nodes) {
+      for (auto &link : node.inputs) {
+        if (link.node < 0) continue;
+        int &last = nodes[link.node].last_use[link.port];
+        last = max(last, node.step);
+      }
+    }
+    // the output must be valid until the next block
+    nodes[output.node].last_use[output.port] = INT32_MAX;
+
+    int block_size = block_frames * max_channels;
+    Vector<int> free_buffers{0};
+    int start = 0;
+    while (start < (int)order.size()) {
+      int step = nodes[order[start]].step;
+      int end = start;
+      // allocate all outputs of the step
+      for (; end < (int)order.size() && nodes[order[end]].step == step; end++) {
+        Node &node = nodes[order[end]];
+        for (int p = 0; p < node.p_node->outputCount(); p++) {
+          if (free_buffers.empty()) {
+            Vector<float> *p_buffer = new Vector<float>(block_size);
+            p_buffer->resize(block_size);
+            free_buffers.push_back(buffers.size());
+            buffers.push_back(p_buffer);
+          }
+          node.out_buffer[p] = free_buffers[free_buffers.size() - 1];
+          free_buffers.pop_back();
+        }
+      }
+      // release the buffers which are not used after this step
+      for (auto &node : nodes) {
+        for (int p = 0; p < node.p_node->outputCount(); p++) {
+          if (node.step <= step && node.last_use[p] == step)
+            free_buffers.push_back(node.out_buffer[p]);
+        }
+      }
+      start = end;
+    }
+
+    // resolve the buffer pointers
+    silence.resize(block_size);
+    memset(silence.data(), 0, block_size * sizeof(float));
+    for (auto &node : nodes) {
+      node.out.resize(node.out_buffer.size());
+      for (int p = 0; p < (int)node.out_buffer.size(); p++)
+        node.out[p] = buffers[node.out_buffer[p]]->data();
+    }
+    for (auto &node : nodes) {
+      node.in.resize(node.inputs.size());
+      for (int p = 0; p < (int)node.inputs.size(); p++) {
+        Link &link = node.inputs[p];
+        node.in[p] = link.node < 0 ? silence.data()
+                                   : nodes[link.node].out[link.port];
+      }
+    }
+    p_output = nodes[output.node].out[output.port];
+
+#ifdef USE_AUDIO_GRAPH_WORKERS
+    if (isParallel()) {
+      for (auto &node : nodes) {
+        node.p_future = new WorkerFuture();
+        futures.push_back(node.p_future);
+      }
+    }
+#endif
+  }
+
+  bool isParallel() {
+#ifdef USE_AUDIO_GRAPH_WORKERS
+    return p_pool != nullptr;
+#else
+    return false;
+#endif
+  }
+
+  /// Processes the nodes of one step: the nodes are independent
+  void processStep(int start, int end) {
+#ifdef USE_AUDIO_GRAPH_WORKERS
+    if (isParallel() && end - start > 1) {
+      // submit all but the last node which we process ourself
+      for (int j = start; j < end - 1; j++) {
+        Node *p_node = &nodes[order[j]];
+        if (!p_pool->submit([this, p_node]() { processNode(*p_node); },
+                            p_node->p_future)) {
+          processNode(*p_node);
+        }
+      }
+      processNode(nodes[order[end - 1]]);
+      for (int j = start; j < end - 1; j++) nodes[order[j]].p_future->wait();
+      return;
+    }
+#endif
+    for (int j = start; j < end; j++) processNode(nodes[order[j]]);
+  }
+
+  void processNode(Node &node) {
+    node.p_node->process(node.in.data(), node.out.data(), block_frames);
+  }
+
+  template <typename T>
+  static void writeSamples(const float *from, T *to, int samples) {
+    T max_value = NumberConverter::maxValueT<T>();
+    for (int j = 0; j < samples; j++) {
+      float value = from[j] * (float)max_value;
+      if (value >= (float)max_value) {
+        to[j] = max_value;
+      } else if (value <= -(float)max_value) {
+        to[j] = -max_value;
+      } else {
+        to[j] = value;
+      }
+    }
+  }
+};
+
+}  // namespace audio_tools
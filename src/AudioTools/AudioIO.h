@@ -1,13 +1,20 @@
 #pragma once
 #include "AudioTools/AudioOutput.h"
 #include "AudioTools/AudioStreams.h"
+#include "AudioCodecs/SeekIndex.h"
+#if USE_ASYNC_OUTPUT
+#  include "AudioTools/AsyncOutputQueue.h"
+#endif
+#if USE_ASYNC_OUTPUT && defined(USE_CONCURRENCY)
+#  include "Concurrency/Task.h"
+#endif
 
 #ifndef MAX_ZERO_READ_COUNT
 #  define MAX_ZERO_READ_COUNT 3
 #endif
 
-#ifndef CHANNEL_SELECT_BUFFER_SIZE
-#  define CHANNEL_SELECT_BUFFER_SIZE 256
+#ifndef MULTI_OUTPUT_DRAIN_SIZE
+#  define MULTI_OUTPUT_DRAIN_SIZE 512
 #endif
 
 
@@ -39,6 +46,11 @@ class TransformationReader {
       LOGE("p_stream is NULL");
       active = false;
     }
+    // in the fixed capacity mode we allocate all buffers here
+    if (active && max_block_size > 0) {
+      setupBuffers(max_block_size);
+    }
+    allocation_count = 0;
   }
 
   size_t readBytes(uint8_t *data, size_t len) {
@@ -52,21 +64,14 @@ class TransformationReader {
       return 0;
     }
 
-    // we read half the necessary bytes
-    if (buffer.size() == 0) {
-      int size = (0.5 / p_transform->getByteFactor() * len);
-      // process full samples/frames
-      size = size / 4 * 4;
-      LOGI("read size: %d", size);
-      buffer.resize(size);
+    // in the fixed capacity mode we provide max max_block_size bytes
+    if (max_block_size > 0 && len > (size_t)max_block_size) {
+      len = max_block_size;
     }
 
-    if (rb.size() == 0) {
-      // make sure that the ring buffer is big enough
-      int rb_size = len * byte_count_factor;
-      LOGI("buffer size: %d", rb_size);
-      rb.resize(rb_size);
-      result_queue.begin();
+    if (buffer.size() == 0 || rb.size() == 0) {
+      allocation_count++;
+      setupBuffers(len);
     }
 
     if (result_queue.available() < len) {
@@ -108,6 +113,13 @@ class TransformationReader {
 
   void setByteCountFactor(int f) { byte_count_factor = f; }
 
+  /// Activates the fixed capacity mode: the buffers are allocated in begin()
+  /// and bigger reads are limited to the indicated size
+  void setMaxBlockSize(int size) { max_block_size = size; }
+
+  /// Number of buffer allocations after begin()
+  int allocations() { return allocation_count; }
+
  protected:
   RingBuffer<uint8_t> rb{0};
   QueueStream<uint8_t> result_queue{rb};  //
@@ -116,6 +128,28 @@ class TransformationReader {
   T *p_transform = nullptr;
   bool active = false;
   int byte_count_factor = 3;
+  int max_block_size = 0;
+  int allocation_count = 0;
+
+  /// allocates the buffers for reads of max len bytes
+  void setupBuffers(size_t len) {
+    // we read half the necessary bytes
+    if (buffer.size() == 0) {
+      int size = (0.5 / p_transform->getByteFactor() * len);
+      // process full samples/frames
+      size = size / 4 * 4;
+      LOGI("read size: %d", size);
+      buffer.resize(size);
+    }
+
+    if (rb.size() == 0) {
+      // make sure that the ring buffer is big enough
+      int rb_size = len * byte_count_factor;
+      LOGI("buffer size: %d", rb_size);
+      rb.resize(rb_size);
+      result_queue.begin();
+    }
+  }
 
   /// Makes sure that the data  is written to the array
   /// @param data
@@ -190,12 +224,78 @@ class ReformatBaseStream : public ModifyingStream {
     reader.end();
   }
 
+  /// Activates the fixed capacity mode: all buffers are allocated in begin()
+  /// for the indicated max number of bytes per write() or readBytes() call.
+  /// Bigger requests are split into chunks instead of reallocating the
+  /// buffers. Call before begin()!
+  void setMaxBlockSize(int size) {
+    max_block_size = size;
+    reader.setMaxBlockSize(size);
+  }
+
+  /// Provides the max block size of the fixed capacity mode (0 = inactive)
+  int maxBlockSize() { return max_block_size; }
+
+  /// Number of buffer (re)allocations after begin(): this should stay 0 in
+  /// the fixed capacity mode
+  virtual int allocations() { return allocation_count + reader.allocations(); }
+
  protected:
   TransformationReader<ReformatBaseStream> reader;
   Stream *p_stream = nullptr;
   Print *p_print = nullptr;
   bool is_output_notify = false;
   AudioInfoSupport *p_notify_on_output = nullptr;
+  int max_block_size = 0;
+  int allocation_count = 0;
+
+  bool isFixedCapacity() { return max_block_size > 0; }
+
+  /// Max chunk size in the fixed capacity mode for the indicated frame size
+  size_t chunkSize(int frameSize) {
+    if (frameSize <= 0) return max_block_size;
+    size_t result = max_block_size / frameSize * frameSize;
+    return result > 0 ? result : frameSize;
+  }
+
+  /// Splits the write into chunks of max maxLen bytes
+  size_t writeChunks(const uint8_t *data, size_t len, size_t maxLen) {
+    size_t result = 0;
+    while (result < len) {
+      size_t chunk = min(len - result, maxLen);
+      size_t written = write(data + result, chunk);
+      if (written == 0) break;
+      result += written;
+    }
+    return result;
+  }
+
+  /// Splits the read into chunks of max maxLen bytes
+  size_t readChunks(uint8_t *data, size_t len, size_t maxLen) {
+    size_t result = 0;
+    while (result < len) {
+      size_t chunk = min(len - result, maxLen);
+      size_t read = readBytes(data + result, chunk);
+      result += read;
+      if (read < chunk) break;
+    }
+    return result;
+  }
+
+  /// Resizes the buffer and counts the reallocations
+  template <typename T>
+  void resizeBuffer(Vector<T> &buffer, int size) {
+    if (size > buffer.capacity()) allocation_count++;
+    buffer.resize(size);
+  }
+
+  /// The buffer only grows: counts the reallocations
+  template <typename T>
+  void resizeBuffer(SingleBuffer<T> &buffer, int size) {
+    if (size <= (int)buffer.size()) return;
+    allocation_count++;
+    buffer.resize(size);
+  }
 
   /// Define potential notification
   void setNotifyOnOutput(AudioInfoSupport &info) { p_notify_on_output = &info; }
@@ -296,7 +396,10 @@ class AdapterAudioOutputToAudioStream : public AudioStream {
 };
 
 /**
- * @brief Replicates the output to multiple destinations.
+ * @brief Replicates the output to multiple destinations. By default the
+ * outputs are written in turn. With setAsync() an output gets its own queue
+ * which is written by drain() or the drain task, so that the slowest output
+ * does not set the pace for the real time outputs.
  * @ingroup transform
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -333,6 +436,14 @@ class MultiOutput : public ModifyingOutput {
   }
 
   virtual ~MultiOutput() {
+#if USE_ASYNC_OUTPUT
+#  ifdef USE_CONCURRENCY
+    endDrainTask();
+#  endif
+    for (int j = 0; j < queues.size(); j++) {
+      delete queues[j];
+    }
+#endif
     for (int j = 0; j < vector.size(); j++) {
       if (vector[j]->isDeletable()) {
         delete vector[j];
@@ -341,20 +452,79 @@ class MultiOutput : public ModifyingOutput {
   }
 
   /// Add an additional AudioOutput output
-  void add(AudioOutput &out) { vector.push_back(&out); }
+  void add(AudioOutput &out) { addOutput(&out); }
 
   /// Add an AudioStream to the output
   void add(AudioStream &stream) {
     AdapterAudioStreamToAudioOutput *out =
         new AdapterAudioStreamToAudioOutput(stream);
-    vector.push_back(out);
+    addOutput(out);
   }
 
   void add(Print &print) {
     AdapterPrintToAudioOutput *out = new AdapterPrintToAudioOutput(print);
-    vector.push_back(out);
+    addOutput(out);
+  }
+
+#if USE_ASYNC_OUTPUT
+  /// Writes the output with the indicated index (in the sequence of the add()
+  /// calls) via a queue of bufferSize bytes, which is written by drain() or
+  /// the drain task, so that a slow output (e.g. a http client or a SD file)
+  /// does not delay the others (e.g. I2S). The policy defines what happens
+  /// when the output falls behind.
+  bool setAsync(int idx, int bufferSize,
+                AsyncOutputPolicy policy = AsyncOutputDropOldest) {
+    if (idx < 0 || idx >= vector.size() || bufferSize <= 0) return false;
+    delete queues[idx];
+    queues[idx] = new AsyncOutputQueue(bufferSize, policy);
+    return true;
+  }
+
+  /// Poll step: writes the queued data to the asynchronous outputs. Call it
+  /// from the loop or from a separate task.
+  void drain() {
+    for (int j = 0; j < vector.size(); j++) {
+      if (queues[j] != nullptr) drainOutput(j);
+    }
+  }
+
+  /// Number of bytes which were discarded for the indicated output
+  uint32_t droppedBytes(int idx) {
+    return queues[idx] == nullptr ? 0 : queues[idx]->droppedBytes();
+  }
+
+  /// Number of bytes which are queued for the indicated output
+  int lagBytes(int idx) {
+    return queues[idx] == nullptr ? 0 : queues[idx]->available();
+  }
+
+  /// Max number of bytes which were queued for the indicated output
+  int maxLagBytes(int idx) {
+    return queues[idx] == nullptr ? 0 : queues[idx]->maxLagBytes();
   }
 
+#  ifdef USE_CONCURRENCY
+  /// Starts a task which writes the queued data to the asynchronous outputs
+  bool beginDrainTask(int stackSize = 3 * 1024, int priority = 1,
+                      int core = -1) {
+    if (is_drain_task) return false;
+    drain_task.create("multi-output", stackSize, priority, core);
+    is_drain_task = true;
+    return drain_task.begin([this]() {
+      drain();
+      delay(1);
+    });
+  }
+
+  /// Stops the drain task
+  void endDrainTask() {
+    if (!is_drain_task) return;
+    drain_task.remove();
+    is_drain_task = false;
+  }
+#  endif
+#endif
+
   void flush() {
     for (int j = 0; j < vector.size(); j++) {
       vector[j]->flush();
@@ -369,6 +539,12 @@ class MultiOutput : public ModifyingOutput {
 
   size_t write(const uint8_t *data, size_t len) {
     for (int j = 0; j < vector.size(); j++) {
+#if USE_ASYNC_OUTPUT
+      if (queues[j] != nullptr) {
+        writeQueue(j, data, len);
+        continue;
+      }
+#endif
       int open = len;
       int start = 0;
       while (open > 0) {
@@ -382,6 +558,12 @@ class MultiOutput : public ModifyingOutput {
 
   size_t write(uint8_t ch) {
     for (int j = 0; j < vector.size(); j++) {
+#if USE_ASYNC_OUTPUT
+      if (queues[j] != nullptr) {
+        writeQueue(j, &ch, 1);
+        continue;
+      }
+#endif
       int open = 1;
       while (open > 0) {
         open -= vector[j]->write(ch);
@@ -392,8 +574,58 @@ class MultiOutput : public ModifyingOutput {
 
  protected:
   Vector<AudioOutput *> vector;
+#if USE_ASYNC_OUTPUT
+  Vector<AsyncOutputQueue *> queues;
+  uint8_t drain_buffer[MULTI_OUTPUT_DRAIN_SIZE];
+#  ifdef USE_CONCURRENCY
+  Task drain_task;
+  bool is_drain_task = false;
+#  endif
+#endif
   /// support for Pipleline
   void setOutput(Print &out) { add(out); }
+
+  void addOutput(AudioOutput *out) {
+    vector.push_back(out);
+#if USE_ASYNC_OUTPUT
+    queues.push_back(nullptr);
+#endif
+  }
+
+#if USE_ASYNC_OUTPUT
+  /// adds the data to the queue of the output
+  void writeQueue(int idx, const uint8_t *data, size_t len) {
+    AsyncOutputQueue &queue = *queues[idx];
+    int written = queue.write(data, len);
+    if (queue.getPolicy() != AsyncOutputBlock) return;
+    // wait for the drain task or write the output ourself
+    while (written < (int)len) {
+#  ifdef USE_CONCURRENCY
+      if (is_drain_task) {
+        delay(1);
+      } else {
+        drainOutput(idx);
+      }
+#  else
+      drainOutput(idx);
+#  endif
+      written += queue.write(data + written, len - written);
+    }
+  }
+
+  /// writes the queued data to the output
+  void drainOutput(int idx) {
+    AsyncOutputQueue &queue = *queues[idx];
+    int len = queue.read(drain_buffer, MULTI_OUTPUT_DRAIN_SIZE);
+    while (len > 0) {
+      int start = 0;
+      while (start < len) {
+        start += vector[idx]->write(drain_buffer + start, len - start);
+      }
+      len = queue.read(drain_buffer, MULTI_OUTPUT_DRAIN_SIZE);
+    }
+  }
+#endif
 };
 
 /**
@@ -470,6 +702,8 @@ class TimedStream : public ModifyingStream {
   bool begin() override {
     calculateByteLimits();
     current_bytes = 0;
+    is_start_positioned = false;
+    if (p_seek_index != nullptr) p_seek_index->begin();
     LOGI("byte range %u - %u",(unsigned) start_bytes,(unsigned) end_bytes);
     return true;
   }
@@ -478,13 +712,18 @@ class TimedStream : public ModifyingStream {
 
   /// Provides only data for the indicated start and end time. Only supported
   /// for data which does not contain any heder information: so PCM, mp3 should
-  /// work!
+  /// work! If the stream supports seeking (see setSeekable()) we jump directly
+  /// to the start position instead of reading and discarding the data.
   size_t readBytes(uint8_t *data, size_t len) override {
     // if reading is not supported we stop
     if (p_stream == nullptr) return 0;
+    // with a seek index the start of the stream is needed to find the position
+    if (p_seek_index != nullptr && !is_start_positioned) {
+      return readWithSeekIndex(data, len);
+    }
     // Positioin to start
     if (start_bytes > current_bytes){
-      consumeBytes(start_bytes - current_bytes);
+      if (!seekBytes(start_bytes)) consumeBytes(start_bytes - current_bytes);
     }
     // if we are past the end we stop
     if (!isActive()) return 0;
@@ -492,7 +731,7 @@ class TimedStream : public ModifyingStream {
     size_t result = 0;
     do {
       result = p_stream->readBytes(data, len);
-      current_bytes += len;
+      current_bytes += result;
       // ignore data before start time
     } while (result > 0 && current_bytes < start_bytes);
     return isPlaying() ? result : 0;
@@ -559,6 +798,31 @@ class TimedStream : public ModifyingStream {
     return end_bytes - start_bytes;
   }
 
+  /// Activates the positioning with seek() for streams which support it: e.g.
+  /// a File or a URLStream (which uses a HTTP Range request). The stream
+  /// must be at the position 0 when begin() is called.
+  template <class T>
+  void setSeekable(T &stream) {
+    setSeekCallback(seekOn<T>, &stream);
+  }
+
+  /// Defines a custom seek function which positions the stream to the
+  /// indicated byte position
+  void setSeekCallback(bool (*callback)(void *ref, size_t pos), void *ref) {
+    seek_callback = callback;
+    seek_ref = ref;
+  }
+
+  /// Determines the positions for compressed data (e.g. mp3, aac or wav files)
+  /// with the SeekIndex instead of the compression ratio: the first block
+  /// (which contains the header) is always provided and the stream continues
+  /// at the frame of the start time. The decoder is informed about the seek.
+  /// Requires setSeekable().
+  void setSeekIndex(SeekIndex &index, AudioDecoder *decoder = nullptr) {
+    p_seek_index = &index;
+    p_decoder = decoder;
+  }
+
  protected:
   Stream *p_stream = nullptr;
   Print *p_print = nullptr;
@@ -569,6 +833,58 @@ class TimedStream : public ModifyingStream {
   uint32_t end_bytes = UINT32_MAX;
   uint32_t current_bytes = 0;
   float compression_ratio = 1.0;
+  bool (*seek_callback)(void *ref, size_t pos) = nullptr;
+  void *seek_ref = nullptr;
+  SeekIndex *p_seek_index = nullptr;
+  AudioDecoder *p_decoder = nullptr;
+  bool is_start_positioned = false;
+
+  template <class T>
+  static bool seekOn(void *ref, size_t pos) {
+    return ((T *)ref)->seek(pos);
+  }
+
+  /// Moves to the indicated byte position if the stream supports it. PCM
+  /// data is aligned to the frame size.
+  bool seekBytes(uint32_t pos) {
+    if (seek_callback == nullptr) return false;
+    int frame_size = info.channels * info.bits_per_sample / 8;
+    if (compression_ratio == 1.0f && frame_size > 0) pos -= pos % frame_size;
+    if (!seek_callback(seek_ref, pos)) {
+      LOGW("seek to %u failed", (unsigned)pos);
+      return false;
+    }
+    LOGD("seek %u -> %u", (unsigned)current_bytes, (unsigned)pos);
+    current_bytes = pos;
+    if (start_bytes > current_bytes) start_bytes = current_bytes;
+    return true;
+  }
+
+  /// Provides the first block and then continues at the position which is
+  /// determined by the seek index
+  size_t readWithSeekIndex(uint8_t *data, size_t len) {
+    size_t result = p_stream->readBytes(data, len);
+    p_seek_index->write(data, result);
+    current_bytes += result;
+    if (result == 0) return 0;
+    is_start_positioned = true;
+    long pos = start_ms > 0 ? p_seek_index->bytePosition(start_ms) : -1;
+    if (pos > (long)current_bytes && seek_callback != nullptr &&
+        seek_callback(seek_ref, pos)) {
+      LOGI("seek %u ms -> %ld", (unsigned)start_ms, pos);
+      if (p_decoder != nullptr)
+        p_decoder->notifySeek(pos - (long)p_seek_index->streamPosition());
+      p_seek_index->setStreamPosition(pos);
+      current_bytes = pos;
+      start_bytes = pos;
+    }
+    // the end position is only known within the duration
+    if (end_ms < p_seek_index->durationMs()) {
+      long end = p_seek_index->bytePosition(end_ms);
+      if (end > (long)current_bytes) end_bytes = end;
+    }
+    return result;
+  }
 
   void consumeBytes(uint32_t len){
     int open = len;
@@ -596,7 +912,8 @@ class TimedStream : public ModifyingStream {
 /**
  * @brief Flexible functionality to extract one or more channels from a
  * multichannel signal. Warning: the destinatios added with addOutput
- * are not automatically notified about audio changes.
+ * are not automatically notified about audio changes. The input is processed
+ * in one pass with the ChannelScatter.
  * @ingroup transform
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -635,6 +952,7 @@ class ChannelsSelectOutput : public AudioOutput {
     def.p_out = &out;
     def.p_audio_info = &out;
     out_channels.push_back(def);
+    is_scatter_valid = false;
   }
 
   /// Define the channel to be selected to the specified output. 0: first
@@ -647,6 +965,7 @@ class ChannelsSelectOutput : public AudioOutput {
     def.p_out = &out;
     def.p_audio_info = &out;
     out_channels.push_back(def);
+    is_scatter_valid = false;
   }
 
   /// Define the channel to be selected to the specified output. 0: first
@@ -658,6 +977,7 @@ class ChannelsSelectOutput : public AudioOutput {
     def.channels = channels;
     def.p_out = &out;
     out_channels.push_back(def);
+    is_scatter_valid = false;
   }
 
   /// Define the stereo channels to be selected to the specified output. 0:
@@ -670,6 +990,7 @@ class ChannelsSelectOutput : public AudioOutput {
     def.channels = channels;
     def.p_out = &out;
     out_channels.push_back(def);
+    is_scatter_valid = false;
   }
 
   /// Define the stereo channels to be selected to the specified output. 0:
@@ -683,6 +1004,7 @@ class ChannelsSelectOutput : public AudioOutput {
     def.p_out = &out;
     def.p_audio_info = &out;
     out_channels.push_back(def);
+    is_scatter_valid = false;
   }
 
   /// Define the stereo channels to be selected to the specified output. 0:
@@ -696,6 +1018,7 @@ class ChannelsSelectOutput : public AudioOutput {
     def.p_out = &out;
     def.p_audio_info = &out;
     out_channels.push_back(def);
+    is_scatter_valid = false;
   }
 
   size_t write(const uint8_t *data, size_t len) override {
@@ -730,39 +1053,33 @@ class ChannelsSelectOutput : public AudioOutput {
   struct ChannelSelectionOutputDef {
     Print *p_out = nullptr;
     AudioInfoSupport *p_audio_info = nullptr;
-    SingleBuffer<uint8_t> buffer{CHANNEL_SELECT_BUFFER_SIZE};
     Vector<uint16_t> channels{0};
   };
   Vector<ChannelSelectionOutputDef> out_channels{0};
+  ChannelScatter scatter;
+  bool is_scatter_valid = false;
 
+  /// Distributes the frames in one pass and writes one block per output
   template <typename T>
   size_t writeT(const uint8_t *buffer, size_t size) {
     if (!is_active) return 0;
-    int sample_count = size / sizeof(T);
-    //int result_size = sample_count / cfg.channels;
-    T *data = (T *)buffer;
-
-    for (int i = 0; i < sample_count; i += cfg.channels) {
-      T *frame = data + i;
+    if (!is_scatter_valid || !scatter.isReady(cfg.channels, sizeof(T))) {
+      scatter.clear();
       for (auto &out : out_channels) {
-        T out_frame[out.channels.size()] = {0};
-        int ch_out = 0;
-        for (auto &ch : out.channels) {
-          // make sure we have a valid channel
-          int channel = (ch < cfg.channels) ? ch : cfg.channels - 1;
-          out_frame[ch_out++] = frame[channel];
-        }
-        // write to buffer
-        size_t written = out.buffer.writeArray((const uint8_t *)&out_frame, sizeof(out_frame));
-        // write buffer to final output
-        if (out.buffer.availableForWrite()<sizeof(out_frame)){
-          out.p_out->write(out.buffer.data(), out.buffer.available());
-          out.buffer.reset();
-        }
-        // if (written != sizeof(out_frame)) {
-        //   LOGW("Could not write all samples %d -> %d", sizeof(out_frame), written);
-        // }
+        scatter.addOutput(out.channels.data(), out.channels.size());
+      }
+      is_scatter_valid = scatter.begin(cfg.channels, sizeof(T));
+      if (!is_scatter_valid) return 0;
+    }
+    int frames = size / sizeof(T) / cfg.channels;
+    const T *data = (const T *)buffer;
+    while (frames > 0) {
+      int n = scatter.scatter(data, frames);
+      for (int j = 0; j < scatter.size(); j++) {
+        out_channels[j].p_out->write(scatter.data(j), scatter.bytes(j, n));
       }
+      data += n * cfg.channels;
+      frames -= n;
     }
     return size;
   }
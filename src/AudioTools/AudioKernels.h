@@ -0,0 +1,1168 @@
+#pragma once
+#include "AudioConfig.h"
+#include "AudioTools/AudioTypes.h"
+
+#if USE_SIMD && defined(__SSE2__)
+#  include <emmintrin.h>
+#  define USE_SIMD_SSE2
+#endif
+
+// desktop builds select the AVX2 variants at runtime
+#if defined(USE_SIMD_SSE2) && defined(__GNUC__) && \
+    (defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP))
+#  include <immintrin.h>
+#  include "AudioTools/CpuFeatures.h"
+#  define USE_SIMD_DISPATCH
+#  define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if USE_SIMD && defined(__SSSE3__)
+#  include <tmmintrin.h>
+#  define USE_SIMD_SSSE3
+#endif
+
+#if USE_SIMD && defined(__ARM_FEATURE_DSP)
+#  define USE_SIMD_ARM_DSP
+#endif
+
+/// Q16.16 representation of the gain 1.0
+#define GAIN_Q16_ONE 65536
+/// Q15 representation of the gain 1.0
+#define GAIN_Q15_ONE 32768
+/// Number of 24 bit samples which are converted to 32 bits on the stack
+#define INT24_CHUNK_SAMPLES 96
+
+namespace audio_tools {
+
+/// Accumulator type which is used by the mixers
+template <typename T> struct MixerAccumulator { typedef int64_t type; };
+template <> struct MixerAccumulator<int16_t> { typedef int32_t type; };
+template <> struct MixerAccumulator<float> { typedef float type; };
+
+/**
+ * @brief Shared processing kernels for the hot sample loops: e.g. the gain
+ * and saturate primitive which is used by the VolumeStream and the mix and
+ * accumulate primitives which are used by the OutputMixer.
+ * The architecture specific implementation is selected at compile time:
+ * - x86 (SSE2): 8 int16 samples per instruction with Q14 gains; packed 24 bit
+ *   data is shuffled with SSSE3. The desktop builds use the AVX2 variants if
+ *   the CPU supports them (see CpuFeatures)
+ * - ARM Cortex-M4/M7 (DSP extension): SMULWB with Q16.16 gains and SSAT
+ * - all other: portable fixed point or float implementation
+ * You can deactivate the architecture specific code with USE_SIMD false.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioKernels {
+ public:
+  /// Converts a float gain to Q16.16
+  static int32_t toGainQ16(float gain) {
+    float result = gain * GAIN_Q16_ONE;
+    if (result > 2147483647.0f) return 2147483647;
+    if (result < -2147483647.0f) return -2147483647;
+    return result;
+  }
+
+  /// Multiplies the interleaved samples with the Q16.16 gain of the related
+  /// channel and saturates the result
+  static void applyGain(int16_t *data, size_t samples, int channels,
+                        const int32_t *gains) {
+#ifdef USE_SIMD_SSE2
+    int16_t q14[8];
+    if (toGainQ14(gains, channels, q14)) {
+      applyGainQ14(data, samples, channels, q14);
+      return;
+    }
+#endif
+    int ch = 0;
+#ifdef USE_SIMD_ARM_DSP
+    for (size_t j = 0; j < samples; j++) {
+      int32_t result = smulwb(gains[ch], data[j]);
+      data[j] = ssat16(result);
+      if (++ch >= channels) ch = 0;
+    }
+#else
+    if (maxGain(gains, channels) <= GAIN_Q16_ONE) {
+      // the result fits into 32 bits
+      for (size_t j = 0; j < samples; j++) {
+        data[j] = clip16((data[j] * gains[ch]) >> 16);
+        if (++ch >= channels) ch = 0;
+      }
+    } else {
+      for (size_t j = 0; j < samples; j++) {
+        int64_t result = (static_cast<int64_t>(data[j]) * gains[ch]) >> 16;
+        data[j] = clip16(result);
+        if (++ch >= channels) ch = 0;
+      }
+    }
+#endif
+  }
+
+  /// Multiplies the interleaved samples with the Q16.16 gain of the related
+  /// channel and saturates the result
+  static void applyGain(int24_t *data, size_t samples, int channels,
+                        const int32_t *gains) {
+    if (applyGain24(data, samples, channels, gains)) return;
+    const int64_t max_value = 8388607;
+    int ch = 0;
+    for (size_t j = 0; j < samples; j++) {
+      int32_t value = data[j];
+      int64_t result = (static_cast<int64_t>(value) * gains[ch]) >> 16;
+      if (result > max_value) result = max_value;
+      if (result < -max_value) result = -max_value;
+      data[j] = static_cast<int32_t>(result);
+      if (++ch >= channels) ch = 0;
+    }
+  }
+
+  /// Multiplies the interleaved samples with the Q16.16 gain of the related
+  /// channel and saturates the result
+  static void applyGain(int32_t *data, size_t samples, int channels,
+                        const int32_t *gains) {
+    const int64_t max_value = 2147483647;
+    int ch = 0;
+    for (size_t j = 0; j < samples; j++) {
+      int64_t result = (static_cast<int64_t>(data[j]) * gains[ch]) >> 16;
+      if (result > max_value) result = max_value;
+      if (result < -max_value) result = -max_value;
+      data[j] = static_cast<int32_t>(result);
+      if (++ch >= channels) ch = 0;
+    }
+  }
+
+  /// Multiplies the interleaved samples with the float gain of the related
+  /// channel and saturates the result
+  static void applyGain(int16_t *data, size_t samples, int channels,
+                        const float *gains) {
+#ifdef USE_SIMD_SSE2
+    int16_t q14[8];
+    if (toGainQ14(gains, channels, q14)) {
+      applyGainQ14(data, samples, channels, q14);
+      return;
+    }
+#endif
+    applyGainFloat(data, samples, channels, gains);
+  }
+
+  /// Multiplies the interleaved samples with the float gain of the related
+  /// channel and saturates the result
+  static void applyGain(int24_t *data, size_t samples, int channels,
+                        const float *gains) {
+    if (applyGain24(data, samples, channels, gains)) return;
+    const float max_value = 8388607.0f;
+    int ch = 0;
+    for (size_t j = 0; j < samples; j++) {
+      float result = gains[ch] * static_cast<int32_t>(data[j]);
+      if (result > max_value) result = max_value;
+      if (result < -max_value) result = -max_value;
+      data[j] = static_cast<int32_t>(result);
+      if (++ch >= channels) ch = 0;
+    }
+  }
+
+  /// Multiplies the interleaved samples with the float gain of the related
+  /// channel and saturates the result
+  static void applyGain(int32_t *data, size_t samples, int channels,
+                        const float *gains) {
+    applyGainFloat(data, samples, channels, gains);
+  }
+
+  /// Adds the samples multiplied with the Q15 gain to the (wider)
+  /// accumulator
+  static void mixAdd(int32_t *acc, const int16_t *data, size_t samples,
+                     int32_t gain) {
+#ifdef USE_SIMD_SSE2
+    if (gain >= -32768 && gain <= 32767) {
+#ifdef USE_SIMD_DISPATCH
+      if (CpuFeatures::hasAVX2()) {
+        mixAddAVX2(acc, data, samples, gain);
+        return;
+      }
+#endif
+      mixAddSSE2(acc, data, samples, gain);
+      return;
+    }
+#endif
+    for (size_t j = 0; j < samples; j++) {
+      acc[j] += data[j] * gain;
+    }
+  }
+
+  /// Adds the samples multiplied with the Q15 gain to the (wider)
+  /// accumulator
+  template <typename A, typename T>
+  static void mixAdd(A *acc, const T *data, size_t samples, int32_t gain) {
+    for (size_t j = 0; j < samples; j++) {
+      acc[j] += static_cast<A>(sampleValue(data[j])) * gain;
+    }
+  }
+
+  /// Adds the samples multiplied with a linear gain ramp to the accumulator:
+  /// the gain and the step per sample are in Q23 (Q15 << 8). Returns the gain
+  /// after the last sample.
+  template <typename A, typename T>
+  static int32_t mixAddRamp(A *acc, const T *data, size_t samples,
+                            int32_t gain, int32_t step) {
+    for (size_t j = 0; j < samples; j++) {
+      acc[j] += static_cast<A>(sampleValue(data[j])) * (gain >> 8);
+      gain += step;
+    }
+    return gain;
+  }
+
+  /// Resamples interleaved frames with a linear interpolation and adds them
+  /// multiplied with the gain to the interleaved accumulator of the mix bus
+  /// in one pass. prev contains the last consumed input frame and frac the
+  /// position between prev and the first frame of data: both are updated.
+  /// step is the ratio of the input to the output rate. Output channel c
+  /// uses the input channel c % in_channels. The gain and the gain step per
+  /// output sample are in Q23 (see mixAddRamp()). Returns the number of
+  /// output frames: consumed provides the number of used input frames.
+  template <typename A, typename T>
+  static size_t mixAddResample(A *acc, size_t out_frames, int out_channels,
+                               const T *data, size_t in_frames,
+                               int in_channels, float *prev, float &frac,
+                               float step, int32_t &gain, int32_t gain_step,
+                               size_t &consumed) {
+    size_t in_idx = 0;
+    size_t out_idx = 0;
+    while (out_idx < out_frames) {
+      // move prev until the next frame follows the position
+      while (frac >= 1.0f && in_idx < in_frames) {
+        const T *frame = data + in_idx * in_channels;
+        for (int ch = 0; ch < in_channels; ch++) prev[ch] = sampleValue(frame[ch]);
+        in_idx++;
+        frac -= 1.0f;
+      }
+      if (frac >= 1.0f || in_idx >= in_frames) break;
+      const T *next = data + in_idx * in_channels;
+      A *out = acc + out_idx * out_channels;
+      for (int ch = 0; ch < out_channels; ch++) {
+        int in_ch = ch % in_channels;
+        float value = prev[in_ch] + frac * (sampleValue(next[in_ch]) - prev[in_ch]);
+        out[ch] += static_cast<A>(value * (gain >> 8));
+        gain += gain_step;
+      }
+      frac += step;
+      out_idx++;
+    }
+    consumed = in_idx;
+    return out_idx;
+  }
+
+  /// Scales the Q15 accumulator back to the sample type and saturates the
+  /// result
+  static void fromQ15(int16_t *data, const int32_t *acc, size_t samples) {
+    size_t j = 0;
+#ifdef USE_SIMD_SSE2
+    const __m128i round = _mm_set1_epi32(1 << 14);
+    for (; j + 8 <= samples; j += 8) {
+      __m128i value0 = _mm_loadu_si128((const __m128i *)(acc + j));
+      __m128i value1 = _mm_loadu_si128((const __m128i *)(acc + j + 4));
+      value0 = _mm_srai_epi32(_mm_add_epi32(value0, round), 15);
+      value1 = _mm_srai_epi32(_mm_add_epi32(value1, round), 15);
+      _mm_storeu_si128((__m128i *)(data + j), _mm_packs_epi32(value0, value1));
+    }
+#endif
+    for (; j < samples; j++) {
+      data[j] = clip16((static_cast<int64_t>(acc[j]) + (1 << 14)) >> 15);
+    }
+  }
+
+  /// Scales the Q15 accumulator back to the sample type and saturates the
+  /// result
+  static void fromQ15(int24_t *data, const int64_t *acc, size_t samples) {
+    fromQ15Int(data, acc, samples, 8388607);
+  }
+
+  /// Scales the Q15 accumulator back to the sample type and saturates the
+  /// result
+  static void fromQ15(int32_t *data, const int64_t *acc, size_t samples) {
+    fromQ15Int(data, acc, samples, 2147483647);
+  }
+
+  /// Scales the Q15 accumulator back: floats are not saturated
+  static void fromQ15(float *data, const float *acc, size_t samples) {
+    for (size_t j = 0; j < samples; j++) {
+      data[j] = acc[j] / GAIN_Q15_ONE;
+    }
+  }
+
+  /// Converts 32 bit to 16 bit samples by dropping the lower 16 bits
+  static void convert(const int32_t *from, int16_t *to, size_t samples) {
+    size_t j = 0;
+#ifdef USE_SIMD_DISPATCH
+    if (CpuFeatures::hasAVX2()) j = convertAVX2(from, to, samples);
+#endif
+#ifdef USE_SIMD_SSE2
+    for (; j + 8 <= samples; j += 8) {
+      __m128i value0 = _mm_loadu_si128((const __m128i *)(from + j));
+      __m128i value1 = _mm_loadu_si128((const __m128i *)(from + j + 4));
+      value0 = _mm_srai_epi32(value0, 16);
+      value1 = _mm_srai_epi32(value1, 16);
+      _mm_storeu_si128((__m128i *)(to + j), _mm_packs_epi32(value0, value1));
+    }
+#endif
+    for (; j < samples; j++) {
+      to[j] = from[j] >> 16;
+    }
+  }
+
+  /// Converts 16 bit to 32 bit samples by shifting them into the upper 16
+  /// bits
+  static void convert(const int16_t *from, int32_t *to, size_t samples) {
+    size_t j = 0;
+#ifdef USE_SIMD_DISPATCH
+    if (CpuFeatures::hasAVX2()) j = convertAVX2(from, to, samples);
+#endif
+#ifdef USE_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; j + 8 <= samples; j += 8) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(from + j));
+      _mm_storeu_si128((__m128i *)(to + j), _mm_unpacklo_epi16(zero, value));
+      _mm_storeu_si128((__m128i *)(to + j + 4),
+                       _mm_unpackhi_epi16(zero, value));
+    }
+#endif
+    for (; j < samples; j++) {
+      to[j] = static_cast<int32_t>(from[j]) << 16;
+    }
+  }
+
+  /// Converts 24 bit to 16 bit samples by dropping the lower 8 bits
+  static void convert(const int24_t *from, int16_t *to, size_t samples) {
+    int32_t tmp[INT24_CHUNK_SAMPLES];
+    while (samples > 0) {
+      size_t n = min(samples, (size_t)INT24_CHUNK_SAMPLES);
+      toInt32(from, tmp, n);
+      convert(tmp, to, n);
+      from += n;
+      to += n;
+      samples -= n;
+    }
+  }
+
+  /// Converts 16 bit to 24 bit samples
+  static void convert(const int16_t *from, int24_t *to, size_t samples) {
+    int32_t tmp[INT24_CHUNK_SAMPLES];
+    while (samples > 0) {
+      size_t n = min(samples, (size_t)INT24_CHUNK_SAMPLES);
+      convert(from, tmp, n);
+      fromInt32(tmp, to, n);
+      from += n;
+      to += n;
+      samples -= n;
+    }
+  }
+
+  /// Converts 24 bit to left justified 32 bit samples
+  static void convert(const int24_t *from, int32_t *to, size_t samples) {
+    toInt32(from, to, samples);
+  }
+
+  /// Converts left justified 32 bit to 24 bit samples by dropping the lower
+  /// 8 bits
+  static void convert(const int32_t *from, int24_t *to, size_t samples) {
+    fromInt32(from, to, samples);
+  }
+
+  /// Converts 24 bit samples to floats in the range of -1.0 to 1.0
+  static void convert(const int24_t *from, float *to, size_t samples,
+                      float gain = 1.0f) {
+    const float factor = gain / (8388607.0f * 256.0f);
+    int32_t tmp[INT24_CHUNK_SAMPLES];
+    while (samples > 0) {
+      size_t n = min(samples, (size_t)INT24_CHUNK_SAMPLES);
+      toInt32(from, tmp, n);
+      for (size_t j = 0; j < n; j++) to[j] = factor * tmp[j];
+      from += n;
+      to += n;
+      samples -= n;
+    }
+  }
+
+  /// Converts floats in the range of -1.0 to 1.0 to 24 bit samples: the
+  /// result is rounded and saturated. If a dither state is provided we add
+  /// triangular (TPDF) dither of +-1 LSB.
+  static void convert(const float *from, int24_t *to, size_t samples,
+                      float gain = 1.0f, uint32_t *p_dither = nullptr) {
+    const float max_value = 8388607.0f;
+    const float factor = gain * max_value;
+    int32_t tmp[INT24_CHUNK_SAMPLES];
+    while (samples > 0) {
+      size_t n = min(samples, (size_t)INT24_CHUNK_SAMPLES);
+      for (size_t j = 0; j < n; j++) {
+        float value = factor * from[j];
+        if (p_dither != nullptr) value += tpdf(*p_dither);
+        value += value < 0.0f ? -0.5f : 0.5f;
+        if (value > max_value) value = max_value;
+        if (value < -max_value) value = -max_value;
+        tmp[j] = static_cast<int32_t>(value) * 256;
+      }
+      fromInt32(tmp, to, n);
+      from += n;
+      to += n;
+      samples -= n;
+    }
+  }
+
+  /// Unpacks 24 bit little endian samples which use 3 bytes into left
+  /// justified 32 bit samples
+  static void unpack24(const uint8_t *from, int32_t *to, size_t samples) {
+    size_t j = 0;
+#ifdef USE_SIMD_SSSE3
+    // we load 16 bytes to process 12: stop before reading past the end
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7,
+                                          8, -1, 9, 10, 11);
+    for (; j + 6 <= samples; j += 4) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(from + j * 3));
+      _mm_storeu_si128((__m128i *)(to + j), _mm_shuffle_epi8(value, shuffle));
+    }
+#endif
+    for (; j < samples; j++) {
+      const uint8_t *p = from + j * 3;
+      to[j] = static_cast<int32_t>((static_cast<uint32_t>(p[2]) << 24) |
+                                   (static_cast<uint32_t>(p[1]) << 16) |
+                                   (static_cast<uint32_t>(p[0]) << 8));
+    }
+  }
+
+  /// Packs left justified 32 bit samples into 24 bit little endian samples
+  /// which use 3 bytes: the lower 8 bits are dropped
+  static void pack24(const int32_t *from, uint8_t *to, size_t samples) {
+    size_t j = 0;
+#ifdef USE_SIMD_SSSE3
+    const __m128i shuffle = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14,
+                                          15, -1, -1, -1, -1);
+    for (; j + 4 <= samples; j += 4) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(from + j));
+      value = _mm_shuffle_epi8(value, shuffle);
+      uint8_t *p = to + j * 3;
+      _mm_storel_epi64((__m128i *)p, value);
+      uint32_t rest = _mm_cvtsi128_si32(_mm_srli_si128(value, 8));
+      memcpy(p + 8, &rest, 4);
+    }
+#endif
+    for (; j < samples; j++) {
+      uint32_t value = static_cast<uint32_t>(from[j]);
+      uint8_t *p = to + j * 3;
+      p[0] = value >> 8;
+      p[1] = value >> 16;
+      p[2] = value >> 24;
+    }
+  }
+
+  /// Unpacks 24 bit samples which use 3 bytes into floats in the range of
+  /// -1.0 to 1.0
+  static void unpack24(const uint8_t *from, float *to, size_t samples,
+                       float gain = 1.0f) {
+    const float factor = gain / (8388607.0f * 256.0f);
+    int32_t tmp[INT24_CHUNK_SAMPLES];
+    while (samples > 0) {
+      size_t n = min(samples, (size_t)INT24_CHUNK_SAMPLES);
+      unpack24(from, tmp, n);
+      for (size_t j = 0; j < n; j++) to[j] = factor * tmp[j];
+      from += n * 3;
+      to += n;
+      samples -= n;
+    }
+  }
+
+  /// Packs floats in the range of -1.0 to 1.0 into 24 bit samples which use
+  /// 3 bytes: the result is rounded and saturated
+  static void pack24(const float *from, uint8_t *to, size_t samples,
+                     float gain = 1.0f) {
+    const float max_value = 8388607.0f;
+    const float factor = gain * max_value;
+    int32_t tmp[INT24_CHUNK_SAMPLES];
+    while (samples > 0) {
+      size_t n = min(samples, (size_t)INT24_CHUNK_SAMPLES);
+      for (size_t j = 0; j < n; j++) {
+        float value = factor * from[j];
+        value += value < 0.0f ? -0.5f : 0.5f;
+        if (value > max_value) value = max_value;
+        if (value < -max_value) value = -max_value;
+        tmp[j] = static_cast<int32_t>(value) * 256;
+      }
+      pack24(tmp, to, n);
+      from += n;
+      to += n * 3;
+      samples -= n;
+    }
+  }
+
+  /// Swaps the byte order of the 16 bit samples in place
+  static void byteSwap16(void *data, size_t samples) {
+    uint8_t *ptr = (uint8_t *)data;
+    size_t j = 0;
+#ifdef USE_SIMD_SSE2
+    for (; j + 8 <= samples; j += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(ptr + j * 2));
+      v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+      _mm_storeu_si128((__m128i *)(ptr + j * 2), v);
+    }
+#endif
+    // 2 samples per 32 bit word (REV16 on ARM)
+    for (; j + 2 <= samples; j += 2) {
+      uint32_t word;
+      memcpy(&word, ptr + j * 2, 4);
+      word = ((word & 0x00FF00FFu) << 8) | ((word >> 8) & 0x00FF00FFu);
+      memcpy(ptr + j * 2, &word, 4);
+    }
+    if (j < samples) {
+      uint8_t tmp = ptr[j * 2];
+      ptr[j * 2] = ptr[j * 2 + 1];
+      ptr[j * 2 + 1] = tmp;
+    }
+  }
+
+  /// Swaps the byte order of the 32 bit samples in place
+  static void byteSwap32(void *data, size_t samples) {
+    uint8_t *ptr = (uint8_t *)data;
+    for (size_t j = 0; j < samples; j++) {
+      uint32_t word;
+      memcpy(&word, ptr + j * 4, 4);
+      word = __builtin_bswap32(word);
+      memcpy(ptr + j * 4, &word, 4);
+    }
+  }
+
+  /// Converts 16 bit samples between the network (big endian) and the host
+  /// byte order in place: this is a no-op on big endian processors
+  static void networkToHost16(void *data, size_t samples) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    byteSwap16(data, samples);
+#endif
+  }
+
+  /// Converts 16 bit samples between the host and the network (big endian)
+  /// byte order in place
+  static void hostToNetwork16(void *data, size_t samples) {
+    networkToHost16(data, samples);
+  }
+
+  /// Copies the samples of one channel from the interleaved frames: from
+  /// points to the first sample of the channel. Integer samples are scaled
+  /// to the target size: e.g. from 32 bit to 16 bit we drop the lower 16 bits.
+  template <typename TFrom, typename TTo>
+  static void extractChannel(const TFrom *from, TTo *to, size_t frames,
+                             int channels) {
+    if (sizeof(TFrom) > sizeof(TTo)) {
+      const int shift = (sizeof(TFrom) - sizeof(TTo)) * 8;
+      for (size_t j = 0; j < frames; j++)
+        to[j] = static_cast<TTo>(from[j * channels] >> shift);
+    } else if (sizeof(TFrom) < sizeof(TTo)) {
+      const TTo factor = TTo(1) << ((sizeof(TTo) - sizeof(TFrom)) * 8);
+      for (size_t j = 0; j < frames; j++)
+        to[j] = static_cast<TTo>(from[j * channels]) * factor;
+    } else {
+      for (size_t j = 0; j < frames; j++) to[j] = from[j * channels];
+    }
+  }
+
+  /// Splits the interleaved frames into one (planar) array per channel
+  template <typename TFrom, typename TTo>
+  static void deinterleave(const TFrom *from, TTo *const *to, size_t frames,
+                           int channels) {
+    for (int ch = 0; ch < channels; ch++) {
+      extractChannel(from + ch, to[ch], frames, channels);
+    }
+  }
+
+  /// Converts integer samples to floats in the range of -1.0 to 1.0
+  template <typename T>
+  static void convert(const T *from, float *to, size_t samples,
+                      float gain = 1.0f) {
+    const float factor = gain / NumberConverter::maxValueT<T>();
+    for (size_t j = 0; j < samples; j++) {
+      to[j] = factor * sampleValue(from[j]);
+    }
+  }
+
+  /// Converts floats in the range of -1.0 to 1.0 to integer samples: the
+  /// result is rounded and saturated. If a dither state is provided we add
+  /// triangular (TPDF) dither of +-1 LSB.
+  template <typename T>
+  static void convert(const float *from, T *to, size_t samples,
+                      float gain = 1.0f, uint32_t *p_dither = nullptr) {
+    const float max_value = NumberConverter::maxValueT<T>();
+    const float factor = gain * max_value;
+    for (size_t j = 0; j < samples; j++) {
+      float value = factor * from[j];
+      if (p_dither != nullptr) value += tpdf(*p_dither);
+      // round half away from zero w/o calling lrintf
+      value += value < 0.0f ? -0.5f : 0.5f;
+      if (value > max_value) value = max_value;
+      if (value < -max_value) value = -max_value;
+      to[j] = static_cast<int32_t>(value);
+    }
+  }
+
+  /// Splits interleaved samples into planes which are separated by the
+  /// indicated distance (stride) in samples: mono and stereo use a single
+  /// sequential pass
+  template <typename TS, typename TD>
+  static void deinterleave(const TS *src, TD *dst, int stride, int channels,
+                           int frames) {
+    switch (channels) {
+      case 1:
+        for (int j = 0; j < frames; j++) dst[j] = sampleValue(src[j]);
+        break;
+      case 2: {
+        TD *left = dst;
+        TD *right = dst + stride;
+        for (int j = 0; j < frames; j++) {
+          left[j] = sampleValue(src[0]);
+          right[j] = sampleValue(src[1]);
+          src += 2;
+        }
+      } break;
+      default:
+        for (int ch = 0; ch < channels; ch++) {
+          TD *out = dst + ch * stride;
+          const TS *in = src + ch;
+          for (int j = 0; j < frames; j++) {
+            out[j] = sampleValue(*in);
+            in += channels;
+          }
+        }
+        break;
+    }
+  }
+
+  /// Combines the planes which are separated by the indicated distance
+  /// (stride) in samples into interleaved samples
+  template <typename TS, typename TD>
+  static void interleave(const TS *src, int stride, TD *dst, int channels,
+                         int frames) {
+    switch (channels) {
+      case 1:
+        for (int j = 0; j < frames; j++) dst[j] = sampleValue(src[j]);
+        break;
+      case 2: {
+        const TS *left = src;
+        const TS *right = src + stride;
+        for (int j = 0; j < frames; j++) {
+          dst[0] = sampleValue(left[j]);
+          dst[1] = sampleValue(right[j]);
+          dst += 2;
+        }
+      } break;
+      default:
+        for (int ch = 0; ch < channels; ch++) {
+          const TS *in = src + ch * stride;
+          TD *out = dst + ch;
+          for (int j = 0; j < frames; j++) {
+            *out = sampleValue(in[j]);
+            out += channels;
+          }
+        }
+        break;
+    }
+  }
+
+  /// Converts interleaved integer samples into separate planes of floating
+  /// point values in the range of -1.0 to 1.0 (e.g. for Faust): each plane is
+  /// filled in a separate pass with a single multiplication per sample, so
+  /// that the compiler can vectorize the loop
+  template <typename T, typename F>
+  static void toPlanar(const T *src, F *const *planes, int channels,
+                       int frames) {
+    const F factor = F(1) / NumberConverter::maxValueT<T>();
+    for (int ch = 0; ch < channels; ch++) {
+      F *out = planes[ch];
+      const T *in = src + ch;
+      if (channels == 1) {
+        for (int j = 0; j < frames; j++) out[j] = factor * sampleValue(in[j]);
+      } else {
+        for (int j = 0; j < frames; j++) {
+          out[j] = factor * sampleValue(*in);
+          in += channels;
+        }
+      }
+    }
+  }
+
+  /// Converts separate planes of floating point values in the range of -1.0
+  /// to 1.0 into interleaved integer samples: the result is rounded and
+  /// saturated
+  template <typename T, typename F>
+  static void fromPlanar(const F *const *planes, T *dst, int channels,
+                         int frames, float gain = 1.0f) {
+    const F max_value = NumberConverter::maxValueT<T>();
+    const F factor = gain * max_value;
+    for (int ch = 0; ch < channels; ch++) {
+      const F *in = planes[ch];
+      T *out = dst + ch;
+      for (int j = 0; j < frames; j++) {
+        F value = factor * in[j];
+        if (value > max_value) value = max_value;
+        if (value < -max_value) value = -max_value;
+        // round half away from zero w/o calling lrintf
+        value += value < F(0) ? F(-0.5) : F(0.5);
+        *out = static_cast<int32_t>(value);
+        out += channels;
+      }
+    }
+  }
+
+  /// Determines the max absolute value and the sum of the squares of the
+  /// interleaved samples per channel: the results are added to the peaks and
+  /// sums. The squares are calculated at a 16 bit scale (24 and 32 bit
+  /// samples are shifted right) so that the sums fit into 64 bits.
+  static void peakSumSquares(const int16_t *data, size_t samples,
+                             int channels, int32_t *peaks, int64_t *sums) {
+    size_t j = 0;
+#ifdef USE_SIMD_SSE2
+    if (8 % channels == 0) {
+      j = peakSumSquaresSSE2(data, samples, channels, peaks, sums);
+    }
+#endif
+    peakSumSquaresInt(data + j, samples - j, channels, peaks, sums, 0);
+  }
+
+  static void peakSumSquares(const int24_t *data, size_t samples,
+                             int channels, int32_t *peaks, int64_t *sums) {
+    peakSumSquaresInt(data, samples, channels, peaks, sums, 8);
+  }
+
+  static void peakSumSquares(const int32_t *data, size_t samples,
+                             int channels, int32_t *peaks, int64_t *sums) {
+    peakSumSquaresInt(data, samples, channels, peaks, sums, 16);
+  }
+
+ protected:
+  template <typename T>
+  static T sampleValue(T value) {
+    return value;
+  }
+  static int32_t sampleValue(int24_t value) {
+    return static_cast<int32_t>(value);
+  }
+
+  /// int24_4bytes_t stores the value left justified in 32 bits
+  static void toInt32(const int24_4bytes_t *from, int32_t *to, size_t samples) {
+    static_assert(sizeof(int24_4bytes_t) == 4, "unexpected int24 size");
+    memcpy(to, from, samples * sizeof(int32_t));
+  }
+
+  static void toInt32(const int24_3bytes_t *from, int32_t *to, size_t samples) {
+    static_assert(sizeof(int24_3bytes_t) == 3, "unexpected int24 size");
+    unpack24((const uint8_t *)from, to, samples);
+  }
+
+  static void fromInt32(const int32_t *from, int24_4bytes_t *to,
+                        size_t samples) {
+    int32_t *out = reinterpret_cast<int32_t *>(to);
+    for (size_t j = 0; j < samples; j++) {
+      // keep the lower 8 bits empty and the range symmetric
+      int32_t value = from[j] & ~0xFF;
+      out[j] = value < -2147483392 ? -2147483392 : value;
+    }
+  }
+
+  static void fromInt32(const int32_t *from, int24_3bytes_t *to,
+                        size_t samples) {
+    pack24(from, (uint8_t *)to, samples);
+  }
+
+  /// Applies the gain on the left justified 32 bit values: returns false if
+  /// there are too many channels for the chunk
+  template <typename G>
+  static bool applyGain24(int24_t *data, size_t samples, int channels,
+                          const G *gains) {
+    const size_t chunk = INT24_CHUNK_SAMPLES - INT24_CHUNK_SAMPLES % channels;
+    if (chunk == 0) return false;
+    int32_t tmp[INT24_CHUNK_SAMPLES];
+    while (samples > 0) {
+      size_t n = min(samples, chunk);
+      toInt32(data, tmp, n);
+      applyGain(tmp, n, channels, gains);
+      fromInt32(tmp, data, n);
+      data += n;
+      samples -= n;
+    }
+    return true;
+  }
+
+  template <typename T>
+  static void fromQ15Int(T *data, const int64_t *acc, size_t samples,
+                         int64_t max_value) {
+    for (size_t j = 0; j < samples; j++) {
+      int64_t result = (acc[j] + (1 << 14)) >> 15;
+      if (result > max_value) result = max_value;
+      if (result < -max_value) result = -max_value;
+      data[j] = static_cast<int32_t>(result);
+    }
+  }
+
+  template <typename T>
+  static void applyGainFloat(T *data, size_t samples, int channels,
+                             const float *gains) {
+    const float max_value = NumberConverter::maxValueT<T>();
+    int ch = 0;
+    for (size_t j = 0; j < samples; j++) {
+      float result = gains[ch] * data[j];
+      if (result > max_value) result = max_value;
+      if (result < -max_value) result = -max_value;
+      data[j] = static_cast<T>(result);
+      if (++ch >= channels) ch = 0;
+    }
+  }
+
+  template <typename T>
+  static void peakSumSquaresInt(const T *data, size_t samples, int channels,
+                                int32_t *peaks, int64_t *sums, int shift) {
+    int ch = 0;
+    for (size_t j = 0; j < samples; j++) {
+      int64_t value = sampleValue(data[j]);
+      int64_t abs_value = value < 0 ? -value : value;
+      if (abs_value > 2147483647) abs_value = 2147483647;
+      if (abs_value > peaks[ch]) peaks[ch] = abs_value;
+      int32_t scaled = static_cast<int32_t>(value >> shift);
+      sums[ch] += static_cast<int64_t>(scaled) * scaled;
+      if (++ch >= channels) ch = 0;
+    }
+  }
+
+  static int32_t maxGain(const int32_t *gains, int channels) {
+    int32_t result = 0;
+    for (int ch = 0; ch < channels; ch++) {
+      // -32768 * -65536 does not fit into 32 bits
+      int32_t gain = gains[ch] < 0 ? -gains[ch] + 1 : gains[ch];
+      if (gain > result) result = gain;
+    }
+    return result;
+  }
+
+  /// Triangular distributed random value in the range of -1.0 to 1.0 using
+  /// a linear congruential generator
+  static inline float tpdf(uint32_t &state) {
+    state = state * 1664525u + 1013904223u;
+    int32_t r1 = state >> 16;
+    state = state * 1664525u + 1013904223u;
+    int32_t r2 = state >> 16;
+    return (r1 - r2) * (1.0f / 65536.0f);
+  }
+
+  static inline int16_t clip16(int64_t value) {
+    if (value > 32767) return 32767;
+    if (value < -32767) return -32767;
+    return value;
+  }
+
+#ifdef USE_SIMD_ARM_DSP
+  /// (a * b[15:0]) >> 16 in a single cycle
+  static inline int32_t smulwb(int32_t a, int16_t b) {
+    int32_t result;
+    asm("smulwb %0, %1, %2" : "=r"(result) : "r"(a), "r"((int32_t)b));
+    return result;
+  }
+
+  static inline int16_t ssat16(int32_t value) {
+    int32_t result;
+    asm("ssat %0, #16, %1" : "=r"(result) : "r"(value));
+    return result;
+  }
+#endif
+
+#ifdef USE_SIMD_SSE2
+  /// Provides the gains for 8 lanes in Q14: returns false if the gains can
+  /// not be represented or if the channels do not fit into the lanes
+  template <typename G>
+  static bool toGainQ14(const G *gains, int channels, int16_t *q14) {
+    bool is_same = true;
+    for (int ch = 1; ch < channels; ch++) {
+      if (gains[ch] != gains[0]) is_same = false;
+    }
+    if (!is_same && 8 % channels != 0) return false;
+    for (int lane = 0; lane < 8; lane++) {
+      float gain = gainAsFloat(gains[is_same ? 0 : lane % channels]);
+      if (gain >= 2.0f || gain <= -2.0f) return false;
+      q14[lane] = static_cast<int16_t>(gain * 16384.0f);
+    }
+    return true;
+  }
+
+  static float gainAsFloat(float gain) { return gain; }
+  static float gainAsFloat(int32_t gain) {
+    return static_cast<float>(gain) / GAIN_Q16_ONE;
+  }
+
+  /// Selects the best implementation for the Q14 gains
+  static void applyGainQ14(int16_t *data, size_t samples, int channels,
+                           const int16_t *q14) {
+#ifdef USE_SIMD_DISPATCH
+    if (CpuFeatures::hasAVX2()) {
+      applyGainAVX2(data, samples, channels, q14);
+      return;
+    }
+#endif
+    applyGainSSE2(data, samples, channels, q14);
+  }
+
+  /// Processes 8 samples with each step: the gain pattern repeats after 8
+  /// samples
+  static void applyGainSSE2(int16_t *data, size_t samples, int channels,
+                            const int16_t *q14) {
+    const __m128i gain = _mm_loadu_si128((const __m128i *)q14);
+    const __m128i round = _mm_set1_epi32(1 << 13);
+    size_t j = 0;
+    for (; j + 8 <= samples; j += 8) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(data + j));
+      __m128i lo = _mm_mullo_epi16(value, gain);
+      __m128i hi = _mm_mulhi_epi16(value, gain);
+      __m128i result0 = _mm_unpacklo_epi16(lo, hi);
+      __m128i result1 = _mm_unpackhi_epi16(lo, hi);
+      result0 = _mm_srai_epi32(_mm_add_epi32(result0, round), 14);
+      result1 = _mm_srai_epi32(_mm_add_epi32(result1, round), 14);
+      _mm_storeu_si128((__m128i *)(data + j),
+                       _mm_packs_epi32(result0, result1));
+    }
+    // process the remaining samples
+    for (; j < samples; j++) {
+      int32_t result = (data[j] * q14[j % 8] + (1 << 13)) >> 14;
+      data[j] = clip16(result);
+    }
+  }
+
+  /// Multiplies 8 samples with each step and adds the 32 bit products
+  static void mixAddSSE2(int32_t *acc, const int16_t *data, size_t samples,
+                         int32_t gain) {
+    const __m128i factor = _mm_set1_epi16(static_cast<int16_t>(gain));
+    size_t j = 0;
+    for (; j + 8 <= samples; j += 8) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(data + j));
+      __m128i lo = _mm_mullo_epi16(value, factor);
+      __m128i hi = _mm_mulhi_epi16(value, factor);
+      __m128i *p_acc0 = (__m128i *)(acc + j);
+      __m128i *p_acc1 = (__m128i *)(acc + j + 4);
+      _mm_storeu_si128(p_acc0, _mm_add_epi32(_mm_loadu_si128(p_acc0),
+                                             _mm_unpacklo_epi16(lo, hi)));
+      _mm_storeu_si128(p_acc1, _mm_add_epi32(_mm_loadu_si128(p_acc1),
+                                             _mm_unpackhi_epi16(lo, hi)));
+    }
+    // process the remaining samples
+    for (; j < samples; j++) {
+      acc[j] += data[j] * gain;
+    }
+  }
+#ifdef USE_SIMD_DISPATCH
+  /// Processes 16 samples with each step: the AVX2 instructions work on two
+  /// 128 bit lanes which both use the gain pattern of 8 samples
+  SIMD_TARGET_AVX2 static void applyGainAVX2(int16_t *data, size_t samples,
+                                             int channels,
+                                             const int16_t *q14) {
+    const __m128i gain8 = _mm_loadu_si128((const __m128i *)q14);
+    const __m256i gain = _mm256_set_m128i(gain8, gain8);
+    const __m256i round = _mm256_set1_epi32(1 << 13);
+    size_t j = 0;
+    for (; j + 16 <= samples; j += 16) {
+      __m256i value = _mm256_loadu_si256((const __m256i *)(data + j));
+      __m256i lo = _mm256_mullo_epi16(value, gain);
+      __m256i hi = _mm256_mulhi_epi16(value, gain);
+      __m256i result0 = _mm256_unpacklo_epi16(lo, hi);
+      __m256i result1 = _mm256_unpackhi_epi16(lo, hi);
+      result0 = _mm256_srai_epi32(_mm256_add_epi32(result0, round), 14);
+      result1 = _mm256_srai_epi32(_mm256_add_epi32(result1, round), 14);
+      _mm256_storeu_si256((__m256i *)(data + j),
+                          _mm256_packs_epi32(result0, result1));
+    }
+    // the remaining samples start with the gain of lane 0
+    applyGainSSE2(data + j, samples - j, channels, q14);
+  }
+
+  /// Multiplies 8 samples with each step and adds the 32 bit products
+  SIMD_TARGET_AVX2 static void mixAddAVX2(int32_t *acc, const int16_t *data,
+                                          size_t samples, int32_t gain) {
+    const __m256i factor = _mm256_set1_epi32(gain);
+    size_t j = 0;
+    for (; j + 8 <= samples; j += 8) {
+      __m256i value = _mm256_cvtepi16_epi32(
+          _mm_loadu_si128((const __m128i *)(data + j)));
+      __m256i *p_acc = (__m256i *)(acc + j);
+      _mm256_storeu_si256(p_acc,
+                          _mm256_add_epi32(_mm256_loadu_si256(p_acc),
+                                           _mm256_mullo_epi32(value, factor)));
+    }
+    for (; j < samples; j++) {
+      acc[j] += data[j] * gain;
+    }
+  }
+
+  /// Converts 16 samples with each step: returns the number of processed
+  /// samples
+  SIMD_TARGET_AVX2 static size_t convertAVX2(const int32_t *from, int16_t *to,
+                                             size_t samples) {
+    size_t j = 0;
+    for (; j + 16 <= samples; j += 16) {
+      __m256i value0 = _mm256_loadu_si256((const __m256i *)(from + j));
+      __m256i value1 = _mm256_loadu_si256((const __m256i *)(from + j + 8));
+      value0 = _mm256_srai_epi32(value0, 16);
+      value1 = _mm256_srai_epi32(value1, 16);
+      // packs works per 128 bit lane: restore the order of the 64 bit blocks
+      __m256i result = _mm256_packs_epi32(value0, value1);
+      result = _mm256_permute4x64_epi64(result, 0xD8);
+      _mm256_storeu_si256((__m256i *)(to + j), result);
+    }
+    return j;
+  }
+
+  /// Converts 16 samples with each step: returns the number of processed
+  /// samples
+  SIMD_TARGET_AVX2 static size_t convertAVX2(const int16_t *from, int32_t *to,
+                                             size_t samples) {
+    size_t j = 0;
+    for (; j + 8 <= samples; j += 8) {
+      __m256i value = _mm256_cvtepi16_epi32(
+          _mm_loadu_si128((const __m128i *)(from + j)));
+      _mm256_storeu_si256((__m256i *)(to + j), _mm256_slli_epi32(value, 16));
+    }
+    return j;
+  }
+#endif
+
+  /// Processes 8 samples with each step: the squares of the even and odd
+  /// lanes are calculated separately with _mm_madd_epi16, so that the
+  /// channels are not mixed. Returns the number of processed samples.
+  static size_t peakSumSquaresSSE2(const int16_t *data, size_t samples,
+                                   int channels, int32_t *peaks,
+                                   int64_t *sums) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask_even = _mm_set1_epi32(0x0000FFFF);
+    __m128i peak = zero;
+    // 64 bit sums of the lanes 0,2 / 4,6 / 1,3 / 5,7
+    __m128i sum_even_lo = zero, sum_even_hi = zero;
+    __m128i sum_odd_lo = zero, sum_odd_hi = zero;
+    size_t j = 0;
+    for (; j + 8 <= samples; j += 8) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(data + j));
+      peak = _mm_max_epi16(peak,
+                           _mm_max_epi16(value, _mm_subs_epi16(zero, value)));
+      __m128i even = _mm_and_si128(value, mask_even);
+      __m128i odd = _mm_srli_epi32(value, 16);
+      __m128i sq_even = _mm_madd_epi16(even, even);
+      __m128i sq_odd = _mm_madd_epi16(odd, odd);
+      sum_even_lo =
+          _mm_add_epi64(sum_even_lo, _mm_unpacklo_epi32(sq_even, zero));
+      sum_even_hi =
+          _mm_add_epi64(sum_even_hi, _mm_unpackhi_epi32(sq_even, zero));
+      sum_odd_lo =
+          _mm_add_epi64(sum_odd_lo, _mm_unpacklo_epi32(sq_odd, zero));
+      sum_odd_hi =
+          _mm_add_epi64(sum_odd_hi, _mm_unpackhi_epi32(sq_odd, zero));
+    }
+    int16_t lane_peaks[8];
+    int64_t lane_sums[8];
+    _mm_storeu_si128((__m128i *)lane_peaks, peak);
+    _mm_storeu_si128((__m128i *)(lane_sums + 0), sum_even_lo);
+    _mm_storeu_si128((__m128i *)(lane_sums + 2), sum_even_hi);
+    _mm_storeu_si128((__m128i *)(lane_sums + 4), sum_odd_lo);
+    _mm_storeu_si128((__m128i *)(lane_sums + 6), sum_odd_hi);
+    // sample index of the lane sums
+    static const int lane_index[8] = {0, 2, 4, 6, 1, 3, 5, 7};
+    for (int lane = 0; lane < 8; lane++) {
+      int ch = lane % channels;
+      if (lane_peaks[lane] > peaks[ch]) peaks[ch] = lane_peaks[lane];
+      sums[lane_index[lane] % channels] += lane_sums[lane];
+    }
+    return j;
+  }
+#endif
+};
+
+/**
+ * @brief Converts an array of samples from one number format to another.
+ * The generic implementation uses the NumberConverter: the common pairs are
+ * specialized at compile time to use the AudioKernels. Floats are in the
+ * range of -1.0 to 1.0.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename TFrom, typename TTo>
+struct NumberFormatKernel {
+  /// true if the data can be copied w/o conversion
+  static constexpr bool is_pass_through = sizeof(TFrom) == sizeof(TTo);
+
+  static void convert(const TFrom *from, TTo *to, size_t samples, float gain,
+                      uint32_t *p_dither) {
+    NumberConverter::convertArray<TFrom, TTo>(const_cast<TFrom *>(from), to,
+                                              samples, gain);
+  }
+};
+
+/// Conversion between integer types with the AudioKernels: the gain is
+/// applied on the result
+template <typename TFrom, typename TTo>
+struct NumberFormatKernelInt {
+  static constexpr bool is_pass_through = false;
+
+  static void convert(const TFrom *from, TTo *to, size_t samples, float gain,
+                      uint32_t *p_dither) {
+    AudioKernels::convert(from, to, samples);
+    if (gain != 1.0f) AudioKernels::applyGain(to, samples, 1, &gain);
+  }
+};
+
+template <>
+struct NumberFormatKernel<int32_t, int16_t>
+    : public NumberFormatKernelInt<int32_t, int16_t> {};
+template <>
+struct NumberFormatKernel<int16_t, int32_t>
+    : public NumberFormatKernelInt<int16_t, int32_t> {};
+template <>
+struct NumberFormatKernel<int24_t, int16_t>
+    : public NumberFormatKernelInt<int24_t, int16_t> {};
+template <>
+struct NumberFormatKernel<int16_t, int24_t>
+    : public NumberFormatKernelInt<int16_t, int24_t> {};
+/// int24_4bytes_t is already left justified in 32 bits: only the packed
+/// int24_3bytes_t needs a conversion
+template <>
+struct NumberFormatKernel<int24_t, int32_t>
+    : public NumberFormatKernelInt<int24_t, int32_t> {
+  static constexpr bool is_pass_through = sizeof(int24_t) == sizeof(int32_t);
+};
+template <>
+struct NumberFormatKernel<int32_t, int24_t>
+    : public NumberFormatKernelInt<int32_t, int24_t> {
+  static constexpr bool is_pass_through = sizeof(int24_t) == sizeof(int32_t);
+};
+
+/// Conversion from integer samples to float
+template <typename TFrom>
+struct NumberFormatKernel<TFrom, float> {
+  static constexpr bool is_pass_through = false;
+
+  static void convert(const TFrom *from, float *to, size_t samples,
+                      float gain, uint32_t *p_dither) {
+    AudioKernels::convert(from, to, samples, gain);
+  }
+};
+
+/// Conversion from float to integer samples with optional dither
+template <typename TTo>
+struct NumberFormatKernel<float, TTo> {
+  static constexpr bool is_pass_through = false;
+
+  static void convert(const float *from, TTo *to, size_t samples, float gain,
+                      uint32_t *p_dither) {
+    AudioKernels::convert(from, to, samples, gain, p_dither);
+  }
+};
+
+template <>
+struct NumberFormatKernel<float, float> {
+  static constexpr bool is_pass_through = true;
+
+  static void convert(const float *from, float *to, size_t samples,
+                      float gain, uint32_t *p_dither) {
+    for (size_t j = 0; j < samples; j++) {
+      to[j] = gain * from[j];
+    }
+  }
+};
+
+}  // namespace audio_tools
@@ -4,6 +4,10 @@
 #if defined(ARDUINO) && !defined(IS_MIN_DESKTOP)
 #  include "Print.h"
 #endif
+/// Defines the compile time minimum log level for a class and its subclasses
+/// e.g. AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_CODEC)
+#define AUDIO_LOG_MIN_LEVEL(level) static constexpr int audio_log_min_level = level;
+
 // Logging Implementation
 #if USE_AUDIO_LOGGING
 
@@ -148,7 +152,8 @@ class AudioLogger {
         }
 };
 
-/// Class specific custom log level
+/// Class specific custom log level: w/o custom level set() and reset() just
+/// cost a branch
 class CustomLogLevel {
 public:
     AudioLogger::LogLevel getActual(){
@@ -158,87 +163,104 @@ public:
     /// Defines a custom level
     void set(AudioLogger::LogLevel level){
       active = true;
-      original = AudioLogger::instance().level();
       actual = level;
     }
 
     /// sets the defined log level
     void set(){
         if (active){
-            AudioLogger::instance().begin(Serial, actual);
+            original = AudioLogger::instance().level();
+            AudioLogger::instance().setLogLevel(actual);
         }
     }
     /// resets to the original log level
     void reset(){
         if (active){
-            AudioLogger::instance().begin(Serial, original);
+            AudioLogger::instance().setLogLevel(original);
         }
     }
 protected:
     bool active=false;
-    AudioLogger::LogLevel original;
-    AudioLogger::LogLevel actual;
+    AudioLogger::LogLevel original = LOG_LEVEL;
+    AudioLogger::LogLevel actual = LOG_LEVEL;
 
 };
 
+/// Compile time minimum log level: the classes of a subsystem can override it
+/// with AUDIO_LOG_MIN_LEVEL()
+static constexpr int audio_log_min_level = LOG_MIN_LEVEL;
+
 
 
 }
 
 
 //#define LOG_OUT(level, fmt, ...) {AudioLogger::instance().prefix(__FILE__,__LINE__, level);cont char PROGMEM *fmt_P=F(fmt); snprintf_P(AudioLogger::instance().str(), LOG_PRINTF_BUFFER_SIZE, fmt,  ##__VA_ARGS__); AudioLogger::instance().println();}
-#define LOG_OUT_PGMEM(level, fmt, ...) { \
+// With deferred logging the log statements are only recorded when active
+#if USE_DEFERRED_LOGGING
+#define LOG_DEFERRED(level, fmt, ...) if (AudioLoggerDeferred::instance().isActive()) { \
+    AudioLoggerDeferred::instance().add(__FILE__,__LINE__, level, fmt, ##__VA_ARGS__); \
+} else
+#else
+#define LOG_DEFERRED(level, fmt, ...)
+#endif
+
+#define LOG_OUT_PGMEM(level, fmt, ...) { LOG_DEFERRED(level, fmt, ##__VA_ARGS__) { \
     AudioLogger::instance().prefix(__FILE__,__LINE__, level); \
     snprintf(AudioLogger::instance().str(), LOG_PRINTF_BUFFER_SIZE, PSTR(fmt),  ##__VA_ARGS__); \
     AudioLogger::instance().println();\
-}
+}}
 
-#define LOG_OUT(level, fmt, ...) { \
+#define LOG_OUT(level, fmt, ...) { LOG_DEFERRED(level, fmt, ##__VA_ARGS__) { \
     AudioLogger::instance().prefix(__FILE__,__LINE__, level); \
     snprintf(AudioLogger::instance().str(), LOG_PRINTF_BUFFER_SIZE, fmt,  ##__VA_ARGS__); \
     AudioLogger::instance().println();\
-}
+}}
 #define LOG_MIN(level) { \
     AudioLogger::instance().prefix(__FILE__,__LINE__, level); \
     AudioLogger::instance().println();\
 }
 
 #ifdef LOG_NO_MSG
-#define LOGD(fmt, ...) if (AudioLogger::instance().level()<=AudioLogger::Debug) { LOG_MIN(AudioLogger::Debug);}
-#define LOGI(fmt, ...) if (AudioLogger::instance().level()<=AudioLogger::Info) { LOG_MIN(AudioLogger::Info);}
-#define LOGW(fmt, ...) if (AudioLogger::instance().level()<=AudioLogger::Warning) { LOG_MIN(AudioLogger::Warning);}
-#define LOGE(fmt, ...) if (AudioLogger::instance().level()<=AudioLogger::Error) { LOG_MIN(AudioLogger::Error);}
+#define LOGD(fmt, ...) if (AudioLogger::Debug>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Debug) { LOG_MIN(AudioLogger::Debug);}
+#define LOGI(fmt, ...) if (AudioLogger::Info>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Info) { LOG_MIN(AudioLogger::Info);}
+#define LOGW(fmt, ...) if (AudioLogger::Warning>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Warning) { LOG_MIN(AudioLogger::Warning);}
+#define LOGE(fmt, ...) if (AudioLogger::Error>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Error) { LOG_MIN(AudioLogger::Error);}
 #else
 // Log statments which store the fmt string in Progmem
-#define LOGD(fmt, ...) if (AudioLogger::instance().level()<=AudioLogger::Debug) { LOG_OUT_PGMEM(AudioLogger::Debug, fmt, ##__VA_ARGS__);}
-#define LOGI(fmt, ...) if (AudioLogger::instance().level()<=AudioLogger::Info) { LOG_OUT_PGMEM(AudioLogger::Info, fmt, ##__VA_ARGS__);}
-#define LOGW(fmt, ...) if (AudioLogger::instance().level()<=AudioLogger::Warning) { LOG_OUT_PGMEM(AudioLogger::Warning, fmt, ##__VA_ARGS__);}
-#define LOGE(fmt, ...) if (AudioLogger::instance().level()<=AudioLogger::Error) { LOG_OUT_PGMEM(AudioLogger::Error, fmt, ##__VA_ARGS__);}
+#define LOGD(fmt, ...) if (AudioLogger::Debug>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Debug) { LOG_OUT_PGMEM(AudioLogger::Debug, fmt, ##__VA_ARGS__);}
+#define LOGI(fmt, ...) if (AudioLogger::Info>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Info) { LOG_OUT_PGMEM(AudioLogger::Info, fmt, ##__VA_ARGS__);}
+#define LOGW(fmt, ...) if (AudioLogger::Warning>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Warning) { LOG_OUT_PGMEM(AudioLogger::Warning, fmt, ##__VA_ARGS__);}
+#define LOGE(fmt, ...) if (AudioLogger::Error>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Error) { LOG_OUT_PGMEM(AudioLogger::Error, fmt, ##__VA_ARGS__);}
 #endif
 
 // Just log file and line 
 #if defined(NO_TRACED) || defined(NO_TRACE)
 #  define TRACED()
 #else
-#  define TRACED() if (AudioLogger::instance().level()<=AudioLogger::Debug) { LOG_OUT(AudioLogger::Debug, LOG_METHOD);}
+#  define TRACED() if (AudioLogger::Debug>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Debug) { LOG_OUT(AudioLogger::Debug, LOG_METHOD);}
 #endif
 
 #if  defined(NO_TRACEI) || defined(NO_TRACE)
 #  define TRACEI()
 #else 
-#  define TRACEI() if (AudioLogger::instance().level()<=AudioLogger::Info) { LOG_OUT(AudioLogger::Info, LOG_METHOD);}
+#  define TRACEI() if (AudioLogger::Info>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Info) { LOG_OUT(AudioLogger::Info, LOG_METHOD);}
 #endif
 
 #if  defined(NO_TRACEW) || defined(NO_TRACE)
 #  define TRACEW()
 #else 
-#  define TRACEW() if (AudioLogger::instance().level()<=AudioLogger::Warning) { LOG_OUT(AudioLogger::Warning, LOG_METHOD);}
+#  define TRACEW() if (AudioLogger::Warning>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Warning) { LOG_OUT(AudioLogger::Warning, LOG_METHOD);}
 #endif
 
 #if  defined(NO_TRACEE) || defined(NO_TRACE)
 #  define TRACEE()
 #else 
-#define TRACEE() if (AudioLogger::instance().level()<=AudioLogger::Error) { LOG_OUT(AudioLogger::Error, LOG_METHOD);}
+#define TRACEE() if (AudioLogger::Error>=audio_log_min_level && AudioLogger::instance().level()<=AudioLogger::Error) { LOG_OUT(AudioLogger::Error, LOG_METHOD);}
+#endif
+
+#if USE_DEFERRED_LOGGING
+#  include "AudioTools/AudioLoggerDeferred.h"
 #endif
 
 
@@ -0,0 +1,328 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+#ifdef USE_CONCURRENCY
+#  include "Concurrency/Task.h"
+#endif
+
+/// Max number of arguments of a deferred log record
+#ifndef LOG_DEFERRED_MAX_ARGS
+#  define LOG_DEFERRED_MAX_ARGS 6
+#endif
+
+/// Space for the copies of the string arguments of a deferred log record
+#ifndef LOG_DEFERRED_TEXT_SIZE
+#  define LOG_DEFERRED_TEXT_SIZE 32
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Deferred binary logging: the log statements just store the format
+ * string pointer, the location and the arguments in a lock free ring of
+ * preallocated records. No formatting and no locking happens in the calling
+ * task, so that we can log in the hot audio paths. process() formats and
+ * prints the queued records later: call it in loop() or in a low priority
+ * task (see AudioLoggerDeferredTask). If the ring is full, the records are dropped and
+ * counted. String arguments are copied (truncated to LOG_DEFERRED_TEXT_SIZE
+ * for all strings of a record).
+ *
+ * Activate it with USE_DEFERRED_LOGGING and
+ * AudioLoggerDeferred::instance().begin().
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioLoggerDeferred {
+ public:
+  /// provides the singleton instance
+  static AudioLoggerDeferred &instance() {
+    static AudioLoggerDeferred self;
+    return self;
+  }
+
+  /// Activates the recording of the log statements
+  void begin() { is_active = true; }
+
+  /// Deactivates the recording: the remaining records are printed
+  void end() {
+    is_active = false;
+    process();
+  }
+
+  /// Returns true if the log statements are recorded
+  bool isActive() { return is_active; }
+
+  /// Records a log statement: returns false if the ring is full
+  template <typename... Args>
+  bool add(const char *file, int line, AudioLogger::LogLevel level,
+           const char *fmt, Args... args) {
+    size_t pos = write_pos.load(std::memory_order_relaxed);
+    Node *node;
+    for (;;) {
+      node = &nodes[pos & mask];
+      size_t seq = node->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (write_pos.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        dropped_count++;
+        return false;
+      } else {
+        pos = write_pos.load(std::memory_order_relaxed);
+      }
+    }
+    Record &rec = node->record;
+    rec.file = file;
+    rec.fmt = fmt;
+    rec.line = line;
+    rec.level = level;
+    rec.argc = 0;
+    rec.text_len = 0;
+    addArgs(rec, args...);
+    node->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Formats and prints the recorded log statements: there must be only one
+  /// caller. Returns the number of printed records.
+  int process(int maxRecords = LOG_DEFERRED_RECORDS) {
+    int count = 0;
+    while (count < maxRecords) {
+      Node &node = nodes[read_pos & mask];
+      if (node.seq.load(std::memory_order_acquire) != read_pos + 1) break;
+      print(node.record);
+      node.seq.store(read_pos + LOG_DEFERRED_RECORDS,
+                     std::memory_order_release);
+      read_pos++;
+      count++;
+    }
+    uint32_t dropped = dropped_count.load();
+    if (dropped != reported_dropped_count) {
+      AudioLogger &log = AudioLogger::instance();
+      log.prefix(__FILE__, __LINE__, AudioLogger::Warning);
+      snprintf(log.str(), LOG_PRINTF_BUFFER_SIZE, "%u log records dropped",
+               (unsigned)(dropped - reported_dropped_count));
+      log.println();
+      reported_dropped_count = dropped;
+    }
+    return count;
+  }
+
+  /// Number of records which were lost because the ring was full
+  uint32_t droppedCount() { return dropped_count; }
+
+ protected:
+  union Arg {
+    int64_t i;
+    double d;
+    const void *p;
+  };
+  enum ArgType : uint8_t { IntArg, UIntArg, DoubleArg, StrArg, PtrArg };
+
+  struct Record {
+    const char *file;
+    const char *fmt;
+    uint16_t line;
+    uint8_t level;
+    uint8_t argc;
+    uint8_t text_len;
+    uint8_t types[LOG_DEFERRED_MAX_ARGS];
+    Arg args[LOG_DEFERRED_MAX_ARGS];
+    char text[LOG_DEFERRED_TEXT_SIZE];
+  };
+
+  struct Node {
+    std::atomic<size_t> seq;
+    Record record;
+  };
+
+  static_assert((LOG_DEFERRED_RECORDS & (LOG_DEFERRED_RECORDS - 1)) == 0,
+                "LOG_DEFERRED_RECORDS must be a power of 2");
+  static const size_t mask = LOG_DEFERRED_RECORDS - 1;
+  Node nodes[LOG_DEFERRED_RECORDS];
+  std::atomic<size_t> write_pos{0};
+  size_t read_pos = 0;
+  std::atomic<uint32_t> dropped_count{0};
+  uint32_t reported_dropped_count = 0;
+  volatile bool is_active = false;
+
+  AudioLoggerDeferred() {
+    for (size_t j = 0; j < LOG_DEFERRED_RECORDS; j++) {
+      nodes[j].seq.store(j, std::memory_order_relaxed);
+    }
+  }
+
+  void addArgs(Record &rec) {}
+
+  template <typename T, typename... Args>
+  void addArgs(Record &rec, T value, Args... args) {
+    if (rec.argc < LOG_DEFERRED_MAX_ARGS) {
+      addArg(rec, rec.args[rec.argc], rec.types[rec.argc], value);
+      rec.argc++;
+    }
+    addArgs(rec, args...);
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value ||
+                          std::is_enum<T>::value>::type
+  addArg(Record &rec, Arg &arg, uint8_t &type, T value) {
+    arg.i = (int64_t)value;
+    type = std::is_signed<T>::value ? IntArg : UIntArg;
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_floating_point<T>::value>::type addArg(
+      Record &rec, Arg &arg, uint8_t &type, T value) {
+    arg.d = value;
+    type = DoubleArg;
+  }
+
+  /// strings are copied into the record: we store the offset
+  void addArg(Record &rec, Arg &arg, uint8_t &type, const char *value) {
+    int len = value == nullptr ? 0 : strlen(value);
+    int open = LOG_DEFERRED_TEXT_SIZE - rec.text_len - 1;
+    if (len > open) len = open;
+    if (len < 0) len = 0;
+    arg.i = rec.text_len;
+    memcpy(rec.text + rec.text_len, value, len);
+    rec.text_len += len;
+    rec.text[rec.text_len] = 0;
+    if (rec.text_len < LOG_DEFERRED_TEXT_SIZE - 1) rec.text_len++;
+    type = StrArg;
+  }
+
+  void addArg(Record &rec, Arg &arg, uint8_t &type, char *value) {
+    addArg(rec, arg, type, (const char *)value);
+  }
+
+  void addArg(Record &rec, Arg &arg, uint8_t &type, const void *value) {
+    arg.p = value;
+    type = PtrArg;
+  }
+
+  void print(Record &rec) {
+    AudioLogger &log = AudioLogger::instance();
+    log.prefix(rec.file, rec.line, (AudioLogger::LogLevel)rec.level);
+    formatRecord(rec, log.str(), LOG_PRINTF_BUFFER_SIZE);
+    log.println();
+  }
+
+  /// printf with the recorded arguments: each conversion is formatted
+  /// separately with the type from the format specification
+  void formatRecord(Record &rec, char *out, int size) {
+    int len = 0;
+    int arg_idx = 0;
+    const char *p = rec.fmt;
+    while (*p != 0 && len < size - 1) {
+      if (*p != '%') {
+        out[len++] = *p++;
+        continue;
+      }
+      if (p[1] == '%') {
+        out[len++] = '%';
+        p += 2;
+        continue;
+      }
+      // determine the conversion specification e.g. %5.2f
+      char spec[16];
+      int n = 0;
+      spec[n++] = *p++;
+      while (*p != 0 && strchr("diouxXcsfFeEgGaAp", *p) == nullptr &&
+             n < (int)sizeof(spec) - 2) {
+        spec[n++] = *p++;
+      }
+      if (*p == 0) break;
+      char conversion = *p++;
+      spec[n++] = conversion;
+      spec[n] = 0;
+      int written = arg_idx < rec.argc
+                        ? formatArg(rec, arg_idx++, spec, conversion,
+                                    out + len, size - len)
+                        : snprintf(out + len, size - len, "%s", spec);
+      if (written > 0) len += min(written, size - len - 1);
+    }
+    out[len] = 0;
+  }
+
+  int formatArg(Record &rec, int idx, const char *spec, char conversion,
+                char *out, int size) {
+    Arg &arg = rec.args[idx];
+    uint8_t type = rec.types[idx];
+    bool is_ll = strstr(spec, "ll") != nullptr;
+    bool is_l = !is_ll && strchr(spec, 'l') != nullptr;
+    bool is_size = strchr(spec, 'z') != nullptr;
+    switch (conversion) {
+      case 'd':
+      case 'i':
+      case 'c': {
+        int64_t value = type == DoubleArg ? (int64_t)arg.d : arg.i;
+        if (is_ll) return snprintf(out, size, spec, (long long)value);
+        if (is_l) return snprintf(out, size, spec, (long)value);
+        if (is_size) return snprintf(out, size, spec, (size_t)value);
+        return snprintf(out, size, spec, (int)value);
+      }
+      case 'u':
+      case 'o':
+      case 'x':
+      case 'X': {
+        uint64_t value = type == DoubleArg ? (uint64_t)arg.d : arg.i;
+        if (is_ll) return snprintf(out, size, spec, (unsigned long long)value);
+        if (is_l) return snprintf(out, size, spec, (unsigned long)value);
+        if (is_size) return snprintf(out, size, spec, (size_t)value);
+        return snprintf(out, size, spec, (unsigned)value);
+      }
+      case 's':
+        if (type != StrArg) return snprintf(out, size, "%s", spec);
+        return snprintf(out, size, spec, rec.text + arg.i);
+      case 'p':
+        return snprintf(out, size, spec, arg.p);
+      default: {
+        double value = type == DoubleArg ? arg.d
+                       : type == IntArg  ? (double)arg.i
+                                         : (double)(uint64_t)arg.i;
+        if (strchr(spec, 'L') != nullptr)
+          return snprintf(out, size, spec, (long double)value);
+        return snprintf(out, size, spec, value);
+      }
+    }
+  }
+};
+
+#ifdef USE_CONCURRENCY
+/**
+ * @brief Low priority FreeRTOS task which prints the deferred log records
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioLoggerDeferredTask {
+ public:
+  /// Starts the recording and the task which prints the records
+  bool begin(int stackSize = 3 * 1024, int priority = 0, int core = -1,
+             int delayMs = 10) {
+    AudioLoggerDeferred::instance().begin();
+    task.create("deferred-log", stackSize, priority, core);
+    return task.begin([delayMs]() {
+      if (AudioLoggerDeferred::instance().process() == 0) delay(delayMs);
+    });
+  }
+
+  /// Stops the task and prints the remaining records
+  void end() {
+    task.end();
+    AudioLoggerDeferred::instance().end();
+  }
+
+ protected:
+  Task task;
+};
+#endif
+
+}  // namespace audio_tools
@@ -0,0 +1,265 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioStreams.h"
+#include "AudioTools/Buffers.h"
+#include "AudioTools/LatencyTracer.h"
+#include "AudioTools/Profiler.h"
+
+/// Mime type of the Prometheus text exposition format
+#define AUDIO_METRICS_MIME "text/plain; version=0.0.4"
+
+namespace audio_tools {
+
+/**
+ * @brief Collects the telemetry of a processing chain (Profiler stages,
+ * VolumeMeter levels, LatencyTracer stages, buffer fill levels, the tracked
+ * allocators and custom values) and provides it in the Prometheus text
+ * exposition format: e.g. to be served by the AudioServer on /metrics.
+ *
+ * The values are read directly from the measuring objects without any
+ * locking, so the audio task is never blocked: a value might therefore
+ * be from a slightly different point in time than its neighbours.
+ * @code
+ * AudioMetrics metrics;
+ * metrics.addProfiler(profiler);
+ * metrics.addBuffer(buffer, "i2s");
+ * server.setMetrics(metrics);
+ * @endcode
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioMetrics {
+ public:
+  /// Reports calls, time, bytes, fill level, underruns and overruns of the
+  /// stages
+  void addProfiler(Profiler &profiler) { add(TypeProfiler, &profiler, ""); }
+
+  /// Reports the volume and rms level in dB
+  void addVolumeMeter(VolumeMeter &meter, const char *name) {
+    add(TypeVolumeMeter, &meter, name);
+  }
+
+  /// Reports the latency of the stages
+  void addLatencyTracer(LatencyTracer &tracer) {
+    add(TypeLatency, &tracer, "");
+  }
+
+  /// Reports the fill level and size of the buffer
+  void addBuffer(BaseBuffer<uint8_t> &buffer, const char *name) {
+    add(TypeBuffer, &buffer, name);
+  }
+
+  /// Reports the current and peak bytes of all AllocatorTracked components
+  void addAllocators() { add(TypeAllocators, nullptr, ""); }
+
+  /// Reports a custom value: the name must be a valid metric name
+  void addValue(const char *name, const char *help, float (*value)(void *ref),
+                void *ref = nullptr, bool isCounter = false) {
+    Entry entry;
+    entry.type = TypeValue;
+    entry.name = name;
+    entry.help = help;
+    entry.value = value;
+    entry.ref = ref;
+    entry.is_counter = isCounter;
+    entries.push_back(entry);
+  }
+
+  /// Prefix of the metric names (default "audio")
+  void setPrefix(const char *prefix) { this->prefix = prefix; }
+
+  /// Writes the metrics in the Prometheus text format
+  void print(Print &out) {
+    p_out = &out;
+    for (auto &entry : entries) {
+      switch (entry.type) {
+        case TypeProfiler:
+          printProfiler(*(Profiler *)entry.ref);
+          break;
+        case TypeVolumeMeter:
+          printVolumeMeter(*(VolumeMeter *)entry.ref, entry.name);
+          break;
+        case TypeLatency:
+          printLatency(*(LatencyTracer *)entry.ref);
+          break;
+        case TypeBuffer:
+          printBuffer(*(BaseBuffer<uint8_t> *)entry.ref, entry.name);
+          break;
+        case TypeAllocators:
+          printAllocators();
+          break;
+        case TypeValue:
+          header(entry.name, entry.help, entry.is_counter);
+          value(entry.name, nullptr, nullptr, entry.value(entry.ref));
+          break;
+      }
+    }
+    p_out = nullptr;
+  }
+
+  /// Provides the metrics in the Prometheus text format as string: the
+  /// result is valid until the next call
+  const char *text() {
+    text_out.clear();
+    print(text_out);
+    return text_out.c_str();
+  }
+
+ protected:
+  /// Print which collects the output in memory
+  class TextPrint : public Print {
+   public:
+    size_t write(uint8_t ch) override {
+      if (data.size() > 0) data.pop_back();
+      data.push_back(ch);
+      data.push_back(0);
+      return 1;
+    }
+    void clear() {
+      data.clear();
+      data.push_back(0);
+    }
+    const char *c_str() { return (const char *)data.data(); }
+
+   protected:
+    Vector<char> data{0};
+  } text_out;
+
+  enum Type {
+    TypeProfiler,
+    TypeVolumeMeter,
+    TypeLatency,
+    TypeBuffer,
+    TypeAllocators,
+    TypeValue
+  };
+  struct Entry {
+    Type type = TypeValue;
+    void *ref = nullptr;
+    const char *name = "";
+    const char *help = "";
+    float (*value)(void *ref) = nullptr;
+    bool is_counter = false;
+  };
+  Vector<Entry> entries;
+  const char *prefix = "audio";
+  Print *p_out = nullptr;
+
+  void add(Type type, void *ref, const char *name) {
+    Entry entry;
+    entry.type = type;
+    entry.ref = ref;
+    entry.name = name;
+    entries.push_back(entry);
+  }
+
+  /// the lines are terminated with \n only as required by the format
+  void header(const char *name, const char *help, bool isCounter) {
+    char msg[160];
+    snprintf(msg, sizeof(msg), "# HELP %s_%s %s\n# TYPE %s_%s %s\n", prefix,
+             name, help, prefix, name, isCounter ? "counter" : "gauge");
+    p_out->print(msg);
+  }
+
+  void value(const char *name, const char *label, const char *labelValue,
+             double value) {
+    char msg[160];
+    if (label != nullptr) {
+      snprintf(msg, sizeof(msg), "%s_%s{%s=\"%s\"} %.10g\n", prefix, name, label,
+               labelValue, value);
+    } else {
+      snprintf(msg, sizeof(msg), "%s_%s %.10g\n", prefix, name, value);
+    }
+    p_out->print(msg);
+  }
+
+  void printProfiler(Profiler &profiler) {
+    int n = profiler.size();
+    header("stage_calls_total", "Number of calls of the stage", true);
+    for (int j = 0; j < n; j++) {
+      ProfileStats &s = profiler.stats(j);
+      value("stage_calls_total", "stage", s.name, s.calls);
+    }
+    header("stage_avg_us", "Average processing time per call in us", false);
+    for (int j = 0; j < n; j++) {
+      ProfileStats &s = profiler.stats(j);
+      value("stage_avg_us", "stage", s.name, s.avgUs());
+    }
+    header("stage_max_us", "Max processing time of a call in us", false);
+    for (int j = 0; j < n; j++) {
+      ProfileStats &s = profiler.stats(j);
+      value("stage_max_us", "stage", s.name, s.maxUs());
+    }
+    header("stage_bytes_total", "Bytes processed by the stage", true);
+    for (int j = 0; j < n; j++) {
+      ProfileStats &s = profiler.stats(j);
+      value("stage_bytes_total", "stage", s.name, s.bytes_out);
+    }
+    header("stage_fill_min", "Smallest fill level of the target", false);
+    for (int j = 0; j < n; j++) {
+      ProfileStats &s = profiler.stats(j);
+      value("stage_fill_min", "stage", s.name, s.min_fill);
+    }
+    header("stage_underruns_total", "Reads which did not provide any data",
+           true);
+    for (int j = 0; j < n; j++) {
+      ProfileStats &s = profiler.stats(j);
+      value("stage_underruns_total", "stage", s.name, s.underruns);
+    }
+    header("stage_overruns_total", "Writes which could not write all data",
+           true);
+    for (int j = 0; j < n; j++) {
+      ProfileStats &s = profiler.stats(j);
+      value("stage_overruns_total", "stage", s.name, s.overruns);
+    }
+  }
+
+  void printVolumeMeter(VolumeMeter &meter, const char *name) {
+    header("volume_db", "Peak level in dB", false);
+    value("volume_db", "meter", name, meter.volumeDB());
+    header("rms_db", "RMS level in dB", false);
+    value("rms_db", "meter", name, meter.rmsDB());
+  }
+
+  void printLatency(LatencyTracer &tracer) {
+    int n = tracer.size();
+    header("latency_avg_ms", "Average latency from the source in ms", false);
+    for (int j = 0; j < n; j++) {
+      LatencyStats &s = tracer.stats(j);
+      value("latency_avg_ms", "stage", s.name, s.avgMs());
+    }
+    header("latency_max_ms", "Max latency from the source in ms", false);
+    for (int j = 0; j < n; j++) {
+      LatencyStats &s = tracer.stats(j);
+      value("latency_max_ms", "stage", s.name, s.max_us / 1000.0f);
+    }
+  }
+
+  void printBuffer(BaseBuffer<uint8_t> &buffer, const char *name) {
+    header("buffer_fill_bytes", "Bytes in the buffer", false);
+    value("buffer_fill_bytes", "buffer", name, buffer.available());
+    header("buffer_size_bytes", "Size of the buffer", false);
+    value("buffer_size_bytes", "buffer", name, buffer.size());
+  }
+
+  void printAllocators() {
+    header("memory_bytes", "Allocated bytes of the component", false);
+    for (auto p = AllocatorTracked::first(); p != nullptr; p = p->next()) {
+      value("memory_bytes", "component", p->name(), p->size());
+    }
+    header("memory_peak_bytes", "Max allocated bytes of the component", false);
+    for (auto p = AllocatorTracked::first(); p != nullptr; p = p->next()) {
+      value("memory_peak_bytes", "component", p->name(), p->peak());
+    }
+    header("memory_psram_bytes", "Allocated bytes of the component in PSRAM",
+           false);
+    for (auto p = AllocatorTracked::first(); p != nullptr; p = p->next()) {
+      value("memory_psram_bytes", "component", p->name(), p->externalSize());
+    }
+  }
+};
+
+}  // namespace audio_tools
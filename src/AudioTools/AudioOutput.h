@@ -1,9 +1,16 @@
 #pragma once
 #include "AudioConfig.h"
 #include "AudioTools/AudioTypes.h"
+#include "AudioTools/AudioKernels.h"
 #include "AudioTools/BaseConverter.h"
 #include "AudioTools/Buffers.h"
 
+/// Max number of frames which are distributed to the outputs in one block by
+/// the ChannelScatter
+#ifndef CHANNEL_SCATTER_FRAMES
+#  define CHANNEL_SCATTER_FRAMES 128
+#endif
+
 namespace audio_tools {
 
 #if USE_PRINT_FLUSH
@@ -21,6 +28,7 @@ class AudioOutput : public Print,
                     public AudioInfoSupport,
                     public AudioInfoSource {
 public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_STREAM)
   virtual ~AudioOutput() = default;
 
   virtual size_t write(const uint8_t *data, size_t len) override = 0;
@@ -39,6 +47,7 @@ public:
   virtual void flush() PRINT_FLUSH_OVERRIDE {
     if (tmp.available() > 0) {
       write((const uint8_t *)tmp.address(), tmp.available());
+      tmp.reset();
     }
   }
 
@@ -79,6 +88,9 @@ public:
   virtual void end() { is_active = false; }
   operator bool() { return is_active; }
 
+  /// Provides direct access to the memory if supported (or nullptr)
+  virtual BufferProvider *bufferProvider() { return nullptr; }
+
 protected:
   int tmpPos = 0;
   AudioInfo cfg;
@@ -298,8 +310,148 @@ protected:
 using HexDumpStream = HexDumpOutput;
 #endif
 
+/// Magic number at the start of each block of the CaptureOutput
+#define CAPTURE_MAGIC "ACAP"
+/// Size of the header of each block of the CaptureOutput
+#define CAPTURE_HEADER_SIZE 20
+
+/**
+ * @brief Header of a block of the CaptureOutput: all numbers are little
+ * endian.
+ * - 0: magic "ACAP"
+ * - 4: uint32_t sequence number
+ * - 8: uint32_t timestamp in us
+ * - 12: uint32_t sample rate
+ * - 16: uint8_t channels
+ * - 17: uint8_t bits per sample
+ * - 18: uint16_t length of the data which follows the header
+ * @ingroup io
+ */
+struct CaptureHeader {
+  uint32_t sequence = 0;
+  uint32_t timestamp_us = 0;
+  AudioInfo info;
+  uint16_t len = 0;
+
+  /// Writes the header to the indicated memory
+  void encode(uint8_t *out) {
+    memcpy(out, CAPTURE_MAGIC, 4);
+    put32(out + 4, sequence);
+    put32(out + 8, timestamp_us);
+    put32(out + 12, info.sample_rate);
+    out[16] = info.channels;
+    out[17] = info.bits_per_sample;
+    out[18] = len & 0xFF;
+    out[19] = len >> 8;
+  }
+
+  /// Reads the header from the indicated memory: returns false if the magic
+  /// number is not valid
+  bool decode(const uint8_t *in) {
+    if (memcmp(in, CAPTURE_MAGIC, 4) != 0) return false;
+    sequence = get32(in + 4);
+    timestamp_us = get32(in + 8);
+    info.sample_rate = get32(in + 12);
+    info.channels = in[16];
+    info.bits_per_sample = in[17];
+    len = in[18] | (in[19] << 8);
+    return true;
+  }
+
+ protected:
+  static void put32(uint8_t *out, uint32_t value) {
+    for (int j = 0; j < 4; j++) out[j] = value >> (8 * j);
+  }
+  static uint32_t get32(const uint8_t *in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+  }
+};
+
 /**
- * @brief Mixing of multiple outputs to one final output
+ * @brief Binary capture of the audio data e.g. for the analysis on a host:
+ * in contrast to the CsvOutput and HexDumpOutput the data is not formatted,
+ * but sent in raw blocks of max block size bytes with a small CaptureHeader
+ * (format, timestamp, sequence number). Each block is sent with one write, so
+ * that it fits into one UDP datagram. This is fast enough to capture at the
+ * full sample rate over Serial/USB-CDC or UDP. On the desktop the data can
+ * be converted to WAV or CSV with the CaptureReceiver.
+ * @ingroup io
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CaptureOutput : public AudioOutput {
+ public:
+  CaptureOutput(int blockSize = DEFAULT_BUFFER_SIZE) { setBlockSize(blockSize); }
+
+  CaptureOutput(Print &out, int blockSize = DEFAULT_BUFFER_SIZE) {
+    setOutput(out);
+    setBlockSize(blockSize);
+  }
+
+  /// Defines the output
+  void setOutput(Print &out) { p_out = &out; }
+
+  /// Defines the max number of audio bytes per block (max 65535)
+  void setBlockSize(int size) { block_size = min(size, 65535); }
+
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    frame.resize(CAPTURE_HEADER_SIZE + block_size);
+    header.sequence = 0;
+    is_active = p_out != nullptr;
+    return is_active;
+  }
+
+  void end() override { is_active = false; }
+
+  /// Sends the data in blocks with a header
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!is_active) return 0;
+    size_t result = 0;
+    while (result < len) {
+      int n = min(len - result, (size_t)block_size);
+      header.info = audioInfo();
+      header.timestamp_us = micros();
+      header.len = n;
+      header.encode(frame.data());
+      memcpy(frame.data() + CAPTURE_HEADER_SIZE, data + result, n);
+      p_out->write(frame.data(), CAPTURE_HEADER_SIZE + n);
+      header.sequence++;
+      result += n;
+    }
+    return len;
+  }
+
+  int availableForWrite() override {
+    return p_out == nullptr ? 0 : DEFAULT_BUFFER_SIZE;
+  }
+
+  /// Number of sent blocks
+  uint32_t blockCount() { return header.sequence; }
+
+ protected:
+  Print *p_out = nullptr;
+  int block_size = DEFAULT_BUFFER_SIZE;
+  CaptureHeader header;
+  Vector<uint8_t> frame{0};
+};
+
+/**
+ * @brief Mixing of multiple outputs to one final output. The mixing is done
+ * block by block on the contiguous data of the input buffers: the samples are
+ * multiplied with the normalized Q15 weights and accumulated in a wider type,
+ * which is saturated only once at the end. Changed weights are applied with a
+ * linear gain ramp to avoid zipper noise.
+ *
+ * Inputs can use a different sample rate and number of channels than the
+ * mix bus: define the bus with setAudioInfo() and the input format with
+ * setInputAudioInfo(). The data of these inputs is resampled with a linear
+ * interpolation directly into the accumulator, so no additional
+ * ResampleStream and buffer is needed.
  * @ingroup transform
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -327,10 +479,45 @@ public:
     for (int i = 0; i < count; i++) {
       weights[i] = 1.0;
     }
+    gains.resize(count);
+    target_gains.resize(count);
+    ramp_steps.resize(count);
+    ramp_remaining.resize(count);
+    conversions.resize(count);
+    for (int i = 0; i < count; i++) {
+      conversions[i] = InputConversion();
+    }
 
     update_total_weights();
   }
 
+  /// Defines the format of the mix bus (final output): needed for inputs
+  /// with a different format
+  void setAudioInfo(AudioInfo info) {
+    bus_info = info;
+    for (int j = 0; j < output_count; j++) updateConversion(j);
+  }
+
+  /// Defines the sample rate and channels of the indicated input: if they
+  /// differ from the mix bus, the input is converted while mixing
+  void setInputAudioInfo(int idx, AudioInfo info) {
+    if (idx >= output_count) {
+      LOGE("Invalid channel %d - max is %d", idx, size() - 1);
+      return;
+    }
+    if (info.channels > OUTPUT_MIXER_MAX_CHANNELS) {
+      LOGE("Unsupported channels: %d", info.channels);
+      return;
+    }
+    conversions[idx].info = info;
+    conversions[idx].is_defined = true;
+    updateConversion(idx);
+  }
+
+  /// Defines the length of the gain ramp (in samples) which is used when a
+  /// weight is changed: 0 changes the weight immediately
+  void setWeightRampSamples(int samples) { ramp_samples = samples; }
+
   /// Defines a new weight for the indicated channel: If you set it to 0.0 it is
   /// muted. The initial value is 1.0
   void setWeight(int channel, float weight) {
@@ -350,6 +537,7 @@ public:
     stream_idx = 0;
     memory_type = memoryType;
     allocate_buffers(size_bytes);
+    update_total_weights();
     return true;
   }
 
@@ -421,23 +609,19 @@ public:
   /// Force output to final destination
   void flushMixer() {
     LOGD("flush");
-    bool result = false;
 
     // determine ringbuffer with mininum available data
     size_t samples = availableSamples();
     // sum up samples
     if (samples > 0) {
-      result = true;
       // mix data from ringbuffers to output
       output.resize(samples);
-      memset(output.data(), 0, samples * sizeof(T));
+      accumulator.resize(samples);
+      memset(accumulator.data(), 0, samples * sizeof(Acc));
       for (int j = 0; j < output_count; j++) {
-        float weight = weights[j];
-        // sum up input samples to result samples
-        for (int i = 0; i < samples; i++) {
-          output[i] += weight * buffers[j]->read() / total_weights;
-        }
+        mix(j, samples);
       }
+      AudioKernels::fromQ15(output.data(), accumulator.data(), samples);
 
       // write output
       LOGD("write to final out: %d", samples * sizeof(T));
@@ -450,9 +634,10 @@ public:
   int availableSamples() {
     size_t samples = 0;
     for (int j = 0; j < output_count; j++) {
-      int available_samples = buffers[j]->available();
+      int available_samples = availableBusSamples(j);
       if (available_samples > 0){
-        samples = MIN(size_bytes / sizeof(T), (size_t)available_samples);
+        size_t limit = samples > 0 ? samples : size_bytes / sizeof(T);
+        samples = MIN(limit, (size_t)available_samples);
       }
     }
     return samples;
@@ -495,9 +680,17 @@ public:
   }
 
 protected:
+  typedef typename MixerAccumulator<T>::type Acc;
   Vector<RingBuffer<T> *> buffers{0};
   Vector<T> output{0};
+  Vector<Acc> accumulator{0};
   Vector<float> weights{0};
+  // gains in Q23 (Q15 << 8) so that we can ramp in small steps
+  Vector<int32_t> gains{0};
+  Vector<int32_t> target_gains{0};
+  Vector<int32_t> ramp_steps{0};
+  Vector<int> ramp_remaining{0};
+  int ramp_samples = OUTPUT_MIXER_RAMP_SAMPLES;
   Print *p_final_output = nullptr;
   float total_weights = 0.0;
   bool is_active = false;
@@ -507,12 +700,154 @@ protected:
   MemoryType memory_type;
   void *p_memory = nullptr;
   bool is_auto_index = true;
+  AudioInfo bus_info;
+  /// Format conversion of an input into the mix bus
+  struct InputConversion {
+    AudioInfo info;
+    bool is_defined = false;
+    bool is_active = false;
+    float step = 1.0f;
+    float frac = 1.0f;
+    float prev[OUTPUT_MIXER_MAX_CHANNELS] = {0};
+  };
+  Vector<InputConversion> conversions{0};
+
+  /// Activates the conversion if the input format differs from the bus
+  void updateConversion(int idx) {
+    InputConversion &conv = conversions[idx];
+    AudioInfo &in = conv.info;
+    conv.is_active = conv.is_defined && in.sample_rate > 0 && in.channels > 0 &&
+                     bus_info.sample_rate > 0 && bus_info.channels > 0 &&
+                     (in.sample_rate != bus_info.sample_rate ||
+                      in.channels != bus_info.channels);
+    conv.step = conv.is_active
+                    ? static_cast<float>(in.sample_rate) / bus_info.sample_rate
+                    : 1.0f;
+    conv.frac = 1.0f;
+    memset(conv.prev, 0, sizeof(conv.prev));
+  }
+
+  /// Number of samples of the mix bus which can be provided by the input
+  int availableBusSamples(int idx) {
+    InputConversion &conv = conversions[idx];
+    int available = buffers[idx]->available();
+    if (!conv.is_active) return available;
+    // each output frame needs the following input frame
+    float in_frames = available / conv.info.channels;
+    int frames = ceilf((in_frames - conv.frac) / conv.step) - 1;
+    return frames > 0 ? frames * bus_info.channels : 0;
+  }
 
   void update_total_weights() {
     total_weights = 0.0;
     for (int j = 0; j < weights.size(); j++) {
       total_weights += weights[j];
     }
+    update_gains();
+  }
+
+  /// Determines the normalized Q15 gains and starts the ramps
+  void update_gains() {
+    float sum = 0.0f;
+    for (int j = 0; j < weights.size(); j++) {
+      float gain = total_weights == 0.0f ? 0.0f : weights[j] / total_weights;
+      sum += gain < 0.0f ? -gain : gain;
+    }
+    // limit the sum of the gains to 2.0, so that the accumulator can not
+    // overflow
+    float factor = sum > 2.0f ? 2.0f / sum : 1.0f;
+    for (int j = 0; j < weights.size(); j++) {
+      float gain = total_weights == 0.0f ? 0.0f : weights[j] / total_weights;
+      float target_f = gain * factor * GAIN_Q15_ONE;
+      int32_t target = target_f + (target_f < 0.0f ? -0.5f : 0.5f);
+      target_gains[j] = target << 8;
+      if (!is_active || ramp_samples <= 0) {
+        gains[j] = target_gains[j];
+        ramp_remaining[j] = 0;
+      } else {
+        ramp_remaining[j] = ramp_samples;
+        ramp_steps[j] = (target_gains[j] - gains[j]) / ramp_samples;
+      }
+    }
+  }
+
+  /// Adds the data of the indicated input to the accumulator
+  void mix(int idx, size_t samples) {
+    RingBuffer<T> *p_buffer = buffers[idx];
+    if (conversions[idx].is_active) {
+      mixConverted(idx, samples / bus_info.channels);
+      return;
+    }
+    size_t pos = 0;
+    while (pos < samples) {
+      size_t len = MIN(samples - pos, (size_t)p_buffer->readPtrSize());
+      if (len == 0) break;
+      mixSpan(idx, accumulator.data() + pos, p_buffer->readPtr(), len);
+      p_buffer->consume(len);
+      pos += len;
+    }
+  }
+
+  /// Mixes a contiguous block: the ramp is applied first
+  void mixSpan(int idx, Acc *acc, const T *data, size_t len) {
+    size_t ramp_len = MIN(len, (size_t)ramp_remaining[idx]);
+    if (ramp_len > 0) {
+      gains[idx] = AudioKernels::mixAddRamp(acc, data, ramp_len, gains[idx],
+                                            ramp_steps[idx]);
+      ramp_remaining[idx] -= ramp_len;
+      if (ramp_remaining[idx] == 0) gains[idx] = target_gains[idx];
+    }
+    int32_t gain = gains[idx] >> 8;
+    if (len > ramp_len && gain != 0) {
+      AudioKernels::mixAdd(acc + ramp_len, data + ramp_len, len - ramp_len,
+                           gain);
+    }
+  }
+
+  /// Resamples the input into the accumulator: the ramp is applied first
+  void mixConverted(int idx, size_t frames) {
+    RingBuffer<T> *p_buffer = buffers[idx];
+    InputConversion &conv = conversions[idx];
+    int in_channels = conv.info.channels;
+    int out_channels = bus_info.channels;
+    size_t pos = 0;
+    while (pos < frames) {
+      const T *data = p_buffer->readPtr();
+      size_t in_frames = p_buffer->readPtrSize() / in_channels;
+      T split_frame[OUTPUT_MIXER_MAX_CHANNELS];
+      bool is_split = in_frames == 0;
+      if (is_split) {
+        // the frame is split by the end of the ring buffer
+        if (p_buffer->peekArray(split_frame, in_channels) < in_channels) break;
+        data = split_frame;
+        in_frames = 1;
+      }
+      size_t out_frames = frames - pos;
+      int32_t step = 0;
+      if (ramp_remaining[idx] > 0) {
+        out_frames = MIN(out_frames, (size_t)(ramp_remaining[idx] + out_channels - 1) / out_channels);
+        step = ramp_steps[idx];
+      }
+      size_t consumed = 0;
+      size_t produced = AudioKernels::mixAddResample(
+          accumulator.data() + pos * out_channels, out_frames, out_channels,
+          data, in_frames, in_channels, conv.prev, conv.frac, conv.step,
+          gains[idx], step, consumed);
+      if (step != 0) {
+        ramp_remaining[idx] -= produced * out_channels;
+        if (ramp_remaining[idx] <= 0) {
+          ramp_remaining[idx] = 0;
+          gains[idx] = target_gains[idx];
+        }
+      }
+      if (is_split) {
+        if (consumed > 0) p_buffer->readArray(split_frame, in_channels);
+      } else {
+        p_buffer->consume(consumed * in_channels);
+      }
+      pos += produced;
+      if (produced == 0 && consumed == 0) break;
+    }
   }
 
   void allocate_buffers(int size) {
@@ -610,9 +945,129 @@ protected:
 using MemoryPrint = MemoryOutput;
 #endif
 
+/**
+ * @brief Distributes the selected channels of interleaved frames to multiple
+ * outputs: the input is processed in a single pass and each selected sample
+ * is copied to the preallocated (interleaved) buffer of the output, so that
+ * we need only one write per output for each block of frames. Used by
+ * ChannelSplitOutput and ChannelsSelectOutput.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ChannelScatter {
+ public:
+  /// Removes all outputs
+  void clear() {
+    outputs.clear();
+    entries.clear();
+    is_ready = false;
+  }
+
+  /// Adds an output with the indicated source channels and returns its index
+  int addOutput(const uint16_t *channels, int count) {
+    Output out;
+    out.channels = count;
+    out.first_entry = entries.size();
+    for (int j = 0; j < count; j++) {
+      Entry entry;
+      entry.channel = channels[j];
+      entries.push_back(entry);
+    }
+    outputs.push_back(out);
+    is_ready = false;
+    return outputs.size() - 1;
+  }
+
+  /// Allocates the buffers for the indicated input format: invalid channels
+  /// are replaced by the last channel
+  bool begin(int channels, int bytesPerSample) {
+    if (channels <= 0 || bytesPerSample <= 0) return false;
+    in_channels = channels;
+    bytes_per_sample = bytesPerSample;
+    int total = 0;
+    for (auto &out : outputs) {
+      for (int j = 0; j < out.channels; j++) {
+        Entry &entry = entries[out.first_entry + j];
+        entry.from = entry.channel < channels ? entry.channel : channels - 1;
+        entry.to = total + j;
+        entry.stride = out.channels;
+      }
+      out.offset = total;
+      total += out.channels * CHANNEL_SCATTER_FRAMES;
+    }
+    memory.resize(total * bytesPerSample);
+    is_ready = (int)memory.size() == total * bytesPerSample;
+    return is_ready;
+  }
+
+  /// Returns true if begin() was called with the indicated format
+  bool isReady(int channels, int bytesPerSample) {
+    return is_ready && channels == in_channels &&
+           bytesPerSample == bytes_per_sample;
+  }
+
+  /// Number of outputs
+  int size() { return outputs.size(); }
+
+  /// Number of channels of the indicated output
+  int channels(int out) { return outputs[out].channels; }
+
+  /// Max number of frames which are processed with one scatter() call
+  int maxFrames() { return CHANNEL_SCATTER_FRAMES; }
+
+  /// Copies max CHANNEL_SCATTER_FRAMES frames to the buffers of the outputs
+  /// and returns the number of processed frames
+  template <typename T>
+  int scatter(const T *data, int frames) {
+    if (frames > CHANNEL_SCATTER_FRAMES) frames = CHANNEL_SCATTER_FRAMES;
+    T *base = (T *)memory.data();
+    const int channels = in_channels;
+    const int count = entries.size();
+    const Entry *p_entries = entries.data();
+    for (int f = 0; f < frames; f++) {
+      const T *frame = data + f * channels;
+      for (int j = 0; j < count; j++) {
+        const Entry &entry = p_entries[j];
+        base[entry.to + f * entry.stride] = frame[entry.from];
+      }
+    }
+    return frames;
+  }
+
+  /// Provides the scattered data of the output
+  const uint8_t *data(int out) {
+    return memory.data() + outputs[out].offset * bytes_per_sample;
+  }
+
+  /// Number of bytes for the indicated output and frames
+  size_t bytes(int out, int frames) {
+    return frames * outputs[out].channels * bytes_per_sample;
+  }
+
+ protected:
+  struct Entry {
+    uint16_t channel = 0;
+    uint16_t from = 0;
+    uint16_t stride = 1;
+    int to = 0;
+  };
+  struct Output {
+    int channels = 0;
+    int first_entry = 0;
+    int offset = 0;
+  };
+  Vector<Entry> entries{0};
+  Vector<Output> outputs{0};
+  Vector<uint8_t> memory{0};
+  int in_channels = 0;
+  int bytes_per_sample = 0;
+  bool is_ready = false;
+};
+
 /**
  * @brief Simple functionality to extract mono streams from a multichannel (e.g.
- * stereo) signal. 
+ * stereo) signal. The input is processed in one pass with the ChannelScatter.
  * @ingroup transform
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -627,10 +1082,9 @@ public:
   /// Define the channel to be sent to the specified output. 0: first (=left)
   /// channel, 1: second (=right) channel
   void addOutput(Print &out, int channel) {
-    ChannelSelectionOutputDef def;
-    def.channel = channel;
-    def.p_out = &out;
-    out_channels.push_back(def);
+    uint16_t ch = channel;
+    scatter.addOutput(&ch, 1);
+    p_outputs.push_back(&out);
   }
 
   size_t write(const uint8_t *data, size_t len) override {
@@ -647,32 +1101,28 @@ public:
   }
 
 protected:
-  struct ChannelSelectionOutputDef {
-    Print *p_out = nullptr;
-    int channel;
-  };
-  Vector<ChannelSelectionOutputDef> out_channels;
+  ChannelScatter scatter;
+  Vector<Print *> p_outputs{0};
 
   template <typename T> 
   size_t writeT(const uint8_t *buffer, size_t size) {
-    int sample_count = size / sizeof(T);
-    int result_size = sample_count / cfg.channels;
-    T *data = (T *)buffer;
-    T result[result_size];
-
-    for (int ch = 0; ch < out_channels.size(); ch++) {
-      ChannelSelectionOutputDef &def = out_channels[ch];
-      // extract mono result
-      int i = 0;
-      for (int j = def.channel; j < sample_count; j += cfg.channels) {
-        result[i++] = data[j];
-      }
-      // write mono result
-      size_t written =
-          def.p_out->write((uint8_t *)result, result_size * sizeof(T));
-      if (written != result_size * sizeof(T)) {
-        LOGW("Could not write all samples");
+    if (!scatter.isReady(cfg.channels, sizeof(T)) &&
+        !scatter.begin(cfg.channels, sizeof(T))) {
+      return 0;
+    }
+    int frames = size / sizeof(T) / cfg.channels;
+    const T *data = (const T *)buffer;
+    while (frames > 0) {
+      int n = scatter.scatter(data, frames);
+      for (int j = 0; j < scatter.size(); j++) {
+        size_t bytes = scatter.bytes(j, n);
+        size_t written = p_outputs[j]->write(scatter.data(j), bytes);
+        if (written != bytes) {
+          LOGW("Could not write all samples");
+        }
       }
+      data += n * cfg.channels;
+      frames -= n;
     }
     return size;
   }
@@ -2,6 +2,7 @@
 
 #include "AudioBasic/Debouncer.h"
 #include "AudioBasic/Str.h"
+#include "AudioCodecs/SeekIndex.h"
 #include "AudioConfig.h"
 #include "AudioHttp/AudioHttp.h"
 #include "AudioTools/AudioLogger.h"
@@ -26,6 +27,87 @@
 
 namespace audio_tools {
 
+/**
+ * @brief Output used by the AudioPlayer for the crossfade: the decoded data
+ * is delayed by the crossfade length, so that at the end of a track the last
+ * part is still available to be mixed with the start of the next track.
+ * Only 16 bit PCM data is supported.
+ * @ingroup player
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CrossfadeOutput : public AudioOutput {
+ public:
+  void setOutput(Print &out) { p_out = &out; }
+
+  /// Defines the delay (=crossfade length) in bytes: 0 deactivates the delay
+  void resize(int bytes) {
+    delay.resize(bytes);
+    delay.reset();
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_out == nullptr) return 0;
+    if (delay.size() == 0) return p_out->write(data, len);
+    size_t pos = 0;
+    while (pos < len) {
+      // output the oldest data to make room
+      if (delay.availableForWrite() == 0) {
+        int n = min((size_t)delay.readPtrSize(), len - pos);
+        delay.consume(p_out->write(delay.readPtr(), n));
+      }
+      pos += delay.writeArray(data + pos, len - pos);
+    }
+    return len;
+  }
+
+  int availableForWrite() override {
+    return p_out == nullptr ? 0 : p_out->availableForWrite();
+  }
+
+  /// Mixes the delayed data (fading out) with the provided data (fading in)
+  /// and writes the result: the delay is empty afterwards
+  void crossfade(const uint8_t *data, size_t len) {
+    if (p_out == nullptr) return;
+    size_t delayed = delay.available();
+    size_t mix = min(delayed, len) & ~(size_t)1;
+    // output the delayed data which is not mixed
+    writeDelayed(delayed - mix);
+    int16_t tmp[64];
+    const int16_t *in = (const int16_t *)data;
+    int samples = mix / 2;
+    for (int j = 0; j < samples; j += 64) {
+      int n = min(64, samples - j);
+      delay.readArray((uint8_t *)tmp, n * 2);
+      for (int k = 0; k < n; k++) {
+        int32_t fade_in = ((int64_t)(j + k) << 15) / samples;
+        tmp[k] = (tmp[k] * (32768 - fade_in) + in[j + k] * fade_in) >> 15;
+      }
+      p_out->write((const uint8_t *)tmp, n * 2);
+    }
+    if (len > mix) p_out->write(data + mix, len - mix);
+  }
+
+  /// Writes out all delayed data
+  void flush() override { writeDelayed(delay.available()); }
+
+  /// Discards the delayed data
+  void clear() { delay.reset(); }
+
+ protected:
+  Print *p_out = nullptr;
+  RingBuffer<uint8_t> delay{0};
+
+  void writeDelayed(size_t len) {
+    while (len > 0 && delay.available() > 0) {
+      int n = min((size_t)delay.readPtrSize(), len);
+      p_out->write(delay.readPtr(), n);
+      delay.consume(n);
+      len -= n;
+    }
+  }
+};
+
 /**
  * @brief Implements a simple audio player which supports the following
  * commands:
@@ -57,6 +139,7 @@ public:
     TRACED();
     this->p_source = &source;
     this->p_decoder = &decoder;
+    decoder.setReuseMemory(true);
     setOutput(output);
     // notification for audio configuration
     decoder.addNotifyAudioChange(*this);
@@ -77,6 +160,7 @@ public:
     TRACED();
     this->p_source = &source;
     this->p_decoder = &decoder;
+    decoder.setReuseMemory(true);
     setOutput(output);
     addNotifyAudioChange(notify);
   }
@@ -94,6 +178,7 @@ public:
     TRACED();
     this->p_source = &source;
     this->p_decoder = &decoder;
+    decoder.setReuseMemory(true);
     setOutput(output);
     // notification for audio configuration
     decoder.addNotifyAudioChange(*this);
@@ -115,6 +200,7 @@ public:
     }
     this->p_final_print = &output;
     this->p_final_stream = nullptr;
+    this->p_final_output = &output;
   }
 
   void setOutput(Print &output) {
@@ -129,6 +215,7 @@ public:
     }
     this->p_final_print = nullptr;
     this->p_final_stream = nullptr;
+    this->p_final_output = &output;
   }
 
   void setOutput(AudioStream &output) {
@@ -143,11 +230,30 @@ public:
     }
     this->p_final_print = nullptr;
     this->p_final_stream = &output;
+    this->p_final_output = &output;
   }
 
   /// Defines the number of bytes used by the copier
   virtual void setBufferSize(int size) { copier.resize(size); }
 
+  /// Activates the gapless prefetch: when the remaining data of the actual
+  /// stream is <= bytes, it is loaded into memory, the next stream is opened
+  /// and its first bytes are buffered, so that the transition at the end of
+  /// the track is an instant switch. This requires a source which reports the
+  /// remaining bytes with available() (e.g. files). 0 deactivates it.
+  void setPrefetchSize(size_t bytes) { prefetch_size = bytes; }
+
+  /// Defines an optional second decoder instance (of the same type) which is
+  /// used to pre-decode the start of the next stream during the prefetch.
+  void setPrefetchDecoder(AudioDecoder &decoder) {
+    p_prefetch_decoder = &decoder;
+    decoder.addNotifyAudioChange(*this);
+  }
+
+  /// Defines the crossfade length between the tracks: it requires a
+  /// prefetch decoder and 16 bit PCM data. Call before begin().
+  void setCrossfadeMs(int ms) { crossfade_ms = ms; }
+
   /// (Re)Starts the playing of the music (from the beginning)
   virtual bool begin(int index = 0, bool isActive = true) {
     TRACED();
@@ -164,6 +270,7 @@ public:
 
     // initial audio info for fade from output when not defined yet
     setupFade();
+    setupCrossfade();
 
     // start dependent objects
     out_decoding.begin();
@@ -173,9 +280,8 @@ public:
     if (index >= 0) {
       p_input_stream = p_source->selectStream(index);
       if (p_input_stream != nullptr) {
-        if (meta_active) {
-          copier.setCallbackOnWrite(decodeMetaData, this);
-        }
+        copier.setCallbackOnWrite(decodeData, this);
+        seek_index.begin();
         copier.begin(out_decoding, *p_input_stream);
         timeout = millis() + p_source->timeoutAutoNext();
         active = isActive;
@@ -209,9 +315,11 @@ public:
   /// (Re)defines the audio source
   void setAudioSource(AudioSource &source) { this->p_source = &source; }
 
-  /// (Re)defines the decoder
+  /// (Re)defines the decoder: the decoder keeps its memory from one track
+  /// to the next (see AudioDecoder::setReuseMemory())
   void setDecoder(AudioDecoder &decoder) {
     this->p_decoder = &decoder;
+    p_decoder->setReuseMemory(true);
     out_decoding.setDecoder(p_decoder);
   }
 
@@ -297,16 +405,55 @@ public:
   /// start selected input stream
   virtual bool setStream(Stream *input) {
     end();
+    endPrefetch();
     out_decoding.begin();
     p_input_stream = input;
     if (p_input_stream != nullptr) {
       LOGD("open selected stream");
       meta_out.begin();
+      seek_index.begin();
       copier.begin(out_decoding, *p_input_stream);
     }
     return p_input_stream != nullptr;
   }
 
+  /// Moves to the indicated time position (in ms) of the actual stream. This
+  /// is supported for MP3, AAC (ADTS), WAV and MP4 data if the AudioSource
+  /// supports seek() (e.g. files). Positions which have not been played yet
+  /// are estimated from the TOC or the average bitrate.
+  virtual bool seek(uint32_t ms) {
+    TRACEI();
+    if (p_input_stream == nullptr || is_prefetched || !is_seek_active) {
+      LOGW("seek not possible");
+      return false;
+    }
+    long pos = seek_index.bytePosition(ms);
+    if (pos < 0) {
+      LOGW("seek to %u ms not supported", (unsigned)ms);
+      return false;
+    }
+    if (is_auto_fade) {
+      fade.setFadeOutActive(true);
+      copier.copy();
+    }
+    if (!p_source->seek(pos)) {
+      LOGW("seek to pos %ld failed", pos);
+      return false;
+    }
+    // the decoder continues with the data at the new position
+    p_decoder->notifySeek(pos - (long)seek_index.streamPosition());
+    seek_index.setStreamPosition(pos);
+    if (is_auto_fade) fade.setFadeInActive(true);
+    timeout = millis() + p_source->timeoutAutoNext();
+    return true;
+  }
+
+  /// Activates the seek index which is needed by seek() (default: true)
+  void setSeekActive(bool active) { is_seek_active = active; }
+
+  /// Provides the seek index of the actual stream
+  SeekIndex &seekIndex() { return seek_index; }
+
   /// Provides the actual stream (=e.g.file)
   virtual Stream *getStream() { return p_input_stream; }
 
@@ -357,6 +504,18 @@ public:
   /// Defines the wait time in ms if the target output is full
   virtual void setDelayIfOutputFull(int delayMs) { delay_if_full = delayMs; }
 
+  /// Offline (batch) processing which runs faster than real time: we do not
+  /// wait for the output and move to the next file as soon as the current
+  /// stream has ended (w/o waiting for the timeout)
+  virtual void setOffline(bool flag, int bufferSize = BATCH_BUFFER_SIZE) {
+    is_offline = flag;
+    delay_if_full = flag ? 0 : 100;
+    copier.setOffline(flag, bufferSize);
+  }
+
+  /// Is the offline (batch) processing active ?
+  bool isOffline() { return is_offline; }
+
   virtual size_t copy() {
     return copy(copier.bufferSize());
   }
@@ -375,11 +534,17 @@ public:
         return 0;
       }
       // handle sound
-      result = copier.copyBytes(bytes);
+      if (!is_prefetched) checkPrefetch();
+      result = is_prefetched ? copyPrefetched(bytes) : copier.copyBytes(bytes);
       if (result > 0 || timeout == 0) {
         // reset timeout if we had any data
         timeout = millis() + p_source->timeoutAutoNext();
       }
+      // in offline mode we do not wait for more data
+      if (is_offline && result == 0 && !is_prefetched &&
+          (p_input_stream == nullptr || p_input_stream->available() <= 0)) {
+        timeout = 0;
+      }
       // move to next stream after timeout
       moveToNextFileOnTimeout();
 
@@ -432,7 +597,7 @@ public:
   bool isSilenceOnInactive() { return silence_on_inactive; }
 
   /// Sends the requested bytes as 0 values to the output
-  void writeSilence(size_t bytes) {
+  virtual void writeSilence(size_t bytes) {
     TRACEI();
     if (p_final_print != nullptr) {
       p_final_print->writeSilence(bytes);
@@ -464,6 +629,7 @@ protected:
   Stream *p_input_stream = nullptr;
   AudioOutput *p_final_print = nullptr;
   AudioStream *p_final_stream = nullptr;
+  Print *p_final_output = nullptr;
   AudioInfoSupport *p_final_notify = nullptr;
   StreamCopy copier; // copies sound into i2s
   AudioInfo info;
@@ -472,7 +638,163 @@ protected:
   int stream_increment = 1;    // +1 moves forward; -1 moves backward
   float current_volume = -1.0f; // illegal value which will trigger an update
   int delay_if_full = 100;
+  bool is_offline = false;
   bool is_auto_fade = true;
+  bool is_seek_active = true;
+  SeekIndex seek_index;
+  /// Captures the pre-decoded data of the next stream
+  class PredecodedOutput : public AudioOutput {
+   public:
+    Vector<uint8_t> data{0};
+    size_t write(const uint8_t *in, size_t len) override {
+      int size = data.size();
+      data.resize(size + len);
+      memcpy(data.data() + size, in, len);
+      return len;
+    }
+  } predecoded;
+  CrossfadeOutput crossfade;
+  AudioDecoder *p_prefetch_decoder = nullptr;
+  Stream *p_next_stream = nullptr;
+  Vector<uint8_t> tail{0};
+  Vector<uint8_t> head{0};
+  size_t tail_pos = 0;
+  size_t prefetch_size = 0;
+  int crossfade_ms = 0;
+  bool is_prefetched = false;
+
+  bool isCrossfade() {
+    return crossfade_ms > 0 && p_prefetch_decoder != nullptr &&
+           p_decoder->isResultPCM();
+  }
+
+  /// Number of bytes which are mixed in the crossfade
+  size_t crossfadeBytes() {
+    AudioInfo cfg = fade.audioInfo();
+    return (uint64_t)crossfade_ms * cfg.sample_rate / 1000 * cfg.channels * 2;
+  }
+
+  /// Delays the decoded data by the crossfade length
+  void setupCrossfade() {
+    if (!isCrossfade()) return;
+    if (fade.audioInfo().bits_per_sample != 16) {
+      LOGW("crossfade requires 16 bits");
+    }
+    crossfade.resize(crossfadeBytes());
+    crossfade.setOutput(volume_out);
+    out_decoding.setOutput(&crossfade);
+  }
+
+  /// Loads the rest of the actual stream and the start of the next stream
+  void checkPrefetch() {
+    if (prefetch_size == 0 || !autonext || p_input_stream == nullptr) return;
+    int available = p_input_stream->available();
+    if (available <= 0 || available > (int)prefetch_size) return;
+    TRACEI();
+    // the source might reuse the stream object: so we read it to the end
+    tail.resize(available);
+    tail_pos = 0;
+    size_t len = 0;
+    while (len < tail.size()) {
+      int read = p_input_stream->readBytes(tail.data() + len, tail.size() - len);
+      if (read <= 0) break;
+      len += read;
+    }
+    tail.resize(len);
+    is_prefetched = true;
+
+    p_next_stream = p_source->nextStream(stream_increment);
+    if (p_next_stream == nullptr) return;
+    head.resize(prefetch_size);
+    len = p_next_stream->readBytes(head.data(), prefetch_size);
+    head.resize(len);
+    // the seek index continues with the next stream
+    seek_index.begin();
+    if (is_seek_active) seek_index.write(head.data(), len);
+
+    if (p_prefetch_decoder != nullptr) predecode();
+  }
+
+  /// Decodes the start of the next stream with the second decoder: we stop
+  /// as soon as we have enough data for the crossfade
+  void predecode() {
+    predecoded.data.clear();
+    p_prefetch_decoder->setOutput(predecoded);
+    p_prefetch_decoder->begin();
+    size_t needed = isCrossfade() ? crossfadeBytes() : 1;
+    size_t pos = 0;
+    while (pos < head.size() && predecoded.data.size() < needed) {
+      size_t n = min((size_t)256, head.size() - pos);
+      p_prefetch_decoder->write(head.data() + pos, n);
+      pos += n;
+    }
+    // remove the consumed data
+    memmove(head.data(), head.data() + pos, head.size() - pos);
+    head.resize(head.size() - pos);
+  }
+
+  /// Feeds the tail of the actual stream and switches to the next stream at
+  /// the end
+  size_t copyPrefetched(size_t bytes) {
+    size_t n = min(bytes, tail.size() - tail_pos);
+    if (n > 0) {
+      size_t result = out_decoding.write(tail.data() + tail_pos, n);
+      tail_pos += result;
+      return result;
+    }
+    switchToNext();
+    return 0;
+  }
+
+  /// Sample accurate switch to the prefetched stream
+  void switchToNext() {
+    TRACEI();
+    is_prefetched = false;
+    tail.resize(0);
+    p_input_stream = p_next_stream;
+    p_next_stream = nullptr;
+    if (p_input_stream == nullptr) {
+      // no next stream: output the delayed data
+      if (isCrossfade()) crossfade.flush();
+      return;
+    }
+    if (p_prefetch_decoder != nullptr) {
+      // continue with the pre-decoded data and the second decoder
+      if (isCrossfade()) {
+        crossfade.crossfade(predecoded.data.data(), predecoded.data.size());
+      } else {
+        Print *out = p_decoder->isResultPCM() ? (Print *)&volume_out
+                                              : p_final_output;
+        out->write(predecoded.data.data(), predecoded.data.size());
+      }
+      predecoded.data.clear();
+      p_decoder->end();
+      AudioDecoder *tmp = p_decoder;
+      p_decoder = p_prefetch_decoder;
+      p_prefetch_decoder = tmp;
+      out_decoding.setDecoder(p_decoder);
+    } else {
+      // reset the decoder w/o any fade or silence
+      p_decoder->end();
+      p_decoder->begin();
+    }
+    if (head.size() > 0) out_decoding.write(head.data(), head.size());
+    head.resize(0);
+    copier.begin(out_decoding, *p_input_stream);
+    timeout = millis() + p_source->timeoutAutoNext();
+  }
+
+  void endPrefetch() {
+    if (is_prefetched && p_prefetch_decoder != nullptr) {
+      p_prefetch_decoder->end();
+    }
+    is_prefetched = false;
+    p_next_stream = nullptr;
+    crossfade.clear();
+    tail.resize(0);
+    head.resize(0);
+    predecoded.data.clear();
+  }
 
   void setupFade() {
     if (p_final_print != nullptr) {
@@ -517,13 +839,16 @@ protected:
     p_decoder->begin();
   }
 
-  /// Callback implementation which writes to metadata
-  static void decodeMetaData(void *obj, void *data, size_t len) {
+  /// Callback implementation which writes to metadata and the seek index
+  static void decodeData(void *obj, void *data, size_t len) {
     LOGD("%s, %zu", LOG_METHOD, len);
     AudioPlayer *p = (AudioPlayer *)obj;
     if (p->meta_active) {
       p->meta_out.write((const uint8_t *)data, len);
     }
+    if (p->is_seek_active) {
+      p->seek_index.write((const uint8_t *)data, len);
+    }
   }
 };
 
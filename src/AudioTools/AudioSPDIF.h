@@ -22,6 +22,7 @@
 #include "AudioTools/AudioStreams.h"
 #include "AudioI2S/I2SConfig.h"
 #include "AudioI2S/I2SStream.h"
+#include "AudioTools/SPDIFEncoder.h"
 
 // Default Data Pin
 #ifndef SPDIF_DATA_PIN
@@ -45,56 +46,8 @@
 #define SPDIF_BUF_SIZE (SPDIF_BLOCK_SIZE / SPDIF_BUF_DIV)
 #define SPDIF_BUF_ARRAY_SIZE (SPDIF_BUF_SIZE / sizeof(uint32_t))
 
-// BMC preamble
-#define BMC_B 0x33173333  // block start
-#define BMC_M 0x331d3333  // left ch
-#define BMC_W 0x331b3333  // right ch
-#define BMC_MW_DIF (BMC_M ^ BMC_W)
-#define SYNC_OFFSET 2  // byte offset of SYNC
-#define SYNC_FLIP ((BMC_B ^ BMC_M) >> (SYNC_OFFSET * 8))
-
-
 namespace audio_tools {
 
-/*
- * 8bit PCM to 16bit BMC conversion table, LSb first, 1 end
- */
-static const uint16_t bmc_tab_uint[256] = {
-    0x3333, 0xb333, 0xd333, 0x5333, 0xcb33, 0x4b33, 0x2b33, 0xab33, 0xcd33,
-    0x4d33, 0x2d33, 0xad33, 0x3533, 0xb533, 0xd533, 0x5533, 0xccb3, 0x4cb3,
-    0x2cb3, 0xacb3, 0x34b3, 0xb4b3, 0xd4b3, 0x54b3, 0x32b3, 0xb2b3, 0xd2b3,
-    0x52b3, 0xcab3, 0x4ab3, 0x2ab3, 0xaab3, 0xccd3, 0x4cd3, 0x2cd3, 0xacd3,
-    0x34d3, 0xb4d3, 0xd4d3, 0x54d3, 0x32d3, 0xb2d3, 0xd2d3, 0x52d3, 0xcad3,
-    0x4ad3, 0x2ad3, 0xaad3, 0x3353, 0xb353, 0xd353, 0x5353, 0xcb53, 0x4b53,
-    0x2b53, 0xab53, 0xcd53, 0x4d53, 0x2d53, 0xad53, 0x3553, 0xb553, 0xd553,
-    0x5553, 0xcccb, 0x4ccb, 0x2ccb, 0xaccb, 0x34cb, 0xb4cb, 0xd4cb, 0x54cb,
-    0x32cb, 0xb2cb, 0xd2cb, 0x52cb, 0xcacb, 0x4acb, 0x2acb, 0xaacb, 0x334b,
-    0xb34b, 0xd34b, 0x534b, 0xcb4b, 0x4b4b, 0x2b4b, 0xab4b, 0xcd4b, 0x4d4b,
-    0x2d4b, 0xad4b, 0x354b, 0xb54b, 0xd54b, 0x554b, 0x332b, 0xb32b, 0xd32b,
-    0x532b, 0xcb2b, 0x4b2b, 0x2b2b, 0xab2b, 0xcd2b, 0x4d2b, 0x2d2b, 0xad2b,
-    0x352b, 0xb52b, 0xd52b, 0x552b, 0xccab, 0x4cab, 0x2cab, 0xacab, 0x34ab,
-    0xb4ab, 0xd4ab, 0x54ab, 0x32ab, 0xb2ab, 0xd2ab, 0x52ab, 0xcaab, 0x4aab,
-    0x2aab, 0xaaab, 0xcccd, 0x4ccd, 0x2ccd, 0xaccd, 0x34cd, 0xb4cd, 0xd4cd,
-    0x54cd, 0x32cd, 0xb2cd, 0xd2cd, 0x52cd, 0xcacd, 0x4acd, 0x2acd, 0xaacd,
-    0x334d, 0xb34d, 0xd34d, 0x534d, 0xcb4d, 0x4b4d, 0x2b4d, 0xab4d, 0xcd4d,
-    0x4d4d, 0x2d4d, 0xad4d, 0x354d, 0xb54d, 0xd54d, 0x554d, 0x332d, 0xb32d,
-    0xd32d, 0x532d, 0xcb2d, 0x4b2d, 0x2b2d, 0xab2d, 0xcd2d, 0x4d2d, 0x2d2d,
-    0xad2d, 0x352d, 0xb52d, 0xd52d, 0x552d, 0xccad, 0x4cad, 0x2cad, 0xacad,
-    0x34ad, 0xb4ad, 0xd4ad, 0x54ad, 0x32ad, 0xb2ad, 0xd2ad, 0x52ad, 0xcaad,
-    0x4aad, 0x2aad, 0xaaad, 0x3335, 0xb335, 0xd335, 0x5335, 0xcb35, 0x4b35,
-    0x2b35, 0xab35, 0xcd35, 0x4d35, 0x2d35, 0xad35, 0x3535, 0xb535, 0xd535,
-    0x5535, 0xccb5, 0x4cb5, 0x2cb5, 0xacb5, 0x34b5, 0xb4b5, 0xd4b5, 0x54b5,
-    0x32b5, 0xb2b5, 0xd2b5, 0x52b5, 0xcab5, 0x4ab5, 0x2ab5, 0xaab5, 0xccd5,
-    0x4cd5, 0x2cd5, 0xacd5, 0x34d5, 0xb4d5, 0xd4d5, 0x54d5, 0x32d5, 0xb2d5,
-    0xd2d5, 0x52d5, 0xcad5, 0x4ad5, 0x2ad5, 0xaad5, 0x3355, 0xb355, 0xd355,
-    0x5355, 0xcb55, 0x4b55, 0x2b55, 0xab55, 0xcd55, 0x4d55, 0x2d55, 0xad55,
-    0x3555, 0xb555, 0xd555, 0x5555,
-};
-static const int16_t *bmc_tab = (int16_t *)bmc_tab_uint;
-
-static uint32_t spdif_buf[SPDIF_BUF_ARRAY_SIZE];
-static uint32_t *spdif_ptr = nullptr;
-
 /**
  * @brief SPDIF configuration
  * @author Phil Schatzmann
@@ -113,7 +66,9 @@ struct SPDIFConfig : public AudioInfo {
 };
 
 /**
- * @brief Output as 16 bit stereo SPDIF on the I2S data output pin
+ * @brief Output as 16 or 24 bit stereo SPDIF on the I2S data output pin: the
+ * audio data is encoded in blocks directly into the buffer which is passed to
+ * the I2S DMA. Sample rates up to 96000 are supported.
  * @ingroup io
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -135,13 +90,11 @@ class SPDIFOutput : public AudioStream {
     TRACED();
     cfg = config;
     // Some validations to make sure that the config is valid
-    if (!(cfg.channels == 1 || cfg.channels == 2)) {
-      LOGE("Unsupported number of channels: %d", cfg.channels);
+    if (!encoder.begin(cfg)) {
       return false;
     }
-    if (cfg.bits_per_sample != 16) {
-      LOGE("Unsupported bits per sample: %d - must be 16!",
-           cfg.bits_per_sample);
+    if (cfg.sample_rate > 96000) {
+      LOGE("Unsupported sample rate: %d", (int)cfg.sample_rate);
       return false;
     }
 
@@ -150,8 +103,10 @@ class SPDIFOutput : public AudioStream {
     }
 
     // initialize S/PDIF buffer
-    spdif_buf_init();
-    spdif_ptr = spdif_buf;
+    spdif_buf.resize(SPDIF_BUF_ARRAY_SIZE);
+    buf_frames = SPDIF_BUF_ARRAY_SIZE / SPDIF_WORDS_PER_FRAME;
+    buf_pos = 0;
+    partial_len = 0;
 
     // Setup I2S
     int sample_rate = cfg.sample_rate * BMC_BITS_FACTOR;
@@ -164,7 +119,7 @@ class SPDIFOutput : public AudioStream {
 
     I2SConfig i2s_cfg;
     i2s_cfg.sample_rate = sample_rate;
-    i2s_cfg.channels = cfg.channels;
+    i2s_cfg.channels = I2S_CHANNELS;
 #ifndef STM32
     i2s_cfg.pin_ws = -1;
     i2s_cfg.pin_bck = -1;
@@ -194,10 +149,6 @@ class SPDIFOutput : public AudioStream {
   /// Change the audio parameters
   void setAudioInfo(AudioInfo info) {
     TRACED();
-    if (info.bits_per_sample != 16) {
-      LOGE("Unsupported bits per sample: %d - must be 16!",
-           info.bits_per_sample);
-    }
     if (cfg.bits_per_sample != info.bits_per_sample
     || cfg.channels != info.channels
     || cfg.sample_rate != info.sample_rate
@@ -218,49 +169,56 @@ class SPDIFOutput : public AudioStream {
   /// Writes the audio data as SPDIF to the defined output pin
   size_t write(const uint8_t *data, size_t len) {
     if (!i2sOn) return 0;
+    const int frame_size = encoder.frameSize();
     const uint8_t *p = data;
-    size_t result = 0;
-
-    while (p < (uint8_t *)data + len) {
-      // convert PCM 16bit data to BMC 32bit pulse pattern
-      if (cfg.channels == 2) {
-        *(spdif_ptr + 1) =
-            (uint32_t)(((bmc_tab[*p] << 16) ^ bmc_tab[*(p + 1)]) << 1) >> 1;
-        p += 2;
-      } else {
-        // must be one channels -> use the same value for both
-        *(spdif_ptr + 1) =
-            (uint32_t)(((bmc_tab[*p] << 16) ^ bmc_tab[*(p)]) << 1) >> 1;
-        p++;
-      }
-      result += 2;
-      spdif_ptr += 2;  // advance to next audio data
-
-      if (spdif_ptr >= &spdif_buf[SPDIF_BUF_ARRAY_SIZE]) {
-        // set block start preamble
-        ((uint8_t *)spdif_buf)[SYNC_OFFSET] ^= SYNC_FLIP;
+    const uint8_t *end = data + len;
+
+    // complete a frame from the last write
+    if (partial_len > 0) {
+      int n = min((int)(end - p), frame_size - partial_len);
+      memcpy(partial + partial_len, p, n);
+      partial_len += n;
+      p += n;
+      if (partial_len < frame_size) return len;
+      encodeFrames(partial, 1);
+      partial_len = 0;
+    }
 
-        i2s.write((uint8_t *)spdif_buf, sizeof(spdif_buf));
-        spdif_ptr = spdif_buf;
-      }
+    // encode the complete frames in blocks
+    int frames = (end - p) / frame_size;
+    while (frames > 0) {
+      int n = min(frames, buf_frames - buf_pos);
+      encodeFrames(p, n);
+      p += n * frame_size;
+      frames -= n;
     }
 
-    return result;
+    // keep the incomplete frame
+    partial_len = end - p;
+    memcpy(partial, p, partial_len);
+    return len;
   }
 
  protected:
   bool i2sOn = false;
   SPDIFConfig cfg;
   I2SStream i2s;
-
-  // initialize S/PDIF buffer
-  void spdif_buf_init(void) {
-    TRACED();
-    size_t i;
-    uint32_t bmc_mw = BMC_W;
-
-    for (i = 0; i < (size_t)SPDIF_BUF_ARRAY_SIZE; i += 2) {
-      spdif_buf[i] = bmc_mw ^= BMC_MW_DIF;
+  SPDIFEncoder encoder;
+  Vector<uint32_t> spdif_buf{0};
+  int buf_frames = 0;
+  int buf_pos = 0;
+  uint8_t partial[8];
+  int partial_len = 0;
+
+  /// encodes the frames into the buffer and outputs it when it is full
+  void encodeFrames(const uint8_t *data, int frames) {
+    encoder.encode(data, frames,
+                   spdif_buf.data() + buf_pos * SPDIF_WORDS_PER_FRAME);
+    buf_pos += frames;
+    if (buf_pos >= buf_frames) {
+      i2s.write((uint8_t *)spdif_buf.data(),
+                spdif_buf.size() * sizeof(uint32_t));
+      buf_pos = 0;
     }
   }
 };
@@ -1,4 +1,14 @@
 #pragma once
+#include "AudioConfig.h"
+#if defined(USE_URL_ARDUINO) && defined(ESP32) && defined(USE_CONCURRENCY)
+#  include "Concurrency/Task.h"
+#  include "Concurrency/LockGuard.h"
+#  define USE_URL_WARM_UP_TASK
+#endif
+
+#ifndef URL_WARM_UP_STACK_SIZE
+#  define URL_WARM_UP_STACK_SIZE 10000
+#endif
 
 namespace audio_tools {
 
@@ -57,6 +67,9 @@ public:
     /// Returns default setting go to the next
     virtual bool isAutoNext() {return true; }
 
+    /// Moves the actual stream to the indicated byte position: only supported by file based sources
+    virtual bool seek(size_t pos) { return false; }
+
     /// access with array syntax
     Stream* operator[](int idx){
         return setIndex(idx);
@@ -192,6 +205,7 @@ public:
         if (started) actual_stream->end();
         actual_stream->begin(value(pos), mime);
         started = true;
+        warmUp();
         return actual_stream;
     }
 
@@ -221,9 +235,28 @@ public:
         if (started) actual_stream->end();
         actual_stream->begin(path, mime);
         started = true;
+        warmUp();
         return actual_stream;
     }
 
+    /// Opt-in: opens the connections to the next and previous url in advance,
+    /// so that a station change only needs to wait for the first audio data.
+    /// This requires an URLStream which is using the connection pool (no
+    /// client defined via setClient()). On the ESP32 this is done by a
+    /// separate task, which also keeps the idle connections alive.
+    void setSpeculative(bool active,
+                        HttpConnectionPool &pool = DefaultConnectionPool) {
+        is_speculative = active;
+        p_pool = &pool;
+#ifdef USE_URL_WARM_UP_TASK
+        if (active && warm_up_task.getTaskHandle() == nullptr) {
+            pool.setMutex(pool_mutex);
+            warm_up_task.create("WarmUp", URL_WARM_UP_STACK_SIZE, 1);
+            warm_up_task.begin(std::bind(&AudioSourceURL::warmUpTask, this));
+        }
+#endif
+    }
+
     int index() {
         return pos;
     }
@@ -256,10 +289,50 @@ protected:
     int max = 0;
     const char* mime = nullptr;
     bool started = false;
+    bool is_speculative = false;
+    HttpConnectionPool *p_pool = nullptr;
+#ifdef USE_URL_WARM_UP_TASK
+    Task warm_up_task;
+    Mutex pool_mutex;
+#endif
 
     /// allow use with empty constructor in subclasses
     AudioSourceURL() = default;
 
+    /// Triggers the warm up of the connections to the neighbouring urls
+    void warmUp() {
+        if (!is_speculative || size() == 0) return;
+#ifdef USE_URL_WARM_UP_TASK
+        xTaskNotifyGive(warm_up_task.getTaskHandle());
+#else
+        warmUpNeighbours();
+#endif
+    }
+
+#ifdef USE_URL_WARM_UP_TASK
+    void warmUpTask() {
+        // wait for a station change: refresh the connections before they are
+        // closed as idle
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(URL_POOL_MAX_IDLE_MS / 2));
+        if (started) warmUpNeighbours();
+    }
+#endif
+
+    /// Opens the connections to the next and previous url
+    void warmUpNeighbours() {
+        int n = size();
+        int next = pos + 1 < n ? pos + 1 : 0;
+        int previous = pos > 0 ? pos - 1 : n - 1;
+        warmUp(next);
+        if (previous != next) warmUp(previous);
+    }
+
+    void warmUp(int idx) {
+        if (idx == pos) return;
+        Url url(value(idx));
+        p_pool->warmUp(url.host(), url.port(), url.isSecure());
+    }
+
     virtual const char* value(int pos){
         return urlArray[pos];
     }
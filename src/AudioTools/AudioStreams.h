@@ -2,16 +2,26 @@
 #include "AudioConfig.h"
 #include "AudioTimer/AudioTimer.h"
 #include "AudioTools/AudioTypes.h"
+#include "AudioTools/AudioKernels.h"
 #include "AudioTools/Buffers.h"
 #include "AudioTools/AudioLogger.h"
 #include "AudioTools/BaseConverter.h"
 #include "AudioEffects/SoundGenerator.h"
 #include "AudioTools/BaseStream.h"
+#if USE_SNAPSHOT
+#  include "Concurrency/Snapshot.h"
+#endif
 
 #ifndef IRAM_ATTR
 #  define IRAM_ATTR
 #endif
 
+#if defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || defined(IS_DESKTOP_WITH_TIME_ONLY)
+#  include <chrono>
+#  include <thread>
+#  define USE_STEADY_CLOCK
+#endif
+
 
 namespace audio_tools {
 
@@ -73,14 +83,26 @@ class ModifyingStream : public AudioStream {
   virtual void setOutput(Print& out) = 0;
 };
 
+/**
+ * @brief Pointer and length of a region in the memory
+ * @ingroup io
+ */
+struct MemorySpan {
+  const uint8_t *data = nullptr;
+  size_t len = 0;
+  operator bool() { return data != nullptr && len > 0; }
+};
+
 /**
  * @brief A simple Stream implementation which is backed by allocated memory. 
+ * With readSpan() the data can be processed directly from the backing memory
+ * (e.g. memory mapped flash/PROGMEM) w/o copying it.
  * @ingroup io
  * @author Phil Schatzmann
  * @copyright GPLv3
  *
  */
-class MemoryStream : public AudioStream {
+class MemoryStream : public AudioStream, public BufferProvider {
  public:
   /// Constructor for alloction in RAM
   MemoryStream(int buffer_size, MemoryType memoryType) {
@@ -159,13 +181,10 @@ class MemoryStream : public AudioStream {
   virtual size_t write(const uint8_t *data, size_t len) override {
     if (!is_active) return 0;
     if (memory_type == FLASH_RAM) return 0;
-    size_t result = 0;
-    for (size_t j = 0; j < len; j++) {
-      if (!write(data[j])) {
-        break;
-      }
-      result = j + 1;
-    }
+    if (buffer==nullptr) return 0;
+    size_t result = min(len, (size_t)max(buffer_size - write_pos, 0));
+    memcpy(buffer + write_pos, data, result);
+    write_pos += result;
     return result;
   }
 
@@ -201,14 +220,27 @@ class MemoryStream : public AudioStream {
     if (!is_active) return 0;
     size_t count = 0;
     while (count < len) {
-      int c = read();
-      if (c < 0) break;
-      *data++ = (char)c;
-      count++;
+      MemorySpan span = readSpan(len - count);
+      if (!span) break;
+      memcpy(data + count, span.data, span.len);
+      count += span.len;
     }
     return count;
   }
 
+  /// Provides the next (max len) bytes directly from the backing memory and
+  /// marks them as read: no data is copied. The span stays valid as long as
+  /// the memory is not changed, which is always the case for flash/PROGMEM.
+  /// In loop mode we continue at the rewind position.
+  MemorySpan readSpan(size_t len) {
+    MemorySpan result;
+    if (!is_active) return result;
+    result.data = readBufferPtr(len);
+    if (result.data == nullptr) return result;
+    result.len = consumeReadBuffer(len);
+    return result;
+  }
+
   virtual int peek() override {
     if (!is_active) return -1;
     int result = -1;
@@ -282,6 +314,43 @@ class MemoryStream : public AudioStream {
     return buffer;
   }
 
+  /// We support direct access to the memory
+  BufferProvider *bufferProvider() override { return this; }
+
+  /// Provides the address of the next unread data
+  const uint8_t *readBufferPtr(size_t &len) override {
+    if (available() <= 0) {
+      len = 0;
+      return nullptr;
+    }
+    len = min(len, (size_t)(write_pos - read_pos));
+    return buffer + read_pos;
+  }
+
+  /// Marks the data from readBufferPtr() as read
+  size_t consumeReadBuffer(size_t len) override {
+    size_t result = min(len, (size_t)max(write_pos - read_pos, 0));
+    read_pos += result;
+    return result;
+  }
+
+  /// Provides the address where we can write to
+  uint8_t *writeBufferPtr(size_t &len) override {
+    if (availableForWrite() <= 0 || buffer == nullptr) {
+      len = 0;
+      return nullptr;
+    }
+    len = min(len, (size_t)(buffer_size - write_pos));
+    return buffer + write_pos;
+  }
+
+  /// Confirms the data which was written to writeBufferPtr()
+  size_t commitWriteBuffer(size_t len) override {
+    size_t result = min(len, (size_t)availableForWrite());
+    write_pos += result;
+    return result;
+  }
+
   /// Callback which is executed when we rewind (in loop mode) to the beginning
   void setRewindCallback(void (*cb)()){
     this->rewind = cb;
@@ -330,7 +399,7 @@ class MemoryStream : public AudioStream {
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
-class RingBufferStream : public AudioStream {
+class RingBufferStream : public AudioStream, public BufferProvider {
  public:
   RingBufferStream(int size = DEFAULT_BUFFER_SIZE) { resize(size); }
 
@@ -362,6 +431,29 @@ class RingBufferStream : public AudioStream {
 
   size_t size() { return buffer.size(); }
 
+  /// We support direct access to the memory
+  BufferProvider *bufferProvider() override { return this; }
+
+  /// Provides the address of the next contiguous unread data
+  const uint8_t *readBufferPtr(size_t &len) override {
+    len = min(len, (size_t)buffer.readPtrSize());
+    return len == 0 ? nullptr : buffer.readPtr();
+  }
+
+  /// Marks the data from readBufferPtr() as read
+  size_t consumeReadBuffer(size_t len) override { return buffer.consume(len); }
+
+  /// Provides the address of the next contiguous free memory
+  uint8_t *writeBufferPtr(size_t &len) override {
+    len = min(len, (size_t)buffer.writePtrSize());
+    return len == 0 ? nullptr : buffer.writePtr();
+  }
+
+  /// Confirms the data which was written to writeBufferPtr()
+  size_t commitWriteBuffer(size_t len) override {
+    return buffer.commitWrite(len) ? len : 0;
+  }
+
  protected:
   RingBuffer<uint8_t> buffer{0};
 };
@@ -490,6 +582,10 @@ class BufferedStream : public ModifyingStream {
   void setOutput(Print &out){
     p_out = &out;
   }
+
+  /// Defines the allocator for the buffer (hot by default)
+  void setAllocator(Allocator &allocator) { buffer.setAllocator(allocator); }
+
   void setStream(Print &out){
     setOutput(out);
   }
@@ -563,7 +659,7 @@ class BufferedStream : public ModifyingStream {
   void clear() { buffer.reset(); }
 
  protected:
-  SingleBuffer<uint8_t> buffer;
+  SingleBuffer<uint8_t> buffer{0, HotAllocator};
   Print* p_out = nullptr;
   Stream* p_in = nullptr;
 
@@ -969,11 +1065,22 @@ struct ThrottleConfig : public AudioInfo {
     channels = 2;
   }
   int correction_us = 0;
+  /// the last part of the wait is done with busy waiting for sub millisecond
+  /// accuracy
+#ifdef USE_STEADY_CLOCK
+  int busy_wait_us = 200;
+#else
+  int busy_wait_us = 0;
+#endif
 };
 
 /**
  * @brief Throttle the sending or receiving of the audio data to limit it to the indicated
- * sample rate.
+ * sample rate. The data is scheduled with absolute deadlines in microseconds
+ * relative to the start, so that the timing errors do not add up: we sleep
+ * until shortly before the deadline and busy wait for the rest (see
+ * ThrottleConfig::busy_wait_us). On the desktop the std::chrono::steady_clock
+ * is used. actualSampleRate() and maxLateUs() report the achieved accuracy.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
@@ -1021,8 +1128,11 @@ class Throttle : public ModifyingStream {
 
   // (re)starts the timing
   void startDelay() { 
-    start_time = micros(); 
+    last_micros = micros();
+    now_us = 0;
+    start_time = nowUs(); 
     sum_frames = 0;
+    max_late_us = 0;
   }
 
   int availableForWrite() {
@@ -1059,19 +1169,35 @@ class Throttle : public ModifyingStream {
   // delay
   void delayFrames(size_t frames) {
     sum_frames += frames;
-    uint64_t durationUsEff = micros() - start_time;
-    uint64_t durationUsToBe = getDelayUs(sum_frames);
-    int64_t waitUs = durationUsToBe - durationUsEff + cfg.correction_us;
+    uint64_t deadline = start_time + getDelayUs(sum_frames) + cfg.correction_us;
+    int64_t waitUs = deadline - nowUs();
     LOGD("wait us: %ld", static_cast<long>(waitUs));
     if (waitUs > 0) {
-      int64_t waitMs = waitUs / 1000;
-      if (waitMs > 0) delay(waitMs);
-      delayMicroseconds(waitUs - (waitMs * 1000));
+      waitUntil(deadline);
     } else {
       LOGD("negative delay!")
     }
+    // we are late if the deadline could not be met
+    int64_t late = nowUs() - deadline;
+    if (late > max_late_us) max_late_us = late;
   }
 
+  /// Sample rate which was achieved since the start
+  float actualSampleRate() {
+    uint64_t duration = nowUs() - start_time;
+    if (duration == 0) return 0.0f;
+    return 1000000.0f * sum_frames / duration;
+  }
+
+  /// Deviation of the achieved sample rate in percent
+  float rateErrorPercent() {
+    if (cfg.sample_rate == 0 || sum_frames == 0) return 0.0f;
+    return 100.0f * (actualSampleRate() - cfg.sample_rate) / cfg.sample_rate;
+  }
+
+  /// Max delay (in us) after a deadline
+  int64_t maxLateUs() { return max_late_us; }
+
   inline int64_t getDelayUs(uint64_t frames){
     return (frames * 1000000) / cfg.sample_rate;
   }
@@ -1085,18 +1211,60 @@ class Throttle : public ModifyingStream {
   }
 
  protected:
-  uint32_t start_time = 0;
-  uint32_t sum_frames = 0;
+  uint64_t start_time = 0;
+  uint64_t sum_frames = 0;
+  uint64_t now_us = 0;
+  uint32_t last_micros = 0;
+  int64_t max_late_us = 0;
   ThrottleConfig cfg;
   int frame_size = 0;
   Print *p_out = nullptr;
   Stream *p_in = nullptr;
+
+  /// Monotonic time in us: on the microcontrollers we extend the 32 bit
+  /// micros() which overflows after about 71 minutes
+  uint64_t nowUs() {
+#ifdef USE_STEADY_CLOCK
+    using namespace std::chrono;
+    return duration_cast<microseconds>(
+               steady_clock::now().time_since_epoch())
+        .count();
+#else
+    uint32_t current = micros();
+    now_us += (uint32_t)(current - last_micros);
+    last_micros = current;
+    return now_us;
+#endif
+  }
+
+  /// sleeps until shortly before the deadline and busy waits for the rest
+  void waitUntil(uint64_t deadline) {
+    int64_t sleepUs = deadline - nowUs() - cfg.busy_wait_us;
+#ifdef USE_STEADY_CLOCK
+    if (sleepUs > 0)
+      std::this_thread::sleep_for(std::chrono::microseconds(sleepUs));
+#else
+    if (sleepUs >= 1000) delay(sleepUs / 1000);
+#endif
+    int64_t waitUs = deadline - nowUs();
+    if (waitUs <= 0) return;
+    if (cfg.busy_wait_us > 0) {
+      while ((int64_t)(deadline - nowUs()) > 0);
+    } else {
+      delayMicroseconds(waitUs);
+    }
+  }
 };
 
 
 /**
  * @brief MixerStream is mixing the input from Multiple Input Streams.
  * All streams must have the same audo format (sample rate, channels, bits per sample). 
+ *
+ * With setPrefetch() each input gets its own buffer which is filled w/o
+ * blocking with the available data, so that a slow stream does not stall the
+ * others: muted inputs and inputs w/o data are skipped and the result is
+ * limited to the data which all active inputs can provide.
  * @ingroup transform
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -1107,11 +1275,16 @@ class InputMixer : public AudioStream {
   public:
     InputMixer() = default;
 
+    ~InputMixer() { clearPrefetch(); }
+
     /// Adds a new input stream
     void add(Stream &in, int weight=100){
       streams.push_back(&in);
       weights.push_back(weight);
       total_weights += weight;
+      if (prefetch_size > 0) {
+        prefetch.push_back(new RingBuffer<uint8_t>(prefetchBufferSize()));
+      }
     }
 
     /// Replaces a stream at the indicated channel
@@ -1127,9 +1300,23 @@ class InputMixer : public AudioStream {
   	  setAudioInfo(info);
       frame_size = info.bits_per_sample/8 * info.channels;
       LOGI("frame_size: %d",frame_size);
+      // the prefetch buffers must be a multiple of the frame size
+      if (prefetch_size > 0) setPrefetch(true, prefetch_size);
   	  return frame_size>0;
     }
 
+    /// Activates the mode where each input is read w/o blocking into its own
+    /// prefetch buffer of the indicated size (in bytes)
+    void setPrefetch(bool active, int bufferSize = DEFAULT_BUFFER_SIZE) {
+      clearPrefetch();
+      prefetch_size = active ? bufferSize : 0;
+      if (prefetch_size > 0) {
+        for (int j = 0; j < size(); j++) {
+          prefetch.push_back(new RingBuffer<uint8_t>(prefetchBufferSize()));
+        }
+      }
+    }
+
     /// Dynamically update the new weight for the indicated channel: If you set it to 0 it is muted (and the stream is not read any more). We recommend to use values between 1 and 100
     void setWeight(int channel, int weight){
       if (channel<size()){
@@ -1150,6 +1337,8 @@ class InputMixer : public AudioStream {
       weights.clear();
       result_vect.clear();
       current_vect.clear();
+      accumulator.clear();
+      clearPrefetch();
       total_weights = 0.0;
     }
 
@@ -1165,6 +1354,10 @@ class InputMixer : public AudioStream {
         return 0;
       }
 
+      if (prefetch_size > 0) {
+        return readBytesPrefetch(data, len);
+      }
+
       if (limit_available_data){
         len = min((int)len, availableBytes());
       }
@@ -1200,6 +1393,88 @@ class InputMixer : public AudioStream {
     int retry_count = 5;
     Vector<int> result_vect;
     Vector<T> current_vect;
+    Vector<RingBuffer<uint8_t>*> prefetch{0};
+    Vector<typename MixerAccumulator<T>::type> accumulator{0};
+    int prefetch_size = 0;
+
+    /// The buffer size must be a multiple of the frame size so that the
+    /// samples are never split at the end of the ring buffer
+    int prefetchBufferSize() {
+      int frames = prefetch_size / frame_size;
+      return (frames > 0 ? frames : 1) * frame_size;
+    }
+
+    void clearPrefetch() {
+      for (auto p_buffer : prefetch) delete p_buffer;
+      prefetch.clear();
+    }
+
+    /// Reads the available data of the unmuted inputs w/o blocking
+    void fillPrefetch() {
+      for (int j = 0; j < size(); j++) {
+        if (weights[j] <= 0) continue;
+        RingBuffer<uint8_t> *p_buffer = prefetch[j];
+        // the free space might wrap around
+        for (int k = 0; k < 2; k++) {
+          int len = min(streams[j]->available(), p_buffer->writePtrSize());
+          if (len <= 0) break;
+          int read = streams[j]->readBytes(p_buffer->writePtr(), len);
+          if (read <= 0) break;
+          p_buffer->commitWrite(read);
+        }
+      }
+    }
+
+    bool isPrefetchActive(int idx) {
+      return weights[idx] > 0 && prefetch[idx]->available() >= frame_size;
+    }
+
+    /// mixing of the active inputs from the prefetch buffers
+    size_t readBytesPrefetch(uint8_t* data, size_t len) {
+      fillPrefetch();
+      // determine the active inputs and the common length
+      int active_weights = 0;
+      size_t result = len;
+      for (int j = 0; j < size(); j++) {
+        if (isPrefetchActive(j)) {
+          active_weights += weights[j];
+          result = min(result, (size_t)prefetch[j]->available());
+        }
+      }
+      result = result / frame_size * frame_size;
+      if (active_weights == 0 || result == 0) return 0;
+
+      // mix the active inputs only
+      size_t samples = result / sizeof(T);
+      accumulator.resize(samples);
+      memset(accumulator.data(), 0, samples * accumulator_sample_size());
+      for (int j = 0; j < size(); j++) {
+        if (!isPrefetchActive(j)) continue;
+        int32_t gain = (static_cast<int64_t>(weights[j]) * GAIN_Q15_ONE +
+                        active_weights / 2) / active_weights;
+        mixPrefetch(prefetch[j], samples, gain);
+      }
+      AudioKernels::fromQ15((T*)data, accumulator.data(), samples);
+      return result;
+    }
+
+    int accumulator_sample_size() {
+      return sizeof(typename MixerAccumulator<T>::type);
+    }
+
+    /// Adds the contiguous blocks of the prefetch buffer to the accumulator
+    void mixPrefetch(RingBuffer<uint8_t> *p_buffer, size_t samples,
+                     int32_t gain) {
+      size_t pos = 0;
+      while (pos < samples) {
+        size_t len = min(samples - pos, p_buffer->readPtrSize() / sizeof(T));
+        if (len == 0) break;
+        AudioKernels::mixAdd(accumulator.data() + pos,
+                             (const T *)p_buffer->readPtr(), len, gain);
+        p_buffer->consume(len * sizeof(T));
+        pos += len;
+      }
+    }
 
     /// mixing using a vector of samples
     int readBytesVector(T* p_data, int byteCount) {
@@ -1600,9 +1875,32 @@ class FilteredStream : public ModifyingStream {
 
 };
 
+/**
+ * @brief Consistent set of results of the VolumeMeter
+ * @ingroup volume
+ */
+struct VolumeMeterValues {
+  /// max amplitude
+  float volume = 0.0f;
+  /// RMS over the window
+  float rms = 0.0f;
+  /// K weighted loudness in LUFS
+  float loudness = -1000.0f;
+  /// Counts the published results
+  uint32_t updates = 0;
+};
+
 /**
  * @brief A simple class to determine the volume. You can use it as 
  * final output or as output or input in your audio chain.
+ *
+ * Besides the peak (max amplitude) we determine the RMS and optionally the
+ * K weighted loudness (LUFS, without gating) over a sliding window
+ * (setWindow()): the data is processed in blocks with the
+ * AudioKernels::peakSumSquares() kernel and the window is maintained with
+ * running sums of the blocks. By default the peak is updated with each write;
+ * with setUpdateInterval() all results are only published at the indicated
+ * control rate.
  * @ingroup io
  * @ingroup volume
  * @author Phil Schatzmann
@@ -1640,9 +1938,30 @@ public:
     if (info.channels > 0) {
       volumes.resize(info.channels);
       volumes_tmp.resize(info.channels);
+      setupWindow();
     }
   }
 
+  /// Defines the length of the window in ms which is used for the RMS and
+  /// the loudness (default 400 ms)
+  void setWindow(int ms) {
+    window_ms = ms;
+    setupWindow();
+  }
+
+  /// Publishes the results only at the indicated interval in ms: with 0
+  /// the peak is updated with each write and the RMS every 10 ms
+  void setUpdateInterval(int ms) {
+    update_ms = ms;
+    setupWindow();
+  }
+
+  /// Activates the K weighted loudness measurement (ITU-R BS.1770)
+  void setLoudness(bool active) {
+    is_loudness = active;
+    setupWindow();
+  }
+
   size_t write(const uint8_t *data, size_t len) {
     updateVolumes(data, len);
     size_t result = len;
@@ -1704,6 +2023,39 @@ public:
   /// Volume of indicated channel in %: max amplitude is 100
   float volumePercent(int channel) { return 100.0f * volumeRatio(channel);}
 
+  /// RMS of all channels over the window. The range depends on the
+  /// bits_per_sample.
+  float rms() { return f_rms; }
+
+  /// RMS of the indicated channel over the window
+  float rms(int channel) {
+    if (channel >= rms_values.size()) {
+      LOGE("invalid channel %d", channel);
+      return 0.0f;
+    }
+    return rms_values[channel];
+  }
+
+  /// RMS in db: a full scale sine is -3 (range: -1000 to 0)
+  float rmsDB() { return toDB(rms()); }
+
+  /// RMS of the indicated channel in db
+  float rmsDB(int channel) { return toDB(rms(channel)); }
+
+  /// K weighted loudness over the window in LUFS (-1000 if not active)
+  float loudness() { return f_loudness; }
+
+  /// Provides a consistent copy of the latest results: with USE_SNAPSHOT
+  /// this can be called by one other task (e.g. a display) without blocking
+  /// the audio processing
+  VolumeMeterValues values() {
+#if USE_SNAPSHOT
+    snapshot.update();
+    return snapshot.readBuffer();
+#else
+    return current;
+#endif
+  }
 
   /// Resets the actual volume
   void clear() {
@@ -1728,9 +2080,40 @@ protected:
   Vector<float> volumes_tmp{0};
   Print* p_out = nullptr;
   Stream* p_stream = nullptr;
+  // window
+  int window_ms = 400;
+  int update_ms = 0;
+  bool is_loudness = false;
+  int block_frames = 0;
+  int block_count = 0;
+  int window_blocks = 0;
+  int ring_pos = 0;
+  int ring_filled = 0;
+  Vector<int32_t> peaks{0};
+  Vector<int64_t> block_sums{0};
+  Vector<int64_t> ring_sums{0};
+  Vector<int64_t> total_sums{0};
+  Vector<float> rms_values{0};
+  float f_rms = 0;
+  // loudness: K weighting filter state per channel and block sums
+  float k_coef[2][5];
+  Vector<float> k_state{0};
+  Vector<float> block_loudness{0};
+  Vector<float> ring_loudness{0};
+  float f_loudness = -1000.0f;
+  VolumeMeterValues current;
+#if USE_SNAPSHOT
+  Snapshot<VolumeMeterValues> snapshot;
+#endif
 
   void updateVolumes(const uint8_t *data, size_t len){
-    clear();
+    if (info.channels > 0 && volumes.size() != info.channels) {
+      // setAudioInfo() was not called
+      volumes.resize(info.channels);
+      volumes_tmp.resize(info.channels);
+      setupWindow();
+    }
+    if (update_ms == 0) clearPeaks();
     switch (info.bits_per_sample) {
     case 16:
       updateVolumesT<int16_t>(data, len);
@@ -1748,32 +2131,189 @@ protected:
   }
 
   template <typename T> void updateVolumesT(const uint8_t *buffer, size_t size) {
-    T *bufferT = (T *)buffer;
-    int samplesCount = size / sizeof(T);
-    for (int j = 0; j < samplesCount; j++) {
-      float tmp = abs(static_cast<float>(bufferT[j]));
-      updateVolume(tmp, j);
+    const T *bufferT = (const T *)buffer;
+    int channels = info.channels;
+    if (channels <= 0 || block_frames <= 0) return;
+    int frames = size / sizeof(T) / channels;
+    int pos = 0;
+    while (pos < frames) {
+      int count = min(frames - pos, block_frames - block_count);
+      const T *block = bufferT + pos * channels;
+      AudioKernels::peakSumSquares(block, count * channels, channels,
+                                   peaks.data(), block_sums.data());
+      if (is_loudness) updateLoudness(block, count);
+      block_count += count;
+      pos += count;
+      if (block_count == block_frames) commitBlock();
+    }
+    if (update_ms == 0) commit();
+  }
+
+  /// Publishes the peaks
+  void commit() {
+    f_volume_tmp = 0;
+    for (int j = 0; j < info.channels; j++) {
+      volumes_tmp[j] = peaks[j];
+      if (volumes_tmp[j] > f_volume_tmp) f_volume_tmp = volumes_tmp[j];
     }
-    commit();
+    f_volume = f_volume_tmp;
+    for (int j = 0; j < info.channels; j++) {
+      volumes[j] = volumes_tmp[j];
+    }
+    publishValues();
   }
 
-  void updateVolume(float tmp, int j) {
-    if (tmp > f_volume_tmp) {
-      f_volume_tmp = tmp;
-    }
-    if (volumes_tmp.size() > 0 && info.channels > 0) {
-      int ch = j % info.channels;
-      if (tmp > volumes_tmp[ch]) {
-        volumes_tmp[ch] = tmp;
-      }
-    }
+  void publishValues() {
+    current.volume = f_volume;
+    current.rms = f_rms;
+    current.loudness = f_loudness;
+    current.updates++;
+#if USE_SNAPSHOT
+    snapshot.publish(current);
+#endif
   }
 
-  void commit() {
-    f_volume = f_volume_tmp;
-    for (int j = 0; j < info.channels; j++) {
-      volumes[j] = volumes_tmp[j];
+  void clearPeaks() {
+    for (int j = 0; j < peaks.size(); j++) peaks[j] = 0;
+  }
+
+  /// Adds the block to the window
+  void commitBlock() {
+    int channels = info.channels;
+    int64_t *ring = ring_sums.data() + ring_pos * channels;
+    for (int ch = 0; ch < channels; ch++) {
+      total_sums[ch] += block_sums[ch] - ring[ch];
+      ring[ch] = block_sums[ch];
+      block_sums[ch] = 0;
     }
+    if (is_loudness) {
+      float sum = 0.0f;
+      for (int ch = 0; ch < channels; ch++) {
+        sum += block_loudness[ch];
+        block_loudness[ch] = 0.0f;
+      }
+      ring_loudness[ring_pos] = sum;
+    }
+    if (++ring_pos == window_blocks) ring_pos = 0;
+    if (ring_filled < window_blocks) ring_filled++;
+    block_count = 0;
+
+    // the squares are summed up at a 16 bit scale
+    float scale =
+        info.bits_per_sample > 16 ? 1 << (info.bits_per_sample - 16) : 1;
+    float frames = (float)ring_filled * block_frames;
+    float total = 0.0f;
+    for (int ch = 0; ch < channels; ch++) {
+      rms_values[ch] = sqrtf(total_sums[ch] / frames) * scale;
+      total += total_sums[ch];
+    }
+    f_rms = sqrtf(total / frames / channels) * scale;
+    if (is_loudness) {
+      // we sum up the float values again to avoid rounding errors
+      float sum = 0.0f;
+      for (int j = 0; j < ring_filled; j++) sum += ring_loudness[j];
+      f_loudness =
+          sum > 0.0f ? -0.691f + 10.0f * log10f(sum / frames) : -1000.0f;
+    }
+    if (update_ms > 0) {
+      commit();
+      clearPeaks();
+    } else {
+      publishValues();
+    }
+  }
+
+  float toDB(float value) {
+    float ratio = value / NumberConverter::maxValue(info.bits_per_sample);
+    if (ratio == 0.0f) return -1000;
+    return 20.0f * log10(ratio);
+  }
+
+  /// K weighting (high shelf and high pass) and sum of the squares
+  template <typename T> void updateLoudness(const T *data, int frames) {
+    int channels = info.channels;
+    float factor = 1.0f / NumberConverter::maxValueT<T>();
+    for (int ch = 0; ch < channels; ch++) {
+      float *st = k_state.data() + ch * 4;
+      float sum = 0.0f;
+      for (int j = 0; j < frames; j++) {
+        T value = data[j * channels + ch];
+        float x = factor * static_cast<int32_t>(value);
+        for (int s = 0; s < 2; s++) {
+          const float *c = k_coef[s];
+          float y = c[0] * x + st[s * 2];
+          st[s * 2] = c[1] * x - c[3] * y + st[s * 2 + 1];
+          st[s * 2 + 1] = c[2] * x - c[4] * y;
+          x = y;
+        }
+        sum += x * x;
+      }
+      block_loudness[ch] += sum;
+    }
+  }
+
+  /// Calculates the block size, the K weighting coefficients and resets the
+  /// window
+  void setupWindow() {
+    int channels = info.channels;
+    if (channels <= 0 || info.sample_rate <= 0) return;
+    int block_ms = update_ms > 0 ? update_ms : 10;
+    block_frames = (int64_t)info.sample_rate * block_ms / 1000;
+    if (block_frames < 1) block_frames = 1;
+    window_blocks = (window_ms + block_ms / 2) / block_ms;
+    if (window_blocks < 1) window_blocks = 1;
+    peaks.resize(channels);
+    block_sums.resize(channels);
+    total_sums.resize(channels);
+    rms_values.resize(channels);
+    ring_sums.resize(channels * window_blocks);
+    for (int j = 0; j < channels; j++) {
+      peaks[j] = 0;
+      block_sums[j] = 0;
+      total_sums[j] = 0;
+      rms_values[j] = 0.0f;
+    }
+    for (int j = 0; j < ring_sums.size(); j++) ring_sums[j] = 0;
+    block_count = 0;
+    ring_pos = 0;
+    ring_filled = 0;
+    f_rms = 0.0f;
+    f_loudness = -1000.0f;
+    if (is_loudness) {
+      k_state.resize(channels * 4);
+      block_loudness.resize(channels);
+      ring_loudness.resize(window_blocks);
+      for (int j = 0; j < k_state.size(); j++) k_state[j] = 0.0f;
+      for (int j = 0; j < channels; j++) block_loudness[j] = 0.0f;
+      for (int j = 0; j < window_blocks; j++) ring_loudness[j] = 0.0f;
+      setupKWeighting();
+    }
+  }
+
+  /// Coefficients of the K weighting for the actual sample rate: these are
+  /// the BS.1770 filters which are recalculated as in libebur128
+  void setupKWeighting() {
+    float fs = info.sample_rate;
+    // stage 1: high shelf with +4 dB
+    float k = tanf(PI * 1681.97445f / fs);
+    float q = 0.70717524f;
+    float vh = powf(10.0f, 3.99984385f / 20.0f);
+    float vb = powf(vh, 0.49966677f);
+    float a0 = 1.0f + k / q + k * k;
+    k_coef[0][0] = (vh + vb * k / q + k * k) / a0;
+    k_coef[0][1] = 2.0f * (k * k - vh) / a0;
+    k_coef[0][2] = (vh - vb * k / q + k * k) / a0;
+    k_coef[0][3] = 2.0f * (k * k - 1.0f) / a0;
+    k_coef[0][4] = (1.0f - k / q + k * k) / a0;
+    // stage 2: high pass at 38 Hz
+    k = tanf(PI * 38.1354709f / fs);
+    q = 0.50032704f;
+    a0 = 1.0f + k / q + k * k;
+    k_coef[1][0] = 1.0f;
+    k_coef[1][1] = -2.0f;
+    k_coef[1][2] = 1.0f;
+    k_coef[1][3] = 2.0f * (k * k - 1.0f) / a0;
+    k_coef[1][4] = (1.0f - k / q + k * k) / a0;
   }
 };
 
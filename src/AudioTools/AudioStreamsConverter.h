@@ -1,5 +1,6 @@
 #pragma once
 #include "AudioIO.h"
+#include "AudioTools/AudioKernels.h"
 #include "AudioTools/AudioStreams.h"
 #include "AudioTools/ResampleStream.h"
 
@@ -30,6 +31,13 @@ class ChannelFormatConverterStreamT : public ReformatBaseStream {
     converter.setSourceChannels(from_channels);
     converter.setTargetChannels(to_channels);
 
+    // allocate the buffers for writes and reads of max_block_size bytes
+    if (isFixedCapacity()) {
+      int samples = max_block_size / sizeof(T) * max(factor, 1.0f) + 1;
+      resizeBuffer(buffer, samples);
+      resizeBuffer(bufferTmp, max_block_size / factor + 1);
+    }
+    allocation_count = 0;
     return true;
   }
 
@@ -44,6 +52,10 @@ class ChannelFormatConverterStreamT : public ReformatBaseStream {
     if (from_channels == to_channels) {
       return p_print->write(data, len);
     }
+    size_t max_len = chunkSize(sizeof(T) * from_channels);
+    if (isFixedCapacity() && len > max_len) {
+      return writeChunks(data, len, max_len);
+    }
     size_t resultBytes = convert(data, len);
     assert(resultBytes = factor * len);
     p_print->write((uint8_t *)buffer.data(), resultBytes);
@@ -56,8 +68,12 @@ class ChannelFormatConverterStreamT : public ReformatBaseStream {
     if (from_channels == to_channels) {
       return p_stream->readBytes(data, len);
     }
+    size_t max_len = chunkSize(sizeof(T) * to_channels);
+    if (isFixedCapacity() && len > max_len) {
+      return readChunks(data, len, max_len);
+    }
     size_t in_bytes = 1.0f / factor * len;
-    bufferTmp.resize(in_bytes);
+    resizeBuffer(bufferTmp, in_bytes);
     p_stream->readBytes(bufferTmp.data(), in_bytes);
     size_t resultBytes = convert(bufferTmp.data(), in_bytes);
     assert(len == resultBytes);
@@ -101,7 +117,7 @@ class ChannelFormatConverterStreamT : public ReformatBaseStream {
   size_t convert(const uint8_t *in_data, size_t size) {
     size_t result;
     size_t result_samples = size / sizeof(T) * factor;
-    buffer.resize(result_samples);
+    resizeBuffer(buffer, result_samples);
     result =
         converter.convert((uint8_t *)buffer.data(), (uint8_t *)in_data, size);
     if (result != result_samples * sizeof(T)) {
@@ -255,12 +271,27 @@ class ChannelFormatConverterStream : public ReformatBaseStream {
     return static_cast<float>(to_channels) / static_cast<float>(from_channels);
   }
 
+  int allocations() override {
+    return p_converter == nullptr ? 0 : p_converter->allocations();
+  }
+
  protected:
   void *converter;
+  ReformatBaseStream *p_converter = nullptr;
   int bits_per_sample = 0;
   int to_channels;
   int from_channels;
 
+  /// Starts the converter with our fixed capacity setting
+  template <typename T>
+  void setupCapacity(ChannelFormatConverterStreamT<T> *conv, int fromChannels,
+                     int toChannels) {
+    converter = conv;
+    p_converter = conv;
+    conv->setMaxBlockSize(max_block_size);
+    conv->begin(fromChannels, toChannels);
+  }
+
   template <typename T>
   ChannelFormatConverterStreamT<T> *getConverter() {
     return (ChannelFormatConverterStreamT<T> *)converter;
@@ -271,20 +302,20 @@ class ChannelFormatConverterStream : public ReformatBaseStream {
     if (p_stream != nullptr) {
       switch (bits_per_sample) {
         case 8:
-          converter = new ChannelFormatConverterStreamT<int8_t>(*p_stream);
-          getConverter<int8_t>()->begin(fromChannels, toChannels);
+          setupCapacity(new ChannelFormatConverterStreamT<int8_t>(*p_stream),
+                        fromChannels, toChannels);
           break;
         case 16:
-          converter = new ChannelFormatConverterStreamT<int16_t>(*p_stream);
-          getConverter<int16_t>()->begin(fromChannels, toChannels);
+          setupCapacity(new ChannelFormatConverterStreamT<int16_t>(*p_stream),
+                        fromChannels, toChannels);
           break;
         case 24:
-          converter = new ChannelFormatConverterStreamT<int24_t>(*p_stream);
-          getConverter<int24_t>()->begin(fromChannels, toChannels);
+          setupCapacity(new ChannelFormatConverterStreamT<int24_t>(*p_stream),
+                        fromChannels, toChannels);
           break;
         case 32:
-          converter = new ChannelFormatConverterStreamT<int32_t>(*p_stream);
-          getConverter<int32_t>()->begin(fromChannels, toChannels);
+          setupCapacity(new ChannelFormatConverterStreamT<int32_t>(*p_stream),
+                        fromChannels, toChannels);
           break;
         default:
           result = false;
@@ -292,20 +323,20 @@ class ChannelFormatConverterStream : public ReformatBaseStream {
     } else {
       switch (bits_per_sample) {
         case 8:
-          converter = new ChannelFormatConverterStreamT<int8_t>(*p_print);
-          getConverter<int8_t>()->begin(fromChannels, toChannels);
+          setupCapacity(new ChannelFormatConverterStreamT<int8_t>(*p_print),
+                        fromChannels, toChannels);
           break;
         case 16:
-          converter = new ChannelFormatConverterStreamT<int16_t>(*p_print);
-          getConverter<int16_t>()->begin(fromChannels, toChannels);
+          setupCapacity(new ChannelFormatConverterStreamT<int16_t>(*p_print),
+                        fromChannels, toChannels);
           break;
         case 24:
-          converter = new ChannelFormatConverterStreamT<int24_t>(*p_print);
-          getConverter<int24_t>()->begin(fromChannels, toChannels);
+          setupCapacity(new ChannelFormatConverterStreamT<int24_t>(*p_print),
+                        fromChannels, toChannels);
           break;
         case 32:
-          converter = new ChannelFormatConverterStreamT<int32_t>(*p_print);
-          getConverter<int32_t>()->begin(fromChannels, toChannels);
+          setupCapacity(new ChannelFormatConverterStreamT<int32_t>(*p_print),
+                        fromChannels, toChannels);
           break;
         default:
           result = false;
@@ -355,6 +386,12 @@ class NumberFormatConverterStreamT : public ReformatBaseStream {
   bool begin() override {
     LOGI("begin %d -> %d bits", (int)sizeof(TFrom), (int)sizeof(TTo));
     is_output_notify = false;
+    // allocate the buffer for writes and reads of max_block_size bytes
+    if (isFixedCapacity()) {
+      float factor = getByteFactor();
+      resizeBuffer(buffer, max_block_size * max(factor, 1.0f / factor));
+    }
+    allocation_count = 0;
     return true;
   }
 
@@ -362,7 +399,12 @@ class NumberFormatConverterStreamT : public ReformatBaseStream {
     TRACED();
     if (p_print == nullptr) return 0;
     addNotifyOnFirstWrite();
-    if (sizeof(TFrom) == sizeof(TTo)) return p_print->write(data, len);
+    if (NumberFormatKernel<TFrom, TTo>::is_pass_through)
+      return p_print->write(data, len);
+    size_t max_len = chunkSize(sizeof(TFrom));
+    if (isFixedCapacity() && len > max_len) {
+      return writeChunks(data, len, max_len);
+    }
     size_t samples = len / sizeof(TFrom);
     size_t result_size = 0;
     TFrom *data_source = (TFrom *)data;
@@ -374,9 +416,9 @@ class NumberFormatConverterStreamT : public ReformatBaseStream {
       }
     } else {
       int size_bytes = sizeof(TTo) * samples;
-      buffer.resize(size_bytes);
-      NumberConverter::convertArray<TFrom, TTo>(
-          data_source, (TTo *)buffer.data(), samples, gain);
+      resizeBuffer(buffer, size_bytes);
+      NumberFormatKernel<TFrom, TTo>::convert(
+          data_source, (TTo *)buffer.data(), samples, gain, ditherState());
       p_print->write((uint8_t *)buffer.address(), size_bytes);
       buffer.reset();
     }
@@ -387,6 +429,10 @@ class NumberFormatConverterStreamT : public ReformatBaseStream {
   size_t readBytes(uint8_t *data, size_t len) override {
     LOGD("NumberFormatConverterStreamT::readBytes: %d", (int)len);
     if (p_stream == nullptr) return 0;
+    size_t max_len = chunkSize(sizeof(TTo));
+    if (isFixedCapacity() && len > max_len) {
+      return readChunks(data, len, max_len);
+    }
     size_t samples = len / sizeof(TTo);
     TTo *data_target = (TTo *)data;
     TFrom source;
@@ -397,11 +443,11 @@ class NumberFormatConverterStreamT : public ReformatBaseStream {
         data_target[j] = NumberConverter::convert<TFrom, TTo>(source);
       }
     } else {
-      buffer.resize(sizeof(TFrom) * samples);
+      resizeBuffer(buffer, sizeof(TFrom) * samples);
       readSamples<TFrom>(p_stream, (TFrom *)buffer.address(), samples);
       TFrom *data = (TFrom *)buffer.address();
-      NumberConverter::convertArray<TFrom, TTo>(data, data_target, samples,
-                                                gain);
+      NumberFormatKernel<TFrom, TTo>::convert(data, data_target, samples,
+                                              gain, ditherState());
       buffer.reset();
     }
     return len;
@@ -422,6 +468,10 @@ class NumberFormatConverterStreamT : public ReformatBaseStream {
   /// Defines the gain (only available when buffered is true)
   void setGain(float value) { gain = value; }
 
+  /// Activates/deactivates the TPDF dither for the conversion from float to
+  /// integers (only available when buffered is true)
+  void setDither(bool flag) { is_dither = flag; }
+
   float getByteFactor() {
     return static_cast<float>(sizeof(TTo)) / static_cast<float>(sizeof(TFrom));
   }
@@ -430,6 +480,10 @@ class NumberFormatConverterStreamT : public ReformatBaseStream {
   SingleBuffer<uint8_t> buffer{0};
   bool is_buffered = true;
   float gain = 1.0f;
+  bool is_dither = true;
+  uint32_t dither_state = 22222;
+
+  uint32_t *ditherState() { return is_dither ? &dither_state : nullptr; }
 };
 
 /**
@@ -496,17 +550,17 @@ class NumberFormatConverterStream : public ReformatBaseStream {
       LOGI("no bit conversion: %d -> %d", from_bit_per_samples,
            to_bit_per_samples);
     } else if (from_bit_per_samples == 8 && to_bit_per_samples == 16) {
-      converter = new NumberFormatConverterStreamT<int8_t, int16_t>(gain);
+      setupCapacity(new NumberFormatConverterStreamT<int8_t, int16_t>(gain));
     } else if (from_bit_per_samples == 16 && to_bit_per_samples == 8) {
-      converter = new NumberFormatConverterStreamT<int16_t, int8_t>(gain);
+      setupCapacity(new NumberFormatConverterStreamT<int16_t, int8_t>(gain));
     } else if (from_bit_per_samples == 24 && to_bit_per_samples == 16) {
-      converter = new NumberFormatConverterStreamT<int24_t, int16_t>(gain);
+      setupCapacity(new NumberFormatConverterStreamT<int24_t, int16_t>(gain));
     } else if (from_bit_per_samples == 16 && to_bit_per_samples == 24) {
-      converter = new NumberFormatConverterStreamT<int16_t, int24_t>(gain);
+      setupCapacity(new NumberFormatConverterStreamT<int16_t, int24_t>(gain));
     } else if (from_bit_per_samples == 32 && to_bit_per_samples == 16) {
-      converter = new NumberFormatConverterStreamT<int32_t, int16_t>(gain);
+      setupCapacity(new NumberFormatConverterStreamT<int32_t, int16_t>(gain));
     } else if (from_bit_per_samples == 16 && to_bit_per_samples == 32) {
-      converter = new NumberFormatConverterStreamT<int16_t, int32_t>(gain);
+      setupCapacity(new NumberFormatConverterStreamT<int16_t, int32_t>(gain));
     } else {
       result = false;
       LOGE("bit combination not supported %d -> %d", from_bit_per_samples,
@@ -638,12 +692,26 @@ class NumberFormatConverterStream : public ReformatBaseStream {
            static_cast<float>(from_bit_per_samples);
   }
 
+  int allocations() override {
+    return p_converter == nullptr ? 0 : p_converter->allocations();
+  }
+
  protected:
   void *converter = nullptr;
+  ReformatBaseStream *p_converter = nullptr;
   int from_bit_per_samples = 16;
   int to_bit_per_samples = 0;
   float gain = 1.0;
 
+  /// Starts the converter with our fixed capacity setting
+  template <typename TFrom, typename TTo>
+  void setupCapacity(NumberFormatConverterStreamT<TFrom, TTo> *conv) {
+    converter = conv;
+    p_converter = conv;
+    conv->setMaxBlockSize(max_block_size);
+    conv->begin();
+  }
+
   template <typename TFrom, typename TTo>
   NumberFormatConverterStreamT<TFrom, TTo> *getConverter() {
     return (NumberFormatConverterStreamT<TFrom, TTo> *)converter;
@@ -686,6 +754,254 @@ class NumberFormatConverterStream : public ReformatBaseStream {
   }
 };
 
+/**
+ * @brief Converter which converts the channels, the bits_per_sample and the
+ * sample_rate in a single pass w/o intermediate buffers. To minimize the work
+ * the channels are reduced first, then the sample rate is converted (with
+ * the fixed point polyphase resampler) on the reduced channels and finally
+ * the result is scaled to the target bits_per_sample and the channels are
+ * added if necessary. Supports 16, 24 and 32 bits. The conversion is
+ * supported both on the input and output side.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FusedFormatConverterStream : public ReformatBaseStream {
+ public:
+  FusedFormatConverterStream() = default;
+  FusedFormatConverterStream(Stream &stream) { setStream(stream); }
+  FusedFormatConverterStream(Print &print) { setOutput(print); }
+  FusedFormatConverterStream(AudioStream &stream) {
+    to_cfg = stream.audioInfo();
+    from_cfg = stream.audioInfo();
+    setStream(stream);
+  }
+  FusedFormatConverterStream(AudioOutput &print) {
+    to_cfg = print.audioInfo();
+    setOutput(print);
+  }
+
+  void setAudioInfo(AudioInfo info) override {
+    TRACED();
+    from_cfg = info;
+    ReformatBaseStream::setAudioInfo(info);
+  }
+
+  void setAudioInfoOut(AudioInfo to) { to_cfg = to; }
+
+  AudioInfo audioInfoOut() override { return to_cfg; }
+
+  /// Defines the number of filter taps of the resampler
+  void setTaps(int taps) { this->taps = taps; }
+
+  bool begin(AudioInfo from, AudioInfo to) {
+    setAudioInfoOut(to);
+    return begin(from);
+  }
+
+  bool begin(AudioInfo from) {
+    TRACED();
+    is_output_notify = false;
+    setAudioInfo(from);
+    if (!isValidBits(from_cfg.bits_per_sample) ||
+        !isValidBits(to_cfg.bits_per_sample)) {
+      LOGE("Unsupported bits_per_sample: %d -> %d", from_cfg.bits_per_sample,
+           to_cfg.bits_per_sample);
+      return false;
+    }
+    if (from_cfg.channels <= 0 || to_cfg.channels <= 0) {
+      LOGE("Invalid channels: %d -> %d", from_cfg.channels, to_cfg.channels);
+      return false;
+    }
+    mix_channels = min(from_cfg.channels, to_cfg.channels);
+    frame_in.resize(mix_channels);
+    frame_out.resize(mix_channels);
+    frame_bytes = from_cfg.channels * from_cfg.bits_per_sample / 8;
+    partial.resize(frame_bytes);
+    partial_len = 0;
+    shift = to_cfg.bits_per_sample - from_cfg.bits_per_sample;
+
+    is_resample = from_cfg.sample_rate != to_cfg.sample_rate;
+    if (is_resample &&
+        !resampler.begin(from_cfg.sample_rate, to_cfg.sample_rate,
+                         mix_channels, taps)) {
+      LOGE("Sample rate %d -> %d not supported", (int)from_cfg.sample_rate,
+           (int)to_cfg.sample_rate);
+      return false;
+    }
+
+    // allocate the output buffer for writes of max_block_size bytes
+    if (isFixedCapacity()) {
+      int frames = chunkSize(frame_bytes) / frame_bytes + 1;
+      resizeBuffer(buffer, outputBytes(frames));
+    }
+    allocation_count = 0;
+
+    // setup reader to support readBytes()
+    setupReader();
+    return true;
+  }
+
+  bool begin() override { return begin(from_cfg); }
+
+  void end() override {
+    ReformatBaseStream::end();
+    resampler.end();
+    buffer.resize(0);
+  }
+
+  virtual size_t write(const uint8_t *data, size_t len) override {
+    LOGD("FusedFormatConverterStream::write: %d", (int)len);
+    if (p_print == nullptr || frame_bytes == 0) return 0;
+    addNotifyOnFirstWrite();
+    size_t max_len = chunkSize(frame_bytes);
+    if (isFixedCapacity() && len > max_len) {
+      return writeChunks(data, len, max_len);
+    }
+    switch (from_cfg.bits_per_sample) {
+      case 16:
+        return writeFrom<int16_t>(data, len);
+      case 24:
+        return writeFrom<int24_t>(data, len);
+      case 32:
+        return writeFrom<int32_t>(data, len);
+    }
+    return 0;
+  }
+
+  int availableForWrite() override {
+    if (p_print == nullptr) return 0;
+    return p_print->availableForWrite() / getByteFactor();
+  }
+
+  float getByteFactor() {
+    return static_cast<float>(to_cfg.channels * to_cfg.bits_per_sample) *
+           to_cfg.sample_rate /
+           (static_cast<float>(from_cfg.channels * from_cfg.bits_per_sample) *
+            from_cfg.sample_rate);
+  }
+
+ protected:
+  AudioInfo from_cfg;
+  AudioInfo to_cfg;
+  ResamplePolyphaseFixed resampler;
+  /// converted output data
+  Vector<uint8_t> buffer{0};
+  /// incomplete frame from the last write
+  Vector<uint8_t> partial{0};
+  Vector<int32_t> frame_in{0};
+  Vector<int32_t> frame_out{0};
+  int partial_len = 0;
+  int frame_bytes = 0;
+  int mix_channels = 0;
+  int shift = 0;
+  int taps = RESAMPLE_POLYPHASE_TAPS;
+  bool is_resample = false;
+
+  static bool isValidBits(int bits) {
+    return bits == 16 || bits == 24 || bits == 32;
+  }
+
+  /// max number of output bytes for the indicated input frames
+  int outputBytes(int frames) {
+    int max_frames = is_resample ? (int64_t)frames * resampler.upFactor() /
+                                           resampler.downFactor() + 2
+                                 : frames;
+    return max_frames * to_cfg.channels * to_cfg.bits_per_sample / 8;
+  }
+
+  template <typename TFrom>
+  size_t writeFrom(const uint8_t *data, size_t len) {
+    switch (to_cfg.bits_per_sample) {
+      case 16:
+        return writeT<TFrom, int16_t>(data, len);
+      case 24:
+        return writeT<TFrom, int24_t>(data, len);
+      case 32:
+        return writeT<TFrom, int32_t>(data, len);
+    }
+    return 0;
+  }
+
+  template <typename TFrom, typename TTo>
+  size_t writeT(const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    int frames = (partial_len + len) / frame_bytes;
+    resizeBuffer(buffer, outputBytes(frames));
+    TTo *out = (TTo *)buffer.data();
+
+    // complete the frame of the last write
+    if (partial_len > 0) {
+      size_t copy = min(len, (size_t)(frame_bytes - partial_len));
+      memcpy(partial.data() + partial_len, data, copy);
+      partial_len += copy;
+      pos += copy;
+      if (partial_len < frame_bytes) return len;
+      out = processFrame<TFrom, TTo>((const TFrom *)partial.data(), out);
+      partial_len = 0;
+    }
+
+    // process all complete frames in one loop
+    for (; pos + frame_bytes <= len; pos += frame_bytes) {
+      out = processFrame<TFrom, TTo>((const TFrom *)(data + pos), out);
+    }
+
+    // keep the remaining bytes
+    partial_len = len - pos;
+    memcpy(partial.data(), data + pos, partial_len);
+
+    size_t result_bytes = (uint8_t *)out - buffer.data();
+    if (result_bytes > 0) p_print->write(buffer.data(), result_bytes);
+    return len;
+  }
+
+  /// Reduces the channels and provides the resulting frames: returns the
+  /// next output position
+  template <typename TFrom, typename TTo>
+  TTo *processFrame(const TFrom *in, TTo *out) {
+    int from_channels = from_cfg.channels;
+    // copy the first channels and combine the exceeding channels
+    for (int ch = 0; ch < mix_channels - 1; ch++) {
+      frame_in[ch] = toInt32(in[ch]);
+    }
+    int64_t total = 0;
+    for (int ch = mix_channels - 1; ch < from_channels; ch++) {
+      total += toInt32(in[ch]);
+    }
+    frame_in[mix_channels - 1] = total / (from_channels - mix_channels + 1);
+
+    if (!is_resample) return outputFrame(frame_in.data(), out);
+    resampler.write(frame_in.data());
+    while (resampler.read(frame_out.data())) {
+      out = outputFrame(frame_out.data(), out);
+    }
+    return out;
+  }
+
+  /// Scales the frame to the target bits_per_sample and repeats the last
+  /// channel if necessary
+  template <typename TTo>
+  TTo *outputFrame(const int32_t *frame, TTo *out) {
+    const int64_t max_value = NumberConverter::maxValue(to_cfg.bits_per_sample);
+    int32_t value = 0;
+    for (int ch = 0; ch < to_cfg.channels; ch++) {
+      if (ch < mix_channels) {
+        int64_t scaled = shift >= 0 ? (int64_t)frame[ch] << shift
+                                    : (int64_t)frame[ch] >> -shift;
+        if (scaled > max_value) scaled = max_value;
+        if (scaled < -max_value) scaled = -max_value;
+        value = scaled;
+      }
+      *out++ = value;
+    }
+    return out;
+  }
+
+  static int32_t toInt32(int16_t value) { return value; }
+  static int32_t toInt32(int32_t value) { return value; }
+  static int32_t toInt32(const int24_t &value) { return value.toInt(); }
+};
+
 /**
  * @brief Converter which converts bits_per_sample, channels and the
  * sample_rate. The conversion is supported both on the input and output side.
@@ -765,6 +1081,19 @@ class FormatConverterStream : public ReformatBaseStream {
     numberFormatConverter.setStream(sampleRateConverter);
     channelFormatConverter.setStream(numberFormatConverter);
 
+    // propagate the fixed capacity mode
+    if (isFixedCapacity()) {
+      float channel_factor =
+          static_cast<float>(to_cfg.channels) / from_cfg.channels;
+      int number_block = max_block_size * max(channel_factor, 1.0f);
+      channelFormatConverter.setMaxBlockSize(max_block_size);
+      numberFormatConverter.setMaxBlockSize(number_block);
+      float bits_factor = static_cast<float>(to_cfg.bits_per_sample) /
+                          from_cfg.bits_per_sample;
+      sampleRateConverter.setMaxBlockSize(number_block *
+                                          max(bits_factor, 1.0f));
+    }
+
     // start individual converters
     bool result = channelFormatConverter.begin(from_cfg, to_cfg.channels);
 
@@ -802,6 +1131,13 @@ class FormatConverterStream : public ReformatBaseStream {
            channelFormatConverter.getByteFactor();
   }
 
+  int allocations() override {
+    return ReformatBaseStream::allocations() +
+           channelFormatConverter.allocations() +
+           numberFormatConverter.allocations() +
+           sampleRateConverter.allocations();
+  }
+
  protected:
   AudioInfo from_cfg;
   AudioInfo to_cfg;
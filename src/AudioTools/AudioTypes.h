@@ -143,6 +143,26 @@ class AudioInfoSupport {
       /// provides the actual output AudioInfo: this is usually the same as audioInfo() unless we use a transforming stream
       virtual AudioInfo audioInfoOut() { return audioInfo();}
 };
+/**
+ * @brief Optional interface for sources and sinks which can provide direct
+ * access to their memory, so that e.g. the StreamCopy does not need to copy
+ * the data via its own intermediate buffer.
+ * @ingroup basic
+ */
+class BufferProvider {
+    public:
+      /// Provides the address of the data that can be read: len is reduced to
+      /// the available contiguous bytes. Returns nullptr if not supported.
+      virtual const uint8_t *readBufferPtr(size_t &len) { len = 0; return nullptr; }
+      /// Confirms that len bytes have been consumed from the readBufferPtr()
+      virtual size_t consumeReadBuffer(size_t len) { return 0; }
+      /// Provides the address where data can be written to: len is reduced to
+      /// the available contiguous bytes. Returns nullptr if not supported.
+      virtual uint8_t *writeBufferPtr(size_t &len) { len = 0; return nullptr; }
+      /// Confirms that len bytes have been written to the writeBufferPtr()
+      virtual size_t commitWriteBuffer(size_t len) { return 0; }
+};
+
 // Support legacy name
 #if USE_OBSOLETE
 using AudioBaseInfo = AudioInfo;
@@ -151,7 +171,12 @@ using AudioInfoDependent = AudioInfoSupport;
 #endif
 
 /**
- * @brief Supports the subscription to audio change notifications
+ * @brief Supports the subscription to audio change notifications. An AudioInfo
+ * which has already been reported to all subscribers is not reported again.
+ * Between
+ * beginAudioInfoUpdate() and endAudioInfoUpdate() the changes are collected
+ * and only the final AudioInfo is reported, so that the subscribers are
+ * reconfigured only once.
  * @ingroup basic
  */
 class AudioInfoSource {
@@ -159,6 +184,7 @@ class AudioInfoSource {
       /// Adds target to be notified about audio changes
       virtual void addNotifyAudioChange(AudioInfoSupport &bi) {
         if (!notify_vector.contains(&bi)) notify_vector.push_back(&bi);
+        has_notified_info = false;
       }
 
       /// Removes a target in order not to be notified about audio changes
@@ -184,15 +210,41 @@ class AudioInfoSource {
         return is_notify_active;
       }
 
+      /// Starts to collect the AudioInfo changes (calls can be nested)
+      virtual void beginAudioInfoUpdate() { update_level++; }
+
+      /// Reports the last collected AudioInfo change once
+      virtual void endAudioInfoUpdate() {
+        if (update_level == 0) return;
+        if (--update_level == 0 && has_pending_info) {
+          has_pending_info = false;
+          notifyAudioChange(pending_info);
+        }
+      }
+
     protected:
       Vector<AudioInfoSupport*> notify_vector;
       bool is_notify_active = true;
+      int update_level = 0;
+      bool has_pending_info = false;
+      bool has_notified_info = false;
+      AudioInfo pending_info;
+      AudioInfo notified_info;
 
       void notifyAudioChange(AudioInfo info){
         if (isNotifyActive()){
+          if (update_level > 0) {
+            pending_info = info;
+            has_pending_info = true;
+            return;
+          }
+          // avoid a redundant reconfiguration
+          if (has_notified_info && notified_info == info) return;
           for(auto n : notify_vector){
               n->setAudioInfo(info);
           }
+          notified_info = info;
+          has_notified_info = true;
         }
       }
 
@@ -2,6 +2,7 @@
 #include "AudioBasic/Collections.h"
 #include "AudioFilter/Filter.h"
 #include "AudioTypes.h"
+#include "AudioFrameBuffer.h"
 
 /**
  * @defgroup convert Converters
@@ -235,6 +236,135 @@ class ConverterAutoCenter : public BaseConverter {
   BaseConverter *p_converter = nullptr;
 };
 
+/**
+ * @brief Removes the DC offset (e.g. of an ADC) with a fixed point running
+ * mean per channel: mean += (x - mean) / 2^shift and the result is x - mean,
+ * which is a single pole DC blocking high pass. A shift of 10 gives a cutoff
+ * of about 3 Hz at 20 kHz. The mean starts with the first sample, so there
+ * is no initial settling from 0. The channels are processed one after the
+ * other in a tight loop where the state is kept in a register. With
+ * process() the filter can be applied directly in the loop which creates the
+ * samples, so that no additional pass is needed.
+ * @ingroup convert
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T sample type
+ * @tparam Acc type of the accumulator: int64_t for 24 and 32 bit samples
+ */
+template <typename T, typename Acc = int32_t>
+class ConverterDCBlockerT : public BaseConverter {
+ public:
+  ConverterDCBlockerT(int channels = 2, int shift = 10) {
+    begin(channels, shift);
+  }
+
+  void begin(int channels, int shift = 10) {
+    this->channels = channels;
+    this->shift = shift;
+    acc.resize(channels);
+    reset();
+  }
+
+  /// Restarts the mean with the next samples
+  void reset() { init_mask = 0; }
+
+  /// Removes the offset from one sample of the indicated channel
+  inline T process(int ch, T sample) {
+    Acc value = (int32_t)sample;
+    setupMean(ch, value);
+    return filter(acc[ch], value);
+  }
+
+  size_t convert(uint8_t *src, size_t byte_count) override {
+    T *data = (T *)src;
+    size_t frames = byte_count / channels / sizeof(T);
+    if (frames == 0) return byte_count;
+    for (int ch = 0; ch < channels; ch++) {
+      T *sample = data + ch;
+      setupMean(ch, (int32_t)*sample);
+      Acc state = acc[ch];
+      for (size_t j = 0; j < frames; j++) {
+        *sample = filter(state, (int32_t)*sample);
+        sample += channels;
+      }
+      acc[ch] = state;
+    }
+    return byte_count;
+  }
+
+ protected:
+  Vector<Acc> acc{0};
+  int channels = 0;
+  int shift = 10;
+  uint32_t init_mask = 0;
+  const Acc max_value = NumberConverter::maxValueT<T>();
+
+  /// The mean starts with the first sample of the channel
+  inline void setupMean(int ch, Acc value) {
+    if ((init_mask & (1u << ch)) == 0) {
+      acc[ch] = value * ((Acc)1 << shift);
+      init_mask |= 1u << ch;
+    }
+  }
+
+  inline T filter(Acc &state, Acc value) {
+    Acc mean = state >> shift;
+    state += value - mean;
+    Acc result = value - mean;
+    if (result > max_value) result = max_value;
+    if (result < -max_value) result = -max_value;
+    return result;
+  }
+};
+
+/**
+ * @brief ConverterDCBlockerT for the bits_per_sample which are defined at
+ * runtime
+ * @ingroup convert
+ */
+class ConverterDCBlocker : public BaseConverter {
+ public:
+  ConverterDCBlocker() = default;
+
+  ConverterDCBlocker(AudioInfo info, int shift = 10) {
+    begin(info.channels, info.bits_per_sample, shift);
+  }
+
+  ~ConverterDCBlocker() {
+    if (p_converter != nullptr) {
+      delete p_converter;
+      p_converter = nullptr;
+    }
+  }
+
+  void begin(int channels, int bitsPerSample, int shift = 10) {
+    if (p_converter != nullptr) delete p_converter;
+    p_converter = nullptr;
+    switch (bitsPerSample) {
+      case 8:
+        p_converter = new ConverterDCBlockerT<int8_t>(channels, shift);
+        break;
+      case 16:
+        p_converter = new ConverterDCBlockerT<int16_t>(channels, shift);
+        break;
+      case 24:
+        p_converter = new ConverterDCBlockerT<int24_t, int64_t>(channels, shift);
+        break;
+      case 32:
+        p_converter = new ConverterDCBlockerT<int32_t, int64_t>(channels, shift);
+        break;
+    }
+  }
+
+  size_t convert(uint8_t *src, size_t size) override {
+    if (p_converter == nullptr) return 0;
+    return p_converter->convert(src, size);
+  }
+
+ protected:
+  BaseConverter *p_converter = nullptr;
+};
+
 /**
  * @brief Switches the left and right channel
  * @ingroup convert
@@ -593,6 +723,308 @@ class Decimate : public BaseConverter {
   int factor = 1;
 };
 
+/**
+ * @brief Decimation with an anti-aliasing low pass FIR filter: only the
+ * samples which are kept are calculated, so the filter costs one
+ * multiplication per tap for each output sample (the polyphase form of a
+ * decimating FIR). The windowed sinc (Blackman) low pass is designed so that
+ * the stop band starts at the new Nyquist frequency.
+ *
+ * Big factors (>= 16) are split into a CIC stage, which needs no
+ * multiplications, followed by the FIR which decimates by 4 (or 2): use
+ * setCIC() to define the stages explicitly. This can be used as a drop in
+ * replacement for the DecimateT.
+ * @ingroup convert
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T>
+class DecimateFIRT : public BaseConverter {
+ public:
+  DecimateFIRT(int factor, int channels, int taps = 0) {
+    setChannels(channels);
+    setFactor(factor);
+    setTaps(taps);
+  }
+
+  /// Defines the number of channels
+  void setChannels(int channels) {
+    this->channels = channels;
+    is_setup = false;
+  }
+
+  /// Sets the factor: e.g. with 3 we convert 48000 to 16000 samples per second
+  void setFactor(int factor) {
+    this->factor = factor;
+    is_setup = false;
+  }
+
+  /// Defines the number of taps of the FIR: 0 uses 32 taps per input sample
+  /// of an output sample
+  void setTaps(int taps) {
+    this->taps = taps;
+    is_setup = false;
+  }
+
+  /// Defines the decimation factor and the order of the CIC stage: the FIR
+  /// decimates by the remaining factor. A factor of 1 deactivates the CIC
+  void setCIC(int cicFactor, int order = 4) {
+    cic_request = cicFactor;
+    cic_order = order;
+    is_setup = false;
+  }
+
+  /// Calculates the coefficients and resets the filter state
+  bool begin() {
+    is_setup = false;
+    if (factor < 1 || channels < 1) {
+      LOGE("Invalid factor %d or channels %d", factor, channels);
+      return false;
+    }
+    cic_factor = cic_request > 0 ? cic_request : autoCICFactor();
+    if (factor % cic_factor != 0) {
+      LOGE("factor %d is not a multiple of the CIC factor %d", factor,
+           cic_factor);
+      return false;
+    }
+    fir_factor = factor / cic_factor;
+    fir_taps = taps > 0 ? taps : 32 * fir_factor + 1;
+    if (fir_factor == 1 && cic_factor > 1) fir_taps = 0;
+    setupFIR();
+    history.resize(channels * 2 * fir_taps);
+    memset(history.data(), 0, history.size() * sizeof(float));
+    integrators.resize(channels * cic_order);
+    combs.resize(channels * cic_order);
+    memset(integrators.data(), 0, integrators.size() * sizeof(uint64_t));
+    memset(combs.data(), 0, combs.size() * sizeof(uint64_t));
+    cic_gain = powf(cic_factor, cic_order);
+    stage.resize(channels);
+    hist_pos = 0;
+    cic_count = 0;
+    fir_count = 0;
+    is_setup = true;
+    return true;
+  }
+
+  size_t convert(uint8_t *src, size_t size) { return convert(src, src, size); }
+
+  size_t convert(uint8_t *target, uint8_t *src, size_t size) {
+    if (!is_setup && !begin()) return 0;
+    if (size % (sizeof(T) * channels) > 0) {
+      LOGE("Buffer size %d is not a multiple of the number of channels %d",
+           (int)size, channels);
+      return 0;
+    }
+    int frame_count = size / (sizeof(T) * channels);
+    T *p_target = (T *)target;
+    T *p_source = (T *)src;
+    float max_value = NumberConverter::maxValueT<T>();
+    size_t result_size = 0;
+
+    for (int i = 0; i < frame_count; i++) {
+      T *frame = p_source + i * channels;
+      if (cic_factor > 1) {
+        if (!integrate(frame)) continue;
+      } else {
+        for (int ch = 0; ch < channels; ch++) stage[ch] = frame[ch];
+      }
+      if (fir_taps == 0) {
+        output(p_target, max_value);
+        result_size += channels * sizeof(T);
+        continue;
+      }
+      // add the stage result to the history: the values are stored twice,
+      // so that the last taps are always available as one block
+      for (int ch = 0; ch < channels; ch++) {
+        float *hist = history.data() + ch * 2 * fir_taps;
+        hist[hist_pos] = stage[ch];
+        hist[hist_pos + fir_taps] = stage[ch];
+      }
+      if (++hist_pos == fir_taps) hist_pos = 0;
+      if (++fir_count < fir_factor) continue;
+      fir_count = 0;
+      // the filter is symmetric, so the order of the taps does not matter
+      for (int ch = 0; ch < channels; ch++) {
+        const float *hist = history.data() + ch * 2 * fir_taps + hist_pos;
+        const float *coef = coefficients.data();
+        float sum = 0.0f;
+        for (int k = 0; k < fir_taps; k++) sum += coef[k] * hist[k];
+        stage[ch] = sum;
+      }
+      output(p_target, max_value);
+      result_size += channels * sizeof(T);
+    }
+
+    LOGD("decimate fir %d: %d -> %d bytes", factor, (int)size,
+         (int)result_size);
+    return result_size;
+  }
+
+  operator bool() { return factor > 1; }
+
+  /// Provides the effective decimation factor of the CIC stage
+  int cicFactor() { return cic_factor; }
+
+  /// Provides the number of taps of the FIR stage
+  int firTaps() { return fir_taps; }
+
+ protected:
+  int channels = 2;
+  int factor = 1;
+  int taps = 0;
+  int cic_request = -1;
+  int cic_order = 4;
+  int cic_factor = 1;
+  int fir_factor = 1;
+  int fir_taps = 0;
+  bool is_setup = false;
+  Vector<float> coefficients{0};
+  Vector<float> history{0};
+  Vector<float> stage{0};
+  // CIC state: we use unsigned values which wrap around by definition
+  Vector<uint64_t> integrators{0};
+  Vector<uint64_t> combs{0};
+  float cic_gain = 1.0f;
+  int hist_pos = 0;
+  int cic_count = 0;
+  int fir_count = 0;
+
+  /// For big factors the FIR only decimates by 4 or 2
+  int autoCICFactor() {
+    if (factor < 16) return 1;
+    if (factor % 4 == 0) return factor / 4;
+    if (factor % 2 == 0) return factor / 2;
+    return 1;
+  }
+
+  /// Windowed sinc low pass with the stop band at the output Nyquist
+  /// frequency
+  void setupFIR() {
+    coefficients.resize(fir_taps);
+    if (fir_taps == 0) return;
+    float transition = 5.5f / fir_taps;
+    float fc = 0.5f / fir_factor - transition / 2.0f;
+    if (fc < 0.05f / fir_factor) fc = 0.05f / fir_factor;
+    float center = (fir_taps - 1) / 2.0f;
+    float sum = 0.0f;
+    for (int j = 0; j < fir_taps; j++) {
+      float x = j - center;
+      float sinc = x == 0.0f ? 2.0f * fc : sinf(2.0f * PI * fc * x) / (PI * x);
+      float w = fir_taps == 1 ? 1.0f
+                              : 0.42f -
+                                    0.5f * cosf(2.0f * PI * j / (fir_taps - 1)) +
+                                    0.08f * cosf(4.0f * PI * j / (fir_taps - 1));
+      coefficients[j] = sinc * w;
+      sum += coefficients[j];
+    }
+    for (int j = 0; j < fir_taps; j++) coefficients[j] /= sum;
+  }
+
+  /// CIC integrators: returns true when the decimated result is in the stage
+  bool integrate(T *frame) {
+    for (int ch = 0; ch < channels; ch++) {
+      uint64_t *acc = integrators.data() + ch * cic_order;
+      uint64_t value = (uint64_t)(int64_t)(int32_t)frame[ch];
+      for (int o = 0; o < cic_order; o++) {
+        acc[o] += value;
+        value = acc[o];
+      }
+    }
+    if (++cic_count < cic_factor) return false;
+    cic_count = 0;
+    for (int ch = 0; ch < channels; ch++) {
+      uint64_t value = integrators[ch * cic_order + cic_order - 1];
+      uint64_t *delay = combs.data() + ch * cic_order;
+      for (int o = 0; o < cic_order; o++) {
+        uint64_t diff = value - delay[o];
+        delay[o] = value;
+        value = diff;
+      }
+      stage[ch] = (float)(int64_t)value / cic_gain;
+    }
+    return true;
+  }
+
+  void output(T *&p_target, float max_value) {
+    for (int ch = 0; ch < channels; ch++) {
+      float value = stage[ch];
+      if (value > max_value) value = max_value;
+      if (value < -max_value) value = -max_value;
+      *p_target++ = (T)value;
+    }
+  }
+};
+
+/**
+ * @brief Decimation with an anti-aliasing low pass filter for any supported
+ * bits_per_sample: see DecimateFIRT
+ * @ingroup convert
+ */
+class DecimateFIR : public BaseConverter {
+ public:
+  DecimateFIR() = default;
+  DecimateFIR(int factor, int channels, int bits_per_sample) {
+    setFactor(factor);
+    setChannels(channels);
+    setBits(bits_per_sample);
+  }
+  ~DecimateFIR() { release(); }
+
+  /// Defines the number of channels
+  void setChannels(int channels) {
+    this->channels = channels;
+    release();
+  }
+  void setBits(int bits) {
+    this->bits = bits;
+    release();
+  }
+  /// Sets the factor: e.g. with 3 we convert 48000 to 16000 samples per second
+  void setFactor(int factor) {
+    this->factor = factor;
+    release();
+  }
+
+  size_t convert(uint8_t *src, size_t size) { return convert(src, src, size); }
+  size_t convert(uint8_t *target, uint8_t *src, size_t size) {
+    if (p_decimate == nullptr) {
+      switch (bits) {
+        case 8:
+          p_decimate = new DecimateFIRT<int8_t>(factor, channels);
+          break;
+        case 16:
+          p_decimate = new DecimateFIRT<int16_t>(factor, channels);
+          break;
+        case 24:
+          p_decimate = new DecimateFIRT<int24_t>(factor, channels);
+          break;
+        case 32:
+          p_decimate = new DecimateFIRT<int32_t>(factor, channels);
+          break;
+        default:
+          LOGE("Number of bits %d not supported.", bits);
+          return 0;
+      }
+    }
+    // the decimation works in place
+    if (target != src) memmove(target, src, size);
+    return p_decimate->convert(target, size);
+  }
+
+  operator bool() { return factor > 1; };
+
+ protected:
+  int channels = 2;
+  int bits = 16;
+  int factor = 1;
+  BaseConverter *p_decimate = nullptr;
+
+  void release() {
+    delete p_decimate;
+    p_decimate = nullptr;
+  }
+};
+
 /**
  * @brief We reduce the number of samples in a datastream by summing (binning) or averaging.
  * This will result in the same number of channels but binSize times less samples.
@@ -1531,7 +1963,7 @@ class Converter1Channel : public BaseConverter {
  * @tparam T
  */
 template <typename T, typename FT>
-class ConverterNChannels : public BaseConverter {
+class ConverterNChannels : public BaseConverter, public PlanarProcessor<FT> {
  public:
   /// Default Constructor
   ConverterNChannels(int channels) {
@@ -1567,26 +1999,38 @@ class ConverterNChannels : public BaseConverter {
     }
   }
 
-  // convert all samples for each channel separately
+  // convert all samples for each channel separately: the filter is called
+  // only once per channel with the full block
   size_t convert(uint8_t *src, size_t size) {
     int count = size / channels / sizeof(T);
     T *sample = (T *)src;
-    for (size_t j = 0; j < count; j++) {
-      for (int channel = 0; channel < channels; channel++) {
-        if (filters[channel] != nullptr) {
-          *sample = filters[channel]->process(*sample);
-        }
-        sample++;
-      }
+    if (frames.capacity() < count) frames.resize(channels, count);
+    frames.fromInterleaved(sample, count);
+    process(frames);
+    for (int channel = 0; channel < channels; channel++) {
+      if (filters[channel] != nullptr) frames.toInterleaved(sample, channel);
     }
     return size;
   }
 
+  /// Applies the filters to the planar frames
+  void process(AudioFrameBuffer<FT> &frames) override {
+    int count = frames.frames();
+    for (int channel = 0; channel < channels && channel < frames.channels();
+         channel++) {
+      Filter<FT> *p_filter = filters[channel];
+      if (p_filter == nullptr) continue;
+      FT *p_channel = frames.channel(channel);
+      p_filter->process(p_channel, p_channel, count);
+    }
+  }
+
   int getChannels() { return channels; }
 
  protected:
   Filter<FT> **filters = nullptr;
   int channels;
+  AudioFrameBuffer<FT> frames;
 };
 
 /**
@@ -108,6 +108,7 @@ class BaseStream : public Stream {
  */
 class AudioStream : public BaseStream, public AudioInfoSupport, public AudioInfoSource {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_STREAM)
   AudioStream() = default;
   virtual ~AudioStream() = default;
   AudioStream(AudioStream const&) = delete;
@@ -155,6 +156,9 @@ class AudioStream : public BaseStream, public AudioInfoSupport, public AudioInfo
     memset(buffer, 0, length);
     return length;
   }
+
+  /// Provides direct access to the memory if supported (or nullptr)
+  virtual BufferProvider *bufferProvider() { return nullptr; }
   
  protected:
   AudioInfo info;
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioStreams.h"
+
+/// Number of frames which are processed in one block
+#ifndef BEAMFORMER_BLOCK_FRAMES
+#  define BEAMFORMER_BLOCK_FRAMES 64
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Delay-and-sum beamformer for 16 bit microphone arrays (e.g. 4-8 mics
+ * captured with I2S TDM): each beam delays the channels by an integer and a
+ * fractional number of samples and sums them to one output channel. The
+ * fractional delays use 4 tap Lagrange interpolators with Q13 coefficients
+ * which are calculated when the beam is steered, so the processing is just
+ * one multiply accumulate loop per channel over a contiguous block.
+ *
+ * The input is interleaved with the mic channels, the output is interleaved
+ * with one channel per beam: all beams share the same input block. Due to the
+ * interpolation the output is delayed by 1 sample more than the indicated
+ * delay.
+ * @code
+ * BeamformerStream beamformer(i2s);
+ * beamformer.setBeams(2);
+ * beamformer.begin(AudioInfo(16000, 4, 16));
+ * float pos[] = {0.0, 0.04, 0.08, 0.12}; // m
+ * beamformer.steerLinear(0, -30, pos);
+ * beamformer.steerLinear(1, 30, pos);
+ * @endcode
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class BeamformerStream : public ModifyingStream {
+ public:
+  BeamformerStream() = default;
+  BeamformerStream(Stream &io) { setStream(io); }
+  BeamformerStream(Print &out) { setOutput(out); }
+
+  void setStream(Stream &io) override {
+    p_stream = &io;
+    p_print = &io;
+  }
+
+  void setOutput(Print &out) override { p_print = &out; }
+
+  /// Number of simultaneous beams (= output channels): call before begin()
+  void setBeams(int beams) { beam_count = beams; }
+
+  /// Max delay in samples: call before begin()
+  void setMaxDelay(int samples) { max_delay = samples; }
+
+  /// Starts the processing: the channels of the info are the mics
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    if (info.bits_per_sample != 16) {
+      LOGE("bits_per_sample not supported: %d", info.bits_per_sample);
+      return false;
+    }
+    channels = info.channels;
+    history = max_delay + 3;
+    stride = history + BEAMFORMER_BLOCK_FRAMES;
+    planar.resize(channels * stride);
+    beams.resize(beam_count * channels);
+    if ((int)planar.size() != channels * stride) {
+      LOGE("not enough memory");
+      return false;
+    }
+    memset(planar.data(), 0, planar.size() * sizeof(int16_t));
+    // all channels w/o delay
+    for (int b = 0; b < beam_count; b++) {
+      for (int ch = 0; ch < channels; ch++) setDelay(b, ch, 0.0f);
+    }
+    return true;
+  }
+
+  /// Defines the delay in samples for the indicated beam and channel
+  bool setDelay(int beam, int channel, float delay) {
+    if (beam >= beam_count || channel >= channels) return false;
+    if (delay < 0.0f) delay = 0.0f;
+    if (delay > max_delay) delay = max_delay;
+    int d = delay;
+    float f = delay - d;
+    Tap &tap = beams[beam * channels + channel];
+    // taps at the delays d .. d+3: the additional sample of delay avoids
+    // the access to the next sample
+    tap.offset = history - d - 3;
+    // Lagrange coefficients for a delay of 1 + f samples relative to tap 0
+    float x = 1.0f + f;
+    float c[4];
+    c[0] = -(x - 1) * (x - 2) * (x - 3) / 6.0f;
+    c[1] = x * (x - 2) * (x - 3) / 2.0f;
+    c[2] = -x * (x - 1) * (x - 3) / 2.0f;
+    c[3] = x * (x - 1) * (x - 2) / 6.0f;
+    for (int k = 0; k < 4; k++) tap.coef[k] = ::round(c[k] * 8192.0f);
+    return true;
+  }
+
+  /// Defines the delays in samples of all channels of the beam
+  bool setDelays(int beam, const float *delays) {
+    for (int ch = 0; ch < channels; ch++) {
+      if (!setDelay(beam, ch, delays[ch])) return false;
+    }
+    return true;
+  }
+
+  /// Steers the beam of a linear array to the indicated angle (0 is
+  /// perpendicular to the array): the positions of the mics are in m
+  bool steerLinear(int beam, float angleDeg, const float *positions,
+                   float speedOfSound = 343.0f) {
+    float delays[channels];
+    float factor = sinf(angleDeg * PI / 180.0f) / speedOfSound *
+                   info.sample_rate;
+    float max_value = 0.0f;
+    for (int ch = 0; ch < channels; ch++) {
+      delays[ch] = positions[ch] * factor;
+      if (ch == 0 || delays[ch] > max_value) max_value = delays[ch];
+    }
+    // the first arriving signal gets the biggest delay
+    for (int ch = 0; ch < channels; ch++) delays[ch] = max_value - delays[ch];
+    return setDelays(beam, delays);
+  }
+
+  AudioInfo audioInfoOut() override {
+    AudioInfo out = audioInfo();
+    out.channels = beam_count;
+    return out;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_print == nullptr || planar.size() == 0) return 0;
+    int frames = len / (channels * sizeof(int16_t));
+    const int16_t *in = (const int16_t *)data;
+    int16_t out[BEAMFORMER_BLOCK_FRAMES * beam_count];
+    for (int pos = 0; pos < frames; pos += BEAMFORMER_BLOCK_FRAMES) {
+      int n = min(frames - pos, BEAMFORMER_BLOCK_FRAMES);
+      processBlock(in + pos * channels, out, n);
+      p_print->write((uint8_t *)out, n * beam_count * sizeof(int16_t));
+    }
+    return frames * channels * sizeof(int16_t);
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_stream == nullptr || planar.size() == 0) return 0;
+    int frames = len / (beam_count * sizeof(int16_t));
+    int16_t *out = (int16_t *)data;
+    int16_t in[BEAMFORMER_BLOCK_FRAMES * channels];
+    int result = 0;
+    while (result < frames) {
+      int n = min(frames - result, BEAMFORMER_BLOCK_FRAMES);
+      n = readFrames(in, n);
+      if (n <= 0) break;
+      processBlock(in, out + result * beam_count, n);
+      result += n;
+    }
+    return result * beam_count * sizeof(int16_t);
+  }
+
+  int available() override {
+    if (p_stream == nullptr || channels == 0) return 0;
+    return p_stream->available() / channels * beam_count;
+  }
+
+  int availableForWrite() override {
+    if (p_print == nullptr || beam_count == 0) return 0;
+    return p_print->availableForWrite() / beam_count * channels;
+  }
+
+ protected:
+  struct Tap {
+    int offset = 0;
+    int16_t coef[4] = {0};
+  };
+  Stream *p_stream = nullptr;
+  Print *p_print = nullptr;
+  int beam_count = 1;
+  int max_delay = 32;
+  int channels = 0;
+  int history = 0;
+  int stride = 0;
+  // per channel: history followed by the actual block
+  Vector<int16_t> planar{0};
+  // per beam: one tap per channel
+  Vector<Tap> beams{0};
+
+  /// Reads n complete frames: returns the number of frames
+  int readFrames(int16_t *in, int n) {
+    int frame_size = channels * sizeof(int16_t);
+    int bytes = p_stream->readBytes((uint8_t *)in, n * frame_size);
+    return bytes / frame_size;
+  }
+
+  void processBlock(const int16_t *in, int16_t *out, int n) {
+    // deinterleave after the history
+    for (int ch = 0; ch < channels; ch++) {
+      int16_t *dst = planar.data() + ch * stride + history;
+      for (int j = 0; j < n; j++) dst[j] = in[j * channels + ch];
+    }
+    int32_t acc[BEAMFORMER_BLOCK_FRAMES];
+    for (int b = 0; b < beam_count; b++) {
+      memset(acc, 0, n * sizeof(int32_t));
+      for (int ch = 0; ch < channels; ch++) {
+        const Tap &tap = beams[b * channels + ch];
+        const int16_t *x = planar.data() + ch * stride + tap.offset;
+        const int32_t c0 = tap.coef[0], c1 = tap.coef[1], c2 = tap.coef[2],
+                      c3 = tap.coef[3];
+        for (int j = 0; j < n; j++) {
+          acc[j] +=
+              (c0 * x[j + 3] + c1 * x[j + 2] + c2 * x[j + 1] + c3 * x[j]) >> 13;
+        }
+      }
+      for (int j = 0; j < n; j++) {
+        int32_t value = acc[j] / channels;
+        if (value > 32767) value = 32767;
+        if (value < -32768) value = -32768;
+        out[j * beam_count + b] = value;
+      }
+    }
+    // keep the last samples as history
+    for (int ch = 0; ch < channels; ch++) {
+      int16_t *buffer = planar.data() + ch * stride;
+      memmove(buffer, buffer + n, history * sizeof(int16_t));
+    }
+  }
+};
+
+}  // namespace audio_tools
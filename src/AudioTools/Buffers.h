@@ -2,6 +2,7 @@
 #pragma once
 
 #include "AudioBasic/Collections.h"
+#include "AudioBasic/Float16.h"
 #include "AudioTools/AudioLogger.h"
 
 #ifndef INT_MAX
@@ -29,6 +30,7 @@ class NBuffer;
 template <typename T>
 class BaseBuffer {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_BUFFER)
   BaseBuffer() = default;
   virtual ~BaseBuffer() = default;
   BaseBuffer(BaseBuffer const &) = delete;
@@ -161,12 +163,15 @@ class BaseBuffer {
 template <typename T>
 class SingleBuffer : public BaseBuffer<T> {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_BUFFER)
   /**
    * @brief Construct a new Single Buffer object
    *
    * @param size
+   * @param allocator used for the buffer memory
    */
-  SingleBuffer(int size) {
+  SingleBuffer(int size, Allocator &allocator = DefaultAllocator) {
+    buffer.setAllocator(allocator);
     this->max_size = size;
     buffer.resize(max_size);
     reset();
@@ -273,6 +278,15 @@ class SingleBuffer : public BaseBuffer<T> {
     }
   }
 
+  /// Defines the allocator for the buffer memory: the content is lost!
+  void setAllocator(Allocator &allocator) {
+    int size = max_size;
+    buffer.setAllocator(allocator);
+    max_size = 0;
+    resize(size);
+    reset();
+  }
+
   /// Sets the buffer to 0 on clear
   void setClearWithZero(bool flag){
     is_clear_with_zero = flag;
@@ -297,7 +311,9 @@ class SingleBuffer : public BaseBuffer<T> {
 template <typename T>
 class RingBuffer : public BaseBuffer<T> {
  public:
-  RingBuffer(int size) {
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_BUFFER)
+  RingBuffer(int size, Allocator &allocator = DefaultAllocator) {
+    _aucBuffer.setAllocator(allocator);
     resize(size);
     reset();
   }
@@ -375,9 +391,47 @@ class RingBuffer : public BaseBuffer<T> {
     }
   }
 
+  /// Defines the allocator for the buffer memory: the content is lost!
+  void setAllocator(Allocator &allocator) {
+    int size = max_size;
+    _aucBuffer.setAllocator(allocator);
+    max_size = 0;
+    resize(size);
+    reset();
+  }
+
   /// Returns the maximum capacity of the buffer
   virtual size_t size() { return max_size; }
 
+  /// Provides the start of the contiguous region which can be read
+  T *readPtr() { return _aucBuffer.data() + _iTail; }
+
+  /// Number of entries which can be read from readPtr()
+  int readPtrSize() { return min(_numElems, max_size - _iTail); }
+
+  /// Releases n entries which have been read from readPtr()
+  int consume(int n) {
+    int result = min(n, readPtrSize());
+    if (result <= 0) return 0;
+    _iTail = (_iTail + result) % max_size;
+    _numElems -= result;
+    return result;
+  }
+
+  /// Provides the start of the contiguous region which can be written
+  T *writePtr() { return _aucBuffer.data() + _iHead; }
+
+  /// Number of entries which can be written to writePtr()
+  int writePtrSize() { return min(max_size - _numElems, max_size - _iHead); }
+
+  /// Confirms that n entries have been written to writePtr()
+  bool commitWrite(int n) {
+    if (n < 0 || n > writePtrSize()) return false;
+    _iHead = (_iHead + n) % max_size;
+    _numElems += n;
+    return true;
+  }
+
  protected:
   Vector<T> _aucBuffer;
   int _iHead;
@@ -388,6 +442,174 @@ class RingBuffer : public BaseBuffer<T> {
   int nextIndex(int index) { return (uint32_t)(index + 1) % max_size; }
 };
 
+/**
+ * @brief RingBuffer which stores float values as float16 to use half of the
+ * memory: the float arrays are converted with the bulk conversions of the
+ * float16.
+ * @ingroup buffers
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class RingBufferFloat16 : public RingBuffer<float16> {
+ public:
+  RingBufferFloat16(int size, Allocator &allocator = DefaultAllocator)
+      : RingBuffer<float16>(size, allocator) {}
+
+  using RingBuffer<float16>::writeArray;
+  using RingBuffer<float16>::readArray;
+
+  /// Stores the floats: returns the number of written values
+  int writeArray(const float data[], int len) {
+    int result = 0;
+    while (result < len && writePtrSize() > 0) {
+      int n = min(len - result, writePtrSize());
+      float16::fromFloat(data + result, writePtr(), n);
+      commitWrite(n);
+      result += n;
+    }
+    return result;
+  }
+
+  /// Provides the stored values as floats: returns the number of read values
+  int readArray(float data[], int len) {
+    int result = 0;
+    while (result < len && readPtrSize() > 0) {
+      int n = min(len - result, readPtrSize());
+      float16::toFloat(readPtr(), data + result, n);
+      consume(n);
+      result += n;
+    }
+    return result;
+  }
+};
+
+/**
+ * @brief Ring buffer with a compile time capacity of N entries which must be a
+ * power of 2: the data is stored inside the object, so there is no heap
+ * allocation, and the index calculation is a bit mask instead of a modulo.
+ * The array operations are done with memcpy in at most 2 segments.
+ * @ingroup buffers
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T
+ * @tparam N capacity: a power of 2
+ */
+template <typename T, int N>
+class RingBufferN : public BaseBuffer<T> {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+ public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_BUFFER)
+  RingBufferN() = default;
+
+  static constexpr int capacity() { return N; }
+
+  T read() override {
+    if (isEmpty()) return -1;
+    T value = buffer[tail & MASK];
+    tail++;
+    return value;
+  }
+
+  T peek() override {
+    if (isEmpty()) return -1;
+    return buffer[tail & MASK];
+  }
+
+  bool write(T data) override {
+    if (isFull()) return false;
+    buffer[head & MASK] = data;
+    head++;
+    return true;
+  }
+
+  int writeArray(const T data[], int len) override {
+    int result = min(len, availableForWrite());
+    if (result <= 0) return 0;
+    int idx = head & MASK;
+    int len1 = min(result, N - idx);
+    memcpy(buffer + idx, data, len1 * sizeof(T));
+    memcpy(buffer, data + len1, (result - len1) * sizeof(T));
+    head += result;
+    return result;
+  }
+
+  int readArray(T data[], int len) override {
+    int result = peekArray(data, len);
+    tail += result;
+    return result;
+  }
+
+  /// Copies multiple entries w/o removing them
+  int peekArray(T data[], int len) {
+    int result = min(len, available());
+    if (result <= 0) return 0;
+    int idx = tail & MASK;
+    int len1 = min(result, N - idx);
+    memcpy(data, buffer + idx, len1 * sizeof(T));
+    memcpy(data + len1, buffer, (result - len1) * sizeof(T));
+    return result;
+  }
+
+  int clearArray(int len) override {
+    int result = min(len, available());
+    if (result <= 0) return 0;
+    tail += result;
+    return result;
+  }
+
+  bool isFull() override { return available() == N; }
+
+  bool isEmpty() { return head == tail; }
+
+  void reset() override {
+    head = 0;
+    tail = 0;
+  }
+
+  int available() override { return head - tail; }
+
+  int availableForWrite() override { return N - available(); }
+
+  T *address() override { return buffer; }
+
+  size_t size() override { return N; }
+
+  /// Provides the start of the contiguous region which can be read
+  T *readPtr() { return buffer + (tail & MASK); }
+
+  /// Number of entries which can be read from readPtr()
+  int readPtrSize() { return min(available(), N - (int)(tail & MASK)); }
+
+  /// Releases n entries which have been read from readPtr()
+  int consume(int n) {
+    int result = min(n, readPtrSize());
+    if (result <= 0) return 0;
+    tail += result;
+    return result;
+  }
+
+  /// Provides the start of the contiguous region which can be written
+  T *writePtr() { return buffer + (head & MASK); }
+
+  /// Number of entries which can be written to writePtr()
+  int writePtrSize() { return min(availableForWrite(), N - (int)(head & MASK)); }
+
+  /// Confirms that n entries have been written to writePtr()
+  bool commitWrite(int n) {
+    if (n < 0 || n > writePtrSize()) return false;
+    head += n;
+    return true;
+  }
+
+ protected:
+  static constexpr uint32_t MASK = N - 1;
+  T buffer[N];
+  // free running positions
+  uint32_t head = 0;
+  uint32_t tail = 0;
+};
+
 /**
  * @brief An File backed Ring Buffer that we can use to receive
  * streaming audio. We expect an open p_file as parameter.
@@ -401,6 +623,7 @@ class RingBuffer : public BaseBuffer<T> {
 template <class File, typename T>
 class RingBufferFile : public BaseBuffer<T> {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_BUFFER)
   RingBufferFile(bool autoRewind = true) { setAutoRewind(autoRewind); }
   RingBufferFile(File &file, bool autoRewind = true) {
     setFile(file);
@@ -548,6 +771,186 @@ class RingBufferFile : public BaseBuffer<T> {
   }
 };
 
+/**
+ * @brief A File backed Ring Buffer with a fixed capacity which accesses the
+ * file only in full blocks (e.g. 512 bytes or 4 KB sectors of a SD card):
+ * the data is collected in a write back block cache and the reads are served
+ * from a read block cache, so that we need to seek only once per block. The
+ * data which has not been written to the file yet is read directly from the
+ * write cache. Call flush() if you want to persist the pending data.
+ * @ingroup buffers
+ * @tparam File
+ * @tparam T
+ */
+template <class File, typename T>
+class RingBufferFileCached : public BaseBuffer<T> {
+ public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_BUFFER)
+  RingBufferFileCached(int blockSize = 512) { setBlockSize(blockSize); }
+  RingBufferFileCached(File &file, size_t size, int blockSize = 512) {
+    setBlockSize(blockSize);
+    setFile(file);
+    resize(size);
+  }
+
+  /// Defines the size of the cached blocks: call before resize()
+  void setBlockSize(int blockSize) { block_size = blockSize; }
+
+  /// Assigns the file to be used
+  void setFile(File &bufferFile) {
+    p_file = &bufferFile;
+    if (!*p_file) {
+      LOGE("file is not valid");
+    }
+  }
+
+  /// Defines the capacity in entries: it is rounded up to full blocks
+  bool resize(size_t size) {
+    size_t bytes = size * sizeof(T);
+    block_count = (bytes + block_size - 1) / block_size;
+    if (block_count == 0) block_count = 1;
+    read_cache.resize(block_size);
+    write_cache.resize(block_size);
+    reset();
+    return true;
+  }
+
+  T read() override {
+    T result = 0;
+    if (readArray(&result, 1) != 1) return -1;
+    return result;
+  }
+
+  T peek() override {
+    T result = 0;
+    uint64_t pos = tail;
+    if (readBytes((uint8_t *)&result, sizeof(T), pos) != sizeof(T)) return -1;
+    return result;
+  }
+
+  bool write(T data) override { return writeArray(&data, 1) == 1; }
+
+  /// reads multiple values
+  int readArray(T data[], int count) override {
+    if (p_file == nullptr) return 0;
+    int read_count = min(count, available());
+    uint64_t pos = tail;
+    size_t bytes = readBytes((uint8_t *)data, read_count * sizeof(T), pos);
+    tail = pos;
+    return bytes / sizeof(T);
+  }
+
+  /// Fills the data into the buffer
+  int writeArray(const T data[], int len) override {
+    if (p_file == nullptr) return 0;
+    int write_count = min(len, availableForWrite());
+    const uint8_t *src = (const uint8_t *)data;
+    size_t open = write_count * sizeof(T);
+    while (open > 0) {
+      size_t offset = head % block_size;
+      size_t n = min(open, (size_t)block_size - offset);
+      memcpy(write_cache.data() + offset, src, n);
+      src += n;
+      open -= n;
+      head += n;
+      // write back the full block
+      if (head % block_size == 0) writeBlock(head / block_size - 1, block_size);
+    }
+    return write_count;
+  }
+
+  /// Writes the pending data of the write cache to the file
+  void flush() {
+    size_t offset = head % block_size;
+    if (p_file != nullptr && offset > 0) {
+      writeBlock(head / block_size, offset);
+    }
+    if (p_file != nullptr) p_file->flush();
+  }
+
+  void reset() override {
+    head = 0;
+    tail = 0;
+    read_block = -1;
+  }
+
+  int available() override { return (head - tail) / sizeof(T); }
+
+  int availableForWrite() override {
+    return (capacity() - (head - tail)) / sizeof(T);
+  }
+
+  bool isFull() override { return availableForWrite() == 0; }
+
+  /// not supported
+  T *address() override { return nullptr; }
+
+  /// Provides the capacity in entries
+  size_t size() override { return capacity() / sizeof(T); }
+
+ protected:
+  File *p_file = nullptr;
+  Vector<uint8_t> read_cache{0};
+  Vector<uint8_t> write_cache{0};
+  int block_size = 512;
+  size_t block_count = 0;
+  // free running byte positions
+  uint64_t head = 0;
+  uint64_t tail = 0;
+  // absolute block number which is in the read cache
+  int64_t read_block = -1;
+
+  size_t capacity() { return block_count * block_size; }
+
+  size_t readBytes(uint8_t *data, size_t len, uint64_t &pos) {
+    size_t result = 0;
+    while (result < len) {
+      int64_t block = pos / block_size;
+      size_t offset = pos % block_size;
+      size_t n = min(len - result, (size_t)block_size - offset);
+      uint8_t *src;
+      if (block == (int64_t)(head / block_size)) {
+        // not written to the file yet
+        src = write_cache.data();
+      } else {
+        if (block != read_block && !readBlock(block)) break;
+        src = read_cache.data();
+      }
+      memcpy(data + result, src + offset, n);
+      result += n;
+      pos += n;
+    }
+    return result;
+  }
+
+  bool readBlock(int64_t block) {
+    seekBlock(block);
+    size_t len = p_file->readBytes(read_cache.data(), block_size);
+    if (len != (size_t)block_size) {
+      LOGE("readBytes: %d -> %d", block_size, (int)len);
+      read_block = -1;
+      return false;
+    }
+    read_block = block;
+    return true;
+  }
+
+  void writeBlock(int64_t block, size_t len) {
+    seekBlock(block);
+    size_t written = p_file->write(write_cache.data(), len);
+    if (written != len) {
+      LOGE("write: %d -> %d", (int)len, (int)written);
+    }
+  }
+
+  void seekBlock(int64_t block) {
+    uint32_t pos = (block % block_count) * block_size;
+    if (!p_file->seek(pos)) {
+      LOGE("seek %u", (unsigned)pos);
+    }
+  }
+};
+
 /**
  * @brief A lock free N buffer. If count=2 we create a DoubleBuffer, if
  * count=3 a TripleBuffer etc.
@@ -558,10 +961,22 @@ class RingBufferFile : public BaseBuffer<T> {
 template <typename T>
 class NBuffer : public BaseBuffer<T> {
  public:
-  NBuffer(int size, int count) {
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_BUFFER)
+  NBuffer(int size, int count, Allocator &allocator = HotAllocator) {
+    setAllocator(allocator);
     resize(size, count);
   }
 
+  /// Defines the allocator which is used for the buffers: call before resize()
+  void setAllocator(Allocator &allocator) {
+    freeMemory();
+    p_allocator = &allocator;
+    filled_buffers.setAllocator(allocator);
+    avaliable_buffers.setAllocator(allocator);
+    buffer_size = 0;
+    buffer_count = 0;
+  }
+
   virtual ~NBuffer() {
     freeMemory();
   }
@@ -721,7 +1136,7 @@ class NBuffer : public BaseBuffer<T> {
     buffer_count = count;
     buffer_size = size;
     for (int j = 0; j < count; j++) {
-      avaliable_buffers[j] = new SingleBuffer<T>(size);
+      avaliable_buffers[j] = newBuffer(size);
       if (avaliable_buffers[j] == nullptr) {
         LOGE("Not Enough Memory for buffer %d", j);
       }
@@ -740,25 +1155,37 @@ class NBuffer : public BaseBuffer<T> {
   Vector<BaseBuffer<T> *> filled_buffers;
   unsigned long start_time = 0;
   unsigned long sample_count = 0;
+  Allocator *p_allocator = &HotAllocator;
 
   // empty constructor only allowed by subclass
   NBuffer() = default;
 
+  /// Allocates a SingleBuffer (incl. the data) with the allocator
+  BaseBuffer<T> *newBuffer(int size) {
+    void *addr = p_allocator->allocate(sizeof(SingleBuffer<T>));
+    if (addr == nullptr) return nullptr;
+    return new (addr) SingleBuffer<T>(size, *p_allocator);
+  }
+
+  void deleteBuffer(BaseBuffer<T> *buffer) {
+    p_allocator->remove((SingleBuffer<T> *)buffer);
+  }
+
   void freeMemory()  {
-    delete actual_write_buffer;
+    if (actual_write_buffer != nullptr) deleteBuffer(actual_write_buffer);
     actual_write_buffer = nullptr;
-    delete actual_read_buffer;
+    if (actual_read_buffer != nullptr) deleteBuffer(actual_read_buffer);
     actual_read_buffer = nullptr;
 
     BaseBuffer<T> *ptr = getNextAvailableBuffer();
     while (ptr != nullptr) {
-      delete ptr;
+      deleteBuffer(ptr);
       ptr = getNextAvailableBuffer();
     }
 
     ptr = getNextFilledBuffer();
     while (ptr != nullptr) {
-      delete ptr;
+      deleteBuffer(ptr);
       ptr = getNextFilledBuffer();
     }
   }
@@ -833,6 +1260,7 @@ class NBuffer : public BaseBuffer<T> {
 template <typename T>
 class BufferedArray {
  public:
+  AUDIO_LOG_MIN_LEVEL(LOG_MIN_LEVEL_BUFFER)
   BufferedArray(Stream &input, int len) {
     LOGI("BufferedArray(%d)", len);
     array.resize(len);
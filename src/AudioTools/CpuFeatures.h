@@ -0,0 +1,83 @@
+#pragma once
+#include "AudioConfig.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Runtime detection of the instruction set extensions for the desktop
+ * builds: the AudioKernels are compiled for the generic target, but provide
+ * additional variants (e.g. AVX2) which are selected at runtime, so that a
+ * single binary uses the best instruction set of the actual CPU. On ARM64
+ * NEON is part of the base architecture and is always available.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CpuFeatures {
+ public:
+  /// Returns true if the AVX2 instructions are available and active
+  static bool hasAVX2() {
+    static bool result = detectAVX2();
+    return result && isActive();
+  }
+
+  /// Returns true if the SSE4.1 instructions are available and active
+  static bool hasSSE41() {
+    static bool result = detectSSE41();
+    return result && isActive();
+  }
+
+  /// Returns true if NEON is available
+  static bool hasNEON() {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /// Name of the best instruction set which is used by the AudioKernels
+  static const char *name() {
+    if (hasAVX2()) return "AVX2";
+    if (hasSSE41()) return "SSE4.1";
+    if (hasNEON()) return "NEON";
+#if defined(__SSE2__)
+    return "SSE2";
+#else
+    return "generic";
+#endif
+  }
+
+  /// Deactivates the runtime dispatch e.g. to compare the results with the
+  /// generic implementation
+  static void setActive(bool active) { is_active_ref() = active; }
+
+  /// Returns true if the runtime dispatch is active
+  static bool isActive() { return is_active_ref(); }
+
+ protected:
+  static bool &is_active_ref() {
+    static bool is_active = true;
+    return is_active;
+  }
+
+  static bool detectAVX2() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+  }
+
+  static bool detectSSE41() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.1");
+#else
+    return false;
+#endif
+  }
+};
+
+}  // namespace audio_tools
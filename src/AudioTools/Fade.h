@@ -1,13 +1,63 @@
 #pragma once
 #include "AudioConfig.h"
 #include "AudioStreams.h"
+#include "AudioTools/AudioKernels.h"
 
 namespace audio_tools {
 
+/// Number of frames which are processed with the same gain
+#ifndef FADE_BLOCK_FRAMES
+#  define FADE_BLOCK_FRAMES 16
+#endif
+
+/// Shape of the fade in/fade out
+enum FadeCurve { FadeLinear, FadeEqualPower, FadeLog };
+
+/**
+ * @brief Precalculated fade curves (linear, equal power and logarithmic)
+ * with Q16.16 gains which are shared by all faders
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FadeTable {
+ public:
+  /// Number of steps of the curves
+  static const int SIZE = 256;
+
+  /// Provides the Q16.16 gain for the position 0..SIZE
+  static int32_t gain(FadeCurve curve, int pos) {
+    if (pos < 0) pos = 0;
+    if (pos > SIZE) pos = SIZE;
+    return table(curve)[pos];
+  }
+
+ protected:
+  static const int32_t *table(FadeCurve curve) {
+    static int32_t tables[3][SIZE + 1];
+    static bool is_setup = false;
+    if (!is_setup) {
+      for (int j = 0; j <= SIZE; j++) {
+        float x = static_cast<float>(j) / SIZE;
+        tables[FadeLinear][j] = AudioKernels::toGainQ16(x);
+        tables[FadeEqualPower][j] =
+            AudioKernels::toGainQ16(sin(x * static_cast<float>(PI) / 2.0f));
+        // 60 dB range which reaches 0 at the start
+        tables[FadeLog][j] =
+            AudioKernels::toGainQ16((powf(1000.0f, x) - 1.0f) / 999.0f);
+      }
+      is_setup = true;
+    }
+    return tables[curve];
+  }
+};
+
 /**
  * @brief Fade In and Fade out in order to prevent popping sound when the
  * audio is started or stopped. The fade in/out is performed over the length
- * of the buffer.
+ * of the buffer: the data is processed in blocks of FADE_BLOCK_FRAMES with
+ * a gain from the precalculated FadeTable using the AudioKernels. When no
+ * fade is active the data is not touched.
  *
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -18,7 +68,6 @@ public:
   void setFadeInActive(bool flag) {
     is_fade_in = flag;
     if (is_fade_in) {
-      volume = 0.0;
       is_fade_out = false;
       is_done = false;
     }
@@ -29,7 +78,6 @@ public:
   void setFadeOutActive(bool flag) {
     is_fade_out = flag;
     if (is_fade_out) {
-      volume = 1.0;
       is_fade_in = false;
       is_done = false;
     }
@@ -37,6 +85,11 @@ public:
 
   bool isFadeOutActive() { return is_fade_out; }
 
+  /// Defines the shape of the fade (default FadeLinear)
+  void setFadeCurve(FadeCurve curve) { this->curve = curve; }
+
+  FadeCurve fadeCurve() { return curve; }
+
   /// @brief Updates the amplitude of the data when a fade in or fade out has
   /// been requested
   /// @param data
@@ -45,6 +98,7 @@ public:
   /// @param bitsPerSample
   void convert(uint8_t *data, int bytes, int channels, int bitsPerSample) {
     this->channels = channels;
+    if (!is_fade_in && !is_fade_out) return;
     int bytes_per_sample = bitsPerSample / 8;
     switch (bitsPerSample) {
     case 16:
@@ -68,58 +122,37 @@ public:
   /// Returns true if the conversion has been executed with any data
   bool isFadeComplete() { return is_done; }
 
+  template <typename T> void convertFrames(T *data, int frames, int channels) {
+    if (frames <= 0 || (!is_fade_in && !is_fade_out)) return;
+    LOGI("fade %s %d frames", is_fade_in ? "in" : "out", frames);
+    fadeBlocks<T>(data, frames, channels, is_fade_in);
+    is_fade_in = false;
+    is_fade_out = false;
+    is_done = true;
+  }
+
 protected:
   bool is_fade_in = false;
   bool is_fade_out = false;
   int channels = 2;
-  float volume = 1.0;
   bool is_done = false;
+  FadeCurve curve = FadeLinear;
 
-  template <typename T> void convertFrames(T *data, int frames, int channels) {
-    float delta = 1.0 / frames;
-    // handle fade out
-    if (is_fade_in) {
-      fadeIn<T>(data, frames, channels, delta);
-      is_fade_in = false;
-    }  else if (is_fade_out) {
-      fadeOut<T>(data, frames, channels, delta);
-    }
-    if (frames > 0) {
-      is_done = true;
-    }
-  }
-
-  template <typename T>
-  void fadeOut(T *data, int frames, int channels, float delta) {
-    for (int j = 0; j < frames; j++) {
-      for (int ch = 0; ch < channels; ch++) {
-        data[j * channels + ch] = data[j * channels + ch] * volume;
-        if (volume > 0) {
-          volume -= delta;
-          if (volume < 0) {
-            volume = 0;
-          }
-        }
-      }
-    }
-    is_fade_out = false;
-    LOGI("faded out %d frames to volume %f",frames, volume);
-  }
-
+  /// applies the gain of the curve block by block
   template <typename T>
-  void fadeIn(T *data, int frames, int channels, float delta) {
-    LOGI("fade in %d frames from volume %f",frames, volume);
-    for (int j = 0; j < frames; j++) {
-      for (int ch = 0; ch < channels; ch++) {
-        data[j * channels + ch] = data[j * channels + ch] * volume;
-        volume += delta;
-        if (volume > 1.0f) {
-          volume = 1.0f;
-        }
-      }
+  void fadeBlocks(T *data, int frames, int channels, bool fadeIn) {
+    int32_t gains[channels];
+    for (int start = 0; start < frames; start += FADE_BLOCK_FRAMES) {
+      int n = min(FADE_BLOCK_FRAMES, frames - start);
+      // use the gain at the center of the block
+      int pos = (static_cast<int64_t>(2 * start + n) * FadeTable::SIZE) /
+                (2 * frames);
+      int32_t gain =
+          FadeTable::gain(curve, fadeIn ? pos : FadeTable::SIZE - pos);
+      for (int ch = 0; ch < channels; ch++) gains[ch] = gain;
+      AudioKernels::applyGain(data + start * channels, n * channels, channels,
+                              gains);
     }
-    volume = 1.0f;
-    is_fade_in = false;
   }
 };
 
@@ -146,14 +179,20 @@ public:
   /// @brief When we do not have any data any more to fade out we try to bring
   /// the last sample slowly to 0
   void end(Print &print, int steps = 200) {
-    T out[channels];
-    for (int j = 0; j < steps; j++) {
-      for (int ch = 0; ch < channels; ch++) {
-        float factor =
-            static_cast<float>(steps - j) / static_cast<float>(steps);
-        out[ch] = last[ch] * factor;
+    if (channels == 0 || steps <= 0) return;
+    // generate the ramp in blocks of FADE_BLOCK_FRAMES frames
+    T out[FADE_BLOCK_FRAMES * channels];
+    int j = 0;
+    while (j < steps) {
+      int n = min(FADE_BLOCK_FRAMES, steps - j);
+      for (int k = 0; k < n; k++, j++) {
+        int32_t gain = (static_cast<int64_t>(steps - j) << 16) / steps;
+        for (int ch = 0; ch < channels; ch++) {
+          out[k * channels + ch] =
+              (static_cast<int64_t>(last[ch]) * gain) >> 16;
+        }
       }
-      print.write((uint8_t *)out, channels * sizeof(T));
+      print.write((uint8_t *)out, n * channels * sizeof(T));
     }
   }
 
@@ -161,10 +200,12 @@ protected:
   int channels = 0;
   Vector<T> last{0};
 
+  /// we only need to copy the last frame
   void storeLastSamples(int frames, uint8_t *src) {
-    T *data = (T *)src;
+    if (frames <= 0) return;
+    T *data = (T *)src + (frames - 1) * channels;
     for (int ch = 0; ch < channels; ch++) {
-      last[ch] = data[frames - 2 * channels + ch];
+      last[ch] = data[ch];
     }
   }
 };
@@ -275,9 +316,10 @@ public:
       LOGE("%s", error_msg);
       return 0;
     }
-    fade.convert(data, len, info.channels, info.bits_per_sample);
-    fade_last.write(data, len);
-    return p_io->readBytes(data, len);
+    size_t result = p_io->readBytes(data, len);
+    fade.convert(data, result, info.channels, info.bits_per_sample);
+    fade_last.write(data, result);
+    return result;
   }
 
   int available() override { return p_io == nullptr ? 0 : p_io->available(); }
@@ -288,9 +330,7 @@ public:
       LOGE("%s", error_msg);
       return 0;
     }
-    if (fade.isFadeInActive() || fade.isFadeOutActive()){
-      fade.convert((uint8_t *)data, len, info.channels, info.bits_per_sample);
-    }
+    fade.convert((uint8_t *)data, len, info.channels, info.bits_per_sample);
     // update last information
     fade_last.write((uint8_t *)data, len);
     // write faded data
@@ -311,6 +351,9 @@ public:
 
   bool isFadeComplete() { return fade.isFadeComplete(); }
 
+  /// Defines the shape of the fade (default FadeLinear)
+  void setFadeCurve(FadeCurve curve) { fade.setFadeCurve(curve); }
+
   // If can not provide any more samples we bring the last sample slowy back to 0
   void writeEnd(Print &print, int steps = 200) {
     fade_last.end(print, steps);
@@ -346,9 +389,12 @@ public:
 
   bool isFadeComplete() { return fade.isFadeComplete(); }
 
+  /// Defines the shape of the fade (default FadeLinear)
+  void setFadeCurve(FadeCurve curve) { fade.setFadeCurve(curve); }
+
   virtual size_t convert(uint8_t *src, size_t size) {
     int frames = size / sizeof(T) / channels;
-    fade.convertFrames<T>(src, frames, channels);
+    fade.convertFrames<T>((T *)src, frames, channels);
     return size;
   };
 
@@ -0,0 +1,329 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioFilter/Filter.h"
+#include "AudioTools/AudioFrameBuffer.h"
+#include "AudioTools/AudioStreams.h"
+#include "Concurrency/QueueLockFree.h"
+#if defined(ESP32)
+#  include "Concurrency/Task.h"
+#  define USE_FILTER_WORKER
+#elif defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || \
+    defined(USE_STD_CONCURRENCY)
+#  include <atomic>
+#  include <thread>
+#  define USE_FILTER_WORKER
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief FilteredStream which splits the channels into two groups: the
+ * channels starting from setWorkerChannels() are filtered by a worker (a
+ * FreeRTOS task which is pinned to the other core on the ESP32, std::thread
+ * on the desktop) while the remaining channels are filtered by the caller.
+ *
+ * The interleaved data is collected in blocks of setFrames() frames and
+ * deinterleaved into an AudioFrameBuffer. With two blocks (double
+ * buffering) the filtering of the actual block overlaps with the output of
+ * the previous block, so that writing has a latency of one block: call
+ * flush() or end() to output the pending data. readBytes() processes the
+ * data without latency. The jobs are handed over to the worker with a
+ * QueueLockFree.
+ *
+ * Unlike the FilteredStream the filters are not deleted by this class. On
+ * platforms without tasks or threads all channels are filtered by the
+ * caller.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T, class TF>
+class FilteredStreamParallel : public ModifyingStream {
+ public:
+  FilteredStreamParallel() = default;
+
+  FilteredStreamParallel(Stream &stream, int channels = 2) {
+    setStream(stream);
+    setChannels(channels);
+  }
+
+  FilteredStreamParallel(Print &out, int channels = 2) {
+    setOutput(out);
+    setChannels(channels);
+  }
+
+  ~FilteredStreamParallel() { end(); }
+
+  void setStream(Stream &stream) override {
+    p_stream = &stream;
+    p_print = &stream;
+  }
+
+  void setOutput(Print &out) override { p_print = &out; }
+
+  /// Defines the number of channels
+  void setChannels(int channels) {
+    this->channels = channels;
+    filters.resize(channels);
+  }
+
+  /// Defines the filter for an individual channel - the first channel is 0
+  void setFilter(int channel, Filter<TF> *filter) {
+    if (channel >= channels) {
+      LOGE("Invalid channel nummber %d - max channel is %d", channel,
+           channels - 1);
+      return;
+    }
+    filters[channel] = filter;
+  }
+
+  void setFilter(int channel, Filter<TF> &filter) {
+    setFilter(channel, &filter);
+  }
+
+  /// Defines the first channel which is processed by the worker: by default
+  /// the worker processes the second half of the channels
+  void setWorkerChannels(int firstChannel) { worker_channel = firstChannel; }
+
+  /// Defines the number of frames of a block
+  void setFrames(int frames) { block_frames = frames; }
+
+#if defined(ESP32)
+  /// Defines the stack, priority and core of the worker task
+  void setWorkerTask(int stackSize, int priority = 1, int core = 0) {
+    stack_size = stackSize;
+    task_priority = priority;
+    task_core = core;
+  }
+#endif
+
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    setChannels(info.channels);
+    return begin();
+  }
+
+  bool begin() override {
+    end();
+    if (channels <= 0 || block_frames <= 0) {
+      LOGE("channels and frames must not be 0");
+      return false;
+    }
+    split = worker_channel < 0 ? channels / 2 : worker_channel;
+    if (split > channels) split = channels;
+    for (int j = 0; j < 2; j++) {
+      blocks[j].pcm.resize(block_frames * channels);
+      blocks[j].planar.resize(channels, block_frames);
+      blocks[j].samples = 0;
+    }
+    actual = 0;
+    pending = -1;
+    jobs.clear();
+    done.clear();
+    startWorker();
+    is_active = true;
+    return AudioStream::begin();
+  }
+
+  void end() override {
+    if (is_active) flush();
+    stopWorker();
+    is_active = false;
+  }
+
+  /// Outputs the pending data
+  void flush() override {
+    if (!is_active) return;
+    Block &block = blocks[actual];
+    if (block.samples >= channels) {
+      submit(actual);
+      finish(pending, true);
+      pending = actual;
+      actual ^= 1;
+    }
+    finish(pending, true);
+    pending = -1;
+    blocks[actual].samples = 0;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (!is_active || p_print == nullptr) return 0;
+    const T *samples = (const T *)data;
+    int n = len / sizeof(T);
+    int pos = 0;
+    int block_samples = block_frames * channels;
+    while (pos < n) {
+      Block &block = blocks[actual];
+      int count = min(n - pos, block_samples - block.samples);
+      memcpy(block.pcm.data() + block.samples, samples + pos,
+             count * sizeof(T));
+      block.samples += count;
+      pos += count;
+      if (block.samples == block_samples) {
+        // filter the actual block while we output the previous one
+        submit(actual);
+        finish(pending, true);
+        pending = actual;
+        actual ^= 1;
+      }
+    }
+    return n * sizeof(T);
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (!is_active || p_stream == nullptr) return 0;
+    size_t result = p_stream->readBytes(data, len);
+    T *samples = (T *)data;
+    int n = result / sizeof(T);
+    int block_samples = block_frames * channels;
+    Block &block = blocks[actual];
+    for (int pos = 0; pos < n; pos += block_samples) {
+      block.samples = min(n - pos, block_samples);
+      memcpy(block.pcm.data(), samples + pos, block.samples * sizeof(T));
+      submit(actual);
+      finish(actual, false);
+      memcpy(samples + pos, block.pcm.data(), block.samples * sizeof(T));
+    }
+    block.samples = 0;
+    return result;
+  }
+
+  int available() override {
+    return p_stream == nullptr ? 0 : p_stream->available();
+  }
+
+  int availableForWrite() override {
+    return p_print == nullptr ? 0 : p_print->availableForWrite();
+  }
+
+  /// Latency of the write() in frames
+  int latency() { return block_frames; }
+
+ protected:
+  struct Block {
+    Vector<T> pcm{0};
+    AudioFrameBuffer<TF> planar;
+    int samples = 0;
+  };
+  Stream *p_stream = nullptr;
+  Print *p_print = nullptr;
+  Vector<Filter<TF> *> filters{0};
+  int channels = 0;
+  int block_frames = 256;
+  int worker_channel = -1;
+  int split = 0;
+  Block blocks[2];
+  int actual = 0;
+  int pending = -1;
+  bool is_active = false;
+  QueueLockFree<int> jobs{2};
+  QueueLockFree<int> done{2};
+#if defined(ESP32)
+  Task task;
+  TaskHandle_t caller = nullptr;
+  int stack_size = 4096;
+  int task_priority = 1;
+  int task_core = 0;
+#elif defined(USE_FILTER_WORKER)
+  std::thread thread;
+  std::atomic<bool> is_running{false};
+#endif
+
+  /// Deinterleaves the block and starts the filtering
+  void submit(int idx) {
+    Block &block = blocks[idx];
+    block.planar.fromInterleaved(block.pcm.data(), block.samples / channels);
+#ifdef USE_FILTER_WORKER
+    if (split < channels) {
+#  if defined(ESP32)
+      caller = xTaskGetCurrentTaskHandle();
+      jobs.enqueue(idx);
+      xTaskNotifyGive(task.getTaskHandle());
+#  else
+      jobs.enqueue(idx);
+#  endif
+    }
+    filterChannels(block, 0, split);
+#else
+    filterChannels(block, 0, channels);
+#endif
+  }
+
+  /// Waits for the worker and interleaves the result
+  void finish(int idx, bool output) {
+    if (idx < 0) return;
+    Block &block = blocks[idx];
+#ifdef USE_FILTER_WORKER
+    if (split < channels) {
+      int result;
+      while (!done.dequeue(result)) {
+#  if defined(ESP32)
+        ulTaskNotifyTake(pdTRUE, 1);
+#  else
+        std::this_thread::yield();
+#  endif
+      }
+    }
+#endif
+    T *pcm = block.pcm.data();
+    for (int ch = 0; ch < channels; ch++) {
+      if (filters[ch] != nullptr) block.planar.toInterleaved(pcm, ch);
+    }
+    if (output) {
+      p_print->write((const uint8_t *)pcm, block.samples * sizeof(T));
+      block.samples = 0;
+    }
+  }
+
+  void filterChannels(Block &block, int from, int to) {
+    for (int ch = from; ch < to; ch++) {
+      Filter<TF> *p_filter = filters[ch];
+      if (p_filter == nullptr) continue;
+      TF *planar = block.planar.channel(ch);
+      p_filter->process(planar, planar, block.planar.frames());
+    }
+  }
+
+  /// Processes the next job of the worker
+  void processJob() {
+    int idx;
+    if (!jobs.dequeue(idx)) {
+#if defined(ESP32)
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#elif defined(USE_FILTER_WORKER)
+      std::this_thread::yield();
+#endif
+      return;
+    }
+    filterChannels(blocks[idx], split, channels);
+    done.enqueue(idx);
+#if defined(ESP32)
+    xTaskNotifyGive(caller);
+#endif
+  }
+
+  void startWorker() {
+    if (split >= channels) return;
+#if defined(ESP32)
+    task.create("filter", stack_size, task_priority, task_core);
+    task.begin([this]() { processJob(); });
+#elif defined(USE_FILTER_WORKER)
+    is_running = true;
+    thread = std::thread([this]() {
+      while (is_running) processJob();
+    });
+#endif
+  }
+
+  void stopWorker() {
+#if defined(ESP32)
+    task.remove();
+#elif defined(USE_FILTER_WORKER)
+    is_running = false;
+    if (thread.joinable()) thread.join();
+#endif
+  }
+};
+
+}  // namespace audio_tools
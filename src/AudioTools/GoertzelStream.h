@@ -0,0 +1,293 @@
+#pragma once
+#include <math.h>
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioStreams.h"
+#include "AudioTools/AudioTypes.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Config for GoertzelStream
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct GoertzelConfig : public AudioInfo {
+  GoertzelConfig() {
+    bits_per_sample = 16;
+    channels = 1;
+    sample_rate = 8000;
+  }
+  /// number of frames which are analyzed together: a bigger block gives a
+  /// better frequency resolution (sample_rate / block_size) but reacts slower
+  int block_size = 205;
+  /// normalized amplitude (0.0 to 1.0) above which a frequency is reported
+  float threshold = 0.1f;
+  /// analyzed channel: -1 analyzes the sum of all channels
+  int channel = 0;
+  /// use integer arithmetic for processors w/o FPU
+  bool fixed_point = false;
+};
+
+/**
+ * @brief Goertzel filter for a single frequency: the samples are processed
+ * one by one, so that we need to keep only 2 state values. The float
+ * variant expects normalized values (-1.0 to 1.0), the fixed point variant
+ * 16 bit samples and a Q14 coefficient.
+ * @ingroup fft
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class GoertzelDetector {
+ public:
+  GoertzelDetector() = default;
+  GoertzelDetector(float frequency) { this->frequency = frequency; }
+
+  /// Calculates the coefficient for the sample rate
+  void begin(int sampleRate) {
+    float omega = 2.0f * PI * frequency / sampleRate;
+    coeff = 2.0f * cosf(omega);
+    coeff_q14 = roundf(coeff * 16384.0f);
+    reset();
+  }
+
+  /// Clears the state at the start of a block
+  void reset() {
+    s1 = s2 = 0.0f;
+    s1_q = s2_q = 0;
+  }
+
+  /// Processes a normalized sample
+  inline void update(float sample) {
+    float s = sample + coeff * s1 - s2;
+    s2 = s1;
+    s1 = s;
+  }
+
+  /// Processes a 16 bit sample with integer arithmetic
+  inline void updateQ15(int32_t sample) {
+    int32_t s =
+        sample + ((static_cast<int64_t>(coeff_q14) * s1_q) >> 14) - s2_q;
+    s2_q = s1_q;
+    s1_q = s;
+  }
+
+  /// Determines the normalized amplitude (0.0 to 1.0) of the frequency at the
+  /// end of a block with the indicated number of samples
+  float magnitude(int samples, bool fixedPoint = false) {
+    float power;
+    if (fixedPoint) {
+      int64_t a = s1_q;
+      int64_t b = s2_q;
+      int64_t p = a * a + b * b - ((coeff_q14 * a >> 14) * b);
+      power = p / (32768.0f * 32768.0f);
+    } else {
+      power = s1 * s1 + s2 * s2 - coeff * s1 * s2;
+    }
+    if (power <= 0.0f) return 0.0f;
+    return 2.0f * sqrtf(power) / samples;
+  }
+
+  float getFrequency() { return frequency; }
+
+ protected:
+  float frequency = 0.0f;
+  float coeff = 0.0f;
+  float s1 = 0.0f;
+  float s2 = 0.0f;
+  int32_t coeff_q14 = 0;
+  int32_t s1_q = 0;
+  int32_t s2_q = 0;
+};
+
+/**
+ * @brief Tone detection with a bank of Goertzel filters: unlike the FFT only
+ * the requested frequencies (e.g. the 8 DTMF tones, pilot or alarm tones)
+ * are evaluated and this is done incrementally for each sample, so that no
+ * buffering is needed. At the end of each block the frequencies with an
+ * amplitude above the threshold are reported via the callback.
+ * It can be used as pass through stream or just as output.
+ * @ingroup fft
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class GoertzelStream : public ModifyingStream {
+ public:
+  GoertzelStream() = default;
+  GoertzelStream(Stream &in) { setStream(in); }
+  GoertzelStream(Print &out) { setOutput(out); }
+
+  /// Defines/Changes the input & output
+  void setStream(Stream &in) override {
+    p_in = &in;
+    p_out = &in;
+  }
+
+  /// Defines/Changes the output target
+  void setOutput(Print &out) override { p_out = &out; }
+
+  GoertzelConfig defaultConfig() {
+    GoertzelConfig cfg;
+    return cfg;
+  }
+
+  /// Adds a frequency which should be detected: call before begin()
+  void addFrequency(float frequency) {
+    detectors.push_back(GoertzelDetector(frequency));
+  }
+
+  /// Adds the 4 low and 4 high DTMF frequencies
+  void addDTMFFrequencies() {
+    const float freq[] = {697, 770, 852, 941, 1209, 1336, 1477, 1633};
+    for (float f : freq) addFrequency(f);
+  }
+
+  /// Defines the callback which is called for each detected frequency at the
+  /// end of a block
+  void setCallback(void (*callback)(float frequency, float magnitude,
+                                    void *ref),
+                   void *ref = nullptr) {
+    p_callback = callback;
+    p_ref = ref;
+  }
+
+  bool begin(GoertzelConfig cfg) {
+    this->cfg = cfg;
+    setAudioInfo(cfg);
+    return begin();
+  }
+
+  bool begin() override {
+    cfg.copyFrom(info);
+    if (cfg.block_size <= 0 || cfg.channel >= cfg.channels) {
+      LOGE("Invalid block_size or channel");
+      return false;
+    }
+    magnitudes.resize(detectors.size());
+    for (auto &detector : detectors) detector.begin(cfg.sample_rate);
+    frame_count = 0;
+    channel = 0;
+    sum = 0;
+    return true;
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_in == nullptr) return 0;
+    size_t result = p_in->readBytes(data, len);
+    process(data, result);
+    return result;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    process(data, len);
+    // w/o output we just detect
+    if (p_out == nullptr) return len;
+    return p_out->write(data, len);
+  }
+
+  int available() override { return p_in == nullptr ? 0 : p_in->available(); }
+
+  int availableForWrite() override {
+    return p_out == nullptr ? DEFAULT_BUFFER_SIZE : p_out->availableForWrite();
+  }
+
+  /// Number of frequencies
+  size_t size() { return detectors.size(); }
+
+  /// Frequency at the indicated index
+  float frequency(int idx) { return detectors[idx].getFrequency(); }
+
+  /// Normalized amplitude of the frequency in the last block
+  float magnitude(int idx) { return magnitudes[idx]; }
+
+  /// Index of the frequency with the biggest amplitude in the indicated
+  /// range which is above the threshold: -1 if none
+  int maxIndex(int from = 0, int to = -1) {
+    if (to < 0) to = detectors.size();
+    int result = -1;
+    float max = cfg.threshold;
+    for (int j = from; j < to; j++) {
+      if (magnitudes[j] > max) {
+        max = magnitudes[j];
+        result = j;
+      }
+    }
+    return result;
+  }
+
+ protected:
+  GoertzelConfig cfg;
+  Stream *p_in = nullptr;
+  Print *p_out = nullptr;
+  Vector<GoertzelDetector> detectors{0};
+  Vector<float> magnitudes{0};
+  void (*p_callback)(float frequency, float magnitude, void *ref) = nullptr;
+  void *p_ref = nullptr;
+  int frame_count = 0;
+  int channel = 0;
+  int32_t sum = 0;
+
+  void process(const uint8_t *data, size_t len) {
+    if (detectors.size() == 0 || magnitudes.size() != detectors.size())
+      return;
+    switch (info.bits_per_sample) {
+      case 16:
+        processT((const int16_t *)data, len / sizeof(int16_t));
+        break;
+      case 24:
+        processT((const int24_t *)data, len / sizeof(int24_t));
+        break;
+      case 32:
+        processT((const int32_t *)data, len / sizeof(int32_t));
+        break;
+      default:
+        LOGE("Unsupported bits_per_sample: %d", info.bits_per_sample);
+    }
+  }
+
+  template <typename T>
+  void processT(const T *data, size_t samples) {
+    for (size_t j = 0; j < samples; j++) {
+      // scale to 16 bits
+      T value = data[j];
+      int32_t sample = value;
+      if (std::is_same<T, int24_t>::value) {
+        sample >>= 8;
+      } else if (sizeof(T) == 4) {
+        sample >>= 16;
+      }
+      if (cfg.channel < 0 || cfg.channel == channel) sum += sample;
+      if (++channel < cfg.channels) continue;
+      channel = 0;
+      addFrame(sum);
+      sum = 0;
+    }
+  }
+
+  /// updates all filters with the 16 bit value of the analyzed frame
+  void addFrame(int32_t sample) {
+    if (cfg.channel < 0) sample /= cfg.channels;
+    if (cfg.fixed_point) {
+      for (auto &detector : detectors) detector.updateQ15(sample);
+    } else {
+      float value = sample / 32768.0f;
+      for (auto &detector : detectors) detector.update(value);
+    }
+    if (++frame_count >= cfg.block_size) evaluate();
+  }
+
+  /// determines the magnitudes at the end of the block and reports the
+  /// detected frequencies
+  void evaluate() {
+    for (int j = 0; j < detectors.size(); j++) {
+      magnitudes[j] = detectors[j].magnitude(frame_count, cfg.fixed_point);
+      detectors[j].reset();
+      if (p_callback != nullptr && magnitudes[j] > cfg.threshold) {
+        p_callback(detectors[j].getFrequency(), magnitudes[j], p_ref);
+      }
+    }
+    frame_count = 0;
+  }
+};
+
+}  // namespace audio_tools
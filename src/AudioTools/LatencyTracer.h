@@ -0,0 +1,312 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioStreams.h"
+
+/// Max number of open markers
+#ifndef LATENCY_TRACER_MARKERS
+#  define LATENCY_TRACER_MARKERS 32
+#endif
+
+/// Number of buckets of the latency histogram
+#ifndef LATENCY_HISTOGRAM_SIZE
+#  define LATENCY_HISTOGRAM_SIZE 16
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Measured latency of one stage: the latency is measured from the
+ * source to the stage.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct LatencyStats {
+  const char *name = "";
+  /// Number of markers which have passed the stage
+  uint32_t count = 0;
+  uint32_t min_us = 0;
+  uint32_t max_us = 0;
+  uint64_t sum_us = 0;
+  /// Number of measurements per bucket: the last bucket collects all
+  /// bigger values
+  uint32_t histogram[LATENCY_HISTOGRAM_SIZE] = {0};
+
+  /// Average latency in ms
+  float avgMs() { return count == 0 ? 0.0f : sum_us / 1000.0f / count; }
+
+  void add(uint32_t us, uint32_t bucketUs) {
+    if (count == 0 || us < min_us) min_us = us;
+    if (us > max_us) max_us = us;
+    sum_us += us;
+    count++;
+    uint32_t idx = us / bucketUs;
+    if (idx >= LATENCY_HISTOGRAM_SIZE) idx = LATENCY_HISTOGRAM_SIZE - 1;
+    histogram[idx]++;
+  }
+
+  void reset() {
+    const char *stage_name = name;
+    *this = LatencyStats();
+    name = stage_name;
+  }
+};
+
+/**
+ * @brief End to end latency measurement of a processing chain. The source
+ * LatencyProbe adds a timestamped marker at regular audio positions (e.g.
+ * every 100 ms of audio) and all other LatencyProbe stages determine the
+ * time when the same audio position passes them. The position is calculated
+ * from the number of bytes and the AudioInfo of each probe, so rate changes
+ * (e.g. by a ResampleStream or a decoder) are taken into account and the
+ * delay of the buffers and codecs between the probes is included in the
+ * measurement. For encoded data you need to define the bytes per second of
+ * the probe.
+ *
+ * The markers are not added to the audio data, so all probes must run on
+ * the same device.
+ * @code
+ * LatencyTracer tracer(100);
+ * LatencyProbe in(i2s_in, tracer, "in", true);
+ * LatencyProbe out(i2s_out, tracer, "out");
+ * ...
+ * tracer.report();
+ * @endcode
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class LatencyTracer {
+ public:
+  LatencyTracer(uint32_t markerIntervalMs = 100, uint32_t bucketMs = 5) {
+    setMarkerInterval(markerIntervalMs);
+    setBucketMs(bucketMs);
+  }
+
+  /// Distance of the markers in ms of audio
+  void setMarkerInterval(uint32_t ms) { interval_us = ms * 1000; }
+
+  uint32_t markerIntervalUs() { return interval_us; }
+
+  /// Width of the buckets of the histogram in ms
+  void setBucketMs(uint32_t ms) { bucket_us = ms > 0 ? ms * 1000 : 1000; }
+
+  /// Registers a new stage: returns the index
+  int addStage(const char *name) {
+    LatencyStats stats;
+    stats.name = name;
+    stages.push_back(stats);
+    return stages.size() - 1;
+  }
+
+  /// Number of stages
+  int size() { return stages.size(); }
+
+  /// Provides the measurements of the indicated stage
+  LatencyStats &stats(int idx) { return stages[idx]; }
+
+  /// Adds a marker: called by the source probe
+  void addMarker(uint64_t positionUs, uint32_t timeUs) {
+    Marker &marker = markers[marker_count % LATENCY_TRACER_MARKERS];
+    marker.position_us = positionUs;
+    marker.time_us = timeUs;
+    marker_count++;
+  }
+
+  /// Number of markers which have been added
+  uint32_t markerCount() { return marker_count; }
+
+  /// Audio position of the marker with the indicated sequence number
+  uint64_t markerPosition(uint32_t seq) {
+    return markers[seq % LATENCY_TRACER_MARKERS].position_us;
+  }
+
+  /// Records the latency of the marker for the stage
+  void record(int idx, uint32_t seq, uint32_t timeUs) {
+    // the marker has been overwritten
+    if (marker_count - seq > LATENCY_TRACER_MARKERS) return;
+    Marker &marker = markers[seq % LATENCY_TRACER_MARKERS];
+    stages[idx].add(timeUs - marker.time_us, bucket_us);
+  }
+
+  /// Resets all measurements
+  void reset() {
+    for (int j = 0; j < stages.size(); j++) stages[j].reset();
+  }
+
+  /// Prints the total latency and the latency added by each stage
+  void report(Print *out = nullptr) {
+    char msg[120];
+    float previous = 0.0f;
+    for (int j = 0; j < stages.size(); j++) {
+      LatencyStats &s = stages[j];
+      float avg = s.avgMs();
+      snprintf(msg, sizeof(msg),
+               "%s: latency=%.1fms (+%.1fms) min=%.1fms max=%.1fms n=%u",
+               s.name, avg, avg - previous, s.min_us / 1000.0f,
+               s.max_us / 1000.0f, (unsigned)s.count);
+      print(out, msg);
+      if (s.count > 0) {
+        int len = snprintf(msg, sizeof(msg), "  histogram (%ums):",
+                           (unsigned)(bucket_us / 1000));
+        for (int b = 0; b < LATENCY_HISTOGRAM_SIZE && len < (int)sizeof(msg);
+             b++) {
+          len += snprintf(msg + len, sizeof(msg) - len, " %u",
+                          (unsigned)s.histogram[b]);
+        }
+        print(out, msg);
+      }
+      previous = avg;
+    }
+  }
+
+ protected:
+  struct Marker {
+    uint64_t position_us = 0;
+    uint32_t time_us = 0;
+  };
+  Marker markers[LATENCY_TRACER_MARKERS];
+  volatile uint32_t marker_count = 0;
+  Vector<LatencyStats> stages;
+  uint32_t interval_us = 100000;
+  uint32_t bucket_us = 5000;
+
+  void print(Print *out, const char *msg) {
+    if (out != nullptr) {
+      out->println(msg);
+    } else {
+      LOGI("%s", msg);
+    }
+  }
+};
+
+/**
+ * @brief Stage of the LatencyTracer which can be put in front of any Print
+ * or Stream of a processing chain: the data is passed through unchanged. The
+ * source probe adds the markers, all other probes measure the time until the
+ * marked audio position has reached them.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class LatencyProbe : public ModifyingStream {
+ public:
+  LatencyProbe(LatencyTracer &tracer, const char *name, bool isSource = false) {
+    p_tracer = &tracer;
+    is_source = isSource;
+    idx = tracer.addStage(name);
+  }
+
+  LatencyProbe(Print &out, LatencyTracer &tracer, const char *name,
+               bool isSource = false)
+      : LatencyProbe(tracer, name, isSource) {
+    setOutput(out);
+  }
+
+  LatencyProbe(Stream &io, LatencyTracer &tracer, const char *name,
+               bool isSource = false)
+      : LatencyProbe(tracer, name, isSource) {
+    setStream(io);
+  }
+
+  void setStream(Stream &io) override {
+    p_stream = &io;
+    p_print = &io;
+  }
+
+  void setOutput(Print &out) override { p_print = &out; }
+
+  /// Defines the data rate for encoded data: by default it is calculated
+  /// from the AudioInfo
+  void setBytesPerSecond(uint32_t bytes) { bytes_per_second = bytes; }
+
+  /// Factor which is applied to the audio position: e.g. if a resampler
+  /// changes the speed w/o changing the AudioInfo
+  void setRateFactor(float factor) { rate_factor = factor; }
+
+  bool begin() override {
+    position_bytes = 0;
+    next_marker = p_tracer->markerCount();
+    next_marker_us = 0;
+    return true;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_print == nullptr) return 0;
+    size_t result = p_print->write(data, len);
+    update(result);
+    return result;
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_stream == nullptr) return 0;
+    size_t result = p_stream->readBytes(data, len);
+    update(result);
+    return result;
+  }
+
+  int available() override {
+    return p_stream == nullptr ? 0 : p_stream->available();
+  }
+
+  int availableForWrite() override {
+    return p_print == nullptr ? 0 : p_print->availableForWrite();
+  }
+
+  /// Provides the measurements of this stage
+  LatencyStats &stats() { return p_tracer->stats(idx); }
+
+  /// Audio position in us which has passed the probe
+  uint64_t positionUs() {
+    uint32_t bps = bytesPerSecond();
+    if (bps == 0) return 0;
+    return position_bytes * 1000000 / bps * rate_factor;
+  }
+
+ protected:
+  LatencyTracer *p_tracer = nullptr;
+  Stream *p_stream = nullptr;
+  Print *p_print = nullptr;
+  int idx = 0;
+  bool is_source = false;
+  uint64_t position_bytes = 0;
+  uint32_t bytes_per_second = 0;
+  float rate_factor = 1.0f;
+  uint32_t next_marker = 0;
+  uint64_t next_marker_us = 0;
+
+  uint32_t bytesPerSecond() {
+    if (bytes_per_second > 0) return bytes_per_second;
+    return info.sample_rate * info.channels * info.bits_per_sample / 8;
+  }
+
+  void update(size_t bytes) {
+    if (bytes == 0) return;
+    position_bytes += bytes;
+    uint64_t pos = positionUs();
+    uint32_t now = micros();
+    if (is_source) {
+      // add the markers for the positions which have passed
+      while (next_marker_us < pos) {
+        p_tracer->addMarker(next_marker_us, now);
+        next_marker_us += p_tracer->markerIntervalUs();
+      }
+      return;
+    }
+    // skip the markers which have been overwritten
+    uint32_t count = p_tracer->markerCount();
+    if (count - next_marker > LATENCY_TRACER_MARKERS) {
+      next_marker = count - LATENCY_TRACER_MARKERS;
+    }
+    // record the markers which have reached us
+    while (next_marker != p_tracer->markerCount() &&
+           p_tracer->markerPosition(next_marker) < pos) {
+      p_tracer->record(idx, next_marker, now);
+      next_marker++;
+    }
+  }
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,250 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioTypes.h"
+#include "AudioTools/Profiler.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Quality setting which can be changed by the LoadGovernor: the level
+ * is passed to the callback whenever it changes.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct LoadKnob {
+  const char *name = "";
+  int min_level = 0;
+  int max_level = 0;
+  int level = 0;
+  void (*setter)(int level, void *ref) = nullptr;
+  void *ref = nullptr;
+};
+
+/**
+ * @brief Prevents underruns when the audio competes with other tasks (e.g.
+ * WiFi or a UI) for the CPU: the governor measures the real time ratio of
+ * the audio loop (processing time / duration of the processed audio). If it
+ * stays above the high threshold, the quality knobs are stepped down one
+ * level at a time in the order in which they were added. When the load is
+ * below the low threshold again, they are stepped up in the reverse order.
+ *
+ * The knobs are simple callbacks, so that any setting can be used: e.g.
+ * OpusAudioEncoder::setComplexity(), ResampleStream::setEngine(),
+ * ReverbProcessor::setActiveQuality() or
+ * WavetableSynthesizer::setMaxActiveVoices(). Settings which need a restart
+ * (e.g. the LAME quality or the FFT length) can be changed in the callback
+ * as well.
+ *
+ * The load is either measured with startBlock() and endBlock() around the
+ * processing or it is taken from a Profiler by calling update().
+ * @code
+ * LoadGovernor governor;
+ * governor.addKnob("voices", 4, 16, [](int level, void *ref) {
+ *   ((WavetableSynthesizer *)ref)->setMaxActiveVoices(level);
+ * }, &synth);
+ * governor.begin(info);
+ * ...
+ * governor.startBlock();
+ * size_t bytes = copier.copy();
+ * governor.endBlock(bytes);
+ * @endcode
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class LoadGovernor {
+ public:
+  LoadGovernor(float highLoad = 0.85f, float lowLoad = 0.6f,
+               uint32_t intervalMs = 500) {
+    setThresholds(highLoad, lowLoad);
+    setInterval(intervalMs);
+  }
+
+  /// Defines the load above which the quality is reduced and the load below
+  /// which it is increased again
+  void setThresholds(float highLoad, float lowLoad) {
+    high_load = highLoad;
+    low_load = lowLoad;
+  }
+
+  /// Time over which the load is averaged before a decision is taken
+  void setInterval(uint32_t ms) { interval_ms = ms; }
+
+  /// Adds a quality knob: the knobs are reduced in the order in which they
+  /// were added. The knob starts with the max level.
+  int addKnob(const char *name, int minLevel, int maxLevel,
+              void (*setter)(int level, void *ref), void *ref = nullptr) {
+    LoadKnob knob;
+    knob.name = name;
+    knob.min_level = minLevel;
+    knob.max_level = maxLevel;
+    knob.level = maxLevel;
+    knob.setter = setter;
+    knob.ref = ref;
+    knobs.push_back(knob);
+    return knobs.size() - 1;
+  }
+
+  /// Number of knobs
+  int size() { return knobs.size(); }
+
+  /// Provides the indicated knob
+  LoadKnob &knob(int idx) { return knobs[idx]; }
+
+  /// Measures the load from all stages of the profiler: the duration of the
+  /// audio is determined from the bytes_out of the indicated stage.
+  void setProfiler(Profiler &profiler, int stageIdx) {
+    p_profiler = &profiler;
+    stage_idx = stageIdx;
+  }
+
+  /// Defines the format which is used to calculate the duration of the audio
+  bool begin(AudioInfo info) {
+    bytes_per_second = info.sample_rate * info.channels * info.bits_per_sample / 8;
+    return begin();
+  }
+
+  /// Sets all knobs to the max level
+  bool begin() {
+    if (bytes_per_second == 0) {
+      LOGE("AudioInfo not defined");
+      return false;
+    }
+    ProfilerClock::begin();
+    for (auto &knob : knobs) {
+      knob.level = knob.max_level;
+      apply(knob);
+    }
+    resetInterval();
+    return true;
+  }
+
+  /// Call before the processing of a block
+  void startBlock() { start_ticks = ProfilerClock::ticks(); }
+
+  /// Call after the processing of a block with the number of processed bytes
+  void endBlock(size_t bytes) {
+    addLoad(ProfilerClock::ticks() - start_ticks, bytes);
+  }
+
+  /// Adds the processing ticks (see ProfilerClock) for the indicated number
+  /// of audio bytes
+  void addLoad(uint32_t ticks, size_t bytes) {
+    sum_ticks += ticks;
+    sum_bytes += bytes;
+    evaluate();
+  }
+
+  /// Takes the measurements from the Profiler: call in the loop
+  void update() {
+    if (p_profiler == nullptr || stage_idx >= p_profiler->size()) return;
+    uint64_t ticks = 0;
+    for (int j = 0; j < p_profiler->size(); j++) {
+      ticks += p_profiler->stats(j).ticks;
+    }
+    uint64_t bytes = p_profiler->stats(stage_idx).bytes_out;
+    // the profiler might have been reset
+    if (ticks < last_profiler_ticks || bytes < last_profiler_bytes) {
+      last_profiler_ticks = ticks;
+      last_profiler_bytes = bytes;
+      return;
+    }
+    sum_ticks += ticks - last_profiler_ticks;
+    sum_bytes += bytes - last_profiler_bytes;
+    last_profiler_ticks = ticks;
+    last_profiler_bytes = bytes;
+    evaluate();
+  }
+
+  /// Real time ratio of the last interval: 1.0 means that the processing
+  /// takes as long as the audio
+  float load() { return last_load; }
+
+  /// Number of level changes
+  uint32_t changes() { return change_count; }
+
+  /// Logs the load and the levels
+  void logReport() {
+    LOGI("load: %.2f", last_load);
+    for (auto &knob : knobs) {
+      LOGI("%s: %d (%d..%d)", knob.name, knob.level, knob.min_level,
+           knob.max_level);
+    }
+  }
+
+ protected:
+  Vector<LoadKnob> knobs;
+  Profiler *p_profiler = nullptr;
+  int stage_idx = 0;
+  uint64_t last_profiler_ticks = 0;
+  uint64_t last_profiler_bytes = 0;
+  float high_load = 0.85f;
+  float low_load = 0.6f;
+  uint32_t interval_ms = 500;
+  uint32_t bytes_per_second = 0;
+  uint32_t start_ticks = 0;
+  uint64_t sum_ticks = 0;
+  uint64_t sum_bytes = 0;
+  uint32_t interval_start_ms = 0;
+  float last_load = 0.0f;
+  uint32_t change_count = 0;
+
+  void resetInterval() {
+    sum_ticks = 0;
+    sum_bytes = 0;
+    interval_start_ms = millis();
+  }
+
+  void evaluate() {
+    if (millis() - interval_start_ms < interval_ms) return;
+    if (sum_bytes == 0 || bytes_per_second == 0) {
+      resetInterval();
+      return;
+    }
+    float processing_us = (float)sum_ticks / ProfilerClock::ticksPerUs();
+    float audio_us = 1000000.0f * sum_bytes / bytes_per_second;
+    last_load = processing_us / audio_us;
+    if (last_load > high_load) {
+      stepDown();
+    } else if (last_load < low_load) {
+      stepUp();
+    }
+    // the next measurement uses the new levels
+    resetInterval();
+  }
+
+  void stepDown() {
+    for (auto &knob : knobs) {
+      if (knob.level > knob.min_level) {
+        knob.level--;
+        LOGI("load %.2f: reducing %s to %d", last_load, knob.name, knob.level);
+        apply(knob);
+        change_count++;
+        return;
+      }
+    }
+  }
+
+  void stepUp() {
+    for (int j = knobs.size() - 1; j >= 0; j--) {
+      LoadKnob &knob = knobs[j];
+      if (knob.level < knob.max_level) {
+        knob.level++;
+        LOGI("load %.2f: increasing %s to %d", last_load, knob.name,
+             knob.level);
+        apply(knob);
+        change_count++;
+        return;
+      }
+    }
+  }
+
+  void apply(LoadKnob &knob) {
+    if (knob.setter != nullptr) knob.setter(knob.level, knob.ref);
+  }
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioTypes.h"
+#include "AudioTools/BaseStream.h"
+#include "AudioBasic/Collections/Vector.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Measures the round trip latency of a full duplex device (e.g. an
+ * I2SStream in RXTX_MODE) where the output is connected to the input: we
+ * output silence followed by an impulse and count the frames until the
+ * impulse is detected in the input. The result includes the output and the
+ * input buffers and the latency of the connected hardware (e.g. the codec).
+ *
+ * LoopbackLatency<int16_t> latency;
+ * latency.begin(i2s);
+ * if (latency.measure()) Serial.println(latency.latencyMs());
+ *
+ * @ingroup io
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T sample type
+ */
+template <typename T = int16_t>
+class LoopbackLatency {
+ public:
+  LoopbackLatency(int blockFrames = 128) { block_frames = blockFrames; }
+
+  /// Defines the full duplex device: the audio info is taken from it
+  void begin(AudioStream &io) { begin(io, io.audioInfo()); }
+
+  /// Defines the full duplex device and the audio info
+  void begin(AudioStream &io, AudioInfo info) {
+    p_io = &io;
+    this->info = info;
+    block.resize(block_frames * info.channels);
+  }
+
+  /// Absolute sample value which is detected as impulse (default: 1/4 of max)
+  void setThreshold(T value) { threshold = value; }
+
+  /// Silence in ms which is output before the impulse so that the buffers
+  /// are in a steady state
+  void setSettleMs(uint32_t ms) { settle_ms = ms; }
+
+  /// Performs the measurement: returns false if the impulse was not detected
+  /// within the timeout
+  bool measure(uint32_t timeoutMs = 2000) {
+    if (p_io == nullptr || info.channels == 0 || info.sample_rate == 0) {
+      LOGE("not started");
+      return false;
+    }
+    latency_frames = -1;
+    size_t impulse_frame = (uint64_t)settle_ms * info.sample_rate / 1000;
+    size_t frames_written = 0;
+    size_t frames_read = 0;
+    size_t block_bytes = block.size() * sizeof(T);
+    uint32_t end = millis() + timeoutMs;
+    while (millis() < end) {
+      // output silence with the impulse at impulse_frame
+      memset(block.data(), 0, block_bytes);
+      if (impulse_frame >= frames_written &&
+          impulse_frame < frames_written + block_frames) {
+        int pos = (impulse_frame - frames_written) * info.channels;
+        for (int ch = 0; ch < info.channels; ch++) {
+          block[pos + ch] = NumberConverter::maxValueT<T>();
+        }
+      }
+      p_io->write((const uint8_t *)block.data(), block_bytes);
+      frames_written += block_frames;
+
+      // search the impulse in the input
+      size_t read = p_io->readBytes((uint8_t *)block.data(), block_bytes);
+      int frames = read / sizeof(T) / info.channels;
+      for (int j = 0; j < frames; j++) {
+        if (frames_read + j > impulse_frame &&
+            isImpulse(block.data() + j * info.channels)) {
+          latency_frames = frames_read + j - impulse_frame;
+          return true;
+        }
+      }
+      frames_read += frames;
+    }
+    LOGW("impulse not detected");
+    return false;
+  }
+
+  /// Measured round trip latency in frames (-1 if not available)
+  int latencyFrames() { return latency_frames; }
+
+  /// Measured round trip latency in ms (-1 if not available)
+  float latencyMs() {
+    if (latency_frames < 0) return -1.0f;
+    return 1000.0f * latency_frames / info.sample_rate;
+  }
+
+ protected:
+  AudioStream *p_io = nullptr;
+  AudioInfo info;
+  Vector<T> block{0};
+  int block_frames;
+  int latency_frames = -1;
+  uint32_t settle_ms = 200;
+  T threshold = NumberConverter::maxValueT<T>() / 4;
+
+  bool isImpulse(T *frame) {
+    for (int ch = 0; ch < info.channels; ch++) {
+      T value = frame[ch];
+      if (value > threshold || value < -threshold) return true;
+    }
+    return false;
+  }
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,309 @@
+#pragma once
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioStreams.h"
+#include "AudioTools/BaseConverter.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Software PDM to PCM conversion for microcontrollers without a
+ * hardware PDM decimator: the 1 bit PDM data is decimated with a CIC filter
+ * (of the indicated order) which is calculated as FIR with a byte wise lookup
+ * table, so that each output sample only needs order * decimation / 8 table
+ * lookups and additions: e.g. 24 for 64 PDM bits per sample. The result is
+ * corrected with a small compensation FIR for the CIC droop, the DC offset is
+ * removed and the result is provided as 16 bit mono PCM.
+ *
+ * The PDM data is expected as bytes in time order and by default the first
+ * bit is the most significant bit. The decimation factor must be a multiple
+ * of 8 (and at least 16); the lookup table needs order * decimation bytes
+ * of 32 bit values: e.g. 24 KBytes for 64 with order 3.
+ * @ingroup convert
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class PDMConverter : public BaseConverter {
+ public:
+  PDMConverter(int decimation = 64, int order = 3) {
+    setDecimation(decimation);
+    setOrder(order);
+  }
+
+  /// Defines the number of PDM bits per PCM sample (multiple of 8)
+  void setDecimation(int factor) {
+    decimation = factor;
+    is_setup = false;
+  }
+
+  int decimationFactor() { return decimation; }
+
+  /// Defines the order of the CIC filter (1 to 4)
+  void setOrder(int order) {
+    this->order = order;
+    is_setup = false;
+  }
+
+  /// Defines the bit order of the PDM bytes: by default the first bit is the
+  /// MSB
+  void setMSBFirst(bool msbFirst) {
+    msb_first = msbFirst;
+    is_setup = false;
+  }
+
+  /// PDM data which is read as little endian I2S words (e.g. 4 for 32 bit
+  /// samples): the bytes of each word are processed in reverse order, so
+  /// that the MSB is the first bit. Supported are 1, 2 and 4.
+  void setWordSize(int bytes) { word_bytes = bytes; }
+
+  /// Defines the amplification of the PCM result
+  void setGain(float gain) { this->gain = gain; }
+
+  /// Pole of the DC blocker: 0 deactivates the DC removal
+  void setDCBlock(float pole) { dc_pole = pole; }
+
+  /// Calculates the lookup table and resets the state
+  bool begin() {
+    is_setup = false;
+    if (decimation < 16 || decimation % 8 != 0) {
+      LOGE("decimation must be a multiple of 8 and >= 16: %d", decimation);
+      return false;
+    }
+    if (word_bytes != 1 && word_bytes != 2 && word_bytes != 4) {
+      LOGE("word size not supported: %d", word_bytes);
+      return false;
+    }
+    if (order < 1 || order > 4) {
+      LOGE("order not supported: %d", order);
+      return false;
+    }
+    setupTable();
+    history.resize(2 * window_bytes);
+    // silence: alternating bits
+    memset(history.data(), 0x55, history.size());
+    hist_pos = 0;
+    byte_count = 0;
+    x1 = x2 = 0.0f;
+    dc_x = dc_y = 0.0f;
+    is_setup = true;
+    return true;
+  }
+
+  /// Converts in place: returns the number of PCM bytes
+  size_t convert(uint8_t *src, size_t size) override {
+    return convert((int16_t *)src, src, size) * sizeof(int16_t);
+  }
+
+  /// Converts the PDM bytes to PCM samples: returns the number of samples.
+  /// The target can be the same as the source.
+  size_t convert(int16_t *target, const uint8_t *pdm, size_t bytes) {
+    if (!is_setup && !begin()) return 0;
+    if (bytes % word_bytes != 0) {
+      LOGE("size %d is not a multiple of the word size", (int)bytes);
+      return 0;
+    }
+    const int step = decimation / 8;
+    const int swap = word_bytes - 1;
+    size_t samples = 0;
+    for (size_t j = 0; j < bytes; j++) {
+      uint8_t value = pdm[j ^ swap];
+      // the values are stored twice, so that the window is one block
+      history[hist_pos] = value;
+      history[hist_pos + window_bytes] = value;
+      if (++hist_pos == window_bytes) hist_pos = 0;
+      if (++byte_count < step) continue;
+      byte_count = 0;
+      target[samples++] = nextSample();
+    }
+    return samples;
+  }
+
+  /// Number of PDM bytes which are needed for the indicated PCM samples
+  size_t pdmBytes(size_t samples) { return samples * decimation / 8; }
+
+ protected:
+  int decimation = 64;
+  int order = 3;
+  bool msb_first = true;
+  int word_bytes = 1;
+  bool is_setup = false;
+  float gain = 1.0f;
+  float dc_pole = 0.995f;
+  int window_bytes = 0;
+  Vector<uint32_t> table{0};
+  Vector<uint8_t> history{0};
+  int hist_pos = 0;
+  int byte_count = 0;
+  float scale = 0.0f;
+  float offset = 0.0f;
+  float comp_alpha = 0.0f;
+  float x1 = 0.0f, x2 = 0.0f;
+  float dc_x = 0.0f, dc_y = 0.0f;
+
+  /// The CIC impulse response is a rectangle of the decimation length which
+  /// is convolved order times with itself: we sum up the coefficients of
+  /// each bit for all 256 byte values
+  void setupTable() {
+    int len = order * (decimation - 1) + 1;
+    Vector<uint32_t> kernel;
+    kernel.resize(len);
+    for (int j = 0; j < len; j++) kernel[j] = j < decimation ? 1 : 0;
+    for (int o = 1; o < order; o++) {
+      for (int j = len - 1; j >= 0; j--) {
+        uint32_t sum = 0;
+        for (int k = 0; k < decimation && k <= j; k++) sum += kernel[j - k];
+        kernel[j] = sum;
+      }
+    }
+    window_bytes = (len + 7) / 8;
+    table.resize(window_bytes * 256);
+    for (int b = 0; b < window_bytes; b++) {
+      for (int value = 0; value < 256; value++) {
+        uint32_t sum = 0;
+        for (int bit = 0; bit < 8; bit++) {
+          int idx = b * 8 + bit;
+          int mask = msb_first ? 0x80 >> bit : 1 << bit;
+          if (idx < len && (value & mask)) sum += kernel[idx];
+        }
+        table[b * 256 + value] = sum;
+      }
+    }
+    // all bits set: decimation^order
+    float full = powf(decimation, order);
+    offset = full / 2.0f;
+    scale = 32767.0f / offset;
+    // 3 tap compensation which is exact at a quarter of the sample rate
+    float sinc = sinf(PI / 4.0f) / (PI / 4.0f);
+    comp_alpha = (1.0f / powf(sinc, order) - 1.0f) / 2.0f;
+  }
+
+  int16_t nextSample() {
+    const uint8_t *window = history.data() + hist_pos;
+    const uint32_t *lut = table.data();
+    uint32_t sum = 0;
+    for (int b = 0; b < window_bytes; b++) {
+      sum += lut[window[b]];
+      lut += 256;
+    }
+    float x = ((float)sum - offset) * scale;
+    // droop compensation: -a, 1 + 2a, -a
+    float y = (1.0f + 2.0f * comp_alpha) * x1 - comp_alpha * (x + x2);
+    x2 = x1;
+    x1 = x;
+    if (dc_pole > 0.0f) {
+      float out = y - dc_x + dc_pole * dc_y;
+      dc_x = y;
+      dc_y = out;
+      y = out;
+    }
+    y *= gain;
+    if (y > 32767.0f) y = 32767.0f;
+    if (y < -32768.0f) y = -32768.0f;
+    return (int16_t)y;
+  }
+};
+
+/**
+ * @brief Stream which converts the raw PDM data of a microphone (e.g. read
+ * with the I2SStream or the I2SBitBang) to 16 bit mono PCM with the
+ * PDMConverter. Use setStream() to read the PDM data or setOutput() if you
+ * want to write the PDM data. The AudioInfo describes the PCM result.
+ * @ingroup io
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class PDMToPCMStream : public ModifyingStream {
+ public:
+  PDMToPCMStream() = default;
+
+  PDMToPCMStream(Stream &in) { setStream(in); }
+
+  PDMToPCMStream(Print &out) { setOutput(out); }
+
+  void setStream(Stream &in) override {
+    p_stream = &in;
+    p_print = &in;
+  }
+
+  void setOutput(Print &out) override { p_print = &out; }
+
+  /// Provides access to the converter e.g. to define the gain or the order
+  PDMConverter &converter() { return pdm; }
+
+  /// Defines the number of PDM bits per PCM sample (multiple of 8)
+  void setDecimation(int factor) { pdm.setDecimation(factor); }
+
+  /// Defines the amplification of the PCM result
+  void setGain(float gain) { pdm.setGain(gain); }
+
+  /// PDM data which is read as little endian I2S words: see PDMConverter
+  void setWordSize(int bytes) { pdm.setWordSize(bytes); }
+
+  /// Provides the audio info of the PDM data: the sample rate is the PDM
+  /// clock
+  AudioInfo audioInfoPDM() {
+    AudioInfo result = audioInfo();
+    result.sample_rate = info.sample_rate * pdm.decimationFactor();
+    result.bits_per_sample = 1;
+    return result;
+  }
+
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    if (info.channels != 1 || info.bits_per_sample != 16) {
+      LOGE("Only 16 bit mono is supported");
+      return false;
+    }
+    buffer.resize(buffer_size);
+    pcm.resize(buffer_size);
+    return pdm.begin() && AudioStream::begin();
+  }
+
+  /// Reads the PDM data and provides the PCM samples
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_stream == nullptr) return 0;
+    int16_t *samples = (int16_t *)data;
+    size_t requested = len / sizeof(int16_t);
+    size_t result = 0;
+    while (result < requested) {
+      size_t bytes = min(pdm.pdmBytes(requested - result), (size_t)buffer.size());
+      size_t read = p_stream->readBytes(buffer.data(), bytes);
+      if (read == 0) break;
+      result += pdm.convert(samples + result, buffer.data(), read);
+    }
+    return result * sizeof(int16_t);
+  }
+
+  /// Converts the PDM data and writes the PCM samples to the output
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_print == nullptr) return 0;
+    for (size_t pos = 0; pos < len; pos += buffer_size) {
+      size_t bytes = min(len - pos, (size_t)buffer_size);
+      size_t samples = pdm.convert(pcm.data(), data + pos, bytes);
+      p_print->write((const uint8_t *)pcm.data(), samples * sizeof(int16_t));
+    }
+    return len;
+  }
+
+  int available() override {
+    if (p_stream == nullptr) return 0;
+    return p_stream->available() * 8 / pdm.decimationFactor() *
+           sizeof(int16_t);
+  }
+
+  int availableForWrite() override { return buffer_size; }
+
+ protected:
+  Stream *p_stream = nullptr;
+  Print *p_print = nullptr;
+  PDMConverter pdm;
+  Vector<uint8_t> buffer{0};
+  Vector<int16_t> pcm{0};
+  int buffer_size = 512;
+};
+
+}  // namespace audio_tools
@@ -2,6 +2,9 @@
 
 #include "AudioTools/AudioOutput.h"
 #include "AudioTools/AudioStreams.h"
+#include "AudioTools/VolumeControl.h"
+#include "AudioTools/Profiler.h"
+#include "AudioFilter/Filter.h"
 
 namespace audio_tools {
 
@@ -18,6 +21,12 @@ class Pipeline : public AudioStream {
 
  public:
   Pipeline() = default;
+
+  ~Pipeline() {
+    for (auto& c : cleanup) {
+      delete c;
+    }
+  }
   ///  adds a component
   bool add(ModifyingStream& io) {
     if (has_output) {
@@ -42,12 +51,21 @@ class Pipeline : public AudioStream {
       io.setStream(*p_stream);
       p_stream = &io;
       p_ai_source = &io;
+#ifdef USE_PROFILER
+      if (p_profiler != nullptr) p_stream = addProbe(io, stageName());
+#endif
     } else {
       // we assume an output chain
+      Print* p_target = &io;
+#ifdef USE_PROFILER
+      if (p_profiler != nullptr) p_target = addProbe(io, stageName());
+#endif
       if (size() > 0) {
         auto& last_c = last();
-        last_c.setOutput(io);
+        last_c.setOutput(*p_target);
         last_c.addNotifyAudioChange(io);
+      } else {
+        p_entry = p_target;
       }
       components.push_back(&io);
     }
@@ -98,7 +116,11 @@ class Pipeline : public AudioStream {
     }
     p_print = &out;
     if (size() > 0) {
-      last().setOutput(out);
+      Print* p_target = &out;
+#ifdef USE_PROFILER
+      if (p_profiler != nullptr) p_target = addProbe(out, "output");
+#endif
+      last().setOutput(*p_target);
     }
     // must be last element
     has_output = true;
@@ -127,9 +149,18 @@ class Pipeline : public AudioStream {
     // must be first
     has_input = true;
     p_stream = &in;
+#ifdef USE_PROFILER
+    if (p_profiler != nullptr) p_stream = addProbe(in, "input");
+#endif
     return true;
   }
 
+  /// Adds a ProfilingStream after the input and in front of each component
+  /// and the output, so that the Profiler reports the time of each stage.
+  /// This is only active if USE_PROFILER is defined and must be called
+  /// before setInput() and add().
+  void setProfiler(Profiler& profiler) { p_profiler = &profiler; }
+
   int availableForWrite() override {
     if (!is_active) return 0;
     if (size() == 0) {
@@ -146,7 +177,7 @@ class Pipeline : public AudioStream {
       return 0;
     }
     LOGD("write: %u", (unsigned)len);
-    return components[0]->write(data, len);
+    return p_entry->write(data, len);
   }
 
   int available() override {
@@ -213,6 +244,7 @@ class Pipeline : public AudioStream {
     }
     cleanup.clear();
 
+    p_entry = nullptr;
     has_output = false;
     has_input = false;
     p_out_print = nullptr;
@@ -225,14 +257,36 @@ class Pipeline : public AudioStream {
     is_active = true;
   }
 
-  /// Defines the AudioInfo for the first node
+  /// Defines the AudioInfo for the first node: the change is propagated
+  /// through the chain in one transaction, so that each component is
+  /// reconfigured only once with its final AudioInfo
   void setAudioInfo(AudioInfo newInfo) override {
     this->info = newInfo;
+    beginAudioInfoUpdate();
     if (has_input && p_ai_input != nullptr) {
       p_ai_input->setAudioInfo(info);
-    } else if (has_output) {
+    } else if (!has_input && size() > 0) {
       components[0]->setAudioInfo(info);
     }
+    endAudioInfoUpdate();
+  }
+
+  /// Collects the AudioInfo changes of all components
+  void beginAudioInfoUpdate() override {
+    AudioStream::beginAudioInfoUpdate();
+    if (p_ai_input != nullptr) p_ai_input->beginAudioInfoUpdate();
+    for (auto c : components) {
+      c->beginAudioInfoUpdate();
+    }
+  }
+
+  /// Reports the final AudioInfo of each component along the chain
+  void endAudioInfoUpdate() override {
+    if (p_ai_input != nullptr) p_ai_input->endAudioInfoUpdate();
+    for (auto c : components) {
+      c->endAudioInfoUpdate();
+    }
+    AudioStream::endAudioInfoUpdate();
   }
 
   /// Provides the resulting AudioInfo from the last node
@@ -302,6 +356,27 @@ class Pipeline : public AudioStream {
   AudioOutput* p_out_print = nullptr;
   AudioStream* p_out_stream = nullptr;
   Print* p_print = nullptr;
+  // first stage of an output pipeline
+  Print* p_entry = nullptr;
+  Profiler* p_profiler = nullptr;
+
+#ifdef USE_PROFILER
+  /// Adds a measuring stage which forwards the calls to the indicated target
+  template <typename T>
+  ModifyingStream* addProbe(T& target, const char* name) {
+    ProfilingStream* probe = new ProfilingStream(target, *p_profiler, name);
+    cleanup.push_back(probe);
+    return probe;
+  }
+
+  const char* stageName() {
+    static const char* names[] = {"stage 0", "stage 1", "stage 2",
+                                  "stage 3", "stage 4", "stage 5",
+                                  "stage 6", "stage 7"};
+    int idx = size() - (has_input ? 1 : 0);
+    return idx < 8 ? names[idx] : "stage";
+  }
+#endif
 
   /// Support for ModifyingOutput
   struct ModifyingStreamAdapter : public ModifyingStream {
@@ -327,6 +402,10 @@ class Pipeline : public AudioStream {
       p_out->addNotifyAudioChange(bi);
     }
 
+    void beginAudioInfoUpdate() override { p_out->beginAudioInfoUpdate(); }
+
+    void endAudioInfoUpdate() override { p_out->endAudioInfoUpdate(); }
+
    protected:
     ModifyingOutput* p_out = nullptr;
   };
@@ -335,11 +414,300 @@ class Pipeline : public AudioStream {
   /// available
   Stream* getInput() {
     Stream* in = p_stream;
-    if (size() > 0) {
+    if (size() > 0 && !has_input) {
       in = &last();
     }
     return in;
   }
 };
 
+/**
+ * @brief Stage for a PipelineT: multiplies the samples with the volume factor
+ * of the related channel.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class VolumeStage {
+ public:
+  VolumeStage(float volume = 1.0f) { this->volume = volume; }
+
+  bool begin(AudioInfo info) {
+    factors.resize(info.channels);
+    for (int ch = 0; ch < info.channels; ch++) factors[ch] = factor(volume);
+    return true;
+  }
+
+  /// Defines the volume for all channels
+  void setVolume(float vol) {
+    volume = vol;
+    for (int ch = 0; ch < factors.size(); ch++) factors[ch] = factor(vol);
+  }
+
+  /// Defines the volume for the indicated channel
+  void setVolume(float vol, int channel) {
+    if (channel < factors.size()) factors[channel] = factor(vol);
+  }
+
+  /// Defines the volume control logic (default is linear)
+  void setVolumeControl(VolumeControl &vc) {
+    p_vc = &vc;
+    setVolume(volume);
+  }
+
+  inline float process(float value, int channel) {
+    return value * factors[channel];
+  }
+
+ protected:
+  Vector<float> factors{0};
+  float volume = 1.0f;
+  VolumeControl *p_vc = nullptr;
+
+  float factor(float vol) {
+    return p_vc == nullptr ? vol : p_vc->getVolumeFactor(vol);
+  }
+};
+
+/**
+ * @brief Stage for a PipelineT: adds the offset and multiplies the result with
+ * the factor (like the ConverterScaler)
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ScaleStage {
+ public:
+  ScaleStage(float factor = 1.0f, float offset = 0.0f) {
+    factor_value = factor;
+    offset_value = offset;
+  }
+
+  bool begin(AudioInfo info) { return true; }
+
+  void setFactor(float factor) { factor_value = factor; }
+
+  void setOffset(float offset) { offset_value = offset; }
+
+  inline float process(float value, int channel) {
+    return (value + offset_value) * factor_value;
+  }
+
+ protected:
+  float factor_value;
+  float offset_value;
+};
+
+/**
+ * @brief Stage for a PipelineT: applies the filter of the related channel
+ * (like the FilteredStream)
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class FilterStage {
+ public:
+  bool begin(AudioInfo info) {
+    int old_size = filters.size();
+    filters.resize(info.channels);
+    for (int ch = old_size; ch < info.channels; ch++) filters[ch] = nullptr;
+    return true;
+  }
+
+  /// Defines the filter for the indicated channel. The number of channels
+  /// must have been defined before we can call this function.
+  void setFilter(int channel, Filter<float> *filter) {
+    if (channel >= filters.size()) {
+      int old_size = filters.size();
+      filters.resize(channel + 1);
+      for (int ch = old_size; ch < channel; ch++) filters[ch] = nullptr;
+    }
+    filters[channel] = filter;
+  }
+
+  void setFilter(int channel, Filter<float> &filter) {
+    setFilter(channel, &filter);
+  }
+
+  inline float process(float value, int channel) {
+    Filter<float> *p_filter = filters[channel];
+    return p_filter == nullptr ? value : p_filter->process(value);
+  }
+
+ protected:
+  Vector<Filter<float> *> filters{0};
+};
+
+/**
+ * @brief Stage for a PipelineT: calls the indicated function for each sample
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class CallbackStage {
+ public:
+  CallbackStage(float (*cb)(float value, int channel)) { callback = cb; }
+
+  bool begin(AudioInfo info) { return callback != nullptr; }
+
+  inline float process(float value, int channel) {
+    return callback(value, channel);
+  }
+
+ protected:
+  float (*callback)(float value, int channel) = nullptr;
+};
+
+/// Recursive container which calls all stages using static dispatch
+template <typename... Stages>
+class PipelineStages;
+
+template <>
+class PipelineStages<> {
+ public:
+  bool begin(AudioInfo info) { return true; }
+  inline float process(float value, int channel) { return value; }
+};
+
+template <typename Stage, typename... Rest>
+class PipelineStages<Stage, Rest...> {
+ public:
+  PipelineStages(Stage &stage, Rest &...rest) : stage(stage), rest(rest...) {}
+
+  bool begin(AudioInfo info) {
+    bool result = stage.begin(info);
+    return rest.begin(info) && result;
+  }
+
+  inline float process(float value, int channel) {
+    return rest.process(stage.process(value, channel), channel);
+  }
+
+ protected:
+  Stage &stage;
+  PipelineStages<Rest...> rest;
+};
+
+/**
+ * @brief Pipeline where the stages are defined at compile time: all stages are
+ * executed in one single loop over the samples of each block with static
+ * dispatch, so that the processing can be inlined. The samples are processed as
+ * float and clipped only once when the result is stored.
+ * A stage needs to provide the methods bool begin(AudioInfo) and
+ * float process(float value, int channel): e.g. VolumeStage, ScaleStage,
+ * FilterStage or CallbackStage.
+ * ```
+ * VolumeStage volume(0.5);
+ * FilterStage filter;
+ * PipelineT<int16_t, VolumeStage, FilterStage> pipeline(out, volume, filter);
+ * ```
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T sample type
+ * @tparam Stages types of the processing stages
+ */
+template <typename T, typename... Stages>
+class PipelineT : public ModifyingStream {
+ public:
+  /// Output pipeline: the processed data is written to out
+  PipelineT(Print &out, Stages &...stages) : stages(stages...) {
+    setOutput(out);
+  }
+
+  /// Input pipeline: the data is read from in and processed
+  PipelineT(Stream &in, Stages &...stages) : stages(stages...) {
+    setStream(in);
+  }
+
+  /// Input and output need to be defined with setStream() or setOutput()
+  PipelineT(Stages &...stages) : stages(stages...) {}
+
+  void setStream(Stream &in) override {
+    p_stream = &in;
+    p_print = &in;
+  }
+
+  void setOutput(Print &out) override { p_print = &out; }
+
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    if (info.channels == 0) {
+      LOGE("channels must not be 0");
+      return false;
+    }
+    is_active = stages.begin(info);
+    return is_active;
+  }
+
+  void end() override { is_active = false; }
+
+  void setAudioInfo(AudioInfo newInfo) override {
+    AudioStream::setAudioInfo(newInfo);
+    if (is_active) stages.begin(info);
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_print == nullptr) return 0;
+    if (!is_active) return p_print->write(data, len);
+    const T *p_in = (const T *)data;
+    size_t samples = len / sizeof(T);
+    // process in blocks of the buffer size
+    if (buffer.size() == 0) buffer.resize(DEFAULT_BUFFER_SIZE / sizeof(T));
+    size_t processed = 0;
+    while (processed < samples) {
+      size_t n = min(samples - processed, (size_t)buffer.size());
+      process(p_in + processed, buffer.data(), n, (int)(processed % info.channels));
+      size_t written = p_print->write((const uint8_t *)buffer.data(), n * sizeof(T));
+      processed += written / sizeof(T);
+      if (written != n * sizeof(T)) break;
+    }
+    return processed * sizeof(T);
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_stream == nullptr) return 0;
+    size_t result = p_stream->readBytes(data, len);
+    if (is_active) {
+      T *p_data = (T *)data;
+      process(p_data, p_data, result / sizeof(T), 0);
+    }
+    return result;
+  }
+
+  int available() override {
+    return p_stream == nullptr ? 0 : p_stream->available();
+  }
+
+  int availableForWrite() override {
+    return p_print == nullptr ? 0 : p_print->availableForWrite();
+  }
+
+ protected:
+  PipelineStages<Stages...> stages;
+  Vector<T> buffer{0};
+  Stream *p_stream = nullptr;
+  Print *p_print = nullptr;
+  bool is_active = false;
+
+  /// Single loop over all samples and stages
+  void process(const T *in, T *out, size_t samples, int channel) {
+    const float max_value = NumberConverter::maxValueT<T>();
+    const int channels = info.channels;
+    int ch = channel;
+    for (size_t j = 0; j < samples; j++) {
+      T sample = in[j];
+      float value = stages.process(static_cast<float>(sample), ch);
+      if (value > max_value) value = max_value;
+      if (value < -max_value) value = -max_value;
+      out[j] = static_cast<T>(value);
+      if (++ch >= channels) ch = 0;
+    }
+  }
+};
+
 }  // namespace audio_tools
@@ -0,0 +1,116 @@
+#pragma once
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioKernels.h"
+#include "AudioTools/AudioTypes.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Planar floating point frame buffer which is used to exchange the
+ * data with DSP libraries (e.g. Faust, Maximilian, STK) which process a block
+ * of float samples per channel: the memory is allocated once in resize(), so
+ * that no allocation is needed in the processing. The conversion from and to
+ * interleaved PCM data is done with the AudioKernels.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam F float type of the library (e.g. float or double)
+ */
+template <typename F = float>
+class PlanarFrameBuffer {
+ public:
+  PlanarFrameBuffer() = default;
+  PlanarFrameBuffer(int channels, int frames) { resize(channels, frames); }
+
+  /// Allocates the planes: call this in begin()
+  void resize(int channels, int frames) {
+    if (channels == channel_count && frames == frame_count) return;
+    channel_count = channels;
+    frame_count = frames;
+    data.resize(channels * frames);
+    plane_ptrs.resize(channels);
+    for (int ch = 0; ch < channels; ch++) {
+      plane_ptrs[ch] = data.data() + ch * frames;
+    }
+  }
+
+  /// Sets all values to 0
+  void clear() { memset(data.data(), 0, data.size() * sizeof(F)); }
+
+  /// Number of channels
+  int channels() { return channel_count; }
+
+  /// Number of frames which can be stored
+  int frames() { return frame_count; }
+
+  /// Array of the plane pointers (e.g. for Faust compute())
+  F **planes() { return plane_ptrs.data(); }
+
+  /// Plane of the indicated channel
+  F *plane(int channel) { return plane_ptrs[channel]; }
+
+  /// Converts the interleaved PCM data into the planes: returns the number of
+  /// converted frames which is limited by the size of the buffer
+  int fromInterleaved(const uint8_t *pcm, int frames, int bitsPerSample) {
+    if (frames > frame_count) frames = frame_count;
+    switch (bitsPerSample) {
+      case 8:
+        AudioKernels::toPlanar((const int8_t *)pcm, planes(), channel_count,
+                               frames);
+        break;
+      case 16:
+        AudioKernels::toPlanar((const int16_t *)pcm, planes(), channel_count,
+                               frames);
+        break;
+      case 24:
+        AudioKernels::toPlanar((const int24_t *)pcm, planes(), channel_count,
+                               frames);
+        break;
+      case 32:
+        AudioKernels::toPlanar((const int32_t *)pcm, planes(), channel_count,
+                               frames);
+        break;
+      default:
+        LOGE("Unsupported bits_per_sample: %d", bitsPerSample);
+        return 0;
+    }
+    return frames;
+  }
+
+  /// Converts the planes into interleaved PCM data with the indicated gain:
+  /// returns the number of converted frames
+  int toInterleaved(uint8_t *pcm, int frames, int bitsPerSample,
+                    float gain = 1.0f) {
+    if (frames > frame_count) frames = frame_count;
+    switch (bitsPerSample) {
+      case 8:
+        AudioKernels::fromPlanar(planes(), (int8_t *)pcm, channel_count,
+                                 frames, gain);
+        break;
+      case 16:
+        AudioKernels::fromPlanar(planes(), (int16_t *)pcm, channel_count,
+                                 frames, gain);
+        break;
+      case 24:
+        AudioKernels::fromPlanar(planes(), (int24_t *)pcm, channel_count,
+                                 frames, gain);
+        break;
+      case 32:
+        AudioKernels::fromPlanar(planes(), (int32_t *)pcm, channel_count,
+                                 frames, gain);
+        break;
+      default:
+        LOGE("Unsupported bits_per_sample: %d", bitsPerSample);
+        return 0;
+    }
+    return frames;
+  }
+
+ protected:
+  Vector<F> data{0};
+  Vector<F *> plane_ptrs{0};
+  int channel_count = 0;
+  int frame_count = 0;
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioFrameBuffer.h"
+#include "AudioTools/AudioStreams.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Processing chain of PlanarProcessor steps (e.g. ConverterNChannels,
+ * Equilizer3Bands) which are exchanging the planar AudioFrameBuffer directly:
+ * the interleaved data is only converted at the edges, i.e. when it enters
+ * and when it leaves the stream. T is the sample type of the stream and TF
+ * the sample type of the planar frames.
+ *
+ * Incomplete frames of a write are kept until the next write.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T, typename TF>
+class PlanarStream : public ModifyingStream {
+ public:
+  PlanarStream() = default;
+
+  PlanarStream(Print &out) { setOutput(out); }
+
+  PlanarStream(Stream &io) { setStream(io); }
+
+  void setStream(Stream &io) override {
+    p_stream = &io;
+    p_print = &io;
+  }
+
+  void setOutput(Print &out) override { p_print = &out; }
+
+  /// Adds a processing step at the end of the chain
+  void add(PlanarProcessor<TF> &processor) {
+    processors.push_back(&processor);
+  }
+
+  /// Removes all processing steps
+  void clear() { processors.clear(); }
+
+  /// Defines the max number of frames which are processed at once
+  void setFrames(int frames) { block_frames = frames; }
+
+  /// Provides access to the planar frames
+  AudioFrameBuffer<TF> &frames() { return frame_buffer; }
+
+  bool begin(AudioInfo info) {
+    setAudioInfo(info);
+    return begin();
+  }
+
+  bool begin() override {
+    if (info.channels <= 0 || block_frames <= 0) {
+      LOGE("channels and frames must not be 0");
+      return false;
+    }
+    if (sizeof(T) != info.bits_per_sample / 8) {
+      LOGE("bits_per_sample not consistent: %d", info.bits_per_sample);
+      return false;
+    }
+    frame_buffer.resize(info.channels, block_frames);
+    interleaved.resize(info.channels * block_frames);
+    open_samples = 0;
+    return AudioStream::begin();
+  }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_print == nullptr || info.channels <= 0) return 0;
+    const T *samples = (const T *)data;
+    int n = len / sizeof(T);
+    int channels = info.channels;
+    int pos = 0;
+    // complete the frame of the last write
+    if (open_samples > 0) {
+      while (open_samples < channels && pos < n) {
+        interleaved[open_samples++] = samples[pos++];
+      }
+      if (open_samples < channels) return len;
+      writeFrames(interleaved.data(), 1);
+      open_samples = 0;
+    }
+    int frames = (n - pos) / channels;
+    for (int processed = 0; processed < frames; processed += block_frames) {
+      int count = min(block_frames, frames - processed);
+      writeFrames(samples + pos + processed * channels, count);
+    }
+    pos += frames * channels;
+    // keep the incomplete frame
+    while (pos < n) interleaved[open_samples++] = samples[pos++];
+    return len;
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_stream == nullptr || info.channels <= 0) return 0;
+    size_t result = p_stream->readBytes(data, len);
+    T *samples = (T *)data;
+    int frames = result / sizeof(T) / info.channels;
+    for (int processed = 0; processed < frames; processed += block_frames) {
+      int count = min(block_frames, frames - processed);
+      T *block = samples + processed * info.channels;
+      frame_buffer.fromInterleaved(block, count);
+      process();
+      frame_buffer.toInterleaved(block);
+    }
+    return result;
+  }
+
+  int available() override {
+    return p_stream == nullptr ? 0 : p_stream->available();
+  }
+
+  int availableForWrite() override {
+    return p_print == nullptr ? 0 : p_print->availableForWrite();
+  }
+
+ protected:
+  Print *p_print = nullptr;
+  Stream *p_stream = nullptr;
+  Vector<PlanarProcessor<TF> *> processors;
+  AudioFrameBuffer<TF> frame_buffer;
+  Vector<T> interleaved{0};
+  int block_frames = 256;
+  int open_samples = 0;
+
+  void process() {
+    for (int j = 0; j < processors.size(); j++) {
+      processors[j]->process(frame_buffer);
+    }
+  }
+
+  void writeFrames(const T *data, int frames) {
+    frame_buffer.fromInterleaved(data, frames);
+    process();
+    frame_buffer.toInterleaved(interleaved.data());
+    p_print->write((const uint8_t *)interleaved.data(),
+                   frames * info.channels * sizeof(T));
+  }
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,323 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioTools/AudioStreams.h"
+
+#if defined(ESP32)
+#  include "esp_idf_version.h"
+#  if ESP_IDF_VERSION_MAJOR >= 5
+#    include "esp_cpu.h"
+#  endif
+#elif defined(IS_MIN_DESKTOP) || defined(IS_DESKTOP) || \
+    defined(IS_DESKTOP_WITH_TIME_ONLY)
+#  include <chrono>
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Provides the most precise time stamp of the platform: the CPU cycle
+ * counter on the ESP32, the RP2040 (SysTick based) and on ARM processors with
+ * a DWT unit, the nanoseconds
+ * on the desktop and the microseconds on all other platforms.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ProfilerClock {
+ public:
+  /// Starts the cycle counter if necessary
+  static void begin() {
+#if !defined(ESP32) && defined(DWT) && defined(CoreDebug)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  }
+
+  /// Actual time stamp in ticks
+  static inline uint32_t ticks() {
+#if defined(ESP32)
+#  if ESP_IDF_VERSION_MAJOR >= 5
+    return esp_cpu_get_cycle_count();
+#  else
+    return ESP.getCycleCount();
+#  endif
+#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
+    return rp2040.getCycleCount();
+#elif defined(DWT) && defined(CoreDebug)
+    return DWT->CYCCNT;
+#elif defined(IS_MIN_DESKTOP) || defined(IS_DESKTOP) || \
+    defined(IS_DESKTOP_WITH_TIME_ONLY)
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(
+               steady_clock::now().time_since_epoch())
+        .count();
+#else
+    return micros();
+#endif
+  }
+
+  /// Number of ticks per microsecond
+  static uint32_t ticksPerUs() {
+#if defined(ESP32)
+    return getCpuFrequencyMhz();
+#elif defined(ARDUINO_ARCH_RP2040) && !defined(ARDUINO_ARCH_MBED)
+    return rp2040.f_cpu() / 1000000;
+#elif defined(DWT) && defined(CoreDebug)
+    return SystemCoreClock / 1000000;
+#elif defined(IS_MIN_DESKTOP) || defined(IS_DESKTOP) || \
+    defined(IS_DESKTOP_WITH_TIME_ONLY)
+    return 1000;
+#else
+    return 1;
+#endif
+  }
+};
+
+/**
+ * @brief Measured values of one stage of the processing chain
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct ProfileStats {
+  const char *name = "";
+  /// Number of write() or readBytes() calls
+  uint32_t calls = 0;
+  /// Ticks which were spent in the stage without the nested stages
+  uint64_t ticks = 0;
+  /// Max ticks of a single call
+  uint32_t max_ticks = 0;
+  /// Bytes which were provided to the stage
+  uint64_t bytes_in = 0;
+  /// Bytes which were processed (written or read) by the stage
+  uint64_t bytes_out = 0;
+  /// Smallest availableForWrite() (output) or available() (input)
+  int min_fill = -1;
+  /// Biggest availableForWrite() (output) or available() (input)
+  int max_fill = -1;
+  /// Number of reads which did not provide any data
+  uint32_t underruns = 0;
+  /// Number of writes which could not write all data
+  uint32_t overruns = 0;
+
+  /// Average time per call in microseconds
+  float avgUs() {
+    uint32_t per_us = ProfilerClock::ticksPerUs();
+    return calls == 0 ? 0.0f : (float)ticks / calls / per_us;
+  }
+
+  /// Max time of a call in microseconds
+  float maxUs() { return (float)max_ticks / ProfilerClock::ticksPerUs(); }
+
+  void reset() {
+    const char *stage_name = name;
+    *this = ProfileStats();
+    name = stage_name;
+  }
+};
+
+/**
+ * @brief Collects the measurements of all ProfilingStream stages and prints a
+ * report at the defined interval. The time which is spent in nested stages
+ * (e.g. the next stage of an output chain which is called by write()) is
+ * subtracted, so that each stage only reports its own time.
+ *
+ * The measurement only happens if USE_PROFILER is defined: otherwise the
+ * ProfilingStream just forwards the calls and the Pipeline does not add any
+ * stages. The Profiler is not thread safe: use a separate one per task.
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class Profiler {
+ public:
+  Profiler(uint32_t reportIntervalMs = 0, Print *logOut = nullptr) {
+    setReportInterval(reportIntervalMs);
+    p_logout = logOut;
+    ProfilerClock::begin();
+    start_ms = millis();
+  }
+
+  /// Defines the interval of the automatic report: 0 = no report
+  void setReportInterval(uint32_t ms) { report_ms = ms; }
+
+  /// Prints the report to the indicated output instead of the AudioLogger
+  void setOutput(Print &out) { p_logout = &out; }
+
+  /// Registers a new stage: returns the index
+  int addStage(const char *name) {
+    ProfileStats stats;
+    stats.name = name;
+    stages.push_back(stats);
+    return stages.size() - 1;
+  }
+
+  /// Number of stages
+  int size() { return stages.size(); }
+
+  /// Provides the measurements of the indicated stage
+  ProfileStats &stats(int idx) { return stages[idx]; }
+
+  /// Resets all measurements
+  void reset() {
+    for (int j = 0; j < stages.size(); j++) stages[j].reset();
+    start_ms = millis();
+  }
+
+  /// Prints the measurements of all stages
+  void report() {
+    uint32_t ms = millis() - start_ms;
+    char msg[160];
+    for (int j = 0; j < stages.size(); j++) {
+      ProfileStats &s = stages[j];
+      float cpu = ms == 0 ? 0.0f
+                          : 100.0f * s.ticks / ProfilerClock::ticksPerUs() /
+                                (ms * 1000.0f);
+      snprintf(msg, sizeof(msg),
+               "%s: calls=%u avg=%.1fus max=%.1fus cpu=%.1f%% in=%lu out=%lu "
+               "fill=%d..%d underruns=%u overruns=%u",
+               s.name, (unsigned)s.calls, s.avgUs(), s.maxUs(), cpu,
+               (unsigned long)s.bytes_in, (unsigned long)s.bytes_out,
+               s.min_fill, s.max_fill, (unsigned)s.underruns,
+               (unsigned)s.overruns);
+      if (p_logout != nullptr) {
+        p_logout->println(msg);
+      } else {
+        LOGI("%s", msg);
+      }
+    }
+  }
+
+  /// Called at the start of a measured call: returns the start time
+  inline uint32_t enter() {
+    if (depth < max_depth) nesting[depth] = nested_ticks;
+    depth++;
+    nested_ticks = 0;
+    return ProfilerClock::ticks();
+  }
+
+  /// Called at the end of a measured call
+  void leave(int idx, uint32_t start) {
+    uint32_t elapsed = ProfilerClock::ticks() - start;
+    uint32_t own = elapsed > nested_ticks ? elapsed - nested_ticks : 0;
+    ProfileStats &s = stages[idx];
+    s.calls++;
+    s.ticks += own;
+    if (own > s.max_ticks) s.max_ticks = own;
+    // the parent must not count our time
+    depth--;
+    uint32_t parent = depth < max_depth ? nesting[depth] : 0;
+    nested_ticks = parent + elapsed;
+    if (depth == 0 && report_ms > 0 && millis() - start_ms >= report_ms) {
+      report();
+      reset();
+    }
+  }
+
+ protected:
+  Vector<ProfileStats> stages;
+  static const int max_depth = 16;
+  uint32_t nesting[max_depth];
+  int depth = 0;
+  uint32_t nested_ticks = 0;
+  uint32_t report_ms = 0;
+  uint32_t start_ms = 0;
+  Print *p_logout = nullptr;
+};
+
+/**
+ * @brief Measuring stage which can be put in front of any Print or Stream of
+ * a processing chain (e.g. as output of a StreamCopy): it records the time
+ * spent per call, the bytes in and out, the fill level of the target and the
+ * underruns and overruns in the Profiler. The Pipeline adds these stages
+ * automatically if a Profiler has been defined with setProfiler().
+ * @ingroup tools
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class ProfilingStream : public ModifyingStream {
+ public:
+  ProfilingStream(Profiler &profiler, const char *name) {
+    p_profiler = &profiler;
+    idx = profiler.addStage(name);
+  }
+
+  ProfilingStream(Print &out, Profiler &profiler, const char *name)
+      : ProfilingStream(profiler, name) {
+    setOutput(out);
+  }
+
+  ProfilingStream(Stream &io, Profiler &profiler, const char *name)
+      : ProfilingStream(profiler, name) {
+    setStream(io);
+  }
+
+  void setStream(Stream &io) override {
+    p_stream = &io;
+    p_print = &io;
+  }
+
+  void setOutput(Print &out) override { p_print = &out; }
+
+  size_t write(const uint8_t *data, size_t len) override {
+    if (p_print == nullptr) return 0;
+#ifdef USE_PROFILER
+    recordFill(p_print->availableForWrite());
+    uint32_t start = p_profiler->enter();
+    size_t result = p_print->write(data, len);
+    p_profiler->leave(idx, start);
+    ProfileStats &s = p_profiler->stats(idx);
+    s.bytes_in += len;
+    s.bytes_out += result;
+    if (result < len) s.overruns++;
+    return result;
+#else
+    return p_print->write(data, len);
+#endif
+  }
+
+  size_t readBytes(uint8_t *data, size_t len) override {
+    if (p_stream == nullptr) return 0;
+#ifdef USE_PROFILER
+    recordFill(p_stream->available());
+    uint32_t start = p_profiler->enter();
+    size_t result = p_stream->readBytes(data, len);
+    p_profiler->leave(idx, start);
+    ProfileStats &s = p_profiler->stats(idx);
+    s.bytes_in += len;
+    s.bytes_out += result;
+    if (result == 0 && len > 0) s.underruns++;
+    return result;
+#else
+    return p_stream->readBytes(data, len);
+#endif
+  }
+
+  int available() override {
+    return p_stream == nullptr ? 0 : p_stream->available();
+  }
+
+  int availableForWrite() override {
+    return p_print == nullptr ? 0 : p_print->availableForWrite();
+  }
+
+  /// Provides the measurements of this stage
+  ProfileStats &stats() { return p_profiler->stats(idx); }
+
+ protected:
+  Profiler *p_profiler = nullptr;
+  Stream *p_stream = nullptr;
+  Print *p_print = nullptr;
+  int idx = 0;
+
+  void recordFill(int fill) {
+    ProfileStats &s = p_profiler->stats(idx);
+    if (s.min_fill < 0 || fill < s.min_fill) s.min_fill = fill;
+    if (fill > s.max_fill) s.max_fill = fill;
+  }
+};
+
+}  // namespace audio_tools
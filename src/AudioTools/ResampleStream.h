@@ -10,6 +10,15 @@
 
 namespace audio_tools {
 
+/**
+ * @brief Resampling algorithm used by the ResampleStream:
+ * - Linear: linear interpolation with a variable step size
+ * - Polyphase: windowed-sinc polyphase FIR with float coefficients
+ * - PolyphaseFixedPoint: windowed-sinc polyphase FIR with Q15 coefficients
+ *   for processors w/o FPU
+ */
+enum class ResampleEngine : uint8_t { Linear, Polyphase, PolyphaseFixedPoint };
+
 /**
  * @brief Optional Configuration object. The critical information is the
  * channels and the step_size. All other information is not used.
@@ -20,8 +29,174 @@ struct ResampleConfig : public AudioInfo {
   /// Optional fixed target sample rate
   int to_sample_rate = 0;
   int buffer_size = DEFAULT_BUFFER_SIZE;
+  /// Resampling algorithm: the polyphase engines need a fixed rate ratio
+  ResampleEngine engine = ResampleEngine::Linear;
+  /// Number of filter taps per phase (polyphase engines only)
+  int taps = RESAMPLE_POLYPHASE_TAPS;
+  /// Max number of phases: if exceeded we fall back to linear interpolation
+  int max_phases = RESAMPLE_MAX_PHASES;
 };
 
+/**
+ * @brief Polyphase windowed-sinc resampler for a fixed rational ratio
+ * to/from = L/M (e.g. 160/147 for 44100 -> 48000). The coefficients of all L
+ * phases are precomputed, so each output sample is a fixed dot product over
+ * the last taps input frames.
+ * @ingroup transform
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam TCoef type of the coefficients: float or int16_t (Q15)
+ * @tparam TValue type of the history values
+ * @tparam TSum type of the accumulator
+ */
+template <typename TCoef, typename TValue, typename TSum>
+class ResamplePolyphaseT {
+ public:
+  /// Calculates the coefficient table: returns false if the ratio needs too
+  /// many phases
+  bool begin(int fromRate, int toRate, int channels, int taps,
+             int maxPhases = RESAMPLE_MAX_PHASES) {
+    if (fromRate <= 0 || toRate <= 0 || channels <= 0 || taps < 2) {
+      LOGE("invalid parameters");
+      return false;
+    }
+    int div = gcd(fromRate, toRate);
+    int up_new = toRate / div;
+    int down_new = fromRate / div;
+    if (up_new > maxPhases) {
+      LOGW("polyphase needs %d phases: max is %d", up_new, maxPhases);
+      return false;
+    }
+    // recalculate the coefficients only if necessary
+    if (up_new != up || down_new != down || taps != this->taps ||
+        coef.size() == 0) {
+      up = up_new;
+      down = down_new;
+      this->taps = taps;
+      setupCoefficients();
+    }
+    this->channels = channels;
+    history.resize(channels * taps * 2);
+    reset();
+    LOGI("polyphase %d/%d with %d taps", up, down, taps);
+    return true;
+  }
+
+  /// Releases the coefficient table and history
+  void end() {
+    coef.resize(0);
+    history.resize(0);
+    up = down = 0;
+  }
+
+  /// Clears the history
+  void reset() {
+    memset(history.data(), 0, history.size() * sizeof(TValue));
+    pos = 0;
+    phase = up;
+  }
+
+  /// Adds the next input frame
+  template <typename T>
+  void write(T *frame) {
+    if (phase >= up) phase -= up;
+    for (int ch = 0; ch < channels; ch++) {
+      // store each value twice, so that the window is always contiguous
+      TValue *p_hist = history.data() + (ch * taps * 2);
+      TValue value = (int32_t)frame[ch];
+      p_hist[pos] = value;
+      p_hist[pos + taps] = value;
+    }
+    if (++pos >= taps) pos = 0;
+  }
+
+  /// Provides the next output frame: returns false if the next input frame is
+  /// needed
+  template <typename T>
+  bool read(T *frame) {
+    if (phase >= up) return false;
+    const TCoef *p_coef = coef.data() + (phase * taps);
+    TSum max_value = NumberConverter::maxValueT<T>();
+    for (int ch = 0; ch < channels; ch++) {
+      const TValue *p_hist = history.data() + (ch * taps * 2) + pos;
+      TSum sum = 0;
+      for (int k = 0; k < taps; k++) {
+        sum += (TSum)p_coef[k] * p_hist[k];
+      }
+      sum = scale(sum);
+      if (sum > max_value) sum = max_value;
+      if (sum < -max_value) sum = -max_value;
+      frame[ch] = (int32_t)round(sum);
+    }
+    phase += down;
+    return true;
+  }
+
+  /// Interpolation factor L
+  int upFactor() { return up; }
+  /// Decimation factor M
+  int downFactor() { return down; }
+
+ protected:
+  Vector<TCoef> coef{0};
+  Vector<TValue> history{0};
+  int up = 0;
+  int down = 0;
+  int taps = 0;
+  int channels = 0;
+  int pos = 0;
+  int phase = 0;
+
+  static int gcd(int a, int b) {
+    while (b != 0) {
+      int tmp = a % b;
+      a = b;
+      b = tmp;
+    }
+    return a;
+  }
+
+  /// Blackman windowed sinc with the cutoff at the lower nyquist frequency
+  void setupCoefficients() {
+    coef.resize(up * taps);
+    float fc = up < down ? static_cast<float>(up) / down : 1.0f;
+    // the output position is located between the taps (center-1) and center
+    float center = taps / 2 - 1;
+    float half = taps / 2.0f;
+    float tmp[taps];
+    for (int p = 0; p < up; p++) {
+      float sum = 0;
+      for (int k = 0; k < taps; k++) {
+        float u = center + static_cast<float>(p) / up - k;
+        float x = PI * fc * u;
+        float sinc = (x == 0.0f) ? 1.0f : sin(x) / x;
+        float w = 0.42f + 0.5f * cos(PI * u / half) +
+                  0.08f * cos(2.0f * PI * u / half);
+        tmp[k] = fc * sinc * w;
+        sum += tmp[k];
+      }
+      // normalize each phase to a gain of 1
+      for (int k = 0; k < taps; k++) {
+        setCoef(coef[p * taps + k], tmp[k] / sum);
+      }
+    }
+  }
+
+  static void setCoef(float &to, float value) { to = value; }
+  static void setCoef(int16_t &to, float value) {
+    to = NumberConverter::clip(value * 32768.0f, 16);
+  }
+  static float scale(float sum) { return sum; }
+  static int64_t scale(int64_t sum) { return (sum + (1 << 14)) >> 15; }
+  static float round(float value) { return ::round(value); }
+  static int64_t round(int64_t value) { return value; }
+};
+
+/// Polyphase resampler using float coefficients
+using ResamplePolyphase = ResamplePolyphaseT<float, float, float>;
+/// Polyphase resampler using Q15 fixed point coefficients
+using ResamplePolyphaseFixed = ResamplePolyphaseT<int16_t, int32_t, int64_t>;
+
 /**
  * @brief Dynamic Resampling. We can use a variable factor to speed up or slow
  * down the playback.
@@ -57,6 +232,9 @@ class ResampleStream : public ReformatBaseStream {
   ResampleConfig defaultConfig() {
     ResampleConfig cfg;
     cfg.copyFrom(audioInfo());
+    cfg.engine = engine;
+    cfg.taps = taps;
+    cfg.max_phases = max_phases;
     return cfg;
   }
 
@@ -65,9 +243,13 @@ class ResampleStream : public ReformatBaseStream {
     is_output_notify = false;
     to_sample_rate = cfg.to_sample_rate;
     out_buffer.resize(cfg.buffer_size);
+    engine = cfg.engine;
+    taps = cfg.taps;
+    max_phases = cfg.max_phases;
 
     setupLastSamples(cfg);
     setStepSize(cfg.step_size);
+    setupPolyphase(cfg, cfg.step_size);
     is_first = true;
     idx = 0;
     // step_dirty = true;
@@ -97,7 +279,7 @@ class ResampleStream : public ReformatBaseStream {
   }
 
   bool begin(AudioInfo from, sample_rate_t toRate) {
-    ResampleConfig rcfg;
+    ResampleConfig rcfg = defaultConfig();
     rcfg.copyFrom(from);
     rcfg.to_sample_rate = toRate;
     rcfg.step_size = getStepSize(from.sample_rate, toRate);
@@ -114,9 +296,9 @@ class ResampleStream : public ReformatBaseStream {
   }
 
   bool begin(AudioInfo info, float step) {
-    ResampleConfig rcfg;
+    ResampleConfig rcfg = defaultConfig();
     rcfg.copyFrom(info);
-    step_size = step;
+    rcfg.step_size = step;
     return begin(rcfg);
   }
 
@@ -125,6 +307,12 @@ class ResampleStream : public ReformatBaseStream {
     if (to_sample_rate != 0) {
       setStepSize(getStepSize(newInfo.sample_rate, to_sample_rate));
     }
+    // recalculate the polyphase coefficients
+    if (engine != ResampleEngine::Linear &&
+        (newInfo.sample_rate != info.sample_rate ||
+         newInfo.channels != info.channels)) {
+      setupPolyphase(newInfo, step_size);
+    }
     // notify about changes
     LOGI("-> ResampleStream:")
     AudioStream::setAudioInfo(newInfo);
@@ -196,6 +384,25 @@ class ResampleStream : public ReformatBaseStream {
 
   float getByteFactor() { return 1.0 / step_size; }
 
+  /// Returns true if the polyphase engine is used for the actual ratio
+  bool isPolyphase() { return is_polyphase; }
+
+  /// Changes the engine while processing: e.g. Linear to reduce the CPU load
+  void setEngine(ResampleEngine newEngine) {
+    if (newEngine == engine) return;
+    engine = newEngine;
+    setupPolyphase(info, step_size);
+  }
+
+  ResampleEngine getEngine() { return engine; }
+
+  void end() override {
+    ReformatBaseStream::end();
+    polyphase_float.end();
+    polyphase_fixed.end();
+    is_polyphase = false;
+  }
+
  protected:
   Vector<uint8_t> last_samples{0};
   float idx = 0;
@@ -207,6 +414,74 @@ class ResampleStream : public ReformatBaseStream {
   bool is_buffer_active = USE_RESAMPLE_BUFFER;
   SingleBuffer<uint8_t> out_buffer{0};
   Print *p_out = nullptr;
+  // optional polyphase engine
+  ResampleEngine engine = ResampleEngine::Linear;
+  int taps = RESAMPLE_POLYPHASE_TAPS;
+  int max_phases = RESAMPLE_MAX_PHASES;
+  bool is_polyphase = false;
+  ResamplePolyphase polyphase_float;
+  ResamplePolyphaseFixed polyphase_fixed;
+
+  /// Sets up the polyphase coefficients: falls back to linear interpolation
+  /// if this is not possible
+  void setupPolyphase(AudioInfo cfg, float step) {
+    is_polyphase = false;
+    if (engine == ResampleEngine::Linear) return;
+    if (cfg.sample_rate == 0 || cfg.channels == 0) return;
+    int from_rate = cfg.sample_rate;
+    int to_rate =
+        to_sample_rate != 0 ? to_sample_rate : ::round(from_rate / step);
+    if (from_rate == to_rate) return;
+    if (engine == ResampleEngine::PolyphaseFixedPoint) {
+      is_polyphase = polyphase_fixed.begin(from_rate, to_rate, cfg.channels,
+                                           taps, max_phases);
+    } else {
+      is_polyphase = polyphase_float.begin(from_rate, to_rate, cfg.channels,
+                                           taps, max_phases);
+    }
+    if (!is_polyphase) {
+      LOGW("using linear interpolation for %d -> %d", from_rate, to_rate);
+    }
+  }
+
+  /// Writes a single frame to the buffer or the output
+  void writeFrame(const uint8_t *frame, size_t frame_size, size_t &written) {
+    if (is_buffer_active) {
+      // if buffer is full we send it to output
+      if (out_buffer.availableForWrite() <= frame_size) {
+        flush();
+      }
+
+      // we use a buffer to minimize the number of output calls
+      int tmp_written = out_buffer.writeArray(frame, frame_size);
+      written += tmp_written;
+      if (frame_size != tmp_written) {
+        TRACEE();
+      }
+    } else {
+      int tmp = p_out->write(frame, frame_size);
+      written += tmp;
+      if (tmp != frame_size) {
+        LOGE("Failed to write %d bytes: %d", (int)frame_size, tmp);
+      }
+    }
+  }
+
+  /// Resampling with the polyphase engine
+  template <typename T, typename TEngine>
+  size_t writePolyphase(TEngine &polyphase, T *data, size_t frames,
+                        size_t &written) {
+    T frame[info.channels];
+    size_t frame_size = sizeof(frame);
+    for (size_t j = 0; j < frames; j++) {
+      polyphase.write(data + (j * info.channels));
+      while (polyphase.read(frame)) {
+        writeFrame((const uint8_t *)frame, frame_size, written);
+      }
+    }
+    flush();
+    return frames * info.channels * sizeof(T);
+  }
 
   /// Sets up the buffer for the rollover samples
   void setupLastSamples(AudioInfo cfg) {
@@ -235,6 +510,12 @@ class ResampleStream : public ReformatBaseStream {
     size_t frames = samples / info.channels;
     written = 0;
 
+    if (is_polyphase) {
+      if (engine == ResampleEngine::PolyphaseFixedPoint)
+        return writePolyphase<T>(polyphase_fixed, data, frames, written);
+      return writePolyphase<T>(polyphase_float, data, frames, written);
+    }
+
     // avoid noise if audio does not start with 0
     if (is_first) {
       is_first = false;
@@ -251,26 +532,7 @@ class ResampleStream : public ReformatBaseStream {
         frame[ch] = result;
       }
 
-      if (is_buffer_active) {
-        // if buffer is full we send it to output
-        if (out_buffer.availableForWrite() <= frame_size) {
-          flush();
-        }
-
-        // we use a buffer to minimize the number of output calls
-        int tmp_written =
-            out_buffer.writeArray((const uint8_t *)&frame, frame_size);
-        written += tmp_written;
-        if (frame_size != tmp_written) {
-          TRACEE();
-        }
-      } else {
-        int tmp = p_out->write((const uint8_t *)&frame, frame_size);
-        written += tmp;
-        if (tmp != frame_size) {
-          LOGE("Failed to write %d bytes: %d", (int)frame_size, tmp);
-        }
-      }
+      writeFrame((const uint8_t *)&frame, frame_size, written);
 
       idx += step_size;
     }
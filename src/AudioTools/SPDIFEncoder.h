@@ -0,0 +1,199 @@
+#pragma once
+
+#include "AudioConfig.h"
+#include "AudioTools/AudioTypes.h"
+
+// BMC preamble
+#define BMC_B 0x33173333  // block start
+#define BMC_M 0x331d3333  // left ch
+#define BMC_W 0x331b3333  // right ch
+#define BMC_MW_DIF (BMC_M ^ BMC_W)
+#define SYNC_OFFSET 2  // byte offset of SYNC
+#define SYNC_FLIP ((BMC_B ^ BMC_M) >> (SYNC_OFFSET * 8))
+#define SPDIF_BLOCK_FRAMES 192
+#define SPDIF_WORDS_PER_FRAME 4
+
+namespace audio_tools {
+
+/*
+ * 8bit PCM to 16bit BMC conversion table, LSb first, 1 end
+ */
+static const uint16_t bmc_tab_uint[256] = {
+    0x3333, 0xb333, 0xd333, 0x5333, 0xcb33, 0x4b33, 0x2b33, 0xab33, 0xcd33,
+    0x4d33, 0x2d33, 0xad33, 0x3533, 0xb533, 0xd533, 0x5533, 0xccb3, 0x4cb3,
+    0x2cb3, 0xacb3, 0x34b3, 0xb4b3, 0xd4b3, 0x54b3, 0x32b3, 0xb2b3, 0xd2b3,
+    0x52b3, 0xcab3, 0x4ab3, 0x2ab3, 0xaab3, 0xccd3, 0x4cd3, 0x2cd3, 0xacd3,
+    0x34d3, 0xb4d3, 0xd4d3, 0x54d3, 0x32d3, 0xb2d3, 0xd2d3, 0x52d3, 0xcad3,
+    0x4ad3, 0x2ad3, 0xaad3, 0x3353, 0xb353, 0xd353, 0x5353, 0xcb53, 0x4b53,
+    0x2b53, 0xab53, 0xcd53, 0x4d53, 0x2d53, 0xad53, 0x3553, 0xb553, 0xd553,
+    0x5553, 0xcccb, 0x4ccb, 0x2ccb, 0xaccb, 0x34cb, 0xb4cb, 0xd4cb, 0x54cb,
+    0x32cb, 0xb2cb, 0xd2cb, 0x52cb, 0xcacb, 0x4acb, 0x2acb, 0xaacb, 0x334b,
+    0xb34b, 0xd34b, 0x534b, 0xcb4b, 0x4b4b, 0x2b4b, 0xab4b, 0xcd4b, 0x4d4b,
+    0x2d4b, 0xad4b, 0x354b, 0xb54b, 0xd54b, 0x554b, 0x332b, 0xb32b, 0xd32b,
+    0x532b, 0xcb2b, 0x4b2b, 0x2b2b, 0xab2b, 0xcd2b, 0x4d2b, 0x2d2b, 0xad2b,
+    0x352b, 0xb52b, 0xd52b, 0x552b, 0xccab, 0x4cab, 0x2cab, 0xacab, 0x34ab,
+    0xb4ab, 0xd4ab, 0x54ab, 0x32ab, 0xb2ab, 0xd2ab, 0x52ab, 0xcaab, 0x4aab,
+    0x2aab, 0xaaab, 0xcccd, 0x4ccd, 0x2ccd, 0xaccd, 0x34cd, 0xb4cd, 0xd4cd,
+    0x54cd, 0x32cd, 0xb2cd, 0xd2cd, 0x52cd, 0xcacd, 0x4acd, 0x2acd, 0xaacd,
+    0x334d, 0xb34d, 0xd34d, 0x534d, 0xcb4d, 0x4b4d, 0x2b4d, 0xab4d, 0xcd4d,
+    0x4d4d, 0x2d4d, 0xad4d, 0x354d, 0xb54d, 0xd54d, 0x554d, 0x332d, 0xb32d,
+    0xd32d, 0x532d, 0xcb2d, 0x4b2d, 0x2b2d, 0xab2d, 0xcd2d, 0x4d2d, 0x2d2d,
+    0xad2d, 0x352d, 0xb52d, 0xd52d, 0x552d, 0xccad, 0x4cad, 0x2cad, 0xacad,
+    0x34ad, 0xb4ad, 0xd4ad, 0x54ad, 0x32ad, 0xb2ad, 0xd2ad, 0x52ad, 0xcaad,
+    0x4aad, 0x2aad, 0xaaad, 0x3335, 0xb335, 0xd335, 0x5335, 0xcb35, 0x4b35,
+    0x2b35, 0xab35, 0xcd35, 0x4d35, 0x2d35, 0xad35, 0x3535, 0xb535, 0xd535,
+    0x5535, 0xccb5, 0x4cb5, 0x2cb5, 0xacb5, 0x34b5, 0xb4b5, 0xd4b5, 0x54b5,
+    0x32b5, 0xb2b5, 0xd2b5, 0x52b5, 0xcab5, 0x4ab5, 0x2ab5, 0xaab5, 0xccd5,
+    0x4cd5, 0x2cd5, 0xacd5, 0x34d5, 0xb4d5, 0xd4d5, 0x54d5, 0x32d5, 0xb2d5,
+    0xd2d5, 0x52d5, 0xcad5, 0x4ad5, 0x2ad5, 0xaad5, 0x3355, 0xb355, 0xd355,
+    0x5355, 0xcb55, 0x4b55, 0x2b55, 0xab55, 0xcd55, 0x4d55, 0x2d55, 0xad55,
+    0x3555, 0xb555, 0xd555, 0x5555,
+};
+static const int16_t *bmc_tab = (int16_t *)bmc_tab_uint;
+
+/**
+ * @brief Biphase mark encoding of PCM data into S/PDIF (IEC 60958) subframes
+ * which are output as 2 x 32 bit I2S words: each audio frame results in
+ * SPDIF_WORDS_PER_FRAME words. The encoding is done byte wise with the BMC
+ * lookup table and the polarity of the bytes is chained with the sign of the
+ * table entries, so that a subframe only needs 4 table lookups. We support
+ * 16 and 24 bit audio (and 32 bit which is truncated to 24 bits) with 1 or 2
+ * channels and we provide the sample rate and word length in the channel
+ * status.
+ *
+ * The first word of a subframe contains the V,U,C,P bits of the prior
+ * subframe, the preamble and the aux bits and the second word the 16 most
+ * significant audio bits.
+ * @ingroup encoder
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SPDIFEncoder {
+ public:
+  /// Defines the audio format and resets the block position
+  bool begin(AudioInfo info) {
+    if (!(info.channels == 1 || info.channels == 2)) {
+      LOGE("Unsupported number of channels: %d", info.channels);
+      return false;
+    }
+    if (!(info.bits_per_sample == 16 || info.bits_per_sample == 24 ||
+          info.bits_per_sample == 32)) {
+      LOGE("Unsupported bits per sample: %d", info.bits_per_sample);
+      return false;
+    }
+    this->info = info;
+    setupChannelStatus();
+    frame_idx = 0;
+    vucp = 0x33;
+    return true;
+  }
+
+  /// Number of bytes of one audio frame
+  int frameSize() { return info.channels * sampleSize(); }
+
+  /// Encodes the indicated number of frames: the output must provide
+  /// frames * SPDIF_WORDS_PER_FRAME words.
+  void encode(const uint8_t *data, int frames, uint32_t *out) {
+    switch (info.bits_per_sample) {
+      case 16:
+        encodeT<int16_t>((const int16_t *)data, frames, out);
+        break;
+      case 24:
+        encodeT<int24_t>((const int24_t *)data, frames, out);
+        break;
+      case 32:
+        encodeT<int32_t>((const int32_t *)data, frames, out);
+        break;
+    }
+  }
+
+ protected:
+  AudioInfo info;
+  uint8_t channel_status[SPDIF_BLOCK_FRAMES / 8] = {0};
+  int frame_idx = 0;
+  // BMC of the V,U,C,P bits of the last subframe
+  uint32_t vucp = 0x33;
+
+  int sampleSize() {
+    return info.bits_per_sample == 24 ? sizeof(int24_t)
+                                      : info.bits_per_sample / 8;
+  }
+
+  template <typename T>
+  void encodeT(const T *pcm, int frames, uint32_t *out) {
+    const int channels = info.channels;
+    for (int j = 0; j < frames; j++) {
+      uint32_t c_bit = (channel_status[frame_idx >> 3] >> (frame_idx & 7)) & 1;
+      int32_t left = toInt24(pcm[0]);
+      int32_t right = channels == 2 ? toInt24(pcm[1]) : left;
+      uint32_t preamble = frame_idx == 0 ? (BMC_B >> 16) & 0xff
+                                         : (BMC_M >> 16) & 0xff;
+      encodeSubframe(left, preamble, c_bit, out);
+      encodeSubframe(right, (BMC_W >> 16) & 0xff, c_bit, out + 2);
+      out += SPDIF_WORDS_PER_FRAME;
+      pcm += channels;
+      if (++frame_idx >= SPDIF_BLOCK_FRAMES) frame_idx = 0;
+    }
+  }
+
+  /// Encodes the 24 bit sample into 2 words. The BMC table entries start with
+  /// the parity of the byte and end with 1: so we can determine the inversion
+  /// of each byte from the sign of the following (inverted) byte.
+  inline void encodeSubframe(int32_t sample, uint32_t preamble, uint32_t c_bit,
+                             uint32_t *out) {
+    int32_t a = bmc_tab[sample & 0xff];
+    int32_t b = bmc_tab[(sample >> 8) & 0xff];
+    int32_t c = bmc_tab[(sample >> 16) & 0xff];
+    // slots 28-31: V=0, U=0, C and even parity
+    uint32_t vuc = c_bit << 2;
+    uint32_t parity = (uint32_t)(a ^ b ^ c ^ bmc_tab[vuc]) >> 31;
+    int32_t n = bmc_tab[vuc | (parity << 3)];
+    int32_t x = c ^ (n >> 31);
+    int32_t y = b ^ (x >> 31);
+    int32_t z = a ^ (y >> 31);
+    out[0] = (vucp << 24) | (preamble << 16) | (z & 0xffff);
+    out[1] = ((uint32_t)y << 16) | (x & 0xffff);
+    vucp = (n >> 8) & 0xff;
+  }
+
+  inline int32_t toInt24(int16_t value) { return (int32_t)value << 8; }
+  inline int32_t toInt24(int24_t value) { return (int32_t)(int)value; }
+  inline int32_t toInt24(int32_t value) { return value >> 8; }
+
+  /// Consumer channel status: PCM, copy permitted, sample rate and word length
+  void setupChannelStatus() {
+    memset(channel_status, 0, sizeof(channel_status));
+    channel_status[0] = 0x04;
+    switch (info.sample_rate) {
+      case 44100:
+        channel_status[3] = 0x00;
+        break;
+      case 48000:
+        channel_status[3] = 0x02;
+        break;
+      case 32000:
+        channel_status[3] = 0x03;
+        break;
+      case 88200:
+        channel_status[3] = 0x08;
+        break;
+      case 96000:
+        channel_status[3] = 0x0a;
+        break;
+      case 176400:
+        channel_status[3] = 0x0c;
+        break;
+      case 192000:
+        channel_status[3] = 0x0e;
+        break;
+      default:
+        // not indicated
+        channel_status[3] = 0x01;
+        break;
+    }
+    // word length: 16 bits of max 20 or 24 bits of max 24
+    channel_status[4] = info.bits_per_sample == 16 ? 0x02 : 0x0b;
+  }
+};
+
+}  // namespace audio_tools
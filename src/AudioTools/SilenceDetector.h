@@ -0,0 +1,158 @@
+#pragma once
+#include <math.h>
+
+#include "AudioTools/AudioKernels.h"
+#include "AudioTools/AudioTypes.h"
+#include "AudioTools/BaseConverter.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Simple energy based silence (voice activity) detector: the energy of
+ * each analyzed block is determined with the shared peak and sum of squares
+ * kernel and compared with the threshold. After the signal has been below the
+ * threshold for the hangover time it is reported as silent, so that the
+ * fade out of words is not cut off. The network streams use it to suppress
+ * the sending of silent packets.
+ * @ingroup volume
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SilenceDetector {
+ public:
+  SilenceDetector() { setThresholdDb(-50.0f); }
+
+  SilenceDetector(AudioInfo info, float thresholdDb = -50.0f,
+                  int hangoverMs = 300) {
+    setAudioInfo(info);
+    setThresholdDb(thresholdDb);
+    setHangoverMs(hangoverMs);
+  }
+
+  /// Defines the audio format of the analyzed data
+  void setAudioInfo(AudioInfo info) {
+    this->info = info;
+    reset();
+  }
+
+  AudioInfo audioInfo() { return info; }
+
+  /// Defines the threshold in dBFS (e.g. -50)
+  void setThresholdDb(float db) {
+    threshold_db = db;
+    // compare the mean squares at the 16 bit scale of the kernel
+    float rms = 32767.0f * powf(10.0f, db / 20.0f);
+    threshold_ms = rms * rms;
+  }
+
+  float thresholdDb() { return threshold_db; }
+
+  /// Defines how long the signal must stay below the threshold before it is
+  /// reported as silent
+  void setHangoverMs(int ms) { hangover_ms = ms; }
+
+  /// Restarts the detection: the signal is considered as active
+  void reset() {
+    silent_frames = 0;
+    is_silent = false;
+    mean_square = 0;
+  }
+
+  /// Analyzes the data and returns true if it is silent
+  bool update(const uint8_t *data, size_t len) {
+    int frame_size = info.channels * info.bits_per_sample / 8;
+    if (frame_size <= 0 || len == 0) return is_silent;
+    size_t samples = len / (info.bits_per_sample / 8);
+    int32_t peak = 0;
+    int64_t sum = 0;
+    switch (info.bits_per_sample) {
+      case 16:
+        AudioKernels::peakSumSquares((const int16_t *)data, samples, 1, &peak,
+                                     &sum);
+        break;
+      case 24:
+        AudioKernels::peakSumSquares((const int24_t *)data, samples, 1, &peak,
+                                     &sum);
+        break;
+      case 32:
+        AudioKernels::peakSumSquares((const int32_t *)data, samples, 1, &peak,
+                                     &sum);
+        break;
+      default:
+        LOGE("Unsupported bits_per_sample: %d", info.bits_per_sample);
+        return false;
+    }
+    mean_square = (float)sum / samples;
+    if (mean_square >= threshold_ms) {
+      silent_frames = 0;
+      is_silent = false;
+    } else {
+      silent_frames += len / frame_size;
+      is_silent = silent_frames >= hangoverFrames();
+    }
+    return is_silent;
+  }
+
+  /// Result of the last update()
+  bool isSilent() { return is_silent; }
+
+  /// Level of the last analyzed block in dBFS
+  float levelDb() {
+    if (mean_square <= 0.0f) return -100.0f;
+    return 10.0f * log10f(mean_square / (32767.0f * 32767.0f));
+  }
+
+ protected:
+  AudioInfo info;
+  float threshold_db = -50.0f;
+  float threshold_ms = 0;
+  float mean_square = 0;
+  int hangover_ms = 300;
+  uint32_t silent_frames = 0;
+  bool is_silent = false;
+
+  uint32_t hangoverFrames() {
+    return (uint64_t)info.sample_rate * hangover_ms / 1000;
+  }
+};
+
+/**
+ * @brief Converter which removes the silent blocks which were identified by
+ * the SilenceDetector: e.g. to suppress the sending of silence in the
+ * AudioEncoderServer. Unlike the SilenceRemovalConverter the data is not
+ * compacted sample by sample but dropped as a whole. The data which is not
+ * silent can be passed on to an additional converter.
+ * @ingroup convert
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SilenceSuppressionConverter : public BaseConverter {
+ public:
+  SilenceSuppressionConverter() = default;
+  SilenceSuppressionConverter(SilenceDetector &detector) {
+    setSilenceDetector(detector);
+  }
+
+  void setSilenceDetector(SilenceDetector &detector) { p_detector = &detector; }
+
+  /// Defines an optional converter which is applied to the data w/o silence
+  void setConverter(BaseConverter *converter) { p_next = converter; }
+
+  size_t convert(uint8_t *data, size_t size) override {
+    if (p_detector != nullptr && p_detector->update(data, size)) {
+      suppressed_bytes += size;
+      return 0;
+    }
+    return p_next == nullptr ? size : p_next->convert(data, size);
+  }
+
+  /// Number of bytes which were not passed on
+  size_t suppressedBytes() { return suppressed_bytes; }
+
+ protected:
+  SilenceDetector *p_detector = nullptr;
+  BaseConverter *p_next = nullptr;
+  size_t suppressed_bytes = 0;
+};
+
+}  // namespace audio_tools
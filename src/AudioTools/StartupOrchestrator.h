@@ -0,0 +1,267 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioConfig.h"
+#include "AudioTools/AudioLogger.h"
+#if defined(ESP32) || defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || \
+    defined(USE_STD_CONCURRENCY)
+#  include "Concurrency/WorkerPool.h"
+#  define USE_STARTUP_WORKERS
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Starts independent components in parallel to reduce the time to
+ * the first audio: e.g. Wi-Fi, the codec board (I2C), mounting the SD card
+ * and the decoder allocation do not depend on each other and can be started
+ * at the same time. Each step is a function which returns true on success:
+ * a step can depend on other steps (e.g. URLStream on Wi-Fi) and is only
+ * started when all its dependencies have succeeded.
+ *
+ * The required steps define the minimum chain: as soon as they are done the
+ * ready callback is called (e.g. to start the output), while the optional
+ * steps may still be running. The startup time of each step is recorded.
+ * @code
+ * StartupOrchestrator startup;
+ * int wifi = startup.add("wifi", []() { return connectWifi(); });
+ * int board = startup.addComponent("board", kit);
+ * int url = startup.addComponent("url", url_stream);
+ * startup.dependsOn(url, wifi);
+ * startup.setReadyCallback([]() { copier.begin(); });
+ * startup.begin(pool);
+ * startup.waitReady(5000);
+ * @endcode
+ * The dependencies must not be cyclic.
+ * If no WorkerPool is provided (or it is not available on the platform) the
+ * steps are executed one after the other in begin().
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class StartupOrchestrator {
+ public:
+  enum StepState { Pending, Running, Done, Failed };
+
+  StartupOrchestrator() = default;
+  ~StartupOrchestrator() {
+    waitAll();
+    for (auto p_step : steps) delete p_step;
+  }
+
+  /// Adds a startup step and returns its id
+  int add(const char *name, std::function<bool()> fn, bool required = true) {
+    Step *p_step = new Step();
+    p_step->name = name;
+    p_step->fn = fn;
+    p_step->is_required = required;
+    steps.push_back(p_step);
+    return steps.size() - 1;
+  }
+
+  /// Adds a step which calls begin() of the indicated object
+  template <class T>
+  int addComponent(const char *name, T &component, bool required = true) {
+    return add(name, [&component]() { return component.begin(); }, required);
+  }
+
+  /// The step is only started after the dependency has succeeded
+  bool dependsOn(int step, int dependency) {
+    if (!isValid(step) || !isValid(dependency) || step == dependency)
+      return false;
+    steps[step]->dependencies.push_back(dependency);
+    return true;
+  }
+
+  /// Callback which is called when all required steps have succeeded
+  void setReadyCallback(std::function<void()> cb) { ready_callback = cb; }
+
+#ifdef USE_STARTUP_WORKERS
+  /// Starts the steps w/o dependencies on the workers of the pool
+  bool begin(WorkerPool &pool) {
+    p_pool = &pool;
+    return start();
+  }
+#endif
+
+  /// Executes all steps sequentially in the order of their dependencies
+  bool begin() {
+#ifdef USE_STARTUP_WORKERS
+    p_pool = nullptr;
+#endif
+    return start();
+  }
+
+  /// Starts the steps whose dependencies are done and calls the ready
+  /// callback: call it in the loop or use waitReady()
+  void update() {
+    if (!is_active) return;
+    bool progress = true;
+    while (progress) {
+      progress = false;
+      for (int j = 0; j < (int)steps.size(); j++) {
+        Step &step = *steps[j];
+        if (step.state != Pending) continue;
+        int deps = dependencyState(step);
+        if (deps == Failed) {
+          LOGE("%s: dependency failed", step.name);
+          step.state = Failed;
+          progress = true;
+        } else if (deps == Done) {
+          run(step);
+          progress = true;
+        }
+      }
+    }
+    if (!is_ready_reported && isReady()) {
+      is_ready_reported = true;
+      ready_ms = millis() - start_ms;
+      LOGI("ready after %u ms", (unsigned)ready_ms);
+      if (ready_callback) ready_callback();
+    }
+  }
+
+  /// Calls update() until all required steps are done or failed: returns
+  /// true if they succeeded.
+  bool waitReady(uint32_t timeoutMs = 0xFFFFFFFF) {
+    uint32_t start = millis();
+    while (true) {
+      update();
+      if (isReady()) return true;
+      if (isRequiredFailed()) return false;
+      if (millis() - start >= timeoutMs) return false;
+      delay(1);
+    }
+  }
+
+  /// Calls update() until all steps have finished
+  void waitAll() {
+    while (is_active && !isFinished()) {
+      update();
+      delay(1);
+    }
+  }
+
+  /// True if all required steps have succeeded
+  bool isReady() {
+    for (auto p_step : steps) {
+      if (p_step->is_required && p_step->state != Done) return false;
+    }
+    return true;
+  }
+
+  /// True if a required step has failed
+  bool isRequiredFailed() {
+    for (auto p_step : steps) {
+      if (p_step->is_required && p_step->state == Failed) return true;
+    }
+    return false;
+  }
+
+  /// True if all steps have succeeded or failed
+  bool isFinished() {
+    for (auto p_step : steps) {
+      if (p_step->state == Pending || p_step->state == Running) return false;
+    }
+    return true;
+  }
+
+  /// State of the indicated step
+  StepState state(int step) { return (StepState)steps[step]->state.load(); }
+
+  /// Startup time of the indicated step in ms
+  uint32_t durationMs(int step) { return steps[step]->duration_ms; }
+
+  /// Time from begin() until the step was finished in ms
+  uint32_t finishedMs(int step) { return steps[step]->finished_ms; }
+
+  /// Time from begin() until all required steps were done in ms
+  uint32_t readyMs() { return ready_ms; }
+
+  /// Logs the startup time of all steps
+  void logTimes() {
+    for (auto p_step : steps) {
+      LOGI("%s: %s %u ms (finished after %u ms)", p_step->name,
+           p_step->state == Done ? "ok" : "failed",
+           (unsigned)p_step->duration_ms, (unsigned)p_step->finished_ms);
+    }
+  }
+
+ protected:
+  struct Step {
+    const char *name = nullptr;
+    std::function<bool()> fn;
+    Vector<int> dependencies{0};
+    bool is_required = true;
+    std::atomic<int> state{Pending};
+    uint32_t duration_ms = 0;
+    uint32_t finished_ms = 0;
+  };
+  Vector<Step *> steps{0};
+  std::function<void()> ready_callback;
+  uint32_t start_ms = 0;
+  uint32_t ready_ms = 0;
+  bool is_active = false;
+  bool is_ready_reported = false;
+#ifdef USE_STARTUP_WORKERS
+  WorkerPool *p_pool = nullptr;
+#endif
+
+  bool isValid(int step) { return step >= 0 && step < (int)steps.size(); }
+
+  bool start() {
+    for (auto p_step : steps) {
+      if (p_step->state == Running) {
+        LOGE("startup is still running");
+        return false;
+      }
+      p_step->state = Pending;
+      p_step->duration_ms = p_step->finished_ms = 0;
+    }
+    start_ms = millis();
+    ready_ms = 0;
+    is_ready_reported = false;
+    is_active = true;
+    update();
+    return !isRequiredFailed();
+  }
+
+  /// Done if all dependencies have succeeded, Failed if one has failed and
+  /// Pending otherwise
+  int dependencyState(Step &step) {
+    int result = Done;
+    for (auto dep : step.dependencies) {
+      int state = steps[dep]->state;
+      if (state == Failed) return Failed;
+      if (state != Done) result = Pending;
+    }
+    return result;
+  }
+
+  void run(Step &step) {
+    step.state = Running;
+    Step *p_step = &step;
+#ifdef USE_STARTUP_WORKERS
+    if (p_pool != nullptr &&
+        p_pool->submit([this, p_step]() { execute(*p_step); })) {
+      return;
+    }
+#endif
+    execute(*p_step);
+  }
+
+  void execute(Step &step) {
+    uint32_t start = millis();
+    bool ok = step.fn();
+    uint32_t end = millis();
+    step.duration_ms = end - start;
+    step.finished_ms = end - start_ms;
+    if (!ok) LOGE("%s: startup failed", step.name);
+    step.state = ok ? Done : Failed;
+  }
+};
+
+}  // namespace audio_tools
@@ -9,6 +9,16 @@
 
 #define NOT_ENOUGH_MEMORY_MSG "Could not allocate enough memory: %d bytes"
 
+/// Default min copy size in bytes of the adaptive mode
+#ifndef COPY_ADAPTIVE_MIN_SIZE
+#  define COPY_ADAPTIVE_MIN_SIZE 128
+#endif
+
+/// Default max copy size in bytes of the adaptive mode
+#ifndef COPY_ADAPTIVE_MAX_SIZE
+#  define COPY_ADAPTIVE_MAX_SIZE 4096
+#endif
+
 namespace audio_tools {
 
 /**
@@ -90,7 +100,9 @@ class StreamCopyT {
 
         /// copies the data from the source to the destination - the result is in bytes
         inline size_t copy() {
-            return copyBytes(buffer_size);
+            size_t result = is_adaptive ? copyAdaptive() : copyBytes(buffer_size);
+            updateStatistics(result);
+            return result;
         }
 
         /// copies the inicated number of bytes from the source to the destination - the result is in bytes
@@ -106,7 +118,7 @@ class StreamCopyT {
             // E.g. if we try to write to a server we might not have any output destination yet
             int to_write = to->availableForWrite();
             if (check_available_for_write && to_write==0){
-                 delay(500);
+                 if (!is_offline) delay(500);
                  return 0;
             }
 
@@ -126,7 +138,7 @@ class StreamCopyT {
             size_t bytes_read = 0; 
 
             if (len > 0){
-                bytes_to_read = min(len, static_cast<size_t>(buffer_size));
+                bytes_to_read = min(len, bytes);
                 // don't overflow buffer
                 if (to_write > 0){
                     bytes_to_read = min((int)bytes_to_read, to_write);
@@ -141,18 +153,37 @@ class StreamCopyT {
 
                 // get the data now
                 bytes_read = 0;
-                if (bytes_to_read>0){
+                const uint8_t *p_data = buffer.data();
+                const uint8_t *p_source = nullptr;
+                uint8_t *p_target = nullptr;
+                size_t direct_len = bytes_to_read;
+                if (bytes_to_read>0 && (p_source = sourceBufferPtr(direct_len)) != nullptr){
+                    // zero copy: we write directly from the memory of the source
+                    p_data = p_source;
+                    bytes_read = direct_len;
+                } else if (bytes_to_read>0 && (p_target = targetBufferPtr(direct_len)) != nullptr){
+                    // zero copy: we read directly into the memory of the target
+                    p_data = p_target;
+                    bytes_read = from->readBytes(p_target, direct_len);
+                } else if (bytes_to_read>0){
                     bytes_read = from->readBytes((uint8_t*)&buffer[0], bytes_to_read);
                 }
 
                 // determine mime
-                notifyMime(buffer.data(), bytes_to_read);
+                notifyMime((void*)p_data, bytes_read);
 
                 // write data
-                result = write(bytes_read, delayCount);
+                if (p_target != nullptr){
+                    result = p_to_provider->commitWriteBuffer(bytes_read);
+                } else {
+                    result = write(p_data, bytes_read, delayCount);
+                }
+                if (p_source != nullptr){
+                    from->bufferProvider()->consumeReadBuffer(result);
+                }
 
                 // callback with unconverted data
-                if (onWrite!=nullptr) onWrite(onWriteObj, &buffer[0], result);
+                if (onWrite!=nullptr) onWrite(onWriteObj, (void*)p_data, result);
 
                 #ifndef COPY_LOG_OFF
                 LOGI("StreamCopy::copy %s %u -> %u -> %u bytes - in %u hops",log_name, (unsigned int)bytes_to_read,(unsigned int) bytes_read, (unsigned int)result, (unsigned int)delayCount);
@@ -162,14 +193,14 @@ class StreamCopyT {
                 if (result == 0){
                     TRACED();
                     // give the processor some time 
-                    delay(delay_on_no_data);
+                    delayOnNoData();
                 }
 
                 //TRACED();
                 CHECK_MEMORY();
             } else {
                 // give the processor some time 
-                delay(delay_on_no_data);
+                delayOnNoData();
                 LOGD("no data %s", log_name);
             }
             //TRACED();
@@ -233,7 +264,7 @@ class StreamCopyT {
                 if (count==0){
                     // wait for more data
                     retry++;
-                    delay(retryWaitMs);
+                    if (!is_offline) delay(retryWaitMs);
                 } else {
                     retry = 0; // after we got new data we restart the counting
                 }
@@ -298,6 +329,12 @@ class StreamCopyT {
             return check_available;
         }
 
+        /// Defines the allocator for the copy buffer (hot by default)
+        void setAllocator(Allocator &allocator){
+            buffer.setAllocator(allocator);
+            resize(buffer_size);
+        }
+
         /// resizes the copy buffer
         void resize(int len){
             buffer_size = len;
@@ -343,10 +380,81 @@ class StreamCopyT {
             is_sync_audio_info = active;
         }
 
+        /// Use the memory of the source or target directly if they support a
+        /// BufferProvider (active by default)
+        void setZeroCopy(bool active){
+            is_zero_copy = active;
+        }
+
+        /// Offline (batch) processing which runs faster than real time: we do
+        /// not wait when there is no data or when the target is full and we
+        /// use a big copy buffer. Use this e.g. to convert files on the desktop.
+        void setOffline(bool flag, int bufferSize = BATCH_BUFFER_SIZE){
+            is_offline = flag;
+            if (flag){
+                delay_on_no_data = 0;
+                retry_delay = 0;
+                check_available_for_write = false;
+                if (buffer_size < bufferSize) resize(bufferSize);
+            } else {
+                delay_on_no_data = COPY_DELAY_ON_NODATA;
+                retry_delay = 10;
+            }
+        }
+
+        /// Is the offline (batch) processing active ?
+        bool isOffline() {
+            return is_offline;
+        }
+
+        /// Adaptive mode: the size of each copy is determined from the
+        /// available() of the source and the availableForWrite() of the target
+        /// and limited by maxSize and the (optional) max latency in ms. We wait
+        /// until at least minSize bytes are available unless the source does not
+        /// provide any more data. If there is no data we just yield instead of
+        /// using a fixed delay.
+        void setAdaptive(bool active, int minSize = COPY_ADAPTIVE_MIN_SIZE,
+                         int maxSize = COPY_ADAPTIVE_MAX_SIZE,
+                         int maxLatencyMs = 0){
+            is_adaptive = active;
+            adaptive_min_size = minSize;
+            adaptive_max_size = maxSize;
+            adaptive_latency_ms = maxLatencyMs;
+            if (active && buffer_size < maxSize) resize(maxSize);
+        }
+
+        /// Is the adaptive mode active ?
+        bool isAdaptive() {
+            return is_adaptive;
+        }
+
+        /// Defines the function which is called in the adaptive mode when there
+        /// is no data: e.g. to wait for a task notification. By default we yield.
+        void setYieldCallback(void (*callback)()){
+            yield_callback = callback;
+        }
+
+        /// Average number of bytes per copy() which provided data in the last
+        /// second
+        int effectiveBlockSize() {
+            return effective_block_size;
+        }
+
+        /// Number of copy() calls which provided data in the last second
+        int copiesPerSecond() {
+            return copies_per_second;
+        }
+
+        /// Defines the BufferProvider of the target: this is set automatically
+        /// if the target is an AudioStream or AudioOutput
+        void setTargetBufferProvider(BufferProvider *provider){
+            p_to_provider = provider;
+        }
+
     protected:
         AudioStream *from = nullptr;
         Print *to = nullptr;
-        Vector<uint8_t> buffer{0};
+        Vector<uint8_t> buffer{0, HotAllocator};
         int buffer_size;
         void (*onWrite)(void*obj, void*buffer, size_t len) = nullptr;
         void (*notifyMimeCallback)(const char*mime) = nullptr;
@@ -364,7 +472,114 @@ class StreamCopyT {
         int channels = 0;
         int min_copy_size = 1;
         bool is_sync_audio_info = false;
+        bool is_zero_copy = true;
+        bool is_offline = false;
         AudioInfoSupport *p_audio_info_support = nullptr;
+        BufferProvider *p_to_provider = nullptr;
+        bool is_adaptive = false;
+        int adaptive_min_size = COPY_ADAPTIVE_MIN_SIZE;
+        int adaptive_max_size = COPY_ADAPTIVE_MAX_SIZE;
+        int adaptive_latency_ms = 0;
+        int last_adaptive_size = 0;
+        void (*yield_callback)() = nullptr;
+        uint32_t statistics_start_ms = 0;
+        uint32_t statistics_copies = 0;
+        uint32_t statistics_bytes = 0;
+        int effective_block_size = 0;
+        int copies_per_second = 0;
+
+        /// give the processor some time if there is no data
+        void delayOnNoData(){
+            if (is_adaptive) {
+                yieldOnNoData();
+                return;
+            }
+            if (delay_on_no_data > 0) delay(delay_on_no_data);
+        }
+
+        void yieldOnNoData(){
+            if (yield_callback != nullptr) {
+                yield_callback();
+                return;
+            }
+        #ifdef ARDUINO
+            yield();
+        #else
+            delay(0);
+        #endif
+        }
+
+        /// Copies the size which is determined from the source and target
+        size_t copyAdaptive(){
+            if (!active || from == nullptr || to == nullptr) return 0;
+            int size = adaptiveSize();
+            if (size <= 0){
+                yieldOnNoData();
+                return 0;
+            }
+            return copyBytes(size);
+        }
+
+        /// Determines the copy size in the adaptive mode: 0 if we need to wait
+        int adaptiveSize(){
+            int len = check_available ? available() : adaptive_max_size;
+            int to_write = to->availableForWrite();
+            if (check_available_for_write && to_write == 0) return 0;
+            if (to_write > 0) len = min(len, to_write);
+            len = min(len, adaptive_max_size);
+            if (adaptive_latency_ms > 0){
+                int latency_bytes = AudioTime::toBytes(adaptive_latency_ms, from->audioInfoOut());
+                if (latency_bytes > 0) len = min(len, latency_bytes);
+            }
+            len = toFrames(len);
+            // wait for more data as long as the available data is growing
+            if (len > 0 && len < adaptive_min_size && len != last_adaptive_size){
+                last_adaptive_size = len;
+                return 0;
+            }
+            last_adaptive_size = len;
+            return len;
+        }
+
+        /// Determines the effective block size and the copies per second
+        void updateStatistics(size_t bytes){
+            if (bytes > 0){
+                statistics_copies++;
+                statistics_bytes += bytes;
+            }
+            uint32_t now = millis();
+            uint32_t elapsed = now - statistics_start_ms;
+            if (elapsed >= 1000){
+                copies_per_second = statistics_copies * 1000 / elapsed;
+                effective_block_size = statistics_copies > 0 ? statistics_bytes / statistics_copies : 0;
+                statistics_copies = 0;
+                statistics_bytes = 0;
+                statistics_start_ms = now;
+            }
+        }
+
+        /// Rounds the length to full frames
+        size_t toFrames(size_t len){
+            int copy_size = minCopySize();
+            return copy_size > 0 ? len / copy_size * copy_size : len;
+        }
+
+        /// Provides the memory of the source for a zero copy write (or nullptr)
+        const uint8_t *sourceBufferPtr(size_t &len){
+            BufferProvider *p_provider = is_zero_copy ? from->bufferProvider() : nullptr;
+            if (p_provider == nullptr) return nullptr;
+            const uint8_t *result = p_provider->readBufferPtr(len);
+            len = toFrames(len);
+            return len > 0 ? result : nullptr;
+        }
+
+        /// Provides the memory of the target for a zero copy read (or nullptr)
+        uint8_t *targetBufferPtr(size_t &len){
+            if (!is_zero_copy || p_to_provider == nullptr) return nullptr;
+            uint8_t *result = p_to_provider->writeBufferPtr(len);
+            len = toFrames(len);
+            return len > 0 ? result : nullptr;
+        }
 
         void syncAudioInfo(){
             // synchronize audio info
@@ -380,13 +595,19 @@ class StreamCopyT {
 
         /// blocking write - until everything is processed
         size_t write(size_t len, size_t &delayCount ){
-            if (!buffer || len==0) return 0;
+            if (!buffer) return 0;
+            return write((const uint8_t*)buffer.data(), len, delayCount);
+        }
+
+        /// blocking write of the indicated data - until everything is processed
+        size_t write(const uint8_t *data, size_t len, size_t &delayCount ){
+            if (data == nullptr || len==0) return 0;
             LOGD("write: %d", (int)len);
             size_t total = 0;
             long open = len;
             int retry = 0;
             while(open > 0){
-                size_t written = to->write((const uint8_t*)buffer.data()+total, open);
+                size_t written = to->write(data+total, open);
                 LOGD("write: %d -> %d", (int) open, (int) written);
                 total += written;
                 open -= written;
@@ -404,7 +625,7 @@ class StreamCopyT {
                     
                     // wait a bit
                     if (retry>1) {
-                        delay(retry_delay);
+                        if (retry_delay > 0) delay(retry_delay);
                         LOGI("try write %s - %d (open %ld bytes) ",log_name, retry, open);
                     }
                 }
@@ -450,11 +671,13 @@ class StreamCopy : public StreamCopyT<uint8_t> {
         StreamCopy(AudioStream &to, AudioStream &from, int buffer_size=DEFAULT_BUFFER_SIZE) : StreamCopyT<uint8_t>(to, from, buffer_size){
              TRACED();
              p_audio_info_support = &to;
+             p_to_provider = to.bufferProvider();
         }
 
         StreamCopy(AudioOutput &to, AudioStream &from, int buffer_size=DEFAULT_BUFFER_SIZE) : StreamCopyT<uint8_t>(to, from, buffer_size){
              TRACED();
              p_audio_info_support = &to;
+             p_to_provider = to.bufferProvider();
         }
 
         StreamCopy(Print &to, AudioStream &from, int buffer_size=DEFAULT_BUFFER_SIZE) : StreamCopyT<uint8_t>(to, from, buffer_size){
@@ -482,15 +705,15 @@ class StreamCopy : public StreamCopyT<uint8_t> {
                 // callback with unconverted data
                 if (onWrite!=nullptr) onWrite(onWriteObj, buffer.data(), result);
 
-                // convert data
-                coverter_ptr->convert((uint8_t*)buffer.data(),  result );
-                write(result, delayCount);
+                // convert data: the converter might change the size
+                size_t converted = coverter_ptr->convert((uint8_t*)buffer.data(),  result );
+                if (converted > 0) write(converted, delayCount);
                 #ifndef COPY_LOG_OFF
                     LOGI("StreamCopy::copy %u bytes - in %u hops", (unsigned int)result,(unsigned int) delayCount);
                 #endif
             } else {
                 // give the processor some time 
-                delay(delay_on_no_data);
+                delayOnNoData();
             }
             return result;
         }
@@ -1,5 +1,10 @@
 #pragma once
 
+/// Number of segments of the precalculated volume curves
+#ifndef VOLUME_CURVE_POINTS
+#  define VOLUME_CURVE_POINTS 64
+#endif
+
 /**
  * @defgroup volume Volume
  * @ingroup dsp
@@ -70,6 +75,46 @@ class CachedVolumeControl : public VolumeControl {
 };
 
 
+/**
+ * @brief Abstract class for volume controls with a calculation which is
+ * expensive (e.g. pow or log): The curve is calculated only once with
+ * VOLUME_CURVE_POINTS segments and the factor is determined with a table
+ * lookup and a linear interpolation. So continuous volume changes are cheap.
+ * @ingroup volume
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TableVolumeControl : public VolumeControl {
+    public:
+        /// determines a multiplication factor (0.0 to 1.0) from an input value (0.0 to 1.0).
+        virtual float getVolumeFactor(float volume) {
+            if (!is_table_valid) setupTable();
+            if (volume <= 0.0f) return table[0];
+            if (volume >= 1.0f) return table[VOLUME_CURVE_POINTS];
+            float pos = volume * VOLUME_CURVE_POINTS;
+            int idx = (int)pos;
+            float frac = pos - idx;
+            return table[idx] + (table[idx + 1] - table[idx]) * frac;
+        }
+
+    protected:
+        float table[VOLUME_CURVE_POINTS + 1];
+        bool is_table_valid = false;
+
+        /// calculates the exact factor for the indicated input value
+        virtual float calculateVolumeFactor(float volume) = 0;
+
+        /// Call this method when the parameters of the curve have changed
+        void invalidateTable() { is_table_valid = false; }
+
+        void setupTable() {
+            for (int j = 0; j <= VOLUME_CURVE_POINTS; j++) {
+                table[j] = limit(calculateVolumeFactor((float)j / VOLUME_CURVE_POINTS));
+            }
+            is_table_valid = true;
+        }
+};
+
 /**
  * @brief Parametric Logarithmic volume control. Using the formula pow(b,input) * a - a, where b is b = pow(((1/ym)-1), 2) and a is a = 1.0 / (b - 1.0). 
  * The parameter ym is determining the steepness.
@@ -78,22 +123,28 @@ class CachedVolumeControl : public VolumeControl {
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
-class LogarithmicVolumeControl : public VolumeControl {
+class LogarithmicVolumeControl : public TableVolumeControl {
     public:
         LogarithmicVolumeControl(float ym=0.1){
             this->ym = ym;
         }
 
+        /// Defines the steepness
+        void setYm(float ym){
+            this->ym = ym;
+            invalidateTable();
+        }
+
+    protected:
+        float ym;
+
         // provides a factor in the range of 0.0 to 1.0
-        virtual float getVolumeFactor(float input) {
+        virtual float calculateVolumeFactor(float input) {
             float b = pow(((1/ym)-1), 2);
             float a = 1.0f / (b - 1.0f);
             float volumeFactor = pow(b,input) * a - a;
-            return limit(volumeFactor);
+            return volumeFactor;
         }
-
-    protected:
-        float ym;
 };
 
 /**
@@ -102,12 +153,12 @@ class LogarithmicVolumeControl : public VolumeControl {
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
-class ExponentialVolumeControl : public VolumeControl {
-    public:
+class ExponentialVolumeControl : public TableVolumeControl {
+    protected:
         // provides a factor in the range of 0.0 to 1.0
-        virtual float getVolumeFactor(float volume) {
+        virtual float calculateVolumeFactor(float volume) {
             float volumeFactor = pow(2.0, volume) - 1.0;
-            return limit(volumeFactor);
+            return volumeFactor;
         }
 };
 
@@ -120,23 +171,29 @@ class ExponentialVolumeControl : public VolumeControl {
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
-class SimulatedAudioPot : public VolumeControl {
+class SimulatedAudioPot : public TableVolumeControl {
     public:
         SimulatedAudioPot(float x=0.5, float y=0.1){
+            setPoint(x, y);
+        }
+        /// Defines the point (x,y) where the slow raising part ends
+        void setPoint(float x, float y){
             this->x = x;
             this->y = y;
+            invalidateTable();
         }
-        virtual float getVolumeFactor(float volume) {
+    protected:
+        float x, y;
+
+        virtual float calculateVolumeFactor(float volume) {
             float result = 0;
             if (volume<=x){
                 result = mapFloat(volume, 0.0, x, 0, y );
             } else {
                 result = mapFloat(volume, x, 1.0, y, 1.0);
             }
-            return limit(result);
+            return result;
         }
-    protected:
-        float x, y;
 };
 
 /**
@@ -4,6 +4,12 @@
 #include "AudioTools/AudioOutput.h"
 #include "AudioTools/VolumeControl.h"
 #include "AudioTools/AudioTypes.h"
+#include "AudioTools/AudioKernels.h"
+
+/// Number of frames which are processed with the same gain during a volume ramp
+#ifndef VOLUME_RAMP_BLOCK_FRAMES
+#  define VOLUME_RAMP_BLOCK_FRAMES 32
+#endif
 
 namespace audio_tools {
 
@@ -19,6 +25,8 @@ struct VolumeStreamConfig : public AudioInfo {
   }
   bool allow_boost = false;
   float volume=1.0;  // start_volume
+  /// volume changes are ramped over the indicated number of frames (0 = immediate)
+  int ramp_frames = 0;
 };
 
 
@@ -118,6 +126,11 @@ class VolumeStream : public ModifyingStream, public VolumeSupport {
         }
 
 
+        /// Defines the number of frames over which a volume change is ramped to avoid zipper noise
+        void setVolumeRamp(int frames){
+            info.ramp_frames = frames;
+        }
+
         /// Defines the volume control logic
         void setVolumeControl(VolumeControl &vc){
             cached_volume.setVolumeControl(vc);
@@ -200,13 +213,10 @@ class VolumeStream : public ModifyingStream, public VolumeSupport {
                 float factor = volumeControl().getVolumeFactor(volume_value);
                 volume_values[channel]=volume_value;
                 #if PREFER_FIXEDPOINT
-                    //convert float to fixed point 2.6
-                    //Fixedpoint-Math from https://github.com/earlephilhower/ESP8266Audio/blob/0abcf71012f6128d52a6bcd155ed1404d6cc6dcd/src/AudioOutput.h#L67
-                    if(factor > 4.0) factor = 4.0;//factor can only be >1 if allow_boost == true TODO: should we update volume_values[channel] if factor got clipped to 4.0?
-                    uint8_t factorF2P6 = (uint8_t) (factor*(1<<6));
-                    factor_for_channel[channel] = factorF2P6;
+                    //convert float to fixed point Q16.16
+                    setTargetFactor(channel, AudioKernels::toGainQ16(factor));
                 #else
-                    factor_for_channel[channel]=factor;
+                    setTargetFactor(channel, factor);
                 #endif
               }
               return true;
@@ -243,18 +253,23 @@ class VolumeStream : public ModifyingStream, public VolumeSupport {
         CachedVolumeControl cached_volume{pot_vc};
         Vector<float> volume_values;
         #if PREFER_FIXEDPOINT
-            Vector<uint8_t> factor_for_channel; //Fixed point 2.6
+            typedef int32_t gain_t; //Fixed point Q16.16
         #else
-            Vector<float> factor_for_channel;
+            typedef float gain_t;
         #endif
+        // actual, target and step per block of the ramp
+        Vector<gain_t> factor_for_channel;
+        Vector<gain_t> target_for_channel;
+        Vector<gain_t> step_for_channel;
+        Vector<int> ramp_blocks;
+        int ramping_channels = 0;
         bool is_started = false;
-        float max_value = 32767; // max value for clipping
         int max_channels = 0;
 
         // checks if volume needs to be updated
         bool isVolumeUpdate(){
             if (!is_started) return false;
-            if (isAllChannelsFullVolume()) return false;
+            if (ramping_channels == 0 && isAllChannelsFullVolume()) return false;
             return true;
         }
 
@@ -268,7 +283,43 @@ class VolumeStream : public ModifyingStream, public VolumeSupport {
         /// Resizes the vectors
         void setupVectors() {
             factor_for_channel.resize(info.channels);
+            target_for_channel.resize(info.channels);
+            step_for_channel.resize(info.channels);
+            ramp_blocks.resize(info.channels);
             volume_values.resize(info.channels);
+            ramping_channels = 0;
+            for (int ch = 0; ch < info.channels; ch++){
+                if (ramp_blocks[ch] > 0) ramping_channels++;
+            }
+        }
+
+        /// Defines the new factor: it is either applied immediately or ramped
+        void setTargetFactor(int channel, gain_t factor){
+            int blocks = info.ramp_frames / VOLUME_RAMP_BLOCK_FRAMES;
+            if (ramp_blocks[channel] > 0) ramping_channels--;
+            target_for_channel[channel] = factor;
+            if (!is_started || blocks == 0 || factor == factor_for_channel[channel]){
+                factor_for_channel[channel] = factor;
+                ramp_blocks[channel] = 0;
+                return;
+            }
+            step_for_channel[channel] = (factor - factor_for_channel[channel]) / blocks;
+            ramp_blocks[channel] = blocks;
+            ramping_channels++;
+        }
+
+        /// Moves the ramping factors one block ahead
+        void updateRamp(){
+            for (int ch = 0; ch < info.channels; ch++){
+                if (ramp_blocks[ch] > 0){
+                    if (--ramp_blocks[ch] == 0){
+                        factor_for_channel[ch] = target_for_channel[ch];
+                        ramping_channels--;
+                    } else {
+                        factor_for_channel[ch] += step_for_channel[ch];
+                    }
+                }
+            }
         }
 
         /// Provides a VolumeStreamConfig based on a AudioInfo
@@ -279,13 +330,14 @@ class VolumeStream : public ModifyingStream, public VolumeSupport {
             cfg1.bits_per_sample = cfg.bits_per_sample;
             // keep volume which might habe been defined befor calling begin
             cfg1.volume = info.volume;  
+            cfg1.allow_boost = info.allow_boost;
+            cfg1.ramp_frames = info.ramp_frames;
             return cfg1;
         }
 
         /// Stores the local variable and calculates some max values
         void setupVolumeStreamConfig(VolumeStreamConfig cfg){
             info = cfg;
-            max_value = NumberConverter::maxValue(info.bits_per_sample);
             if (info.channels>max_channels){
               max_channels = info.channels;
             }
@@ -305,15 +357,8 @@ class VolumeStream : public ModifyingStream, public VolumeSupport {
             return cached_volume;
         }
 
-        #if PREFER_FIXEDPOINT
-        uint8_t factorForChannel(int channel){
-        #else
-        float factorForChannel(int channel){
-        #endif
-            return factor_for_channel.size()==0? 1.0 : factor_for_channel[channel];
-        }
-
         void applyVolume(const uint8_t *buffer, size_t size){
+            if (factor_for_channel.size() < info.channels) return;
             switch(info.bits_per_sample){
                 case 16:
                     applyVolume16((int16_t*)buffer, size/2);
@@ -329,50 +374,33 @@ class VolumeStream : public ModifyingStream, public VolumeSupport {
             }
         }
 
-        void applyVolume16(int16_t* data, size_t size){
-            for (size_t j=0;j<size;j++){
-                #if PREFER_FIXEDPOINT
-                int32_t result = (data[j] * factorForChannel(j%info.channels)) >> 6; //Fixedpoint-Math from https://github.com/earlephilhower/ESP8266Audio/blob/0abcf71012f6128d52a6bcd155ed1404d6cc6dcd/src/AudioOutput.h#L67
-                #else
-                float result = factorForChannel(j%info.channels) * data[j];
-                #endif
-                if (!info.allow_boost){
-                    if (result>max_value) result = max_value;
-                    if (result<-max_value) result = -max_value;
-                } 
-                data[j]= static_cast<int16_t>(result);
+        /// scales the samples with the shared gain and saturate primitive: during
+        /// a ramp the gains are updated for each block of VOLUME_RAMP_BLOCK_FRAMES
+        template <typename T>
+        void applyVolumeT(T* data, size_t size){
+            size_t block = VOLUME_RAMP_BLOCK_FRAMES * info.channels;
+            while (ramping_channels > 0 && size > 0){
+                size_t n = min(block, size);
+                updateRamp();
+                AudioKernels::applyGain(data, n, info.channels, factor_for_channel.data());
+                data += n;
+                size -= n;
+            }
+            if (size > 0) {
+                AudioKernels::applyGain(data, size, info.channels, factor_for_channel.data());
             }
         }
 
+        void applyVolume16(int16_t* data, size_t size){
+            applyVolumeT(data, size);
+        }
+
         void applyVolume24(int24_t* data, size_t size) {
-            for (size_t j=0;j<size;j++){
-                #if PREFER_FIXEDPOINT
-                int32_t result = (data[j] * factorForChannel(j%info.channels)) >> 6; //8bits * 24bits = fits into 32
-                #else
-                float result = factorForChannel(j%info.channels) * data[j];
-                #endif
-                if (!info.allow_boost){
-                    if (result>max_value) result = max_value;
-                    if (result<-max_value) result = -max_value;
-                } 
-                int32_t result1 = result;
-                data[j]= static_cast<int24_t>(result1);
-            }
+            applyVolumeT(data, size);
         }
 
         void applyVolume32(int32_t* data, size_t size) {
-            for (size_t j=0;j<size;j++){
-                #if PREFER_FIXEDPOINT
-                int64_t result = (static_cast<int64_t>(data[j]) * static_cast<int64_t>(factorForChannel(j%info.channels))) >> 6;
-                #else
-                float result = factorForChannel(j%info.channels) * data[j];
-                #endif
-                if (!info.allow_boost){
-                    if (result>max_value) result = max_value;
-                    if (result<-max_value) result = -max_value;
-                } 
-                data[j]= static_cast<int32_t>(result);
-            }
+            applyVolumeT(data, size);
         }
 };
 
@@ -6,11 +6,25 @@
 #include "AudioBasic/Str.h"
 #include "AudioCodecs/AudioEncoded.h"
 
+/// Max number of data blocks which can be sent w/o acknowledgment
+#ifndef AUDIO_SYNC_WINDOW
+#  define AUDIO_SYNC_WINDOW 8
+#endif
+
+/// Max number of payload bytes of a data block
+#ifndef AUDIO_SYNC_BLOCK_SIZE
+#  define AUDIO_SYNC_BLOCK_SIZE 512
+#endif
+
+/// Retransmit timeout in ms until we have a measured round trip time
+#ifndef AUDIO_SYNC_INITIAL_RTO_MS
+#  define AUDIO_SYNC_INITIAL_RTO_MS 200
+#endif
 
 namespace audio_tools {
 
 
-enum class RecordType : uint8_t { Undefined, Begin, Send, Receive, End };
+enum class RecordType : uint8_t { Undefined, Begin, Send, Receive, End, Ack };
 enum class AudioType : uint8_t { PCM, MP3, AAC, WAV, ADPC };
 enum class TransmitRole : uint8_t { Sender, Receiver };
 
@@ -34,7 +48,8 @@ struct AudioDataBegin : public AudioHeader {
   AudioType type = AudioType::PCM;
 };
 
-/// Protocol Record for Data
+/// Protocol Record for Data: seq is the block number which starts with 0
+/// after the AudioDataBegin
 struct AudioSendData : public AudioHeader {
   AudioSendData() {
     rec = RecordType::Send;
@@ -53,10 +68,46 @@ struct AudioDataEnd : public AudioHeader {
   AudioDataEnd() { rec = RecordType::End; }
 };
 
+/// Protocol Record for the acknowledgment of data blocks: all blocks before
+/// next_seq have been received (cumulative) and bit n of the mask reports
+/// the block next_seq + 1 + n (selective). The window is the number of
+/// outstanding blocks which the receiver accepts.
+struct AudioAckData : public AudioHeader {
+  AudioAckData() { rec = RecordType::Ack; }
+  uint16_t next_seq = 0;
+  uint16_t window = 0;
+  uint32_t mask = 0;
+};
+
+/// Compares 16 bit sequence numbers with wrap around: result < 0 if a is
+/// before b
+inline int audioSyncSeqDiff(uint16_t a, uint16_t b) {
+  return (int16_t)(uint16_t)(a - b);
+}
+
+/// The window is a power of 2, so that the slots do not collide when the
+/// sequence numbers wrap around: the acknowledgment mask supports 32 blocks
+inline int audioSyncWindow(int blocks) {
+  int result = 1;
+  while (result * 2 <= blocks && result < 32) result *= 2;
+  return result;
+}
 
 /**
  * @brief Audio Writer which is synchronizing the amount of data
- * that can be processed with the AudioReceiver
+ * that can be processed with the AudioReceiver. We use a sliding window:
+ * up to AUDIO_SYNC_WINDOW blocks can be sent before they are acknowledged,
+ * so that the throughput is not limited by the round trip time of the link
+ * (e.g. ESP-NOW or UDP). The receiver acknowledges the blocks cumulatively
+ * and selectively: blocks which are not acknowledged within the
+ * retransmit timeout (derived from the measured round trip time) are sent
+ * again and 3 duplicate acknowledgments trigger a fast retransmit.
+ * The number of outstanding blocks is limited by a congestion window
+ * (additive increase, multiplicative decrease on losses) and by the
+ * window which is reported by the receiver.
+ *
+ * Each block is sent with one write() to the destination, so that it
+ * fits into one packet if the block size is small enough.
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
@@ -64,8 +115,26 @@ class AudioSyncWriter : public AudioOutput {
  public:
   AudioSyncWriter(Stream &dest) { p_dest = &dest; }
 
+  /// Defines the max payload of a block: call before begin()
+  void setBlockSize(int size) { block_size = size; }
+
+  /// Defines the max number of outstanding blocks (a power of 2 up to 32):
+  /// call before begin()
+  void setWindowSize(int blocks) { window_size = audioSyncWindow(blocks); }
+
   bool begin(AudioInfo &info, AudioType type) {
     is_sync = true;
+    packet_size = sizeof(AudioSendData) + block_size;
+    packets.resize(window_size * packet_size);
+    slots.resize(window_size);
+    for (auto &slot : slots) slot = Slot();
+    base_seq = next_seq = 0;
+    cwnd = 1.0f;
+    peer_window = window_size;
+    dup_acks = 0;
+    srtt_ms = 0;
+    rto_ms = AUDIO_SYNC_INITIAL_RTO_MS;
+    retransmit_count = 0;
     AudioDataBegin begin;
     begin.info = info;
     begin.type = type;
@@ -75,58 +144,205 @@ class AudioSyncWriter : public AudioOutput {
     return len == write_len;
   }
 
+  /// Sends the data in blocks: blocks if the window is full
   size_t write(const uint8_t *data, size_t len) override {
-    int written_len = 0;
-    int open_len = len;
-    AudioSendData send;
+    size_t written_len = 0;
     while (written_len < len) {
-      int available_to_write = waitForRequest();
-      size_t to_write_len = DEFAULT_BUFFER_SIZE;
-      to_write_len = min(open_len, available_to_write);
-      send.increment();
-      send.size = to_write_len;
-      p_dest->write((const uint8_t *)&send, sizeof(send));
-      int w = p_dest->write(data + written_len, to_write_len);
-      written_len += w;
-      open_len -= w;
+      while (!canSend()) {
+        update();
+        if (!canSend()) delay(1);
+      }
+      int to_write_len = min((int)(len - written_len), block_size);
+      sendBlock(data + written_len, to_write_len);
+      written_len += to_write_len;
+      update();
     }
     return written_len;
   }
 
-  int availableForWrite() override { return available_to_write; }
+  /// Free space of the window in bytes
+  int availableForWrite() override {
+    return canSend() ? (sendWindow() - outstanding()) * block_size : 0;
+  }
+
+  /// Processes the acknowledgments and retransmits the blocks which have
+  /// timed out: call it regularly if you do not write
+  void update() {
+    readAcks();
+    checkTimeouts();
+  }
+
+  /// Waits until all blocks have been acknowledged
+  bool flush(uint32_t timeoutMs = 5000) {
+    uint32_t start = millis();
+    while (outstanding() > 0) {
+      update();
+      if (millis() - start > timeoutMs) return false;
+      delay(1);
+    }
+    return true;
+  }
 
   void end() {
+    flush();
     AudioDataEnd end;
     end.increment();
     p_dest->write((const uint8_t *)&end, sizeof(end));
   }
 
+  /// Number of blocks which have been sent but not acknowledged
+  int outstanding() { return (uint16_t)(next_seq - base_seq); }
+
+  /// Actual congestion window in blocks
+  float congestionWindow() { return cwnd; }
+
+  /// Smoothed round trip time in ms
+  uint32_t roundTripMs() { return srtt_ms; }
+
+  /// Number of retransmitted blocks
+  uint32_t retransmits() { return retransmit_count; }
+
  protected:
+  struct Slot {
+    uint32_t sent_ms = 0;
+    uint16_t len = 0;
+    bool is_acked = false;
+    bool is_retransmitted = false;
+  };
   Stream *p_dest;
-  int available_to_write = 1024;
   bool is_sync;
+  int block_size = AUDIO_SYNC_BLOCK_SIZE;
+  int window_size = AUDIO_SYNC_WINDOW;
+  int packet_size = 0;
+  Vector<uint8_t> packets{0};
+  Vector<Slot> slots{0};
+  uint16_t base_seq = 0;
+  uint16_t next_seq = 0;
+  float cwnd = 1.0f;
+  int peer_window = AUDIO_SYNC_WINDOW;
+  int dup_acks = 0;
+  uint32_t srtt_ms = 0;
+  uint32_t rto_ms = AUDIO_SYNC_INITIAL_RTO_MS;
+  uint32_t retransmit_count = 0;
 
-  /// Waits for the data to be available
-  void waitFor(int size) {
-    while (p_dest->available() < size) {
-      delay(10);
+  /// Effective window: min of the configured, congestion and receiver window
+  int sendWindow() {
+    int result = min(window_size, (int)cwnd);
+    result = min(result, peer_window);
+    return max(result, 1);
+  }
+
+  bool canSend() { return outstanding() < sendWindow(); }
+
+  Slot &slot(uint16_t seq) { return slots[seq % window_size]; }
+
+  uint8_t *packet(uint16_t seq) {
+    return packets.data() + (seq % window_size) * packet_size;
+  }
+
+  void sendBlock(const uint8_t *data, int len) {
+    uint16_t seq = next_seq++;
+    AudioSendData send;
+    send.seq = seq;
+    send.size = len;
+    uint8_t *p_packet = packet(seq);
+    memcpy(p_packet, &send, sizeof(send));
+    memcpy(p_packet + sizeof(send), data, len);
+    Slot &s = slot(seq);
+    s.len = len;
+    s.is_acked = false;
+    s.is_retransmitted = false;
+    transmit(seq);
+  }
+
+  void transmit(uint16_t seq) {
+    Slot &s = slot(seq);
+    s.sent_ms = millis();
+    p_dest->write(packet(seq), sizeof(AudioSendData) + s.len);
+  }
+
+  void retransmit(uint16_t seq) {
+    slot(seq).is_retransmitted = true;
+    retransmit_count++;
+    transmit(seq);
+  }
+
+  void readAcks() {
+    AudioAckData ack;
+    while (p_dest->available() >= (int)sizeof(ack)) {
+      if (p_dest->readBytes((uint8_t *)&ack, sizeof(ack)) != sizeof(ack))
+        break;
+      if (ack.rec == RecordType::Ack) processAck(ack);
+    }
+  }
+
+  void processAck(AudioAckData &ack) {
+    peer_window = ack.window;
+    int acked = audioSyncSeqDiff(ack.next_seq, base_seq);
+    if (acked > outstanding()) return;  // invalid or old session
+    if (acked > 0) {
+      // cumulative acknowledgment: measure the rtt w/o retransmissions
+      Slot &last = slot(ack.next_seq - 1);
+      if (!last.is_retransmitted) updateRTT(millis() - last.sent_ms);
+      for (int j = 0; j < acked; j++) {
+        // additive increase: one block per window
+        cwnd += 1.0f / cwnd;
+      }
+      if (cwnd > window_size) cwnd = window_size;
+      base_seq = ack.next_seq;
+      dup_acks = 0;
+    } else if (acked == 0 && outstanding() > 0) {
+      if (++dup_acks == 3) {
+        // fast retransmit of the missing block
+        onLoss();
+        retransmit(base_seq);
+      }
+    }
+    // selective acknowledgments
+    for (int j = 0; j < 32; j++) {
+      if ((ack.mask & (1UL << j)) == 0) continue;
+      uint16_t seq = ack.next_seq + 1 + j;
+      if (audioSyncSeqDiff(seq, next_seq) >= 0) break;
+      slot(seq).is_acked = true;
+    }
+  }
+
+  void checkTimeouts() {
+    uint32_t now = millis();
+    bool is_loss = false;
+    for (uint16_t seq = base_seq; seq != next_seq; seq++) {
+      Slot &s = slot(seq);
+      if (s.is_acked || now - s.sent_ms < rto_ms) continue;
+      is_loss = true;
+      retransmit(seq);
+    }
+    if (is_loss) {
+      onLoss();
+      // back off until we get a new rtt measurement
+      rto_ms = min(rto_ms * 2, (uint32_t)2000);
     }
   }
 
-  int waitForRequest() {
-    AudioConfirmDataToReceive rcv;
-    size_t rcv_len = sizeof(rcv);
-    waitFor(rcv_len);
-    p_dest->readBytes((uint8_t *)&rcv, rcv_len);
-    return rcv.size;
+  /// Multiplicative decrease
+  void onLoss() {
+    cwnd = max(cwnd / 2.0f, 1.0f);
+    dup_acks = 0;
+  }
+
+  void updateRTT(uint32_t rtt) {
+    srtt_ms = srtt_ms == 0 ? rtt : (7 * srtt_ms + rtt) / 8;
+    rto_ms = max(2 * srtt_ms + 10, (uint32_t)20);
   }
 };
 
 /**
- * @brief Receving Audio Data over the wire and requesting for more data when
- * done to synchronize the processing with the sender. The audio data is
- * processed by the EncodedAudioStream; If you have multiple readers, only one
- * receiver should be used as confirmer!
+ * @brief Receving Audio Data over the wire and acknowledging the received
+ * blocks to synchronize the processing with the sender. Blocks which arrive
+ * out of order are kept until the missing blocks have been received, so
+ * that the audio data is written in order to the EncodedAudioStream. If the
+ * output can not accept a full block, the window in the acknowledgments
+ * is reduced to 1 block. If you have multiple readers, only one receiver should be used
+ * as confirmer!
  * @author Phil Schatzmann
  * @copyright GPLv3
  */
@@ -139,11 +355,18 @@ class AudioSyncReader : public AudioStream {
     is_confirmer = isConfirmer;
   }
 
+  /// Defines the max payload of a block: must match the writer
+  void setBlockSize(int size) { block_size = size; }
+
+  /// Defines the number of blocks which can be received out of order (a
+  /// power of 2 up to 32)
+  void setWindowSize(int blocks) { window_size = audioSyncWindow(blocks); }
+
   size_t copy() {
     int processed = 0;
     int header_size = sizeof(header);
     waitFor(header_size);
-    readBytes((uint8_t *)&header, header_size);
+    p_in->readBytes((uint8_t *)&header, header_size);
 
     switch (header.rec) {
       case RecordType::Begin:
@@ -155,6 +378,8 @@ class AudioSyncReader : public AudioStream {
       case RecordType::Send:
         processed = receiveData();
         break;
+      default:
+        break;
     }
     return processed;
   }
@@ -162,20 +387,27 @@ class AudioSyncReader : public AudioStream {
  protected:
   Stream *p_in;
   EncodedAudioStream *p_out;
-  AudioConfirmDataToReceive req;
   AudioHeader header;
   AudioDataBegin begin;
-  size_t available = 0;  // initial value
-  bool is_started = false;
   bool is_confirmer;
-  int last_seq = 0;
+  int block_size = AUDIO_SYNC_BLOCK_SIZE;
+  int window_size = AUDIO_SYNC_WINDOW;
+  uint16_t expected_seq = 0;
+  Vector<uint8_t> blocks{0};
+  Vector<uint16_t> block_len{0};
+  Vector<bool> is_received{0};
 
   /// Starts the processing
   void audioDataBegin() {
     readProtocol(&begin, sizeof(begin));
+    blocks.resize(window_size * block_size);
+    block_len.resize(window_size);
+    is_received.resize(window_size);
+    for (int j = 0; j < window_size; j++) is_received[j] = false;
+    expected_seq = 0;
     p_out->begin();
     p_out->setAudioInfo(begin.info);
-    requestData();
+    sendAck();
   }
 
   /// Ends the processing
@@ -189,22 +421,46 @@ class AudioSyncReader : public AudioStream {
   int receiveData() {
     AudioSendData data;
     readProtocol(&data, sizeof(data));
-    available = data.size;
-    // receive and process audio data
-    waitFor(available);
-    int max_gap = 10;
-    if (data.seq > last_seq ||
-        (data.seq < max_gap && last_seq >= (32767 - max_gap))) {
-      uint8_t buffer[available];
-      p_in->readBytes((uint8_t *)buffer, available);
-      p_out->write((const uint8_t *)buffer, available);
-      // only one reader should be used as confirmer
-      if (is_confirmer) {
-        requestData();
-      }
-      last_seq = data.seq;
+    int len = data.size;
+    waitFor(len);
+    if (len > block_size || blocks.size() == 0) {
+      LOGE("Invalid block size: %d", len);
+      skip(len);
+      return 0;
+    }
+    int diff = audioSyncSeqDiff(data.seq, expected_seq);
+    if (diff < 0 || diff >= window_size) {
+      // duplicate or outside of the window: acknowledge again
+      skip(len);
+      sendAck();
+      return 0;
+    }
+    int idx = data.seq % window_size;
+    p_in->readBytes(blocks.data() + idx * block_size, len);
+    block_len[idx] = len;
+    is_received[idx] = true;
+
+    // output all blocks which are in order
+    int processed = 0;
+    while (is_received[expected_seq % window_size]) {
+      int pos = expected_seq % window_size;
+      p_out->write(blocks.data() + pos * block_size, block_len[pos]);
+      processed += block_len[pos];
+      is_received[pos] = false;
+      expected_seq++;
+    }
+    sendAck();
+    return processed;
+  }
+
+  /// Discards the indicated number of bytes
+  void skip(int len) {
+    uint8_t tmp[64];
+    while (len > 0) {
+      int n = p_in->readBytes(tmp, min(len, 64));
+      if (n <= 0) break;
+      len -= n;
     }
-    return available;
   }
 
   /// Waits for the data to be available
@@ -214,11 +470,20 @@ class AudioSyncReader : public AudioStream {
     }
   }
 
-  /// Request new data from writer
-  void requestData() {
-    req.size = p_out->availableForWrite();
-    req.increment();
-    p_in->write((const uint8_t *)&req, sizeof(req));
+  /// Acknowledges the received blocks: only one reader should be used as
+  /// confirmer
+  void sendAck() {
+    if (!is_confirmer) return;
+    AudioAckData ack;
+    ack.next_seq = expected_seq;
+    for (int j = 0; j < window_size - 1; j++) {
+      if (is_received[(uint16_t)(expected_seq + 1 + j) % window_size])
+        ack.mask |= 1UL << j;
+    }
+    // flow control: we slow down to 1 block if the output is full
+    ack.window = p_out->availableForWrite() >= block_size ? window_size : 1;
+    ack.increment();
+    p_in->write((const uint8_t *)&ack, sizeof(ack));
     p_in->flush();
   }
 
@@ -228,7 +493,7 @@ class AudioSyncReader : public AudioStream {
     memcpy(data, &header, header_size);
     int read_size = len - header_size;
     waitFor(read_size);
-    readBytes((uint8_t *)data + header_size, read_size);
+    p_in->readBytes((uint8_t *)data + header_size, read_size);
   }
 };
 
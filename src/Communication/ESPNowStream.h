@@ -2,9 +2,13 @@
 #include <WiFiUdp.h>
 #include <esp_now.h>
 
+#include <atomic>
+
 #include "AudioTools/BaseStream.h"
+#include "AudioTools/SilenceDetector.h"
 #include "AudioBasic/Str.h"
-#include "AudioTools/Buffers.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "Concurrency/QueueLockFree.h"
 
 
 namespace audio_tools {
@@ -33,6 +37,30 @@ class Lock {
 
 
 
+/**
+ * @brief Optional header which is sent at the beginning of each ESP-NOW packet
+ * to detect lost packets
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct ESPNowPacketHeader {
+  uint16_t seq = 0;
+  uint16_t len = 0;
+};
+
+/// Flag in the length of the packet header which marks a silent packet
+#define ESP_NOW_SILENCE_FLAG 0x8000
+
+/**
+ * @brief Receive slot for a single ESP-NOW packet
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+struct ESPNowPacket {
+  uint8_t data[ESP_NOW_MAX_DATA_LEN];
+  uint16_t len = 0;
+};
+
 /**
  * @brief Configuration for ESP-NOW protocolö.W
  * @author Phil Schatzmann
@@ -47,8 +75,16 @@ struct ESPNowStreamConfig {
   bool use_send_ack = true;  // we wait for
   uint16_t delay_after_write_ms = 2;
   uint16_t delay_after_failed_write_ms = 2000;
+  /// max time in ms we wait for the send confirmation
+  uint16_t send_ack_timeout_ms = 200;
   uint16_t buffer_size = ESP_NOW_MAX_DATA_LEN;
+  /// number of preallocated receive packet slots
   uint16_t buffer_count = 400;
+  /// collect the written data until the packet is full (or flush() is called)
+  bool use_batching = false;
+  /// add a ESPNowPacketHeader with a sequence number to each packet: this
+  /// must be the same on the sender and receiver
+  bool use_header = false;
   int write_retry_count = -1; // -1 endless
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
   void (*recveive_cb)(const esp_now_recv_info *info, const uint8_t *data,
@@ -75,7 +111,7 @@ class ESPNowStream : public BaseStream {
   ESPNowStream() { ESPNowStreamSelf = this; };
 
   ~ESPNowStream() {
-    if (p_buffer != nullptr) delete p_buffer;
+    if (send_semaphore != nullptr) vSemaphoreDelete(send_semaphore);
   }
 
   ESPNowStreamConfig defaultConfig() {
@@ -92,6 +128,12 @@ class ESPNowStream : public BaseStream {
   /// Defines an alternative send callback
   void setSendCallback(esp_now_send_cb_t cb) { send = cb; }
 
+  /// Suppresses the sending of the audio data which is identified as silent:
+  /// with use_header only the header is sent, otherwise nothing
+  void setSilenceDetector(SilenceDetector &detector) {
+    p_silence = &detector;
+  }
+
   /// Defines the Receive Callback - Deactivates the readBytes and available()
   /// methods!
   void setReceiveCallback(esp_now_recv_cb_t cb) { receive = cb; }
@@ -145,6 +187,7 @@ class ESPNowStream : public BaseStream {
 
   /// DeInitialization
   void end() {
+    flush();
     if (esp_now_deinit() != ESP_OK) {
       LOGE("esp_now_deinit");
     }
@@ -205,87 +248,213 @@ class ESPNowStream : public BaseStream {
     return addPeer(peer);
   }
 
-  /// Writes the data - sends it to all the peers
+  /// Writes the data - sends it to all the peers. With use_batching the last
+  /// partial packet is only sent with the next write() or flush().
   size_t write(const uint8_t *data, size_t len) override {
-    int open = len;
     size_t result = 0;
-    int retry_count = 0;
-    while (open > 0) {
-      if (available_to_write > 0) {
-        resetAvailableToWrite();
-        size_t send_len = min(open, ESP_NOW_MAX_DATA_LEN);
-        esp_err_t rc = esp_now_send(nullptr, data + result, send_len);
-        // wait for confirmation
-        if (cfg.use_send_ack) {
-          while (available_to_write == 0) {
-            delay(1);
-          }
-        } else {
-          is_write_ok = true;
-        }
-        // check status
-        if (rc == ESP_OK && is_write_ok) {
-          open -= send_len;
-          result += send_len;
-        } else {
-          LOGW("Write failed - retrying again");
-          retry_count++;
-          if (cfg.write_retry_count>0 && retry_count>=cfg.write_retry_count){
-            LOGE("Write error after %d retries", cfg.write_retry_count);
-            // break loop
-            return 0;
-          }
-        }
-        // if we do have no partner to write we stall and retry later
-      } else {
-        delay(cfg.delay_after_write_ms);
-      }
-
-      // Wait some time before we retry
-      if (!is_write_ok) {
-        delay(cfg.delay_after_failed_write_ms);
-      }
+    while (result < len) {
+      size_t copy = min(len - result, payloadSize() - tx_len);
+      memcpy(tx_packet + headerSize() + tx_len, data + result, copy);
+      tx_len += copy;
+      result += copy;
+      if (tx_len >= payloadSize() && !sendPacket()) return 0;
     }
+    if (!cfg.use_batching) flush();
     return result;
   }
 
+  /// Sends the collected partial packet
+  void flush() override {
+    if (tx_len > 0) sendPacket();
+  }
+
   /// Reeds the data from the peers
   size_t readBytes(uint8_t *data, size_t len) override {
-    if (p_buffer == nullptr) return 0;
-    Lock lock(write_lock);
-    return p_buffer->readArray(data, len);
+    size_t result = 0;
+    while (result < len && nextPacket()) {
+      ESPNowPacket &packet = packets[read_slot];
+      size_t copy = min(len - result, (size_t)(packet.len - read_pos));
+      memcpy(data + result, packet.data + read_pos, copy);
+      read_pos += copy;
+      result += copy;
+      if (read_pos >= packet.len) releasePacket();
+    }
+    rx_available -= result;
+    return result;
   }
 
-  int available() override {
-    return p_buffer == nullptr ? 0 : p_buffer->available();
-  }
+  int available() override { return rx_available; }
 
-  int availableForWrite() override {
-    return cfg.use_send_ack ? available_to_write : cfg.buffer_size;
-  }
+  int availableForWrite() override { return cfg.buffer_size; }
+
+  /// Number of sent packets
+  uint32_t packetsSent() { return packets_sent; }
+
+  /// Number of packets for which the audio data was suppressed
+  uint32_t suppressedPackets() { return suppressed_packets; }
+
+  /// Number of received packets
+  uint32_t packetsReceived() { return packets_received; }
+
+  /// Number of received packets which were dropped because all slots were
+  /// used
+  uint32_t droppedPackets() { return dropped_packets; }
+
+  /// Number of missing packets detected by the sequence number (use_header)
+  uint32_t lostPackets() { return lost_packets; }
 
  protected:
   ESPNowStreamConfig cfg;
-  BaseBuffer<uint8_t> *p_buffer = nullptr;
   esp_now_recv_cb_t receive = default_recv_cb;
   esp_now_send_cb_t send = default_send_cb;
-  volatile size_t available_to_write;
   bool is_init = false;
-  bool is_write_ok = false;
-  _lock_t write_lock;
-
-  inline void setupReceiveBuffer(){
-    // setup receive buffer
-    if (p_buffer == nullptr && cfg.buffer_count > 0) {
-      // p_buffer = new NBuffer<uint8_t>(cfg.buffer_size , cfg.buffer_count);
-      p_buffer = new RingBuffer<uint8_t>(cfg.buffer_size * cfg.buffer_count);
+  volatile bool is_write_ok = false;
+  // send side
+  SemaphoreHandle_t send_semaphore = nullptr;
+  uint8_t tx_packet[ESP_NOW_MAX_DATA_LEN];
+  size_t tx_len = 0;
+  uint16_t tx_seq = 0;
+  uint32_t packets_sent = 0;
+  uint32_t suppressed_packets = 0;
+  SilenceDetector *p_silence = nullptr;
+  // receive side: the callback takes a free slot, fills it and puts it into
+  // the filled queue w/o locking
+  Vector<ESPNowPacket> packets;
+  QueueLockFree<uint16_t> free_slots{1};
+  QueueLockFree<uint16_t> filled_slots{1};
+  std::atomic<int> rx_available{0};
+  int read_slot = -1;
+  int read_pos = 0;
+  uint16_t rx_seq = 0;
+  bool is_first_packet = true;
+  volatile uint32_t packets_received = 0;
+  volatile uint32_t dropped_packets = 0;
+  volatile uint32_t lost_packets = 0;
+
+  /// Preallocates the receive slots
+  void setupReceiveBuffer() {
+    if (packets.size() > 0 || cfg.buffer_count == 0) return;
+    packets.resize(cfg.buffer_count);
+    free_slots.resize(cfg.buffer_count);
+    filled_slots.resize(cfg.buffer_count);
+    for (uint16_t j = 0; j < cfg.buffer_count; j++) free_slots.enqueue(j);
+  }
+
+  size_t headerSize() { return cfg.use_header ? sizeof(ESPNowPacketHeader) : 0; }
+
+  size_t payloadSize() {
+    size_t max_len = ESP_NOW_MAX_DATA_LEN - headerSize();
+    return cfg.buffer_size > 0 && cfg.buffer_size < max_len ? cfg.buffer_size
+                                                            : max_len;
+  }
+
+  /// Sends the tx_packet: with use_send_ack we wait for the send callback
+  bool sendPacket() {
+    size_t send_len = tx_len + headerSize();
+    bool is_silent = p_silence != nullptr &&
+                     p_silence->update(tx_packet + headerSize(), tx_len);
+    if (is_silent) {
+      suppressed_packets++;
+      if (!cfg.use_header) {
+        tx_len = 0;
+        return true;
+      }
+      // the header is sufficient to play the silence
+      send_len = headerSize();
+    }
+    if (cfg.use_header) {
+      ESPNowPacketHeader header;
+      header.seq = tx_seq;
+      header.len = tx_len;
+      if (is_silent) header.len |= ESP_NOW_SILENCE_FLAG;
+      memcpy(tx_packet, &header, sizeof(header));
     }
+    int retry_count = 0;
+    while (true) {
+      // clear a late confirmation of a timed out packet
+      if (cfg.use_send_ack) xSemaphoreTake(send_semaphore, 0);
+      esp_err_t rc = esp_now_send(nullptr, tx_packet, send_len);
+      if (rc == ESP_OK && cfg.use_send_ack) {
+        if (xSemaphoreTake(send_semaphore,
+                           pdMS_TO_TICKS(cfg.send_ack_timeout_ms)) != pdTRUE) {
+          LOGW("No send confirmation");
+          is_write_ok = false;
+        }
+      } else {
+        is_write_ok = rc == ESP_OK;
+      }
+      if (is_write_ok) break;
+
+      LOGW("Write failed - retrying again");
+      retry_count++;
+      if (cfg.write_retry_count > 0 && retry_count >= cfg.write_retry_count) {
+        LOGE("Write error after %d retries", cfg.write_retry_count);
+        tx_len = 0;
+        return false;
+      }
+      // Wait some time before we retry
+      delay(cfg.delay_after_failed_write_ms);
+    }
+    packets_sent++;
+    tx_seq++;
+    tx_len = 0;
+    return true;
   }
 
-  inline void resetAvailableToWrite() {
-    if (cfg.use_send_ack) {
-      available_to_write = 0;
+  /// Makes sure that we have a current packet to read from
+  bool nextPacket() {
+    if (read_slot >= 0) return true;
+    uint16_t idx;
+    if (!filled_slots.dequeue(idx)) return false;
+    read_slot = idx;
+    read_pos = 0;
+    return true;
+  }
+
+  /// Gives the completely read packet back to the free slots
+  void releasePacket() {
+    free_slots.enqueue(read_slot);
+    read_slot = -1;
+    read_pos = 0;
+  }
+
+  /// Called from the receive callback: must not block
+  void receivePacket(const uint8_t *data, int data_len) {
+    if (packets.size() == 0) return;
+    if (cfg.use_header) {
+      ESPNowPacketHeader header;
+      if (data_len < (int)sizeof(header)) return;
+      memcpy(&header, data, sizeof(header));
+      data += sizeof(header);
+      data_len -= sizeof(header);
+      if (header.len & ESP_NOW_SILENCE_FLAG) {
+        // silent packet: data == nullptr
+        data = nullptr;
+        data_len = header.len & ~ESP_NOW_SILENCE_FLAG;
+        if (data_len > ESP_NOW_MAX_DATA_LEN) data_len = ESP_NOW_MAX_DATA_LEN;
+      } else if (header.len < data_len) {
+        data_len = header.len;
+      }
+      if (!is_first_packet) lost_packets += (uint16_t)(header.seq - rx_seq);
+      rx_seq = header.seq + 1;
+      is_first_packet = false;
+    }
+    if (data_len <= 0) return;
+    packets_received++;
+    uint16_t idx;
+    if (!free_slots.dequeue(idx)) {
+      dropped_packets++;
+      return;
     }
+    ESPNowPacket &packet = packets[idx];
+    if (data == nullptr) {
+      memset(packet.data, 0, data_len);
+    } else {
+      memcpy(packet.data, data, data_len);
+    }
+    packet.len = data_len;
+    rx_available += data_len;
+    filled_slots.enqueue(idx);
   }
 
   bool isEncrypted() {
@@ -326,12 +495,13 @@ class ESPNowStream : public BaseStream {
     if (cfg.recveive_cb != nullptr) {
       esp_now_register_recv_cb(cfg.recveive_cb);
     } else {
+      setupReceiveBuffer();
       esp_now_register_recv_cb(receive);
     }
     if (cfg.use_send_ack) {
+      if (send_semaphore == nullptr) send_semaphore = xSemaphoreCreateBinary();
       esp_now_register_send_cb(send);
     }
-    available_to_write = cfg.buffer_size;
     is_init = result == ESP_OK;
     return is_init;
   }
@@ -350,29 +520,13 @@ class ESPNowStream : public BaseStream {
     return (const char *)macStr;
   }
 
-  static int bufferAvailableForWrite() {
-    Lock lock(ESPNowStreamSelf->write_lock);
-    return ESPNowStreamSelf->p_buffer->availableForWrite();
-  }
-
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
   static void default_recv_cb(const esp_now_recv_info *info, const uint8_t *data, int data_len)
 #else
   static void default_recv_cb(const uint8_t *mac_addr, const uint8_t *data, int data_len)
 #endif
 {
-    LOGD("rec_cb: %d", data_len);
-    // make sure that the receive buffer is available - moved from begin to make sure that it is only allocated when needed
-    ESPNowStreamSelf->setupReceiveBuffer();
-    // blocking write
-    while (bufferAvailableForWrite() < data_len) {
-      delay(2);
-    }
-    Lock lock(ESPNowStreamSelf->write_lock);
-    size_t result = ESPNowStreamSelf->p_buffer->writeArray(data, data_len);
-    if (result!=data_len){
-      LOGE("writeArray %d -> %d", data_len, result);
-    }
+    ESPNowStreamSelf->receivePacket(data, data_len);
   }
 
   static void default_send_cb(const uint8_t *mac_addr,
@@ -388,12 +542,8 @@ class ESPNowStream : public BaseStream {
 
     // ignore others
     if (strncmp((char *)mac_addr, (char *)first_mac, ESP_NOW_KEY_LEN) == 0) {
-      ESPNowStreamSelf->available_to_write = ESPNowStreamSelf->cfg.buffer_size;
-      if (status == ESP_NOW_SEND_SUCCESS) {
-        ESPNowStreamSelf->is_write_ok = true;
-      } else {
-        ESPNowStreamSelf->is_write_ok = false;
-      }
+      ESPNowStreamSelf->is_write_ok = status == ESP_NOW_SEND_SUCCESS;
+      xSemaphoreGive(ESPNowStreamSelf->send_semaphore);
     }
   }
 };
@@ -5,25 +5,36 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <math.h>
 #include <string.h>
 
 namespace audio_tools {
 
+/// Integer log2 which can be evaluated at compile time
+constexpr int hammingLog2(int value) {
+    return value <= 1 ? 0 : 1 + hammingLog2(value / 2);
+}
+
 /**
- * @brief Hamming forware error correction. Inspired by
+ * @brief Hamming forware error correction (extended Hamming code which can
+ * correct single and detect double bit errors in each block_t). Inspired by
  * https://github.com/nasserkessas/hamming-codes
- * 
+ *
  * Hamming<1024,uint16_t> hamming; // block_ts of 1k with block_tsize 16bits = 31.25% redundency
- * 
+ *
  * Block size (bits)	Redundant bits	Redundancy percentage
  * 4	3	75%
  * 8	4	50%
  * 16	5	31.25%
  * 32	6	18.75%
  * 64	7	10.94%
- * 
+ *
+ * The bit positions are precalculated and the syndrome is determined with a
+ * lookup table per byte of the block_t, so we do not need to process each bit
+ * of a block_t separately. All code words of a frame are processed with one
+ * call.
  * @ingroup fec
+ * @author Phil Schatzmann
+ * @copyright GPLv3
 */
 
 template <int bytecount, class block_t>
@@ -32,22 +43,33 @@ class HammingFEC : public BaseStream {
     HammingFEC(Stream &stream){
         p_stream = &stream;
         p_print = &stream;
+        setupTables();
     }
 
     HammingFEC(Print &print){
         p_print = &print;
+        setupTables();
     }
 
     int availableForWrite() override {
         return bytecount;
     }
-    
+
     size_t write(const uint8_t* data, size_t len)override{
         if (p_print==nullptr) return 0;
-        for (int j=0;j<len;j++){
-            raw.write(data[j]);
+        size_t pos = 0;
+        while (pos < len) {
+            // encode complete frames w/o copying them to the raw buffer
+            if (raw.isEmpty() && len - pos >= bytecount) {
+                encode(data + pos);
+                pos += bytecount;
+                continue;
+            }
+            size_t copy = min(len - pos, (size_t)raw.availableForWrite());
+            raw.writeArray(data + pos, copy);
+            pos += copy;
             if(raw.availableForWrite()==0){
-                encode(raw.data(), raw.size());
+                encode(raw.data());
                 raw.reset();
             }
         }
@@ -60,257 +82,157 @@ class HammingFEC : public BaseStream {
 
     size_t readBytes(uint8_t* data, size_t len)override{
         if (p_stream==nullptr) return 0;
-        if (encoded.isEmpty()){
+        if (raw.isEmpty()){
+            raw.reset();
             // read encoded data from surce
-            p_stream->readBytes(encoded.data(), encodedSize());
-            encoded.setAvailable(encodedSize());
+            if (readFully(encoded.address(), encodedSize()) != encodedSize())
+                return 0;
             // decode data
-            if(decode((block_t*)encoded.data(), bytecount)){
-                raw.setAvailable(bytecount);
+            if(!decode((block_t*)encoded.address(), raw.address())){
+                LOGW("Hamming: more than one error detected");
             }
+            raw.setAvailable(bytecount);
         }
         return raw.readArray(data, len);
     }
 
   protected:
+    /// Amount of bits in a block_t
+    static constexpr int bits = sizeof(block_t) * 8;
+    /// Amount of bits per block_t used to carry the message
+    static constexpr int messageBits = bits - hammingLog2(bits) - 1;
+    /// Amount of block_ts needed to encode a frame
+    static constexpr int blocks = (bytecount * 8 + messageBits - 1) / messageBits;
+
     SingleBuffer<uint8_t> raw{bytecount};
     SingleBuffer<uint8_t> encoded{encodedSize()};
     Stream* p_stream = nullptr;
     Print* p_print = nullptr;
-
-    int getBlocks(){
-        // Amount of bits in a block_t //
-        int bits = sizeof(block_t) * 8;
-
-        // Amount of bits per block_t used to carry the message //
-        int messageBits = bits - log2(bits) - 1;
-
-        // Amount of block_ts needed to encode message //
-        int block_ts = ceil((float) bytecount / messageBits);
-
-        return block_ts;
-    } 
-
-    int encodedSize(){
-        return getBlocks()+1*sizeof(block_t);
-    }
-   
-    int encode(uint8_t *input, int len) {
-
-        // Amount of bits in a block_t //
-        int bits = sizeof(block_t) * 8;
-
-        // Amount of bits per block_t used to carry the message //
-        int messageBits = bits - log2(bits) - 1;
-
-        // Amount of block_ts needed to encode message //
-        int block_ts = ceil((float) len / messageBits);
-
-        // Array of encoded block_ts //
-        block_t encoded[block_ts+1];
-
-        // Loop through each block_t //
-        for (int i = 0; i < block_ts+1; i++) {
-
-            // Final encoded block_t variable //
-            block_t thisBlock = 0;
-            
-            // Amount of "skipped" bits (used for parity) //
-            int skipped = 0;
-
-            // Count of how many bits are "on" //
-            int onCount = 0;
-            
-            // Array of "on" bits //
-            int onList[bits];
-
-            // Loop through each message bit in this block_t to populate final block_t //
-            for (int j = 0; j < bits; j++) {
-
-                // Skip bit if reserved for parity bit //
-                if ((j & (j - 1)) == 0) { // Check if j is a power of two or 0
-                    skipped++;
-                    continue;
-                }
-
-                bool thisBit;
-                
-                if (i != block_ts) {
-
-                    // Current overall bit number //
-                    int currentBit = i*messageBits + (j-skipped);
-                    
-                    // Current uint8_tacter //
-                    int currentChar = currentBit/(sizeof(uint8_t)*8); // int division
-                    
-                    // Value of current bit //
-                    thisBit = currentBit < len*sizeof(uint8_t)*8 ? getCharBit(input[currentChar], currentBit-currentChar*8) : 0;
-                }
-
-                else {
-                    thisBit = getBit(len/8, j-skipped+(sizeof(block_t)*8-messageBits));
-                }
-
-            // If bit is "on", add to onList and onCount //
-                if (thisBit) {
-                    onList[onCount] = j;
-                    onCount++;
-                }
-                
-                // Populate final message block_t //
-                thisBlock = modifyBit(thisBlock, j, thisBit);
-            }
-
-            // Calculate values of parity bits //
-            block_t parityBits = multipleXor(onList, onCount);
-
-            // Loop through skipped bits (parity bits) //
-            for (int k = 1; k < skipped; k++) { // skip bit 0
-
-                // If bit is "on", add to onCount
-                if (getBit(parityBits, sizeof(block_t)*8-skipped+k)) {
-                    onCount++;
-                }
-
-                // Add parity bit to final block_t //
-                thisBlock = modifyBit(thisBlock, (int) pow(2, skipped-k-1) , getBit(parityBits, sizeof(block_t)*8-skipped+k));
-            }
-
-            // Add overall parity bit (total parity of onCount) //
-            thisBlock = modifyBit(thisBlock, 0, onCount & 1);
-
-            // Add block_t to encoded block_ts //
-            encoded[i] = thisBlock;
-        }
-        
-        // Write encoded message to file /
-        return p_print->write((const uint8_t*)encoded, sizeof(block_t)*block_ts+1);
-    }
-
-    bool decode(block_t input[], int len) {
-        uint8_t* output = (uint8_t*)raw.data();
-        
-        // Amount of bits in a block_t //
-        int bits = sizeof(block_t) * 8;
-
-        for (int b = 0; b < (len/sizeof(block_t)); b++) {
-
-            // Count of how many bits are "on" //
-            int onCount = 0;
-            
-            // Array of "on" bits //
-            int onList[bits];
-
-            // Populate onCount and onList //
-            for (int i = 1; i < bits; i++) {
-                getBit(input[b], i);
-                if (getBit(input[b], i)) {
-                    onList[onCount] = i;
-                    onCount++;
-                }
-            }
-
-            // Check for single errors //
-            int errorLoc = multipleXor(onList, onCount);
-
-            if (errorLoc) {
-                
-                // Check for multiple errors //
-                if (!(onCount & 1 ^ getBit(input[b], 0))) { // last bit of onCount (total parity) XOR first bit of block_t (parity bit)
-                    LOGE("\nMore than one error detected. Aborting.\n");
-                    return false;
-                }
-                
-                // Flip error bit //
-                else {
-                    input[b] = toggleBit(input[b], (bits-1) - errorLoc);
-                                    }
-            }
+    /// Bit positions which carry the message
+    uint8_t data_pos[messageBits];
+    /// XOR of the positions of the set bits for each byte of a block_t
+    uint8_t syndrome_table[sizeof(block_t)][256];
+
+    static constexpr int encodedSize() { return blocks * sizeof(block_t); }
+
+    /// Bit positions are counted from the most significant bit
+    static block_t mask(int pos) { return (block_t)1 << (bits - 1 - pos); }
+
+    void setupTables() {
+        int idx = 0;
+        for (int j = 0; j < bits; j++) {
+            // Skip bit if reserved for parity bit (power of two or 0)
+            if ((j & (j - 1)) == 0) continue;
+            data_pos[idx++] = j;
         }
-
-        // Amount of bits per block_t used to carry the message //
-        int messageBits = bits - log2(bits) - 1;
-
-        int currentBit, currentChar;
-
-        int uint8_ts = 0;
-
-        for (int i = 0; i < len/sizeof(block_t); i++) {
-
-            // Initialise variable to store amount of parity bits passed //
-            int skipped = 0;
-
-            // Loop through each message bit in this block_t to populate final block_t //
-            for (int j = 0; j < bits; j++) {
-
-                // Skip bit if reserved for parity bit //
-                if ((j & (j - 1)) == 0) { // Check if j is a power of two or 0
-                    skipped++;
-                    continue;
-                }
-
-                // Current overall bit number //
-                currentBit = i*messageBits + (j-skipped);
-
-                // Current uint8_tacter //
-                currentChar = currentBit/(sizeof(uint8_t)*8); // int division
-
-                // Value of current bit //
-                bool thisBit = getBit(input[i], j);
-
-                if (i != len/sizeof(block_t)-1) {
-                
-                    // Populate final decoded uint8_tacter //
-                    output[currentChar] = modifyCharBit(output[currentChar], currentBit-currentChar*sizeof(uint8_t)*8, thisBit);
+        for (int k = 0; k < (int)sizeof(block_t); k++) {
+            for (int value = 0; value < 256; value++) {
+                uint8_t syndrome = 0;
+                for (int b = 0; b < 8; b++) {
+                    if (value & (1 << b)) syndrome ^= bits - 1 - (k * 8 + b);
                 }
-
-                else {
-                    uint8_ts = modifyBit(uint8_ts, j-skipped+(sizeof(block_t)*8-messageBits), thisBit);
-                }
-
+                syndrome_table[k][value] = syndrome;
             }
         }
-
-
-        return uint8_ts;
     }
 
-    int multipleXor(int *indicies, int len) {
-        int val = indicies[0];
-        for (int i = 1; i < len; i++) {
-            val = val ^ indicies[i];
+    /// XOR of the positions of all bits which are on
+    uint8_t syndrome(block_t block) {
+        uint8_t result = 0;
+        for (int k = 0; k < (int)sizeof(block_t); k++) {
+            result ^= syndrome_table[k][(block >> (k * 8)) & 0xFF];
         }
-        return val;
+        return result;
     }
 
-    block_t modifyBit(block_t n, int p, bool b) {
-        return ((n & ~(1 << (sizeof(block_t)*8-1-p))) | (b << (sizeof(block_t)*8-1-p)));
-    }
-
-    uint8_t modifyCharBit(uint8_t n, int p, bool b) {
-        return ((n & ~(1 << (sizeof(uint8_t)*8-1-p))) | (b << (sizeof(uint8_t)*8-1-p)));
-    }
-
-    bool getBit(block_t b, int i) {
-        return (b << i) & (int) pow(2, (sizeof(block_t)*8-1));
+    /// Returns true if an odd number of bits is on
+    static bool parity(block_t block) {
+        for (int shift = bits / 2; shift > 0; shift >>= 1) {
+            block ^= block >> shift;
+        }
+        return block & 1;
     }
 
-    bool getCharBit(uint8_t b, int i) {
-        return (b << i) & (int) pow(2, (sizeof(uint8_t)*8-1));
+    /// Distributes the message bits and adds the parity bits
+    block_t encodeBlock(uint64_t value) {
+        block_t block = 0;
+        for (int j = 0; j < messageBits; j++) {
+            if ((value >> (messageBits - 1 - j)) & 1) block |= mask(data_pos[j]);
+        }
+        // set the parity bits so that the syndrome gets 0
+        uint8_t parity_bits = syndrome(block);
+        for (int k = 1; k < bits; k <<= 1) {
+            if (parity_bits & k) block |= mask(k);
+        }
+        // add overall parity bit
+        if (parity(block)) block |= mask(0);
+        return block;
     }
 
-    block_t toggleBit(block_t b, int i) {
-        return b ^ (1 << i);
+    /// Collects the message bits
+    uint64_t decodeBlock(block_t block) {
+        uint64_t result = 0;
+        for (int j = 0; j < messageBits; j++) {
+            result = (result << 1) | ((block & mask(data_pos[j])) ? 1 : 0);
+        }
+        return result;
+    }
+
+    size_t encode(const uint8_t *input) {
+        block_t *output = (block_t *)encoded.address();
+        uint64_t bit_buffer = 0;
+        int bit_count = 0;
+        int input_pos = 0;
+        for (int i = 0; i < blocks; i++) {
+            while (bit_count < messageBits) {
+                uint8_t value = input_pos < bytecount ? input[input_pos] : 0;
+                bit_buffer = (bit_buffer << 8) | value;
+                input_pos++;
+                bit_count += 8;
+            }
+            bit_count -= messageBits;
+            uint64_t value = bit_buffer >> bit_count;
+            output[i] = encodeBlock(value & ((1ULL << messageBits) - 1));
+        }
+        return p_print->write(encoded.address(), encodedSize());
+    }
+
+    bool decode(block_t input[], uint8_t *output) {
+        bool result = true;
+        uint64_t bit_buffer = 0;
+        int bit_count = 0;
+        int output_pos = 0;
+        for (int i = 0; i < blocks; i++) {
+            block_t block = input[i];
+            uint8_t error_pos = syndrome(block);
+            if (error_pos != 0) {
+                // Check for multiple errors: the total parity must be odd
+                if (!parity(block)) {
+                    result = false;
+                } else {
+                    // Flip error bit
+                    block ^= mask(error_pos);
+                }
+            }
+            bit_buffer = (bit_buffer << messageBits) | decodeBlock(block);
+            bit_count += messageBits;
+            while (bit_count >= 8 && output_pos < bytecount) {
+                bit_count -= 8;
+                output[output_pos++] = bit_buffer >> bit_count;
+            }
+        }
+        return result;
     }
 
-    int inList(uint8_t **list, uint8_t *testString, int listLen) {
-        for (int i = 0; i < listLen; i++) {
-            if (strcmp(list[i], testString) == 0) {
-                return i;
-            }
+    int readFully(uint8_t* data, int len) {
+        int result = 0;
+        while (result < len) {
+            int read = p_stream->readBytes(data + result, len - result);
+            if (read <= 0) break;
+            result += read;
         }
-        return 0;
+        return result;
     }
 };
 
-} // ns
\ No newline at end of file
+} // ns
@@ -1,13 +1,37 @@
 #pragma once
 #include "AudioTools/BaseStream.h"
+#include "AudioTools/Buffers.h"
 #include "RHGenericDriver.h"
 
+/// Number of packets which can be buffered while the radio is sending
+#ifndef RADIOHEAD_TX_PACKETS
+#  define RADIOHEAD_TX_PACKETS 4
+#endif
+
 namespace audio_tools {
 
 
 /**
  * @brief Arduino Stream which is using the RadioHead library to send and
  * receive data. We use the river API directly.
+ *
+ * The written data is collected in a ring buffer and sent in packets of
+ * the max message length of the driver: we only wait for the radio if the
+ * buffer is full, so that the encoding of the next data overlaps with the
+ * transmission of the actual packet. Each packet starts with a sequence
+ * number, so that the receiver can report lost packets (see
+ * setPacketLossCallback()).
+ *
+ * For voice over LoRa or RFM links use a low bitrate codec and align the
+ * packets to its frames, so that a lost packet does not break the frame
+ * boundaries:
+ * @code
+ * Codec2Encoder codec2(1300);
+ * ReadioHeadStream radio(driver);
+ * radio.setFrameSize(codec2.bytesCompressed()); // after codec2.begin()
+ * @endcode
+ * On the receiving side Codec2Decoder::concealBytes() can be called in the
+ * packet loss callback.
  * @ingroup communications
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -18,56 +42,153 @@ class ReadioHeadStream : public Stream {
 
   void setDriver(RHGenericDriver &driver) { p_driver = &driver; }
 
+  /// Aligns the payload of the packets to a multiple of the frame size
+  void setFrameSize(int size) { frame_size = size; }
+
+  /// Callback which is called with the number of lost bytes when the
+  /// receiver detects a gap in the sequence numbers
+  void setPacketLossCallback(void (*cb)(int lostBytes, void *ref),
+                             void *ref = nullptr) {
+    loss_callback = cb;
+    loss_ref = ref;
+  }
+
+  bool begin(RxTxMode mode) {
+    this->mode = mode;
+    return begin();
+  }
+
   bool begin() {
     if (p_driver == nullptr) return false;
-    p_driver->setMode(mode == RX_MODE ? RHGenericDriver::RHMode::RHModeRx
-                                      : RHGenericDriver::RHMode::RHModeTx);
-    return p_driver->init();
+    if (!p_driver->init()) return false;
+    int max_len = p_driver->maxMessageLength();
+    payload_size = max_len - 1;
+    if (frame_size > 0 && payload_size >= frame_size)
+      payload_size = payload_size / frame_size * frame_size;
+    packet.resize(max_len);
+    packet_len = packet_pos = 0;
+    tx_seq = 0;
+    is_rx_started = false;
+    lost_packets = 0;
+    if (mode == RX_MODE) {
+      p_driver->setModeRx();
+    } else {
+      tx_buffer.resize(payload_size * RADIOHEAD_TX_PACKETS);
+    }
+    return true;
   }
 
-  void end() { p_driver->setMode(RHGenericDriver::RHMode::RHModeSleep); }
+  void end() {
+    if (mode == TX_MODE) flush();
+    p_driver->sleep();
+  }
 
   int available() override {
     if (mode == TX_MODE) return 0;
-    return p_driver->available() ? p_driver->maxMessageLength() : 0;
+    if (packet_pos < packet_len) return packet_len - packet_pos;
+    return p_driver->available() ? payload_size : 0;
   }
 
+  /// Provides the data of at most one packet, so that a packet loss is
+  /// reported before the data after the gap is returned
   size_t readBytes(uint8_t *data, size_t len) override {
     if (mode == TX_MODE) return 0;
-    int open = len;
-    int processed = 0;
-    while (open > 0) {
-      uint8_t av = available();
-      if (av == 0) break;
-      p_driver->recv(data + processed, &av);
-      open -= av;
-      processed += av;
-    }
-    return processed;
+    if (packet_pos >= packet_len && !receivePacket()) return 0;
+    int n = min((int)len, packet_len - packet_pos);
+    memcpy(data, packet.data() + packet_pos, n);
+    packet_pos += n;
+    return n;
+  }
+
+  int read() override {
+    uint8_t result = 0;
+    return readBytes(&result, 1) == 1 ? result : -1;
+  }
+
+  int peek() override {
+    if (packet_pos >= packet_len && !receivePacket()) return -1;
+    return packet[packet_pos];
   }
 
   int availableForWrite() override {
     if (mode == RX_MODE) return 0;
-    return p_driver->maxMessageLength();
+    return tx_buffer.availableForWrite();
   }
 
+  /// Adds the data to the send buffer and sends the full packets
   size_t write(const uint8_t *data, size_t len) override {
     if (mode == RX_MODE) return 0;
-    int open = len;
-    int processed = 0;
-    while (open > 0) {
-      int av = available();
-      if (av == 0) break;
-      p_driver->send(data + processed, av);
-      open -= av;
-      processed += av;
+    size_t processed = 0;
+    while (processed < len) {
+      processed += tx_buffer.writeArray(data + processed, len - processed);
+      // wait for the radio only if the buffer is full
+      while (tx_buffer.available() >= payload_size) {
+        if (!sendPacket(payload_size, tx_buffer.isFull())) break;
+      }
     }
     return processed;
   }
 
+  size_t write(uint8_t ch) override { return write(&ch, 1); }
+
+  /// Sends the buffered data and waits until the last packet was sent
+  void flush() override {
+    if (mode != TX_MODE) return;
+    while (tx_buffer.available() > 0) {
+      sendPacket(min(tx_buffer.available(), payload_size), true);
+    }
+    p_driver->waitPacketSent();
+  }
+
+  /// Number of packets which were detected as lost
+  uint32_t lostPackets() { return lost_packets; }
+
  protected:
   RHGenericDriver *p_driver = nullptr;
-  RxTxMode mode;
+  RxTxMode mode = TX_MODE;
+  RingBuffer<uint8_t> tx_buffer{0};
+  Vector<uint8_t> packet{0};
+  int payload_size = 0;
+  int frame_size = 0;
+  int packet_len = 0;
+  int packet_pos = 0;
+  uint8_t tx_seq = 0;
+  uint8_t rx_seq = 0;
+  bool is_rx_started = false;
+  uint32_t lost_packets = 0;
+  void (*loss_callback)(int lostBytes, void *ref) = nullptr;
+  void *loss_ref = nullptr;
+
+  /// Sends the next packet: returns false if the radio is still busy and we
+  /// do not want to wait
+  bool sendPacket(int len, bool wait) {
+    if (p_driver->mode() == RHGenericDriver::RHModeTx) {
+      if (!wait) return false;
+      p_driver->waitPacketSent();
+    }
+    packet[0] = tx_seq++;
+    int n = tx_buffer.readArray(packet.data() + 1, len);
+    p_driver->send(packet.data(), n + 1);
+    return true;
+  }
+
+  /// Receives the next packet and checks the sequence number
+  bool receivePacket() {
+    if (!p_driver->available()) return false;
+    uint8_t len = packet.size();
+    if (!p_driver->recv(packet.data(), &len) || len < 1) return false;
+    uint8_t seq = packet[0];
+    if (is_rx_started && seq != rx_seq) {
+      uint8_t lost = seq - rx_seq;
+      lost_packets += lost;
+      if (loss_callback != nullptr) loss_callback(lost * payload_size, loss_ref);
+    }
+    is_rx_started = true;
+    rx_seq = seq + 1;
+    packet_pos = 1;
+    packet_len = len;
+    return true;
+  }
 };
 
-}  // namespace audio_tools
\ No newline at end of file
+}  // namespace audio_tools
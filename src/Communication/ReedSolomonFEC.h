@@ -7,8 +7,10 @@
 namespace audio_tools {
 
 /**
- * @brief Forward error correction using Reed-Solomon: 
- * write is encoding and readBytes does the decoding.
+ * @brief Forward error correction using Reed-Solomon:
+ * write is encoding and readBytes does the decoding. Complete frames of
+ * the written data are encoded directly from the provided buffer: up to
+ * FEC_BATCH_FRAMES frames with one call.
  * @ingroup fec
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -29,14 +31,23 @@ class ReedSolomonFEC : public BaseStream {
     int availableForWrite() override {
         return bytecount;
     }
-    
+
     size_t write(const uint8_t* data, size_t len) override {
         if (p_print==nullptr) return 0;
-        for (int j=0;j<len;j++){
-            raw.write(data[j]);
+        size_t pos = 0;
+        while (pos < len) {
+            // encode complete frames w/o copying them to the raw buffer
+            size_t frames = min((len - pos) / bytecount, (size_t)FEC_BATCH_FRAMES);
+            if (raw.isEmpty() && frames > 0) {
+                writeFrames(data + pos, frames);
+                pos += frames * bytecount;
+                continue;
+            }
+            size_t copy = min(len - pos, (size_t)raw.availableForWrite());
+            raw.writeArray(data + pos, copy);
+            pos += copy;
             if(raw.availableForWrite()==0){
-                rs.Encode(raw.data(), encoded.data());
-                p_print->write(encoded.data(), bytecount+additional_bytes);
+                writeFrames(raw.data(), 1);
                 raw.reset();
             }
         }
@@ -49,22 +60,41 @@ class ReedSolomonFEC : public BaseStream {
 
     size_t readBytes(uint8_t* data, size_t len) override{
         if (p_stream==nullptr) return 0;
-        if (encoded.isEmpty()){
+        if (raw.isEmpty()){
+            raw.reset();
             int read_len = bytecount + additional_bytes;
-            p_stream->readBytes(encoded.data(), read_len);
-            encoded.setAvailable(read_len);
+            if (readFully(encoded.address(), read_len) != read_len) return 0;
+            if (rs.Decode(encoded.address(), raw.address()) != 0) {
+                LOGW("Reed-Solomon: could not correct errors");
+            }
+            raw.setAvailable(bytecount);
         }
-        return encoded.readArray(data, len);
+        return raw.readArray(data, len);
     }
 
 
   protected:
     SingleBuffer<uint8_t> raw{bytecount};
-    SingleBuffer<uint8_t> encoded{bytecount+additional_bytes};
+    SingleBuffer<uint8_t> encoded{(bytecount + additional_bytes) * FEC_BATCH_FRAMES};
     RS::ReedSolomon<bytecount, additional_bytes> rs;
     Stream* p_stream = nullptr;
     Print* p_print = nullptr;
 
+    void writeFrames(const uint8_t* data, size_t frames) {
+        rs.Encode(data, encoded.address(), frames);
+        p_print->write(encoded.address(), (bytecount + additional_bytes) * frames);
+    }
+
+    int readFully(uint8_t* data, int len) {
+        int result = 0;
+        while (result < len) {
+            int read = p_stream->readBytes(data + result, len - result);
+            if (read <= 0) break;
+            result += read;
+        }
+        return result;
+    }
+
 };
 
-}
\ No newline at end of file
+}
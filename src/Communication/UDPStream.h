@@ -2,9 +2,14 @@
 #include <WiFiUdp.h>
 #include <esp_now.h>
 
+#include "AudioBasic/Collections/Vector.h"
 #include "AudioBasic/Str.h"
 #include "AudioTools/BaseStream.h"
 #include "AudioTools/Buffers.h"
+#include "AudioTools/SilenceDetector.h"
+
+/// Flag in the length of the packet header which marks a silent packet
+#define UDP_SILENCE_FLAG 0x8000
 
 namespace audio_tools {
 
@@ -13,6 +18,15 @@ namespace audio_tools {
  * AudioSource and AudioSink. By default the WiFiUDP object is used and we login
  * to wifi if the ssid and password is provided and we are not already
  * connected.
+ *
+ * In the packet mode the written data is collected up to the payload size
+ * before it is sent as one datagram with a sequence number. The receiver uses
+ * an adaptive jitter buffer which reorders the packets, drops late packets
+ * and conceals lost packets with silence. Both sides must use the packet mode.
+ *
+ * If a SilenceDetector is defined, silent packets are replaced by a packet
+ * which consists of the header only and the receiver plays silence. W/o the
+ * packet mode the silent data is not sent at all.
  * @ingroup communications
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -41,15 +55,38 @@ public:
   /// @param udp
   void setUDP(UDP &udp) { p_udp = &udp; };
 
+  /// Activates the packet mode with sequence numbers and the jitter buffer:
+  /// the payload size should fit into the MTU (1500 - 28 bytes IP/UDP header)
+  void setPacketMode(bool active, int payloadSize = UDP_PAYLOAD_SIZE) {
+    is_packet_mode = active;
+    payload_size = payloadSize;
+  }
+
+  /// Suppresses the sending of the audio data which is identified as silent
+  void setSilenceDetector(SilenceDetector &detector) {
+    p_silence = &detector;
+  }
+
+  /// Defines the min and max number of packets in the jitter buffer
+  void setJitterBuffer(int minPackets, int maxPackets) {
+    min_depth = minPackets;
+    max_depth = maxPackets;
+    target_depth = minPackets;
+  }
+
   /// Always return 1492 (MTU 1500 - 8 byte header) as UDP packet available to
   /// write
-  int availableForWrite() { return 1492; }
+  int availableForWrite() {
+    if (is_packet_mode) return payload_size - send_len;
+    return 1492;
+  }
 
   /**
    * Provides the available size of the current package and if this is used up
    * of the next package
    */
   int available() override {
+    if (is_packet_mode) return availablePacket();
     int size = p_udp->available();
     // if the curren package is used up we prvide the info for the next
     if (size == 0) {
@@ -100,6 +137,11 @@ public:
   /// Replys will be sent to the initial remote caller
   size_t write(const uint8_t *data, size_t len) override {
     TRACED();
+    if (is_packet_mode) return writePacket(data, len);
+    if (p_silence != nullptr && p_silence->update(data, len)) {
+      suppressed_packets++;
+      return len;
+    }
     p_udp->beginPacket(remoteIP(), remotePort());
     size_t result = p_udp->write(data, len);
     p_udp->endPacket();
@@ -109,6 +151,7 @@ public:
   /// Reads bytes using WiFi::readBytes
   size_t readBytes(uint8_t *data, size_t len) override {
     TRACED();
+    if (is_packet_mode) return readPacket(data, len);
     size_t avail = available();
     size_t bytes_read = 0;
     if (avail > 0) {
@@ -122,7 +165,92 @@ public:
 
   void setPassword(const char *pwd) { this->password = pwd; }
 
+  /// Sends the collected data in packet mode
+  void flush() override {
+    if (!is_packet_mode || send_len == 0) return;
+    UDPPacketHeader header;
+    header.seq = send_seq++;
+    header.len = send_len;
+    bool is_silent =
+        p_silence != nullptr && p_silence->update(send_buffer.data(), send_len);
+    p_udp->beginPacket(remoteIP(), remotePort());
+    if (is_silent) {
+      // the header is sufficient to play the silence
+      header.len |= UDP_SILENCE_FLAG;
+      p_udp->write((const uint8_t *)&header, sizeof(header));
+      suppressed_packets++;
+    } else {
+      p_udp->write((const uint8_t *)&header, sizeof(header));
+      p_udp->write(send_buffer.data(), send_len);
+    }
+    p_udp->endPacket();
+    send_len = 0;
+    packets_sent++;
+  }
+
+  /// Number of sent packets
+  uint32_t packetsSent() { return packets_sent; }
+
+  /// Number of sent packets for which the audio data was suppressed
+  uint32_t suppressedPackets() { return suppressed_packets; }
+
+  /// Number of received packets
+  uint32_t packetsReceived() { return packets_received; }
+
+  /// Number of lost packets which have been replaced with silence
+  uint32_t lostPackets() { return lost_count; }
+
+  /// Number of packets which arrived too late and were dropped
+  uint32_t latePackets() { return late_count; }
+
+  /// Estimated jitter of the packet arrival in ms
+  float jitterMs() { return jitter_ms; }
+
+  /// Actual depth of the jitter buffer in packets
+  int bufferedPackets() { return buffered_count; }
+
+  /// Target depth of the jitter buffer in packets
+  int targetPackets() { return target_depth; }
+
 protected:
+  struct UDPPacketHeader {
+    uint16_t seq = 0;
+    uint16_t len = 0;
+  };
+  struct UDPPacketSlot {
+    Vector<uint8_t> data{0};
+    uint16_t seq = 0;
+    bool valid = false;
+  };
+  // packet mode
+  bool is_packet_mode = false;
+  int payload_size = UDP_PAYLOAD_SIZE;
+  Vector<uint8_t> send_buffer{0};
+  int send_len = 0;
+  uint16_t send_seq = 0;
+  uint32_t packets_sent = 0;
+  uint32_t suppressed_packets = 0;
+  SilenceDetector *p_silence = nullptr;
+  // jitter buffer
+  Vector<UDPPacketSlot> slots{0};
+  Vector<uint8_t> receive_buffer{0};
+  int min_depth = UDP_JITTER_MIN_PACKETS;
+  int max_depth = UDP_JITTER_MAX_PACKETS;
+  int target_depth = UDP_JITTER_MIN_PACKETS;
+  int buffered_count = 0;
+  bool is_playing = false;
+  bool is_first_packet = true;
+  uint16_t play_seq = 0;
+  int play_pos = 0;
+  int last_len = 0;
+  int conceal_open = 0;
+  uint32_t packets_received = 0;
+  uint32_t lost_count = 0;
+  uint32_t late_count = 0;
+  uint32_t last_arrival_ms = 0;
+  float interval_ms = 0;
+  float jitter_ms = 0;
+
   WiFiUDP default_udp;
   UDP *p_udp = &default_udp;
   uint16_t remote_port_ext;
@@ -130,6 +258,181 @@ protected:
   const char *ssid = nullptr;
   const char *password = nullptr;
 
+  /// Collects the data into packets of the payload size
+  size_t writePacket(const uint8_t *data, size_t len) {
+    if ((int)send_buffer.size() != payload_size) {
+      send_buffer.resize(payload_size);
+      send_len = 0;
+    }
+    size_t result = 0;
+    while (result < len) {
+      int n = min((int)(len - result), payload_size - send_len);
+      memcpy(send_buffer.data() + send_len, data + result, n);
+      send_len += n;
+      result += n;
+      if (send_len == payload_size) flush();
+    }
+    return result;
+  }
+
+  /// Moves all received packets into the jitter buffer
+  void receivePackets() {
+    if (slots.size() == 0) {
+      // power of 2 so that the slot index is continuous at the seq wrap
+      int size = 1;
+      while (size < max_depth * 2) size <<= 1;
+      slots.resize(size);
+    }
+    int size = p_udp->parsePacket();
+    while (size > 0) {
+      if (size >= (int)sizeof(UDPPacketHeader)) {
+        if ((int)receive_buffer.size() < size) receive_buffer.resize(size);
+        int read = p_udp->read(receive_buffer.data(), size);
+        if (read >= (int)sizeof(UDPPacketHeader)) addPacket(read);
+      }
+      size = p_udp->parsePacket();
+    }
+  }
+
+  /// Adds the packet in the receive buffer to the related slot
+  void addPacket(int size) {
+    UDPPacketHeader header;
+    memcpy(&header, receive_buffer.data(), sizeof(header));
+    bool is_silent = header.len & UDP_SILENCE_FLAG;
+    int len = header.len & ~UDP_SILENCE_FLAG;
+    if (!is_silent) len = min(len, size - (int)sizeof(header));
+    if (len <= 0) return;
+    packets_received++;
+    updateJitter();
+    if (is_first_packet) {
+      play_seq = header.seq;
+      is_first_packet = false;
+    }
+    int16_t offset = header.seq - play_seq;
+    if (offset < 0) {
+      late_count++;
+      return;
+    }
+    if (offset >= 2 * (int)slots.size()) {
+      // far ahead (e.g. sender restarted): we restart the playback
+      LOGW("resync jitter buffer: %d", offset);
+      resetSlots();
+      play_seq = header.seq;
+    } else if (offset >= (int)slots.size()) {
+      // buffer overflow: we skip the oldest packets
+      while ((int16_t)(header.seq - play_seq) >= (int)slots.size()) {
+        UDPPacketSlot *p_slot = playSlot();
+        if (p_slot != nullptr) {
+          p_slot->valid = false;
+          buffered_count--;
+        }
+        late_count++;
+        play_seq++;
+        play_pos = 0;
+      }
+    }
+    UDPPacketSlot &slot = slots[header.seq % slots.size()];
+    if (slot.valid && slot.seq == header.seq) return;  // duplicate
+    slot.data.resize(len);
+    if (is_silent) {
+      memset(slot.data.data(), 0, len);
+    } else {
+      memcpy(slot.data.data(), receive_buffer.data() + sizeof(header), len);
+    }
+    slot.seq = header.seq;
+    slot.valid = true;
+    buffered_count++;
+  }
+
+  /// Exponential moving average of the inter-arrival deviation (RFC 3550)
+  void updateJitter() {
+    uint32_t now = millis();
+    uint32_t last = last_arrival_ms;
+    last_arrival_ms = now;
+    if (last != 0) {
+      float delta = now - last;
+      if (interval_ms == 0) interval_ms = delta;
+      interval_ms += (delta - interval_ms) / 16.0f;
+      float deviation = delta > interval_ms ? delta - interval_ms
+                                            : interval_ms - delta;
+      jitter_ms += (deviation - jitter_ms) / 16.0f;
+      // cover twice the jitter
+      if (interval_ms <= 0) return;
+      int depth = 1 + (int)(2.0f * jitter_ms / interval_ms);
+      target_depth = depth < min_depth   ? min_depth
+                     : depth > max_depth ? max_depth
+                                         : depth;
+    }
+  }
+
+  void resetSlots() {
+    for (auto &slot : slots) slot.valid = false;
+    buffered_count = 0;
+    is_playing = false;
+    play_pos = 0;
+    conceal_open = 0;
+  }
+
+  /// Determines the next packet: returns nullptr for a lost packet
+  UDPPacketSlot *playSlot() {
+    UDPPacketSlot &slot = slots[play_seq % slots.size()];
+    return slot.valid && slot.seq == play_seq ? &slot : nullptr;
+  }
+
+  /// Number of bytes which can be read from the actual packet
+  int availablePacket() {
+    receivePackets();
+    if (conceal_open > 0) return conceal_open;
+    if (!is_playing) {
+      // prefill the jitter buffer
+      if (buffered_count < target_depth) return 0;
+      is_playing = true;
+    }
+    if (buffered_count == 0) {
+      // underflow: we need to prefill again
+      is_playing = false;
+      return 0;
+    }
+    UDPPacketSlot *p_slot = playSlot();
+    if (p_slot != nullptr) return p_slot->data.size() - play_pos;
+    // the packet is missing: conceal it if the following are available
+    if (last_len > 0 && buffered_count >= target_depth) {
+      lost_count++;
+      conceal_open = last_len;
+      play_seq++;
+      return conceal_open;
+    }
+    return 0;
+  }
+
+  /// Provides the data in the sequence of the packets
+  size_t readPacket(uint8_t *data, size_t len) {
+    size_t result = 0;
+    while (result < len) {
+      int avail = availablePacket();
+      if (avail <= 0) break;
+      int n = min(avail, (int)(len - result));
+      if (conceal_open > 0) {
+        // silence for the lost packet
+        memset(data + result, 0, n);
+        conceal_open -= n;
+      } else {
+        UDPPacketSlot *p_slot = playSlot();
+        memcpy(data + result, p_slot->data.data() + play_pos, n);
+        play_pos += n;
+        if (play_pos >= (int)p_slot->data.size()) {
+          last_len = p_slot->data.size();
+          p_slot->valid = false;
+          buffered_count--;
+          play_pos = 0;
+          play_seq++;
+        }
+      }
+      result += n;
+    }
+    return result;
+  }
+
   /// connect to WIFI if necessary
   void connect() {
     if (WiFi.status() != WL_CONNECTED && ssid != nullptr &&
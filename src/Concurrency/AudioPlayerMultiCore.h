@@ -0,0 +1,197 @@
+#pragma once
+#include "AudioTools/AudioPlayer.h"
+#include "Concurrency/BufferRTOS.h"
+#include "Concurrency/Task.h"
+
+namespace audio_tools {
+
+/**
+ * @brief AudioPlayer with a split pipeline: the source and the decoder are
+ * running in one task and the output (e.g. I2S) in another task, which can be
+ * pinned to different cores. The decoded PCM data is passed via a BufferRTOS:
+ * its size defines how long a slow SD read or a network stall can be bridged.
+ *
+ * The tasks are started by begin(), so you do not need to call copy() in the
+ * loop any more. If the output task does not find any data while the player
+ * is active, this is counted as underrun.
+ * @ingroup player
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class AudioPlayerMultiCore : public AudioPlayer {
+ public:
+  AudioPlayerMultiCore(AudioSource &source, AudioOutput &output,
+                       AudioDecoder &decoder)
+      : AudioPlayer(source, output, decoder) {}
+
+  AudioPlayerMultiCore(AudioSource &source, Print &output,
+                       AudioDecoder &decoder,
+                       AudioInfoSupport *notify = nullptr)
+      : AudioPlayer(source, output, decoder, notify) {}
+
+  AudioPlayerMultiCore(AudioSource &source, AudioStream &output,
+                       AudioDecoder &decoder)
+      : AudioPlayer(source, output, decoder) {}
+
+  ~AudioPlayerMultiCore() { end(); }
+
+  /// Defines the core, priority and stack size of the source and decoder task
+  void setDecoderTask(int core, int priority = 1, int stackSize = 10000) {
+    decoder_core = core;
+    decoder_priority = priority;
+    decoder_stack_size = stackSize;
+  }
+
+  /// Defines the core, priority and stack size of the output task
+  void setOutputTask(int core, int priority = 2, int stackSize = 4096) {
+    output_core = core;
+    output_priority = priority;
+    output_stack_size = stackSize;
+  }
+
+  /// Defines the size of the buffer for the decoded PCM data in bytes
+  void setPCMBufferSize(size_t bytes) { pcm_buffer_size = bytes; }
+
+  /// The output starts only when the PCM buffer is filled by the indicated %
+  void setPrefillPercent(int percent) { prefill_percent = percent; }
+
+  /// Defines the number of bytes which are written to the output at once
+  void setOutputBufferSize(size_t bytes) { output_buffer.resize(bytes); }
+
+  /// Starts the player with the decoder and output task
+  bool begin(int index = 0, bool isActive = true) override {
+    TRACEI();
+    if (p_final_output == nullptr) {
+      LOGE("output not defined");
+      return false;
+    }
+    pcm_buffer.resize(pcm_buffer_size);
+    pcm_buffer.setReadMaxWait(pdMS_TO_TICKS(read_wait_ms));
+    pcm_buffer.reset();
+    if (output_buffer.size() == 0) output_buffer.resize(DEFAULT_BUFFER_SIZE);
+    pcm_queue.end();
+    pcm_queue.begin(prefill_percent);
+    setupPCMOutput();
+    // the queue provides the back pressure
+    delay_if_full = 0;
+    underrun_count = 0;
+
+    bool result = AudioPlayer::begin(index, isActive);
+
+    if (!is_tasks_active) {
+      decoder_task.create("decoder", decoder_stack_size, decoder_priority,
+                          decoder_core);
+      output_task.create("output", output_stack_size, output_priority,
+                         output_core);
+      decoder_task.begin([this]() { copyDecoded(); });
+      output_task.begin([this]() { copyOutput(); });
+      is_tasks_active = true;
+    }
+    return result;
+  }
+
+  /// Stops the tasks and the player
+  void end() override {
+    TRACEI();
+    // setStream() is calling end() from the decoder task
+    if (is_tasks_active && !is_set_stream) {
+      decoder_task.remove();
+      output_task.remove();
+      is_tasks_active = false;
+    }
+    AudioPlayer::end();
+  }
+
+  /// start selected input stream: the tasks are kept running
+  bool setStream(Stream *input) override {
+    is_set_stream = true;
+    bool result = AudioPlayer::setStream(input);
+    is_set_stream = false;
+    return result;
+  }
+
+  /// The processing is done by the tasks: this is just doing nothing
+  size_t copy() override {
+    if (!is_tasks_active) return AudioPlayer::copy();
+    delay(10);
+    return 0;
+  }
+
+  /// The processing is done by the tasks: this is just doing nothing
+  size_t copy(size_t bytes) override {
+    if (!is_tasks_active) return AudioPlayer::copy(bytes);
+    delay(10);
+    return 0;
+  }
+
+  /// Writes the silence to the PCM buffer, so that the order is kept
+  void writeSilence(size_t bytes) override {
+    uint8_t zero[64] = {0};
+    while (bytes > 0) {
+      size_t len = bytes > sizeof(zero) ? sizeof(zero) : bytes;
+      pcm_queue.write(zero, len);
+      bytes -= len;
+    }
+  }
+
+  /// Number of times the output did not find any data
+  uint32_t underruns() { return underrun_count; }
+
+  /// Resets the underrun counter
+  void resetUnderruns() { underrun_count = 0; }
+
+  /// Number of decoded bytes which are waiting for the output
+  int bufferedBytes() { return pcm_buffer.available(); }
+
+  Task &decoderTask() { return decoder_task; }
+
+  Task &outputTask() { return output_task; }
+
+ protected:
+  BufferRTOS<uint8_t> pcm_buffer{0};
+  QueueStream<uint8_t> pcm_queue{pcm_buffer};
+  Vector<uint8_t> output_buffer{0};
+  Task decoder_task;
+  Task output_task;
+  bool is_tasks_active = false;
+  bool is_set_stream = false;
+  size_t pcm_buffer_size = 16 * 1024;
+  int prefill_percent = 75;
+  int read_wait_ms = 10;
+  int decoder_core = 0;
+  int decoder_priority = 1;
+  int decoder_stack_size = 10000;
+  int output_core = 1;
+  int output_priority = 2;
+  int output_stack_size = 4096;
+  volatile uint32_t underrun_count = 0;
+
+  /// Redirects the end of the decoding chain to the PCM buffer
+  void setupPCMOutput() {
+    if (p_decoder->isResultPCM()) {
+      fade.setOutput(pcm_queue);
+    } else {
+      out_decoding.setOutput(&pcm_queue);
+    }
+  }
+
+  /// Source and decoder task
+  void copyDecoded() {
+    if (AudioPlayer::copy() == 0) delay(5);
+  }
+
+  /// Output task
+  void copyOutput() {
+    size_t len = pcm_queue.readBytes(output_buffer.data(), output_buffer.size());
+    if (len > 0) {
+      p_final_output->write(output_buffer.data(), len);
+    } else {
+      // the queue becomes active when the prefill level has been reached
+      if (isActive() && pcm_queue) underrun_count++;
+      delay(1);
+    }
+  }
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,224 @@
+#pragma once
+#include <atomic>
+
+#include "AudioBasic/Collections/Allocator.h"
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioConfig.h"
+#include "AudioTools/AudioLogger.h"
+#include "AudioTools/Buffers.h"
+#include "Concurrency/QueueRTOS.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Block of a BufferPoolRTOS
+ * @ingroup concurrency
+ * @tparam T
+ */
+template <typename T>
+struct BufferPoolBlock {
+  /// Start of the preallocated data
+  T *data = nullptr;
+  /// Capacity in entries
+  int size = 0;
+  /// Number of valid entries
+  int len = 0;
+};
+
+/**
+ * @brief A fixed pool of preallocated blocks which are passed by pointer
+ * through two FreeRTOS queues: the producer acquires a free block with
+ * acquireWrite(), fills it and hands it over with commitWrite(); the consumer
+ * gets the filled block with acquireRead() and returns it with releaseRead().
+ * No data is copied and no mutex is needed: the tasks just block in the
+ * queues until a block is available.
+ *
+ * All memory is allocated in the constructor. For compatibility the class
+ * also implements the BaseBuffer api with writeArray() and readArray(), which
+ * copy the data into/from the actual block: this supports one producer and
+ * one consumer task.
+ * @ingroup buffers
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T
+ */
+template <typename T>
+class BufferPoolRTOS : public BaseBuffer<T> {
+ public:
+  BufferPoolRTOS(int blockSize, int blockCount,
+                 TickType_t writeMaxWait = portMAX_DELAY,
+                 TickType_t readMaxWait = portMAX_DELAY,
+                 Allocator &allocator = DefaultAllocator)
+      : memory(allocator) {
+    block_size = blockSize;
+    block_count = blockCount;
+    write_wait = writeMaxWait;
+    read_wait = readMaxWait;
+    memory.resize(blockSize * blockCount);
+    blocks.resize(blockCount);
+    free_blocks.resize(blockCount);
+    filled_blocks.resize(blockCount);
+    reset();
+  }
+
+  void setReadMaxWait(TickType_t ticks) { read_wait = ticks; }
+
+  void setWriteMaxWait(TickType_t ticks) { write_wait = ticks; }
+
+  /// Provides the next free block: producer only. Returns nullptr on timeout
+  BufferPoolBlock<T> *acquireWrite(TickType_t wait) {
+    BufferPoolBlock<T> *result = nullptr;
+    if (!free_blocks.dequeue(result, wait)) return nullptr;
+    result->len = 0;
+    return result;
+  }
+
+  BufferPoolBlock<T> *acquireWrite() { return acquireWrite(write_wait); }
+
+  /// Hands over the filled block (with block->len entries) to the consumer
+  bool commitWrite(BufferPoolBlock<T> *block) {
+    if (block == nullptr) return false;
+    filled_entries += block->len;
+    return filled_blocks.enqueue(block);
+  }
+
+  /// Provides the next filled block: consumer only. Returns nullptr on timeout
+  BufferPoolBlock<T> *acquireRead(TickType_t wait) {
+    BufferPoolBlock<T> *result = nullptr;
+    return filled_blocks.dequeue(result, wait) ? result : nullptr;
+  }
+
+  BufferPoolBlock<T> *acquireRead() { return acquireRead(read_wait); }
+
+  /// Returns the processed block to the pool
+  bool releaseRead(BufferPoolBlock<T> *block) {
+    if (block == nullptr) return false;
+    filled_entries -= block->len;
+    block->len = 0;
+    return free_blocks.enqueue(block);
+  }
+
+  /// Copies the data into the actual block: full blocks are committed
+  int writeArray(const T data[], int len) override {
+    int result = 0;
+    while (result < len) {
+      if (p_write == nullptr) {
+        p_write = acquireWrite();
+        if (p_write == nullptr) break;
+      }
+      int n = min(len - result, p_write->size - p_write->len);
+      memcpy(p_write->data + p_write->len, data + result, n * sizeof(T));
+      p_write->len += n;
+      result += n;
+      if (p_write->len == p_write->size) {
+        commitWrite(p_write);
+        p_write = nullptr;
+      }
+    }
+    return result;
+  }
+
+  /// Copies the data from the actual block: empty blocks are released
+  int readArray(T data[], int len) override {
+    int result = 0;
+    while (result < len) {
+      if (p_read == nullptr) {
+        // only wait if we did not get any data yet
+        p_read = acquireRead(result == 0 ? read_wait : 0);
+        if (p_read == nullptr) break;
+        read_pos = 0;
+      }
+      int n = min(len - result, p_read->len - read_pos);
+      memcpy(data + result, p_read->data + read_pos, n * sizeof(T));
+      read_pos += n;
+      result += n;
+      if (read_pos == p_read->len) {
+        releaseRead(p_read);
+        p_read = nullptr;
+      }
+    }
+    return result;
+  }
+
+  /// Commits the partially filled write block
+  bool flush() {
+    if (p_write == nullptr || p_write->len == 0) return false;
+    bool result = commitWrite(p_write);
+    p_write = nullptr;
+    return result;
+  }
+
+  bool write(T data) override { return writeArray(&data, 1) == 1; }
+
+  T read() override {
+    T result = 0;
+    readArray(&result, 1);
+    return result;
+  }
+
+  T peek() override {
+    if (p_read == nullptr) {
+      p_read = acquireRead(0);
+      read_pos = 0;
+    }
+    return p_read == nullptr ? 0 : p_read->data[read_pos];
+  }
+
+  /// Number of committed entries which have not been read yet
+  int available() override {
+    int result = filled_entries.load();
+    if (p_read != nullptr) result -= read_pos;
+    return result;
+  }
+
+  /// Entries that can be written w/o blocking
+  int availableForWrite() override {
+    int result = free_blocks.available() * block_size;
+    if (p_write != nullptr) result += p_write->size - p_write->len;
+    return result;
+  }
+
+  bool isFull() override { return availableForWrite() == 0; }
+
+  /// Moves all blocks back to the pool: this is not thread safe!
+  void reset() override {
+    free_blocks.clear();
+    filled_blocks.clear();
+    for (int j = 0; j < block_count; j++) {
+      blocks[j].data = memory.data() + j * block_size;
+      blocks[j].size = block_size;
+      blocks[j].len = 0;
+      BufferPoolBlock<T> *block = &blocks[j];
+      free_blocks.enqueue(block);
+    }
+    filled_entries = 0;
+    p_write = nullptr;
+    p_read = nullptr;
+    read_pos = 0;
+  }
+
+  T *address() override { return memory.data(); }
+
+  size_t size() override { return block_size * block_count; }
+
+  int blockSize() { return block_size; }
+
+  int blockCount() { return block_count; }
+
+ protected:
+  Vector<T> memory;
+  Vector<BufferPoolBlock<T>> blocks{0};
+  QueueRTOS<BufferPoolBlock<T> *> free_blocks{0, portMAX_DELAY, 0};
+  QueueRTOS<BufferPoolBlock<T> *> filled_blocks{0, portMAX_DELAY, 0};
+  std::atomic<int> filled_entries{0};
+  int block_size = 0;
+  int block_count = 0;
+  TickType_t write_wait = portMAX_DELAY;
+  TickType_t read_wait = portMAX_DELAY;
+  BufferPoolBlock<T> *p_write = nullptr;
+  BufferPoolBlock<T> *p_read = nullptr;
+  int read_pos = 0;
+};
+
+}  // namespace audio_tools
@@ -3,6 +3,7 @@
 #include "AudioTools/AudioLogger.h"
 
 #ifdef USE_STD_CONCURRENCY
+#  include <atomic>
 #  include <mutex>
 #endif
 
@@ -79,6 +80,47 @@ protected:
 };
 
 
+#if defined(ESP32)
+
+/**
+ * @brief Spin lock for short critical sections which can be accessed from
+ * both cores: it is based on a portMUX, so the interrupts of the actual core
+ * are disabled while the lock is held. Do not call any blocking FreeRTOS
+ * functions while it is locked.
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SpinLock : public MutexBase {
+public:
+  void lock() override { portENTER_CRITICAL(&mux); }
+  void unlock() override { portEXIT_CRITICAL(&mux); }
+
+protected:
+  portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#elif defined(USE_STD_CONCURRENCY)
+
+/**
+ * @brief Spin lock for short critical sections based on std::atomic_flag
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SpinLock : public MutexBase {
+public:
+  void lock() override {
+    while (flag.test_and_set(std::memory_order_acquire));
+  }
+  void unlock() override { flag.clear(std::memory_order_release); }
+
+protected:
+  std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+#endif
+
 /**
  * @brief RAII implementaion using a Mutex: Only a few microcontrollers provide
  * lock guards, so I decided to roll my own solution where we can just use a
@@ -90,12 +132,12 @@ protected:
  */
 class LockGuard {
 public:
-  LockGuard(Mutex &mutex) {
+  LockGuard(MutexBase &mutex) {
     TRACED();
     p_mutex = &mutex;
     p_mutex->lock();
   }
-  LockGuard(Mutex *mutex) {
+  LockGuard(MutexBase *mutex) {
     TRACED();
     p_mutex = mutex;
     p_mutex->lock();
@@ -106,7 +148,7 @@ public:
   }
 
 protected:
-  Mutex *p_mutex = nullptr;
+  MutexBase *p_mutex = nullptr;
 };
 
 }
@@ -5,10 +5,18 @@
 #include <atomic>
 #include <cstddef>
 
+#include "AudioBasic/Collections/Allocator.h"
+#include "AudioBasic/Collections/Vector.h"
+
 namespace audio_tools {
 
 /**
- * @brief A simple single producer, single consumer lock free queue
+ * @brief A bounded lock free queue: the positions are claimed with compare and
+ * swap, so it can also be used with multiple producers (e.g. callbacks) and
+ * consumers. The capacity is rounded up to a power of 2.
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
  */
 template <typename T>
 class QueueLockFree {
@@ -21,8 +29,6 @@ class QueueLockFree {
   ~QueueLockFree() {
     for (size_t i = head_pos; i != tail_pos; ++i)
       (&p_node[i & capacity_mask].data)->~T();
-
-    delete[] (char*)p_node;
   }
 
   void setAllocator(Allocator& allocator) { vector.setAllocator(allocator); }
@@ -33,10 +39,10 @@ class QueueLockFree {
       capacity_mask |= capacity_mask >> i;
     capacity_value = capacity_mask + 1;
 
-    vector.resize(capacity);
+    vector.resize(capacity_value);
     p_node = vector.data();
 
-    for (size_t i = 0; i < capacity; ++i) {
+    for (size_t i = 0; i < capacity_value; ++i) {
       p_node[i].tail.store(i, std::memory_order_relaxed);
       p_node[i].head.store(-1, std::memory_order_relaxed);
     }
@@ -61,7 +67,7 @@ class QueueLockFree {
     size_t tail = tail_pos.load(std::memory_order_relaxed);
     for (;;) {
       node = &p_node[tail & capacity_mask];
-      if (node->tail.load(std::memory_order_relaxed) != tail) return false;
+      if (node->tail.load(std::memory_order_acquire) != tail) return false;
       if ((tail_pos.compare_exchange_weak(tail, tail + 1,
                                           std::memory_order_relaxed)))
         break;
@@ -76,7 +82,7 @@ class QueueLockFree {
     size_t head = head_pos.load(std::memory_order_relaxed);
     for (;;) {
       node = &p_node[head & capacity_mask];
-      if (node->head.load(std::memory_order_relaxed) != head) return false;
+      if (node->head.load(std::memory_order_acquire) != head) return false;
       if (head_pos.compare_exchange_weak(head, head + 1,
                                          std::memory_order_relaxed))
         break;
@@ -87,6 +93,55 @@ class QueueLockFree {
     return true;
   }
 
+  /// Adds up to len elements with one compare and swap: returns the number
+  /// of added elements
+  size_t enqueueArray(const T* data, size_t len) {
+    size_t tail = tail_pos.load(std::memory_order_relaxed);
+    size_t n;
+    for (;;) {
+      // number of free consecutive positions
+      n = 0;
+      while (n < len && p_node[(tail + n) & capacity_mask].tail.load(
+                            std::memory_order_acquire) == tail + n)
+        n++;
+      if (n == 0) return 0;
+      if (tail_pos.compare_exchange_weak(tail, tail + n,
+                                         std::memory_order_relaxed))
+        break;
+    }
+    for (size_t i = 0; i < n; i++) {
+      Node* node = &p_node[(tail + i) & capacity_mask];
+      new (&node->data) T(data[i]);
+      node->head.store(tail + i, std::memory_order_release);
+    }
+    return n;
+  }
+
+  /// Removes up to len elements with one compare and swap: returns the
+  /// number of removed elements
+  size_t dequeueArray(T* result, size_t len) {
+    size_t head = head_pos.load(std::memory_order_relaxed);
+    size_t n;
+    for (;;) {
+      // number of consecutive filled positions
+      n = 0;
+      while (n < len && p_node[(head + n) & capacity_mask].head.load(
+                            std::memory_order_acquire) == head + n)
+        n++;
+      if (n == 0) return 0;
+      if (head_pos.compare_exchange_weak(head, head + n,
+                                         std::memory_order_relaxed))
+        break;
+    }
+    for (size_t i = 0; i < n; i++) {
+      Node* node = &p_node[(head + i) & capacity_mask];
+      result[i] = node->data;
+      (&node->data)->~T();
+      node->tail.store(head + i + capacity_value, std::memory_order_release);
+    }
+    return n;
+  }
+
   void clear() {
     T tmp;
     while (dequeue(tmp));
@@ -68,14 +68,54 @@ class QueueRTOS {
     return xQueuePeek(xQueue, &data, (TickType_t)read_max_wait);
   }
 
-  bool dequeue(T& data) {
+  bool dequeue(T& data) { return dequeue(data, read_max_wait); }
+
+  /// Dequeues with the indicated max wait
+  bool dequeue(T& data, TickType_t wait) {
     TRACED();
     if (xQueue==nullptr) return false;
-    return xQueueReceive(xQueue, &data, (TickType_t)read_max_wait);
+    return xQueueReceive(xQueue, &data, wait);
+  }
+
+  /// Adds up to len entries: we wait only for the first entry, the others
+  /// are added as long as there is space. Returns the number of added entries
+  int enqueueArray(T* data, int len) {
+    TRACED();
+    if (xQueue == nullptr) return 0;
+    int result = 0;
+    TickType_t wait = write_max_wait;
+    while (result < len && xQueueSend(xQueue, (void*)&data[result], wait)) {
+      result++;
+      wait = 0;
+    }
+    return result;
+  }
+
+  /// Removes up to len entries: we wait only for the first entry, the others
+  /// are removed as long as they are available. Returns the number of entries
+  int dequeueArray(T* data, int len) { return dequeueArray(data, len, read_max_wait); }
+
+  /// Removes up to len entries with the indicated max wait for the first
+  /// entry
+  int dequeueArray(T* data, int len, TickType_t wait) {
+    TRACED();
+    if (xQueue == nullptr) return 0;
+    int result = 0;
+    while (result < len && xQueueReceive(xQueue, &data[result], wait)) {
+      result++;
+      wait = 0;
+    }
+    return result;
   }
 
   size_t size() { return queue_size; }
 
+  /// Number of entries in the queue
+  int available() {
+    if (xQueue==nullptr) return 0;
+    return uxQueueMessagesWaiting(xQueue);
+  }
+
   bool clear() {
     TRACED();
     if (xQueue==nullptr) return false;
@@ -0,0 +1,190 @@
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+
+#include "AudioBasic/Collections/Allocator.h"
+#include "AudioTools/Buffers.h"
+
+namespace audio_tools {
+
+/**
+ * @brief A single producer, single consumer lock free ring buffer: one task
+ * (or ISR) is writing while another task is reading. The size is rounded up
+ * to a power of 2, so that the index calculation is just a bit mask, and the
+ * array operations are done with memcpy in at most 2 segments.
+ *
+ * In addition you can access the contiguous regions directly: e.g. a DMA
+ * callback or a decoder can fill writePtr() with up to writePtrSize() entries
+ * and confirm them with commitWrite(). The reader can process readPtr() with
+ * up to readPtrSize() entries and release them with consume().
+ *
+ * Please note that reset() and resize() are not thread safe.
+ * @ingroup buffers
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ * @tparam T
+ */
+template <typename T>
+class RingBufferLockFree : public BaseBuffer<T> {
+ public:
+  RingBufferLockFree(int size = 0, Allocator &allocator = DefaultAllocator) {
+    vector.setAllocator(allocator);
+    resize(size);
+  }
+
+  /// Resizes the buffer to the next power of 2 and clears the data
+  void resize(int size) {
+    size_t capacity = 1;
+    while (capacity < (size_t)size) capacity <<= 1;
+    if (size <= 0) capacity = 0;
+    if (capacity != capacity_value) {
+      vector.resize(capacity);
+      capacity_value = capacity;
+      capacity_mask = capacity == 0 ? 0 : capacity - 1;
+    }
+    reset();
+  }
+
+  /// Returns the (power of 2) capacity of the buffer
+  size_t size() override { return capacity_value; }
+
+  /// Writes a single entry: producer only
+  bool write(T data) override { return writeArray(&data, 1) == 1; }
+
+  /// Reads a single entry: consumer only
+  T read() override {
+    T result{};
+    readArray(&result, 1);
+    return result;
+  }
+
+  /// Provides the next entry w/o removing it: consumer only
+  T peek() override {
+    T result{};
+    if (available() > 0) {
+      result = vector[tail_pos.load(std::memory_order_relaxed) & capacity_mask];
+    }
+    return result;
+  }
+
+  /// Writes multiple entries with at most 2 memcpy: producer only
+  int writeArray(const T data[], int len) override {
+    int result = min(len, availableForWrite());
+    if (result <= 0) return 0;
+    size_t head = head_pos.load(std::memory_order_relaxed);
+    size_t idx = head & capacity_mask;
+    size_t len1 = min((size_t)result, capacity_value - idx);
+    memcpy(vector.data() + idx, data, len1 * sizeof(T));
+    if (len1 < (size_t)result) {
+      memcpy(vector.data(), data + len1, (result - len1) * sizeof(T));
+    }
+    head_pos.store(head + result, std::memory_order_release);
+    return result;
+  }
+
+  /// Reads multiple entries with at most 2 memcpy: consumer only
+  int readArray(T data[], int len) override {
+    if (data == nullptr) {
+      LOGE("NPE");
+      return 0;
+    }
+    int result = peekArray(data, len);
+    if (result > 0) consume(result);
+    return result;
+  }
+
+  /// Copies multiple entries w/o removing them: consumer only
+  int peekArray(T data[], int len) {
+    int result = min(len, available());
+    if (result <= 0) return 0;
+    size_t tail = tail_pos.load(std::memory_order_relaxed);
+    size_t idx = tail & capacity_mask;
+    size_t len1 = min((size_t)result, capacity_value - idx);
+    memcpy(data, vector.data() + idx, len1 * sizeof(T));
+    if (len1 < (size_t)result) {
+      memcpy(data + len1, vector.data(), (result - len1) * sizeof(T));
+    }
+    return result;
+  }
+
+  /// Removes the next len entries: consumer only
+  int clearArray(int len) override { return consume(len); }
+
+  /// Number of entries which can be read
+  int available() override {
+    size_t head = head_pos.load(std::memory_order_acquire);
+    return head - tail_pos.load(std::memory_order_relaxed);
+  }
+
+  /// Number of entries which can be written
+  int availableForWrite() override {
+    size_t tail = tail_pos.load(std::memory_order_acquire);
+    return capacity_value - (head_pos.load(std::memory_order_relaxed) - tail);
+  }
+
+  bool isFull() override { return availableForWrite() == 0; }
+
+  /// Clears the buffer: this is not thread safe!
+  void reset() override {
+    head_pos.store(0, std::memory_order_relaxed);
+    tail_pos.store(0, std::memory_order_relaxed);
+  }
+
+  /// Returns the address of the start of the physical buffer
+  T *address() override { return vector.data(); }
+
+  /// Provides the start of the contiguous free region: producer only
+  T *writePtr() {
+    return vector.data() +
+           (head_pos.load(std::memory_order_relaxed) & capacity_mask);
+  }
+
+  /// Number of entries which can be written to writePtr()
+  int writePtrSize() {
+    size_t idx = head_pos.load(std::memory_order_relaxed) & capacity_mask;
+    return min((size_t)availableForWrite(), capacity_value - idx);
+  }
+
+  /// Confirms that n entries have been written to writePtr(): producer only
+  bool commitWrite(int n) {
+    if (n < 0 || n > writePtrSize()) return false;
+    head_pos.store(head_pos.load(std::memory_order_relaxed) + n,
+                   std::memory_order_release);
+    return true;
+  }
+
+  /// Provides the start of the contiguous filled region: consumer only
+  T *readPtr() {
+    return vector.data() +
+           (tail_pos.load(std::memory_order_relaxed) & capacity_mask);
+  }
+
+  /// Number of entries which can be read from readPtr()
+  int readPtrSize() {
+    size_t idx = tail_pos.load(std::memory_order_relaxed) & capacity_mask;
+    return min((size_t)available(), capacity_value - idx);
+  }
+
+  /// Releases n entries which have been read: consumer only
+  int consume(int n) {
+    int result = min(n, available());
+    if (result <= 0) return 0;
+    tail_pos.store(tail_pos.load(std::memory_order_relaxed) + result,
+                   std::memory_order_release);
+    return result;
+  }
+
+ protected:
+  Vector<T> vector{0};
+  size_t capacity_value = 0;
+  size_t capacity_mask = 0;
+  // free running positions: only the producer updates the head and only the
+  // consumer updates the tail
+  std::atomic<size_t> head_pos{0};
+  std::atomic<size_t> tail_pos{0};
+};
+
+}  // namespace audio_tools
@@ -0,0 +1,160 @@
+#pragma once
+#include <stdint.h>
+
+#include <atomic>
+
+#include "AudioBasic/Collections/Vector.h"
+
+namespace audio_tools {
+
+/**
+ * @brief Index management of a triple buffer: the writer always owns one
+ * slot, the reader owns another one and the third slot holds the latest
+ * published result. Publishing and taking over a result are a single atomic
+ * exchange, so neither side ever needs to wait.
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class TripleBufferIndex {
+ public:
+  /// Slot which is owned by the writer
+  int writeIndex() { return write_idx; }
+
+  /// Slot which is owned by the reader
+  int readIndex() { return read_idx; }
+
+  /// Makes the write slot available to the reader
+  void publish() {
+    uint8_t prev =
+        middle.exchange(write_idx | FRESH, std::memory_order_acq_rel);
+    write_idx = prev & INDEX_MASK;
+  }
+
+  /// Takes over the latest published slot: returns false if nothing new has
+  /// been published since the last call
+  bool update() {
+    if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) return false;
+    uint8_t prev = middle.exchange(read_idx, std::memory_order_acq_rel);
+    read_idx = prev & INDEX_MASK;
+    return true;
+  }
+
+  /// Returns true if a result is available for update()
+  bool isFresh() {
+    return (middle.load(std::memory_order_relaxed) & FRESH) != 0;
+  }
+
+ protected:
+  static constexpr uint8_t FRESH = 4;
+  static constexpr uint8_t INDEX_MASK = 3;
+  std::atomic<uint8_t> middle{1};
+  uint8_t write_idx = 2;
+  uint8_t read_idx = 0;
+};
+
+/**
+ * @brief Lock free snapshot of a value (e.g. a struct with measurement
+ * results) which is published by one task (e.g. the audio processing) and
+ * read by another task (e.g. a display or web server). The writer never
+ * waits and the reader always gets a consistent copy. This is a triple
+ * buffer, so it supports exactly one writer and one reader task.
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T>
+class Snapshot {
+ public:
+  /// Writer: provides the value which will be published next
+  T &writeBuffer() { return slots[index.writeIndex()]; }
+
+  /// Writer: publishes the write buffer
+  void publish() { index.publish(); }
+
+  /// Writer: copies the value into the write buffer and publishes it
+  void publish(const T &value) {
+    writeBuffer() = value;
+    publish();
+  }
+
+  /// Reader: takes over the latest published value: returns false if there
+  /// is nothing new
+  bool update() { return index.update(); }
+
+  /// Reader: the value which was taken over with the last update()
+  const T &readBuffer() { return slots[index.readIndex()]; }
+
+  /// Reader: provides the latest published value: returns true if it is new
+  bool read(T &result) {
+    bool is_new = update();
+    result = readBuffer();
+    return is_new;
+  }
+
+ protected:
+  TripleBufferIndex index;
+  T slots[3];
+};
+
+/**
+ * @brief Lock free snapshot of an array (e.g. the magnitudes of a FFT) with
+ * one writer and one reader task: see Snapshot.
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+template <typename T>
+class SnapshotArray {
+ public:
+  SnapshotArray(int size = 0) { resize(size); }
+
+  /// Defines the number of entries: call this before the tasks are using the
+  /// object
+  void resize(int size) {
+    for (int j = 0; j < 3; j++) {
+      slots[j].resize(size);
+      for (int i = 0; i < size; i++) slots[j][i] = T();
+    }
+  }
+
+  /// Number of entries
+  int size() { return slots[0].size(); }
+
+  /// Writer: provides the array which will be published next
+  T *writeBuffer() { return slots[index.writeIndex()].data(); }
+
+  /// Writer: publishes the write buffer
+  void publish() { index.publish(); }
+
+  /// Writer: copies the values into the write buffer and publishes them
+  void publish(const T *values, int len) {
+    T *target = writeBuffer();
+    int n = len < size() ? len : size();
+    for (int j = 0; j < n; j++) target[j] = values[j];
+    publish();
+  }
+
+  /// Reader: takes over the latest published array: returns false if there
+  /// is nothing new
+  bool update() { return index.update(); }
+
+  /// Reader: the array which was taken over with the last update()
+  const T *readBuffer() { return slots[index.readIndex()].data(); }
+
+  /// Reader: copies the latest published values: returns true if they are
+  /// new
+  bool read(T *result, int len) {
+    bool is_new = update();
+    const T *source = readBuffer();
+    int n = len < size() ? len : size();
+    for (int j = 0; j < n; j++) result[j] = source[j];
+    return is_new;
+  }
+
+ protected:
+  TripleBufferIndex index;
+  Vector<T> slots[3];
+};
+
+}  // namespace audio_tools
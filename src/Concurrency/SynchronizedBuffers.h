@@ -147,7 +147,7 @@ public:
     // setup buffers
     NBuffer<T>::write_buffer_count = 0;
     for (int j = 0; j < bufferCount; j++) {
-      BaseBuffer<T> *tmp = new SingleBuffer<T>(bufferSize);
+      BaseBuffer<T> *tmp = NBuffer<T>::newBuffer(bufferSize);
       if (tmp != nullptr) {
         available_buffers.enqueue(tmp);
       } else {
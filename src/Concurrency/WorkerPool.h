@@ -0,0 +1,339 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include "AudioBasic/Collections/Vector.h"
+#include "AudioConfig.h"
+#include "AudioTools/AudioLogger.h"
+#if defined(ESP32)
+#  include "freertos/FreeRTOS.h"
+#  include "freertos/semphr.h"
+#  include "Concurrency/QueueRTOS.h"
+#  include "Concurrency/Task.h"
+#  define USE_WORKER_POOL_RTOS
+#elif defined(IS_DESKTOP) || defined(IS_MIN_DESKTOP) || \
+    defined(USE_STD_CONCURRENCY)
+#  include <chrono>
+#  include <condition_variable>
+#  include <mutex>
+#  include <thread>
+#  if defined(__linux__)
+#    include <pthread.h>
+#  endif
+#  define USE_WORKER_POOL_STD
+#else
+#  error "WorkerPool requires FreeRTOS tasks (ESP32) or std::thread"
+#endif
+
+namespace audio_tools {
+
+/**
+ * @brief Completion handle of a job which was submitted to a WorkerPool:
+ * wait() blocks (w/o polling) until the job has been executed. The object
+ * is provided by the caller and must be valid until the job is done. It can
+ * be reused for the next job.
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class WorkerFuture {
+ public:
+  WorkerFuture() {
+#ifdef USE_WORKER_POOL_RTOS
+    // the semaphore is available when there is no pending job
+    semaphore = xSemaphoreCreateBinaryStatic(&semaphore_buffer);
+    xSemaphoreGive(semaphore);
+#endif
+  }
+
+  /// Returns true when the job has been executed
+  bool isDone() {
+#ifdef USE_WORKER_POOL_RTOS
+    return uxSemaphoreGetCount(semaphore) > 0;
+#else
+    std::lock_guard<std::mutex> lock(mutex);
+    return is_done;
+#endif
+  }
+
+  /// Waits until the job has been executed
+  void wait() {
+#ifdef USE_WORKER_POOL_RTOS
+    xSemaphoreTake(semaphore, portMAX_DELAY);
+    xSemaphoreGive(semaphore);
+#else
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]() { return is_done; });
+#endif
+  }
+
+ protected:
+  friend class WorkerPool;
+#ifdef USE_WORKER_POOL_RTOS
+  SemaphoreHandle_t semaphore = nullptr;
+  StaticSemaphore_t semaphore_buffer;
+#else
+  bool is_done = true;
+  std::mutex mutex;
+  std::condition_variable condition;
+#endif
+
+  void reset() {
+#ifdef USE_WORKER_POOL_RTOS
+    xSemaphoreTake(semaphore, 0);
+#else
+    std::lock_guard<std::mutex> lock(mutex);
+    is_done = false;
+#endif
+  }
+
+  /// Signals the completion: the worker must not access the object afterwards
+  void setDone() {
+#ifdef USE_WORKER_POOL_RTOS
+    xSemaphoreGive(semaphore);
+#else
+    // notify with the lock, so that the waiting task can not release the
+    // object before we are done
+    std::lock_guard<std::mutex> lock(mutex);
+    is_done = true;
+    condition.notify_all();
+#endif
+  }
+};
+
+/**
+ * @brief Portable pool of workers which execute the submitted jobs: on the
+ * ESP32 the workers are FreeRTOS tasks and the jobs are passed by pointer
+ * through QueueRTOS queues, on the desktop we use std::thread with a mutex
+ * and condition variables. The workers can be pinned to a core.
+ *
+ * The job slots are preallocated in begin(): submit() blocks when all slots
+ * are in use. You can get informed about the completion with a WorkerFuture
+ * or with a callback, which is called in the context of the worker.
+ * @ingroup concurrency
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class WorkerPool {
+ public:
+  WorkerPool() = default;
+  ~WorkerPool() { end(); }
+
+  /// Defines the stack size of the tasks (ESP32 only)
+  void setStackSize(int size) { stack_size = size; }
+
+  /// Defines the priority of the tasks (ESP32 only)
+  void setPriority(int prio) { priority = prio; }
+
+  /// Pins all workers to the indicated core (-1 for no pinning)
+  void setCore(int core) { this->core = core; }
+
+  /// Starts the indicated number of workers with max queueSize pending jobs
+  bool begin(int workers = 2, int queueSize = 16) {
+    end();
+    if (workers <= 0 || queueSize <= 0) return false;
+    worker_count = workers;
+    jobs.resize(queueSize);
+#ifdef USE_WORKER_POOL_RTOS
+    free_jobs.resize(queueSize);
+    pending_jobs.resize(queueSize);
+    for (int j = 0; j < queueSize; j++) {
+      Job *job = &jobs[j];
+      free_jobs.enqueue(job);
+    }
+#else
+    free_jobs.clear();
+    pending_jobs.clear();
+    for (int j = 0; j < queueSize; j++) free_jobs.push_back(&jobs[j]);
+#endif
+    is_active = true;
+    tasks.resize(workers);
+    for (int j = 0; j < workers; j++) {
+      startWorker(j);
+    }
+    return true;
+  }
+
+  /// Waits for the pending jobs and stops the workers
+  void end() {
+    if (!is_active) return;
+    waitAll();
+#ifdef USE_WORKER_POOL_RTOS
+    is_active = false;
+    for (auto &task : tasks) {
+      task->remove();
+      delete task;
+    }
+#else
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      is_active = false;
+    }
+    job_available.notify_all();
+    for (auto &thread : tasks) {
+      if (thread->joinable()) thread->join();
+      delete thread;
+    }
+#endif
+    tasks.clear();
+  }
+
+  /// Submits a job: the optional future is signaled when the job is done
+  bool submit(std::function<void()> fn, WorkerFuture *future = nullptr) {
+    return submit(fn, nullptr, future);
+  }
+
+  /// Submits a job with a callback which is called when the job is done
+  bool submit(std::function<void()> fn, std::function<void()> onDone,
+              WorkerFuture *future = nullptr) {
+    if (!is_active) return false;
+    Job *job = acquireJob();
+    if (job == nullptr) return false;
+    job->fn = fn;
+    job->on_done = onDone;
+    job->p_future = future;
+    if (future != nullptr) future->reset();
+    pending_count++;
+    pushJob(job);
+    return true;
+  }
+
+  /// Waits until all submitted jobs have been executed
+  void waitAll() {
+#ifdef USE_WORKER_POOL_RTOS
+    while (pending_count.load() > 0) delay(1);
+#else
+    std::unique_lock<std::mutex> lock(mutex);
+    all_done.wait(lock, [this]() { return pending_count.load() == 0; });
+#endif
+  }
+
+  /// Number of jobs which have been submitted but are not done yet
+  int pending() { return pending_count.load(); }
+
+  /// Number of workers
+  int workers() { return worker_count; }
+
+ protected:
+  struct Job {
+    std::function<void()> fn;
+    std::function<void()> on_done;
+    WorkerFuture *p_future = nullptr;
+  };
+  Vector<Job> jobs{0};
+  std::atomic<int> pending_count{0};
+  std::atomic<bool> is_active{false};
+  int worker_count = 0;
+  int stack_size = 4096;
+  int priority = 1;
+  int core = -1;
+#ifdef USE_WORKER_POOL_RTOS
+  QueueRTOS<Job *> free_jobs{0, portMAX_DELAY, portMAX_DELAY};
+  QueueRTOS<Job *> pending_jobs{0, portMAX_DELAY, portMAX_DELAY};
+  Vector<Task *> tasks{0};
+#else
+  std::mutex mutex;
+  std::condition_variable job_available;
+  std::condition_variable slot_available;
+  std::condition_variable all_done;
+  Vector<Job *> free_jobs{0};
+  Vector<Job *> pending_jobs{0};
+  Vector<std::thread *> tasks{0};
+#endif
+
+  /// Executes the job and releases the slot
+  void execute(Job *job) {
+    job->fn();
+    if (job->on_done) job->on_done();
+    WorkerFuture *future = job->p_future;
+    job->fn = nullptr;
+    job->on_done = nullptr;
+    job->p_future = nullptr;
+    releaseJob(job);
+    if (future != nullptr) future->setDone();
+#ifdef USE_WORKER_POOL_STD
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--pending_count == 0) all_done.notify_all();
+#else
+    pending_count--;
+#endif
+  }
+
+#ifdef USE_WORKER_POOL_RTOS
+
+  void startWorker(int id) {
+    Task *task = new Task();
+    task->create("worker", stack_size, priority, core);
+    task->begin([this]() {
+      Job *job = nullptr;
+      if (pending_jobs.dequeue(job, portMAX_DELAY)) execute(job);
+    });
+    tasks[id] = task;
+  }
+
+  Job *acquireJob() {
+    Job *job = nullptr;
+    return free_jobs.dequeue(job, portMAX_DELAY) ? job : nullptr;
+  }
+
+  void releaseJob(Job *job) { free_jobs.enqueue(job); }
+
+  void pushJob(Job *job) { pending_jobs.enqueue(job); }
+
+#else
+
+  void startWorker(int id) {
+    tasks[id] = new std::thread([this]() {
+      while (true) {
+        Job *job = nullptr;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          job_available.wait(
+              lock, [this]() { return !is_active || !pending_jobs.empty(); });
+          if (pending_jobs.empty()) return;
+          job = pending_jobs[0];
+          pending_jobs.erase(0);
+        }
+        execute(job);
+      }
+    });
+#if defined(__linux__)
+    if (core >= 0) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(core, &cpuset);
+      pthread_setaffinity_np(tasks[id]->native_handle(), sizeof(cpu_set_t),
+                             &cpuset);
+    }
+#endif
+  }
+
+  Job *acquireJob() {
+    std::unique_lock<std::mutex> lock(mutex);
+    slot_available.wait(lock, [this]() { return !free_jobs.empty(); });
+    Job *job = free_jobs[free_jobs.size() - 1];
+    free_jobs.pop_back();
+    return job;
+  }
+
+  void releaseJob(Job *job) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      free_jobs.push_back(job);
+    }
+    slot_available.notify_one();
+  }
+
+  void pushJob(Job *job) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending_jobs.push_back(job);
+    }
+    job_available.notify_one();
+  }
+
+#endif
+};
+
+}  // namespace audio_tools
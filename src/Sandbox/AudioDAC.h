@@ -4,6 +4,20 @@
 #include "AudioTools/Buffers.h"
 #include "AudioTimer/AudioTimer.h"
 #include "AudioTools/AudioOutput.h"
+#include "AudioTools/AudioStreams.h"
+#if defined(ESP32) && ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "driver/rmt.h"
+#endif
+
+/// Number of PCM frames which are modulated in one block
+#ifndef SIGMA_DELTA_BLOCK_FRAMES
+#  define SIGMA_DELTA_BLOCK_FRAMES 32
+#endif
+
+/// Number of 32 bit words which are sent to the RMT in one block
+#ifndef RMT_DAC_BLOCK_WORDS
+#  define RMT_DAC_BLOCK_WORDS 32
+#endif
 
 namespace audio_tools {
 
@@ -167,7 +181,7 @@ class OversamplingDAC : public AudioOutput {
             }
             int samples = frames * info.channels;
             for (int j=0; j<samples; j++){
-                quantize(ptr[j], j % 2);
+                quantize(ptr[j], j % info.channels);
             }
             // return bytes
             return samples*2;
@@ -507,6 +521,214 @@ class SerialDAC : public OversamplingDAC32 {
         }
 };       
 
+/**
+ * @brief Sigma delta modulator which converts 16 bit PCM to a 1 bit stream
+ * in 32 bit words (MSB first): each PCM sample is converted to the
+ * oversample factor number of words. Instead of deciding bit by bit, the
+ * density of ones of a word is quantized to 33 levels and the word is taken
+ * from a lookup table with the evenly spread bit patterns; the quantization
+ * error is fed back to the next word (first order noise shaping at the word
+ * rate). Between two samples the value is interpolated linearly.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SigmaDeltaModulator {
+    public:
+        /// Defines the number of 32 bit words per sample
+        void setOversampleFactor(int factor) {
+            oversample_factor = factor < 1 ? 1 : factor;
+        }
+
+        int oversampleFactor() {
+            return oversample_factor;
+        }
+
+        /// Resets the state for the indicated number of channels
+        bool begin(int channels) {
+            this->channels = channels;
+            error.resize(channels);
+            last.resize(channels);
+            if ((int)last.size() != channels){
+                LOGE("not enough memory");
+                return false;
+            }
+            for (int ch=0; ch<channels; ch++){
+                error[ch] = 0;
+                last[ch] = 0x8000;
+            }
+            return true;
+        }
+
+        /// Converts one sample of the indicated channel to oversample factor words
+        void modulate(int16_t sample, int channel, uint32_t *out) {
+            const uint32_t *table = patternTable();
+            // density of ones in 1/65536
+            int32_t value = (int32_t)sample + 0x8000;
+            int32_t step = (value - last[channel]) / oversample_factor;
+            int32_t current = value - step * (oversample_factor - 1);
+            int32_t err = error[channel];
+            for (int j = 0; j < oversample_factor; j++) {
+                int32_t target = current + err;
+                int32_t level = (target + 1024) >> 11;
+                if (level < 0) level = 0;
+                if (level > 32) level = 32;
+                err = target - (level << 11);
+                out[j] = table[level];
+                current += step;
+            }
+            error[channel] = err;
+            last[channel] = value;
+        }
+
+        /// Converts interleaved frames: the words of each channel are
+        /// written to a separate block of frames * oversample factor words
+        size_t modulate(const int16_t *pcm, size_t frames, uint32_t *out) {
+            size_t words = frames * oversample_factor;
+            for (int ch = 0; ch < channels; ch++) {
+                uint32_t *dest = out + ch * words;
+                for (size_t j = 0; j < frames; j++) {
+                    modulate(pcm[j * channels + ch], ch, dest);
+                    dest += oversample_factor;
+                }
+            }
+            return words * channels;
+        }
+
+    protected:
+        int oversample_factor = 2;
+        int channels = 0;
+        Vector<int32_t> error{0};
+        Vector<int32_t> last{0};
+
+        /// Words with 0 to 32 evenly spread ones
+        static const uint32_t *patternTable() {
+            static uint32_t table[33] = {0};
+            static bool is_setup = false;
+            if (!is_setup) {
+                for (int level = 0; level <= 32; level++) {
+                    uint32_t bits = 0;
+                    for (int i = 0; i < 32; i++) {
+                        bits = bits << 1;
+                        bits |= ((i + 1) * level / 32) - (i * level / 32);
+                    }
+                    table[level] = bits;
+                }
+                is_setup = true;
+            }
+            return table;
+        }
+};
+
+/**
+ * @brief Sigma delta DAC which provides the 1 bit stream as 32 bit words to
+ * an output which clocks them out with DMA: e.g. an I2SStream with 32 bits,
+ * 2 channels and audioInfoOut().sample_rate. The data pin provides the 1 bit
+ * signal which just needs a RC low pass filter. The channels are mixed down
+ * to mono. So no timer and no cpu is needed to toggle the pin.
+ * @code
+ * I2SStream i2s;
+ * SigmaDeltaStream dac(i2s);
+ * dac.begin(AudioInfo(44100, 2, 16));
+ * auto cfg = i2s.defaultConfig(TX_MODE);
+ * cfg.copyFrom(dac.audioInfoOut());
+ * i2s.begin(cfg);
+ * @endcode
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SigmaDeltaStream : public AudioStream {
+    public:
+        SigmaDeltaStream() = default;
+        SigmaDeltaStream(Print &out) {
+            setOutput(out);
+        }
+
+        void setOutput(Print &out) {
+            p_print = &out;
+        }
+
+        /// Defines the number of 32 bit words per sample: must be even (default 2)
+        void setOversampleFactor(int factor) {
+            modulator.setOversampleFactor(factor);
+        }
+
+        bool begin(AudioInfo info) {
+            setAudioInfo(info);
+            return begin();
+        }
+
+        bool begin() override {
+            if (info.bits_per_sample != 16) {
+                LOGE("Only 16 Bits per sample are supported - you requested %d", info.bits_per_sample);
+                return false;
+            }
+            if (modulator.oversampleFactor() % 2 != 0) {
+                LOGE("oversample factor must be even");
+                return false;
+            }
+            return modulator.begin(1);
+        }
+
+        /// Format of the generated 32 bit words
+        AudioInfo audioInfoOut() override {
+            AudioInfo out;
+            out.sample_rate = info.sample_rate * modulator.oversampleFactor() / 2;
+            out.channels = 2;
+            out.bits_per_sample = 32;
+            return out;
+        }
+
+        /// Bits per second of the 1 bit stream
+        uint32_t outputBitRate() {
+            return (uint32_t)info.sample_rate * modulator.oversampleFactor() * 32;
+        }
+
+        size_t write(const uint8_t *data, size_t len) override {
+            int channels = info.channels;
+            if (channels <= 0) return 0;
+            const int16_t *pcm = (const int16_t *)data;
+            size_t frames = len / (sizeof(int16_t) * channels);
+            int16_t mono[SIGMA_DELTA_BLOCK_FRAMES];
+            uint32_t words[SIGMA_DELTA_BLOCK_FRAMES * modulator.oversampleFactor()];
+            for (size_t pos = 0; pos < frames; pos += SIGMA_DELTA_BLOCK_FRAMES) {
+                int n = min(frames - pos, (size_t)SIGMA_DELTA_BLOCK_FRAMES);
+                for (int j = 0; j < n; j++) {
+                    const int16_t *frame = pcm + (pos + j) * channels;
+                    int32_t sum = 0;
+                    for (int ch = 0; ch < channels; ch++) sum += frame[ch];
+                    mono[j] = sum / channels;
+                }
+                size_t count = modulator.modulate(mono, n, words);
+                writeWords(words, count);
+            }
+            return frames * sizeof(int16_t) * channels;
+        }
+
+        int availableForWrite() override {
+            if (p_print == nullptr) return DEFAULT_BUFFER_SIZE;
+            // each frame results in oversample factor words
+            int words = p_print->availableForWrite() / sizeof(uint32_t);
+            return words / modulator.oversampleFactor() * sizeof(int16_t) * info.channels;
+        }
+
+    protected:
+        Print *p_print = nullptr;
+        SigmaDeltaModulator modulator;
+
+        /// Outputs the modulated words
+        virtual void writeWords(const uint32_t *words, size_t count) {
+            if (p_print == nullptr) return;
+            const uint8_t *data = (const uint8_t *)words;
+            size_t len = count * sizeof(uint32_t);
+            size_t result = 0;
+            while (result < len) {
+                size_t written = p_print->write(data + result, len - result);
+                if (written == 0) break;
+                result += written;
+            }
+        }
+};
+
 #ifdef USE_DELTASIGMA
 
 /**
@@ -531,6 +753,9 @@ class DeltaSigmaDAC : public OversamplingDAC32 {
         bool begin(DACInfo cfg) override {
             TRACED();
             cfg.logInfo(true);
+            modulator.setOversampleFactor(cfg.oversample_factor);
+            if (!modulator.begin(cfg.channels)) return false;
+            words.resize(cfg.channels * cfg.oversample_factor);
             // default processing
             return OversamplingDAC::begin(cfg);
         }
@@ -541,28 +766,151 @@ class DeltaSigmaDAC : public OversamplingDAC32 {
 
 
     protected:
-        /// updates the buffer with delta sigma values
+        SigmaDeltaModulator modulator;
+        // words of the actual frame: oversample_factor for each channel
+        Vector<uint32_t> words{0};
+
+        size_t availableFramesToWrite() override {
+            // each frame needs oversample_factor words per channel
+            return buffer.availableForWrite() / (info.channels * info.oversample_factor);
+        }
+
+        /// updates the buffer with delta sigma values: the words are written
+        /// interleaved when the last channel of the frame has been provided
         virtual void quantize(int16_t newSamp, int left_right_idx) override {
-            // Don't need lastSamp anymore, store this one for next round
-            last_values[left_right_idx] = newSamp;
+            const int factor = info.oversample_factor;
+            modulator.modulate(newSamp, left_right_idx, words.data() + left_right_idx * factor);
+            if (left_right_idx == info.channels - 1) {
+                for (int j = 0; j < factor; j++) {
+                    for (int ch = 0; ch < info.channels; ch++) {
+                        buffer.write(words[ch * factor + j]);
+                    }
+                }
+            }
+        }
+};
 
-            // How much the comparison signal changes each oversample step
-            int32_t diffPerStep = (newSamp - last_values[left_right_idx]) >> (4 + info.oversample_factor);
-            for (int j = 0; j < info.oversample_factor; j++) {
-                uint32_t bits = 0; // The bits we convert the sample into, MSB to go on the wire first
-                
-                for (int i = 32; i > 0; i--) {
-                    bits = bits << 1;
-                    if (cummulated_error[left_right_idx] < 0) {
-                        bits |= 1;
-                        cummulated_error[left_right_idx] += fixedPosValue - newSamp;
-                    } else {
-                        // Bits[0] = 0 handled already by left shift
-                        cummulated_error[left_right_idx] -= fixedPosValue + newSamp;
+#endif
+
+#if defined(ESP32) && ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+
+/**
+ * @brief Sigma delta DAC which clocks out the 1 bit stream on any pin with
+ * the RMT peripheral of the ESP32: one RMT tick is one bit, so each RMT item
+ * holds 2 bits. The items are taken byte wise from a lookup table and are
+ * written in blocks of RMT_DAC_BLOCK_WORDS words alternating between 2
+ * buffers, which are refilled into the RMT memory by the driver. The bit
+ * rate is derived from the 80 MHz APB clock with an integer divider, so the
+ * effective sample rate might deviate slightly.
+ * @code
+ * SigmaDeltaRMTStream dac(26);
+ * dac.begin(AudioInfo(22050, 1, 16));
+ * @endcode
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class SigmaDeltaRMTStream : public SigmaDeltaStream {
+    public:
+        SigmaDeltaRMTStream(int pin = PIN_PWM_START, rmt_channel_t channel = RMT_CHANNEL_0) {
+            this->pin = pin;
+            this->channel = channel;
+        }
+
+        ~SigmaDeltaRMTStream() {
+            end();
+        }
+
+        /// Number of RMT memory blocks of 64 items (default 2)
+        void setMemoryBlocks(int blocks) {
+            mem_blocks = blocks;
+        }
+
+        bool begin() override {
+            end();
+            if (!SigmaDeltaStream::begin()) return false;
+            uint32_t bit_rate = outputBitRate();
+            uint32_t div = (APB_CLK_FREQ + bit_rate / 2) / bit_rate;
+            if (div < 1) div = 1;
+            if (div > 255) div = 255;
+            rmt_config_t cfg = RMT_DEFAULT_CONFIG_TX((gpio_num_t)pin, channel);
+            cfg.clk_div = div;
+            cfg.mem_block_num = mem_blocks;
+            cfg.tx_config.idle_output_en = true;
+            cfg.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+            if (rmt_config(&cfg) != ESP_OK || rmt_driver_install(channel, 0, 0) != ESP_OK) {
+                LOGE("RMT setup failed");
+                return false;
+            }
+            LOGI("bit rate: %u (requested %u)", (unsigned)(APB_CLK_FREQ / div), (unsigned)bit_rate);
+            for (int j = 0; j < 2; j++) {
+                items[j].resize(RMT_DAC_BLOCK_WORDS * 16);
+            }
+            is_installed = true;
+            return true;
+        }
+
+        void end() override {
+            if (!is_installed) return;
+            rmt_wait_tx_done(channel, portMAX_DELAY);
+            rmt_driver_uninstall(channel);
+            for (int j = 0; j < 2; j++) {
+                items[j].resize(0);
+            }
+            is_installed = false;
+        }
+
+        int availableForWrite() override {
+            return DEFAULT_BUFFER_SIZE;
+        }
+
+    protected:
+        int pin;
+        rmt_channel_t channel;
+        int mem_blocks = 2;
+        bool is_installed = false;
+        Vector<rmt_item32_t> items[2] = {Vector<rmt_item32_t>{0}, Vector<rmt_item32_t>{0}};
+        int items_idx = 0;
+
+        /// 4 items (of 2 bits each) for each byte: MSB first
+        static const uint32_t *itemTable() {
+            static uint32_t table[256 * 4] = {0};
+            static bool is_setup = false;
+            if (!is_setup) {
+                for (int value = 0; value < 256; value++) {
+                    for (int j = 0; j < 4; j++) {
+                        rmt_item32_t item;
+                        item.duration0 = 1;
+                        item.level0 = (value >> (7 - j * 2)) & 1;
+                        item.duration1 = 1;
+                        item.level1 = (value >> (6 - j * 2)) & 1;
+                        table[value * 4 + j] = item.val;
                     }
-                    newSamp += diffPerStep; // Move the reference signal towards destination
-                }                
-                buffer.write(bits);
+                }
+                is_setup = true;
+            }
+            return table;
+        }
+
+        /// Translates the words to items: the transmission of the previous
+        /// buffer must be complete before it is reused, which is ensured by
+        /// rmt_write_items()
+        void writeWords(const uint32_t *words, size_t count) override {
+            if (!is_installed) return;
+            const uint32_t *table = itemTable();
+            while (count > 0) {
+                int n = min(count, (size_t)RMT_DAC_BLOCK_WORDS);
+                uint32_t *dest = (uint32_t *)items[items_idx].data();
+                for (int j = 0; j < n; j++) {
+                    uint32_t word = words[j];
+                    for (int shift = 24; shift >= 0; shift -= 8) {
+                        memcpy(dest, table + ((word >> shift) & 0xFF) * 4, 4 * sizeof(uint32_t));
+                        dest += 4;
+                    }
+                }
+                rmt_write_items(channel, items[items_idx].data(), n * 16, false);
+                items_idx = 1 - items_idx;
+                words += n;
+                count -= n;
             }
         }
 };
@@ -3,6 +3,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "AudioTools/AudioLogger.h"
+#include "Concurrency/RingBufferLockFree.h"
+
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTYPES
 //--------------------------------------------------------------------+
@@ -11,6 +14,21 @@
 #define AUDIO_SAMPLE_RATE 48000
 #endif
 
+/// Number of channels of the speaker and the microphone
+#ifndef USB_AUDIO_CHANNELS
+#define USB_AUDIO_CHANNELS 2
+#endif
+
+/// Bytes per sample: 2 or 4
+#ifndef USB_AUDIO_BYTES_PER_SAMPLE
+#define USB_AUDIO_BYTES_PER_SAMPLE 2
+#endif
+
+/// Size of the ring buffers which are shared with I2S in ms
+#ifndef USB_AUDIO_BUFFER_MS
+#define USB_AUDIO_BUFFER_MS 16
+#endif
+
 //--------------------------------------------------------------------+
 // Board Specific Configuration
 //--------------------------------------------------------------------+
@@ -32,7 +50,9 @@
 // defined by compiler flags for flexibility
 #ifndef CFG_TUSB_MCU
 #ifdef ESP32
-#define CFG_TUSB_MCU OPT_MCU_ESP32S2
+#define CFG_TUSB_MCU OPT_MCU_ESP32S3
+#elif defined(ARDUINO_ARCH_RP2040)
+#define CFG_TUSB_MCU OPT_MCU_RP2040
 #else
 #error CFG_TUSB_MCU must be defined
 #endif
@@ -53,9 +73,6 @@
 // Default is max speed that hardware controller could support with on-chip PHY
 #define CFG_TUD_MAX_SPEED BOARD_TUD_MAX_SPEED
 
-// CFG_TUSB_DEBUG is defined by compiler in DEBUG build
-// #define CFG_TUSB_DEBUG           0
-
 /* USB DMA on some MCUs can only access a specific SRAM region with restriction
  * on alignment. Tinyusb use follows macros to declare transferring memory so
  * that they can be put into those specific section. e.g
@@ -92,39 +109,29 @@
 // AUDIO CLASS DRIVER CONFIGURATION
 //--------------------------------------------------------------------
 
-// Have a look into audio_device.h for all configurations
+// UAC2 headset: speaker (isochronous OUT with asynchronous feedback
+// endpoint) and microphone (asynchronous isochronous IN)
+#define USB_AUDIO_FRAME_SIZE (USB_AUDIO_CHANNELS * USB_AUDIO_BYTES_PER_SAMPLE)
+// one additional frame per packet is needed for the asynchronous adjustment
+#define USB_AUDIO_EP_SIZE ((AUDIO_SAMPLE_RATE / 1000 + 1) * USB_AUDIO_FRAME_SIZE)
+
+#define CFG_TUD_AUDIO_FUNC_1_DESC_LEN USB_AUDIO_HEADSET_DESC_LEN
+// AS interfaces: speaker and microphone
+#define CFG_TUD_AUDIO_FUNC_1_N_AS_INT 2
+#define CFG_TUD_AUDIO_FUNC_1_CTRL_BUF_SZ 64
 
-#define CFG_TUD_AUDIO_FUNC_1_DESC_LEN TUD_AUDIO_MIC_ONE_CH_DESC_LEN
-#define CFG_TUD_AUDIO_FUNC_1_N_AS_INT                                          \
-  1 // Number of Standard AS Interface Descriptors (4.9.1) defined per audio
-    // function - this is required to be able to remember the current alternate
-    // settings of these interfaces - We restrict us here to have a constant
-    // number for all audio functions (which means this has to be the maximum
-    // number of AS interfaces an audio function has and a second audio function
-    // with less AS interfaces just wastes a few bytes)
-#define CFG_TUD_AUDIO_FUNC_1_CTRL_BUF_SZ 64 // Size of control request buffer
+#define CFG_TUD_AUDIO_ENABLE_EP_OUT 1
+#define CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP 1
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_RX USB_AUDIO_BYTES_PER_SAMPLE
+#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX USB_AUDIO_CHANNELS
+#define CFG_TUD_AUDIO_FUNC_1_EP_OUT_SZ_MAX USB_AUDIO_EP_SIZE
+#define CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ (4 * USB_AUDIO_EP_SIZE)
 
 #define CFG_TUD_AUDIO_ENABLE_EP_IN 1
-#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX                             \
-  2 // Driver gets this info from the descriptors - we define it here to use it
-    // to setup the descriptors and to do calculations with it below
-#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX                                     \
-  1 // Driver gets this info from the descriptors - we define it here to use it
-    // to setup the descriptors and to do calculations with it below - be aware:
-    // for different number of channels you need another descriptor!
-#define CFG_TUD_AUDIO_EP_SZ_IN                                                 \
-  (48 + 1) *                                                                   \
-      CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX *                             \
-          CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX // 48 Samples (48 kHz) x 2
-                                             // Bytes/Sample x
-                                             // CFG_TUD_AUDIO_N_CHANNELS_TX
-                                             // Channels - One extra sample is
-                                             // needed for asynchronous transfer
-                                             // adjustment, see feedback EP
-#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX                                      \
-  CFG_TUD_AUDIO_EP_SZ_IN // Maximum EP IN size for all AS alternate settings
-                         // used
-#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ CFG_TUD_AUDIO_EP_SZ_IN + 1
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX USB_AUDIO_BYTES_PER_SAMPLE
+#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX USB_AUDIO_CHANNELS
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX USB_AUDIO_EP_SIZE
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ (4 * USB_AUDIO_EP_SIZE)
 
 /* A combination of interfaces must have a unique product id, since PC will save
  * device driver after the first plug. Same VID/PID with different interface e.g
@@ -180,10 +187,20 @@ uint8_t const *tud_descriptor_device_cb(void) {
 //--------------------------------------------------------------------+
 // Configuration Descriptor
 //--------------------------------------------------------------------+
-enum { ITF_NUM_AUDIO_CONTROL = 0, ITF_NUM_AUDIO_STREAMING, ITF_NUM_TOTAL };
+enum {
+  ITF_NUM_AUDIO_CONTROL = 0,
+  ITF_NUM_AUDIO_STREAMING_SPK,
+  ITF_NUM_AUDIO_STREAMING_MIC,
+  ITF_NUM_TOTAL
+};
 
-#define CONFIG_TOTAL_LEN                                                       \
-  (TUD_CONFIG_DESC_LEN + CFG_TUD_AUDIO * TUD_AUDIO_MIC_ONE_CH_DESC_LEN)
+// Unit and terminal ids
+#define UAC2_ENTITY_SPK_INPUT_TERMINAL 0x01
+#define UAC2_ENTITY_SPK_FEATURE_UNIT 0x02
+#define UAC2_ENTITY_SPK_OUTPUT_TERMINAL 0x03
+#define UAC2_ENTITY_CLOCK 0x04
+#define UAC2_ENTITY_MIC_INPUT_TERMINAL 0x11
+#define UAC2_ENTITY_MIC_OUTPUT_TERMINAL 0x13
 
 #if CFG_TUSB_MCU == OPT_MCU_LPC175X_6X ||                                      \
     CFG_TUSB_MCU == OPT_MCU_LPC177X_8X || CFG_TUSB_MCU == OPT_MCU_LPC40XX
@@ -198,18 +215,114 @@ enum { ITF_NUM_AUDIO_CONTROL = 0, ITF_NUM_AUDIO_STREAMING, ITF_NUM_TOTAL };
 #else
 #define EPNUM_AUDIO 0x01
 #endif
+#define EPNUM_AUDIO_FB (EPNUM_AUDIO + 1)
+
+// the size parameter of the feedback endpoint was added with TinyUSB 0.16
+#if defined(TUSB_VERSION_MINOR) && TUSB_VERSION_MINOR >= 16
+#define USB_AUDIO_DESC_FB_EP(_ep) TUD_AUDIO_DESC_STD_AS_ISO_FB_EP(_ep, 4, 1)
+#else
+#define USB_AUDIO_DESC_FB_EP(_ep) TUD_AUDIO_DESC_STD_AS_ISO_FB_EP(_ep, 1)
+#endif
+
+#define USB_AUDIO_AC_ENTITIES_LEN                                              \
+  (TUD_AUDIO_DESC_CLK_SRC_LEN + 2 * TUD_AUDIO_DESC_INPUT_TERM_LEN +            \
+   2 * TUD_AUDIO_DESC_OUTPUT_TERM_LEN +                                        \
+   TUD_AUDIO_DESC_FEATURE_UNIT_TWO_CHANNEL_LEN)
+
+#define USB_AUDIO_HEADSET_DESC_LEN                                             \
+  (TUD_AUDIO_DESC_IAD_LEN + TUD_AUDIO_DESC_STD_AC_LEN +                        \
+   TUD_AUDIO_DESC_CS_AC_LEN + USB_AUDIO_AC_ENTITIES_LEN +                      \
+   /* speaker */                                                               \
+   2 * TUD_AUDIO_DESC_STD_AS_INT_LEN + TUD_AUDIO_DESC_CS_AS_INT_LEN +          \
+   TUD_AUDIO_DESC_TYPE_I_FORMAT_LEN + TUD_AUDIO_DESC_STD_AS_ISO_EP_LEN +       \
+   TUD_AUDIO_DESC_CS_AS_ISO_EP_LEN + TUD_AUDIO_DESC_STD_AS_ISO_FB_EP_LEN +     \
+   /* microphone */                                                            \
+   2 * TUD_AUDIO_DESC_STD_AS_INT_LEN + TUD_AUDIO_DESC_CS_AS_INT_LEN +          \
+   TUD_AUDIO_DESC_TYPE_I_FORMAT_LEN + TUD_AUDIO_DESC_STD_AS_ISO_EP_LEN +       \
+   TUD_AUDIO_DESC_CS_AS_ISO_EP_LEN)
+
+#define CONFIG_TOTAL_LEN                                                       \
+  (TUD_CONFIG_DESC_LEN + CFG_TUD_AUDIO * USB_AUDIO_HEADSET_DESC_LEN)
+
+#define USB_AUDIO_ISO_ASYNC                                                    \
+  (uint8_t)((uint8_t)TUSB_XFER_ISOCHRONOUS |                                   \
+            (uint8_t)TUSB_ISO_EP_ATT_ASYNCHRONOUS |                            \
+            (uint8_t)TUSB_ISO_EP_ATT_DATA)
+
+#define USB_AUDIO_FU_CTRL                                                      \
+  (AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_MUTE_POS |                         \
+   AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_VOLUME_POS)
 
 uint8_t const desc_configuration[] = {
     // Config number, interface count, string index, total length, attribute,
     // power in mA
     TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0x00, 100),
 
-    // Interface number, string index, EP Out & EP In address, EP size
-    TUD_AUDIO_MIC_ONE_CH_DESCRIPTOR(
-        /*_itfnum*/ ITF_NUM_AUDIO_CONTROL, /*_stridx*/ 0,
-        /*_nBytesPerSample*/ CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX,
-        /*_nBitsUsedPerSample*/ CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX * 8,
-        /*_epin*/ 0x80 | EPNUM_AUDIO, /*_epsize*/ CFG_TUD_AUDIO_EP_SZ_IN)};
+    // Audio function with 3 interfaces
+    TUD_AUDIO_DESC_IAD(ITF_NUM_AUDIO_CONTROL, ITF_NUM_TOTAL, 0x00),
+    TUD_AUDIO_DESC_STD_AC(ITF_NUM_AUDIO_CONTROL, 0x00, 0x04),
+    TUD_AUDIO_DESC_CS_AC(0x0200, AUDIO_FUNC_HEADSET, USB_AUDIO_AC_ENTITIES_LEN,
+                         AUDIO_CS_AS_INTERFACE_CTRL_LATENCY_POS),
+    // internal fixed clock which is driven by I2S
+    TUD_AUDIO_DESC_CLK_SRC(UAC2_ENTITY_CLOCK, AUDIO_CLOCK_SOURCE_ATT_INT_FIX_CLK,
+                           (AUDIO_CTRL_R << AUDIO_CLOCK_SOURCE_CTRL_CLK_FRQ_POS),
+                           0x00, 0x00),
+    // speaker: USB streaming -> feature unit -> speaker
+    TUD_AUDIO_DESC_INPUT_TERM(UAC2_ENTITY_SPK_INPUT_TERMINAL,
+                              AUDIO_TERM_TYPE_USB_STREAMING, 0x00,
+                              UAC2_ENTITY_CLOCK, USB_AUDIO_CHANNELS,
+                              AUDIO_CHANNEL_CONFIG_NON_PREDEFINED, 0x00, 0x00,
+                              0x00),
+    TUD_AUDIO_DESC_FEATURE_UNIT_TWO_CHANNEL(
+        UAC2_ENTITY_SPK_FEATURE_UNIT, UAC2_ENTITY_SPK_INPUT_TERMINAL,
+        USB_AUDIO_FU_CTRL, USB_AUDIO_FU_CTRL, USB_AUDIO_FU_CTRL, 0x00),
+    TUD_AUDIO_DESC_OUTPUT_TERM(UAC2_ENTITY_SPK_OUTPUT_TERMINAL,
+                               AUDIO_TERM_TYPE_OUT_GENERIC_SPEAKER, 0x00,
+                               UAC2_ENTITY_SPK_FEATURE_UNIT, UAC2_ENTITY_CLOCK,
+                               0x0000, 0x00),
+    // microphone: microphone -> USB streaming
+    TUD_AUDIO_DESC_INPUT_TERM(UAC2_ENTITY_MIC_INPUT_TERMINAL,
+                              AUDIO_TERM_TYPE_IN_GENERIC_MIC, 0x00,
+                              UAC2_ENTITY_CLOCK, USB_AUDIO_CHANNELS,
+                              AUDIO_CHANNEL_CONFIG_NON_PREDEFINED, 0x00, 0x00,
+                              0x00),
+    TUD_AUDIO_DESC_OUTPUT_TERM(UAC2_ENTITY_MIC_OUTPUT_TERMINAL,
+                               AUDIO_TERM_TYPE_USB_STREAMING, 0x00,
+                               UAC2_ENTITY_MIC_INPUT_TERMINAL,
+                               UAC2_ENTITY_CLOCK, 0x0000, 0x00),
+
+    // speaker streaming interface: alternate 0 has no bandwidth
+    TUD_AUDIO_DESC_STD_AS_INT(ITF_NUM_AUDIO_STREAMING_SPK, 0x00, 0x00, 0x00),
+    TUD_AUDIO_DESC_STD_AS_INT(ITF_NUM_AUDIO_STREAMING_SPK, 0x01, 0x02, 0x00),
+    TUD_AUDIO_DESC_CS_AS_INT(UAC2_ENTITY_SPK_INPUT_TERMINAL, AUDIO_CTRL_NONE,
+                             AUDIO_FORMAT_TYPE_I, AUDIO_DATA_FORMAT_TYPE_I_PCM,
+                             USB_AUDIO_CHANNELS,
+                             AUDIO_CHANNEL_CONFIG_NON_PREDEFINED, 0x00),
+    TUD_AUDIO_DESC_TYPE_I_FORMAT(USB_AUDIO_BYTES_PER_SAMPLE,
+                                 USB_AUDIO_BYTES_PER_SAMPLE * 8),
+    TUD_AUDIO_DESC_STD_AS_ISO_EP(EPNUM_AUDIO, USB_AUDIO_ISO_ASYNC,
+                                 USB_AUDIO_EP_SIZE, 0x01),
+    TUD_AUDIO_DESC_CS_AS_ISO_EP(AUDIO_CS_AS_ISO_DATA_EP_ATT_NON_MAX_PACKETS_OK,
+                                AUDIO_CTRL_NONE,
+                                AUDIO_CS_AS_ISO_DATA_EP_LOCK_DELAY_UNIT_UNDEFINED,
+                                0x0000),
+    USB_AUDIO_DESC_FB_EP(0x80 | EPNUM_AUDIO_FB),
+
+    // microphone streaming interface
+    TUD_AUDIO_DESC_STD_AS_INT(ITF_NUM_AUDIO_STREAMING_MIC, 0x00, 0x00, 0x00),
+    TUD_AUDIO_DESC_STD_AS_INT(ITF_NUM_AUDIO_STREAMING_MIC, 0x01, 0x01, 0x00),
+    TUD_AUDIO_DESC_CS_AS_INT(UAC2_ENTITY_MIC_OUTPUT_TERMINAL, AUDIO_CTRL_NONE,
+                             AUDIO_FORMAT_TYPE_I, AUDIO_DATA_FORMAT_TYPE_I_PCM,
+                             USB_AUDIO_CHANNELS,
+                             AUDIO_CHANNEL_CONFIG_NON_PREDEFINED, 0x00),
+    TUD_AUDIO_DESC_TYPE_I_FORMAT(USB_AUDIO_BYTES_PER_SAMPLE,
+                                 USB_AUDIO_BYTES_PER_SAMPLE * 8),
+    TUD_AUDIO_DESC_STD_AS_ISO_EP(0x80 | EPNUM_AUDIO, USB_AUDIO_ISO_ASYNC,
+                                 USB_AUDIO_EP_SIZE, 0x01),
+    TUD_AUDIO_DESC_CS_AS_ISO_EP(AUDIO_CS_AS_ISO_DATA_EP_ATT_NON_MAX_PACKETS_OK,
+                                AUDIO_CTRL_NONE,
+                                AUDIO_CS_AS_ISO_DATA_EP_LOCK_DELAY_UNIT_UNDEFINED,
+                                0x0000)};
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
 // Application return pointer to descriptor
@@ -227,7 +340,7 @@ uint8_t const *tud_descriptor_configuration_cb(uint8_t index) {
 char const *string_desc_arr[] = {
     (const char[]){0x09, 0x04}, // 0: is supported language is English (0x0409)
     "PaniRCorp",                // 1: Manufacturer
-    "MicNode",                  // 2: Product
+    "AudioTools",               // 2: Product
     "123456",                   // 3: Serials, should use chip ID
     "UAC2",                     // 4: Audio Interface
 };
@@ -269,58 +382,117 @@ uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
   return _desc_str;
 }
 
-/* Blink pattern
- * - 250 ms  : device not mounted
- * - 1000 ms : device mounted
- * - 2500 ms : device is suspended
+/**
+ * @brief Asynchronous feedback for the isochronous OUT endpoint: we report
+ * the number of samples per USB frame (1 ms) in 16.16 format. The nominal
+ * value is corrected by the deviation of the fill level of the ring buffer
+ * (which is consumed by I2S) from its target, so that the host follows the
+ * I2S clock and we do not need any resampling.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
  */
-enum {
-  BLINK_NOT_MOUNTED = 250,
-  BLINK_MOUNTED = 1000,
-  BLINK_SUSPENDED = 2500,
+class USBAudioFeedback {
+ public:
+  /// Defines the sample rate and the target fill level in frames
+  void begin(uint32_t sampleRate, int targetFrames) {
+    nominal = (sampleRate << 16) / 1000;
+    target = targetFrames;
+    fill_avg = targetFrames;
+    integral = 0;
+    value = nominal;
+  }
+
+  /// Updates the feedback with the actual fill level in frames (called once
+  /// per USB frame) and returns the value in 16.16 format
+  uint32_t update(int fillFrames) {
+    // smoothing over about 64 ms: the fill level changes in packets
+    fill_avg += (fillFrames - fill_avg) / 64.0f;
+    // PI controller: 1 frame of deviation changes the rate by 1 sample/s;
+    // the integral compensates the static clock difference
+    float error = (target - fill_avg) * 65.536f;
+    float max_correction = nominal / 200.0f;  // max 0.5%
+    integral = clamp(integral + error / 1000.0f, max_correction);
+    value = nominal + (int32_t)clamp(error + integral, max_correction);
+    return value;
+  }
+
+  /// Last feedback value in 16.16 format
+  uint32_t feedback() { return value; }
+
+  /// Nominal samples per USB frame in 16.16 format
+  uint32_t nominalValue() { return nominal; }
+
+ protected:
+  uint32_t nominal = 48 << 16;
+  uint32_t value = 48 << 16;
+  int target = 0;
+  float fill_avg = 0;
+  float integral = 0;
+
+  float clamp(float value, float limit) {
+    if (value > limit) return limit;
+    if (value < -limit) return -limit;
+    return value;
+  }
 };
 
-static uint32_t blink_interval_ms = BLINK_NOT_MOUNTED;
-static int channels = 2;
-static uint8_t bytesPerSample;
-static Stream *p_in = nullptr;
-static Print *p_out = nullptr;
+static uint8_t bytesPerSample = USB_AUDIO_BYTES_PER_SAMPLE;
 
 // Audio controls
 // Current states
-bool mute[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1]; // +1 for master channel 0
-uint16_t
-    volume[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1]; // +1 for master channel 0
+bool mute[USB_AUDIO_CHANNELS + 1];       // +1 for master channel 0
+int16_t volume[USB_AUDIO_CHANNELS + 1];  // +1 for master channel 0
 uint32_t sampFreq;
 uint8_t clkValid;
 
 // Range states
-audio_control_range_2_n_t(
-    1) volumeRng[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1]; // Volume range state
 audio_control_range_4_n_t(1) sampleFreqRng; // Sample frequency range state
 
-// Audio test data
-uint16_t test_buffer_audio[(CFG_TUD_AUDIO_EP_SZ_IN - 2) / 2];
-uint16_t startVal = 0;
-
-void led_blinking_task(void);
-void audio_task(void);
-
-/*------------- MAIN -------------*/
+class AudioUSB;
+static AudioUSB *p_audio_usb = nullptr;
+
+/**
+ * @brief USB Audio Class 2 device (headset) with TinyUSB for the ESP32-S3
+ * and RP2040: the speaker data is received with an isochronous OUT endpoint
+ * and the microphone data is sent with an isochronous IN endpoint. The
+ * device clock is the I2S clock: the asynchronous feedback endpoint reports
+ * the rate which is derived from the fill level of the speaker ring buffer,
+ * so that there is no drift and no resampling. The microphone packets are
+ * sized based on the fill level of the microphone ring buffer.
+ *
+ * The USB packets are copied directly into (and from) the lock free ring
+ * buffers which are shared with the I2S DMA callbacks:
+ * @code
+ * AudioUSB usb;
+ * usb.begin(info);
+ * i2s.driver()->setDMACallbackTX(AudioUSB::dmaCallbackTX, &usb);
+ * i2s.driver()->setDMACallbackRX(AudioUSB::dmaCallbackRX, &usb);
+ * // in loop(): usb.copy();
+ * @endcode
+ * Alternatively you can use the speakerBuffer() and microphoneBuffer()
+ * directly.
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
 class AudioUSB {
 public:
-  AudioUSB(Stream &in) {
-    p_in = &in;
-    p_out = &in;
-  }
-  AudioUSB(Print &out) { p_out = &out; }
-  void begin(AudioInfo cfg) {
-    this->info = cfg;
-    channels = cfg.channels;
-    // board_init();
+  AudioUSB() { p_audio_usb = this; }
 
-    // init device stack on configured roothub port
-    tud_init(BOARD_TUD_RHPORT);
+  bool begin(AudioInfo cfg) {
+    if (cfg.channels != USB_AUDIO_CHANNELS ||
+        cfg.bits_per_sample != USB_AUDIO_BYTES_PER_SAMPLE * 8) {
+      LOGE("Only %d channels with %d bits are supported", USB_AUDIO_CHANNELS,
+           USB_AUDIO_BYTES_PER_SAMPLE * 8);
+      return false;
+    }
+    this->info = cfg;
+    p_audio_usb = this;
+    int frames = cfg.sample_rate * USB_AUDIO_BUFFER_MS / 1000;
+    speaker.resize(frames * USB_AUDIO_FRAME_SIZE);
+    microphone.resize(frames * USB_AUDIO_FRAME_SIZE);
+    target_frames = speaker.size() / USB_AUDIO_FRAME_SIZE / 2;
+    feedback.begin(cfg.sample_rate, target_frames);
+    underflow_count = overflow_count = 0;
 
     // Init values
     sampFreq = cfg.sample_rate;
@@ -330,47 +502,149 @@ public:
     sampleFreqRng.subrange[0].bMin = cfg.sample_rate;
     sampleFreqRng.subrange[0].bMax = cfg.sample_rate;
     sampleFreqRng.subrange[0].bRes = 0;
+
+    // init device stack on configured roothub port
+    return tud_init(BOARD_TUD_RHPORT);
+  }
+
+  /// Executes the tinyusb device task
+  void copy() { tud_task(); }
+
+  /// Ring buffer with the received speaker data which is consumed by I2S
+  RingBufferLockFree<uint8_t> &speakerBuffer() { return speaker; }
+
+  /// Ring buffer with the microphone data which is filled by I2S
+  RingBufferLockFree<uint8_t> &microphoneBuffer() { return microphone; }
+
+  /// I2S TX DMA callback: provides the speaker data
+  static void dmaCallbackTX(uint8_t *data, size_t len, void *ref) {
+    ((AudioUSB *)ref)->readSpeaker(data, len);
+  }
+
+  /// I2S RX DMA callback: adds the microphone data
+  static void dmaCallbackRX(const uint8_t *data, size_t len, void *ref) {
+    ((AudioUSB *)ref)->writeMicrophone(data, len);
+  }
+
+  /// Copies the speaker data to the indicated (DMA) buffer: missing data is
+  /// replaced by silence
+  void readSpeaker(uint8_t *data, size_t len) {
+    int n = speaker.readArray(data, len);
+    if (n < (int)len) {
+      memset(data + n, 0, len - n);
+      if (is_speaker_active) underflow_count++;
+    }
+  }
+
+  /// Adds the microphone data from the indicated (DMA) buffer
+  void writeMicrophone(const uint8_t *data, size_t len) {
+    if (microphone.writeArray(data, len) < (int)len) overflow_count++;
+  }
+
+  /// Actual feedback value in samples per ms in 16.16 format
+  uint32_t feedbackValue() { return feedback.feedback(); }
+
+  /// Number of I2S buffers which could not be filled completely
+  uint32_t underflows() { return underflow_count; }
+
+  /// Number of I2S buffers which did not fit into the microphone buffer
+  uint32_t overflows() { return overflow_count; }
+
+  /// Called by tinyusb: moves the received packet into the speaker buffer
+  void receiveSpeaker(uint16_t len) {
+    int open = len;
+    while (open > 0) {
+      int n = min(open, (int)speaker.writePtrSize());
+      if (n == 0) {
+        // buffer full: discard the rest
+        uint8_t tmp[64];
+        n = tud_audio_read(tmp, min(open, 64));
+        if (n == 0) break;
+      } else {
+        n = tud_audio_read(speaker.writePtr(), n);
+        if (n == 0) break;
+        speaker.commitWrite(n);
+      }
+      open -= n;
+    }
+    tud_audio_fb_set(feedback.update(speaker.available() / USB_AUDIO_FRAME_SIZE));
+  }
+
+  /// Called by tinyusb: provides the next microphone packet. We send one
+  /// frame more or less than the nominal size to keep the fill level.
+  void sendMicrophone() {
+    int frames = info.sample_rate / 1000;
+    int fill = microphone.available() / USB_AUDIO_FRAME_SIZE;
+    if (fill > 2 * target_frames - frames) frames++;
+    else if (fill < frames) frames--;
+    int open = min(frames, fill) * USB_AUDIO_FRAME_SIZE;
+    while (open > 0) {
+      int n = min(open, (int)microphone.readPtrSize());
+      if (n == 0) break;
+      tud_audio_write(microphone.readPtr(), n);
+      microphone.consume(n);
+      open -= n;
+    }
   }
 
-  void copy() {
-    tud_task(); // tinyusb device task
-    led_blinking_task();
-    audio_task();
+  void setSpeakerActive(bool active) {
+    is_speaker_active = active;
+    if (active) feedback.begin(info.sample_rate, target_frames);
   }
 
 protected:
   AudioInfo info;
+  RingBufferLockFree<uint8_t> speaker{0};
+  RingBufferLockFree<uint8_t> microphone{0};
+  USBAudioFeedback feedback;
+  int target_frames = 0;
+  bool is_speaker_active = false;
+  uint32_t underflow_count = 0;
+  uint32_t overflow_count = 0;
 };
 
 //--------------------------------------------------------------------+
-// Device callbacks
+// AUDIO Callbacks
 //--------------------------------------------------------------------+
 
-// Invoked when device is mounted
-void tud_mount_cb(void) { blink_interval_ms = BLINK_MOUNTED; }
-
-// Invoked when device is unmounted
-void tud_umount_cb(void) { blink_interval_ms = BLINK_NOT_MOUNTED; }
-
-// Invoked when usb bus is suspended
-// remote_wakeup_en : if host allow us  to perform remote wakeup
-// Within 7ms, device must draw an average of current less than 2.5 mA from
-// bus
-void tud_suspend_cb(bool remote_wakeup_en) {
-  (void)remote_wakeup_en;
-  blink_interval_ms = BLINK_SUSPENDED;
+bool tud_audio_rx_done_pre_read_cb(uint8_t rhport, uint16_t n_bytes_received,
+                                   uint8_t func_id, uint8_t ep_out,
+                                   uint8_t cur_alt_setting) {
+  (void)rhport;
+  (void)func_id;
+  (void)ep_out;
+  (void)cur_alt_setting;
+  if (p_audio_usb != nullptr) p_audio_usb->receiveSpeaker(n_bytes_received);
+  return true;
 }
 
-// Invoked when usb bus is resumed
-void tud_resume_cb(void) { blink_interval_ms = BLINK_MOUNTED; }
+bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t itf, uint8_t ep_in,
+                                   uint8_t cur_alt_setting) {
+  (void)rhport;
+  (void)itf;
+  (void)ep_in;
+  (void)cur_alt_setting;
+  if (p_audio_usb != nullptr) p_audio_usb->sendMicrophone();
+  return true;
+}
 
-//--------------------------------------------------------------------+
-// AUDIO Task
-//--------------------------------------------------------------------+
+bool tud_audio_set_itf_cb(uint8_t rhport,
+                          tusb_control_request_t const *p_request) {
+  (void)rhport;
+  uint8_t const itf = tu_u16_low(tu_le16toh(p_request->wIndex));
+  uint8_t const alt = tu_u16_low(tu_le16toh(p_request->wValue));
+  if (itf == ITF_NUM_AUDIO_STREAMING_SPK && p_audio_usb != nullptr)
+    p_audio_usb->setSpeakerActive(alt != 0);
+  return true;
+}
 
-void audio_task(void) {
-  // Yet to be filled - e.g. put meas data into TX FIFOs etc.
-  // asm("nop");
+bool tud_audio_set_itf_close_EP_cb(uint8_t rhport,
+                                   tusb_control_request_t const *p_request) {
+  (void)rhport;
+  uint8_t const itf = tu_u16_low(tu_le16toh(p_request->wIndex));
+  if (itf == ITF_NUM_AUDIO_STREAMING_SPK && p_audio_usb != nullptr)
+    p_audio_usb->setSpeakerActive(false);
+  return true;
 }
 
 //--------------------------------------------------------------------+
@@ -383,20 +657,7 @@ bool tud_audio_set_req_ep_cb(uint8_t rhport,
                              uint8_t *pBuff) {
   (void)rhport;
   (void)pBuff;
-
-  // We do not support any set range requests here, only current value
-  // requests
-  TU_VERIFY(p_request->bRequest == AUDIO_CS_REQ_CUR);
-
-  // Page 91 in UAC2 specification
-  uint8_t channelNum = TU_U16_LOW(p_request->wValue);
-  uint8_t ctrlSel = TU_U16_HIGH(p_request->wValue);
-  uint8_t ep = TU_U16_LOW(p_request->wIndex);
-
-  (void)channelNum;
-  (void)ctrlSel;
-  (void)ep;
-
+  (void)p_request;
   return false; // Yet not implemented
 }
 
@@ -406,20 +667,7 @@ bool tud_audio_set_req_itf_cb(uint8_t rhport,
                               uint8_t *pBuff) {
   (void)rhport;
   (void)pBuff;
-
-  // We do not support any set range requests here, only current value
-  // requests
-  TU_VERIFY(p_request->bRequest == AUDIO_CS_REQ_CUR);
-
-  // Page 91 in UAC2 specification
-  uint8_t channelNum = TU_U16_LOW(p_request->wValue);
-  uint8_t ctrlSel = TU_U16_HIGH(p_request->wValue);
-  uint8_t itf = TU_U16_LOW(p_request->wIndex);
-
-  (void)channelNum;
-  (void)ctrlSel;
-  (void)itf;
-
+  (void)p_request;
   return false; // Yet not implemented
 }
 
@@ -432,41 +680,30 @@ bool tud_audio_set_req_entity_cb(uint8_t rhport,
   // Page 91 in UAC2 specification
   uint8_t channelNum = TU_U16_LOW(p_request->wValue);
   uint8_t ctrlSel = TU_U16_HIGH(p_request->wValue);
-  uint8_t itf = TU_U16_LOW(p_request->wIndex);
   uint8_t entityID = TU_U16_HIGH(p_request->wIndex);
 
-  (void)itf;
-
   // We do not support any set range requests here, only current value
   // requests
   TU_VERIFY(p_request->bRequest == AUDIO_CS_REQ_CUR);
+  TU_VERIFY(channelNum <= USB_AUDIO_CHANNELS);
 
   // If request is for our feature unit
-  if (entityID == 2) {
+  if (entityID == UAC2_ENTITY_SPK_FEATURE_UNIT) {
     switch (ctrlSel) {
     case AUDIO_FU_CTRL_MUTE:
       // Request uses format layout 1
       TU_VERIFY(p_request->wLength == sizeof(audio_control_cur_1_t));
-
       mute[channelNum] = ((audio_control_cur_1_t *)pBuff)->bCur;
-
-      TU_LOG2("    Set Mute: %d of channel: %u\r\n", mute[channelNum],
-              channelNum);
       return true;
 
     case AUDIO_FU_CTRL_VOLUME:
       // Request uses format layout 2
       TU_VERIFY(p_request->wLength == sizeof(audio_control_cur_2_t));
-
-      volume[channelNum] = (uint16_t)((audio_control_cur_2_t *)pBuff)->bCur;
-
-      TU_LOG2("    Set Volume: %d dB of channel: %u\r\n", volume[channelNum],
-              channelNum);
+      volume[channelNum] = (int16_t)((audio_control_cur_2_t *)pBuff)->bCur;
       return true;
 
       // Unknown/Unsupported control
     default:
-      TU_BREAKPOINT();
       return false;
     }
   }
@@ -477,18 +714,7 @@ bool tud_audio_set_req_entity_cb(uint8_t rhport,
 bool tud_audio_get_req_ep_cb(uint8_t rhport,
                              tusb_control_request_t const *p_request) {
   (void)rhport;
-
-  // Page 91 in UAC2 specification
-  uint8_t channelNum = TU_U16_LOW(p_request->wValue);
-  uint8_t ctrlSel = TU_U16_HIGH(p_request->wValue);
-  uint8_t ep = TU_U16_LOW(p_request->wIndex);
-
-  (void)channelNum;
-  (void)ctrlSel;
-  (void)ep;
-
-  //	return tud_control_xfer(rhport, p_request, &tmp, 1);
-
+  (void)p_request;
   return false; // Yet not implemented
 }
 
@@ -496,16 +722,7 @@ bool tud_audio_get_req_ep_cb(uint8_t rhport,
 bool tud_audio_get_req_itf_cb(uint8_t rhport,
                               tusb_control_request_t const *p_request) {
   (void)rhport;
-
-  // Page 91 in UAC2 specification
-  uint8_t channelNum = TU_U16_LOW(p_request->wValue);
-  uint8_t ctrlSel = TU_U16_HIGH(p_request->wValue);
-  uint8_t itf = TU_U16_LOW(p_request->wIndex);
-
-  (void)channelNum;
-  (void)ctrlSel;
-  (void)itf;
-
+  (void)p_request;
   return false; // Yet not implemented
 }
 
@@ -517,111 +734,94 @@ bool tud_audio_get_req_entity_cb(uint8_t rhport,
   // Page 91 in UAC2 specification
   uint8_t channelNum = TU_U16_LOW(p_request->wValue);
   uint8_t ctrlSel = TU_U16_HIGH(p_request->wValue);
-  // uint8_t itf = TU_U16_LOW(p_request->wIndex); 			// Since
-  // we have only one audio function implemented, we do not need the itf value
+  // Since we have only one audio function implemented, we do not need the
+  // itf value
   uint8_t entityID = TU_U16_HIGH(p_request->wIndex);
+  TU_VERIFY(channelNum <= USB_AUDIO_CHANNELS);
 
-  // Input terminal (Microphone input)
-  if (entityID == 1) {
+  // Input terminals
+  if (entityID == UAC2_ENTITY_SPK_INPUT_TERMINAL ||
+      entityID == UAC2_ENTITY_MIC_INPUT_TERMINAL) {
     switch (ctrlSel) {
     case AUDIO_TE_CTRL_CONNECTOR: {
       // The terminal connector control only has a get request with only the
       // CUR attribute.
       audio_desc_channel_cluster_t ret;
-
-      // Those are dummy values for now
-      ret.bNrChannels = channels;
+      ret.bNrChannels = USB_AUDIO_CHANNELS;
       ret.bmChannelConfig = (audio_channel_config_t)0;
       ret.iChannelNames = 0;
-
-      TU_LOG2("    Get terminal connector\r\n");
-
       return tud_audio_buffer_and_schedule_control_xfer(
           rhport, p_request, (void *)&ret, sizeof(ret));
     } break;
 
       // Unknown/Unsupported control selector
     default:
-      TU_BREAKPOINT();
       return false;
     }
   }
 
   // Feature unit
-  if (entityID == 2) {
+  if (entityID == UAC2_ENTITY_SPK_FEATURE_UNIT) {
     switch (ctrlSel) {
     case AUDIO_FU_CTRL_MUTE:
       // Audio control mute cur parameter block consists of only one byte - we
       // thus can send it right away There does not exist a range parameter
       // block for mute
-      TU_LOG2("    Get Mute of channel: %u\r\n", channelNum);
       return tud_control_xfer(rhport, p_request, &mute[channelNum], 1);
 
     case AUDIO_FU_CTRL_VOLUME:
       switch (p_request->bRequest) {
       case AUDIO_CS_REQ_CUR:
-        TU_LOG2("    Get Volume of channel: %u\r\n", channelNum);
         return tud_control_xfer(rhport, p_request, &volume[channelNum],
                                 sizeof(volume[channelNum]));
 
-      case AUDIO_CS_REQ_RANGE:
-        TU_LOG2("    Get Volume range of channel: %u\r\n", channelNum);
-
-        // Copy values - only for testing - better is version below
+      case AUDIO_CS_REQ_RANGE: {
         audio_control_range_2_n_t(1) ret;
-
         ret.wNumSubRanges = 1;
-        ret.subrange[0].bMin = -90; // -90 dB
-        ret.subrange[0].bMax = 90;  // +90 dB
-        ret.subrange[0].bRes = 1;   // 1 dB steps
-
+        ret.subrange[0].bMin = -90 * 256; // -90 dB in 1/256 dB
+        ret.subrange[0].bMax = 0;         // 0 dB
+        ret.subrange[0].bRes = 256;       // 1 dB steps
         return tud_audio_buffer_and_schedule_control_xfer(
             rhport, p_request, (void *)&ret, sizeof(ret));
+      }
 
         // Unknown/Unsupported control
       default:
-        TU_BREAKPOINT();
         return false;
       }
       break;
 
       // Unknown/Unsupported control
     default:
-      TU_BREAKPOINT();
       return false;
     }
   }
 
   // Clock Source unit
-  if (entityID == 4) {
+  if (entityID == UAC2_ENTITY_CLOCK) {
     switch (ctrlSel) {
     case AUDIO_CS_CTRL_SAM_FREQ:
       // channelNum is always zero in this case
       switch (p_request->bRequest) {
       case AUDIO_CS_REQ_CUR:
-        TU_LOG2("    Get Sample Freq.\r\n");
         return tud_control_xfer(rhport, p_request, &sampFreq, sizeof(sampFreq));
 
       case AUDIO_CS_REQ_RANGE:
-        TU_LOG2("    Get Sample Freq. range\r\n");
         return tud_control_xfer(rhport, p_request, &sampleFreqRng,
                                 sizeof(sampleFreqRng));
 
         // Unknown/Unsupported control
       default:
-        TU_BREAKPOINT();
         return false;
       }
       break;
 
     case AUDIO_CS_CTRL_CLK_VALID:
       // Only cur attribute exists for this request
-      TU_LOG2("    Get Sample Freq. valid\r\n");
       return tud_control_xfer(rhport, p_request, &clkValid, sizeof(clkValid));
 
     // Unknown/Unsupported control
     default:
-      TU_BREAKPOINT();
       return false;
     }
   }
@@ -630,81 +830,4 @@ bool tud_audio_get_req_entity_cb(uint8_t rhport,
   return false; // Yet not implemented
 }
 
-bool tud_audio_tx_done_pre_load_cb(uint8_t rhport, uint8_t itf, uint8_t ep_in,
-                                   uint8_t cur_alt_setting) {
-  (void)rhport;
-  (void)itf;
-  (void)ep_in;
-  (void)cur_alt_setting;
-
-  tud_audio_write((uint8_t *)test_buffer_audio, CFG_TUD_AUDIO_EP_SZ_IN - 2);
-
-  return true;
-}
-
-bool tud_audio_tx_done_post_load_cb(uint8_t rhport, uint16_t n_bytes_copied,
-                                    uint8_t itf, uint8_t ep_in,
-                                    uint8_t cur_alt_setting) {
-  (void)rhport;
-  (void)n_bytes_copied;
-  (void)itf;
-  (void)ep_in;
-  (void)cur_alt_setting;
-
-  //   for (size_t cnt = 0; cnt < (CFG_TUD_AUDIO_EP_SZ_IN - 2) / 2; cnt++) {
-  //     test_buffer_audio[cnt] = startVal++;
-  //   }
-  if (p_in != nullptr) {
-    p_in->readBytes((uint8_t *)test_buffer_audio, CFG_TUD_AUDIO_EP_SZ_IN - 2);
-  } else {
-    memset(test_buffer_audio, 0, CFG_TUD_AUDIO_EP_SZ_IN - 2);
-  }
-
-  return true;
-}
-
-bool tud_audio_rx_done_pre_read_cb(uint8_t rhport, uint16_t n_bytes_received, uint8_t func_id, uint8_t ep_out, uint8_t cur_alt_setting)
-{
-    (void)rhport;
-    (void)func_id;
-    (void)ep_out;
-    (void)cur_alt_setting;
-
-    //free-running, adjust myself to match pace
-    bytes_read = tud_audio_read(test_buffer_audio, CFG_TUD_AUDIO_EP_SZ_IN - 2);     //read from USB, write to buffer
-    if (p_print!=nullptr){
-      p_print->write(usb_spk_buf, bytes_read);
-    }
-
-    return true;
-}
-
-
-bool tud_audio_set_itf_close_EP_cb(uint8_t rhport,
-                                   tusb_control_request_t const *p_request) {
-  (void)rhport;
-  (void)p_request;
-  startVal = 0;
-
-  return true;
-}
-
-//--------------------------------------------------------------------+
-// BLINKING TASK
-//--------------------------------------------------------------------+
-void led_blinking_task(void) {
-#ifdef PIN_LED
-  static uint32_t start_ms = 0;
-  static bool led_state = false;
-
-  // Blink every interval ms
-  if (millis() - start_ms < blink_interval_ms)
-    return; // not enough time
-  start_ms += blink_interval_ms;
-
-  digitalWrite(PIN_LED, led_state);
-  led_state = 1 - led_state; // toggle
-#endif
-}
-
-} // namespace audio_tools
\ No newline at end of file
+} // namespace audio_tools
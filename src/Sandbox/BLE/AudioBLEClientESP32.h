@@ -2,6 +2,7 @@
 
 #include "AudioBLEStream.h"
 #include "ConstantsESP32.h"
+#include "Concurrency/RingBufferLockFree.h"
 //#include <BLE2902.h>
 #include <BLEDevice.h>
 #include <BLEServer.h>
@@ -34,6 +35,10 @@ public:
     TRACEI();
     // Init BLE device
     BLEDevice::init(localName);
+#if defined(CONFIG_BT_BLE_50_FEATURES_SUPPORTED)
+    esp_ble_gap_set_preferred_default_phy(ESP_BLE_GAP_PHY_2M_PREF_MASK,
+                                          ESP_BLE_GAP_PHY_2M_PREF_MASK);
+#endif
 
     // Retrieve a Scanner and set the callback we want to use to be informed
     // when we have detected a new device.
@@ -55,6 +60,12 @@ public:
     setupBLEClient();
     if (!is_client_connected || !is_client_set_up)
       return 0;
+    // data received via notifications
+    if (is_notify) {
+      size_t result = receive_buffer.readArray(data, len);
+      grantCredits();
+      return result;
+    }
     if (!ch01_char->canRead())
       return 0;
     // changed to auto to be version independent (it changed from std::string to
@@ -66,7 +77,10 @@ public:
     return str.length();
   }
 
-  int available() override { return BLE_MTU - BLE_MTU_OVERHEAD; }
+  int available() override {
+    if (is_notify) return receive_buffer.available();
+    return BLE_MTU - BLE_MTU_OVERHEAD;
+  }
 
   size_t write(const uint8_t *data, size_t len) override {
     TRACED();
@@ -81,9 +95,10 @@ public:
       writeChannel2Characteristic(data, len);
       delay(1);
     } else {
-      // send only data with max mtu
-      for (int j=0; j<len; j++){
-        write_buffer.write(data[j]);
+      // coalesce the data up to the negotiated mtu
+      size_t pos = 0;
+      while (pos < len) {
+        pos += write_buffer.writeArray(data + pos, len - pos);
         if (write_buffer.isFull()){
           writeChannel2Characteristic(write_buffer.data(), write_buffer.available());
           write_buffer.reset();
@@ -93,6 +108,14 @@ public:
     return len;
   }
 
+  /// Sends the remaining coalesced data
+  void flush() override {
+    if (is_client_set_up && write_buffer.available() > 0) {
+      writeChannel2Characteristic(write_buffer.data(), write_buffer.available());
+      write_buffer.reset();
+    }
+  }
+
   int availableForWrite() override { 
     return is_framed ? (BLE_MTU - BLE_MTU_OVERHEAD) : DEFAULT_BUFFER_SIZE; 
   }
@@ -121,12 +144,19 @@ protected:
   BLERemoteCharacteristic *ch01_char = nullptr; // read
   BLERemoteCharacteristic *ch02_char = nullptr; // write
   BLERemoteCharacteristic *info_char = nullptr;
+  BLERemoteCharacteristic *credit_char = nullptr;
   BLEAdvertisedDevice advertised_device;
   BLEUUID BLUEID_AUDIO_SERVICE_UUID{BLE_AUDIO_SERVICE_UUID};
   BLEUUID BLUEID_CH1_UUID{BLE_CH1_UUID};
   BLEUUID BLUEID_CH2_UUID{BLE_CH2_UUID};
   BLEUUID BLUEID_INFO_UUID{BLE_INFO_UUID};
+  BLEUUID BLUEID_CREDIT_UUID{BLE_CREDIT_UUID};
   SingleBuffer<uint8_t> write_buffer{0};
+  // filled by the notifications in the BLE task
+  RingBufferLockFree<uint8_t> receive_buffer{0};
+  // notifications which were received and granted
+  std::atomic<uint32_t> received_count{0};
+  uint32_t granted_count = 0;
   int write_throttle = 0;
   bool write_confirmation_flag = false;
 
@@ -184,10 +214,36 @@ protected:
 
   static void notifyCallback(BLERemoteCharacteristic *pBLERemoteCharacteristic,
                              uint8_t *pData, size_t length, bool isNotify) {
-    TRACEI();
-    if (pBLERemoteCharacteristic->getUUID().toString() ==
-        selfAudioBLEClient->BLE_INFO_UUID) {
+    TRACED();
+    auto uuid = pBLERemoteCharacteristic->getUUID().toString();
+    if (uuid == selfAudioBLEClient->BLE_INFO_UUID) {
       selfAudioBLEClient->setAudioInfo(pData, length);
+    } else if (uuid == selfAudioBLEClient->BLE_CH1_UUID) {
+      // we never get more data then we granted credits for
+      selfAudioBLEClient->receive_buffer.writeArray(pData, length);
+      selfAudioBLEClient->received_count++;
+    }
+  }
+
+  /// Payload of a notification or write
+  int payloadSize() { return max_transfer_size - BLE_MTU_OVERHEAD; }
+
+  /// Sends the additional credits to the server
+  void writeCredits(uint16_t count) {
+    if (credit_char == nullptr || count == 0) return;
+    uint8_t value[2] = {(uint8_t)(count & 0xFF), (uint8_t)(count >> 8)};
+    credit_char->writeValue(value, 2, false);
+  }
+
+  /// Grants the credits for the free space in the receive buffer
+  void grantCredits() {
+    int outstanding = granted_count - received_count.load();
+    int possible = receive_buffer.availableForWrite() / payloadSize();
+    int grant = possible - outstanding;
+    // we grant the credits in batches to reduce the overhead
+    if (grant >= 4 || (grant > 0 && outstanding == 0)) {
+      writeCredits(grant);
+      granted_count += grant;
     }
   }
 
@@ -197,11 +253,6 @@ protected:
 
     TRACEI();
 
-    // setup buffer
-    if (write_buffer.size()==0){
-      write_buffer.resize(getMTU() - BLE_MTU_OVERHEAD);
-    }
-
     if (p_client == nullptr)
       p_client = BLEDevice::createClient();
 
@@ -223,6 +274,16 @@ protected:
     LOGI("Setting mtu to %d", max_transfer_size);
     assert(max_transfer_size > 0);
     p_client->setMTU(max_transfer_size);
+    // use the negotiated mtu
+    if (p_client->getMTU() > 0) {
+      max_transfer_size = std::min((int)max_transfer_size, (int)p_client->getMTU());
+    }
+    LOGI("Negotiated mtu: %d", max_transfer_size);
+
+    // setup buffer
+    if (write_buffer.size() != (size_t)payloadSize()){
+      write_buffer.resize(payloadSize());
+    }
 
     // Obtain a reference to the service we are after in the remote BLE
     // server.
@@ -260,13 +321,33 @@ protected:
       readAudioInfoCharacteristic();
 
     }
+    if (is_notify && !setupNotify()) {
+      return false;
+    }
     LOGI("Connected to server: %s", is_client_connected ? "true" : "false");
     is_client_set_up = true;
     is_client_connected = true;
     return is_client_connected;
   }
 
-  int getMTU() override { return BLE_MTU; }
+  int getMTU() override { return max_transfer_size; }
+
+  /// Subscribes to the notifications and grants the initial credits
+  bool setupNotify() {
+    if (credit_char == nullptr) {
+      credit_char = p_remote_service->getCharacteristic(BLUEID_CREDIT_UUID);
+      if (credit_char == nullptr) {
+        LOGE("Failed to find char. UUID: %s", BLE_CREDIT_UUID);
+        return false;
+      }
+    }
+    if (receive_buffer.size() == 0) receive_buffer.resize(RX_BUFFER_SIZE);
+    ch01_char->registerForNotify(notifyCallback);
+    received_count = 0;
+    granted_count = 0;
+    grantCredits();
+    return true;
+  }
 
 
 };
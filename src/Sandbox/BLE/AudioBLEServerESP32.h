@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
+
 #include "AudioBLEStream.h"
 #include "ConstantsESP32.h"
-//#include <BLE2902.h>
+#include <BLE2902.h>
 #include <BLEDevice.h>
 #include <BLEServer.h>
 #include <BLEUtils.h>
@@ -20,13 +22,23 @@ class AudioBLEServer : public AudioBLEStream,
                        public BLECharacteristicCallbacks,
                        public BLEServerCallbacks {
 public:
-  AudioBLEServer(int mtu = BLE_MTU) : AudioBLEStream(mtu) {}
+  AudioBLEServer(int mtu = BLE_MTU) : AudioBLEStream(mtu) {
+    requested_mtu = mtu;
+    // determined after the negotiation with the client
+    max_transfer_size = 0;
+  }
 
   // starts a BLE server with the indicated name
   bool begin(const char *name) {
     TRACEI();
     ble_server_name = name;
     BLEDevice::init(name);
+    // MTU which is requested in the negotiation
+    BLEDevice::setMTU(requested_mtu);
+#if defined(CONFIG_BT_BLE_50_FEATURES_SUPPORTED)
+    esp_ble_gap_set_preferred_default_phy(ESP_BLE_GAP_PHY_2M_PREF_MASK,
+                                          ESP_BLE_GAP_PHY_2M_PREF_MASK);
+#endif
 
     p_server = BLEDevice::createServer();
     p_server->setCallbacks(this);
@@ -61,10 +73,19 @@ public:
     if (!connected()) {
       return 0;
     }
+    setupTXBuffer();
     if (is_framed && availableForWrite() < dataSize) {
       return 0;
     }
-    return transmit_buffer.writeArray(data, dataSize);
+    size_t result = transmit_buffer.writeArray(data, dataSize);
+    if (is_framed) transmit_buffer_sizes.write(result);
+    if (is_notify) sendNotifications(false);
+    return result;
+  }
+
+  /// Sends the remaining data as notification
+  void flush() override {
+    if (is_notify) sendNotifications(true);
   }
 
   int availableForWrite() override {
@@ -84,6 +105,7 @@ protected:
   BLECharacteristic *ch01_char;
   BLECharacteristic *ch02_char;
   BLECharacteristic *info_char;
+  BLECharacteristic *credit_char = nullptr;
   BLEDescriptor ch01_desc{"2901"};
   BLEDescriptor ch02_desc{"2901"};
   BLEDescriptor info_desc{"2901"};
@@ -91,6 +113,9 @@ protected:
   RingBuffer<uint16_t> receive_sizes{0};
   RingBuffer<uint8_t> transmit_buffer{0};
   RingBuffer<uint16_t> transmit_buffer_sizes{0};
+  uint16_t requested_mtu = BLE_MTU;
+  // number of notifications which the client can accept
+  std::atomic<int> credits{0};
 
   virtual void receiveAudio(const uint8_t *data, size_t size) {
     while (receive_buffer.availableForWrite() < size) {
@@ -111,16 +136,45 @@ protected:
     info_char->notify();
   }
 
+  /// Provides the negotiated MTU
   int getMTU() override {
     TRACED();
-    if (max_transfer_size == 0) {
-      int peer_max_transfer_size =
-          p_server->getPeerMTU(p_server->getConnId()) - BLE_MTU_OVERHEAD;
-      max_transfer_size = std::min(BLE_MTU - BLE_MTU, peer_max_transfer_size);
+    if (max_transfer_size == 0 && p_server->getConnectedCount() > 0) {
+      int peer_mtu = p_server->getPeerMTU(p_server->getConnId());
+      if (peer_mtu > 0) {
+        max_transfer_size = std::min((int)requested_mtu, peer_mtu);
+        LOGI("max_transfer_size: %d", max_transfer_size);
+      }
+    }
+    return max_transfer_size > 0 ? max_transfer_size : BLE_DEFAULT_MTU;
+  }
 
-      LOGI("max_transfer_size: %d", max_transfer_size);
+  /// Sends the buffered data coalesced up to the MTU as long as the client
+  /// has credits: partial packets are only sent if requested
+  void sendNotifications(bool partial) {
+    int payload = getMTU() - BLE_MTU_OVERHEAD;
+    uint8_t tmp[payload];
+    while (credits.load() > 0 && connected()) {
+      int len = 0;
+      if (is_framed) {
+        if (transmit_buffer_sizes.available() == 0) break;
+        len = transmit_buffer_sizes.peek();
+        if (len > payload) {
+          LOGE("frame too big for mtu: %d", len);
+          transmit_buffer_sizes.read();
+          transmit_buffer.clearArray(len);
+          continue;
+        }
+        transmit_buffer_sizes.read();
+      } else {
+        len = std::min(payload, transmit_buffer.available());
+        if (len == 0 || (len < payload && !partial)) break;
+      }
+      transmit_buffer.readArray(tmp, len);
+      ch01_char->setValue(tmp, len);
+      ch01_char->notify();
+      credits--;
     }
-    return max_transfer_size;
   }
 
   void setupBLEService() {
@@ -130,12 +184,22 @@ protected:
     if (p_service == nullptr) {
       p_service = p_server->createService(BLE_AUDIO_SERVICE_UUID);
 
-      ch01_char = p_service->createCharacteristic(
-          BLE_CH1_UUID, BLECharacteristic::PROPERTY_READ );
+      uint32_t ch01_properties = BLECharacteristic::PROPERTY_READ;
+      if (is_notify) ch01_properties |= BLECharacteristic::PROPERTY_NOTIFY;
+      ch01_char = p_service->createCharacteristic(BLE_CH1_UUID, ch01_properties);
       ch01_desc.setValue("Channel 1");
       ch01_char->addDescriptor(&ch01_desc);
+      if (is_notify) ch01_char->addDescriptor(new BLE2902());
       ch01_char->setCallbacks(this);
 
+      // the client grants the notifications which it can accept
+      if (is_notify) {
+        credit_char = p_service->createCharacteristic(
+            BLE_CREDIT_UUID, BLECharacteristic::PROPERTY_WRITE |
+                                 BLECharacteristic::PROPERTY_WRITE_NR);
+        credit_char->setCallbacks(this);
+      }
+
       ch02_char = p_service->createCharacteristic(
           BLE_CH2_UUID, BLECharacteristic::PROPERTY_WRITE);
       ch02_desc.setValue("Channel 2");
@@ -168,21 +232,37 @@ protected:
 
   void onConnect(BLEServer *pServer) override {
     TRACEI();
+    // renegotiate the mtu and wait for the credits of the new client
+    max_transfer_size = 0;
+    credits = 0;
   }
 
   void onDisconnect(BLEServer *pServer) override {
     TRACEI();
+    credits = 0;
     BLEDevice::startAdvertising();
   }
 
+  void onMtuChanged(BLEServer *pServer,
+                    esp_ble_gatts_cb_param_t *param) override {
+    TRACEI();
+    max_transfer_size = 0;
+  }
+
   /// store the next batch of data
   void onWrite(BLECharacteristic *pCharacteristic) override {
     TRACED();
     setupRXBuffer();
     // changed to auto to be version independent (it changed from std::string to String)
     auto value = pCharacteristic->getValue();
-    if (pCharacteristic->getUUID().toString() == BLE_INFO_UUID) {
+    auto uuid = pCharacteristic->getUUID().toString();
+    if (uuid == BLE_INFO_UUID) {
       setAudioInfo((uint8_t *)&value[0], value.length());
+    } else if (uuid == BLE_CREDIT_UUID) {
+      // little endian uint16 with the additional credits
+      if (value.length() >= 2) {
+        credits += (uint8_t)value[0] | ((uint8_t)value[1] << 8);
+      }
     } else {
       receiveAudio((uint8_t *)&value[0], value.length());
     }
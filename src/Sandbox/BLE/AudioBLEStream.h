@@ -12,7 +12,12 @@ namespace audio_tools {
  * @brief Transmit and receive data via BLE using a Serial API.
  * The following additional experimental features are offered:
  * setFramed(true) tries to keep the original write sizes;
- * setAudioInfoActive(true) informs about changes in the audio info
+ * setAudioInfoActive(true) informs about changes in the audio info;
+ * setNotify(true) sends the data as notifications which are coalesced up to
+ * the negotiated MTU with a credit based flow control (this must be set on
+ * both sides).
+ * To reduce the data rate, wrap the stream with an EncodedAudioStream using
+ * the SBC or LC3 codec (CodecSBC.h, CodecLC3.h) in framed mode.
  */
 
 class AudioBLEStream : public AudioStream {
@@ -45,6 +50,11 @@ public:
 
   void setFramed(bool flag) { is_framed = flag; }
 
+  /// Sends the data as notifications with credit based flow control
+  void setNotify(bool flag) { is_notify = flag; }
+
+  void setCreditUUID(const char *uuid) { BLE_CREDIT_UUID = uuid; }
+
   Str toStr(AudioInfo info) {
     snprintf(audio_info_str, 40, "%d:%d:%d", info.sample_rate, info.channels,
             info.bits_per_sample);
@@ -67,6 +77,7 @@ protected:
   bool is_started = false;
   bool is_audio_info_active = false;
   bool is_framed = false;
+  bool is_notify = false;
   char audio_info_str[40];
 
   // Bluetooth LE GATT UUIDs for the Nordic UART profile Change UUID here if
@@ -75,6 +86,8 @@ protected:
   const char *BLE_CH1_UUID = "6e400002-b5a3-f393-e0a9-e50e24dcca9e"; // RX
   const char *BLE_CH2_UUID = "6e400003-b5a3-f393-e0a9-e50e24dcca9e"; // TX
   const char *BLE_INFO_UUID = "6e400004-b5a3-f393-e0a9-e50e24dcca9e";
+  // receiver grants the number of notifications it can accept
+  const char *BLE_CREDIT_UUID = "6e400005-b5a3-f393-e0a9-e50e24dcca9e";
 
   virtual int getMTU() = 0;
 
@@ -3,6 +3,8 @@
 // must be greater than MTU, less than ESP_GATT_MAX_ATTR_LEN
 #define BLE_MTU 517
 #define BLE_MTU_OVERHEAD 5
+// MTU before the negotiation
+#define BLE_DEFAULT_MTU 23
 #define RX_BUFFER_SIZE 4096
 #define RX_COUNT 100
 #define TX_BUFFER_SIZE 4096
@@ -21,6 +21,14 @@
 #define GGWAVE_DEFAULT_BYTES_PER_FRAME GGWAVE_DEFAULT_SAMPLES_PER_FRAME*GGWAVE_DEFAULT_PAYLOAD_LEN
 #define GGWAVE_DEFAULT_PROTOCOL GGWAVE_PROTOCOL_AUDIBLE_FAST 
 #define GGWAVE_DEFAULT_SAMPLE_BYTESIZE 2
+/// Number of bins above the start frequency which are checked by the pre-gate
+#ifndef GGWAVE_GATE_BINS
+#  define GGWAVE_GATE_BINS 32
+#endif
+/// Number of frames which are written with one write by the encoder
+#ifndef GGWAVE_WRITE_FRAMES
+#  define GGWAVE_WRITE_FRAMES 128
+#endif
 
 //GGWAVE_PROTOCOL_DT_FAST
 
@@ -29,6 +37,13 @@ namespace audio_tools {
 /**
  * @brief GGWaveDecoder: Translates audio into text
  * Codec using https://github.com/ggerganov/ggwave-arduino
+ *
+ * 16 bit samples are collected in a preallocated float frame of
+ * samplesPerFrame samples, so that ggwave does not need to convert them. With
+ * setPreGate() a frame is only decoded if a transmission is likely: the
+ * Goertzel power of the bins of the start markers of the active protocols
+ * must be a relevant part of the signal power. The decoder then stays active
+ * for the hold time.
  * @ingroup codec-ggwave
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -76,14 +91,27 @@ public:
     sample_byte_size = size;
   }
 
+  /// Runs the decoder only if the power in the band of the start markers
+  /// exceeds the indicated ratio of the signal power: the decoder stays
+  /// active for holdMs after the last detection
+  void setPreGate(bool active, float ratio = 0.25f, int holdMs = 1000){
+    is_gate = active;
+    gate_ratio = ratio;
+    gate_hold_ms = holdMs;
+  }
+
+  /// Returns true if the full decoder is running
+  bool isGateOpen() { return !is_gate || hold_frames > 0; }
+
   void begin() {
     if (pt_print==nullptr){
       LOGE("final destination not defined");
       return;
     }
 
-    receive_buffer.resize(samples_per_frame*sample_byte_size);
     ggwave.setLogFile(nullptr);
+    // 16 bit samples are converted to float frames
+    is_block_mode = samples_format_input == GGWAVE_SAMPLE_FORMAT_I16;
 
     auto p = GGWave::getDefaultParameters();
     p.payloadLength   = playload_len;
@@ -91,9 +119,12 @@ public:
     p.sampleRateOut   = info.sample_rate;
     p.sampleRate      = info.sample_rate;
     p.samplesPerFrame = samples_per_frame;
-    p.sampleFormatInp = samples_format_input;
+    p.sampleFormatInp = is_block_mode ? GGWAVE_SAMPLE_FORMAT_F32 : samples_format_input;
     p.sampleFormatOut = samples_format_output;
     p.operatingMode   = GGWAVE_OPERATING_MODE_RX | GGWAVE_OPERATING_MODE_USE_DSS ;
+    if (p.samplesPerFrame == 0) {
+      p.samplesPerFrame = GGWave::getDefaultParameters().samplesPerFrame;
+    }
 
 
     // Remove the ones that you don't need to reduce memory usage
@@ -112,6 +143,8 @@ public:
         active = false;
         LOGE("prepare failed");
     }
+    receive_buffer.resize(p.samplesPerFrame*sample_byte_size);
+    setupFrames(p.samplesPerFrame);
   }
 
 
@@ -122,6 +155,7 @@ public:
 
   size_t write(const uint8_t *data, size_t len) { 
     if (!active) return 0;
+    if (is_block_mode) return writeBlocks((const int16_t*)data, len / sizeof(int16_t)) * sizeof(int16_t);
     uint8_t *p_byte = (uint8_t *)data;
     for (int j=0;j<len;j++){
         receive_buffer.write(p_byte[j]);
@@ -150,10 +184,120 @@ protected:
   int playload_len = GGWAVE_DEFAULT_PAYLOAD_LEN;
   int sample_byte_size = GGWAVE_DEFAULT_SAMPLE_BYTESIZE;
   bool active = false;
+  bool is_block_mode = true;
+  // current and previous float frame
+  Vector<float> frame{0};
+  Vector<float> prev_frame{0};
+  int frame_pos = 0;
+  // Goertzel coefficients of the bins which are checked by the pre-gate
+  Vector<float> gate_coef{0};
+  bool is_gate = false;
+  float gate_ratio = 0.25f;
+  int gate_hold_ms = 1000;
+  int hold_frames = 0;
+
+  void setupFrames(int samplesPerFrame) {
+    frame.resize(samplesPerFrame);
+    prev_frame.resize(samplesPerFrame);
+    frame_pos = 0;
+    hold_frames = 0;
+    memset(prev_frame.data(), 0, prev_frame.size() * sizeof(float));
+    // bins of the start markers of all active protocols
+    gate_coef.resize(0);
+    Vector<ggwave_ProtocolId> ids;
+    ids.push_back(GGWAVE_DEFAULT_PROTOCOL);
+    for (auto protocol: protocols) ids.push_back(protocol);
+    for (auto id : ids) {
+      int start = GGWave::Protocols::rx()[id].freqStart;
+      for (int bin = start; bin < start + GGWAVE_GATE_BINS && bin < samplesPerFrame / 2; bin++) {
+        gate_coef.push_back(2.0f * cosf(2.0f * PI * bin / samplesPerFrame));
+      }
+    }
+  }
+
+  /// Collects the samples in float frames
+  size_t writeBlocks(const int16_t *samples, size_t n) {
+    size_t pos = 0;
+    int frame_size = frame.size();
+    while (pos < n) {
+      int len = min((size_t)(frame_size - frame_pos), n - pos);
+      toFloat(samples + pos, frame.data() + frame_pos, len);
+      frame_pos += len;
+      pos += len;
+      if (frame_pos == frame_size) {
+        processFrame();
+        frame_pos = 0;
+      }
+    }
+    return n;
+  }
+
+  /// int16 to float in blocks of 4 samples
+  static void toFloat(const int16_t *in, float *out, int n) {
+    const float factor = 1.0f / 32768.0f;
+    int j = 0;
+    for (; j + 4 <= n; j += 4) {
+      out[j] = in[j] * factor;
+      out[j + 1] = in[j + 1] * factor;
+      out[j + 2] = in[j + 2] * factor;
+      out[j + 3] = in[j + 3] * factor;
+    }
+    for (; j < n; j++) out[j] = in[j] * factor;
+  }
+
+  void processFrame() {
+    if (is_gate) {
+      bool is_likely = isTransmissionLikely(frame.data(), frame.size());
+      if (is_likely) {
+        // also provide the frame before the first detection
+        if (hold_frames == 0) decodeFrame(prev_frame.data());
+        hold_frames = max(1, (int)((int64_t)gate_hold_ms * info.sample_rate / 1000 / frame.size()));
+      } else if (hold_frames > 0) {
+        hold_frames--;
+      }
+      if (hold_frames == 0) {
+        // keep the frame for the next detection
+        memcpy(prev_frame.data(), frame.data(), frame.size() * sizeof(float));
+        return;
+      }
+    }
+    decodeFrame(frame.data());
+  }
+
+  /// Goertzel power of the marker bins relative to the power of the frame
+  bool isTransmissionLikely(const float *x, int n) {
+    float total = 0.0f;
+    for (int j = 0; j < n; j++) total += x[j] * x[j];
+    // ignore silence
+    if (total < 1.0e-6f * n) return false;
+    float band = 0.0f;
+    for (auto coef : gate_coef) {
+      float s1 = 0.0f, s2 = 0.0f;
+      for (int j = 0; j < n; j++) {
+        float s0 = x[j] + coef * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+      }
+      band += s1 * s1 + s2 * s2 - coef * s1 * s2;
+    }
+    // positive and negative frequencies: sum |X|^2 = n * sum x^2
+    return 2.0f * band / (n * total) > gate_ratio;
+  }
+
+  void decodeFrame(float *samples) {
+    if (ggwave.decode(samples, frame.size() * sizeof(float))) {
+      int nr = ggwave.rxTakeData(data);
+      if (nr > 0) {
+        pt_print->write((uint8_t*) &data[0], nr);
+      }
+    } else {
+      LOGW("decoding error");
+    }
+  }
 
   void decode() {
     if (receive_buffer.available()>0){
-      if (ggwave.decode(receive_buffer.address(), receive_buffer.available()/(info.bits_per_sample/8))) {
+      if (ggwave.decode(receive_buffer.address(), receive_buffer.available())) {
           // Check if we have successfully decoded any data:
           int nr = ggwave.rxTakeData(data);
           if (nr > 0) {
@@ -170,6 +314,10 @@ protected:
 /**
  * @brief GGWaveEncoder: Translates text into audio
  * Codec using https://github.com/ggerganov/ggwave-arduino
+ *
+ * The tones are multiples of the frequency resolution of a frame, so they
+ * are generated from one precomputed sine table with samplesPerFrame entries
+ * and are written in blocks.
  * @ingroup codec-ggwave
  * @author Phil Schatzmann
  * @copyright GPLv3
@@ -218,8 +366,6 @@ public:
       LOGE("final destination not defined");
       return;
     }
-    sine_wave.begin(info.channels, info.sample_rate, 0);
-
     auto parameters = GGWave::getDefaultParameters();
     parameters.payloadLength   = playload_len;
     parameters.sampleRateInp   = info.sample_rate;
@@ -241,6 +387,7 @@ public:
     //GGWave::Protocols::tx()[protocolId].freqStart += 48;
 
     ggwave.prepare(parameters);
+    setupToneTable();
     active = true;
   }
 
@@ -291,29 +438,49 @@ protected:
   int volume = GGWave::kDefaultVolume;
   int sample_byte_size = GGWAVE_DEFAULT_SAMPLE_BYTESIZE;
   bool active = false;
-  //SineFromTable<int16_t> sine_wave;
-  FastSineGenerator<int16_t> sine_wave; 
+  // one sine period over a frame
+  Vector<int16_t> tone_table{0};
+  Vector<int16_t> block{0};
+  int tone_pos = 0;
 
-  virtual void play(int freq, int ms){
+  void setupToneTable() {
+    int n = ggwave.samplesPerFrame();
     // adjust amplitude by pitch bcause high values are too loud
-    int amplitude = 10000; // / (freq/1000);
-    sine_wave.setAmplitude(amplitude);
-    sine_wave.setFrequency(freq);
-    uint64_t end = millis()+ms;
-    while(millis()<end){
-      int16_t sample = sine_wave.readSample();
-      for (int ch=0;ch<info.channels;ch++){
-        pt_print->write((uint8_t*)&sample,2);
+    int amplitude = 10000;
+    tone_table.resize(n);
+    for (int j = 0; j < n; j++) {
+      tone_table[j] = amplitude * sinf(2.0f * PI * j / n);
+    }
+    block.resize(GGWAVE_WRITE_FRAMES * info.channels);
+    tone_pos = 0;
+  }
+
+  virtual void play(int freq, int ms){
+    int n = tone_table.size();
+    // the tone is a multiple of the frequency resolution: step through the table
+    int step = ::round((float)freq * n / info.sample_rate);
+    int frames = (int64_t)ms * info.sample_rate / 1000;
+    while (frames > 0) {
+      int len = min(frames, GGWAVE_WRITE_FRAMES);
+      int16_t *p_out = block.data();
+      for (int j = 0; j < len; j++) {
+        int16_t sample = tone_table[tone_pos];
+        tone_pos += step;
+        if (tone_pos >= n) tone_pos %= n;
+        for (int ch = 0; ch < info.channels; ch++) *p_out++ = sample;
       }
+      pt_print->write((uint8_t *)block.data(), len * info.channels * sizeof(int16_t));
+      frames -= len;
     }
   }
 
   virtual void silence(int samples){
-    // adjust amplitude by pitch bcause high values are too loud
-    int16_t sample = 0;
-    for (int ch=0;ch<info.channels;ch++){
-      pt_print->write((uint8_t*)&sample,2);
-    }    
+    memset(block.data(), 0, block.size() * sizeof(int16_t));
+    while (samples > 0) {
+      int len = min(samples, GGWAVE_WRITE_FRAMES);
+      pt_print->write((uint8_t *)block.data(), len * info.channels * sizeof(int16_t));
+      samples -= len;
+    }
   }
 
 };
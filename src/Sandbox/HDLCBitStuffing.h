@@ -0,0 +1,285 @@
+#pragma once
+#include "AudioConfig.h"
+#include "AudioBasic/Collections/Vector.h"
+#include <stdint.h>
+
+namespace audio_tools {
+
+/**
+ * @brief Synchronous HDLC encoder which is doing the bit stuffing (a 0 is
+ * inserted after 5 consecutive 1 bits) and adds the 0x7E flags. The data is
+ * processed with one table lookup per byte: the table is indexed by the
+ * number of preceding 1 bits and the data byte. The bits are sent lsb first.
+ * @ingroup communications
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class HDLCBitEncoder {
+ public:
+  HDLCBitEncoder() = default;
+  HDLCBitEncoder(Print &out) { setOutput(out); }
+
+  void setOutput(Print &out) { p_out = &out; }
+
+  bool begin() {
+    table();
+    ones = 0;
+    acc = 0;
+    acc_bits = 0;
+    return p_out != nullptr;
+  }
+
+  /// Sends the frame data surrounded by flags
+  size_t writeFrame(const uint8_t *data, size_t len) {
+    if (p_out == nullptr) return 0;
+    Entry(&tab)[5][256] = table();
+    addFlag();
+    for (size_t j = 0; j < len; j++) {
+      const Entry &e = tab[ones][data[j]];
+      addBits(e.bits, e.count);
+      ones = e.ones;
+    }
+    addFlag();
+    writeBuffer();
+    return len;
+  }
+
+  /// Sends a flag (01111110) which is not bit stuffed
+  void writeFlag() {
+    addFlag();
+    writeBuffer();
+  }
+
+  /// Outputs the pending bits: the last byte is filled up with 1 (idle)
+  void flush() {
+    if (acc_bits > 0) {
+      addBits(0xFF >> acc_bits, 8 - acc_bits);
+    }
+    writeBuffer();
+    if (p_out != nullptr) p_out->flush();
+  }
+
+ protected:
+  struct Entry {
+    uint16_t bits;
+    uint8_t count;
+    uint8_t ones;
+  };
+  Print *p_out = nullptr;
+  uint32_t acc = 0;
+  int acc_bits = 0;
+  int ones = 0;
+  uint8_t out_buffer[32];
+  int out_len = 0;
+
+  void addBits(uint32_t bits, int count) {
+    acc |= bits << acc_bits;
+    acc_bits += count;
+    while (acc_bits >= 8) {
+      out_buffer[out_len++] = acc & 0xFF;
+      acc >>= 8;
+      acc_bits -= 8;
+      if (out_len == sizeof(out_buffer)) {
+        writeBuffer();
+      }
+    }
+  }
+
+  void addFlag() {
+    addBits(0x7E, 8);
+    ones = 0;
+  }
+
+  void writeBuffer() {
+    if (out_len > 0) {
+      p_out->write(out_buffer, out_len);
+      out_len = 0;
+    }
+  }
+
+  /// Table indexed by the number of preceding 1 bits (0-4) and the data byte
+  static Entry (&table())[5][256] {
+    static Entry tab[5][256];
+    static bool is_setup = false;
+    if (is_setup) return tab;
+    for (int state = 0; state < 5; state++) {
+      for (int byte = 0; byte < 256; byte++) {
+        uint16_t bits = 0;
+        int count = 0;
+        int ones = state;
+        for (int b = 0; b < 8; b++) {
+          int bit = (byte >> b) & 1;
+          bits |= bit << count++;
+          if (bit) {
+            if (++ones == 5) {
+              // stuffed 0
+              count++;
+              ones = 0;
+            }
+          } else {
+            ones = 0;
+          }
+        }
+        tab[state][byte] = {bits, (uint8_t)count, (uint8_t)ones};
+      }
+    }
+    is_setup = true;
+    return tab;
+  }
+};
+
+/**
+ * @brief Synchronous HDLC decoder which removes the stuffed bits and detects
+ * the flags and aborts. Bytes which can not contain a flag or abort are
+ * processed with a single table lookup, the others bit by bit. The decoded
+ * frames (incl. the FCS) are reported via a callback.
+ * @ingroup communications
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class HDLCBitDecoder {
+ public:
+  HDLCBitDecoder(int maxFrameLength = 512) { max_frame_length = maxFrameLength; }
+
+  /// Defines the callback which is called for each received frame
+  void setFrameCallback(void (*cb)(const uint8_t *frame, size_t len, void *ref),
+                        void *ref = nullptr) {
+    frame_callback = cb;
+    this->ref = ref;
+  }
+
+  bool begin() {
+    table();
+    frame.resize(max_frame_length);
+    reset();
+    is_hunting = true;
+    ones = 0;
+    return true;
+  }
+
+  /// Processes the received (bit stuffed) data: returns the number of frames
+  int write(const uint8_t *data, size_t len) {
+    uint16_t(&tab)[6][256] = table();
+    int frames = 0;
+    for (size_t j = 0; j < len; j++) {
+      uint8_t byte = data[j];
+      uint16_t e = (is_hunting || ones > 5) ? SLOW : tab[ones][byte];
+      if (e & SLOW) {
+        for (int b = 0; b < 8; b++) {
+          if (processBit((byte >> b) & 1)) frames++;
+        }
+      } else {
+        addBits(e & 0xFF, (e >> 8) & 0xF);
+        ones = (e >> 12) & 0x7;
+      }
+    }
+    return frames;
+  }
+
+  /// Number of frames which were dropped because of aborts or overflows
+  size_t errors() { return error_count; }
+
+ protected:
+  // entry: bits (8) | count (4) << 8 | ones (3) << 12 | SLOW
+  static const uint16_t SLOW = 0x8000;
+  Vector<uint8_t> frame{0};
+  void (*frame_callback)(const uint8_t *frame, size_t len, void *ref) = nullptr;
+  void *ref = nullptr;
+  int max_frame_length;
+  size_t frame_len = 0;
+  size_t error_count = 0;
+  uint32_t acc = 0;
+  int acc_bits = 0;
+  int ones = 0;
+  bool is_hunting = true;
+
+  void reset() {
+    frame_len = 0;
+    acc = 0;
+    acc_bits = 0;
+  }
+
+  void addBits(uint32_t bits, int count) {
+    acc |= bits << acc_bits;
+    acc_bits += count;
+    if (acc_bits >= 8) {
+      if (frame_len >= (size_t)max_frame_length) {
+        // overflow: wait for next flag
+        error_count++;
+        is_hunting = true;
+        reset();
+        return;
+      }
+      frame[frame_len++] = acc & 0xFF;
+      acc >>= 8;
+      acc_bits -= 8;
+    }
+  }
+
+  /// Returns true if a frame was completed
+  bool processBit(int bit) {
+    bool result = false;
+    if (bit) {
+      if (++ones >= 7) {
+        // abort or idle
+        if (!is_hunting && frame_len > 0) error_count++;
+        is_hunting = true;
+        reset();
+      }
+      if (!is_hunting) addBits(1, 1);
+      return false;
+    }
+    if (ones == 5) {
+      // stuffed bit
+      ones = 0;
+      return false;
+    }
+    if (ones == 6) {
+      // flag: the last 7 bits (0111111) belong to the flag
+      if (!is_hunting && acc_bits == 7 && frame_len > 0) {
+        if (frame_callback != nullptr)
+          frame_callback(frame.data(), frame_len, ref);
+        result = true;
+      }
+      is_hunting = false;
+      reset();
+    } else if (!is_hunting) {
+      addBits(0, 1);
+    }
+    ones = 0;
+    return result;
+  }
+
+  /// Table indexed by the number of preceding 1 bits (0-5) and the data byte
+  static uint16_t (&table())[6][256] {
+    static uint16_t tab[6][256];
+    static bool is_setup = false;
+    if (is_setup) return tab;
+    for (int state = 0; state < 6; state++) {
+      for (int byte = 0; byte < 256; byte++) {
+        uint16_t bits = 0;
+        int count = 0;
+        int ones = state;
+        bool slow = false;
+        for (int b = 0; b < 8 && !slow; b++) {
+          int bit = (byte >> b) & 1;
+          if (bit) {
+            if (++ones == 6) slow = true;
+            bits |= 1 << count++;
+          } else if (ones == 5) {
+            ones = 0;
+          } else {
+            count++;
+            ones = 0;
+          }
+        }
+        tab[state][byte] =
+            slow ? SLOW : (uint16_t)(bits | count << 8 | ones << 12);
+      }
+    }
+    is_setup = true;
+    return tab;
+  }
+};
+
+}  // namespace audio_tools
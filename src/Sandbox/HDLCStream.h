@@ -138,6 +138,7 @@ private:
   Stream *p_in = nullptr;
   bool escape_character = false;
   SingleBuffer<uint8_t> frame_buffer{0};
+  Vector<uint8_t> send_buffer{0};
   uint8_t frame_position = 0;
   // 16bit CRC sum for _crc_ccitt_update
   uint16_t frame_checksum;
@@ -190,38 +191,37 @@ private:
     return result;
   }
 
-  /// Wrap given data in HDLC frame and send it out byte at a time
+  /// Wrap given data in HDLC frame and send it out with a single write
   void sendFrame(const uint8_t *framebuffer, size_t frame_length) {
     LOGD("HDLCStream::sendFrame: %zu", frame_length);
-    uint8_t data;
     uint16_t fcs = CRC16_CCITT_INIT_VAL;
-
-    p_out->write((uint8_t)FRAME_BOUNDARY_OCTET);
-
-    while (frame_length) {
-      data = *framebuffer++;
+    // worst case: all bytes escaped + 2 flags
+    send_buffer.resize(2 * (frame_length + 2) + 2);
+    uint8_t *out = send_buffer.data();
+    int pos = 0;
+
+    out[pos++] = FRAME_BOUNDARY_OCTET;
+    for (size_t j = 0; j < frame_length; j++) {
+      uint8_t data = framebuffer[j];
       fcs = HDLCStream::_crc_ccitt_update(fcs, data);
-      if ((data == CONTROL_ESCAPE_OCTET) || (data == FRAME_BOUNDARY_OCTET)) {
-        p_out->write((uint8_t)CONTROL_ESCAPE_OCTET);
-        data ^= INVERT_OCTET;
-      }
-      p_out->write((uint8_t)data);
-      frame_length--;
-    }
-    data = low(fcs);
-    if ((data == CONTROL_ESCAPE_OCTET) || (data == FRAME_BOUNDARY_OCTET)) {
-      p_out->write((uint8_t)CONTROL_ESCAPE_OCTET);
-      data ^= (uint8_t)INVERT_OCTET;
+      pos += escape(data, out + pos);
     }
-    p_out->write((uint8_t)data);
-    data = high(fcs);
+    pos += escape(low(fcs), out + pos);
+    pos += escape(high(fcs), out + pos);
+    out[pos++] = FRAME_BOUNDARY_OCTET;
+    p_out->write(out, pos);
+    p_out->flush();
+  }
+
+  /// Writes the escaped byte and returns the number of written bytes
+  static int escape(uint8_t data, uint8_t *out) {
     if ((data == CONTROL_ESCAPE_OCTET) || (data == FRAME_BOUNDARY_OCTET)) {
-      p_out->write(CONTROL_ESCAPE_OCTET);
-      data ^= INVERT_OCTET;
+      out[0] = CONTROL_ESCAPE_OCTET;
+      out[1] = data ^ INVERT_OCTET;
+      return 2;
     }
-    p_out->write(data);
-    p_out->write(FRAME_BOUNDARY_OCTET);
-    p_out->flush();
+    out[0] = data;
+    return 1;
   }
 
   static uint16_t crc16_update(uint16_t crc, uint8_t a) {
@@ -11,7 +11,10 @@
 namespace audio_tools {
 
 /**
- * @brief I2S emulated with the help of the Arduion SPI api.
+ * @brief I2S emulated with the help of the Arduion SPI api. The word select
+ * is toggled by software for each word: if you just need a 1 bit audio
+ * output, the SigmaDeltaStream (with an I2SStream) or the SigmaDeltaRMTStream
+ * from AudioDAC.h clock out the data w/o cpu.
  * @author Phil Schatzmann
  * @ingroup io
  * @copyright GPLv3
@@ -45,12 +48,27 @@ public:
 
   void end() { SPI.end(); }
 
+  /// Sends the samples word by word: the bytes of each little endian sample
+  /// are sent MSB first
   size_t write(const uint8_t *data, size_t len) {
+    int word_size = buffer.size();
+    if (word_size == 0) return 0;
     for (int j = 0; j < len; j++) {
       buffer.write(data[j]);
       if (buffer.availableForWrite() == 0) {
+        uint8_t *word = buffer.data();
+        for (int k = 0; k < word_size / 2; k++) {
+          uint8_t tmp = word[k];
+          word[k] = word[word_size - 1 - k];
+          word[word_size - 1 - k] = tmp;
+        }
         digitalWrite(i2s_config.pin_ws, ws_state);
-        SPI.transfer(buffer.data(), buffer.size());
+#if defined(ESP32)
+        // no need to read back the received data
+        SPI.writeBytes(word, word_size);
+#else
+        SPI.transfer(word, word_size);
+#endif
         // toggle word select
         ws_state = !ws_state;
         buffer.reset();
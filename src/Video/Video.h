@@ -48,6 +48,18 @@ class VideoAudioSync {
     uint32_t delay_ms = microsecondsPerFrame / 1000;
     delay(delay_ms);
   }
+
+  /// Called before a video frame is decoded: return false to drop the frame
+  virtual bool beginVideoFrame(uint32_t frame, int32_t microsecondsPerFrame) {
+    return true;
+  }
+
+  /// Defines the data rate of the (encoded) audio stream
+  virtual void setAudioByteRate(uint32_t bytesPerSecond) {}
+
+  /// Restarts the synchronization at the indicated position (e.g. after a
+  /// seek)
+  virtual void reset(uint64_t positionUs) {}
 };
 
 /**
@@ -99,4 +111,121 @@ class VideoAudioBufferedSync : public VideoAudioSync {
   int correction_ms = 0;
 };
 
+/**
+ * @brief Presentation timestamp based synchronization of video and audio: the
+ * audio is buffered and the audio clock is determined from the bytes which
+ * have been written to the (blocking) audio output, e.g. I2S, minus the
+ * latency of the output (DMA) buffers. The presentation time of a frame is
+ * its index multiplied with the frame duration. Frames which are late by
+ * more than one frame period are dropped w/o decoding them, and when the
+ * video is ahead we play the buffered audio until the next frame is due.
+ * W/o audio the clock is based on micros().
+ * @ingroup video
+ * @author Phil Schatzmann
+ * @copyright GPLv3
+ */
+class VideoAudioTimestampSync : public VideoAudioSync {
+ public:
+  VideoAudioTimestampSync(int bufferSize, int outputLatencyMs = 0) {
+    ring_buffer.resize(bufferSize);
+    setOutputLatencyMs(outputLatencyMs);
+  }
+
+  /// Defines the delay of the audio output (e.g. size of the I2S DMA buffers)
+  void setOutputLatencyMs(int ms) { latency_us = 1000l * ms; }
+
+  /// Defines the data rate of the (encoded) audio stream which is used to
+  /// determine the audio clock
+  void setAudioByteRate(uint32_t bytesPerSecond) override {
+    byte_rate = bytesPerSecond;
+  }
+
+  /// Buffers the audio data: the surplus which does not fit is played
+  void writeAudio(Print *out, uint8_t *data, size_t size) override {
+    p_out = out;
+    while (ring_buffer.availableForWrite() < (int)size) {
+      if (playAudio(size - ring_buffer.availableForWrite()) == 0) break;
+    }
+    ring_buffer.writeArray(data, size);
+  }
+
+  /// Returns false if the frame is late and should be dropped
+  bool beginVideoFrame(uint32_t frame, int32_t microsecondsPerFrame) override {
+    frame_pts_us = (uint64_t)frame * microsecondsPerFrame;
+    frame_start_us = micros();
+    bool result = clockUs() < frame_pts_us + microsecondsPerFrame;
+    if (!result) dropped_frames++;
+    return result;
+  }
+
+  /// Plays the buffered audio until the next frame needs to be decoded
+  void delayVideoFrame(int32_t microsecondsPerFrame,
+                       uint32_t time_used_ms) override {
+    // we use the decoding time of the last frame as estimate for the next
+    uint32_t decode_us = (uint32_t)micros() - frame_start_us;
+    uint64_t next_pts = frame_pts_us + microsecondsPerFrame;
+    uint64_t target = next_pts > decode_us ? next_pts - decode_us : 0;
+    while (clockUs() < target) {
+      if (playAudio(sizeof(audio)) == 0) {
+        // no buffered audio: the audio clock can not advance
+        if (hasAudioClock()) break;
+        delay(1);
+      }
+    }
+  }
+
+  /// Restarts the clocks at the indicated position
+  void reset(uint64_t positionUs) override {
+    ring_buffer.reset();
+    played_bytes = 0;
+    base_us = positionUs;
+    start_us = micros();
+    is_started = true;
+  }
+
+  /// Current position of the audio (or system) clock in microseconds
+  uint64_t clockUs() {
+    if (!is_started) {
+      start_us = micros();
+      is_started = true;
+    }
+    if (hasAudioClock()) {
+      uint64_t result = played_bytes * 1000000ull / byte_rate;
+      result = result > latency_us ? result - latency_us : 0;
+      return base_us + result;
+    }
+    return base_us + ((uint32_t)micros() - start_us);
+  }
+
+  /// Number of frames which were dropped because they were late
+  uint32_t droppedFrames() { return dropped_frames; }
+
+ protected:
+  RingBuffer<uint8_t> ring_buffer{0};
+  Print *p_out = nullptr;
+  uint8_t audio[256];
+  uint64_t played_bytes = 0;
+  uint64_t base_us = 0;
+  uint64_t frame_pts_us = 0;
+  uint32_t latency_us = 0;
+  uint32_t byte_rate = 0;
+  uint32_t start_us = 0;
+  uint32_t frame_start_us = 0;
+  uint32_t dropped_frames = 0;
+  bool is_started = false;
+
+  bool hasAudioClock() { return byte_rate > 0 && played_bytes > 0; }
+
+  /// Writes up to the indicated number of buffered bytes to the output
+  size_t playAudio(size_t max) {
+    if (p_out == nullptr) return 0;
+    size_t len = min((size_t)ring_buffer.available(), min(max, sizeof(audio)));
+    if (len == 0) return 0;
+    ring_buffer.readArray(audio, len);
+    p_out->write(audio, len);
+    played_bytes += len;
+    return len;
+  }
+};
+
 }  // namespace audio_tools
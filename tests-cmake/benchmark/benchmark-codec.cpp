@@ -0,0 +1,175 @@
+/**
+ * @file benchmark-codec.cpp
+ * @author Phil Schatzmann
+ * @brief Decoding speed of the MP3, AAC, Opus, FLAC and ADPCM decoders. MP3 and
+ * AAC use the test files of the codec tests; the Opus, FLAC and ADPCM data is
+ * encoded from a generated sine wave before we start the measurement. We also
+ * measure the Base64 encoding and decoding which is used to send audio as
+ * text.
+ * @copyright GPLv3
+ */
+#include "benchmark.h"
+#include "AudioCodecs/CodecMP3Helix.h"
+#include "AudioCodecs/CodecAACHelix.h"
+#include "AudioCodecs/CodecOpus.h"
+#include "AudioCodecs/CodecFLAC.h"
+#include "AudioCodecs/CodecADPCM.h"
+#include "AudioCodecs/CodecIMAADPCM.h"
+#include "AudioCodecs/CodecBase64.h"
+#include "../codec/mp3-helix/BabyElephantWalk60_mp3.h"
+#include "../codec/aac-helix/audio.h"
+
+const int seconds = 10;
+Vector<int16_t> pcm{0};
+
+/// Collects the encoded data and the size of each written packet
+class PacketOutput : public AudioOutput {
+ public:
+  Vector<uint8_t> data{0};
+  Vector<int> packets{0};
+  size_t write(const uint8_t *in, size_t len) override {
+    int size = data.size();
+    data.resize(size + len);
+    memcpy(data.data() + size, in, len);
+    packets.push_back(len);
+    return len;
+  }
+};
+
+/// Generates the pcm test data
+void setupData(AudioInfo info) {
+  SineWaveGenerator<int16_t> sine(16000);
+  sine.begin(info, N_A4);
+  pcm.resize(info.sample_rate * info.channels * seconds);
+  for (int j = 0; j < pcm.size(); j++) pcm[j] = sine.readSample();
+}
+
+void encode(AudioEncoder &encoder, AudioInfo info, PacketOutput &out) {
+  setupData(info);
+  encoder.setAudioInfo(info);
+  encoder.setOutput(out);
+  encoder.begin();
+  for (int j = 0; j < pcm.size(); j += 512) {
+    int n = min(512, (int)pcm.size() - j);
+    encoder.write((uint8_t *)(pcm.data() + j), n * sizeof(int16_t));
+  }
+  encoder.end();
+}
+
+/// Decodes the data which is written in chunks of the indicated size: a size
+/// of 0 writes the recorded packets
+void benchmarkDecoder(const char *name, AudioDecoder &decoder,
+                      const uint8_t *data, size_t len, AudioInfo info,
+                      Vector<int> *packets = nullptr) {
+  CountingOutput out;
+  // determine the number of samples
+  auto decode = [&]() {
+    out.total = 0;
+    decoder.setAudioInfo(info);
+    decoder.setOutput(out);
+    decoder.begin();
+    if (packets != nullptr) {
+      size_t pos = 0;
+      for (int j = 0; j < packets->size(); j++) {
+        decoder.write(data + pos, (*packets)[j]);
+        pos += (*packets)[j];
+      }
+    } else {
+      for (size_t pos = 0; pos < len; pos += 1024) {
+        decoder.write(data + pos, min((size_t)1024, len - pos));
+      }
+    }
+    decoder.end();
+  };
+  decode();
+  benchmark(name, out.total / sizeof(int16_t), decode);
+}
+
+void benchmarkFLAC() {
+  AudioInfo info(44100, 2, 16);
+  PacketOutput encoded;
+  FLACEncoder encoder;
+  encode(encoder, info, encoded);
+
+  CountingOutput out;
+  FLACDecoder decoder;
+  auto decode = [&]() {
+    MemoryStream in(encoded.data.data(), encoded.data.size());
+    in.begin();
+    out.total = 0;
+    decoder.setInput(in);
+    decoder.setOutput(out);
+    decoder.begin();
+    while (decoder.copy());
+    decoder.end();
+  };
+  decode();
+  benchmark("FLACDecoder", out.total / sizeof(int16_t), decode);
+}
+
+void benchmarkBase64() {
+  AudioInfo info(44100, 2, 16);
+  PacketOutput encoded;
+  EncoderBase64 encoder;
+  encoder.setNewLine(NoCR);
+  encode(encoder, info, encoded);
+  // measure the encoding w/o collecting the result
+  CountingOutput out;
+  benchmark("EncoderBase64", pcm.size(), [&]() {
+    encoder.setOutput(out);
+    encoder.begin();
+    for (int j = 0; j < pcm.size(); j += 512) {
+      int n = min(512, (int)pcm.size() - j);
+      encoder.write((uint8_t *)(pcm.data() + j), n * sizeof(int16_t));
+    }
+    encoder.end();
+  });
+
+  DecoderBase64 decoder;
+  decoder.setNewLine(NoCR);
+  benchmarkDecoder("DecoderBase64", decoder, encoded.data.data(),
+                   encoded.data.size(), info);
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+
+  MP3DecoderHelix mp3;
+  benchmarkDecoder("MP3DecoderHelix", mp3, BabyElephantWalk60_mp3,
+                   BabyElephantWalk60_mp3_len, AudioInfo(44100, 2, 16));
+
+  AACDecoderHelix aac;
+  benchmarkDecoder("AACDecoderHelix", aac, gs_16b_2c_44100hz_aac,
+                   gs_16b_2c_44100hz_aac_len, AudioInfo(44100, 2, 16));
+
+  AudioInfo opus_info(48000, 2, 16);
+  PacketOutput opus_data;
+  OpusAudioEncoder opus_encoder;
+  encode(opus_encoder, opus_info, opus_data);
+  OpusAudioDecoder opus;
+  benchmarkDecoder("OpusAudioDecoder", opus, opus_data.data.data(),
+                   opus_data.data.size(), opus_info, &opus_data.packets);
+
+  benchmarkFLAC();
+
+  AudioInfo adpcm_info(44100, 2, 16);
+  PacketOutput adpcm_data;
+  ADPCMEncoder adpcm_encoder(AV_CODEC_ID_ADPCM_IMA_WAV, 1024);
+  encode(adpcm_encoder, adpcm_info, adpcm_data);
+  ADPCMDecoder adpcm(AV_CODEC_ID_ADPCM_IMA_WAV, 1024);
+  benchmarkDecoder("ADPCMDecoder IMA WAV", adpcm, adpcm_data.data.data(),
+                   adpcm_data.data.size(), adpcm_info);
+
+  PacketOutput ima_data;
+  IMAADPCMEncoder ima_encoder(1024);
+  encode(ima_encoder, adpcm_info, ima_data);
+  IMAADPCMDecoder ima(1024);
+  benchmarkDecoder("IMAADPCMDecoder", ima, ima_data.data.data(),
+                   ima_data.data.size(), adpcm_info);
+
+  benchmarkBase64();
+  stop();
+}
+
+void loop() {}
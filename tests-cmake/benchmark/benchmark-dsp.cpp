@@ -0,0 +1,244 @@
+/**
+ * @file benchmark-dsp.cpp
+ * @author Phil Schatzmann
+ * @brief Throughput of the buffers, streams, filters and FFTs which are used in
+ * the hot paths of the audio processing: we process 10 seconds of 16 bit
+ * stereo audio in blocks of 512 samples.
+ * @copyright GPLv3
+ */
+#include "benchmark.h"
+#include "AudioLibs/AudioRealFFT.h"
+#include "AudioLibs/AudioKissFFT.h"
+#include "AudioTools/SPDIFEncoder.h"
+
+AudioInfo info(44100, 2, 16);
+const int block = 512;
+// about 10 seconds: a multiple of the block size
+const size_t samples = (44100 * 2 * 10 / block) * block;
+Vector<int16_t> pcm{0};
+Vector<int16_t> result{0};
+NullStream null_out;
+
+void setupData() {
+  SineWaveGenerator<int16_t> sine(16000);
+  sine.begin(info, N_A4);
+  pcm.resize(samples);
+  result.resize(samples);
+  for (size_t j = 0; j < samples; j++) pcm[j] = sine.readSample();
+}
+
+/// Writes the test data in blocks to the output
+void writeAll(Print &out, const uint8_t *data, size_t bytes,
+              size_t block_bytes = block * sizeof(int16_t)) {
+  for (size_t pos = 0; pos < bytes; pos += block_bytes) {
+    out.write(data + pos, min(block_bytes, bytes - pos));
+  }
+}
+
+void benchmarkBuffers() {
+  RingBuffer<int16_t> ring(4 * block);
+  benchmark("RingBuffer write/read", samples, [&]() {
+    for (size_t pos = 0; pos < samples; pos += block) {
+      ring.writeArray(pcm.data() + pos, block);
+      ring.readArray(result.data() + pos, block);
+    }
+  });
+
+  static RingBufferN<int16_t, 4 * block> ring_n;
+  benchmark("RingBufferN write/read", samples, [&]() {
+    for (size_t pos = 0; pos < samples; pos += block) {
+      ring_n.writeArray(pcm.data() + pos, block);
+      ring_n.readArray(result.data() + pos, block);
+    }
+  });
+
+  NBuffer<int16_t> nbuffer(block, 4);
+  benchmark("NBuffer write/read", samples, [&]() {
+    for (size_t pos = 0; pos < samples; pos += block) {
+      nbuffer.writeArray(pcm.data() + pos, block);
+      nbuffer.readArray(result.data() + pos, block);
+    }
+  });
+}
+
+void benchmarkVolume() {
+  VolumeStream volume(null_out);
+  volume.begin(info);
+  volume.setVolume(0.5);
+  benchmark("VolumeStream", samples, [&]() {
+    writeAll(volume, (uint8_t *)pcm.data(), samples * sizeof(int16_t));
+  });
+
+  VolumeMeter meter(null_out);
+  meter.begin(info);
+  benchmark("VolumeMeter", samples, [&]() {
+    writeAll(meter, (uint8_t *)pcm.data(), samples * sizeof(int16_t));
+  });
+
+  meter.setLoudness(true);
+  benchmark("VolumeMeter with loudness", samples, [&]() {
+    writeAll(meter, (uint8_t *)pcm.data(), samples * sizeof(int16_t));
+  });
+}
+
+template <typename TFrom, typename TTo>
+void benchmarkFormat(const char *name) {
+  Vector<TFrom> data{0};
+  data.resize(samples);
+  for (size_t j = 0; j < samples; j++) {
+    data[j] = NumberConverter::convert<int16_t, TFrom>(pcm[j]);
+  }
+  NumberFormatConverterStreamT<TFrom, TTo> converter(null_out);
+  converter.begin();
+  benchmark(name, samples, [&]() {
+    writeAll(converter, (uint8_t *)data.data(), samples * sizeof(TFrom),
+             block * sizeof(TFrom));
+  });
+}
+
+void benchmarkFormats() {
+  benchmarkFormat<int8_t, int16_t>("NumberFormatConverter 8->16");
+  benchmarkFormat<int8_t, int24_t>("NumberFormatConverter 8->24");
+  benchmarkFormat<int8_t, int32_t>("NumberFormatConverter 8->32");
+  benchmarkFormat<int16_t, int8_t>("NumberFormatConverter 16->8");
+  benchmarkFormat<int16_t, int24_t>("NumberFormatConverter 16->24");
+  benchmarkFormat<int16_t, int32_t>("NumberFormatConverter 16->32");
+  benchmarkFormat<int24_t, int8_t>("NumberFormatConverter 24->8");
+  benchmarkFormat<int24_t, int16_t>("NumberFormatConverter 24->16");
+  benchmarkFormat<int24_t, int32_t>("NumberFormatConverter 24->32");
+  benchmarkFormat<int32_t, int8_t>("NumberFormatConverter 32->8");
+  benchmarkFormat<int32_t, int16_t>("NumberFormatConverter 32->16");
+  benchmarkFormat<int32_t, int24_t>("NumberFormatConverter 32->24");
+}
+
+void benchmarkResample(const char *name, float step) {
+  ResampleStream resample(null_out);
+  resample.setStepSize(step);
+  resample.begin(info);
+  benchmark(name, samples, [&]() {
+    writeAll(resample, (uint8_t *)pcm.data(), samples * sizeof(int16_t));
+  });
+}
+
+void benchmarkDecimate(const char *name, BaseConverter &decimate) {
+  benchmark(name, samples, [&]() {
+    memcpy(result.data(), pcm.data(), samples * sizeof(int16_t));
+    for (size_t pos = 0; pos < samples; pos += block) {
+      decimate.convert((uint8_t *)(result.data() + pos),
+                       block * sizeof(int16_t));
+    }
+  });
+}
+
+void benchmarkFilter(const char *name, Filter<float> &filter) {
+  Vector<float> in{0};
+  Vector<float> out{0};
+  in.resize(samples);
+  out.resize(samples);
+  for (size_t j = 0; j < samples; j++) in[j] = pcm[j];
+  benchmark(name, samples, [&]() {
+    for (size_t pos = 0; pos < samples; pos += block) {
+      filter.process(in.data() + pos, out.data() + pos, block);
+    }
+  });
+}
+
+void benchmarkFilters() {
+  // 32 tap low pass
+  float fir_coef[32];
+  for (int j = 0; j < 32; j++) fir_coef[j] = 1.0f / 32;
+  FIR<float> fir(fir_coef);
+  benchmarkFilter("FIR 32 taps", fir);
+
+  LowPassFilter<float> biquad(1000, info.sample_rate);
+  benchmarkFilter("BiQuad low pass", biquad);
+
+  const float sos[4][6] = {{0.0029f, 0.0058f, 0.0029f, 1.0f, -1.8f, 0.81f},
+                           {1.0f, 2.0f, 1.0f, 1.0f, -1.7f, 0.75f},
+                           {1.0f, 2.0f, 1.0f, 1.0f, -1.6f, 0.70f},
+                           {1.0f, 2.0f, 1.0f, 1.0f, -1.5f, 0.65f}};
+  const float gain[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+  SOSFilter<float, 4> sos_filter(sos, gain);
+  benchmarkFilter("SOSFilter 4 sections", sos_filter);
+
+  MedianFilter<float> median(31);
+  benchmarkFilter("MedianFilter 31", median);
+  MedianFilterHeap<float> median_heap(31);
+  benchmarkFilter("MedianFilterHeap 31", median_heap);
+  MedianFilterHeap<float> median_heap_101(101);
+  benchmarkFilter("MedianFilterHeap 101", median_heap_101);
+}
+
+void benchmarkMixer() {
+  OutputMixer<int16_t> mixer(null_out, 2);
+  mixer.begin(block * sizeof(int16_t));
+  benchmark("OutputMixer 2 inputs", samples, [&]() {
+    const size_t bytes = block * sizeof(int16_t);
+    for (size_t pos = 0; pos < samples; pos += block) {
+      mixer.write((uint8_t *)(pcm.data() + pos), bytes);
+      mixer.write((uint8_t *)(pcm.data() + pos), bytes);
+    }
+  });
+  mixer.end();
+}
+
+template <typename T>
+void benchmarkSPDIF(const char *name, AudioInfo spdif_info) {
+  Vector<T> data{0};
+  data.resize(samples);
+  for (size_t j = 0; j < samples; j++) {
+    data[j] = NumberConverter::convert<int16_t, T>(pcm[j]);
+  }
+  const int frames = block / info.channels;
+  Vector<uint32_t> out{0};
+  out.resize(frames * SPDIF_WORDS_PER_FRAME);
+  SPDIFEncoder encoder;
+  encoder.begin(spdif_info);
+  benchmark(name, samples, [&]() {
+    for (size_t pos = 0; pos < samples; pos += block) {
+      encoder.encode((uint8_t *)(data.data() + pos), frames, out.data());
+    }
+  });
+}
+
+void fftCallback(AudioFFTBase &fft) {}
+
+void benchmarkFFT(const char *name, AudioFFTBase &fft) {
+  auto cfg = fft.defaultConfig();
+  cfg.copyFrom(info);
+  cfg.length = 1024;
+  cfg.callback = fftCallback;
+  fft.begin(cfg);
+  benchmark(name, samples, [&]() {
+    writeAll(fft, (uint8_t *)pcm.data(), samples * sizeof(int16_t));
+  });
+  fft.end();
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+  setupData();
+
+  benchmarkBuffers();
+  benchmarkVolume();
+  benchmarkFormats();
+  benchmarkResample("ResampleStream 0.5", 0.5f);
+  benchmarkResample("ResampleStream 1.5", 1.5f);
+  DecimateT<int16_t> decimate(3, info.channels);
+  benchmarkDecimate("DecimateT 3", decimate);
+  DecimateFIRT<int16_t> decimate_fir(3, info.channels);
+  benchmarkDecimate("DecimateFIRT 3", decimate_fir);
+  benchmarkFilters();
+  benchmarkMixer();
+  benchmarkSPDIF<int16_t>("SPDIFEncoder 16 bit", info);
+  benchmarkSPDIF<int24_t>("SPDIFEncoder 24 bit 96kHz", AudioInfo(96000, 2, 24));
+
+  AudioRealFFT real_fft;
+  benchmarkFFT("AudioRealFFT 1024", real_fft);
+  AudioKissFFT kiss_fft;
+  benchmarkFFT("AudioKissFFT 1024", kiss_fft);
+  stop();
+}
+
+void loop() {}
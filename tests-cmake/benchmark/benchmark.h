@@ -0,0 +1,46 @@
+/**
+ * @file benchmark.h
+ * @author Phil Schatzmann
+ * @brief Simple timing support for the benchmarks: each test is executed once
+ * to warm up the caches and then repeated. We report the fastest run as
+ * samples per second and nanoseconds per sample, so that the results are
+ * repeatable on the desktop and under QEMU.
+ * @copyright GPLv3
+ */
+#pragma once
+#include <chrono>
+#include "AudioTools.h"
+
+#ifndef BENCHMARK_REPEAT
+#  define BENCHMARK_REPEAT 5
+#endif
+
+/// Counts the written bytes
+class CountingOutput : public AudioOutput {
+ public:
+  size_t total = 0;
+  size_t write(const uint8_t *data, size_t len) override {
+    total += len;
+    return len;
+  }
+};
+
+/// Executes the function and reports the fastest run for the indicated
+/// number of processed samples
+template <class F>
+void benchmark(const char *name, size_t samples, F fn) {
+  using namespace std::chrono;
+  fn();
+  uint64_t best_ns = UINT64_MAX;
+  for (int j = 0; j < BENCHMARK_REPEAT; j++) {
+    auto start = steady_clock::now();
+    fn();
+    uint64_t ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    if (ns < best_ns) best_ns = ns;
+  }
+  if (best_ns == 0) best_ns = 1;
+  char msg[120];
+  snprintf(msg, sizeof(msg), "%-40s %10.2f Msamples/s %10.2f ns/sample", name,
+           (double)samples * 1000.0 / best_ns, (double)best_ns / samples);
+  Serial.println(msg);
+}
@@ -0,0 +1,103 @@
+// Throughput of the table driven IMAADPCMEncoder/IMAADPCMDecoder compared to
+// the ADPCMEncoder/ADPCMDecoder (AV_CODEC_ID_ADPCM_IMA_WAV) using 10 seconds
+// of stereo audio with a block size of 1024 bytes.
+#include "AudioTools.h"
+#include "AudioCodecs/CodecADPCM.h" // https://github.com/pschatzmann/adpcm
+#include "AudioCodecs/CodecIMAADPCM.h"
+
+AudioInfo info(44100, 2, 16);
+const int block_size = 1024;
+const int frames = 44100 * 10;
+Vector<int16_t> pcm{0};
+
+/// Counts the written bytes
+class CountingOutput : public AudioOutput {
+ public:
+  size_t total = 0;
+  size_t write(const uint8_t *in, size_t len) override {
+    total += len;
+    return len;
+  }
+};
+
+/// Collects the written data
+class CollectingOutput : public AudioOutput {
+ public:
+  Vector<uint8_t> data{0};
+  size_t write(const uint8_t *in, size_t len) override {
+    int size = data.size();
+    data.resize(size + len);
+    memcpy(data.data() + size, in, len);
+    return len;
+  }
+};
+
+void setupData() {
+  pcm.resize(frames * info.channels);
+  for (int j = 0; j < frames; j++) {
+    pcm[j * 2] = 16000 * sin(2 * PI * 440 * j / info.sample_rate);
+    pcm[j * 2 + 1] = 16000 * sin(2 * PI * 660 * j / info.sample_rate);
+  }
+}
+
+void report(const char *name, uint32_t ms) {
+  if (ms == 0) ms = 1;
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(ms);
+  Serial.print(" ms, ");
+  Serial.print((uint32_t)((uint64_t)frames * 1000 / ms));
+  Serial.println(" frames/s");
+}
+
+/// Encodes the pcm data and then decodes the result again
+void benchmark(const char *name, AudioEncoder &encoder, AudioDecoder &decoder) {
+  CollectingOutput encoded;
+  encoder.setAudioInfo(info);
+  encoder.setOutput(encoded);
+  encoder.begin();
+  uint32_t start = millis();
+  for (int j = 0; j < pcm.size(); j += 512) {
+    int n = min(512, (int)pcm.size() - j);
+    encoder.write((uint8_t *)(pcm.data() + j), n * sizeof(int16_t));
+  }
+  encoder.end();
+  Serial.print(name);
+  report(" encode", millis() - start);
+
+  CountingOutput decoded;
+  decoder.setAudioInfo(info);
+  decoder.setOutput(decoded);
+  decoder.begin();
+  start = millis();
+  for (int j = 0; j < encoded.data.size(); j += 512) {
+    int n = min(512, (int)encoded.data.size() - j);
+    decoder.write(encoded.data.data() + j, n);
+  }
+  decoder.end();
+  Serial.print(name);
+  report(" decode", millis() - start);
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+  setupData();
+
+  ADPCMEncoder adpcm_encoder(AV_CODEC_ID_ADPCM_IMA_WAV, block_size);
+  ADPCMDecoder adpcm_decoder(AV_CODEC_ID_ADPCM_IMA_WAV, block_size);
+  benchmark("adpcm_ffmpeg", adpcm_encoder, adpcm_decoder);
+
+  for (int workers = 1; workers <= 4; workers *= 2) {
+    IMAADPCMEncoder ima_encoder(block_size);
+    IMAADPCMDecoder ima_decoder(block_size);
+    ima_encoder.setWorkers(workers);
+    Serial.print("workers ");
+    Serial.print(workers);
+    Serial.print(" ");
+    benchmark("ima", ima_encoder, ima_decoder);
+  }
+  stop();
+}
+
+void loop() {}
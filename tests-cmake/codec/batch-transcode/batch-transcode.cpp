@@ -0,0 +1,76 @@
+/**
+ * @file batch-transcode.cpp
+ * @author Phil Schatzmann
+ * @brief Command line tool which transcodes all mp3 files of a directory to
+ * wav or flac at full CPU speed: the files are processed in parallel with a
+ * BatchTranscoder.
+ *
+ * Usage: batch-transcode <input-dir> <output-dir> [wav|flac] [threads]
+ * @copyright GPLv3
+ */
+#include <dirent.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+
+#include "AudioTools.h"
+#include "AudioCodecs/CodecFLAC.h"
+#include "AudioCodecs/CodecMP3Helix.h"
+#include "AudioLibs/Desktop/BatchTranscoder.h"
+
+using namespace audio_tools;
+
+bool endsWith(const std::string &str, const char *suffix) {
+  size_t len = strlen(suffix);
+  return str.size() >= len &&
+         strcasecmp(str.c_str() + str.size() - len, suffix) == 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <input-dir> <output-dir> [wav|flac] [threads]\n",
+            argv[0]);
+    return 1;
+  }
+  std::string in_dir = argv[1];
+  std::string out_dir = argv[2];
+  bool is_flac = argc > 3 && strcmp(argv[3], "flac") == 0;
+  int threads = argc > 4 ? atoi(argv[4]) : 0;
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+
+  BatchTranscoder transcoder;
+  transcoder.setDecoderFactory([]() -> AudioDecoder * { return new MP3DecoderHelix(); });
+  if (is_flac) {
+    transcoder.setEncoderFactory([]() -> AudioEncoder * { return new FLACEncoder(); });
+  } else {
+    transcoder.setEncoderFactory([]() -> AudioEncoder * { return new WAVEncoder(); });
+  }
+
+  DIR *dir = opendir(in_dir.c_str());
+  if (dir == nullptr) {
+    fprintf(stderr, "Could not open directory %s\n", in_dir.c_str());
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  transcoder.begin(threads);
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    std::string name = entry->d_name;
+    if (!endsWith(name, ".mp3")) continue;
+    std::string out_name = name.substr(0, name.size() - 4) + (is_flac ? ".flac" : ".wav");
+    transcoder.add((in_dir + "/" + name).c_str(), (out_dir + "/" + out_name).c_str());
+  }
+  closedir(dir);
+  transcoder.waitAll();
+  transcoder.end();
+
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+  printf("%d files transcoded, %d failed: %llu -> %llu bytes in %lld ms\n",
+         transcoder.filesProcessed(), transcoder.filesFailed(),
+         (unsigned long long)transcoder.bytesRead(),
+         (unsigned long long)transcoder.bytesWritten(), (long long)ms);
+  return transcoder.filesFailed() == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file flac-parallel.cpp
+ * @author Phil Schatzmann
+ * @brief Throughput benchmark: FLACEncoder compared with FLACEncoderParallel
+ * using a different number of workers
+ * @copyright GPLv3
+ */
+#include "AudioTools.h"
+#include "AudioCodecs/CodecFLAC.h"
+#include "AudioCodecs/CodecFLACParallel.h"
+
+AudioInfo info(44100, 2, 16);
+const int seconds = 60;
+SineWaveGenerator<int16_t> sine_wave(16000);
+Vector<int16_t> pcm{0};
+
+/// Counts the encoded bytes
+class CountingOutput : public AudioOutput {
+ public:
+  size_t total = 0;
+  size_t write(const uint8_t *data, size_t len) override {
+    total += len;
+    return len;
+  }
+};
+
+void report(const char *name, uint32_t ms, size_t bytes) {
+  if (ms == 0) ms = 1;
+  Serial.print(name);
+  Serial.print(": ");
+  Serial.print(ms);
+  Serial.print(" ms, ");
+  Serial.print((float)seconds * 1000 / ms);
+  Serial.print("x realtime, ");
+  Serial.print((uint32_t)bytes);
+  Serial.println(" bytes");
+}
+
+template <class T>
+uint32_t encode(T &encoder, CountingOutput &out) {
+  encoder.setAudioInfo(info);
+  encoder.setOutput(out);
+  encoder.begin();
+  uint32_t start = millis();
+  for (int j = 0; j < seconds; j++) {
+    encoder.write((const uint8_t *)pcm.data(), pcm.size() * sizeof(int16_t));
+  }
+  encoder.end();
+  return millis() - start;
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+
+  // one second of a sine wave which is encoded repeatedly
+  sine_wave.begin(info, N_B4);
+  pcm.resize(info.sample_rate * info.channels);
+  for (int j = 0; j < info.sample_rate; j++) {
+    int16_t sample = sine_wave.readSample();
+    pcm[j * 2] = sample;
+    pcm[j * 2 + 1] = sample;
+  }
+
+  CountingOutput out;
+  FLACEncoder flac;
+  flac.setBlockSize(4096);
+  uint32_t ms = encode(flac, out);
+  report("FLACEncoder", ms, out.total);
+
+  for (int workers = 1; workers <= 4; workers *= 2) {
+    CountingOutput out_parallel;
+    FLACEncoderParallel flac_parallel(workers);
+    flac_parallel.setBlockSize(4096);
+    ms = encode(flac_parallel, out_parallel);
+    Serial.print(workers);
+    report(" workers", ms, out_parallel.total);
+  }
+  stop();
+}
+
+void loop() {}
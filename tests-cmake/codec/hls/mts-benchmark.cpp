@@ -0,0 +1,104 @@
+// Packet level throughput of the MTSDecoder: we compare the buffered tsdemux
+// based processing with the streaming mode using synthetic TS packets which
+// contain a PAT, a PMT with one AAC stream and PES packets.
+#include "AudioTools.h"
+#include "AudioCodecs/CodecTSDemux.h"
+
+const int packets = 100000;
+const uint16_t pmt_pid = 0x100;
+const uint16_t audio_pid = 0x101;
+Vector<uint8_t> ts_data{0};
+
+/// Counts the bytes which are provided by the decoder
+class CountingOutput : public AudioOutput {
+ public:
+  size_t total = 0;
+  size_t write(const uint8_t *data, size_t len) override {
+    total += len;
+    return len;
+  }
+};
+
+void writeHeader(uint8_t *p, uint16_t pid, bool start, uint8_t cc) {
+  p[0] = 0x47;
+  p[1] = (start ? 0x40 : 0) | (pid >> 8);
+  p[2] = pid & 0xFF;
+  p[3] = 0x10 | (cc & 0x0F);
+}
+
+void writePAT(uint8_t *p) {
+  memset(p, 0xFF, 188);
+  writeHeader(p, 0, true, 0);
+  const uint8_t section[] = {0x00, 0x00, 0xB0, 0x0D, 0x00, 0x01, 0xC1, 0x00,
+                             0x00, 0x00, 0x01, 0xE0 | (pmt_pid >> 8),
+                             pmt_pid & 0xFF, 0, 0, 0, 0};
+  memcpy(p + 4, section, sizeof(section));
+}
+
+void writePMT(uint8_t *p) {
+  memset(p, 0xFF, 188);
+  writeHeader(p, pmt_pid, true, 0);
+  const uint8_t section[] = {0x00, 0x02, 0xB0, 0x12, 0x00, 0x01, 0xC1, 0x00,
+                             0x00, 0xE0 | (audio_pid >> 8), audio_pid & 0xFF,
+                             0xF0, 0x00, 0x0F, 0xE0 | (audio_pid >> 8),
+                             audio_pid & 0xFF, 0xF0, 0x00, 0, 0, 0, 0};
+  memcpy(p + 4, section, sizeof(section));
+}
+
+void writePES(uint8_t *p, bool start, uint8_t cc) {
+  writeHeader(p, audio_pid, start, cc);
+  for (int j = 4; j < 188; j++) p[j] = j;
+  if (start) {
+    // PES header w/o PTS and with unbounded length
+    const uint8_t header[] = {0x00, 0x00, 0x01, 0xC0, 0x00,
+                              0x00, 0x80, 0x00, 0x00};
+    memcpy(p + 4, header, sizeof(header));
+  }
+}
+
+void setupData() {
+  ts_data.resize(packets * 188);
+  uint8_t *p = ts_data.data();
+  writePAT(p);
+  writePMT(p + 188);
+  for (int j = 2; j < packets; j++) {
+    writePES(p + j * 188, j % 16 == 2, j);
+  }
+}
+
+void benchmark(bool streaming) {
+  CountingOutput out;
+  MTSDecoder mts;
+  mts.setOutput(out);
+  mts.setStreamingMode(streaming);
+  mts.begin();
+  uint32_t start = millis();
+  // feed the data in chunks which are not aligned to the packet size
+  size_t pos = 0;
+  while (pos < ts_data.size()) {
+    size_t len = min((size_t)1000, ts_data.size() - pos);
+    mts.write(ts_data.data() + pos, len);
+    pos += len;
+  }
+  mts.flush();
+  uint32_t ms = millis() - start;
+  mts.end();
+  if (ms == 0) ms = 1;
+  Serial.print(streaming ? "streaming: " : "buffered: ");
+  Serial.print(ms);
+  Serial.print(" ms, ");
+  Serial.print((uint32_t)((uint64_t)packets * 1000 / ms));
+  Serial.print(" packets/s, payload bytes: ");
+  Serial.println((uint32_t)out.total);
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+  setupData();
+  benchmark(false);
+  benchmark(true);
+  stop();
+}
+
+void loop() {}
@@ -0,0 +1,86 @@
+// Throughput of the SBCEncoder and LC3Encoder using 10 seconds of 48 kHz
+// stereo audio: one frame per write, batches of 16 frames and batches which
+// are encoded by the worker.
+#include "AudioTools.h"
+#include "AudioCodecs/CodecSBC.h"  // https://github.com/pschatzmann/arduino-libsbc
+#include "AudioCodecs/CodecLC3.h"  // https://github.com/pschatzmann/arduino-liblc3
+
+AudioInfo info(48000, 2, 16);
+const int frames = 48000 * 10;
+const int batch_frames = 16;
+Vector<int16_t> pcm{0};
+
+/// Counts the written bytes
+class CountingOutput : public AudioOutput {
+ public:
+  size_t total = 0;
+  size_t write(const uint8_t *in, size_t len) override {
+    total += len;
+    return len;
+  }
+};
+
+void setupData() {
+  pcm.resize(frames * info.channels);
+  for (int j = 0; j < frames; j++) {
+    pcm[j * 2] = 16000 * sin(2 * PI * 440 * j / info.sample_rate);
+    pcm[j * 2 + 1] = 16000 * sin(2 * PI * 660 * j / info.sample_rate);
+  }
+}
+
+void report(const char *name, const char *mode, uint32_t ms, size_t bytes) {
+  if (ms == 0) ms = 1;
+  Serial.print(name);
+  Serial.print(" ");
+  Serial.print(mode);
+  Serial.print(": ");
+  Serial.print(ms);
+  Serial.print(" ms, ");
+  Serial.print((uint32_t)((uint64_t)frames * 1000 / ms));
+  Serial.print(" frames/s, ");
+  Serial.print((uint32_t)bytes);
+  Serial.println(" bytes");
+}
+
+/// Encodes the pcm data in writes of 1024 bytes
+template <class Encoder>
+void benchmark(const char *name, const char *mode, Encoder &encoder) {
+  CountingOutput out;
+  encoder.setAudioInfo(info);
+  encoder.setOutput(out);
+  encoder.begin();
+  uint32_t start = millis();
+  const uint8_t *data = (const uint8_t *)pcm.data();
+  size_t len = pcm.size() * sizeof(int16_t);
+  for (size_t pos = 0; pos < len; pos += 1024) {
+    encoder.write(data + pos, min((size_t)1024, len - pos));
+  }
+  encoder.end();
+  report(name, mode, millis() - start, out.total);
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+  setupData();
+
+  for (int mode = 0; mode < 3; mode++) {
+    const char *mode_name = mode == 0 ? "frame" : mode == 1 ? "batch" : "worker";
+    SBCEncoder sbc(8, 16, 53);
+    sbc.setJointStereo(true);
+    LC3Encoder lc3(10000, 120);
+    if (mode > 0) {
+      sbc.setBatchFrames(batch_frames);
+      lc3.setBatchFrames(batch_frames);
+    }
+    if (mode == 2) {
+      sbc.setUseWorker(true);
+      lc3.setUseWorker(true);
+    }
+    benchmark("sbc", mode_name, sbc);
+    benchmark("lc3", mode_name, lc3);
+  }
+  stop();
+}
+
+void loop() {}
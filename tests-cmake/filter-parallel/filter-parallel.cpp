@@ -0,0 +1,104 @@
+/**
+ * @file filter-parallel.cpp
+ * @author Phil Schatzmann
+ * @brief 8 channel crossover with 4 biquads per channel: the result of the
+ * FilteredStreamParallel must be identical with the FilteredStream. Both
+ * processing times are printed.
+ * @copyright GPLv3
+ */
+#include "AudioTools.h"
+#include "AudioTools/FilteredStreamParallel.h"
+
+const int channels = 8;
+const int seconds = 10;
+AudioInfo info(48000, channels, 16);
+Vector<int16_t> pcm{0};
+
+/// Collects the written data in a preallocated vector
+class CollectingOutput : public AudioOutput {
+ public:
+  Vector<int16_t> data{0};
+  size_t size = 0;
+  CollectingOutput() { data.resize(pcm.size()); }
+  size_t write(const uint8_t *in, size_t len) override {
+    size_t samples = min(len / sizeof(int16_t), data.size() - size);
+    memcpy(data.data() + size, in, samples * sizeof(int16_t));
+    size += samples;
+    return len;
+  }
+};
+
+/// 4 biquads in series
+class Crossover : public Filter<float> {
+ public:
+  Crossover(int channel)
+      : lp1(2000 + channel * 100, 48000), lp2(2000 + channel * 100, 48000),
+        hp1(100 + channel * 10, 48000), hp2(100 + channel * 10, 48000) {}
+  float process(float in) override {
+    return hp2.process(hp1.process(lp2.process(lp1.process(in))));
+  }
+
+ protected:
+  LowPassFilter<float> lp1, lp2;
+  HighPassFilter<float> hp1, hp2;
+};
+
+/// Writes the test data in blocks of 1024 bytes: the FilteredStream is
+/// modifying the written data, so we always provide a copy
+uint32_t process(Print &out) {
+  Vector<int16_t> copy{0};
+  copy.resize(pcm.size());
+  memcpy(copy.data(), pcm.data(), pcm.size() * sizeof(int16_t));
+  uint8_t *data = (uint8_t *)copy.data();
+  size_t len = copy.size() * sizeof(int16_t);
+  uint32_t start = millis();
+  for (size_t pos = 0; pos < len; pos += 1024) {
+    out.write(data + pos, min((size_t)1024, len - pos));
+  }
+  return millis() - start;
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+
+  SineWaveGenerator<int16_t> sine(16000);
+  sine.begin(info, N_A4);
+  pcm.resize(info.sample_rate * channels * seconds);
+  for (int j = 0; j < pcm.size(); j++) pcm[j] = sine.readSample() + j % 1000;
+
+  // sequential reference: the FilteredStream deletes the filters
+  CollectingOutput expected;
+  FilteredStream<int16_t, float> filtered(expected, channels);
+  for (int ch = 0; ch < channels; ch++) filtered.setFilter(ch, new Crossover(ch));
+  filtered.begin(info);
+  uint32_t ms = process(filtered);
+  Serial.print("FilteredStream: ");
+  Serial.print(ms);
+  Serial.println(" ms");
+
+  CollectingOutput actual;
+  Crossover *filters[channels];
+  FilteredStreamParallel<int16_t, float> parallel(actual, channels);
+  for (int ch = 0; ch < channels; ch++) {
+    filters[ch] = new Crossover(ch);
+    parallel.setFilter(ch, filters[ch]);
+  }
+  parallel.begin(info);
+  ms = process(parallel);
+  parallel.end();
+  Serial.print("FilteredStreamParallel: ");
+  Serial.print(ms);
+  Serial.println(" ms");
+  for (int ch = 0; ch < channels; ch++) delete filters[ch];
+
+  assert(expected.size == pcm.size());
+  assert(actual.size == pcm.size());
+  for (int j = 0; j < pcm.size(); j++) {
+    assert(expected.data[j] == actual.data[j]);
+  }
+  Serial.println("ok");
+  stop();
+}
+
+void loop() {}
@@ -0,0 +1,65 @@
+/**
+ * @file worker-pool.cpp
+ * @author Phil Schatzmann
+ * @brief Sums up blocks of a sine wave with a WorkerPool: the result must be
+ * identical with the sequential calculation. We check the futures, the
+ * completion callbacks and waitAll().
+ * @copyright GPLv3
+ */
+#include "AudioTools.h"
+#include "Concurrency/WorkerPool.h"
+
+const int blocks = 64;
+const int block_size = 4096;
+Vector<int16_t> pcm{0};
+int64_t results[blocks];
+
+int64_t sum(int block) {
+  int64_t result = 0;
+  for (int j = 0; j < block_size; j++) {
+    result += pcm[block * block_size + j];
+  }
+  return result;
+}
+
+void setup() {
+  Serial.begin(115200);
+  AudioLogger::instance().begin(Serial, AudioLogger::Warning);
+
+  SineWaveGenerator<int16_t> sine(16000);
+  sine.begin(AudioInfo(44100, 1, 16), N_A4);
+  pcm.resize(blocks * block_size);
+  for (int j = 0; j < pcm.size(); j++) pcm[j] = sine.readSample();
+
+  WorkerPool pool;
+  pool.begin(4, 8);
+
+  // futures
+  WorkerFuture futures[blocks];
+  for (int b = 0; b < blocks; b++) {
+    pool.submit([b]() { results[b] = sum(b); }, &futures[b]);
+  }
+  for (int b = 0; b < blocks; b++) {
+    futures[b].wait();
+    assert(futures[b].isDone());
+    assert(results[b] == sum(b));
+  }
+
+  // completion callbacks
+  std::atomic<int> done{0};
+  for (int b = 0; b < blocks; b++) {
+    pool.submit([b]() { results[b] = -sum(b); }, [&done]() { done++; });
+  }
+  pool.waitAll();
+  assert(done == blocks);
+  assert(pool.pending() == 0);
+  for (int b = 0; b < blocks; b++) assert(results[b] == -sum(b));
+  pool.end();
+
+  // no more jobs after end
+  assert(!pool.submit([]() {}));
+  Serial.println("ok");
+  stop();
+}
+
+void loop() {}